@@ -0,0 +1,99 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Allocations.h"
+
+#ifdef RSOCKET_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+
+// The glibc allocator, under the names it keeps for code which interposes
+// malloc() and the rest.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+
+// Plain globals, constant initialized: the hooks run before any constructor.
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> bytes{0};
+
+void count(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(size, std::memory_order_relaxed);
+}
+}
+
+// The hooks match the declarations of glibc, which can't throw.
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+  count(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+  count(n * size);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+  count(size);
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+  count(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  count(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept {
+  count(size);
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+
+void free(void* ptr) noexcept {
+  __libc_free(ptr);
+}
+}
+
+namespace rsocket {
+
+bool countingAllocations() {
+  return true;
+}
+
+AllocationCount allocationCount() {
+  AllocationCount count;
+  count.allocations = allocations.load(std::memory_order_relaxed);
+  count.bytes = bytes.load(std::memory_order_relaxed);
+  return count;
+}
+}
+
+#else
+
+namespace rsocket {
+
+bool countingAllocations() {
+  return false;
+}
+
+AllocationCount allocationCount() {
+  return AllocationCount();
+}
+}
+
+#endif
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace rsocket {
+
+/// Heap allocations made by the process, in every thread.
+struct AllocationCount {
+  uint64_t allocations{0};
+  uint64_t bytes{0};
+};
+
+/// Whether the benchmarks were built to count allocations, with
+/// -DBENCHMARKS_COUNT_ALLOCATIONS=ON.  The counts are zero otherwise.
+///
+/// The counting build interposes malloc() and the rest of the glibc allocator,
+/// which operator new and folly's buffers go through, so it sees every
+/// allocation the library makes.  The counters are shared by all threads, the
+/// throughput of that build isn't comparable with the regular one.  It doesn't
+/// work with the sanitizers, nor with another malloc such as jemalloc.
+bool countingAllocations();
+
+/// The allocations made since the start of the process.
+AllocationCount allocationCount();
+
+/// Measures the allocations made from its construction on.
+class AllocationMeter {
+ public:
+  AllocationMeter() : start_{allocationCount()} {}
+
+  AllocationCount sinceStart() const {
+    auto const now = allocationCount();
+    AllocationCount count;
+    count.allocations = now.allocations - start_.allocations;
+    count.bytes = now.bytes - start_.bytes;
+    return count;
+  }
+
+  /// Allocations so far per item, for `items` of them.
+  double allocationsPer(size_t items) const {
+    return static_cast<double>(sinceStart().allocations) /
+        std::max<size_t>(items, 1);
+  }
+
+  /// Bytes allocated so far per item, for `items` of them.
+  double bytesPer(size_t items) const {
+    return static_cast<double>(sinceStart().bytes) /
+        std::max<size_t>(items, 1);
+  }
+
+ private:
+  const AllocationCount start_;
+};
+}
@@ -1,7 +1,10 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include "benchmarks/Results.h"
+
 #include <arpa/inet.h>
 #include <folly/Benchmark.h>
+#include <folly/Format.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -111,6 +114,8 @@ static void BM_Baseline_TCP_SendReceive(
     std::this_thread::yield();
   }
 
+  rsocket::ResultRecord record{folly::sformat(
+      "BaselineTcp/{}B/s{}B/r{}B", loadSize, msgLength, recvLength)};
   size_t receivedBytes = 0;
   while (receivedBytes < loadSize) {
     ssize_t recved = recv(sock, message, recvLength, 0);
@@ -123,6 +128,9 @@ static void BM_Baseline_TCP_SendReceive(
     receivedBytes += recved;
   }
 
+  record.stop();
+  record.throughput("bytes_per_s", receivedBytes / record.seconds());
+
   close(sock);
   t.join();
 }
@@ -1,5 +1,7 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include "benchmarks/Results.h"
+
 #include <folly/Benchmark.h>
 #include <folly/init/Init.h>
 
@@ -8,6 +10,10 @@ int main(int argc, char** argv) {
 
   FLAGS_logtostderr = true;
 
+  if (!FLAGS_results_json.empty()) {
+    LOG(INFO) << "Appending the results to " << FLAGS_results_json;
+  }
+
   LOG(INFO) << "Running benchmarks... (takes minutes)";
   folly::runBenchmarks();
 
@@ -0,0 +1,179 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "benchmarks/CpuMeter.h"
+#include "benchmarks/Latch.h"
+#include "benchmarks/Results.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Optional.h>
+
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketResponder.h"
+#include "yarpl/Flowable.h"
+
+namespace rsocket {
+
+/// Responder that answers every item of a channel, either with the item itself
+/// or with a fixed message of a given size.
+class ChannelResponder : public RSocketResponder {
+ public:
+  /// Echoes the items back without a response size.
+  explicit ChannelResponder(folly::Optional<size_t> responseSize)
+      : responseSize_{responseSize} {}
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requests,
+      StreamId) override {
+    if (!responseSize_) {
+      return requests;
+    }
+    auto message = std::make_shared<folly::IOBuf>(
+        folly::IOBuf::COPY_BUFFER, std::string(*responseSize_, 'a'));
+    return requests->map(
+        [message](Payload) { return Payload(message->clone()); });
+  }
+
+ private:
+  const folly::Optional<size_t> responseSize_;
+};
+
+/// Subscriber that receives N items, asking for at most `window` of them at a
+/// time: it tops the window up by half once half of it arrived.  Cancels the
+/// subscription once all of them arrived, and signals a latch when it
+/// terminates.
+class WindowedSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  WindowedSubscriber(Latch& latch, size_t items, size_t window)
+      : latch_{latch},
+        items_{items},
+        window_{std::max<size_t>(window, 1)},
+        refill_{std::max<size_t>(window_ / 2, 1)} {}
+
+  size_t received() const {
+    return received_;
+  }
+
+  size_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  void onSubscribeImpl() override {
+    this->request(std::min(window_, items_));
+  }
+
+  void onNextImpl(Payload payload) override {
+    bytes_ += payload.data ? payload.data->computeChainDataLength() : 0;
+    if (++received_ == items_) {
+      terminate();
+      // After this cancel we could be destroyed.
+      this->cancel();
+      return;
+    }
+    if (received_ % refill_ == 0 && requested_ < items_) {
+      auto const n = std::min(refill_, items_ - requested_);
+      requested_ += n;
+      this->request(n);
+    }
+  }
+
+  void onCompleteImpl() override {
+    terminate();
+  }
+
+  void onErrorImpl(folly::exception_wrapper) override {
+    terminate();
+  }
+
+  void terminate() {
+    if (!terminated_) {
+      terminated_ = true;
+      latch_.post();
+    }
+  }
+
+  Latch& latch_;
+  const size_t items_;
+  const size_t window_;
+  const size_t refill_;
+
+  // Only accessed on the EventBase of the client, until the latch is posted.
+  size_t requested_{std::min(window_, items_)};
+  size_t received_{0};
+  size_t bytes_{0};
+  bool terminated_{false};
+};
+
+/// Opens a channel on each client which sends `items` payloads of
+/// `requestSize` bytes and receives as many responses, with at most `window`
+/// of them requested at a time.  The responses are requested by the client,
+/// and the payloads by the server as it passes them on to the responses, so
+/// the window applies in both directions.  Logs the messages and bytes per
+/// second in each direction, and the CPU cycles per message, and records them
+/// as the results of benchmark `name`.
+inline void runChannels(
+    const std::string& name,
+    const std::vector<std::shared_ptr<RSocketClient>>& clients,
+    size_t requestSize,
+    size_t window,
+    size_t items) {
+  using Clock = std::chrono::steady_clock;
+
+  Latch latch{clients.size()};
+  std::vector<yarpl::Reference<WindowedSubscriber>> subscribers;
+  auto const message = std::make_shared<folly::IOBuf>(
+      folly::IOBuf::COPY_BUFFER, std::string(requestSize, 'a'));
+
+  ResultRecord record{name};
+  CpuMeter meter;
+  auto const start = Clock::now();
+  for (auto& client : clients) {
+    auto subscriber = yarpl::make_ref<WindowedSubscriber>(latch, items, window);
+    subscribers.push_back(subscriber);
+    // The first payload is the initial request of the channel, the responder
+    // answers the ones after it.
+    auto requests = yarpl::flowable::Flowables::fromGenerator<Payload>(
+                        [message] { return Payload(message->clone()); })
+                        ->take(static_cast<int64_t>(items) + 1);
+    client->getRequester()->requestChannel(std::move(requests))->subscribe(
+        std::move(subscriber));
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+    return;
+  }
+  record.stop();
+  auto const seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  size_t received = 0;
+  size_t receivedBytes = 0;
+  for (auto& subscriber : subscribers) {
+    received += subscriber->received();
+    receivedBytes += subscriber->bytes();
+  }
+  auto const sent = clients.size() * items;
+  LOG(INFO) << "  Sent " << sent / seconds << " msgs/s, "
+            << sent * requestSize / seconds << " bytes/s";
+  LOG(INFO) << "  Received " << received / seconds << " msgs/s, "
+            << receivedBytes / seconds << " bytes/s";
+  LOG(INFO) << "  " << meter.cyclesPer(sent + received) << " cycles/message";
+
+  record.items(sent + received);
+  record.throughput("sent_msgs_per_s", sent / seconds);
+  record.throughput("sent_bytes_per_s", sent * requestSize / seconds);
+  record.throughput("received_msgs_per_s", received / seconds);
+  record.throughput("received_bytes_per_s", receivedBytes / seconds);
+  record.metric("cycles_per_msg", meter.cyclesPer(sent + received));
+}
+}
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/ChannelThroughput.h"
+#include "benchmarks/MemoryFixture.h"
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(items, 100000, "number of items sent on the channel");
+
+namespace {
+
+/// Runs a channel whose responses are either the items echoed back or
+/// messages of `responseSize` bytes.
+void channelThroughput(
+    size_t requestSize,
+    folly::Optional<size_t> responseSize,
+    size_t window) {
+  std::unique_ptr<MemoryFixture> fixture;
+
+  BENCHMARK_SUSPEND {
+    fixture = std::make_unique<MemoryFixture>(
+        std::make_shared<ChannelResponder>(responseSize));
+
+    LOG(INFO) << "  Running a channel of " << FLAGS_items << " items of "
+              << requestSize << " bytes, window of " << window;
+  }
+
+  runChannels(
+      folly::sformat(
+          "{}/{}B/window{}",
+          responseSize ? "Asymmetric" : "Echo",
+          requestSize,
+          window),
+      {fixture->client},
+      requestSize,
+      window,
+      FLAGS_items);
+}
+
+void Echo(unsigned n, size_t size, size_t window) {
+  (void)n;
+  channelThroughput(size, folly::none, window);
+}
+
+/// Large items to the server, small ones back.
+void Asymmetric(unsigned n, size_t size, size_t window) {
+  (void)n;
+  channelThroughput(size, kMessageLen, window);
+}
+}
+
+BENCHMARK_NAMED_PARAM(Echo, 32B_window16, 32, 16)
+BENCHMARK_NAMED_PARAM(Echo, 32B_window256, 32, 256)
+BENCHMARK_NAMED_PARAM(Echo, 32B_window4096, 32, 4096)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window16, 1024, 16)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window256, 1024, 256)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window4096, 1024, 4096)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window16, 16384, 16)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window256, 16384, 256)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window4096, 16384, 4096)
+
+BENCHMARK_DRAW_LINE()
+
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window16, 1024, 16)
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window256, 1024, 256)
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window4096, 1024, 4096)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window16, 16384, 16)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window256, 16384, 256)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window4096, 16384, 4096)
@@ -0,0 +1,95 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/ChannelThroughput.h"
+#include "benchmarks/Fixture.h"
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(
+    override_client_threads,
+    0,
+    "control the number of client threads (defaults to the number of clients)");
+DEFINE_int32(clients, 10, "number of clients to run");
+DEFINE_int32(items, 100000, "number of items sent on the channel, per client");
+
+namespace {
+
+/// Runs a channel per client, whose responses are either the items echoed
+/// back or messages of `responseSize` bytes.
+void channelThroughput(
+    size_t requestSize,
+    folly::Optional<size_t> responseSize,
+    size_t window) {
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+
+  BENCHMARK_SUSPEND {
+    auto responder = std::make_shared<ChannelResponder>(responseSize);
+
+    opts.serverThreads = FLAGS_server_threads;
+    opts.clients = FLAGS_clients;
+    if (FLAGS_override_client_threads > 0) {
+      opts.clientThreads = FLAGS_override_client_threads;
+    }
+
+    fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+    LOG(INFO) << "  " << opts.clients << " clients across "
+              << fixture->workers.size() << " threads.";
+    LOG(INFO) << "  Running a channel of " << FLAGS_items << " items of "
+              << requestSize << " bytes per client, window of " << window;
+  }
+
+  runChannels(
+      folly::sformat(
+          "{}/{}B/window{}",
+          responseSize ? "Asymmetric" : "Echo",
+          requestSize,
+          window),
+      fixture->clients,
+      requestSize,
+      window,
+      FLAGS_items);
+}
+
+void Echo(unsigned n, size_t size, size_t window) {
+  (void)n;
+  channelThroughput(size, folly::none, window);
+}
+
+/// Large items to the server, small ones back.
+void Asymmetric(unsigned n, size_t size, size_t window) {
+  (void)n;
+  channelThroughput(size, kMessageLen, window);
+}
+}
+
+BENCHMARK_NAMED_PARAM(Echo, 32B_window16, 32, 16)
+BENCHMARK_NAMED_PARAM(Echo, 32B_window256, 32, 256)
+BENCHMARK_NAMED_PARAM(Echo, 32B_window4096, 32, 4096)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window16, 1024, 16)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window256, 1024, 256)
+BENCHMARK_NAMED_PARAM(Echo, 1KB_window4096, 1024, 4096)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window16, 16384, 16)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window256, 16384, 256)
+BENCHMARK_NAMED_PARAM(Echo, 16KB_window4096, 16384, 4096)
+
+BENCHMARK_DRAW_LINE()
+
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window16, 1024, 16)
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window256, 1024, 256)
+BENCHMARK_NAMED_PARAM(Asymmetric, 1KB_window4096, 1024, 4096)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window16, 16384, 16)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window256, 16384, 256)
+BENCHMARK_NAMED_PARAM(Asymmetric, 16KB_window4096, 16384, 4096)
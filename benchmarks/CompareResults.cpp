@@ -0,0 +1,180 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <folly/Format.h>
+#include <folly/dynamic.h>
+#include <folly/init/Init.h>
+#include <folly/json.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+/// Compares the results two runs of the benchmarks wrote with --results_json,
+/// and fails when a result got worse by more than --threshold percent:
+///
+///   compare-results [--threshold=5] BASELINE.json CURRENT.json
+///
+/// Throughputs are better higher.  Latency percentiles (up to p99), CPU and
+/// wall time, resident memory and allocations (in the build counting them)
+/// are better lower.  Other figures, latency tails and benchmarks only one of
+/// the runs has are shown but not compared.
+
+DEFINE_double(
+    threshold,
+    5.0,
+    "percentage by which a result may get worse before it fails the "
+    "comparison");
+
+namespace {
+
+using Records = std::map<std::string, folly::dynamic>;
+
+/// The records of a file by benchmark, the last one of each.
+Records load(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    LOG(FATAL) << "Can't read " << path;
+  }
+  Records records;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    auto record = folly::parseJson(line);
+    records[record["benchmark"].asString()] = std::move(record);
+  }
+  return records;
+}
+
+struct Result {
+  std::string name;
+  double value;
+  /// Whether the result is compared, and better higher or lower.
+  enum class Kind { HIGHER_IS_BETTER, LOWER_IS_BETTER, SHOWN } kind;
+};
+
+std::vector<Result> results(const folly::dynamic& record) {
+  using Kind = Result::Kind;
+  std::vector<Result> results;
+  auto add = [&](const std::string& name, const folly::dynamic* value, Kind k) {
+    if (value && value->isNumber()) {
+      results.push_back({name, value->asDouble(), k});
+    }
+  };
+
+  for (auto const& item : record["throughput"].items()) {
+    add("throughput." + item.first.asString(),
+        &item.second,
+        Kind::HIGHER_IS_BETTER);
+  }
+  for (auto const& histogram : record["latency_us"].items()) {
+    auto const prefix = "latency_us." + histogram.first.asString() + ".";
+    for (auto const& item : histogram.second.items()) {
+      auto const percentile = item.first.asString();
+      auto const compared =
+          percentile == "p50" || percentile == "p90" || percentile == "p99";
+      add(prefix + percentile,
+          &item.second,
+          compared ? Kind::LOWER_IS_BETTER : Kind::SHOWN);
+    }
+  }
+  for (auto const name : {"wall_seconds",
+                          "cpu_seconds",
+                          "resident_bytes",
+                          "allocations",
+                          "allocated_bytes",
+                          "allocations_per_item",
+                          "allocated_bytes_per_item"}) {
+    add(name, record.get_ptr(name), Kind::LOWER_IS_BETTER);
+  }
+  for (auto const& item : record["metrics"].items()) {
+    add("metrics." + item.first.asString(), &item.second, Kind::SHOWN);
+  }
+  return results;
+}
+
+/// Prints the changes of the results of a benchmark, returns whether any of
+/// them regressed.
+bool compare(
+    const std::string& benchmark,
+    const folly::dynamic& baseline,
+    const folly::dynamic& current) {
+  LOG(INFO) << benchmark;
+  if (!(baseline["flags"] == current["flags"])) {
+    LOG(WARNING) << "  The runs have different flags: "
+                 << folly::toJson(baseline["flags"]) << " vs "
+                 << folly::toJson(current["flags"]);
+  }
+
+  std::map<std::string, double> before;
+  for (auto const& result : results(baseline)) {
+    before[result.name] = result.value;
+  }
+
+  bool regressed = false;
+  for (auto const& result : results(current)) {
+    auto it = before.find(result.name);
+    if (it == before.end()) {
+      LOG(INFO) << "  " << result.name << ": " << result.value << " (new)";
+      continue;
+    }
+    auto const change =
+        it->second != 0 ? 100 * (result.value - it->second) / it->second : 0;
+    auto worse = 0.0;
+    if (result.kind == Result::Kind::HIGHER_IS_BETTER) {
+      worse = -change;
+    } else if (result.kind == Result::Kind::LOWER_IS_BETTER) {
+      worse = change;
+    }
+    auto const regression = worse > FLAGS_threshold;
+    regressed = regressed || regression;
+    LOG(INFO) << "  " << result.name << ": " << it->second << " -> "
+              << result.value << folly::sformat(" ({:+.1f}%)", change)
+              << (regression ? " REGRESSION" : "");
+  }
+  return regressed;
+}
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+
+  FLAGS_logtostderr = true;
+
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: " << argv[0]
+               << " [--threshold=PERCENT] BASELINE.json CURRENT.json";
+    return 2;
+  }
+
+  auto const baseline = load(argv[1]);
+  auto const current = load(argv[2]);
+
+  size_t regressions = 0;
+  for (auto const& record : current) {
+    auto it = baseline.find(record.first);
+    if (it == baseline.end()) {
+      LOG(INFO) << record.first << ": not in the baseline";
+      continue;
+    }
+    if (compare(record.first, it->second, record.second)) {
+      ++regressions;
+    }
+  }
+  for (auto const& record : baseline) {
+    if (current.find(record.first) == current.end()) {
+      LOG(INFO) << record.first << ": not in the current run";
+    }
+  }
+
+  if (regressions > 0) {
+    LOG(ERROR) << regressions << " benchmarks regressed by more than "
+               << FLAGS_threshold << "%";
+    return 1;
+  }
+  return 0;
+}
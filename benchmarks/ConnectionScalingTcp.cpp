@@ -0,0 +1,243 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/CpuMeter.h"
+#include "benchmarks/Fixture.h"
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Latch.h"
+#include "benchmarks/ResourceUsage.h"
+#include "benchmarks/Results.h"
+#include "benchmarks/Throughput.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(client_threads, 8, "number of threads driving the clients");
+DEFINE_int32(connections, 10000, "number of connections (one per client)");
+DEFINE_int32(keepalive_ms, 1000, "keepalive interval of the clients");
+DEFINE_int32(
+    idle_seconds,
+    5,
+    "how long to measure the CPU time of the idle connections for");
+DEFINE_int32(
+    requests,
+    100,
+    "number of request-responses sent by each active connection, one at a "
+    "time");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Sends request-responses from one client one at a time, and records how
+/// long each took.
+class ClosedLoopClient {
+ public:
+  ClosedLoopClient(
+      folly::EventBase& eventBase,
+      RSocketRequester& requester,
+      size_t requests,
+      Latch& latch)
+      : eventBase_{eventBase},
+        requester_{requester},
+        requests_{requests},
+        latch_{latch} {}
+
+  void start() {
+    eventBase_.runInEventBaseThread([this] { send(); });
+  }
+
+  const LatencyHistogram& latencies() const {
+    return latencies_;
+  }
+
+  size_t errors() const {
+    return errors_;
+  }
+
+ private:
+  class Observer : public yarpl::single::SingleObserverBase<Payload> {
+   public:
+    explicit Observer(ClosedLoopClient& client) : client_{client} {}
+
+    void onSuccess(Payload) override {
+      client_.onResponse();
+      yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+    }
+
+    void onError(folly::exception_wrapper) override {
+      ++client_.errors_;
+      client_.onResponse();
+      yarpl::single::SingleObserverBase<Payload>::onError({});
+    }
+
+   private:
+    ClosedLoopClient& client_;
+  };
+
+  void send() {
+    if (done_ == requests_) {
+      latch_.post();
+      return;
+    }
+    sent_ = Clock::now();
+    requester_.requestResponse(Payload("ConnectionScalingTcp"))
+        ->subscribe(yarpl::make_ref<Observer>(*this));
+  }
+
+  void onResponse() {
+    latencies_.record(Clock::now() - sent_);
+    ++done_;
+    send();
+  }
+
+  folly::EventBase& eventBase_;
+  RSocketRequester& requester_;
+  const size_t requests_;
+  Latch& latch_;
+
+  Clock::time_point sent_;
+  size_t done_{0};
+  size_t errors_{0};
+  LatencyHistogram latencies_;
+};
+
+void report(const LatencyHistogram& histogram) {
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  LOG(INFO) << "  Latency (us) over " << histogram.count()
+            << " requests: p50=" << us(histogram.percentile(50))
+            << " p90=" << us(histogram.percentile(90))
+            << " p99=" << us(histogram.percentile(99))
+            << " p99.9=" << us(histogram.percentile(99.9))
+            << " max=" << us(histogram.max())
+            << " mean=" << us(histogram.mean());
+}
+
+/// Connects all of the clients, lets them idle, then has `activeFraction` of
+/// them send requests while the others keep idling.
+///
+/// The memory per connection covers both of its ends, as client and server
+/// run in this process.  It includes the threads of the fixture, so run with
+/// enough connections to make those negligible.  The idle CPU time is mostly
+/// spent on keepalives.
+void ConnectionScaling(unsigned n, double activeFraction) {
+  (void)n;
+
+  Fixture::Options opts;
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = FLAGS_connections;
+  opts.clientThreads = FLAGS_client_threads;
+  opts.keepaliveInterval = std::chrono::milliseconds(FLAGS_keepalive_ms);
+
+  LOG(INFO) << "Running:";
+  LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+  LOG(INFO) << "  " << opts.clients << " clients across "
+            << *opts.clientThreads << " threads, keepalive every "
+            << FLAGS_keepalive_ms << "ms.";
+
+  ResultRecord record{folly::sformat(
+      "ConnectionScaling/{}pct_active",
+      static_cast<int>(std::lround(activeFraction * 100)))};
+  auto const residentBefore = residentBytes();
+  auto const start = Clock::now();
+  auto fixture = std::make_unique<Fixture>(
+      opts, std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')));
+  auto const setupSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  auto const resident = residentBytes();
+
+  auto const connections = static_cast<double>(opts.clients);
+  LOG(INFO) << "  Setup: " << connections / setupSeconds << " connections/s";
+  LOG(INFO) << "  Memory: "
+            << (static_cast<double>(resident) - residentBefore) / connections
+            << " bytes/connection (" << resident << " bytes resident)";
+  record.throughput("connections_per_s", connections / setupSeconds);
+  record.metric(
+      "bytes_per_connection",
+      (static_cast<double>(resident) - residentBefore) / connections);
+
+  {
+    CpuMeter meter;
+    std::this_thread::sleep_for(std::chrono::seconds(FLAGS_idle_seconds));
+    auto const cpu = meter.seconds();
+    LOG(INFO) << "  Idle: " << 100 * cpu / FLAGS_idle_seconds
+              << "% of a CPU, "
+              << cpu * 1e6 / FLAGS_idle_seconds / connections
+              << "us of CPU per connection per second";
+    record.metric(
+        "idle_cpu_us_per_connection_s",
+        cpu * 1e6 / FLAGS_idle_seconds / connections);
+  }
+
+  auto const active = static_cast<size_t>(connections * activeFraction);
+  if (active == 0) {
+    return;
+  }
+
+  Latch latch{active};
+  std::vector<std::unique_ptr<ClosedLoopClient>> loadClients;
+  for (size_t i = 0; i < active; ++i) {
+    loadClients.push_back(std::make_unique<ClosedLoopClient>(
+        *fixture->clientEventBases[i],
+        *fixture->clients[i]->getRequester(),
+        FLAGS_requests,
+        latch));
+  }
+
+  LOG(INFO) << "  " << active << " active connections sending "
+            << FLAGS_requests << " requests each.";
+
+  CpuMeter meter;
+  for (auto& client : loadClients) {
+    client->start();
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+  auto const cpu = meter.seconds();
+  record.stop();
+
+  // Stop the clients before reading their histograms.
+  fixture.reset();
+
+  LatencyHistogram latencies;
+  size_t errors = 0;
+  for (auto& client : loadClients) {
+    latencies.merge(client->latencies());
+    errors += client->errors();
+  }
+  report(latencies);
+  auto const cpuPerRequest =
+      cpu * 1e6 / std::max<uint64_t>(latencies.count(), 1);
+  LOG(INFO) << "  " << cpuPerRequest << "us of CPU per request";
+  record.items(latencies.count());
+  record.latency("request_response", latencies);
+  record.metric("cpu_us_per_request", cpuPerRequest);
+  if (errors > 0) {
+    LOG(ERROR) << errors << " requests failed";
+  }
+}
+}
+
+BENCHMARK_NAMED_PARAM(ConnectionScaling, idle, 0.0)
+BENCHMARK_NAMED_PARAM(ConnectionScaling, 1pct_active, 0.01)
+BENCHMARK_NAMED_PARAM(ConnectionScaling, 10pct_active, 0.1)
+BENCHMARK_NAMED_PARAM(ConnectionScaling, all_active, 1.0)
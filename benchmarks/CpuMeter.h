@@ -0,0 +1,62 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Measures the CPU time of the process from its construction on, across all
+/// of its threads and including the time the kernel spends on its behalf.
+///
+/// The time is converted to cycles at the rate of the timestamp counter, which
+/// ticks at the nominal frequency of the CPU.  Without a timestamp counter the
+/// "cycles" are nanoseconds.
+class CpuMeter {
+ public:
+  CpuMeter()
+      : cpuStart_{cpuNanos()}, wallStart_{Clock::now()}, tscStart_{tsc()} {}
+
+  /// CPU time spent so far.
+  double seconds() const {
+    return (cpuNanos() - cpuStart_) / 1e9;
+  }
+
+  /// CPU cycles spent so far per message, for `messages` of them.
+  double cyclesPer(size_t messages) const {
+    auto const cpu = cpuNanos() - cpuStart_;
+    auto const wall =
+        std::chrono::duration<double, std::nano>(Clock::now() - wallStart_)
+            .count();
+    auto const ticks = static_cast<double>(tsc() - tscStart_);
+    auto const cyclesPerNano = ticks > 0 && wall > 0 ? ticks / wall : 1.0;
+    return cpu * cyclesPerNano / std::max<size_t>(messages, 1);
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static double cpuNanos() {
+    timespec ts;
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + ts.tv_nsec;
+  }
+
+  static uint64_t tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  const double cpuStart_;
+  const Clock::time_point wallStart_;
+  const uint64_t tscStart_;
+};
@@ -2,6 +2,10 @@
 
 #include "benchmarks/Fixture.h"
 #include "benchmarks/Latch.h"
+#include "benchmarks/Results.h"
+
+#include <algorithm>
+#include <vector>
 
 #include <folly/Benchmark.h>
 #include <folly/portability/GFlags.h>
@@ -17,6 +21,11 @@ DEFINE_int32(
     "control the number of client threads (defaults to the number of clients)");
 DEFINE_int32(clients, 10, "number of clients to run");
 DEFINE_int32(items, 1000000, "number of items to fire-and-forget, in total");
+DEFINE_int32(
+    batch_size,
+    0,
+    "send the items with fireAndForgetBatch, this many at a time per client "
+    "(0 sends them one by one)");
 
 namespace {
 
@@ -59,16 +68,39 @@ BENCHMARK(FireForgetThroughput, n) {
     LOG(INFO) << "  Running " << FLAGS_items << " requests in total.";
   }
 
-  for (int i = 0; i < FLAGS_items; ++i) {
-    for (auto& client : fixture->clients) {
-      client->getRequester()
-          ->fireAndForget(Payload("TcpFireAndForget"))
-          ->subscribe(yarpl::make_ref<yarpl::single::SingleObserverBase<void>>());
+  ResultRecord record{"FireForgetThroughput"};
+  if (FLAGS_batch_size > 0) {
+    for (int i = 0; i < FLAGS_items; i += FLAGS_batch_size) {
+      auto const batchSize = std::min(FLAGS_batch_size, FLAGS_items - i);
+      for (auto& client : fixture->clients) {
+        std::vector<Payload> batch;
+        batch.reserve(batchSize);
+        for (int j = 0; j < batchSize; ++j) {
+          batch.emplace_back("TcpFireAndForget");
+        }
+        client->getRequester()
+            ->fireAndForgetBatch(std::move(batch))
+            ->subscribe(
+                yarpl::make_ref<yarpl::single::SingleObserverBase<void>>());
+      }
+    }
+  } else {
+    for (int i = 0; i < FLAGS_items; ++i) {
+      for (auto& client : fixture->clients) {
+        client->getRequester()
+            ->fireAndForget(Payload("TcpFireAndForget"))
+            ->subscribe(
+                yarpl::make_ref<yarpl::single::SingleObserverBase<void>>());
+      }
     }
   }
 
   constexpr std::chrono::minutes timeout{5};
   if (!latch.timed_wait(timeout)) {
     LOG(ERROR) << "Timed out!";
+    return;
   }
+  record.stop();
+  record.items(FLAGS_items);
+  record.throughput("msgs_per_s", FLAGS_items / record.seconds());
 }
@@ -10,13 +10,38 @@ namespace rsocket {
 
 namespace {
 
-std::shared_ptr<RSocketClient> makeClient(
+folly::Future<std::unique_ptr<RSocketClient>> makeClient(
     folly::EventBase* eventBase,
-    folly::SocketAddress address) {
+    folly::SocketAddress address,
+    std::chrono::milliseconds keepaliveInterval) {
   auto factory =
       std::make_unique<TcpConnectionFactory>(*eventBase, std::move(address));
-  return RSocket::createConnectedClient(std::move(factory)).get();
+  return RSocket::createConnectedClient(
+      std::move(factory),
+      SetupParameters(),
+      std::make_shared<RSocketResponder>(),
+      keepaliveInterval);
 }
+
+/// Runs the responder of every connection on the threads of an executor.
+class ExecutorServiceHandler : public RSocketServiceHandler {
+ public:
+  ExecutorServiceHandler(
+      std::shared_ptr<RSocketResponder> responder,
+      std::shared_ptr<ResponderExecutor> executor)
+      : responder_{std::move(responder)}, executor_{std::move(executor)} {}
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    RSocketConnectionParams params(responder_);
+    params.responderExecutor = executor_;
+    return params;
+  }
+
+ private:
+  const std::shared_ptr<RSocketResponder> responder_;
+  const std::shared_ptr<ResponderExecutor> executor_;
+};
 }
 
 Fixture::Fixture(
@@ -29,7 +54,15 @@ Fixture::Fixture(
 
   auto acceptor = std::make_unique<TcpConnectionAcceptor>(std::move(opts));
   server = std::make_unique<RSocketServer>(std::move(acceptor));
-  server->start([responder](const SetupParameters&) { return responder; });
+  if (options.singleThreadedResponder) {
+    server->setSingleThreadedResponder();
+  }
+  if (options.responderExecutor) {
+    server->start(std::make_shared<ExecutorServiceHandler>(
+        std::move(responder), options.responderExecutor));
+  } else {
+    server->start([responder](const SetupParameters&) { return responder; });
+  }
 
   auto const numWorkers =
       options.clientThreads ? *options.clientThreads : options.clients;
@@ -40,11 +73,17 @@ Fixture::Fixture(
 
   const folly::SocketAddress actual{"127.0.0.1", *server->listeningPort()};
 
+  std::vector<folly::Future<std::unique_ptr<RSocketClient>>> connecting;
   for (size_t i = 0; i < options.clients; ++i) {
     auto worker = std::move(workers.front());
     workers.pop_front();
-    clients.push_back(makeClient(worker->getEventBase(), actual));
+    connecting.push_back(makeClient(
+        worker->getEventBase(), actual, options.keepaliveInterval));
+    clientEventBases.push_back(worker->getEventBase());
     workers.push_back(std::move(worker));
   }
+  for (auto& client : connecting) {
+    clients.push_back(std::move(client).get());
+  }
 }
 }
@@ -4,10 +4,12 @@
 
 #include "rsocket/RSocketClient.h"
 #include "rsocket/RSocketServer.h"
+#include "rsocket/ResponderExecutor.h"
 
 #include <folly/Optional.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 
+#include <chrono>
 #include <deque>
 #include <vector>
 
@@ -16,7 +18,7 @@ namespace rsocket {
 /// Benchmarks fixture object that contains a server, along with a list of
 /// clients and their worker threads.
 ///
-/// Uses TCP as the transport.
+/// Uses TCP as the transport.  The clients connect concurrently.
 struct Fixture {
   struct Options {
     /// Number of threads the server will run.
@@ -28,6 +30,16 @@ struct Fixture {
     /// Number of worker threads driving the clients.  A default value means to
     /// use one thread per client.
     folly::Optional<size_t> clientThreads;
+
+    /// Keepalive interval of the clients.
+    std::chrono::milliseconds keepaliveInterval{kDefaultKeepaliveInterval};
+
+    /// How the server calls the responder: on the EventBase of each
+    /// connection with singleThreadedResponder, on the threads of
+    /// responderExecutor when there is one, and through a
+    /// ScheduledRSocketResponder otherwise.
+    bool singleThreadedResponder{false};
+    std::shared_ptr<ResponderExecutor> responderExecutor;
   };
 
   Fixture(Options, std::shared_ptr<RSocketResponder>);
@@ -37,6 +49,8 @@ struct Fixture {
   std::unique_ptr<RSocketServer> server;
   std::deque<std::unique_ptr<folly::ScopedEventBaseThread>> workers;
   std::vector<std::shared_ptr<RSocketClient>> clients;
+  /// EventBase of the worker each client runs on, by client index.
+  std::vector<folly::EventBase*> clientEventBases;
   const Options options;
 };
 }
@@ -0,0 +1,324 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/framing/FrameSerializer.h"
+
+using namespace rsocket;
+
+/// Encoding and decoding of every frame type, by every serializer.
+///
+/// Frames which carry a payload are measured for each payload size, with and
+/// without metadata, and with the payload (when encoding) or the frame (when
+/// decoding) in one contiguous buffer or in a chain of them.  There are a lot
+/// of combinations, pick some with --bm_regex, e.g.
+///
+///   frame-serializer --bm_regex='v1.0/PAYLOAD/.*/1KB'
+
+namespace {
+
+constexpr size_t kPayloadSizes[] = {16, 1024, 64 * 1024};
+constexpr size_t kMetadataSize = 32;
+/// Number of buffers a chained payload or frame is split into.
+constexpr size_t kChainLength = 4;
+constexpr StreamId kStreamId = 1;
+
+const ProtocolVersion kVersions[] = {ProtocolVersion(0, 0),
+                                     ProtocolVersion(0, 1),
+                                     ProtocolVersion(1, 0)};
+
+/// Copies `size` bytes into one buffer, or into a chain of kChainLength.
+std::unique_ptr<folly::IOBuf> makeBuffer(size_t size, bool chained) {
+  if (!chained) {
+    return folly::IOBuf::copyBuffer(std::string(size, 'a'));
+  }
+  auto const piece = (size + kChainLength - 1) / kChainLength;
+  std::unique_ptr<folly::IOBuf> head;
+  for (size_t offset = 0; offset < size || !head; offset += piece) {
+    auto buf = folly::IOBuf::copyBuffer(
+        std::string(std::min(piece, size - offset), 'a'));
+    if (head) {
+      head->prependChain(std::move(buf));
+    } else {
+      head = std::move(buf);
+    }
+  }
+  return head;
+}
+
+/// The same bytes in one buffer, or split into a chain of kChainLength.
+std::unique_ptr<folly::IOBuf> reshape(const folly::IOBuf& frame, bool chained) {
+  auto bytes = frame.clone();
+  bytes->coalesce();
+  if (!chained) {
+    return bytes;
+  }
+  auto const size = bytes->length();
+  auto const piece = (size + kChainLength - 1) / kChainLength;
+  std::unique_ptr<folly::IOBuf> head;
+  for (size_t offset = 0; offset < size || !head; offset += piece) {
+    auto buf = folly::IOBuf::copyBuffer(
+        bytes->data() + offset, std::min(piece, size - offset));
+    if (head) {
+      head->prependChain(std::move(buf));
+    } else {
+      head = std::move(buf);
+    }
+  }
+  return head;
+}
+
+Payload makePayload(size_t size, bool metadata, bool chained) {
+  return Payload(
+      makeBuffer(size, chained),
+      metadata ? makeBuffer(kMetadataSize, chained) : nullptr);
+}
+
+template <typename Frame>
+std::unique_ptr<folly::IOBuf> serialize(
+    FrameSerializer& serializer,
+    Frame frame) {
+  return serializer.serializeOut(std::move(frame));
+}
+
+std::unique_ptr<folly::IOBuf> serialize(
+    FrameSerializer& serializer,
+    Frame_KEEPALIVE frame) {
+  return serializer.serializeOut(std::move(frame), true);
+}
+
+template <typename Frame>
+bool deserialize(
+    FrameSerializer& serializer,
+    Frame& frame,
+    std::unique_ptr<folly::IOBuf> in) {
+  return serializer.deserializeFrom(frame, std::move(in));
+}
+
+bool deserialize(
+    FrameSerializer& serializer,
+    Frame_KEEPALIVE& frame,
+    std::unique_ptr<folly::IOBuf> in) {
+  return serializer.deserializeFrom(frame, std::move(in), true);
+}
+
+/// The name of a benchmark of a serializer.  Names have to outlive the
+/// benchmarks.
+const char* benchmarkName(ProtocolVersion version, const std::string& name) {
+  static std::deque<std::string> names;
+  names.push_back(
+      folly::sformat("v{}.{}/{}", version.major, version.minor, name));
+  return names.back().c_str();
+}
+
+/// Registers the encoding and the decoding of the frames `make` creates.  The
+/// frames are created before the measurement, and encoded frames are decoded
+/// from buffers shaped by `chained`.
+template <typename Frame>
+void addFrameBenchmarks(
+    ProtocolVersion version,
+    const std::string& name,
+    std::function<Frame()> make,
+    bool chained) {
+  folly::addBenchmark(
+      __FILE__,
+      benchmarkName(version, name + "/encode"),
+      [version, make](unsigned iters) -> unsigned {
+        std::unique_ptr<FrameSerializer> serializer;
+        std::vector<Frame> frames;
+        BENCHMARK_SUSPEND {
+          serializer = FrameSerializer::createFrameSerializer(version);
+          frames.reserve(iters);
+          for (unsigned i = 0; i < iters; ++i) {
+            frames.push_back(make());
+          }
+        }
+        for (auto& frame : frames) {
+          folly::doNotOptimizeAway(serialize(*serializer, std::move(frame)));
+        }
+        return iters;
+      });
+
+  folly::addBenchmark(
+      __FILE__,
+      benchmarkName(version, name + "/decode"),
+      [version, make, chained](unsigned iters) -> unsigned {
+        std::unique_ptr<FrameSerializer> serializer;
+        std::vector<std::unique_ptr<folly::IOBuf>> buffers;
+        BENCHMARK_SUSPEND {
+          serializer = FrameSerializer::createFrameSerializer(version);
+          auto const encoded =
+              reshape(*serialize(*serializer, make()), chained);
+          buffers.reserve(iters);
+          for (unsigned i = 0; i < iters; ++i) {
+            buffers.push_back(encoded->clone());
+          }
+        }
+        for (auto& buffer : buffers) {
+          Frame frame;
+          folly::doNotOptimizeAway(
+              deserialize(*serializer, frame, std::move(buffer)));
+        }
+        return iters;
+      });
+}
+
+/// Registers the frames carrying a payload, for every payload shape.
+template <typename Frame>
+void addPayloadFrameBenchmarks(
+    ProtocolVersion version,
+    const std::string& type,
+    std::function<Frame(Payload)> make) {
+  for (auto size : kPayloadSizes) {
+    for (auto metadata : {false, true}) {
+      for (auto chained : {false, true}) {
+        auto const payload = std::make_shared<Payload>(
+            makePayload(size, metadata, chained));
+        auto const name = folly::sformat(
+            "{}/{}/{}/{}",
+            type,
+            size >= 1024 ? folly::sformat("{}KB", size / 1024)
+                         : folly::sformat("{}B", size),
+            metadata ? "metadata" : "no_metadata",
+            chained ? "chained" : "contiguous");
+        addFrameBenchmarks<Frame>(
+            version,
+            name,
+            [payload, make] { return make(payload->clone()); },
+            chained);
+      }
+    }
+  }
+}
+
+/// Registers peekFrameType() and peekStreamId() on a PAYLOAD frame.
+void addPeekBenchmarks(ProtocolVersion version) {
+  auto const serializer = FrameSerializer::createFrameSerializer(version);
+  auto const encoded =
+      std::shared_ptr<folly::IOBuf>(serializer->serializeOut(Frame_PAYLOAD(
+          kStreamId, FrameFlags::NEXT, makePayload(1024, false, false))));
+
+  folly::addBenchmark(
+      __FILE__,
+      benchmarkName(version, "peekFrameType"),
+      [version, encoded](unsigned iters) -> unsigned {
+        std::unique_ptr<FrameSerializer> serializer;
+        BENCHMARK_SUSPEND {
+          serializer = FrameSerializer::createFrameSerializer(version);
+        }
+        for (unsigned i = 0; i < iters; ++i) {
+          folly::doNotOptimizeAway(serializer->peekFrameType(*encoded));
+        }
+        return iters;
+      });
+
+  folly::addBenchmark(
+      __FILE__,
+      benchmarkName(version, "peekStreamId"),
+      [version, encoded](unsigned iters) -> unsigned {
+        std::unique_ptr<FrameSerializer> serializer;
+        BENCHMARK_SUSPEND {
+          serializer = FrameSerializer::createFrameSerializer(version);
+        }
+        for (unsigned i = 0; i < iters; ++i) {
+          folly::doNotOptimizeAway(serializer->peekStreamId(*encoded));
+        }
+        return iters;
+      });
+}
+
+void addBenchmarks(ProtocolVersion version) {
+  addPayloadFrameBenchmarks<Frame_REQUEST_STREAM>(
+      version, "REQUEST_STREAM", [](Payload payload) {
+        return Frame_REQUEST_STREAM(
+            kStreamId, FrameFlags::EMPTY, 1, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_REQUEST_CHANNEL>(
+      version, "REQUEST_CHANNEL", [](Payload payload) {
+        return Frame_REQUEST_CHANNEL(
+            kStreamId, FrameFlags::EMPTY, 1, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_REQUEST_RESPONSE>(
+      version, "REQUEST_RESPONSE", [](Payload payload) {
+        return Frame_REQUEST_RESPONSE(
+            kStreamId, FrameFlags::EMPTY, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_REQUEST_FNF>(
+      version, "REQUEST_FNF", [](Payload payload) {
+        return Frame_REQUEST_FNF(
+            kStreamId, FrameFlags::EMPTY, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_PAYLOAD>(
+      version, "PAYLOAD", [](Payload payload) {
+        return Frame_PAYLOAD(kStreamId, FrameFlags::NEXT, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_ERROR>(
+      version, "ERROR", [](Payload payload) {
+        return Frame_ERROR(
+            kStreamId, ErrorCode::APPLICATION_ERROR, std::move(payload));
+      });
+  addPayloadFrameBenchmarks<Frame_SETUP>(
+      version, "SETUP", [version](Payload payload) {
+        return Frame_SETUP(
+            FrameFlags::EMPTY,
+            version.major,
+            version.minor,
+            5000,
+            Frame_SETUP::kMaxLifetime,
+            ResumeIdentificationToken(),
+            "text/plain",
+            "text/plain",
+            std::move(payload));
+      });
+
+  addFrameBenchmarks<Frame_REQUEST_N>(
+      version,
+      "REQUEST_N",
+      [] { return Frame_REQUEST_N(kStreamId, 64); },
+      false);
+  addFrameBenchmarks<Frame_CANCEL>(
+      version, "CANCEL", [] { return Frame_CANCEL(kStreamId); }, false);
+  addFrameBenchmarks<Frame_METADATA_PUSH>(
+      version,
+      "METADATA_PUSH",
+      [] { return Frame_METADATA_PUSH(makeBuffer(kMetadataSize, false)); },
+      false);
+  addFrameBenchmarks<Frame_KEEPALIVE>(
+      version,
+      "KEEPALIVE",
+      [] {
+        return Frame_KEEPALIVE(
+            FrameFlags::KEEPALIVE_RESPOND, 0, makeBuffer(16, false));
+      },
+      false);
+  addFrameBenchmarks<Frame_LEASE>(
+      version, "LEASE", [] { return Frame_LEASE(1000, 100); }, false);
+  addFrameBenchmarks<Frame_RESUME>(
+      version,
+      "RESUME",
+      [version] {
+        return Frame_RESUME(ResumeIdentificationToken(), 0, 0, version);
+      },
+      false);
+  addFrameBenchmarks<Frame_RESUME_OK>(
+      version, "RESUME_OK", [] { return Frame_RESUME_OK(0); }, false);
+
+  addPeekBenchmarks(version);
+}
+
+struct Registration {
+  Registration() {
+    for (auto const& version : kVersions) {
+      addBenchmarks(version);
+    }
+  }
+} registration;
+}
@@ -0,0 +1,125 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <folly/Bits.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+/// Histogram of latencies in the style of HdrHistogram.  Values are counted in
+/// log-linear buckets: every power of two range is split into the same number
+/// of linear sub-buckets, so any recorded value is reported with a relative
+/// error below 1 / 2^(kPrecisionBits - 1), from nanoseconds up to hours,
+/// using a fixed amount of memory.
+///
+/// Not thread-safe.  Use one histogram per thread and merge them.
+class LatencyHistogram {
+ public:
+  using Duration = std::chrono::nanoseconds;
+
+  LatencyHistogram() : counts_(kBucketCount, 0) {}
+
+  void record(Duration latency) {
+    auto const value = static_cast<uint64_t>(std::max<int64_t>(
+        latency.count(), 0));
+    ++counts_[bucketIndex(value)];
+    ++total_;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t count() const {
+    return total_;
+  }
+
+  Duration min() const {
+    return Duration(total_ ? min_ : 0);
+  }
+
+  Duration max() const {
+    return Duration(max_);
+  }
+
+  Duration mean() const {
+    return Duration(total_ ? sum_ / total_ : 0);
+  }
+
+  /// Smallest value which at least `percentile` percent of the recorded
+  /// values are equal or lower than, rounded up to the end of its bucket.
+  Duration percentile(double percentile) const {
+    if (total_ == 0) {
+      return Duration(0);
+    }
+    auto const clamped = std::min(std::max(percentile, 0.0), 100.0);
+    auto const target = std::max<uint64_t>(
+        1,
+        static_cast<uint64_t>(
+            std::ceil(clamped / 100.0 * static_cast<double>(total_))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return Duration(std::min(highestValueInBucket(i), max_));
+      }
+    }
+    return Duration(max_);
+  }
+
+ private:
+  static constexpr unsigned kPrecisionBits = 8;
+  static constexpr uint64_t kSubBuckets = uint64_t(1) << kPrecisionBits;
+  static constexpr uint64_t kHalfSubBuckets = kSubBuckets / 2;
+  static constexpr size_t kBucketCount =
+      kSubBuckets + (64 - kPrecisionBits) * kHalfSubBuckets;
+
+  /// Values below kSubBuckets are counted exactly.  Above that, a value is
+  /// shifted right until it falls into [kSubBuckets / 2, kSubBuckets), and the
+  /// shift selects the power of two range.
+  static size_t bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    auto const shift = folly::findLastSet(value) - kPrecisionBits;
+    DCHECK_GE(shift, 1U);
+    return static_cast<size_t>(
+        kSubBuckets + (shift - 1) * kHalfSubBuckets +
+        ((value >> shift) - kHalfSubBuckets));
+  }
+
+  static uint64_t highestValueInBucket(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    auto const shift = (index - kSubBuckets) / kHalfSubBuckets + 1;
+    auto const subBucket = (index - kSubBuckets) % kHalfSubBuckets;
+    auto const lowest = (kHalfSubBuckets + subBucket) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_{0};
+  uint64_t sum_{0};
+  uint64_t min_{std::numeric_limits<uint64_t>::max()};
+  uint64_t max_{0};
+};
+}
@@ -0,0 +1,637 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Fixture.h"
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Latch.h"
+#include "benchmarks/Results.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/FileUtil.h>
+#include <folly/io/Cursor.h>
+#include <folly/json.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+DEFINE_string(
+    workload,
+    "",
+    "JSON file describing the workload, see the README (defaults to a mix of "
+    "all the interactions)");
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(
+    override_client_threads,
+    0,
+    "control the number of client threads (defaults to the number of clients)");
+DEFINE_int32(connections, 0, "override the connections of the workload");
+DEFINE_int32(rate, 0, "override the requests/s of the workload");
+DEFINE_int32(duration_s, 0, "override the duration of the workload");
+DEFINE_uint64(seed, 1, "seed of the random choices of the clients");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kDefaultWorkload = R"({
+  "connections": 10,
+  "rate": 10000,
+  "duration_s": 10,
+  "interactions": {
+    "request_response": {
+      "weight": 70,
+      "request_size": 64,
+      "response_size": {"min": 64, "max": 4096}
+    },
+    "fire_and_forget": {"weight": 20, "request_size": [[64, 9], [1024, 1]]},
+    "stream": {"weight": 5, "request_size": 64, "response_size": 256,
+               "items": {"min": 1, "max": 100}},
+    "channel": {"weight": 5, "request_size": 256, "response_size": 256,
+                "items": 10}
+  }
+})";
+
+enum class Interaction : size_t {
+  REQUEST_RESPONSE,
+  FIRE_AND_FORGET,
+  STREAM,
+  CHANNEL,
+};
+
+constexpr size_t kInteractions = 4;
+
+constexpr std::array<const char*, kInteractions> kInteractionNames{
+    {"request_response", "fire_and_forget", "stream", "channel"}};
+
+using Random = std::mt19937_64;
+
+/// Sizes, or item counts, picked at random.  Parsed from a number, for a
+/// fixed one, {"min": A, "max": B} for uniformly distributed ones, or
+/// [[A, weight], [B, weight], ...] for weighted ones.
+class Distribution {
+ public:
+  Distribution() = default;
+
+  explicit Distribution(const folly::dynamic& spec) {
+    if (spec.isInt()) {
+      min_ = max_ = spec.asInt();
+    } else if (spec.isObject()) {
+      min_ = spec["min"].asInt();
+      max_ = spec["max"].asInt();
+      uniform_ = true;
+    } else if (spec.isArray()) {
+      std::vector<double> weights;
+      for (auto& choice : spec) {
+        values_.push_back(choice[0].asInt());
+        weights.push_back(choice[1].asDouble());
+      }
+      if (values_.empty()) {
+        throw std::invalid_argument("empty distribution");
+      }
+      weighted_ = std::discrete_distribution<size_t>(
+          weights.begin(), weights.end());
+      min_ = *std::min_element(values_.begin(), values_.end());
+      max_ = *std::max_element(values_.begin(), values_.end());
+    } else {
+      throw std::invalid_argument("bad distribution " + folly::toJson(spec));
+    }
+    if (min_ > max_) {
+      throw std::invalid_argument("bad distribution " + folly::toJson(spec));
+    }
+  }
+
+  size_t operator()(Random& random) {
+    if (uniform_) {
+      return std::uniform_int_distribution<size_t>(min_, max_)(random);
+    }
+    if (!values_.empty()) {
+      return values_[weighted_(random)];
+    }
+    return min_;
+  }
+
+  size_t max() const {
+    return max_;
+  }
+
+ private:
+  size_t min_{0};
+  size_t max_{0};
+  bool uniform_{false};
+  std::vector<size_t> values_;
+  std::discrete_distribution<size_t> weighted_;
+};
+
+struct InteractionSpec {
+  double weight{0};
+  Distribution requestSize;
+  Distribution responseSize;
+  /// Of streams and channels, in each direction.
+  Distribution items;
+};
+
+/// What the clients send, see kDefaultWorkload.  The requests are spread
+/// evenly over the connections and sent at a fixed rate.
+struct Workload {
+  size_t connections{0};
+  size_t rate{0};
+  std::chrono::seconds duration{0};
+  std::array<InteractionSpec, kInteractions> interactions;
+
+  explicit Workload(const folly::dynamic& spec) {
+    connections = spec.getDefault("connections", 1).asInt();
+    rate = spec.getDefault("rate", 1000).asInt();
+    duration = std::chrono::seconds(spec.getDefault("duration_s", 10).asInt());
+    if (FLAGS_connections > 0) {
+      connections = FLAGS_connections;
+    }
+    if (FLAGS_rate > 0) {
+      rate = FLAGS_rate;
+    }
+    if (FLAGS_duration_s > 0) {
+      duration = std::chrono::seconds(FLAGS_duration_s);
+    }
+
+    for (auto& item : spec["interactions"].items()) {
+      auto const name = item.first.asString();
+      auto const it =
+          std::find(kInteractionNames.begin(), kInteractionNames.end(), name);
+      if (it == kInteractionNames.end()) {
+        throw std::invalid_argument("unknown interaction " + name);
+      }
+      auto& interaction = interactions[it - kInteractionNames.begin()];
+      auto& config = item.second;
+      interaction.weight = config.getDefault("weight", 1).asDouble();
+      interaction.requestSize =
+          Distribution(config.getDefault("request_size", 0));
+      interaction.responseSize =
+          Distribution(config.getDefault("response_size", 0));
+      interaction.items = Distribution(config.getDefault("items", 1));
+    }
+  }
+
+  size_t maxSize() const {
+    size_t size = 0;
+    for (auto& interaction : interactions) {
+      size = std::max(
+          {size, interaction.requestSize.max(), interaction.responseSize.max()});
+    }
+    return size;
+  }
+};
+
+/// A payload of `size` bytes, sharing the buffer of `message`.
+Payload makePayload(const folly::IOBuf& message, size_t size) {
+  auto data = message.clone();
+  data->trimEnd(data->length() - std::min(size, data->length()));
+  return Payload(std::move(data));
+}
+
+/// Answers each request with payloads of the size the request asks for in its
+/// metadata.  Streams go on until they are canceled.
+class WorkloadResponder : public RSocketResponder {
+ public:
+  explicit WorkloadResponder(size_t maxSize)
+      : message_{std::make_shared<folly::IOBuf>(
+            folly::IOBuf::COPY_BUFFER,
+            std::string(maxSize, 'a'))} {}
+
+  yarpl::Reference<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    return yarpl::single::Singles::fromGenerator<Payload>(
+        [message = message_, size = responseSize(request)] {
+          return makePayload(*message, size);
+        });
+  }
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId) override {
+    return yarpl::flowable::Flowables::fromGenerator<Payload>(
+        [message = message_, size = responseSize(request)] {
+          return makePayload(*message, size);
+        });
+  }
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requests,
+      StreamId) override {
+    return requests->map(
+        [message = message_, size = responseSize(request)](Payload) {
+          return makePayload(*message, size);
+        });
+  }
+
+  void handleFireAndForget(Payload, StreamId) override {}
+
+ private:
+  static size_t responseSize(const Payload& request) {
+    if (!request.metadata) {
+      return 0;
+    }
+    folly::io::Cursor cursor(request.metadata.get());
+    uint32_t size = 0;
+    cursor.tryReadBE(size);
+    return size;
+  }
+
+  const std::shared_ptr<folly::IOBuf> message_;
+};
+
+/// Figures of one interaction on one client.
+struct InteractionStats {
+  size_t completed{0};
+  size_t errors{0};
+  size_t requestBytes{0};
+  size_t responseBytes{0};
+  LatencyHistogram corrected;
+  LatencyHistogram uncorrected;
+
+  void merge(const InteractionStats& other) {
+    completed += other.completed;
+    errors += other.errors;
+    requestBytes += other.requestBytes;
+    responseBytes += other.responseBytes;
+    corrected.merge(other.corrected);
+    uncorrected.merge(other.uncorrected);
+  }
+};
+
+/// Sends the requests of one client at a fixed rate, picking the interaction
+/// and the sizes of each at random, and records how long each took until its
+/// last response, as in RequestResponseLatencyTcp.cpp.  Fire-and-forgets have
+/// no response, they are only counted.
+///
+/// Everything runs on the EventBase of the client.
+class LoadClient {
+ public:
+  LoadClient(
+      folly::EventBase& eventBase,
+      RSocketRequester& requester,
+      const Workload& workload,
+      std::chrono::nanoseconds interval,
+      size_t requests,
+      uint64_t seed,
+      Latch& latch)
+      : eventBase_{eventBase},
+        requester_{requester},
+        workload_{workload},
+        interval_{interval},
+        requests_{requests},
+        random_{seed},
+        latch_{latch},
+        message_{std::make_shared<folly::IOBuf>(
+            folly::IOBuf::COPY_BUFFER,
+            std::string(workload.maxSize(), 'a'))} {
+    std::vector<double> weights;
+    for (auto& interaction : workload_.interactions) {
+      weights.push_back(interaction.weight);
+    }
+    pick_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+  }
+
+  void start() {
+    eventBase_.runInEventBaseThread([this] {
+      start_ = Clock::now();
+      sendDue();
+    });
+  }
+
+  const InteractionStats& stats(Interaction interaction) const {
+    return stats_[static_cast<size_t>(interaction)];
+  }
+
+ private:
+  /// Observes a request/response.
+  class Observer : public yarpl::single::SingleObserverBase<Payload> {
+   public:
+    Observer(
+        LoadClient& client,
+        Clock::time_point scheduled,
+        Clock::time_point sent)
+        : client_{client}, scheduled_{scheduled}, sent_{sent} {}
+
+    void onSuccess(Payload payload) override {
+      client_.onResponse(Interaction::REQUEST_RESPONSE, payload);
+      client_.onDone(Interaction::REQUEST_RESPONSE, scheduled_, sent_);
+      yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+    }
+
+    void onError(folly::exception_wrapper) override {
+      client_.onError(Interaction::REQUEST_RESPONSE);
+      yarpl::single::SingleObserverBase<Payload>::onError({});
+    }
+
+   private:
+    LoadClient& client_;
+    const Clock::time_point scheduled_;
+    const Clock::time_point sent_;
+  };
+
+  /// Counts the fire-and-forgets which couldn't be sent.
+  class FireAndForgetObserver : public yarpl::single::SingleObserverBase<void> {
+   public:
+    explicit FireAndForgetObserver(LoadClient& client) : client_{client} {}
+
+    void onError(folly::exception_wrapper) override {
+      ++client_.stats_[static_cast<size_t>(Interaction::FIRE_AND_FORGET)]
+            .errors;
+      yarpl::single::SingleObserverBase<void>::onError({});
+    }
+
+   private:
+    LoadClient& client_;
+  };
+
+  /// Observes a stream or a channel until `items` responses arrived.
+  class Subscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+   public:
+    Subscriber(
+        LoadClient& client,
+        Interaction interaction,
+        size_t items,
+        Clock::time_point scheduled,
+        Clock::time_point sent)
+        : client_{client},
+          interaction_{interaction},
+          items_{std::max<size_t>(items, 1)},
+          scheduled_{scheduled},
+          sent_{sent} {}
+
+   private:
+    void onSubscribeImpl() override {
+      this->request(items_);
+    }
+
+    void onNextImpl(Payload payload) override {
+      client_.onResponse(interaction_, payload);
+      if (++received_ == items_) {
+        terminate(false);
+        // After this cancel we could be destroyed.
+        this->cancel();
+      }
+    }
+
+    void onCompleteImpl() override {
+      terminate(false);
+    }
+
+    void onErrorImpl(folly::exception_wrapper) override {
+      terminate(true);
+    }
+
+    void terminate(bool error) {
+      if (terminated_) {
+        return;
+      }
+      terminated_ = true;
+      if (error) {
+        client_.onError(interaction_);
+      } else {
+        client_.onDone(interaction_, scheduled_, sent_);
+      }
+    }
+
+    LoadClient& client_;
+    const Interaction interaction_;
+    const size_t items_;
+    const Clock::time_point scheduled_;
+    const Clock::time_point sent_;
+    size_t received_{0};
+    bool terminated_{false};
+  };
+
+  /// Sends every request whose time has come, then checks again in a
+  /// millisecond.
+  void sendDue() {
+    while (sent_ < requests_) {
+      auto const scheduled = start_ + interval_ * static_cast<int64_t>(sent_);
+      auto const now = Clock::now();
+      if (scheduled > now) {
+        break;
+      }
+      ++sent_;
+      send(static_cast<Interaction>(pick_(random_)), scheduled, now);
+    }
+
+    if (sent_ < requests_) {
+      eventBase_.runAfterDelay([this] { sendDue(); }, 1);
+    }
+  }
+
+  void send(
+      Interaction interaction,
+      Clock::time_point scheduled,
+      Clock::time_point now) {
+    auto& spec = workload_.interactions[static_cast<size_t>(interaction)];
+    auto& stats = stats_[static_cast<size_t>(interaction)];
+
+    auto request = makePayload(*message_, spec.requestSize(random_));
+    auto const responseSize = static_cast<uint32_t>(spec.responseSize(random_));
+    request.metadata = folly::IOBuf::create(sizeof(responseSize));
+    folly::io::Appender(request.metadata.get(), 0).writeBE(responseSize);
+    stats.requestBytes += request.data->computeChainDataLength();
+
+    switch (interaction) {
+      case Interaction::REQUEST_RESPONSE:
+        requester_.requestResponse(std::move(request))
+            ->subscribe(yarpl::make_ref<Observer>(*this, scheduled, now));
+        break;
+      case Interaction::FIRE_AND_FORGET:
+        requester_.fireAndForget(std::move(request))
+            ->subscribe(yarpl::make_ref<FireAndForgetObserver>(*this));
+        // Done once it's sent, the errors are counted after.
+        ++stats.completed;
+        latch_.post();
+        break;
+      case Interaction::STREAM:
+        requester_.requestStream(std::move(request))
+            ->subscribe(yarpl::make_ref<Subscriber>(
+                *this, interaction, spec.items(random_), scheduled, now));
+        break;
+      case Interaction::CHANNEL: {
+        auto const items = spec.items(random_);
+        auto const size = spec.requestSize(random_);
+        // The first payload is the initial request of the channel, the
+        // responder answers the ones after it.
+        auto first = std::make_shared<Payload>(std::move(request));
+        auto requests = yarpl::flowable::Flowables::fromGenerator<Payload>(
+                            [first, message = message_, size] {
+                              if (*first) {
+                                return std::move(*first);
+                              }
+                              return makePayload(*message, size);
+                            })
+                            ->take(static_cast<int64_t>(items) + 1);
+        stats.requestBytes += items * size;
+        requester_.requestChannel(std::move(requests))
+            ->subscribe(yarpl::make_ref<Subscriber>(
+                *this, interaction, items, scheduled, now));
+        break;
+      }
+    }
+  }
+
+  void onResponse(Interaction interaction, const Payload& payload) {
+    stats_[static_cast<size_t>(interaction)].responseBytes +=
+        payload.data ? payload.data->computeChainDataLength() : 0;
+  }
+
+  void onDone(
+      Interaction interaction,
+      Clock::time_point scheduled,
+      Clock::time_point sent) {
+    auto& stats = stats_[static_cast<size_t>(interaction)];
+    auto const now = Clock::now();
+    stats.corrected.record(now - scheduled);
+    stats.uncorrected.record(now - sent);
+    ++stats.completed;
+    latch_.post();
+  }
+
+  void onError(Interaction interaction) {
+    ++stats_[static_cast<size_t>(interaction)].errors;
+    latch_.post();
+  }
+
+  folly::EventBase& eventBase_;
+  RSocketRequester& requester_;
+  const Workload& workload_;
+  const std::chrono::nanoseconds interval_;
+  const size_t requests_;
+  Random random_;
+  Latch& latch_;
+  const std::shared_ptr<folly::IOBuf> message_;
+  std::discrete_distribution<size_t> pick_;
+
+  Clock::time_point start_;
+  size_t sent_{0};
+  std::array<InteractionStats, kInteractions> stats_;
+};
+
+void report(
+    ResultRecord& record,
+    const std::string& name,
+    const InteractionStats& stats) {
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  auto const seconds = record.seconds();
+  LOG(INFO) << name << ": " << stats.completed / seconds << " requests/s, "
+            << stats.requestBytes / seconds << " request bytes/s, "
+            << stats.responseBytes / seconds << " response bytes/s, "
+            << stats.errors << " errors";
+  record.throughput(name + "_per_s", stats.completed / seconds);
+  record.metric(name + "_errors", stats.errors);
+  if (stats.corrected.count() == 0) {
+    return;
+  }
+  auto const& histogram = stats.corrected;
+  LOG(INFO) << "  latency (us): p50=" << us(histogram.percentile(50))
+            << " p90=" << us(histogram.percentile(90))
+            << " p99=" << us(histogram.percentile(99))
+            << " p99.9=" << us(histogram.percentile(99.9))
+            << " max=" << us(histogram.max())
+            << " mean=" << us(histogram.mean())
+            << " (uncorrected p99=" << us(stats.uncorrected.percentile(99))
+            << ")";
+  record.latency(name, stats.corrected);
+  record.latency(name + "_uncorrected", stats.uncorrected);
+}
+}
+
+BENCHMARK(LoadGenerator, n) {
+  (void)n;
+
+  std::unique_ptr<Workload> workload;
+  std::vector<std::unique_ptr<LoadClient>> loadClients;
+  std::unique_ptr<Fixture> fixture;
+  std::unique_ptr<Latch> latch;
+  Fixture::Options opts;
+
+  BENCHMARK_SUSPEND {
+    std::string spec = kDefaultWorkload;
+    if (!FLAGS_workload.empty() &&
+        !folly::readFile(FLAGS_workload.c_str(), spec)) {
+      LOG(FATAL) << "Can't read " << FLAGS_workload;
+    }
+    workload = std::make_unique<Workload>(folly::parseJson(spec));
+
+    opts.serverThreads = FLAGS_server_threads;
+    opts.clients = std::max<size_t>(workload->connections, 1);
+    if (FLAGS_override_client_threads > 0) {
+      opts.clientThreads = FLAGS_override_client_threads;
+    }
+
+    fixture = std::make_unique<Fixture>(
+        opts, std::make_shared<WorkloadResponder>(workload->maxSize()));
+
+    auto const perClientRate =
+        std::max<size_t>(workload->rate / opts.clients, 1);
+    auto const perClient = static_cast<size_t>(
+        perClientRate * workload->duration.count());
+    latch = std::make_unique<Latch>(perClient * opts.clients);
+
+    auto const interval =
+        std::chrono::nanoseconds{std::chrono::seconds(1)} / perClientRate;
+    for (size_t i = 0; i < opts.clients; ++i) {
+      loadClients.push_back(std::make_unique<LoadClient>(
+          *fixture->clientEventBases[i],
+          *fixture->clients[i]->getRequester(),
+          *workload,
+          interval,
+          perClient,
+          FLAGS_seed + i,
+          *latch));
+    }
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+    LOG(INFO) << "  " << opts.clients << " clients across "
+              << fixture->workers.size() << " threads.";
+    LOG(INFO) << "  Running " << perClient << " requests per client at "
+              << perClientRate << " requests/s each";
+  }
+
+  ResultRecord record{"LoadGenerator"};
+  for (auto& client : loadClients) {
+    client->start();
+  }
+
+  auto const timeout = workload->duration + std::chrono::minutes(5);
+  if (!latch->timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+  record.stop();
+
+  BENCHMARK_SUSPEND {
+    // Stop the clients before reading their figures.
+    fixture.reset();
+
+    size_t items = 0;
+    for (size_t i = 0; i < kInteractions; ++i) {
+      if (workload->interactions[i].weight <= 0) {
+        continue;
+      }
+      InteractionStats stats;
+      for (auto& client : loadClients) {
+        stats.merge(client->stats(static_cast<Interaction>(i)));
+      }
+      report(record, kInteractionNames[i], stats);
+      items += stats.completed;
+    }
+    record.items(items);
+  }
+}
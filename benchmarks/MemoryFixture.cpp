@@ -0,0 +1,268 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/MemoryFixture.h"
+
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include "rsocket/RSocket.h"
+
+namespace rsocket {
+
+namespace {
+
+/// One direction of a loopback connection: the frames written by one end,
+/// on their way to the input of the other end, on its EventBase.
+///
+/// Frames written while a delivery is already scheduled join it, so a burst
+/// of frames costs a single hop to the other EventBase.
+class LoopbackPipe : public std::enable_shared_from_this<LoopbackPipe> {
+ public:
+  explicit LoopbackPipe(folly::EventBase& eventBase) : eventBase_{&eventBase} {}
+
+  /// Can be called from any thread.
+  void write(std::unique_ptr<folly::IOBuf> frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    frames_.push_back(std::move(frame));
+    scheduleLocked();
+  }
+
+  /// The input of the reading end completes after the frames written before.
+  /// Can be called from any thread.
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    scheduleLocked();
+  }
+
+  // The rest is only called on the EventBase of the reading end.
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber> input) {
+    if (auto previous = std::move(input_)) {
+      previous->onComplete();
+    }
+    input_ = std::move(input);
+    // Frames which arrived before wait for it.
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduleLocked();
+  }
+
+  void cancelInput() {
+    input_ = nullptr;
+  }
+
+  /// The reading end is gone, drops the frames written from now on.
+  void detach() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      eventBase_ = nullptr;
+      closed_ = true;
+      frames_.clear();
+    }
+    input_ = nullptr;
+  }
+
+ private:
+  void scheduleLocked() {
+    if (scheduled_ || !eventBase_) {
+      return;
+    }
+    scheduled_ = true;
+    eventBase_->runInEventBaseThread(
+        [self = shared_from_this()] { self->deliver(); });
+  }
+
+  void deliver() {
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    bool closed;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      scheduled_ = false;
+      if (!input_) {
+        return;
+      }
+      frames.swap(frames_);
+      closed = closed_;
+    }
+
+    for (auto& frame : frames) {
+      // The frames left after the input canceled are dropped.
+      if (!input_) {
+        return;
+      }
+      input_->onNext(std::move(frame));
+    }
+    if (closed) {
+      if (auto input = std::move(input_)) {
+        input->onComplete();
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  folly::EventBase* eventBase_;
+  std::vector<std::unique_ptr<folly::IOBuf>> frames_;
+  bool scheduled_{false};
+  bool closed_{false};
+
+  /// Only accessed on the EventBase of the reading end.
+  yarpl::Reference<DuplexConnection::Subscriber> input_;
+};
+
+class LoopbackInputSubscription : public yarpl::flowable::Subscription {
+ public:
+  explicit LoopbackInputSubscription(std::shared_ptr<LoopbackPipe> pipe)
+      : pipe_{std::move(pipe)} {}
+
+  void request(int64_t) override {}
+
+  void cancel() override {
+    if (auto pipe = std::move(pipe_)) {
+      pipe->cancelInput();
+    }
+  }
+
+ private:
+  std::shared_ptr<LoopbackPipe> pipe_;
+};
+
+class LoopbackOutputSubscriber : public DuplexConnection::Subscriber {
+ public:
+  explicit LoopbackOutputSubscriber(std::shared_ptr<LoopbackPipe> pipe)
+      : pipe_{std::move(pipe)} {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    // No flow control, like the other transports.
+    subscription->request(std::numeric_limits<int64_t>::max());
+    subscription_ = std::move(subscription);
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    pipe_->write(std::move(frame));
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+  }
+
+  void onError(folly::exception_wrapper) override {
+    subscription_ = nullptr;
+  }
+
+ private:
+  const std::shared_ptr<LoopbackPipe> pipe_;
+  yarpl::Reference<yarpl::flowable::Subscription> subscription_;
+};
+
+/// One end of a pair of DuplexConnections connected to each other in memory,
+/// without a socket or the kernel in between: the frames written to it are
+/// handed over as they are to the input of the other end.  The frames keep
+/// their boundaries, so that no length fields are written or parsed either.
+///
+/// Has to be destroyed on the EventBase it reads on.  Destroying it completes
+/// the input of the other end.
+class LoopbackConnection : public DuplexConnection {
+ public:
+  LoopbackConnection(
+      std::shared_ptr<LoopbackPipe> inbound,
+      std::shared_ptr<LoopbackPipe> outbound)
+      : inbound_{std::move(inbound)}, outbound_{std::move(outbound)} {}
+
+  ~LoopbackConnection() {
+    inbound_->detach();
+    outbound_->close();
+  }
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber> input) override {
+    input->onSubscribe(yarpl::make_ref<LoopbackInputSubscription>(inbound_));
+    inbound_->setInput(std::move(input));
+  }
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override {
+    return yarpl::make_ref<LoopbackOutputSubscriber>(outbound_);
+  }
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  const std::shared_ptr<LoopbackPipe> inbound_;
+  const std::shared_ptr<LoopbackPipe> outbound_;
+};
+
+/// Accepts the server end of a single loopback connection.
+class Acceptor : public ConnectionAcceptor {
+ public:
+  folly::EventBase& eventBase() {
+    return *worker_.getEventBase();
+  }
+
+  void setConnection(std::unique_ptr<DuplexConnection> connection) {
+    connection_ = std::move(connection);
+  }
+
+  void start(OnDuplexConnectionAccept onAccept) override {
+    eventBase().runInEventBaseThread(
+        [ this, onAccept = std::move(onAccept) ]() mutable {
+          onAccept(std::move(connection_), eventBase());
+        });
+  }
+
+  void stop() override {}
+
+  folly::Optional<uint16_t> listeningPort() const override {
+    return folly::none;
+  }
+
+ private:
+  folly::ScopedEventBaseThread worker_;
+  std::unique_ptr<DuplexConnection> connection_;
+};
+
+/// Runs the server, and connects the client end of its loopback connection.
+class Factory : public ConnectionFactory {
+ public:
+  explicit Factory(std::shared_ptr<RSocketResponder> responder) {
+    auto acceptor = std::make_unique<Acceptor>();
+
+    auto toClient = std::make_shared<LoopbackPipe>(*worker_.getEventBase());
+    auto toServer = std::make_shared<LoopbackPipe>(acceptor->eventBase());
+    connection_ = std::make_unique<LoopbackConnection>(toClient, toServer);
+    acceptor->setConnection(
+        std::make_unique<LoopbackConnection>(toServer, toClient));
+
+    server_ = std::make_unique<RSocketServer>(std::move(acceptor));
+    server_->start([responder](const SetupParameters&) { return responder; });
+  }
+
+  folly::Future<ConnectedDuplexConnection> connect() override {
+    return folly::via(worker_.getEventBase(), [this] {
+      return ConnectedDuplexConnection{std::move(connection_),
+                                       *worker_.getEventBase()};
+    });
+  }
+
+ private:
+  // The server goes first, while the client's worker still runs.
+  folly::ScopedEventBaseThread worker_;
+  std::unique_ptr<DuplexConnection> connection_;
+  std::unique_ptr<RSocketServer> server_;
+};
+}
+
+MemoryFixture::MemoryFixture(std::shared_ptr<RSocketResponder> responder) {
+  auto factory = std::make_unique<Factory>(std::move(responder));
+  client = RSocket::createConnectedClient(std::move(factory)).get();
+}
+}
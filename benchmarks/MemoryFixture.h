@@ -0,0 +1,23 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketResponder.h"
+
+#include <memory>
+
+namespace rsocket {
+
+/// Benchmarks fixture object that contains a server and a single client,
+/// connected to each other through memory.
+///
+/// The connection hands the frames over between the EventBases of the client
+/// and the server without any socket, so the benchmarks only measure the cost
+/// of the state machines, the frame serialization and yarpl.
+struct MemoryFixture {
+  explicit MemoryFixture(std::shared_ptr<RSocketResponder>);
+
+  std::shared_ptr<RSocketClient> client;
+};
+}
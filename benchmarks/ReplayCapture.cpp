@@ -0,0 +1,284 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Results.h"
+#include "benchmarks/Throughput.h"
+
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include <folly/Baton.h>
+#include <folly/Benchmark.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/framing/FrameCapture.h"
+
+using namespace rsocket;
+
+DEFINE_string(capture, "", "capture file to replay, see FrameCapture.h");
+DEFINE_bool(
+    recorded_speed,
+    false,
+    "replay the frames as far apart as they were recorded, instead of as fast "
+    "as the server takes them");
+DEFINE_int32(response_size, 64, "bytes of each payload the responder sends");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Payloads of the requests and responses, as fast as they are requested.
+class ReplayResponder : public FixedResponder {
+ public:
+  ReplayResponder() : FixedResponder(std::string(FLAGS_response_size, 'a')) {}
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>>,
+      StreamId streamId) override {
+    return handleRequestStream(std::move(request), streamId);
+  }
+};
+
+/// The records of a capture on their way to the input of the connection, on
+/// its EventBase.  Each record is only handed over once the previous one has
+/// been taken, so that those left when the input cancels, e.g. after the
+/// SETUP, wait for the next input.
+class Replay : public std::enable_shared_from_this<Replay> {
+ public:
+  Replay(
+      std::vector<FrameCaptureReader::Record> records,
+      folly::EventBase& eventBase,
+      bool recordedSpeed)
+      : records_{std::move(records)},
+        eventBase_{eventBase},
+        recordedSpeed_{recordedSpeed} {}
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber> input) {
+    input_ = std::move(input);
+    schedule();
+  }
+
+  void cancelInput() {
+    input_ = nullptr;
+  }
+
+  void onWritten(const folly::IOBuf& frame) {
+    ++framesWritten_;
+    bytesWritten_ += frame.computeChainDataLength();
+  }
+
+  /// Posted once all the records were handed over.
+  folly::Baton<>& done() {
+    return done_;
+  }
+
+  size_t bytesRead() const {
+    return bytesRead_;
+  }
+
+  size_t framesWritten() const {
+    return framesWritten_;
+  }
+
+  size_t bytesWritten() const {
+    return bytesWritten_;
+  }
+
+ private:
+  void schedule() {
+    if (scheduled_) {
+      return;
+    }
+    scheduled_ = true;
+    eventBase_.runInEventBaseThread(
+        [self = shared_from_this()] { self->deliver(); });
+  }
+
+  void deliver() {
+    scheduled_ = false;
+    if (!started_) {
+      started_ = true;
+      start_ = Clock::now();
+    }
+    while (input_ && next_ < records_.size()) {
+      auto& record = records_[next_];
+      if (recordedSpeed_) {
+        dueAt_ += record.delay;
+        auto const due = start_ + dueAt_;
+        auto const now = Clock::now();
+        if (due > now) {
+          dueAt_ -= record.delay;
+          scheduled_ = true;
+          eventBase_.runAfterDelay(
+              [self = shared_from_this()] { self->deliver(); },
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  due - now)
+                  .count());
+          return;
+        }
+      }
+      ++next_;
+      bytesRead_ += record.bytes->computeChainDataLength();
+      input_->onNext(std::move(record.bytes));
+    }
+    if (input_ && next_ == records_.size()) {
+      auto input = std::move(input_);
+      input->onComplete();
+      done_.post();
+    }
+  }
+
+  std::vector<FrameCaptureReader::Record> records_;
+  folly::EventBase& eventBase_;
+  const bool recordedSpeed_;
+  folly::Baton<> done_;
+
+  // Only accessed on the EventBase.
+  yarpl::Reference<DuplexConnection::Subscriber> input_;
+  size_t next_{0};
+  bool scheduled_{false};
+  bool started_{false};
+  Clock::time_point start_;
+  std::chrono::microseconds dueAt_{0};
+  size_t bytesRead_{0};
+  size_t framesWritten_{0};
+  size_t bytesWritten_{0};
+};
+
+class ReplayInputSubscription : public yarpl::flowable::Subscription {
+ public:
+  explicit ReplayInputSubscription(std::shared_ptr<Replay> replay)
+      : replay_{std::move(replay)} {}
+
+  void request(int64_t) override {}
+
+  void cancel() override {
+    if (auto replay = std::move(replay_)) {
+      replay->cancelInput();
+    }
+  }
+
+ private:
+  std::shared_ptr<Replay> replay_;
+};
+
+/// Drops the frames the server writes, counting them.
+class ReplayOutputSubscriber : public DuplexConnection::Subscriber {
+ public:
+  explicit ReplayOutputSubscriber(std::shared_ptr<Replay> replay)
+      : replay_{std::move(replay)} {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+    subscription_ = std::move(subscription);
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    replay_->onWritten(*frame);
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+  }
+
+  void onError(folly::exception_wrapper) override {
+    subscription_ = nullptr;
+  }
+
+ private:
+  const std::shared_ptr<Replay> replay_;
+  yarpl::Reference<yarpl::flowable::Subscription> subscription_;
+};
+
+/// Reads the records of a capture, as the connection it was recorded on
+/// would have.
+class ReplayConnection : public DuplexConnection {
+ public:
+  ReplayConnection(std::shared_ptr<Replay> replay, bool framed)
+      : replay_{std::move(replay)}, framed_{framed} {}
+
+  ~ReplayConnection() {
+    replay_->cancelInput();
+  }
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber> input) override {
+    input->onSubscribe(yarpl::make_ref<ReplayInputSubscription>(replay_));
+    replay_->setInput(std::move(input));
+  }
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override {
+    return yarpl::make_ref<ReplayOutputSubscriber>(replay_);
+  }
+
+  bool isFramed() const override {
+    return framed_;
+  }
+
+ private:
+  const std::shared_ptr<Replay> replay_;
+  const bool framed_;
+};
+} // namespace
+
+BENCHMARK(ReplayCapture, n) {
+  (void)n;
+
+  std::shared_ptr<Replay> replay;
+  std::unique_ptr<ReplayConnection> connection;
+  folly::ScopedEventBaseThread worker;
+  size_t records = 0;
+
+  BENCHMARK_SUSPEND {
+    CHECK(!FLAGS_capture.empty()) << "--capture is required";
+    FrameCaptureReader reader(FLAGS_capture);
+    std::vector<FrameCaptureReader::Record> recorded;
+    while (auto record = reader.next()) {
+      recorded.push_back(std::move(*record));
+    }
+    records = recorded.size();
+    replay = std::make_shared<Replay>(
+        std::move(recorded), *worker.getEventBase(), FLAGS_recorded_speed);
+    connection = std::make_unique<ReplayConnection>(replay, reader.framed());
+
+    LOG(INFO) << "Replaying " << records << " "
+              << (reader.framed() ? "frames" : "reads") << " of "
+              << FLAGS_capture
+              << (FLAGS_recorded_speed ? " at the recorded speed"
+                                       : " at full speed");
+  }
+
+  auto responder = std::make_shared<ReplayResponder>();
+  RSocketServer server(nullptr);
+
+  ResultRecord record{"ReplayCapture"};
+  worker.getEventBase()->runInEventBaseThreadAndWait([&] {
+    // The reads of unframed connections go through a FramedReader.
+    server.acceptConnection(
+        std::move(connection),
+        *worker.getEventBase(),
+        RSocketServiceHandler::create(
+            [responder](const SetupParameters&) { return responder; }));
+  });
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!replay->done().timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+    return;
+  }
+  // Let the server handle what the last records started.
+  worker.getEventBase()->runInEventBaseThreadAndWait([] {});
+  record.stop();
+  record.items(records);
+  record.throughput("records_per_s", records / record.seconds());
+  record.throughput("bytes_read_per_s", replay->bytesRead() / record.seconds());
+  record.metric("frames_written", replay->framesWritten());
+  record.metric("bytes_written", replay->bytesWritten());
+
+  BENCHMARK_SUSPEND {
+    server.shutdownAndWait();
+  }
+}
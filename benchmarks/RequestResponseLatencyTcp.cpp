@@ -0,0 +1,234 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Fixture.h"
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Latch.h"
+#include "benchmarks/Results.h"
+#include "benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(
+    override_client_threads,
+    0,
+    "control the number of client threads (defaults to the number of clients)");
+DEFINE_int32(clients, 10, "number of clients to run");
+DEFINE_int32(
+    items,
+    100000,
+    "number of request-response requests to send, in total");
+DEFINE_int32(rate, 1000, "requests per second sent by each client");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Sends requests from one client at a fixed rate, whether or not the previous
+/// ones have been answered yet, and records how long each took.
+///
+/// Latency is recorded twice.  The corrected histogram measures from the time
+/// a request was scheduled to be sent, so stalls of the client (which delay
+/// the requests queued behind them) are accounted for, instead of being
+/// hidden by coordinated omission.  The uncorrected histogram measures from
+/// the time the request was actually sent.
+class OpenLoopClient {
+ public:
+  OpenLoopClient(
+      folly::EventBase& eventBase,
+      RSocketRequester& requester,
+      std::chrono::nanoseconds interval,
+      size_t requests,
+      Latch& latch)
+      : eventBase_{eventBase},
+        requester_{requester},
+        interval_{interval},
+        requests_{requests},
+        latch_{latch} {}
+
+  void start() {
+    eventBase_.runInEventBaseThread([this] {
+      start_ = Clock::now();
+      sendDue();
+    });
+  }
+
+  const LatencyHistogram& corrected() const {
+    return corrected_;
+  }
+
+  const LatencyHistogram& uncorrected() const {
+    return uncorrected_;
+  }
+
+  size_t errors() const {
+    return errors_;
+  }
+
+ private:
+  class Observer : public yarpl::single::SingleObserverBase<Payload> {
+   public:
+    Observer(
+        OpenLoopClient& client,
+        Clock::time_point scheduled,
+        Clock::time_point sent)
+        : client_{client}, scheduled_{scheduled}, sent_{sent} {}
+
+    void onSuccess(Payload) override {
+      client_.onResponse(scheduled_, sent_);
+      yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+    }
+
+    void onError(folly::exception_wrapper) override {
+      client_.onError();
+      yarpl::single::SingleObserverBase<Payload>::onError({});
+    }
+
+   private:
+    OpenLoopClient& client_;
+    const Clock::time_point scheduled_;
+    const Clock::time_point sent_;
+  };
+
+  /// Sends every request whose time has come, then checks again in a
+  /// millisecond.
+  void sendDue() {
+    while (sent_ < requests_) {
+      auto const scheduled = start_ + interval_ * static_cast<int64_t>(sent_);
+      auto const now = Clock::now();
+      if (scheduled > now) {
+        break;
+      }
+      ++sent_;
+      requester_.requestResponse(Payload("RequestResponseTcp"))
+          ->subscribe(yarpl::make_ref<Observer>(*this, scheduled, now));
+    }
+
+    if (sent_ < requests_) {
+      eventBase_.runAfterDelay([this] { sendDue(); }, 1);
+    }
+  }
+
+  void onResponse(Clock::time_point scheduled, Clock::time_point sent) {
+    auto const now = Clock::now();
+    corrected_.record(now - scheduled);
+    uncorrected_.record(now - sent);
+    latch_.post();
+  }
+
+  void onError() {
+    ++errors_;
+    latch_.post();
+  }
+
+  folly::EventBase& eventBase_;
+  RSocketRequester& requester_;
+  const std::chrono::nanoseconds interval_;
+  const size_t requests_;
+  Latch& latch_;
+
+  Clock::time_point start_;
+  size_t sent_{0};
+  size_t errors_{0};
+  LatencyHistogram corrected_;
+  LatencyHistogram uncorrected_;
+};
+
+void report(const char* name, const LatencyHistogram& histogram) {
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  LOG(INFO) << name << " latency (us) over " << histogram.count()
+            << " requests: p50=" << us(histogram.percentile(50))
+            << " p90=" << us(histogram.percentile(90))
+            << " p99=" << us(histogram.percentile(99))
+            << " p99.9=" << us(histogram.percentile(99.9))
+            << " max=" << us(histogram.max())
+            << " mean=" << us(histogram.mean());
+}
+}
+
+BENCHMARK(RequestResponseLatency, n) {
+  (void)n;
+
+  std::vector<std::unique_ptr<OpenLoopClient>> loadClients;
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+
+  auto const perClient =
+      static_cast<size_t>(FLAGS_items / std::max(FLAGS_clients, 1));
+  Latch latch{perClient * static_cast<size_t>(FLAGS_clients)};
+
+  BENCHMARK_SUSPEND {
+    auto responder =
+        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a'));
+
+    opts.serverThreads = FLAGS_server_threads;
+    opts.clients = FLAGS_clients;
+    if (FLAGS_override_client_threads > 0) {
+      opts.clientThreads = FLAGS_override_client_threads;
+    }
+
+    fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+    auto const interval = std::chrono::nanoseconds{std::chrono::seconds(1)} /
+        std::max(FLAGS_rate, 1);
+    for (size_t i = 0; i < opts.clients; ++i) {
+      loadClients.push_back(std::make_unique<OpenLoopClient>(
+          *fixture->clientEventBases[i],
+          *fixture->clients[i]->getRequester(),
+          interval,
+          perClient,
+          latch));
+    }
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+    LOG(INFO) << "  " << opts.clients << " clients across "
+              << fixture->workers.size() << " threads.";
+    LOG(INFO) << "  Running " << perClient << " requests per client at "
+              << FLAGS_rate << " requests/s each";
+  }
+
+  ResultRecord record{"RequestResponseLatency"};
+  for (auto& client : loadClients) {
+    client->start();
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+  record.stop();
+
+  BENCHMARK_SUSPEND {
+    // Stop the clients before reading their histograms.
+    fixture.reset();
+
+    LatencyHistogram corrected;
+    LatencyHistogram uncorrected;
+    size_t errors = 0;
+    for (auto& client : loadClients) {
+      corrected.merge(client->corrected());
+      uncorrected.merge(client->uncorrected());
+      errors += client->errors();
+    }
+    report("Corrected", corrected);
+    report("Uncorrected", uncorrected);
+    record.latency("corrected", corrected);
+    record.latency("uncorrected", uncorrected);
+    record.items(corrected.count());
+    record.throughput("responses_per_s", corrected.count() / record.seconds());
+    if (errors > 0) {
+      LOG(ERROR) << errors << " requests failed";
+    }
+  }
+}
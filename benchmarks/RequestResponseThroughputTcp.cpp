@@ -2,6 +2,7 @@
 
 #include "benchmarks/Fixture.h"
 #include "benchmarks/Latch.h"
+#include "benchmarks/Results.h"
 #include "benchmarks/Throughput.h"
 
 #include <folly/Benchmark.h>
@@ -80,6 +81,7 @@ BENCHMARK(RequestResponseThroughput, n) {
     LOG(INFO) << "  Running " << FLAGS_items << " requests in total";
   }
 
+  ResultRecord record{"RequestResponseThroughput"};
   for (int i = 0; i < FLAGS_items; ++i) {
     auto& client = fixture->clients[i % opts.clients];
     client->getRequester()
@@ -90,5 +92,9 @@ BENCHMARK(RequestResponseThroughput, n) {
   constexpr std::chrono::minutes timeout{5};
   if (!latch.timed_wait(timeout)) {
     LOG(ERROR) << "Timed out!";
+    return;
   }
+  record.stop();
+  record.items(FLAGS_items);
+  record.throughput("requests_per_s", FLAGS_items / record.seconds());
 }
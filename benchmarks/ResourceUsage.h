@@ -0,0 +1,37 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <fstream>
+
+/// Resident set size of the process in bytes, from /proc/self/statm.  Returns
+/// 0 where that isn't available.
+inline size_t residentBytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  if (!(statm >> pages >> resident)) {
+    return 0;
+  }
+  return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+/// Context switches of all the threads of the process so far.
+struct ContextSwitches {
+  /// The thread blocked, e.g. waiting for a task or for the socket.
+  long voluntary{0};
+  /// The thread was preempted.
+  long involuntary{0};
+};
+
+inline ContextSwitches contextSwitches() {
+  rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return ContextSwitches();
+  }
+  return ContextSwitches{usage.ru_nvcsw, usage.ru_nivcsw};
+}
@@ -0,0 +1,505 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Fixture.h"
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Latch.h"
+#include "benchmarks/ResourceUsage.h"
+#include "benchmarks/Results.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(clients, 4, "number of clients to run");
+DEFINE_int32(
+    items,
+    20000,
+    "number of requests to send for each mode and interaction, in total");
+DEFINE_int32(outstanding, 32, "requests each client keeps in flight");
+DEFINE_int32(
+    stream_items,
+    10,
+    "payloads of each stream, and of each channel in both directions");
+DEFINE_int32(
+    work_us,
+    0,
+    "time the responder spins for each request, as the work of an "
+    "application");
+DEFINE_string(
+    modes,
+    "scheduled,single_threaded,executor",
+    "dispatch modes of the responder to run");
+DEFINE_string(
+    executor_threads,
+    "1,4,16",
+    "sizes of the ResponderExecutor to run the executor mode with");
+DEFINE_string(
+    interactions,
+    "request_response,fire_and_forget,stream,channel",
+    "interactions to run");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// How the server calls its responder.
+struct Dispatch {
+  std::string name;
+  bool singleThreaded{false};
+  /// Threads of the ResponderExecutor, 0 for none.
+  size_t executorThreads{0};
+};
+
+std::vector<Dispatch> dispatches() {
+  std::vector<std::string> modes;
+  folly::split(',', FLAGS_modes, modes, true);
+  std::vector<Dispatch> result;
+  for (auto& mode : modes) {
+    if (mode == "scheduled") {
+      result.push_back(Dispatch{mode, false, 0});
+    } else if (mode == "single_threaded") {
+      result.push_back(Dispatch{mode, true, 0});
+    } else if (mode == "executor") {
+      std::vector<std::string> sizes;
+      folly::split(',', FLAGS_executor_threads, sizes, true);
+      for (auto& size : sizes) {
+        result.push_back(
+            Dispatch{mode + "_" + size, false, folly::to<size_t>(size)});
+      }
+    } else {
+      throw std::invalid_argument("unknown dispatch mode " + mode);
+    }
+  }
+  return result;
+}
+
+enum class Interaction {
+  REQUEST_RESPONSE,
+  FIRE_AND_FORGET,
+  STREAM,
+  CHANNEL,
+};
+
+Interaction parseInteraction(const std::string& name) {
+  if (name == "request_response") {
+    return Interaction::REQUEST_RESPONSE;
+  }
+  if (name == "fire_and_forget") {
+    return Interaction::FIRE_AND_FORGET;
+  }
+  if (name == "stream") {
+    return Interaction::STREAM;
+  }
+  if (name == "channel") {
+    return Interaction::CHANNEL;
+  }
+  throw std::invalid_argument("unknown interaction " + name);
+}
+
+/// Spins for --work_us.
+void work() {
+  if (FLAGS_work_us <= 0) {
+    return;
+  }
+  auto const until = Clock::now() + std::chrono::microseconds(FLAGS_work_us);
+  while (Clock::now() < until) {
+  }
+}
+
+/// Metadata of a fire-and-forget: the client which sent it and when, so that
+/// the responder tells the client once it is handled.
+std::unique_ptr<folly::IOBuf> fireAndForgetMetadata(
+    uint32_t client,
+    Clock::time_point sent) {
+  auto metadata = folly::IOBuf::create(sizeof(uint32_t) + sizeof(int64_t));
+  folly::io::Appender appender(metadata.get(), 0);
+  appender.writeBE(client);
+  appender.writeBE<int64_t>(sent.time_since_epoch().count());
+  return metadata;
+}
+
+/// Answers each request after --work_us, on whichever thread the dispatch
+/// mode calls it.
+class DispatchResponder : public RSocketResponder {
+ public:
+  using OnFireAndForget = std::function<void(uint32_t, Clock::time_point)>;
+
+  DispatchResponder()
+      : message_{folly::IOBuf::copyBuffer(std::string(kMessageLen, 'a'))} {}
+
+  /// Called with the metadata of each fire-and-forget once it is handled.
+  /// Set before the clients send any.
+  void setOnFireAndForget(OnFireAndForget onFireAndForget) {
+    onFireAndForget_ = std::move(onFireAndForget);
+  }
+
+  yarpl::Reference<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload,
+      StreamId) override {
+    work();
+    return yarpl::single::Singles::fromGenerator<Payload>(
+        [msg = message_->clone()] { return Payload(msg->clone()); });
+  }
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload,
+      StreamId) override {
+    work();
+    return yarpl::flowable::Flowables::fromGenerator<Payload>(
+        [msg = message_->clone()] { return Payload(msg->clone()); });
+  }
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requests,
+      StreamId) override {
+    work();
+    return requests->map(
+        [msg = message_->clone()](Payload) { return Payload(msg->clone()); });
+  }
+
+  void handleFireAndForget(Payload request, StreamId) override {
+    work();
+    folly::io::Cursor cursor(request.metadata.get());
+    auto const client = cursor.readBE<uint32_t>();
+    auto const sent =
+        Clock::time_point(Clock::duration(cursor.readBE<int64_t>()));
+    onFireAndForget_(client, sent);
+  }
+
+ private:
+  const std::unique_ptr<folly::IOBuf> message_;
+  OnFireAndForget onFireAndForget_;
+};
+
+/// Keeps --outstanding requests of one interaction in flight on one client,
+/// sending the next as soon as one is done, and records how long each took
+/// until its last response.  A fire-and-forget is done once the responder
+/// handled it.
+///
+/// Everything runs on the EventBase of the client.
+class ClosedLoopClient {
+ public:
+  ClosedLoopClient(
+      uint32_t index,
+      folly::EventBase& eventBase,
+      RSocketRequester& requester,
+      Interaction interaction,
+      size_t requests,
+      Latch& latch)
+      : index_{index},
+        eventBase_{eventBase},
+        requester_{requester},
+        interaction_{interaction},
+        requests_{requests},
+        latch_{latch},
+        message_{folly::IOBuf::copyBuffer(std::string(kMessageLen, 'a'))} {}
+
+  void start() {
+    eventBase_.runInEventBaseThread([this] {
+      auto const window =
+          std::min<size_t>(std::max(FLAGS_outstanding, 1), requests_);
+      for (size_t i = 0; i < window; ++i) {
+        send();
+      }
+    });
+  }
+
+  /// Called by the responder, on any thread.
+  void onFireAndForgetHandled(Clock::time_point sent) {
+    eventBase_.runInEventBaseThread([this, sent] { onDone(sent); });
+  }
+
+  const LatencyHistogram& latency() const {
+    return latency_;
+  }
+
+  size_t errors() const {
+    return errors_;
+  }
+
+ private:
+  class Observer : public yarpl::single::SingleObserverBase<Payload> {
+   public:
+    Observer(ClosedLoopClient& client, Clock::time_point sent)
+        : client_{client}, sent_{sent} {}
+
+    void onSuccess(Payload) override {
+      client_.onDone(sent_);
+      yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+    }
+
+    void onError(folly::exception_wrapper) override {
+      client_.onError();
+      yarpl::single::SingleObserverBase<Payload>::onError({});
+    }
+
+   private:
+    ClosedLoopClient& client_;
+    const Clock::time_point sent_;
+  };
+
+  /// Counts the fire-and-forgets which couldn't be sent, they are done then.
+  class FireAndForgetObserver : public yarpl::single::SingleObserverBase<void> {
+   public:
+    explicit FireAndForgetObserver(ClosedLoopClient& client)
+        : client_{client} {}
+
+    void onError(folly::exception_wrapper) override {
+      client_.onError();
+      yarpl::single::SingleObserverBase<void>::onError({});
+    }
+
+   private:
+    ClosedLoopClient& client_;
+  };
+
+  /// Observes a stream or a channel until --stream_items responses arrived.
+  class Subscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+   public:
+    Subscriber(ClosedLoopClient& client, size_t items, Clock::time_point sent)
+        : client_{client}, items_{items}, sent_{sent} {}
+
+   private:
+    void onSubscribeImpl() override {
+      this->request(items_);
+    }
+
+    void onNextImpl(Payload) override {
+      if (++received_ == items_) {
+        terminate(false);
+        // After this cancel we could be destroyed.
+        this->cancel();
+      }
+    }
+
+    void onCompleteImpl() override {
+      terminate(false);
+    }
+
+    void onErrorImpl(folly::exception_wrapper) override {
+      terminate(true);
+    }
+
+    void terminate(bool error) {
+      if (terminated_) {
+        return;
+      }
+      terminated_ = true;
+      if (error) {
+        client_.onError();
+      } else {
+        client_.onDone(sent_);
+      }
+    }
+
+    ClosedLoopClient& client_;
+    const size_t items_;
+    const Clock::time_point sent_;
+    size_t received_{0};
+    bool terminated_{false};
+  };
+
+  void send() {
+    if (sent_ == requests_) {
+      return;
+    }
+    ++sent_;
+    auto const now = Clock::now();
+    auto const items = static_cast<size_t>(std::max(FLAGS_stream_items, 1));
+    switch (interaction_) {
+      case Interaction::REQUEST_RESPONSE:
+        requester_.requestResponse(Payload(message_->clone()))
+            ->subscribe(yarpl::make_ref<Observer>(*this, now));
+        break;
+      case Interaction::FIRE_AND_FORGET:
+        requester_
+            .fireAndForget(Payload(
+                message_->clone(), fireAndForgetMetadata(index_, now)))
+            ->subscribe(yarpl::make_ref<FireAndForgetObserver>(*this));
+        break;
+      case Interaction::STREAM:
+        requester_.requestStream(Payload(message_->clone()))
+            ->subscribe(yarpl::make_ref<Subscriber>(*this, items, now));
+        break;
+      case Interaction::CHANNEL: {
+        // The first payload is the initial request of the channel, the
+        // responder answers the ones after it.
+        auto requests = yarpl::flowable::Flowables::fromGenerator<Payload>(
+                            [msg = message_->clone()] {
+                              return Payload(msg->clone());
+                            })
+                            ->take(static_cast<int64_t>(items) + 1);
+        requester_.requestChannel(std::move(requests))
+            ->subscribe(yarpl::make_ref<Subscriber>(*this, items, now));
+        break;
+      }
+    }
+  }
+
+  void onDone(Clock::time_point sent) {
+    latency_.record(Clock::now() - sent);
+    latch_.post();
+    send();
+  }
+
+  void onError() {
+    ++errors_;
+    latch_.post();
+    send();
+  }
+
+  const uint32_t index_;
+  folly::EventBase& eventBase_;
+  RSocketRequester& requester_;
+  const Interaction interaction_;
+  const size_t requests_;
+  Latch& latch_;
+  const std::unique_ptr<folly::IOBuf> message_;
+
+  size_t sent_{0};
+  size_t errors_{0};
+  LatencyHistogram latency_;
+};
+
+/// Runs `interaction` against a server dispatching as `dispatch`, and records
+/// it as ResponderDispatch/<dispatch>/<interaction>.
+void run(
+    const Dispatch& dispatch,
+    const std::string& interactionName,
+    Fixture& fixture,
+    DispatchResponder& responder) {
+  auto const interaction = parseInteraction(interactionName);
+  auto const perClient = static_cast<size_t>(
+      FLAGS_items / std::max<size_t>(fixture.clients.size(), 1));
+  Latch latch{perClient * fixture.clients.size()};
+
+  std::vector<std::unique_ptr<ClosedLoopClient>> loadClients;
+  for (size_t i = 0; i < fixture.clients.size(); ++i) {
+    loadClients.push_back(std::make_unique<ClosedLoopClient>(
+        static_cast<uint32_t>(i),
+        *fixture.clientEventBases[i],
+        *fixture.clients[i]->getRequester(),
+        interaction,
+        perClient,
+        latch));
+  }
+  responder.setOnFireAndForget(
+      [&loadClients](uint32_t client, Clock::time_point sent) {
+        loadClients[client]->onFireAndForgetHandled(sent);
+      });
+
+  auto const name = dispatch.name + "/" + interactionName;
+  auto const switchesBefore = contextSwitches();
+  ResultRecord record{"ResponderDispatch/" + name};
+  for (auto& client : loadClients) {
+    client->start();
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << name << " timed out!";
+  }
+  record.stop();
+  auto const switchesAfter = contextSwitches();
+
+  // Let the clients go idle before reading their figures.
+  for (auto* eventBase : fixture.clientEventBases) {
+    eventBase->runInEventBaseThreadAndWait([] {});
+  }
+
+  LatencyHistogram latency;
+  size_t errors = 0;
+  for (auto& client : loadClients) {
+    latency.merge(client->latency());
+    errors += client->errors();
+  }
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  auto const completed = std::max<uint64_t>(latency.count(), 1);
+  auto const voluntary = switchesAfter.voluntary - switchesBefore.voluntary;
+  auto const involuntary =
+      switchesAfter.involuntary - switchesBefore.involuntary;
+  LOG(INFO) << name << ": " << latency.count() / record.seconds()
+            << " requests/s, latency (us): p50=" << us(latency.percentile(50))
+            << " p90=" << us(latency.percentile(90))
+            << " p99=" << us(latency.percentile(99))
+            << " p99.9=" << us(latency.percentile(99.9))
+            << " max=" << us(latency.max())
+            << ", context switches per request: "
+            << static_cast<double>(voluntary) / completed << " voluntary, "
+            << static_cast<double>(involuntary) / completed << " involuntary";
+  if (errors > 0) {
+    LOG(ERROR) << name << ": " << errors << " requests failed";
+  }
+  record.throughput("requests_per_s", latency.count() / record.seconds());
+  record.latency("latency", latency);
+  record.metric(
+      "voluntary_switches_per_request",
+      static_cast<double>(voluntary) / completed);
+  record.metric(
+      "involuntary_switches_per_request",
+      static_cast<double>(involuntary) / completed);
+  record.metric("errors", errors);
+  record.items(latency.count());
+}
+}
+
+BENCHMARK(ResponderDispatch, n) {
+  (void)n;
+
+  std::vector<std::string> interactions;
+  folly::split(',', FLAGS_interactions, interactions, true);
+
+  for (auto const& dispatch : dispatches()) {
+    std::unique_ptr<Fixture> fixture;
+    std::shared_ptr<DispatchResponder> responder;
+
+    BENCHMARK_SUSPEND {
+      Fixture::Options opts;
+      opts.serverThreads = FLAGS_server_threads;
+      opts.clients = std::max(FLAGS_clients, 1);
+      opts.singleThreadedResponder = dispatch.singleThreaded;
+      if (dispatch.executorThreads > 0) {
+        ResponderExecutor::Options executorOptions;
+        executorOptions.numThreads = dispatch.executorThreads;
+        opts.responderExecutor =
+            std::make_shared<ResponderExecutor>(executorOptions);
+      }
+      responder = std::make_shared<DispatchResponder>();
+      fixture = std::make_unique<Fixture>(opts, responder);
+
+      LOG(INFO) << "Running " << dispatch.name << ":";
+      LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+      LOG(INFO) << "  " << opts.clients << " clients with "
+                << FLAGS_outstanding << " requests in flight each.";
+    }
+
+    for (auto const& interaction : interactions) {
+      run(dispatch, interaction, *fixture, *responder);
+    }
+
+    BENCHMARK_SUSPEND {
+      fixture.reset();
+    }
+  }
+}
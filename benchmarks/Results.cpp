@@ -0,0 +1,137 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/Results.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/json.h>
+#include <glog/logging.h>
+
+#include "benchmarks/ResourceUsage.h"
+
+DEFINE_string(
+    results_json,
+    "",
+    "append a JSON record of the results of each benchmark to this file");
+
+namespace rsocket {
+
+namespace {
+
+/// The flags defined by the benchmarks, with their values.
+folly::dynamic benchmarkFlags() {
+  std::vector<gflags::CommandLineFlagInfo> flags;
+  gflags::GetAllFlags(&flags);
+
+  auto result = folly::dynamic::object();
+  for (auto const& flag : flags) {
+    if (flag.filename.find("benchmarks/") == std::string::npos ||
+        flag.name == "results_json") {
+      continue;
+    }
+    if (flag.type == "bool") {
+      result[flag.name] = flag.current_value == "true";
+    } else if (flag.type == "double") {
+      result[flag.name] = folly::to<double>(flag.current_value);
+    } else if (flag.type == "string") {
+      result[flag.name] = flag.current_value;
+    } else {
+      result[flag.name] = folly::to<int64_t>(flag.current_value);
+    }
+  }
+  return result;
+}
+
+double microseconds(std::chrono::nanoseconds ns) {
+  return static_cast<double>(ns.count()) / 1000;
+}
+}
+
+ResultRecord::ResultRecord(std::string benchmark)
+    : benchmark_{std::move(benchmark)} {}
+
+ResultRecord::~ResultRecord() {
+  stop();
+  if (FLAGS_results_json.empty()) {
+    return;
+  }
+
+  try {
+    folly::dynamic record = folly::dynamic::object("benchmark", benchmark_)(
+        "flags", benchmarkFlags())("wall_seconds", *wallSeconds_)(
+        "cpu_seconds", cpuSeconds_)("resident_bytes", residentBytes_)(
+        "throughput", throughput_)("latency_us", latency_)(
+        "metrics", metrics_);
+    if (countingAllocations()) {
+      record["allocations"] = allocations_.allocations;
+      record["allocated_bytes"] = allocations_.bytes;
+      if (items_ && *items_ > 0) {
+        record["allocations_per_item"] =
+            static_cast<double>(allocations_.allocations) / *items_;
+        record["allocated_bytes_per_item"] =
+            static_cast<double>(allocations_.bytes) / *items_;
+      }
+    }
+
+    std::ofstream out(FLAGS_results_json, std::ios::app);
+    out << folly::toJson(record) << '\n';
+    if (!out) {
+      LOG(ERROR) << "Failed to write the results to " << FLAGS_results_json;
+    }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Failed to record the results of " << benchmark_ << ": "
+               << ex.what();
+  }
+}
+
+void ResultRecord::throughput(const std::string& name, double perSecond) {
+  throughput_[name] = perSecond;
+}
+
+void ResultRecord::latency(
+    const std::string& name,
+    const LatencyHistogram& histogram) {
+  latency_[name] = folly::dynamic::object("count", histogram.count())(
+      "p50", microseconds(histogram.percentile(50)))(
+      "p90", microseconds(histogram.percentile(90)))(
+      "p99", microseconds(histogram.percentile(99)))(
+      "p99.9", microseconds(histogram.percentile(99.9)))(
+      "max", microseconds(histogram.max()))(
+      "mean", microseconds(histogram.mean()));
+}
+
+void ResultRecord::metric(const std::string& name, double value) {
+  metrics_[name] = value;
+}
+
+void ResultRecord::items(size_t count) {
+  stop();
+  items_ = count;
+  if (countingAllocations()) {
+    auto const items = static_cast<double>(std::max<size_t>(count, 1));
+    LOG(INFO) << "  " << allocations_.allocations / items
+              << " allocations and " << allocations_.bytes / items
+              << " bytes allocated per item";
+  }
+}
+
+void ResultRecord::stop() {
+  if (wallSeconds_) {
+    return;
+  }
+  wallSeconds_ = seconds();
+  cpuSeconds_ = cpu_.seconds();
+  residentBytes_ = residentBytes();
+  allocations_ = allocationMeter_.sinceStart();
+}
+
+double ResultRecord::seconds() const {
+  if (wallSeconds_) {
+    return *wallSeconds_;
+  }
+  return std::chrono::duration<double>(Clock::now() - start_).count();
+}
+}
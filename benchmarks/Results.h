@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+#include <folly/portability/GFlags.h>
+
+#include "benchmarks/Allocations.h"
+#include "benchmarks/CpuMeter.h"
+#include "benchmarks/LatencyHistogram.h"
+
+DECLARE_string(results_json);
+
+namespace rsocket {
+
+/// The results of one run of a benchmark, appended as a line of JSON to the
+/// file named by --results_json when it's destroyed.  Nothing is written
+/// without the flag.
+///
+/// A record holds the name of the benchmark, the flags defined by the
+/// benchmarks, the wall time, CPU time and resident memory of the run, and the
+/// throughputs, latencies and other figures the benchmark adds.  In the build
+/// counting allocations, see Allocations.h, it holds the allocations of the
+/// run too.  The run lasts from the construction of the record to stop().
+/// compare-results diffs the records of two runs.
+class ResultRecord {
+ public:
+  explicit ResultRecord(std::string benchmark);
+  ~ResultRecord();
+
+  ResultRecord(const ResultRecord&) = delete;
+  ResultRecord& operator=(const ResultRecord&) = delete;
+
+  /// A rate in units per second, e.g. "msgs_per_s".  Higher is better.
+  void throughput(const std::string& name, double perSecond);
+
+  /// The percentiles of `histogram`, in microseconds.  Lower is better.
+  void latency(const std::string& name, const LatencyHistogram& histogram);
+
+  /// Any other figure, which isn't compared.
+  void metric(const std::string& name, double value);
+
+  /// The number of messages or requests of the run, which the allocations are
+  /// divided by.  Logs the allocations per item when they are counted.  Ends
+  /// the run, if it hasn't.
+  void items(size_t count);
+
+  /// Ends the run, e.g. before the fixture is torn down.  The destructor does
+  /// otherwise.
+  void stop();
+
+  /// Wall time in seconds from the construction to stop(), or to now.
+  double seconds() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  const std::string benchmark_;
+  const Clock::time_point start_{Clock::now()};
+  const CpuMeter cpu_;
+  const AllocationMeter allocationMeter_;
+
+  folly::Optional<double> wallSeconds_;
+  double cpuSeconds_{0};
+  size_t residentBytes_{0};
+  AllocationCount allocations_;
+  folly::Optional<size_t> items_;
+
+  folly::dynamic throughput_ = folly::dynamic::object;
+  folly::dynamic latency_ = folly::dynamic::object;
+  folly::dynamic metrics_ = folly::dynamic::object;
+};
+}
@@ -0,0 +1,321 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Results.h"
+#include "benchmarks/Throughput.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Synchronized.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/internal/ResumeBufferPool.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 1, "number of server threads to run");
+DEFINE_int32(message_len, 1024, "length of the streamed messages");
+DEFINE_int32(window, 1024, "number of messages the client keeps requested");
+DEFINE_int32(disconnects, 20, "number of times the transport is disconnected");
+DEFINE_int32(disconnect_ms, 250, "time the stream flows between disconnects");
+DEFINE_int32(
+    keepalive_ms,
+    1000,
+    "keepalive interval of the client, which acknowledges the position it "
+    "received up to");
+DEFINE_int32(
+    position_ack_bytes,
+    64 * 1024,
+    "how often the client acknowledges the position it received up to, in "
+    "bytes, 0 to only do so with keepalives");
+DEFINE_int32(
+    resume_buffer_pool_mb,
+    0,
+    "size of the resume buffer pool of the server, 0 for the default buffer "
+    "of each connection");
+DEFINE_bool(
+    resume_buffer_huge_pages,
+    false,
+    "carve the chunks of the resume buffer pool from huge pages");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Records what the server buffers and replays for resumption.
+class ResumeStats : public RSocketStats {
+ public:
+  void resumeBufferChanged(int, int dataSizeDelta) override {
+    auto const size = bufferBytes_ += dataSizeDelta;
+    auto peak = peakBufferBytes_.load();
+    while (size > peak && !peakBufferBytes_.compare_exchange_weak(peak, size)) {
+    }
+  }
+
+  void serverResume(
+      folly::Optional<int64_t>,
+      int64_t,
+      int64_t serverDelta,
+      ResumeOutcome outcome) override {
+    if (outcome == ResumeOutcome::SUCCESS) {
+      replayedBytes_ += serverDelta;
+    }
+  }
+
+  int64_t bufferBytes() const {
+    return bufferBytes_;
+  }
+
+  int64_t peakBufferBytes() const {
+    return peakBufferBytes_;
+  }
+
+  int64_t replayedBytes() const {
+    return replayedBytes_;
+  }
+
+ private:
+  std::atomic<int64_t> bufferBytes_{0};
+  std::atomic<int64_t> peakBufferBytes_{0};
+  std::atomic<int64_t> replayedBytes_{0};
+};
+
+/// Keeps the states of the connections, so that the clients can resume them.
+class ResumableServiceHandler : public RSocketServiceHandler {
+ public:
+  ResumableServiceHandler(
+      std::shared_ptr<RSocketResponder> responder,
+      std::shared_ptr<RSocketStats> stats)
+      : responder_{std::move(responder)}, stats_{std::move(stats)} {}
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    return RSocketConnectionParams(responder_, stats_);
+  }
+
+  void onNewRSocketState(
+      std::shared_ptr<RSocketServerState> state,
+      ResumeIdentificationToken token) override {
+    store_.lock()->insert({token, std::move(state)});
+  }
+
+  folly::Expected<std::shared_ptr<RSocketServerState>, RSocketException>
+  onResume(ResumeIdentificationToken token) override {
+    auto store = store_.lock();
+    auto it = store->find(token);
+    if (it == store->end()) {
+      return folly::makeUnexpected(RSocketException("Unknown resume token"));
+    }
+    return it->second;
+  }
+
+ private:
+  const std::shared_ptr<RSocketResponder> responder_;
+  const std::shared_ptr<RSocketStats> stats_;
+  folly::Synchronized<
+      std::map<ResumeIdentificationToken, std::shared_ptr<RSocketServerState>>,
+      std::mutex>
+      store_;
+};
+
+/// Keeps `window` messages requested and counts the ones received, until it
+/// is stopped.
+class CountingSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  explicit CountingSubscriber(size_t window)
+      : window_{std::max<size_t>(window, 2)} {}
+
+  void onSubscribeImpl() override {
+    this->request(window_);
+  }
+
+  void onNextImpl(Payload) override {
+    ++received_;
+    if (stopped_) {
+      this->cancel();
+      return;
+    }
+    if (++consumed_ == window_ / 2) {
+      consumed_ = 0;
+      this->request(window_ / 2);
+    }
+  }
+
+  void onCompleteImpl() override {}
+
+  void onErrorImpl(folly::exception_wrapper ew) override {
+    LOG(ERROR) << "Stream failed: " << ew.what();
+  }
+
+  /// Cancels the stream on the next message.
+  void stop() {
+    stopped_ = true;
+  }
+
+  size_t received() const {
+    return received_;
+  }
+
+ private:
+  const size_t window_;
+  size_t consumed_{0};
+  std::atomic<bool> stopped_{false};
+  std::atomic<size_t> received_{0};
+};
+
+void report(const LatencyHistogram& histogram) {
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  LOG(INFO) << "  Resume latency (us) over " << histogram.count()
+            << " resumptions: p50=" << us(histogram.percentile(50))
+            << " p90=" << us(histogram.percentile(90))
+            << " p99=" << us(histogram.percentile(99))
+            << " max=" << us(histogram.max())
+            << " mean=" << us(histogram.mean());
+}
+}
+
+/// Streams messages to a warm resumable client, measures the throughput for
+/// a while, then disconnects and resumes the transport every --disconnect_ms
+/// for as long again.
+///
+/// The resume latency runs from the disconnected client calling resume() to
+/// the server accepting the resumption.  The replayed bytes are the bytes the
+/// server sent again because the client hadn't received them, and the buffer
+/// bytes are the frames the server kept for resumption.  The throughput loss
+/// compares the messages received in the second period with the first.
+BENCHMARK(ResumeStress, n) {
+  (void)n;
+
+  folly::ScopedEventBaseThread worker;
+  std::shared_ptr<ResumeStats> stats;
+  std::unique_ptr<RSocketServer> server;
+  std::unique_ptr<RSocketClient> client;
+  yarpl::Reference<CountingSubscriber> subscriber;
+
+  BENCHMARK_SUSPEND {
+    stats = std::make_shared<ResumeStats>();
+
+    TcpConnectionAcceptor::Options opts;
+    opts.address = folly::SocketAddress{"0.0.0.0", 0};
+    opts.threads = FLAGS_server_threads;
+    server = RSocket::createServer(
+        std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+    if (FLAGS_resume_buffer_pool_mb > 0) {
+      server->setResumeBufferPool(std::make_shared<ResumeBufferPool>(
+          static_cast<size_t>(FLAGS_resume_buffer_pool_mb) * 1024 * 1024,
+          ResumeBufferPool::kDefaultChunkSize,
+          FLAGS_resume_buffer_huge_pages));
+    }
+    server->start(std::make_shared<ResumableServiceHandler>(
+        std::make_shared<FixedResponder>(std::string(FLAGS_message_len, 'a')),
+        stats));
+
+    SetupParameters setupParameters;
+    setupParameters.resumable = true;
+    setupParameters.positionAckBytes = FLAGS_position_ack_bytes;
+    client = RSocket::createConnectedClient(
+                 std::make_unique<TcpConnectionFactory>(
+                     *worker.getEventBase(),
+                     folly::SocketAddress{"127.0.0.1",
+                                          *server->listeningPort()}),
+                 std::move(setupParameters),
+                 std::make_shared<RSocketResponder>(),
+                 std::chrono::milliseconds(FLAGS_keepalive_ms))
+                 .get();
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << FLAGS_server_threads << " threads, "
+              << (FLAGS_resume_buffer_pool_mb > 0
+                      ? folly::to<std::string>(
+                            FLAGS_resume_buffer_pool_mb, "MB resume pool.")
+                      : std::string("default resume buffer."));
+    LOG(INFO) << "  Stream of " << FLAGS_message_len << "B messages, "
+              << FLAGS_window << " requested at a time.";
+    LOG(INFO) << "  Client acknowledging every " << FLAGS_position_ack_bytes
+              << " bytes and every " << FLAGS_keepalive_ms << "ms.";
+    LOG(INFO) << "  " << FLAGS_disconnects << " disconnects, every "
+              << FLAGS_disconnect_ms << "ms.";
+  }
+
+  ResultRecord record{"ResumeStress"};
+  subscriber = yarpl::make_ref<CountingSubscriber>(FLAGS_window);
+  client->getRequester()
+      ->requestStream(Payload("ResumeStressTcp"))
+      ->subscribe(subscriber);
+
+  auto const period =
+      std::chrono::milliseconds(FLAGS_disconnect_ms) * FLAGS_disconnects;
+
+  auto const baselineStart = subscriber->received();
+  std::this_thread::sleep_for(period);
+  auto const baseline = subscriber->received() - baselineStart;
+
+  LatencyHistogram latencies;
+  size_t failures = 0;
+  auto const stressStart = subscriber->received();
+  auto const start = Clock::now();
+  for (int i = 0; i < FLAGS_disconnects; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_disconnect_ms));
+    client->disconnect(std::runtime_error("ResumeStressTcp disconnect")).get();
+    auto const resuming = Clock::now();
+    try {
+      client->resume().get();
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Resumption failed: " << ex.what();
+      ++failures;
+      break;
+    }
+    latencies.record(Clock::now() - resuming);
+  }
+  auto const stressed = subscriber->received() - stressStart;
+  auto const scale =
+      std::chrono::duration<double>(period).count() /
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  subscriber->stop();
+  record.stop();
+
+  BENCHMARK_SUSPEND {
+    report(latencies);
+    LOG(INFO) << "  Replayed " << stats->replayedBytes() << " bytes, "
+              << stats->replayedBytes() /
+                 std::max<size_t>(latencies.count(), 1)
+              << " bytes per resumption";
+    LOG(INFO) << "  Resume buffer: " << stats->peakBufferBytes()
+              << " bytes at peak, " << stats->bufferBytes() << " at the end";
+    auto const seconds = std::chrono::duration<double>(period).count();
+    LOG(INFO) << "  Throughput: " << baseline / seconds
+              << " msgs/s without disconnects, " << stressed * scale / seconds
+              << " msgs/s with them";
+    if (baseline > 0) {
+      LOG(INFO) << "  Throughput loss: "
+                << 100 * (1 - stressed * scale / baseline) << "%";
+    }
+    if (failures > 0) {
+      LOG(ERROR) << failures << " resumptions failed";
+    }
+
+    record.items(baseline + stressed);
+    record.latency("resume", latencies);
+    record.throughput("baseline_msgs_per_s", baseline / seconds);
+    record.throughput("msgs_per_s", stressed * scale / seconds);
+    record.metric("replayed_bytes", stats->replayedBytes());
+    record.metric("peak_resume_buffer_bytes", stats->peakBufferBytes());
+    record.metric("resume_failures", failures);
+
+    client.reset();
+    server.reset();
+  }
+}
@@ -1,6 +1,7 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include "benchmarks/Fixture.h"
+#include "benchmarks/Results.h"
 #include "benchmarks/Throughput.h"
 
 #include <folly/Baton.h>
@@ -50,6 +51,7 @@ BENCHMARK(StreamThroughput, n) {
               << " streams of " << FLAGS_items << " items each.";
   }
 
+  ResultRecord record{"StreamThroughput"};
   for (size_t i = 0; i < FLAGS_streams; ++i) {
     for (auto& client : fixture->clients) {
       client->getRequester()
@@ -61,5 +63,11 @@ BENCHMARK(StreamThroughput, n) {
   constexpr std::chrono::minutes timeout{5};
   if (!latch.timed_wait(timeout)) {
     LOG(ERROR) << "Timed out!";
+    return;
   }
+  record.stop();
+  auto const items =
+      static_cast<size_t>(FLAGS_items) * FLAGS_streams * opts.clients;
+  record.items(items);
+  record.throughput("msgs_per_s", items / record.seconds());
 }
@@ -0,0 +1,144 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/TransportHarness.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "rsocket/transports/unix/UnixDomainConnectionAcceptor.h"
+#include "rsocket/transports/unix/UnixDomainConnectionFactory.h"
+#include "rsocket/transports/ws/WebSocketConnectionAcceptor.h"
+#include "rsocket/transports/ws/WebSocketConnectionFactory.h"
+
+#ifdef RSOCKET_QUIC
+#include "rsocket/transports/quic/QuicConnectionAcceptor.h"
+#include "rsocket/transports/quic/QuicConnectionFactory.h"
+#include "test/test_utils/QuicCertificate.h"
+#endif
+
+using namespace rsocket;
+
+DEFINE_string(
+    transports,
+    "tcp,unix,ws",
+    "transports to run, quic too when built with RSOCKET_QUIC");
+DEFINE_int32(server_threads, 2, "number of server threads to run");
+DEFINE_int32(frames, 200000, "frames sent one way for the throughput");
+DEFINE_int32(frame_size, 1024, "bytes of the frames of the throughput");
+DEFINE_int32(round_trips, 20000, "frames echoed for the latency");
+DEFINE_int32(connections, 500, "connections established at once");
+DEFINE_int32(large_frames, 16, "large frames echoed");
+DEFINE_int32(large_frame_kb, 8192, "size of the large frames");
+
+namespace {
+
+TcpConnectionAcceptor::Options tcpOptions() {
+  TcpConnectionAcceptor::Options options(0, FLAGS_server_threads);
+  options.address = folly::SocketAddress("127.0.0.1", 0);
+  options.backlog = std::max(FLAGS_connections, 10);
+  return options;
+}
+
+folly::SocketAddress listening(const ConnectionAcceptor& acceptor) {
+  return folly::SocketAddress("127.0.0.1", *acceptor.listeningPort());
+}
+
+/// The transports built in, to add a transport list it here.
+std::vector<TransportUnderTest> builtInTransports() {
+  std::vector<TransportUnderTest> transports;
+
+  transports.push_back(TransportUnderTest{
+      "tcp",
+      [] { return std::make_unique<TcpConnectionAcceptor>(tcpOptions()); },
+      [](const ConnectionAcceptor& acceptor, folly::EventBase& eventBase) {
+        return std::make_unique<TcpConnectionFactory>(
+            eventBase, listening(acceptor));
+      }});
+
+  // In the abstract namespace, there is no file to clean up.
+  auto const path = folly::to<std::string>(
+      std::string(1, '\0'), "rsocket-transport-comparison-", ::getpid());
+  transports.push_back(TransportUnderTest{
+      "unix",
+      [path] {
+        UnixDomainConnectionAcceptor::Options options(
+            path, FLAGS_server_threads, std::max(FLAGS_connections, 10));
+        return std::make_unique<UnixDomainConnectionAcceptor>(options);
+      },
+      [path](const ConnectionAcceptor&, folly::EventBase& eventBase) {
+        return std::make_unique<UnixDomainConnectionFactory>(eventBase, path);
+      }});
+
+  transports.push_back(TransportUnderTest{
+      "ws",
+      [] {
+        return std::make_unique<WebSocketConnectionAcceptor>(tcpOptions());
+      },
+      [](const ConnectionAcceptor& acceptor, folly::EventBase& eventBase) {
+        return std::make_unique<WebSocketConnectionFactory>(
+            eventBase, listening(acceptor));
+      }});
+
+#ifdef RSOCKET_QUIC
+  auto const certificate = std::make_shared<tests::QuicCertificate>();
+  transports.push_back(TransportUnderTest{
+      "quic",
+      [certificate] {
+        QuicConnectionAcceptor::Options options(0, FLAGS_server_threads);
+        options.address = folly::SocketAddress("127.0.0.1", 0);
+        return std::make_unique<QuicConnectionAcceptor>(
+            options, certificate->serverContext());
+      },
+      [certificate](
+          const ConnectionAcceptor& acceptor, folly::EventBase& eventBase) {
+        return std::make_unique<QuicConnectionFactory>(
+            eventBase,
+            listening(acceptor),
+            "localhost",
+            certificate->clientHandshakeFactory());
+      }});
+#endif
+
+  return transports;
+}
+}
+
+BENCHMARK(TransportComparison, n) {
+  (void)n;
+
+  TransportScenarioOptions options;
+  options.frames = FLAGS_frames;
+  options.frameSize = FLAGS_frame_size;
+  options.roundTrips = FLAGS_round_trips;
+  options.connections = FLAGS_connections;
+  options.largeFrames = FLAGS_large_frames;
+  options.largeFrameSize = static_cast<size_t>(FLAGS_large_frame_kb) * 1024;
+
+  std::vector<std::string> names;
+  folly::split(',', FLAGS_transports, names, true);
+  auto const transports = builtInTransports();
+  for (auto const& name : names) {
+    auto it = std::find_if(
+        transports.begin(),
+        transports.end(),
+        [&](const TransportUnderTest& transport) {
+          return transport.name == name;
+        });
+    if (it == transports.end()) {
+      LOG(ERROR) << "Unknown transport " << name;
+      continue;
+    }
+    runTransportScenarios(*it, options);
+  }
+}
@@ -0,0 +1,486 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "benchmarks/TransportHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <folly/Baton.h>
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <glog/logging.h>
+
+#include "benchmarks/LatencyHistogram.h"
+#include "benchmarks/Results.h"
+#include "rsocket/framing/FramedDuplexConnection.h"
+#include "yarpl/utils/credits.h"
+
+namespace rsocket {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::minutes kTimeout{5};
+
+/// The first byte of a frame tells the server what to do with it.
+enum class Kind : uint8_t {
+  /// Sent back as it is.
+  ECHO = 'E',
+  /// Dropped.
+  SINK = 'S',
+  /// Dropped, and acknowledged with an ACK frame of the same sequence number.
+  ACK = 'A',
+};
+
+/// The kind, then the sequence number of the frame on its connection.
+constexpr size_t kHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+struct Header {
+  Kind kind;
+  uint32_t sequence;
+};
+
+/// A frame of the header and `body`, which it shares.
+std::unique_ptr<folly::IOBuf>
+makeFrame(Kind kind, uint32_t sequence, const folly::IOBuf* body = nullptr) {
+  auto frame = folly::IOBuf::create(kHeaderSize);
+  folly::io::Appender appender(frame.get(), 0);
+  appender.write(static_cast<uint8_t>(kind));
+  appender.writeBE(sequence);
+  if (body) {
+    frame->prependChain(body->clone());
+  }
+  return frame;
+}
+
+/// The body of the frames of `size` bytes, header included.
+std::unique_ptr<folly::IOBuf> makeBody(size_t size) {
+  auto const length = size > kHeaderSize ? size - kHeaderSize : 0;
+  return folly::IOBuf::copyBuffer(std::string(length, 'x'));
+}
+
+folly::Optional<Header> parseHeader(const folly::IOBuf& frame) {
+  folly::io::Cursor cursor(&frame);
+  if (!cursor.canAdvance(kHeaderSize)) {
+    return folly::none;
+  }
+  Header header;
+  header.kind = static_cast<Kind>(cursor.read<uint8_t>());
+  header.sequence = cursor.readBE<uint32_t>();
+  return header;
+}
+
+/// One end of a connection.  Everything but the constructor runs on the
+/// EventBase of the connection.
+class Peer : public DuplexConnection::Subscriber {
+ public:
+  using OnFrame = std::function<void(Peer&, std::unique_ptr<folly::IOBuf>)>;
+
+  Peer(std::unique_ptr<DuplexConnection> connection, OnFrame onFrame)
+      : connection_{std::move(connection)}, onFrame_{std::move(onFrame)} {
+    if (!connection_->isFramed()) {
+      connection_ = std::make_unique<FramedDuplexConnection>(
+          std::move(connection_), ProtocolVersion::Current());
+    }
+  }
+
+  void start() {
+    connection_->setInput(this->ref_from_this(this));
+    output_ = connection_->getOutput();
+    output_->onSubscribe(yarpl::flowable::Subscription::empty());
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (output_) {
+      output_->onNext(std::move(frame));
+    }
+  }
+
+  /// Terminates the input and the output, and destroys the connection.
+  void close() {
+    if (auto output = std::move(output_)) {
+      output->onComplete();
+    }
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    connection_.reset();
+  }
+
+  /// The sequence number of the next frame expected from the other end.
+  uint32_t expected{0};
+
+ private:
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    subscription_ = std::move(subscription);
+    subscription_->request(yarpl::credits::kNoFlowControl);
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    onFrame_(*this, std::move(frame));
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+  }
+
+  void onError(folly::exception_wrapper) override {
+    subscription_ = nullptr;
+  }
+
+  std::unique_ptr<DuplexConnection> connection_;
+  const OnFrame onFrame_;
+  yarpl::Reference<DuplexConnection::Subscriber> output_;
+  yarpl::Reference<yarpl::flowable::Subscription> subscription_;
+};
+
+/// Checks that `header` is the next frame of `peer`, counts it in `errors`
+/// otherwise.
+template <typename Counter>
+void checkSequence(Peer& peer, const Header& header, Counter& errors) {
+  if (header.sequence != peer.expected) {
+    ++errors;
+  }
+  peer.expected = header.sequence + 1;
+}
+
+/// Accepts the connections of a transport and answers their frames according
+/// to their Kind.
+class Server {
+ public:
+  explicit Server(const TransportUnderTest& transport)
+      : acceptor_{transport.makeAcceptor()} {
+    acceptor_->start([this](
+                         std::unique_ptr<DuplexConnection> connection,
+                         folly::EventBase& eventBase) {
+      auto peer = yarpl::make_ref<Peer>(
+          std::move(connection),
+          [this](Peer& peer, std::unique_ptr<folly::IOBuf> frame) {
+            onFrame(peer, std::move(frame));
+          });
+      peer->start();
+      std::lock_guard<std::mutex> lock(mutex_);
+      peers_.emplace_back(std::move(peer), &eventBase);
+    });
+  }
+
+  ~Server() {
+    acceptor_->stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& peer : peers_) {
+      peer.second->runInEventBaseThreadAndWait(
+          [&peer] { peer.first->close(); });
+    }
+  }
+
+  const ConnectionAcceptor& acceptor() const {
+    return *acceptor_;
+  }
+
+  /// Frames which were cut or out of order.
+  size_t errors() const {
+    return errors_.load();
+  }
+
+ private:
+  void onFrame(Peer& peer, std::unique_ptr<folly::IOBuf> frame) {
+    auto const header = parseHeader(*frame);
+    if (!header) {
+      ++errors_;
+      return;
+    }
+    switch (header->kind) {
+      case Kind::ECHO:
+        peer.send(std::move(frame));
+        break;
+      case Kind::SINK:
+        checkSequence(peer, *header, errors_);
+        break;
+      case Kind::ACK:
+        checkSequence(peer, *header, errors_);
+        peer.send(makeFrame(Kind::ACK, header->sequence));
+        break;
+      default:
+        ++errors_;
+        break;
+    }
+  }
+
+  const std::unique_ptr<ConnectionAcceptor> acceptor_;
+  std::mutex mutex_;
+  std::vector<std::pair<yarpl::Reference<Peer>, folly::EventBase*>> peers_;
+  std::atomic<size_t> errors_{0};
+};
+
+/// Starts a Peer on a connection of a factory, on the EventBase of the
+/// connection.
+yarpl::Reference<Peer> startPeer(
+    ConnectionFactory::ConnectedDuplexConnection connected,
+    Peer::OnFrame onFrame) {
+  yarpl::Reference<Peer> peer;
+  connected.eventBase.runInEventBaseThreadAndWait([&] {
+    peer = yarpl::make_ref<Peer>(
+        std::move(connected.connection), std::move(onFrame));
+    peer->start();
+  });
+  return peer;
+}
+
+/// What a scenario measured, logged and recorded the same way for all.
+struct Measurement {
+  size_t frames{0};
+  size_t bytes{0};
+  size_t errors{0};
+  LatencyHistogram latency;
+};
+
+void report(
+    ResultRecord& record,
+    const std::string& name,
+    const Measurement& measurement) {
+  auto us = [](std::chrono::nanoseconds ns) {
+    return static_cast<double>(ns.count()) / 1000;
+  };
+  auto const seconds = record.seconds();
+  auto const& latency = measurement.latency;
+  LOG(INFO) << name << ": " << measurement.frames / seconds << " frames/s, "
+            << measurement.bytes / seconds / (1024 * 1024) << " MB/s";
+  record.throughput("frames_per_s", measurement.frames / seconds);
+  record.throughput("bytes_per_s", measurement.bytes / seconds);
+  if (latency.count() > 0) {
+    LOG(INFO) << "  latency (us): p50=" << us(latency.percentile(50))
+              << " p90=" << us(latency.percentile(90))
+              << " p99=" << us(latency.percentile(99))
+              << " p99.9=" << us(latency.percentile(99.9))
+              << " max=" << us(latency.max());
+    record.latency("latency", latency);
+  }
+  if (measurement.errors > 0) {
+    LOG(ERROR) << name << ": " << measurement.errors
+               << " frames were cut, out of order or missing";
+  }
+  record.metric("errors", measurement.errors);
+  record.items(measurement.frames);
+}
+
+/// The run of one scenario.  The frames are sent and received on the
+/// EventBase of the clients, the figures are read once done() was called.
+class Scenario {
+ public:
+  Scenario(
+      const std::string& transport,
+      const std::string& name,
+      const Server& server)
+      : name_{transport + "/" + name},
+        server_{server},
+        serverErrors_{server.errors()} {}
+
+  /// Starts the run, which lasts until done() is called.
+  void start() {
+    record_ = std::make_unique<ResultRecord>("Transport/" + name_);
+  }
+
+  void done() {
+    done_.post();
+  }
+
+  /// Waits for done(), then logs and records the run.
+  void finish() {
+    if (!done_.timed_wait(kTimeout)) {
+      LOG(ERROR) << name_ << " timed out!";
+      ++measurement.errors;
+    }
+    record_->stop();
+    measurement.errors += server_.errors() - serverErrors_;
+    report(*record_, name_, measurement);
+  }
+
+  Measurement measurement;
+
+ private:
+  const std::string name_;
+  const Server& server_;
+  const size_t serverErrors_;
+  std::unique_ptr<ResultRecord> record_;
+  folly::Baton<> done_;
+};
+
+/// Closes peers on their EventBase.
+void closePeers(
+    folly::EventBase& eventBase,
+    std::vector<yarpl::Reference<Peer>>& peers) {
+  eventBase.runInEventBaseThreadAndWait([&] {
+    for (auto& peer : peers) {
+      peer->close();
+    }
+    peers.clear();
+  });
+}
+
+/// Frames streamed to the server in batches, each acknowledged by the server
+/// on its last frame, with two batches in flight.
+void throughput(
+    Scenario& scenario,
+    ConnectionFactory& factory,
+    folly::EventBase& eventBase,
+    const TransportScenarioOptions& options) {
+  constexpr size_t kBatch = 256;
+  constexpr size_t kBatchesInFlight = 2;
+  auto const batches = std::max<size_t>(options.frames / kBatch, 1);
+  auto const body = makeBody(options.frameSize);
+  auto const frameBytes = kHeaderSize + body->computeChainDataLength();
+  uint32_t sequence = 0;
+  size_t batchesSent = 0;
+  size_t acked = 0;
+
+  auto sendBatch = [&](Peer& peer) {
+    if (batchesSent == batches) {
+      return;
+    }
+    ++batchesSent;
+    for (size_t i = 0; i < kBatch; ++i) {
+      auto const kind = i + 1 == kBatch ? Kind::ACK : Kind::SINK;
+      peer.send(makeFrame(kind, sequence++, body.get()));
+    }
+  };
+
+  std::vector<yarpl::Reference<Peer>> peers{startPeer(
+      factory.connect().get(),
+      [&](Peer& peer, std::unique_ptr<folly::IOBuf> frame) {
+        auto const header = parseHeader(*frame);
+        if (!header || header->kind != Kind::ACK ||
+            header->sequence + 1 != (acked + 1) * kBatch) {
+          ++scenario.measurement.errors;
+        }
+        scenario.measurement.frames += kBatch;
+        scenario.measurement.bytes += kBatch * frameBytes;
+        if (++acked == batches) {
+          scenario.done();
+          return;
+        }
+        sendBatch(peer);
+      })};
+
+  scenario.start();
+  eventBase.runInEventBaseThread([&] {
+    for (size_t i = 0; i < kBatchesInFlight; ++i) {
+      sendBatch(*peers.front());
+    }
+  });
+  scenario.finish();
+  closePeers(eventBase, peers);
+}
+
+/// Echoes a frame of `frameSize` bytes `count` times, one after the other,
+/// over each of `connections` connections.  Records the round trips.
+void echo(
+    Scenario& scenario,
+    ConnectionFactory& factory,
+    folly::EventBase& eventBase,
+    size_t connections,
+    size_t count,
+    size_t frameSize) {
+  auto const body = makeBody(frameSize);
+  auto const frameBytes = kHeaderSize + body->computeChainDataLength();
+  size_t remaining = connections;
+  std::vector<Clock::time_point> sent(connections);
+  std::vector<uint32_t> echoed(connections, 0);
+
+  auto const send = [&](Peer& peer, size_t index) {
+    sent[index] = Clock::now();
+    peer.send(makeFrame(Kind::ECHO, echoed[index], body.get()));
+  };
+
+  // The clients connect at once, the connections are part of the run.
+  scenario.start();
+  std::vector<folly::Future<ConnectionFactory::ConnectedDuplexConnection>>
+      connecting;
+  for (size_t i = 0; i < connections; ++i) {
+    connecting.push_back(factory.connect());
+  }
+  auto connected = folly::collectAll(connecting).get();
+  std::vector<yarpl::Reference<Peer>> peers;
+  for (size_t i = 0; i < connections; ++i) {
+    if (connected[i].hasException()) {
+      LOG(ERROR) << "Could not connect: " << connected[i].exception().what();
+      eventBase.runInEventBaseThreadAndWait([&] {
+        ++scenario.measurement.errors;
+        if (--remaining == 0) {
+          scenario.done();
+        }
+      });
+      continue;
+    }
+    peers.push_back(startPeer(
+        std::move(connected[i].value()),
+        [&, i](Peer& peer, std::unique_ptr<folly::IOBuf> frame) {
+          auto& measurement = scenario.measurement;
+          measurement.latency.record(Clock::now() - sent[i]);
+          auto const header = parseHeader(*frame);
+          if (!header || header->kind != Kind::ECHO ||
+              header->sequence != echoed[i] ||
+              frame->computeChainDataLength() != frameBytes) {
+            ++measurement.errors;
+          }
+          ++measurement.frames;
+          measurement.bytes += 2 * frameBytes;
+          if (++echoed[i] < count) {
+            send(peer, i);
+          } else if (--remaining == 0) {
+            scenario.done();
+          }
+        }));
+    auto& peer = *peers.back();
+    eventBase.runInEventBaseThread([&, i] { send(peer, i); });
+  }
+  scenario.finish();
+  closePeers(eventBase, peers);
+}
+
+} // namespace
+
+void runTransportScenarios(
+    const TransportUnderTest& transport,
+    const TransportScenarioOptions& options) {
+  LOG(INFO) << "Running the scenarios of " << transport.name;
+  Server server{transport};
+  folly::ScopedEventBaseThread client{"transport-client"};
+  auto& eventBase = *client.getEventBase();
+  auto factory = transport.makeFactory(server.acceptor(), eventBase);
+
+  {
+    Scenario scenario{transport.name, "throughput", server};
+    throughput(scenario, *factory, eventBase, options);
+  }
+  {
+    Scenario scenario{transport.name, "latency", server};
+    echo(scenario, *factory, eventBase, 1, options.roundTrips, 64);
+  }
+  {
+    Scenario scenario{transport.name, "connections", server};
+    echo(scenario, *factory, eventBase, options.connections, 1, 64);
+  }
+  {
+    Scenario scenario{transport.name, "large_frames", server};
+    echo(
+        scenario,
+        *factory,
+        eventBase,
+        1,
+        options.largeFrames,
+        options.largeFrameSize);
+  }
+}
+
+} // namespace rsocket
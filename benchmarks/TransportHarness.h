@@ -0,0 +1,68 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/ConnectionFactory.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// A transport run through the scenarios of runTransportScenarios(): how to
+/// make an acceptor, and a factory connecting to it.
+struct TransportUnderTest {
+  std::string name;
+
+  /// An acceptor which isn't started yet.
+  std::function<std::unique_ptr<ConnectionAcceptor>()> makeAcceptor;
+
+  /// A factory connecting to `acceptor`, started, with its connections on
+  /// `eventBase`.
+  std::function<std::unique_ptr<ConnectionFactory>(
+      const ConnectionAcceptor& acceptor,
+      folly::EventBase& eventBase)>
+      makeFactory;
+};
+
+/// The sizes of the scenarios.
+struct TransportScenarioOptions {
+  /// Frames sent one way for the throughput, of frameSize bytes.
+  size_t frames{200000};
+  size_t frameSize{1024};
+
+  /// Frames echoed one after the other for the latency.
+  size_t roundTrips{20000};
+
+  /// Connections established at once, each then echoing a frame.
+  size_t connections{500};
+
+  /// Frames of largeFrameSize bytes echoed one after the other.
+  size_t largeFrames{16};
+  size_t largeFrameSize{8 * 1024 * 1024};
+};
+
+/// Runs `transport` through the same scenarios as any other, at the level of
+/// DuplexConnection, so that transports compare like for like:
+///
+/// - throughput: frames streamed from a client to the server,
+/// - latency: small frames echoed by the server one after the other,
+/// - connections: many clients connecting at once, then each echoing a frame,
+/// - large_frames: large frames echoed one after the other.
+///
+/// Each scenario checks that the frames arrive whole and in order, and is
+/// logged and recorded with --results_json as
+/// Transport/<name>/<scenario>.  Transports which aren't framed are wrapped
+/// in a FramedDuplexConnection on both ends, as RSocket does.
+void runTransportScenarios(
+    const TransportUnderTest& transport,
+    const TransportScenarioOptions& options);
+
+} // namespace rsocket
@@ -0,0 +1,232 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <folly/Baton.h>
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include "yarpl/Flowable.h"
+#include "yarpl/Observable.h"
+#include "yarpl/Single.h"
+#include "yarpl/utils/credits.h"
+
+using namespace yarpl;
+using namespace yarpl::flowable;
+
+/// The cost of yarpl itself, per item: pipelines of each kind of stream, the
+/// emitters behind Flowable::create(), observeOn() hops between threads,
+/// Reference copies and moves, and the credits of subscriptions shared by
+/// several threads.  Each iteration is one item, or one operation.  Pick some
+/// with --bm_regex, e.g.
+///
+///   yarpl-operators --bm_regex='Flowable/.*'
+
+namespace {
+
+/// The number of items a subscriber requests at a time.
+constexpr int64_t kBatches[] = {1, 64, credits::kNoFlowControl};
+
+std::string batchName(int64_t batch) {
+  return batch == credits::kNoFlowControl ? "all"
+                                           : folly::to<std::string>(batch);
+}
+
+/// range() -> map() -> filter() -> subscribe(), requesting `batch` items at a
+/// time.  The filter drops no item.
+void flowablePipeline(size_t iters, int64_t batch) {
+  int64_t sum = 0;
+  Flowables::range(0, iters)
+      ->map([](int64_t i) { return i * 2; })
+      ->filter([](int64_t i) { return i >= 0; })
+      ->subscribe([&](int64_t i) { sum += i; }, batch);
+  folly::doNotOptimizeAway(sum);
+}
+
+void flowableEmitter(size_t iters, int64_t batch) {
+  int64_t sum = 0;
+  int64_t next = 0;
+  auto const count = static_cast<int64_t>(iters);
+  Flowable<int64_t>::create(
+      [&](Reference<Subscriber<int64_t>> subscriber, int64_t requested) {
+        int64_t emitted = 0;
+        for (; emitted < requested && next < count; ++emitted) {
+          subscriber->onNext(next++);
+        }
+        if (next == count) {
+          subscriber->onComplete();
+        }
+        return std::make_tuple(emitted, next == count);
+      })
+      ->subscribe([&](int64_t i) { sum += i; }, batch);
+  folly::doNotOptimizeAway(sum);
+}
+
+/// Items produced on the benchmark's thread and consumed on an EventBase.
+void flowableObserveOn(size_t iters, int64_t batch) {
+  folly::Baton<> done;
+  int64_t sum = 0;
+  folly::ScopedEventBaseThread worker;
+  Flowables::range(0, iters)
+      ->observeOn(*worker.getEventBase())
+      ->subscribe(
+          Subscribers::create<int64_t>(
+              [&](int64_t i) { sum += i; },
+              [&](folly::exception_wrapper) { done.post(); },
+              [&] { done.post(); },
+              batch));
+  done.wait();
+  folly::doNotOptimizeAway(sum);
+}
+
+void observablePipeline(size_t iters) {
+  int64_t sum = 0;
+  observable::Observables::range(0, iters)
+      ->map([](int64_t i) { return i * 2; })
+      ->filter([](int64_t i) { return i >= 0; })
+      ->subscribe([&](int64_t i) { sum += i; });
+  folly::doNotOptimizeAway(sum);
+}
+
+/// One Single per iteration, as every request/response creates one.
+void singlePipeline(size_t iters) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < iters; ++i) {
+    single::Singles::just<int64_t>(i)
+        ->map([](int64_t v) { return v * 2; })
+        ->subscribe([&](int64_t v) { sum += v; });
+  }
+  folly::doNotOptimizeAway(sum);
+}
+
+class Counted : public virtual Refcounted {};
+
+template <typename T>
+void referenceCopy(size_t iters) {
+  auto const ref = make_ref<T>();
+  for (size_t i = 0; i < iters; ++i) {
+    Reference<T> copy = ref;
+    folly::doNotOptimizeAway(copy);
+  }
+}
+
+template <typename T>
+void referenceMove(size_t iters) {
+  auto ref = make_ref<T>();
+  for (size_t i = 0; i < iters; ++i) {
+    Reference<T> moved = std::move(ref);
+    folly::doNotOptimizeAway(moved);
+    ref = std::move(moved);
+  }
+}
+
+/// add() and consume() by `threads` threads on the same credits, as
+/// request(n) and onNext() on both sides of a subscription.
+void creditsContention(size_t iters, size_t threads) {
+  std::atomic<int64_t> current{0};
+  std::atomic<size_t> ready{0};
+  std::vector<std::thread> workers;
+  BENCHMARK_SUSPEND {
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        ready.fetch_add(1);
+        while (ready.load() < threads + 1) {
+        }
+        for (size_t i = t; i < iters; i += threads) {
+          credits::add(&current, 1);
+          credits::consume(&current, 1);
+        }
+      });
+    }
+    while (ready.load() < threads) {
+    }
+  }
+  ready.fetch_add(1);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  folly::doNotOptimizeAway(current.load());
+}
+
+void localCredits(size_t iters) {
+  credits::LocalCredits current;
+  for (size_t i = 0; i < iters; ++i) {
+    current.add(1);
+    current.consume(1);
+  }
+  folly::doNotOptimizeAway(current.get());
+}
+
+void addFlowableBenchmarks() {
+  for (auto const batch : kBatches) {
+    auto const suffix = batchName(batch);
+    folly::addBenchmark(
+        __FILE__,
+        "Flowable/pipeline/request_" + suffix,
+        [batch](unsigned iters) {
+          flowablePipeline(iters, batch);
+          return iters;
+        });
+    folly::addBenchmark(
+        __FILE__,
+        "Flowable/emitter/request_" + suffix,
+        [batch](unsigned iters) {
+          flowableEmitter(iters, batch);
+          return iters;
+        });
+    folly::addBenchmark(
+        __FILE__,
+        "Flowable/observeOn/request_" + suffix,
+        [batch](unsigned iters) {
+          flowableObserveOn(iters, batch);
+          return iters;
+        });
+  }
+}
+
+void addOtherBenchmarks() {
+  folly::addBenchmark(__FILE__, "Observable/pipeline", [](unsigned iters) {
+    observablePipeline(iters);
+    return iters;
+  });
+  folly::addBenchmark(__FILE__, "Single/pipeline", [](unsigned iters) {
+    singlePipeline(iters);
+    return iters;
+  });
+
+  folly::addBenchmark(__FILE__, "Reference/copy", [](unsigned iters) {
+    referenceCopy<Counted>(iters);
+    return iters;
+  });
+  folly::addBenchmark(__FILE__, "Reference/move", [](unsigned iters) {
+    referenceMove<Counted>(iters);
+    return iters;
+  });
+
+  folly::addBenchmark(__FILE__, "credits/local", [](unsigned iters) {
+    localCredits(iters);
+    return iters;
+  });
+  for (size_t threads : {1, 2, 4}) {
+    folly::addBenchmark(
+        __FILE__,
+        folly::sformat("credits/atomic/threads_{}", threads),
+        [threads](unsigned iters) {
+          creditsContention(iters, threads);
+          return iters;
+        });
+  }
+}
+
+struct Registration {
+  Registration() {
+    addFlowableBenchmarks();
+    addOtherBenchmarks();
+  }
+} registration;
+
+} // namespace
@@ -0,0 +1,91 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/BusyPollEventBaseThread.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseObserver.h>
+
+namespace rsocket {
+
+/// Keeps a loop callback scheduled while it spins, which makes the EventBase
+/// poll without blocking.  Once the budget is spent it lets the EventBase
+/// block, and as an observer sampling every loop it starts spinning again
+/// after the loop that woke up.
+class BusyPollEventBaseThread::Spinner : public folly::EventBase::LoopCallback,
+                                         public folly::EventBaseObserver {
+ public:
+  Spinner(folly::EventBase& eventBase, std::chrono::microseconds budget)
+      : eventBase_(eventBase), budget_(budget) {}
+
+  void start() {
+    deadline_ = Clock::now() + budget_;
+    state_ = State::SPINNING;
+    eventBase_.runInLoop(this);
+  }
+
+  void runLoopCallback() noexcept override {
+    if (Clock::now() < deadline_) {
+      eventBase_.runInLoop(this);
+      return;
+    }
+    // The observer is called at the end of this loop still.
+    state_ = State::PARKING;
+  }
+
+  uint32_t getSampleRate() const override {
+    // Every loop.
+    return 0;
+  }
+
+  void loopSample(int64_t, int64_t) override {
+    switch (state_) {
+      case State::SPINNING:
+        break;
+      case State::PARKING:
+        state_ = State::PARKED;
+        break;
+      case State::PARKED:
+        // The loop blocked and something woke it up.
+        start();
+        break;
+    }
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  enum class State { SPINNING, PARKING, PARKED };
+
+  folly::EventBase& eventBase_;
+  const std::chrono::microseconds budget_;
+  Clock::time_point deadline_;
+  State state_{State::PARKED};
+};
+
+BusyPollEventBaseThread::BusyPollEventBaseThread(
+    std::chrono::microseconds spinBudget,
+    const std::string& name)
+    : thread_(name) {
+  if (spinBudget.count() <= 0) {
+    return;
+  }
+  auto eventBase = thread_.getEventBase();
+  spinner_ = std::make_shared<Spinner>(*eventBase, spinBudget);
+  eventBase->runInEventBaseThreadAndWait([this, eventBase] {
+    eventBase->setObserver(spinner_);
+    spinner_->start();
+  });
+}
+
+BusyPollEventBaseThread::~BusyPollEventBaseThread() {
+  if (!spinner_) {
+    return;
+  }
+  auto eventBase = thread_.getEventBase();
+  eventBase->runInEventBaseThreadAndWait([this, eventBase] {
+    eventBase->setObserver(nullptr);
+    spinner_->cancelLoopCallback();
+  });
+}
+
+} // namespace rsocket
@@ -0,0 +1,48 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+namespace rsocket {
+
+/**
+ * A thread driving an EventBase, like folly::ScopedEventBaseThread, which
+ * keeps polling for events without sleeping for `spinBudget` after each time
+ * it wakes up, before it sleeps in epoll again.  Requests arriving while it
+ * spins are picked up without the wakeup latency of epoll, at the cost of a
+ * core kept busy.  A zero budget never spins.
+ *
+ * Meant for the latency critical connections: TcpConnectionAcceptor runs its
+ * workers on such threads with Options::busyPollBudget, and a
+ * TcpConnectionFactory connects on the EventBase it is given, which can be
+ * that of a BusyPollEventBaseThread.  TcpSocketOptions::busyPollMicros makes
+ * the kernel busy poll the device queue as well.
+ */
+class BusyPollEventBaseThread {
+ public:
+  explicit BusyPollEventBaseThread(
+      std::chrono::microseconds spinBudget,
+      const std::string& name = "rsocket-busy-poll");
+  ~BusyPollEventBaseThread();
+
+  BusyPollEventBaseThread(const BusyPollEventBaseThread&) = delete;
+  BusyPollEventBaseThread& operator=(const BusyPollEventBaseThread&) = delete;
+
+  folly::EventBase* getEventBase() const {
+    return thread_.getEventBase();
+  }
+
+ private:
+  class Spinner;
+
+  folly::ScopedEventBaseThread thread_;
+  /// Set with a non-zero budget, only used on the thread.
+  std::shared_ptr<Spinner> spinner_;
+};
+
+} // namespace rsocket
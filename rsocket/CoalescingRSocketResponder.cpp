@@ -0,0 +1,287 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/CoalescingRSocketResponder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/internal/ScheduledSingleObserver.h"
+
+namespace rsocket {
+
+/// The inner requests in flight by key, and the requests waiting for them.
+class CoalescingRSocketResponder::Flights
+    : public std::enable_shared_from_this<Flights> {
+ public:
+  /// The subscription of a request waiting for the inner request of its key.
+  class Waiter : public yarpl::single::SingleSubscription {
+   public:
+    Waiter(
+        std::shared_ptr<Flights> flights,
+        std::string key,
+        yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer)
+        : flights_(std::move(flights)),
+          key_(std::move(key)),
+          observer_(std::move(observer)) {}
+
+    void cancel() override {
+      cancelled_ = true;
+      flights_->leave(key_, this);
+    }
+
+    /// Only called by the one who took the waiter out of its flight.
+    void onSuccess(Payload response) {
+      auto observer = std::move(observer_);
+      observer->onSuccess(std::move(response));
+    }
+
+    void onError(folly::exception_wrapper ex) {
+      auto observer = std::move(observer_);
+      observer->onError(std::move(ex));
+    }
+
+    void dropObserver() {
+      observer_ = nullptr;
+    }
+
+    bool cancelled() const {
+      return cancelled_;
+    }
+
+   private:
+    const std::shared_ptr<Flights> flights_;
+    const std::string key_;
+    yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer_;
+    std::atomic<bool> cancelled_{false};
+  };
+
+  struct Flight {
+    std::vector<yarpl::Reference<Waiter>> waiters;
+    yarpl::Reference<yarpl::single::SingleSubscription> subscription;
+  };
+
+  class FlightObserver : public yarpl::single::SingleObserver<Payload> {
+   public:
+    FlightObserver(
+        std::shared_ptr<Flights> flights,
+        std::string key,
+        std::shared_ptr<Flight> flight)
+        : flights_(std::move(flights)),
+          key_(std::move(key)),
+          flight_(std::move(flight)) {}
+
+    void onSubscribe(yarpl::Reference<yarpl::single::SingleSubscription>
+                         subscription) override {
+      flights_->subscribed(flight_, std::move(subscription));
+    }
+
+    void onSuccess(Payload response) override {
+      auto waiters = flights_->land(key_, flight_);
+      for (auto& waiter : waiters) {
+        waiter->onSuccess(
+            &waiter == &waiters.back() ? std::move(response)
+                                       : response.clone());
+      }
+    }
+
+    void onError(folly::exception_wrapper ex) override {
+      for (auto& waiter : flights_->land(key_, flight_)) {
+        waiter->onError(ex);
+      }
+    }
+
+   private:
+    const std::shared_ptr<Flights> flights_;
+    const std::string key_;
+    const std::shared_ptr<Flight> flight_;
+  };
+
+  void join(
+      const std::shared_ptr<RSocketResponder>& inner,
+      std::string key,
+      Payload request,
+      StreamId streamId,
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) {
+    // The answer may come from the inner request of another connection.
+    if (auto eventBase =
+            folly::EventBaseManager::get()->getExistingEventBase()) {
+      observer = yarpl::make_ref<ScheduledSingleObserver<Payload>>(
+          std::move(observer), *eventBase);
+    }
+    auto waiter = yarpl::make_ref<Waiter>(shared_from_this(), key, observer);
+    // Subscribed first, the waiter may be answered as soon as it joins a
+    // flight.
+    observer->onSubscribe(waiter);
+
+    std::shared_ptr<Flight> flight;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (waiter->cancelled()) {
+        waiter->dropObserver();
+        return;
+      }
+      auto& inFlight = flights_[key];
+      if (inFlight) {
+        inFlight->waiters.push_back(std::move(waiter));
+        ++coalesced_;
+        return;
+      }
+      inFlight = flight = std::make_shared<Flight>();
+      flight->waiters.push_back(std::move(waiter));
+    }
+    inner->handleRequestResponse(std::move(request), streamId)
+        ->subscribe(yarpl::make_ref<FlightObserver>(
+            shared_from_this(), std::move(key), std::move(flight)));
+  }
+
+  size_t inFlight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flights_.size();
+  }
+
+  size_t coalesced() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return coalesced_;
+  }
+
+ private:
+  void leave(const std::string& key, Waiter* waiter) {
+    yarpl::Reference<yarpl::single::SingleSubscription> subscription;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = flights_.find(key);
+      if (it == flights_.end()) {
+        return;
+      }
+      auto flight = it->second;
+      auto& waiters = flight->waiters;
+      auto found = std::find_if(
+          waiters.begin(), waiters.end(), [waiter](const auto& other) {
+            return other.get() == waiter;
+          });
+      if (found == waiters.end()) {
+        return;
+      }
+      (*found)->dropObserver();
+      waiters.erase(found);
+      if (!waiters.empty()) {
+        return;
+      }
+      // The last waiter is gone, so is the inner request.
+      flights_.erase(it);
+      subscription = std::move(flight->subscription);
+    }
+    if (subscription) {
+      subscription->cancel();
+    }
+  }
+
+  void subscribed(
+      const std::shared_ptr<Flight>& flight,
+      yarpl::Reference<yarpl::single::SingleSubscription> subscription) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!flight->waiters.empty()) {
+        flight->subscription = std::move(subscription);
+        return;
+      }
+    }
+    // All the waiters left before the inner request got its subscription.
+    subscription->cancel();
+  }
+
+  /// Ends the flight, returns its waiters to answer.
+  std::vector<yarpl::Reference<Waiter>> land(
+      const std::string& key,
+      const std::shared_ptr<Flight>& flight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = flights_.find(key);
+    if (it != flights_.end() && it->second == flight) {
+      flights_.erase(it);
+    }
+    flight->subscription = nullptr;
+    return std::move(flight->waiters);
+  }
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+  size_t coalesced_{0};
+};
+
+CoalescingRSocketResponder::CoalescingRSocketResponder(
+    std::shared_ptr<RSocketResponder> inner,
+    KeyFunction key)
+    : inner_(std::move(inner)),
+      key_(std::move(key)),
+      flights_(std::make_shared<Flights>()) {}
+
+CoalescingRSocketResponder::~CoalescingRSocketResponder() = default;
+
+bool CoalescingRSocketResponder::acceptRequest(
+    StreamType streamType,
+    const MetadataView& metadata,
+    StreamId streamId) {
+  return inner_->acceptRequest(streamType, metadata, streamId);
+}
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+CoalescingRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  auto key = key_(request);
+  if (!key) {
+    return inner_->handleRequestResponse(std::move(request), streamId);
+  }
+  return yarpl::single::Single<Payload>::create([
+    inner = inner_,
+    flights = flights_,
+    key = std::move(*key),
+    request = std::move(request),
+    streamId
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    flights->join(
+        inner, std::move(key), std::move(request), streamId, observer);
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+CoalescingRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  return inner_->handleRequestStream(std::move(request), streamId);
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+CoalescingRSocketResponder::handleRequestChannel(
+    Payload request,
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  return inner_->handleRequestChannel(
+      std::move(request), std::move(requestStream), streamId);
+}
+
+void CoalescingRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  inner_->handleFireAndForget(std::move(request), streamId);
+}
+
+void CoalescingRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  inner_->handleMetadataPush(std::move(metadata));
+}
+
+size_t CoalescingRSocketResponder::inFlight() const {
+  return flights_->inFlight();
+}
+
+size_t CoalescingRSocketResponder::coalesced() const {
+  return flights_->coalesced();
+}
+
+} // namespace rsocket
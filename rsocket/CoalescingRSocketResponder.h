@@ -0,0 +1,76 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <folly/Optional.h>
+
+#include "rsocket/RSocketResponder.h"
+
+namespace rsocket {
+
+/**
+ * A decorated RSocketResponder which handles identical request-responses in
+ * flight at the same time once.  The first request with a key is handed to
+ * the inner responder, the requests with the same key arriving before it is
+ * answered wait for its answer, which is shared with IOBuf::clone().  The
+ * other interaction models are forwarded as they are.
+ *
+ * Share one instance across the connections of a server to coalesce their
+ * requests too.  The answers are delivered on the EventBase each request
+ * arrived on.  The inner request is cancelled once all of its requests are.
+ */
+class CoalescingRSocketResponder : public RSocketResponder {
+ public:
+  /// Returns the key of a request, none for a request which must not be
+  /// coalesced.  Called concurrently from the threads of the connections.
+  using KeyFunction = std::function<folly::Optional<std::string>(
+      const Payload& request)>;
+
+  CoalescingRSocketResponder(
+      std::shared_ptr<RSocketResponder> inner,
+      KeyFunction key);
+
+  ~CoalescingRSocketResponder();
+
+  bool acceptRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+  /// Inner requests in flight.
+  size_t inFlight() const;
+
+  /// Requests which waited for an identical one so far.
+  size_t coalesced() const;
+
+ private:
+  class Flights;
+
+  const std::shared_ptr<RSocketResponder> inner_;
+  const KeyFunction key_;
+  /// Shared with the Singles handed out, which can outlive the responder.
+  const std::shared_ptr<Flights> flights_;
+};
+
+} // namespace rsocket
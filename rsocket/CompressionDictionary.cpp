@@ -0,0 +1,50 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/CompressionDictionary.h"
+
+#include <stdexcept>
+
+#include <folly/portability/Config.h>
+
+#if FOLLY_HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+namespace rsocket {
+
+#if FOLLY_HAVE_LIBZSTD
+
+CompressionDictionary::CompressionDictionary(
+    folly::ByteRange dictionary,
+    int level)
+    : id_(ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size())) {
+  // Frames compressed without a dictionary carry the id 0.
+  if (id_ == 0) {
+    throw std::runtime_error("Compression dictionary without an id");
+  }
+  compression_ =
+      ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+  decompression_ = ZSTD_createDDict(dictionary.data(), dictionary.size());
+  if (!compression_ || !decompression_) {
+    ZSTD_freeCDict(compression_);
+    ZSTD_freeDDict(decompression_);
+    throw std::runtime_error("Cannot load compression dictionary");
+  }
+}
+
+CompressionDictionary::~CompressionDictionary() {
+  ZSTD_freeCDict(compression_);
+  ZSTD_freeDDict(decompression_);
+}
+
+#else
+
+CompressionDictionary::CompressionDictionary(folly::ByteRange, int) {
+  throw std::runtime_error("Compression dictionaries need zstd");
+}
+
+CompressionDictionary::~CompressionDictionary() = default;
+
+#endif
+
+} // namespace rsocket
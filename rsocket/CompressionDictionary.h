@@ -0,0 +1,59 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <folly/Range.h>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace rsocket {
+
+/// The mime type of the SETUP metadata entry by which a client names its
+/// compression dictionary, the id of the dictionary as 4 big endian bytes.
+constexpr folly::StringPiece kCompressionDictionaryMimeType{
+    "message/x.rsocket.compression-dictionary.v0"};
+
+/**
+ * A zstd dictionary, as trained by `zstd --train` on samples of the payloads
+ * of an application.  It is digested once, and then used read-only by all the
+ * connections and threads it is shared with.  Small and repetitive payloads
+ * compress several times better with a dictionary than on their own.
+ *
+ * Only payloads compressed with PayloadCompression::Codec::ZSTD use it, see
+ * PayloadCompression::dictionary.
+ */
+class CompressionDictionary {
+ public:
+  /// Throws std::runtime_error if the dictionary isn't a zstd dictionary with
+  /// an id, or if folly was built without zstd.
+  explicit CompressionDictionary(folly::ByteRange dictionary, int level = 3);
+
+  ~CompressionDictionary();
+
+  CompressionDictionary(const CompressionDictionary&) = delete;
+  CompressionDictionary& operator=(const CompressionDictionary&) = delete;
+
+  /// The id of the dictionary, which the frames it compresses carry.
+  uint32_t id() const {
+    return id_;
+  }
+
+  const ZSTD_CDict_s* compressionDictionary() const {
+    return compression_;
+  }
+
+  const ZSTD_DDict_s* decompressionDictionary() const {
+    return decompression_;
+  }
+
+ private:
+  uint32_t id_{0};
+  ZSTD_CDict_s* compression_{nullptr};
+  ZSTD_DDict_s* decompression_{nullptr};
+};
+
+} // namespace rsocket
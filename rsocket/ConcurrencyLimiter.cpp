@@ -0,0 +1,471 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/ConcurrencyLimiter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+
+#include "rsocket/RSocketErrors.h"
+#include "yarpl/flowable/Flowables.h"
+
+namespace rsocket {
+
+namespace {
+
+/// The limit, the requests in flight and the queue, shared by the requests.
+class LimiterCore {
+ public:
+  using Options = ConcurrencyLimiter::Options;
+  using Stats = ConcurrencyLimiter::Stats;
+  using Clock = AdaptiveLimit::Clock;
+  using Start = folly::Function<void()>;
+
+  enum class Admission { ADMITTED, QUEUED, REJECTED };
+
+  explicit LimiterCore(Options options)
+      : options_(std::move(options)), limit_(options_) {}
+
+  /// Takes room for a request, or queues `start` to be called once there is
+  /// some, with a ticket to withdraw it.
+  Admission admit(Start start, std::atomic<uint64_t>& ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inFlight_ < limit_.limit()) {
+      ++inFlight_;
+      return Admission::ADMITTED;
+    }
+    if (queue_.size() >= options_.maxQueued) {
+      ++rejected_;
+      return Admission::REJECTED;
+    }
+    ticket = nextTicket_++;
+    queue_.emplace_back(ticket.load(), std::move(start));
+    return Admission::QUEUED;
+  }
+
+  /// Takes a queued request out of the queue, false if it isn't queued.
+  bool withdraw(uint64_t ticket) {
+    if (ticket == 0) {
+      return false;
+    }
+    Start start;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = std::find_if(
+          queue_.begin(), queue_.end(), [ticket](const Queued& queued) {
+            return queued.first == ticket;
+          });
+      if (it == queue_.end()) {
+        return false;
+      }
+      // Destroyed outside of the lock, it holds the request.
+      start = std::move(it->second);
+      queue_.erase(it);
+    }
+    return true;
+  }
+
+  /// Ends a request in flight, with its latency unless it was cancelled, and
+  /// starts the queued requests which fit.
+  void release(folly::Optional<Clock::duration> latency, bool overload) {
+    std::vector<Start> starts;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      DCHECK_GT(inFlight_, 0u);
+      auto const wasInFlight = inFlight_--;
+      if (latency) {
+        limit_.update(*latency, overload, wasInFlight);
+      }
+      while (!queue_.empty() && inFlight_ < limit_.limit()) {
+        ++inFlight_;
+        starts.push_back(std::move(queue_.front().second));
+        queue_.pop_front();
+      }
+    }
+    for (auto& start : starts) {
+      start();
+    }
+  }
+
+  bool isOverload(const folly::exception_wrapper& ex) const {
+    if (options_.isOverload) {
+      return options_.isOverload(ex);
+    }
+    return ex.is_compatible_with<NoLeaseError>() ||
+        ex.is_compatible_with<PendingFramesFullError>() ||
+        ex.is_compatible_with<RequestTimeoutError>();
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.limit = limit_.limit();
+    stats.inFlight = inFlight_;
+    stats.queued = queue_.size();
+    stats.rejected = rejected_;
+    return stats;
+  }
+
+ private:
+  using Queued = std::pair<uint64_t, Start>;
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  AdaptiveLimit limit_;
+  size_t inFlight_{0};
+  std::deque<Queued> queue_;
+  uint64_t nextTicket_{1};
+  size_t rejected_{0};
+};
+
+using Core = LimiterCore;
+
+/// What a request-response and a stream have in common: the room the request
+/// takes in the limiter, released once.
+class LimitedRequest {
+ public:
+  LimitedRequest(
+      std::shared_ptr<Core> core,
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      const RequestOptions& options)
+      : core_(std::move(core)),
+        requester_(std::move(requester)),
+        request_(std::move(request)),
+        options_(options) {}
+
+ protected:
+  /// Releases the room of the request, the first time only.
+  void finish(bool overload) {
+    if (!finished_.exchange(true)) {
+      core_->release(Core::Clock::now() - startedAt_, overload);
+    }
+  }
+
+  void finishCancelled() {
+    if (!finished_.exchange(true)) {
+      core_->release(folly::none, false);
+    }
+  }
+
+  const std::shared_ptr<Core> core_;
+  std::shared_ptr<RSocketRequester> requester_;
+  Payload request_;
+  const RequestOptions options_;
+
+  std::mutex mutex_;
+  bool cancelled_{false};
+  Core::Clock::time_point startedAt_;
+  std::atomic<uint64_t> ticket_{0};
+  std::atomic<bool> finished_{false};
+};
+
+class LimitedSingle final : public yarpl::single::SingleObserver<Payload>,
+                            public yarpl::single::SingleSubscription,
+                            private LimitedRequest {
+ public:
+  LimitedSingle(
+      std::shared_ptr<Core> core,
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      const RequestOptions& options,
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer)
+      : LimitedRequest(
+            std::move(core),
+            std::move(requester),
+            std::move(request),
+            options),
+        observer_(std::move(observer)) {}
+
+  void begin() {
+    observer_->onSubscribe(this->ref_from_this(this));
+    auto admission =
+        core_->admit([self = this->ref_from_this(this)] { self->start(); },
+                     ticket_);
+    if (admission == Core::Admission::ADMITTED) {
+      start();
+    } else if (admission == Core::Admission::REJECTED) {
+      finished_ = true;
+      if (auto observer = takeObserver()) {
+        observer->onError(ConcurrencyLimitError(""));
+      }
+    }
+  }
+
+  void onSubscribe(yarpl::Reference<yarpl::single::SingleSubscription>
+                       subscription) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!cancelled_) {
+        inner_ = std::move(subscription);
+        return;
+      }
+    }
+    subscription->cancel();
+  }
+
+  void onSuccess(Payload response) override {
+    finish(false);
+    if (auto observer = takeObserver()) {
+      observer->onSuccess(std::move(response));
+    }
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    finish(core_->isOverload(ex));
+    if (auto observer = takeObserver()) {
+      observer->onError(std::move(ex));
+    }
+  }
+
+  void cancel() override {
+    yarpl::Reference<yarpl::single::SingleSubscription> inner;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+      cancelled_ = true;
+      observer_ = nullptr;
+      inner = std::move(inner_);
+    }
+    if (core_->withdraw(ticket_)) {
+      return;
+    }
+    if (inner) {
+      inner->cancel();
+    }
+    finishCancelled();
+  }
+
+ private:
+  void start() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        // Released by cancel().
+        return;
+      }
+      startedAt_ = Core::Clock::now();
+    }
+    requester_->requestResponse(std::move(request_), options_)
+        ->subscribe(this->ref_from_this(this));
+  }
+
+  yarpl::Reference<yarpl::single::SingleObserver<Payload>> takeObserver() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inner_ = nullptr;
+    return std::move(observer_);
+  }
+
+  yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer_;
+  yarpl::Reference<yarpl::single::SingleSubscription> inner_;
+};
+
+class LimitedStream : public yarpl::flowable::Subscriber<Payload>,
+                      public yarpl::flowable::Subscription,
+                      private LimitedRequest {
+ public:
+  LimitedStream(
+      std::shared_ptr<Core> core,
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      const RequestOptions& options,
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber)
+      : LimitedRequest(
+            std::move(core),
+            std::move(requester),
+            std::move(request),
+            options),
+        subscriber_(std::move(subscriber)) {}
+
+  void begin() {
+    subscriber_->onSubscribe(this->ref_from_this(this));
+    auto admission =
+        core_->admit([self = this->ref_from_this(this)] { self->start(); },
+                     ticket_);
+    if (admission == Core::Admission::ADMITTED) {
+      start();
+    } else if (admission == Core::Admission::REJECTED) {
+      finished_ = true;
+      if (auto subscriber = takeSubscriber()) {
+        subscriber->onError(ConcurrencyLimitError(""));
+      }
+    }
+  }
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    int64_t requested = 0;
+    bool cancelled;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled = cancelled_;
+      if (!cancelled) {
+        inner_ = subscription;
+        requested = std::exchange(requested_, 0);
+      }
+    }
+    if (cancelled) {
+      subscription->cancel();
+    } else if (requested > 0) {
+      subscription->request(requested);
+    }
+  }
+
+  void onNext(Payload payload) override {
+    // The first payload ends the wait the limit is about.
+    finish(false);
+    yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      subscriber = subscriber_;
+    }
+    if (subscriber) {
+      subscriber->onNext(std::move(payload));
+    }
+  }
+
+  void onComplete() override {
+    finish(false);
+    if (auto subscriber = takeSubscriber()) {
+      subscriber->onComplete();
+    }
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    finish(core_->isOverload(ex));
+    if (auto subscriber = takeSubscriber()) {
+      subscriber->onError(std::move(ex));
+    }
+  }
+
+  void request(int64_t n) override {
+    yarpl::Reference<yarpl::flowable::Subscription> inner;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!inner_) {
+        // Requested once the stream is sent.
+        requested_ = n > std::numeric_limits<int64_t>::max() - requested_
+            ? std::numeric_limits<int64_t>::max()
+            : requested_ + n;
+        return;
+      }
+      inner = inner_;
+    }
+    inner->request(n);
+  }
+
+  void cancel() override {
+    yarpl::Reference<yarpl::flowable::Subscription> inner;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+      cancelled_ = true;
+      subscriber_ = nullptr;
+      inner = std::move(inner_);
+    }
+    if (core_->withdraw(ticket_)) {
+      return;
+    }
+    if (inner) {
+      inner->cancel();
+    }
+    finishCancelled();
+  }
+
+ private:
+  void start() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        // Released by cancel().
+        return;
+      }
+      startedAt_ = Core::Clock::now();
+    }
+    requester_->requestStream(std::move(request_), options_)
+        ->subscribe(this->ref_from_this(this));
+  }
+
+  yarpl::Reference<yarpl::flowable::Subscriber<Payload>> takeSubscriber() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inner_ = nullptr;
+    return std::move(subscriber_);
+  }
+
+  yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber_;
+  yarpl::Reference<yarpl::flowable::Subscription> inner_;
+  /// Requested before the stream was sent.
+  int64_t requested_{0};
+};
+
+} // namespace
+
+class ConcurrencyLimiter::Core : public LimiterCore {
+ public:
+  using LimiterCore::LimiterCore;
+};
+
+ConcurrencyLimiter::ConcurrencyLimiter(Options options)
+    : core_(std::make_shared<Core>(std::move(options))) {}
+
+ConcurrencyLimiter::~ConcurrencyLimiter() = default;
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+ConcurrencyLimiter::requestResponse(
+    std::shared_ptr<RSocketRequester> requester,
+    Payload request,
+    const RequestOptions& options) {
+  return yarpl::single::Single<Payload>::create([
+    core = core_,
+    requester = std::move(requester),
+    request = std::move(request),
+    options
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    yarpl::make_ref<LimitedSingle>(
+        std::move(core),
+        std::move(requester),
+        std::move(request),
+        options,
+        std::move(observer))
+        ->begin();
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+ConcurrencyLimiter::requestStream(
+    std::shared_ptr<RSocketRequester> requester,
+    Payload request,
+    const RequestOptions& options) {
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    core = core_,
+    requester = std::move(requester),
+    request = std::move(request),
+    options
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    yarpl::make_ref<LimitedStream>(
+        std::move(core),
+        std::move(requester),
+        std::move(request),
+        options,
+        std::move(subscriber))
+        ->begin();
+  });
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::stats() const {
+  return core_->stats();
+}
+
+} // namespace rsocket
@@ -0,0 +1,85 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <folly/ExceptionWrapper.h>
+
+#include "rsocket/Payload.h"
+#include "rsocket/RSocketRequester.h"
+#include "rsocket/RequestOptions.h"
+#include "rsocket/internal/AdaptiveLimit.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+namespace rsocket {
+
+/**
+ * Bounds the requests in flight to a server, in front of RSocketRequester,
+ * with a limit it adapts to the latency of the responses.  Once the limit is
+ * reached, requests wait in a queue for one in flight to terminate, and fail
+ * with ConcurrencyLimitError once the queue is full.  It keeps the latency of
+ * a server which slows down from growing with its queues, and stops piling
+ * requests onto it, whether or not it issues leases.
+ *
+ * Use one limiter per server, with the requesters of all the connections to
+ * it.  A request-response is in flight until it terminates, a stream until
+ * its first payload or its termination, which is also when its latency is
+ * taken.  Cancelled requests leave the limit as it is.
+ *
+ * Thread safe.  The Singles and Flowables handed out can outlive the limiter.
+ */
+class ConcurrencyLimiter {
+ public:
+  using Algorithm = AdaptiveLimit::Algorithm;
+
+  /// How the limit follows latency, and what happens beyond it.
+  struct Options : AdaptiveLimit::Options {
+    /// Requests which wait for room.  Beyond them, requests fail right away.
+    size_t maxQueued{0};
+    /// Whether an error is a sign of overload, which backs the limit off.
+    /// By default the REJECTED errors and the timeouts raised locally are.
+    std::function<bool(const folly::exception_wrapper&)> isOverload;
+  };
+
+  struct Stats {
+    size_t limit{0};
+    size_t inFlight{0};
+    size_t queued{0};
+    /// Requests which failed because the queue was full, so far.
+    size_t rejected{0};
+  };
+
+  explicit ConcurrencyLimiter(Options options);
+  ~ConcurrencyLimiter();
+
+  ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+  ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+  /// See RSocketRequester::requestResponse.  The request is sent through
+  /// `requester` once the Single is subscribed to and the limit allows it.
+  yarpl::Reference<yarpl::single::Single<Payload>> requestResponse(
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      const RequestOptions& options = RequestOptions());
+
+  /// See RSocketRequester::requestStream.  The request is sent once the
+  /// Flowable is subscribed to and the limit allows it, with what the
+  /// subscriber requested so far.
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream(
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      const RequestOptions& options = RequestOptions());
+
+  Stats stats() const;
+
+ private:
+  class Core;
+
+  const std::shared_ptr<Core> core_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,360 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/ConcurrencyLimitingRSocketResponder.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+#include "yarpl/flowable/Flowables.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Name of the route shared by the routes beyond maxRoutes.
+constexpr auto kOtherRoutes = "(other)";
+
+std::string routeOf(const MetadataView& metadata, bool compositeMetadata) {
+  if (!metadata.hasMetadata()) {
+    return std::string();
+  }
+  if (compositeMetadata) {
+    try {
+      CompositeMetadataReader reader(metadata);
+      if (auto routing = reader.find(kRoutingMimeType)) {
+        return routing->cursor().readFixedString(routing->length());
+      }
+      return std::string();
+    } catch (const std::exception&) {
+      // Malformed, the whole metadata is the route then.
+    }
+  }
+  return metadata.cursor().readFixedString(metadata.length());
+}
+
+MetadataView metadataOf(const Payload& request) {
+  if (!request.metadata) {
+    return MetadataView();
+  }
+  return MetadataView(
+      folly::io::Cursor(request.metadata.get()),
+      request.metadata->computeChainDataLength());
+}
+
+/// The limits of the routes, and their requests in flight.
+class RouteLimits {
+ public:
+  using Options = ConcurrencyLimitingRSocketResponder::Options;
+  using RouteStats = ConcurrencyLimitingRSocketResponder::RouteStats;
+
+  struct Route {
+    Route(std::string _name, const AdaptiveLimit::Options& options)
+        : name(std::move(_name)), limit(options) {}
+
+    const std::string name;
+    AdaptiveLimit limit;
+    size_t inFlight{0};
+    size_t rejected{0};
+  };
+
+  /// A request in flight on a route, until it ends or is destroyed.
+  class RouteRequest {
+   public:
+    RouteRequest(std::shared_ptr<RouteLimits> routes, Route& route)
+        : routes_(std::move(routes)),
+          route_(route),
+          started_(AdaptiveLimit::Clock::now()) {}
+
+    ~RouteRequest() {
+      end();
+    }
+
+    /// Takes the latency of the request, the first time only.
+    void sample() {
+      if (!sampled_.exchange(true)) {
+        routes_->sample(route_, AdaptiveLimit::Clock::now() - started_);
+      }
+    }
+
+    void end() {
+      if (!ended_.exchange(true)) {
+        routes_->release(route_);
+      }
+    }
+
+   private:
+    const std::shared_ptr<RouteLimits> routes_;
+    Route& route_;
+    const AdaptiveLimit::Clock::time_point started_;
+    std::atomic<bool> sampled_{false};
+    std::atomic<bool> ended_{false};
+  };
+
+  explicit RouteLimits(Options options)
+      : options_(std::move(options)), others_(kOtherRoutes, options_) {}
+
+  /// Whether the route of a request is below its limit.
+  bool admit(const MetadataView& metadata) {
+    auto name = routeOf(metadata, options_.compositeMetadata);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& route = find(std::move(name));
+    if (route.inFlight < route.limit.limit()) {
+      return true;
+    }
+    ++route.rejected;
+    return false;
+  }
+
+  /// Counts a request in flight on its route.
+  static std::unique_ptr<RouteRequest> start(
+      const std::shared_ptr<RouteLimits>& self,
+      const Payload& request) {
+    auto name = routeOf(metadataOf(request), self->options_.compositeMetadata);
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    auto& route = self->find(std::move(name));
+    ++route.inFlight;
+    return std::make_unique<RouteRequest>(self, route);
+  }
+
+  std::vector<RouteStats> stats() const {
+    std::vector<RouteStats> stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.reserve(routes_.size() + 1);
+    auto const add = [&](const Route& route) {
+      RouteStats routeStats;
+      routeStats.route = route.name;
+      routeStats.limit = route.limit.limit();
+      routeStats.inFlight = route.inFlight;
+      routeStats.rejected = route.rejected;
+      stats.push_back(std::move(routeStats));
+    };
+    for (auto const& route : routes_) {
+      add(*route.second);
+    }
+    if (othersUsed_) {
+      add(others_);
+    }
+    return stats;
+  }
+
+ private:
+  /// Under the lock.
+  Route& find(std::string name) {
+    auto it = routes_.find(name);
+    if (it != routes_.end()) {
+      return *it->second;
+    }
+    if (routes_.size() >= options_.maxRoutes) {
+      othersUsed_ = true;
+      return others_;
+    }
+    auto route = std::make_unique<Route>(name, options_);
+    auto& result = *route;
+    routes_.emplace(std::move(name), std::move(route));
+    return result;
+  }
+
+  void sample(Route& route, AdaptiveLimit::Clock::duration latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    route.limit.update(latency, false, route.inFlight);
+  }
+
+  void release(Route& route) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DCHECK_GT(route.inFlight, 0u);
+    --route.inFlight;
+  }
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  /// Never erased, the requests in flight point to them.
+  std::unordered_map<std::string, std::unique_ptr<Route>> routes_;
+  Route others_;
+  bool othersUsed_{false};
+};
+
+using Request = std::unique_ptr<RouteLimits::RouteRequest>;
+
+class LimitedSingleObserver final
+    : public yarpl::single::SingleObserver<Payload>,
+      public yarpl::single::SingleSubscription {
+ public:
+  LimitedSingleObserver(
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> inner,
+      Request request)
+      : inner_(std::move(inner)), request_(std::move(request)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::single::SingleSubscription> subscription)
+      override {
+    subscription_ = std::move(subscription);
+    inner_->onSubscribe(this->ref_from_this(this));
+  }
+
+  void onSuccess(Payload payload) override {
+    request_->sample();
+    request_->end();
+    inner_->onSuccess(std::move(payload));
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    request_->sample();
+    request_->end();
+    inner_->onError(std::move(ex));
+  }
+
+  void cancel() override {
+    request_->end();
+    subscription_->cancel();
+  }
+
+ private:
+  yarpl::Reference<yarpl::single::SingleObserver<Payload>> inner_;
+  yarpl::Reference<yarpl::single::SingleSubscription> subscription_;
+  const Request request_;
+};
+
+class LimitedSubscriber : public yarpl::flowable::Subscriber<Payload>,
+                          public yarpl::flowable::Subscription {
+ public:
+  LimitedSubscriber(
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> inner,
+      Request request)
+      : inner_(std::move(inner)), request_(std::move(request)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    subscription_ = std::move(subscription);
+    inner_->onSubscribe(this->ref_from_this(this));
+  }
+
+  void onNext(Payload payload) override {
+    request_->sample();
+    inner_->onNext(std::move(payload));
+  }
+
+  void onComplete() override {
+    request_->sample();
+    request_->end();
+    inner_->onComplete();
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    request_->sample();
+    request_->end();
+    inner_->onError(std::move(ex));
+  }
+
+  void request(int64_t n) override {
+    subscription_->request(n);
+  }
+
+  void cancel() override {
+    request_->end();
+    subscription_->cancel();
+  }
+
+ private:
+  yarpl::Reference<yarpl::flowable::Subscriber<Payload>> inner_;
+  yarpl::Reference<yarpl::flowable::Subscription> subscription_;
+  const Request request_;
+};
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>> limitFlowable(
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> flowable,
+    Request request) {
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    flowable = std::move(flowable),
+    request = std::move(request)
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    flowable->subscribe(yarpl::make_ref<LimitedSubscriber>(
+        std::move(subscriber), std::move(request)));
+  });
+}
+
+} // namespace
+
+class ConcurrencyLimitingRSocketResponder::Routes : public RouteLimits {
+ public:
+  using RouteLimits::RouteLimits;
+};
+
+ConcurrencyLimitingRSocketResponder::ConcurrencyLimitingRSocketResponder(
+    std::shared_ptr<RSocketResponder> inner,
+    Options options)
+    : inner_(std::move(inner)),
+      routes_(std::make_shared<Routes>(std::move(options))) {}
+
+ConcurrencyLimitingRSocketResponder::~ConcurrencyLimitingRSocketResponder() =
+    default;
+
+bool ConcurrencyLimitingRSocketResponder::acceptRequest(
+    StreamType streamType,
+    const MetadataView& metadata,
+    StreamId streamId) {
+  // The request is counted once it is handled, right after.  The state
+  // machine sends REJECTED for a request which isn't accepted.
+  if (streamType != StreamType::FNF && !routes_->admit(metadata)) {
+    return false;
+  }
+  return inner_->acceptRequest(streamType, metadata, streamId);
+}
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+ConcurrencyLimitingRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  auto limited = Routes::start(routes_, request);
+  auto single = inner_->handleRequestResponse(std::move(request), streamId);
+  return yarpl::single::Single<Payload>::create([
+    single = std::move(single),
+    limited = std::move(limited)
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    single->subscribe(yarpl::make_ref<LimitedSingleObserver>(
+        std::move(observer), std::move(limited)));
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+ConcurrencyLimitingRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  auto limited = Routes::start(routes_, request);
+  return limitFlowable(
+      inner_->handleRequestStream(std::move(request), streamId),
+      std::move(limited));
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+ConcurrencyLimitingRSocketResponder::handleRequestChannel(
+    Payload request,
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  auto limited = Routes::start(routes_, request);
+  return limitFlowable(
+      inner_->handleRequestChannel(
+          std::move(request), std::move(requestStream), streamId),
+      std::move(limited));
+}
+
+void ConcurrencyLimitingRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  inner_->handleFireAndForget(std::move(request), streamId);
+}
+
+void ConcurrencyLimitingRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  inner_->handleMetadataPush(std::move(metadata));
+}
+
+std::vector<ConcurrencyLimitingRSocketResponder::RouteStats>
+ConcurrencyLimitingRSocketResponder::stats() const {
+  return routes_->stats();
+}
+
+} // namespace rsocket
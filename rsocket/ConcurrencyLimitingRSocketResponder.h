@@ -0,0 +1,89 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/internal/AdaptiveLimit.h"
+
+namespace rsocket {
+
+/**
+ * A decorated RSocketResponder which bounds the requests each route has in
+ * flight, with a limit per route which follows the latency of its handler,
+ * see AdaptiveLimit.  Once a route has reached its limit, its new requests
+ * are rejected from acceptRequest(), which has the peer sent a REJECTED
+ * error, so that one slow route can't take all of the capacity of the
+ * responder, nor all of the threads of its ResponderExecutor.
+ *
+ * A route is the routing entry of the metadata if it is composite, or the
+ * whole metadata otherwise.  Request-responses are in flight until they
+ * terminate, streams and channels until they terminate too, and their
+ * latency is that of their first payload.  Fire-and-forgets and metadata
+ * pushes are forwarded as they are.
+ *
+ * Share one instance across the connections of a server to limit them
+ * together.  Thread safe.
+ */
+class ConcurrencyLimitingRSocketResponder : public RSocketResponder {
+ public:
+  struct Options : AdaptiveLimit::Options {
+    /// Whether the metadata of the requests is composite.
+    bool compositeMetadata{false};
+    /// Routes limited apart.  The requests of the routes beyond them share
+    /// one limit.
+    size_t maxRoutes{1024};
+  };
+
+  struct RouteStats {
+    std::string route;
+    size_t limit{0};
+    size_t inFlight{0};
+    /// Requests rejected so far.
+    size_t rejected{0};
+  };
+
+  ConcurrencyLimitingRSocketResponder(
+      std::shared_ptr<RSocketResponder> inner,
+      Options options);
+
+  ~ConcurrencyLimitingRSocketResponder();
+
+  bool acceptRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+  /// The routes seen so far, the one shared by the routes beyond maxRoutes
+  /// last if it was used.
+  std::vector<RouteStats> stats() const;
+
+ private:
+  class Routes;
+
+  const std::shared_ptr<RSocketResponder> inner_;
+  /// Shared with the requests in flight, which can outlive the responder.
+  const std::shared_ptr<Routes> routes_;
+};
+
+} // namespace rsocket
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <folly/Optional.h>
 
 #include "rsocket/DuplexConnection.h"
@@ -59,5 +61,35 @@ class ConnectionAcceptor {
    * acceptor is not listening.
    */
   virtual folly::Optional<uint16_t> listeningPort() const = 0;
+
+  /**
+   * Get the EventBases of the worker threads connections are accepted on, when
+   * the acceptor has a fixed set of them.  Only valid once started.  Returns an
+   * empty vector by default.
+   */
+  virtual std::vector<folly::EventBase*> workerEventBases() const {
+    return {};
+  }
+
+  /**
+   * Get the file descriptors of the listening sockets, e.g. to hand them over
+   * to a new process, see HotRestart.h.  They stay owned by the acceptor.
+   * Only valid once started.  Returns an empty vector by default.
+   */
+  virtual std::vector<int> listeningSockets() const {
+    return {};
+  }
+
+  /**
+   * Wrap a connected socket handed over by another process, see HotRestart.h,
+   * into a connection on `eventBase` as if it had been accepted.  Called on
+   * `eventBase`.  Returns nullptr by default, leaving the descriptor to the
+   * caller.
+   */
+  virtual std::unique_ptr<DuplexConnection> adoptSocket(
+      int /*fd*/,
+      folly::EventBase& /*eventBase*/) {
+    return nullptr;
+  }
 };
 } // namespace rsocket
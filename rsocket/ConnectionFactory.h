@@ -45,5 +45,15 @@ class ConnectionFactory {
    * Resource creation depends on the particular implementation.
    */
   virtual folly::Future<ConnectedDuplexConnection> connect() = 0;
+
+  /**
+   * Connect with the IO of the connection on `eventBase`, e.g. one of an
+   * IOThreadPool.  Implementations which can't pick the EventBase of their
+   * connections connect() as usual.
+   */
+  virtual folly::Future<ConnectedDuplexConnection> connectOn(
+      folly::EventBase& /*eventBase*/) {
+    return connect();
+  }
 };
 } // namespace rsocket
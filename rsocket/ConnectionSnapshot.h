@@ -0,0 +1,56 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <folly/Optional.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// The state of an open stream, see ConnectionSnapshot.
+struct StreamSnapshot {
+  StreamId streamId{0};
+  /// Payloads the stream has asked the peer for and not received yet, 0 for
+  /// the streams which only send.
+  size_t consumerAllowance{0};
+};
+
+/// The state of a connection at one point in time, see
+/// RSocketServer::snapshot().
+struct ConnectionSnapshot {
+  RSocketMode mode{RSocketMode::SERVER};
+  /// None until it has been negotiated.
+  folly::Optional<ProtocolVersion> protocolVersion;
+  bool resumable{false};
+  /// Whether the connection has lost its transport and waits to be resumed.
+  bool disconnected{false};
+
+  /// Frames, and their bytes, waiting in the connection to be written, e.g.
+  /// while the transport isn't writable.
+  size_t pendingFrames{0};
+  size_t pendingBytes{0};
+  /// Bytes of the sent frames kept for resumption.
+  size_t resumeBufferBytes{0};
+  /// Bytes buffered by the transport, see DuplexConnection::bufferedBytes().
+  size_t transportBufferedBytes{0};
+
+  /// Bytes of the frames read and written since the connection was set up,
+  /// across resumptions.  The frames replayed by resumptions aren't counted
+  /// again.
+  uint64_t bytesRead{0};
+  uint64_t bytesWritten{0};
+
+  /// CPU cycles the connection spent on its EventBase so far, 0 unless
+  /// RSocketStats::cpuAccountingEnabled(), see CpuAccount.  Compare the
+  /// connections by it to find the ones using up the IO threads.
+  uint64_t cpuCycles{0};
+
+  /// The open streams.
+  std::vector<StreamSnapshot> streams;
+};
+}
@@ -0,0 +1,129 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/CountingRSocketStats.h"
+
+#include <algorithm>
+
+#include <folly/Bits.h>
+
+namespace rsocket {
+
+constexpr size_t CountingRSocketStats::kNumFrameTypes;
+constexpr size_t CountingRSocketStats::kNumSizeBuckets;
+constexpr size_t CountingRSocketStats::kCacheLineSize;
+
+size_t CountingRSocketStats::sizeBucket(size_t bytes) {
+  return std::min<size_t>(folly::findLastSet(bytes), kNumSizeBuckets - 1);
+}
+
+size_t CountingRSocketStats::sizeBucketMax(size_t bucket) {
+  if (bucket >= kNumSizeBuckets - 1) {
+    return (size_t(1) << (kNumSizeBuckets - 1)) - 1;
+  }
+  return (size_t(1) << bucket) - 1;
+}
+
+CountingRSocketStats::ThreadCounters::ThreadCounters(
+    CountingRSocketStats& _parent)
+    : parent(_parent) {
+  for (size_t i = 0; i < kNumFrameTypes; ++i) {
+    framesRead[i].store(0, std::memory_order_relaxed);
+    framesWritten[i].store(0, std::memory_order_relaxed);
+    for (size_t j = 0; j < kNumSizeBuckets; ++j) {
+      sizesRead[i][j].store(0, std::memory_order_relaxed);
+      sizesWritten[i][j].store(0, std::memory_order_relaxed);
+    }
+  }
+  bytesRead.store(0, std::memory_order_relaxed);
+  bytesWritten.store(0, std::memory_order_relaxed);
+}
+
+CountingRSocketStats::ThreadCounters::~ThreadCounters() {
+  std::lock_guard<std::mutex> lock(parent.retiredMutex_);
+  addTo(parent.retired_);
+}
+
+void CountingRSocketStats::ThreadCounters::addTo(Counters& counters) const {
+  for (size_t i = 0; i < kNumFrameTypes; ++i) {
+    counters.framesRead[i] += framesRead[i].load(std::memory_order_relaxed);
+    counters.framesWritten[i] +=
+        framesWritten[i].load(std::memory_order_relaxed);
+    for (size_t j = 0; j < kNumSizeBuckets; ++j) {
+      counters.sizesRead[i][j] +=
+          sizesRead[i][j].load(std::memory_order_relaxed);
+      counters.sizesWritten[i][j] +=
+          sizesWritten[i][j].load(std::memory_order_relaxed);
+    }
+  }
+  counters.bytesRead += bytesRead.load(std::memory_order_relaxed);
+  counters.bytesWritten += bytesWritten.load(std::memory_order_relaxed);
+}
+
+CountingRSocketStats::ThreadCounters& CountingRSocketStats::local() {
+  auto counters = threadCounters_.get();
+  if (!counters) {
+    counters = new ThreadCounters(*this);
+    threadCounters_.reset(counters);
+  }
+  return *counters;
+}
+
+void CountingRSocketStats::bytesWritten(size_t bytes) {
+  ThreadCounters::add(local().bytesWritten, bytes);
+}
+
+void CountingRSocketStats::bytesRead(size_t bytes) {
+  ThreadCounters::add(local().bytesRead, bytes);
+}
+
+void CountingRSocketStats::frameWritten(FrameType frameType) {
+  ThreadCounters::add(local().framesWritten[index(frameType)], 1);
+}
+
+void CountingRSocketStats::frameRead(FrameType frameType) {
+  ThreadCounters::add(local().framesRead[index(frameType)], 1);
+}
+
+void CountingRSocketStats::framesRead(FrameType frameType, size_t count) {
+  ThreadCounters::add(local().framesRead[index(frameType)], count);
+}
+
+void CountingRSocketStats::frameReadBytes(FrameType frameType, size_t bytes) {
+  auto& counters = local();
+  ThreadCounters::add(counters.framesRead[index(frameType)], 1);
+  ThreadCounters::add(
+      counters.sizesRead[index(frameType)][sizeBucket(bytes)], 1);
+}
+
+void CountingRSocketStats::frameWrittenBytes(
+    FrameType frameType,
+    size_t bytes) {
+  auto& counters = local();
+  ThreadCounters::add(counters.framesWritten[index(frameType)], 1);
+  ThreadCounters::add(
+      counters.sizesWritten[index(frameType)][sizeBucket(bytes)], 1);
+}
+
+CountingRSocketStats::Counters CountingRSocketStats::snapshot() const {
+  Counters counters;
+  {
+    auto accessor = threadCounters_.accessAllThreads();
+    for (const auto& threadCounters : accessor) {
+      threadCounters.addTo(counters);
+    }
+  }
+  std::lock_guard<std::mutex> lock(retiredMutex_);
+  for (size_t i = 0; i < kNumFrameTypes; ++i) {
+    counters.framesRead[i] += retired_.framesRead[i];
+    counters.framesWritten[i] += retired_.framesWritten[i];
+    for (size_t j = 0; j < kNumSizeBuckets; ++j) {
+      counters.sizesRead[i][j] += retired_.sizesRead[i][j];
+      counters.sizesWritten[i][j] += retired_.sizesWritten[i][j];
+    }
+  }
+  counters.bytesRead += retired_.bytesRead;
+  counters.bytesWritten += retired_.bytesWritten;
+  return counters;
+}
+
+} // namespace rsocket
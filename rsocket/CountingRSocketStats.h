@@ -0,0 +1,137 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <folly/ThreadLocal.h>
+
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/// RSocketStats counting the frames of each FrameType, and the bytes, read and
+/// written.  Meant to be cheap enough to keep enabled in production, and to be
+/// shared by all the connections of a process.
+///
+/// Every thread counts into its own counters, which no other thread writes, so
+/// counting is a plain add without any atomic read-modify-write or contended
+/// cache line.  snapshot() adds up the counters of all the threads, it is the
+/// expensive operation.  The counts of the threads which exited are kept.
+///
+/// With `frameSizes`, it also counts the frames of each type by size, in
+/// power of two buckets, e.g. to pick buffer sizes or the fragmentation and
+/// compression thresholds.  The connections then report every frame on its
+/// own, instead of the runs of frames of a type.
+class CountingRSocketStats : public RSocketStats {
+ public:
+  /// Frame types are 6 bits.
+  static constexpr size_t kNumFrameTypes = 64;
+
+  /// Bucket 0 counts the empty frames, bucket i the frames of 2^(i-1) to
+  /// 2^i - 1 bytes, and the last one the frames of 2^23 bytes and more, up to
+  /// the largest frame length of 2^24 - 1 bytes.
+  static constexpr size_t kNumSizeBuckets = 25;
+
+  using SizeBuckets = std::array<uint64_t, kNumSizeBuckets>;
+
+  struct Counters {
+    std::array<uint64_t, kNumFrameTypes> framesRead{};
+    std::array<uint64_t, kNumFrameTypes> framesWritten{};
+    uint64_t bytesRead{0};
+    uint64_t bytesWritten{0};
+    /// Only counted with `frameSizes`.
+    std::array<SizeBuckets, kNumFrameTypes> sizesRead{};
+    std::array<SizeBuckets, kNumFrameTypes> sizesWritten{};
+
+    uint64_t read(FrameType frameType) const {
+      return framesRead[index(frameType)];
+    }
+    uint64_t written(FrameType frameType) const {
+      return framesWritten[index(frameType)];
+    }
+    const SizeBuckets& readSizes(FrameType frameType) const {
+      return sizesRead[index(frameType)];
+    }
+    const SizeBuckets& writtenSizes(FrameType frameType) const {
+      return sizesWritten[index(frameType)];
+    }
+  };
+
+  explicit CountingRSocketStats(bool frameSizes = false)
+      : frameSizes_{frameSizes} {}
+
+  /// The bucket of a frame of `bytes`.
+  static size_t sizeBucket(size_t bytes);
+
+  /// The largest size a bucket counts.
+  static size_t sizeBucketMax(size_t bucket);
+
+  void bytesWritten(size_t bytes) override;
+  void bytesRead(size_t bytes) override;
+  void frameWritten(FrameType frameType) override;
+  void frameRead(FrameType frameType) override;
+  void framesRead(FrameType frameType, size_t count) override;
+
+  bool frameSizesEnabled() const override {
+    return frameSizes_;
+  }
+  void frameReadBytes(FrameType frameType, size_t bytes) override;
+  void frameWrittenBytes(FrameType frameType, size_t bytes) override;
+
+  /// Sum of the counters of all the threads.
+  Counters snapshot() const;
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  /// Counters of one thread.  The other threads only read them, the atomics
+  /// are relaxed and never incremented atomically.  Padded so that they don't
+  /// share cache lines with the data of the other threads.
+  struct ThreadCounters {
+    explicit ThreadCounters(CountingRSocketStats& parent);
+
+    /// Moves the counts to the retired counters of the parent.
+    ~ThreadCounters();
+
+    static void add(std::atomic<uint64_t>& counter, uint64_t n) {
+      counter.store(
+          counter.load(std::memory_order_relaxed) + n,
+          std::memory_order_relaxed);
+    }
+
+    void addTo(Counters&) const;
+
+    char padding0[kCacheLineSize];
+    CountingRSocketStats& parent;
+    std::atomic<uint64_t> framesRead[kNumFrameTypes];
+    std::atomic<uint64_t> framesWritten[kNumFrameTypes];
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> sizesRead[kNumFrameTypes][kNumSizeBuckets];
+    std::atomic<uint64_t> sizesWritten[kNumFrameTypes][kNumSizeBuckets];
+    char padding1[kCacheLineSize];
+  };
+
+  struct ThreadCountersTag {};
+
+  static size_t index(FrameType frameType) {
+    return static_cast<size_t>(frameType) % kNumFrameTypes;
+  }
+
+  ThreadCounters& local();
+
+  const bool frameSizes_;
+
+  /// Declared before threadCounters_, whose destructor destroys the
+  /// ThreadCounters of all the threads, moving their counts here.
+  mutable std::mutex retiredMutex_;
+  Counters retired_;
+
+  folly::ThreadLocalPtr<ThreadCounters, ThreadCountersTag> threadCounters_;
+};
+
+} // namespace rsocket
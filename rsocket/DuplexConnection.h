@@ -3,11 +3,18 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/RequestOptions.h"
+#include "rsocket/internal/Common.h"
 #include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
 
 namespace folly {
-class IOBuf;
+class EventBase;
+class IOBufQueue;
 }
 
 namespace rsocket {
@@ -28,6 +35,24 @@ public:
     subscription_.reset();
   }
 
+  /// Number of bytes the subscriber knows it still needs before it can make
+  /// progress, e.g. the rest of a partially received frame, or 0 if unknown.
+  /// Transports can use it to size their reads.
+  virtual size_t bytesExpected() const {
+    return 0;
+  }
+
+  /// Takes several frames at once.  Subscribers which can hand them to the
+  /// transport in a single write override it, the others take them one by
+  /// one.  An input gets the frames parsed from one read this way, and has to
+  /// drop those left after it canceled.
+  virtual void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      onNext(std::move(frame));
+    }
+  }
+
 protected:
   Reference<yarpl::flowable::Subscription> subscription() {
     return subscription_;
@@ -37,6 +62,16 @@ private:
   Reference<yarpl::flowable::Subscription> subscription_;
 };
 
+/// The Subscription handed to the output of a DuplexConnection.  Transports
+/// which buffer the frames they can't write to the network yet tell it when the
+/// buffered bytes go above their high-water mark, and when they have drained
+/// again.  The output keeps accepting frames while it is not writable, it is up
+/// to the producers to back off.
+class DuplexSubscription : public yarpl::flowable::Subscription {
+ public:
+  virtual void onWritabilityChanged(bool /*writable*/) {}
+};
+
 /// Represents a connection of the underlying protocol, on top of which the
 /// RSocket protocol is layered.  The underlying protocol MUST provide an
 /// ordered, guaranteed, bidirectional transport of frames.  Moreover, frame
@@ -56,6 +91,7 @@ class DuplexConnection {
  public:
   using Subscriber = yarpl::flowable::Subscriber<std::unique_ptr<folly::IOBuf>>;
   using DuplexSubscriber = rsocket::DuplexSubscriber;
+  using DuplexSubscription = rsocket::DuplexSubscription;
 
   virtual ~DuplexConnection() = default;
 
@@ -75,5 +111,51 @@ class DuplexConnection {
   virtual bool isFramed() const {
     return false;
   }
+
+  /// Bytes the connection holds in memory: the frames it buffers until they
+  /// are written to the network and the bytes read which don't make a whole
+  /// frame yet.  Called on the EventBase of the connection, to account for
+  /// the memory of the RSocket connection on top of it.
+  virtual size_t bufferedBytes() const {
+    return 0;
+  }
+
+  /// Frees the buffers the connection keeps around to reuse, e.g. its read
+  /// buffer, while it is idle.  They are allocated again on the next read or
+  /// write.  Called on the EventBase of the connection.
+  virtual void releaseBuffers() {}
+
+  /// Detaches the connection from its EventBase, to carry on with
+  /// attachEventBase() on another one.  Nothing is read in between.  Returns
+  /// false if the connection can't move right now, e.g. while writes are in
+  /// flight, or at all.  Called on the EventBase of the connection.
+  virtual bool detachEventBase() {
+    return false;
+  }
+
+  /// Attaches a detached connection to `eventBase`, and resumes reading.
+  /// Called on `eventBase`.
+  virtual void attachEventBase(folly::EventBase& /*eventBase*/) {}
+
+  /// Takes the socket out of the connection, to hand it over to another
+  /// process, see HotRestart.h.  Returns its file descriptor, which the caller
+  /// owns, and appends the bytes read from it which aren't delivered yet to
+  /// `unread`.  Returns -1 if the connection can't, e.g. while writes are in
+  /// flight, or at all.  Closing the connection afterwards leaves the socket
+  /// open.  Called on the EventBase of the connection.
+  virtual int releaseSocket(folly::IOBufQueue& /*unread*/) {
+    return -1;
+  }
+
+  /// Tells the connection the priority of a stream, before the first frame of
+  /// the stream is sent on it, e.g. for transports which carry the streams of
+  /// a class apart.  It holds until clearStreamPriority().  Streams which
+  /// started on another connection, before a resumption, have none.  Called
+  /// on the EventBase of the connection.
+  virtual void setStreamPriority(
+      StreamId /*streamId*/,
+      StreamPriority /*priority*/) {}
+
+  virtual void clearStreamPriority(StreamId /*streamId*/) {}
 };
 }
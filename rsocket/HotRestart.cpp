@@ -0,0 +1,321 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/HotRestart.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <folly/Exception.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+namespace rsocket {
+
+namespace {
+
+/// Each message is a header of kind, flags and body length, as big endian
+/// uint32_t, then the body.  The descriptor, if any, rides on the header.
+constexpr size_t kHeaderLength = 12;
+constexpr uint32_t kFdAttached = 1;
+/// Longer bodies are taken as garbage.
+constexpr uint32_t kMaxBodyLength = 1 << 30;
+
+enum class MessageKind : uint32_t {
+  LISTENING_SOCKET = 1,
+  CONNECTION = 2,
+  END = 3,
+};
+
+struct Message {
+  MessageKind kind;
+  int fd{-1};
+  std::unique_ptr<folly::IOBuf> body;
+};
+
+void sendFull(int unixSocket, const uint8_t* data, size_t length) {
+  while (length > 0) {
+    auto const sent = ::send(unixSocket, data, length, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      folly::throwSystemError("hot restart send");
+    }
+    data += sent;
+    length -= sent;
+  }
+}
+
+void sendMessage(
+    int unixSocket,
+    MessageKind kind,
+    int fd,
+    const folly::IOBuf* body) {
+  auto const bodyLength = body ? body->computeChainDataLength() : 0;
+  if (bodyLength > kMaxBodyLength) {
+    throw std::runtime_error("hot restart message too long");
+  }
+
+  uint8_t header[kHeaderLength];
+  folly::io::RWPrivateCursor cursor(
+      folly::IOBuf::wrapBufferAsValue(header, sizeof(header)));
+  cursor.writeBE<uint32_t>(static_cast<uint32_t>(kind));
+  cursor.writeBE<uint32_t>(fd >= 0 ? kFdAttached : 0);
+  cursor.writeBE<uint32_t>(static_cast<uint32_t>(bodyLength));
+
+  iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = sizeof(header);
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  if (fd >= 0) {
+    std::memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(unixSocket, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (sent < 0) {
+    folly::throwSystemError("hot restart sendmsg");
+  }
+  // The descriptor went with the first byte, the rest is plain bytes.
+  sendFull(unixSocket, header + sent, sizeof(header) - sent);
+  if (body) {
+    for (auto range : *body) {
+      sendFull(unixSocket, range.data(), range.size());
+    }
+  }
+}
+
+/// Returns false on EOF before the first byte.
+bool receiveFull(int unixSocket, uint8_t* data, size_t length) {
+  size_t received = 0;
+  while (received < length) {
+    auto const n = ::recv(unixSocket, data + received, length - received, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      folly::throwSystemError("hot restart recv");
+    }
+    if (n == 0) {
+      if (received == 0) {
+        return false;
+      }
+      throw std::runtime_error("hot restart message truncated");
+    }
+    received += n;
+  }
+  return true;
+}
+
+Message receiveMessage(int unixSocket) {
+  uint8_t header[kHeaderLength];
+  iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = sizeof(header);
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do {
+    received = ::recvmsg(unixSocket, &msg, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0) {
+    folly::throwSystemError("hot restart recvmsg");
+  }
+
+  Message message;
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+      std::memcpy(&message.fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  auto closeFd = [&message] {
+    if (message.fd >= 0) {
+      ::close(message.fd);
+    }
+  };
+
+  if (msg.msg_flags & MSG_CTRUNC) {
+    closeFd();
+    throw std::runtime_error("hot restart descriptors truncated");
+  }
+  if (received == 0) {
+    throw std::runtime_error("hot restart peer closed");
+  }
+  try {
+    if (static_cast<size_t>(received) < sizeof(header) &&
+        !receiveFull(
+            unixSocket, header + received, sizeof(header) - received)) {
+      throw std::runtime_error("hot restart message truncated");
+    }
+
+    folly::io::Cursor cursor(
+        folly::IOBuf::wrapBufferAsValue(header, sizeof(header)));
+    auto const kind = cursor.readBE<uint32_t>();
+    auto const flags = cursor.readBE<uint32_t>();
+    auto const bodyLength = cursor.readBE<uint32_t>();
+    if (kind < static_cast<uint32_t>(MessageKind::LISTENING_SOCKET) ||
+        kind > static_cast<uint32_t>(MessageKind::END)) {
+      throw std::runtime_error("hot restart message of unknown kind");
+    }
+    if (((flags & kFdAttached) != 0) != (message.fd >= 0)) {
+      throw std::runtime_error("hot restart descriptor missing");
+    }
+    if (bodyLength > kMaxBodyLength) {
+      throw std::runtime_error("hot restart message too long");
+    }
+    message.kind = static_cast<MessageKind>(kind);
+    message.body = folly::IOBuf::create(bodyLength);
+    if (bodyLength > 0 &&
+        !receiveFull(unixSocket, message.body->writableData(), bodyLength)) {
+      throw std::runtime_error("hot restart message truncated");
+    }
+    message.body->append(bodyLength);
+  } catch (const std::exception&) {
+    closeFd();
+    throw;
+  }
+  return message;
+}
+
+void sendEnd(int unixSocket) {
+  sendMessage(unixSocket, MessageKind::END, -1, nullptr);
+}
+
+} // namespace
+
+HandedOverConnection::HandedOverConnection(
+    HandedOverConnection&& other) noexcept
+    : state(std::move(other.state)),
+      fd(other.fd),
+      unread(std::move(other.unread)) {
+  other.fd = -1;
+}
+
+HandedOverConnection& HandedOverConnection::operator=(
+    HandedOverConnection&& other) noexcept {
+  if (this != &other) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    state = std::move(other.state);
+    fd = other.fd;
+    unread = std::move(other.unread);
+    other.fd = -1;
+  }
+  return *this;
+}
+
+HandedOverConnection::~HandedOverConnection() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+void sendListeningSockets(int unixSocket, const std::vector<int>& sockets) {
+  for (auto fd : sockets) {
+    sendMessage(unixSocket, MessageKind::LISTENING_SOCKET, fd, nullptr);
+  }
+  sendEnd(unixSocket);
+}
+
+std::vector<int> receiveListeningSockets(int unixSocket) {
+  std::vector<int> sockets;
+  auto closeAll = [&sockets] {
+    for (auto fd : sockets) {
+      ::close(fd);
+    }
+  };
+  try {
+    while (true) {
+      auto message = receiveMessage(unixSocket);
+      if (message.kind == MessageKind::END) {
+        return sockets;
+      }
+      if (message.fd >= 0) {
+        sockets.push_back(message.fd);
+      }
+      if (message.kind != MessageKind::LISTENING_SOCKET || message.fd < 0) {
+        throw std::runtime_error("hot restart expected a listening socket");
+      }
+    }
+  } catch (const std::exception&) {
+    closeAll();
+    throw;
+  }
+}
+
+void sendHandedOverConnections(
+    int unixSocket,
+    std::vector<HandedOverConnection> connections) {
+  for (auto& connection : connections) {
+    // The state's length, the state, then the bytes read ahead.
+    folly::IOBufQueue body(folly::IOBufQueue::cacheChainLength());
+    folly::io::QueueAppender appender(&body, 4);
+    auto const stateLength =
+        connection.state ? connection.state->computeChainDataLength() : 0;
+    appender.writeBE<uint32_t>(static_cast<uint32_t>(stateLength));
+    if (connection.state) {
+      body.append(std::move(connection.state));
+    }
+    if (connection.unread) {
+      body.append(std::move(connection.unread));
+    }
+    auto const buf = body.move();
+    sendMessage(unixSocket, MessageKind::CONNECTION, connection.fd, buf.get());
+  }
+  sendEnd(unixSocket);
+  // The descriptors are closed here with the connections.
+}
+
+std::vector<HandedOverConnection> receiveHandedOverConnections(
+    int unixSocket) {
+  std::vector<HandedOverConnection> connections;
+  while (true) {
+    auto message = receiveMessage(unixSocket);
+    if (message.kind == MessageKind::END) {
+      return connections;
+    }
+    HandedOverConnection connection;
+    connection.fd = message.fd;
+    if (message.kind != MessageKind::CONNECTION) {
+      throw std::runtime_error("hot restart expected a connection");
+    }
+
+    folly::io::Cursor cursor(message.body.get());
+    try {
+      auto const stateLength = cursor.readBE<uint32_t>();
+      cursor.clone(connection.state, stateLength);
+    } catch (const std::out_of_range&) {
+      throw std::runtime_error("hot restart connection truncated");
+    }
+    if (!cursor.isAtEnd()) {
+      cursor.clone(connection.unread, cursor.totalLength());
+    }
+    connections.push_back(std::move(connection));
+  }
+}
+
+} // namespace rsocket
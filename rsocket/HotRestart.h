@@ -0,0 +1,78 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+
+namespace rsocket {
+
+/// Hot restart of a RSocketServer: a new process takes the listening sockets
+/// and the resumable connections over from the old one, so that deploys don't
+/// drop the connections.  The file descriptors go over a Unix domain stream
+/// socket between the two processes, e.g. one the old process listens on, as
+/// SCM_RIGHTS messages.
+///
+/// The old process:
+///
+///   sendListeningSockets(unixSocket, server.listeningSockets());
+///   sendHandedOverConnections(
+///       unixSocket, server.handOverConnections().get());
+///   // The connections which can't be handed over, e.g. not resumable.
+///   server.shutdownAndWait(drainTimeout);
+///
+/// The new process:
+///
+///   TcpConnectionAcceptor::Options options(port);
+///   options.inheritedSockets = receiveListeningSockets(unixSocket);
+///   RSocketServer server(std::make_unique<TcpConnectionAcceptor>(options));
+///   server.setResumeBufferPool(pool);
+///   server.start(serviceHandler);
+///   server.adoptConnections(
+///       receiveHandedOverConnections(unixSocket), serviceHandler);
+///
+/// The connections carry on over the same sockets with their resumption
+/// state, the clients see at most a stall.  The connections whose socket
+/// can't move, e.g. TLS ones or those with writes in flight, are closed and
+/// their clients resume them in the new process.  The streams don't survive:
+/// their handlers stay behind, the clients see them canceled.  Not for Unix
+/// domain socket acceptors, whose socket file goes away with the old server.
+///
+/// The calls block, and throw std::system_error if the Unix socket fails and
+/// std::runtime_error on unexpected messages.
+
+/// A connection handed over, see RSocketServer::handOverConnections().
+struct HandedOverConnection {
+  HandedOverConnection() = default;
+  HandedOverConnection(HandedOverConnection&&) noexcept;
+  HandedOverConnection& operator=(HandedOverConnection&&) noexcept;
+  /// Closes the socket if nobody took it.
+  ~HandedOverConnection();
+
+  /// The state to carry on from, see ResumeStateTransfer.
+  std::unique_ptr<folly::IOBuf> state;
+  /// The socket, -1 if it couldn't be released and the client has to resume
+  /// the connection.
+  int fd{-1};
+  /// The bytes read from the socket which didn't make a whole frame yet.
+  std::unique_ptr<folly::IOBuf> unread;
+};
+
+/// Sends the listening sockets, which stay open here.
+void sendListeningSockets(int unixSocket, const std::vector<int>& sockets);
+
+/// Receives the listening sockets, which the caller owns, see
+/// TcpConnectionAcceptor::Options::inheritedSockets.
+std::vector<int> receiveListeningSockets(int unixSocket);
+
+/// Sends the connections, and closes their sockets here.
+void sendHandedOverConnections(
+    int unixSocket,
+    std::vector<HandedOverConnection> connections);
+
+std::vector<HandedOverConnection> receiveHandedOverConnections(
+    int unixSocket);
+
+} // namespace rsocket
@@ -0,0 +1,86 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/IOThreadPool.h"
+
+#include <folly/Conv.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+struct IOThreadPool::Thread {
+  explicit Thread(size_t index)
+      : thread(folly::to<std::string>("rsocket-io-", index)) {}
+
+  folly::ScopedEventBaseThread thread;
+  /// Shared with the leases, which may outlive the pool.
+  const std::shared_ptr<std::atomic<size_t>> connections{
+      std::make_shared<std::atomic<size_t>>(0)};
+};
+
+IOThreadPool::Lease::Lease(
+    std::shared_ptr<std::atomic<size_t>> connections,
+    folly::EventBase& eventBase)
+    : connections_(std::move(connections)), eventBase_(eventBase) {
+  ++*connections_;
+}
+
+IOThreadPool::Lease::~Lease() {
+  --*connections_;
+}
+
+IOThreadPool::IOThreadPool(size_t threads, Policy policy) : policy_(policy) {
+  CHECK_GT(threads, 0u);
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.push_back(std::make_unique<Thread>(i));
+  }
+}
+
+IOThreadPool::~IOThreadPool() = default;
+
+std::shared_ptr<IOThreadPool::Lease> IOThreadPool::lease() {
+  auto& thread = *threads_[pick()];
+  return std::make_shared<Lease>(
+      thread.connections, *thread.thread.getEventBase());
+}
+
+size_t IOThreadPool::pick() {
+  // Co-locate the connection with a caller running on the pool.
+  if (auto current = folly::EventBaseManager::get()->getExistingEventBase()) {
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      if (threads_[i]->thread.getEventBase() == current) {
+        return i;
+      }
+    }
+  }
+
+  auto const start = next_++ % threads_.size();
+  if (policy_ == Policy::ROUND_ROBIN) {
+    return start;
+  }
+  // Ties go to the thread after the one picked last.
+  auto picked = start;
+  for (size_t i = 1; i < threads_.size(); ++i) {
+    auto const index = (start + i) % threads_.size();
+    if (*threads_[index]->connections < *threads_[picked]->connections) {
+      picked = index;
+    }
+  }
+  return picked;
+}
+
+std::vector<folly::EventBase*> IOThreadPool::eventBases() const {
+  std::vector<folly::EventBase*> eventBases;
+  for (auto const& thread : threads_) {
+    eventBases.push_back(thread->thread.getEventBase());
+  }
+  return eventBases;
+}
+
+size_t IOThreadPool::connections(size_t index) const {
+  return *threads_.at(index)->connections;
+}
+
+} // namespace rsocket
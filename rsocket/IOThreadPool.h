@@ -0,0 +1,79 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace folly {
+class EventBase;
+class ScopedEventBaseThread;
+}
+
+namespace rsocket {
+
+/**
+ * A fixed set of IO threads, each driving an EventBase, which the connections
+ * of many RSocketClients share instead of each of them driving its own
+ * thread.  Pass it to RSocket::createConnectedClient, its connection and its
+ * state machine then live on one of the EventBases.
+ *
+ * A caller running on one of the EventBases gets that one, so that its
+ * requests are sent without a hop to another thread.  The others get the
+ * EventBases in turn, or the one with the fewest connections.
+ *
+ * The clients must be destroyed before the pool.  Thread safe.
+ */
+class IOThreadPool {
+ public:
+  enum class Policy {
+    ROUND_ROBIN,
+    LEAST_CONNECTIONS,
+  };
+
+  /// An EventBase of the pool.  The connection it was picked for counts
+  /// against it while the lease lives.
+  class Lease {
+   public:
+    Lease(std::shared_ptr<std::atomic<size_t>> connections, folly::EventBase&);
+    ~Lease();
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    folly::EventBase& eventBase() const {
+      return eventBase_;
+    }
+
+   private:
+    const std::shared_ptr<std::atomic<size_t>> connections_;
+    folly::EventBase& eventBase_;
+  };
+
+  explicit IOThreadPool(size_t threads, Policy policy = Policy::ROUND_ROBIN);
+  ~IOThreadPool();
+
+  IOThreadPool(const IOThreadPool&) = delete;
+  IOThreadPool& operator=(const IOThreadPool&) = delete;
+
+  /// Picks the EventBase of a new connection.
+  std::shared_ptr<Lease> lease();
+
+  /// The EventBases of the threads, in order.
+  std::vector<folly::EventBase*> eventBases() const;
+
+  /// The leases live on the EventBase of thread `index`.
+  size_t connections(size_t index) const;
+
+ private:
+  struct Thread;
+
+  size_t pick();
+
+  const Policy policy_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+  std::atomic<size_t> next_{0};
+};
+
+} // namespace rsocket
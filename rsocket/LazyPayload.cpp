@@ -0,0 +1,55 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/LazyPayload.h"
+
+#include <folly/io/Cursor.h>
+
+namespace rsocket {
+
+LazyPayload::LazyPayload(std::unique_ptr<folly::IOBuf> frame, Layout layout)
+    : frame_(std::move(frame)),
+      layout_(layout),
+      frameLength_(frame_->computeChainDataLength()) {
+  DCHECK_LE(layout_.dataOffset, frameLength_);
+}
+
+MetadataView LazyPayload::metadataView() const {
+  if (!hasMetadata()) {
+    return MetadataView();
+  }
+  folly::io::Cursor cursor(frame_.get());
+  cursor.skip(*layout_.metadataOffset);
+  return MetadataView(cursor, layout_.metadataLength);
+}
+
+std::unique_ptr<folly::IOBuf> LazyPayload::cloneMetadata() const {
+  if (!hasMetadata()) {
+    return nullptr;
+  }
+  return cloneRange(*layout_.metadataOffset, layout_.metadataLength);
+}
+
+std::unique_ptr<folly::IOBuf> LazyPayload::cloneData() const {
+  if (dataLength() == 0) {
+    return nullptr;
+  }
+  return cloneRange(layout_.dataOffset, dataLength());
+}
+
+Payload LazyPayload::materialize() && {
+  Payload payload(cloneData(), cloneMetadata());
+  frame_.reset();
+  return payload;
+}
+
+std::unique_ptr<folly::IOBuf> LazyPayload::cloneRange(
+    size_t offset,
+    size_t length) const {
+  folly::io::Cursor cursor(frame_.get());
+  cursor.skip(offset);
+  std::unique_ptr<folly::IOBuf> range;
+  cursor.clone(range, length);
+  return range;
+}
+
+} // namespace rsocket
@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/Optional.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/MetadataView.h"
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/// The payload of a received request, left in the buffers of its frame.  The
+/// metadata and the data are only cloned out of the frame when they are
+/// asked for, so that handlers which only read the metadata, or forward the
+/// frame as it is, don't pay for building a Payload.
+/// See RSocketResponder::handlesLazyPayloads().
+class LazyPayload {
+ public:
+  /// Where the metadata and the data are in the frame, as offsets from its
+  /// first byte.  The data runs to the end of the frame.
+  struct Layout {
+    /// folly::none for frames without metadata.
+    folly::Optional<size_t> metadataOffset;
+    size_t metadataLength{0};
+    size_t dataOffset{0};
+  };
+
+  LazyPayload(std::unique_ptr<folly::IOBuf> frame, Layout layout);
+
+  /// A view of the metadata, which neither copies nor allocates.  It is only
+  /// valid as long as this LazyPayload.
+  MetadataView metadataView() const;
+
+  bool hasMetadata() const {
+    return layout_.metadataOffset.hasValue();
+  }
+
+  size_t dataLength() const {
+    return frameLength_ - layout_.dataOffset;
+  }
+
+  /// Clones of the metadata and the data out of the frame, like the ones of
+  /// the Payload built when the frame is deserialized.  nullptr if there is
+  /// no metadata, or no data.
+  std::unique_ptr<folly::IOBuf> cloneMetadata() const;
+  std::unique_ptr<folly::IOBuf> cloneData() const;
+
+  /// The whole serialized frame, header included.
+  const folly::IOBuf& frame() const {
+    return *frame_;
+  }
+
+  std::unique_ptr<folly::IOBuf> moveFrame() && {
+    return std::move(frame_);
+  }
+
+  /// Clones the metadata and the data out of the frame, and releases it.
+  Payload materialize() &&;
+
+ private:
+  std::unique_ptr<folly::IOBuf> cloneRange(size_t offset, size_t length)
+      const;
+
+  std::unique_ptr<folly::IOBuf> frame_;
+  Layout layout_;
+  size_t frameLength_;
+};
+
+} // namespace rsocket
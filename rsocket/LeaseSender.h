@@ -0,0 +1,61 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace rsocket {
+
+/// Permission for the peer to send up to `numberOfRequests` new requests
+/// within `ttl` of receiving the lease.
+struct Lease {
+  Lease(std::chrono::milliseconds _ttl, uint32_t _numberOfRequests)
+      : ttl(_ttl), numberOfRequests(_numberOfRequests) {}
+
+  std::chrono::milliseconds ttl;
+  uint32_t numberOfRequests;
+};
+
+// This class decides which leases a server issues to a client which asked for
+// leases in its SETUP frame.  It is handed to the RSocketServer through
+// RSocketConnectionParams, one instance per connection.
+//
+// The server asks for a lease as soon as the connection is established, and
+// then each time the previous lease expires.  Requests which arrive without a
+// lease are rejected by the server, and clients fail them locally before they
+// are sent, so load is shed before it reaches the responder.
+//
+// The methods are called on the EventBase of the connection.
+class LeaseSender {
+ public:
+  virtual ~LeaseSender() = default;
+
+  // Returns the next lease to issue.  activeStreams is the number of streams
+  // currently open on the connection.  A lease for zero requests issues
+  // nothing, and the sender is asked again once its ttl elapses.
+  virtual Lease nextLease(size_t activeStreams) = 0;
+};
+
+// Keeps the number of concurrent streams on the connection under a limit by
+// only leasing the remaining capacity.
+class ConcurrencyLeaseSender : public LeaseSender {
+ public:
+  ConcurrencyLeaseSender(
+      size_t maxConcurrentStreams,
+      std::chrono::milliseconds ttl = std::chrono::seconds(1))
+      : maxConcurrentStreams_(maxConcurrentStreams), ttl_(ttl) {}
+
+  Lease nextLease(size_t activeStreams) override {
+    auto available = activeStreams < maxConcurrentStreams_
+        ? maxConcurrentStreams_ - activeStreams
+        : 0;
+    return Lease(ttl_, static_cast<uint32_t>(available));
+  }
+
+ private:
+  const size_t maxConcurrentStreams_;
+  const std::chrono::milliseconds ttl_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,75 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/MappedFile.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <folly/Exception.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+
+/// Where the pages of the region are mapped, for munmap.
+struct FileMapping {
+  void* base;
+  size_t length;
+};
+
+std::unique_ptr<folly::IOBuf> mapRegion(int fd, off_t offset, size_t length) {
+  if (length == 0) {
+    return folly::IOBuf::create(0);
+  }
+  // mmap wants an offset aligned on pages, the bytes in front of the region
+  // are mapped as well but left out of the buffer.
+  static const auto pageSize = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+  auto const skipped = static_cast<size_t>(offset % pageSize);
+  auto const mappedLength = skipped + length;
+  // Private writable pages, so that a write to the buffer, e.g. of a frame
+  // header into its headroom, never reaches the file.
+  auto base = mmap(
+      nullptr,
+      mappedLength,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE,
+      fd,
+      offset - static_cast<off_t>(skipped));
+  if (base == MAP_FAILED) {
+    folly::throwSystemError("mmap of the payload file failed");
+  }
+  // The pages are sent in order, reading ahead saves faults on the EventBase.
+  madvise(base, mappedLength, MADV_SEQUENTIAL);
+  madvise(base, mappedLength, MADV_WILLNEED);
+
+  auto mapping = new FileMapping{base, mappedLength};
+  // The buffer starts at the region, without headroom or tailroom.
+  return folly::IOBuf::takeOwnership(
+      static_cast<uint8_t*>(base) + skipped,
+      length,
+      [](void*, void* userData) {
+        auto mapping = static_cast<FileMapping*>(userData);
+        munmap(mapping->base, mapping->length);
+        delete mapping;
+      },
+      mapping);
+}
+
+} // namespace
+
+MappedFile::MappedFile(int fd, off_t offset, size_t length)
+    : region_(mapRegion(fd, offset, length)) {}
+
+Payload MappedFile::payload(
+    size_t offset,
+    size_t length,
+    std::unique_ptr<folly::IOBuf> metadata) const {
+  CHECK_LE(offset, size());
+  CHECK_LE(length, size() - offset);
+  auto data = region_->cloneOne();
+  data->trimStart(offset);
+  data->trimEnd(size() - offset - length);
+  return Payload(std::move(data), std::move(metadata));
+}
+}
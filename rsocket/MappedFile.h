@@ -0,0 +1,54 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <sys/types.h>
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/// A region of a file mapped once, e.g. a static blob served to many streams.
+/// The payloads made from it share the mapped pages, with the reference count
+/// of their IOBufs: the region is unmapped once the MappedFile and all of its
+/// payloads are gone, so the memory stays that of one copy of the file in the
+/// page cache however many streams send it at once.
+///
+/// The mapping stays valid once the file descriptor is closed, but the file
+/// must not shrink while it is alive.  The pages are mapped private, so writes
+/// to the payloads never reach the file.
+class MappedFile {
+ public:
+  /// Maps `length` bytes of the file `fd` from `offset`.  Throws
+  /// std::system_error if the file can't be mapped.
+  MappedFile(int fd, off_t offset, size_t length);
+
+  MappedFile(MappedFile&&) = default;
+  MappedFile& operator=(MappedFile&&) = default;
+
+  size_t size() const {
+    return region_->length();
+  }
+
+  /// A payload with the `length` bytes of the region from `offset` as the
+  /// data, sharing the mapping.
+  Payload payload(
+      size_t offset,
+      size_t length,
+      std::unique_ptr<folly::IOBuf> metadata = std::unique_ptr<folly::IOBuf>())
+      const;
+
+  /// A payload with the whole region as the data.
+  Payload payload(
+      std::unique_ptr<folly::IOBuf> metadata = std::unique_ptr<folly::IOBuf>())
+      const {
+    return payload(0, size(), std::move(metadata));
+  }
+
+ private:
+  std::unique_ptr<folly::IOBuf> region_;
+};
+}
@@ -0,0 +1,51 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/MemoryGovernor.h"
+
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace rsocket {
+
+constexpr size_t MemoryGovernor::kResumeSteps;
+
+MemoryGovernor::MemoryGovernor(Options options)
+    : options_(options),
+      shrinkBytes_(std::llround(options_.budget * options_.shrinkAt)),
+      rejectBytes_(std::llround(options_.budget * options_.rejectAt)) {
+  CHECK_GT(options_.budget, 0U);
+  CHECK_LE(options_.shrinkAt, options_.rejectAt);
+}
+
+void MemoryGovernor::update(size_t& reported, size_t bytes) {
+  if (bytes > reported) {
+    usage_.fetch_add(bytes - reported, std::memory_order_relaxed);
+  } else if (bytes < reported) {
+    usage_.fetch_sub(reported - bytes, std::memory_order_relaxed);
+  }
+  reported = bytes;
+}
+
+MemoryGovernor::Level MemoryGovernor::level() const {
+  auto const used = usage();
+  if (used >= rejectBytes_) {
+    return Level::REJECTING;
+  }
+  return used >= shrinkBytes_ ? Level::SHRINKING : Level::NORMAL;
+}
+
+double MemoryGovernor::resumeFraction() const {
+  auto const used = usage();
+  if (used < shrinkBytes_) {
+    return 1;
+  }
+  if (used >= options_.budget) {
+    return 0;
+  }
+  auto const left = options_.budget - used;
+  auto const steps = left * kResumeSteps / (options_.budget - shrinkBytes_);
+  return static_cast<double>(steps) / kResumeSteps;
+}
+
+} // namespace rsocket
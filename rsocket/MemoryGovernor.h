@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace rsocket {
+
+/**
+ * Memory budget of all the connections of a process, see
+ * RSocketServer::setMemoryGovernor().  Rather than having the process killed
+ * for running out of memory in a traffic spike, the connections degrade as
+ * their usage approaches the budget.
+ *
+ * Each connection reports the bytes it holds as it reads and writes frames,
+ * counted as for its ConnectionMemoryLimits: its resume buffer, its pending
+ * frames, the partial frames it reassembles and the buffers of its transport.
+ * Past `shrinkAt` of the budget, the resume buffers are progressively shrunk,
+ * down to nothing at the budget, evicting their oldest frames, and the
+ * windows the stream requesters grant ahead of their subscribers (see
+ * AdaptiveRequestN) are cut back to their minimum.  Past `rejectAt`, new
+ * streams of the peers are also rejected with REJECTED.  Everything comes
+ * back as the usage goes down.
+ *
+ * Share one governor between the servers of a process to have them share the
+ * budget.  Thread safe.
+ */
+class MemoryGovernor {
+ public:
+  struct Options {
+    size_t budget{0};
+    /// Fractions of the budget.
+    double shrinkAt{0.7};
+    double rejectAt{0.9};
+  };
+
+  enum class Level {
+    NORMAL,
+    SHRINKING,
+    REJECTING,
+  };
+
+  /// Resume buffers are shrunk in steps of 1/kResumeSteps of their capacity,
+  /// so that they aren't resized as every frame is written.
+  static constexpr size_t kResumeSteps = 8;
+
+  explicit MemoryGovernor(Options options);
+
+  /// Replaces the bytes a connection reported, `reported`, with `bytes`.
+  void update(size_t& reported, size_t bytes);
+
+  /// Bytes held by all the connections.
+  size_t usage() const {
+    return usage_.load(std::memory_order_relaxed);
+  }
+
+  Level level() const;
+
+  /// The fraction of their capacity the resume buffers may hold at the
+  /// current usage, in steps of 1/kResumeSteps.
+  double resumeFraction() const;
+
+ private:
+  const Options options_;
+  /// The fractions of the budget, in bytes.
+  const size_t shrinkBytes_;
+  const size_t rejectBytes_;
+  std::atomic<size_t> usage_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,57 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/Cursor.h>
+
+namespace rsocket {
+
+/// A read-only view of the metadata of a received frame, over the buffers of
+/// the frame itself.  Reading it neither copies nor allocates.  The frame is
+/// owned by the caller, so the view is only valid for the duration of the call
+/// it is passed to.
+class MetadataView {
+ public:
+  /// The view of a frame without metadata.
+  MetadataView() = default;
+
+  /// `cursor` is positioned at the first of `length` bytes of metadata.
+  MetadataView(folly::io::Cursor cursor, size_t length)
+      : cursor_(std::move(cursor)), length_(length) {}
+
+  /// Whether the frame carries metadata, which may still be empty.
+  bool hasMetadata() const {
+    return cursor_.hasValue();
+  }
+
+  size_t length() const {
+    return length_;
+  }
+
+  /// A cursor positioned at the metadata.  The bytes past length() are the
+  /// data of the frame.
+  folly::io::Cursor cursor() const {
+    DCHECK(hasMetadata());
+    return *cursor_;
+  }
+
+  /// The metadata, if its bytes are contiguous in memory, which they are
+  /// unless the frame straddles read buffers.
+  folly::Optional<folly::ByteRange> contiguousBytes() const {
+    if (!hasMetadata()) {
+      return folly::ByteRange();
+    }
+    if (cursor_->length() < length_) {
+      return folly::none;
+    }
+    return folly::ByteRange(cursor_->data(), length_);
+  }
+
+ private:
+  folly::Optional<folly::io::Cursor> cursor_;
+  size_t length_{0};
+};
+
+} // namespace rsocket
@@ -3,10 +3,31 @@
 #include "rsocket/Payload.h"
 #include <folly/String.h>
 #include <folly/io/Cursor.h>
+#include "rsocket/MappedFile.h"
 #include "rsocket/framing/Frame.h"
 
 namespace rsocket {
 
+namespace {
+
+/// Strings up to this size are copied into an IOBuf::createCombined buffer,
+/// which takes as many allocations as owning the string.
+constexpr size_t kMaxCopiedBytes = 1024;
+
+std::unique_ptr<folly::IOBuf> wrapString(std::string&& str) {
+  if (str.size() <= kMaxCopiedBytes) {
+    return folly::IOBuf::copyBuffer(str);
+  }
+  auto owner = new std::string(std::move(str));
+  return folly::IOBuf::takeOwnership(
+      &(*owner)[0],
+      owner->size(),
+      [](void*, void* userData) { delete static_cast<std::string*>(userData); },
+      owner);
+}
+
+} // namespace
+
 Payload::Payload(
     std::unique_ptr<folly::IOBuf> _data,
     std::unique_ptr<folly::IOBuf> _metadata)
@@ -19,6 +40,23 @@ Payload::Payload(const std::string& _data, const std::string& _metadata)
   }
 }
 
+Payload Payload::wrap(std::string&& _data, std::string&& _metadata) {
+  Payload payload;
+  payload.data = wrapString(std::move(_data));
+  if (!_metadata.empty()) {
+    payload.metadata = wrapString(std::move(_metadata));
+  }
+  return payload;
+}
+
+Payload Payload::fromFile(
+    int fd,
+    off_t offset,
+    size_t length,
+    std::unique_ptr<folly::IOBuf> _metadata) {
+  return MappedFile(fd, offset, length).payload(std::move(_metadata));
+}
+
 void Payload::checkFlags(FrameFlags flags) const {
   DCHECK(!!(flags & FrameFlags::METADATA) == bool(metadata));
 }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <folly/io/IOBuf.h>
+#include <sys/types.h>
 #include <memory>
 #include <string>
 
@@ -23,6 +24,27 @@ struct Payload {
       const std::string& data,
       const std::string& metadata = std::string());
 
+  /// Takes ownership of the strings instead of copying them.  Strings small
+  /// enough for a single allocation of IOBuf and bytes are copied anyway,
+  /// that is cheaper than keeping the string alive.  Empty metadata is left
+  /// null, like with the copying constructor.
+  static Payload wrap(
+      std::string&& data,
+      std::string&& metadata = std::string());
+
+  /// Maps `length` bytes of the file `fd` from `offset` as the data, instead
+  /// of reading them.  The frames carry the mapped pages, so TcpDuplexConnection
+  /// writes them from the page cache, without a copy through userspace with
+  /// TcpZeroCopy.  The mapping stays valid once `fd` is closed, but the file
+  /// must not shrink while it is alive.  Writes to the data stay private.
+  /// MappedFile maps a region once for many payloads.
+  /// Throws std::system_error if the file can't be mapped.
+  static Payload fromFile(
+      int fd,
+      off_t offset,
+      size_t length,
+      std::unique_ptr<folly::IOBuf> metadata = std::unique_ptr<folly::IOBuf>());
+
   explicit operator bool() const {
     return data != nullptr || metadata != nullptr;
   }
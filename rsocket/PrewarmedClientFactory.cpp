@@ -0,0 +1,146 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/PrewarmedClientFactory.h"
+
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+
+namespace rsocket {
+
+struct PrewarmedClientFactory::State {
+  State(
+      std::shared_ptr<ConnectionFactory> _connectionFactory,
+      size_t _spares,
+      SetupParametersFactory _makeSetupParameters,
+      std::chrono::milliseconds _keepaliveInterval,
+      std::shared_ptr<RSocketStats> _stats)
+      : connectionFactory(std::move(_connectionFactory)),
+        spares(_spares),
+        makeSetupParameters(std::move(_makeSetupParameters)),
+        keepaliveInterval(_keepaliveInterval),
+        stats(std::move(_stats)) {}
+
+  const std::shared_ptr<ConnectionFactory> connectionFactory;
+  const size_t spares;
+  const SetupParametersFactory makeSetupParameters;
+  const std::chrono::milliseconds keepaliveInterval;
+  const std::shared_ptr<RSocketStats> stats;
+
+  std::mutex mutex;
+  std::deque<std::unique_ptr<RSocketClient>> ready;
+  /// Number of spares being connected.
+  size_t connecting{0};
+  /// Fulfilled once connecting drops to 0.
+  std::vector<folly::Promise<folly::Unit>> waiters;
+};
+
+PrewarmedClientFactory::PrewarmedClientFactory(
+    std::shared_ptr<ConnectionFactory> connectionFactory,
+    size_t spares,
+    SetupParametersFactory makeSetupParameters,
+    std::chrono::milliseconds keepaliveInterval,
+    std::shared_ptr<RSocketStats> stats)
+    : state_(std::make_shared<State>(
+          std::move(connectionFactory),
+          spares,
+          std::move(makeSetupParameters),
+          keepaliveInterval,
+          stats ? std::move(stats) : RSocketStats::noop())) {
+  CHECK(state_->connectionFactory);
+  connectSpares(state_);
+}
+
+PrewarmedClientFactory::~PrewarmedClientFactory() = default;
+
+folly::Future<std::unique_ptr<RSocketClient>>
+PrewarmedClientFactory::getClient() {
+  std::unique_ptr<RSocketClient> client;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (!state_->ready.empty()) {
+      client = std::move(state_->ready.front());
+      state_->ready.pop_front();
+    }
+  }
+  connectSpares(state_);
+  if (client) {
+    return folly::makeFuture(std::move(client));
+  }
+  return connect(*state_);
+}
+
+folly::Future<folly::Unit> PrewarmedClientFactory::waitForSpares() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (state_->connecting == 0) {
+    return folly::makeFuture();
+  }
+  state_->waiters.emplace_back();
+  return state_->waiters.back().getFuture();
+}
+
+size_t PrewarmedClientFactory::sparesReady() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->ready.size();
+}
+
+void PrewarmedClientFactory::connectSpares(
+    const std::shared_ptr<State>& state) {
+  size_t missing = 0;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    auto const planned = state->ready.size() + state->connecting;
+    missing = planned < state->spares ? state->spares - planned : 0;
+    state->connecting += missing;
+  }
+
+  std::weak_ptr<State> weakState = state;
+  for (size_t i = 0; i < missing; ++i) {
+    connect(*state).then(
+        [weakState](folly::Try<std::unique_ptr<RSocketClient>> client) {
+          auto state = weakState.lock();
+          if (!state) {
+            // The factory is gone, the client is closed.
+            return;
+          }
+          if (client.hasException()) {
+            VLOG(2) << "Could not connect a spare client: "
+                    << client.exception().what();
+          }
+          std::vector<folly::Promise<folly::Unit>> waiters;
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (client.hasValue()) {
+              state->ready.push_back(std::move(client.value()));
+            }
+            if (--state->connecting == 0) {
+              waiters = std::move(state->waiters);
+            }
+          }
+          for (auto& waiter : waiters) {
+            waiter.setValue();
+          }
+        });
+  }
+}
+
+folly::Future<std::unique_ptr<RSocketClient>> PrewarmedClientFactory::connect(
+    const State& state) {
+  return RSocket::createConnectedClient(
+             state.connectionFactory,
+             state.makeSetupParameters(),
+             std::make_shared<RSocketResponder>(),
+             state.keepaliveInterval,
+             state.stats)
+      .then([](std::unique_ptr<RSocketClient> client) {
+        auto answered = client->getRequester()->ping();
+        return answered.then([client = std::move(client)]() mutable {
+          return std::move(client);
+        });
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <folly/futures/Future.h>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketParameters.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/**
+ * Hands out RSocketClients which are already connected, so that the first
+ * request of a caller doesn't wait for the connection and the SETUP.
+ *
+ * Keeps `spares` clients connected ahead of time, all of them connected in
+ * parallel from the start.  A client is only a spare once the server has
+ * answered a keepalive on it (see RSocketRequester::ping), which proves it
+ * accepted the SETUP.  Every client handed out is replaced, and spares which
+ * failed to connect are retried when the next client is asked for.  Spares
+ * aren't checked again: one whose connection broke while waiting is handed
+ * out as it is, with its requests failing.
+ *
+ * The methods can be called from any thread.
+ */
+class PrewarmedClientFactory {
+ public:
+  using SetupParametersFactory = std::function<SetupParameters()>;
+
+  PrewarmedClientFactory(
+      std::shared_ptr<ConnectionFactory> connectionFactory,
+      size_t spares,
+      SetupParametersFactory makeSetupParameters = [] {
+        return SetupParameters();
+      },
+      std::chrono::milliseconds keepaliveInterval = kDefaultKeepaliveInterval,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+
+  ~PrewarmedClientFactory();
+
+  PrewarmedClientFactory(const PrewarmedClientFactory&) = delete;
+  PrewarmedClientFactory& operator=(const PrewarmedClientFactory&) = delete;
+
+  /// A spare if one is ready, otherwise a client connected for the caller.
+  folly::Future<std::unique_ptr<RSocketClient>> getClient();
+
+  /// Fulfilled once no spare is being connected anymore, whether they all
+  /// connected or some failed.
+  folly::Future<folly::Unit> waitForSpares();
+
+  /// Number of spares ready to be handed out.
+  size_t sparesReady() const;
+
+ private:
+  struct State;
+
+  /// Connects as many spares as are missing.
+  static void connectSpares(const std::shared_ptr<State>&);
+
+  /// Connects a client and waits for the server to answer a keepalive.
+  static folly::Future<std::unique_ptr<RSocketClient>> connect(const State&);
+
+  const std::shared_ptr<State> state_;
+};
+
+} // namespace rsocket
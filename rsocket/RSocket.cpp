@@ -54,6 +54,65 @@ folly::Future<std::unique_ptr<RSocketClient>> RSocket::createConnectedClient(
   });
 }
 
+folly::Future<std::unique_ptr<RSocketClient>> RSocket::createConnectedClient(
+    std::shared_ptr<ConnectionFactory> connectionFactory,
+    std::shared_ptr<IOThreadPool> ioThreads,
+    SetupParameters setupParameters,
+    std::shared_ptr<RSocketResponder> responder,
+    std::chrono::milliseconds keepaliveInterval,
+    std::shared_ptr<RSocketStats> stats,
+    std::shared_ptr<RSocketConnectionEvents> connectionEvents,
+    std::shared_ptr<ResumeManager> resumeManager,
+    std::shared_ptr<ColdResumeHandler> coldResumeHandler) {
+  CHECK(ioThreads);
+  auto lease = ioThreads->lease();
+  auto* eventBase = &lease->eventBase();
+  return connectionFactory->connectOn(*eventBase).then([
+    connectionFactory,
+    lease = std::move(lease),
+    setupParameters = std::move(setupParameters),
+    responder = std::move(responder),
+    keepaliveInterval,
+    stats = std::move(stats),
+    connectionEvents = std::move(connectionEvents),
+    resumeManager = std::move(resumeManager),
+    coldResumeHandler = std::move(coldResumeHandler)
+  ](ConnectionFactory::ConnectedDuplexConnection connection) mutable {
+    // Factories which can't connect on the leased EventBase hop, like the
+    // clients of an explicit state machine EventBase.
+    auto* transportEvb = &connection.eventBase;
+    auto* stateMachineEvb = &lease->eventBase();
+    return via(transportEvb, [
+      connection = std::move(connection),
+      connectionFactory = std::move(connectionFactory),
+      lease = std::move(lease),
+      setupParameters = std::move(setupParameters),
+      responder = std::move(responder),
+      keepaliveInterval,
+      stats = std::move(stats),
+      connectionEvents = std::move(connectionEvents),
+      resumeManager = std::move(resumeManager),
+      coldResumeHandler = std::move(coldResumeHandler),
+      stateMachineEvb
+    ]() mutable {
+      auto client = RSocket::createClientFromConnection(
+          std::move(connection.connection),
+          connection.eventBase,
+          std::move(setupParameters),
+          std::move(connectionFactory),
+          std::move(responder),
+          keepaliveInterval,
+          std::move(stats),
+          std::move(connectionEvents),
+          std::move(resumeManager),
+          std::move(coldResumeHandler),
+          stateMachineEvb);
+      client->ioThreadLease_ = std::move(lease);
+      return client;
+    });
+  });
+}
+
 folly::Future<std::unique_ptr<RSocketClient>> RSocket::createResumedClient(
     std::shared_ptr<ConnectionFactory> connectionFactory,
     ResumeIdentificationToken token,
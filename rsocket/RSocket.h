@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "rsocket/IOThreadPool.h"
 #include "rsocket/RSocketClient.h"
 #include "rsocket/RSocketServer.h"
 
@@ -28,6 +29,24 @@ class RSocket {
           std::shared_ptr<ColdResumeHandler>(),
       folly::EventBase* stateMachineEvb = nullptr);
 
+  // Creates a RSocketClient connected on an EventBase of `ioThreads`, see
+  // IOThreadPool and ConnectionFactory::connectOn.  Its state machine lives
+  // on the same EventBase.  A resumption connects through
+  // ConnectionFactory::connect.
+  static folly::Future<std::unique_ptr<RSocketClient>> createConnectedClient(
+      std::shared_ptr<ConnectionFactory>,
+      std::shared_ptr<IOThreadPool> ioThreads,
+      SetupParameters setupParameters = SetupParameters(),
+      std::shared_ptr<RSocketResponder> responder =
+          std::make_shared<RSocketResponder>(),
+      std::chrono::milliseconds keepaliveInterval = kDefaultKeepaliveInterval,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      std::shared_ptr<RSocketConnectionEvents> connectionEvents =
+          std::shared_ptr<RSocketConnectionEvents>(),
+      std::shared_ptr<ResumeManager> resumeManager = nullptr,
+      std::shared_ptr<ColdResumeHandler> coldResumeHandler =
+          std::shared_ptr<ColdResumeHandler>());
+
   // Creates a RSocketClient which cold-resumes from the provided state
   // keepaliveInterval of 0 will result in no keepAlives
   static folly::Future<std::unique_ptr<RSocketClient>> createResumedClient(
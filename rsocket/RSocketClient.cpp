@@ -4,11 +4,14 @@
 #include "rsocket/RSocketRequester.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
+#include "rsocket/framing/CompressedDuplexConnection.h"
 #include "rsocket/framing/FrameTransportImpl.h"
 #include "rsocket/framing/FramedDuplexConnection.h"
 #include "rsocket/framing/ScheduledFrameTransport.h"
 #include "rsocket/internal/ClientResumeStatusCallback.h"
 #include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/internal/StreamCompressor.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
 
 using namespace folly;
 
@@ -92,7 +95,9 @@ folly::Future<folly::Unit> RSocketClient::resume() {
           framedConnection = std::move(connection.connection);
         } else {
           framedConnection = std::make_unique<FramedDuplexConnection>(
-              std::move(connection.connection), protocolVersion_);
+              std::move(connection.connection),
+              protocolVersion_,
+              maxFrameLength_);
         }
         auto transport =
             yarpl::make_ref<FrameTransportImpl>(std::move(framedConnection));
@@ -164,12 +169,30 @@ void RSocketClient::fromConnection(
     evb_ = &transportEvb;
   }
   createState();
+  maxFrameLength_ = setupParameters.maxFrameLength;
+  auto& compression = setupParameters.connectionCompression;
   std::unique_ptr<DuplexConnection> framedConnection;
   if (connection->isFramed()) {
+    compression.codec = ConnectionCompression::Codec::NONE;
     framedConnection = std::move(connection);
   } else {
+    // The compression is asked for in the composite metadata of the 1.0
+    // SETUP.
+    if (compression.codec != ConnectionCompression::Codec::NONE &&
+        setupParameters.protocolVersion != ProtocolVersion::Unknown &&
+        setupParameters.protocolVersion.major >= 1 &&
+        setupParameters.metadataMimeType == kCompositeMetadataMimeType &&
+        StreamCompressor::create(compression.codec, compression.level) &&
+        StreamDecompressor::create(compression.codec)) {
+      connection = CompressedDuplexConnection::client(
+          std::move(connection), compression, maxFrameLength_);
+    } else {
+      compression.codec = ConnectionCompression::Codec::NONE;
+    }
     framedConnection = std::make_unique<FramedDuplexConnection>(
-        std::move(connection), setupParameters.protocolVersion);
+        std::move(connection),
+        setupParameters.protocolVersion,
+        maxFrameLength_);
   }
   auto transport =
       yarpl::make_ref<FrameTransportImpl>(std::move(framedConnection));
@@ -7,6 +7,7 @@
 #include "rsocket/ColdResumeHandler.h"
 #include "rsocket/ConnectionFactory.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/IOThreadPool.h"
 #include "rsocket/RSocketConnectionEvents.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketRequester.h"
@@ -83,6 +84,8 @@ class RSocketClient {
 
   ProtocolVersion protocolVersion_;
   ResumeIdentificationToken token_;
+  // See SetupParameters::maxFrameLength, reused to resume.
+  size_t maxFrameLength_{kMaxFrameLength};
 
   // Remember the StateMachine's evb (supplied through constructor).  If no
   // EventBase is provided, the underlying transport's EventBase will be used
@@ -95,5 +98,7 @@ class RSocketClient {
   // resumption, and vice versa.
   folly::EventBase* evb_{nullptr};
 
+  // The EventBase of the IOThreadPool the client was connected on, if any.
+  std::shared_ptr<IOThreadPool::Lease> ioThreadLease_;
 };
 }
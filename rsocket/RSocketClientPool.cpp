@@ -0,0 +1,930 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/RSocketClientPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+
+#include <folly/Optional.h>
+#include <folly/Random.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/metadata/StreamStripe.h"
+#include "yarpl/flowable/Flowables.h"
+
+namespace rsocket {
+
+namespace {
+using Counter = std::shared_ptr<std::atomic<size_t>>;
+
+/// Counts a request as outstanding on a connection until it terminates or
+/// gets cancelled.
+class OutstandingRequest {
+ public:
+  explicit OutstandingRequest(Counter outstanding)
+      : outstanding_(std::move(outstanding)) {
+    ++*outstanding_;
+  }
+
+  ~OutstandingRequest() {
+    done();
+  }
+
+  void done() {
+    if (!done_.exchange(true)) {
+      --*outstanding_;
+    }
+  }
+
+ private:
+  const Counter outstanding_;
+  std::atomic<bool> done_{false};
+};
+
+class OutstandingSubscriber : public yarpl::flowable::Subscriber<Payload>,
+                              public yarpl::flowable::Subscription {
+ public:
+  OutstandingSubscriber(
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> inner,
+      Counter outstanding)
+      : inner_(std::move(inner)), request_(std::move(outstanding)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    subscription_ = std::move(subscription);
+    inner_->onSubscribe(this->ref_from_this(this));
+  }
+
+  void onNext(Payload payload) override {
+    inner_->onNext(std::move(payload));
+  }
+
+  void onComplete() override {
+    request_.done();
+    inner_->onComplete();
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    request_.done();
+    inner_->onError(std::move(ex));
+  }
+
+  void request(int64_t n) override {
+    subscription_->request(n);
+  }
+
+  void cancel() override {
+    request_.done();
+    subscription_->cancel();
+  }
+
+ private:
+  yarpl::Reference<yarpl::flowable::Subscriber<Payload>> inner_;
+  yarpl::Reference<yarpl::flowable::Subscription> subscription_;
+  OutstandingRequest request_;
+};
+
+class OutstandingSingleObserver
+    : public yarpl::single::SingleObserver<Payload>,
+      public yarpl::single::SingleSubscription {
+ public:
+  OutstandingSingleObserver(
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> inner,
+      Counter outstanding)
+      : inner_(std::move(inner)), request_(std::move(outstanding)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::single::SingleSubscription> subscription)
+      override {
+    subscription_ = std::move(subscription);
+    inner_->onSubscribe(this->ref_from_this(this));
+  }
+
+  void onSuccess(Payload payload) override {
+    request_.done();
+    inner_->onSuccess(std::move(payload));
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    request_.done();
+    inner_->onError(std::move(ex));
+  }
+
+  void cancel() override {
+    request_.done();
+    subscription_->cancel();
+  }
+
+ private:
+  yarpl::Reference<yarpl::single::SingleObserver<Payload>> inner_;
+  yarpl::Reference<yarpl::single::SingleSubscription> subscription_;
+  OutstandingRequest request_;
+};
+
+} // namespace
+
+struct RSocketClientPool::Connection {
+  explicit Connection(std::unique_ptr<RSocketClient> _client)
+      : client(std::move(_client)),
+        outstanding(std::make_shared<std::atomic<size_t>>(0)),
+        eventBase(&client->getRequester()->getEventBase()) {}
+
+  std::shared_ptr<RSocketClient> client;
+  Counter outstanding;
+  /// Of the requester of the client.
+  folly::EventBase* eventBase;
+};
+
+struct RSocketClientPool::History {
+  static constexpr size_t kLatencies = 128;
+  /// Latencies needed before the adaptive hedge delay is used.
+  static constexpr size_t kMinLatencies = 20;
+  /// Latencies recorded between two computations of the percentile.
+  static constexpr size_t kPercentileInterval = 16;
+
+  History() : balance(budget.maxBalance) {}
+
+  void setBudget(RetryBudget _budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = _budget;
+    balance = budget.maxBalance;
+  }
+
+  /// Saves up the share of the budget of a request.
+  void deposit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    balance = std::min(balance + budget.ratio, budget.maxBalance);
+  }
+
+  /// Takes a copy out of the budget, returns false if it is empty.
+  bool withdraw() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (balance < 1) {
+      return false;
+    }
+    balance -= 1;
+    return true;
+  }
+
+  void recordLatency(std::chrono::microseconds latency) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (latencies.size() < kLatencies) {
+      latencies.push_back(latency);
+    } else {
+      latencies[nextLatency] = latency;
+    }
+    nextLatency = (nextLatency + 1) % kLatencies;
+    if (latencies.size() >= kMinLatencies &&
+        (++sincePercentile >= kPercentileInterval || !p95)) {
+      sincePercentile = 0;
+      auto sorted = latencies;
+      auto nth = sorted.begin() + sorted.size() * 95 / 100;
+      std::nth_element(sorted.begin(), nth, sorted.end());
+      p95 = *nth;
+    }
+  }
+
+  folly::Optional<std::chrono::microseconds> latencyP95() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return p95;
+  }
+
+  std::mutex mutex;
+  RetryBudget budget;
+  double balance;
+  /// The recent latencies, oldest first from nextLatency on once full.
+  std::vector<std::chrono::microseconds> latencies;
+  size_t nextLatency{0};
+  size_t sincePercentile{0};
+  folly::Optional<std::chrono::microseconds> p95;
+};
+
+/// A request-response sent with a RequestPolicy, which is the subscription of
+/// its observer.  Each copy of the request is an attempt, the first one to
+/// succeed wins and the others are cancelled.  The attempts complete on the
+/// EventBases of their connections, and the hedge timer on the Timekeeper
+/// of folly, hence the lock.
+class RSocketClientPool::PolicyRequest
+    : public yarpl::single::SingleSubscription {
+ public:
+  PolicyRequest(
+      std::shared_ptr<const Connections> connections,
+      std::shared_ptr<History> history,
+      Payload request,
+      RequestPolicy policy,
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer)
+      : connections_(std::move(connections)),
+        history_(std::move(history)),
+        request_(std::move(request)),
+        policy_(policy),
+        observer_(std::move(observer)) {}
+
+  void start() {
+    history_->deposit();
+    send(nullptr);
+
+    auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+        policy_.hedgeDelay);
+    if (policy_.adaptiveHedgeDelay && delay.count() > 0) {
+      if (auto p95 = history_->latencyP95()) {
+        delay = std::max(*p95, std::chrono::microseconds(1));
+      }
+    }
+    if (delay.count() > 0) {
+      folly::futures::sleep(delay).then(
+          [self = this->ref_from_this(this)] { self->hedge(); });
+    }
+  }
+
+  void cancel() override {
+    std::vector<yarpl::Reference<yarpl::single::SingleSubscription>> losers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_) {
+        return;
+      }
+      losers = finish();
+      observer_ = nullptr;
+    }
+    for (auto& loser : losers) {
+      loser->cancel();
+    }
+  }
+
+ private:
+  class AttemptObserver;
+
+  struct Attempt {
+    explicit Attempt(const Connection& _connection)
+        : connection(&_connection), sent(std::chrono::steady_clock::now()) {}
+
+    const Connection* connection;
+    std::chrono::steady_clock::time_point sent;
+    yarpl::Reference<yarpl::single::SingleSubscription> subscription;
+    bool done{false};
+  };
+
+  /// Sends an attempt, on another connection than `previous` if possible.
+  void send(const Connection* previous) {
+    Payload request;
+    size_t index;
+    const Connection* connection;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      connection = &pickOther(*connections_, previous);
+      index = attempts_.size();
+      attempts_.emplace_back(*connection);
+      request = request_.clone();
+    }
+    connection->client->getRequester()
+        ->requestResponse(std::move(request))
+        ->subscribe(yarpl::make_ref<OutstandingSingleObserver>(
+            yarpl::make_ref<AttemptObserver>(
+                this->ref_from_this(this), index),
+            connection->outstanding));
+  }
+
+  void hedge() {
+    const Connection* previous;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_ || hedged_) {
+        return;
+      }
+      hedged_ = true;
+      previous = attempts_.back().connection;
+    }
+    if (history_->withdraw()) {
+      send(previous);
+    }
+  }
+
+  void onAttemptSubscribe(
+      size_t index,
+      yarpl::Reference<yarpl::single::SingleSubscription> subscription) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!finished_) {
+        attempts_[index].subscription = std::move(subscription);
+        return;
+      }
+    }
+    // Lost before it got its subscription.
+    subscription->cancel();
+  }
+
+  void onAttemptSuccess(size_t index, Payload payload) {
+    yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer;
+    std::vector<yarpl::Reference<yarpl::single::SingleSubscription>> losers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& attempt = attempts_[index];
+      attempt.done = true;
+      attempt.subscription = nullptr;
+      if (finished_) {
+        return;
+      }
+      history_->recordLatency(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - attempt.sent));
+      losers = finish();
+      observer = std::move(observer_);
+    }
+    for (auto& loser : losers) {
+      loser->cancel();
+    }
+    observer->onSuccess(std::move(payload));
+  }
+
+  void onAttemptError(size_t index, folly::exception_wrapper ex) {
+    yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer;
+    const Connection* previous;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& attempt = attempts_[index];
+      attempt.done = true;
+      attempt.subscription = nullptr;
+      previous = attempt.connection;
+      if (finished_) {
+        return;
+      }
+      for (auto const& other : attempts_) {
+        if (!other.done) {
+          // The hedge may still succeed.
+          return;
+        }
+      }
+      if (retries_ == policy_.maxRetries || !history_->withdraw()) {
+        finish();
+        observer = std::move(observer_);
+      } else {
+        ++retries_;
+      }
+    }
+    if (observer) {
+      observer->onError(std::move(ex));
+    } else {
+      send(previous);
+    }
+  }
+
+  /// Finishes the request, under the lock.  Returns the subscriptions of the
+  /// attempts still running, to cancel out of it.
+  std::vector<yarpl::Reference<yarpl::single::SingleSubscription>> finish() {
+    finished_ = true;
+    std::vector<yarpl::Reference<yarpl::single::SingleSubscription>> running;
+    for (auto& attempt : attempts_) {
+      if (!attempt.done && attempt.subscription) {
+        running.push_back(std::move(attempt.subscription));
+      }
+      attempt.done = true;
+    }
+    return running;
+  }
+
+  const std::shared_ptr<const Connections> connections_;
+  const std::shared_ptr<History> history_;
+  const Payload request_;
+  const RequestPolicy policy_;
+
+  std::mutex mutex_;
+  yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer_;
+  std::vector<Attempt> attempts_;
+  size_t retries_{0};
+  bool hedged_{false};
+  bool finished_{false};
+};
+
+class RSocketClientPool::PolicyRequest::AttemptObserver
+    : public yarpl::single::SingleObserver<Payload> {
+ public:
+  AttemptObserver(yarpl::Reference<PolicyRequest> request, size_t index)
+      : request_(std::move(request)), index_(index) {}
+
+  void onSubscribe(yarpl::Reference<yarpl::single::SingleSubscription>
+                       subscription) override {
+    request_->onAttemptSubscribe(index_, std::move(subscription));
+  }
+
+  void onSuccess(Payload payload) override {
+    request_->onAttemptSuccess(index_, std::move(payload));
+    request_ = nullptr;
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    request_->onAttemptError(index_, std::move(ex));
+    request_ = nullptr;
+  }
+
+ private:
+  yarpl::Reference<PolicyRequest> request_;
+  const size_t index_;
+};
+
+/// A stream striped across connections, which is the subscription of its
+/// subscriber.  The items of the stripes are queued until they are next in
+/// order and requested.  The stripes deliver on the EventBases of their
+/// connections, hence the lock; the items are passed on out of it, by one
+/// thread at a time.
+class RSocketClientPool::StripedStream
+    : public yarpl::flowable::Subscription {
+ public:
+  StripedStream(
+      size_t stripes,
+      size_t prefetch,
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber)
+      : prefetch_(static_cast<int64_t>(std::max<size_t>(prefetch, 1))),
+        stripes_(stripes),
+        subscriber_(std::move(subscriber)) {}
+
+  /// Subscribes to stripe `index`, sent on `connection`.
+  void subscribeStripe(
+      size_t index,
+      const Connection& connection,
+      const Payload& request) {
+    auto stripe = request.clone();
+    addStreamStripe(
+        stripe,
+        StreamStripe{static_cast<uint32_t>(index),
+                     static_cast<uint32_t>(stripes_.size())});
+    connection.client->getRequester()
+        ->requestStream(std::move(stripe))
+        ->subscribe(yarpl::make_ref<OutstandingSubscriber>(
+            yarpl::make_ref<StripeSubscriber>(
+                this->ref_from_this(this), index),
+            connection.outstanding));
+  }
+
+  void request(int64_t n) override {
+    if (n <= 0) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto const max = std::numeric_limits<int64_t>::max();
+      requested_ = n > max - requested_ ? max : requested_ + n;
+    }
+    drain();
+  }
+
+  void cancel() override {
+    std::vector<yarpl::Reference<yarpl::flowable::Subscription>> running;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_) {
+        return;
+      }
+      running = finish();
+      subscriber_ = nullptr;
+    }
+    for (auto& subscription : running) {
+      subscription->cancel();
+    }
+  }
+
+ private:
+  class StripeSubscriber;
+
+  struct Stripe {
+    std::deque<Payload> queue;
+    yarpl::Reference<yarpl::flowable::Subscription> subscription;
+    /// Items passed on since the stripe was last requested more.
+    int64_t consumed{0};
+    bool completed{false};
+  };
+
+  void onStripeSubscribe(
+      size_t index,
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!finished_) {
+        stripes_[index].subscription = subscription;
+      }
+    }
+    if (finished()) {
+      subscription->cancel();
+    } else {
+      subscription->request(prefetch_);
+    }
+  }
+
+  void onStripeNext(size_t index, Payload payload) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_) {
+        return;
+      }
+      stripes_[index].queue.push_back(std::move(payload));
+    }
+    drain();
+  }
+
+  void onStripeComplete(size_t index) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stripes_[index].completed = true;
+      stripes_[index].subscription = nullptr;
+    }
+    drain();
+  }
+
+  void onStripeError(size_t index, folly::exception_wrapper ex) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stripes_[index].completed = true;
+      stripes_[index].subscription = nullptr;
+      if (finished_ || error_) {
+        return;
+      }
+      error_ = std::move(ex);
+    }
+    drain();
+  }
+
+  bool finished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+  }
+
+  /// Passes on the items which are next in order while they are requested,
+  /// and the end of the stream once the stripe of the next item has ended.
+  void drain() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (draining_) {
+        // The thread draining will see what changed.
+        return;
+      }
+      draining_ = true;
+    }
+    while (true) {
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber;
+      folly::Optional<Payload> next;
+      folly::exception_wrapper error;
+      yarpl::Reference<yarpl::flowable::Subscription> replenish;
+      int64_t replenished = 0;
+      std::vector<yarpl::Reference<yarpl::flowable::Subscription>> running;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!subscriber_) {
+          draining_ = false;
+          return;
+        }
+        auto& stripe = stripes_[next_ % stripes_.size()];
+        if (error_) {
+          error = std::move(error_);
+          running = finish();
+          subscriber = std::move(subscriber_);
+        } else if (requested_ > 0 && !stripe.queue.empty()) {
+          next = std::move(stripe.queue.front());
+          stripe.queue.pop_front();
+          --requested_;
+          ++next_;
+          if (++stripe.consumed >= std::max<int64_t>(prefetch_ / 2, 1) &&
+              stripe.subscription) {
+            replenish = stripe.subscription;
+            replenished = stripe.consumed;
+            stripe.consumed = 0;
+          }
+          subscriber = subscriber_;
+        } else if (stripe.queue.empty() && stripe.completed) {
+          // The next item would have been on this stripe, the stream is over.
+          running = finish();
+          subscriber = std::move(subscriber_);
+        } else {
+          draining_ = false;
+          return;
+        }
+      }
+
+      for (auto& subscription : running) {
+        subscription->cancel();
+      }
+      if (next) {
+        subscriber->onNext(std::move(*next));
+        if (replenish) {
+          replenish->request(replenished);
+        }
+      } else if (error) {
+        subscriber->onError(std::move(error));
+      } else {
+        subscriber->onComplete();
+      }
+    }
+  }
+
+  /// Finishes the stream, under the lock.  Returns the subscriptions of the
+  /// stripes still running, to cancel out of it.
+  std::vector<yarpl::Reference<yarpl::flowable::Subscription>> finish() {
+    finished_ = true;
+    std::vector<yarpl::Reference<yarpl::flowable::Subscription>> running;
+    for (auto& stripe : stripes_) {
+      if (!stripe.completed && stripe.subscription) {
+        running.push_back(std::move(stripe.subscription));
+      }
+      stripe.subscription = nullptr;
+      stripe.queue.clear();
+    }
+    return running;
+  }
+
+  const int64_t prefetch_;
+
+  std::mutex mutex_;
+  std::vector<Stripe> stripes_;
+  yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber_;
+  folly::exception_wrapper error_;
+  int64_t requested_{0};
+  /// Index of the next item of the stream.
+  size_t next_{0};
+  bool draining_{false};
+  bool finished_{false};
+};
+
+class RSocketClientPool::StripedStream::StripeSubscriber
+    : public yarpl::flowable::Subscriber<Payload> {
+ public:
+  StripeSubscriber(yarpl::Reference<StripedStream> stream, size_t index)
+      : stream_(std::move(stream)), index_(index) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    stream_->onStripeSubscribe(index_, std::move(subscription));
+  }
+
+  void onNext(Payload payload) override {
+    stream_->onStripeNext(index_, std::move(payload));
+  }
+
+  void onComplete() override {
+    stream_->onStripeComplete(index_);
+    stream_ = nullptr;
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    stream_->onStripeError(index_, std::move(ex));
+    stream_ = nullptr;
+  }
+
+ private:
+  yarpl::Reference<StripedStream> stream_;
+  const size_t index_;
+};
+
+folly::Future<std::unique_ptr<RSocketClientPool>> RSocketClientPool::create(
+    std::vector<std::shared_ptr<ConnectionFactory>> factories,
+    size_t connectionsPerFactory,
+    SetupParametersFactory makeSetupParameters) {
+  CHECK(!factories.empty());
+  CHECK_GT(connectionsPerFactory, 0);
+
+  std::vector<folly::Future<std::unique_ptr<RSocketClient>>> clients;
+  for (auto& factory : factories) {
+    for (size_t i = 0; i < connectionsPerFactory; ++i) {
+      clients.push_back(
+          RSocket::createConnectedClient(factory, makeSetupParameters()));
+    }
+  }
+
+  return fromClients(std::move(clients));
+}
+
+folly::Future<std::unique_ptr<RSocketClientPool>> RSocketClientPool::create(
+    std::vector<std::shared_ptr<ConnectionFactory>> factories,
+    std::shared_ptr<IOThreadPool> ioThreads,
+    size_t connectionsPerFactory,
+    SetupParametersFactory makeSetupParameters) {
+  CHECK(!factories.empty());
+  CHECK(ioThreads);
+  CHECK_GT(connectionsPerFactory, 0);
+
+  std::vector<folly::Future<std::unique_ptr<RSocketClient>>> clients;
+  for (auto& factory : factories) {
+    for (size_t i = 0; i < connectionsPerFactory; ++i) {
+      clients.push_back(RSocket::createConnectedClient(
+          factory, ioThreads, makeSetupParameters()));
+    }
+  }
+
+  return fromClients(std::move(clients));
+}
+
+folly::Future<std::unique_ptr<RSocketClientPool>>
+RSocketClientPool::fromClients(
+    std::vector<folly::Future<std::unique_ptr<RSocketClient>>> clients) {
+  return folly::collect(clients).then(
+      [](std::vector<std::unique_ptr<RSocketClient>> connected) {
+        return std::unique_ptr<RSocketClientPool>(
+            new RSocketClientPool(std::move(connected)));
+      });
+}
+
+RSocketClientPool::RSocketClientPool(
+    std::vector<std::unique_ptr<RSocketClient>> clients)
+    : history_(std::make_shared<History>()) {
+  auto connections = std::make_shared<Connections>();
+  connections->reserve(clients.size());
+  for (auto& client : clients) {
+    connections->emplace_back(std::move(client));
+  }
+  connections_ = std::move(connections);
+}
+
+RSocketClientPool::~RSocketClientPool() = default;
+
+const RSocketClientPool::Connection& RSocketClientPool::pick(
+    const Connections& connections) {
+  auto const n = static_cast<uint32_t>(connections.size());
+  if (n == 1) {
+    return connections[0];
+  }
+  // Two distinct random connections, the less loaded one wins.
+  auto const first = folly::Random::rand32(n);
+  auto const second = (first + 1 + folly::Random::rand32(n - 1)) % n;
+  auto const& a = connections[std::min(first, second)];
+  auto const& b = connections[std::max(first, second)];
+  return *b.outstanding < *a.outstanding ? b : a;
+}
+
+const RSocketClientPool::Connection& RSocketClientPool::pick(
+    const Connections& connections,
+    bool affinity) {
+  if (!affinity) {
+    return pick(connections);
+  }
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase || !eventBase->isInEventBaseThread()) {
+    return pick(connections);
+  }
+  // The least loaded connection on the caller's EventBase, from a random
+  // start so that ties don't always go to the same one.
+  auto const n = connections.size();
+  auto const start = folly::Random::rand32(static_cast<uint32_t>(n));
+  const Connection* local = nullptr;
+  for (size_t i = 0; i < n; ++i) {
+    auto const& connection = connections[(start + i) % n];
+    if (connection.eventBase == eventBase &&
+        (!local || *connection.outstanding < *local->outstanding)) {
+      local = &connection;
+    }
+  }
+  return local ? *local : pick(connections);
+}
+
+const RSocketClientPool::Connection& RSocketClientPool::pickOther(
+    const Connections& connections,
+    const Connection* previous) {
+  auto const n = static_cast<uint32_t>(connections.size());
+  if (!previous || n == 1) {
+    return pick(connections);
+  }
+  if (n == 2) {
+    return &connections[0] == previous ? connections[1] : connections[0];
+  }
+  // Two distinct random connections out of the others.
+  auto const skipped = static_cast<uint32_t>(previous - connections.data());
+  auto const skip = [skipped](uint32_t i) { return i < skipped ? i : i + 1; };
+  auto const first = folly::Random::rand32(n - 1);
+  auto const second = (first + 1 + folly::Random::rand32(n - 2)) % (n - 1);
+  auto const& a = connections[skip(first)];
+  auto const& b = connections[skip(second)];
+  return *b.outstanding < *a.outstanding ? b : a;
+}
+
+std::vector<const RSocketClientPool::Connection*>
+RSocketClientPool::pickLeastLoaded(const Connections& connections, size_t n) {
+  // From a random start, so that ties don't always go to the same ones.
+  auto const size = connections.size();
+  auto const start = folly::Random::rand32(static_cast<uint32_t>(size));
+  std::vector<const Connection*> picked;
+  picked.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    picked.push_back(&connections[(start + i) % size]);
+  }
+  std::stable_sort(
+      picked.begin(),
+      picked.end(),
+      [](const Connection* a, const Connection* b) {
+        return *a->outstanding < *b->outstanding;
+      });
+  picked.resize(std::min(n, size));
+  return picked;
+}
+
+std::vector<size_t> RSocketClientPool::outstandingRequests() const {
+  std::vector<size_t> outstanding;
+  outstanding.reserve(connections_->size());
+  for (auto const& connection : *connections_) {
+    outstanding.push_back(*connection.outstanding);
+  }
+  return outstanding;
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+RSocketClientPool::requestStream(Payload request) {
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    connections = connections_,
+    affinity = affinity_.load(),
+    request = std::move(request)
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    auto const& connection = pick(*connections, affinity);
+    auto requester = connection.client->getRequester();
+    requester->requestStream(std::move(request))
+        ->subscribe(yarpl::make_ref<OutstandingSubscriber>(
+            std::move(subscriber), connection.outstanding));
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+RSocketClientPool::requestStripedStream(
+    Payload request,
+    size_t stripes,
+    size_t prefetch) {
+  CHECK_GT(stripes, 0);
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    connections = connections_,
+    request = std::move(request),
+    stripes,
+    prefetch
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) {
+    auto const picked = pickLeastLoaded(*connections, stripes);
+    auto stream = yarpl::make_ref<StripedStream>(
+        picked.size(), prefetch, subscriber);
+    subscriber->onSubscribe(stream);
+    for (size_t i = 0; i < picked.size(); ++i) {
+      stream->subscribeStripe(i, *picked[i], request);
+    }
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+RSocketClientPool::requestChannel(
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> requests) {
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    connections = connections_,
+    affinity = affinity_.load(),
+    requests = std::move(requests)
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    auto const& connection = pick(*connections, affinity);
+    auto requester = connection.client->getRequester();
+    requester->requestChannel(std::move(requests))
+        ->subscribe(yarpl::make_ref<OutstandingSubscriber>(
+            std::move(subscriber), connection.outstanding));
+  });
+}
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+RSocketClientPool::requestResponse(Payload request) {
+  return yarpl::single::Single<Payload>::create([
+    connections = connections_,
+    affinity = affinity_.load(),
+    request = std::move(request)
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    auto const& connection = pick(*connections, affinity);
+    auto requester = connection.client->getRequester();
+    requester->requestResponse(std::move(request))
+        ->subscribe(yarpl::make_ref<OutstandingSingleObserver>(
+            std::move(observer), connection.outstanding));
+  });
+}
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+RSocketClientPool::requestResponse(
+    Payload request,
+    const RequestPolicy& policy) {
+  return yarpl::single::Single<Payload>::create([
+    connections = connections_,
+    history = history_,
+    request = std::move(request),
+    policy
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    auto policyRequest = yarpl::make_ref<PolicyRequest>(
+        connections, history, std::move(request), policy, observer);
+    observer->onSubscribe(policyRequest);
+    policyRequest->start();
+  });
+}
+
+void RSocketClientPool::setRetryBudget(RetryBudget budget) {
+  history_->setBudget(budget);
+}
+
+void RSocketClientPool::setEventBaseAffinity(bool affinity) {
+  affinity_ = affinity;
+}
+
+yarpl::Reference<yarpl::single::Single<void>> RSocketClientPool::fireAndForget(
+    Payload request) {
+  // Nothing stays outstanding, any connection does.  Picked now, the
+  // caller's EventBase is that of the request.
+  return pick(*connections_, affinity_)
+      .client->getRequester()
+      ->fireAndForget(std::move(request));
+}
+
+} // namespace rsocket
@@ -0,0 +1,203 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <folly/futures/Future.h>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/IOThreadPool.h"
+#include "rsocket/Payload.h"
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketParameters.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+namespace rsocket {
+
+/**
+ * A set of RSocketClient connections, possibly to several endpoints, which
+ * requests are balanced across.  Created with RSocketClientPool::create.
+ *
+ * Each request goes to the less loaded of two randomly picked connections
+ * ("power of two choices"), load being the number of requests the pool has
+ * open on the connection.  The connection is picked when the returned
+ * Flowable or Single is subscribed to.
+ *
+ * Idempotent request-responses can be sent with a RequestPolicy, which hedges
+ * slow requests on a second connection and retries failed ones, within a
+ * RetryBudget shared by the requests of the pool.
+ *
+ * Large streams can be striped across several connections, see
+ * requestStripedStream().
+ *
+ * With setEventBaseAffinity(), requests made from the EventBase of one of the
+ * connections go to one of those connections instead, so that they are sent
+ * and answered on the caller's thread, without any hop.  Connecting the pool
+ * on an IOThreadPool the application runs on spreads the connections across
+ * its EventBases.
+ *
+ * The request methods can be called from any thread.
+ */
+class RSocketClientPool {
+ public:
+  using SetupParametersFactory = std::function<SetupParameters()>;
+
+  /// How an idempotent request-response is sent more than once.  The server
+  /// may see any number of copies of the request, up to 2 + maxRetries.
+  struct RequestPolicy {
+    /// Sends a copy of the request on another connection if no response
+    /// arrived this long after the first one was sent.  The first response
+    /// wins, and the other copy is cancelled.  0 for no hedging.
+    std::chrono::milliseconds hedgeDelay{0};
+    /// Hedges after the 95th percentile of the latencies of the recent
+    /// requests sent with a policy instead, once there are enough of them.
+    /// hedgeDelay is used until then, and must be set.
+    bool adaptiveHedgeDelay{false};
+    /// Copies of the request sent, each on another connection, after all the
+    /// copies sent so far failed.
+    size_t maxRetries{0};
+  };
+
+  /// Bounds the copies hedging and retries send, so that they don't pile
+  /// onto servers which are slow or failing for every request.
+  struct RetryBudget {
+    /// Copies allowed per request sent with a policy.
+    double ratio{0.1};
+    /// Copies which can be saved up while requests don't need them.  The
+    /// budget is full when the pool is created.
+    double maxBalance{10};
+  };
+
+  /**
+   * Connects `connectionsPerFactory` clients through each of the factories.
+   * Each connection is set up with parameters from `makeSetupParameters`.
+   * The returned future fails if any of the connections fails.
+   */
+  static folly::Future<std::unique_ptr<RSocketClientPool>> create(
+      std::vector<std::shared_ptr<ConnectionFactory>> factories,
+      size_t connectionsPerFactory = 1,
+      SetupParametersFactory makeSetupParameters = [] {
+        return SetupParameters();
+      });
+
+  /**
+   * Like create(), with the connections on the EventBases of `ioThreads`, in
+   * turn, see RSocket::createConnectedClient.  Must not be called from one of
+   * them, which would get all the connections.
+   */
+  static folly::Future<std::unique_ptr<RSocketClientPool>> create(
+      std::vector<std::shared_ptr<ConnectionFactory>> factories,
+      std::shared_ptr<IOThreadPool> ioThreads,
+      size_t connectionsPerFactory = 1,
+      SetupParametersFactory makeSetupParameters = [] {
+        return SetupParameters();
+      });
+
+  ~RSocketClientPool();
+
+  RSocketClientPool(const RSocketClientPool&) = delete;
+  RSocketClientPool& operator=(const RSocketClientPool&) = delete;
+
+  /// See RSocketRequester::requestStream.
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream(
+      Payload request);
+
+  /// Requests a stream split in `stripes` stripes, each a request stream sent
+  /// on another of the least loaded connections, and merges them back in
+  /// order.  Stripe i carries the items i, i + stripes, i + 2 * stripes, ...
+  /// of the stream: the responder finds which one it is sending in the
+  /// StreamStripe entry added to the composite metadata of the request, see
+  /// rsocket/metadata/StreamStripe.h.  `stripes` is clamped to the size of
+  /// the pool.
+  ///
+  /// Each stripe is requested `prefetch` items at a time, independently of
+  /// the others, so that a stream isn't bound by the flow control and the
+  /// EventBase of a single connection.  Up to `stripes * prefetch` items are
+  /// buffered while the next one in order is late.  An error of any stripe
+  /// fails the stream.
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStripedStream(
+      Payload request,
+      size_t stripes,
+      size_t prefetch = 64);
+
+  /// See RSocketRequester::requestChannel.
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestChannel(
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requests);
+
+  /// See RSocketRequester::requestResponse.
+  yarpl::Reference<yarpl::single::Single<Payload>> requestResponse(
+      Payload request);
+
+  /// Like requestResponse(), hedging and retrying the request as the policy
+  /// says.  Only for requests which are safe to handle more than once.
+  yarpl::Reference<yarpl::single::Single<Payload>> requestResponse(
+      Payload request,
+      const RequestPolicy& policy);
+
+  /// Replaces the budget of the hedges and retries, and fills it.
+  void setRetryBudget(RetryBudget budget);
+
+  /// Sends the requests subscribed to on the EventBase of one or more
+  /// connections on the least loaded of those, and the others as without
+  /// affinity.  Hedged, retried and striped requests need several
+  /// connections and aren't affected.  Applies to the requests made
+  /// afterwards.
+  void setEventBaseAffinity(bool affinity);
+
+  /// See RSocketRequester::fireAndForget.
+  yarpl::Reference<yarpl::single::Single<void>> fireAndForget(
+      Payload request);
+
+  /// Number of connections in the pool.
+  size_t size() const {
+    return connections_->size();
+  }
+
+  /// Number of requests open on each connection.
+  std::vector<size_t> outstandingRequests() const;
+
+ private:
+  struct Connection;
+  using Connections = std::vector<Connection>;
+  struct History;
+  class PolicyRequest;
+  class StripedStream;
+
+  explicit RSocketClientPool(std::vector<std::unique_ptr<RSocketClient>>);
+
+  /// The pool of the clients, once all of them are connected.
+  static folly::Future<std::unique_ptr<RSocketClientPool>> fromClients(
+      std::vector<folly::Future<std::unique_ptr<RSocketClient>>> clients);
+
+  static const Connection& pick(const Connections&);
+
+  /// Like pick(), preferring the connections on the EventBase of the caller
+  /// with `affinity`.
+  static const Connection& pick(const Connections&, bool affinity);
+
+  /// Like pick(), avoiding `previous` if there is another connection.
+  static const Connection& pickOther(
+      const Connections&,
+      const Connection* previous);
+
+  /// The `n` least loaded connections, at most all of them.
+  static std::vector<const Connection*> pickLeastLoaded(
+      const Connections&,
+      size_t n);
+
+  /// Shared with the Flowables and Singles handed out, which can be
+  /// subscribed to after the pool is gone.
+  std::shared_ptr<const Connections> connections_;
+  /// Latencies and retry budget of the requests sent with a policy.
+  const std::shared_ptr<History> history_;
+  /// See setEventBaseAffinity().
+  std::atomic<bool> affinity_{false};
+};
+
+} // namespace rsocket
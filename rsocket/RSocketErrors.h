@@ -117,4 +117,102 @@ class ConnectionCloseError : public RSocketError {
     return "CONNECTION_CLOSE";
   }
 };
+
+/**
+ * Raised locally when a request can't be sent because the connection was set
+ * up with leases and the peer hasn't granted one.  The peer would have
+ * rejected the request.
+ *
+ * Error Code: REJECTED 0x00000202
+ */
+class NoLeaseError : public RSocketError {
+ public:
+  using RSocketError::RSocketError;
+
+  int getErrorCode() override {
+    return 0x00000202;
+  }
+
+  const char* what() const noexcept override {
+    return "REJECTED (no lease)";
+  }
+};
+
+/**
+ * Raised locally when a request didn't terminate within the timeout of its
+ * RequestOptions.  The request is cancelled.
+ *
+ * Error Code: CANCELED 0x00000203
+ */
+class RequestTimeoutError : public RSocketError {
+ public:
+  using RSocketError::RSocketError;
+
+  int getErrorCode() override {
+    return 0x00000203;
+  }
+
+  const char* what() const noexcept override {
+    return "CANCELED (request timed out)";
+  }
+};
+
+/**
+ * Raised locally when a request can't be sent because the frames the
+ * connection buffers for the peer reached their limits, see
+ * PendingFrameLimits::Policy::FAIL_NEW_STREAMS.
+ *
+ * Error Code: REJECTED 0x00000202
+ */
+class PendingFramesFullError : public RSocketError {
+ public:
+  using RSocketError::RSocketError;
+
+  int getErrorCode() override {
+    return 0x00000202;
+  }
+
+  const char* what() const noexcept override {
+    return "REJECTED (pending frame buffer is full)";
+  }
+};
+
+/**
+ * Raised locally when a request can't be sent because a ConcurrencyLimiter
+ * has reached its limit and its queue is full.
+ *
+ * Error Code: REJECTED 0x00000202
+ */
+class ConcurrencyLimitError : public RSocketError {
+ public:
+  using RSocketError::RSocketError;
+
+  int getErrorCode() override {
+    return 0x00000202;
+  }
+
+  const char* what() const noexcept override {
+    return "REJECTED (concurrency limit reached)";
+  }
+};
+
+/**
+ * Raised locally for a request-response with a future, see
+ * RSocketRequester::requestResponseFuture(), when its RequestGroup is
+ * cancelled.  The request is cancelled.
+ *
+ * Error Code: CANCELED 0x00000203
+ */
+class RequestCancelledError : public RSocketError {
+ public:
+  using RSocketError::RSocketError;
+
+  int getErrorCode() override {
+    return 0x00000203;
+  }
+
+  const char* what() const noexcept override {
+    return "CANCELED (request group cancelled)";
+  }
+};
 }
@@ -3,6 +3,9 @@
 #pragma once
 
 #include <folly/io/IOBuf.h>
+#include <chrono>
+#include <limits>
+#include <memory>
 #include <string>
 #include "rsocket/Payload.h"
 #include "rsocket/framing/FrameSerializer.h"
@@ -10,6 +13,8 @@
 
 namespace rsocket {
 
+class CompressionDictionary;
+
 using OnRSocketResume =
     std::function<bool(std::vector<StreamId>, std::vector<StreamId>)>;
 
@@ -22,6 +27,185 @@ class RSocketParameters {
   ProtocolVersion protocolVersion;
 };
 
+// Controls how the credit requested by the subscribers of incoming streams is
+// sent to the peer in REQUEST_N frames.  By default every request is sent to
+// the peer right away.
+struct RequestNBatching {
+  // Credit is held back while the peer still has more than this many payloads
+  // left to send on the stream, and is sent in one REQUEST_N once it drops to
+  // the mark.  A subscriber which keeps a window of W payloads requested (one
+  // more for each payload it receives) then causes one REQUEST_N per
+  // W - lowWaterMark - 1 payloads instead of one per payload.
+  size_t lowWaterMark{std::numeric_limits<size_t>::max()};
+  // Send the credit requested during one EventBase loop iteration in a single
+  // REQUEST_N per stream, at the end of the iteration.
+  bool perLoopIteration{false};
+};
+
+// Lets the stream requesters of a connection request payloads ahead of their
+// subscribers, the way TCP autotunes its receive window, so that a stream
+// isn't held back by a round trip per REQUEST_N.  The peer is kept granted a
+// window of payloads beyond what the subscriber requested, and the payloads
+// which arrive before they are requested are buffered by the stream.  The
+// window starts at the last one a stream of the connection reached, and grows
+// to twice the payloads the subscriber consumes per round trip, the round trip
+// time being measured by the keepalives of the client.  On the server, which
+// doesn't send keepalives, it stays at the size it starts at.  Windows don't
+// grow, and are cut back to minWindow, while the connection is above the
+// high-water mark of its ConnectionMemoryLimits.  The REQUEST_STREAM carries
+// the first request of the subscriber plus the window.  Disabled while
+// maxWindow is 0, which it is by default.
+struct AdaptiveRequestN {
+  size_t minWindow{16};
+  size_t maxWindow{0};
+
+  bool enabled() const {
+    return maxWindow > 0;
+  }
+};
+
+// Bounds the frames a connection buffers while it can't send them: while it
+// is disconnected or resuming, and while the transport is buffering writes.
+// By default nothing is bounded.
+struct PendingFrameLimits {
+  enum class Policy {
+    // Requests fail locally with PendingFramesFullError.  The publishers of
+    // the connection stop producing, while the frames they already produced
+    // are still buffered.
+    FAIL_NEW_STREAMS,
+    // The longest-lived stream (the one with the lowest id) with buffered
+    // frames is closed, and its frames are dropped, until the new frame fits.
+    // The peer is sent a CANCEL or an ERROR for it.
+    DROP_OLDEST_STREAM,
+    // The frames which don't fit are written to an unlinked temporary file and
+    // read back when they are sent.  They are sent after the frames held in
+    // memory, which are the only ones sent in priority order.
+    SPILL_TO_FILE,
+  };
+
+  size_t maxFrames{std::numeric_limits<size_t>::max()};
+  size_t maxBytes{std::numeric_limits<size_t>::max()};
+  Policy policy{Policy::FAIL_NEW_STREAMS};
+  // Fire-and-forgets are dropped, as they are best-effort, while the frames
+  // pending plus the bytes the transport buffers reach this many bytes, so
+  // that they don't hold back the frames of the other streams.
+  size_t maxBytesForFireAndForget{std::numeric_limits<size_t>::max()};
+};
+
+// Bounds the bytes a connection holds in memory: the partial frames read from
+// the transport, the frames its writes buffer, the frames pending to be sent,
+// the fragments of frames being reassembled and the frames buffered for
+// resumption.  They are checked as frames are read and written.  Above
+// highWaterMark, the publishers of the connection stop producing until the
+// bytes go back to lowWaterMark.  Above maxBytes, the connection is closed
+// with a CONNECTION_ERROR, so that a peer which doesn't read, or sends huge
+// fragmented frames, can't make it grow without bounds.  0 disables a limit,
+// which they are by default.
+struct ConnectionMemoryLimits {
+  size_t highWaterMark{0};
+  size_t lowWaterMark{0};
+  size_t maxBytes{0};
+};
+
+// Sheds the load of a server whose worker EventBases can't keep up.  Each
+// EventBase is probed every probeInterval: it is overloaded once a probe runs
+// more than maxLoopLatency late, or finds more than maxQueuedTasks tasks queued
+// with runInEventBaseThread(), and until both go back below half of their
+// limits.  While it is overloaded, its connections reject new requests with
+// REJECTED and issue no leases.  0 disables a limit, which they are by
+// default.
+struct LoadSheddingOptions {
+  std::chrono::milliseconds maxLoopLatency{0};
+  size_t maxQueuedTasks{0};
+  std::chrono::milliseconds probeInterval{10};
+
+  bool enabled() const {
+    return maxLoopLatency.count() > 0 || maxQueuedTasks > 0;
+  }
+};
+
+// Bounds the streams the peers of a server have open at once, so that a
+// runaway client opening streams without end can't exhaust its memory.  Past
+// maxPerConnection streams opened by the peer of a connection, or past
+// maxPerServer over all the connections of the server, new REQUEST_* frames
+// are rejected with REJECTED before their payload is even read.  0 disables a
+// limit, which they are by default.
+struct StreamLimits {
+  size_t maxPerConnection{0};
+  size_t maxPerServer{0};
+};
+
+// Bounds the SETUPs and RESUMEs a server processes at once on each of its
+// worker EventBases, so that a reconnect storm after an outage doesn't have
+// the service handler set up every client at the same time.  A SETUP or
+// RESUME is in progress from its first frame until the server accepted or
+// rejected it, e.g. while onNewSetupAsync() hasn't completed.  Past
+// maxInProgress, new SETUPs are rejected with REJECTED_SETUP before their
+// frame is even decoded.  RESUMEs, which are cheaper and keep the state of
+// their clients, are admitted up to resumeHeadroom more, and are rejected
+// past it with a CONNECTION_ERROR, so that their clients retry with their
+// state.  0 disables the limit, which it is by default.
+struct SetupAdmissionLimits {
+  size_t maxInProgress{0};
+  size_t resumeHeadroom{0};
+};
+
+// Compresses the data of the payloads a connection sends, in REQUEST_* and
+// PAYLOAD frames, with a codec of folly.  Data shorter than minBytes, or which
+// doesn't shrink, is sent as it is, and metadata always is.  A compressed
+// frame carries the COMPRESSED flag, and its data starts with the id of the
+// codec.  The flag is a reserved bit for peers without this extension, so it
+// is negotiated: a client with a codec asks for it with an entry of the
+// composite metadata of its SETUP, and the server, which compresses if its
+// RSocketConnectionParams::compression has a codec, accepts the payloads of
+// the client with a METADATA_PUSH of that entry.  The client only compresses
+// once it got it.  Clients with other SETUP metadata don't compress, and the
+// flag is ignored on the connections which didn't negotiate it.  Both peers
+// decompress whatever their own settings.  Only for protocol 1.0, both peers
+// need folly built with the codec.
+struct PayloadCompression {
+  // The ids in the compressed data.
+  enum class Codec : uint8_t {
+    NONE = 0,
+    ZSTD = 1,
+    LZ4 = 2,
+  };
+
+  Codec codec{Codec::NONE};
+  size_t minBytes{512};
+  // The zstd dictionary to compress and decompress with, shared read-only by
+  // the connections using it.  A client names its dictionary in its SETUP,
+  // which takes composite metadata, and the server uses its dictionary with
+  // that id, see RSocketServer::addCompressionDictionary().  A client with
+  // other SETUP metadata compresses without its dictionary.
+  std::shared_ptr<const CompressionDictionary> dictionary;
+};
+
+// Compresses the whole byte stream of a connection, below the framing, with a
+// single streaming context per direction, so that small repetitive frames
+// compress with the ones before them rather than on their own.  What is
+// written during an EventBase loop iteration is compressed and flushed
+// together.  A client with a codec asks for it in the composite metadata of
+// its SETUP.  A server which accepts it answers with a METADATA_PUSH, and
+// compresses everything it writes after it with the codec of the client, which
+// does the same once it read that METADATA_PUSH.  A server without this
+// extension, see RSocketServer::setConnectionCompression(), ignores the request
+// and the connection isn't compressed.  Only for protocol 1.0 with composite
+// SETUP metadata over transports without their own framing, and not for the
+// connections of resumptions, which are not compressed.  Level 0 is the
+// default level of the codec.
+struct ConnectionCompression {
+  // The ids at the start of the compressed bytes.
+  enum class Codec : uint8_t {
+    NONE = 0,
+    ZSTD = 1,
+    DEFLATE = 2,
+  };
+
+  Codec codec{Codec::NONE};
+  int level{0};
+};
+
 class SetupParameters : public RSocketParameters {
  public:
   explicit SetupParameters(
@@ -42,6 +226,56 @@ class SetupParameters : public RSocketParameters {
   std::string dataMimeType;
   Payload payload;
   ResumeIdentificationToken token;
+  // Whether the client may only send requests which the server granted it a
+  // lease for.
+  bool lease{false};
+  // Payloads larger than this many bytes (metadata and data) are sent in
+  // fragments of at most this size.  This is a local setting, it isn't sent
+  // to the peer.  0 disables fragmentation.
+  size_t mtu{0};
+  // How REQUEST_N frames are sent.  This is a local setting as well.
+  RequestNBatching requestNBatching;
+  // How far ahead of their subscribers the stream requesters request.  Local
+  // as well.
+  AdaptiveRequestN adaptiveRequestN;
+  // How many frames are buffered while they can't be sent.  Local as well.
+  PendingFrameLimits pendingFrameLimits;
+  // How many payloads each stream responder serializes ahead of the REQUEST_N
+  // of the peer, up to 256.  They are written together once the peer requests
+  // them.  Local as well, 0 disables.
+  size_t streamSerializeAhead{0};
+  // On resumable connections, a KEEPALIVE without the respond flag is sent
+  // once this many bytes were received since the last KEEPALIVE sent, so that
+  // the peer drops the frames it buffers for resumption early instead of at
+  // the next regular keepalive.  Local as well, 0 disables.  The peer has to
+  // accept KEEPALIVE frames without the respond flag, which servers before
+  // this setting existed didn't.
+  size_t positionAckBytes{0};
+  // How many bytes the connection holds in memory.  Local as well.
+  ConnectionMemoryLimits memoryLimits;
+  // Longest frame read or written, not counting its length field, on
+  // transports which aren't framed.  A longer frame fails the connection.
+  // Local as well, the mtu should leave room for the frame headers below it.
+  size_t maxFrameLength{kMaxFrameLength};
+  // Whether the client only sends a keepalive when it received no frame for
+  // the keepalive interval.  Any frame received then answers the keepalive,
+  // so the connection is still disconnected once nothing was received for two
+  // intervals.  Local as well.
+  bool keepaliveOnlyWhenIdle{false};
+  // Once no frame other than a KEEPALIVE was received or sent during an
+  // interval this long, the intervals being checked one after the other, the
+  // connection frees the buffers it keeps around to reuse: its read buffers,
+  // the spare capacity of its queues, and that of the frames it buffers for
+  // resumption.  They are allocated again on the next frame.  Local as well,
+  // 0 disables.
+  std::chrono::milliseconds hibernateAfter{0};
+  // How the payloads sent are compressed.  A client with a codec asks the
+  // server for compressed payloads in its SETUP.
+  PayloadCompression compression;
+  // Set on the server when the client asked for compressed payloads.
+  bool compressionRequested{false};
+  // How the client compresses its connection, see ConnectionCompression.
+  ConnectionCompression connectionCompression;
 };
 
 std::ostream& operator<<(std::ostream&, const SetupParameters&);
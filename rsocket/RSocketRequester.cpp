@@ -3,7 +3,9 @@
 #include "rsocket/RSocketRequester.h"
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/ScopeGuard.h>
 
+#include "rsocket/RSocketErrors.h"
 #include "rsocket/internal/ScheduledSingleObserver.h"
 #include "rsocket/internal/ScheduledSubscriber.h"
 #include "yarpl/Flowable.h"
@@ -14,6 +16,146 @@ using namespace yarpl;
 
 namespace rsocket {
 
+namespace {
+
+/// Requests made inline from within requests, e.g. by a responder which calls
+/// another service on the same EventBase, nest on the stack.  Past this depth
+/// they go through the queue of the EventBase instead.
+constexpr size_t kMaxInlineDepth = 8;
+thread_local size_t inlineDepth = 0;
+
+/// Runs `fn` right away when called from the thread of the EventBase,
+/// without the queue hop and the allocation of the closure, and schedules it
+/// on the EventBase otherwise.
+template <typename F>
+void runInEventBase(folly::EventBase& eventBase, F&& fn) {
+  if (eventBase.isInEventBaseThread() && inlineDepth < kMaxInlineDepth) {
+    ++inlineDepth;
+    SCOPE_EXIT {
+      --inlineDepth;
+    };
+    fn();
+  } else {
+    eventBase.runInEventBaseThread(std::forward<F>(fn));
+  }
+}
+
+/// Sends fire-and-forget requests from the EventBase of the connection.
+/// Returns the error of the first request which can't be sent, the ones
+/// before it are sent.
+folly::exception_wrapper sendFireAndForgetBatch(
+    RSocketStateMachine& srs,
+    std::vector<Payload> requests) {
+  if (srs.rejectsNewStreams()) {
+    return PendingFramesFullError("");
+  }
+  folly::exception_wrapper error;
+  for (auto it = requests.begin(); it != requests.end(); ++it) {
+    if (!srs.acquireLease()) {
+      requests.erase(it, requests.end());
+      error = NoLeaseError("");
+      break;
+    }
+  }
+  if (!requests.empty()) {
+    srs.fireAndForgetBatch(std::move(requests));
+  }
+  return error;
+}
+
+/// Collects the Payloads of a Flowable into batches, and sends each of them
+/// with a single hop to the EventBase.  The next batch is requested once the
+/// previous one has been sent.  The observer is only used on the EventBase.
+class FireAndForgetBatcher
+    : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  FireAndForgetBatcher(
+      std::shared_ptr<RSocketStateMachine> srs,
+      folly::EventBase& eventBase,
+      yarpl::Reference<yarpl::single::SingleObserverBase<void>> observer)
+      : srs_(std::move(srs)),
+        eventBase_(eventBase),
+        observer_(std::move(observer)) {}
+
+  /// Stops sending on behalf of the observer, from any thread.
+  void cancelBatches() {
+    cancel();
+    eventBase_.runInEventBaseThread(
+        [self = this->ref_from_this(this)] { self->observer_ = nullptr; });
+  }
+
+ private:
+  static constexpr size_t kBatchSize =
+      RSocketRequester::kFireAndForgetBatchSize;
+
+  void onSubscribeImpl() override {
+    request(kBatchSize);
+  }
+
+  void onNextImpl(Payload request) override {
+    batch_.push_back(std::move(request));
+    if (batch_.size() == kBatchSize) {
+      flush(false, folly::exception_wrapper());
+    }
+  }
+
+  void onCompleteImpl() override {
+    flush(true, folly::exception_wrapper());
+  }
+
+  void onErrorImpl(folly::exception_wrapper ex) override {
+    flush(true, std::move(ex));
+  }
+
+  void flush(bool last, folly::exception_wrapper error) {
+    std::vector<Payload> requests;
+    requests.swap(batch_);
+    eventBase_.runInEventBaseThread([
+      self = this->ref_from_this(this),
+      requests = std::move(requests),
+      last,
+      error = std::move(error)
+    ]() mutable { self->send(std::move(requests), last, std::move(error)); });
+  }
+
+  void send(
+      std::vector<Payload> requests,
+      bool last,
+      folly::exception_wrapper error) {
+    if (!observer_) {
+      return;
+    }
+    if (!requests.empty()) {
+      if (auto ex = sendFireAndForgetBatch(*srs_, std::move(requests))) {
+        cancel();
+        last = true;
+        error = std::move(ex);
+      }
+    }
+    if (!last) {
+      request(kBatchSize);
+      return;
+    }
+    auto observer = std::move(observer_);
+    if (error) {
+      observer->onError(std::move(error));
+    } else {
+      observer->onSuccess();
+    }
+  }
+
+  const std::shared_ptr<RSocketStateMachine> srs_;
+  folly::EventBase& eventBase_;
+  yarpl::Reference<yarpl::single::SingleObserverBase<void>> observer_;
+  std::vector<Payload> batch_;
+};
+
+constexpr size_t FireAndForgetBatcher::kBatchSize;
+
+} // namespace
+
+constexpr size_t RSocketRequester::kFireAndForgetBatchSize;
+
 RSocketRequester::RSocketRequester(
     std::shared_ptr<RSocketStateMachine> srs,
     EventBase& eventBase)
@@ -34,23 +176,27 @@ void RSocketRequester::closeSocket() {
 yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
 RSocketRequester::requestChannel(
     yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
-        requestStream) {
+        requestStream,
+    const RequestOptions& options) {
   CHECK(stateMachine_); // verify the socket was not closed
 
   return yarpl::flowable::Flowables::fromPublisher<Payload>([
     eb = &eventBase_,
     requestStream = std::move(requestStream),
+    options,
     srs = stateMachine_
   ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
     auto lambda = [
       requestStream = std::move(requestStream),
       subscriber = std::move(subscriber),
+      options,
       srs = std::move(srs),
       eb
     ]() mutable {
       auto responseSink = srs->streamsFactory().createChannelRequester(
           yarpl::make_ref<ScheduledSubscriptionSubscriber<Payload>>(
-              std::move(subscriber), *eb));
+              std::move(subscriber), *eb),
+          options);
       // responseSink is wrapped with thread scheduling
       // so all emissions happen on the right thread
 
@@ -62,70 +208,108 @@ RSocketRequester::requestChannel(
             std::move(responseSink), *eb));
       }
     };
-    if (eb->isInEventBaseThread()) {
-      lambda();
-    } else {
-      eb->runInEventBaseThread(std::move(lambda));
-    }
+    runInEventBase(*eb, std::move(lambda));
   });
 }
 
 yarpl::Reference<yarpl::flowable::Flowable<Payload>>
-RSocketRequester::requestStream(Payload request) {
+RSocketRequester::requestStream(
+    Payload request,
+    const RequestOptions& options) {
   CHECK(stateMachine_); // verify the socket was not closed
 
   return yarpl::flowable::Flowables::fromPublisher<Payload>([
     eb = &eventBase_,
     request = std::move(request),
+    options,
     srs = stateMachine_
   ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
     auto lambda = [
       request = std::move(request),
       subscriber = std::move(subscriber),
+      options,
       srs = std::move(srs),
       eb
     ]() mutable {
       srs->streamsFactory().createStreamRequester(
           std::move(request),
           yarpl::make_ref<ScheduledSubscriptionSubscriber<Payload>>(
-              std::move(subscriber), *eb));
+              std::move(subscriber), *eb),
+          options);
     };
-    if (eb->isInEventBaseThread()) {
-      lambda();
-    } else {
-      eb->runInEventBaseThread(std::move(lambda));
-    }
+    runInEventBase(*eb, std::move(lambda));
+  });
+}
+
+void RSocketRequester::requestStreamWith(
+    Payload request,
+    yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber,
+    const RequestOptions& options,
+    StreamRequesterFactory makeRequester) {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  runInEventBase(eventBase_, [
+    request = std::move(request),
+    subscriber = std::move(subscriber),
+    options,
+    srs = stateMachine_,
+    makeRequester
+  ]() mutable {
+    srs->streamsFactory().createStreamRequester(
+        std::move(request), std::move(subscriber), options, makeRequester);
   });
 }
 
 yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
-RSocketRequester::requestResponse(Payload request) {
+RSocketRequester::requestResponse(
+    Payload request,
+    const RequestOptions& options) {
   CHECK(stateMachine_); // verify the socket was not closed
 
   return yarpl::single::Single<Payload>::create([
     eb = &eventBase_,
     request = std::move(request),
+    options,
     srs = stateMachine_
   ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
     auto lambda = [
       request = std::move(request),
       observer = std::move(observer),
+      options,
       eb,
       srs = std::move(srs)
     ]() mutable {
       srs->streamsFactory().createRequestResponseRequester(
           std::move(request),
           yarpl::make_ref<ScheduledSubscriptionSingleObserver<Payload>>(
-              std::move(observer), *eb));
+              std::move(observer), *eb),
+          options);
     };
-    if (eb->isInEventBaseThread()) {
-      lambda();
-    } else {
-      eb->runInEventBaseThread(std::move(lambda));
-    }
+    runInEventBase(*eb, std::move(lambda));
   });
 }
 
+folly::Future<Payload> RSocketRequester::requestResponseFuture(
+    Payload request,
+    const RequestOptions& options) {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  folly::Promise<Payload> promise;
+  auto future = promise.getFuture();
+  runInEventBase(
+      eventBase_,
+      [
+        request = std::move(request),
+        promise = std::move(promise),
+        options,
+        srs = stateMachine_
+      ]() mutable {
+        srs->streamsFactory().createRequestResponseRequester(
+            std::move(request), std::move(promise), options);
+      });
+  return future;
+}
+
 yarpl::Reference<yarpl::single::Single<void>> RSocketRequester::fireAndForget(
     rsocket::Payload request) {
   CHECK(stateMachine_); // verify the socket was not closed
@@ -140,30 +324,100 @@ yarpl::Reference<yarpl::single::Single<void>> RSocketRequester::fireAndForget(
       subscriber = std::move(subscriber),
       srs = std::move(srs)
     ]() mutable {
+      subscriber->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+      if (srs->rejectsNewStreams()) {
+        subscriber->onError(PendingFramesFullError(""));
+        return;
+      }
+      if (!srs->acquireLease()) {
+        subscriber->onError(NoLeaseError(""));
+        return;
+      }
       // TODO pass in SingleSubscriber for underlying layers to
       // call onSuccess/onError once put on network
       srs->fireAndForget(std::move(request));
       // right now just immediately call onSuccess
+      subscriber->onSuccess();
+    };
+    runInEventBase(*eb, std::move(lambda));
+  });
+}
+
+yarpl::Reference<yarpl::single::Single<void>>
+RSocketRequester::fireAndForgetBatch(std::vector<rsocket::Payload> requests) {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  return yarpl::single::Single<void>::create([
+    eb = &eventBase_,
+    requests = std::move(requests),
+    srs = stateMachine_
+  ](yarpl::Reference<yarpl::single::SingleObserverBase<void>> subscriber) mutable {
+    auto lambda = [
+      requests = std::move(requests),
+      subscriber = std::move(subscriber),
+      srs = std::move(srs)
+    ]() mutable {
       subscriber->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+      if (auto ex = sendFireAndForgetBatch(*srs, std::move(requests))) {
+        subscriber->onError(std::move(ex));
+        return;
+      }
       subscriber->onSuccess();
     };
-    if (eb->isInEventBaseThread()) {
-      lambda();
-    } else {
-      eb->runInEventBaseThread(std::move(lambda));
-    }
+    runInEventBase(*eb, std::move(lambda));
+  });
+}
+
+yarpl::Reference<yarpl::single::Single<void>>
+RSocketRequester::fireAndForgetBatch(
+    yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>> requests) {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  return yarpl::single::Single<void>::create([
+    eb = &eventBase_,
+    requests = std::move(requests),
+    srs = stateMachine_
+  ](yarpl::Reference<yarpl::single::SingleObserverBase<void>> subscriber) {
+    auto batcher = yarpl::make_ref<FireAndForgetBatcher>(srs, *eb, subscriber);
+    subscriber->onSubscribe(yarpl::single::SingleSubscriptions::create(
+        [batcher] { batcher->cancelBatches(); }));
+    requests->subscribe(batcher);
   });
 }
 
 void RSocketRequester::metadataPush(std::unique_ptr<folly::IOBuf> metadata) {
   CHECK(stateMachine_); // verify the socket was not closed
 
-  eventBase_.runInEventBaseThread(
+  runInEventBase(
+      eventBase_,
       [ srs = stateMachine_, metadata = std::move(metadata) ]() mutable {
         srs->metadataPush(std::move(metadata));
       });
 }
 
+void RSocketRequester::metadataPushLatest(
+    std::unique_ptr<folly::IOBuf> metadata,
+    std::string key) {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  runInEventBase(eventBase_, [
+    srs = stateMachine_,
+    metadata = std::move(metadata),
+    key = std::move(key)
+  ]() mutable { srs->metadataPushLatest(std::move(metadata), key); });
+}
+
+folly::Future<folly::Unit> RSocketRequester::ping() {
+  CHECK(stateMachine_); // verify the socket was not closed
+
+  return folly::via(&eventBase_, [srs = stateMachine_] { return srs->ping(); });
+}
+
+std::shared_ptr<RequestGroup> RSocketRequester::createRequestGroup() {
+  CHECK(stateMachine_); // verify the socket was not closed
+  return std::make_shared<RequestGroup>(stateMachine_, eventBase_);
+}
+
 DuplexConnection* RSocketRequester::getConnection() {
   return stateMachine_? stateMachine_->getConnection() : nullptr;
 }
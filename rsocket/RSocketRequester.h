@@ -2,13 +2,21 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
+#include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
 
 #include "yarpl/Flowable.h"
 #include "yarpl/Single.h"
 
 #include "rsocket/Payload.h"
+#include "rsocket/RequestGroup.h"
+#include "rsocket/RequestOptions.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
+#include "rsocket/statemachine/StreamRequester.h"
+#include "rsocket/statemachine/StreamsFactory.h"
 
 namespace rsocket {
 
@@ -52,7 +60,32 @@ class RSocketRequester {
    * https://github.com/ReactiveSocket/reactivesocket/blob/master/Protocol.md#request-stream
    */
   virtual yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
-  requestStream(rsocket::Payload request);
+  requestStream(
+      rsocket::Payload request,
+      const RequestOptions& options = RequestOptions());
+
+  /**
+   * Send a single request and get a response stream, delivered straight to
+   * `subscriber`, of a final class S deriving from Subscriber<Payload>.
+   *
+   * As S is known, the payloads are handed to S::onNext() with a direct call
+   * the compiler can inline into the handling of their frames, rather than
+   * through the virtual calls of a Flowable and of the subscribers which
+   * move them to the right thread.  In exchange, `subscriber` is signaled on
+   * the EventBase of the connection, and must request and cancel on it.
+   */
+  template <typename S>
+  void requestStream(
+      rsocket::Payload request,
+      yarpl::Reference<S> subscriber,
+      const RequestOptions& options = RequestOptions()) {
+    requestStreamWith(
+        std::move(request),
+        yarpl::Reference<yarpl::flowable::Subscriber<rsocket::Payload>>(
+            std::move(subscriber)),
+        options,
+        &TypedStreamRequester<S>::make);
+  }
 
   /**
    * Start a channel (streams in both directions).
@@ -62,7 +95,8 @@ class RSocketRequester {
    */
   virtual yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
   requestChannel(
-      yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>> requests);
+      yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>> requests,
+      const RequestOptions& options = RequestOptions());
 
   /**
    * Send a single request and get a single response.
@@ -71,7 +105,20 @@ class RSocketRequester {
    * https://github.com/ReactiveSocket/reactivesocket/blob/master/Protocol.md#stream-sequences-request-response
    */
   virtual yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
-  requestResponse(rsocket::Payload request);
+  requestResponse(
+      rsocket::Payload request,
+      const RequestOptions& options = RequestOptions());
+
+  /**
+   * Send a single request and get a single response, like requestResponse(),
+   * without the Single and observer objects in between.
+   *
+   * The future is completed on the EventBase of the connection.  Interrupting
+   * it (e.g. with cancel()) cancels the request.
+   */
+  virtual folly::Future<rsocket::Payload> requestResponseFuture(
+      rsocket::Payload request,
+      const RequestOptions& options = RequestOptions());
 
   /**
    * Send a single Payload with no response.
@@ -88,11 +135,68 @@ class RSocketRequester {
   virtual yarpl::Reference<yarpl::single::Single<void>> fireAndForget(
       rsocket::Payload request);
 
+  /**
+   * Send several Payloads with no response, in a single hop to the EventBase
+   * of the connection and, when it is writable, a single write.
+   *
+   * The returned Single<void> succeeds once all of them are sent, or fails if
+   * the connection refuses new requests, in which case the requests before
+   * the refused one are still sent.
+   */
+  virtual yarpl::Reference<yarpl::single::Single<void>> fireAndForgetBatch(
+      std::vector<rsocket::Payload> requests);
+
+  /**
+   * Send each Payload of a Flowable with no response.  The Flowable is
+   * requested kFireAndForgetBatchSize Payloads at a time, and each batch is
+   * sent as with the vector variant before the next one is requested.
+   *
+   * The returned Single<void> succeeds once the Flowable completes and all
+   * of its Payloads are sent.  It fails with the error of the Flowable, or
+   * if the connection refuses new requests, which cancels the Flowable.
+   */
+  virtual yarpl::Reference<yarpl::single::Single<void>> fireAndForgetBatch(
+      yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>> requests);
+
+  static constexpr size_t kFireAndForgetBatchSize = 256;
+
   /**
    * Send metadata without response.
    */
   virtual void metadataPush(std::unique_ptr<folly::IOBuf> metadata);
 
+  /**
+   * Send metadata without response, for metadata where only the latest
+   * matters, e.g. configuration.  While the connection can't write it (it is
+   * backed up, disconnected or resuming), it replaces the metadata sent with
+   * the same `key` which is still waiting to be written, rather than being
+   * written after it.
+   */
+  virtual void metadataPushLatest(
+      std::unique_ptr<folly::IOBuf> metadata,
+      std::string key = std::string());
+
+  /**
+   * Send a KEEPALIVE the server has to answer.  The returned future is
+   * fulfilled with the answer, and fails if the connection is lost first.
+   * Only for the requester of a client.
+   */
+  virtual folly::Future<folly::Unit> ping();
+
+  /**
+   * Creates a group of requests of this requester, which can be cancelled
+   * together, see RequestOptions::group.
+   */
+  std::shared_ptr<RequestGroup> createRequestGroup();
+
+  /**
+   * The EventBase the requests are sent from, and their responses delivered
+   * on.  Requests made on it are sent without a hop to another thread.
+   */
+  folly::EventBase& getEventBase() const {
+    return eventBase_;
+  }
+
   /**
    * To be used only temporarily to check the transport's status.
    */
@@ -101,6 +205,17 @@ class RSocketRequester {
   virtual void closeSocket();
 
  private:
+  void requestStreamWith(
+      rsocket::Payload request,
+      yarpl::Reference<yarpl::flowable::Subscriber<rsocket::Payload>>
+          subscriber,
+      const RequestOptions& options,
+      StreamRequesterFactory makeRequester);
+
+  // Forwards the streams of proxies to the connection, see
+  // RSocketResponder::forwardRequest().
+  friend class RSocketStateMachine;
+
   std::shared_ptr<rsocket::RSocketStateMachine> stateMachine_;
   folly::EventBase& eventBase_;
 };
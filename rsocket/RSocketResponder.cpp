@@ -6,6 +6,20 @@
 
 namespace rsocket {
 
+bool RSocketResponder::acceptRequest(
+    StreamType,
+    const MetadataView&,
+    rsocket::StreamId) {
+  return true;
+}
+
+std::shared_ptr<RSocketRequester> RSocketResponder::forwardRequest(
+    StreamType,
+    const MetadataView&,
+    rsocket::StreamId) {
+  return nullptr;
+}
+
 yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
 RSocketResponder::handleRequestResponse(rsocket::Payload, rsocket::StreamId) {
   return yarpl::single::Singles::error<rsocket::Payload>(
@@ -18,6 +32,34 @@ RSocketResponder::handleRequestStream(rsocket::Payload, rsocket::StreamId) {
       std::logic_error("handleRequestStream not implemented"));
 }
 
+bool RSocketResponder::handlesLazyPayloads() const {
+  return false;
+}
+
+bool RSocketResponder::servesSerializedResponses() const {
+  return false;
+}
+
+std::shared_ptr<const SerializedResponse> RSocketResponder::serializedResponse(
+    const rsocket::LazyPayload&,
+    rsocket::StreamId) {
+  return nullptr;
+}
+
+yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
+RSocketResponder::handleRequestResponseLazy(
+    rsocket::LazyPayload request,
+    rsocket::StreamId streamId) {
+  return handleRequestResponse(std::move(request).materialize(), streamId);
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
+RSocketResponder::handleRequestStreamLazy(
+    rsocket::LazyPayload request,
+    rsocket::StreamId streamId) {
+  return handleRequestStream(std::move(request).materialize(), streamId);
+}
+
 yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
 RSocketResponder::handleRequestChannel(
     rsocket::Payload,
@@ -33,6 +75,17 @@ void RSocketResponder::handleFireAndForget(
   // No default implementation, no error response to provide.
 }
 
+bool RSocketResponder::batchesFireAndForget() const {
+  return false;
+}
+
+void RSocketResponder::handleFireAndForgetBatch(
+    std::vector<std::pair<rsocket::Payload, rsocket::StreamId>> requests) {
+  for (auto& request : requests) {
+    handleFireAndForget(std::move(request.first), request.second);
+  }
+}
+
 void RSocketResponder::handleMetadataPush(std::unique_ptr<folly::IOBuf>) {
   // No default implementation, no error response to provide.
 }
@@ -139,4 +192,28 @@ void RSocketResponder::handleRequestResponseCore(
   auto single = handleRequestResponse(std::move(request), streamId);
   single->subscribe(std::move(responseObserver));
 }
+
+void RSocketResponder::handleRequestStreamCore(
+    LazyPayload request,
+    StreamId streamId,
+    const yarpl::Reference<yarpl::flowable::Subscriber<Payload>>&
+        response) noexcept {
+  auto flowable = handleRequestStreamLazy(std::move(request), streamId);
+  flowable->subscribe(std::move(response));
+}
+
+void RSocketResponder::handleRequestResponseCore(
+    LazyPayload request,
+    StreamId streamId,
+    const yarpl::Reference<yarpl::single::SingleObserver<Payload>>&
+        responseObserver) noexcept {
+  auto single = handleRequestResponseLazy(std::move(request), streamId);
+  single->subscribe(std::move(responseObserver));
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>> sharePayloads(
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> payloads) {
+  return payloads->share(
+      [](const Payload& payload) { return payload.clone(); });
+}
 } // namespace rsocket
@@ -2,13 +2,22 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "rsocket/LazyPayload.h"
+#include "rsocket/MetadataView.h"
 #include "rsocket/Payload.h"
+#include "rsocket/SerializedResponse.h"
 #include "rsocket/internal/Common.h"
 #include "yarpl/Flowable.h"
 #include "yarpl/Single.h"
 
 namespace rsocket {
 
+class RSocketRequester;
+
 /**
  * Responder APIs to handle requests on an RSocket connection.
  *
@@ -32,6 +41,42 @@ class RSocketResponder {
  public:
   virtual ~RSocketResponder() = default;
 
+  /**
+   * Called for every new request before its frame is deserialized, with a
+   * view of the metadata of the request.  Returning false rejects the request
+   * (fire-and-forget requests are dropped) before any Payload is built for
+   * it, so routing and admission decisions which only need the metadata don't
+   * allocate.
+   *
+   * The default accepts all requests.
+   */
+  virtual bool acceptRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      rsocket::StreamId streamId);
+
+  /**
+   * Called for every new request-response and request stream accepted by
+   * acceptRequest(), with the same view of its metadata, to forward it to
+   * another connection as a routing proxy does.
+   *
+   * Returning a requester forwards the frame of the request to a new stream
+   * of its connection, and from then on every frame of the two streams to
+   * the other one, with only their stream ids rewritten.  No Payload is
+   * built on either side, and REQUEST_N frames go through as they are, so
+   * the flow control is the one of the two ends of the proxy.  The fragments
+   * of fragmented frames go through as they are, but requests which arrive
+   * in fragments are handled as usual.
+   *
+   * Only connections with the same protocol version, from 1.0 on, and
+   * neither resumable nor compressed, forward requests; they are handled as
+   * usual otherwise.  The default returns nullptr, which doesn't forward.
+   */
+  virtual std::shared_ptr<RSocketRequester> forwardRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      rsocket::StreamId streamId);
+
   /**
    * Called when a new `requestResponse` occurs from an RSocketRequester.
    *
@@ -40,6 +85,29 @@ class RSocketResponder {
   virtual yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
   handleRequestResponse(rsocket::Payload request, rsocket::StreamId streamId);
 
+  /**
+   * Whether new request-responses are first offered to serializedResponse().
+   * Requests which are compressed or fragmented, or arrive on a connection
+   * which traces streams or generates cold resumption tokens, or with a
+   * protocol version before 1.0, are not.
+   *
+   * The default doesn't offer them.
+   */
+  virtual bool servesSerializedResponses() const;
+
+  /**
+   * Called for every new request-response accepted by acceptRequest(), if
+   * servesSerializedResponses(), with its payload left in its frame.
+   * Returning a response answers the request with it, as a clone of its
+   * serialized frame, without calling handleRequestResponse() or creating a
+   * stream for the request.  Returning nullptr handles the request as usual.
+   *
+   * The default returns nullptr.
+   */
+  virtual std::shared_ptr<const SerializedResponse> serializedResponse(
+      const rsocket::LazyPayload& request,
+      rsocket::StreamId streamId);
+
   /**
    * Called when a new `requestStream` occurs from an RSocketRequester.
    *
@@ -48,6 +116,39 @@ class RSocketResponder {
   virtual yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
   handleRequestStream(rsocket::Payload request, rsocket::StreamId streamId);
 
+  /**
+   * Whether new request-responses and request streams are handed to
+   * handleRequestResponseLazy() and handleRequestStreamLazy(), with the
+   * payload left in the frame of the request, instead of being cloned out of
+   * it for handleRequestResponse() and handleRequestStream().  Requests which
+   * are compressed or fragmented, or arrive on a connection which traces
+   * streams or generates cold resumption tokens, or with a protocol version
+   * before 1.0, still get a Payload.
+   *
+   * The default doesn't hand over lazy payloads.
+   */
+  virtual bool handlesLazyPayloads() const;
+
+  /**
+   * Called instead of handleRequestResponse() if handlesLazyPayloads().
+   *
+   * The default materializes the payload and calls handleRequestResponse().
+   */
+  virtual yarpl::Reference<yarpl::single::Single<rsocket::Payload>>
+  handleRequestResponseLazy(
+      rsocket::LazyPayload request,
+      rsocket::StreamId streamId);
+
+  /**
+   * Called instead of handleRequestStream() if handlesLazyPayloads().
+   *
+   * The default materializes the payload and calls handleRequestStream().
+   */
+  virtual yarpl::Reference<yarpl::flowable::Flowable<rsocket::Payload>>
+  handleRequestStreamLazy(
+      rsocket::LazyPayload request,
+      rsocket::StreamId streamId);
+
   /**
    * Called when a new `requestChannel` occurs from an RSocketRequester.
    *
@@ -69,6 +170,25 @@ class RSocketResponder {
       rsocket::Payload request,
       rsocket::StreamId streamId);
 
+  /**
+   * Whether the fire-and-forget requests read together from the connection
+   * are handed over in one handleFireAndForgetBatch() call, instead of one
+   * handleFireAndForget() call each.  They are then handled after the other
+   * frames read with them.
+   *
+   * The default doesn't batch them.
+   */
+  virtual bool batchesFireAndForget() const;
+
+  /**
+   * Called with the fire-and-forget requests read together from the
+   * connection, in order, if batchesFireAndForget().
+   *
+   * The default calls handleFireAndForget() for each of them.
+   */
+  virtual void handleFireAndForgetBatch(
+      std::vector<std::pair<rsocket::Payload, rsocket::StreamId>> requests);
+
   /**
    * Called when a new `metadataPush` occurs from an RSocketRequester.
    *
@@ -100,5 +220,28 @@ class RSocketResponder {
       StreamId streamId,
       const yarpl::Reference<yarpl::single::SingleObserver<Payload>>&
           response) noexcept;
+
+  /// Internal methods for handling requests with lazy payloads, not intended
+  /// to be used by application code.
+  void handleRequestStreamCore(
+      LazyPayload request,
+      StreamId streamId,
+      const yarpl::Reference<yarpl::flowable::Subscriber<Payload>>&
+          response) noexcept;
+  void handleRequestResponseCore(
+      LazyPayload request,
+      StreamId streamId,
+      const yarpl::Reference<yarpl::single::SingleObserver<Payload>>&
+          response) noexcept;
 };
+
+/// Shares one subscription of `payloads` between the streams of all the
+/// requesters it is returned to from handleRequestStream(), e.g. for the
+/// subscribers of a topic.  Each stream gets a clone of every payload, which
+/// shares the data and metadata buffers of the original, so they are only
+/// written once and each frame just has the header of its own stream in front
+/// of them.  The payloads are only requested as fast as the stream with the
+/// least REQUEST_N credit can take them, see Flowable::share().
+yarpl::Reference<yarpl::flowable::Flowable<Payload>> sharePayloads(
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> payloads);
 }
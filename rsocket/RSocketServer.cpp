@@ -1,14 +1,26 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include "rsocket/RSocketServer.h"
+
+#include <algorithm>
+
 #include <folly/io/async/EventBaseManager.h>
 
 #include <rsocket/internal/ScheduledRSocketResponder.h>
+#include "rsocket/CompressionDictionary.h"
 #include "rsocket/RSocketErrors.h"
 #include "rsocket/RSocketStats.h"
+#include "rsocket/ResumeStateStore.h"
+#include "rsocket/framing/CompressedDuplexConnection.h"
+#include "rsocket/framing/FrameTransportImpl.h"
 #include "rsocket/framing/FramedDuplexConnection.h"
 #include "rsocket/framing/ScheduledFrameTransport.h"
 #include "rsocket/internal/ConnectionSet.h"
+#include "rsocket/internal/ExecutorRSocketResponder.h"
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/internal/ResumeBufferPool.h"
+#include "rsocket/internal/ResumeStateTransfer.h"
+#include "rsocket/internal/WarmResumeManager.h"
 
 namespace rsocket {
 
@@ -16,9 +28,11 @@ RSocketServer::RSocketServer(
     std::unique_ptr<ConnectionAcceptor> connectionAcceptor,
     std::shared_ptr<RSocketStats> stats)
     : duplexConnectionAcceptor_(std::move(connectionAcceptor)),
-      setupResumeAcceptors_([] {
+      setupResumeAcceptors_([this] {
         return new rsocket::SetupResumeAcceptor{
-            folly::EventBaseManager::get()->getExistingEventBase()};
+            folly::EventBaseManager::get()->getExistingEventBase(),
+            protocolVersion_,
+            setupAdmission_};
       }),
       connectionSet_(std::make_shared<ConnectionSet>()),
       stats_(std::move(stats)) {}
@@ -29,10 +43,53 @@ RSocketServer::~RSocketServer() {
 }
 
 void RSocketServer::shutdownAndWait() {
-  if (isShutdown_) {
+  if (!beginShutdown()) {
+    return;
+  }
+
+  // Close off all outstanding connections.
+  connectionSet_.reset();
+  takeShardConnections();
+}
+
+void RSocketServer::shutdownAndWait(std::chrono::milliseconds drainTimeout) {
+  if (!beginShutdown()) {
     return;
   }
 
+  VLOG(1) << "Draining connections for up to " << drainTimeout.count()
+          << "ms";
+  auto shardConnections = takeShardConnections();
+  std::vector<folly::Future<folly::Unit>> drained;
+  drained.push_back(connectionSet_->drain(drainTimeout));
+  for (auto& connections : shardConnections) {
+    drained.push_back(connections->drain(drainTimeout));
+  }
+  folly::collectAll(drained).get();
+
+  // Close off any connection which may have raced with the acceptors closing.
+  connectionSet_.reset();
+}
+
+std::vector<std::shared_ptr<ConnectionSet>>
+RSocketServer::takeShardConnections() {
+  std::vector<std::shared_ptr<ConnectionSet>> connections;
+  for (auto* eventBase : shardEventBases_) {
+    eventBase->runImmediatelyOrRunInEventBaseThreadAndWait([&] {
+      auto& shard = *shards_;
+      if (shard && shard->connectionSet) {
+        connections.push_back(std::move(shard->connectionSet));
+      }
+    });
+  }
+  return connections;
+}
+
+bool RSocketServer::stopAccepting() {
+  if (isShutdown_) {
+    return false;
+  }
+
   // Will stop forwarding connections from duplexConnectionAcceptor_ to
   // setupResumeAcceptors_
   isShutdown_ = true;
@@ -49,9 +106,11 @@ void RSocketServer::shutdownAndWait() {
   }
 
   folly::collectAll(closingFutures).get();
+  return true;
+}
 
-  // Close off all outstanding connections.
-  connectionSet_.reset();
+bool RSocketServer::beginShutdown() {
+  return stopAccepting() || handedOver_.exchange(false);
 }
 
 void RSocketServer::start(
@@ -72,6 +131,68 @@ void RSocketServer::start(
       });
 }
 
+void RSocketServer::startSharded(ShardFactory makeShard) {
+  CHECK(duplexConnectionAcceptor_); // RSocketServer has to be initialized with
+  // the acceptor
+
+  if (started) {
+    throw std::runtime_error("RSocketServer::start() already called.");
+  }
+  started = true;
+  shardFactory_ = std::move(makeShard);
+
+  duplexConnectionAcceptor_->start(
+      [this](
+          std::unique_ptr<DuplexConnection> connection, folly::EventBase&) {
+        auto& shard = localShard();
+        shard.params.stats->serverConnectionAccepted();
+        accept(std::move(connection), shard.params.serviceHandler, &shard);
+      });
+
+  shardEventBases_ = duplexConnectionAcceptor_->workerEventBases();
+  if (shardEventBases_.empty()) {
+    throw std::runtime_error(
+        "RSocketServer::startSharded() needs an acceptor with worker "
+        "EventBases");
+  }
+
+  // Connections accepted so far have created the shards of their EventBases
+  // already, create the others now.
+  for (auto* eventBase : shardEventBases_) {
+    eventBase->runInEventBaseThreadAndWait([this] { localShard(); });
+  }
+}
+
+RSocketServer::Shard& RSocketServer::localShard() {
+  auto& shard = *shards_;
+  if (!shard) {
+    auto* eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+    CHECK(eventBase);
+    shard = std::make_unique<Shard>();
+    shard->params = shardFactory_(*eventBase);
+    CHECK(shard->params.serviceHandler);
+    if (!shard->params.stats) {
+      shard->params.stats = RSocketStats::noop();
+    }
+    shard->connectionSet = std::make_shared<ConnectionSet>();
+  }
+  return *shard;
+}
+
+folly::EventBase& RSocketServer::shardEventBase(size_t shard) const {
+  CHECK_LT(shard, shardEventBases_.size());
+  return *shardEventBases_[shard];
+}
+
+void RSocketServer::runOnShard(
+    size_t shard,
+    folly::Function<void(RSocketServiceHandler&)> func) {
+  shardEventBase(shard).runInEventBaseThread(
+      [ this, func = std::move(func) ]() mutable {
+        func(*localShard().params.serviceHandler);
+      });
+}
+
 void RSocketServer::start(OnNewSetupFn onNewSetupFn) {
   start(RSocketServiceHandler::create(std::move(onNewSetupFn)));
 }
@@ -84,11 +205,64 @@ void RSocketServer::setSingleThreadedResponder() {
   useScheduledResponder_ = false;
 }
 
+void RSocketServer::setResumeBufferPool(
+    std::shared_ptr<ResumeBufferPool> pool) {
+  resumeBufferPool_ = std::move(pool);
+}
+
+void RSocketServer::setResumeStateStore(
+    std::shared_ptr<ResumeStateStore> store) {
+  resumeStateStore_ = std::move(store);
+}
+
+void RSocketServer::setMaxFrameLength(size_t maxFrameLength) {
+  maxFrameLength_ = maxFrameLength;
+}
+
+void RSocketServer::setProtocolVersion(ProtocolVersion protocolVersion) {
+  protocolVersion_ = protocolVersion;
+}
+
+void RSocketServer::setLoadShedding(LoadSheddingOptions options) {
+  loadShedding_ = options;
+}
+
+void RSocketServer::setSetupAdmission(SetupAdmissionLimits limits) {
+  setupAdmission_ = limits;
+}
+
+void RSocketServer::setStreamLimits(StreamLimits limits) {
+  streamLimits_ = limits;
+}
+
+void RSocketServer::setMemoryGovernor(
+    std::shared_ptr<MemoryGovernor> governor) {
+  memoryGovernor_ = std::move(governor);
+}
+
+void RSocketServer::setConnectionCompression(
+    ConnectionCompression compression) {
+  connectionCompression_ = compression;
+}
+
+void RSocketServer::addCompressionDictionary(
+    std::shared_ptr<const CompressionDictionary> dictionary) {
+  auto const id = dictionary->id();
+  compressionDictionaries_[id] = std::move(dictionary);
+}
+
 void RSocketServer::acceptConnection(
     std::unique_ptr<DuplexConnection> connection,
     folly::EventBase&,
     std::shared_ptr<RSocketServiceHandler> serviceHandler) {
   stats_->serverConnectionAccepted();
+  accept(std::move(connection), std::move(serviceHandler), nullptr);
+}
+
+void RSocketServer::accept(
+    std::unique_ptr<DuplexConnection> connection,
+    std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    Shard* shard) {
   if (isShutdown_) {
     // connection is getting out of scope and terminated
     return;
@@ -98,8 +272,12 @@ void RSocketServer::acceptConnection(
   if (connection->isFramed()) {
     framedConnection = std::move(connection);
   } else {
+    if (connectionCompression_.codec != ConnectionCompression::Codec::NONE) {
+      connection = CompressedDuplexConnection::server(
+          std::move(connection), connectionCompression_.level, maxFrameLength_);
+    }
     framedConnection = std::make_unique<FramedDuplexConnection>(
-        std::move(connection), ProtocolVersion::Unknown);
+        std::move(connection), protocolVersion_, maxFrameLength_);
   }
 
   auto* acceptor = setupResumeAcceptors_.get();
@@ -112,62 +290,214 @@ void RSocketServer::acceptConnection(
           &RSocketServer::onRSocketSetup,
           this,
           serviceHandler,
+          shard,
           std::placeholders::_1,
           std::placeholders::_2),
       std::bind(
           &RSocketServer::onRSocketResume,
           this,
           serviceHandler,
+          shard,
           std::placeholders::_1,
           std::placeholders::_2));
 }
 
 void RSocketServer::onRSocketSetup(
     std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    Shard* shard,
     yarpl::Reference<FrameTransport> frameTransport,
     SetupParameters setupParams) {
   auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
   VLOG(2) << "Received new setup payload on " << eventBase->getName();
   CHECK(eventBase);
-  auto result = serviceHandler->onNewSetup(setupParams);
-  if (result.hasError()) {
-    VLOG(3) << "Terminating SETUP attempt from client.  No Responder";
-    throw result.error();
+  auto accepted = serviceHandler->onNewSetupAsync(setupParams);
+  if (accepted.isReady()) {
+    // A rejection throws, and SetupResumeAcceptor rejects the SETUP.
+    auto rs = createStateMachine(
+        *serviceHandler,
+        shard,
+        *eventBase,
+        setupParams,
+        std::move(accepted.value()),
+        nullptr);
+    rs->connectServer(std::move(frameTransport), std::move(setupParams));
+    return;
   }
-  auto connectionParams = std::move(result.value());
+
+  // The frames sent by the client meanwhile wait in the transport.
+  VLOG(3) << "Waiting for the service handler to accept the SETUP";
+  std::move(accepted).via(eventBase).then([
+    this,
+    serviceHandler = std::move(serviceHandler),
+    shard,
+    eventBase,
+    inProgress = setupResumeAcceptors_->trackInProgress(),
+    frameTransport = std::move(frameTransport),
+    setupParams = std::move(setupParams)
+  ](folly::Try<RSocketConnectionParams> result) mutable {
+    std::shared_ptr<RSocketStateMachine> rs;
+    try {
+      if (isShutdown_) {
+        throw RSocketException("Server is shutting down");
+      }
+      rs = createStateMachine(
+          *serviceHandler,
+          shard,
+          *eventBase,
+          setupParams,
+          std::move(result.value()),
+          nullptr);
+    } catch (const std::exception& exn) {
+      VLOG(3) << "Terminating SETUP attempt from client: " << exn.what();
+      auto const version = setupParams.protocolVersion;
+      SetupResumeAcceptor::rejectSetup(
+          std::move(frameTransport),
+          version,
+          folly::exception_wrapper{std::current_exception(), exn});
+      return;
+    }
+    rs->connectServer(std::move(frameTransport), std::move(setupParams));
+  });
+}
+
+std::shared_ptr<RSocketStateMachine> RSocketServer::createStateMachine(
+    RSocketServiceHandler& serviceHandler,
+    Shard* shard,
+    folly::EventBase& eventBase,
+    SetupParameters& setupParams,
+    RSocketConnectionParams connectionParams,
+    const ResumeStateTransfer* transferred) {
   if (!connectionParams.responder) {
     LOG(ERROR) << "Received invalid Responder. Dropping connection";
     throw RSocketException("Received invalid Responder from server");
   }
+  if (setupParams.lease && !connectionParams.leaseSender) {
+    VLOG(3) << "Terminating SETUP attempt from client.  No LeaseSender";
+    throw RSocketException("Server doesn't support leases");
+  }
+  std::shared_ptr<const CompressionDictionary> dictionary;
+  if (setupParams.compressionRequested) {
+    if (auto id = compressionDictionaryId(setupParams)) {
+      auto found = compressionDictionaries_.find(*id);
+      if (found == compressionDictionaries_.end()) {
+        VLOG(3) << "Terminating SETUP attempt from client.  No dictionary "
+                << *id;
+        throw RSocketException("Unknown compression dictionary");
+      }
+      dictionary = found->second;
+    }
+  }
+  // The connections of a shard never leave its EventBase.
+  auto const useScheduledResponder = useScheduledResponder_ && !shard;
+  std::shared_ptr<WarmResumeManager> resumeManager;
+  if ((resumeBufferPool_ && setupParams.resumable) || transferred) {
+    auto stats =
+        connectionParams.stats ? connectionParams.stats : RSocketStats::noop();
+    resumeManager = resumeBufferPool_
+        ? std::make_shared<WarmResumeManager>(stats, resumeBufferPool_)
+        : std::make_shared<WarmResumeManager>(stats);
+    if (transferred && !resumeManager->importState(*transferred)) {
+      throw RSocketException("Invalid resumption state");
+    }
+  }
+  std::shared_ptr<RSocketResponder> responder;
+  if (connectionParams.responderExecutor) {
+    responder = std::make_shared<ExecutorRSocketResponder>(
+        std::move(connectionParams.responder),
+        connectionParams.responderExecutor->createQueue(),
+        eventBase);
+  } else if (useScheduledResponder) {
+    responder = std::make_shared<ScheduledRSocketResponder>(
+        std::move(connectionParams.responder), eventBase);
+  } else {
+    responder = std::move(connectionParams.responder);
+  }
   auto rs = std::make_shared<RSocketStateMachine>(
-      useScheduledResponder_
-          ? std::make_shared<ScheduledRSocketResponder>(
-              std::move(connectionParams.responder), *eventBase)
-          : std::move(connectionParams.responder),
+      std::move(responder),
       nullptr,
       RSocketMode::SERVER,
       std::move(connectionParams.stats),
       std::move(connectionParams.connectionEvents),
-      nullptr, /* resumeManager */
-      nullptr /* coldResumeHandler */);
+      std::move(resumeManager),
+      nullptr, /* coldResumeHandler */
+      std::move(connectionParams.leaseSender));
+  rs->setSetupIdentity(
+      setupParams.token,
+      setupParams.metadataMimeType,
+      setupParams.dataMimeType);
 
-  connectionSet_->insert(rs, eventBase);
-  rs->registerSet(connectionSet_);
+  if (loadShedding_.enabled()) {
+    auto& monitor = loadMonitors_.getOrCreate(
+        eventBase,
+        eventBase,
+        loadShedding_,
+        shard ? shard->params.stats : stats_);
+    rs->setEventBaseLoad(monitor.load());
+  }
+  if (streamLimits_.maxPerConnection > 0 || streamLimits_.maxPerServer > 0) {
+    rs->setStreamLimits(streamLimits_, streamCount_);
+  }
+  if (memoryGovernor_) {
+    rs->setMemoryGovernor(memoryGovernor_);
+  }
+
+  auto& connectionSet = shard ? shard->connectionSet : connectionSet_;
+  connectionSet->insert(rs, &eventBase);
+  rs->registerSet(connectionSet, &eventBase);
 
-  auto requester = std::make_shared<RSocketRequester>(rs, *eventBase);
-  auto serverState = std::shared_ptr<RSocketServerState>(
-      new RSocketServerState(*eventBase, rs, requester));
-  serviceHandler->onNewRSocketState(std::move(serverState), setupParams.token);
-  rs->connectServer(std::move(frameTransport), std::move(setupParams));
+  auto requester = std::make_shared<RSocketRequester>(rs, eventBase);
+  auto serverState = std::shared_ptr<RSocketServerState>(new RSocketServerState(
+      eventBase,
+      rs,
+      requester,
+      setupParams.metadataMimeType,
+      setupParams.dataMimeType));
+  serviceHandler.onNewRSocketState(std::move(serverState), setupParams.token);
+  setupParams.mtu = connectionParams.mtu;
+  setupParams.requestNBatching = connectionParams.requestNBatching;
+  setupParams.adaptiveRequestN = connectionParams.adaptiveRequestN;
+  setupParams.pendingFrameLimits = connectionParams.pendingFrameLimits;
+  setupParams.streamSerializeAhead = connectionParams.streamSerializeAhead;
+  setupParams.positionAckBytes = connectionParams.positionAckBytes;
+  setupParams.memoryLimits = connectionParams.memoryLimits;
+  setupParams.hibernateAfter = connectionParams.hibernateAfter;
+  setupParams.compression = connectionParams.compression;
+  // Only the dictionary the client has will do.
+  setupParams.compression.dictionary = std::move(dictionary);
+  return rs;
 }
 
 void RSocketServer::onRSocketResume(
     std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    Shard* shard,
     yarpl::Reference<FrameTransport> frameTransport,
     ResumeParameters resumeParams) {
   auto result = serviceHandler->onResume(resumeParams.token);
   if (result.hasError()) {
-    stats_->resumeFailedNoState();
+    std::unique_ptr<folly::IOBuf> handedOver;
+    {
+      auto states = handedOverStates_.lock();
+      auto found = states->find(resumeParams.token);
+      if (found != states->end()) {
+        handedOver = std::move(found->second);
+        states->erase(found);
+      }
+    }
+    if (handedOver || resumeStateStore_) {
+      auto fetched = handedOver
+          ? folly::makeFuture(std::move(handedOver))
+          : resumeStateStore_->fetch(resumeParams.token);
+      resumeFromStore(
+          std::move(serviceHandler),
+          shard,
+          std::move(frameTransport),
+          std::move(resumeParams),
+          std::move(fetched));
+      return;
+    }
+  }
+  if (result.hasError()) {
+    (shard ? shard->params.stats : stats_)->resumeFailedNoState();
     VLOG(3) << "Terminating RESUME attempt from client.  No ServerState found";
     throw result.error();
   }
@@ -201,6 +531,91 @@ void RSocketServer::onRSocketResume(
   }
 }
 
+void RSocketServer::resumeFromStore(
+    std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    Shard* shard,
+    yarpl::Reference<FrameTransport> frameTransport,
+    ResumeParameters resumeParams,
+    folly::Future<std::unique_ptr<folly::IOBuf>> fetched) {
+  auto* eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  VLOG(2) << "Fetching the resumption state of client on "
+          << eventBase->getName();
+  // Filled in once the state is fetched.
+  struct Handover {
+    ResumeStateTransfer state;
+    SetupParameters setupParams;
+  };
+  auto handover = std::make_shared<Handover>();
+  auto inProgress = setupResumeAcceptors_->trackInProgress();
+  std::move(fetched)
+      .via(eventBase)
+      .then([
+        this,
+        serviceHandler,
+        shard,
+        eventBase,
+        handover,
+        resumeParams
+      ](std::unique_ptr<folly::IOBuf> buf) {
+        if (isShutdown_) {
+          throw RSocketException("Server is shutting down");
+        }
+        auto state =
+            buf ? ResumeStateTransfer::deserialize(*buf) : folly::none;
+        if (!state || state->protocolVersion != resumeParams.protocolVersion) {
+          (shard ? shard->params.stats : stats_)->resumeFailedNoState();
+          throw RSocketException("No ServerState");
+        }
+        handover->setupParams = SetupParameters(
+            state->metadataMimeType,
+            state->dataMimeType,
+            Payload(),
+            true,
+            resumeParams.token,
+            state->protocolVersion);
+        handover->state = std::move(*state);
+        return serviceHandler->onNewSetupAsync(handover->setupParams)
+            .via(eventBase);
+      })
+      .then([
+        this,
+        serviceHandler = std::move(serviceHandler),
+        shard,
+        eventBase,
+        handover,
+        inProgress = std::move(inProgress),
+        frameTransport = std::move(frameTransport),
+        resumeParams = std::move(resumeParams)
+      ](folly::Try<RSocketConnectionParams> result) mutable {
+        std::shared_ptr<RSocketStateMachine> rs;
+        try {
+          if (isShutdown_) {
+            throw RSocketException("Server is shutting down");
+          }
+          rs = createStateMachine(
+              *serviceHandler,
+              shard,
+              *eventBase,
+              handover->setupParams,
+              std::move(result.value()),
+              &handover->state);
+        } catch (const std::exception& exn) {
+          VLOG(3) << "Terminating RESUME attempt from client: " << exn.what();
+          SetupResumeAcceptor::rejectResume(
+              std::move(frameTransport),
+              resumeParams.protocolVersion,
+              folly::exception_wrapper{std::current_exception(), exn});
+          return;
+        }
+        VLOG(2) << "Resuming client handed over on " << eventBase->getName();
+        rs->resumeTransferredServer(
+            std::move(frameTransport),
+            resumeParams,
+            handover->setupParams,
+            handover->state);
+      });
+}
+
 void RSocketServer::startAndPark(
     std::shared_ptr<RSocketServiceHandler> serviceHandler) {
   start(std::move(serviceHandler));
@@ -211,6 +626,247 @@ void RSocketServer::unpark() {
   waiting_.post();
 }
 
+void RSocketServer::broadcastMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  if (isShutdown_) {
+    return;
+  }
+  auto push = std::make_shared<SharedMetadataPush>(std::move(metadata));
+  connectionSet_->metadataPush(push);
+  for (auto* eventBase : shardEventBases_) {
+    eventBase->runInEventBaseThread([this, push] {
+      auto& shard = *shards_;
+      if (shard && shard->connectionSet) {
+        shard->connectionSet->metadataPush(push);
+      }
+    });
+  }
+}
+
+folly::Future<std::vector<ConnectionSnapshot>> RSocketServer::snapshot() {
+  if (isShutdown_) {
+    return folly::makeFuture(std::vector<ConnectionSnapshot>());
+  }
+
+  std::vector<folly::Future<std::vector<ConnectionSnapshot>>> snapshots;
+  snapshots.push_back(connectionSet_->snapshot());
+  for (auto* eventBase : shardEventBases_) {
+    auto promise =
+        std::make_shared<folly::Promise<std::vector<ConnectionSnapshot>>>();
+    snapshots.push_back(promise->getFuture());
+    eventBase->runInEventBaseThread([this, promise] {
+      auto& shard = *shards_;
+      if (!shard || !shard->connectionSet) {
+        promise->setValue(std::vector<ConnectionSnapshot>());
+        return;
+      }
+      shard->connectionSet->snapshot().then(
+          [promise](std::vector<ConnectionSnapshot> snapshots) {
+            promise->setValue(std::move(snapshots));
+          });
+    });
+  }
+
+  return ConnectionSet::collectSnapshots(std::move(snapshots));
+}
+
+folly::Future<size_t> RSocketServer::migrateConnections(
+    folly::EventBase& from,
+    folly::EventBase& to,
+    size_t maxConnections) {
+  if (isShutdown_ || &from == &to || maxConnections == 0) {
+    return folly::makeFuture<size_t>(0);
+  }
+  return connectionSet_->migrate(from, to, maxConnections);
+}
+
+folly::Future<size_t> RSocketServer::rebalance(size_t maxConnections) {
+  auto workers = duplexConnectionAcceptor_
+      ? duplexConnectionAcceptor_->workerEventBases()
+      : std::vector<folly::EventBase*>();
+  if (isShutdown_ || workers.size() < 2) {
+    return folly::makeFuture<size_t>(0);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  std::vector<folly::Future<Clock::duration>> waits;
+  for (auto* eventBase : workers) {
+    auto promise = std::make_shared<folly::Promise<Clock::duration>>();
+    waits.push_back(promise->getFuture());
+    eventBase->runInEventBaseThread([ promise, queued = Clock::now() ] {
+      promise->setValue(Clock::now() - queued);
+    });
+  }
+
+  return folly::collect(waits).then(
+      [ this, workers = std::move(workers), maxConnections ](
+          std::vector<Clock::duration> waited) {
+        auto const busiest =
+            std::max_element(waited.begin(), waited.end()) - waited.begin();
+        auto const idlest =
+            std::min_element(waited.begin(), waited.end()) - waited.begin();
+        VLOG(2) << "Rebalancing from " << workers[busiest]->getName()
+                << " to " << workers[idlest]->getName();
+        return migrateConnections(
+            *workers[busiest], *workers[idlest], maxConnections);
+      });
+}
+
+std::vector<int> RSocketServer::listeningSockets() const {
+  return duplexConnectionAcceptor_
+      ? duplexConnectionAcceptor_->listeningSockets()
+      : std::vector<int>();
+}
+
+folly::Future<std::vector<HandedOverConnection>>
+RSocketServer::handOverConnections() {
+  if (!stopAccepting()) {
+    return folly::makeFuture(std::vector<HandedOverConnection>());
+  }
+  handedOver_ = true;
+
+  std::vector<folly::Future<std::vector<HandedOverConnection>>> handedOver;
+  handedOver.push_back(connectionSet_->handOver());
+  for (auto* eventBase : shardEventBases_) {
+    handedOver.push_back(folly::via(eventBase, [this] {
+      auto& shard = *shards_;
+      if (!shard || !shard->connectionSet) {
+        return folly::makeFuture(std::vector<HandedOverConnection>());
+      }
+      return shard->connectionSet->handOver();
+    }));
+  }
+
+  return ConnectionSet::collectHandedOver(std::move(handedOver));
+}
+
+size_t RSocketServer::adoptConnections(
+    std::vector<HandedOverConnection> connections,
+    std::shared_ptr<RSocketServiceHandler> serviceHandler) {
+  CHECK(started);
+  auto workers = duplexConnectionAcceptor_->workerEventBases();
+  size_t next = 0;
+
+  std::vector<folly::Future<bool>> adopted;
+  for (auto& connection : connections) {
+    auto state = connection.state
+        ? ResumeStateTransfer::deserialize(*connection.state)
+        : folly::none;
+    if (!state) {
+      LOG(ERROR) << "Dropping a connection handed over with an invalid state";
+      continue;
+    }
+    if (connection.fd < 0 || workers.empty()) {
+      keepHandedOverState(state->token, std::move(connection.state));
+      continue;
+    }
+    auto* eventBase = workers[next++ % workers.size()];
+    adopted.push_back(folly::via(eventBase, [
+      this,
+      connection = std::move(connection),
+      state = std::move(*state),
+      serviceHandler,
+      eventBase
+    ]() mutable {
+      return adoptConnection(
+          std::move(connection),
+          std::move(state),
+          std::move(serviceHandler),
+          *eventBase);
+    }));
+  }
+
+  size_t count = 0;
+  for (auto& result : folly::collectAll(adopted).get()) {
+    if (result.hasValue() && result.value()) {
+      ++count;
+    }
+  }
+  VLOG(1) << "Adopted " << count << " of " << connections.size()
+          << " connections handed over";
+  return count;
+}
+
+folly::Future<bool> RSocketServer::adoptConnection(
+    HandedOverConnection connection,
+    ResumeStateTransfer state,
+    std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    folly::EventBase& eventBase) {
+  auto* shard = shardFactory_ ? &localShard() : nullptr;
+  if (shard) {
+    serviceHandler = shard->params.serviceHandler;
+  }
+  auto socket =
+      duplexConnectionAcceptor_->adoptSocket(connection.fd, eventBase);
+  if (!socket) {
+    keepHandedOverState(state.token, std::move(connection.state));
+    return folly::makeFuture(false);
+  }
+  // The connection owns the socket now.
+  connection.fd = -1;
+
+  auto framed = std::make_unique<FramedDuplexConnection>(
+      std::move(socket), state.protocolVersion, maxFrameLength_);
+  if (connection.unread) {
+    framed->prependInput(std::move(connection.unread));
+  }
+  auto frameTransport = yarpl::make_ref<FrameTransportImpl>(std::move(framed));
+
+  struct Adoption {
+    ResumeStateTransfer state;
+    SetupParameters setupParams;
+  };
+  auto adoption = std::make_shared<Adoption>();
+  adoption->setupParams = SetupParameters(
+      state.metadataMimeType,
+      state.dataMimeType,
+      Payload(),
+      true,
+      state.token,
+      state.protocolVersion);
+  adoption->state = std::move(state);
+
+  return serviceHandler->onNewSetupAsync(adoption->setupParams)
+      .via(&eventBase)
+      .then([
+        this,
+        serviceHandler,
+        shard,
+        &eventBase,
+        adoption,
+        frameTransport = std::move(frameTransport)
+      ](folly::Try<RSocketConnectionParams> result) mutable {
+        std::shared_ptr<RSocketStateMachine> rs;
+        try {
+          if (isShutdown_) {
+            throw RSocketException("Server is shutting down");
+          }
+          rs = createStateMachine(
+              *serviceHandler,
+              shard,
+              eventBase,
+              adoption->setupParams,
+              std::move(result.value()),
+              &adoption->state);
+        } catch (const std::exception& exn) {
+          VLOG(3) << "Closing connection handed over: " << exn.what();
+          frameTransport->close();
+          return false;
+        }
+        VLOG(2) << "Adopting connection handed over on " << eventBase.getName();
+        rs->adoptTransferredServer(
+            std::move(frameTransport), adoption->setupParams, adoption->state);
+        return true;
+      });
+}
+
+void RSocketServer::keepHandedOverState(
+    const ResumeIdentificationToken& token,
+    std::unique_ptr<folly::IOBuf> state) {
+  VLOG(2) << "Keeping the state of connection " << token << " to resume";
+  (*handedOverStates_.lock())[token] = std::move(state);
+}
+
 folly::Optional<uint16_t> RSocketServer::listeningPort() const {
   return duplexConnectionAcceptor_ ? duplexConnectionAcceptor_->listeningPort()
                                    : folly::none;
@@ -2,19 +2,37 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <folly/Baton.h>
+#include <folly/Function.h>
 #include <folly/Synchronized.h>
 #include <folly/ThreadLocal.h>
+#include <folly/io/async/EventBaseLocal.h>
 #include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/ConnectionSnapshot.h"
+#include "rsocket/HotRestart.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketServiceHandler.h"
+#include "rsocket/internal/EventBaseLoadMonitor.h"
 #include "rsocket/internal/SetupResumeAcceptor.h"
 
 namespace rsocket {
 
+class CompressionDictionary;
+class MemoryGovernor;
+class ResumeBufferPool;
+class ResumeStateStore;
+struct ResumeStateTransfer;
+
 /**
  * API for starting an RSocket server. Returned from RSocket::createServer.
  *
@@ -24,6 +42,17 @@ namespace rsocket {
  */
 class RSocketServer {
  public:
+  /// What a shard of a sharded server handles its connections with, see
+  /// startSharded().
+  struct ShardParams {
+    std::shared_ptr<RSocketServiceHandler> serviceHandler;
+    std::shared_ptr<RSocketStats> stats{RSocketStats::noop()};
+  };
+
+  /// Creates the ShardParams of the shard of an EventBase.  Called on the
+  /// thread of that EventBase.
+  using ShardFactory = std::function<ShardParams(folly::EventBase&)>;
+
   explicit RSocketServer(
       std::unique_ptr<ConnectionAcceptor>,
       std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
@@ -60,6 +89,48 @@ class RSocketServer {
   void startAndPark(std::shared_ptr<RSocketServiceHandler> serviceHandler);
   void startAndPark(OnNewSetupFn onNewSetupFn);
 
+  /**
+   * Start the ConnectionAcceptor as a thread-per-core server, with one shard
+   * per worker EventBase of the acceptor (see
+   * ConnectionAcceptor::workerEventBases(), and
+   * TcpConnectionAcceptor::Options::reusePort to also give each worker its own
+   * listening socket).
+   *
+   * Each shard is created by `makeShard` on its EventBase and has its own
+   * service handler, stats, setup acceptor and set of connections.  The
+   * connections of a shard stay on its EventBase and their responders are
+   * called there directly, without ScheduledRSocketResponder, so nothing is
+   * shared across the shards.  Warm resumption only finds the state of
+   * connections set up by the same shard, unless the service handlers share
+   * it.
+   *
+   * Blocks until all the shards have been created.  Throws if the acceptor has
+   * no worker EventBases.
+   *
+   * This method assumes it will be called only once, instead of start().
+   */
+  void startSharded(ShardFactory makeShard);
+
+  /**
+   * Number of shards of a server started with startSharded(), 0 otherwise.
+   */
+  size_t shardCount() const {
+    return shardEventBases_.size();
+  }
+
+  /**
+   * The EventBase of a shard, `shard` is below shardCount().
+   */
+  folly::EventBase& shardEventBase(size_t shard) const;
+
+  /**
+   * Run `func` on the EventBase of a shard with the service handler of the
+   * shard.  The server must outlive the call.
+   */
+  void runOnShard(
+      size_t shard,
+      folly::Function<void(RSocketServiceHandler&)> func);
+
   /**
    * Unblock the server if it has called startAndPark().  Can only be called
    * once.
@@ -77,6 +148,103 @@ class RSocketServer {
 
   void shutdownAndWait();
 
+  /**
+   * Gracefully shut down the server.  Stops accepting new connections, then
+   * drains the open ones in parallel on their EventBases: new requests are
+   * rejected and each connection is closed once its in-flight streams have
+   * terminated, or after `drainTimeout` at the latest.  Blocks until all the
+   * connections have closed.
+   */
+  void shutdownAndWait(std::chrono::milliseconds drainTimeout);
+
+  /**
+   * Send a METADATA_PUSH frame with `metadata` to all the connections of the
+   * server, e.g. to broadcast a configuration change.  The frame is serialized
+   * once and its buffer is shared by the connections, which are handed their
+   * frames with one hop per EventBase.  Only the connections which have
+   * completed their setup get the frame.  Must not race with the shutdown of
+   * the server.
+   */
+  void broadcastMetadataPush(std::unique_ptr<folly::IOBuf> metadata);
+
+  /**
+   * Take a snapshot of the open connections of the server and of their
+   * streams, e.g. to find the hot ones while latency spikes.  The connections
+   * keep running: each of them is read on its own EventBase, with one hop per
+   * EventBase, so a snapshot is cheap enough to take in production.  The
+   * snapshots of the connections aren't taken at the same time.
+   *
+   * The future completes on one of the EventBases, it must not be waited for
+   * on an EventBase of the server.  It has no connections once the server is
+   * shut down.
+   */
+  folly::Future<std::vector<ConnectionSnapshot>> snapshot();
+
+  /**
+   * Move the IO of at most `maxConnections` open connections from the worker
+   * EventBase `from` to `to`: their sockets are read and written, and their
+   * frames are parsed, on `to` from then on.  The state machines, and the
+   * streams open on them, stay on `from` and are not interrupted.  The
+   * connections with writes in flight are skipped, as are those resumed on
+   * another EventBase and those moved already.  See
+   * RSocketStateMachine::migrateTransport().
+   *
+   * The future completes on `from` with the number of connections moved.
+   * Only for the connections of a server started with start().
+   */
+  folly::Future<size_t> migrateConnections(
+      folly::EventBase& from,
+      folly::EventBase& to,
+      size_t maxConnections);
+
+  /**
+   * Measure how long a task waits in the queue of each worker EventBase of
+   * the acceptor, and move the IO of at most `maxConnections` connections
+   * from the busiest one to the least busy one, see migrateConnections().
+   * Meant to be called periodically while a few heavy connections keep one
+   * worker busier than the others.
+   *
+   * The future completes with the number of connections moved, it must not
+   * be waited for on an EventBase of the server.  Must not race with the
+   * shutdown of the server.
+   */
+  folly::Future<size_t> rebalance(size_t maxConnections);
+
+  /**
+   * The listening sockets of the acceptor, to hand them over to the process
+   * restarting this server, see HotRestart.h.  They stay owned by the
+   * acceptor.
+   */
+  std::vector<int> listeningSockets() const;
+
+  /**
+   * Hand the connections over to the process restarting this server, see
+   * HotRestart.h: stops accepting, then releases the resumable connections
+   * with their sockets and their resumption state, see
+   * RSocketStateMachine::exportResumeState(), and closes them here.  Their
+   * streams are canceled.  The other connections keep running, they are
+   * drained or closed by a shutdownAndWait() call afterwards.
+   *
+   * The future completes on one of the EventBases, it must not be waited for
+   * on an EventBase of the server.
+   */
+  folly::Future<std::vector<HandedOverConnection>> handOverConnections();
+
+  /**
+   * Carry on with the connections the process this server restarts has
+   * handed over, see handOverConnections(), on the worker EventBases of the
+   * acceptor in turn.  Each of them is set up with `serviceHandler`, or the
+   * service handler of its shard, as if its client had sent the SETUP again.
+   * The connections handed over without their socket, or whose socket can't
+   * be adopted, are resumed here once their clients reconnect.  Blocks until
+   * all of them are set up, must be called after start(), not on an
+   * EventBase of the server.  Returns the number of connections carrying on
+   * over their socket.
+   */
+  size_t adoptConnections(
+      std::vector<HandedOverConnection> connections,
+      std::shared_ptr<RSocketServiceHandler> serviceHandler);
+
   /**
    * Gets the port the ConnectionAcceptor is listening on.  Returns folly::none
    * if this server is not listening on a port.
@@ -89,16 +257,163 @@ class RSocketServer {
    */
   void setSingleThreadedResponder();
 
+  /**
+   * Buffer the sent frames of the resumable connections in chunks borrowed
+   * from `pool`, bounding the memory used for resumption by all of them.  Only
+   * applies to the connections set up afterwards.
+   */
+  void setResumeBufferPool(std::shared_ptr<ResumeBufferPool> pool);
+
+  /**
+   * Look up the resumption state of the clients resuming a connection the
+   * service handler doesn't know in `store`, e.g. in the other hosts of a
+   * cluster.  The connection is then resumed here, see ResumeStateStore.
+   */
+  void setResumeStateStore(std::shared_ptr<ResumeStateStore> store);
+
+  /**
+   * Fail the connections which receive or send a frame longer than
+   * `maxFrameLength` bytes, checked as soon as its length field is read and
+   * before it is buffered.  Defaults to the protocol maximum, kMaxFrameLength.
+   * Only applies to the connections accepted afterwards, on transports which
+   * aren't framed.
+   */
+  void setMaxFrameLength(size_t maxFrameLength);
+
+  /**
+   * Only accept clients of `protocolVersion`, e.g. ProtocolVersion(1, 0),
+   * instead of detecting the version of each connection from its first
+   * frame.  The framing and the serializer of the connections are set up for
+   * it as they are accepted, and connections of other versions are closed.
+   * Must be called before the server is started.
+   */
+  void setProtocolVersion(ProtocolVersion protocolVersion);
+
+  /**
+   * Reject new requests with REJECTED, and stop issuing leases, on the
+   * EventBases which can't keep up with their connections, so that requests
+   * fail fast under overload rather than wait in the queues.  See
+   * LoadSheddingOptions.  Must be called before the server is started.
+   */
+  void setLoadShedding(LoadSheddingOptions options);
+
+  /**
+   * Bound the SETUPs and RESUMEs processed at once on each worker EventBase,
+   * shedding the others with an ERROR frame, with room kept for the RESUMEs.
+   * See SetupAdmissionLimits.  Must be called before the server is started.
+   */
+  void setSetupAdmission(SetupAdmissionLimits limits);
+
+  /**
+   * Bound the streams the clients have open at once, per connection and over
+   * all the connections, rejecting the requests past them with REJECTED.  See
+   * StreamLimits.  Must be called before the server is started.
+   */
+  void setStreamLimits(StreamLimits limits);
+
+  /**
+   * Report the bytes the connections hold to `governor`, which shrinks their
+   * resume buffers, cuts their windows back and rejects new streams as the
+   * usage of all the connections sharing it approaches its budget.  See
+   * MemoryGovernor.  Must be called before the server is started.
+   */
+  void setMemoryGovernor(std::shared_ptr<MemoryGovernor> governor);
+
+  /**
+   * Compress the connections whose clients ask for it in their SETUP, with
+   * one streaming context per direction at `compression.level`; the clients
+   * pick the codec.  Only applies to transports without framing of their own,
+   * see ConnectionCompression.  A NONE codec, the default, leaves the bytes of
+   * every connection alone.  Must be called before the server is started.
+   */
+  void setConnectionCompression(ConnectionCompression compression);
+
+  /**
+   * Compress and decompress the payloads of the clients naming this dictionary
+   * in their SETUP with it, see PayloadCompression::dictionary.  It is loaded
+   * once and shared by all the connections.  The clients naming a dictionary
+   * the server doesn't have are rejected.  Must be called before the server is
+   * started.
+   */
+  void addCompressionDictionary(
+      std::shared_ptr<const CompressionDictionary> dictionary);
+
  private:
+  /// A shard of a server started with startSharded().  Only used on the thread
+  /// it was created on.
+  struct Shard {
+    ShardParams params;
+    std::shared_ptr<ConnectionSet> connectionSet;
+  };
+
+  /// Returns the shard of the current thread, creating it the first time.
+  Shard& localShard();
+
+  /// Takes the connections out of all the shards.
+  std::vector<std::shared_ptr<ConnectionSet>> takeShardConnections();
+
+  /// Sets up a connection, on behalf of `shard` unless it is nullptr.
+  void accept(
+      std::unique_ptr<DuplexConnection> connection,
+      std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      Shard* shard);
+
   void onRSocketSetup(
       std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      Shard* shard,
       yarpl::Reference<rsocket::FrameTransport> frameTransport,
       rsocket::SetupParameters setupPayload);
+
+  /// Creates the state machine of a new connection, or of one handed over by
+  /// another host if `transferred` isn't null, with the parameters the service
+  /// handler accepted it with, and gives it to the service handler.  Fills in
+  /// the local settings of `setupParams`.  Throws if the parameters are
+  /// invalid.
+  std::shared_ptr<RSocketStateMachine> createStateMachine(
+      RSocketServiceHandler& serviceHandler,
+      Shard* shard,
+      folly::EventBase& eventBase,
+      SetupParameters& setupParams,
+      RSocketConnectionParams connectionParams,
+      const ResumeStateTransfer* transferred);
+
+  /// Stops accepting new connections and closes the pending setups.  Returns
+  /// false if the server has already been shut down.
+  bool stopAccepting();
+
+  /// Like stopAccepting(), but also true once after handOverConnections(),
+  /// so that the connections left behind are shut down.
+  bool beginShutdown();
+
+  /// Sets up a connection handed over with its socket, on `eventBase`.
+  /// Completes with false if it couldn't be.
+  folly::Future<bool> adoptConnection(
+      HandedOverConnection connection,
+      ResumeStateTransfer state,
+      std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      folly::EventBase& eventBase);
+
+  /// Keeps the state of a connection handed over for its client to resume.
+  void keepHandedOverState(
+      const ResumeIdentificationToken& token,
+      std::unique_ptr<folly::IOBuf> state);
+
   void onRSocketResume(
       std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      Shard* shard,
       yarpl::Reference<rsocket::FrameTransport> frameTransport,
       rsocket::ResumeParameters setupPayload);
 
+  /// Resumes a connection the service handler doesn't know with the state
+  /// `fetched`, from a connection handed over or from resumeStateStore_, or
+  /// rejects the RESUME.
+  void resumeFromStore(
+      std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      Shard* shard,
+      yarpl::Reference<rsocket::FrameTransport> frameTransport,
+      rsocket::ResumeParameters resumeParams,
+      folly::Future<std::unique_ptr<folly::IOBuf>> fetched);
+
   std::unique_ptr<ConnectionAcceptor> duplexConnectionAcceptor_;
   bool started{false};
 
@@ -106,8 +421,15 @@ class RSocketServer {
   folly::ThreadLocal<rsocket::SetupResumeAcceptor, SetupResumeAcceptorTag>
       setupResumeAcceptors_;
 
+  class ShardTag {};
+  folly::ThreadLocal<std::unique_ptr<Shard>, ShardTag> shards_;
+  ShardFactory shardFactory_;
+  std::vector<folly::EventBase*> shardEventBases_;
+
   folly::Baton<> waiting_;
   std::atomic<bool> isShutdown_{false};
+  /// Set by handOverConnections() until the server is shut down.
+  std::atomic<bool> handedOver_{false};
 
   std::shared_ptr<ConnectionSet> connectionSet_;
   std::shared_ptr<RSocketStats> stats_;
@@ -118,5 +440,35 @@ class RSocketServer {
    * be scheduled to another event base.
    */
   bool useScheduledResponder_{true};
+
+  std::shared_ptr<ResumeBufferPool> resumeBufferPool_;
+  std::shared_ptr<ResumeStateStore> resumeStateStore_;
+  /// The serialized states of the connections handed over without their
+  /// socket, until their clients resume them.
+  folly::Synchronized<
+      std::map<ResumeIdentificationToken, std::unique_ptr<folly::IOBuf>>,
+      std::mutex>
+      handedOverStates_;
+  size_t maxFrameLength_{kMaxFrameLength};
+  ProtocolVersion protocolVersion_{ProtocolVersion::Unknown};
+
+  std::unordered_map<uint32_t, std::shared_ptr<const CompressionDictionary>>
+      compressionDictionaries_;
+
+  SetupAdmissionLimits setupAdmission_;
+
+  LoadSheddingOptions loadShedding_;
+  /// The monitors of the EventBases with connections, with loadShedding_.
+  folly::EventBaseLocal<EventBaseLoadMonitor> loadMonitors_;
+
+  StreamLimits streamLimits_;
+  /// The streams the clients of all the connections have open, against
+  /// StreamLimits::maxPerServer.
+  const std::shared_ptr<std::atomic<size_t>> streamCount_{
+      std::make_shared<std::atomic<size_t>>(0)};
+
+  ConnectionCompression connectionCompression_;
+
+  std::shared_ptr<MemoryGovernor> memoryGovernor_;
 };
 } // namespace rsocket
@@ -0,0 +1,30 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/RSocketServerState.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/internal/ResumeStateTransfer.h"
+
+namespace rsocket {
+
+folly::Future<std::unique_ptr<folly::IOBuf>>
+RSocketServerState::exportResumeState() {
+  return folly::makeFuture()
+      .via(&eventBase_)
+      .then([
+        sm = rSocketStateMachine_,
+        metadataMimeType = metadataMimeType_,
+        dataMimeType = dataMimeType_
+      ]() -> std::unique_ptr<folly::IOBuf> {
+        ResumeStateTransfer state;
+        if (!sm->exportResumeState(state)) {
+          return nullptr;
+        }
+        state.metadataMimeType = metadataMimeType;
+        state.dataMimeType = dataMimeType;
+        return state.serialize();
+      });
+}
+
+} // namespace rsocket
@@ -2,6 +2,11 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
+#include <folly/futures/Future.h>
+
 #include "rsocket/RSocketRequester.h"
 
 namespace folly {
@@ -22,19 +27,32 @@ class RSocketServerState {
     return rSocketRequester_;
   }
 
+  /// Hands the connection over to another host, see ResumeStateStore: returns
+  /// the state to resume it from and closes it here.  Fulfilled with nullptr
+  /// if the connection is closed or not resumable.
+  folly::Future<std::unique_ptr<folly::IOBuf>> exportResumeState();
+
   friend class RSocketServer;
+  friend class ResumeSessionTable;
 
  private:
   RSocketServerState(
       folly::EventBase& eventBase,
       std::shared_ptr<RSocketStateMachine> stateMachine,
-      std::shared_ptr<RSocketRequester> rSocketRequester)
+      std::shared_ptr<RSocketRequester> rSocketRequester,
+      std::string metadataMimeType = "",
+      std::string dataMimeType = "")
       : eventBase_(eventBase),
         rSocketStateMachine_(stateMachine),
-        rSocketRequester_(rSocketRequester) {}
+        rSocketRequester_(rSocketRequester),
+        metadataMimeType_(std::move(metadataMimeType)),
+        dataMimeType_(std::move(dataMimeType)) {}
 
   folly::EventBase& eventBase_;
   std::shared_ptr<RSocketStateMachine> rSocketStateMachine_;
   std::shared_ptr<RSocketRequester> rSocketRequester_;
+  // Of the SETUP, for another host to set the connection up again.
+  const std::string metadataMimeType_;
+  const std::string dataMimeType_;
 };
 }
@@ -4,6 +4,22 @@
 
 namespace rsocket {
 
+folly::Expected<RSocketConnectionParams, RSocketException>
+RSocketServiceHandler::onNewSetup(const SetupParameters&) {
+  return folly::makeUnexpected(
+      RSocketException("The service handler doesn't accept connections"));
+}
+
+folly::Future<RSocketConnectionParams> RSocketServiceHandler::onNewSetupAsync(
+    const SetupParameters& setupParameters) {
+  auto result = onNewSetup(setupParameters);
+  if (result.hasError()) {
+    return folly::makeFuture<RSocketConnectionParams>(
+        std::move(result.error()));
+  }
+  return folly::makeFuture(std::move(result.value()));
+}
+
 void RSocketServiceHandler::onNewRSocketState(
     std::shared_ptr<RSocketServerState>,
     ResumeIdentificationToken) {}
@@ -3,13 +3,16 @@
 #pragma once
 
 #include <folly/Expected.h>
+#include <folly/futures/Future.h>
 
+#include "rsocket/LeaseSender.h"
 #include "rsocket/RSocketConnectionEvents.h"
 #include "rsocket/RSocketException.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketServerState.h"
 #include "rsocket/RSocketStats.h"
+#include "rsocket/ResponderExecutor.h"
 #include "rsocket/internal/Common.h"
 
 namespace rsocket {
@@ -25,13 +28,52 @@ struct RSocketConnectionParams {
   explicit RSocketConnectionParams(
       std::shared_ptr<RSocketResponder> _responder,
       std::shared_ptr<RSocketStats> _stats = RSocketStats::noop(),
-      std::shared_ptr<RSocketConnectionEvents> _connectionEvents = nullptr)
+      std::shared_ptr<RSocketConnectionEvents> _connectionEvents = nullptr,
+      std::shared_ptr<LeaseSender> _leaseSender = nullptr,
+      size_t _mtu = 0)
       : responder(std::move(_responder)),
         stats(std::move(_stats)),
-        connectionEvents(std::move(_connectionEvents)) {}
+        connectionEvents(std::move(_connectionEvents)),
+        leaseSender(std::move(_leaseSender)),
+        mtu(_mtu) {}
   std::shared_ptr<RSocketResponder> responder;
   std::shared_ptr<RSocketStats> stats;
   std::shared_ptr<RSocketConnectionEvents> connectionEvents;
+  // Issues the leases of connections whose client asked for leases.  Such
+  // connections are rejected when no LeaseSender is provided.
+  std::shared_ptr<LeaseSender> leaseSender;
+  // The largest payload sent to the client in a single frame, see
+  // SetupParameters::mtu.
+  size_t mtu;
+  // How REQUEST_N frames are sent to the client, see
+  // SetupParameters::requestNBatching.
+  RequestNBatching requestNBatching;
+  // How far ahead the streams requested from the client request, see
+  // AdaptiveRequestN.
+  AdaptiveRequestN adaptiveRequestN;
+  // How many frames are buffered for the client while they can't be sent, see
+  // SetupParameters::pendingFrameLimits.
+  PendingFrameLimits pendingFrameLimits;
+  // How many payloads the stream responders serialize ahead of the REQUEST_N
+  // of the client, see SetupParameters::streamSerializeAhead.
+  size_t streamSerializeAhead{0};
+  // How often the server acknowledges the position it received up to, see
+  // SetupParameters::positionAckBytes.
+  size_t positionAckBytes{0};
+  // How many bytes the connection to the client holds in memory, see
+  // ConnectionMemoryLimits.
+  ConnectionMemoryLimits memoryLimits;
+  // How long the connection to the client is idle before it frees its spare
+  // buffers, see SetupParameters::hibernateAfter.
+  std::chrono::milliseconds hibernateAfter{0};
+  // Runs the responder on the threads of this executor, rather than on the
+  // EventBase of the connection, with a queue of its own.  Returning the same
+  // executor for all the connections of a service handler shares its threads
+  // fairly between them, see ResponderExecutor.
+  std::shared_ptr<ResponderExecutor> responderExecutor;
+  // How the payloads sent to a client asking for compressed payloads are
+  // compressed, see PayloadCompression.
+  PayloadCompression compression;
 };
 
 
@@ -63,8 +105,23 @@ class RSocketServiceHandler {
   // the application returns a RSocketException, then an ERROR frame with code
   // REJECTED_SETUP is sent to the client.  The exception message is sent as
   // payload.
+  //
+  // Handlers which accept connections asynchronously override
+  // onNewSetupAsync() instead.
   virtual folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
-      const SetupParameters&) = 0;
+      const SetupParameters&);
+
+  // Same as onNewSetup(), for handlers which have to wait for something
+  // before accepting a connection, e.g. an authentication service, without
+  // blocking the thread of the connection.  The frames the client sends
+  // meanwhile are held until the future is fulfilled, and a future failed
+  // with an exception rejects the connection.  Copy out of the
+  // SetupParameters what is needed later, the reference is only valid during
+  // the call.  The future must be fulfilled before the server is destroyed.
+  //
+  // Calls onNewSetup() by default.
+  virtual folly::Future<RSocketConnectionParams> onNewSetupAsync(
+      const SetupParameters&);
 
   // This method gets called after some state is created for each client.  The
   // application should preserve the RSocketServerState if it wants to resume
@@ -26,6 +26,7 @@ class NoopStats : public RSocketStats {
   void bytesRead(size_t) override {}
   void frameWritten(FrameType) override {}
   void frameRead(FrameType) override {}
+  void framesRead(FrameType, size_t) override {}
   virtual void serverResume(
       folly::Optional<int64_t>,
       int64_t,
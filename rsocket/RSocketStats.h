@@ -3,21 +3,48 @@
 #pragma once
 
 #include <folly/Optional.h>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
 
 #include "rsocket/framing/FrameType.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/metadata/TraceContext.h"
 
 namespace rsocket {
 
 class DuplexConnection;
 
+/// The timings of a traced stream, see RSocketStats::streamSpan().
+struct StreamSpan {
+  TraceContext context;
+  StreamId streamId{0};
+  StreamType streamType{StreamType::REQUEST_RESPONSE};
+  /// Whether this side sent the request.
+  bool requester{false};
+  /// When the requester wrote the request frame, or the responder read it.
+  std::chrono::steady_clock::time_point start;
+  /// From the start to the first payload the requester read, or the responder
+  /// wrote.  Unset if there was none.
+  folly::Optional<std::chrono::microseconds> firstPayload;
+  /// From the start to the end of the stream.
+  std::chrono::microseconds duration{0};
+  StreamCompletionSignal signal{StreamCompletionSignal::COMPLETE};
+};
+
 class RSocketStats {
  public:
   enum class ResumeOutcome { SUCCESS, FAILURE };
 
+  /// Which side of a stream ran out of allowance, see streamStalled().
+  enum class StallDirection {
+    /// This side can't send: the peer hasn't requested more payloads.
+    SEND,
+    /// The peer can't send: the subscriber on this side hasn't requested more.
+    RECEIVE,
+  };
+
   virtual ~RSocketStats() = default;
 
   static std::shared_ptr<RSocketStats> noop();
@@ -44,14 +71,134 @@ class RSocketStats {
   virtual void bytesRead(size_t /* bytes */) {}
   virtual void frameWritten(FrameType /* frameType */) {}
   virtual void frameRead(FrameType /* frameType */) {}
+  /// Counts frames of the same type read in a row, e.g. from one read of the
+  /// transport.
+  virtual void framesRead(FrameType frameType, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      frameRead(frameType);
+    }
+  }
+
+  /// Whether to report the size of every frame to frameReadBytes() and
+  /// frameWrittenBytes(), instead of frameRead(), framesRead() and
+  /// frameWritten().  Read once when the connection is created.
+  virtual bool frameSizesEnabled() const {
+    return false;
+  }
+  /// A frame of `bytes`, without its length field, was read.
+  virtual void frameReadBytes(FrameType frameType, size_t /* bytes */) {
+    frameRead(frameType);
+  }
+  /// A frame of `bytes`, without its length field, was written.
+  virtual void frameWrittenBytes(FrameType frameType, size_t /* bytes */) {
+    frameWritten(frameType);
+  }
   virtual void resumeBufferChanged(
       int /* framesCountDelta */,
       int /* dataSizeDelta */) {}
   virtual void streamBufferChanged(
       int64_t /* framesCountDelta */,
       int64_t /* dataSizeDelta */) {}
+  /// The bytes a connection holds in memory went above the high-water mark of
+  /// its ConnectionMemoryLimits (`backpressure`), or back to the low-water
+  /// mark.
+  virtual void connectionMemoryBackpressure(
+      bool /* backpressure */,
+      size_t /* bytes */) {}
+  /// A connection held more bytes than allowed by its ConnectionMemoryLimits,
+  /// and is being closed.
+  virtual void connectionMemoryExceeded(size_t /* bytes */) {}
+  /// The peer of a connection didn't read what it was sent fast enough, see
+  /// TcpWriteBufferLimits, and the connection is being closed with `bytes`
+  /// still buffered.  `stalled` is set if nothing was written for the stall
+  /// timeout, unset if the buffered bytes went above the maximum.
+  virtual void connectionWriteStalled(
+      size_t /* bytes */,
+      folly::Optional<std::chrono::milliseconds> /* stalled */) {}
+  /// A worker EventBase of a server started (`overloaded`) or stopped
+  /// shedding load, with the load its last probe measured, see
+  /// LoadSheddingOptions.
+  virtual void eventBaseOverloaded(
+      bool /* overloaded */,
+      std::chrono::microseconds /* loopLatency */,
+      size_t /* queuedTasks */) {}
   virtual void resumeFailedNoState() {}
+  /// A fire-and-forget was dropped rather than sent, see
+  /// PendingFrameLimits::maxBytesForFireAndForget.
+  virtual void fireAndForgetDropped() {}
+
+  /// Whether the connections count the CPU cycles they spend on their
+  /// EventBase, reading frames, running the responder on them and writing
+  /// frames.  It costs two reads of the timestamp counter per read batch and
+  /// per write.  Read once when the connection is created.
+  virtual bool cpuAccountingEnabled() const {
+    return false;
+  }
+  /// The cycles a connection spent on its EventBase, reported when it closes
+  /// with cpuAccountingEnabled(), see ConnectionSnapshot::cpuCycles for the
+  /// connections still open.
+  virtual void connectionCpuCycles(uint64_t /* cycles */) {}
+
   virtual void keepaliveSent() {}
   virtual void keepaliveReceived() {}
+  /// The round trip time of a keepalive the peer answered, measured apart
+  /// from the latency of the streams: the keepalives skip the data frames
+  /// waiting to be written, see RSocketStateMachine::outputFrameOrEnqueue().
+  /// The answers don't tell which keepalive they answer, each is taken to
+  /// answer the oldest one not answered yet.  Only for clients.
+  virtual void keepaliveRoundTrip(std::chrono::microseconds /* rtt */) {}
+
+  /// Whether to measure the latencies of the streams the connection responds
+  /// to, and report them to the stream*() methods below.  Read once when the
+  /// connection is created.
+  virtual bool streamLatenciesEnabled() const {
+    return false;
+  }
+  /// From reading the request frame to invoking the RSocketResponder.
+  virtual void streamHandlerInvoked(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* latency */) {}
+  /// From reading the request frame to writing the first payload of the
+  /// response, on the EventBase of the connection.  With a responder running
+  /// on another EventBase, e.g. a ScheduledRSocketResponder, it includes the
+  /// time spent in its queue.
+  virtual void streamFirstPayload(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* latency */) {}
+  /// Between writing two payloads of the response.
+  virtual void streamPayloadGap(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* gap */) {}
+  /// From using up the allowance of the requester to it sending REQUEST_N.
+  virtual void streamBlockedOnRequestN(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* blocked */) {}
+
+  /// How long a stream or channel may go without allowance in one direction
+  /// before it is reported to streamStalled(), 0 to not track the allowances.
+  /// Read once when the connection is created.
+  virtual std::chrono::milliseconds streamStallThreshold() const {
+    return std::chrono::milliseconds(0);
+  }
+  /// A stream or channel had no allowance in `direction` for at least
+  /// streamStallThreshold(), e.g. because of a slow consumer.  Reported once
+  /// the stall ends, when more payloads are requested or the stream ends, on
+  /// the EventBase of the connection.
+  virtual void streamStalled(
+      StreamId /* streamId */,
+      StreamType /* streamType */,
+      StallDirection /* direction */,
+      std::chrono::microseconds /* stalled */) {}
+
+  /// Fraction of the requests sent without a RequestOptions::traceParent
+  /// which start a sampled trace, from 0 to 1.  One request in 1 / rate is
+  /// taken, the others only pay for a branch.  With a rate above 0, the
+  /// requests received with a sampled trace context in their metadata are
+  /// traced as well.  Read once when the connection is created.
+  virtual double traceSampleRate() const {
+    return 0;
+  }
+  /// A stream of a sampled trace ended, on the EventBase of the connection.
+  virtual void streamSpan(const StreamSpan& /* span */) {}
 };
 } // namespace rsocket
@@ -0,0 +1,35 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/RequestGroup.h"
+
+#include <atomic>
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/statemachine/RSocketStateMachine.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Ids are unique in the process, so that a group can't cancel the requests
+/// of another group on the same connection.
+std::atomic<uint64_t> nextGroupId{1};
+
+} // namespace
+
+RequestGroup::RequestGroup(
+    std::shared_ptr<RSocketStateMachine> stateMachine,
+    folly::EventBase& eventBase)
+    : id_(nextGroupId.fetch_add(1, std::memory_order_relaxed)),
+      stateMachine_(std::move(stateMachine)),
+      eventBase_(eventBase) {}
+
+void RequestGroup::cancel() {
+  eventBase_.runInEventBaseThread(
+      [ stateMachine = stateMachine_, id = id_ ] {
+        stateMachine->cancelStreamGroup(id);
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,55 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+class RSocketStateMachine;
+
+/**
+ * A set of requests of an RSocketRequester, to cancel all of them at once,
+ * e.g. the requests of a user session when it ends.  Made with
+ * RSocketRequester::createRequestGroup(), requests join it with
+ * RequestOptions::group.
+ *
+ * Cancelling the requests one by one through their subscriptions takes a hop
+ * to the EventBase of the connection and a write of a CANCEL frame each.  A
+ * group is cancelled in one hop, with all of the CANCEL frames in one write.
+ */
+class RequestGroup {
+ public:
+  RequestGroup(
+      std::shared_ptr<RSocketStateMachine> stateMachine,
+      folly::EventBase& eventBase);
+
+  RequestGroup(const RequestGroup&) = delete;
+  RequestGroup& operator=(const RequestGroup&) = delete;
+
+  /**
+   * Cancels the requests of the group which haven't terminated yet, as their
+   * subscribers would: the subscribers aren't signaled, except the futures
+   * of requestResponseFuture() which fail with RequestCancelledError.
+   *
+   * Requests which join the group afterwards aren't cancelled, the group can
+   * be cancelled again.
+   */
+  void cancel();
+
+  uint64_t id() const {
+    return id_;
+  }
+
+ private:
+  const uint64_t id_;
+  const std::shared_ptr<RSocketStateMachine> stateMachine_;
+  folly::EventBase& eventBase_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,74 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <folly/Optional.h>
+
+#include "rsocket/metadata/TraceContext.h"
+
+namespace rsocket {
+
+class RequestGroup;
+
+/// Orders the frames of a stream against those of the other streams of the
+/// connection while they are waiting to be written, e.g. while the connection
+/// is resuming.  Connection frames (keepalives, leases, errors) always go
+/// first, then the INTERACTIVE streams and then the BULK ones.  Within a class
+/// the streams take turns, each of them sending up to `weight` frames per
+/// turn.  The frames of one stream are always sent in order.
+struct StreamPriority {
+  enum class Class : uint8_t {
+    /// Latency sensitive requests.  This is the default of request-response.
+    INTERACTIVE,
+    /// Everything else.  This is the default of streams and channels.
+    BULK,
+  };
+
+  explicit StreamPriority(
+      Class _priorityClass = Class::BULK,
+      uint8_t _weight = 1)
+      : priorityClass(_priorityClass), weight(_weight) {}
+
+  Class priorityClass;
+  uint8_t weight;
+};
+
+/// Per request options of the RSocketRequester.
+struct RequestOptions {
+  /// Falls back to the default of the interaction model when not set.
+  folly::Optional<StreamPriority> priority;
+
+  /// Fails the request with RequestTimeoutError, and cancels it, if it hasn't
+  /// terminated this long after it was sent.  Fire-and-forget requests have no
+  /// timeout.
+  folly::Optional<std::chrono::milliseconds> timeout;
+
+  /// Adds the timeout to the metadata of the request, so that the responder
+  /// can cancel the work the requester no longer waits for.  Only for
+  /// connections whose metadata mime type is composite metadata, see
+  /// kRequestTimeoutMimeType.
+  bool propagateTimeout{false};
+
+  /// The request gets a span of this trace, as a child of `traceParent`.  It
+  /// is recorded if the trace is sampled, see RSocketStats::streamSpan().
+  /// Without a parent, requests start new traces at the sample rate of the
+  /// stats of the connection.
+  folly::Optional<TraceContext> traceParent;
+
+  /// Adds the trace context of the request to its metadata, so that the
+  /// responder records its span in the same trace.  Only for connections
+  /// whose metadata mime type is composite metadata, see
+  /// kTraceContextMimeType.
+  bool propagateTrace{false};
+
+  /// The request joins the group, to be cancelled with the other requests of
+  /// the group by RequestGroup::cancel().  The group must have been created
+  /// by the requester of the request.  Fire-and-forget requests don't join.
+  std::shared_ptr<RequestGroup> group;
+};
+
+} // namespace rsocket
@@ -0,0 +1,257 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/ResponderExecutor.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+
+#include <folly/ExceptionWrapper.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+constexpr size_t kNumClasses = 2;
+
+size_t classIndex(StreamPriority::Class priorityClass) {
+  return static_cast<size_t>(priorityClass);
+}
+}
+
+struct ResponderExecutor::Queue::State {
+  std::array<std::deque<Func>, kNumClasses> tasks;
+  /// Whether the queue takes turns in Core::ready for the class.
+  std::array<bool, kNumClasses> ready{{false, false}};
+  size_t size{0};
+  /// Of `size`, the tasks in Core::deadlines.
+  size_t deadlineTasks{0};
+};
+
+struct ResponderExecutor::Core {
+  struct DeadlineTask {
+    Clock::time_point deadline;
+    Func func;
+    Func expired;
+    std::shared_ptr<Queue::State> queue;
+
+    /// Puts the earliest deadline at the top of a heap.
+    bool operator<(const DeadlineTask& other) const {
+      return deadline > other.deadline;
+    }
+  };
+
+  explicit Core(Options _options) : options(_options) {}
+
+  bool full(const Queue::State& queue) const {
+    return stopping || size >= options.maxQueuedTasks ||
+        queue.size >= options.maxQueuedTasksPerQueue;
+  }
+
+  /// Takes the next task, a task must be queued.
+  Func next() {
+    for (size_t i = 0; i < kNumClasses; ++i) {
+      auto& heap = deadlines[i];
+      if (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        auto task = std::move(heap.back());
+        heap.pop_back();
+        --task.queue->size;
+        --task.queue->deadlineTasks;
+        --size;
+        if (task.deadline <= Clock::now()) {
+          return task.expired ? std::move(task.expired) : Func([] {});
+        }
+        return std::move(task.func);
+      }
+
+      auto& queues = ready[i];
+      while (!queues.empty()) {
+        auto queue = std::move(queues.front());
+        queues.pop_front();
+        queue->ready[i] = false;
+        auto& tasks = queue->tasks[i];
+        if (tasks.empty()) {
+          // The queue was destroyed with its tasks.
+          continue;
+        }
+        auto func = std::move(tasks.front());
+        tasks.pop_front();
+        --queue->size;
+        --size;
+        if (!tasks.empty()) {
+          queue->ready[i] = true;
+          queues.push_back(std::move(queue));
+        }
+        return func;
+      }
+    }
+    LOG(DFATAL) << "No task queued";
+    return [] {};
+  }
+
+  const Options options;
+
+  std::mutex mutex;
+  std::condition_variable tasksAvailable;
+  bool stopping{false};
+  /// Tasks in all the queues.
+  size_t size{0};
+  /// The queues with tasks of each class, in the order they take turns.
+  std::array<std::deque<std::shared_ptr<Queue::State>>, kNumClasses> ready;
+  /// The tasks with a deadline of each class, a heap earliest first.
+  std::array<std::vector<DeadlineTask>, kNumClasses> deadlines;
+};
+
+ResponderExecutor::ResponderExecutor(Options options)
+    : core_(std::make_shared<Core>(options)) {
+  auto const numThreads = std::max<size_t>(options.numThreads, 1);
+  threads_.reserve(numThreads);
+  for (size_t i = 0; i < numThreads; ++i) {
+    threads_.emplace_back([core = core_] {
+      std::unique_lock<std::mutex> lock(core->mutex);
+      while (true) {
+        core->tasksAvailable.wait(
+            lock, [&] { return core->stopping || core->size > 0; });
+        if (core->stopping) {
+          return;
+        }
+        auto func = core->next();
+        lock.unlock();
+        try {
+          func();
+        } catch (const std::exception& ex) {
+          LOG(ERROR) << "Responder task threw: " << folly::exceptionStr(ex);
+        }
+        func = nullptr;
+        lock.lock();
+      }
+    });
+  }
+}
+
+ResponderExecutor::~ResponderExecutor() {
+  std::array<std::deque<std::shared_ptr<Queue::State>>, kNumClasses> ready;
+  std::array<std::vector<Core::DeadlineTask>, kNumClasses> deadlines;
+  {
+    std::lock_guard<std::mutex> lock(core_->mutex);
+    core_->stopping = true;
+    ready.swap(core_->ready);
+    deadlines.swap(core_->deadlines);
+    for (auto& heap : deadlines) {
+      for (auto& task : heap) {
+        --task.queue->size;
+        --task.queue->deadlineTasks;
+        --core_->size;
+      }
+    }
+  }
+  core_->tasksAvailable.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+
+  // The tasks hold the streams they are for, drop them now rather than with
+  // their queues.
+  for (auto& queues : ready) {
+    for (auto& queue : queues) {
+      std::array<std::deque<Func>, kNumClasses> dropped;
+      std::lock_guard<std::mutex> lock(core_->mutex);
+      core_->size -= queue->size;
+      queue->size = 0;
+      dropped.swap(queue->tasks);
+    }
+  }
+}
+
+std::shared_ptr<ResponderExecutor::Queue> ResponderExecutor::createQueue() {
+  return std::shared_ptr<Queue>(
+      new Queue(core_, std::make_shared<Queue::State>()));
+}
+
+size_t ResponderExecutor::queuedTasks() const {
+  std::lock_guard<std::mutex> lock(core_->mutex);
+  return core_->size;
+}
+
+ResponderExecutor::Queue::Queue(
+    std::shared_ptr<Core> core,
+    std::shared_ptr<State> state)
+    : core_(std::move(core)), state_(std::move(state)) {}
+
+ResponderExecutor::Queue::~Queue() {
+  // The tasks are destroyed out of the lock, they may hold anything.
+  std::array<std::deque<Func>, kNumClasses> dropped;
+  std::vector<Core::DeadlineTask> droppedDeadlines;
+  std::lock_guard<std::mutex> lock(core_->mutex);
+  core_->size -= state_->size;
+  state_->size = 0;
+  dropped.swap(state_->tasks);
+  if (state_->deadlineTasks == 0) {
+    return;
+  }
+  state_->deadlineTasks = 0;
+  for (auto& heap : core_->deadlines) {
+    auto const kept = std::partition(
+        heap.begin(), heap.end(), [this](const Core::DeadlineTask& task) {
+          return task.queue != state_;
+        });
+    std::move(kept, heap.end(), std::back_inserter(droppedDeadlines));
+    heap.erase(kept, heap.end());
+    std::make_heap(heap.begin(), heap.end());
+  }
+}
+
+bool ResponderExecutor::Queue::add(
+    Func func,
+    StreamPriority::Class priorityClass) {
+  {
+    std::lock_guard<std::mutex> lock(core_->mutex);
+    if (core_->full(*state_)) {
+      return false;
+    }
+    auto const i = classIndex(priorityClass);
+    state_->tasks[i].push_back(std::move(func));
+    ++state_->size;
+    ++core_->size;
+    if (!state_->ready[i]) {
+      state_->ready[i] = true;
+      core_->ready[i].push_back(state_);
+    }
+  }
+  core_->tasksAvailable.notify_one();
+  return true;
+}
+
+bool ResponderExecutor::Queue::add(
+    Func func,
+    StreamPriority::Class priorityClass,
+    folly::Optional<Clock::time_point> deadline,
+    Func expired) {
+  if (!deadline || !core_->options.earliestDeadlineFirst) {
+    return add(std::move(func), priorityClass);
+  }
+  {
+    std::lock_guard<std::mutex> lock(core_->mutex);
+    if (core_->full(*state_)) {
+      return false;
+    }
+    auto& heap = core_->deadlines[classIndex(priorityClass)];
+    heap.push_back(Core::DeadlineTask{
+        *deadline, std::move(func), std::move(expired), state_});
+    std::push_heap(heap.begin(), heap.end());
+    ++state_->size;
+    ++state_->deadlineTasks;
+    ++core_->size;
+  }
+  core_->tasksAvailable.notify_one();
+  return true;
+}
+
+bool ResponderExecutor::Queue::full() const {
+  std::lock_guard<std::mutex> lock(core_->mutex);
+  return core_->full(*state_);
+}
+}
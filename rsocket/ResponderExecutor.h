@@ -0,0 +1,114 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+
+#include "rsocket/RequestOptions.h"
+
+namespace rsocket {
+
+/**
+ * A pool of threads running the handlers of the requests received by a
+ * server, shared by its connections, see
+ * RSocketConnectionParams::responderExecutor.
+ *
+ * Each connection queues its tasks on a Queue of its own.  The threads take
+ * the tasks of the INTERACTIVE class first, then those of the BULK class, and
+ * within a class they go round-robin across the queues which have tasks, one
+ * task at a time.  A client flooding its connection with requests only makes
+ * its own queue longer, and the other connections keep their turns.
+ *
+ * The tasks are bounded, per queue and in total, so that an overloaded server
+ * rejects the requests rather than queue them for ever.
+ *
+ * With Options::earliestDeadlineFirst, the tasks of requests with a deadline
+ * run before the others of their class, the earliest deadline first across
+ * all the queues, and those whose deadline passed while they were queued are
+ * answered with a cheap error instead of being handled.
+ *
+ * Thread safe.
+ */
+class ResponderExecutor {
+ public:
+  struct Options {
+    size_t numThreads{std::max(1u, std::thread::hardware_concurrency())};
+    /// Tasks waiting in all the queues.
+    size_t maxQueuedTasks{16 * 1024};
+    /// Tasks waiting in one queue.
+    size_t maxQueuedTasksPerQueue{1024};
+    /// Run the tasks with a deadline earliest first, see Queue::add().
+    bool earliestDeadlineFirst{false};
+  };
+
+  using Func = folly::Function<void()>;
+  using Clock = std::chrono::steady_clock;
+
+  class Queue;
+
+  explicit ResponderExecutor(Options options);
+
+  /// Joins the threads.  The queued tasks which haven't run are dropped.
+  ~ResponderExecutor();
+
+  ResponderExecutor(const ResponderExecutor&) = delete;
+  ResponderExecutor& operator=(const ResponderExecutor&) = delete;
+
+  /// Creates the queue of a connection.  The tasks of a queue which haven't
+  /// run when it is destroyed are dropped.  The queue can outlive the
+  /// executor, it refuses new tasks then.
+  std::shared_ptr<Queue> createQueue();
+
+  /// Number of tasks waiting to run.
+  size_t queuedTasks() const;
+
+ private:
+  struct Core;
+
+  const std::shared_ptr<Core> core_;
+  std::vector<std::thread> threads_;
+};
+
+/// The tasks of one connection, see ResponderExecutor.
+class ResponderExecutor::Queue {
+ public:
+  ~Queue();
+
+  /// Queues `func` to run on a thread of the executor.  Returns false, and
+  /// drops it, if the queue or the executor is full, or the executor is
+  /// destroyed.
+  bool add(Func func, StreamPriority::Class priorityClass);
+
+  /// Like add(Func, StreamPriority::Class), for the task of a request which
+  /// is only worth handling until `deadline`.  With
+  /// Options::earliestDeadlineFirst, the task runs before the tasks without a
+  /// deadline of its class, and `expired` runs instead of `func` if the
+  /// deadline has passed by the time a thread takes it.  Otherwise, or
+  /// without a deadline, `expired` is dropped.
+  bool add(
+      Func func,
+      StreamPriority::Class priorityClass,
+      folly::Optional<Clock::time_point> deadline,
+      Func expired);
+
+  /// Whether a task added now would be refused.
+  bool full() const;
+
+ private:
+  friend class ResponderExecutor;
+
+  struct State;
+
+  Queue(std::shared_ptr<Core> core, std::shared_ptr<State> state);
+
+  const std::shared_ptr<Core> core_;
+  const std::shared_ptr<State> state_;
+};
+}
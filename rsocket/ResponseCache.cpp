@@ -0,0 +1,391 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/ResponseCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/hash/Hash.h>
+#include <folly/hash/SpookyHashV2.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+namespace rsocket {
+
+namespace {
+
+struct Key {
+  std::string route;
+  uint64_t hash1{0};
+  uint64_t hash2{0};
+
+  bool operator==(const Key& other) const {
+    return hash1 == other.hash1 && hash2 == other.hash2 &&
+        route == other.route;
+  }
+};
+
+struct KeyHash {
+  size_t operator()(const Key& key) const {
+    return folly::hash::hash_combine(key.hash1, key.route);
+  }
+};
+
+std::string routeOf(const Payload& request, bool compositeMetadata) {
+  if (!request.metadata) {
+    return std::string();
+  }
+  if (compositeMetadata) {
+    try {
+      CompositeMetadataReader reader(*request.metadata);
+      if (auto routing = reader.find(kRoutingMimeType)) {
+        return routing->cursor().readFixedString(routing->length());
+      }
+      return std::string();
+    } catch (const std::exception&) {
+      // Malformed, the whole metadata tells the request apart then.
+    }
+  }
+  return request.cloneMetadataToString();
+}
+
+Key keyOf(const Payload& request, bool compositeMetadata) {
+  Key key;
+  key.route = routeOf(request, compositeMetadata);
+  folly::hash::SpookyHashV2 hasher;
+  hasher.Init(0, 0);
+  if (request.data) {
+    for (auto range : *request.data) {
+      hasher.Update(range.data(), range.size());
+    }
+  }
+  hasher.Final(&key.hash1, &key.hash2);
+  return key;
+}
+
+size_t bytesOf(const Payload& payload) {
+  return (payload.data ? payload.data->computeChainDataLength() : 0) +
+      (payload.metadata ? payload.metadata->computeChainDataLength() : 0);
+}
+
+} // namespace
+
+class ResponseCache::Core : public std::enable_shared_from_this<Core> {
+ public:
+  explicit Core(Options options) : options_(options) {}
+
+  /// The subscription of an observer of the cache.  It waits for the request
+  /// in flight for its key, unless the cache answers it right away.
+  class Waiter : public yarpl::single::SingleSubscription {
+   public:
+    Waiter(
+        std::shared_ptr<Core> core,
+        Key key,
+        yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer)
+        : core_(std::move(core)),
+          key_(std::move(key)),
+          observer_(std::move(observer)) {}
+
+    void cancel() override {
+      cancelled_ = true;
+      core_->leave(key_, this);
+    }
+
+    /// Only called by the one who took the waiter out of its flight.
+    void onSuccess(Payload response) {
+      auto observer = std::move(observer_);
+      observer->onSuccess(std::move(response));
+    }
+
+    void onError(folly::exception_wrapper ex) {
+      auto observer = std::move(observer_);
+      observer->onError(std::move(ex));
+    }
+
+    void dropObserver() {
+      observer_ = nullptr;
+    }
+
+    bool cancelled() const {
+      return cancelled_;
+    }
+
+   private:
+    const std::shared_ptr<Core> core_;
+    const Key key_;
+    yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer_;
+    std::atomic<bool> cancelled_{false};
+  };
+
+  /// A request in flight, and the waiters for its response.
+  struct Flight {
+    std::vector<yarpl::Reference<Waiter>> waiters;
+    yarpl::Reference<yarpl::single::SingleSubscription> subscription;
+  };
+
+  class FlightObserver : public yarpl::single::SingleObserver<Payload> {
+   public:
+    FlightObserver(
+        std::shared_ptr<Core> core,
+        Key key,
+        std::shared_ptr<Flight> flight)
+        : core_(std::move(core)),
+          key_(std::move(key)),
+          flight_(std::move(flight)) {}
+
+    void onSubscribe(yarpl::Reference<yarpl::single::SingleSubscription>
+                         subscription) override {
+      core_->flightSubscribed(flight_, std::move(subscription));
+    }
+
+    void onSuccess(Payload response) override {
+      core_->flightSucceeded(key_, flight_, std::move(response));
+    }
+
+    void onError(folly::exception_wrapper ex) override {
+      core_->flightFailed(key_, flight_, std::move(ex));
+    }
+
+   private:
+    const std::shared_ptr<Core> core_;
+    const Key key_;
+    const std::shared_ptr<Flight> flight_;
+  };
+
+  void request(
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request,
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) {
+    auto key = keyOf(request, options_.compositeMetadata);
+    auto waiter = yarpl::make_ref<Waiter>(shared_from_this(), key, observer);
+    // Subscribed first, the waiter may be answered as soon as it joins a
+    // flight.
+    observer->onSubscribe(waiter);
+
+    std::shared_ptr<Flight> flight;
+    Payload response;
+    bool hit = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (waiter->cancelled()) {
+        waiter->dropObserver();
+        return;
+      }
+
+      auto entry = entries_.find(key);
+      if (entry != entries_.end()) {
+        if (entry->second->expires > std::chrono::steady_clock::now()) {
+          lru_.splice(lru_.begin(), lru_, entry->second);
+          response = entry->second->response.clone();
+          hit = true;
+          ++stats_.hits;
+        } else {
+          erase(entry);
+        }
+      }
+
+      if (!hit) {
+        auto& inFlight = flights_[key];
+        if (inFlight) {
+          inFlight->waiters.push_back(std::move(waiter));
+          ++stats_.coalesced;
+          return;
+        }
+        inFlight = flight = std::make_shared<Flight>();
+        flight->waiters.push_back(waiter);
+        ++stats_.misses;
+      }
+    }
+
+    if (hit) {
+      waiter->onSuccess(std::move(response));
+      return;
+    }
+    requester->requestResponse(std::move(request))
+        ->subscribe(yarpl::make_ref<FlightObserver>(
+            shared_from_this(), std::move(key), std::move(flight)));
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    stats_.bytes = 0;
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.entries = entries_.size();
+    return stats;
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    Payload response;
+    std::chrono::steady_clock::time_point expires;
+    size_t bytes;
+  };
+
+  using Entries = std::list<Entry>;
+
+  void leave(const Key& key, Waiter* waiter) {
+    yarpl::Reference<yarpl::single::SingleSubscription> subscription;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = flights_.find(key);
+      if (it == flights_.end()) {
+        return;
+      }
+      auto flight = it->second;
+      auto& waiters = flight->waiters;
+      auto found = std::find_if(
+          waiters.begin(), waiters.end(), [waiter](const auto& other) {
+            return other.get() == waiter;
+          });
+      if (found == waiters.end()) {
+        return;
+      }
+      (*found)->dropObserver();
+      waiters.erase(found);
+      if (!waiters.empty()) {
+        return;
+      }
+      // The last waiter is gone, so is the request.
+      flights_.erase(it);
+      subscription = std::move(flight->subscription);
+    }
+    if (subscription) {
+      subscription->cancel();
+    }
+  }
+
+  void flightSubscribed(
+      const std::shared_ptr<Flight>& flight,
+      yarpl::Reference<yarpl::single::SingleSubscription> subscription) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!flight->waiters.empty()) {
+        flight->subscription = std::move(subscription);
+        return;
+      }
+    }
+    // All the waiters left before the request got its subscription.
+    subscription->cancel();
+  }
+
+  void flightSucceeded(
+      const Key& key,
+      const std::shared_ptr<Flight>& flight,
+      Payload response) {
+    std::vector<yarpl::Reference<Waiter>> waiters;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      waiters = takeWaiters(key, flight);
+      insert(key, response);
+    }
+    for (auto& waiter : waiters) {
+      waiter->onSuccess(
+          &waiter == &waiters.back() ? std::move(response) : response.clone());
+    }
+  }
+
+  void flightFailed(
+      const Key& key,
+      const std::shared_ptr<Flight>& flight,
+      folly::exception_wrapper ex) {
+    std::vector<yarpl::Reference<Waiter>> waiters;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      waiters = takeWaiters(key, flight);
+    }
+    for (auto& waiter : waiters) {
+      waiter->onError(ex);
+    }
+  }
+
+  /// Ends the flight, under the lock.
+  std::vector<yarpl::Reference<Waiter>> takeWaiters(
+      const Key& key,
+      const std::shared_ptr<Flight>& flight) {
+    auto it = flights_.find(key);
+    if (it != flights_.end() && it->second == flight) {
+      flights_.erase(it);
+    }
+    flight->subscription = nullptr;
+    return std::move(flight->waiters);
+  }
+
+  /// Caches a response, under the lock.
+  void insert(const Key& key, const Payload& response) {
+    auto const bytes = bytesOf(response) + key.route.size();
+    if (bytes > options_.maxBytes || options_.maxEntries == 0) {
+      return;
+    }
+    auto existing = entries_.find(key);
+    if (existing != entries_.end()) {
+      erase(existing);
+    }
+    while (!lru_.empty() &&
+           (entries_.size() >= options_.maxEntries ||
+            stats_.bytes + bytes > options_.maxBytes)) {
+      erase(entries_.find(lru_.back().key));
+    }
+    lru_.push_front(Entry{key,
+                          response.clone(),
+                          std::chrono::steady_clock::now() + options_.ttl,
+                          bytes});
+    entries_.emplace(key, lru_.begin());
+    stats_.bytes += bytes;
+  }
+
+  /// Under the lock.
+  void erase(
+      std::unordered_map<Key, Entries::iterator, KeyHash>::iterator entry) {
+    stats_.bytes -= entry->second->bytes;
+    lru_.erase(entry->second);
+    entries_.erase(entry);
+  }
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  /// Most recently used first.
+  Entries lru_;
+  std::unordered_map<Key, Entries::iterator, KeyHash> entries_;
+  std::unordered_map<Key, std::shared_ptr<Flight>, KeyHash> flights_;
+  Stats stats_;
+};
+
+ResponseCache::ResponseCache(Options options)
+    : core_(std::make_shared<Core>(options)) {}
+
+ResponseCache::~ResponseCache() = default;
+
+yarpl::Reference<yarpl::single::Single<Payload>> ResponseCache::requestResponse(
+    std::shared_ptr<RSocketRequester> requester,
+    Payload request) {
+  return yarpl::single::Single<Payload>::create([
+    core = core_,
+    requester = std::move(requester),
+    request = std::move(request)
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    core->request(requester, std::move(request), std::move(observer));
+  });
+}
+
+void ResponseCache::clear() {
+  core_->clear();
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+  return core_->stats();
+}
+
+} // namespace rsocket
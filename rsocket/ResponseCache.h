@@ -0,0 +1,85 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "rsocket/Payload.h"
+#include "rsocket/RSocketRequester.h"
+#include "yarpl/Single.h"
+
+namespace rsocket {
+
+/**
+ * A cache of the responses to idempotent request-responses, in front of
+ * RSocketRequester::requestResponse.
+ *
+ * Requests are told apart by their route and a 128-bit hash of their data.
+ * The route is the whole metadata of the request, or only its routing entry
+ * if the metadata is composite.  A request gets the cached response to an
+ * identical one sent less than the TTL ago, or joins an identical request in
+ * flight, so that concurrent requests for a key send a single request.  Only
+ * successful responses are cached, the least recently used are evicted first.
+ *
+ * Responses are shared with IOBuf::clone(), hits don't copy their bytes.  The
+ * Singles handed out can outlive the cache.
+ *
+ * Thread safe.
+ */
+class ResponseCache {
+ public:
+  struct Options {
+    /// How long a response is served from the cache.
+    std::chrono::milliseconds ttl{std::chrono::seconds(1)};
+    /// Responses cached at most.
+    size_t maxEntries{1024};
+    /// Bytes of the cached responses and routes at most.  Bigger responses
+    /// aren't cached.
+    size_t maxBytes{16 * 1024 * 1024};
+    /// Whether the metadata of the requests is composite.  The requests are
+    /// then routed by their routing entry, and their other entries, e.g.
+    /// trace contexts, don't tell them apart.
+    bool compositeMetadata{false};
+  };
+
+  struct Stats {
+    /// Requests answered from the cache.
+    size_t hits{0};
+    /// Requests which joined an identical request in flight.
+    size_t coalesced{0};
+    /// Requests sent.
+    size_t misses{0};
+    /// Responses cached now.
+    size_t entries{0};
+    /// Bytes of the responses cached now.
+    size_t bytes{0};
+  };
+
+  explicit ResponseCache(Options options);
+  ~ResponseCache();
+
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+
+  /// See RSocketRequester::requestResponse.  The request is sent, through
+  /// `requester`, when the Single is subscribed to and neither the cache nor
+  /// a request in flight answers it.  An observer which cancels leaves the
+  /// request in flight, which is cancelled with the last of its observers.
+  yarpl::Reference<yarpl::single::Single<Payload>> requestResponse(
+      std::shared_ptr<RSocketRequester> requester,
+      Payload request);
+
+  /// Drops the cached responses.  Requests in flight are still cached once
+  /// answered.
+  void clear();
+
+  Stats stats() const;
+
+ private:
+  class Core;
+
+  const std::shared_ptr<Core> core_;
+};
+
+} // namespace rsocket
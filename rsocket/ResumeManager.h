@@ -3,6 +3,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 
 #include <folly/Optional.h>
 
@@ -43,6 +44,14 @@ struct StreamResumeInfo {
 
 using StreamResumeInfos = std::unordered_map<StreamId, StreamResumeInfo>;
 
+// The arguments of one ResumeManager::trackReceivedFrame() call.
+struct ReceivedFrameInfo {
+  size_t frameLength;
+  FrameType frameType;
+  StreamId streamId;
+  size_t consumerAllowance;
+};
+
 // Applications desiring to have cold-resumption should implement a
 // ResumeManager interface.  By default, an in-memory implementation of this
 // interface (WarmResumeManager) will be used by RSocket.
@@ -66,8 +75,23 @@ class ResumeManager {
       StreamId streamId,
       size_t consumerAllowance) = 0;
 
+  // Tracks the frames received in one read of the transport, in order.
+  virtual void trackReceivedFrames(
+      const std::vector<ReceivedFrameInfo>& infos) {
+    for (const auto& info : infos) {
+      trackReceivedFrame(
+          info.frameLength,
+          info.frameType,
+          info.streamId,
+          info.consumerAllowance);
+    }
+  }
+
+  // frameLength is the data length of the whole serializedFrame chain.  The
+  // frame must be copied if it is going to be kept.
   virtual void trackSentFrame(
       const folly::IOBuf& serializedFrame,
+      size_t frameLength,
       FrameType frameType,
       StreamId streamId,
       size_t consumerAllowance) = 0;
@@ -93,6 +117,19 @@ class ResumeManager {
       ResumePosition position,
       FrameTransport& transport) const = 0;
 
+  // Like sendFramesFromPosition(), but stops once at least "maxBytes" were
+  // sent and returns the position following the last frame sent.  Resumption
+  // replays the buffered frames a few at a time this way, instead of taking
+  // the EventBase over until all of them are written.  The default sends all
+  // the frames at once.
+  virtual ResumePosition replayFramesFromPosition(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t /*maxBytes*/) const {
+    sendFramesFromPosition(position, transport);
+    return lastSentPosition();
+  }
+
   // This should return the first (oldest) available position in the send
   // buffer.
   virtual ResumePosition firstSentPosition() const = 0;
@@ -121,6 +158,22 @@ class ResumeManager {
   // Returns the largest used StreamId so far.
   virtual StreamId getLargestUsedStreamId() = 0;
 
+  // Bytes of the frames buffered in memory, which count against the
+  // ConnectionMemoryLimits of the connection.  Implementations keeping the
+  // frames elsewhere return 0.
+  virtual size_t bufferedBytes() const {
+    return 0;
+  }
+
+  // Frees the spare memory of the buffered frames, e.g. compacts them, while
+  // the connection is idle.  Frames keep being tracked the same afterwards.
+  virtual void releaseBuffers() {}
+
+  // Buffers at most `fraction` of the capacity of the implementation in
+  // memory, evicting the oldest frames above it, until it is called again,
+  // see MemoryGovernor.  Implementations without such a buffer ignore it.
+  virtual void limitBuffer(double /* fraction */) {}
+
   // Utility method to check frames which should be tracked for resumption.
   inline bool shouldTrackFrame(const FrameType frameType) {
     switch (frameType) {
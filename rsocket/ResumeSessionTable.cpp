@@ -0,0 +1,148 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/ResumeSessionTable.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/CachelinePadded.h>
+#include <folly/SharedMutex.h>
+#include <folly/Synchronized.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/internal/TimingWheel.h"
+#include "rsocket/statemachine/RSocketStateMachine.h"
+
+namespace rsocket {
+
+namespace {
+struct TokenHash {
+  size_t operator()(const ResumeIdentificationToken& token) const {
+    auto const& bits = token.data();
+    return folly::hash::fnv64_buf(bits.data(), bits.size());
+  }
+};
+} // namespace
+
+struct ResumeSessionTable::Core {
+  using Sessions = std::unordered_map<
+      ResumeIdentificationToken,
+      std::shared_ptr<RSocketServerState>,
+      TokenHash>;
+  using Shard = folly::Synchronized<Sessions, folly::SharedMutex>;
+
+  explicit Core(Options _options)
+      : options(_options), shards(std::max<size_t>(options.numShards, 1)) {}
+
+  Shard& shard(const ResumeIdentificationToken& token) {
+    // The bits of the hash left over by the maps of the shards.
+    auto const hash = folly::hash::twang_mix64(TokenHash()(token));
+    return *shards[hash % shards.size()];
+  }
+
+  /// Erases the session of `token` if it is still `state`.
+  void eraseIf(
+      const ResumeIdentificationToken& token,
+      const std::shared_ptr<RSocketServerState>& state) {
+    auto locked = shard(token).wlock();
+    auto found = locked->find(token);
+    if (found != locked->end() && found->second == state) {
+      locked->erase(found);
+    }
+  }
+
+  const Options options;
+  std::vector<folly::CachelinePadded<Shard>> shards;
+};
+
+ResumeSessionTable::ResumeSessionTable(Options options)
+    : core_(std::make_shared<Core>(options)) {}
+
+ResumeSessionTable::~ResumeSessionTable() = default;
+
+void ResumeSessionTable::insert(
+    const ResumeIdentificationToken& token,
+    std::shared_ptr<RSocketServerState> state) {
+  CHECK(state);
+  auto& eventBase = state->eventBase_;
+  std::weak_ptr<RSocketServerState> weakState = state;
+  (*core_->shard(token).wlock())[token] = std::move(state);
+
+  auto schedule = [ core = std::weak_ptr<Core>(core_), token, weakState ] {
+    scheduleCheck(core, token, weakState);
+  };
+  if (eventBase.isInEventBaseThread()) {
+    schedule();
+  } else {
+    eventBase.runInEventBaseThread(std::move(schedule));
+  }
+}
+
+std::shared_ptr<RSocketServerState> ResumeSessionTable::find(
+    const ResumeIdentificationToken& token) const {
+  auto locked = core_->shard(token).rlock();
+  auto found = locked->find(token);
+  return found == locked->end() ? nullptr : found->second;
+}
+
+bool ResumeSessionTable::erase(const ResumeIdentificationToken& token) {
+  return core_->shard(token).wlock()->erase(token) > 0;
+}
+
+size_t ResumeSessionTable::size() const {
+  size_t size = 0;
+  for (auto& shard : core_->shards) {
+    size += shard->rlock()->size();
+  }
+  return size;
+}
+
+void ResumeSessionTable::scheduleCheck(
+    std::weak_ptr<Core> weakCore,
+    ResumeIdentificationToken token,
+    std::weak_ptr<RSocketServerState> weakState) {
+  auto core = weakCore.lock();
+  auto state = weakState.lock();
+  if (!core || !state) {
+    // The table or the session is gone.
+    return;
+  }
+  auto const abandonAfter = core->options.abandonAfter;
+  TimingWheel::get(state->eventBase_)
+      .schedule(abandonAfter, [
+        weakCore = std::move(weakCore),
+        token = std::move(token),
+        weakState = std::move(weakState)
+      ]() mutable {
+        auto core = weakCore.lock();
+        auto state = weakState.lock();
+        if (!core || !state) {
+          return;
+        }
+        if (state->rSocketStateMachine_->isAbandoned(
+                core->options.abandonAfter)) {
+          VLOG(3) << "Removing abandoned session " << token;
+          core->eraseIf(token, state);
+          return;
+        }
+        scheduleCheck(std::move(weakCore), std::move(token), weakState);
+      });
+}
+
+void ResumeSessionServiceHandler::onNewRSocketState(
+    std::shared_ptr<RSocketServerState> state,
+    ResumeIdentificationToken token) {
+  sessions_->insert(token, std::move(state));
+}
+
+folly::Expected<std::shared_ptr<RSocketServerState>, RSocketException>
+ResumeSessionServiceHandler::onResume(ResumeIdentificationToken token) {
+  if (auto state = sessions_->find(token)) {
+    return state;
+  }
+  return folly::makeUnexpected(RSocketException("No ServerState"));
+}
+
+} // namespace rsocket
@@ -0,0 +1,93 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "rsocket/RSocketServiceHandler.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// The states of the resumable connections of a server by resume token, for
+/// RSocketServiceHandler::onNewRSocketState() to store them in and onResume()
+/// to find them in, see ResumeSessionServiceHandler.
+///
+/// The table is sharded by token, each shard behind a reader-writer lock, so
+/// that the lookups of clients resuming en masse after a network blip go in
+/// parallel, and only wait for the insertions into their own shard.
+///
+/// The sessions whose connection closed or isn't resumable, or which their
+/// client didn't resume within `abandonAfter` of being disconnected, are
+/// removed.  Each session is checked every `abandonAfter` on the TimingWheel
+/// of its EventBase, so that an abandoned session goes within twice that.
+/// Thread safe.
+class ResumeSessionTable {
+ public:
+  struct Options {
+    /// How long a disconnected session waits for its client.
+    std::chrono::milliseconds abandonAfter{std::chrono::minutes(1)};
+    size_t numShards{64};
+  };
+
+  explicit ResumeSessionTable(Options options = Options());
+  ~ResumeSessionTable();
+
+  ResumeSessionTable(const ResumeSessionTable&) = delete;
+  ResumeSessionTable& operator=(const ResumeSessionTable&) = delete;
+
+  /// Stores a session, replacing the one with the same token if any.
+  void insert(
+      const ResumeIdentificationToken& token,
+      std::shared_ptr<RSocketServerState> state);
+
+  /// Returns nullptr if there is no session with the token.
+  std::shared_ptr<RSocketServerState> find(
+      const ResumeIdentificationToken& token) const;
+
+  /// Returns false if there was no session with the token.
+  bool erase(const ResumeIdentificationToken& token);
+
+  /// Number of sessions.
+  size_t size() const;
+
+ private:
+  struct Core;
+
+  /// Checks, on its EventBase, whether the session stored with `state` is
+  /// abandoned, and schedules the next check if not.
+  static void scheduleCheck(
+      std::weak_ptr<Core> core,
+      ResumeIdentificationToken token,
+      std::weak_ptr<RSocketServerState> state);
+
+  /// Shared with the pending checks, which may outlive the table.
+  const std::shared_ptr<Core> core_;
+};
+
+/// A RSocketServiceHandler keeping the states of its connections in a
+/// ResumeSessionTable, for subclasses which only accept the connections.
+class ResumeSessionServiceHandler : public RSocketServiceHandler {
+ public:
+  explicit ResumeSessionServiceHandler(
+      std::shared_ptr<ResumeSessionTable> sessions =
+          std::make_shared<ResumeSessionTable>())
+      : sessions_(std::move(sessions)) {}
+
+  void onNewRSocketState(
+      std::shared_ptr<RSocketServerState> state,
+      ResumeIdentificationToken token) override;
+
+  folly::Expected<std::shared_ptr<RSocketServerState>, RSocketException>
+      onResume(ResumeIdentificationToken token) override;
+
+  ResumeSessionTable& sessions() {
+    return *sessions_;
+  }
+
+ private:
+  const std::shared_ptr<ResumeSessionTable> sessions_;
+};
+
+} // namespace rsocket
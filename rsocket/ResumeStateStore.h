@@ -0,0 +1,33 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/futures/Future.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Where a RSocketServer looks for the resumption state of the connections it
+/// doesn't know, e.g. the hosts of a cluster behind a load balancer asking the
+/// one that owns the connection.  See RSocketServer::setResumeStateStore().
+///
+/// The owner of a connection hands it over with
+/// RSocketServerState::exportResumeState(), and the server which fetched the
+/// state resumes the connection as a warm resumption.  The streams of the
+/// connection don't move: the client sees them canceled.
+class ResumeStateStore {
+ public:
+  virtual ~ResumeStateStore() = default;
+
+  /// Fetches the state of the connection with the token, as exported by its
+  /// owner.  Fulfilled with nullptr if no host has the connection.  The
+  /// future must be fulfilled before the server is destroyed.
+  virtual folly::Future<std::unique_ptr<folly::IOBuf>> fetch(
+      ResumeIdentificationToken) = 0;
+};
+
+} // namespace rsocket
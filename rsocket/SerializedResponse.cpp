@@ -0,0 +1,15 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/SerializedResponse.h"
+
+#include "rsocket/framing/Frame.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+
+namespace rsocket {
+
+SerializedResponse::SerializedResponse(Payload response)
+    : payload_(std::move(response)),
+      frame_(FrameSerializerV1_0().serializeOut(Frame_PAYLOAD(
+          0, FrameFlags::NEXT | FrameFlags::COMPLETE, payload_.clone()))) {}
+
+} // namespace rsocket
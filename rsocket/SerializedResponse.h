@@ -0,0 +1,49 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/**
+ * A response to request-responses serialized once, for the responders which
+ * return the same bytes to many requests, e.g. for their hot keys.  See
+ * RSocketResponder::serializedResponse().
+ *
+ * It holds the PAYLOAD frame of the response, with the NEXT and COMPLETE
+ * flags, serialized with protocol 1.0.  Each request it answers is sent a
+ * clone of the frame with only its header rewritten: no Payload, stream or
+ * Single is created, and the bytes of the response aren't copied.  The
+ * connections of other protocol versions, and the ones which fragment frames
+ * of its size, serialize the payload as usual.  The frame is sent as it is,
+ * without PayloadCompression.
+ *
+ * Immutable, shared between the connections of all the threads.
+ */
+class SerializedResponse {
+ public:
+  explicit SerializedResponse(Payload response);
+
+  SerializedResponse(const SerializedResponse&) = delete;
+  SerializedResponse& operator=(const SerializedResponse&) = delete;
+
+  const Payload& payload() const {
+    return payload_;
+  }
+
+  /// The PAYLOAD frame, for stream 0.
+  const folly::IOBuf& frame() const {
+    return *frame_;
+  }
+
+ private:
+  const Payload payload_;
+  const std::unique_ptr<folly::IOBuf> frame_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,147 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/StandbyConnectionFactory.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// Connections are destroyed on the EventBase they were connected on.
+void close(folly::EventBase& eventBase, std::unique_ptr<DuplexConnection> c) {
+  eventBase.runInEventBaseThread([connection = std::move(c)]() mutable {
+    connection.reset();
+  });
+}
+} // namespace
+
+struct StandbyConnectionFactory::State {
+  State(std::shared_ptr<ConnectionFactory> _factory, Options _options)
+      : factory(std::move(_factory)), options(_options) {}
+
+  ~State() {
+    if (standby) {
+      close(*standbyEventBase, std::move(standby));
+    }
+  }
+
+  /// Whether the standby idled for too long to be used.
+  bool stale() const {
+    return options.maxIdle.count() > 0 &&
+        Clock::now() - standbySince > options.maxIdle;
+  }
+
+  const std::shared_ptr<ConnectionFactory> factory;
+  const Options options;
+
+  std::mutex mutex;
+  std::unique_ptr<DuplexConnection> standby;
+  folly::EventBase* standbyEventBase{nullptr};
+  Clock::time_point standbySince;
+  bool connecting{false};
+  /// Fulfilled once connecting is done.
+  std::vector<folly::Promise<folly::Unit>> waiters;
+};
+
+StandbyConnectionFactory::StandbyConnectionFactory(
+    std::shared_ptr<ConnectionFactory> factory,
+    Options options)
+    : state_(std::make_shared<State>(std::move(factory), options)) {
+  CHECK(state_->factory);
+  connectStandby(state_);
+}
+
+StandbyConnectionFactory::~StandbyConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+StandbyConnectionFactory::connect() {
+  std::unique_ptr<DuplexConnection> standby;
+  folly::EventBase* eventBase = nullptr;
+  bool stale = false;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->standby) {
+      stale = state_->stale();
+      standby = std::move(state_->standby);
+      eventBase = state_->standbyEventBase;
+    }
+  }
+  connectStandby(state_);
+  if (standby && !stale) {
+    VLOG(2) << "Handing out the standby connection";
+    return folly::makeFuture(
+        ConnectedDuplexConnection{std::move(standby), *eventBase});
+  }
+  if (standby) {
+    VLOG(2) << "Closing the stale standby connection";
+    close(*eventBase, std::move(standby));
+  }
+  return state_->factory->connect();
+}
+
+folly::Future<folly::Unit> StandbyConnectionFactory::waitForStandby() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (!state_->connecting) {
+    return folly::makeFuture();
+  }
+  state_->waiters.emplace_back();
+  return state_->waiters.back().getFuture();
+}
+
+bool StandbyConnectionFactory::standbyReady() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->standby && !state_->stale();
+}
+
+void StandbyConnectionFactory::connectStandby(
+    const std::shared_ptr<State>& state) {
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->standby || state->connecting) {
+      return;
+    }
+    state->connecting = true;
+  }
+
+  std::weak_ptr<State> weakState = state;
+  state->factory->connect().then(
+      [weakState](folly::Try<ConnectedDuplexConnection> connected) {
+        auto state = weakState.lock();
+        if (!state) {
+          // The factory is gone, the connection is closed.
+          if (connected.hasValue()) {
+            close(
+                connected.value().eventBase,
+                std::move(connected.value().connection));
+          }
+          return;
+        }
+        if (connected.hasException()) {
+          VLOG(2) << "Could not connect a standby connection: "
+                  << connected.exception().what();
+        }
+        std::vector<folly::Promise<folly::Unit>> waiters;
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (connected.hasValue()) {
+            state->standby = std::move(connected.value().connection);
+            state->standbyEventBase = &connected.value().eventBase;
+            state->standbySince = Clock::now();
+          }
+          state->connecting = false;
+          waiters = std::move(state->waiters);
+        }
+        for (auto& waiter : waiters) {
+          waiter.setValue();
+        }
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,64 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include <folly/futures/Future.h>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * Keeps a connection of `factory` established and idle ahead of time, so that
+ * a client failing over doesn't wait for the transport to connect.
+ *
+ * Give it to an RSocketClient in place of `factory`: once its connection
+ * dies, RSocketClient::resume() sends its RESUME over the standby right away,
+ * which saves the round trips of the connect, and of the TLS handshake if
+ * any.  A `factory` connecting to another server fails over to it the same
+ * way.  Each connection handed out is replaced by a new standby, and a standby
+ * which failed to connect is tried again with the next connect().
+ *
+ * Nothing is read or written on the standby while it waits, so a peer which
+ * dropped it is only noticed once it is used.  Standbys idle for longer than
+ * `maxIdle` are closed and connected again instead of being handed out, as
+ * servers and load balancers tend to drop idle connections.
+ *
+ * The methods can be called from any thread.
+ */
+class StandbyConnectionFactory : public ConnectionFactory {
+ public:
+  struct Options {
+    /// 0 for standbys which never go stale.
+    std::chrono::milliseconds maxIdle{std::chrono::seconds(30)};
+  };
+
+  explicit StandbyConnectionFactory(
+      std::shared_ptr<ConnectionFactory> factory,
+      Options options = Options());
+  ~StandbyConnectionFactory();
+
+  /// The standby if there is one, otherwise a connection of the factory.
+  /// Connects a new standby either way.
+  folly::Future<ConnectedDuplexConnection> connect() override;
+
+  /// Fulfilled once no standby is being connected anymore, whether it
+  /// connected or failed.
+  folly::Future<folly::Unit> waitForStandby();
+
+  /// Whether a standby is ready to be handed out.
+  bool standbyReady() const;
+
+ private:
+  struct State;
+
+  /// Connects a standby unless there is one already.
+  static void connectStandby(const std::shared_ptr<State>&);
+
+  const std::shared_ptr<State> state_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,442 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/framing/CompressedDuplexConnection.h"
+
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/framing/Frame.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/framing/FrameType.h"
+#include "rsocket/internal/StreamCompressor.h"
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+namespace rsocket {
+
+namespace {
+using Codec = ConnectionCompression::Codec;
+
+constexpr size_t kLengthFieldSize =
+    FrameSerializerV1_0::kFrameLengthFieldLength;
+/// The length field and the header of a frame.
+constexpr size_t kFramePrefixSize =
+    kLengthFieldSize + FrameSerializerV1_0::kFrameHeaderSize;
+
+size_t readFrameLength(folly::io::Cursor& cursor) {
+  size_t length = 0;
+  for (size_t i = 0; i < kLengthFieldSize; ++i) {
+    length = (length << 8) | cursor.read<uint8_t>();
+  }
+  return length;
+}
+
+/// A copy of a frame without its length field, to deserialize.
+std::unique_ptr<folly::IOBuf> frameBody(const folly::IOBuf& frame) {
+  folly::io::Cursor cursor(&frame);
+  cursor.skip(kLengthFieldSize);
+  std::unique_ptr<folly::IOBuf> body;
+  cursor.clone(body, cursor.totalLength());
+  return body;
+}
+
+/// The codec of the entry of kConnectionCompressionMimeType of composite
+/// metadata, NONE without one.
+Codec findCodec(const folly::IOBuf& metadata) {
+  try {
+    auto entry = CompositeMetadataReader(metadata).find(
+        kConnectionCompressionMimeType);
+    if (!entry || entry->length() != 1) {
+      return Codec::NONE;
+    }
+    return static_cast<Codec>(entry->cursor().read<uint8_t>());
+  } catch (const std::exception&) {
+    // Malformed, no codec then.
+    return Codec::NONE;
+  }
+}
+
+/// The codec a SETUP, with its length field, asks for.  NONE for a SETUP
+/// other than a 1.0 one, or which doesn't ask.
+Codec requestedCodec(const folly::IOBuf& frame) {
+  if (FrameSerializerV1_0::detectProtocolVersion(frame, kLengthFieldSize) !=
+      FrameSerializerV1_0::Version) {
+    return Codec::NONE;
+  }
+  Frame_SETUP setup;
+  if (!FrameSerializerV1_0().deserializeFrom(setup, frameBody(frame)) ||
+      setup.metadataMimeType_ != kCompositeMetadataMimeType ||
+      !setup.payload_.metadata) {
+    return Codec::NONE;
+  }
+  return findCodec(*setup.payload_.metadata);
+}
+
+/// The codec of a METADATA_PUSH, with its length field, written by
+/// markerFrame().  NONE for any other METADATA_PUSH.
+Codec markerCodec(const folly::IOBuf& frame) {
+  Frame_METADATA_PUSH push;
+  if (!FrameSerializerV1_0().deserializeFrom(push, frameBody(frame)) ||
+      !push.metadata_) {
+    return Codec::NONE;
+  }
+  return findCodec(*push.metadata_);
+}
+
+/// The METADATA_PUSH, with its length field, written right before the
+/// compressed bytes.
+std::unique_ptr<folly::IOBuf> markerFrame(Codec codec) {
+  auto frame = FrameSerializerV1_0().serializeOut(
+      Frame_METADATA_PUSH(CompressedDuplexConnection::setupMetadata(codec)));
+  auto const length = frame->computeChainDataLength();
+  auto marker = folly::IOBuf::create(kLengthFieldSize);
+  for (size_t i = kLengthFieldSize; i > 0; --i) {
+    *marker->writableTail() = static_cast<uint8_t>(length >> (8 * (i - 1)));
+    marker->append(1);
+  }
+  marker->prependChain(std::move(frame));
+  return marker;
+}
+} // namespace
+
+struct CompressedDuplexConnection::State {
+  enum class Reading : uint8_t {
+    /// The server waits for the SETUP.
+    SETUP,
+    /// Frames are read as they are until the METADATA_PUSH of the peer.
+    SCANNING,
+    /// The connection doesn't compress.
+    PLAIN,
+    COMPRESSED,
+  };
+
+  State(bool _isServer, ConnectionCompression compression, size_t maxLength)
+      : isServer(_isServer),
+        level(compression.level),
+        codec(compression.codec),
+        maxFrameLength(maxLength),
+        reading(_isServer ? Reading::SETUP : Reading::SCANNING) {}
+
+  /// The bytes read, decompressed if they need to be, without the frames of
+  /// the negotiation.  Throws std::runtime_error on bytes which can't be
+  /// decompressed, or which decompress to more than the longest frame.
+  std::unique_ptr<folly::IOBuf> read(std::unique_ptr<folly::IOBuf> bytes) {
+    switch (reading) {
+      case Reading::PLAIN:
+        return bytes;
+      case Reading::COMPRESSED:
+        return decompressor->decompress(*bytes, maxFrameLength);
+      case Reading::SETUP:
+      case Reading::SCANNING:
+        break;
+    }
+
+    pending.append(std::move(bytes));
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    while (reading == Reading::SETUP || reading == Reading::SCANNING) {
+      if (plainInput > 0) {
+        if (pending.empty()) {
+          break;
+        }
+        auto const length = std::min(plainInput, pending.chainLength());
+        out.append(pending.split(length));
+        plainInput -= length;
+      } else if (!readFrame(out)) {
+        break;
+      }
+    }
+    if (!pending.empty()) {
+      if (reading == Reading::PLAIN) {
+        out.append(pending.move());
+      } else if (reading == Reading::COMPRESSED) {
+        out.append(decompressor->decompress(*pending.move(), maxFrameLength));
+      }
+    }
+    return out.move();
+  }
+
+  /// Reads the frame at the start of `pending`.  Returns false until enough
+  /// of it has been read.
+  bool readFrame(folly::IOBufQueue& out) {
+    if (pending.chainLength() < kFramePrefixSize) {
+      return false;
+    }
+    folly::io::Cursor cursor(pending.front());
+    auto const frameLength = readFrameLength(cursor);
+    auto const streamId = cursor.readBE<uint32_t>();
+    auto const type = static_cast<FrameType>(cursor.readBE<uint16_t>() >> 10);
+    auto const length = kLengthFieldSize + frameLength;
+    auto const negotiating = reading == Reading::SETUP
+        ? type == FrameType::SETUP
+        : type == FrameType::METADATA_PUSH;
+    if (!negotiating || streamId != 0 || frameLength > maxFrameLength) {
+      // Handed over as it is, the FramedReader fails the frames too long.
+      plainInput = length;
+      // The METADATA_PUSH of the server comes first, if at all.
+      if (reading == Reading::SETUP || !isServer) {
+        reading = Reading::PLAIN;
+      }
+      return true;
+    }
+    if (pending.chainLength() < length) {
+      return false;
+    }
+
+    auto frame = pending.split(length);
+    if (reading == Reading::SETUP) {
+      auto const requested = requestedCodec(*frame);
+      out.append(std::move(frame));
+      reading = startCompressing(requested) ? Reading::SCANNING
+                                            : Reading::PLAIN;
+      return true;
+    }
+    auto const marked = markerCodec(*frame);
+    if (marked == Codec::NONE) {
+      out.append(std::move(frame));
+      if (!isServer) {
+        reading = Reading::PLAIN;
+      }
+      return true;
+    }
+    if (marked != codec) {
+      throw std::runtime_error(folly::to<std::string>(
+          "The peer compresses with codec ", static_cast<int>(marked)));
+    }
+    reading = Reading::COMPRESSED;
+    if (!isServer) {
+      // The server accepted, the client compresses from now on.
+      compressing = true;
+      markerPending = true;
+    }
+    return true;
+  }
+
+  /// Whether the server compresses with the codec the client asked for.
+  bool startCompressing(Codec requested) {
+    DCHECK(isServer);
+    compressor = StreamCompressor::create(requested, level);
+    decompressor = StreamDecompressor::create(requested);
+    if (!compressor || !decompressor) {
+      compressor = nullptr;
+      decompressor = nullptr;
+      return false;
+    }
+    codec = requested;
+    compressing = true;
+    markerPending = true;
+    return true;
+  }
+
+  /// The bytes to write, compressed if they need to be.
+  std::unique_ptr<folly::IOBuf> write(std::unique_ptr<folly::IOBuf> bytes) {
+    if (!compressing) {
+      return bytes;
+    }
+    auto compressed = compressor->compress(*bytes);
+    if (auto marker = takeMarker()) {
+      marker->prependChain(std::move(compressed));
+      return marker;
+    }
+    return compressed;
+  }
+
+  /// The METADATA_PUSH to write before the first compressed bytes, nullptr
+  /// once written.
+  std::unique_ptr<folly::IOBuf> takeMarker() {
+    if (!markerPending) {
+      return nullptr;
+    }
+    markerPending = false;
+    return markerFrame(codec);
+  }
+
+  const bool isServer;
+  const int level;
+  /// Known to the server once it read the SETUP.
+  Codec codec;
+  const size_t maxFrameLength;
+
+  Reading reading;
+  /// The bytes read from the start of a frame, while reading frames as they
+  /// are.
+  folly::IOBufQueue pending{folly::IOBufQueue::cacheChainLength()};
+  /// Bytes of the current frame still read as they are.
+  size_t plainInput{0};
+  std::unique_ptr<StreamDecompressor> decompressor;
+
+  bool compressing{false};
+  bool markerPending{false};
+  std::unique_ptr<StreamCompressor> compressor;
+};
+
+class CompressedDuplexConnection::Input
+    : public DuplexConnection::DuplexSubscriber {
+ public:
+  Input(
+      std::shared_ptr<State> state,
+      yarpl::Reference<DuplexConnection::Subscriber> inner)
+      : state_(std::move(state)), inner_(std::move(inner)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    DuplexSubscriber::onSubscribe(subscription);
+    inner_->onSubscribe(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> bytes) override {
+    if (!inner_) {
+      return;
+    }
+    std::unique_ptr<folly::IOBuf> read;
+    try {
+      read = state_->read(std::move(bytes));
+    } catch (const std::exception& ex) {
+      VLOG(1) << "error: " << ex.what();
+      auto subscription = DuplexSubscriber::subscription();
+      onError(std::runtime_error(ex.what()));
+      if (subscription) {
+        subscription->cancel();
+      }
+      return;
+    }
+    if (read && !read->empty()) {
+      inner_->onNext(std::move(read));
+    }
+  }
+
+  void onComplete() override {
+    DuplexSubscriber::onComplete();
+    if (auto inner = std::move(inner_)) {
+      inner->onComplete();
+    }
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    DuplexSubscriber::onError(ex);
+    if (auto inner = std::move(inner_)) {
+      inner->onError(std::move(ex));
+    }
+  }
+
+ private:
+  const std::shared_ptr<State> state_;
+  yarpl::Reference<DuplexConnection::Subscriber> inner_;
+};
+
+class CompressedDuplexConnection::Output
+    : public DuplexConnection::DuplexSubscriber {
+ public:
+  Output(
+      std::shared_ptr<State> state,
+      yarpl::Reference<DuplexConnection::Subscriber> inner)
+      : state_(std::move(state)), inner_(std::move(inner)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    DuplexSubscriber::onSubscribe(subscription);
+    inner_->onSubscribe(std::move(subscription));
+    // The server accepts at once, so that the client compresses early.
+    if (auto marker = state_->takeMarker()) {
+      inner_->onNext(std::move(marker));
+    }
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> bytes) override {
+    if (!inner_) {
+      return;
+    }
+    std::unique_ptr<folly::IOBuf> written;
+    try {
+      written = state_->write(std::move(bytes));
+    } catch (const std::exception& ex) {
+      VLOG(1) << "error: " << ex.what();
+      auto subscription = DuplexSubscriber::subscription();
+      onError(std::runtime_error(ex.what()));
+      if (subscription) {
+        subscription->cancel();
+      }
+      return;
+    }
+    inner_->onNext(std::move(written));
+  }
+
+  void onComplete() override {
+    DuplexSubscriber::onComplete();
+    if (auto inner = std::move(inner_)) {
+      inner->onComplete();
+    }
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    DuplexSubscriber::onError(ex);
+    if (auto inner = std::move(inner_)) {
+      inner->onError(std::move(ex));
+    }
+  }
+
+ private:
+  const std::shared_ptr<State> state_;
+  yarpl::Reference<DuplexConnection::Subscriber> inner_;
+};
+
+std::unique_ptr<CompressedDuplexConnection> CompressedDuplexConnection::client(
+    std::unique_ptr<DuplexConnection> connection,
+    ConnectionCompression compression,
+    size_t maxFrameLength) {
+  auto state = std::make_shared<State>(false, compression, maxFrameLength);
+  state->compressor =
+      StreamCompressor::create(compression.codec, compression.level);
+  state->decompressor = StreamDecompressor::create(compression.codec);
+  CHECK(state->compressor && state->decompressor)
+      << "Compression codec unavailable";
+  return std::unique_ptr<CompressedDuplexConnection>(
+      new CompressedDuplexConnection(std::move(connection), std::move(state)));
+}
+
+std::unique_ptr<CompressedDuplexConnection> CompressedDuplexConnection::server(
+    std::unique_ptr<DuplexConnection> connection,
+    int level,
+    size_t maxFrameLength) {
+  ConnectionCompression compression;
+  compression.level = level;
+  return std::unique_ptr<CompressedDuplexConnection>(
+      new CompressedDuplexConnection(
+          std::move(connection),
+          std::make_shared<State>(true, compression, maxFrameLength)));
+}
+
+std::unique_ptr<folly::IOBuf> CompressedDuplexConnection::setupMetadata(
+    ConnectionCompression::Codec codec) {
+  auto const id = static_cast<char>(codec);
+  return CompositeMetadataBuilder()
+      .add(kConnectionCompressionMimeType, folly::StringPiece(&id, 1))
+      .build();
+}
+
+CompressedDuplexConnection::CompressedDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    std::shared_ptr<State> state)
+    : inner_(std::move(connection)), state_(std::move(state)) {}
+
+CompressedDuplexConnection::~CompressedDuplexConnection() {}
+
+void CompressedDuplexConnection::setInput(
+    yarpl::Reference<DuplexConnection::Subscriber> subscriber) {
+  CHECK(!input_) << "The input is set once";
+  input_ = yarpl::make_ref<Input>(state_, std::move(subscriber));
+  inner_->setInput(input_);
+}
+
+yarpl::Reference<DuplexConnection::Subscriber>
+CompressedDuplexConnection::getOutput() {
+  return yarpl::make_ref<Output>(state_, inner_->getOutput());
+}
+
+size_t CompressedDuplexConnection::bufferedBytes() const {
+  return state_->pending.chainLength() + inner_->bufferedBytes();
+}
+
+} // namespace rsocket
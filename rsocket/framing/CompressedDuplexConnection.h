@@ -0,0 +1,100 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/Range.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketParameters.h"
+
+namespace rsocket {
+
+/// The mime type of the composite metadata entry, the id of a codec as a
+/// single byte, by which a client asks for ConnectionCompression in its SETUP,
+/// and which a METADATA_PUSH of each connection carries right before the
+/// compressed bytes.
+constexpr folly::StringPiece kConnectionCompressionMimeType{
+    "message/x.rsocket.connection-compression.v0"};
+
+/// Compresses the bytes of a connection without framing of its own, below the
+/// FramedDuplexConnection, see ConnectionCompression.
+///
+/// The connection of a server reads the first frame as it is: if it is a
+/// SETUP asking for compression with a codec the server has, it writes a
+/// METADATA_PUSH of kConnectionCompressionMimeType as it is, and compresses
+/// everything after it.  It then reads the frames of the client as they are
+/// until the client does the same.  The connection of a client writes as it
+/// is, and only compresses after the METADATA_PUSH of the server, which has
+/// to be the first frame it reads.  Neither connection hands these frames
+/// over, and both fail once the bytes of a single read decompress to more
+/// than the longest frame.
+///
+/// The connections are not handed over, as their compression contexts can't
+/// be, see DuplexConnection::releaseSocket().
+class CompressedDuplexConnection : public virtual DuplexConnection {
+ public:
+  /// The connection of a client compressing with `compression`, whose codec
+  /// is not NONE, once the server accepts it.
+  static std::unique_ptr<CompressedDuplexConnection> client(
+      std::unique_ptr<DuplexConnection> connection,
+      ConnectionCompression compression,
+      size_t maxFrameLength);
+
+  /// The connection of a server, which compresses at `level` if the client
+  /// asks for it.
+  static std::unique_ptr<CompressedDuplexConnection> server(
+      std::unique_ptr<DuplexConnection> connection,
+      int level,
+      size_t maxFrameLength);
+
+  /// The composite metadata entry by which a client asks for `codec` in its
+  /// SETUP.
+  static std::unique_ptr<folly::IOBuf> setupMetadata(
+      ConnectionCompression::Codec codec);
+
+  ~CompressedDuplexConnection();
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override;
+
+  size_t bufferedBytes() const override;
+
+  void releaseBuffers() override {
+    inner_->releaseBuffers();
+  }
+
+  bool detachEventBase() override {
+    return inner_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    inner_->attachEventBase(eventBase);
+  }
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) override {
+    inner_->setStreamPriority(streamId, priority);
+  }
+
+  void clearStreamPriority(StreamId streamId) override {
+    inner_->clearStreamPriority(streamId);
+  }
+
+ private:
+  struct State;
+  class Input;
+  class Output;
+
+  CompressedDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      std::shared_ptr<State> state);
+
+  std::unique_ptr<DuplexConnection> inner_;
+  /// Shared with the input and the output.
+  const std::shared_ptr<State> state_;
+  yarpl::Reference<Input> input_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,75 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/framing/Fragmentation.h"
+
+#include <algorithm>
+
+namespace rsocket {
+
+namespace {
+size_t chainLength(const std::unique_ptr<folly::IOBuf>& buf) {
+  return buf ? buf->computeChainDataLength() : 0;
+}
+} // namespace
+
+bool needsFragmentation(const Payload& payload, size_t mtu) {
+  return mtu > 0 &&
+      chainLength(payload.metadata) + chainLength(payload.data) > mtu;
+}
+
+std::vector<Payload> fragmentPayload(Payload payload, size_t mtu) {
+  DCHECK_GT(mtu, 0);
+  auto const hasMetadata = payload.metadata != nullptr;
+
+  folly::IOBufQueue metadata{folly::IOBufQueue::cacheChainLength()};
+  if (payload.metadata) {
+    metadata.append(std::move(payload.metadata));
+  }
+  folly::IOBufQueue data{folly::IOBufQueue::cacheChainLength()};
+  if (payload.data) {
+    data.append(std::move(payload.data));
+  }
+
+  std::vector<Payload> fragments;
+  fragments.reserve(
+      (metadata.chainLength() + data.chainLength() + mtu - 1) / mtu);
+  do {
+    Payload fragment;
+    auto budget = mtu;
+    if (!metadata.empty()) {
+      auto length = std::min(budget, metadata.chainLength());
+      fragment.metadata = metadata.split(length);
+      budget -= length;
+    } else if (hasMetadata && fragments.empty()) {
+      fragment.metadata = folly::IOBuf::create(0);
+    }
+    if (budget > 0 && !data.empty()) {
+      fragment.data = data.split(std::min(budget, data.chainLength()));
+    }
+    fragments.push_back(std::move(fragment));
+  } while (!metadata.empty() || !data.empty());
+  return fragments;
+}
+
+void PayloadReassembler::append(Payload fragment) {
+  if (fragment.metadata) {
+    hasMetadata_ = true;
+    metadata_.append(std::move(fragment.metadata));
+  }
+  if (fragment.data) {
+    data_.append(std::move(fragment.data));
+  }
+}
+
+Payload PayloadReassembler::move() {
+  auto data = data_.move();
+  auto metadata = metadata_.move();
+  if (hasMetadata_ && !metadata) {
+    metadata = folly::IOBuf::create(0);
+  }
+  hasMetadata_ = false;
+  return Payload(
+      data ? std::move(data) : folly::IOBuf::create(0), std::move(metadata));
+}
+
+} // namespace rsocket
@@ -0,0 +1,52 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <vector>
+
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/Payload.h"
+#include "rsocket/framing/FrameFlags.h"
+#include "rsocket/framing/FrameType.h"
+
+namespace rsocket {
+
+/// Whether the payload carries more than `mtu` bytes of metadata and data.  An
+/// mtu of 0 disables fragmentation.
+bool needsFragmentation(const Payload& payload, size_t mtu);
+
+/// Splits the payload into fragments carrying at most `mtu` bytes of metadata
+/// and data each, metadata first.  The fragments share the buffers of the
+/// payload, no bytes are copied.
+std::vector<Payload> fragmentPayload(Payload payload, size_t mtu);
+
+/// Joins the fragments of a payload back into one payload.  The buffers of the
+/// fragments are chained, no bytes are copied.
+class PayloadReassembler {
+ public:
+  void append(Payload fragment);
+
+  /// Total number of metadata and data bytes appended so far.
+  size_t size() const {
+    return metadata_.chainLength() + data_.chainLength();
+  }
+
+  Payload move();
+
+ private:
+  bool hasMetadata_{false};
+  folly::IOBufQueue metadata_{folly::IOBufQueue::cacheChainLength()};
+  folly::IOBufQueue data_{folly::IOBufQueue::cacheChainLength()};
+};
+
+/// A request or PAYLOAD frame whose payload is still arriving in fragments.
+struct PartialFrame {
+  /// Type and flags of the first fragment.
+  FrameType type{FrameType::RESERVED};
+  FrameFlags flags{FrameFlags::EMPTY};
+  uint32_t requestN{0};
+  PayloadReassembler payload;
+};
+
+} // namespace rsocket
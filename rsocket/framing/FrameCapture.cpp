@@ -0,0 +1,200 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/framing/FrameCapture.h"
+
+#include <fcntl.h>
+
+#include <folly/FileUtil.h>
+#include <folly/Varint.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+constexpr folly::StringPiece FrameCaptureWriter::kMagic;
+constexpr size_t FrameCaptureWriter::kFlushBytes;
+
+namespace {
+
+/// Records the bytes read before passing them on to the input subscriber of
+/// the connection.
+class CapturingSubscriber : public DuplexConnection::DuplexSubscriber {
+ public:
+  CapturingSubscriber(
+      yarpl::Reference<DuplexConnection::Subscriber> inner,
+      std::shared_ptr<FrameCaptureWriter> writer)
+      : inner_(std::move(inner)),
+        innerSizeHint_(
+            dynamic_cast<DuplexConnection::DuplexSubscriber*>(inner_.get())),
+        writer_(std::move(writer)) {}
+
+  void onSubscribe(
+      yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
+    inner_->onSubscribe(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> bytes) override {
+    writer_->record(*bytes);
+    inner_->onNext(std::move(bytes));
+  }
+
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    for (auto& frame : frames) {
+      writer_->record(*frame);
+    }
+    if (innerSizeHint_) {
+      innerSizeHint_->onNextMultiple(std::move(frames));
+      return;
+    }
+    for (auto& frame : frames) {
+      inner_->onNext(std::move(frame));
+    }
+  }
+
+  void onComplete() override {
+    writer_->flush();
+    innerSizeHint_ = nullptr;
+    if (auto inner = std::move(inner_)) {
+      inner->onComplete();
+    }
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    writer_->flush();
+    innerSizeHint_ = nullptr;
+    if (auto inner = std::move(inner_)) {
+      inner->onError(std::move(ew));
+    }
+  }
+
+  size_t bytesExpected() const override {
+    return innerSizeHint_ ? innerSizeHint_->bytesExpected() : 0;
+  }
+
+ private:
+  yarpl::Reference<DuplexConnection::Subscriber> inner_;
+  DuplexConnection::DuplexSubscriber* innerSizeHint_;
+  const std::shared_ptr<FrameCaptureWriter> writer_;
+};
+
+void appendVarint(folly::io::QueueAppender& appender, uint64_t value) {
+  appender.ensure(folly::kMaxVarintLength64);
+  appender.append(folly::encodeVarint(value, appender.writableData()));
+}
+
+bool readVarint(folly::io::Cursor& cursor, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+    if (!cursor.tryRead(byte)) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<folly::IOBuf> readCapture(const std::string& path) {
+  std::string contents;
+  if (!folly::readFile(path.c_str(), contents)) {
+    throw std::runtime_error("Can't read capture file " + path);
+  }
+  auto const headerLength = FrameCaptureWriter::kMagic.size() + 1;
+  if (contents.size() < headerLength ||
+      folly::StringPiece(contents).subpiece(
+          0, FrameCaptureWriter::kMagic.size()) != FrameCaptureWriter::kMagic) {
+    throw std::runtime_error(path + " is not a capture file");
+  }
+  return folly::IOBuf::fromString(std::move(contents));
+}
+
+} // namespace
+
+FrameCaptureWriter::FrameCaptureWriter(const std::string& path, bool framed)
+    : file_(path, O_WRONLY | O_CREAT | O_TRUNC) {
+  folly::io::QueueAppender appender(&buffer_, kMagic.size() + 1);
+  appender.push(
+      reinterpret_cast<const uint8_t*>(kMagic.data()), kMagic.size());
+  appender.write<uint8_t>(framed ? 1 : 0);
+}
+
+FrameCaptureWriter::~FrameCaptureWriter() {
+  flush();
+}
+
+void FrameCaptureWriter::record(const folly::IOBuf& bytes) {
+  if (failed_) {
+    return;
+  }
+  auto const now = Clock::now();
+  auto const delay = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - lastRecord_.value_or(now));
+  lastRecord_ = now;
+
+  folly::io::QueueAppender appender(&buffer_, 2 * folly::kMaxVarintLength64);
+  appendVarint(appender, delay.count());
+  appendVarint(appender, bytes.computeChainDataLength());
+  for (auto range : bytes) {
+    appender.push(range.data(), range.size());
+  }
+  ++records_;
+
+  if (buffer_.chainLength() >= kFlushBytes) {
+    flush();
+  }
+}
+
+bool FrameCaptureWriter::flush() {
+  if (failed_ || buffer_.empty()) {
+    buffer_.move();
+    return !failed_;
+  }
+  auto buffered = buffer_.move();
+  auto iov = buffered->getIov();
+  if (folly::writevFull(file_.fd(), iov.data(), iov.size()) < 0) {
+    PLOG(ERROR) << "Can't write capture file, stopped capturing";
+    failed_ = true;
+  }
+  return !failed_;
+}
+
+FrameCaptureReader::FrameCaptureReader(const std::string& path)
+    : contents_(readCapture(path)), cursor_(contents_.get()) {
+  cursor_.skip(FrameCaptureWriter::kMagic.size());
+  framed_ = cursor_.read<uint8_t>() != 0;
+}
+
+folly::Optional<FrameCaptureReader::Record> FrameCaptureReader::next() {
+  uint64_t delay;
+  uint64_t length;
+  if (!readVarint(cursor_, delay) || !readVarint(cursor_, length) ||
+      !cursor_.canAdvance(length)) {
+    return folly::none;
+  }
+  Record record;
+  record.delay = std::chrono::microseconds(delay);
+  cursor_.clone(record.bytes, length);
+  return std::move(record);
+}
+
+CapturingDuplexConnection::CapturingDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    const std::string& path)
+    : inner_(std::move(connection)),
+      writer_(std::make_shared<FrameCaptureWriter>(path, inner_->isFramed())) {
+}
+
+void CapturingDuplexConnection::setInput(
+    yarpl::Reference<DuplexConnection::Subscriber> subscriber) {
+  if (!subscriber) {
+    inner_->setInput(nullptr);
+    return;
+  }
+  inner_->setInput(
+      yarpl::make_ref<CapturingSubscriber>(std::move(subscriber), writer_));
+}
+
+} // namespace rsocket
@@ -0,0 +1,133 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <folly/File.h>
+#include <folly/Optional.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace rsocket {
+
+/// Records the bytes a DuplexConnection reads, with the time they arrived, to
+/// a compact binary file, e.g. to replay production traffic offline, see
+/// benchmarks/ReplayCapture.cpp.
+///
+/// The file starts with kMagic and a byte telling whether the connection was
+/// framed, i.e. whether each record is a whole frame, or a read which still
+/// carries the frame length fields.  Each record then holds the microseconds
+/// since the previous record and the length of its bytes, as varints,
+/// followed by the bytes.
+///
+/// The records are buffered and written kFlushBytes at a time.  Not
+/// thread-safe, a connection records on its EventBase.
+class FrameCaptureWriter {
+ public:
+  static constexpr folly::StringPiece kMagic{"RSCAPTURE1"};
+  static constexpr size_t kFlushBytes{64 * 1024};
+
+  /// Creates or truncates the file at `path`.  Throws if it can't.
+  FrameCaptureWriter(const std::string& path, bool framed);
+
+  /// Writes the records still buffered.
+  ~FrameCaptureWriter();
+
+  void record(const folly::IOBuf& bytes);
+
+  /// Writes the buffered records to the file.  Returns false if it can't,
+  /// after which nothing more is written.
+  bool flush();
+
+  size_t records() const {
+    return records_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  folly::File file_;
+  folly::IOBufQueue buffer_{folly::IOBufQueue::cacheChainLength()};
+  folly::Optional<Clock::time_point> lastRecord_;
+  size_t records_{0};
+  bool failed_{false};
+};
+
+/// Reads back the records of a FrameCaptureWriter.  The file is read at once,
+/// and the records share its buffer.
+class FrameCaptureReader {
+ public:
+  struct Record {
+    /// Since the previous record.
+    std::chrono::microseconds delay{0};
+    std::unique_ptr<folly::IOBuf> bytes;
+  };
+
+  /// Throws if the file at `path` can't be read or isn't a capture.
+  explicit FrameCaptureReader(const std::string& path);
+
+  /// Whether the records are whole frames.
+  bool framed() const {
+    return framed_;
+  }
+
+  /// The next record, or none at the end of the file.  A truncated record at
+  /// the end, e.g. of a process which crashed, is skipped.
+  folly::Optional<Record> next();
+
+ private:
+  std::unique_ptr<folly::IOBuf> contents_;
+  folly::io::Cursor cursor_;
+  bool framed_{false};
+};
+
+/// Records the bytes `connection` reads to a capture file, see
+/// FrameCaptureWriter, and passes everything else through.  The file is
+/// flushed when the input terminates, and when this is destroyed.
+class CapturingDuplexConnection : public DuplexConnection {
+ public:
+  CapturingDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      const std::string& path);
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override {
+    return inner_->getOutput();
+  }
+
+  bool isFramed() const override {
+    return inner_->isFramed();
+  }
+
+  size_t bufferedBytes() const override {
+    return inner_->bufferedBytes();
+  }
+
+  void releaseBuffers() override {
+    inner_->releaseBuffers();
+  }
+
+  bool detachEventBase() override {
+    return inner_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    inner_->attachEventBase(eventBase);
+  }
+
+  DuplexConnection* getConnection() {
+    return inner_.get();
+  }
+
+ private:
+  const std::unique_ptr<DuplexConnection> inner_;
+  const std::shared_ptr<FrameCaptureWriter> writer_;
+};
+
+} // namespace rsocket
@@ -27,6 +27,11 @@ enum class FrameFlags : uint16_t {
 
   // PAYLOAD.
   NEXT = 0x20,
+
+  // REQUEST_RESPONSE, REQUEST_FNF, REQUEST_STREAM, REQUEST_CHANNEL, PAYLOAD.
+  // Extension: the data is compressed, see PayloadCompression.  Only the
+  // first fragment of a fragmented frame carries it.
+  COMPRESSED = 0x10,
 };
 
 constexpr uint16_t raw(FrameFlags flags) {
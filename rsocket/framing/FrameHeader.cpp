@@ -18,21 +18,27 @@ constexpr auto kKeepAliveRespond = "KEEPALIVE_RESPOND";
 constexpr auto kFollows = "FOLLOWS";
 constexpr auto kComplete = "COMPLETE";
 constexpr auto kNext = "NEXT";
+constexpr auto kCompressed = "COMPRESSED";
 
 std::map<FrameType, std::vector<std::pair<FrameFlags, std::string>>>
     flagToNameMap{
         {FrameType::REQUEST_N, {}},
         {FrameType::REQUEST_RESPONSE,
-         {{FrameFlags::METADATA, kMetadata}, {FrameFlags::FOLLOWS, kFollows}}},
+         {{FrameFlags::METADATA, kMetadata},
+          {FrameFlags::FOLLOWS, kFollows},
+          {FrameFlags::COMPRESSED, kCompressed}}},
         {FrameType::REQUEST_FNF,
-         {{FrameFlags::METADATA, kMetadata}, {FrameFlags::FOLLOWS, kFollows}}},
+         {{FrameFlags::METADATA, kMetadata},
+          {FrameFlags::FOLLOWS, kFollows},
+          {FrameFlags::COMPRESSED, kCompressed}}},
         {FrameType::METADATA_PUSH, {}},
         {FrameType::CANCEL, {}},
         {FrameType::PAYLOAD,
          {{FrameFlags::METADATA, kMetadata},
           {FrameFlags::FOLLOWS, kFollows},
           {FrameFlags::COMPLETE, kComplete},
-          {FrameFlags::NEXT, kNext}}},
+          {FrameFlags::NEXT, kNext},
+          {FrameFlags::COMPRESSED, kCompressed}}},
         {FrameType::ERROR, {{FrameFlags::METADATA, kMetadata}}},
         {FrameType::KEEPALIVE,
          {{FrameFlags::KEEPALIVE_RESPOND, kKeepAliveRespond}}},
@@ -45,9 +51,12 @@ std::map<FrameType, std::vector<std::pair<FrameFlags, std::string>>>
         {FrameType::REQUEST_CHANNEL,
          {{FrameFlags::METADATA, kMetadata},
           {FrameFlags::FOLLOWS, kFollows},
-          {FrameFlags::COMPLETE, kComplete}}},
+          {FrameFlags::COMPLETE, kComplete},
+          {FrameFlags::COMPRESSED, kCompressed}}},
         {FrameType::REQUEST_STREAM,
-         {{FrameFlags::METADATA, kMetadata}, {FrameFlags::FOLLOWS, kFollows}}}};
+         {{FrameFlags::METADATA, kMetadata},
+          {FrameFlags::FOLLOWS, kFollows},
+          {FrameFlags::COMPRESSED, kCompressed}}}};
 
 std::ostream&
 writeFlags(std::ostream& os, FrameFlags frameFlags, FrameType frameType) {
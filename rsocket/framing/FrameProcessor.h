@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "rsocket/internal/Common.h"
 
 namespace folly {
@@ -16,7 +19,21 @@ class FrameProcessor {
   virtual ~FrameProcessor() = default;
 
   virtual void processFrame(std::unique_ptr<folly::IOBuf>) = 0;
+
+  /// Processes the frames parsed from one read of the transport, in order.
+  /// Processors which can share the per frame work across them override it.
+  virtual void processFrames(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      processFrame(std::move(frame));
+    }
+  }
+
   virtual void onTerminal(folly::exception_wrapper) = 0;
+
+  /// Called when the transport starts or stops accepting more output without
+  /// buffering it, see DuplexSubscription.
+  virtual void onWritabilityChanged(bool /*writable*/) {}
 };
 
 } // reactivesocket
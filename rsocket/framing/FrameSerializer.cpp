@@ -2,6 +2,8 @@
 
 #include "rsocket/framing/FrameSerializer.h"
 
+#include <stdexcept>
+
 #include <folly/Conv.h>
 #include <folly/portability/GFlags.h>
 
@@ -65,6 +67,39 @@ std::unique_ptr<FrameSerializer> FrameSerializer::createAutodetectedSerializer(
   return createFrameSerializer(detectedVersion);
 }
 
+folly::Optional<FrameHeader> FrameSerializer::peekFrameHeader(
+    const folly::IOBuf& in) {
+  auto streamId = peekStreamId(in);
+  if (!streamId) {
+    return folly::none;
+  }
+  return FrameHeader(peekFrameType(in), FrameFlags::EMPTY, *streamId);
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializer::withStreamId(
+    std::unique_ptr<folly::IOBuf> frame,
+    StreamId streamId) {
+  return copyWithStreamId(*frame, streamId);
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializer::cloneWithStreamId(
+    const folly::IOBuf& frame,
+    StreamId streamId,
+    folly::Optional<FrameFlags> flags) {
+  if (flags) {
+    throw std::invalid_argument(
+        "Replacing the flags of a frame is not supported by this serializer");
+  }
+  return copyWithStreamId(frame, streamId);
+}
+
+folly::Optional<LazyPayload::Layout> FrameSerializer::peekRequestPayload(
+    const folly::IOBuf&,
+    FrameHeader&,
+    uint32_t&) {
+  return folly::none;
+}
+
 std::ostream& operator<<(std::ostream& os, const ProtocolVersion& version) {
   return os << version.major << "." << version.minor;
 }
@@ -6,6 +6,8 @@
 
 #include <memory>
 
+#include "rsocket/LazyPayload.h"
+#include "rsocket/MetadataView.h"
 #include "rsocket/framing/Frame.h"
 
 namespace rsocket {
@@ -26,6 +28,34 @@ class FrameSerializer {
   virtual FrameType peekFrameType(const folly::IOBuf& in) = 0;
   virtual folly::Optional<StreamId> peekStreamId(const folly::IOBuf& in) = 0;
 
+  /// Decodes the frame type and stream id in a single pass over the frame
+  /// header, so that callers dispatching on both don't parse it twice.
+  /// Returns folly::none if the header can't be decoded.
+  ///
+  /// The flags are only filled in by serializers whose flag encoding doesn't
+  /// depend on the frame type.  Use the header of the deserialized frame when
+  /// the flags are needed.
+  virtual folly::Optional<FrameHeader> peekFrameHeader(const folly::IOBuf& in);
+
+  /// Returns a view of the metadata of a REQUEST_STREAM, REQUEST_CHANNEL,
+  /// REQUEST_RESPONSE or REQUEST_FNF frame without deserializing the frame.
+  /// Returns folly::none for other frames and frames which can't be decoded.
+  virtual folly::Optional<MetadataView> peekRequestMetadata(
+      const folly::IOBuf& in) = 0;
+
+  /// Decodes the header and the request N (0 for frames without one) of a
+  /// REQUEST_STREAM, REQUEST_CHANNEL, REQUEST_RESPONSE or REQUEST_FNF frame,
+  /// and locates its payload for a LazyPayload, without cloning it out of the
+  /// frame.  Returns folly::none for other frames and frames which can't be
+  /// decoded.
+  ///
+  /// The default returns folly::none for all frames, the callers then
+  /// deserialize them.
+  virtual folly::Optional<LazyPayload::Layout> peekRequestPayload(
+      const folly::IOBuf& in,
+      FrameHeader& header,
+      uint32_t& requestN);
+
   virtual std::unique_ptr<folly::IOBuf> serializeOut(
       Frame_REQUEST_STREAM&&) = 0;
   virtual std::unique_ptr<folly::IOBuf> serializeOut(
@@ -46,6 +76,35 @@ class FrameSerializer {
   virtual std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME&&) = 0;
   virtual std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME_OK&&) = 0;
 
+  /// Copies a frame serialized by this serializer, with its stream id
+  /// replaced.  Frames which only differ by their stream id, such as an ERROR
+  /// rejecting requests, can be serialized once and copied from then on.
+  virtual std::unique_ptr<folly::IOBuf> copyWithStreamId(
+      const folly::IOBuf& frame,
+      StreamId streamId) = 0;
+
+  /// Replaces the stream id of a frame serialized by this serializer, e.g.
+  /// to forward it to another connection, without copying the rest of the
+  /// frame.
+  ///
+  /// The default copies the frame with copyWithStreamId().
+  virtual std::unique_ptr<folly::IOBuf> withStreamId(
+      std::unique_ptr<folly::IOBuf> frame,
+      StreamId streamId);
+
+  /// Clones a frame serialized by this serializer with its stream id, and
+  /// optionally its flags, replaced.  Only the header is copied, the clone
+  /// shares the rest of the frame with the original, so that e.g. a PAYLOAD
+  /// can be fanned out to many streams.  The flags can't add or remove the
+  /// METADATA flag.
+  ///
+  /// The default copies the frame with copyWithStreamId(), and throws
+  /// std::invalid_argument when asked to replace the flags.
+  virtual std::unique_ptr<folly::IOBuf> cloneWithStreamId(
+      const folly::IOBuf& frame,
+      StreamId streamId,
+      folly::Optional<FrameFlags> flags = folly::none);
+
   virtual bool deserializeFrom(
       Frame_REQUEST_STREAM&,
       std::unique_ptr<folly::IOBuf>) = 0;
@@ -198,13 +198,7 @@ static void serializeMetadataInto(
   appender.insert(std::move(metadata));
 }
 
-std::unique_ptr<folly::IOBuf> FrameSerializerV0::deserializeMetadataFrom(
-    folly::io::Cursor& cur,
-    FrameFlags flags) {
-  if (!(flags & FrameFlags::METADATA)) {
-    return nullptr;
-  }
-
+static uint32_t deserializeMetadataLengthFrom(folly::io::Cursor& cur) {
   const auto length = cur.readBE<uint32_t>();
 
   if (length >= kMaxMetadataLength) {
@@ -215,8 +209,18 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV0::deserializeMetadataFrom(
     throw std::runtime_error("Metadata is too small to encode its size");
   }
 
-  const auto metadataPayloadLength =
-      length - static_cast<uint32_t>(sizeof(uint32_t));
+  // the length includes the length field itself
+  return length - static_cast<uint32_t>(sizeof(uint32_t));
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializerV0::deserializeMetadataFrom(
+    folly::io::Cursor& cur,
+    FrameFlags flags) {
+  if (!(flags & FrameFlags::METADATA)) {
+    return nullptr;
+  }
+
+  const auto metadataPayloadLength = deserializeMetadataLengthFrom(cur);
 
   // TODO: Check if metadataPayloadLength exceeds frame length minus frame
   // header size.
@@ -323,6 +327,38 @@ folly::Optional<StreamId> FrameSerializerV0::peekStreamId(
   }
 }
 
+folly::Optional<MetadataView> FrameSerializerV0::peekRequestMetadata(
+    const folly::IOBuf& in) {
+  folly::io::Cursor cur(&in);
+  try {
+    FrameHeader header;
+    FrameFlags_V0 flags;
+    deserializeHeaderFrom(cur, header, flags);
+    switch (header.type) {
+      case FrameType::REQUEST_STREAM:
+      case FrameType::REQUEST_CHANNEL:
+        cur.skip(sizeof(uint32_t)); // requestN
+        break;
+      case FrameType::REQUEST_RESPONSE:
+      case FrameType::REQUEST_FNF:
+        break;
+      default:
+        return folly::none;
+    }
+
+    if (!(header.flags & FrameFlags::METADATA)) {
+      return MetadataView();
+    }
+    auto const length = deserializeMetadataLengthFrom(cur);
+    if (!cur.canAdvance(length)) {
+      return folly::none;
+    }
+    return MetadataView(cur, length);
+  } catch (...) {
+    return folly::none;
+  }
+}
+
 std::unique_ptr<folly::IOBuf> FrameSerializerV0::serializeOut(
     Frame_REQUEST_STREAM&& frame) {
   return serializeOutInternal(std::move(frame));
@@ -521,6 +557,19 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV0::serializeOut(
   return queue.move();
 }
 
+std::unique_ptr<folly::IOBuf> FrameSerializerV0::copyWithStreamId(
+    const folly::IOBuf& frame,
+    StreamId streamId) {
+  auto const length = frame.computeChainDataLength();
+  auto copy = folly::IOBuf::createCombined(length);
+  folly::io::Cursor(&frame).pull(copy->writableData(), length);
+  copy->append(length);
+  folly::io::RWPrivateCursor cur(copy.get());
+  cur.skip(sizeof(uint16_t) + sizeof(uint16_t)); // type and flags
+  cur.writeBE<uint32_t>(streamId);
+  return copy;
+}
+
 bool FrameSerializerV0::deserializeFrom(
     Frame_REQUEST_STREAM& frame,
     std::unique_ptr<folly::IOBuf> in) {
@@ -15,6 +15,8 @@ class FrameSerializerV0 : public FrameSerializer {
 
   FrameType peekFrameType(const folly::IOBuf& in) override;
   folly::Optional<StreamId> peekStreamId(const folly::IOBuf& in) override;
+  folly::Optional<MetadataView> peekRequestMetadata(
+      const folly::IOBuf& in) override;
 
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_REQUEST_STREAM&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_REQUEST_CHANNEL&&) override;
@@ -30,6 +32,9 @@ class FrameSerializerV0 : public FrameSerializer {
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_LEASE&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME_OK&&) override;
+  std::unique_ptr<folly::IOBuf> copyWithStreamId(
+      const folly::IOBuf& frame,
+      StreamId streamId) override;
 
   bool deserializeFrom(Frame_REQUEST_STREAM&, std::unique_ptr<folly::IOBuf>)
       override;
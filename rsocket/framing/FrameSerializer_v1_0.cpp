@@ -9,10 +9,78 @@ namespace rsocket {
 constexpr const ProtocolVersion FrameSerializerV1_0::Version;
 constexpr const size_t FrameSerializerV1_0::kFrameHeaderSize;
 constexpr const size_t FrameSerializerV1_0::kMinBytesNeededForAutodetection;
+constexpr const size_t FrameSerializerV1_0::kFrameLengthFieldLength;
+constexpr const size_t FrameSerializerV1_0::kPayloadHeadroom;
+constexpr const size_t FrameSerializerV1_0::kStreamIdOffset;
+constexpr const size_t FrameSerializerV1_0::kTypeAndFlagsOffset;
 
 namespace {
 constexpr const auto kMedatadaLengthSize = 3; // bytes
 constexpr const auto kMaxMetadataLength = 0xFFFFFF; // 24bit max value
+
+using DeserializeError = FrameSerializerV1_0::DeserializeError;
+/// The outcome of reading some fields of a frame.
+using Status = folly::Expected<folly::Unit, DeserializeError>;
+
+Status truncated() {
+  return folly::makeUnexpected(DeserializeError::TRUNCATED);
+}
+
+Status invalid() {
+  return folly::makeUnexpected(DeserializeError::INVALID);
+}
+
+template <typename T>
+Status readBE(folly::io::Cursor& cur, T& value) {
+  return cur.tryReadBE(value) ? Status(folly::unit) : truncated();
+}
+
+/// Reads a signed field which must not be negative, or must be positive.
+template <typename T, typename U>
+Status readPositiveBE(folly::io::Cursor& cur, U& value, bool allowZero) {
+  T read;
+  if (!cur.tryReadBE(read)) {
+    return truncated();
+  }
+  if (read < 0 || (read == 0 && !allowZero)) {
+    return invalid();
+  }
+  value = static_cast<U>(read);
+  return folly::unit;
+}
+
+Status cloneFrom(
+    folly::io::Cursor& cur,
+    size_t length,
+    std::unique_ptr<folly::IOBuf>& buf) {
+  if (!cur.canAdvance(length)) {
+    return truncated();
+  }
+  cur.clone(buf, length);
+  return folly::unit;
+}
+
+Status readStringFrom(folly::io::Cursor& cur, size_t length, std::string& str) {
+  if (!cur.canAdvance(length)) {
+    return truncated();
+  }
+  str = cur.readFixedString(length);
+  return folly::unit;
+}
+
+Status readTokenFrom(folly::io::Cursor& cur, ResumeIdentificationToken& token) {
+  uint16_t size;
+  if (!cur.tryReadBE(size)) {
+    return truncated();
+  }
+  if (!cur.canAdvance(size)) {
+    return truncated();
+  }
+  std::vector<uint8_t> data(size);
+  cur.pull(data.data(), data.size());
+  token.set(std::move(data));
+  return folly::unit;
+}
 } // namespace
 
 ProtocolVersion FrameSerializerV1_0::protocolVersion() {
@@ -20,23 +88,29 @@ ProtocolVersion FrameSerializerV1_0::protocolVersion() {
 }
 
 static folly::IOBufQueue createBufferQueue(size_t bufferSize) {
-  auto buf = folly::IOBuf::createCombined(bufferSize);
+  // Leave room for the frame length field in front of the header, so that
+  // FramedWriter can prepend it in place instead of allocating a new buffer.
+  auto buf = folly::IOBuf::createCombined(
+      FrameSerializerV1_0::kFrameLengthFieldLength + bufferSize);
+  buf->advance(FrameSerializerV1_0::kFrameLengthFieldLength);
   folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
   queue.append(std::move(buf));
   return queue;
 }
 
-static FrameType deserializeFrameType(uint16_t frameType) {
-  if (frameType > static_cast<uint8_t>(FrameType::RESUME_OK) &&
-      frameType != static_cast<uint8_t>(FrameType::EXT)) {
-    return FrameType::RESERVED;
-  }
-  return static_cast<FrameType>(frameType);
+/// A single buffer of `size` bytes to write a frame into, with the same room
+/// for the frame length field as createBufferQueue().  For the small frames
+/// of a fixed size, which don't need an IOBufQueue.
+static std::unique_ptr<folly::IOBuf> createFrameBuffer(size_t size) {
+  auto buf = folly::IOBuf::createCombined(
+      FrameSerializerV1_0::kFrameLengthFieldLength + size);
+  buf->advance(FrameSerializerV1_0::kFrameLengthFieldLength);
+  buf->append(size);
+  return buf;
 }
 
-static void serializeHeaderInto(
-    folly::io::QueueAppender& appender,
-    const FrameHeader& header) {
+template <typename TWriter>
+static void serializeHeaderInto(TWriter& appender, const FrameHeader& header) {
   appender.writeBE<int32_t>(static_cast<int32_t>(header.streamId));
 
   auto type = static_cast<uint8_t>(header.type); // 6 bit
@@ -45,61 +119,85 @@ static void serializeHeaderInto(
   appender.write(static_cast<uint8_t>(flags)); // lower 8 bits
 }
 
-static void deserializeHeaderFrom(folly::io::Cursor& cur, FrameHeader& header) {
-  auto streamId = cur.readBE<int32_t>();
+static Status deserializeHeaderFrom(
+    folly::io::Cursor& cur,
+    FrameHeader& header) {
+  int32_t streamId;
+  uint8_t type; // |Frame Type |I|M|
+  uint8_t flags;
+  if (!cur.tryReadBE(streamId) || !cur.tryReadBE(type) ||
+      !cur.tryReadBE(flags)) {
+    return truncated();
+  }
   if (streamId < 0) {
-    throw std::runtime_error("invalid stream id");
+    return invalid();
   }
   header.streamId = static_cast<StreamId>(streamId);
-  uint16_t type = cur.readBE<uint8_t>(); // |Frame Type |I|M|
-  header.type = deserializeFrameType(type >> 2);
-  header.flags =
-      static_cast<FrameFlags>(((type & 0x3) << 8) | cur.readBE<uint8_t>());
+  header.type = FrameSerializerV1_0::decodeFrameType(type >> 2);
+  header.flags = static_cast<FrameFlags>(((type & 0x3) << 8) | flags);
+  return folly::unit;
 }
 
-static void serializeMetadataInto(
-    folly::io::QueueAppender& appender,
-    std::unique_ptr<folly::IOBuf> metadata) {
-  if (metadata == nullptr) {
-    return;
-  }
-
-  // Use signed int because the first bit in metadata length is reserved.
-  if (metadata->length() > kMaxMetadataLength) {
+template <typename TWriter>
+static void serializeMetadataLengthInto(TWriter& appender, size_t length) {
+  if (length > kMaxMetadataLength) {
     CHECK(false) << "Metadata is too big to serialize";
   }
 
   // metadata length field not included in the medatadata length
-  uint32_t metadataLength = static_cast<uint32_t>(metadata->length());
+  uint32_t metadataLength = static_cast<uint32_t>(length);
   appender.write(static_cast<uint8_t>(metadataLength >> 16)); // first byte
   appender.write(
       static_cast<uint8_t>((metadataLength >> 8) & 0xFF)); // second byte
   appender.write(static_cast<uint8_t>(metadataLength & 0xFF)); // third byte
+}
 
+static void serializeMetadataInto(
+    folly::io::QueueAppender& appender,
+    std::unique_ptr<folly::IOBuf> metadata) {
+  if (metadata == nullptr) {
+    return;
+  }
+
+  serializeMetadataLengthInto(appender, metadata->computeChainDataLength());
   appender.insert(std::move(metadata));
 }
 
-std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::deserializeMetadataFrom(
+static Status deserializeMetadataLengthFrom(
+    folly::io::Cursor& cur,
+    uint32_t& metadataLength) {
+  // 24 bits, which can't exceed kMaxMetadataLength.
+  uint8_t bytes[kMedatadaLengthSize];
+  if (!cur.canAdvance(sizeof(bytes))) {
+    return truncated();
+  }
+  cur.pull(bytes, sizeof(bytes));
+  metadataLength = (static_cast<uint32_t>(bytes[0]) << 16) |
+      (static_cast<uint32_t>(bytes[1]) << 8) | bytes[2];
+  return folly::unit;
+}
+
+folly::Expected<std::unique_ptr<folly::IOBuf>, DeserializeError>
+FrameSerializerV1_0::deserializeMetadataFrom(
     folly::io::Cursor& cur,
     FrameFlags flags) {
+  std::unique_ptr<folly::IOBuf> metadata;
   if (!(flags & FrameFlags::METADATA)) {
-    return nullptr;
+    return std::move(metadata);
   }
 
-  uint32_t metadataLength = 0;
-  metadataLength |= static_cast<uint32_t>(cur.read<uint8_t>() << 16);
-  metadataLength |= static_cast<uint32_t>(cur.read<uint8_t>() << 8);
-  metadataLength |= cur.read<uint8_t>();
-
-  if (metadataLength > kMaxMetadataLength) {
-    throw std::runtime_error("Metadata is too big to deserialize");
+  uint32_t metadataLength;
+  auto status = deserializeMetadataLengthFrom(cur, metadataLength);
+  if (status) {
+    status = cloneFrom(cur, metadataLength, metadata);
   }
-
-  std::unique_ptr<folly::IOBuf> metadata;
-  cur.clone(metadata, metadataLength);
-  return metadata;
+  if (!status) {
+    return folly::makeUnexpected(status.error());
+  }
+  return std::move(metadata);
 }
 
+/// The rest of the frame, nullptr if there is none.
 static std::unique_ptr<folly::IOBuf> deserializeDataFrom(
     folly::io::Cursor& cur) {
   std::unique_ptr<folly::IOBuf> data;
@@ -111,12 +209,16 @@ static std::unique_ptr<folly::IOBuf> deserializeDataFrom(
   return data;
 }
 
-static Payload deserializePayloadFrom(
+static Status deserializePayloadFrom(
     folly::io::Cursor& cur,
-    FrameFlags flags) {
+    FrameFlags flags,
+    Payload& payload) {
   auto metadata = FrameSerializerV1_0::deserializeMetadataFrom(cur, flags);
-  auto data = deserializeDataFrom(cur);
-  return Payload(std::move(data), std::move(metadata));
+  if (!metadata) {
+    return folly::makeUnexpected(metadata.error());
+  }
+  payload = Payload(deserializeDataFrom(cur), std::move(metadata.value()));
+  return folly::unit;
 }
 
 static void serializePayloadInto(
@@ -132,8 +234,61 @@ static uint32_t payloadFramingSize(const Payload& payload) {
   return (payload.metadata != nullptr ? kMedatadaLengthSize : 0);
 }
 
+/// Serializes a frame without copying or allocating, by writing the fixed
+/// part of the frame (produced by writePrefix) and the metadata length into
+/// the headroom of the first payload buffer and chaining the rest of the
+/// payload behind it.  Room for the frame length field is kept in front, so
+/// FramedWriter doesn't need to allocate either.
+///
+/// Returns nullptr and leaves the payload untouched when the first payload
+/// buffer is shared or doesn't have enough headroom.
+template <typename TWritePrefix>
+static std::unique_ptr<folly::IOBuf> serializeIntoHeadroom(
+    size_t prefixSize,
+    Payload& payload,
+    TWritePrefix&& writePrefix) {
+  auto& first = payload.metadata ? payload.metadata : payload.data;
+  if (!first || first->isSharedOne()) {
+    return nullptr;
+  }
+
+  const auto framingSize = prefixSize + payloadFramingSize(payload);
+  if (first->headroom() <
+      framingSize + FrameSerializerV1_0::kFrameLengthFieldLength) {
+    return nullptr;
+  }
+
+  const bool hasMetadata = payload.metadata != nullptr;
+  const auto metadataLength =
+      hasMetadata ? payload.metadata->computeChainDataLength() : 0;
+
+  auto frame = std::move(first);
+  frame->prepend(framingSize);
+
+  folly::io::RWPrivateCursor cur(frame.get());
+  writePrefix(cur);
+  if (hasMetadata) {
+    serializeMetadataLengthInto(cur, metadataLength);
+    if (payload.data) {
+      frame->prependChain(std::move(payload.data));
+    }
+  }
+  return frame;
+}
+
 static std::unique_ptr<folly::IOBuf> serializeOutInternal(
     Frame_REQUEST_Base&& frame) {
+  auto inPlace = serializeIntoHeadroom(
+      FrameSerializerV1_0::kFrameHeaderSize + sizeof(uint32_t),
+      frame.payload_,
+      [&frame](folly::io::RWPrivateCursor& cur) {
+        serializeHeaderInto(cur, frame.header_);
+        cur.writeBE<int32_t>(static_cast<int32_t>(frame.requestN_));
+      });
+  if (inPlace) {
+    return inPlace;
+  }
+
   auto queue = createBufferQueue(
       FrameSerializerV1_0::kFrameHeaderSize + sizeof(uint32_t) +
       payloadFramingSize(frame.payload_));
@@ -150,20 +305,10 @@ static bool deserializeFromInternal(
     Frame_REQUEST_Base& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-
-    auto requestN = cur.readBE<int32_t>();
-    // TODO(lehecka): requestN <= 0
-    if (requestN < 0) {
-      throw std::runtime_error("invalid request N");
-    }
-    frame.requestN_ = static_cast<uint32_t>(requestN);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  // TODO(lehecka): requestN <= 0
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      readPositiveBE<int32_t>(cur, frame.requestN_, true /* allowZero */) &&
+      deserializePayloadFrom(cur, frame.header_.flags, frame.payload_);
 }
 
 static size_t getResumeIdTokenFramingLength(
@@ -176,27 +321,104 @@ static size_t getResumeIdTokenFramingLength(
 
 FrameType FrameSerializerV1_0::peekFrameType(const folly::IOBuf& in) {
   folly::io::Cursor cur(&in);
-  try {
-    cur.skip(sizeof(int32_t)); // streamId
-    uint8_t type = cur.readBE<uint8_t>(); // |Frame Type |I|M|
-    return deserializeFrameType(type >> 2);
-  } catch (...) {
+  uint8_t type; // |Frame Type |I|M|
+  if (cur.skipAtMost(sizeof(int32_t)) != sizeof(int32_t) || // streamId
+      !cur.tryReadBE(type)) {
     return FrameType::RESERVED;
   }
+  return FrameSerializerV1_0::decodeFrameType(type >> 2);
 }
 
 folly::Optional<StreamId> FrameSerializerV1_0::peekStreamId(
     const folly::IOBuf& in) {
   folly::io::Cursor cur(&in);
-  try {
-    auto streamId = cur.readBE<int32_t>();
-    if (streamId < 0) {
+  int32_t streamId;
+  if (!cur.tryReadBE(streamId) || streamId < 0) {
+    return folly::none;
+  }
+  return folly::make_optional(static_cast<StreamId>(streamId));
+}
+
+folly::Optional<FrameHeader> FrameSerializerV1_0::peekSplitFrameHeader(
+    const folly::IOBuf& in) {
+  folly::io::Cursor cur(&in);
+  FrameHeader header;
+  if (!deserializeHeaderFrom(cur, header)) {
+    return folly::none;
+  }
+  return header;
+}
+
+folly::Optional<MetadataView> FrameSerializerV1_0::peekRequestMetadata(
+    const folly::IOBuf& in) {
+  folly::io::Cursor cur(&in);
+  FrameHeader header;
+  if (!deserializeHeaderFrom(cur, header)) {
+    return folly::none;
+  }
+  switch (header.type) {
+    case FrameType::REQUEST_STREAM:
+    case FrameType::REQUEST_CHANNEL:
+      // requestN
+      if (cur.skipAtMost(sizeof(int32_t)) != sizeof(int32_t)) {
+        return folly::none;
+      }
+      break;
+    case FrameType::REQUEST_RESPONSE:
+    case FrameType::REQUEST_FNF:
+      break;
+    default:
       return folly::none;
-    }
-    return folly::make_optional(static_cast<StreamId>(streamId));
-  } catch (...) {
+  }
+
+  if (!(header.flags & FrameFlags::METADATA)) {
+    return MetadataView();
+  }
+  uint32_t length;
+  if (!deserializeMetadataLengthFrom(cur, length) || !cur.canAdvance(length)) {
+    return folly::none;
+  }
+  return MetadataView(cur, length);
+}
+
+folly::Optional<LazyPayload::Layout> FrameSerializerV1_0::peekRequestPayload(
+    const folly::IOBuf& in,
+    FrameHeader& header,
+    uint32_t& requestN) {
+  folly::io::Cursor cur(&in);
+  if (!deserializeHeaderFrom(cur, header)) {
     return folly::none;
   }
+  requestN = 0;
+  switch (header.type) {
+    case FrameType::REQUEST_STREAM:
+    case FrameType::REQUEST_CHANNEL:
+      if (!readPositiveBE<int32_t>(cur, requestN, true /* allowZero */)) {
+        return folly::none;
+      }
+      break;
+    case FrameType::REQUEST_RESPONSE:
+    case FrameType::REQUEST_FNF:
+      break;
+    default:
+      return folly::none;
+  }
+
+  // The cursor only knows what is left of the frame.
+  auto const frameLength = in.computeChainDataLength();
+  LazyPayload::Layout layout;
+  if (!!(header.flags & FrameFlags::METADATA)) {
+    uint32_t length;
+    if (!deserializeMetadataLengthFrom(cur, length) ||
+        !cur.canAdvance(length)) {
+      return folly::none;
+    }
+    layout.metadataOffset = frameLength - cur.totalLength();
+    layout.metadataLength = length;
+    cur.skip(length);
+  }
+  layout.dataOffset = frameLength - cur.totalLength();
+  return layout;
 }
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
@@ -211,6 +433,16 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_RESPONSE&& frame) {
+  auto inPlace = serializeIntoHeadroom(
+      kFrameHeaderSize,
+      frame.payload_,
+      [&frame](folly::io::RWPrivateCursor& cur) {
+        serializeHeaderInto(cur, frame.header_);
+      });
+  if (inPlace) {
+    return inPlace;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -221,6 +453,16 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_FNF&& frame) {
+  auto inPlace = serializeIntoHeadroom(
+      kFrameHeaderSize,
+      frame.payload_,
+      [&frame](folly::io::RWPrivateCursor& cur) {
+        serializeHeaderInto(cur, frame.header_);
+      });
+  if (inPlace) {
+    return inPlace;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -231,11 +473,11 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_N&& frame) {
-  auto queue = createBufferQueue(kFrameHeaderSize + sizeof(uint32_t));
-  folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
-  serializeHeaderInto(appender, frame.header_);
-  appender.writeBE<int32_t>(static_cast<int32_t>(frame.requestN_));
-  return queue.move();
+  auto buf = createFrameBuffer(kFrameHeaderSize + sizeof(uint32_t));
+  folly::io::RWPrivateCursor cur(buf.get());
+  serializeHeaderInto(cur, frame.header_);
+  cur.writeBE<int32_t>(static_cast<int32_t>(frame.requestN_));
+  return buf;
 }
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
@@ -251,14 +493,24 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_CANCEL&& frame) {
-  auto queue = createBufferQueue(kFrameHeaderSize);
-  folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
-  serializeHeaderInto(appender, frame.header_);
-  return queue.move();
+  auto buf = createFrameBuffer(kFrameHeaderSize);
+  folly::io::RWPrivateCursor cur(buf.get());
+  serializeHeaderInto(cur, frame.header_);
+  return buf;
 }
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_PAYLOAD&& frame) {
+  auto inPlace = serializeIntoHeadroom(
+      kFrameHeaderSize,
+      frame.payload_,
+      [&frame](folly::io::RWPrivateCursor& cur) {
+        serializeHeaderInto(cur, frame.header_);
+      });
+  if (inPlace) {
+    return inPlace;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -269,6 +521,17 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_ERROR&& frame) {
+  auto inPlace = serializeIntoHeadroom(
+      kFrameHeaderSize + sizeof(uint32_t),
+      frame.payload_,
+      [&frame](folly::io::RWPrivateCursor& cur) {
+        serializeHeaderInto(cur, frame.header_);
+        cur.writeBE(static_cast<uint32_t>(frame.errorCode_));
+      });
+  if (inPlace) {
+    return inPlace;
+  }
+
   auto queue = createBufferQueue(
       kFrameHeaderSize + sizeof(uint32_t) + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -281,14 +544,14 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_KEEPALIVE&& frame,
     bool /*resumeable*/) {
-  auto queue = createBufferQueue(kFrameHeaderSize + sizeof(int64_t));
-  folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
-  serializeHeaderInto(appender, frame.header_);
-  appender.writeBE<int64_t>(static_cast<int64_t>(frame.position_));
+  auto buf = createFrameBuffer(kFrameHeaderSize + sizeof(int64_t));
+  folly::io::RWPrivateCursor cur(buf.get());
+  serializeHeaderInto(cur, frame.header_);
+  cur.writeBE<int64_t>(static_cast<int64_t>(frame.position_));
   if (frame.data_) {
-    appender.insert(std::move(frame.data_));
+    buf->prependChain(std::move(frame.data_));
   }
-  return queue.move();
+  return buf;
 }
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
@@ -379,6 +642,70 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
   return queue.move();
 }
 
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::copyWithStreamId(
+    const folly::IOBuf& frame,
+    StreamId streamId) {
+  auto copy = createFrameBuffer(frame.computeChainDataLength());
+  folly::io::Cursor(&frame).pull(copy->writableData(), copy->length());
+  folly::io::RWPrivateCursor cur(copy.get());
+  cur.skip(kStreamIdOffset);
+  cur.writeBE<int32_t>(static_cast<int32_t>(streamId));
+  return copy;
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::withStreamId(
+    std::unique_ptr<folly::IOBuf> frame,
+    StreamId streamId) {
+  constexpr auto kStreamIdEnd = kStreamIdOffset + sizeof(int32_t);
+  if (frame->length() < kStreamIdEnd) {
+    return copyWithStreamId(*frame, streamId);
+  }
+  if (!frame->isSharedOne()) {
+    folly::io::RWPrivateCursor cur(frame.get());
+    cur.skip(kStreamIdOffset);
+    cur.writeBE<int32_t>(static_cast<int32_t>(streamId));
+    return frame;
+  }
+  auto header = createFrameBuffer(kStreamIdEnd);
+  folly::io::RWPrivateCursor cur(header.get());
+  cur.push(frame->data(), kStreamIdOffset);
+  cur.writeBE<int32_t>(static_cast<int32_t>(streamId));
+  frame->trimStart(kStreamIdEnd);
+  header->prependChain(std::move(frame));
+  return header;
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::cloneWithStreamId(
+    const folly::IOBuf& frame,
+    StreamId streamId,
+    folly::Optional<FrameFlags> flags) {
+  CHECK_GE(frame.computeChainDataLength(), kFrameHeaderSize)
+      << "Not a frame";
+  folly::io::Cursor in(&frame);
+  in.skip(kTypeAndFlagsOffset);
+  // |Frame Type|I|M|Flags|, the flags are the lower 10 bits.
+  auto typeAndFlags = in.readBE<uint16_t>();
+  if (flags) {
+    auto const newFlags = static_cast<uint16_t>(*flags) & 0x3ff;
+    CHECK_EQ(
+        typeAndFlags & static_cast<uint16_t>(FrameFlags::METADATA),
+        newFlags & static_cast<uint16_t>(FrameFlags::METADATA))
+        << "Can't add or remove the metadata of a frame";
+    typeAndFlags = (typeAndFlags & ~0x3ff) | newFlags;
+  }
+
+  auto header = createFrameBuffer(kFrameHeaderSize);
+  folly::io::RWPrivateCursor out(header.get());
+  out.writeBE<int32_t>(static_cast<int32_t>(streamId));
+  out.writeBE<uint16_t>(typeAndFlags);
+  if (auto const rest = in.totalLength()) {
+    std::unique_ptr<folly::IOBuf> body;
+    in.clone(body, rest);
+    header->prependChain(std::move(body));
+  }
+  return header;
+}
+
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_STREAM& frame,
     std::unique_ptr<folly::IOBuf> in) {
@@ -395,57 +722,36 @@ bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_RESPONSE& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      deserializePayloadFrom(cur, frame.header_.flags, frame.payload_);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_FNF& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      deserializePayloadFrom(cur, frame.header_.flags, frame.payload_);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_N& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    auto requestN = cur.readBE<int32_t>();
-    if (requestN <= 0) {
-      throw std::runtime_error("invalid request n");
-    }
-    frame.requestN_ = static_cast<uint32_t>(requestN);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      readPositiveBE<int32_t>(cur, frame.requestN_, false /* allowZero */);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_METADATA_PUSH& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    // metadata takes the rest of the frame, just like data in other frames
-    // that's why we use deserializeDataFrom
-    frame.metadata_ = deserializeDataFrom(cur);
-  } catch (...) {
+  if (!deserializeHeaderFrom(cur, frame.header_)) {
     return false;
   }
+  // metadata takes the rest of the frame, just like data in other frames
+  // that's why we use deserializeDataFrom
+  frame.metadata_ = deserializeDataFrom(cur);
   return frame.metadata_ != nullptr;
 }
 
@@ -453,39 +759,29 @@ bool FrameSerializerV1_0::deserializeFrom(
     Frame_CANCEL& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_).hasValue();
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_PAYLOAD& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      deserializePayloadFrom(cur, frame.header_.flags, frame.payload_);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_ERROR& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.errorCode_ = static_cast<ErrorCode>(cur.readBE<uint32_t>());
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
+  uint32_t errorCode;
+  if (!deserializeHeaderFrom(cur, frame.header_) ||
+      !readBE(cur, errorCode)) {
     return false;
   }
-  return true;
+  frame.errorCode_ = static_cast<ErrorCode>(errorCode);
+  return deserializePayloadFrom(cur, frame.header_.flags, frame.payload_)
+      .hasValue();
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
@@ -493,17 +789,11 @@ bool FrameSerializerV1_0::deserializeFrom(
     std::unique_ptr<folly::IOBuf> in,
     bool /*resumable*/) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    auto position = cur.readBE<int64_t>();
-    if (position < 0) {
-      throw std::runtime_error("invalid value for position");
-    }
-    frame.position_ = static_cast<ResumePosition>(position);
-    frame.data_ = deserializeDataFrom(cur);
-  } catch (...) {
+  if (!deserializeHeaderFrom(cur, frame.header_) ||
+      !readPositiveBE<int64_t>(cur, frame.position_, true /* allowZero */)) {
     return false;
   }
+  frame.data_ = deserializeDataFrom(cur);
   return true;
 }
 
@@ -511,67 +801,40 @@ bool FrameSerializerV1_0::deserializeFrom(
     Frame_SETUP& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-
-    frame.versionMajor_ = cur.readBE<uint16_t>();
-    frame.versionMinor_ = cur.readBE<uint16_t>();
-
-    auto keepaliveTime = cur.readBE<int32_t>();
-    if (keepaliveTime <= 0) {
-      throw std::runtime_error("invalid keepalive time");
-    }
-    frame.keepaliveTime_ = static_cast<uint32_t>(keepaliveTime);
+  if (!deserializeHeaderFrom(cur, frame.header_) ||
+      !readBE(cur, frame.versionMajor_) || !readBE(cur, frame.versionMinor_) ||
+      !readPositiveBE<int32_t>(cur, frame.keepaliveTime_, false) ||
+      !readPositiveBE<int32_t>(cur, frame.maxLifetime_, false)) {
+    return false;
+  }
 
-    auto maxLifetime = cur.readBE<int32_t>();
-    if (maxLifetime <= 0) {
-      throw std::runtime_error("invalid maxLife time");
-    }
-    frame.maxLifetime_ = static_cast<uint32_t>(maxLifetime);
-
-    if (!!(frame.header_.flags & FrameFlags::RESUME_ENABLE)) {
-      auto resumeTokenSize = cur.readBE<uint16_t>();
-      std::vector<uint8_t> data(resumeTokenSize);
-      cur.pull(data.data(), data.size());
-      frame.token_.set(std::move(data));
-    } else {
-      frame.token_ = ResumeIdentificationToken();
+  if (!!(frame.header_.flags & FrameFlags::RESUME_ENABLE)) {
+    if (!readTokenFrom(cur, frame.token_)) {
+      return false;
     }
-
-    auto mdmtLen = cur.readBE<uint8_t>();
-    frame.metadataMimeType_ = cur.readFixedString(mdmtLen);
-
-    auto dmtLen = cur.readBE<uint8_t>();
-    frame.dataMimeType_ = cur.readFixedString(dmtLen);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
+  } else {
+    frame.token_ = ResumeIdentificationToken();
   }
-  return true;
+
+  uint8_t mdmtLen;
+  uint8_t dmtLen;
+  return readBE(cur, mdmtLen) &&
+      readStringFrom(cur, mdmtLen, frame.metadataMimeType_) &&
+      readBE(cur, dmtLen) &&
+      readStringFrom(cur, dmtLen, frame.dataMimeType_) &&
+      deserializePayloadFrom(cur, frame.header_.flags, frame.payload_);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_LEASE& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-
-    auto ttl = cur.readBE<int32_t>();
-    if (ttl <= 0) {
-      throw std::runtime_error("invalid ttl value");
-    }
-    frame.ttl_ = static_cast<uint32_t>(ttl);
-
-    auto numberOfRequests = cur.readBE<int32_t>();
-    if (numberOfRequests <= 0) {
-      throw std::runtime_error("invalid numberOfRequests value");
-    }
-    frame.numberOfRequests_ = static_cast<uint32_t>(numberOfRequests);
-    frame.metadata_ = deserializeDataFrom(cur);
-  } catch (...) {
+  if (!deserializeHeaderFrom(cur, frame.header_) ||
+      !readPositiveBE<int32_t>(cur, frame.ttl_, false /* allowZero */) ||
+      !readPositiveBE<int32_t>(cur, frame.numberOfRequests_, false)) {
     return false;
   }
+  frame.metadata_ = deserializeDataFrom(cur);
   return true;
 }
 
@@ -579,50 +842,20 @@ bool FrameSerializerV1_0::deserializeFrom(
     Frame_RESUME& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.versionMajor_ = cur.readBE<uint16_t>();
-    frame.versionMinor_ = cur.readBE<uint16_t>();
-
-    auto resumeTokenSize = cur.readBE<uint16_t>();
-    std::vector<uint8_t> data(resumeTokenSize);
-    cur.pull(data.data(), data.size());
-    frame.token_.set(std::move(data));
-
-    auto lastReceivedServerPosition = cur.readBE<int64_t>();
-    if (lastReceivedServerPosition < 0) {
-      throw std::runtime_error("invalid value for lastReceivedServerPosition");
-    }
-    frame.lastReceivedServerPosition_ =
-        static_cast<ResumePosition>(lastReceivedServerPosition);
-
-    auto clientPosition = cur.readBE<int64_t>();
-    if (clientPosition < 0) {
-      throw std::runtime_error("invalid value for clientPosition");
-    }
-    frame.clientPosition_ = static_cast<ResumePosition>(clientPosition);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      readBE(cur, frame.versionMajor_) && readBE(cur, frame.versionMinor_) &&
+      readTokenFrom(cur, frame.token_) &&
+      readPositiveBE<int64_t>(
+             cur, frame.lastReceivedServerPosition_, true /* allowZero */) &&
+      readPositiveBE<int64_t>(cur, frame.clientPosition_, true);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_RESUME_OK& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-
-    auto position = cur.readBE<int64_t>();
-    if (position < 0) {
-      throw std::runtime_error("invalid value for position");
-    }
-    frame.position_ = static_cast<ResumePosition>(position);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeHeaderFrom(cur, frame.header_) &&
+      readPositiveBE<int64_t>(cur, frame.position_, true /* allowZero */);
 }
 
 ProtocolVersion FrameSerializerV1_0::detectProtocolVersion(
@@ -653,28 +886,29 @@ ProtocolVersion FrameSerializerV1_0::detectProtocolVersion(
   //  +-------------------------------+-------------------------------+
 
   folly::io::Cursor cur(&firstFrame);
-  try {
-    cur.skip(skipBytes);
-
-    auto streamId = cur.readBE<int32_t>();
-    auto frameType = cur.readBE<uint8_t>() >> 2;
-    cur.skip(sizeof(uint8_t)); // flags
-    auto majorVersion = cur.readBE<uint16_t>();
-    auto minorVersion = cur.readBE<uint16_t>();
-
-    constexpr static const auto kSETUP = 0x01;
-    constexpr static const auto kRESUME = 0x0D;
-
-    VLOG(4) << "frameType=" << frameType << "streamId=" << streamId
-            << " majorVersion=" << majorVersion
-            << " minorVersion=" << minorVersion;
-
-    if (streamId == 0 && (frameType == kSETUP || frameType == kRESUME) &&
-        majorVersion == FrameSerializerV1_0::Version.major &&
-        minorVersion == FrameSerializerV1_0::Version.minor) {
-      return FrameSerializerV1_0::Version;
-    }
-  } catch (...) {
+  int32_t streamId;
+  uint8_t typeAndFlags;
+  uint8_t flags;
+  uint16_t majorVersion;
+  uint16_t minorVersion;
+  if (cur.skipAtMost(skipBytes) != skipBytes || !cur.tryReadBE(streamId) ||
+      !cur.tryReadBE(typeAndFlags) || !cur.tryReadBE(flags) ||
+      !cur.tryReadBE(majorVersion) || !cur.tryReadBE(minorVersion)) {
+    return ProtocolVersion::Unknown;
+  }
+  auto const frameType = typeAndFlags >> 2;
+
+  constexpr static const auto kSETUP = 0x01;
+  constexpr static const auto kRESUME = 0x0D;
+
+  VLOG(4) << "frameType=" << frameType << "streamId=" << streamId
+          << " majorVersion=" << majorVersion
+          << " minorVersion=" << minorVersion;
+
+  if (streamId == 0 && (frameType == kSETUP || frameType == kRESUME) &&
+      majorVersion == FrameSerializerV1_0::Version.major &&
+      minorVersion == FrameSerializerV1_0::Version.minor) {
+    return FrameSerializerV1_0::Version;
   }
   return ProtocolVersion::Unknown;
 }
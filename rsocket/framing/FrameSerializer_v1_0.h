@@ -2,15 +2,35 @@
 
 #pragma once
 
+#include <folly/Expected.h>
+
 #include "rsocket/framing/FrameSerializer.h"
 
 namespace rsocket {
 
-class FrameSerializerV1_0 : public FrameSerializer {
+/// Serializer of protocol 1.0.  It is final, so calls made through a reference
+/// to this type rather than to FrameSerializer are direct, and the ones defined
+/// here can be inlined.
+class FrameSerializerV1_0 final : public FrameSerializer {
  public:
   constexpr static const ProtocolVersion Version = ProtocolVersion(1, 0);
   constexpr static const size_t kFrameHeaderSize = 6; // bytes
   constexpr static const size_t kMinBytesNeededForAutodetection = 10; // bytes
+  constexpr static const size_t kFrameLengthFieldLength = 3; // bytes
+
+  /// Layout of the frame header: the stream id, then 6 bits of frame type and
+  /// 10 bits of flags.
+  constexpr static const size_t kStreamIdOffset = 0;
+  constexpr static const size_t kTypeAndFlagsOffset = 4;
+
+  /// Headroom to reserve in front of the first payload buffer (metadata if
+  /// present, data otherwise) so that frames carrying the payload can be
+  /// serialized in place: the frame length, the frame header, any fixed
+  /// frame fields and the metadata length are written into the headroom and
+  /// the payload buffers are chained as they are, without memcpy and without
+  /// allocating.  The buffer must not be shared.
+  constexpr static const size_t kPayloadHeadroom =
+      kFrameLengthFieldLength + kFrameHeaderSize + sizeof(uint32_t) + 3;
 
   ProtocolVersion protocolVersion() override;
 
@@ -20,6 +40,20 @@ class FrameSerializerV1_0 : public FrameSerializer {
 
   FrameType peekFrameType(const folly::IOBuf& in) override;
   folly::Optional<StreamId> peekStreamId(const folly::IOBuf& in) override;
+  folly::Optional<FrameHeader> peekFrameHeader(
+      const folly::IOBuf& in) override {
+    // The header is nearly always in the first buffer of the frame.
+    if (in.length() >= kFrameHeaderSize) {
+      return decodeFrameHeader(in.data());
+    }
+    return peekSplitFrameHeader(in);
+  }
+  folly::Optional<MetadataView> peekRequestMetadata(
+      const folly::IOBuf& in) override;
+  folly::Optional<LazyPayload::Layout> peekRequestPayload(
+      const folly::IOBuf& in,
+      FrameHeader& header,
+      uint32_t& requestN) override;
 
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_REQUEST_STREAM&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_REQUEST_CHANNEL&&) override;
@@ -35,6 +69,19 @@ class FrameSerializerV1_0 : public FrameSerializer {
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_LEASE&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME&&) override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME_OK&&) override;
+  std::unique_ptr<folly::IOBuf> copyWithStreamId(
+      const folly::IOBuf& frame,
+      StreamId streamId) override;
+  /// Rewrites the stream id in the frame if its first buffer isn't shared,
+  /// e.g. with the other frames of a read buffer.  Otherwise the stream id
+  /// goes in a new buffer chained in front of the rest of the frame.
+  std::unique_ptr<folly::IOBuf> withStreamId(
+      std::unique_ptr<folly::IOBuf> frame,
+      StreamId streamId) override;
+  std::unique_ptr<folly::IOBuf> cloneWithStreamId(
+      const folly::IOBuf& frame,
+      StreamId streamId,
+      folly::Optional<FrameFlags> flags = folly::none) override;
 
   bool deserializeFrom(Frame_REQUEST_STREAM&, std::unique_ptr<folly::IOBuf>)
       override;
@@ -59,8 +106,49 @@ class FrameSerializerV1_0 : public FrameSerializer {
   bool deserializeFrom(Frame_RESUME_OK&, std::unique_ptr<folly::IOBuf>)
       override;
 
-  static std::unique_ptr<folly::IOBuf> deserializeMetadataFrom(
-      folly::io::Cursor& cur,
-      FrameFlags flags);
+  /// Why a frame can't be deserialized.  The fields are read with bounds
+  /// checks instead of exceptions, so that malformed frames cost as little as
+  /// well formed ones.
+  enum class DeserializeError : uint8_t {
+    /// The frame ends before the fields it announces.
+    TRUNCATED,
+    /// A field has a value the protocol doesn't allow.
+    INVALID,
+  };
+
+  /// The metadata of a frame with the METADATA flag, nullptr without.
+  static folly::Expected<std::unique_ptr<folly::IOBuf>, DeserializeError>
+  deserializeMetadataFrom(folly::io::Cursor& cur, FrameFlags flags);
+
+  /// Frame types this version doesn't know are RESERVED.
+  static FrameType decodeFrameType(uint8_t type) {
+    if (type > static_cast<uint8_t>(FrameType::RESUME_OK) &&
+        type != static_cast<uint8_t>(FrameType::EXT)) {
+      return FrameType::RESERVED;
+    }
+    return static_cast<FrameType>(type);
+  }
+
+ private:
+  /// Decodes the kFrameHeaderSize bytes at `data`.
+  static folly::Optional<FrameHeader> decodeFrameHeader(const uint8_t* data) {
+    auto const streamId = (uint32_t(data[kStreamIdOffset]) << 24) |
+        (uint32_t(data[kStreamIdOffset + 1]) << 16) |
+        (uint32_t(data[kStreamIdOffset + 2]) << 8) |
+        uint32_t(data[kStreamIdOffset + 3]);
+    if (streamId & 0x80000000) {
+      return folly::none;
+    }
+    auto const type = data[kTypeAndFlagsOffset];
+    FrameHeader header;
+    header.streamId = static_cast<StreamId>(streamId);
+    header.type = decodeFrameType(type >> 2);
+    header.flags = static_cast<FrameFlags>(
+        ((type & 0x3) << 8) | data[kTypeAndFlagsOffset + 1]);
+    return header;
+  }
+
+  /// peekFrameHeader() of a header which spans buffers.
+  folly::Optional<FrameHeader> peekSplitFrameHeader(const folly::IOBuf& in);
 };
 }
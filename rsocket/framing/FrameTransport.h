@@ -1,7 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+
 #include "yarpl/Refcounted.h"
 
+#include "rsocket/RequestOptions.h"
 #include "rsocket/framing/FrameProcessor.h"
 
 namespace rsocket {
@@ -11,8 +17,30 @@ class FrameTransport : public virtual yarpl::Refcounted {
  public:
   virtual void setFrameProcessor(std::shared_ptr<FrameProcessor>) = 0;
   virtual void outputFrameOrDrop(std::unique_ptr<folly::IOBuf>) = 0;
+  /// Writes several frames, in order, with a single write where the
+  /// connection supports it.
+  virtual void outputFramesOrDrop(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      outputFrameOrDrop(std::move(frame));
+    }
+  }
   virtual void close() = 0;
   virtual void closeWithError(folly::exception_wrapper) = 0;
+  /// Bytes the connection holds in memory, see
+  /// DuplexConnection::bufferedBytes().  0 when the connection lives on
+  /// another EventBase, as with ScheduledFrameTransport.
+  virtual size_t bufferedBytes() const {
+    return 0;
+  }
+  /// Frees the spare buffers of the connection, see
+  /// DuplexConnection::releaseBuffers().  Does nothing when the connection
+  /// lives on another EventBase.
+  virtual void releaseBuffers() {}
+  /// Tells the connection the priority of a stream, see
+  /// DuplexConnection::setStreamPriority().
+  virtual void setStreamPriority(StreamId, StreamPriority) {}
+  virtual void clearStreamPriority(StreamId) {}
   // Just for observation purposes!
   virtual DuplexConnection* getConnection() = 0;
 };
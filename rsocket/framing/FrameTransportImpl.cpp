@@ -112,6 +112,12 @@ void FrameTransportImpl::onNext(std::unique_ptr<folly::IOBuf> frame) {
   frameProcessor_->processFrame(std::move(frame));
 }
 
+void FrameTransportImpl::onNextMultiple(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  CHECK(frameProcessor_);
+  frameProcessor_->processFrames(std::move(frames));
+}
+
 void FrameTransportImpl::terminateProcessor(folly::exception_wrapper ex) {
   // This method can be executed multiple times while terminating.
 
@@ -149,6 +155,13 @@ void FrameTransportImpl::cancel() {
   terminateProcessor(folly::exception_wrapper());
 }
 
+void FrameTransportImpl::onWritabilityChanged(bool writable) {
+  VLOG(3) << "FrameTransport writable=" << writable;
+  if (frameProcessor_) {
+    frameProcessor_->onWritabilityChanged(writable);
+  }
+}
+
 void FrameTransportImpl::outputFrameOrDrop(
     std::unique_ptr<folly::IOBuf> frame) {
   if (!connection_) {
@@ -160,4 +173,21 @@ void FrameTransportImpl::outputFrameOrDrop(
   connectionOutput_->onNext(std::move(frame));
 }
 
+void FrameTransportImpl::outputFramesOrDrop(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  if (!connection_) {
+    // if the connection was closed we will drop the frames
+    return;
+  }
+
+  CHECK(connectionOutput_); // the connect method has to be already executed
+  if (auto output = dynamic_cast<DuplexSubscriber*>(connectionOutput_.get())) {
+    output->onNextMultiple(std::move(frames));
+    return;
+  }
+  for (auto& frame : frames) {
+    connectionOutput_->onNext(std::move(frame));
+  }
+}
+
 }
@@ -15,9 +15,9 @@ class FrameProcessor;
 
 class FrameTransportImpl : public FrameTransport,
                            /// Registered as an input in the DuplexConnection.
-                           public DuplexConnection::Subscriber,
+                           public DuplexConnection::DuplexSubscriber,
                            /// Receives signals about connection writability.
-                           public yarpl::flowable::Subscription {
+                           public DuplexConnection::DuplexSubscription {
  public:
   explicit FrameTransportImpl(std::unique_ptr<DuplexConnection> connection);
   ~FrameTransportImpl();
@@ -28,6 +28,10 @@ class FrameTransportImpl : public FrameTransport,
   /// drop the frame.
   void outputFrameOrDrop(std::unique_ptr<folly::IOBuf>) override;
 
+  /// Writes the frames to the output at once, if it is a DuplexSubscriber.
+  void outputFramesOrDrop(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
+
   /// Cancel the input, complete the output, and close the underlying
   /// connection.
   void close() override;
@@ -40,6 +44,28 @@ class FrameTransportImpl : public FrameTransport,
     return !connection_;
   }
 
+  size_t bufferedBytes() const override {
+    return connection_ ? connection_->bufferedBytes() : 0;
+  }
+
+  void releaseBuffers() override {
+    if (connection_) {
+      connection_->releaseBuffers();
+    }
+  }
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) override {
+    if (connection_) {
+      connection_->setStreamPriority(streamId, priority);
+    }
+  }
+
+  void clearStreamPriority(StreamId streamId) override {
+    if (connection_) {
+      connection_->clearStreamPriority(streamId);
+    }
+  }
+
   DuplexConnection* getConnection() override {
     return connection_.get();
   }
@@ -51,6 +77,7 @@ class FrameTransportImpl : public FrameTransport,
 
   void onSubscribe(yarpl::Reference<yarpl::flowable::Subscription>) override;
   void onNext(std::unique_ptr<folly::IOBuf>) override;
+  void onNextMultiple(std::vector<std::unique_ptr<folly::IOBuf>>) override;
   void onComplete() override;
   void onError(folly::exception_wrapper) override;
 
@@ -58,6 +85,7 @@ class FrameTransportImpl : public FrameTransport,
 
   void request(int64_t) override;
   void cancel() override;
+  void onWritabilityChanged(bool writable) override;
 
   /// Terminates the FrameProcessor.  Will queue up the exception if no
   /// processor is set, overwriting any previously queued exception.
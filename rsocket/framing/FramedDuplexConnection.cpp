@@ -1,6 +1,9 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include "rsocket/framing/FramedDuplexConnection.h"
+
+#include <folly/io/IOBufQueue.h>
+
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FramedReader.h"
 #include "rsocket/framing/FramedWriter.h"
@@ -13,21 +16,64 @@ FramedDuplexConnection::~FramedDuplexConnection() {}
 
 FramedDuplexConnection::FramedDuplexConnection(
     std::unique_ptr<DuplexConnection> connection,
-    ProtocolVersion protocolVersion)
+    ProtocolVersion protocolVersion,
+    size_t maxFrameLength)
     : inner_(std::move(connection)),
-      protocolVersion_(std::make_shared<ProtocolVersion>(protocolVersion)) {}
+      protocolVersion_(protocolVersion),
+      detectedVersion_(
+          protocolVersion == ProtocolVersion::Unknown
+              ? std::make_shared<ProtocolVersion>(protocolVersion)
+              : nullptr),
+      maxFrameLength_(maxFrameLength) {}
 
 yarpl::Reference<DuplexConnection::Subscriber>
 FramedDuplexConnection::getOutput() {
-  return yarpl::make_ref<FramedWriter>(inner_->getOutput(), protocolVersion_);
+  if (detectedVersion_) {
+    return yarpl::make_ref<FramedWriter>(
+        inner_->getOutput(), detectedVersion_, maxFrameLength_);
+  }
+  return yarpl::make_ref<FramedWriter>(
+      inner_->getOutput(), protocolVersion_, maxFrameLength_);
 }
 
 void FramedDuplexConnection::setInput(
     yarpl::Reference<DuplexConnection::Subscriber> framesSink) {
   if (!inputReader_) {
-    inputReader_ = yarpl::make_ref<FramedReader>(protocolVersion_);
+    inputReader_ = detectedVersion_
+        ? yarpl::make_ref<FramedReader>(detectedVersion_, maxFrameLength_)
+        : yarpl::make_ref<FramedReader>(protocolVersion_, maxFrameLength_);
+    if (unread_) {
+      // Buffered until the reader has an input, ahead of anything the inner
+      // connection delivers.
+      inputReader_->onNext(std::move(unread_));
+    }
     inner_->setInput(inputReader_);
   }
   inputReader_->setInput(std::move(framesSink));
 }
+
+size_t FramedDuplexConnection::bufferedBytes() const {
+  auto const framing = inputReader_ ? inputReader_->bufferedBytes() : 0;
+  return framing + inner_->bufferedBytes();
+}
+
+int FramedDuplexConnection::releaseSocket(folly::IOBufQueue& unread) {
+  folly::IOBufQueue innerUnread;
+  auto const fd = inner_->releaseSocket(innerUnread);
+  if (fd < 0) {
+    return fd;
+  }
+  if (inputReader_) {
+    inputReader_->takeBufferedBytes(unread);
+  }
+  unread.append(innerUnread.move());
+  return fd;
+}
+
+void FramedDuplexConnection::releaseBuffers() {
+  if (inputReader_) {
+    inputReader_->releaseBuffers();
+  }
+  inner_->releaseBuffers();
+}
 }
@@ -9,13 +9,19 @@ namespace rsocket {
 
 class FramedReader;
 class FramedWriter;
-struct ProtocolVersion;
 
 class FramedDuplexConnection : public virtual DuplexConnection {
  public:
+  /// Frames longer than `maxFrameLength` bytes fail the connection, either
+  /// way.  See FramedReader and FramedWriter.
+  ///
+  /// With ProtocolVersion::Unknown the version is detected from the first
+  /// frame read, and shared with the writer.  Otherwise the reader and the
+  /// writer work with the version they are given.
   FramedDuplexConnection(
       std::unique_ptr<DuplexConnection> connection,
-      ProtocolVersion protocolVersion);
+      ProtocolVersion protocolVersion,
+      size_t maxFrameLength = kMaxFrameLength);
 
   ~FramedDuplexConnection();
 
@@ -27,6 +33,37 @@ class FramedDuplexConnection : public virtual DuplexConnection {
     return true;
   }
 
+  size_t bufferedBytes() const override;
+
+  void releaseBuffers() override;
+
+  bool detachEventBase() override {
+    return inner_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    inner_->attachEventBase(eventBase);
+  }
+
+  /// With the bytes of a partial frame ahead of those of the inner
+  /// connection.
+  int releaseSocket(folly::IOBufQueue& unread) override;
+
+  /// Parses `bytes` ahead of what the inner connection reads, e.g. the bytes
+  /// another process read from the socket before handing it over.  Called
+  /// before setInput().
+  void prependInput(std::unique_ptr<folly::IOBuf> bytes) {
+    unread_ = std::move(bytes);
+  }
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) override {
+    inner_->setStreamPriority(streamId, priority);
+  }
+
+  void clearStreamPriority(StreamId streamId) override {
+    inner_->clearStreamPriority(streamId);
+  }
+
   DuplexConnection* getConnection() {
     return inner_.get();
   }
@@ -34,6 +71,11 @@ class FramedDuplexConnection : public virtual DuplexConnection {
  private:
   std::unique_ptr<DuplexConnection> inner_;
   yarpl::Reference<FramedReader> inputReader_;
-  std::shared_ptr<ProtocolVersion> protocolVersion_;
+  const ProtocolVersion protocolVersion_;
+  /// The version detected by the reader, without a known version.
+  std::shared_ptr<ProtocolVersion> detectedVersion_;
+  const size_t maxFrameLength_;
+  /// See prependInput().
+  std::unique_ptr<folly::IOBuf> unread_;
 };
 }
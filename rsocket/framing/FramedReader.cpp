@@ -2,6 +2,7 @@
 
 #include "rsocket/framing/FramedReader.h"
 
+#include <folly/Conv.h>
 #include <folly/io/Cursor.h>
 
 #include "rsocket/framing/FrameSerializer_v0_1.h"
@@ -51,7 +52,7 @@ size_t frameSizeWithoutLengthField(ProtocolVersion version, size_t frameSize) {
 }
 
 size_t FramedReader::readFrameLength() const {
-  auto fieldLength = frameSizeFieldLength(*version_);
+  auto fieldLength = frameSizeFieldLength(version_);
   DCHECK_GT(fieldLength, 0);
 
   folly::io::Cursor cur{payloadQueue_.front()};
@@ -66,6 +67,42 @@ size_t FramedReader::readFrameLength() const {
   return frameLength;
 }
 
+bool FramedReader::exceedsMaxFrameLength(size_t frameSize) const {
+  return frameSizeWithoutLengthField(version_, frameSize) > maxFrameLength_;
+}
+
+size_t FramedReader::bytesExpected() const {
+  if (version_ == ProtocolVersion::Unknown) {
+    return 0;
+  }
+  auto const buffered = payloadQueue_.chainLength();
+  if (buffered < frameSizeFieldLength(version_)) {
+    return 0;
+  }
+  auto const frameLength = readFrameLength();
+  if (exceedsMaxFrameLength(frameLength)) {
+    // It isn't going to be read, the transport shouldn't size its reads for
+    // it.
+    return 0;
+  }
+  auto const frameSize = frameSizeWithLengthField(version_, frameLength);
+  return frameSize > buffered ? frameSize - buffered : 0;
+}
+
+void FramedReader::releaseBuffers() {
+  auto const buffered = payloadQueue_.chainLength();
+  if (buffered > 0) {
+    auto compact = folly::IOBuf::create(buffered);
+    folly::io::Cursor(payloadQueue_.front())
+        .pull(compact->writableData(), buffered);
+    compact->append(buffered);
+    payloadQueue_.move();
+    payloadQueue_.append(std::move(compact));
+  }
+  frameBounds_.clear();
+  frameBounds_.shrink_to_fit();
+}
+
 void FramedReader::onSubscribe(yarpl::Reference<Subscription> subscription) {
   DuplexConnection::DuplexSubscriber::onSubscribe(subscription);
   subscription->request(std::numeric_limits<int64_t>::max());
@@ -74,10 +111,40 @@ void FramedReader::onSubscribe(yarpl::Reference<Subscription> subscription) {
 void FramedReader::onNext(std::unique_ptr<folly::IOBuf> payload) {
   VLOG(4) << "incoming bytes length=" << payload->length() << '\n'
           << hexDump(payload->clone()->moveToFbString());
+  if (payloadQueue_.empty() && !payload->isChained() && !dispatchingFrames_ &&
+      version_ != ProtocolVersion::Unknown && inner_) {
+    parseFramesFrom(std::move(payload));
+    return;
+  }
   payloadQueue_.append(std::move(payload));
   parseFrames();
 }
 
+void FramedReader::parseFramesFrom(std::unique_ptr<folly::IOBuf> payload) {
+  // Delivering onNext can trigger termination and destroy this instance.
+  auto thisPtr = this->ref_from_this(this);
+
+  dispatchingFrames_ = true;
+
+  // The whole frames are sliced out of the read, only the rest of it goes
+  // through the queue.  Invalid frames stay in the read, to be reported by
+  // the frame by frame parsing.
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  auto const offset = scanFrames(*payload);
+  sliceFrames(*payload, frames);
+  payload->trimStart(offset);
+  if (!payload->empty()) {
+    payloadQueue_.append(std::move(payload));
+  }
+  deliverFrames(std::move(frames));
+
+  while (parseAndDeliverFrames()) {
+    // Delivering the frames may have allowed more of them.
+  }
+
+  dispatchingFrames_ = false;
+}
+
 void FramedReader::parseFrames() {
   if (dispatchingFrames_) {
     return;
@@ -88,32 +155,58 @@ void FramedReader::parseFrames() {
 
   dispatchingFrames_ = true;
 
+  while (parseAndDeliverFrames()) {
+    // Delivering the frames may have allowed more of them.
+  }
+
+  dispatchingFrames_ = false;
+}
+
+bool FramedReader::parseAndDeliverFrames() {
+  // The frames in the buffered bytes are delivered together, so that the inner
+  // subscriber pays what it does per delivery once per read rather than once
+  // per frame.
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  std::string errorMsg;
+
   while (allowance_.canConsume(1) && inner_) {
     if (!ensureOrAutodetectProtocolVersion()) {
       // At this point we dont have enough bytes on the wire or we errored out.
       break;
     }
 
-    auto const frameSizeFieldLen = frameSizeFieldLength(*version_);
+    auto const frameSizeFieldLen = frameSizeFieldLength(version_);
     if (payloadQueue_.chainLength() < frameSizeFieldLen) {
       // We don't even have the next frame size value.
       break;
     }
 
+    if (parseFrameBatch(frames)) {
+      continue;
+    }
+
     auto const nextFrameSize = readFrameLength();
-    if (nextFrameSize < minimalFrameLength(*version_)) {
-      error("Invalid frame - Frame size smaller than minimum");
+    if (nextFrameSize < minimalFrameLength(version_)) {
+      errorMsg = "Invalid frame - Frame size smaller than minimum";
+      break;
+    }
+    if (exceedsMaxFrameLength(nextFrameSize)) {
+      errorMsg = folly::to<std::string>(
+          "Invalid frame - Frame size ",
+          frameSizeWithoutLengthField(version_, nextFrameSize),
+          " larger than maximum ",
+          maxFrameLength_);
       break;
     }
 
     if (payloadQueue_.chainLength() <
-        frameSizeWithLengthField(*version_, nextFrameSize)) {
+        frameSizeWithLengthField(version_, nextFrameSize)) {
       // Need to accumulate more data.
       break;
     }
 
     payloadQueue_.trimStart(frameSizeFieldLen);
-    auto payloadSize = frameSizeWithoutLengthField(*version_, nextFrameSize);
+    auto payloadSize = frameSizeWithoutLengthField(version_, nextFrameSize);
 
     DCHECK_GT(payloadSize, 0)
         << "folly::IOBufQueue::split(0) returns a nullptr, can't have that";
@@ -123,10 +216,99 @@ void FramedReader::parseFrames() {
 
     VLOG(4) << "parsed frame length=" << nextFrame->length() << '\n'
             << hexDump(nextFrame->clone()->moveToFbString());
-    inner_->onNext(std::move(nextFrame));
+    frames.push_back(std::move(nextFrame));
   }
 
-  dispatchingFrames_ = false;
+  auto const delivered = !frames.empty();
+  deliverFrames(std::move(frames));
+  if (!errorMsg.empty()) {
+    // Once the frames before the invalid one are delivered.
+    error(std::move(errorMsg));
+    return false;
+  }
+  return delivered;
+}
+
+bool FramedReader::parseFrameBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>>& frames) {
+  auto const* head = payloadQueue_.front();
+  auto const offset = scanFrames(*head);
+  if (frameBounds_.size() < 2) {
+    return false;
+  }
+  sliceFrames(*head, frames);
+  payloadQueue_.trimStart(offset);
+  return true;
+}
+
+size_t FramedReader::scanFrames(const folly::IOBuf& buf) {
+  auto const* data = buf.data();
+  auto const length = buf.length();
+  auto const fieldLength = frameSizeFieldLength(version_);
+  auto const minimalLength = minimalFrameLength(version_);
+  auto const maxFrames = allowance_.get();
+
+  frameBounds_.clear();
+  size_t offset = 0;
+  while (frameBounds_.size() < maxFrames && offset + fieldLength <= length) {
+    size_t frameSize = 0;
+    for (size_t i = 0; i < fieldLength; ++i) {
+      frameSize = (frameSize << 8) | data[offset + i];
+    }
+    if (frameSize < minimalLength || exceedsMaxFrameLength(frameSize)) {
+      // Reported by the frame by frame parsing.
+      break;
+    }
+    auto const totalSize = frameSizeWithLengthField(version_, frameSize);
+    if (totalSize > length - offset) {
+      break;
+    }
+    frameBounds_.emplace_back(
+        offset + fieldLength,
+        frameSizeWithoutLengthField(version_, frameSize));
+    offset += totalSize;
+  }
+  return offset;
+}
+
+void FramedReader::sliceFrames(
+    const folly::IOBuf& buf,
+    std::vector<std::unique_ptr<folly::IOBuf>>& frames) {
+  if (frameBounds_.empty()) {
+    return;
+  }
+  frames.reserve(frames.size() + frameBounds_.size());
+  for (auto const& bounds : frameBounds_) {
+    auto frame = buf.cloneOne();
+    frame->trimStart(bounds.first);
+    frame->trimEnd(frame->length() - bounds.second);
+    frames.push_back(std::move(frame));
+  }
+  CHECK(allowance_.tryConsume(frameBounds_.size()));
+
+  VLOG(4) << "parsed " << frameBounds_.size() << " frames at once";
+}
+
+void FramedReader::deliverFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  if (frames.empty() || !inner_) {
+    return;
+  }
+  if (frames.size() == 1) {
+    inner_->onNext(std::move(frames.front()));
+    return;
+  }
+  if (auto inner = dynamic_cast<DuplexConnection::DuplexSubscriber*>(
+          inner_.get())) {
+    inner->onNextMultiple(std::move(frames));
+    return;
+  }
+  for (auto& frame : frames) {
+    if (!inner_) {
+      break;
+    }
+    inner_->onNext(std::move(frame));
+  }
 }
 
 void FramedReader::onComplete() {
@@ -165,11 +347,7 @@ void FramedReader::setInput(
   inner_->onSubscribe(this->ref_from_this(this));
 }
 
-bool FramedReader::ensureOrAutodetectProtocolVersion() {
-  if (*version_ != ProtocolVersion::Unknown) {
-    return true;
-  }
-
+bool FramedReader::autodetectProtocolVersion() {
   auto minBytesNeeded = std::max(
       FrameSerializerV0_1::kMinBytesNeededForAutodetection,
       FrameSerializerV1_0::kMinBytesNeededForAutodetection);
@@ -186,14 +364,19 @@ bool FramedReader::ensureOrAutodetectProtocolVersion() {
   auto detected = FrameSerializerV1_0::detectProtocolVersion(
       firstFrame, kFrameLengthFieldLengthV1_0);
   if (detected != ProtocolVersion::Unknown) {
-    *version_ = FrameSerializerV1_0::Version;
-    return true;
+    version_ = FrameSerializerV1_0::Version;
+  } else {
+    detected = FrameSerializerV0_1::detectProtocolVersion(
+        firstFrame, kFrameLengthFieldLengthV0_1);
+    if (detected != ProtocolVersion::Unknown) {
+      version_ = FrameSerializerV0_1::Version;
+    }
   }
 
-  detected = FrameSerializerV0_1::detectProtocolVersion(
-      firstFrame, kFrameLengthFieldLengthV0_1);
-  if (detected != ProtocolVersion::Unknown) {
-    *version_ = FrameSerializerV0_1::Version;
+  if (version_ != ProtocolVersion::Unknown) {
+    if (detectedVersion_) {
+      *detectedVersion_ = version_;
+    }
     return true;
   }
 
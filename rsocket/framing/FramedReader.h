@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include <folly/io/IOBufQueue.h>
 
 #include "rsocket/DuplexConnection.h"
@@ -14,8 +17,24 @@ namespace rsocket {
 class FramedReader : public DuplexConnection::DuplexSubscriber,
                      public yarpl::flowable::Subscription {
  public:
-  explicit FramedReader(std::shared_ptr<ProtocolVersion> version)
-      : version_{std::move(version)} {}
+  /// Frames longer than `maxFrameLength` bytes, not counting their length
+  /// field, fail the input as soon as their length field is read, before
+  /// their bytes are buffered.
+  ///
+  /// The version is detected from the first frame if it is Unknown, and then
+  /// published through `version` to the FramedWriter sharing it.
+  explicit FramedReader(
+      std::shared_ptr<ProtocolVersion> version,
+      size_t maxFrameLength = kMaxFrameLength)
+      : version_{*version},
+        detectedVersion_{std::move(version)},
+        maxFrameLength_{maxFrameLength} {}
+
+  /// Reads the frames of a known version, without autodetection.
+  explicit FramedReader(
+      ProtocolVersion version,
+      size_t maxFrameLength = kMaxFrameLength)
+      : version_{version}, maxFrameLength_{maxFrameLength} {}
 
   /// Set the inner subscriber which will be getting full frame payloads.
   void setInput(yarpl::Reference<DuplexConnection::Subscriber>);
@@ -30,6 +49,24 @@ class FramedReader : public DuplexConnection::DuplexSubscriber,
   void onComplete() override;
   void onError(folly::exception_wrapper) override;
 
+  /// Bytes still missing from the frame at the head of the buffer, once its
+  /// length field has been received.
+  size_t bytesExpected() const override;
+
+  /// Bytes received which don't make a whole frame yet.
+  size_t bufferedBytes() const {
+    return payloadQueue_.chainLength();
+  }
+
+  /// Moves the bytes of a partial frame out of the read buffers they pin, into
+  /// a buffer of their size, and drops the spare capacity kept for parsing.
+  void releaseBuffers();
+
+  /// Moves the bytes received which don't make a whole frame yet to `out`.
+  void takeBufferedBytes(folly::IOBufQueue& out) {
+    out.append(payloadQueue_.move());
+  }
+
   // Subscription.
 
   void request(int64_t) override;
@@ -37,16 +74,61 @@ class FramedReader : public DuplexConnection::DuplexSubscriber,
 
  private:
   void parseFrames();
-  bool ensureOrAutodetectProtocolVersion();
+
+  /// Parses the frames which are allowed and delivers them.  Returns false
+  /// once there is none, or on errors.
+  bool parseAndDeliverFrames();
+
+  /// Splits all the complete frames at the front of the head buffer of the
+  /// queue in one pass, as slices sharing that buffer, and appends them to
+  /// `frames`.  Returns false, leaving the queue untouched, if the head buffer
+  /// doesn't start with at least two complete frames.
+  bool parseFrameBatch(std::vector<std::unique_ptr<folly::IOBuf>>& frames);
+
+  /// Delivers the whole frames of a read which arrived while nothing was
+  /// buffered as slices of it, and only queues what follows them, so that
+  /// reads of whole frames never go through the queue.
+  void parseFramesFrom(std::unique_ptr<folly::IOBuf> payload);
+
+  /// Finds the complete frames allowed at the front of `buf`, in
+  /// frameBounds_, and returns the offset past the last one.
+  size_t scanFrames(const folly::IOBuf& buf);
+
+  /// Appends the frames found by scanFrames() to `frames`, as slices sharing
+  /// `buf`.
+  void sliceFrames(
+      const folly::IOBuf& buf,
+      std::vector<std::unique_ptr<folly::IOBuf>>& frames);
+
+  /// Delivers the frames parsed at once, all together if the inner subscriber
+  /// is a DuplexSubscriber.
+  void deliverFrames(std::vector<std::unique_ptr<folly::IOBuf>> frames);
+
+  bool ensureOrAutodetectProtocolVersion() {
+    return version_ != ProtocolVersion::Unknown || autodetectProtocolVersion();
+  }
+  bool autodetectProtocolVersion();
 
   size_t readFrameLength() const;
 
+  /// Whether a frame whose length field holds `frameSize` is too long.
+  bool exceedsMaxFrameLength(size_t frameSize) const;
+
   yarpl::Reference<DuplexConnection::Subscriber> inner_;
 
   Allowance allowance_;
   bool dispatchingFrames_{false};
 
+  /// Offsets and lengths of the frames found by scanFrames(), kept to reuse
+  /// their allocation.
+  std::vector<std::pair<size_t, size_t>> frameBounds_;
+
   folly::IOBufQueue payloadQueue_{folly::IOBufQueue::cacheChainLength()};
-  std::shared_ptr<ProtocolVersion> version_;
+  /// Read on every frame, so it is kept here rather than behind
+  /// detectedVersion_.
+  ProtocolVersion version_;
+  /// Where the detected version is published, if it is detected.
+  std::shared_ptr<ProtocolVersion> detectedVersion_;
+  const size_t maxFrameLength_;
 };
 }
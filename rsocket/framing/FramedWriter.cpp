@@ -2,16 +2,16 @@
 
 #include "rsocket/framing/FramedWriter.h"
 
+#include <folly/Likely.h>
 #include <folly/io/Cursor.h>
 
 #include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/internal/OutputSlab.h"
 
 namespace rsocket {
 
 using namespace yarpl::flowable;
 
-constexpr static const auto kMaxFrameLength = 0xFFFFFF; // 24bit max value
-
 template <typename TWriter>
 static void writeFrameLength(
     TWriter& cur,
@@ -32,17 +32,17 @@ static void writeFrameLength(
 }
 
 size_t FramedWriter::getFrameSizeFieldLength() const {
-  CHECK(*protocolVersion_ != ProtocolVersion::Unknown);
-  if (*protocolVersion_ < FrameSerializerV1_0::Version) {
+  CHECK(protocolVersion_ != ProtocolVersion::Unknown);
+  if (protocolVersion_ < FrameSerializerV1_0::Version) {
     return sizeof(int32_t);
   } else {
-    return 3; // bytes
+    return FrameSerializerV1_0::kFrameLengthFieldLength;
   }
 }
 
 size_t FramedWriter::getPayloadLength(size_t payloadLength) const {
-  DCHECK(*protocolVersion_ != ProtocolVersion::Unknown);
-  if (*protocolVersion_ < FrameSerializerV1_0::Version) {
+  DCHECK(protocolVersion_ != ProtocolVersion::Unknown);
+  if (protocolVersion_ < FrameSerializerV1_0::Version) {
     return payloadLength + getFrameSizeFieldLength();
   } else {
     return payloadLength;
@@ -58,14 +58,24 @@ std::unique_ptr<folly::IOBuf> FramedWriter::appendSize(
     std::unique_ptr<folly::IOBuf> payload) {
   CHECK(payload);
 
+  if (UNLIKELY(protocolVersion_ == ProtocolVersion::Unknown) &&
+      sharedVersion_) {
+    protocolVersion_ = *sharedVersion_;
+  }
   const auto frameSizeFieldLength = getFrameSizeFieldLength();
+  auto const frameLength = payload->computeChainDataLength();
+  if (frameLength > maxFrameLength_) {
+    return nullptr;
+  }
   // the frame size includes the payload size and the size value
-  auto payloadLength = getPayloadLength(payload->computeChainDataLength());
+  auto payloadLength = getPayloadLength(frameLength);
   if (payloadLength > kMaxFrameLength) {
     return nullptr;
   }
 
-  if (payload->headroom() >= frameSizeFieldLength) {
+  // The headroom of a shared buffer may be the bytes of another one, e.g. of
+  // a frame still buffered for resumption.
+  if (!payload->isSharedOne() && payload->headroom() >= frameSizeFieldLength) {
     // move the data pointer back and write value to the payload
     payload->prepend(frameSizeFieldLength);
     folly::io::RWPrivateCursor cur(payload.get());
@@ -96,7 +106,7 @@ void FramedWriter::onNext(std::unique_ptr<folly::IOBuf> payload) {
 
 void FramedWriter::onNextMultiple(
     std::vector<std::unique_ptr<folly::IOBuf>> payloads) {
-  folly::IOBufQueue payloadQueue;
+  std::unique_ptr<folly::IOBuf> chain;
 
   for (auto& payload : payloads) {
     auto sizedPayload = appendSize(std::move(payload));
@@ -104,9 +114,9 @@ void FramedWriter::onNextMultiple(
       error("payload too big");
       return;
     }
-    payloadQueue.append(std::move(sizedPayload));
+    OutputSlab::append(chain, std::move(sizedPayload));
   }
-  stream_->onNext(payloadQueue.move());
+  stream_->onNext(std::move(chain));
 }
 
 void FramedWriter::error(std::string errorMsg) {
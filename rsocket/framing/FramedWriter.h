@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/internal/Common.h"
 #include "yarpl/flowable/Subscriber.h"
 
 namespace rsocket {
@@ -14,13 +15,33 @@ struct ProtocolVersion;
 
 class FramedWriter : public DuplexConnection::DuplexSubscriber {
  public:
+  /// Frames longer than `maxFrameLength` bytes, not counting their length
+  /// field, fail the output instead of being written.
+  ///
+  /// The version can be Unknown until the first frame is written, e.g. while
+  /// the FramedReader sharing it detects it.
   explicit FramedWriter(
       yarpl::Reference<DuplexConnection::Subscriber> stream,
-      std::shared_ptr<ProtocolVersion> protocolVersion)
+      std::shared_ptr<ProtocolVersion> protocolVersion,
+      size_t maxFrameLength = kMaxFrameLength)
       : stream_(std::move(stream)),
-        protocolVersion_(std::move(protocolVersion)) {}
+        protocolVersion_(*protocolVersion),
+        sharedVersion_(std::move(protocolVersion)),
+        maxFrameLength_(maxFrameLength) {}
 
-  void onNextMultiple(std::vector<std::unique_ptr<folly::IOBuf>> element);
+  /// Writes the frames of a known version.
+  FramedWriter(
+      yarpl::Reference<DuplexConnection::Subscriber> stream,
+      ProtocolVersion protocolVersion,
+      size_t maxFrameLength = kMaxFrameLength)
+      : stream_(std::move(stream)),
+        protocolVersion_(protocolVersion),
+        maxFrameLength_(maxFrameLength) {}
+
+  /// Writes the frames to the stream as a single chain, their small buffers
+  /// packed together, see OutputSlab.
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> element) override;
 
  private:
   // Subscriber methods
@@ -39,6 +60,9 @@ class FramedWriter : public DuplexConnection::DuplexSubscriber {
       std::unique_ptr<folly::IOBuf> payload);
 
   yarpl::Reference<DuplexConnection::Subscriber> stream_;
-  std::shared_ptr<ProtocolVersion> protocolVersion_;
+  /// Read on every frame, taken from sharedVersion_ once it is known.
+  ProtocolVersion protocolVersion_;
+  std::shared_ptr<ProtocolVersion> sharedVersion_;
+  const size_t maxFrameLength_;
 };
 }
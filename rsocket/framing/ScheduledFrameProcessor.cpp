@@ -5,20 +5,42 @@
 
 namespace rsocket {
 
+ScheduledFrameProcessor::ScheduledFrameProcessor(
+    std::shared_ptr<FrameProcessor> fp,
+    folly::EventBase* evb)
+    : frameProcessor_(std::move(fp)),
+      evb_(evb),
+      queue_(std::make_shared<ScheduledFrameQueue>(
+          *evb_,
+          [fp = frameProcessor_](ScheduledFrameQueue::Frames frames) {
+            if (frames.size() == 1) {
+              fp->processFrame(std::move(frames.front()));
+            } else {
+              fp->processFrames(std::move(frames));
+            }
+          })) {}
+
 ScheduledFrameProcessor::~ScheduledFrameProcessor() {}
 
 void ScheduledFrameProcessor::processFrame(
     std::unique_ptr<folly::IOBuf> ioBuf) {
-  evb_->runInEventBaseThread(
-      [ fp = frameProcessor_, ioBuf = std::move(ioBuf) ]() mutable {
-        fp->processFrame(std::move(ioBuf));
-      });
+  queue_->push(std::move(ioBuf));
+}
+
+void ScheduledFrameProcessor::processFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  queue_->push(std::move(frames));
 }
 
 void ScheduledFrameProcessor::onTerminal(folly::exception_wrapper ex) {
-  evb_->runInEventBaseThread(
-      [ ex = std::move(ex), fp = frameProcessor_ ]() mutable {
-        fp->onTerminal(std::move(ex));
-      });
+  queue_->run([ ex = std::move(ex), fp = frameProcessor_ ]() mutable {
+    fp->onTerminal(std::move(ex));
+  });
+}
+
+void ScheduledFrameProcessor::onWritabilityChanged(bool writable) {
+  queue_->run([ writable, fp = frameProcessor_ ]() {
+    fp->onWritabilityChanged(writable);
+  });
 }
 }
@@ -3,6 +3,7 @@
 #include <folly/io/async/EventBase.h>
 
 #include "rsocket/framing/FrameProcessor.h"
+#include "rsocket/framing/ScheduledFrameQueue.h"
 
 namespace rsocket {
 
@@ -13,22 +14,26 @@ namespace rsocket {
 // client is on a different EventBase compared to the EventBase on which the
 // original RSocketStateMachine was constructed for the client.  Here the
 // transport uses this class to schedule events of the RSocketStateMachine
-// (FrameProcessor) in the original EventBase.
+// (FrameProcessor) in the original EventBase.  The frames are handed over in
+// bursts, see ScheduledFrameQueue.
 class ScheduledFrameProcessor : public FrameProcessor {
  public:
   ScheduledFrameProcessor(
       std::shared_ptr<FrameProcessor> fp,
-      folly::EventBase* evb)
-      : frameProcessor_(std::move(fp)), evb_(evb) {}
+      folly::EventBase* evb);
 
   ~ScheduledFrameProcessor();
 
   void processFrame(std::unique_ptr<folly::IOBuf> ioBuf) override;
+  void processFrames(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
   void onTerminal(folly::exception_wrapper ex) override;
+  void onWritabilityChanged(bool writable) override;
 
  private:
   std::shared_ptr<FrameProcessor> frameProcessor_;
   folly::EventBase* evb_;
+  const std::shared_ptr<ScheduledFrameQueue> queue_;
 };
 
 } // rsocket
@@ -0,0 +1,70 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/framing/ScheduledFrameQueue.h"
+
+#include <folly/io/async/EventBase.h>
+
+namespace rsocket {
+
+ScheduledFrameQueue::ScheduledFrameQueue(
+    folly::EventBase& evb,
+    folly::Function<void(Frames)> deliver)
+    : evb_(evb), deliver_(std::move(deliver)) {}
+
+ScheduledFrameQueue::~ScheduledFrameQueue() = default;
+
+void ScheduledFrameQueue::push(std::unique_ptr<folly::IOBuf> frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  items_.push_back(Item{std::move(frame), nullptr});
+  scheduleDrain();
+}
+
+void ScheduledFrameQueue::push(Frames frames) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& frame : frames) {
+    items_.push_back(Item{std::move(frame), nullptr});
+  }
+  scheduleDrain();
+}
+
+void ScheduledFrameQueue::run(folly::Function<void()> func) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  items_.push_back(Item{nullptr, std::move(func)});
+  scheduleDrain();
+}
+
+void ScheduledFrameQueue::scheduleDrain() {
+  if (drainScheduled_) {
+    return;
+  }
+  drainScheduled_ = true;
+  evb_.runInEventBaseThread([self = shared_from_this()] { self->drain(); });
+}
+
+void ScheduledFrameQueue::drain() {
+  std::deque<Item> items;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items.swap(items_);
+    // What is pushed from now on is taken by the next drain.
+    drainScheduled_ = false;
+  }
+
+  Frames frames;
+  for (auto& item : items) {
+    if (item.frame) {
+      frames.push_back(std::move(item.frame));
+      continue;
+    }
+    if (!frames.empty()) {
+      deliver_(std::move(frames));
+      frames.clear();
+    }
+    item.func();
+  }
+  if (!frames.empty()) {
+    deliver_(std::move(frames));
+  }
+}
+
+} // namespace rsocket
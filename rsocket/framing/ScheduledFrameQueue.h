@@ -0,0 +1,66 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/io/IOBuf.h>
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Hands frames, and the other signals, over to an EventBase in bursts.  The
+/// first push after a drain schedules the next one, and a drain takes
+/// everything queued by then with a single task.  Consecutive frames are
+/// delivered together, the tasks run in between them in the order they were
+/// queued.  Thread safe.
+///
+/// This is used by ScheduledFrameTransport and ScheduledFrameProcessor, so a
+/// busy connection living across two EventBases doesn't cost one task per
+/// frame.
+class ScheduledFrameQueue
+    : public std::enable_shared_from_this<ScheduledFrameQueue> {
+ public:
+  using Frames = std::vector<std::unique_ptr<folly::IOBuf>>;
+
+  /// `deliver` is called on `evb` with the frames of a burst.
+  ScheduledFrameQueue(
+      folly::EventBase& evb,
+      folly::Function<void(Frames)> deliver);
+  ~ScheduledFrameQueue();
+
+  void push(std::unique_ptr<folly::IOBuf> frame);
+  void push(Frames frames);
+
+  /// Runs `func` on the EventBase, after the frames pushed so far have been
+  /// delivered and before those pushed afterwards.
+  void run(folly::Function<void()> func);
+
+ private:
+  /// A frame or a task.
+  struct Item {
+    std::unique_ptr<folly::IOBuf> frame;
+    folly::Function<void()> func;
+  };
+
+  /// Under the lock, schedules a drain unless one is pending already.
+  void scheduleDrain();
+  void drain();
+
+  folly::EventBase& evb_;
+  /// Only called on the EventBase.
+  folly::Function<void(Frames)> deliver_;
+
+  std::mutex mutex_;
+  std::deque<Item> items_;
+  bool drainScheduled_{false};
+};
+
+} // namespace rsocket
@@ -4,11 +4,28 @@
 
 namespace rsocket {
 
+ScheduledFrameTransport::ScheduledFrameTransport(
+    yarpl::Reference<FrameTransport> frameTransport,
+    folly::EventBase* transportEvb,
+    folly::EventBase* stateMachineEvb)
+    : transportEvb_(transportEvb),
+      stateMachineEvb_(stateMachineEvb),
+      frameTransport_(std::move(frameTransport)),
+      queue_(std::make_shared<ScheduledFrameQueue>(
+          *transportEvb_,
+          [ft = frameTransport_](ScheduledFrameQueue::Frames frames) {
+            if (frames.size() == 1) {
+              ft->outputFrameOrDrop(std::move(frames.front()));
+            } else {
+              ft->outputFramesOrDrop(std::move(frames));
+            }
+          })) {}
+
 ScheduledFrameTransport::~ScheduledFrameTransport() {}
 
 void ScheduledFrameTransport::setFrameProcessor(
     std::shared_ptr<FrameProcessor> fp) {
-  transportEvb_->runInEventBaseThread(
+  queue_->run(
       [ this, self = this->ref_from_this(this), fp = std::move(fp) ]() mutable {
         auto scheduledFP = std::make_shared<ScheduledFrameProcessor>(
             std::move(fp), stateMachineEvb_);
@@ -18,23 +35,37 @@ void ScheduledFrameTransport::setFrameProcessor(
 
 void ScheduledFrameTransport::outputFrameOrDrop(
     std::unique_ptr<folly::IOBuf> ioBuf) {
-  transportEvb_->runInEventBaseThread(
-      [ ft = frameTransport_, ioBuf = std::move(ioBuf) ]() mutable {
-        ft->outputFrameOrDrop(std::move(ioBuf));
-      });
+  queue_->push(std::move(ioBuf));
+}
+
+void ScheduledFrameTransport::outputFramesOrDrop(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  queue_->push(std::move(frames));
 }
 
 void ScheduledFrameTransport::close() {
-  transportEvb_->runInEventBaseThread([ft = frameTransport_]() {
-    ft->close();
-  });
+  queue_->run([ft = frameTransport_]() { ft->close(); });
 }
 
 void ScheduledFrameTransport::closeWithError(folly::exception_wrapper ex) {
-  transportEvb_->runInEventBaseThread(
-      [ ft = frameTransport_, ex = std::move(ex) ]() mutable {
-        ft->closeWithError(std::move(ex));
-      });
+  queue_->run([ ft = frameTransport_, ex = std::move(ex) ]() mutable {
+    ft->closeWithError(std::move(ex));
+  });
+}
+
+void ScheduledFrameTransport::setStreamPriority(
+    StreamId streamId,
+    StreamPriority priority) {
+  // After the frames pushed so far, before those of the stream.
+  queue_->run([ ft = frameTransport_, streamId, priority ] {
+    ft->setStreamPriority(streamId, priority);
+  });
+}
+
+void ScheduledFrameTransport::clearStreamPriority(StreamId streamId) {
+  queue_->run([ ft = frameTransport_, streamId ] {
+    ft->clearStreamPriority(streamId);
+  });
 }
 
 } // rsocket
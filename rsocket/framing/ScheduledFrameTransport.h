@@ -4,6 +4,7 @@
 
 #include "rsocket/framing/FrameTransportImpl.h"
 #include "rsocket/framing/ScheduledFrameProcessor.h"
+#include "rsocket/framing/ScheduledFrameQueue.h"
 
 namespace rsocket {
 
@@ -14,24 +15,26 @@ namespace rsocket {
 // client is on a different EventBase compared to the EventBase on which the
 // original RSocketStateMachine was constructed for the client.  Here the
 // RSocketStateMachine uses this class to schedule events of the Transport in
-// the new EventBase.
+// the new EventBase.  The frames are handed over in bursts, see
+// ScheduledFrameQueue.
 class ScheduledFrameTransport : public FrameTransport,
                                 public yarpl::enable_get_ref {
  public:
   ScheduledFrameTransport(
       yarpl::Reference<FrameTransport> frameTransport,
       folly::EventBase* transportEvb,
-      folly::EventBase* stateMachineEvb)
-      : transportEvb_(transportEvb),
-        stateMachineEvb_(stateMachineEvb),
-        frameTransport_(std::move(frameTransport)) {}
+      folly::EventBase* stateMachineEvb);
 
   ~ScheduledFrameTransport();
 
   void setFrameProcessor(std::shared_ptr<FrameProcessor> fp) override;
   void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> ioBuf) override;
+  void outputFramesOrDrop(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
   void close() override;
   void closeWithError(folly::exception_wrapper ex) override;
+  void setStreamPriority(StreamId streamId, StreamPriority priority) override;
+  void clearStreamPriority(StreamId streamId) override;
 
  private:
   DuplexConnection* getConnection() override {
@@ -46,5 +49,6 @@ class ScheduledFrameTransport : public FrameTransport,
   folly::EventBase* transportEvb_;
   folly::EventBase* stateMachineEvb_;
   yarpl::Reference<FrameTransport> frameTransport_;
+  const std::shared_ptr<ScheduledFrameQueue> queue_;
 };
 }
@@ -0,0 +1,79 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/AdaptiveLimit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rsocket {
+
+namespace {
+/// Smoothing of the latencies of the GRADIENT algorithm, as the weight of a
+/// new latency.  The short-term average follows about the last 10 responses,
+/// the long-term one about the last 100.
+constexpr double kShortTermWeight = 0.1;
+constexpr double kLongTermWeight = 0.01;
+/// The short-term latency may exceed the long-term one by this much before
+/// GRADIENT backs off, so that noise doesn't.
+constexpr double kLatencyTolerance = 1.5;
+/// Weight of a new limit of GRADIENT.
+constexpr double kLimitSmoothing = 0.2;
+} // namespace
+
+AdaptiveLimit::AdaptiveLimit(const Options& options)
+    : options_(options),
+      limit_(static_cast<double>(std::max(
+          options.minLimit,
+          std::min(options.initialLimit, options.maxLimit)))) {}
+
+size_t AdaptiveLimit::limit() const {
+  return std::max(options_.minLimit, static_cast<size_t>(limit_));
+}
+
+void AdaptiveLimit::update(
+    Clock::duration latency,
+    bool overload,
+    size_t inFlight) {
+  auto const minLimit = static_cast<double>(options_.minLimit);
+  auto const maxLimit = static_cast<double>(options_.maxLimit);
+  // Requests which use little of the limit say nothing about a larger one.
+  auto const limitUsed = 2 * inFlight >= limit();
+
+  if (options_.algorithm == Algorithm::AIMD) {
+    if (overload || latency > options_.latencyThreshold) {
+      limit_ = std::max(minLimit, limit_ * options_.backoffRatio);
+    } else if (limitUsed) {
+      limit_ = std::min(maxLimit, limit_ + 1);
+    }
+    return;
+  }
+
+  auto const sample = std::chrono::duration<double>(latency).count();
+  if (shortLatency_ == 0) {
+    shortLatency_ = longLatency_ = sample;
+  } else {
+    shortLatency_ += (sample - shortLatency_) * kShortTermWeight;
+    longLatency_ += (sample - longLatency_) * kLongTermWeight;
+  }
+  if (overload) {
+    limit_ = std::max(minLimit, limit_ * options_.backoffRatio);
+    return;
+  }
+  // Once latency went down again, the long-term average catches up faster,
+  // or the limit would stay at its maximum while it does.
+  if (longLatency_ > 2 * shortLatency_) {
+    longLatency_ *= 0.95;
+  }
+  if (!limitUsed || shortLatency_ <= 0) {
+    return;
+  }
+  auto const gradient = std::max(
+      options_.backoffRatio,
+      std::min(1.0, kLatencyTolerance * longLatency_ / shortLatency_));
+  auto const next = limit_ * gradient + std::sqrt(limit_);
+  limit_ = std::max(
+      minLimit,
+      std::min(
+          maxLimit, limit_ * (1 - kLimitSmoothing) + next * kLimitSmoothing));
+}
+}
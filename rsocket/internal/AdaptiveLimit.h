@@ -0,0 +1,55 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace rsocket {
+
+/// A concurrency limit which follows the latency of the requests, see
+/// ConcurrencyLimiter and ConcurrencyLimitingRSocketResponder.
+///
+/// Not thread safe.
+class AdaptiveLimit {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Algorithm {
+    /// Grows the limit by one per response faster than latencyThreshold while
+    /// at least half of the limit is in use, and multiplies it by
+    /// backoffRatio on a slower response or an overload.
+    AIMD,
+    /// Scales the limit by the ratio of the long-term average latency to the
+    /// short-term one, with some tolerance and bounded to [backoffRatio, 1],
+    /// plus the square root of the limit as headroom.  The limit stops
+    /// growing as soon as responses slow down, without a threshold to tune.
+    GRADIENT,
+  };
+
+  struct Options {
+    Algorithm algorithm{Algorithm::AIMD};
+    size_t initialLimit{20};
+    size_t minLimit{1};
+    size_t maxLimit{1000};
+    /// Responses slower than this are a sign of overload, with AIMD.
+    std::chrono::milliseconds latencyThreshold{std::chrono::seconds(1)};
+    double backoffRatio{0.9};
+  };
+
+  explicit AdaptiveLimit(const Options& options);
+
+  size_t limit() const;
+
+  /// Takes the latency of a request, and whether it failed from an overload.
+  /// `inFlight` counts the requests in flight along with it.
+  void update(Clock::duration latency, bool overload, size_t inFlight);
+
+ private:
+  const Options options_;
+  double limit_;
+  /// Averages of the latencies in seconds, with GRADIENT.
+  double shortLatency_{0};
+  double longLatency_{0};
+};
+}
@@ -4,36 +4,41 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 
 namespace rsocket {
 
-class Allowance {
+/// A count of items which may be consumed, saturating at the maximum of its
+/// representation.
+template <typename T>
+class BasicAllowance {
  public:
-  using ValueType = size_t;
+  using ValueType = T;
 
-  Allowance() = default;
+  BasicAllowance() = default;
 
-  explicit Allowance(ValueType initialValue) : value_(initialValue) {}
+  explicit BasicAllowance(ValueType initialValue) : value_(initialValue) {}
 
-  bool tryConsume(ValueType n) {
+  bool tryConsume(size_t n) {
     if (!canConsume(n)) {
       return false;
     }
-    value_ -= n;
+    value_ -= static_cast<ValueType>(n);
     return true;
   }
 
-  ValueType add(ValueType n) {
+  ValueType add(size_t n) {
     auto old_value = value_;
-    value_ += n;
-    if (old_value > value_) {
+    if (n >= static_cast<size_t>(max() - value_)) {
       value_ = max();
+    } else {
+      value_ += static_cast<ValueType>(n);
     }
     return old_value;
   }
 
-  bool canConsume(ValueType n) const {
+  bool canConsume(size_t n) const {
     return value_ >= n;
   }
 
@@ -41,12 +46,12 @@ class Allowance {
     return consumeUpTo(max());
   }
 
-  ValueType consumeUpTo(ValueType limit) {
+  ValueType consumeUpTo(size_t limit) {
     if (limit > value_) {
       limit = value_;
     }
-    value_ -= limit;
-    return limit;
+    value_ -= static_cast<ValueType>(limit);
+    return static_cast<ValueType>(limit);
   }
 
   explicit operator bool() const {
@@ -68,6 +73,16 @@ class Allowance {
   static_assert(
       std::numeric_limits<ValueType>::is_integer,
       "Allowance representation must be an integer type");
+  static_assert(
+      sizeof(ValueType) <= sizeof(size_t),
+      "Allowance representation must fit in a size_t");
   ValueType value_{0};
 };
+
+using Allowance = BasicAllowance<size_t>;
+
+/// The allowances kept per stream, in 32 bits like the REQUEST_N frames
+/// (see Frame_REQUEST_N::kMaxRequestN), as there can be millions of streams.
+using StreamAllowance = BasicAllowance<uint32_t>;
+
 } // reactivesocket
@@ -29,6 +29,10 @@ constexpr std::chrono::seconds kDefaultKeepaliveInterval{5};
 
 constexpr int64_t kMaxRequestN = std::numeric_limits<int32_t>::max();
 
+/// Largest frame the 24 bit frame length field of protocol 1.0 can carry, not
+/// counting the field.  The default limit of framed connections.
+constexpr size_t kMaxFrameLength = 0xFFFFFF;
+
 /// A unique identifier of a stream.
 using StreamId = uint32_t;
 
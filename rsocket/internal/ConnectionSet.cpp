@@ -2,12 +2,43 @@
 
 #include "rsocket/internal/ConnectionSet.h"
 
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/internal/ResumeStateTransfer.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
+#include <folly/hash/Hash.h>
 #include <folly/io/async/EventBase.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace rsocket {
 
+SharedMetadataPush::SharedMetadataPush(std::unique_ptr<folly::IOBuf> metadata)
+    : metadata_(std::move(metadata)) {}
+
+SharedMetadataPush::~SharedMetadataPush() = default;
+
+std::unique_ptr<folly::IOBuf> SharedMetadataPush::frame(
+    ProtocolVersion version) {
+  // Cloning marks the buffers as shared, so the clones are taken under the
+  // lock as well.
+  auto frames = frames_.lock();
+  for (auto& frame : *frames) {
+    if (frame.first == version) {
+      return frame.second->clone();
+    }
+  }
+  auto serializer = FrameSerializer::createFrameSerializer(version);
+  if (!serializer) {
+    return nullptr;
+  }
+  frames->emplace_back(
+      version,
+      serializer->serializeOut(Frame_METADATA_PUSH(metadata_->clone())));
+  return frames->back().second->clone();
+}
+
 ConnectionSet::ConnectionSet() {}
 
 ConnectionSet::~ConnectionSet() {
@@ -16,16 +47,21 @@ ConnectionSet::~ConnectionSet() {
 
   StateMachineMap map;
 
-  // Move all the connections out of the synchronized map so we don't block
+  // Move all the connections out of the synchronized maps so we don't block
   // while closing the state machines.
-  {
-    auto locked = machines_.lock();
-    if (locked->empty()) {
-      VLOG(2) << "No connections to close, early exit";
-      return;
+  for (auto& shard : shards_) {
+    auto locked = shard->lock();
+    if (map.empty()) {
+      map.swap(*locked);
+    } else {
+      map.insert(locked->begin(), locked->end());
+      locked->clear();
     }
+  }
 
-    map.swap(*locked);
+  if (map.empty()) {
+    VLOG(2) << "No connections to close, early exit";
+    return;
   }
 
   VLOG(2) << "Need to close " << map.size() << " connections";
@@ -53,13 +89,230 @@ ConnectionSet::~ConnectionSet() {
 void ConnectionSet::insert(
     std::shared_ptr<RSocketStateMachine> machine,
     folly::EventBase* evb) {
-  machines_.lock()->emplace(std::move(machine), evb);
+  shard(evb).lock()->emplace(std::move(machine), evb);
 }
 
 void ConnectionSet::remove(
-    const std::shared_ptr<RSocketStateMachine>& machine) {
-  auto locked = machines_.lock();
+    const std::shared_ptr<RSocketStateMachine>& machine,
+    folly::EventBase* evb) {
+  auto locked = shard(evb).lock();
   auto const result = locked->erase(machine);
   DCHECK_LE(result, 1);
 }
+
+folly::Future<folly::Unit> ConnectionSet::drain(
+    std::chrono::milliseconds timeout) {
+  // The machines stay in the set until they close, group them by EventBase
+  // to drain each group with a single hop.
+  auto groups = groupByEventBase();
+
+  VLOG(2) << "Draining connections on " << groups.size() << " EventBases";
+
+  std::vector<folly::Future<folly::Unit>> drained;
+  for (auto& group : groups) {
+    auto promise = std::make_shared<folly::Promise<folly::Unit>>();
+    drained.push_back(promise->getFuture());
+    group.first->runInEventBaseThread(
+        [machines = std::move(group.second), promise, timeout]() mutable {
+          // Only touched on this EventBase.
+          auto remaining = std::make_shared<size_t>(machines.size());
+          for (auto& machine : machines) {
+            machine->drain(timeout, [promise, remaining] {
+              if (--*remaining == 0) {
+                promise->setValue();
+              }
+            });
+          }
+        });
+  }
+
+  return folly::collectAll(drained).then(
+      [](std::vector<folly::Try<folly::Unit>>) {});
+}
+
+void ConnectionSet::metadataPush(std::shared_ptr<SharedMetadataPush> push) {
+  auto groups = groupByEventBase();
+  VLOG(2) << "Pushing metadata to connections on " << groups.size()
+          << " EventBases";
+
+  for (auto& group : groups) {
+    auto send = [ machines = std::move(group.second), push ] {
+      // Clones of the frame for this EventBase, by protocol version.
+      std::vector<std::pair<ProtocolVersion, std::unique_ptr<folly::IOBuf>>>
+          frames;
+      for (auto& machine : machines) {
+        auto const version = machine->protocolVersion();
+        if (!version) {
+          continue;
+        }
+        auto it = std::find_if(
+            frames.begin(), frames.end(), [&](const auto& frame) {
+              return frame.first == *version;
+            });
+        if (it == frames.end()) {
+          frames.emplace_back(*version, push->frame(*version));
+          it = frames.end() - 1;
+        }
+        if (it->second) {
+          machine->metadataPushSerialized(it->second->clone());
+        }
+      }
+    };
+
+    if (group.first->isInEventBaseThread()) {
+      send();
+    } else {
+      group.first->runInEventBaseThread(std::move(send));
+    }
+  }
+}
+
+folly::Future<std::vector<ConnectionSnapshot>> ConnectionSet::snapshot() {
+  auto groups = groupByEventBase();
+
+  std::vector<folly::Future<std::vector<ConnectionSnapshot>>> snapshots;
+  for (auto& group : groups) {
+    auto promise =
+        std::make_shared<folly::Promise<std::vector<ConnectionSnapshot>>>();
+    snapshots.push_back(promise->getFuture());
+    auto take = [ machines = std::move(group.second), promise ] {
+      std::vector<ConnectionSnapshot> taken;
+      taken.reserve(machines.size());
+      for (auto& machine : machines) {
+        taken.push_back(machine->snapshot());
+      }
+      promise->setValue(std::move(taken));
+    };
+
+    if (group.first->isInEventBaseThread()) {
+      take();
+    } else {
+      group.first->runInEventBaseThread(std::move(take));
+    }
+  }
+
+  return collectSnapshots(std::move(snapshots));
+}
+
+folly::Future<size_t> ConnectionSet::migrate(
+    folly::EventBase& from,
+    folly::EventBase& to,
+    size_t count) {
+  std::vector<std::shared_ptr<RSocketStateMachine>> machines;
+  {
+    auto locked = shard(&from).lock();
+    for (auto& kv : *locked) {
+      if (kv.second == &from) {
+        machines.push_back(kv.first);
+      }
+    }
+  }
+
+  VLOG(2) << "Moving the IO of up to " << count << " of " << machines.size()
+          << " connections from " << from.getName() << " to " << to.getName();
+
+  auto promise = std::make_shared<folly::Promise<size_t>>();
+  auto future = promise->getFuture();
+  auto move = [ machines = std::move(machines), &from, &to, count, promise ] {
+    size_t moved = 0;
+    for (auto& machine : machines) {
+      if (moved == count) {
+        break;
+      }
+      if (machine->migrateTransport(from, to)) {
+        ++moved;
+      }
+    }
+    promise->setValue(moved);
+  };
+
+  if (from.isInEventBaseThread()) {
+    move();
+  } else {
+    from.runInEventBaseThread(std::move(move));
+  }
+  return future;
+}
+
+folly::Future<std::vector<HandedOverConnection>> ConnectionSet::handOver() {
+  auto groups = groupByEventBase();
+
+  VLOG(2) << "Handing over connections on " << groups.size() << " EventBases";
+
+  std::vector<folly::Future<std::vector<HandedOverConnection>>> handedOver;
+  for (auto& group : groups) {
+    auto promise =
+        std::make_shared<folly::Promise<std::vector<HandedOverConnection>>>();
+    handedOver.push_back(promise->getFuture());
+    auto hand = [ machines = std::move(group.second), promise ] {
+      std::vector<HandedOverConnection> connections;
+      for (auto& machine : machines) {
+        ResumeStateTransfer state;
+        HandedOverSocket socket;
+        if (!machine->exportResumeState(state, &socket)) {
+          continue;
+        }
+        HandedOverConnection connection;
+        connection.state = state.serialize();
+        connection.fd = socket.fd;
+        connection.unread = socket.unread.move();
+        connections.push_back(std::move(connection));
+      }
+      promise->setValue(std::move(connections));
+    };
+
+    if (group.first->isInEventBaseThread()) {
+      hand();
+    } else {
+      group.first->runInEventBaseThread(std::move(hand));
+    }
+  }
+
+  return collectHandedOver(std::move(handedOver));
+}
+
+folly::Future<std::vector<HandedOverConnection>>
+ConnectionSet::collectHandedOver(
+    std::vector<folly::Future<std::vector<HandedOverConnection>>> groups) {
+  return folly::collectAll(groups).then(
+      [](std::vector<folly::Try<std::vector<HandedOverConnection>>> results) {
+        std::vector<HandedOverConnection> all;
+        for (auto& result : results) {
+          for (auto& connection : result.value()) {
+            all.push_back(std::move(connection));
+          }
+        }
+        return all;
+      });
+}
+
+folly::Future<std::vector<ConnectionSnapshot>> ConnectionSet::collectSnapshots(
+    std::vector<folly::Future<std::vector<ConnectionSnapshot>>> snapshots) {
+  return folly::collectAll(snapshots).then(
+      [](std::vector<folly::Try<std::vector<ConnectionSnapshot>>> results) {
+        std::vector<ConnectionSnapshot> all;
+        for (auto& result : results) {
+          for (auto& snapshot : result.value()) {
+            all.push_back(std::move(snapshot));
+          }
+        }
+        return all;
+      });
+}
+
+ConnectionSet::StateMachineGroups ConnectionSet::groupByEventBase() {
+  StateMachineGroups groups;
+  for (auto& shard : shards_) {
+    auto locked = shard->lock();
+    for (auto& kv : *locked) {
+      groups[kv.second].push_back(kv.first);
+    }
+  }
+  return groups;
+}
+
+ConnectionSet::Shard& ConnectionSet::shard(folly::EventBase* evb) {
+  auto const hash = folly::hash::twang_mix64(reinterpret_cast<uintptr_t>(evb));
+  return *shards_[hash % kShards];
+}
 }
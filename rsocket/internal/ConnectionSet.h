@@ -2,25 +2,60 @@
 
 #pragma once
 
+#include <folly/CachelinePadded.h>
 #include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
 
+#include <array>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rsocket/ConnectionSnapshot.h"
+#include "rsocket/HotRestart.h"
+#include "rsocket/internal/Common.h"
 
 namespace folly {
 class EventBase;
+class IOBuf;
 }
 
 namespace rsocket {
 
 class RSocketStateMachine;
 
+/// A METADATA_PUSH frame sent to many connections.  It is serialized once per
+/// protocol version and the connections get clones of it, sharing its buffer.
+/// Thread safe.
+class SharedMetadataPush {
+ public:
+  explicit SharedMetadataPush(std::unique_ptr<folly::IOBuf> metadata);
+  ~SharedMetadataPush();
+
+  /// Returns a clone of the frame serialized for `version`, or nullptr if the
+  /// version isn't supported.
+  std::unique_ptr<folly::IOBuf> frame(ProtocolVersion version);
+
+ private:
+  using Frames =
+      std::vector<std::pair<ProtocolVersion, std::unique_ptr<folly::IOBuf>>>;
+
+  const std::unique_ptr<folly::IOBuf> metadata_;
+  folly::Synchronized<Frames, std::mutex> frames_;
+};
+
 /// Set of RSocketStateMachine objects.  Stores them until they call
 /// RSocketStateMachine::close().
 ///
 /// Also tracks which EventBase is controlling each state machine so that they
 /// can be closed on the correct thread.
+///
+/// The state machines are sharded by their EventBase, each shard with its own
+/// lock, so connections coming and going on different EventBases don't
+/// contend.  Only the destructor visits all the shards.
 class ConnectionSet {
  public:
   ConnectionSet();
@@ -28,12 +63,61 @@ class ConnectionSet {
 
   void insert(std::shared_ptr<RSocketStateMachine>, folly::EventBase*);
 
-  void remove(const std::shared_ptr<RSocketStateMachine>&);
+  /// Removes a state machine, given the same EventBase it was inserted with.
+  void remove(const std::shared_ptr<RSocketStateMachine>&, folly::EventBase*);
+
+  /// Drains all the state machines in parallel, each on its own EventBase (see
+  /// RSocketStateMachine::drain()).  The future completes once all of them
+  /// have closed.
+  folly::Future<folly::Unit> drain(std::chrono::milliseconds timeout);
+
+  /// Sends the METADATA_PUSH frame to all the state machines, with one hop to
+  /// each EventBase for all of its state machines.  The frames of the state
+  /// machines on the calling thread's EventBase are sent inline.
+  void metadataPush(std::shared_ptr<SharedMetadataPush>);
+
+  /// Takes a snapshot of all the state machines, each on its own EventBase
+  /// with one hop to each of them, while they keep running.  The snapshots of
+  /// the state machines on the calling thread's EventBase are taken inline.
+  folly::Future<std::vector<ConnectionSnapshot>> snapshot();
+
+  /// Moves the IO of at most `count` of the state machines on `from` to `to`,
+  /// on `from`, see RSocketStateMachine::migrateTransport().  The future
+  /// completes with the number of connections moved.
+  folly::Future<size_t>
+  migrate(folly::EventBase& from, folly::EventBase& to, size_t count);
+
+  /// Hands all the resumable state machines over to another process of this
+  /// host and closes them, each on its own EventBase, see
+  /// RSocketStateMachine::exportResumeState().  The others keep running.
+  folly::Future<std::vector<HandedOverConnection>> handOver();
+
+  /// Concatenates the connections handed over by several groups of state
+  /// machines.
+  static folly::Future<std::vector<HandedOverConnection>> collectHandedOver(
+      std::vector<folly::Future<std::vector<HandedOverConnection>>> groups);
+
+  /// Concatenates the snapshots of several groups of state machines.
+  static folly::Future<std::vector<ConnectionSnapshot>> collectSnapshots(
+      std::vector<folly::Future<std::vector<ConnectionSnapshot>>> snapshots);
 
  private:
   using StateMachineMap = std::
       unordered_map<std::shared_ptr<RSocketStateMachine>, folly::EventBase*>;
+  using StateMachineGroups = std::unordered_map<
+      folly::EventBase*,
+      std::vector<std::shared_ptr<RSocketStateMachine>>>;
+
+  /// Groups the state machines by their EventBase.
+  StateMachineGroups groupByEventBase();
+  using Shard = folly::Synchronized<StateMachineMap, std::mutex>;
+
+  /// Enough shards for every worker EventBase of a server to (most likely) get
+  /// its own.
+  static constexpr size_t kShards = 64;
+
+  Shard& shard(folly::EventBase*);
 
-  folly::Synchronized<StateMachineMap, std::mutex> machines_;
+  std::array<folly::CachelinePadded<Shard>, kShards> shards_;
 };
 }
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace rsocket {
+
+/// The timestamp counter of the CPU, which ticks at its nominal frequency.
+/// Nanoseconds of the steady clock where there is none.
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/// Cycles a connection spent on its EventBase, counted by Scopes around the
+/// entry points of its work: reading frames, which includes dispatching them
+/// to the responder, and writing frames.  Only the outermost of nested scopes
+/// counts, so each cycle is counted once.  Does nothing unless enabled, beyond
+/// a branch per scope.
+///
+/// Not thread-safe, used on the EventBase of the connection.
+class CpuAccount {
+ public:
+  class Scope {
+   public:
+    explicit Scope(CpuAccount& account) {
+      if (!account.enabled_) {
+        return;
+      }
+      account_ = &account;
+      if (account.depth_++ == 0) {
+        start_ = readCycleCounter();
+      }
+    }
+
+    ~Scope() {
+      if (account_ && --account_->depth_ == 0) {
+        account_->cycles_ += readCycleCounter() - start_;
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    CpuAccount* account_{nullptr};
+    uint64_t start_{0};
+  };
+
+  explicit CpuAccount(bool enabled) : enabled_{enabled} {}
+
+  bool enabled() const {
+    return enabled_;
+  }
+
+  uint64_t cycles() const {
+    return cycles_;
+  }
+
+ private:
+  const bool enabled_;
+  uint32_t depth_{0};
+  uint64_t cycles_{0};
+};
+
+} // namespace rsocket
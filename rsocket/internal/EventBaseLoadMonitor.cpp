@@ -0,0 +1,60 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/EventBaseLoadMonitor.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+EventBaseLoadMonitor::EventBaseLoadMonitor(
+    folly::EventBase& eventBase,
+    LoadSheddingOptions options,
+    std::shared_ptr<RSocketStats> stats)
+    : folly::AsyncTimeout(&eventBase),
+      eventBase_(eventBase),
+      options_(options),
+      stats_(stats ? std::move(stats) : RSocketStats::noop()),
+      load_(std::make_shared<EventBaseLoad>()) {
+  scheduleProbe();
+}
+
+EventBaseLoadMonitor::~EventBaseLoadMonitor() {
+  // The connections keep the load, they must not shed it forever.
+  load_->overloaded = false;
+}
+
+void EventBaseLoadMonitor::scheduleProbe() {
+  auto const interval =
+      std::max(options_.probeInterval, std::chrono::milliseconds(1));
+  due_ = Clock::now() + interval;
+  scheduleTimeout(static_cast<uint32_t>(interval.count()));
+}
+
+void EventBaseLoadMonitor::timeoutExpired() noexcept {
+  auto& load = *load_;
+  load.loopLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::max(Clock::now() - due_, Clock::duration(0)));
+  load.queuedTasks = eventBase_.getNotificationQueueSize();
+
+  // Once overloaded, the load has to go back below half of the limits.
+  auto const divisor = load.overloaded ? 2 : 1;
+  auto const latencyExceeded = options_.maxLoopLatency.count() > 0 &&
+      load.loopLatency * divisor > options_.maxLoopLatency;
+  auto const queueExceeded = options_.maxQueuedTasks > 0 &&
+      load.queuedTasks * divisor > options_.maxQueuedTasks;
+  auto const overloaded = latencyExceeded || queueExceeded;
+  if (overloaded != load.overloaded) {
+    VLOG(1) << (overloaded ? "Shedding load" : "Stopped shedding load")
+            << ", loop latency " << load.loopLatency.count() << "us, "
+            << load.queuedTasks << " queued tasks";
+    load.overloaded = overloaded;
+    stats_->eventBaseOverloaded(
+        overloaded, load.loopLatency, load.queuedTasks);
+  }
+  scheduleProbe();
+}
+}
@@ -0,0 +1,60 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/RSocketParameters.h"
+
+namespace rsocket {
+
+class RSocketStats;
+
+/// The load of an EventBase, as measured by the last probe of its
+/// EventBaseLoadMonitor.  Only used on the thread of the EventBase.
+struct EventBaseLoad {
+  /// How late the probe ran.
+  std::chrono::microseconds loopLatency{0};
+  /// Tasks queued with runInEventBaseThread() when the probe ran.
+  size_t queuedTasks{0};
+  /// Whether the EventBase sheds load, see LoadSheddingOptions.
+  bool overloaded{false};
+};
+
+/// Probes the load of an EventBase every LoadSheddingOptions::probeInterval,
+/// with a timeout of its own.  A probe measures how late the timeout fires
+/// and how many tasks wait in the queue of the EventBase, so it costs one
+/// timeout per interval however many connections the EventBase has.  The
+/// connections look at the EventBaseLoad, which outlives the monitor.
+///
+/// Must only be used from the thread of its EventBase.
+class EventBaseLoadMonitor : private folly::AsyncTimeout {
+ public:
+  EventBaseLoadMonitor(
+      folly::EventBase& eventBase,
+      LoadSheddingOptions options,
+      std::shared_ptr<RSocketStats> stats);
+  ~EventBaseLoadMonitor();
+
+  std::shared_ptr<const EventBaseLoad> load() const {
+    return load_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  void timeoutExpired() noexcept override;
+  void scheduleProbe();
+
+  folly::EventBase& eventBase_;
+  const LoadSheddingOptions options_;
+  const std::shared_ptr<RSocketStats> stats_;
+  const std::shared_ptr<EventBaseLoad> load_;
+  /// When the scheduled probe is due.
+  Clock::time_point due_;
+};
+}
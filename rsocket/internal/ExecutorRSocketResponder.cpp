@@ -0,0 +1,237 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/ExecutorRSocketResponder.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/RSocketException.h"
+#include "rsocket/internal/ScheduledSingleObserver.h"
+#include "rsocket/internal/ScheduledSubscriber.h"
+#include "rsocket/metadata/RequestTimeout.h"
+
+namespace rsocket {
+
+namespace {
+constexpr auto kQueueFull = "Responder queue is full";
+constexpr auto kExpired = "Request deadline passed before it was handled";
+
+/// The time until which the requester waits for `request`, if it said so.
+folly::Optional<ResponderExecutor::Clock::time_point> deadline(
+    const Payload& request) {
+  if (!request.metadata) {
+    return folly::none;
+  }
+  auto const timeout = findRequestTimeout(*request.metadata);
+  if (!timeout) {
+    return folly::none;
+  }
+  return ResponderExecutor::Clock::now() + *timeout;
+}
+
+/// Fails a request-response whose deadline passed, on its EventBase.
+ResponderExecutor::Func expiredResponse(
+    yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer,
+    folly::EventBase& eventBase) {
+  return [ observer = std::move(observer), eventBase = &eventBase ]() mutable {
+    auto scheduled = yarpl::make_ref<ScheduledSingleObserver<Payload>>(
+        std::move(observer), *eventBase);
+    scheduled->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+    scheduled->onError(RSocketException(kExpired));
+  };
+}
+
+/// Fails a stream or channel whose deadline passed, on its EventBase.
+ResponderExecutor::Func expiredStream(
+    yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber,
+    folly::EventBase& eventBase) {
+  return [ subscriber = std::move(subscriber),
+           eventBase = &eventBase ]() mutable {
+    auto scheduled = yarpl::make_ref<ScheduledSubscriber<Payload>>(
+        std::move(subscriber), *eventBase);
+    scheduled->onSubscribe(yarpl::flowable::Subscription::empty());
+    scheduled->onError(RSocketException(kExpired));
+  };
+}
+}
+
+ExecutorRSocketResponder::ExecutorRSocketResponder(
+    std::shared_ptr<RSocketResponder> inner,
+    std::shared_ptr<ResponderExecutor::Queue> queue,
+    folly::EventBase& eventBase)
+    : inner_(std::move(inner)),
+      queue_(std::move(queue)),
+      eventBase_(eventBase) {}
+
+bool ExecutorRSocketResponder::acceptRequest(
+    StreamType streamType,
+    const MetadataView& metadata,
+    StreamId streamId) {
+  // The state machine sends REJECTED for a request which isn't accepted.
+  return !queue_->full() &&
+      inner_->acceptRequest(streamType, metadata, streamId);
+}
+
+yarpl::Reference<yarpl::single::Single<Payload>>
+ExecutorRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  auto const requestDeadline = deadline(request);
+  return yarpl::single::Singles::create<Payload>([
+    inner = inner_,
+    queue = queue_,
+    eventBase = &eventBase_,
+    request = std::move(request),
+    requestDeadline,
+    streamId
+  ](yarpl::Reference<yarpl::single::SingleObserver<Payload>> observer) mutable {
+    auto added = queue->add(
+        [
+          inner,
+          eventBase,
+          request = std::move(request),
+          streamId,
+          observer
+        ]() mutable {
+          inner->handleRequestResponse(std::move(request), streamId)
+              ->subscribe(yarpl::make_ref<ScheduledSingleObserver<Payload>>(
+                  std::move(observer), *eventBase));
+        },
+        StreamPriority::Class::INTERACTIVE,
+        requestDeadline,
+        expiredResponse(observer, *eventBase));
+    if (!added) {
+      observer->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+      observer->onError(RSocketException(kQueueFull));
+    }
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+ExecutorRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  auto const requestDeadline = deadline(request);
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    inner = inner_,
+    queue = queue_,
+    eventBase = &eventBase_,
+    request = std::move(request),
+    requestDeadline,
+    streamId
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    auto added = queue->add(
+        [
+          inner,
+          eventBase,
+          request = std::move(request),
+          streamId,
+          subscriber
+        ]() mutable {
+          inner->handleRequestStream(std::move(request), streamId)
+              ->subscribe(yarpl::make_ref<ScheduledSubscriber<Payload>>(
+                  std::move(subscriber), *eventBase));
+        },
+        StreamPriority::Class::BULK,
+        requestDeadline,
+        expiredStream(subscriber, *eventBase));
+    if (!added) {
+      subscriber->onSubscribe(yarpl::flowable::Subscription::empty());
+      subscriber->onError(RSocketException(kQueueFull));
+    }
+  });
+}
+
+yarpl::Reference<yarpl::flowable::Flowable<Payload>>
+ExecutorRSocketResponder::handleRequestChannel(
+    Payload request,
+    yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  auto requestStreamFlowable =
+      yarpl::flowable::Flowables::fromPublisher<Payload>(
+          [ requestStream = std::move(requestStream),
+            eventBase = &eventBase_ ](
+              yarpl::Reference<yarpl::flowable::Subscriber<Payload>>
+                  subscriber) {
+            requestStream->subscribe(
+                yarpl::make_ref<ScheduledSubscriptionSubscriber<Payload>>(
+                    std::move(subscriber), *eventBase));
+          });
+  auto const requestDeadline = deadline(request);
+  return yarpl::flowable::Flowables::fromPublisher<Payload>([
+    inner = inner_,
+    queue = queue_,
+    eventBase = &eventBase_,
+    request = std::move(request),
+    requestStream = std::move(requestStreamFlowable),
+    requestDeadline,
+    streamId
+  ](yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber) mutable {
+    auto added = queue->add(
+        [
+          inner,
+          eventBase,
+          request = std::move(request),
+          requestStream,
+          streamId,
+          subscriber
+        ]() mutable {
+          inner
+              ->handleRequestChannel(
+                  std::move(request), std::move(requestStream), streamId)
+              ->subscribe(yarpl::make_ref<ScheduledSubscriber<Payload>>(
+                  std::move(subscriber), *eventBase));
+        },
+        StreamPriority::Class::BULK,
+        requestDeadline,
+        expiredStream(subscriber, *eventBase));
+    if (!added) {
+      subscriber->onSubscribe(yarpl::flowable::Subscription::empty());
+      subscriber->onError(RSocketException(kQueueFull));
+    }
+  });
+}
+
+void ExecutorRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  auto added = queue_->add(
+      [ inner = inner_, request = std::move(request), streamId ]() mutable {
+        inner->handleFireAndForget(std::move(request), streamId);
+      },
+      StreamPriority::Class::BULK);
+  if (!added) {
+    VLOG(2) << "Dropping fire-and-forget " << streamId << ", "
+            << kQueueFull;
+  }
+}
+
+bool ExecutorRSocketResponder::batchesFireAndForget() const {
+  return inner_->batchesFireAndForget();
+}
+
+void ExecutorRSocketResponder::handleFireAndForgetBatch(
+    std::vector<std::pair<Payload, StreamId>> requests) {
+  auto const size = requests.size();
+  auto added = queue_->add(
+      [ inner = inner_, requests = std::move(requests) ]() mutable {
+        inner->handleFireAndForgetBatch(std::move(requests));
+      },
+      StreamPriority::Class::BULK);
+  if (!added) {
+    VLOG(2) << "Dropping " << size << " fire-and-forgets, " << kQueueFull;
+  }
+}
+
+void ExecutorRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  auto added = queue_->add(
+      [ inner = inner_, metadata = std::move(metadata) ]() mutable {
+        inner->handleMetadataPush(std::move(metadata));
+      },
+      StreamPriority::Class::INTERACTIVE);
+  if (!added) {
+    VLOG(2) << "Dropping metadata push, " << kQueueFull;
+  }
+}
+
+} // rsocket
@@ -0,0 +1,63 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/ResponderExecutor.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+//
+// A decorated RSocketResponder object which calls the application code on the
+// threads of a ResponderExecutor, from the queue of its connection, and
+// schedules the calls from application code to RSocket on the provided
+// EventBase.  The requests which find the queue full are rejected.  The
+// request timeouts in the metadata give the deadlines of the tasks, see
+// ResponderExecutor::Options::earliestDeadlineFirst.
+//
+class ExecutorRSocketResponder : public RSocketResponder {
+ public:
+  ExecutorRSocketResponder(
+      std::shared_ptr<RSocketResponder> inner,
+      std::shared_ptr<ResponderExecutor::Queue> queue,
+      folly::EventBase& eventBase);
+
+  bool acceptRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      yarpl::Reference<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  bool batchesFireAndForget() const override;
+
+  /// Runs the batch in one task.
+  void handleFireAndForgetBatch(
+      std::vector<std::pair<Payload, StreamId>> requests) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+ private:
+  const std::shared_ptr<RSocketResponder> inner_;
+  const std::shared_ptr<ResponderExecutor::Queue> queue_;
+  folly::EventBase& eventBase_;
+};
+
+} // rsocket
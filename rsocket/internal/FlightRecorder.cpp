@@ -0,0 +1,178 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/FlightRecorder.h"
+
+#include <algorithm>
+#include <ostream>
+
+#include <folly/Bits.h>
+#include <folly/ThreadLocal.h>
+
+namespace rsocket {
+
+constexpr size_t FlightRecorder::kEventsPerThread;
+std::atomic<bool> FlightRecorder::dumpOnConnectionError_{false};
+
+namespace {
+static_assert(
+    folly::isPowTwo(FlightRecorder::kEventsPerThread),
+    "kEventsPerThread must be a power of two");
+
+/// The events of one thread.  Only the thread writes them, the others read
+/// them like a seqlock: an event they copied is valid if the thread hadn't
+/// started overwriting it by the time they were done.
+struct Ring {
+  static constexpr size_t kMask = FlightRecorder::kEventsPerThread - 1;
+
+  /// An event packed in 4 words.
+  struct Slot {
+    std::atomic<uint64_t> timestamp;
+    std::atomic<uint64_t> connection;
+    /// Stream id and length.
+    std::atomic<uint64_t> stream;
+    /// Type, flags and direction.
+    std::atomic<uint64_t> frame;
+  };
+
+  Ring() {
+    for (auto& slot : slots) {
+      slot.timestamp.store(0, std::memory_order_relaxed);
+      slot.connection.store(0, std::memory_order_relaxed);
+      slot.stream.store(0, std::memory_order_relaxed);
+      slot.frame.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(const FlightRecorder::Event& event) {
+    auto const position = recorded.load(std::memory_order_relaxed);
+    started.store(position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& slot = slots[position & kMask];
+    slot.timestamp.store(event.timestamp.count(), std::memory_order_relaxed);
+    slot.connection.store(
+        reinterpret_cast<uintptr_t>(event.connection),
+        std::memory_order_relaxed);
+    slot.stream.store(
+        (uint64_t(event.streamId) << 32) | event.length,
+        std::memory_order_relaxed);
+    slot.frame.store(
+        uint64_t(event.type) | (uint64_t(event.flags) << 8) |
+            (uint64_t(event.written) << 24),
+        std::memory_order_relaxed);
+    recorded.store(position + 1, std::memory_order_release);
+  }
+
+  /// Appends the events of the ring which `filter` accepts.
+  template <typename Filter>
+  void copyTo(std::vector<FlightRecorder::Event>& events, Filter filter)
+      const {
+    auto const end = recorded.load(std::memory_order_acquire);
+    auto const begin = end > kMask ? end - kMask - 1 : 0;
+    auto const first = events.size();
+    for (auto i = begin; i < end; ++i) {
+      auto& slot = slots[i & kMask];
+      FlightRecorder::Event event;
+      event.timestamp = std::chrono::nanoseconds(
+          slot.timestamp.load(std::memory_order_relaxed));
+      event.connection = reinterpret_cast<const void*>(static_cast<uintptr_t>(
+          slot.connection.load(std::memory_order_relaxed)));
+      auto const stream = slot.stream.load(std::memory_order_relaxed);
+      event.streamId = static_cast<StreamId>(stream >> 32);
+      event.length = static_cast<uint32_t>(stream);
+      auto const frame = slot.frame.load(std::memory_order_relaxed);
+      event.type = static_cast<FrameType>(frame & 0xff);
+      event.flags = static_cast<FrameFlags>((frame >> 8) & 0xffff);
+      event.written = (frame >> 24) & 1;
+      events.push_back(event);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // The events the thread started overwriting meanwhile are left out.
+    auto const overwritten = started.load(std::memory_order_relaxed);
+    auto const valid = overwritten > kMask ? overwritten - kMask - 1 : 0;
+    auto const skip = std::min<uint64_t>(
+        valid > begin ? valid - begin : 0, events.size() - first);
+    auto out = events.begin() + first;
+    for (auto in = out + skip; in != events.end(); ++in) {
+      if (filter(*in)) {
+        *out++ = *in;
+      }
+    }
+    events.erase(out, events.end());
+  }
+
+  Slot slots[FlightRecorder::kEventsPerThread];
+  /// Events recorded so far.
+  std::atomic<uint64_t> recorded{0};
+  /// Events whose recording started, one more than `recorded` while one is
+  /// being recorded.
+  std::atomic<uint64_t> started{0};
+};
+
+struct RingTag {};
+
+folly::ThreadLocal<Ring, RingTag>& rings() {
+  static auto rings = new folly::ThreadLocal<Ring, RingTag>();
+  return *rings;
+}
+
+void sortByTime(std::vector<FlightRecorder::Event>& events) {
+  std::stable_sort(
+      events.begin(),
+      events.end(),
+      [](const FlightRecorder::Event& a, const FlightRecorder::Event& b) {
+        return a.timestamp < b.timestamp;
+      });
+}
+} // namespace
+
+void FlightRecorder::record(
+    const void* connection,
+    StreamId streamId,
+    FrameType type,
+    FrameFlags flags,
+    size_t length,
+    bool written) {
+  Event event;
+  event.timestamp = std::chrono::steady_clock::now().time_since_epoch();
+  event.connection = connection;
+  event.streamId = streamId;
+  event.length = static_cast<uint32_t>(length);
+  event.type = type;
+  event.flags = flags;
+  event.written = written;
+  rings()->record(event);
+}
+
+std::vector<FlightRecorder::Event> FlightRecorder::dump() {
+  std::vector<Event> events;
+  {
+    auto accessor = rings().accessAllThreads();
+    for (const auto& ring : accessor) {
+      ring.copyTo(events, [](const Event&) { return true; });
+    }
+  }
+  sortByTime(events);
+  return events;
+}
+
+std::vector<FlightRecorder::Event> FlightRecorder::dumpThread(
+    const void* connection) {
+  std::vector<Event> events;
+  rings()->copyTo(events, [connection](const Event& event) {
+    return event.connection == connection;
+  });
+  return events;
+}
+
+std::ostream& operator<<(
+    std::ostream& os,
+    const FlightRecorder::Event& event) {
+  return os << event.timestamp.count() << "ns " << event.connection
+            << (event.written ? " Out: " : " In: ") << event.type
+            << " stream " << event.streamId << " flags " << event.flags
+            << ", " << event.length << " bytes";
+}
+
+} // namespace rsocket
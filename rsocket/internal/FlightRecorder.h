@@ -0,0 +1,89 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "rsocket/framing/FrameFlags.h"
+#include "rsocket/framing/FrameType.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// The last frames each thread read and wrote, for all the connections of the
+/// process, to find out what led to an incident without running with verbose
+/// logging.  Always on: recording an event is a few relaxed stores into a ring
+/// buffer of the thread, which no other thread writes.
+///
+/// dump() copies the rings of all the threads without stopping them, the
+/// events being overwritten while they are copied are left out.  The rings of
+/// the threads which exited are dropped.  The events of a connection are dumped
+/// to the log when it closes with a CONNECTION_ERROR once
+/// setDumpOnConnectionError() is set.
+class FlightRecorder {
+ public:
+  /// Events kept per thread, a power of two.
+  static constexpr size_t kEventsPerThread = 4096;
+
+  struct Event {
+    /// steady_clock time since its epoch.
+    std::chrono::nanoseconds timestamp{0};
+    /// The RSocketStateMachine the frame is of.
+    const void* connection{nullptr};
+    StreamId streamId{0};
+    uint32_t length{0};
+    FrameType type{FrameType::RESERVED};
+    FrameFlags flags{FrameFlags::EMPTY};
+    bool written{false};
+  };
+
+  static void recordRead(
+      const void* connection,
+      StreamId streamId,
+      FrameType type,
+      FrameFlags flags,
+      size_t length) {
+    record(connection, streamId, type, flags, length, false);
+  }
+
+  static void recordWritten(
+      const void* connection,
+      StreamId streamId,
+      FrameType type,
+      FrameFlags flags,
+      size_t length) {
+    record(connection, streamId, type, flags, length, true);
+  }
+
+  /// The events of all the threads, oldest first.
+  static std::vector<Event> dump();
+
+  /// The events of `connection` recorded by the calling thread, oldest first.
+  static std::vector<Event> dumpThread(const void* connection);
+
+  static void setDumpOnConnectionError(bool dump) {
+    dumpOnConnectionError_.store(dump, std::memory_order_relaxed);
+  }
+  static bool dumpOnConnectionError() {
+    return dumpOnConnectionError_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static void record(
+      const void* connection,
+      StreamId streamId,
+      FrameType type,
+      FrameFlags flags,
+      size_t length,
+      bool written);
+
+  static std::atomic<bool> dumpOnConnectionError_;
+};
+
+std::ostream& operator<<(std::ostream&, const FlightRecorder::Event&);
+
+} // namespace rsocket
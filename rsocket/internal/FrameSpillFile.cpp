@@ -0,0 +1,96 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/FrameSpillFile.h"
+
+#include <unistd.h>
+#include <limits>
+
+#include <folly/FileUtil.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+/// Each frame is stored as its length followed by its bytes.
+using FrameLength = uint32_t;
+} // namespace
+
+bool FrameSpillFile::push(const folly::IOBuf& frame) {
+  if (!file_) {
+    try {
+      file_ = folly::File::temporary();
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Can't create frame spill file: " << ex.what();
+      return false;
+    }
+  }
+
+  auto const length = frame.computeChainDataLength();
+  if (length > std::numeric_limits<FrameLength>::max()) {
+    return false;
+  }
+  auto offset = writeOffset_;
+  auto const frameLength = static_cast<FrameLength>(length);
+  if (folly::pwriteFull(file_.fd(), &frameLength, sizeof(frameLength), offset) <
+      0) {
+    PLOG(ERROR) << "Can't write frame spill file";
+    return false;
+  }
+  offset += sizeof(frameLength);
+  for (auto range : frame) {
+    if (folly::pwriteFull(file_.fd(), range.data(), range.size(), offset) < 0) {
+      PLOG(ERROR) << "Can't write frame spill file";
+      return false;
+    }
+    offset += range.size();
+  }
+
+  writeOffset_ = offset;
+  ++numFrames_;
+  return true;
+}
+
+std::unique_ptr<folly::IOBuf> FrameSpillFile::pop() {
+  if (empty()) {
+    return nullptr;
+  }
+
+  FrameLength frameLength;
+  if (folly::preadFull(
+          file_.fd(), &frameLength, sizeof(frameLength), readOffset_) !=
+      sizeof(frameLength)) {
+    PLOG(ERROR) << "Can't read frame spill file, dropping " << numFrames_
+                << " frames";
+    clear();
+    return nullptr;
+  }
+  auto frame = folly::IOBuf::create(frameLength);
+  if (folly::preadFull(
+          file_.fd(),
+          frame->writableData(),
+          frameLength,
+          readOffset_ + sizeof(frameLength)) != frameLength) {
+    PLOG(ERROR) << "Can't read frame spill file, dropping " << numFrames_
+                << " frames";
+    clear();
+    return nullptr;
+  }
+  frame->append(frameLength);
+
+  readOffset_ += sizeof(frameLength) + frameLength;
+  if (--numFrames_ == 0) {
+    clear();
+  }
+  return frame;
+}
+
+void FrameSpillFile::clear() {
+  numFrames_ = 0;
+  readOffset_ = 0;
+  writeOffset_ = 0;
+  if (file_ && ::ftruncate(file_.fd(), 0) != 0) {
+    PLOG(ERROR) << "Can't truncate frame spill file";
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,43 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <sys/types.h>
+#include <memory>
+
+#include <folly/File.h>
+#include <folly/io/IOBuf.h>
+
+namespace rsocket {
+
+/// FIFO of serialized frames stored in an unlinked temporary file, which is
+/// created on the first push.  The file is truncated whenever it empties.
+class FrameSpillFile {
+ public:
+  /// Appends a frame.  Returns false if it couldn't be written, in which case
+  /// the file is left unchanged.
+  bool push(const folly::IOBuf& frame);
+
+  /// Removes and returns the oldest frame, or nullptr if the file is empty.
+  /// Frames which can't be read back are lost, along with all the frames
+  /// after them.
+  std::unique_ptr<folly::IOBuf> pop();
+
+  bool empty() const {
+    return numFrames_ == 0;
+  }
+
+  size_t size() const {
+    return numFrames_;
+  }
+
+ private:
+  void clear();
+
+  folly::File file_;
+  off_t readOffset_{0};
+  off_t writeOffset_{0};
+  size_t numFrames_{0};
+};
+
+} // namespace rsocket
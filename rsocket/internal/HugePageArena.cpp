@@ -0,0 +1,154 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/HugePageArena.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <folly/portability/SysMman.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+constexpr size_t HugePageArena::kRegionSize;
+
+namespace {
+constexpr size_t kBlockAlignment = 64;
+
+size_t roundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+/// Maps a region aligned on kRegionSize, for transparent huge pages to be
+/// able to back all of it.
+void* mapAligned() {
+  auto const size = 2 * HugePageArena::kRegionSize;
+  auto mapped = ::mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  auto const begin = reinterpret_cast<uintptr_t>(mapped);
+  auto const aligned = roundUp(begin, HugePageArena::kRegionSize);
+  if (aligned > begin) {
+    ::munmap(mapped, aligned - begin);
+  }
+  auto const end = aligned + HugePageArena::kRegionSize;
+  if (begin + size > end) {
+    ::munmap(reinterpret_cast<void*>(end), begin + size - end);
+  }
+  auto region = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+  ::madvise(region, HugePageArena::kRegionSize, MADV_HUGEPAGE);
+#endif
+  return region;
+}
+} // namespace
+
+HugePageArena::HugePageArena(size_t blockSize)
+    : blockSize_(roundUp(blockSize, kBlockAlignment)) {
+  CHECK_GT(blockSize_, 0U);
+  CHECK_LE(blockSize_, kRegionSize);
+}
+
+HugePageArena::~HugePageArena() {
+  for (auto& region : regions_) {
+    ::munmap(region.address, kRegionSize);
+  }
+}
+
+void* HugePageArena::allocate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_.empty() && !grow()) {
+    return nullptr;
+  }
+  auto block = free_.back();
+  free_.pop_back();
+  return block;
+}
+
+void HugePageArena::free(void* block) {
+  DCHECK(block);
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_.push_back(block);
+}
+
+bool HugePageArena::owns(const void* block) const {
+  auto const address = static_cast<const uint8_t*>(block);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto next = std::upper_bound(
+      regions_.begin(),
+      regions_.end(),
+      address,
+      [](const uint8_t* address, const Region& region) {
+        return address < static_cast<const uint8_t*>(region.address);
+      });
+  if (next == regions_.begin()) {
+    return false;
+  }
+  auto const base = static_cast<const uint8_t*>(std::prev(next)->address);
+  return address < base + kRegionSize;
+}
+
+size_t HugePageArena::regions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return regions_.size();
+}
+
+size_t HugePageArena::hugetlbRegions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (auto& region : regions_) {
+    count += region.hugetlb;
+  }
+  return count;
+}
+
+bool HugePageArena::grow() {
+  if (exhausted_) {
+    return false;
+  }
+
+  Region region{nullptr, false};
+#ifdef MAP_HUGETLB
+  auto mapped = ::mmap(
+      nullptr,
+      kRegionSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+      -1,
+      0);
+  if (mapped != MAP_FAILED) {
+    region = Region{mapped, true};
+  }
+#endif
+  if (!region.address) {
+    region.address = mapAligned();
+  }
+  if (!region.address) {
+    LOG(WARNING) << "Can't map huge page regions anymore, using the heap";
+    exhausted_ = true;
+    return false;
+  }
+
+  auto position = std::upper_bound(
+      regions_.begin(),
+      regions_.end(),
+      region,
+      [](const Region& a, const Region& b) { return a.address < b.address; });
+  regions_.insert(position, region);
+  auto const blocks = kRegionSize / blockSize_;
+  auto base = static_cast<uint8_t*>(region.address);
+  // In reverse, so that the blocks are handed out in address order.
+  for (size_t i = blocks; i > 0; --i) {
+    free_.push_back(base + (i - 1) * blockSize_);
+  }
+  return true;
+}
+
+} // namespace rsocket
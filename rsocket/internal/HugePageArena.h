@@ -0,0 +1,74 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsocket {
+
+/// Hands out fixed size blocks carved from 2MB regions backed by huge pages,
+/// so that buffers touched across many connections cost fewer TLB entries.
+///
+/// A region is mapped with MAP_HUGETLB from the reserved huge pages if there
+/// are any, and otherwise mapped normally with madvise(MADV_HUGEPAGE), for
+/// transparent huge pages to back it if they are enabled.  allocate() returns
+/// nullptr once no region can be mapped at all, or on platforms without mmap,
+/// and callers then fall back to the heap.
+///
+/// Freed blocks are kept for reuse, the regions are only unmapped with the
+/// arena.  Thread safe.
+class HugePageArena {
+ public:
+  static constexpr size_t kRegionSize = 2 * 1024 * 1024;
+
+  /// `blockSize` is rounded up to a multiple of 64 bytes, and must not exceed
+  /// kRegionSize.
+  explicit HugePageArena(size_t blockSize);
+  ~HugePageArena();
+
+  HugePageArena(const HugePageArena&) = delete;
+  HugePageArena& operator=(const HugePageArena&) = delete;
+
+  size_t blockSize() const {
+    return blockSize_;
+  }
+
+  /// Returns a block of blockSize() bytes, or nullptr if no more memory could
+  /// be mapped.
+  void* allocate();
+
+  /// Takes back a block allocate() returned.
+  void free(void* block);
+
+  /// Whether `block` was allocated from the arena, for callers which mix its
+  /// blocks with heap ones.
+  bool owns(const void* block) const;
+
+  /// Number of regions mapped, and how many of them come from the reserved
+  /// huge pages.
+  size_t regions() const;
+  size_t hugetlbRegions() const;
+
+ private:
+  struct Region {
+    void* address;
+    bool hugetlb;
+  };
+
+  /// Maps a region and adds its blocks to free_.  Returns false if it can't.
+  bool grow();
+
+  const size_t blockSize_;
+
+  mutable std::mutex mutex_;
+  /// Sorted by address.
+  std::vector<Region> regions_;
+  std::vector<void*> free_;
+  /// Set once mapping a region failed, so that it isn't tried again.
+  bool exhausted_{false};
+};
+
+} // namespace rsocket
@@ -7,9 +7,7 @@ namespace rsocket {
 KeepaliveTimer::KeepaliveTimer(
     std::chrono::milliseconds period,
     folly::EventBase& eventBase)
-    : eventBase_(eventBase),
-      generation_(std::make_shared<uint32_t>(0)),
-      period_(period) {}
+    : wheel_(TimingWheel::get(eventBase)), period_(period) {}
 
 KeepaliveTimer::~KeepaliveTimer() {
   stop();
@@ -20,18 +18,22 @@ std::chrono::milliseconds KeepaliveTimer::keepaliveTime() {
 }
 
 void KeepaliveTimer::schedule() {
-  auto scheduledGeneration = *generation_;
-  auto generation = generation_;
-  eventBase_.runAfterDelay(
-      [this, generation, scheduledGeneration]() {
-        if (*generation == scheduledGeneration) {
-          sendKeepalive();
-        }
-      },
-      static_cast<uint32_t>(keepaliveTime().count()));
+  wheel_.cancel(handle_);
+  handle_ = wheel_.schedule(keepaliveTime(), [this] {
+    handle_ = TimingWheel::Handle();
+    sendKeepalive();
+  });
 }
 
 void KeepaliveTimer::sendKeepalive() {
+  if (onlyWhenIdle_ && frameReceived_) {
+    // The connection isn't idle, and the peer is alive.
+    frameReceived_ = false;
+    pending_ = false;
+    schedule();
+    return;
+  }
+  frameReceived_ = false;
   if (pending_) {
     // Make sure connection_ is not deleted (via external call to stop)
     // while we still mid-operation
@@ -49,7 +51,12 @@ void KeepaliveTimer::sendKeepalive() {
 
 // must be called from the same thread as start
 void KeepaliveTimer::stop() {
-  *generation_ += 1;
+  // A stopped timer doesn't touch the wheel, which goes away with the
+  // EventBase.
+  if (handle_.id != 0) {
+    wheel_.cancel(handle_);
+    handle_ = TimingWheel::Handle();
+  }
   pending_ = false;
   connection_ = nullptr;
 }
@@ -57,8 +64,8 @@ void KeepaliveTimer::stop() {
 // must be called from the same thread as stop
 void KeepaliveTimer::start(const std::shared_ptr<FrameSink>& connection) {
   connection_ = connection;
-  *generation_ += 1;
   DCHECK(!pending_);
+  frameReceived_ = false;
 
   schedule();
 }
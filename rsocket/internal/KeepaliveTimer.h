@@ -4,10 +4,18 @@
 
 #include <folly/io/async/EventBase.h>
 
+#include "rsocket/internal/TimingWheel.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
 namespace rsocket {
 
+/// Sends the keepalives of a connection, and disconnects it when a keepalive
+/// isn't answered within the period.  The timers of all the connections of an
+/// EventBase share its TimingWheel, so a connection costs one wheel entry
+/// rather than an EventBase timeout of its own, and the keepalives which are
+/// due at the same tick are sent, and checked, together.
+///
+/// Must only be used from the thread of its EventBase.
 class KeepaliveTimer {
  public:
   KeepaliveTimer(std::chrono::milliseconds period, folly::EventBase& eventBase);
@@ -26,11 +34,27 @@ class KeepaliveTimer {
 
   void keepaliveReceived();
 
+  /// Called for every frame received.  Only a store, the timer looks at it
+  /// when the keepalive is due.
+  void frameReceived() {
+    frameReceived_ = true;
+  }
+
+  /// Whether keepalives are skipped when a frame was received during the
+  /// period.
+  void setOnlyWhenIdle(bool onlyWhenIdle) {
+    onlyWhenIdle_ = onlyWhenIdle;
+  }
+
  private:
   std::shared_ptr<FrameSink> connection_;
-  folly::EventBase& eventBase_;
-  std::shared_ptr<uint32_t> generation_;
+  TimingWheel& wheel_;
+  /// The scheduled keepalive, if any.
+  TimingWheel::Handle handle_;
   std::chrono::milliseconds period_;
-  std::atomic<bool> pending_{false};
+  bool pending_{false};
+  bool onlyWhenIdle_{false};
+  /// Whether a frame was received since the keepalive was last due.
+  bool frameReceived_{false};
 };
 }
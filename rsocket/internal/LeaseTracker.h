@@ -0,0 +1,46 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace rsocket {
+
+/// Tracks the requests left in the most recent lease of a connection.  Used
+/// by the requester to check the lease it received, and by the responder to
+/// check the requests the peer makes against the lease it issued.
+class LeaseTracker {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Replaces the current lease, starting at `now`.
+  void update(
+      std::chrono::milliseconds ttl,
+      uint32_t numberOfRequests,
+      Clock::time_point now = Clock::now()) {
+    expiry_ = now + ttl;
+    remaining_ = numberOfRequests;
+  }
+
+  /// Consumes one request of the lease.  Returns false if the lease expired or
+  /// has been used up.
+  bool tryAcquire(Clock::time_point now = Clock::now()) {
+    if (remaining_ == 0 || now >= expiry_) {
+      remaining_ = 0;
+      return false;
+    }
+    --remaining_;
+    return true;
+  }
+
+  uint32_t remaining(Clock::time_point now = Clock::now()) const {
+    return now >= expiry_ ? 0 : remaining_;
+  }
+
+ private:
+  Clock::time_point expiry_;
+  uint32_t remaining_{0};
+};
+
+} // namespace rsocket
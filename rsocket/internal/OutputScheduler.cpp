@@ -0,0 +1,167 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/OutputScheduler.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace rsocket {
+
+constexpr size_t OutputScheduler::kNumClasses;
+
+void OutputScheduler::setPriority(StreamId streamId, StreamPriority priority) {
+  DCHECK_NE(streamId, 0u);
+  priorities_[streamId] = priority;
+}
+
+void OutputScheduler::clearPriority(StreamId streamId) {
+  priorities_.erase(streamId);
+}
+
+void OutputScheduler::enqueue(
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  ++size_;
+  if (streamId == 0) {
+    connectionFrames_.push_back(std::move(frame));
+    return;
+  }
+
+  // Keep the frames of a stream in one queue, even if its priority changed
+  // since the first of them was queued.
+  for (auto& classQueue : classes_) {
+    auto it = classQueue.streams.find(streamId);
+    if (it != classQueue.streams.end()) {
+      it->second.frames.push_back(std::move(frame));
+      return;
+    }
+  }
+
+  auto it = priorities_.find(streamId);
+  auto const priority =
+      it != priorities_.end() ? it->second : StreamPriority();
+  auto& classQueue = classes_[static_cast<size_t>(priority.priorityClass)];
+  auto& streamQueue = classQueue.streams[streamId];
+  streamQueue.weight = std::max<uint8_t>(priority.weight, 1);
+  streamQueue.frames.push_back(std::move(frame));
+  classQueue.turns.push_back(streamId);
+}
+
+bool OutputScheduler::replaceConnectionFrame(
+    const folly::IOBuf* queued,
+    std::unique_ptr<folly::IOBuf>& frame) {
+  for (auto& connectionFrame : connectionFrames_) {
+    if (connectionFrame.get() == queued) {
+      connectionFrame.swap(frame);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<folly::IOBuf> OutputScheduler::dequeue() {
+  if (size_ == 0) {
+    return nullptr;
+  }
+  --size_;
+  if (!connectionFrames_.empty()) {
+    auto frame = std::move(connectionFrames_.front());
+    connectionFrames_.pop_front();
+    return frame;
+  }
+  for (auto& classQueue : classes_) {
+    if (!classQueue.turns.empty()) {
+      return classQueue.dequeue();
+    }
+  }
+  DCHECK(false) << "size_ out of sync with the queues";
+  return nullptr;
+}
+
+std::vector<std::unique_ptr<folly::IOBuf>> OutputScheduler::dropStream(
+    StreamId streamId) {
+  DCHECK_NE(streamId, 0u);
+  for (auto& classQueue : classes_) {
+    auto frames = classQueue.drop(streamId);
+    if (!frames.empty()) {
+      DCHECK_GE(size_, frames.size());
+      size_ -= frames.size();
+      return frames;
+    }
+  }
+  return {};
+}
+
+StreamId OutputScheduler::oldestStream() const {
+  StreamId oldest = 0;
+  for (auto& classQueue : classes_) {
+    for (auto streamId : classQueue.turns) {
+      if (oldest == 0 || streamId < oldest) {
+        oldest = streamId;
+      }
+    }
+  }
+  return oldest;
+}
+
+void OutputScheduler::shrinkToFit() {
+  connectionFrames_.shrink_to_fit();
+  for (auto& classQueue : classes_) {
+    classQueue.turns.shrink_to_fit();
+    for (auto& stream : classQueue.streams) {
+      stream.second.frames.shrink_to_fit();
+    }
+    if (classQueue.streams.empty()) {
+      classQueue.streams.rehash(0);
+    }
+  }
+}
+
+std::unique_ptr<folly::IOBuf> OutputScheduler::ClassQueue::dequeue() {
+  auto const streamId = turns.front();
+  auto it = streams.find(streamId);
+  DCHECK(it != streams.end());
+  auto& streamQueue = it->second;
+  if (credit == 0) {
+    credit = streamQueue.weight;
+  }
+
+  auto frame = std::move(streamQueue.frames.front());
+  streamQueue.frames.pop_front();
+  --credit;
+
+  if (streamQueue.frames.empty()) {
+    streams.erase(it);
+    turns.pop_front();
+    credit = 0;
+  } else if (credit == 0) {
+    turns.pop_front();
+    turns.push_back(streamId);
+  }
+  return frame;
+}
+
+std::vector<std::unique_ptr<folly::IOBuf>> OutputScheduler::ClassQueue::drop(
+    StreamId streamId) {
+  auto it = streams.find(streamId);
+  if (it == streams.end()) {
+    return {};
+  }
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  for (auto& frame : it->second.frames) {
+    frames.push_back(std::move(frame));
+  }
+  streams.erase(it);
+
+  auto turn = std::find(turns.begin(), turns.end(), streamId);
+  DCHECK(turn != turns.end());
+  if (turn == turns.begin()) {
+    // the next stream starts a fresh turn
+    credit = 0;
+  }
+  turns.erase(turn);
+  return frames;
+}
+
+} // namespace rsocket
@@ -0,0 +1,86 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/RequestOptions.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Queue of the serialized frames of a connection which are waiting to be
+/// written, handing them out in the order given by the StreamPriority of their
+/// streams.  Frames of stream 0 are connection frames and come out first.
+/// Streams without a priority are BULK with a weight of 1.
+class OutputScheduler {
+ public:
+  /// Sets the priority of a stream.  Frames already queued for the stream keep
+  /// the priority they were queued with.
+  void setPriority(StreamId, StreamPriority);
+  void clearPriority(StreamId);
+
+  void enqueue(StreamId, std::unique_ptr<folly::IOBuf>);
+
+  /// Puts `frame` in the place of the queued connection frame `queued`, and
+  /// returns the latter in `frame`.  Returns false, leaving `frame` alone, if
+  /// `queued` isn't queued.
+  bool replaceConnectionFrame(
+      const folly::IOBuf* queued,
+      std::unique_ptr<folly::IOBuf>& frame);
+
+  /// Returns the next frame to write, or nullptr if the queue is empty.
+  std::unique_ptr<folly::IOBuf> dequeue();
+
+  /// Returns the queued frames of a stream, removing them from the queue.
+  std::vector<std::unique_ptr<folly::IOBuf>> dropStream(StreamId);
+
+  /// Returns the stream with the lowest id which has frames queued, or 0 if
+  /// only connection frames are queued.
+  StreamId oldestStream() const;
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Number of queued frames.
+  size_t size() const {
+    return size_;
+  }
+
+  /// Frees the spare blocks and buckets of the queues.
+  void shrinkToFit();
+
+ private:
+  struct StreamQueue {
+    std::deque<std::unique_ptr<folly::IOBuf>> frames;
+    uint8_t weight{1};
+  };
+
+  /// Weighted round robin over the streams of one priority class.
+  struct ClassQueue {
+    std::unordered_map<StreamId, StreamQueue> streams;
+    /// Streams with queued frames, the one at the front is sending.
+    std::deque<StreamId> turns;
+    /// Frames the stream at the front of `turns` may still send this turn.
+    uint32_t credit{0};
+
+    std::unique_ptr<folly::IOBuf> dequeue();
+    std::vector<std::unique_ptr<folly::IOBuf>> drop(StreamId);
+  };
+
+  static constexpr size_t kNumClasses = 2;
+
+  std::deque<std::unique_ptr<folly::IOBuf>> connectionFrames_;
+  std::array<ClassQueue, kNumClasses> classes_;
+  std::unordered_map<StreamId, StreamPriority> priorities_;
+  size_t size_{0};
+};
+
+} // namespace rsocket
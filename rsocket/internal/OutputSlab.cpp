@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/OutputSlab.h"
+
+#include <cstring>
+
+namespace rsocket {
+
+constexpr size_t OutputSlab::kSlabSize;
+constexpr size_t OutputSlab::kMaxPackedBytes;
+
+namespace {
+/// The slab of the thread, whose tailroom is what's left of it.
+std::unique_ptr<folly::IOBuf>& slab() {
+  thread_local std::unique_ptr<folly::IOBuf> slab;
+  return slab;
+}
+
+/// Copies `buf` into the slab, extending the view ending the chain if it
+/// ends where the copy starts.
+void pack(std::unique_ptr<folly::IOBuf>& chain, const folly::IOBuf& buf) {
+  auto& current = slab();
+  auto const length = buf.length();
+  if (!current || current->tailroom() < length) {
+    if (current && !current->isSharedOne()) {
+      // Nothing written from it is referenced any more.
+      current->clear();
+    } else {
+      current = folly::IOBuf::create(OutputSlab::kSlabSize);
+    }
+  }
+
+  auto last = chain ? chain->prev() : nullptr;
+  auto const extends = last && last->tail() == current->tail() &&
+      last->buffer() == current->buffer();
+  std::memcpy(current->writableTail(), buf.data(), length);
+  if (extends) {
+    current->append(length);
+    last->append(length);
+    return;
+  }
+  auto view = current->cloneOne();
+  view->trimStart(current->length());
+  current->append(length);
+  view->append(length);
+  if (chain) {
+    chain->prependChain(std::move(view));
+  } else {
+    chain = std::move(view);
+  }
+}
+} // namespace
+
+void OutputSlab::append(
+    std::unique_ptr<folly::IOBuf>& chain,
+    std::unique_ptr<folly::IOBuf> frame) {
+  while (frame) {
+    auto rest = frame->pop();
+    if (frame->length() <= kMaxPackedBytes) {
+      if (!frame->empty()) {
+        pack(chain, *frame);
+      }
+    } else if (chain) {
+      chain->prependChain(std::move(frame));
+    } else {
+      chain = std::move(frame);
+    }
+    frame = std::move(rest);
+  }
+}
+
+} // namespace rsocket
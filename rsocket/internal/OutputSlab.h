@@ -0,0 +1,36 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+
+namespace rsocket {
+
+/// Packs the small buffers of the frames written together into a slab, one
+/// per thread and so per EventBase, so that the headers and small payloads of
+/// a batch go out as one contiguous iovec.  Larger buffers are chained by
+/// reference.
+///
+/// The bytes written from a slab are views of it.  Once the slab is full, it
+/// is reused if the transport released all of them, and replaced otherwise,
+/// so that in a steady state the packed bytes cost no allocation of their
+/// own.
+class OutputSlab {
+ public:
+  static constexpr size_t kSlabSize = 16 * 1024;
+  /// Buffers up to this size are copied into the slab.
+  static constexpr size_t kMaxPackedBytes = 256;
+
+  /// Appends the buffers of `frame` to `chain`, which may be empty, packing
+  /// the small ones into the slab of the thread.
+  static void append(
+      std::unique_ptr<folly::IOBuf>& chain,
+      std::unique_ptr<folly::IOBuf> frame);
+
+ private:
+  OutputSlab() = delete;
+};
+
+} // namespace rsocket
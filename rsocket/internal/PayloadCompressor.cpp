@@ -0,0 +1,298 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/PayloadCompressor.h"
+
+#include <array>
+
+#include <folly/Conv.h>
+#include <folly/io/Compression.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/Config.h>
+
+#if FOLLY_HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+namespace rsocket {
+
+namespace {
+
+using Codec = PayloadCompression::Codec;
+
+constexpr size_t kNumCodecs = 3;
+
+/// The codecs of the thread, shared by its connections.  A codec object
+/// keeps its contexts from one payload to the next.
+folly::io::Codec* threadCodec(Codec codec) {
+  thread_local std::array<std::unique_ptr<folly::io::Codec>, kNumCodecs>
+      codecs;
+  thread_local std::array<bool, kNumCodecs> created{};
+
+  auto const i = static_cast<size_t>(codec);
+  if (i == 0 || i >= kNumCodecs) {
+    return nullptr;
+  }
+  if (!created[i]) {
+    created[i] = true;
+    auto const type = codec == Codec::ZSTD
+        ? folly::io::CodecType::ZSTD
+        : folly::io::CodecType::LZ4_VARINT_SIZE;
+    if (folly::io::hasCodec(type)) {
+      codecs[i] = folly::io::getCodec(type);
+    }
+  }
+  return codecs[i].get();
+}
+
+/// Checks the length of the data once decompressed, which comes from the
+/// peer, before anything is allocated for it.
+uint64_t checkLength(uint64_t length, size_t maxLength) {
+  if (length > maxLength) {
+    throw std::runtime_error(folly::to<std::string>(
+        "Compressed payload of ", length, " bytes, more than ", maxLength));
+  }
+  return length;
+}
+
+/// The length of the data once decompressed, which LZ4_VARINT_SIZE puts
+/// first as a varint.
+uint64_t varintContentLength(const folly::IOBuf& compressed) {
+  folly::io::Cursor cursor(&compressed);
+  uint64_t length = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    if (cursor.isAtEnd()) {
+      break;
+    }
+    auto const byte = cursor.read<uint8_t>();
+    length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return length;
+    }
+  }
+  throw std::runtime_error("Corrupt compressed payload");
+}
+
+#if FOLLY_HAVE_LIBZSTD
+
+/// The length of the data once decompressed, which the zstd frame carries.
+uint64_t zstdContentLength(folly::ByteRange input) {
+  auto const length = ZSTD_getFrameContentSize(input.data(), input.size());
+  if (length == ZSTD_CONTENTSIZE_UNKNOWN || length == ZSTD_CONTENTSIZE_ERROR) {
+    throw std::runtime_error("Compressed payload without its length");
+  }
+  return length;
+}
+
+/// The zstd contexts of the thread, shared by its connections whatever their
+/// dictionaries.
+struct ZstdContexts {
+  ZstdContexts()
+      : compression(ZSTD_createCCtx()), decompression(ZSTD_createDCtx()) {}
+
+  ~ZstdContexts() {
+    ZSTD_freeCCtx(compression);
+    ZSTD_freeDCtx(decompression);
+  }
+
+  ZSTD_CCtx* const compression;
+  ZSTD_DCtx* const decompression;
+};
+
+ZstdContexts& threadZstdContexts() {
+  thread_local ZstdContexts contexts;
+  return contexts;
+}
+
+std::unique_ptr<folly::IOBuf> compressWithDictionary(
+    folly::IOBuf& data,
+    const CompressionDictionary& dictionary) {
+  auto const input = data.coalesce();
+  auto output = folly::IOBuf::create(ZSTD_compressBound(input.size()));
+  auto const size = ZSTD_compress_usingCDict(
+      threadZstdContexts().compression,
+      output->writableTail(),
+      output->tailroom(),
+      input.data(),
+      input.size(),
+      dictionary.compressionDictionary());
+  if (ZSTD_isError(size)) {
+    return nullptr;
+  }
+  output->append(size);
+  return output;
+}
+
+/// Returns nullptr for zstd frames compressed without a dictionary.
+std::unique_ptr<folly::IOBuf> decompressWithDictionary(
+    folly::IOBuf& compressed,
+    const CompressionDictionary* dictionary,
+    size_t maxLength) {
+  auto const input = compressed.coalesce();
+  auto const id = ZSTD_getDictID_fromFrame(input.data(), input.size());
+  if (id == 0) {
+    return nullptr;
+  }
+  if (!dictionary || dictionary->id() != id) {
+    throw std::runtime_error(
+        folly::to<std::string>("Unknown compression dictionary ", id));
+  }
+  auto const length = checkLength(zstdContentLength(input), maxLength);
+  auto output = folly::IOBuf::create(length);
+  auto const size = ZSTD_decompress_usingDDict(
+      threadZstdContexts().decompression,
+      output->writableTail(),
+      length,
+      input.data(),
+      input.size(),
+      dictionary->decompressionDictionary());
+  if (ZSTD_isError(size) || size != length) {
+    throw std::runtime_error("Corrupt compressed payload");
+  }
+  output->append(size);
+  return output;
+}
+
+#endif
+
+} // namespace
+
+bool compressPayload(Payload& payload, const PayloadCompression& compression) {
+  if (compression.codec == Codec::NONE || !payload.data) {
+    return false;
+  }
+  auto const length = payload.data->computeChainDataLength();
+  if (length < compression.minBytes || length == 0) {
+    return false;
+  }
+  std::unique_ptr<folly::IOBuf> compressed;
+#if FOLLY_HAVE_LIBZSTD
+  if (compression.dictionary && compression.codec == Codec::ZSTD) {
+    compressed = compressWithDictionary(*payload.data, *compression.dictionary);
+  }
+#endif
+  if (!compressed) {
+    auto codec = threadCodec(compression.codec);
+    if (!codec) {
+      return false;
+    }
+    compressed = codec->compress(payload.data.get());
+  }
+  if (compressed->computeChainDataLength() + 1 >= length) {
+    return false;
+  }
+
+  // The codec id goes in a buffer of its own, with room for the frame headers
+  // in front of it when there is no metadata.
+  auto data = folly::IOBuf::create(FrameSerializerV1_0::kPayloadHeadroom + 1);
+  data->advance(FrameSerializerV1_0::kPayloadHeadroom);
+  *data->writableTail() = static_cast<uint8_t>(compression.codec);
+  data->append(1);
+  data->prependChain(std::move(compressed));
+  payload.data = std::move(data);
+  return true;
+}
+
+void decompressPayload(
+    Payload& payload,
+    const PayloadCompression& compression,
+    size_t maxLength) {
+  // The codec id and at least a byte.
+  if (!payload.data || payload.data->computeChainDataLength() < 2) {
+    throw std::runtime_error("Compressed payload without data");
+  }
+  folly::io::Cursor cursor(payload.data.get());
+  auto const id = static_cast<Codec>(cursor.read<uint8_t>());
+  auto codec = threadCodec(id);
+  if (!codec) {
+    throw std::runtime_error("Unknown compression codec");
+  }
+  std::unique_ptr<folly::IOBuf> compressed;
+  cursor.clone(compressed, cursor.totalLength());
+  uint64_t length = 0;
+#if FOLLY_HAVE_LIBZSTD
+  // The zstd frame tells which dictionary it was compressed with, if any.
+  if (id == Codec::ZSTD) {
+    if (auto data = decompressWithDictionary(
+            *compressed, compression.dictionary.get(), maxLength)) {
+      payload.data = std::move(data);
+      return;
+    }
+    length = zstdContentLength(compressed->coalesce());
+  }
+#else
+  (void)compression;
+#endif
+  if (id == Codec::LZ4) {
+    length = varintContentLength(*compressed);
+  }
+  // The codec fails if the data doesn't have the length checked.
+  payload.data =
+      codec->uncompress(compressed.get(), checkLength(length, maxLength));
+}
+
+std::unique_ptr<folly::IOBuf> payloadCompressionMetadata() {
+  return CompositeMetadataBuilder()
+      .add(kPayloadCompressionMimeType, folly::StringPiece())
+      .build();
+}
+
+bool hasPayloadCompressionEntry(const folly::IOBuf& metadata) {
+  try {
+    return CompositeMetadataReader(metadata)
+        .find(kPayloadCompressionMimeType)
+        .hasValue();
+  } catch (const std::exception&) {
+    // Malformed, not an answer then.
+    return false;
+  }
+}
+
+std::unique_ptr<folly::IOBuf> compressionSetupMetadata(
+    const PayloadCompression& compression) {
+  auto metadata = payloadCompressionMetadata();
+  if (compression.dictionary) {
+    metadata->prependChain(
+        compressionDictionaryMetadata(*compression.dictionary));
+  }
+  return metadata;
+}
+
+std::unique_ptr<folly::IOBuf> compressionDictionaryMetadata(
+    const CompressionDictionary& dictionary) {
+  auto id = folly::IOBuf::create(sizeof(uint32_t));
+  folly::io::Appender(id.get(), 0).writeBE<uint32_t>(dictionary.id());
+  return CompositeMetadataBuilder()
+      .add(kCompressionDictionaryMimeType, std::move(id))
+      .build();
+}
+
+folly::Optional<uint32_t> compressionDictionaryId(
+    const SetupParameters& setupParams) {
+  if (setupParams.metadataMimeType != kCompositeMetadataMimeType ||
+      !setupParams.payload.metadata) {
+    return folly::none;
+  }
+  try {
+    CompositeMetadataReader reader(*setupParams.payload.metadata);
+    auto entry = reader.find(kCompressionDictionaryMimeType);
+    if (!entry || entry->length() != sizeof(uint32_t)) {
+      return folly::none;
+    }
+    return entry->cursor().readBE<uint32_t>();
+  } catch (const std::exception&) {
+    // Malformed, no dictionary then.
+    return folly::none;
+  }
+}
+
+bool requestsCompression(const SetupParameters& setupParams) {
+  return setupParams.metadataMimeType == kCompositeMetadataMimeType &&
+      setupParams.payload.metadata &&
+      hasPayloadCompressionEntry(*setupParams.payload.metadata);
+}
+
+} // namespace rsocket
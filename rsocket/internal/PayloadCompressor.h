@@ -0,0 +1,56 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include "rsocket/CompressionDictionary.h"
+#include "rsocket/Payload.h"
+#include "rsocket/RSocketParameters.h"
+
+namespace rsocket {
+
+/// Compresses the data of `payload` as `compression` says, see
+/// PayloadCompression.  Returns false, and leaves the payload as it is, for
+/// data too short or which doesn't shrink, or a codec folly doesn't have.
+bool compressPayload(Payload& payload, const PayloadCompression& compression);
+
+/// Decompresses data compressed by compressPayload(), with the dictionary of
+/// `compression` if the data was compressed with one.  Throws
+/// std::runtime_error if it can't, or if the data would be longer than
+/// `maxLength` bytes once decompressed.
+void decompressPayload(
+    Payload& payload,
+    const PayloadCompression& compression,
+    size_t maxLength);
+
+/// The mime type of the empty composite metadata entry by which a client asks
+/// for compressed payloads in its SETUP, and by which the server, in a
+/// METADATA_PUSH, tells the client that it can send compressed payloads.
+constexpr folly::StringPiece kPayloadCompressionMimeType{
+    "message/x.rsocket.payload-compression.v0"};
+
+/// The composite metadata entry of kPayloadCompressionMimeType.
+std::unique_ptr<folly::IOBuf> payloadCompressionMetadata();
+
+/// Whether composite metadata has an entry of kPayloadCompressionMimeType.
+bool hasPayloadCompressionEntry(const folly::IOBuf& metadata);
+
+/// The composite metadata entries by which a client asks for compressed
+/// payloads in its SETUP, and names its dictionary if it has one.
+std::unique_ptr<folly::IOBuf> compressionSetupMetadata(
+    const PayloadCompression& compression);
+
+/// The composite metadata entry by which a client names its dictionary in its
+/// SETUP.
+std::unique_ptr<folly::IOBuf> compressionDictionaryMetadata(
+    const CompressionDictionary& dictionary);
+
+/// Whether the client asked for compressed payloads in its SETUP.
+bool requestsCompression(const SetupParameters& setupParams);
+
+/// The id of the dictionary the client named in its SETUP, if any.
+folly::Optional<uint32_t> compressionDictionaryId(
+    const SetupParameters& setupParams);
+
+} // namespace rsocket
@@ -0,0 +1,883 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/PersistentResumeManager.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/Format.h>
+#include <folly/ProducerConsumerQueue.h>
+#include <folly/io/IOBuf.h>
+#include <glog/logging.h>
+
+#include "rsocket/internal/ResumePersistenceThread.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Start of every segment file.
+constexpr uint64_t kSegmentMagic = 0x31474f4c4d534552; // "RESMLOG1"
+constexpr size_t kSegmentHeaderLength = sizeof(kSegmentMagic);
+
+/// Records start with the length of their body and their type.  The length
+/// is written last, a zero length is the end of the log.
+constexpr size_t kRecordHeaderLength = sizeof(uint32_t) + sizeof(uint8_t);
+
+/// The fields of a SENT_FRAME record before the frame.
+constexpr size_t kSentFrameHeaderLength =
+    sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+/// The most fixed fields of a record, before its frame or bytes.
+constexpr size_t kMaxRecordFields = 32;
+
+constexpr folly::StringPiece kSegmentPrefix{"resume."};
+constexpr folly::StringPiece kSegmentSuffix{".log"};
+
+std::string segmentPath(const std::string& directory, uint64_t number) {
+  return folly::sformat(
+      "{}/{}{}{}", directory, kSegmentPrefix, number, kSegmentSuffix);
+}
+
+} // namespace
+
+enum class PersistentResumeManager::RecordType : uint8_t {
+  CHECKPOINT = 1,
+  SENT_FRAME = 2,
+  /// A sent frame too large to be buffered.
+  SENT_SKIPPED = 3,
+  RESET = 4,
+  RECEIVED = 5,
+  STREAM_OPEN = 6,
+  STREAM_CLOSED = 7,
+};
+
+/// Fills the body of a record.  The space is reserved up front.
+class PersistentResumeManager::Writer {
+ public:
+  explicit Writer(uint8_t* data) : data_(data) {}
+
+  template <typename T>
+  void write(T value) {
+    std::memcpy(data_ + offset_, &value, sizeof(value));
+    offset_ += sizeof(value);
+  }
+
+  void write(const void* data, size_t length) {
+    std::memcpy(data_ + offset_, data, length);
+    offset_ += length;
+  }
+
+  void write(const folly::IOBuf& buf) {
+    for (auto range : buf) {
+      write(range.data(), range.size());
+    }
+  }
+
+  /// Returns where the next `length` bytes go, for the caller to fill.
+  uint8_t* skip(size_t length) {
+    auto const data = data_ + offset_;
+    offset_ += length;
+    return data;
+  }
+
+  size_t offset() const {
+    return offset_;
+  }
+
+ private:
+  uint8_t* const data_;
+  size_t offset_{0};
+};
+
+/// Reads the body of a record, failing instead of reading past its end.
+class PersistentResumeManager::Reader {
+ public:
+  Reader(const uint8_t* data, size_t length) : data_(data), length_(length) {}
+
+  template <typename T>
+  bool read(T& value) {
+    if (length_ - offset_ < sizeof(value)) {
+      return false;
+    }
+    std::memcpy(&value, data_ + offset_, sizeof(value));
+    offset_ += sizeof(value);
+    return true;
+  }
+
+  bool read(size_t length, folly::ByteRange& range) {
+    if (length_ - offset_ < length) {
+      return false;
+    }
+    range = folly::ByteRange(data_ + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+  folly::ByteRange rest() {
+    auto const range =
+        folly::ByteRange(data_ + offset_, data_ + length_);
+    offset_ = length_;
+    return range;
+  }
+
+ private:
+  const uint8_t* const data_;
+  const size_t length_;
+  size_t offset_{0};
+};
+
+/// A record on its way to the segment: the fixed fields of its body, then
+/// the frame or the bytes following them, by reference.
+struct PersistentResumeManager::Record {
+  RecordType type;
+  std::array<uint8_t, kMaxRecordFields> fields;
+  size_t fieldsLength{0};
+  std::unique_ptr<folly::IOBuf> data;
+  /// Length of the body.
+  size_t length{0};
+  /// For a CHECKPOINT, the length of the segment it starts.
+  size_t segmentLength{0};
+};
+
+/// The segment files of a manager, appended to by the manager itself, or by
+/// the persistence thread with the records the manager queued.
+class PersistentResumeManager::Log : public ResumePersistenceThread::Task {
+ public:
+  Log(std::string directory, size_t queueCapacity)
+      : directory_(std::move(directory)),
+        // One slot of the queue stays empty.
+        queue_(std::max<size_t>(queueCapacity, 1) + 1) {}
+
+  ~Log() {
+    unmapSegment();
+  }
+
+  /// The segments created next are numbered after `number`.
+  void setLastSegmentNumber(uint64_t number) {
+    segmentNumber_ = number;
+  }
+
+  /// Has the segments synced by sync(), and each previous segment deleted
+  /// only once the next one is.
+  void startSyncing() {
+    syncing_ = true;
+  }
+
+  bool failed() const {
+    return failed_.load(std::memory_order_acquire);
+  }
+
+  /// Called by the manager, which is the only producer.
+  bool enqueue(Record&& record) {
+    return queue_.write(std::move(record));
+  }
+
+  /// Called by the manager once it is done queuing records, with the record
+  /// to write after them if any.
+  void close(std::unique_ptr<Record> last) {
+    last_ = std::move(last);
+    closed_.store(true, std::memory_order_release);
+  }
+
+  /// Appends a record, or starts the next segment with a CHECKPOINT.
+  bool write(Record& record) {
+    if (failed()) {
+      return false;
+    }
+    if (record.type == RecordType::CHECKPOINT) {
+      return startSegment(record);
+    }
+    if (kRecordHeaderLength + record.length > segmentLength_ - segmentOffset_) {
+      LOG(DFATAL) << "Resumption record past the end of its segment";
+      fail();
+      return false;
+    }
+
+    auto const start = segment_ + segmentOffset_;
+    Writer writer(start + kRecordHeaderLength);
+    writer.write(record.fields.data(), record.fieldsLength);
+    if (record.data) {
+      writer.write(*record.data);
+    }
+    DCHECK_EQ(record.length, writer.offset());
+    start[sizeof(uint32_t)] = static_cast<uint8_t>(record.type);
+    // Written last, it makes the record visible to recovery.
+    auto const length32 = static_cast<uint32_t>(record.length);
+    std::memcpy(start, &length32, sizeof(length32));
+    segmentOffset_ += kRecordHeaderLength + record.length;
+    return true;
+  }
+
+  bool drain() override {
+    // Read first: once closed, everything it queued is in the queue.
+    auto const closed = closed_.load(std::memory_order_acquire);
+    Record record;
+    while (queue_.read(record)) {
+      write(record);
+    }
+    if (closed && last_) {
+      write(*last_);
+      last_.reset();
+    }
+    return !closed;
+  }
+
+  void sync() override {
+    if (segment_ && segmentOffset_ > syncedOffset_) {
+      static auto const pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+      auto const from = syncedOffset_ / pageSize * pageSize;
+      if (::msync(segment_ + from, segmentOffset_ - from, MS_SYNC) != 0) {
+        PLOG(ERROR) << "Can't sync "
+                    << segmentPath(directory_, segmentNumber_);
+      }
+      syncedOffset_ = segmentOffset_;
+    }
+    if (!previous_.empty() && segment_) {
+      ::unlink(previous_.c_str());
+      previous_.clear();
+    }
+  }
+
+ private:
+  bool startSegment(const Record& checkpoint) {
+    auto const length = checkpoint.segmentLength;
+    auto const number = segmentNumber_ + 1;
+    auto const path = segmentPath(directory_, number);
+
+    folly::File file;
+    void* mapping = MAP_FAILED;
+    try {
+      file = folly::File(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+      folly::checkUnixError(
+          ::ftruncate(file.fd(), static_cast<off_t>(length)),
+          "Can't size ",
+          path);
+      mapping = ::mmap(
+          nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd(), 0);
+      if (mapping == MAP_FAILED) {
+        folly::throwSystemError("Can't map ", path);
+      }
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Stopped persisting the resumption state: " << ex.what();
+      if (file) {
+        ::unlink(path.c_str());
+      }
+      fail();
+      return false;
+    }
+
+    auto const data = static_cast<uint8_t*>(mapping);
+    std::memcpy(data, &kSegmentMagic, sizeof(kSegmentMagic));
+    auto const record = data + kSegmentHeaderLength;
+    Writer writer(record + kRecordHeaderLength);
+    writer.write(*checkpoint.data);
+    DCHECK_EQ(checkpoint.length, writer.offset());
+    record[sizeof(uint32_t)] = static_cast<uint8_t>(RecordType::CHECKPOINT);
+    auto const length32 = static_cast<uint32_t>(checkpoint.length);
+    std::memcpy(record, &length32, sizeof(length32));
+
+    // The new segment is complete, the previous one is not needed anymore.
+    // When syncing, the last synced segment stays until the new one is
+    // synced.
+    auto const previous =
+        segment_ ? segmentPath(directory_, segmentNumber_) : "";
+    unmapSegment();
+    if (!previous.empty()) {
+      if (syncing_ && previous_.empty()) {
+        previous_ = previous;
+      } else {
+        ::unlink(previous.c_str());
+      }
+    }
+
+    segmentFile_ = std::move(file);
+    segmentNumber_ = number;
+    segment_ = data;
+    segmentLength_ = length;
+    segmentOffset_ =
+        kSegmentHeaderLength + kRecordHeaderLength + checkpoint.length;
+    syncedOffset_ = 0;
+    return true;
+  }
+
+  /// Stops persisting, without leaving a stale state to resume from.
+  void fail() {
+    if (segment_) {
+      unmapSegment();
+      ::unlink(segmentPath(directory_, segmentNumber_).c_str());
+    }
+    if (!previous_.empty()) {
+      ::unlink(previous_.c_str());
+      previous_.clear();
+    }
+    failed_.store(true, std::memory_order_release);
+  }
+
+  void unmapSegment() {
+    if (segment_) {
+      ::munmap(segment_, segmentLength_);
+      segment_ = nullptr;
+    }
+    segmentFile_ = folly::File();
+  }
+
+  const std::string directory_;
+
+  /// The segment being appended to, mapped in memory.
+  folly::File segmentFile_;
+  uint64_t segmentNumber_{0};
+  uint8_t* segment_{nullptr};
+  size_t segmentLength_{0};
+  /// End of the last record of the segment.
+  size_t segmentOffset_{0};
+  /// End of the records synced.
+  size_t syncedOffset_{0};
+
+  bool syncing_{false};
+  /// The previous segment, deleted once the current one is synced.
+  std::string previous_;
+
+  folly::ProducerConsumerQueue<Record> queue_;
+  std::unique_ptr<Record> last_;
+  std::atomic<bool> closed_{false};
+  std::atomic<bool> failed_{false};
+};
+
+PersistentResumeManager::PersistentResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    Options options)
+    : WarmResumeManager(std::move(stats), options.capacity),
+      directory_(std::move(options.directory)),
+      segmentSize_(options.segmentSize),
+      log_(std::make_shared<Log>(directory_, options.queueCapacity)) {
+  replaying_ = true;
+  auto const oldSegments = recover();
+  replaying_ = false;
+
+  // Appending to the recovered segment could leave the remains of a record
+  // that was being written before the restart after the new records.  The
+  // first segment is written here, to fail early.
+  if (!startSegment()) {
+    throw std::runtime_error(folly::sformat(
+        "Can't write the resumption state to {}", directory_));
+  }
+  for (auto number : oldSegments) {
+    ::unlink(segmentPath(directory_, number).c_str());
+  }
+
+  persistenceThread_ = std::move(options.persistenceThread);
+  if (persistenceThread_) {
+    log_->startSyncing();
+    persistenceThread_->add(log_);
+  }
+}
+
+PersistentResumeManager::~PersistentResumeManager() {
+  if (persistenceThread_) {
+    std::unique_ptr<Record> last;
+    if (overflowed_ && !failed()) {
+      // Has the changes of the records which didn't fit in the queue.
+      last = std::make_unique<Record>(checkpointRecord());
+    }
+    // The thread writes what is queued still, then drops the log.
+    log_->close(std::move(last));
+    persistenceThread_->wake();
+  }
+}
+
+void PersistentResumeManager::trackReceivedFrame(
+    size_t frameLength,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+  WarmResumeManager::trackReceivedFrame(
+      frameLength, frameType, streamId, consumerAllowance);
+  auto it = streamResumeInfos_.find(streamId);
+  if (it != streamResumeInfos_.end()) {
+    it->second.consumerAllowance = consumerAllowance;
+  }
+
+  append(
+      RecordType::RECEIVED,
+      sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t),
+      [&](Writer& writer) {
+        writer.write<uint64_t>(impliedPosition_);
+        writer.write<uint32_t>(streamId);
+        writer.write<uint64_t>(consumerAllowance);
+      });
+}
+
+void PersistentResumeManager::trackReceivedFrames(
+    const std::vector<ReceivedFrameInfo>& infos) {
+  // Updates the allowance of the streams frame by frame.
+  ResumeManager::trackReceivedFrames(infos);
+}
+
+void PersistentResumeManager::trackSentFrame(
+    const folly::IOBuf& serializedFrame,
+    size_t frameLength,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+  auto it = streamResumeInfos_.find(streamId);
+  if (it != streamResumeInfos_.end()) {
+    it->second.consumerAllowance = consumerAllowance;
+  }
+
+  auto const position = lastSentPosition_;
+  WarmResumeManager::trackSentFrame(
+      serializedFrame, frameLength, frameType, streamId, consumerAllowance);
+
+  if (frameLength > capacity_) {
+    append(
+        RecordType::SENT_SKIPPED,
+        kSentFrameHeaderLength + sizeof(uint64_t),
+        [&](Writer& writer) {
+          writer.write<uint64_t>(position);
+          writer.write<uint32_t>(streamId);
+          writer.write<uint64_t>(consumerAllowance);
+          writer.write<uint64_t>(frameLength);
+        });
+    return;
+  }
+  // The frame is shared with the persistence thread, not copied.
+  append(
+      RecordType::SENT_FRAME,
+      kSentFrameHeaderLength,
+      [&](Writer& writer) {
+        writer.write<uint64_t>(position);
+        writer.write<uint32_t>(streamId);
+        writer.write<uint64_t>(consumerAllowance);
+      },
+      serializedFrame.clone());
+}
+
+void PersistentResumeManager::resetUpToPosition(ResumePosition position) {
+  // Keepalives acknowledge the same position over and over.
+  if (position <= firstSentPosition_) {
+    return;
+  }
+  WarmResumeManager::resetUpToPosition(position);
+  append(RecordType::RESET, sizeof(uint64_t), [&](Writer& writer) {
+    writer.write<uint64_t>(firstSentPosition_);
+  });
+}
+
+void PersistentResumeManager::onStreamOpen(
+    StreamId streamId,
+    RequestOriginator requester,
+    std::string streamToken,
+    StreamType streamType) {
+  CHECK(streamType != StreamType::FNF);
+  if (requester == RequestOriginator::LOCAL &&
+      streamId > largestUsedStreamId_) {
+    largestUsedStreamId_ = streamId;
+  }
+
+  auto const& token =
+      streamResumeInfos_
+          .emplace(
+              streamId,
+              StreamResumeInfo(streamType, requester, std::move(streamToken)))
+          .first->second.streamToken;
+
+  append(
+      RecordType::STREAM_OPEN,
+      sizeof(uint32_t) + 2 * sizeof(uint8_t),
+      [&](Writer& writer) {
+        writer.write<uint32_t>(streamId);
+        writer.write<uint8_t>(static_cast<uint8_t>(requester));
+        writer.write<uint8_t>(static_cast<uint8_t>(streamType));
+      },
+      token.empty() ? nullptr : folly::IOBuf::copyBuffer(token));
+}
+
+void PersistentResumeManager::onStreamClosed(StreamId streamId) {
+  if (streamResumeInfos_.erase(streamId) == 0) {
+    return;
+  }
+  append(RecordType::STREAM_CLOSED, sizeof(uint32_t), [&](Writer& writer) {
+    writer.write<uint32_t>(streamId);
+  });
+}
+
+void PersistentResumeManager::checkpoint() {
+  startSegment();
+}
+
+bool PersistentResumeManager::failed() const {
+  return log_->failed();
+}
+
+std::vector<uint64_t> PersistentResumeManager::listSegments() const {
+  std::vector<uint64_t> numbers;
+  auto dir = ::opendir(directory_.c_str());
+  if (!dir) {
+    folly::throwSystemError("Can't open ", directory_);
+  }
+  while (auto entry = ::readdir(dir)) {
+    folly::StringPiece name{entry->d_name};
+    if (!name.removePrefix(kSegmentPrefix) ||
+        !name.removeSuffix(kSegmentSuffix)) {
+      continue;
+    }
+    try {
+      numbers.push_back(folly::to<uint64_t>(name));
+    } catch (const std::exception&) {
+      // Not one of ours.
+    }
+  }
+  ::closedir(dir);
+  std::sort(numbers.begin(), numbers.end());
+  return numbers;
+}
+
+std::vector<uint64_t> PersistentResumeManager::recover() {
+  auto numbers = listSegments();
+  for (auto it = numbers.rbegin(); it != numbers.rend(); ++it) {
+    if (replaySegment(*it)) {
+      break;
+    }
+    LOG(WARNING) << "Ignoring invalid resumption segment "
+                 << segmentPath(directory_, *it);
+  }
+  log_->setLastSegmentNumber(numbers.empty() ? 0 : numbers.back());
+  return numbers;
+}
+
+bool PersistentResumeManager::replaySegment(uint64_t number) {
+  auto const path = segmentPath(directory_, number);
+  folly::File file;
+  struct stat st;
+  try {
+    file = folly::File(path, O_RDONLY);
+    folly::checkUnixError(::fstat(file.fd(), &st), "Can't stat ", path);
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << ex.what();
+    return false;
+  }
+  auto const length = static_cast<size_t>(st.st_size);
+  if (length < kSegmentHeaderLength + kRecordHeaderLength) {
+    return false;
+  }
+  auto mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file.fd(), 0);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Can't map " << path;
+    return false;
+  }
+  auto const data = static_cast<const uint8_t*>(mapping);
+
+  uint64_t magic;
+  std::memcpy(&magic, data, sizeof(magic));
+  auto offset = kSegmentHeaderLength;
+  bool restored = false;
+  while (magic == kSegmentMagic &&
+         length - offset >= kRecordHeaderLength) {
+    uint32_t bodyLength;
+    std::memcpy(&bodyLength, data + offset, sizeof(bodyLength));
+    auto const type = static_cast<RecordType>(data[offset + sizeof(uint32_t)]);
+    offset += kRecordHeaderLength;
+    if (bodyLength == 0 || bodyLength > length - offset) {
+      break;
+    }
+
+    Reader reader(data + offset, bodyLength);
+    offset += bodyLength;
+    if (!restored) {
+      // The segments start with a checkpoint.
+      if (type != RecordType::CHECKPOINT || !restoreCheckpoint(reader)) {
+        break;
+      }
+      restored = true;
+    } else if (!replayRecord(type, reader)) {
+      LOG(WARNING) << "Invalid record in " << path;
+      break;
+    }
+  }
+
+  ::munmap(mapping, length);
+  return restored;
+}
+
+bool PersistentResumeManager::restoreCheckpoint(Reader& reader) {
+  uint64_t firstSent, lastSent, implied;
+  uint32_t largestUsedStreamId, streamCount;
+  if (!reader.read(firstSent) || !reader.read(lastSent) ||
+      !reader.read(implied) || !reader.read(largestUsedStreamId) ||
+      !reader.read(streamCount)) {
+    return false;
+  }
+
+  // Parse the streams first, the buffered frames are restored as they are
+  // read.
+  StreamResumeInfos streamResumeInfos;
+  for (uint32_t i = 0; i < streamCount; ++i) {
+    uint32_t streamId, tokenLength;
+    uint8_t streamType, requester;
+    uint64_t producerAllowance, consumerAllowance;
+    folly::ByteRange token;
+    if (!reader.read(streamId) || !reader.read(streamType) ||
+        !reader.read(requester) || !reader.read(producerAllowance) ||
+        !reader.read(consumerAllowance) || !reader.read(tokenLength) ||
+        !reader.read(tokenLength, token)) {
+      return false;
+    }
+    StreamResumeInfo info(
+        static_cast<StreamType>(streamType),
+        static_cast<RequestOriginator>(requester),
+        token.str());
+    info.producerAllowance = producerAllowance;
+    info.consumerAllowance = consumerAllowance;
+    streamResumeInfos.emplace(streamId, std::move(info));
+  }
+
+  streamResumeInfos_ = std::move(streamResumeInfos);
+  largestUsedStreamId_ = largestUsedStreamId;
+  impliedPosition_ = implied;
+  // Drop the frames of a segment which failed to be restored.
+  WarmResumeManager::resetUpToPosition(lastSentPosition_);
+  firstSentPosition_ = firstSent;
+  lastSentPosition_ = firstSent;
+
+  uint32_t frameCount;
+  if (!reader.read(frameCount)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < frameCount; ++i) {
+    uint32_t frameLength;
+    folly::ByteRange frame;
+    if (!reader.read(frameLength) || !reader.read(frameLength, frame)) {
+      return false;
+    }
+    auto buf = folly::IOBuf::wrapBuffer(frame);
+    WarmResumeManager::trackSentFrame(
+        *buf, frameLength, FrameType::PAYLOAD, 0, 0);
+  }
+  // The buffered frames end at the last sent position, unless there are none.
+  if (frameCount == 0) {
+    lastSentPosition_ = lastSent;
+  }
+  return lastSentPosition_ == static_cast<ResumePosition>(lastSent);
+}
+
+bool PersistentResumeManager::replayRecord(RecordType type, Reader& reader) {
+  switch (type) {
+    case RecordType::SENT_FRAME:
+    case RecordType::SENT_SKIPPED: {
+      uint64_t position, consumerAllowance;
+      uint32_t streamId;
+      if (!reader.read(position) || !reader.read(streamId) ||
+          !reader.read(consumerAllowance) ||
+          static_cast<ResumePosition>(position) != lastSentPosition_) {
+        return false;
+      }
+      auto it = streamResumeInfos_.find(streamId);
+      if (it != streamResumeInfos_.end()) {
+        it->second.consumerAllowance = consumerAllowance;
+      }
+      if (type == RecordType::SENT_FRAME) {
+        auto buf = folly::IOBuf::wrapBuffer(reader.rest());
+        WarmResumeManager::trackSentFrame(
+            *buf, buf->length(), FrameType::PAYLOAD, streamId, 0);
+        return true;
+      }
+      uint64_t frameLength;
+      if (!reader.read(frameLength)) {
+        return false;
+      }
+      WarmResumeManager::resetUpToPosition(lastSentPosition_);
+      lastSentPosition_ += frameLength;
+      firstSentPosition_ = lastSentPosition_;
+      return true;
+    }
+    case RecordType::RESET: {
+      uint64_t position;
+      if (!reader.read(position)) {
+        return false;
+      }
+      WarmResumeManager::resetUpToPosition(position);
+      return true;
+    }
+    case RecordType::RECEIVED: {
+      uint64_t implied, consumerAllowance;
+      uint32_t streamId;
+      if (!reader.read(implied) || !reader.read(streamId) ||
+          !reader.read(consumerAllowance)) {
+        return false;
+      }
+      impliedPosition_ = implied;
+      auto it = streamResumeInfos_.find(streamId);
+      if (it != streamResumeInfos_.end()) {
+        it->second.consumerAllowance = consumerAllowance;
+      }
+      return true;
+    }
+    case RecordType::STREAM_OPEN: {
+      uint32_t streamId;
+      uint8_t requester, streamType;
+      if (!reader.read(streamId) || !reader.read(requester) ||
+          !reader.read(streamType) ||
+          streamType >= static_cast<uint8_t>(StreamType::FNF)) {
+        return false;
+      }
+      onStreamOpen(
+          streamId,
+          static_cast<RequestOriginator>(requester),
+          reader.rest().str(),
+          static_cast<StreamType>(streamType));
+      return true;
+    }
+    case RecordType::STREAM_CLOSED: {
+      uint32_t streamId;
+      if (!reader.read(streamId)) {
+        return false;
+      }
+      streamResumeInfos_.erase(streamId);
+      return true;
+    }
+    case RecordType::CHECKPOINT:
+      return false;
+  }
+  return false;
+}
+
+size_t PersistentResumeManager::checkpointLength() const {
+  size_t length = 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+  for (const auto& item : streamResumeInfos_) {
+    length += sizeof(uint32_t) + 2 * sizeof(uint8_t) + 2 * sizeof(uint64_t) +
+        sizeof(uint32_t) + item.second.streamToken.size();
+  }
+  length += sizeof(uint32_t);
+  for (size_t i = 0; i < frameCount(); ++i) {
+    length += sizeof(uint32_t) + frameLength(i);
+  }
+  return length;
+}
+
+void PersistentResumeManager::writeCheckpoint(Writer& writer) const {
+  writer.write<uint64_t>(firstSentPosition_);
+  writer.write<uint64_t>(lastSentPosition_);
+  writer.write<uint64_t>(impliedPosition_);
+  writer.write<uint32_t>(largestUsedStreamId_);
+  writer.write<uint32_t>(streamResumeInfos_.size());
+  for (const auto& item : streamResumeInfos_) {
+    const auto& info = item.second;
+    writer.write<uint32_t>(item.first);
+    writer.write<uint8_t>(static_cast<uint8_t>(info.streamType));
+    writer.write<uint8_t>(static_cast<uint8_t>(info.requester));
+    writer.write<uint64_t>(info.producerAllowance);
+    writer.write<uint64_t>(info.consumerAllowance);
+    writer.write<uint32_t>(info.streamToken.size());
+    writer.write(info.streamToken.data(), info.streamToken.size());
+  }
+  writer.write<uint32_t>(frameCount());
+  for (size_t i = 0; i < frameCount(); ++i) {
+    auto const length = frameLength(i);
+    writer.write<uint32_t>(length);
+    copyFrame(i, writer.skip(length));
+  }
+}
+
+bool PersistentResumeManager::startSegment() {
+  if (failed()) {
+    return false;
+  }
+  auto record = checkpointRecord();
+  auto const used =
+      kSegmentHeaderLength + kRecordHeaderLength + record.length;
+  auto const length = record.segmentLength;
+  if (!submit(std::move(record))) {
+    return false;
+  }
+  segmentLength_ = length;
+  segmentOffset_ = used;
+  return true;
+}
+
+PersistentResumeManager::Record PersistentResumeManager::checkpointRecord()
+    const {
+  auto const bodyLength = checkpointLength();
+  auto const used = kSegmentHeaderLength + kRecordHeaderLength + bodyLength;
+  // Any sent frame which gets buffered fits after the checkpoint.
+  auto const length = std::max(
+      {segmentSize_,
+       2 * used,
+       used + kRecordHeaderLength + kSentFrameHeaderLength + capacity_});
+
+  Record record;
+  record.type = RecordType::CHECKPOINT;
+  record.length = bodyLength;
+  record.segmentLength = length;
+  record.data = folly::IOBuf::create(bodyLength);
+  Writer writer(record.data->writableData());
+  writeCheckpoint(writer);
+  DCHECK_EQ(bodyLength, writer.offset());
+  record.data->append(bodyLength);
+  return record;
+}
+
+template <typename F>
+void PersistentResumeManager::append(
+    RecordType type,
+    size_t fieldsLength,
+    F&& writeFields,
+    std::unique_ptr<folly::IOBuf> data) {
+  if (replaying_ || failed()) {
+    return;
+  }
+  auto const length =
+      fieldsLength + (data ? data->computeChainDataLength() : 0);
+  if (overflowed_ ||
+      kRecordHeaderLength + length > segmentLength_ - segmentOffset_) {
+    // The records are appended once the state changed, the checkpoint of the
+    // next segment already has the change.
+    startSegment();
+    return;
+  }
+
+  Record record;
+  record.type = type;
+  DCHECK_LE(fieldsLength, kMaxRecordFields);
+  Writer writer(record.fields.data());
+  writeFields(writer);
+  DCHECK_EQ(fieldsLength, writer.offset());
+  record.fieldsLength = fieldsLength;
+  record.data = std::move(data);
+  record.length = length;
+  if (submit(std::move(record))) {
+    segmentOffset_ += kRecordHeaderLength + length;
+  }
+}
+
+bool PersistentResumeManager::submit(Record record) {
+  if (!persistenceThread_) {
+    return log_->write(record);
+  }
+  if (!log_->enqueue(std::move(record))) {
+    // The checkpoint replacing the records lost waits for room in the queue.
+    overflowed_ = true;
+    return false;
+  }
+  overflowed_ = false;
+  persistenceThread_->wake();
+  return true;
+}
+
+} // namespace rsocket
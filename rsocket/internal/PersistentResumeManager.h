@@ -0,0 +1,162 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "rsocket/internal/WarmResumeManager.h"
+
+namespace rsocket {
+
+class ResumePersistenceThread;
+
+/// ResumeManager for cold resumption, persisting the state needed to resume the
+/// connection after a restart of the process to a directory.
+///
+/// The state is kept in memory like by the WarmResumeManager, and every change
+/// to it is appended to a memory-mapped segment file: tracking a sent frame is
+/// copying it to the mapping, the kernel writes it to the file.  Each segment
+/// starts with a checkpoint of the whole state.  Once a segment is full the
+/// next one is started with a new checkpoint, and the previous one is deleted.
+/// Recovery restores the checkpoint of the most recent segment and replays the
+/// records after it, up to the first incomplete one.
+///
+/// The files survive the process crashing but not the machine crashing, they
+/// are not synced to the disk.  Unless the manager has a persistence thread:
+/// the records are then handed to it instead, with the frames by reference,
+/// and it appends them, starts the segments and syncs them every interval, so
+/// that tracking the frames never touches the filesystem.  The records still
+/// queued are lost if the process crashes.
+class PersistentResumeManager : public WarmResumeManager {
+ public:
+  struct Options {
+    /// Existing directory holding the segment files, one per connection.
+    std::string directory;
+    /// Size of the segment files.  A segment is made larger if it wouldn't
+    /// hold twice its checkpoint, or a buffered frame after it.
+    size_t segmentSize{8 * 1024 * 1024};
+    /// Most bytes of sent frames buffered.
+    size_t capacity{DEFAULT_CAPACITY};
+    /// Writes and syncs the segments off the calling thread if set.
+    std::shared_ptr<ResumePersistenceThread> persistenceThread;
+    /// Records waiting for the persistence thread.  Once they don't fit the
+    /// manager starts a new segment, with a checkpoint, as soon as the thread
+    /// catches up.
+    size_t queueCapacity{4096};
+  };
+
+  /// Restores the state persisted in the directory, if there is any, and
+  /// starts a segment, on the calling thread.  Throws if the directory can't
+  /// be written.
+  PersistentResumeManager(std::shared_ptr<RSocketStats> stats, Options options);
+  ~PersistentResumeManager();
+
+  void trackReceivedFrame(
+      size_t frameLength,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void trackReceivedFrames(
+      const std::vector<ReceivedFrameInfo>& infos) override;
+
+  void trackSentFrame(
+      const folly::IOBuf& serializedFrame,
+      size_t frameLength,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void resetUpToPosition(ResumePosition position) override;
+
+  void onStreamOpen(
+      StreamId,
+      RequestOriginator,
+      std::string streamToken,
+      StreamType) override;
+
+  void onStreamClosed(StreamId streamId) override;
+
+  const StreamResumeInfos& getStreamResumeInfos() override {
+    return streamResumeInfos_;
+  }
+
+  StreamId getLargestUsedStreamId() override {
+    return largestUsedStreamId_;
+  }
+
+  /// The frames in memory mirror those of the log, which keeps them all.
+  void limitBuffer(double) override {}
+
+  /// Starts a new segment with a checkpoint of the current state, and deletes
+  /// the previous one.  Happens on its own when a segment is full.
+  void checkpoint();
+
+ private:
+  class Writer;
+  class Reader;
+  class Log;
+  struct Record;
+  enum class RecordType : uint8_t;
+
+  /// Numbers of the segment files in the directory, in ascending order.
+  std::vector<uint64_t> listSegments() const;
+
+  /// Restores the state from the most recent valid segment.  Returns the
+  /// numbers of all the segments found.
+  std::vector<uint64_t> recover();
+  bool replaySegment(uint64_t number);
+  bool restoreCheckpoint(Reader&);
+  bool replayRecord(RecordType, Reader&);
+
+  /// Has the next segment created, starting with a checkpoint, and the
+  /// current one deleted.  Returns false if it can't be, e.g. because the
+  /// persistence failed.
+  bool startSegment();
+  /// A CHECKPOINT record of the current state, starting a segment large
+  /// enough for it.
+  Record checkpointRecord() const;
+  size_t checkpointLength() const;
+  void writeCheckpoint(Writer&) const;
+
+  /// Appends a record whose fixed fields of `fieldsLength` bytes are written
+  /// by writeFields, followed by `data`, after the change it records was made
+  /// to the state.
+  template <typename F>
+  void append(
+      RecordType,
+      size_t fieldsLength,
+      F&& writeFields,
+      std::unique_ptr<folly::IOBuf> data = nullptr);
+
+  /// Writes the record, or queues it for the persistence thread.  Returns
+  /// false if it can't.
+  bool submit(Record);
+
+  /// Set after an error writing a segment, nothing is persisted anymore.
+  bool failed() const;
+
+  const std::string directory_;
+  const size_t segmentSize_;
+
+  StreamResumeInfos streamResumeInfos_;
+  StreamId largestUsedStreamId_{0};
+
+  /// The segment files, written here or by persistenceThread_.
+  std::shared_ptr<Log> log_;
+  std::shared_ptr<ResumePersistenceThread> persistenceThread_;
+
+  /// The segment being appended to as of the records submitted so far.
+  size_t segmentLength_{0};
+  /// End of the last record submitted.
+  size_t segmentOffset_{0};
+
+  /// Set while recovering, nothing is appended then.
+  bool replaying_{false};
+  /// Set when a record didn't fit in the queue of the persistence thread: the
+  /// next one is a checkpoint.
+  bool overflowed_{false};
+};
+
+} // namespace rsocket
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace rsocket {
+
+/// Gives T class-specific operator new and delete which recycle the memory of
+/// destroyed objects through a free list per thread, for the objects which are
+/// created and destroyed for every stream.  Derive T from PoolAllocated<T>.
+///
+/// The stream state machines and their wrappers live on the EventBase of
+/// their connection, so the free list of a thread serves the streams of the
+/// EventBase it runs.  An object destroyed on another thread goes to the list
+/// of that thread.  Each list keeps at most kMaxFree blocks, and objects of
+/// classes deriving from T which are larger than T use the global allocator.
+template <typename T, size_t kMaxFree = 1024>
+class PoolAllocated {
+ public:
+  static void* operator new(size_t size) {
+    if (size == sizeof(T) && !exited()) {
+      auto& list = freeList();
+      if (auto block = list.head) {
+        list.head = block->next;
+        --list.size;
+        return block;
+      }
+    }
+    return ::operator new(size);
+  }
+
+  static void operator delete(void* pointer, size_t size) {
+    if (pointer && size == sizeof(T) && !exited()) {
+      auto& list = freeList();
+      if (list.size < kMaxFree) {
+        list.head = new (pointer) Block{list.head};
+        ++list.size;
+        return;
+      }
+    }
+    ::operator delete(pointer);
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  struct FreeList {
+    ~FreeList() {
+      exited() = true;
+      while (auto block = head) {
+        head = block->next;
+        ::operator delete(block);
+      }
+    }
+
+    Block* head{nullptr};
+    size_t size{0};
+  };
+
+  static FreeList& freeList() {
+    static thread_local FreeList list;
+    return list;
+  }
+
+  /// Whether the list of this thread was destroyed, the objects destroyed
+  /// afterwards while the thread exits are freed right away.
+  static bool& exited() {
+    static thread_local bool exited{false};
+    return exited;
+  }
+};
+
+} // namespace rsocket
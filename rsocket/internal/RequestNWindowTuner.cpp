@@ -0,0 +1,53 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/RequestNWindowTuner.h"
+
+#include <algorithm>
+
+namespace rsocket {
+
+namespace {
+/// Shortest interval the consumption of a stream is measured over, so that
+/// the rates of the streams on a fast network aren't taken from a handful of
+/// payloads.
+constexpr std::chrono::milliseconds kMinSampleInterval{1};
+}
+
+RequestNWindowTuner::RequestNWindowTuner(AdaptiveRequestN params)
+    : params_(params),
+      lastWindow_(std::min(params.minWindow, params.maxWindow)) {}
+
+void RequestNWindowTuner::addRoundTrip(Clock::duration rtt) {
+  if (smoothedRtt_ == Clock::duration::zero()) {
+    smoothedRtt_ = rtt;
+  } else {
+    smoothedRtt_ = (smoothedRtt_ * 7 + rtt) / 8;
+  }
+}
+
+RequestNWindowTuner::Clock::duration RequestNWindowTuner::sampleInterval()
+    const {
+  return std::max<Clock::duration>(smoothedRtt_, kMinSampleInterval);
+}
+
+size_t RequestNWindowTuner::nextWindow(
+    size_t window,
+    size_t consumed,
+    Clock::duration elapsed) {
+  if (memoryPressure_ || smoothedRtt_ == Clock::duration::zero() ||
+      elapsed <= Clock::duration::zero()) {
+    return window;
+  }
+  // Twice the bandwidth-delay product, so that the window doesn't limit the
+  // stream while the consumption grows.
+  auto const perRtt = static_cast<double>(consumed) * smoothedRtt_.count() /
+      elapsed.count();
+  auto const target = std::min(
+      2 * perRtt, static_cast<double>(params_.maxWindow));
+  if (target > window) {
+    window = static_cast<size_t>(target);
+  }
+  lastWindow_ = window;
+  return window;
+}
+}
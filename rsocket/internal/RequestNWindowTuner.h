@@ -0,0 +1,61 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include "rsocket/RSocketParameters.h"
+
+namespace rsocket {
+
+/// Sizes the windows of the stream requesters of a connection, see
+/// AdaptiveRequestN.  Shared by the connection, which feeds it the round trip
+/// times of its keepalives and its memory pressure, and by its streams.
+///
+/// Must only be used from the thread of the connection.
+class RequestNWindowTuner {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit RequestNWindowTuner(AdaptiveRequestN params);
+
+  /// Takes a round trip time, smoothed as TCP does (RFC 6298).
+  void addRoundTrip(Clock::duration rtt);
+
+  /// The smoothed round trip time, 0 until one is known.
+  Clock::duration roundTripTime() const {
+    return smoothedRtt_;
+  }
+
+  /// While set windows don't grow, and are cut back to the minimum.
+  void setMemoryPressure(bool pressure) {
+    memoryPressure_ = pressure;
+  }
+
+  /// The window a new stream starts with.
+  size_t initialWindow() const {
+    return lastWindow_;
+  }
+
+  /// How often a stream measures the payloads its subscriber consumed.
+  Clock::duration sampleInterval() const;
+
+  /// The window of a stream which had `window`, and whose subscriber consumed
+  /// `consumed` payloads during `elapsed`.  Windows only grow.
+  size_t nextWindow(size_t window, size_t consumed, Clock::duration elapsed);
+
+  /// The part of `window` the peer may be granted ahead of the subscriber.
+  size_t effectiveWindow(size_t window) const {
+    return memoryPressure_ && window > params_.minWindow ? params_.minWindow
+                                                         : window;
+  }
+
+ private:
+  const AdaptiveRequestN params_;
+  Clock::duration smoothedRtt_{0};
+  /// The last window a stream of the connection reached.
+  size_t lastWindow_;
+  bool memoryPressure_{false};
+};
+}
@@ -0,0 +1,110 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/ResumeBufferPool.h"
+
+#include <glog/logging.h>
+
+#include "rsocket/internal/HugePageArena.h"
+#include "rsocket/internal/WarmResumeManager.h"
+
+namespace rsocket {
+
+constexpr size_t ResumeBufferPool::kDefaultChunkSize;
+
+void ResumeBufferPool::ChunkDeleter::operator()(uint8_t* chunk) const {
+  if (arena) {
+    arena->free(chunk);
+  } else {
+    delete[] chunk;
+  }
+}
+
+ResumeBufferPool::ResumeBufferPool(
+    size_t capacity,
+    size_t chunkSize,
+    bool hugePages)
+    : chunkSize_(chunkSize),
+      maxChunks_(capacity / chunkSize),
+      arena_(
+          hugePages && chunkSize <= HugePageArena::kRegionSize
+              ? std::make_unique<HugePageArena>(chunkSize)
+              : nullptr) {
+  CHECK_GT(chunkSize_, 0U);
+}
+
+ResumeBufferPool::~ResumeBufferPool() {
+  // The managers hold on to the pool.
+  DCHECK(managers_.empty());
+}
+
+size_t ResumeBufferPool::chunksInUse() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunksInUse_;
+}
+
+void ResumeBufferPool::add(WarmResumeManager& manager) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  manager.poolEntry_ = managers_.insert(managers_.end(), &manager);
+}
+
+void ResumeBufferPool::remove(WarmResumeManager& manager) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  managers_.erase(manager.poolEntry_);
+}
+
+ResumeBufferPool::Chunk ResumeBufferPool::allocate(
+    WarmResumeManager& borrower) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  managers_.splice(managers_.end(), managers_, borrower.poolEntry_);
+
+  if (!free_.empty()) {
+    auto chunk = std::move(free_.back());
+    free_.pop_back();
+    ++chunksInUse_;
+    return chunk;
+  }
+  if (chunksAllocated_ < maxChunks_) {
+    ++chunksAllocated_;
+    ++chunksInUse_;
+    if (arena_) {
+      if (auto block = arena_->allocate()) {
+        return Chunk(static_cast<uint8_t*>(block), ChunkDeleter{arena_.get()});
+      }
+    }
+    return Chunk(new uint8_t[chunkSize_]);
+  }
+
+  for (auto victim : managers_) {
+    if (victim == &borrower) {
+      continue;
+    }
+    // Only trying avoids a deadlock with a victim waiting for the pool, which
+    // keeps its chunks then.
+    std::unique_lock<std::recursive_mutex> victimLock(
+        victim->mutex_, std::try_to_lock);
+    if (!victimLock || victim->chunks_.empty()) {
+      continue;
+    }
+    auto chunks = victim->shedChunk();
+    DCHECK(!chunks.empty());
+    auto chunk = std::move(chunks.back());
+    chunks.pop_back();
+    chunksInUse_ -= chunks.size();
+    for (auto& freed : chunks) {
+      free_.push_back(std::move(freed));
+    }
+    return chunk;
+  }
+  return nullptr;
+}
+
+void ResumeBufferPool::release(std::vector<Chunk> chunks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  DCHECK_GE(chunksInUse_, chunks.size());
+  chunksInUse_ -= chunks.size();
+  for (auto& chunk : chunks) {
+    free_.push_back(std::move(chunk));
+  }
+}
+
+} // namespace rsocket
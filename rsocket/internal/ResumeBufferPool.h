@@ -0,0 +1,84 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rsocket {
+
+class HugePageArena;
+class WarmResumeManager;
+
+/// Memory budget shared by the resume buffers of many connections, see
+/// RSocketServer::setResumeBufferPool().
+///
+/// The WarmResumeManagers of the connections borrow fixed-size chunks from the
+/// pool as they buffer sent frames and give them back once the frames are
+/// acknowledged.  When all the chunks are lent out, the oldest chunk of the
+/// connection that has least recently borrowed one is taken back, with the
+/// frames it holds: that connection can't resume from before its remaining
+/// frames anymore.  Chunks are never freed, the pool allocates at most
+/// `capacity` bytes over its lifetime.
+///
+/// With `hugePages`, the chunks are carved from 2MB huge pages, see
+/// HugePageArena, so that the TLB covers the buffers of many more connections.
+/// Chunks come from the heap once huge pages run out, or if they are larger
+/// than a huge page.
+///
+/// Thread safe, the connections can live on different threads.
+class ResumeBufferPool {
+ public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit ResumeBufferPool(
+      size_t capacity,
+      size_t chunkSize = kDefaultChunkSize,
+      bool hugePages = false);
+  ~ResumeBufferPool();
+
+  size_t chunkSize() const {
+    return chunkSize_;
+  }
+
+  /// Number of chunks lent out.
+  size_t chunksInUse() const;
+
+ private:
+  friend class WarmResumeManager;
+
+  /// Gives a chunk back to the arena it was carved from, if any.
+  struct ChunkDeleter {
+    void operator()(uint8_t* chunk) const;
+
+    HugePageArena* arena{nullptr};
+  };
+  using Chunk = std::unique_ptr<uint8_t[], ChunkDeleter>;
+
+  void add(WarmResumeManager&);
+  void remove(WarmResumeManager&);
+
+  /// Lends a chunk to `borrower`, which must hold its own lock.  Returns
+  /// nullptr if none is available and none could be taken back from another
+  /// connection.
+  Chunk allocate(WarmResumeManager& borrower);
+  void release(std::vector<Chunk> chunks);
+
+  const size_t chunkSize_;
+  const size_t maxChunks_;
+  /// Outlives the chunks, which are all back in free_ by the time the pool is
+  /// destroyed.
+  const std::unique_ptr<HugePageArena> arena_;
+
+  mutable std::mutex mutex_;
+  /// The connections, the one which least recently borrowed a chunk first.
+  std::list<WarmResumeManager*> managers_;
+  std::vector<Chunk> free_;
+  size_t chunksInUse_{0};
+  size_t chunksAllocated_{0};
+};
+
+} // namespace rsocket
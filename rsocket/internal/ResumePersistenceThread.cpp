@@ -0,0 +1,100 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/ResumePersistenceThread.h"
+
+#include <algorithm>
+
+#include <folly/ThreadName.h>
+
+namespace rsocket {
+
+ResumePersistenceThread::ResumePersistenceThread(Options options)
+    : options_(options), thread_([this] { run(); }) {}
+
+ResumePersistenceThread::~ResumePersistenceThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wakeUp_.notify_one();
+  thread_.join();
+}
+
+void ResumePersistenceThread::add(std::shared_ptr<Task> task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.push_back(std::move(task));
+}
+
+void ResumePersistenceThread::wake() {
+  if (woken_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  // Taken so that the thread can't miss the notification between checking
+  // woken_ and waiting.
+  std::lock_guard<std::mutex> lock(mutex_);
+  wakeUp_.notify_one();
+}
+
+void ResumePersistenceThread::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto const requested = ++flushRequested_;
+  wakeUp_.notify_one();
+  flushed_.wait(lock, [&] { return flushCompleted_ >= requested; });
+}
+
+void ResumePersistenceThread::run() {
+  folly::setThreadName("rs-persist");
+  using Clock = std::chrono::steady_clock;
+  auto nextSync = Clock::now() + options_.syncInterval;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wakeUp_.wait_until(lock, nextSync, [&] {
+      return stopping_ || flushCompleted_ < flushRequested_ ||
+          woken_.load(std::memory_order_acquire);
+    });
+    auto const stopping = stopping_;
+    auto const flushRequested = flushRequested_;
+    auto tasks = tasks_;
+    lock.unlock();
+
+    // Records queued after this are seen by the next round.
+    woken_.store(false, std::memory_order_release);
+    std::vector<std::shared_ptr<Task>> finished;
+    for (auto& task : tasks) {
+      if (!task->drain()) {
+        finished.push_back(task);
+      }
+    }
+
+    // Group commit: one sync per file for all the records of the interval.
+    auto const now = Clock::now();
+    auto const syncing =
+        stopping || now >= nextSync || flushRequested != flushCompleted_;
+    if (syncing) {
+      for (auto& task : tasks) {
+        task->sync();
+      }
+      nextSync = now + options_.syncInterval;
+    } else {
+      // The last records of the tasks going away don't wait.
+      for (auto& task : finished) {
+        task->sync();
+      }
+    }
+
+    lock.lock();
+    for (auto& task : finished) {
+      tasks_.erase(std::find(tasks_.begin(), tasks_.end(), task));
+    }
+    if (syncing && flushRequested > flushCompleted_) {
+      flushCompleted_ = flushRequested;
+      flushed_.notify_all();
+    }
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsocket {
+
+/// Thread writing the resumption state of PersistentResumeManager objects to
+/// their files, so that the EventBases tracking the frames never touch the
+/// filesystem, see PersistentResumeManager::Options::persistenceThread.
+///
+/// The managers hand their records over through lock-free queues, the thread
+/// writes them as they come.  The files are synced every `syncInterval`, all
+/// the records written since the previous sync at once.  Thread safe.
+class ResumePersistenceThread {
+ public:
+  struct Options {
+    /// How often the written records are synced to the disk.
+    std::chrono::milliseconds syncInterval{std::chrono::milliseconds(10)};
+  };
+
+  /// What the thread does for a manager.
+  class Task {
+   public:
+    virtual ~Task() = default;
+
+    /// Writes the records queued so far.  Returns false once there won't be
+    /// any more, the task is dropped after a last sync then.
+    virtual bool drain() = 0;
+
+    /// Syncs the records written so far to the disk.
+    virtual void sync() = 0;
+  };
+
+  explicit ResumePersistenceThread(Options options = Options());
+
+  /// Writes and syncs what is queued, then joins the thread.
+  ~ResumePersistenceThread();
+
+  ResumePersistenceThread(const ResumePersistenceThread&) = delete;
+  ResumePersistenceThread& operator=(const ResumePersistenceThread&) = delete;
+
+  void add(std::shared_ptr<Task> task);
+
+  /// Has the records queued be written.  Cheap when the thread is busy
+  /// already, to be called after each record.
+  void wake();
+
+  /// Blocks until the records queued so far are written and synced.
+  void flush();
+
+ private:
+  void run();
+
+  const Options options_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeUp_;
+  std::condition_variable flushed_;
+  std::vector<std::shared_ptr<Task>> tasks_;
+  bool stopping_{false};
+  uint64_t flushRequested_{0};
+  uint64_t flushCompleted_{0};
+  /// Set by wake() until the thread drains the tasks.
+  std::atomic<bool> woken_{false};
+
+  std::thread thread_;
+};
+
+} // namespace rsocket
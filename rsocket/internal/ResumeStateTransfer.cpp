@@ -0,0 +1,101 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/ResumeStateTransfer.h"
+
+#include <stdexcept>
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+namespace rsocket {
+
+namespace {
+/// Leads the serialized state, bumped on incompatible changes.
+constexpr uint32_t kFormatVersion = 2;
+
+void writeString(folly::io::QueueAppender& appender, const std::string& str) {
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(str.size()));
+  appender.push(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+std::string readString(folly::io::Cursor& cursor) {
+  auto const length = cursor.readBE<uint32_t>();
+  return cursor.readFixedString(length);
+}
+} // namespace
+
+std::unique_ptr<folly::IOBuf> ResumeStateTransfer::serialize() const {
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  folly::io::QueueAppender appender(&queue, 256);
+
+  appender.writeBE<uint32_t>(kFormatVersion);
+  appender.writeBE<uint16_t>(protocolVersion.major);
+  appender.writeBE<uint16_t>(protocolVersion.minor);
+  auto const& tokenBits = token.data();
+  appender.writeBE<uint16_t>(static_cast<uint16_t>(tokenBits.size()));
+  appender.push(tokenBits.data(), tokenBits.size());
+  writeString(appender, metadataMimeType);
+  writeString(appender, dataMimeType);
+
+  appender.writeBE<int64_t>(impliedPosition);
+  appender.writeBE<int64_t>(firstSentPosition);
+  appender.writeBE<int64_t>(lastSentPosition);
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(sentFrames.size()));
+  for (const auto& frame : sentFrames) {
+    appender.writeBE<uint32_t>(
+        static_cast<uint32_t>(frame->computeChainDataLength()));
+    appender.insert(frame->clone());
+  }
+
+  appender.writeBE<uint32_t>(nextStreamId);
+  appender.writeBE<uint32_t>(lastPeerStreamId);
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(openStreams.size()));
+  for (auto streamId : openStreams) {
+    appender.writeBE<uint32_t>(streamId);
+  }
+  return queue.move();
+}
+
+folly::Optional<ResumeStateTransfer> ResumeStateTransfer::deserialize(
+    const folly::IOBuf& buf) {
+  folly::io::Cursor cursor(&buf);
+  ResumeStateTransfer state;
+  try {
+    if (cursor.readBE<uint32_t>() != kFormatVersion) {
+      return folly::none;
+    }
+    state.protocolVersion.major = cursor.readBE<uint16_t>();
+    state.protocolVersion.minor = cursor.readBE<uint16_t>();
+    std::vector<uint8_t> tokenBits(cursor.readBE<uint16_t>());
+    cursor.pull(tokenBits.data(), tokenBits.size());
+    state.token.set(std::move(tokenBits));
+    state.metadataMimeType = readString(cursor);
+    state.dataMimeType = readString(cursor);
+
+    state.impliedPosition = cursor.readBE<int64_t>();
+    state.firstSentPosition = cursor.readBE<int64_t>();
+    state.lastSentPosition = cursor.readBE<int64_t>();
+    auto const frameCount = cursor.readBE<uint32_t>();
+    for (uint32_t i = 0; i < frameCount; ++i) {
+      auto const length = cursor.readBE<uint32_t>();
+      std::unique_ptr<folly::IOBuf> frame;
+      cursor.clone(frame, length);
+      state.sentFrames.push_back(std::move(frame));
+    }
+
+    state.nextStreamId = cursor.readBE<uint32_t>();
+    state.lastPeerStreamId = cursor.readBE<uint32_t>();
+    auto const streamCount = cursor.readBE<uint32_t>();
+    for (uint32_t i = 0; i < streamCount; ++i) {
+      state.openStreams.push_back(cursor.readBE<uint32_t>());
+    }
+  } catch (const std::out_of_range&) {
+    return folly::none;
+  }
+  if (!cursor.isAtEnd()) {
+    return folly::none;
+  }
+  return std::move(state);
+}
+
+} // namespace rsocket
@@ -0,0 +1,57 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// The state of a resumable server connection handed over to another host,
+/// see ResumeStateStore.  Only the connection moves: the positions and the
+/// buffered frames to resume from, and the ids of the streams.  The streams
+/// it had are canceled on the new host since their handlers stay behind.
+struct ResumeStateTransfer {
+  ProtocolVersion protocolVersion;
+  /// Of the SETUP, for the other host to set the connection up again.
+  ResumeIdentificationToken token;
+  std::string metadataMimeType;
+  std::string dataMimeType;
+
+  ResumePosition impliedPosition{0};
+  ResumePosition firstSentPosition{0};
+  ResumePosition lastSentPosition{0};
+  /// The buffered sent frames, starting at firstSentPosition.
+  std::vector<std::unique_ptr<folly::IOBuf>> sentFrames;
+
+  /// Next id of a stream started by the server, and the last id of a stream
+  /// started by the client.
+  StreamId nextStreamId{0};
+  StreamId lastPeerStreamId{0};
+  /// The streams open on the connection when it was handed over.
+  std::vector<StreamId> openStreams;
+
+  std::unique_ptr<folly::IOBuf> serialize() const;
+
+  /// Returns folly::none if `buf` isn't a serialized state.
+  static folly::Optional<ResumeStateTransfer> deserialize(
+      const folly::IOBuf& buf);
+};
+
+/// The socket of a connection handed over to another process of the same
+/// host along with its state, see HotRestart.h.
+struct HandedOverSocket {
+  /// -1 if the transport couldn't release it.
+  int fd{-1};
+  /// The bytes read from the socket which didn't make a whole frame yet.
+  folly::IOBufQueue unread{folly::IOBufQueue::cacheChainLength()};
+};
+
+} // namespace rsocket
@@ -80,4 +80,13 @@ void ScheduledRSocketResponder::handleFireAndForget(
   inner_->handleFireAndForget(std::move(request), streamId);
 }
 
+bool ScheduledRSocketResponder::batchesFireAndForget() const {
+  return inner_->batchesFireAndForget();
+}
+
+void ScheduledRSocketResponder::handleFireAndForgetBatch(
+    std::vector<std::pair<Payload, StreamId>> requests) {
+  inner_->handleFireAndForgetBatch(std::move(requests));
+}
+
 } // rsocket
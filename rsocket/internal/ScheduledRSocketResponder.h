@@ -41,6 +41,11 @@ class ScheduledRSocketResponder : public RSocketResponder {
       Payload request,
       StreamId streamId) override;
 
+  bool batchesFireAndForget() const override;
+
+  void handleFireAndForgetBatch(
+      std::vector<std::pair<Payload, StreamId>> requests) override;
+
  private:
   std::shared_ptr<RSocketResponder> inner_;
   folly::EventBase& eventBase_;
@@ -4,6 +4,7 @@
 
 #include <folly/io/async/EventBase.h>
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/internal/ScheduledSingleSubscription.h"
 #include "yarpl/single/SingleObserver.h"
 #include "yarpl/single/Singles.h"
@@ -18,7 +19,9 @@ namespace rsocket {
 // scheduled on the right EventBase.
 //
 template<typename T>
-class ScheduledSingleObserver : public yarpl::single::SingleObserver<T> {
+class ScheduledSingleObserver final
+    : public yarpl::single::SingleObserver<T>,
+      public PoolAllocated<ScheduledSingleObserver<T>> {
  public:
   ScheduledSingleObserver(
       yarpl::Reference<yarpl::single::SingleObserver<T>> observer,
@@ -74,7 +77,9 @@ class ScheduledSingleObserver : public yarpl::single::SingleObserver<T> {
 // call to Subscription::cancel safe.
 //
 template<typename T>
-class ScheduledSubscriptionSingleObserver : public yarpl::single::SingleObserver<T> {
+class ScheduledSubscriptionSingleObserver final
+    : public yarpl::single::SingleObserver<T>,
+      public PoolAllocated<ScheduledSubscriptionSingleObserver<T>> {
  public:
   ScheduledSubscriptionSingleObserver(
       yarpl::Reference<yarpl::single::SingleObserver<T>> observer,
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "yarpl/single/SingleSubscription.h"
 
 namespace folly {
@@ -14,7 +15,9 @@ namespace rsocket {
 // A decorator of the SingleSubscription object which schedules the method calls on the
 // provided EventBase
 //
-class ScheduledSingleSubscription : public yarpl::single::SingleSubscription {
+class ScheduledSingleSubscription
+    : public yarpl::single::SingleSubscription,
+      public PoolAllocated<ScheduledSingleSubscription> {
  public:
   ScheduledSingleSubscription(
       yarpl::Reference<yarpl::single::SingleSubscription> inner,
@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/internal/ScheduledSubscription.h"
 
 #include <folly/io/async/EventBase.h>
 
+#include "yarpl/flowable/Signal.h"
 #include "yarpl/flowable/Subscriber.h"
+#include "yarpl/utils/MpscQueue.h"
 
 namespace rsocket {
 
@@ -19,7 +22,8 @@ namespace rsocket {
 //
 
 template <typename T>
-class ScheduledSubscriber : public yarpl::flowable::Subscriber<T> {
+class ScheduledSubscriber : public yarpl::flowable::Subscriber<T>,
+                            public PoolAllocated<ScheduledSubscriber<T>> {
  public:
   ScheduledSubscriber(
       yarpl::Reference<yarpl::flowable::Subscriber<T>> inner,
@@ -28,55 +32,49 @@ class ScheduledSubscriber : public yarpl::flowable::Subscriber<T> {
 
   void onSubscribe(
       yarpl::Reference<yarpl::flowable::Subscription> subscription) override {
-    if (eventBase_.isInEventBaseThread()) {
-      inner_->onSubscribe(std::move(subscription));
-    } else {
-      eventBase_.runInEventBaseThread(
-      [inner = inner_, subscription = std::move(subscription)]
-      {
-        inner->onSubscribe(std::move(subscription));
-      });
-    }
+    signal(yarpl::flowable::Signal<T>::subscribe(std::move(subscription)));
   }
 
   // No further calls to the subscription after this method is invoked.
   void onComplete() override {
-    if (eventBase_.isInEventBaseThread()) {
-      inner_->onComplete();
-    } else {
-      eventBase_.runInEventBaseThread(
-      [inner = inner_]
-      {
-        inner->onComplete();
-      });
-    }
+    signal(yarpl::flowable::Signal<T>::complete());
   }
 
   void onError(folly::exception_wrapper ex) override {
-    if (eventBase_.isInEventBaseThread()) {
-      inner_->onError(std::move(ex));
-    } else {
-      eventBase_.runInEventBaseThread(
-      [inner = inner_, ex = std::move(ex)]() mutable {
-        inner->onError(std::move(ex));
-      });
-    }
+    signal(yarpl::flowable::Signal<T>::error(std::move(ex)));
   }
 
   void onNext(T value) override {
-    if (eventBase_.isInEventBaseThread()) {
-      inner_->onNext(std::move(value));
-    } else {
+    signal(yarpl::flowable::Signal<T>::next(std::move(value)));
+  }
+
+  void onNextBatch(std::vector<T> values) override {
+    signal(yarpl::flowable::Signal<T>::nextBatch(std::move(values)));
+  }
+
+ private:
+  // Signals from other threads are queued up and delivered by a single
+  // EventBase task, which is only scheduled when the queue was empty.  Signals
+  // on the EventBase thread go straight through unless they would overtake
+  // queued ones.
+  void signal(yarpl::flowable::Signal<T> signal) {
+    if (eventBase_.isInEventBaseThread() && queue_.empty()) {
+      signal.deliverTo(*inner_);
+    } else if (queue_.push(std::move(signal))) {
       eventBase_.runInEventBaseThread(
-      [inner = inner_, value = std::move(value)]() mutable {
-        inner->onNext(std::move(value));
-      });
+          [self = this->ref_from_this(this)] { self->drain(); });
     }
   }
 
- private:
+  void drain() {
+    queue_.drain([this](yarpl::flowable::Signal<T> signal) {
+      signal.deliverTo(*inner_);
+    });
+  }
+
   yarpl::Reference<yarpl::flowable::Subscriber<T>> inner_;
   folly::EventBase& eventBase_;
+  yarpl::MpscQueue<yarpl::flowable::Signal<T>> queue_;
 };
 
 //
@@ -89,7 +87,8 @@ class ScheduledSubscriber : public yarpl::flowable::Subscriber<T> {
 //
 template <typename T>
 class ScheduledSubscriptionSubscriber
-    : public yarpl::flowable::Subscriber<T> {
+    : public yarpl::flowable::Subscriber<T>,
+      public PoolAllocated<ScheduledSubscriptionSubscriber<T>> {
  public:
   ScheduledSubscriptionSubscriber(
       yarpl::Reference<yarpl::flowable::Subscriber<T>> inner,
@@ -115,6 +114,10 @@ class ScheduledSubscriptionSubscriber
     inner_->onNext(std::move(value));
   }
 
+  void onNextBatch(std::vector<T> values) override {
+    inner_->onNextBatch(std::move(values));
+  }
+
  private:
   yarpl::Reference<yarpl::flowable::Subscriber<T>> inner_;
   folly::EventBase& eventBase_;
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "yarpl/flowable/Subscription.h"
 
 namespace folly {
@@ -14,7 +15,8 @@ namespace rsocket {
 // A decorator of the Subscription object which schedules the method calls on the
 // provided EventBase
 //
-class ScheduledSubscription : public yarpl::flowable::Subscription {
+class ScheduledSubscription : public yarpl::flowable::Subscription,
+                              public PoolAllocated<ScheduledSubscription> {
  public:
   ScheduledSubscription(
       yarpl::Reference<yarpl::flowable::Subscription> inner,
@@ -9,6 +9,7 @@
 #include "rsocket/framing/FrameProcessor.h"
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/PayloadCompressor.h"
 
 namespace rsocket {
 
@@ -41,6 +42,22 @@ void closeWithError(
   output->onError(std::runtime_error{std::move(message)});
 }
 
+/// Counts a SETUP or RESUME as in progress while it lives.
+class InProgress {
+ public:
+  explicit InProgress(std::shared_ptr<std::atomic<size_t>> counter)
+      : counter_(std::move(counter)) {
+    ++*counter_;
+  }
+
+  ~InProgress() {
+    --*counter_;
+  }
+
+ private:
+  const std::shared_ptr<std::atomic<size_t>> counter_;
+};
+
 } // namespace
 
 SetupResumeAcceptor::OneFrameSubscriber::OneFrameSubscriber(
@@ -70,7 +87,9 @@ void SetupResumeAcceptor::OneFrameSubscriber::close() {
 
 void SetupResumeAcceptor::OneFrameSubscriber::onSubscribeImpl() {
   DCHECK(acceptor_.inOwnerThread());
-  this->request(std::numeric_limits<int32_t>::max());
+  // Only the first frame, the requests the client sent right after it stay
+  // buffered in the connection for the transport.
+  this->request(1);
 }
 
 void SetupResumeAcceptor::OneFrameSubscriber::onNextImpl(
@@ -96,8 +115,14 @@ void SetupResumeAcceptor::OneFrameSubscriber::onTerminateImpl() {
   acceptor_.remove(ref_from_this(this));
 }
 
-SetupResumeAcceptor::SetupResumeAcceptor(folly::EventBase* eventBase)
-    : eventBase_{eventBase} {
+SetupResumeAcceptor::SetupResumeAcceptor(
+    folly::EventBase* eventBase,
+    ProtocolVersion protocolVersion,
+    SetupAdmissionLimits admission)
+    : eventBase_{eventBase},
+      protocolVersion_{protocolVersion},
+      admission_{admission},
+      inProgress_{std::make_shared<std::atomic<size_t>>(0)} {
   CHECK(eventBase_);
 }
 
@@ -119,7 +144,9 @@ void SetupResumeAcceptor::processFrame(
     return;
   }
 
-  auto serializer = FrameSerializer::createAutodetectedSerializer(*buf);
+  auto serializer = protocolVersion_ == ProtocolVersion::Unknown
+      ? FrameSerializer::createAutodetectedSerializer(*buf)
+      : FrameSerializer::createFrameSerializer(protocolVersion_);
   if (!serializer) {
     std::string msg{"Unable to detect protocol version"};
     VLOG(2) << msg;
@@ -127,7 +154,19 @@ void SetupResumeAcceptor::processFrame(
     return;
   }
 
-  switch (serializer->peekFrameType(*buf)) {
+  auto const frameType = serializer->peekFrameType(*buf);
+  if (!admits(frameType)) {
+    VLOG(2) << "Shedding " << frameType << ", " << *inProgress_
+            << " in progress";
+    std::string msg{"Server is overloaded"};
+    auto err = serializer->serializeOut(
+        frameType == FrameType::SETUP ? Frame_ERROR::rejectedSetup(msg)
+                                      : Frame_ERROR::connectionError(msg));
+    closeWithError(std::move(connection), std::move(err), std::move(msg));
+    return;
+  }
+
+  switch (frameType) {
     case FrameType::SETUP: {
       Frame_SETUP frame;
       if (!serializer->deserializeFrom(frame, std::move(buf))) {
@@ -141,6 +180,7 @@ void SetupResumeAcceptor::processFrame(
 
       SetupParameters params;
       frame.moveToSetupPayload(params);
+      params.compressionRequested = requestsCompression(params);
 
       if (serializer->protocolVersion() != params.protocolVersion) {
         std::string msg{"SETUP frame has invalid protocol version"};
@@ -152,14 +192,14 @@ void SetupResumeAcceptor::processFrame(
       auto transport =
           yarpl::make_ref<FrameTransportImpl>(std::move(connection));
 
+      auto const version = params.protocolVersion;
       try {
         onSetup(transport, std::move(params));
       } catch (const std::exception& exn) {
-        folly::exception_wrapper ew{std::current_exception(), exn};
-        auto err = Frame_ERROR::rejectedSetup(ew.what().toStdString());
-        transport->setFrameProcessor(std::make_shared<NoneFrameProcessor>());
-        transport->outputFrameOrDrop(serializer->serializeOut(std::move(err)));
-        transport->closeWithError(std::move(ew));
+        rejectSetup(
+            std::move(transport),
+            version,
+            folly::exception_wrapper{std::current_exception(), exn});
       }
       break;
     }
@@ -191,14 +231,14 @@ void SetupResumeAcceptor::processFrame(
       auto transport =
           yarpl::make_ref<FrameTransportImpl>(std::move(connection));
 
+      auto const version = params.protocolVersion;
       try {
         onResume(transport, std::move(params));
       } catch (const std::exception& exn) {
-        folly::exception_wrapper ew{std::current_exception(), exn};
-        auto err = Frame_ERROR::rejectedResume(ew.what().toStdString());
-        transport->setFrameProcessor(std::make_shared<NoneFrameProcessor>());
-        transport->outputFrameOrDrop(serializer->serializeOut(std::move(err)));
-        transport->closeWithError(std::move(ew));
+        rejectResume(
+            std::move(transport),
+            version,
+            folly::exception_wrapper{std::current_exception(), exn});
       }
       break;
     }
@@ -212,6 +252,30 @@ void SetupResumeAcceptor::processFrame(
   }
 }
 
+void SetupResumeAcceptor::rejectSetup(
+    yarpl::Reference<FrameTransport> transport,
+    ProtocolVersion version,
+    folly::exception_wrapper ex) {
+  auto serializer = FrameSerializer::createFrameSerializer(version);
+  CHECK(serializer);
+  auto err = Frame_ERROR::rejectedSetup(ex.what().toStdString());
+  transport->setFrameProcessor(std::make_shared<NoneFrameProcessor>());
+  transport->outputFrameOrDrop(serializer->serializeOut(std::move(err)));
+  transport->closeWithError(std::move(ex));
+}
+
+void SetupResumeAcceptor::rejectResume(
+    yarpl::Reference<FrameTransport> transport,
+    ProtocolVersion version,
+    folly::exception_wrapper ex) {
+  auto serializer = FrameSerializer::createFrameSerializer(version);
+  CHECK(serializer);
+  auto err = Frame_ERROR::rejectedResume(ex.what().toStdString());
+  transport->setFrameProcessor(std::make_shared<NoneFrameProcessor>());
+  transport->outputFrameOrDrop(serializer->serializeOut(std::move(err)));
+  transport->closeWithError(std::move(ex));
+}
+
 void SetupResumeAcceptor::accept(
     std::unique_ptr<DuplexConnection> connection,
     OnSetup onSetup,
@@ -228,6 +292,24 @@ void SetupResumeAcceptor::accept(
   subscriber->setInput();
 }
 
+bool SetupResumeAcceptor::admits(FrameType type) const {
+  if (admission_.maxInProgress == 0) {
+    return true;
+  }
+  auto limit = admission_.maxInProgress;
+  if (type == FrameType::RESUME) {
+    limit += admission_.resumeHeadroom;
+  } else if (type != FrameType::SETUP) {
+    // Rejected as invalid anyway.
+    return true;
+  }
+  return *inProgress_ < limit;
+}
+
+std::shared_ptr<void> SetupResumeAcceptor::trackInProgress() {
+  return std::make_shared<InProgress>(inProgress_);
+}
+
 void SetupResumeAcceptor::remove(
     const yarpl::Reference<SetupResumeAcceptor::OneFrameSubscriber>&
         subscriber) {
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <unordered_set>
 
@@ -10,6 +11,7 @@
 
 #include "rsocket/DuplexConnection.h"
 #include "rsocket/RSocketParameters.h"
+#include "rsocket/framing/FrameType.h"
 #include "yarpl/Refcounted.h"
 
 namespace folly {
@@ -35,7 +37,13 @@ class SetupResumeAcceptor final {
   using OnResume =
       folly::Function<void(yarpl::Reference<FrameTransport>, ResumeParameters)>;
 
-  explicit SetupResumeAcceptor(folly::EventBase*);
+  /// Only accepts the first frames of `protocolVersion` when it is known,
+  /// detects the version of each connection otherwise.  Sheds the SETUPs and
+  /// RESUMEs past `admission`.
+  explicit SetupResumeAcceptor(
+      folly::EventBase*,
+      ProtocolVersion protocolVersion = ProtocolVersion::Unknown,
+      SetupAdmissionLimits admission = SetupAdmissionLimits());
   ~SetupResumeAcceptor();
 
   /// Wait for and process the first frame on a DuplexConnection, calling the
@@ -47,6 +55,28 @@ class SetupResumeAcceptor final {
   /// destroyed, provided we know the ID of the owner thread.
   folly::Future<folly::Unit> close();
 
+  /// Counts the SETUP or RESUME handed to OnSetup or OnResume as in progress,
+  /// see SetupAdmissionLimits, until the returned token is destroyed.  Those
+  /// which the callbacks complete before returning don't need one.
+  std::shared_ptr<void> trackInProgress();
+
+  /// Reject a SETUP whose transport was handed to OnSetup, sending an ERROR
+  /// frame with the message of `ex` and closing the transport.  An exception
+  /// thrown by OnSetup rejects it the same way.
+  static void rejectSetup(
+      yarpl::Reference<FrameTransport>,
+      ProtocolVersion,
+      folly::exception_wrapper ex);
+
+  /// Reject a RESUME whose transport was handed to OnResume, sending an ERROR
+  /// frame with the message of `ex` and closing the transport.  For a RESUME
+  /// rejected once OnResume has returned, an exception thrown by OnResume
+  /// rejects it the same way.
+  static void rejectResume(
+      yarpl::Reference<FrameTransport>,
+      ProtocolVersion,
+      folly::exception_wrapper ex);
+
  private:
   /// Subscriber that owns a connection, sets itself as that connection's input,
   /// and reads out a single frame before cancelling.
@@ -86,6 +116,9 @@ class SetupResumeAcceptor final {
       OnSetup,
       OnResume);
 
+  /// Whether a first frame of `type` fits in the admission limits.
+  bool admits(FrameType type) const;
+
   /// Remove a OneFrameSubscriber from the set.
   void remove(const yarpl::Reference<OneFrameSubscriber>&);
 
@@ -105,6 +138,11 @@ class SetupResumeAcceptor final {
   bool closed_{false};
 
   folly::EventBase* eventBase_;
+  const ProtocolVersion protocolVersion_;
+
+  const SetupAdmissionLimits admission_;
+  /// Shared with the tokens, which may outlive this.
+  const std::shared_ptr<std::atomic<size_t>> inProgress_;
 };
 
 } // namespace rsocket
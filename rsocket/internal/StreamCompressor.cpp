@@ -0,0 +1,264 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/StreamCompressor.h"
+
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/portability/Config.h>
+#include <glog/logging.h>
+
+#if FOLLY_HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+#if FOLLY_HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+namespace rsocket {
+
+namespace {
+
+using Codec = ConnectionCompression::Codec;
+
+/// Output buffers are allocated this big at least.
+constexpr size_t kMinOutputBytes = 4096;
+
+/// Stops a decompression whose output went past its limit.
+void checkOutput(const folly::IOBufQueue& out, size_t maxBytes) {
+  if (out.chainLength() > maxBytes) {
+    throw std::runtime_error(folly::to<std::string>(
+        "Compressed bytes decompress to more than ", maxBytes, " bytes"));
+  }
+}
+
+#if FOLLY_HAVE_LIBZSTD
+
+class ZstdCompressor : public StreamCompressor {
+ public:
+  explicit ZstdCompressor(int level) : stream_(ZSTD_createCStream()) {
+    CHECK(stream_);
+    check(ZSTD_initCStream(stream_, level > 0 ? level : 3));
+  }
+
+  ~ZstdCompressor() {
+    ZSTD_freeCStream(stream_);
+  }
+
+  std::unique_ptr<folly::IOBuf> compress(const folly::IOBuf& bytes) override {
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (auto range : bytes) {
+      ZSTD_inBuffer in{range.data(), range.size(), 0};
+      while (in.pos < in.size) {
+        auto space = out.preallocate(kMinOutputBytes, ZSTD_CStreamOutSize());
+        ZSTD_outBuffer output{space.first, space.second, 0};
+        check(ZSTD_compressStream(stream_, &output, &in));
+        out.postallocate(output.pos);
+      }
+    }
+    size_t left;
+    do {
+      auto space = out.preallocate(kMinOutputBytes, ZSTD_CStreamOutSize());
+      ZSTD_outBuffer output{space.first, space.second, 0};
+      left = check(ZSTD_flushStream(stream_, &output));
+      out.postallocate(output.pos);
+    } while (left > 0);
+    return out.move();
+  }
+
+ private:
+  static size_t check(size_t result) {
+    if (ZSTD_isError(result)) {
+      throw std::runtime_error(folly::to<std::string>(
+          "zstd compression failed: ", ZSTD_getErrorName(result)));
+    }
+    return result;
+  }
+
+  ZSTD_CStream* const stream_;
+};
+
+class ZstdDecompressor : public StreamDecompressor {
+ public:
+  ZstdDecompressor() : stream_(ZSTD_createDStream()) {
+    CHECK(stream_);
+    ZSTD_initDStream(stream_);
+  }
+
+  ~ZstdDecompressor() {
+    ZSTD_freeDStream(stream_);
+  }
+
+  std::unique_ptr<folly::IOBuf> decompress(
+      const folly::IOBuf& bytes,
+      size_t maxBytes) override {
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (auto range : bytes) {
+      ZSTD_inBuffer in{range.data(), range.size(), 0};
+      ZSTD_outBuffer output;
+      // The context may hold output back until there is room for it.
+      do {
+        auto space = out.preallocate(kMinOutputBytes, ZSTD_DStreamOutSize());
+        output = ZSTD_outBuffer{space.first, space.second, 0};
+        auto const result = ZSTD_decompressStream(stream_, &output, &in);
+        if (ZSTD_isError(result)) {
+          throw std::runtime_error(folly::to<std::string>(
+              "zstd decompression failed: ", ZSTD_getErrorName(result)));
+        }
+        out.postallocate(output.pos);
+        checkOutput(out, maxBytes);
+      } while (in.pos < in.size || output.pos == output.size);
+    }
+    return out.move();
+  }
+
+ private:
+  ZSTD_DStream* const stream_;
+};
+
+#endif
+
+#if FOLLY_HAVE_LIBZ
+
+class DeflateCompressor : public StreamCompressor {
+ public:
+  explicit DeflateCompressor(int level) {
+    stream_.zalloc = Z_NULL;
+    stream_.zfree = Z_NULL;
+    stream_.opaque = Z_NULL;
+    auto const result =
+        deflateInit(&stream_, level > 0 ? level : Z_DEFAULT_COMPRESSION);
+    CHECK_EQ(result, Z_OK);
+  }
+
+  ~DeflateCompressor() {
+    deflateEnd(&stream_);
+  }
+
+  std::unique_ptr<folly::IOBuf> compress(const folly::IOBuf& bytes) override {
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (auto range : bytes) {
+      stream_.next_in = const_cast<Bytef*>(range.data());
+      stream_.avail_in = static_cast<uInt>(range.size());
+      while (stream_.avail_in > 0) {
+        run(out, Z_NO_FLUSH);
+      }
+    }
+    // A sync flush is done once it leaves room in the output.
+    do {
+      run(out, Z_SYNC_FLUSH);
+    } while (stream_.avail_out == 0);
+    return out.move();
+  }
+
+ private:
+  void run(folly::IOBufQueue& out, int flush) {
+    auto space = out.preallocate(kMinOutputBytes, 4 * kMinOutputBytes);
+    stream_.next_out = static_cast<Bytef*>(space.first);
+    stream_.avail_out = static_cast<uInt>(space.second);
+    auto const result = deflate(&stream_, flush);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      throw std::runtime_error(
+          folly::to<std::string>("deflate failed: ", result));
+    }
+    out.postallocate(space.second - stream_.avail_out);
+  }
+
+  z_stream stream_;
+};
+
+class DeflateDecompressor : public StreamDecompressor {
+ public:
+  DeflateDecompressor() {
+    stream_.zalloc = Z_NULL;
+    stream_.zfree = Z_NULL;
+    stream_.opaque = Z_NULL;
+    stream_.next_in = Z_NULL;
+    stream_.avail_in = 0;
+    CHECK_EQ(inflateInit(&stream_), Z_OK);
+  }
+
+  ~DeflateDecompressor() {
+    inflateEnd(&stream_);
+  }
+
+  std::unique_ptr<folly::IOBuf> decompress(
+      const folly::IOBuf& bytes,
+      size_t maxBytes) override {
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (auto range : bytes) {
+      stream_.next_in = const_cast<Bytef*>(range.data());
+      stream_.avail_in = static_cast<uInt>(range.size());
+      do {
+        auto space = out.preallocate(kMinOutputBytes, 4 * kMinOutputBytes);
+        stream_.next_out = static_cast<Bytef*>(space.first);
+        stream_.avail_out = static_cast<uInt>(space.second);
+        auto const result = inflate(&stream_, Z_SYNC_FLUSH);
+        out.postallocate(space.second - stream_.avail_out);
+        checkOutput(out, maxBytes);
+        if (result == Z_BUF_ERROR) {
+          // No progress possible until more bytes arrive.
+          break;
+        }
+        if (result != Z_OK) {
+          throw std::runtime_error(
+              folly::to<std::string>("inflate failed: ", result));
+        }
+      } while (stream_.avail_in > 0 || stream_.avail_out == 0);
+    }
+    return out.move();
+  }
+
+ private:
+  z_stream stream_;
+};
+
+#endif
+
+} // namespace
+
+std::unique_ptr<StreamCompressor> StreamCompressor::create(
+    Codec codec,
+    int level) {
+  switch (codec) {
+    case Codec::ZSTD:
+#if FOLLY_HAVE_LIBZSTD
+      return std::make_unique<ZstdCompressor>(level);
+#else
+      break;
+#endif
+    case Codec::DEFLATE:
+#if FOLLY_HAVE_LIBZ
+      return std::make_unique<DeflateCompressor>(level);
+#else
+      break;
+#endif
+    case Codec::NONE:
+      break;
+  }
+  (void)level;
+  return nullptr;
+}
+
+std::unique_ptr<StreamDecompressor> StreamDecompressor::create(Codec codec) {
+  switch (codec) {
+    case Codec::ZSTD:
+#if FOLLY_HAVE_LIBZSTD
+      return std::make_unique<ZstdDecompressor>();
+#else
+      break;
+#endif
+    case Codec::DEFLATE:
+#if FOLLY_HAVE_LIBZ
+      return std::make_unique<DeflateDecompressor>();
+#else
+      break;
+#endif
+    case Codec::NONE:
+      break;
+  }
+  return nullptr;
+}
+
+} // namespace rsocket
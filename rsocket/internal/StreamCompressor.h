@@ -0,0 +1,46 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/RSocketParameters.h"
+
+namespace rsocket {
+
+/// The compressing side of a ConnectionCompression: one streaming context,
+/// whose window spans everything compressed with it.
+class StreamCompressor {
+ public:
+  virtual ~StreamCompressor() = default;
+
+  /// Compresses `bytes`, and flushes the context so that the peer can
+  /// decompress everything compressed so far.
+  virtual std::unique_ptr<folly::IOBuf> compress(const folly::IOBuf& bytes) = 0;
+
+  /// nullptr for NONE, or a codec folly was built without.
+  static std::unique_ptr<StreamCompressor> create(
+      ConnectionCompression::Codec codec,
+      int level);
+};
+
+/// The decompressing side of a ConnectionCompression.
+class StreamDecompressor {
+ public:
+  virtual ~StreamDecompressor() = default;
+
+  /// Decompresses the next bytes of the stream, which may end anywhere.
+  /// Throws std::runtime_error for corrupt bytes, or once they decompress to
+  /// more than `maxBytes`.
+  virtual std::unique_ptr<folly::IOBuf> decompress(
+      const folly::IOBuf& bytes,
+      size_t maxBytes) = 0;
+
+  /// nullptr for NONE, or a codec folly was built without.
+  static std::unique_ptr<StreamDecompressor> create(
+      ConnectionCompression::Codec codec);
+};
+
+} // namespace rsocket
@@ -0,0 +1,249 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Table of per-stream values indexed by StreamId.
+///
+/// Stream ids are allocated monotonically with a step of 2 (odd ids by the
+/// client, even ids by the server), so the live streams of each parity form a
+/// mostly dense window which slides forward as old streams end.  Each parity
+/// is kept in a ring of slots indexed by `streamId >> 1`, which avoids the
+/// per-stream node allocation and the pointer chasing of a hash map.  Ids
+/// which don't fit the window (a peer picking far apart ids, or a long-lived
+/// stream pinning the window while many new ones are opened) end up in a
+/// sparse hash map.
+///
+/// T must be default constructible and convertible to bool, with a default
+/// constructed value meaning "no stream" (e.g. yarpl::Reference).
+template <typename T>
+class StreamTable {
+ public:
+  /// Inserts a value for the stream.  Returns false if the stream is already
+  /// present, in which case the table is left unchanged.
+  bool insert(StreamId streamId, T value) {
+    DCHECK(value);
+    if (find(streamId)) {
+      return false;
+    }
+    if (!windows_[parity(streamId)].insert(key(streamId), value)) {
+      sparse_.emplace(streamId, std::move(value));
+    }
+    ++size_;
+    return true;
+  }
+
+  /// Returns a pointer to the value of the stream, or nullptr.  The pointer
+  /// is invalidated by the next insert/erase.
+  T* find(StreamId streamId) {
+    if (auto value = windows_[parity(streamId)].find(key(streamId))) {
+      return value;
+    }
+    if (sparse_.empty()) {
+      return nullptr;
+    }
+    auto it = sparse_.find(streamId);
+    return it == sparse_.end() ? nullptr : &it->second;
+  }
+
+  const T* find(StreamId streamId) const {
+    return const_cast<StreamTable*>(this)->find(streamId);
+  }
+
+  /// Removes the stream and returns its value, or a default constructed value
+  /// if the stream is not present.
+  T erase(StreamId streamId) {
+    auto value = windows_[parity(streamId)].erase(key(streamId));
+    if (!value && !sparse_.empty()) {
+      auto it = sparse_.find(streamId);
+      if (it != sparse_.end()) {
+        value = std::move(it->second);
+        sparse_.erase(it);
+      }
+    }
+    if (value) {
+      --size_;
+    }
+    return value;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Frees the slots of the windows without streams, they are allocated
+  /// again by the next insert.
+  void releaseEmptySlots() {
+    for (auto& window : windows_) {
+      window.releaseIfEmpty();
+    }
+    if (sparse_.empty()) {
+      sparse_.rehash(0);
+    }
+  }
+
+  /// Returns the id of one of the streams in the table.  The table must not
+  /// be empty.
+  StreamId anyStreamId() const {
+    DCHECK(!empty());
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      if (!windows_[i].empty()) {
+        return static_cast<StreamId>((windows_[i].lowestKey() << 1) | i);
+      }
+    }
+    DCHECK(!sparse_.empty());
+    return sparse_.begin()->first;
+  }
+
+  /// Calls fn(streamId, value) for every stream.  The table must not be
+  /// modified from within fn.
+  template <typename F>
+  void forEach(F&& fn) const {
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      windows_[i].forEach([&](uint32_t k, const T& value) {
+        fn(static_cast<StreamId>((k << 1) | i), value);
+      });
+    }
+    for (const auto& kv : sparse_) {
+      fn(kv.first, kv.second);
+    }
+  }
+
+ private:
+  static size_t parity(StreamId streamId) {
+    return streamId & 1;
+  }
+
+  static uint32_t key(StreamId streamId) {
+    return streamId >> 1;
+  }
+
+  /// Ring of slots covering the keys [base_, base_ + slots_.size()).
+  class Window {
+   public:
+    bool empty() const {
+      return count_ == 0;
+    }
+
+    uint32_t lowestKey() const {
+      DCHECK(!empty());
+      return base_;
+    }
+
+    void releaseIfEmpty() {
+      if (empty()) {
+        std::vector<T>().swap(slots_);
+      }
+    }
+
+    T* find(uint32_t k) {
+      if (empty() || k < base_ || k >= end_) {
+        return nullptr;
+      }
+      auto& slot = slots_[k & mask()];
+      return slot ? &slot : nullptr;
+    }
+
+    bool insert(uint32_t k, T& value) {
+      if (empty()) {
+        if (slots_.empty()) {
+          slots_.resize(kInitialCapacity);
+        }
+        base_ = k;
+        end_ = k + 1;
+      } else {
+        auto low = std::min(base_, k);
+        auto high = std::max(end_, k + 1);
+        if (high - low > slots_.size() && !grow(low, high)) {
+          return false;
+        }
+        base_ = low;
+        end_ = high;
+      }
+      slots_[k & mask()] = std::move(value);
+      ++count_;
+      return true;
+    }
+
+    T erase(uint32_t k) {
+      auto value = find(k);
+      if (!value) {
+        return T();
+      }
+      auto result = std::move(*value);
+      *value = T();
+      if (--count_ == 0) {
+        base_ = end_ = 0;
+        return result;
+      }
+      // keep both ends of the window on live streams so that it slides
+      // forward with the allocation of new ids
+      while (!slots_[base_ & mask()]) {
+        ++base_;
+      }
+      while (!slots_[(end_ - 1) & mask()]) {
+        --end_;
+      }
+      return result;
+    }
+
+    template <typename F>
+    void forEach(F&& fn) const {
+      for (auto k = base_; k < end_ && count_ > 0; ++k) {
+        const auto& slot = slots_[k & mask()];
+        if (slot) {
+          fn(k, slot);
+        }
+      }
+    }
+
+   private:
+    static constexpr size_t kInitialCapacity = 16;
+    static constexpr size_t kMaxCapacity = 1 << 16;
+
+    size_t mask() const {
+      return slots_.size() - 1;
+    }
+
+    bool grow(uint32_t low, uint32_t high) {
+      auto capacity = slots_.size();
+      while (capacity < high - low) {
+        capacity <<= 1;
+      }
+      if (capacity > kMaxCapacity) {
+        return false;
+      }
+      std::vector<T> slots(capacity);
+      for (auto k = base_; k < end_; ++k) {
+        slots[k & (capacity - 1)] = std::move(slots_[k & mask()]);
+      }
+      slots_ = std::move(slots);
+      return true;
+    }
+
+    std::vector<T> slots_;
+    uint32_t base_{0};
+    uint32_t end_{0};
+    size_t count_{0};
+  };
+
+  std::array<Window, 2> windows_;
+  std::unordered_map<StreamId, T> sparse_;
+  size_t size_{0};
+};
+
+} // namespace rsocket
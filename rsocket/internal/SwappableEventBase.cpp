@@ -2,9 +2,25 @@
 
 #include "SwappableEventBase.h"
 
+#include <thread>
+
 namespace rsocket {
 
 bool SwappableEventBase::runInEventBaseThread(CbFunc cb) {
+  // Announced before reading current_, so that either setEventBase sees this
+  // call and waits for it, or this call sees the swap.
+  posting_.fetch_add(1);
+  if (auto eb = current_.load()) {
+    auto const posted = eb->runInEventBaseThread(
+        [eb, cb_ = std::move(cb)]() mutable { return cb_(*eb); });
+    posting_.fetch_sub(1, std::memory_order_release);
+    return posted;
+  }
+  posting_.fetch_sub(1, std::memory_order_release);
+  return runInEventBaseThreadSlow(std::move(cb));
+}
+
+bool SwappableEventBase::runInEventBaseThreadSlow(CbFunc cb) {
   std::lock_guard<std::mutex> l(hasSebDtored_->l_);
 
   if(this->isSwapping()) {
@@ -26,6 +42,13 @@ void SwappableEventBase::setEventBase(folly::EventBase& newEb) {
     return;
   }
 
+  // The callbacks which already read eb_ from current_ have to be enqueued
+  // before the swap, they only take that long.
+  current_.store(nullptr);
+  while (posting_.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+
   eb_->runInEventBaseThread([this, hasSebDtored = hasSebDtored_]() {
     std::lock_guard<std::mutex> lInner(hasSebDtored->l_);
     if(hasSebDtored->destroyed_) {
@@ -45,6 +68,8 @@ void SwappableEventBase::setEventBase(folly::EventBase& newEb) {
     }
 
     queued_.clear();
+    // After the queued callbacks, which come before the ones which read it.
+    current_.store(eb_);
   });
 }
 
@@ -4,6 +4,7 @@
 
 #include <folly/io/async/EventBase.h>
 #include <folly/Function.h>
+#include <atomic>
 #include <mutex>
 
 namespace rsocket {
@@ -12,6 +13,11 @@ namespace rsocket {
 // an underlying EventBase to be changed, and to force callbacks to be
 // executed in serial order regardless of which underlying EventBase they are
 // enqueued on.
+//
+// Swaps are rare, so runInEventBaseThread only takes the lock while one is
+// pending.  Otherwise it reads the EventBase from an atomic, and announces
+// itself in another one so that a swap waits for it to enqueue on the old
+// EventBase before it starts.
 class SwappableEventBase final {
   // std::mutex doesn't like being in a std::pair
   struct MutexBoolPair {
@@ -25,7 +31,8 @@ public:
   using CbFunc = folly::Function<void(folly::EventBase&)>;
 
   explicit SwappableEventBase(folly::EventBase& eb)
-  : eb_(&eb),
+  : current_(&eb),
+    eb_(&eb),
     nextEb_(nullptr),
     hasSebDtored_(std::make_shared<MutexBoolPair>()) {}
 
@@ -48,6 +55,15 @@ public:
   ~SwappableEventBase();
 
 private:
+  // runInEventBaseThread while a swap is pending, under the lock
+  bool runInEventBaseThreadSlow(CbFunc cb);
+
+  // eb_ while no swap is pending, nullptr otherwise.  Read without the lock.
+  std::atomic<folly::EventBase*> current_;
+  // calls to runInEventBaseThread between reading current_ and enqueueing
+  // on it, which a swap waits for
+  std::atomic<size_t> posting_{0};
+
   folly::EventBase* eb_;
   folly::EventBase* nextEb_; // also indicate if we're in the middle of a swap
 
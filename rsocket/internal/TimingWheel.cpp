@@ -0,0 +1,108 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/internal/TimingWheel.h"
+
+#include <algorithm>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+constexpr std::chrono::milliseconds TimingWheel::kDefaultTick;
+constexpr size_t TimingWheel::kDefaultNumSlots;
+
+TimingWheel::TimingWheel(
+    folly::EventBase& eventBase,
+    std::chrono::milliseconds tick,
+    size_t numSlots)
+    : folly::AsyncTimeout(&eventBase),
+      tick_(std::max(tick, std::chrono::milliseconds(1))),
+      start_(Clock::now()),
+      slots_(std::max<size_t>(numSlots, 1)) {}
+
+TimingWheel& TimingWheel::get(folly::EventBase& eventBase) {
+  static folly::EventBaseLocal<TimingWheel> wheels;
+  return wheels.getOrCreate(eventBase, eventBase);
+}
+
+TimingWheel::Handle TimingWheel::schedule(
+    std::chrono::milliseconds timeout,
+    folly::Function<void()> callback) {
+  auto const deadline =
+      Clock::now() + std::max(timeout, std::chrono::milliseconds(0));
+  // Round up, so that the timeout never fires early.
+  auto tick = ticksSinceStart(deadline);
+  if (start_ + tick_ * static_cast<int64_t>(tick) < deadline) {
+    ++tick;
+  }
+  tick = std::max(tick, nextTick_);
+
+  Handle handle;
+  handle.slot = tick % slots_.size();
+  handle.id = nextId_++;
+  slots_[handle.slot].emplace(handle.id, Entry{deadline, std::move(callback)});
+  ++size_;
+
+  if (!isScheduled()) {
+    scheduleTimeout(tick_);
+  }
+  return handle;
+}
+
+void TimingWheel::cancel(Handle handle) {
+  if (handle.id == 0) {
+    return;
+  }
+  DCHECK_LT(handle.slot, slots_.size());
+  size_ -= slots_[handle.slot].erase(handle.id);
+  if (size_ == 0) {
+    cancelTimeout();
+  }
+}
+
+void TimingWheel::timeoutExpired() noexcept {
+  auto const now = Clock::now();
+  auto const nowTick = ticksSinceStart(now);
+
+  // Collect the expired timeouts first, their callbacks can schedule and
+  // cancel timeouts.  Every slot is visited at most once, however late this
+  // runs.
+  std::vector<Handle> expired;
+  for (size_t i = 0; nextTick_ <= nowTick && i < slots_.size(); ++i) {
+    auto const slotIndex = nextTick_ % slots_.size();
+    for (const auto& entry : slots_[slotIndex]) {
+      if (entry.second.deadline <= now) {
+        expired.push_back(Handle{slotIndex, entry.first});
+      }
+    }
+    ++nextTick_;
+  }
+  nextTick_ = std::max(nextTick_, nowTick + 1);
+
+  for (auto handle : expired) {
+    // An earlier callback may have cancelled it.
+    auto& slot = slots_[handle.slot];
+    auto it = slot.find(handle.id);
+    if (it == slot.end()) {
+      continue;
+    }
+    auto callback = std::move(it->second.callback);
+    slot.erase(it);
+    --size_;
+    callback();
+  }
+
+  if (size_ > 0 && !isScheduled()) {
+    scheduleTimeout(tick_);
+  }
+}
+
+uint64_t TimingWheel::ticksSinceStart(Clock::time_point time) const {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(time - start_)
+          .count() /
+      tick_.count());
+}
+
+} // namespace rsocket
@@ -0,0 +1,75 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+namespace rsocket {
+
+/// Hashed timing wheel for the stream deadlines of the connections of an
+/// EventBase.  Timeouts are rounded up to the next tick, and a single
+/// AsyncTimeout drives the wheel while it has timeouts scheduled.
+///
+/// Not thread safe, it must only be used from the thread of its EventBase.
+class TimingWheel : private folly::AsyncTimeout {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Identifies a scheduled timeout.  The default constructed handle doesn't
+  /// refer to any.
+  struct Handle {
+    size_t slot{0};
+    uint64_t id{0};
+  };
+
+  static constexpr std::chrono::milliseconds kDefaultTick{10};
+  static constexpr size_t kDefaultNumSlots{512};
+
+  explicit TimingWheel(
+      folly::EventBase& eventBase,
+      std::chrono::milliseconds tick = kDefaultTick,
+      size_t numSlots = kDefaultNumSlots);
+
+  /// Returns the wheel of an EventBase, creating it on first use.
+  static TimingWheel& get(folly::EventBase& eventBase);
+
+  /// Calls `callback` once `timeout` has passed, unless cancelled before.
+  Handle schedule(
+      std::chrono::milliseconds timeout,
+      folly::Function<void()> callback);
+
+  /// Cancels a timeout.  Does nothing if it already fired or was cancelled.
+  void cancel(Handle handle);
+
+  /// Number of scheduled timeouts.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  struct Entry {
+    Clock::time_point deadline;
+    folly::Function<void()> callback;
+  };
+
+  void timeoutExpired() noexcept override;
+
+  /// Number of ticks from start_ to `time`, rounded down.
+  uint64_t ticksSinceStart(Clock::time_point time) const;
+
+  const std::chrono::milliseconds tick_;
+  const Clock::time_point start_;
+  std::vector<std::unordered_map<uint64_t, Entry>> slots_;
+  /// The next tick whose slot hasn't been processed yet.
+  uint64_t nextTick_{0};
+  uint64_t nextId_{1};
+  size_t size_{0};
+};
+
+} // namespace rsocket
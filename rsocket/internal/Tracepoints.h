@@ -0,0 +1,31 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <folly/tracing/StaticTracepoint.h>
+
+/// USDT probes of the provider "rsocket", to trace the connections of a
+/// process which is running, e.g. with bpftrace:
+///
+///   bpftrace -e 'usdt:/path/to/binary:rsocket:frame_read
+///                { @bytes[arg3] = sum(arg4); }'
+///
+/// A probe compiles to a single nop, until a tracer attaches to it.  The first
+/// argument of every probe identifies the connection, the second is its mode
+/// (0 for a server, 1 for a client):
+///
+///   frame_read, frame_written: stream id, frame type, frame length
+///   stream_open: stream id
+///   stream_close: stream id, StreamCompletionSignal
+///   resume_start
+///   resume_finish: 1 when resumed, 0 otherwise
+///   keepalive_sent, keepalive_received: flags, data length
+///
+/// Build with -DRSOCKET_TRACEPOINTS=OFF to leave them out.
+#ifdef RSOCKET_NO_TRACEPOINTS
+#define RSOCKET_TRACE(name, ...) \
+  do {                           \
+  } while (false)
+#else
+#define RSOCKET_TRACE(name, ...) FOLLY_SDT(rsocket, name, ##__VA_ARGS__)
+#endif
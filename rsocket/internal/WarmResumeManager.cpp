@@ -3,10 +3,33 @@
 #include "rsocket/internal/WarmResumeManager.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/internal/ResumeBufferPool.h"
+#include "rsocket/internal/ResumeStateTransfer.h"
 
 namespace rsocket {
 
+WarmResumeManager::WarmResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    std::shared_ptr<ResumeBufferPool> pool,
+    size_t capacity)
+    : stats_(std::move(stats)), capacity_(capacity), pool_(std::move(pool)) {
+  if (pool_) {
+    pool_->add(*this);
+  }
+}
+
 WarmResumeManager::~WarmResumeManager() {
+  // Once removed the pool doesn't take chunks back anymore.
+  if (pool_) {
+    pool_->remove(*this);
+  }
   clearFrames(lastSentPosition_);
 }
 
@@ -22,34 +45,46 @@ void WarmResumeManager::trackReceivedFrame(
   }
 }
 
+void WarmResumeManager::trackReceivedFrames(
+    const std::vector<ReceivedFrameInfo>& infos) {
+  for (const auto& info : infos) {
+    if (shouldTrackFrame(info.frameType)) {
+      impliedPosition_ += info.frameLength;
+    }
+  }
+  VLOG(6) << "Track " << infos.size() << " received frames";
+}
+
 void WarmResumeManager::trackSentFrame(
     const folly::IOBuf& serializedFrame,
+    size_t frameLength,
     FrameType frameType,
     StreamId,
     size_t consumerAllowance) {
   if (shouldTrackFrame(frameType)) {
-    // TODO(tmont): this could be expensive, find a better way to get length
-    auto frameDataLength = serializedFrame.computeChainDataLength();
+    DCHECK_EQ(frameLength, serializedFrame.computeChainDataLength());
 
     VLOG(6) << "Track sent frame " << frameType
             << " Allowance: " << consumerAllowance;
-    // If the frame is too huge, we don't cache it.
-    // We empty the entire cache instead.
-    if (frameDataLength > capacity_) {
+    auto lock = lockBuffer();
+    // If the frame is too huge, or the pool is out of chunks, we don't cache
+    // it.  We empty the entire cache instead.
+    if (frameLength > limit_ ||
+        !addFrame(lastSentPosition_, serializedFrame, frameLength)) {
       resetUpToPosition(lastSentPosition_);
-      lastSentPosition_ += frameDataLength;
-      firstSentPosition_ += frameDataLength;
+      lastSentPosition_ += frameLength;
+      firstSentPosition_ += frameLength;
       DCHECK(firstSentPosition_ == lastSentPosition_);
       DCHECK(size_ == 0);
       return;
     }
 
-    addFrame(serializedFrame, frameDataLength);
-    lastSentPosition_ += frameDataLength;
+    lastSentPosition_ += frameLength;
   }
 }
 
 void WarmResumeManager::resetUpToPosition(ResumePosition position) {
+  auto lock = lockBuffer();
   if (position <= firstSentPosition_) {
     return;
   }
@@ -61,89 +96,355 @@ void WarmResumeManager::resetUpToPosition(ResumePosition position) {
   clearFrames(position);
 
   firstSentPosition_ = position;
-  DCHECK(frames_.empty() || frames_.front().first == firstSentPosition_);
+  DCHECK(frameCount() == 0 || framePosition(0) == firstSentPosition_);
 }
 
 bool WarmResumeManager::isPositionAvailable(ResumePosition position) const {
+  auto lock = lockBuffer();
   return (lastSentPosition_ == position) ||
       std::binary_search(
-             frames_.begin(),
-             frames_.end(),
-             std::make_pair(position, std::unique_ptr<folly::IOBuf>()),
-             [](decltype(frames_.back()) pairA,
-                decltype(frames_.back()) pairB) {
-               return pairA.first < pairB.first;
-             });
+             positions_.begin() + firstFrame_, positions_.end(), position);
 }
 
-void WarmResumeManager::addFrame(
+bool WarmResumeManager::addFrame(
+    ResumePosition position,
     const folly::IOBuf& frame,
-    size_t frameDataLength) {
-  size_ += frameDataLength;
-  while (size_ > capacity_) {
+    size_t frameLength) {
+  DCHECK_LE(frameLength, limit_);
+  while (frameCount() > 0 &&
+         static_cast<size_t>(position - framePosition(0)) + frameLength >
+             limit_) {
     evictFrame();
   }
-  frames_.emplace_back(lastSentPosition_, frame.clone());
-  stats_->resumeBufferChanged(1, static_cast<int>(frameDataLength));
+  if (frameLength >= kMinSharedFrameLength) {
+    positions_.push_back(position);
+    copiedOffsets_.push_back(copied_);
+    sharedFrames_.push_back(frame.clone());
+    sharedBytes_ += frameLength;
+    stats_->resumeBufferChanged(1, static_cast<int>(frameLength));
+    return true;
+  }
+  if (pool_) {
+    if (!reserveChunks(frameLength)) {
+      return false;
+    }
+  } else {
+    reserve(size_ + frameLength);
+  }
+
+  auto offset = size_;
+  for (auto range : frame) {
+    auto data = range.data();
+    auto length = range.size();
+    while (length > 0) {
+      size_t contiguous;
+      auto dest = bufferAt(offset, contiguous);
+      auto chunk = std::min(length, contiguous);
+      std::memcpy(dest, data, chunk);
+      offset += chunk;
+      data += chunk;
+      length -= chunk;
+    }
+  }
+
+  positions_.push_back(position);
+  copiedOffsets_.push_back(copied_);
+  sharedFrames_.emplace_back();
+  size_ += frameLength;
+  copied_ += frameLength;
+  stats_->resumeBufferChanged(1, static_cast<int>(frameLength));
+  return true;
 }
 
 void WarmResumeManager::evictFrame() {
-  DCHECK(!frames_.empty());
+  DCHECK_GT(frameCount(), 0);
 
-  auto position = frames_.size() > 1 ? std::next(frames_.begin())->first
-                                     : lastSentPosition_;
+  auto position = frameCount() > 1 ? framePosition(1) : lastSentPosition_;
   resetUpToPosition(position);
 }
 
 void WarmResumeManager::clearFrames(ResumePosition position) {
-  if (frames_.empty()) {
+  std::vector<Chunk> freed;
+  dropFrames(position, freed);
+  if (!freed.empty()) {
+    pool_->release(std::move(freed));
+  }
+}
+
+void WarmResumeManager::dropFrames(
+    ResumePosition position,
+    std::vector<Chunk>& freed) {
+  if (frameCount() == 0) {
     return;
   }
   DCHECK(position <= lastSentPosition_);
   DCHECK(position >= firstSentPosition_);
 
-  auto end = std::lower_bound(
-      frames_.begin(),
-      frames_.end(),
-      position,
-      [](decltype(frames_.back()) pair, ResumePosition pos) {
-        return pair.first < pos;
-      });
-  DCHECK(end == frames_.end() || end->first >= firstSentPosition_);
-  auto pos = end == frames_.end() ? position : end->first;
+  auto begin = positions_.begin() + firstFrame_;
+  auto end = std::lower_bound(begin, positions_.end(), position);
+  auto const count = static_cast<size_t>(std::distance(begin, end));
+  auto const last = firstFrame_ + count;
+  auto const bytes = static_cast<size_t>(
+      (end == positions_.end() ? lastSentPosition_ : *end) - *begin);
   stats_->resumeBufferChanged(
-      -static_cast<int>(std::distance(frames_.begin(), end)),
-      -static_cast<int>(pos - firstSentPosition_));
+      -static_cast<int>(count), -static_cast<int>(bytes));
+
+  for (auto i = firstFrame_; i < last; ++i) {
+    if (auto shared = std::move(sharedFrames_[i])) {
+      sharedBytes_ -= shared->computeChainDataLength();
+    }
+  }
+  auto const copied = copiedBefore(last) - copiedBefore(firstFrame_);
+  size_ -= copied;
+  firstFrame_ = last;
+  if (firstFrame_ * 2 >= positions_.size()) {
+    eraseEvictedFrames();
+  }
+
+  if (size_ == 0) {
+    head_ = 0;
+    std::move(chunks_.begin(), chunks_.end(), std::back_inserter(freed));
+    chunks_.clear();
+  } else if (pool_) {
+    head_ += copied;
+    while (head_ >= pool_->chunkSize()) {
+      freed.push_back(std::move(chunks_.front()));
+      chunks_.pop_front();
+      head_ -= pool_->chunkSize();
+    }
+  } else {
+    head_ = (head_ + copied) % ringSize_;
+  }
+}
+
+void WarmResumeManager::eraseEvictedFrames() {
+  positions_.erase(positions_.begin(), positions_.begin() + firstFrame_);
+  copiedOffsets_.erase(
+      copiedOffsets_.begin(), copiedOffsets_.begin() + firstFrame_);
+  sharedFrames_.erase(
+      sharedFrames_.begin(), sharedFrames_.begin() + firstFrame_);
+  firstFrame_ = 0;
+}
+
+void WarmResumeManager::releaseBuffers() {
+  auto lock = lockBuffer();
+  eraseEvictedFrames();
+  positions_.shrink_to_fit();
+  copiedOffsets_.shrink_to_fit();
+  sharedFrames_.shrink_to_fit();
+  if (pool_) {
+    // The chunks only cover the buffered frames already.
+    chunks_.shrink_to_fit();
+    return;
+  }
+  if (size_ == ringSize_) {
+    return;
+  }
+  std::unique_ptr<uint8_t[]> ring(size_ > 0 ? new uint8_t[size_] : nullptr);
+  copyOut(0, size_, ring.get());
+  ring_ = std::move(ring);
+  ringSize_ = size_;
+  head_ = 0;
+}
+
+void WarmResumeManager::limitBuffer(double fraction) {
+  auto lock = lockBuffer();
+  auto const limit = static_cast<size_t>(capacity_ * fraction);
+  auto const lowered = limit < limit_;
+  limit_ = std::min(limit, capacity_);
+  if (!lowered) {
+    return;
+  }
+  while (frameCount() > 0 &&
+         static_cast<size_t>(lastSentPosition_ - framePosition(0)) > limit_) {
+    evictFrame();
+  }
+  releaseBuffers();
+}
+
+void WarmResumeManager::reserve(size_t size) {
+  if (ring_ && size <= ringSize_) {
+    return;
+  }
+
+  constexpr size_t kMinRingSize = 4096;
+  auto newSize = std::max(ringSize_, kMinRingSize);
+  while (newSize < size) {
+    newSize *= 2;
+  }
+  newSize = std::min(newSize, std::max(limit_, size));
+
+  std::unique_ptr<uint8_t[]> ring(new uint8_t[newSize]);
+  copyOut(0, size_, ring.get());
+  ring_ = std::move(ring);
+  ringSize_ = newSize;
+  head_ = 0;
+}
+
+bool WarmResumeManager::reserveChunks(size_t frameLength) {
+  auto const chunkSize = pool_->chunkSize();
+  while (chunks_.size() * chunkSize < head_ + size_ + frameLength) {
+    if (auto chunk = pool_->allocate(*this)) {
+      chunks_.push_back(std::move(chunk));
+    } else if (frameCount() > 0) {
+      evictFrame();
+    } else {
+      std::vector<Chunk> freed(
+          std::make_move_iterator(chunks_.begin()),
+          std::make_move_iterator(chunks_.end()));
+      chunks_.clear();
+      head_ = 0;
+      if (!freed.empty()) {
+        pool_->release(std::move(freed));
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<WarmResumeManager::Chunk> WarmResumeManager::shedChunk() {
+  DCHECK_GT(frameCount(), 0U);
+  // The frames starting in the oldest chunk go with it.
+  auto const chunkSize = pool_->chunkSize();
+  auto begin = copiedOffsets_.begin() + firstFrame_;
+  auto next = std::lower_bound(
+      begin, copiedOffsets_.end(), copied_ - size_ + chunkSize - head_);
+  auto const position = next == copiedOffsets_.end()
+      ? lastSentPosition_
+      : positions_[std::distance(copiedOffsets_.begin(), next)];
+
+  std::vector<Chunk> freed;
+  dropFrames(position, freed);
+  firstSentPosition_ = position;
+  return freed;
+}
+
+std::unique_lock<std::recursive_mutex> WarmResumeManager::lockBuffer() const {
+  return pool_ ? std::unique_lock<std::recursive_mutex>(mutex_)
+               : std::unique_lock<std::recursive_mutex>();
+}
+
+uint8_t* WarmResumeManager::bufferAt(size_t offset, size_t& contiguous)
+    const {
+  if (pool_) {
+    auto const chunkSize = pool_->chunkSize();
+    auto const index = (head_ + offset) / chunkSize;
+    auto const from = (head_ + offset) % chunkSize;
+    contiguous = chunkSize - from;
+    return chunks_[index].get() + from;
+  }
+  auto const from = (head_ + offset) % ringSize_;
+  contiguous = ringSize_ - from;
+  return ring_.get() + from;
+}
+
+void WarmResumeManager::copyOut(size_t offset, size_t length, uint8_t* dest)
+    const {
+  DCHECK_LE(offset + length, size_);
+  while (length > 0) {
+    size_t contiguous;
+    auto from = bufferAt(offset, contiguous);
+    auto chunk = std::min(length, contiguous);
+    std::memcpy(dest, from, chunk);
+    offset += chunk;
+    dest += chunk;
+    length -= chunk;
+  }
+}
+
+size_t WarmResumeManager::frameLength(size_t index) const {
+  DCHECK_LT(index, frameCount());
+  auto const next = index + 1 < frameCount() ? framePosition(index + 1)
+                                             : lastSentPosition_;
+  return static_cast<size_t>(next - framePosition(index));
+}
+
+std::unique_ptr<folly::IOBuf> WarmResumeManager::copyFrame(
+    size_t index) const {
+  if (auto const& shared = sharedFrames_[firstFrame_ + index]) {
+    return shared->clone();
+  }
+  auto const length = frameLength(index);
+  auto frame = folly::IOBuf::create(length);
+  copyFrame(index, frame->writableData());
+  frame->append(length);
+  return frame;
+}
+
+void WarmResumeManager::copyFrame(size_t index, uint8_t* dest) const {
+  if (auto const& shared = sharedFrames_[firstFrame_ + index]) {
+    folly::io::Cursor(shared.get()).pull(dest, frameLength(index));
+    return;
+  }
+  copyOut(bufferOffset(index), frameLength(index), dest);
+}
 
-  frames_.erase(frames_.begin(), end);
-  size_ -= static_cast<decltype(size_)>(pos - firstSentPosition_);
+void WarmResumeManager::exportState(ResumeStateTransfer& state) const {
+  auto lock = lockBuffer();
+  state.impliedPosition = impliedPosition_;
+  state.firstSentPosition = firstSentPosition_;
+  state.lastSentPosition = lastSentPosition_;
+  state.sentFrames.clear();
+  for (size_t i = 0; i < frameCount(); ++i) {
+    state.sentFrames.push_back(copyFrame(i));
+  }
+}
+
+bool WarmResumeManager::importState(const ResumeStateTransfer& state) {
+  auto lock = lockBuffer();
+  if (state.impliedPosition < 0 || state.firstSentPosition < 0 ||
+      state.firstSentPosition > state.lastSentPosition) {
+    return false;
+  }
+  clearFrames(lastSentPosition_);
+  impliedPosition_ = state.impliedPosition;
+  firstSentPosition_ = state.firstSentPosition;
+  lastSentPosition_ = state.firstSentPosition;
+  // Frames which don't fit in this buffer are dropped like when sent.
+  for (const auto& frame : state.sentFrames) {
+    WarmResumeManager::trackSentFrame(
+        *frame, frame->computeChainDataLength(), FrameType::PAYLOAD, 0, 0);
+  }
+  if (state.sentFrames.empty()) {
+    firstSentPosition_ = lastSentPosition_ = state.lastSentPosition;
+  }
+  return lastSentPosition_ == state.lastSentPosition;
 }
 
 void WarmResumeManager::sendFramesFromPosition(
     ResumePosition position,
     FrameTransport& frameTransport) const {
+  replayFramesFromPosition(
+      position, frameTransport, std::numeric_limits<size_t>::max());
+}
+
+ResumePosition WarmResumeManager::replayFramesFromPosition(
+    ResumePosition position,
+    FrameTransport& frameTransport,
+    size_t maxBytes) const {
+  auto lock = lockBuffer();
   DCHECK(isPositionAvailable(position));
 
   if (position == lastSentPosition_) {
     // idle resumption
-    return;
+    return position;
   }
 
-  auto found = std::lower_bound(
-      frames_.begin(),
-      frames_.end(),
-      position,
-      [](decltype(frames_.back()) pair, ResumePosition pos) {
-        return pair.first < pos;
-      });
+  auto begin = positions_.begin() + firstFrame_;
+  auto found = std::lower_bound(begin, positions_.end(), position);
 
-  DCHECK(found != frames_.end());
-  DCHECK(found->first == position);
+  DCHECK(found != positions_.end());
+  DCHECK(*found == position);
 
-  while (found != frames_.end()) {
-    frameTransport.outputFrameOrDrop(found->second->clone());
-    found++;
+  size_t sent = 0;
+  auto index = static_cast<size_t>(std::distance(begin, found));
+  while (index < frameCount() && sent < maxBytes) {
+    sent += frameLength(index);
+    frameTransport.outputFrameOrDrop(copyFrame(index));
+    ++index;
   }
+  return index < frameCount() ? framePosition(index) : lastSentPosition_;
 }
 
 } // reactivesocket
@@ -3,18 +3,22 @@
 #pragma once
 
 #include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
 
 #include "rsocket/RSocketStats.h"
 #include "rsocket/ResumeManager.h"
-
-namespace folly {
-class IOBuf;
-}
+#include "rsocket/internal/ResumeBufferPool.h"
 
 namespace rsocket {
 
 class RSocketStateMachine;
 class FrameTransport;
+struct ResumeStateTransfer;
 
 class WarmResumeManager : public ResumeManager {
  public:
@@ -22,6 +26,14 @@ class WarmResumeManager : public ResumeManager {
       std::shared_ptr<RSocketStats> stats,
       size_t capacity = DEFAULT_CAPACITY)
       : stats_(std::move(stats)), capacity_(capacity) {}
+
+  /// Buffers the sent frames in chunks borrowed from `pool`, which can take
+  /// them back with the oldest frames for other connections.  The manager
+  /// still buffers at most `capacity` bytes.
+  WarmResumeManager(
+      std::shared_ptr<RSocketStats> stats,
+      std::shared_ptr<ResumeBufferPool> pool,
+      size_t capacity = DEFAULT_CAPACITY);
   ~WarmResumeManager();
 
   void trackReceivedFrame(
@@ -30,8 +42,12 @@ class WarmResumeManager : public ResumeManager {
       StreamId streamId,
       size_t consumerAllowance) override;
 
+  void trackReceivedFrames(
+      const std::vector<ReceivedFrameInfo>& infos) override;
+
   void trackSentFrame(
       const folly::IOBuf& serializedFrame,
+      size_t frameLength,
       FrameType frameType,
       StreamId streamId,
       size_t consumerAllowance) override;
@@ -44,7 +60,13 @@ class WarmResumeManager : public ResumeManager {
       ResumePosition position,
       FrameTransport& transport) const override;
 
+  ResumePosition replayFramesFromPosition(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t maxBytes) const override;
+
   ResumePosition firstSentPosition() const override {
+    auto lock = lockBuffer();
     return firstSentPosition_;
   }
 
@@ -72,16 +94,62 @@ class WarmResumeManager : public ResumeManager {
   }
 
   size_t size() {
-    return size_;
+    auto lock = lockBuffer();
+    return size_ + sharedBytes_;
+  }
+
+  /// The bytes copied, and those of the shared frames, which may be shared
+  /// with the rest of the process or not.
+  size_t bufferedBytes() const override {
+    auto lock = lockBuffer();
+    return size_ + sharedBytes_;
   }
 
+  /// Moves the buffered frames to a ring of their size, or drops the ring if
+  /// there are none, and erases the evicted positions.  The ring grows again
+  /// with the next frames.
+  void releaseBuffers() override;
+
+  /// Lowering the limit evicts the frames above it, and then releases the
+  /// spare memory as releaseBuffers() does.
+  void limitBuffer(double fraction) override;
+
+  /// Copies the positions and the buffered frames to `state`, for another host
+  /// to resume the connection from.
+  void exportState(ResumeStateTransfer& state) const;
+
+  /// Restores the positions and the frames exported by another host.  Returns
+  /// false if they are inconsistent.
+  bool importState(const ResumeStateTransfer& state);
+
  protected:
-  void addFrame(const folly::IOBuf&, size_t);
+  /// Copies the frame into the buffer, or shares it if it is large, evicting
+  /// the oldest frames if needed.  Returns false if the pool has no room for
+  /// it.
+  bool addFrame(ResumePosition, const folly::IOBuf&, size_t frameLength);
   void evictFrame();
 
   // Called before clearing cached frames to update stats.
   void clearFrames(ResumePosition position);
 
+  size_t frameCount() const {
+    return positions_.size() - firstFrame_;
+  }
+
+  ResumePosition framePosition(size_t index) const {
+    return positions_[firstFrame_ + index];
+  }
+
+  /// Length of the index-th buffered frame.
+  size_t frameLength(size_t index) const;
+
+  /// Returns a copy of the index-th buffered frame, a clone if it is shared.
+  std::unique_ptr<folly::IOBuf> copyFrame(size_t index) const;
+
+  /// Copies the index-th buffered frame to dest, which must have room for
+  /// frameLength(index) bytes.
+  void copyFrame(size_t index, uint8_t* dest) const;
+
   std::shared_ptr<RSocketStats> stats_;
 
   // Start position of the send buffer queue
@@ -91,10 +159,83 @@ class WarmResumeManager : public ResumeManager {
   // Inferred position of the rcvd frames
   ResumePosition impliedPosition_{0};
 
-  std::deque<std::pair<ResumePosition, std::unique_ptr<folly::IOBuf>>> frames_;
-
   constexpr static size_t DEFAULT_CAPACITY = 1024 * 1024; // 1MB
+  /// Frames at least this long are kept as clones of their IOBufs instead of
+  /// being copied.  They mostly carry payloads, e.g. of a MappedFile, which
+  /// the frames of all the connections then share.
+  constexpr static size_t kMinSharedFrameLength = 16 * 1024;
   const size_t capacity_;
+  /// Bytes buffered at most, capacity_ unless limitBuffer() lowered it.
+  size_t limit_{capacity_};
+  /// Bytes of the frames copied into the ring or the chunks.
   size_t size_{0};
+  /// Bytes of the shared frames.
+  size_t sharedBytes_{0};
+
+ private:
+  friend class ResumeBufferPool;
+
+  using Chunk = ResumeBufferPool::Chunk;
+
+  /// Keeps the pool from taking chunks back, if the frames are in chunks.
+  std::unique_lock<std::recursive_mutex> lockBuffer() const;
+
+  void reserve(size_t size);
+  /// Borrows chunks for frameLength more bytes.  Evicts the oldest frames to
+  /// give chunks back if the pool is out of them.  Returns false if it still
+  /// is once all the frames are evicted.
+  bool reserveChunks(size_t frameLength);
+  /// Drops the frames before `position`, moving the chunks freed to `freed`.
+  void dropFrames(ResumePosition position, std::vector<Chunk>& freed);
+  /// Drops the frames starting in the oldest chunk, for the pool.  Returns
+  /// the chunks freed.
+  std::vector<Chunk> shedChunk();
+
+  /// Erases the positions of the evicted frames.
+  void eraseEvictedFrames();
+
+  /// Bytes copied into the buffer before the frame at positions_[frame], since
+  /// the manager was created.
+  size_t copiedBefore(size_t frame) const {
+    return frame < copiedOffsets_.size() ? copiedOffsets_[frame] : copied_;
+  }
+
+  /// Offset from head_ of the index-th buffered frame, which must be copied.
+  size_t bufferOffset(size_t index) const {
+    return copiedBefore(firstFrame_ + index) - (copied_ - size_);
+  }
+
+  /// Returns where the byte at `offset` from head_ is, and how many bytes
+  /// follow it contiguously.
+  uint8_t* bufferAt(size_t offset, size_t& contiguous) const;
+  void copyOut(size_t offset, size_t length, uint8_t* dest) const;
+
+  // The sent frames are copied back to back in a ring of bytes, which grows up
+  // to capacity_, or in the chunks borrowed from pool_.  head_ is the offset
+  // of the first byte of the oldest copied frame, in the ring or the first
+  // chunk, and size_ bytes follow it.  The shared frames are in sharedFrames_
+  // instead.
+  std::unique_ptr<uint8_t[]> ring_;
+  size_t ringSize_{0};
+  const std::shared_ptr<ResumeBufferPool> pool_;
+  std::deque<Chunk> chunks_;
+  size_t head_{0};
+
+  // Guards the buffer of a pooled manager, the pool takes chunks back from the
+  // thread of another connection.  Recursive since evicting frames goes
+  // through the virtual resetUpToPosition().
+  mutable std::recursive_mutex mutex_;
+  std::list<WarmResumeManager*>::iterator poolEntry_;
+
+  // Positions of the buffered frames, starting at positions_[firstFrame_].
+  // Evicted positions are only erased from the front once they make up half
+  // of the vector.
+  std::vector<ResumePosition> positions_;
+  size_t firstFrame_{0};
+  // Along with positions_, the bytes copied before each frame, and the frame
+  // itself if it is shared rather than copied.
+  std::vector<size_t> copiedOffsets_;
+  std::vector<std::unique_ptr<folly::IOBuf>> sharedFrames_;
+  size_t copied_{0};
 };
 }
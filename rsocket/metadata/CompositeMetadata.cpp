@@ -0,0 +1,124 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/metadata/CompositeMetadata.h"
+
+#include <stdexcept>
+
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+namespace rsocket {
+
+namespace {
+constexpr uint8_t kWellKnownMimeTypeFlag = 0x80;
+constexpr size_t kMaxMimeTypeLength = 128;
+constexpr size_t kContentLengthSize = 3; // bytes
+constexpr size_t kMaxContentLength = 0xFFFFFF; // 24bit max value
+
+folly::io::Cursor cursorOf(const MetadataView& metadata) {
+  static const folly::IOBuf empty;
+  return metadata.hasMetadata() ? metadata.cursor()
+                                : folly::io::Cursor(&empty);
+}
+} // namespace
+
+CompositeMetadataReader::CompositeMetadataReader(const MetadataView& metadata)
+    : cursor_(cursorOf(metadata)), remaining_(metadata.length()) {}
+
+void CompositeMetadataReader::consume(size_t bytes) {
+  if (bytes > remaining_) {
+    throw std::runtime_error("Truncated composite metadata entry");
+  }
+  remaining_ -= bytes;
+}
+
+bool CompositeMetadataReader::next(CompositeMetadataEntry& entry) {
+  if (remaining_ == 0) {
+    return false;
+  }
+
+  consume(sizeof(uint8_t));
+  auto const mimeTypeHeader = cursor_.read<uint8_t>();
+  if (mimeTypeHeader & kWellKnownMimeTypeFlag) {
+    auto const id = static_cast<uint8_t>(mimeTypeHeader & 0x7F);
+    entry.wellKnownId = id;
+    entry.mimeType = wellKnownMimeTypeName(id);
+  } else {
+    // the length is encoded minus one, mime types can't be empty
+    auto const length = static_cast<size_t>(mimeTypeHeader) + 1;
+    consume(length);
+    entry.wellKnownId = folly::none;
+    if (cursor_.length() >= length) {
+      entry.mimeType = folly::StringPiece(
+          reinterpret_cast<const char*>(cursor_.data()), length);
+      cursor_.skip(length);
+    } else {
+      cursor_.pull(mimeType_, length);
+      entry.mimeType = folly::StringPiece(mimeType_, length);
+    }
+  }
+
+  consume(kContentLengthSize);
+  uint32_t length = 0;
+  length |= static_cast<uint32_t>(cursor_.read<uint8_t>() << 16);
+  length |= static_cast<uint32_t>(cursor_.read<uint8_t>() << 8);
+  length |= cursor_.read<uint8_t>();
+
+  consume(length);
+  entry.content = MetadataView(cursor_, length);
+  cursor_.skip(length);
+  return true;
+}
+
+folly::Optional<MetadataView> CompositeMetadataReader::find(
+    folly::StringPiece mimeType) {
+  CompositeMetadataEntry entry;
+  while (next(entry)) {
+    if (entry.mimeType == mimeType) {
+      return entry.content;
+    }
+  }
+  return folly::none;
+}
+
+CompositeMetadataBuilder& CompositeMetadataBuilder::add(
+    folly::StringPiece mimeType,
+    std::unique_ptr<folly::IOBuf> content) {
+  if (mimeType.empty() || mimeType.size() > kMaxMimeTypeLength) {
+    throw std::invalid_argument("Invalid composite metadata mime type");
+  }
+  auto const length = content ? content->computeChainDataLength() : 0;
+  if (length > kMaxContentLength) {
+    throw std::invalid_argument("Composite metadata entry is too big");
+  }
+
+  folly::io::QueueAppender appender(
+      &queue_, sizeof(uint8_t) + kMaxMimeTypeLength + kContentLengthSize);
+  if (auto id = wellKnownMimeTypeId(mimeType)) {
+    appender.write(static_cast<uint8_t>(kWellKnownMimeTypeFlag | *id));
+  } else {
+    appender.write(static_cast<uint8_t>(mimeType.size() - 1));
+    appender.push(
+        reinterpret_cast<const uint8_t*>(mimeType.data()), mimeType.size());
+  }
+  appender.write(static_cast<uint8_t>(length >> 16));
+  appender.write(static_cast<uint8_t>((length >> 8) & 0xFF));
+  appender.write(static_cast<uint8_t>(length & 0xFF));
+
+  if (length > 0) {
+    queue_.append(std::move(content));
+  }
+  return *this;
+}
+
+CompositeMetadataBuilder& CompositeMetadataBuilder::add(
+    folly::StringPiece mimeType,
+    folly::StringPiece content) {
+  return add(mimeType, folly::IOBuf::copyBuffer(content));
+}
+
+std::unique_ptr<folly::IOBuf> CompositeMetadataBuilder::build() {
+  auto metadata = queue_.move();
+  return metadata ? std::move(metadata) : folly::IOBuf::create(0);
+}
+
+} // namespace rsocket
@@ -0,0 +1,81 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/MetadataView.h"
+
+namespace rsocket {
+
+/// An entry of composite metadata, as decoded by CompositeMetadataReader.
+struct CompositeMetadataEntry {
+  /// The mime type of the entry.  Empty for well-known ids which have no
+  /// known name yet.
+  folly::StringPiece mimeType;
+  /// Set if the mime type was encoded as a well-known mime type id.
+  folly::Optional<uint8_t> wellKnownId;
+  /// The metadata of the entry, still in the buffers of the composite
+  /// metadata.
+  MetadataView content;
+};
+
+/// Iterates the entries of composite metadata
+/// (message/x.rsocket.composite-metadata.v0) without copying them.
+///
+/// The entries point into the buffers the reader was created from, which must
+/// outlive them.  The mime type of an entry is only valid until the following
+/// call to next().
+class CompositeMetadataReader {
+ public:
+  explicit CompositeMetadataReader(const folly::IOBuf& metadata)
+      : cursor_(&metadata), remaining_(metadata.computeChainDataLength()) {}
+
+  explicit CompositeMetadataReader(const MetadataView& metadata);
+
+  /// Decodes the next entry into `entry`.  Returns false once all entries
+  /// have been read.  Throws std::runtime_error if the metadata is malformed.
+  bool next(CompositeMetadataEntry& entry);
+
+  /// Returns the content of the first entry with the given mime type.
+  /// Throws std::runtime_error if the metadata is malformed.
+  folly::Optional<MetadataView> find(folly::StringPiece mimeType);
+
+ private:
+  void consume(size_t bytes);
+
+  folly::io::Cursor cursor_;
+  size_t remaining_;
+  /// Mime types which straddle buffers are copied here.
+  char mimeType_[128];
+};
+
+/// Builds composite metadata.  The contents of the entries are chained into
+/// the result, not copied.
+class CompositeMetadataBuilder {
+ public:
+  /// Appends an entry.  Well-known mime types are encoded by their id.
+  /// Throws std::invalid_argument if the mime type is empty or longer than 128
+  /// bytes, or if the content is longer than 2^24 - 1 bytes.
+  CompositeMetadataBuilder& add(
+      folly::StringPiece mimeType,
+      std::unique_ptr<folly::IOBuf> content);
+
+  CompositeMetadataBuilder& add(
+      folly::StringPiece mimeType,
+      folly::StringPiece content);
+
+  /// Returns the composite metadata built so far, and resets the builder.
+  std::unique_ptr<folly::IOBuf> build();
+
+ private:
+  folly::IOBufQueue queue_{folly::IOBufQueue::cacheChainLength()};
+};
+
+} // namespace rsocket
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/metadata/RequestTimeout.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <folly/io/Cursor.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+
+namespace rsocket {
+
+void addRequestTimeout(Payload& payload, std::chrono::milliseconds timeout) {
+  auto const millis = std::min<int64_t>(
+      std::max<int64_t>(timeout.count(), 0),
+      std::numeric_limits<uint32_t>::max());
+  auto content = folly::IOBuf::create(sizeof(uint32_t));
+  folly::io::Appender(content.get(), 0)
+      .writeBE(static_cast<uint32_t>(millis));
+
+  auto entry = CompositeMetadataBuilder()
+                   .add(kRequestTimeoutMimeType, std::move(content))
+                   .build();
+  if (payload.metadata) {
+    payload.metadata->prependChain(std::move(entry));
+  } else {
+    payload.metadata = std::move(entry);
+  }
+}
+
+namespace {
+folly::Optional<std::chrono::milliseconds> findRequestTimeoutIn(
+    CompositeMetadataReader reader) {
+  try {
+    auto content = reader.find(kRequestTimeoutMimeType);
+    if (!content || content->length() != sizeof(uint32_t)) {
+      return folly::none;
+    }
+    return std::chrono::milliseconds(content->cursor().readBE<uint32_t>());
+  } catch (const std::runtime_error&) {
+    return folly::none;
+  }
+}
+} // namespace
+
+folly::Optional<std::chrono::milliseconds> findRequestTimeout(
+    const folly::IOBuf& metadata) {
+  return findRequestTimeoutIn(CompositeMetadataReader(metadata));
+}
+
+folly::Optional<std::chrono::milliseconds> findRequestTimeout(
+    const MetadataView& metadata) {
+  return findRequestTimeoutIn(CompositeMetadataReader(metadata));
+}
+
+} // namespace rsocket
@@ -0,0 +1,36 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/MetadataView.h"
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/// The mime type of the composite metadata entry which carries the time the
+/// requester still waits for a request, as a big-endian uint32 number of
+/// milliseconds.
+constexpr folly::StringPiece kRequestTimeoutMimeType{
+    "message/x.rsocket.request-timeout.v0"};
+
+/// Appends a request timeout entry to the composite metadata of a payload,
+/// creating the metadata if it has none.
+void addRequestTimeout(Payload& payload, std::chrono::milliseconds timeout);
+
+/// Returns the request timeout of composite metadata, or folly::none if it
+/// has none or isn't valid composite metadata.
+folly::Optional<std::chrono::milliseconds> findRequestTimeout(
+    const folly::IOBuf& metadata);
+
+/// Like findRequestTimeout(const folly::IOBuf&), over the metadata of a
+/// received frame.
+folly::Optional<std::chrono::milliseconds> findRequestTimeout(
+    const MetadataView& metadata);
+
+} // namespace rsocket
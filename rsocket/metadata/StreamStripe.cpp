@@ -0,0 +1,49 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/metadata/StreamStripe.h"
+
+#include <stdexcept>
+
+#include <folly/io/Cursor.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+
+namespace rsocket {
+
+void addStreamStripe(Payload& payload, StreamStripe stripe) {
+  auto content = folly::IOBuf::create(2 * sizeof(uint32_t));
+  folly::io::Appender appender(content.get(), 0);
+  appender.writeBE(stripe.index);
+  appender.writeBE(stripe.count);
+
+  auto entry = CompositeMetadataBuilder()
+                   .add(kStreamStripeMimeType, std::move(content))
+                   .build();
+  if (payload.metadata) {
+    payload.metadata->prependChain(std::move(entry));
+  } else {
+    payload.metadata = std::move(entry);
+  }
+}
+
+folly::Optional<StreamStripe> findStreamStripe(const folly::IOBuf& metadata) {
+  try {
+    auto content =
+        CompositeMetadataReader(metadata).find(kStreamStripeMimeType);
+    if (!content || content->length() != 2 * sizeof(uint32_t)) {
+      return folly::none;
+    }
+    auto cursor = content->cursor();
+    StreamStripe stripe;
+    stripe.index = cursor.readBE<uint32_t>();
+    stripe.count = cursor.readBE<uint32_t>();
+    if (stripe.count == 0 || stripe.index >= stripe.count) {
+      return folly::none;
+    }
+    return stripe;
+  } catch (const std::runtime_error&) {
+    return folly::none;
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,38 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/// The mime type of the composite metadata entry which marks a request stream
+/// as one stripe of a logical stream split across connections, see
+/// RSocketClientPool::requestStripedStream().  It holds the index of the
+/// stripe and the number of stripes, as big-endian uint32s.
+constexpr folly::StringPiece kStreamStripeMimeType{
+    "message/x.rsocket.stream-stripe.v0"};
+
+/// Stripe `index` of a logical stream split in `count` stripes carries the
+/// items index, index + count, index + 2 * count, ... of the logical stream.
+/// The responder ends each stripe after the last of its items.
+struct StreamStripe {
+  uint32_t index{0};
+  uint32_t count{1};
+};
+
+/// Appends a stream stripe entry to the composite metadata of a payload,
+/// creating the metadata if it has none.
+void addStreamStripe(Payload& payload, StreamStripe stripe);
+
+/// Returns the stream stripe of composite metadata, or folly::none if it has
+/// none, or isn't valid composite metadata, or the stripe isn't valid.
+folly::Optional<StreamStripe> findStreamStripe(const folly::IOBuf& metadata);
+
+} // namespace rsocket
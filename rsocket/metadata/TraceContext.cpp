@@ -0,0 +1,122 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/metadata/TraceContext.h"
+
+#include <ostream>
+#include <stdexcept>
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr uint8_t kSampledFlag = 0x01;
+constexpr uint8_t kParentFlag = 0x02;
+
+constexpr size_t kIdsLength = 3 * sizeof(uint64_t);
+
+/// Span ids are never 0.
+uint64_t newSpanId() {
+  uint64_t id;
+  do {
+    id = folly::Random::rand64();
+  } while (id == 0);
+  return id;
+}
+} // namespace
+
+TraceContext TraceContext::newTrace(bool sampled) {
+  TraceContext context;
+  context.traceIdHigh = folly::Random::rand64();
+  context.traceIdLow = newSpanId();
+  context.spanId = newSpanId();
+  context.sampled = sampled;
+  return context;
+}
+
+TraceContext TraceContext::newChild() const {
+  TraceContext child;
+  child.traceIdHigh = traceIdHigh;
+  child.traceIdLow = traceIdLow;
+  child.spanId = newSpanId();
+  child.parentSpanId = spanId;
+  child.sampled = sampled;
+  return child;
+}
+
+bool operator==(const TraceContext& a, const TraceContext& b) {
+  return a.traceIdHigh == b.traceIdHigh && a.traceIdLow == b.traceIdLow &&
+      a.spanId == b.spanId && a.parentSpanId == b.parentSpanId &&
+      a.sampled == b.sampled;
+}
+
+std::ostream& operator<<(std::ostream& os, const TraceContext& context) {
+  os << folly::sformat(
+      "{:016x}{:016x}/{:016x}",
+      context.traceIdHigh,
+      context.traceIdLow,
+      context.spanId);
+  if (context.parentSpanId) {
+    os << folly::sformat(" parent={:016x}", *context.parentSpanId);
+  }
+  return os << (context.sampled ? " sampled" : " unsampled");
+}
+
+void addTraceContext(Payload& payload, const TraceContext& context) {
+  auto const parent = context.parentSpanId.hasValue();
+  auto content = folly::IOBuf::create(
+      1 + kIdsLength + (parent ? sizeof(uint64_t) : 0));
+  folly::io::Appender appender(content.get(), 0);
+  appender.write<uint8_t>(
+      (context.sampled ? kSampledFlag : 0) | (parent ? kParentFlag : 0));
+  appender.writeBE(context.traceIdHigh);
+  appender.writeBE(context.traceIdLow);
+  appender.writeBE(context.spanId);
+  if (parent) {
+    appender.writeBE(*context.parentSpanId);
+  }
+
+  auto entry = CompositeMetadataBuilder()
+                   .add(kTraceContextMimeType, std::move(content))
+                   .build();
+  if (payload.metadata) {
+    payload.metadata->prependChain(std::move(entry));
+  } else {
+    payload.metadata = std::move(entry);
+  }
+}
+
+folly::Optional<TraceContext> findTraceContext(const folly::IOBuf& metadata) {
+  try {
+    auto content =
+        CompositeMetadataReader(metadata).find(kTraceContextMimeType);
+    if (!content || content->length() < 1 + kIdsLength) {
+      return folly::none;
+    }
+    auto cursor = content->cursor();
+    auto const flags = cursor.read<uint8_t>();
+    auto const parent = !!(flags & kParentFlag);
+    if (content->length() !=
+        1 + kIdsLength + (parent ? sizeof(uint64_t) : 0)) {
+      return folly::none;
+    }
+    TraceContext context;
+    context.sampled = !!(flags & kSampledFlag);
+    context.traceIdHigh = cursor.readBE<uint64_t>();
+    context.traceIdLow = cursor.readBE<uint64_t>();
+    context.spanId = cursor.readBE<uint64_t>();
+    if (parent) {
+      context.parentSpanId = cursor.readBE<uint64_t>();
+    }
+    return context;
+  } catch (const std::runtime_error&) {
+    return folly::none;
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,51 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+/// The mime type of the composite metadata entry which carries the trace
+/// context of a request: a byte of flags, the 128 bit trace id, the 64 bit
+/// span id and, with the parent flag, the 64 bit parent span id, big-endian.
+constexpr folly::StringPiece kTraceContextMimeType{
+    "message/x.rsocket.trace-context.v0"};
+
+/// Identifies a span of a distributed trace, and whether the trace is
+/// recorded.
+struct TraceContext {
+  uint64_t traceIdHigh{0};
+  uint64_t traceIdLow{0};
+  uint64_t spanId{0};
+  folly::Optional<uint64_t> parentSpanId;
+  /// Whether the spans of the trace are recorded.  The decision of the root
+  /// span holds for the whole trace.
+  bool sampled{false};
+
+  /// A new trace, with random ids.
+  static TraceContext newTrace(bool sampled);
+
+  /// A new span of the same trace, whose parent is this one.
+  TraceContext newChild() const;
+};
+
+bool operator==(const TraceContext&, const TraceContext&);
+std::ostream& operator<<(std::ostream&, const TraceContext&);
+
+/// Appends a trace context entry to the composite metadata of a payload,
+/// creating the metadata if it has none.
+void addTraceContext(Payload& payload, const TraceContext& context);
+
+/// Returns the trace context of composite metadata, or folly::none if it has
+/// none or isn't valid composite metadata.
+folly::Optional<TraceContext> findTraceContext(const folly::IOBuf& metadata);
+
+} // namespace rsocket
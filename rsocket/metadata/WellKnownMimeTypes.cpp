@@ -0,0 +1,25 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+namespace rsocket {
+
+folly::Optional<uint8_t> wellKnownMimeTypeId(folly::StringPiece name) {
+  for (auto const& mimeType : kWellKnownMimeTypes) {
+    if (mimeType.name == name) {
+      return mimeType.id;
+    }
+  }
+  return folly::none;
+}
+
+folly::StringPiece wellKnownMimeTypeName(uint8_t id) {
+  for (auto const& mimeType : kWellKnownMimeTypes) {
+    if (mimeType.id == id) {
+      return mimeType.name;
+    }
+  }
+  return folly::StringPiece();
+}
+
+} // namespace rsocket
@@ -14,6 +14,7 @@ void ChannelRequester::onSubscribe(
 }
 
 void ChannelRequester::onNext(Payload request) noexcept {
+  checkPublisherOnNext();
   if (!requested_) {
     requested_ = true;
 
@@ -38,9 +39,9 @@ void ChannelRequester::onNext(Payload request) noexcept {
     return;
   }
 
-  checkPublisherOnNext();
   if (!publisherClosed()) {
     writePayload(std::move(request), false);
+    requestFromProducer();
   }
 }
 
@@ -126,6 +127,10 @@ void ChannelRequester::handleRequestN(uint32_t n) {
   PublisherBase::processRequestN(n);
 }
 
+void ChannelRequester::connectionWritabilityChanged(bool writable) {
+  publisherWritabilityChanged(writable);
+}
+
 void ChannelRequester::handleCancel() {
   CHECK(requested_);
   publisherComplete();
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "rsocket/Payload.h"
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/ConsumerBase.h"
 #include "rsocket/statemachine/PublisherBase.h"
 #include "yarpl/flowable/Subscriber.h"
@@ -12,7 +13,8 @@ namespace rsocket {
 /// Implementation of stream stateMachine that represents a Channel requester.
 class ChannelRequester : public ConsumerBase,
                          public PublisherBase,
-                         public yarpl::flowable::Subscriber<Payload> {
+                         public yarpl::flowable::Subscriber<Payload>,
+                         public PoolAllocated<ChannelRequester> {
  public:
   ChannelRequester(std::shared_ptr<StreamsWriter> writer, StreamId streamId)
       : ConsumerBase(std::move(writer), streamId),
@@ -32,13 +34,17 @@ class ChannelRequester : public ConsumerBase,
   void handleRequestN(uint32_t n) override;
   void handleError(folly::exception_wrapper errorPayload) override;
   void handleCancel() override;
+  void cancelRequest() override {
+    cancel();
+  }
+  void connectionWritabilityChanged(bool writable) override;
 
   void endStream(StreamCompletionSignal) override;
   void tryCompleteChannel();
 
   /// An allowance accumulated before the stream is initialised.
   /// Remaining part of the allowance is forwarded to the ConsumerBase.
-  Allowance initialResponseAllowance_;
+  StreamAllowance initialResponseAllowance_;
   bool requested_{false};
 };
 }
@@ -16,6 +16,7 @@ void ChannelResponder::onNext(Payload response) noexcept {
   checkPublisherOnNext();
   if (!publisherClosed()) {
     writePayload(std::move(response), false);
+    requestFromProducer();
   }
 }
 
@@ -95,6 +96,10 @@ void ChannelResponder::handleRequestN(uint32_t n) {
   processRequestN(n);
 }
 
+void ChannelResponder::connectionWritabilityChanged(bool writable) {
+  publisherWritabilityChanged(writable);
+}
+
 void ChannelResponder::handleError(folly::exception_wrapper ex) {
   errorConsumer(std::move(ex));
   tryCompleteChannel();
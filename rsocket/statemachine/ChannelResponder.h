@@ -4,6 +4,7 @@
 
 #include <iosfwd>
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/ConsumerBase.h"
 #include "rsocket/statemachine/PublisherBase.h"
 #include "yarpl/flowable/Subscriber.h"
@@ -13,7 +14,8 @@ namespace rsocket {
 /// Implementation of stream stateMachine that represents a Channel responder.
 class ChannelResponder : public ConsumerBase,
                          public PublisherBase,
-                         public yarpl::flowable::Subscriber<Payload> {
+                         public yarpl::flowable::Subscriber<Payload>,
+                         public PoolAllocated<ChannelResponder> {
  public:
   ChannelResponder(
       std::shared_ptr<StreamsWriter> writer,
@@ -38,6 +40,7 @@ class ChannelResponder : public ConsumerBase,
   void handleRequestN(uint32_t n) override;
   void handleCancel() override;
   void handleError(folly::exception_wrapper ex) override;
+  void connectionWritabilityChanged(bool writable) override;
 
   void onNextPayloadFrame(
       uint32_t requestN,
@@ -3,7 +3,9 @@
 #include "rsocket/statemachine/ConsumerBase.h"
 
 #include <algorithm>
+#include <limits>
 
+#include <folly/io/async/EventBaseManager.h>
 #include <glog/logging.h>
 
 #include "rsocket/Payload.h"
@@ -30,19 +32,67 @@ void ConsumerBase::subscribe(
 // TODO: this is probably buggy and misused and not needed (when
 // completeConsumer exists)
 void ConsumerBase::cancelConsumer() {
-  state_ = State::CLOSED;
+  flags_ |= kClosed;
   VLOG(5) << "ConsumerBase::cancelConsumer()";
   consumingSubscriber_ = nullptr;
+  if (prefetch_) {
+    prefetch_->buffered.clear();
+  }
+}
+
+void ConsumerBase::setWindowTuner(std::shared_ptr<RequestNWindowTuner> tuner) {
+  prefetch_ = std::make_unique<Prefetch>(std::move(tuner));
+}
+
+size_t ConsumerBase::startPrefetch(size_t n) {
+  DCHECK(prefetch_);
+  auto& prefetch = *prefetch_;
+  prefetch.demand = n;
+  auto const window = prefetch.tuner->effectiveWindow(prefetch.window);
+  return n > std::numeric_limits<size_t>::max() - window
+      ? std::numeric_limits<size_t>::max()
+      : n + window;
 }
 
 void ConsumerBase::generateRequest(size_t n) {
-  allowance_.add(n);
-  pendingAllowance_.add(n);
+  if (!prefetch_) {
+    grantRequest(n);
+    return;
+  }
+  auto& demand = prefetch_->demand;
+  demand = n > std::numeric_limits<size_t>::max() - demand
+      ? std::numeric_limits<size_t>::max()
+      : demand + n;
+  drainPrefetched();
+  topUpPrefetch();
+}
+
+void ConsumerBase::grantRequest(size_t n) {
+  if (flags_ & kUnbounded) {
+    return;
+  }
+  if (n >= StreamAllowance::max() - allowance_.get()) {
+    // What the peer was granted so far stays granted, the rest is pending.
+    flags_ |= kUnbounded;
+    auto const synced = allowance_.get() > pendingAllowance_.get()
+        ? allowance_.get() - pendingAllowance_.get()
+        : 0;
+    allowance_ = StreamAllowance(StreamAllowance::max());
+    pendingAllowance_ = StreamAllowance(StreamAllowance::max() - synced);
+  } else {
+    allowance_.add(n);
+    pendingAllowance_.add(n);
+  }
   sendRequests();
 }
 
 void ConsumerBase::endStream(StreamCompletionSignal signal) {
   VLOG(5) << "ConsumerBase::endStream(" << signal << ")";
+  if (prefetch_ && prefetch_->completed) {
+    // The subscriber is completed once it took the buffered payloads.
+    StreamStateMachineBase::endStream(signal);
+    return;
+  }
   if (auto subscriber = std::move(consumingSubscriber_)) {
     if (signal == StreamCompletionSignal::COMPLETE ||
         signal == StreamCompletionSignal::CANCEL) { // TODO: remove CANCEL
@@ -61,38 +111,106 @@ size_t ConsumerBase::getConsumerAllowance() const {
 }
 
 void ConsumerBase::processPayload(Payload&& payload, bool onNext) {
-  if (payload || onNext) {
-    // Frames carry application-level payloads are taken into account when
-    // figuring out flow control allowance.
-    if (allowance_.tryConsume(1)) {
-      sendRequests();
-      consumingSubscriber_->onNext(std::move(payload));
-    } else {
-      handleFlowControlError();
-      return;
-    }
+  if (acceptPayload(payload, onNext)) {
+    consumingSubscriber_->onNext(std::move(payload));
+  }
+}
+
+bool ConsumerBase::acceptPayload(Payload& payload, bool onNext) {
+  if (!payload && !onNext) {
+    return false;
   }
+  // Frames carry application-level payloads are taken into account when
+  // figuring out flow control allowance.
+  if (!consumeAllowance()) {
+    handleFlowControlError();
+    return false;
+  }
+  if (prefetch_) {
+    prefetch_->buffered.push_back(std::move(payload));
+    drainPrefetched();
+    topUpPrefetch();
+    return false;
+  }
+  sendRequests();
+  return true;
 }
 
 void ConsumerBase::completeConsumer() {
-  state_ = State::CLOSED;
+  flags_ |= kClosed;
   VLOG(5) << "ConsumerBase::completeConsumer()";
+  if (prefetch_ && !prefetch_->buffered.empty()) {
+    prefetch_->completed = true;
+    return;
+  }
   if (auto subscriber = std::move(consumingSubscriber_)) {
     subscriber->onComplete();
   }
 }
 
 void ConsumerBase::errorConsumer(folly::exception_wrapper ex) {
-  state_ = State::CLOSED;
+  flags_ |= kClosed;
   VLOG(5) << "ConsumerBase::errorConsumer()";
+  if (prefetch_) {
+    prefetch_->buffered.clear();
+    prefetch_->completed = false;
+  }
   if (auto subscriber = std::move(consumingSubscriber_)) {
     subscriber->onError(std::move(ex));
   }
 }
 
+bool ConsumerBase::consumeAllowance() {
+  if (!(flags_ & kUnbounded)) {
+    return allowance_.tryConsume(1);
+  }
+  // The peer may send what it was granted, allowance_ less
+  // pendingAllowance_.  The payload is owed to it again.
+  if (allowance_.get() == pendingAllowance_.get()) {
+    return false;
+  }
+  pendingAllowance_.add(1);
+  return true;
+}
+
 void ConsumerBase::sendRequests() {
-  // TODO(stupaq): batch if remote end has some spare allowance
-  // TODO(stupaq): limit how much is synced to the other end
+  if (!pendingAllowance_ || (flags_ & kRequestsScheduled)) {
+    return;
+  }
+
+  // Payloads the other end may still send us without further REQUEST_Ns.
+  auto const synced = allowance_.get() > pendingAllowance_.get()
+      ? allowance_.get() - pendingAllowance_.get()
+      : 0;
+  // An unbounded consumer tops the peer up once per REQUEST_N worth of
+  // payloads at most.
+  auto const lowWaterMark = flags_ & kUnbounded
+      ? std::min(
+            batching_.lowWaterMark,
+            static_cast<size_t>(Frame_REQUEST_N::kMaxRequestN))
+      : batching_.lowWaterMark;
+  if (synced > lowWaterMark) {
+    // Called again once a payload consumes some of it.
+    return;
+  }
+
+  if (batching_.perLoopIteration) {
+    if (auto evb = folly::EventBaseManager::get()->getExistingEventBase()) {
+      flags_ |= kRequestsScheduled;
+      evb->runInLoop([self = this->ref_from_this(this)] {
+        self->flags_ &= ~kRequestsScheduled;
+        if (!self->isTerminated() && !self->consumerClosed()) {
+          self->flushRequests();
+        }
+      });
+      return;
+    }
+  }
+
+  flushRequests();
+}
+
+void ConsumerBase::flushRequests() {
   size_t toSync = Frame_REQUEST_N::kMaxRequestN;
   toSync = pendingAllowance_.consumeUpTo(toSync);
   if (toSync > 0) {
@@ -100,6 +218,67 @@ void ConsumerBase::sendRequests() {
   }
 }
 
+void ConsumerBase::drainPrefetched() {
+  auto& prefetch = *prefetch_;
+  if (prefetch.draining) {
+    // The subscriber requested more from onNext(), the loop below goes on.
+    return;
+  }
+  // The subscriber may release its subscription, and with it this consumer,
+  // from onNext().
+  auto self = this->ref_from_this(this);
+  prefetch.draining = true;
+  while (prefetch.demand > 0 && !prefetch.buffered.empty() &&
+         consumingSubscriber_) {
+    auto payload = std::move(prefetch.buffered.front());
+    prefetch.buffered.pop_front();
+    if (prefetch.demand != std::numeric_limits<size_t>::max()) {
+      --prefetch.demand;
+    }
+
+    auto const now = RequestNWindowTuner::Clock::now();
+    if (prefetch.consumed++ == 0) {
+      prefetch.since = now;
+    } else if (now - prefetch.since >= prefetch.tuner->sampleInterval()) {
+      prefetch.window = prefetch.tuner->nextWindow(
+          prefetch.window, prefetch.consumed - 1, now - prefetch.since);
+      prefetch.consumed = 1;
+      prefetch.since = now;
+    }
+
+    consumingSubscriber_->onNext(std::move(payload));
+  }
+  prefetch.draining = false;
+
+  if (prefetch.completed && prefetch.buffered.empty()) {
+    prefetch.completed = false;
+    if (auto subscriber = std::move(consumingSubscriber_)) {
+      subscriber->onComplete();
+    }
+  }
+}
+
+void ConsumerBase::topUpPrefetch() {
+  if (isTerminated() || consumerClosed()) {
+    return;
+  }
+  if (flags_ & kUnbounded) {
+    // Topped up as the payloads are consumed.
+    sendRequests();
+    return;
+  }
+  auto const& prefetch = *prefetch_;
+  auto const window = prefetch.tuner->effectiveWindow(prefetch.window);
+  auto const held = allowance_.get() + prefetch.buffered.size();
+  auto const target =
+      prefetch.demand > std::numeric_limits<size_t>::max() - window
+      ? std::numeric_limits<size_t>::max()
+      : prefetch.demand + window;
+  if (target > held) {
+    grantRequest(target - held);
+  }
+}
+
 void ConsumerBase::handleFlowControlError() {
   if (auto subscriber = std::move(consumingSubscriber_)) {
     subscriber->onError(std::runtime_error("surplus response"));
@@ -4,10 +4,14 @@
 
 #include <folly/ExceptionWrapper.h>
 #include <cstddef>
+#include <deque>
+#include <memory>
 
 #include "rsocket/Payload.h"
+#include "rsocket/RSocketParameters.h"
 #include "rsocket/internal/Allowance.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/RequestNWindowTuner.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/flowable/Subscription.h"
@@ -34,43 +38,122 @@ class ConsumerBase : public StreamStateMachineBase,
   void subscribe(
       yarpl::Reference<yarpl::flowable::Subscriber<Payload>> subscriber);
 
+  /// Adds the request of the subscriber.  Unless the consumer prefetches,
+  /// the peer is granted as much.
   void generateRequest(size_t n);
 
+  void setRequestNBatching(const RequestNBatching& batching) {
+    batching_ = batching;
+  }
+
+  /// Makes the consumer request a window of payloads ahead of its subscriber,
+  /// sized by `tuner`, see AdaptiveRequestN.  Before the first request.
+  void setWindowTuner(std::shared_ptr<RequestNWindowTuner> tuner);
+
   size_t getConsumerAllowance() const override;
 
  protected:
   void cancelConsumer();
 
   bool consumerClosed() const {
-    return state_ == State::CLOSED;
+    return flags_ & kClosed;
   }
 
   void endStream(StreamCompletionSignal signal) override;
 
   void processPayload(Payload&&, bool onNext);
 
+  /// The part of processPayload() before the payload is delivered: returns
+  /// true if the subscriber is to be given it right away, for consumers
+  /// which deliver it themselves, see TypedStreamRequester.
+  bool acceptPayload(Payload& payload, bool onNext);
+
+  /// Null once the consumer is closed.
+  yarpl::flowable::Subscriber<Payload>* consumingSubscriber() const {
+    return consumingSubscriber_.get();
+  }
+
+  /// Grants the peer `n` more payloads.
+  void grantRequest(size_t n);
+
+  /// Whether the consumer requests ahead of its subscriber, see
+  /// setWindowTuner().
+  bool prefetches() const {
+    return prefetch_ != nullptr;
+  }
+
+  /// Takes the first request of the subscriber of a prefetching consumer,
+  /// and returns how many payloads the peer is to be granted initially.
+  size_t startPrefetch(size_t n);
+
   void completeConsumer();
   void errorConsumer(folly::exception_wrapper ex);
 
  private:
+  /// Consumes the allowance of a payload, false if there is none.
+  bool consumeAllowance();
+
+  /// Syncs the pending allowance to the other end, as allowed by batching_.
   void sendRequests();
+  void flushRequests();
 
   void handleFlowControlError();
 
+  /// Delivers the payloads buffered by a prefetching consumer, as many as
+  /// its subscriber requested, and then the completion they held back.
+  void drainPrefetched();
+  /// Grants the peer what keeps it a window ahead of the subscriber.
+  void topUpPrefetch();
+
+  /// The state of a prefetching consumer, kept out of the consumers which
+  /// don't prefetch.
+  struct Prefetch {
+    explicit Prefetch(std::shared_ptr<RequestNWindowTuner> _tuner)
+        : tuner(std::move(_tuner)), window(tuner->initialWindow()) {}
+
+    std::shared_ptr<RequestNWindowTuner> tuner;
+    size_t window;
+    /// Requested by the subscriber and not delivered yet, saturated once it
+    /// is unbounded.
+    size_t demand{0};
+    /// Received ahead of the subscriber.
+    std::deque<Payload> buffered;
+    /// Delivered since `since`, to measure the consumption of the subscriber.
+    size_t consumed{0};
+    RequestNWindowTuner::Clock::time_point since;
+    bool draining{false};
+    /// The stream completed, the subscriber is told once it took the
+    /// buffered payloads.
+    bool completed{false};
+  };
+
   /// A Subscriber that will consume payloads.
   /// This is responsible for delivering a terminal signal to the
   /// Subscriber once the stream ends.
   yarpl::Reference<yarpl::flowable::Subscriber<Payload>> consumingSubscriber_;
 
   /// A total, net allowance (requested less delivered) by this consumer.
-  Allowance allowance_;
+  /// Once it saturates the consumer is unbounded, see kUnbounded.
+  StreamAllowance allowance_;
   /// An allowance that have yet to be synced to the other end by sending
   /// REQUEST_N frames.
-  Allowance pendingAllowance_;
-
-  enum class State : uint8_t {
-    RESPONDING,
-    CLOSED,
-  } state_{State::RESPONDING};
+  StreamAllowance pendingAllowance_;
+
+  RequestNBatching batching_;
+
+  std::unique_ptr<Prefetch> prefetch_;
+
+  /// Bits of flags_.
+  enum : uint8_t {
+    /// flushRequests() runs at the end of this loop iteration.
+    kRequestsScheduled = 1 << 0,
+    /// The consumer doesn't respond anymore.
+    kClosed = 1 << 1,
+    /// More was requested than allowance_ can count.  allowance_ stays at
+    /// its maximum, and each payload adds to pendingAllowance_ instead, so
+    /// that the peer keeps being granted more.
+    kUnbounded = 1 << 2,
+  };
+  uint8_t flags_{0};
 };
 }
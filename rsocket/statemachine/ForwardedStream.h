@@ -0,0 +1,39 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+class RSocketStateMachine;
+
+/// A stream which a routing proxy forwards frame by frame, from the
+/// connection its request arrived on to a new stream of the connection it is
+/// forwarded to, see RSocketResponder::forwardRequest().  Each connection
+/// only touches its own end, on its EventBase.
+struct ForwardedStream {
+  struct End {
+    std::weak_ptr<RSocketStateMachine> connection;
+    folly::EventBase* eventBase{nullptr};
+    /// 0 until the connection forwarded to has allocated the stream.
+    StreamId streamId{0};
+  };
+
+  ForwardedStream(StreamType _type, End _responder, End _requester)
+      : type(_type),
+        responder(std::move(_responder)),
+        requester(std::move(_requester)) {}
+
+  const StreamType type;
+  /// The end which received the request.
+  End responder;
+  /// The end which sent the request on.
+  End requester;
+};
+
+} // namespace rsocket
@@ -8,53 +8,86 @@
 
 namespace rsocket {
 
+constexpr size_t PublisherBase::kMaxProducerAllowance;
+
 PublisherBase::PublisherBase(uint32_t initialRequestN)
     : initialRequestN_(initialRequestN) {}
 
 void PublisherBase::publisherSubscribe(
     yarpl::Reference<yarpl::flowable::Subscription> subscription) {
-  if (state_ == State::CLOSED) {
+  if (flags_ & kClosed) {
     subscription->cancel();
     return;
   }
   DCHECK(!producingSubscription_);
   producingSubscription_ = std::move(subscription);
-  if (initialRequestN_) {
-    producingSubscription_->request(initialRequestN_.consumeAll());
-  }
+  requestFromProducer();
 }
 
-void PublisherBase::checkPublisherOnNext() {
+bool PublisherBase::checkPublisherOnNext() {
   // we are either responding and publisherSubscribe method was called
   // or we are already terminated
-  CHECK((state_ == State::RESPONDING) == !!producingSubscription_);
+  CHECK(!(flags_ & kClosed) == !!producingSubscription_);
+  if (producerAllowance_) {
+    --producerAllowance_;
+    return true;
+  }
+  return false;
+}
+
+void PublisherBase::requestFromProducer() {
+  if (!producingSubscription_ || !(flags_ & kWritable) ||
+      producerAllowance_ > kMaxProducerAllowance / 2) {
+    return;
+  }
+  auto const n =
+      initialRequestN_.consumeUpTo(kMaxProducerAllowance - producerAllowance_);
+  if (n) {
+    producerAllowance_ += static_cast<uint16_t>(n);
+    producingSubscription_->request(n);
+  }
+}
+
+bool PublisherBase::producerWaitsForPeer() const {
+  return producingSubscription_ && (flags_ & kWritable) && !initialRequestN_;
+}
+
+void PublisherBase::requestAheadOfPeer(size_t n) {
+  DCHECK(producingSubscription_);
+  producingSubscription_->request(n);
+}
+
+void PublisherBase::publisherWritabilityChanged(bool writable) {
+  if (writable) {
+    flags_ |= kWritable;
+  } else {
+    flags_ &= ~kWritable;
+  }
+  requestFromProducer();
 }
 
 void PublisherBase::publisherComplete() {
-  state_ = State::CLOSED;
+  flags_ |= kClosed;
   producingSubscription_ = nullptr;
 }
 
 bool PublisherBase::publisherClosed() const {
-  return state_ == State::CLOSED;
+  return flags_ & kClosed;
 }
 
 void PublisherBase::processRequestN(uint32_t requestN) {
-  if (!requestN || state_ == State::CLOSED) {
+  if (!requestN || (flags_ & kClosed)) {
     return;
   }
 
   // we might not have the subscription set yet as there can be REQUEST_N
   // frames scheduled on the executor before onSubscribe method
-  if (producingSubscription_) {
-    producingSubscription_->request(requestN);
-  } else {
-    initialRequestN_.add(requestN);
-  }
+  initialRequestN_.add(requestN);
+  requestFromProducer();
 }
 
 void PublisherBase::terminatePublisher() {
-  state_ = State::CLOSED;
+  flags_ |= kClosed;
   if (auto subscription = std::move(producingSubscription_)) {
     subscription->cancel();
   }
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <limits>
+
 #include "rsocket/Payload.h"
 #include "rsocket/internal/Allowance.h"
 #include "yarpl/flowable/Subscription.h"
@@ -11,14 +14,42 @@ namespace rsocket {
 enum class StreamCompletionSignal;
 
 /// A class that represents a flow-control-aware producer of data.
+///
+/// The allowance granted by the peer is handed to the producer at most
+/// kMaxProducerAllowance at a time, and only while the connection is writable,
+/// so that a producer stops soon after the transport starts buffering.
 class PublisherBase {
  public:
+  /// Most of the peer's allowance the producer holds at any time.
+  static constexpr size_t kMaxProducerAllowance = 256;
+  static_assert(
+      kMaxProducerAllowance <= std::numeric_limits<uint16_t>::max(),
+      "The producer allowance is kept in 16 bits");
+
   explicit PublisherBase(uint32_t initialRequestN);
 
   void publisherSubscribe(
       yarpl::Reference<yarpl::flowable::Subscription> subscription);
 
-  void checkPublisherOnNext();
+  /// Must be called for each payload of the producer.  Returns whether the
+  /// payload was within the allowance handed to the producer.
+  bool checkPublisherOnNext();
+
+  /// Tops up the allowance of the producer.  Called after a payload has been
+  /// written.
+  void requestFromProducer();
+
+  /// Whether the producer would be handed allowance, but the peer granted
+  /// none which wasn't handed already.
+  bool producerWaitsForPeer() const;
+
+  /// Requests `n` payloads from the producer beyond the allowance of the peer.
+  /// They aren't counted by the publisher, checkPublisherOnNext() returns
+  /// false for them.
+  void requestAheadOfPeer(size_t n);
+
+  /// Stops or resumes handing allowance to the producer.
+  void publisherWritabilityChanged(bool writable);
 
   void publisherComplete();
   bool publisherClosed() const;
@@ -32,11 +63,19 @@ class PublisherBase {
   /// This is responsible for delivering a terminal signal to the
   /// Subscription once the stream ends.
   yarpl::Reference<yarpl::flowable::Subscription> producingSubscription_;
-  Allowance initialRequestN_;
+  /// Allowance of the peer which hasn't been handed to the producer yet.
+  StreamAllowance initialRequestN_;
+  /// Allowance handed to the producer which it hasn't used yet, at most
+  /// kMaxProducerAllowance.
+  uint16_t producerAllowance_{0};
 
-  enum class State : uint8_t {
-    RESPONDING,
-    CLOSED,
-  } state_{State::RESPONDING};
+  /// Bits of flags_.
+  enum : uint8_t {
+    /// The connection accepts more output, see publisherWritabilityChanged().
+    kWritable = 1 << 0,
+    /// The publisher doesn't respond anymore.
+    kClosed = 1 << 1,
+  };
+  uint8_t flags_{kWritable};
 };
 }
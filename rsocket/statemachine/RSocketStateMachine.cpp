@@ -2,6 +2,10 @@
 
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 #include <folly/ExceptionWrapper.h>
 #include <folly/Format.h>
 #include <folly/Optional.h>
@@ -9,23 +13,57 @@
 #include <folly/io/async/EventBaseManager.h>
 
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/MemoryGovernor.h"
 #include "rsocket/RSocketConnectionEvents.h"
+#include "rsocket/RSocketErrors.h"
 #include "rsocket/RSocketParameters.h"
+#include "rsocket/RSocketRequester.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
+#include "rsocket/framing/CompressedDuplexConnection.h"
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/framing/ScheduledFrameProcessor.h"
+#include "rsocket/framing/ScheduledFrameTransport.h"
 #include "rsocket/internal/ClientResumeStatusCallback.h"
 #include "rsocket/internal/ConnectionSet.h"
+#include "rsocket/internal/EventBaseLoadMonitor.h"
+#include "rsocket/internal/FlightRecorder.h"
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/internal/ResumeStateTransfer.h"
 #include "rsocket/internal/ScheduledSubscriber.h"
+#include "rsocket/internal/Tracepoints.h"
 #include "rsocket/internal/WarmResumeManager.h"
+#include "rsocket/metadata/RequestTimeout.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+#include "rsocket/metadata/TraceContext.h"
 #include "rsocket/statemachine/ChannelResponder.h"
 #include "rsocket/statemachine/StreamState.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 
 namespace rsocket {
 
+namespace {
+/// Bytes of buffered frames replayed with each call to the ResumeManager, the
+/// transport's writability is checked in between.
+constexpr size_t kReplayBatchBytes = 64 * 1024;
+/// Bytes of buffered frames replayed in one EventBase loop iteration, so that
+/// the other connections of the thread aren't held up by a resumption.
+constexpr size_t kReplayBytesPerLoop = 512 * 1024;
+/// Streams terminated in one EventBase loop iteration when closing, so that
+/// the other connections of the thread aren't held up by a huge connection.
+constexpr size_t kStreamsClosedPerLoop = 1024;
+
+/// One in how many requests are sampled at `rate`, 0 for none.
+size_t traceInterval(double rate) {
+  if (!(rate > 0)) {
+    return 0;
+  }
+  return rate >= 1 ? 1 : static_cast<size_t>(std::llround(1 / rate));
+}
+} // namespace
+
 RSocketStateMachine::RSocketStateMachine(
     std::shared_ptr<RSocketResponder> requestResponder,
     std::unique_ptr<KeepaliveTimer> keepaliveTimer,
@@ -33,16 +71,24 @@ RSocketStateMachine::RSocketStateMachine(
     std::shared_ptr<RSocketStats> stats,
     std::shared_ptr<RSocketConnectionEvents> connectionEvents,
     std::shared_ptr<ResumeManager> resumeManager,
-    std::shared_ptr<ColdResumeHandler> coldResumeHandler)
+    std::shared_ptr<ColdResumeHandler> coldResumeHandler,
+    std::shared_ptr<LeaseSender> leaseSender)
     : mode_{mode},
       stats_{stats ? stats : RSocketStats::noop()},
+      measureStreamLatencies_{stats_->streamLatenciesEnabled()},
+      reportFrameSizes_{stats_->frameSizesEnabled()},
+      cpu_{stats_->cpuAccountingEnabled()},
       streamState_{*stats_},
+      traceEvery_{traceInterval(stats_->traceSampleRate())},
+      traceCountdown_{traceEvery_},
+      stallThreshold_{stats_->streamStallThreshold()},
       resumeManager_{resumeManager
                          ? resumeManager
                          : std::make_shared<WarmResumeManager>(stats_)},
       requestResponder_{std::move(requestResponder)},
       keepaliveTimer_{std::move(keepaliveTimer)},
       coldResumeHandler_{std::move(coldResumeHandler)},
+      leaseSender_{std::move(leaseSender)},
       streamsFactory_{*this, mode},
       connectionEvents_{connectionEvents} {
   // We deliberately do not "open" input or output to avoid having c'tor on the
@@ -66,6 +112,9 @@ RSocketStateMachine::~RSocketStateMachine() {
   DCHECK(!resumeCallback_);
   DCHECK(isDisconnected()); // the instance should be closed by via
   // close method
+  if (memoryGovernor_) {
+    memoryGovernor_->update(governedBytes_, 0);
+  }
 }
 
 void RSocketStateMachine::setResumable(bool resumable) {
@@ -74,11 +123,41 @@ void RSocketStateMachine::setResumable(bool resumable) {
   isResumable_ = resumable;
 }
 
+void RSocketStateMachine::setAdaptiveRequestN(
+    const AdaptiveRequestN& adaptive) {
+  if (adaptive.enabled()) {
+    requestNWindowTuner_ = std::make_shared<RequestNWindowTuner>(adaptive);
+  }
+}
+
 void RSocketStateMachine::connectServer(
     yarpl::Reference<FrameTransport> frameTransport,
     const SetupParameters& setupParams) {
   setResumable(setupParams.resumable);
+  mtu_ = setupParams.mtu;
+  requestNBatching_ = setupParams.requestNBatching;
+  setAdaptiveRequestN(setupParams.adaptiveRequestN);
+  streamState_.setPendingFrameLimits(setupParams.pendingFrameLimits);
+  streamSerializeAhead_ = setupParams.streamSerializeAhead;
+  positionAckBytes_ = setupParams.positionAckBytes;
+  memoryLimits_ = setupParams.memoryLimits;
+  maxFrameLength_ = std::min(setupParams.maxFrameLength, kMaxFrameLength);
+  hibernateAfter_ = setupParams.hibernateAfter;
+  // Only the 1.0 serializer keeps the flags it doesn't know.
+  if (setupParams.compressionRequested &&
+      setupParams.protocolVersion.major >= 1) {
+    compression_ = setupParams.compression;
+    acceptsCompressed_ = true;
+  }
   connect(std::move(frameTransport), setupParams.protocolVersion);
+  if (acceptsCompressed_) {
+    // The client only compresses its payloads once it got this.
+    outputFrameOrEnqueue(Frame_METADATA_PUSH(payloadCompressionMetadata()));
+  }
+  if (setupParams.lease && leaseSender_) {
+    responderLeaseEnabled_ = true;
+    sendLease();
+  }
   sendPendingFrames();
 }
 
@@ -97,6 +176,7 @@ bool RSocketStateMachine::resumeServer(
   int64_t serverDelta =
       resumeManager_->lastSentPosition() - resumeParams.serverPosition;
 
+  RSOCKET_TRACE(resume_start, this, static_cast<int>(mode_));
   std::runtime_error exn{"Connection being resumed, dropping old connection"};
   disconnect(std::move(exn));
 
@@ -104,6 +184,7 @@ bool RSocketStateMachine::resumeServer(
 
   auto result = resumeFromPositionOrClose(
       resumeParams.serverPosition, resumeParams.clientPosition);
+  RSOCKET_TRACE(resume_finish, this, static_cast<int>(mode_), result ? 1 : 0);
 
   stats_->serverResume(
       clientAvailable,
@@ -115,6 +196,150 @@ bool RSocketStateMachine::resumeServer(
   return result;
 }
 
+void RSocketStateMachine::setSetupIdentity(
+    ResumeIdentificationToken token,
+    std::string metadataMimeType,
+    std::string dataMimeType) {
+  setupToken_ = std::move(token);
+  setupMetadataMimeType_ = std::move(metadataMimeType);
+  setupDataMimeType_ = std::move(dataMimeType);
+}
+
+bool RSocketStateMachine::exportResumeState(
+    ResumeStateTransfer& state,
+    HandedOverSocket* socket) {
+  auto warmResumeManager =
+      dynamic_cast<WarmResumeManager*>(resumeManager_.get());
+  if (mode_ != RSocketMode::SERVER || !isResumable_ || isClosed() ||
+      !frameSerializer_ || !warmResumeManager) {
+    return false;
+  }
+
+  if (socket) {
+    // Only the socket of a transport still on this EventBase, and once the
+    // frames sent so far are written: the positions are those of the bytes
+    // on the wire then.
+    auto local = dynamic_cast<FrameTransportImpl*>(frameTransport_.get());
+    if (local && !local->isClosed() && local->getConnection()) {
+      socket->fd = local->getConnection()->releaseSocket(socket->unread);
+    }
+  }
+
+  // The client is resuming elsewhere, even if this side hasn't noticed that
+  // the connection broke yet.
+  std::runtime_error exn{"Connection handed over to another host"};
+  disconnect(exn);
+
+  state.protocolVersion = frameSerializer_->protocolVersion();
+  state.token = setupToken_;
+  state.metadataMimeType = setupMetadataMimeType_;
+  state.dataMimeType = setupDataMimeType_;
+  warmResumeManager->exportState(state);
+  state.nextStreamId = streamsFactory_.nextStreamId();
+  state.lastPeerStreamId = streamsFactory_.lastPeerStreamId();
+  state.openStreams.clear();
+  streamState_.streams_.forEach(
+      [&](StreamId streamId, const yarpl::Reference<StreamStateMachineBase>&) {
+        state.openStreams.push_back(streamId);
+      });
+
+  close(std::move(exn), StreamCompletionSignal::CONNECTION_END);
+  return true;
+}
+
+bool RSocketStateMachine::migrateTransport(
+    folly::EventBase& stateMachineEvb,
+    folly::EventBase& transportEvb) {
+  DCHECK(stateMachineEvb.isInEventBaseThread());
+  if (&stateMachineEvb == &transportEvb || isDisconnected() ||
+      resumeCallback_) {
+    return false;
+  }
+  // Only the IO of a transport still on this EventBase moves, e.g. not the
+  // one of a client which resumed on another EventBase.
+  auto local = dynamic_cast<FrameTransportImpl*>(frameTransport_.get());
+  if (!local || local->isClosed() ||
+      !local->getConnection()->detachEventBase()) {
+    return false;
+  }
+
+  VLOG(2) << "Moving the transport " << local << " to "
+          << transportEvb.getName();
+
+  yarpl::Reference<FrameTransport> transport = frameTransport_;
+  // Ahead of whatever the state machine hands the transport from now on.  The
+  // processor is replaced before the connection reads again.
+  transportEvb.runInEventBaseThread([
+    transport,
+    self = shared_from_this(),
+    stateMachineEvb = &stateMachineEvb,
+    transportEvb = &transportEvb
+  ] {
+    transport->setFrameProcessor(
+        std::make_shared<ScheduledFrameProcessor>(self, stateMachineEvb));
+    if (auto connection = transport->getConnection()) {
+      connection->attachEventBase(*transportEvb);
+    }
+  });
+  frameTransport_ = yarpl::make_ref<ScheduledFrameTransport>(
+      std::move(transport), &transportEvb, &stateMachineEvb);
+  return true;
+}
+
+bool RSocketStateMachine::resumeTransferredServer(
+    yarpl::Reference<FrameTransport> frameTransport,
+    const ResumeParameters& resumeParams,
+    const SetupParameters& setupParams,
+    const ResumeStateTransfer& state) {
+  restoreTransferredServer(setupParams, state);
+  if (!resumeServer(std::move(frameTransport), resumeParams)) {
+    return false;
+  }
+  cancelTransferredStreams(state);
+  return true;
+}
+
+void RSocketStateMachine::adoptTransferredServer(
+    yarpl::Reference<FrameTransport> frameTransport,
+    const SetupParameters& setupParams,
+    const ResumeStateTransfer& state) {
+  restoreTransferredServer(setupParams, state);
+  // The client doesn't know, the positions carry on from where the other
+  // process left them.
+  connect(std::move(frameTransport), state.protocolVersion);
+  sendPendingFrames();
+  cancelTransferredStreams(state);
+}
+
+void RSocketStateMachine::restoreTransferredServer(
+    const SetupParameters& setupParams,
+    const ResumeStateTransfer& state) {
+  setResumable(true);
+  mtu_ = setupParams.mtu;
+  requestNBatching_ = setupParams.requestNBatching;
+  setAdaptiveRequestN(setupParams.adaptiveRequestN);
+  streamState_.setPendingFrameLimits(setupParams.pendingFrameLimits);
+  streamSerializeAhead_ = setupParams.streamSerializeAhead;
+  positionAckBytes_ = setupParams.positionAckBytes;
+  memoryLimits_ = setupParams.memoryLimits;
+  maxFrameLength_ = std::min(setupParams.maxFrameLength, kMaxFrameLength);
+  hibernateAfter_ = setupParams.hibernateAfter;
+  streamsFactory_.restoreStreamIds(state.nextStreamId, state.lastPeerStreamId);
+  setSetupIdentity(state.token, state.metadataMimeType, state.dataMimeType);
+}
+
+void RSocketStateMachine::cancelTransferredStreams(
+    const ResumeStateTransfer& state) {
+  for (auto streamId : state.openStreams) {
+    if (streamsFactory_.isLocalStreamId(streamId)) {
+      writeCancel(Frame_CANCEL(streamId));
+    } else {
+      writeError(Frame_ERROR::canceled(
+          streamId, "Stream lost when handing the connection over"));
+    }
+  }
+}
+
 void RSocketStateMachine::connectClient(
     yarpl::Reference<FrameTransport> transport,
     SetupParameters params) {
@@ -124,9 +349,50 @@ void RSocketStateMachine::connectClient(
   setFrameSerializer(FrameSerializer::createFrameSerializer(version));
 
   setResumable(params.resumable);
+  requesterLeaseEnabled_ = params.lease;
+  mtu_ = params.mtu;
+  requestNBatching_ = params.requestNBatching;
+  setAdaptiveRequestN(params.adaptiveRequestN);
+  streamState_.setPendingFrameLimits(params.pendingFrameLimits);
+  streamSerializeAhead_ = params.streamSerializeAhead;
+  positionAckBytes_ = params.positionAckBytes;
+  memoryLimits_ = params.memoryLimits;
+  maxFrameLength_ = std::min(params.maxFrameLength, kMaxFrameLength);
+  hibernateAfter_ = params.hibernateAfter;
+  if (keepaliveTimer_) {
+    keepaliveTimer_->setOnlyWhenIdle(params.keepaliveOnlyWhenIdle);
+  }
+  // The client asks for compressed payloads in the composite metadata of its
+  // SETUP, which the server answers with a METADATA_PUSH, and only compresses
+  // its own from then on.  Only the 1.0 serializer keeps the COMPRESSED flag.
+  if (version.major >= 1 &&
+      params.compression.codec != PayloadCompression::Codec::NONE &&
+      params.metadataMimeType == kCompositeMetadataMimeType) {
+    auto entries = compressionSetupMetadata(params.compression);
+    if (params.payload.metadata) {
+      params.payload.metadata->prependChain(std::move(entries));
+    } else {
+      params.payload.metadata = std::move(entries);
+    }
+    requestedCompression_ = std::move(params.compression);
+    acceptsCompressed_ = true;
+  }
+  // The transport compresses once the server accepts, see RSocketClient.
+  if (params.connectionCompression.codec !=
+          ConnectionCompression::Codec::NONE &&
+      params.metadataMimeType == kCompositeMetadataMimeType) {
+    auto entry = CompressedDuplexConnection::setupMetadata(
+        params.connectionCompression.codec);
+    if (params.payload.metadata) {
+      params.payload.metadata->prependChain(std::move(entry));
+    } else {
+      params.payload.metadata = std::move(entry);
+    }
+  }
 
   Frame_SETUP frame(
-      params.resumable ? FrameFlags::RESUME_ENABLE : FrameFlags::EMPTY,
+      (params.resumable ? FrameFlags::RESUME_ENABLE : FrameFlags::EMPTY) |
+          (params.lease ? FrameFlags::LEASE : FrameFlags::EMPTY),
       version.major,
       version.minor,
       getKeepaliveTime(),
@@ -174,6 +440,7 @@ void RSocketStateMachine::resumeClient(
       resumeManager_->firstSentPosition(),
       frameSerializer_->protocolVersion());
   VLOG(3) << "Out: " << resumeFrame;
+  RSOCKET_TRACE(resume_start, this, static_cast<int>(mode_));
 
   // Disconnect a previous client if there is one.
   disconnect(std::runtime_error{"Resuming client on a different connection"});
@@ -198,12 +465,13 @@ void RSocketStateMachine::connect(
         throw exn;
       }
     } else {
-      frameSerializer_ = FrameSerializer::createFrameSerializer(version);
-      if (!frameSerializer_) {
+      auto serializer = FrameSerializer::createFrameSerializer(version);
+      if (!serializer) {
         std::runtime_error exn("Invalid protocol version");
         transport->closeWithError(std::move(exn));
         throw exn;
       }
+      setFrameSerializer(std::move(serializer));
     }
   }
 
@@ -211,6 +479,9 @@ void RSocketStateMachine::connect(
   // setFrameProcessor() returns.  There can be terminating signals processed in
   // that call which will nullify frameTransport_.
   frameTransport_ = transport;
+  // The streams are told once the pending frames have been sent.
+  isWritable_ = true;
+  isReplaying_ = false;
 
   if (connectionEvents_) {
     connectionEvents_->onConnected();
@@ -221,17 +492,21 @@ void RSocketStateMachine::connect(
   auto copyThis = shared_from_this();
   frameTransport_->setFrameProcessor(copyThis);
   stats_->socketConnected();
+
+  if (hibernateAfter_.count() > 0 && !hibernationScheduled_) {
+    hibernationScheduled_ = true;
+    scheduleHibernationCheck();
+  }
 }
 
 void RSocketStateMachine::sendPendingFrames() {
   DCHECK(!resumeCallback_);
 
   // We are free to try to send frames again.  Not all frames might be sent if
-  // the connection breaks, the rest of them will queue up again.
-  auto outputFrames = streamState_.moveOutputPendingFrames();
-  for (auto& frame : outputFrames) {
-    outputFrameOrEnqueue(std::move(frame));
-  }
+  // the connection breaks or the transport starts buffering, the rest of them
+  // stay pending.
+  sendPendingFramesWhileWritable();
+  notifyStreamsWritability();
 
   // TODO: turn on only after setup frame was received
   if (keepaliveTimer_) {
@@ -267,23 +542,57 @@ void RSocketStateMachine::close(
 
   isClosed_ = true;
   stats_->socketClosed(signal);
+  if (memoryGovernor_) {
+    memoryGovernor_->update(governedBytes_, 0);
+  }
+  if (cpu_.enabled()) {
+    stats_->connectionCpuCycles(cpu_.cycles());
+  }
 
   VLOG(6) << "close";
 
+  if (signal == StreamCompletionSignal::CONNECTION_ERROR &&
+      FlightRecorder::dumpOnConnectionError()) {
+    LOG(ERROR) << mode_ << " Closing " << this << " with "
+               << (ex ? ex.what() : "CONNECTION_ERROR")
+               << ", last frames:";
+    for (auto& event : FlightRecorder::dumpThread(this)) {
+      LOG(ERROR) << "  " << event;
+    }
+  }
+
   if (auto resumeCallback = std::move(resumeCallback_)) {
     resumeCallback->onResumeError(
         ConnectionException(ex ? ex.get_exception()->what() : "RS closing"));
   }
 
-  closeStreams(signal);
+  // Incoming frames are discarded from here on, the streams left over are
+  // terminated in the next loop iterations.
+  auto const streamsClosed = closeStreams(signal);
+  closeForwardedStreams();
+  partialFrames_.clear();
   closeFrameTransport(ex, signal);
 
+  closeError_ = std::move(ex);
+  if (streamsClosed) {
+    finishClose();
+  }
+}
+
+void RSocketStateMachine::finishClose() {
   if (auto connectionEvents = std::move(connectionEvents_)) {
-    connectionEvents->onClosed(std::move(ex));
+    connectionEvents->onClosed(std::move(closeError_));
   }
 
   if (auto set = connectionSet_.lock()) {
-    set->remove(shared_from_this());
+    // The set owns this while it holds it.
+    if (auto self = weakFromThis().lock()) {
+      set->remove(self, connectionSetEventBase_);
+    }
+  }
+
+  if (auto onDrained = std::move(onDrained_)) {
+    onDrained();
   }
 }
 
@@ -305,6 +614,11 @@ void RSocketStateMachine::closeFrameTransport(
         ex ? ex.get_exception()->what() : "connection closing"));
   }
 
+  for (auto& ping : std::exchange(pings_, {})) {
+    ping.setException(ConnectionException("Keepalive not answered"));
+  }
+  keepaliveSentAt_.clear();
+
   // Echo the exception to the frameTransport only if the frameTransport started
   // closing with error.  Otherwise we sent some error frame over the wire and
   // we are closing the transport cleanly.
@@ -315,6 +629,7 @@ void RSocketStateMachine::closeFrameTransport(
       frameTransport_->close();
     }
     frameTransport_ = nullptr;
+    disconnectedAt_ = std::chrono::steady_clock::now();
   }
 }
 
@@ -383,9 +698,174 @@ void RSocketStateMachine::reconnect(
 void RSocketStateMachine::addStream(
     StreamId streamId,
     yarpl::Reference<StreamStateMachineBase> stateMachine) {
-  auto result =
-      streamState_.streams_.emplace(streamId, std::move(stateMachine));
-  DCHECK(result.second);
+  auto inserted =
+      streamState_.streams_.insert(streamId, std::move(stateMachine));
+  DCHECK(inserted);
+  RSOCKET_TRACE(stream_open, this, static_cast<int>(mode_), streamId);
+  if (!streamsFactory_.isLocalStreamId(streamId)) {
+    ++peerStreams_;
+    if (serverStreams_) {
+      serverStreams_->fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void RSocketStateMachine::setStreamLimits(
+    StreamLimits limits,
+    std::shared_ptr<std::atomic<size_t>> serverStreams) {
+  DCHECK_EQ(peerStreams_, 0U);
+  streamLimits_ = limits;
+  serverStreams_ = std::move(serverStreams);
+}
+
+void RSocketStateMachine::setMemoryGovernor(
+    std::shared_ptr<MemoryGovernor> governor) {
+  memoryGovernor_ = std::move(governor);
+}
+
+bool RSocketStateMachine::tooManyPeerStreams() const {
+  if (streamLimits_.maxPerConnection > 0 &&
+      peerStreams_ >= streamLimits_.maxPerConnection) {
+    return true;
+  }
+  return serverStreams_ && streamLimits_.maxPerServer > 0 &&
+      serverStreams_->load(std::memory_order_relaxed) >=
+      streamLimits_.maxPerServer;
+}
+
+bool RSocketStateMachine::hasStream(StreamId streamId) const {
+  return streamState_.streams_.find(streamId) != nullptr;
+}
+
+void RSocketStateMachine::setStreamPriority(
+    StreamId streamId,
+    StreamPriority priority) {
+  streamState_.setStreamPriority(streamId, priority);
+  if (frameTransport_) {
+    frameTransport_->setStreamPriority(streamId, priority);
+  }
+}
+
+void RSocketStateMachine::setStreamTimeout(
+    StreamId streamId,
+    std::chrono::milliseconds timeout,
+    bool propagate) {
+  auto& deadline = streamDeadlines_[streamId];
+  deadline.timeout = timeout;
+  deadline.propagate = propagate;
+}
+
+void RSocketStateMachine::setStreamTrace(
+    StreamId streamId,
+    const folly::Optional<TraceContext>& parent,
+    bool propagate) {
+  if (!parent && traceEvery_ == 0) {
+    return;
+  }
+  StreamTrace trace;
+  if (parent) {
+    trace.span.context = parent->newChild();
+  } else if (--traceCountdown_ == 0) {
+    traceCountdown_ = traceEvery_;
+    trace.span.context = TraceContext::newTrace(true);
+  } else {
+    return;
+  }
+  trace.span.streamId = streamId;
+  trace.span.requester = true;
+  trace.propagate = propagate;
+  streamTraces_[streamId] = std::move(trace);
+}
+
+void RSocketStateMachine::setStreamGroup(StreamId streamId, uint64_t group) {
+  streamGroups_[streamId] = group;
+}
+
+void RSocketStateMachine::cancelStreamGroup(uint64_t group) {
+  std::vector<StreamId> streamIds;
+  for (const auto& stream : streamGroups_) {
+    if (stream.second == group) {
+      streamIds.push_back(stream.first);
+    }
+  }
+  if (streamIds.empty()) {
+    return;
+  }
+  VLOG(3) << mode_ << " Cancelling the " << streamIds.size()
+          << " streams of group " << group;
+
+  // Cancelled while another group is, the frames join the batch of that one.
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  auto const outermost = !cancelBatch_;
+  if (outermost) {
+    frames.reserve(streamIds.size());
+    cancelBatch_ = &frames;
+  }
+  for (auto streamId : streamIds) {
+    auto stream = streamState_.streams_.find(streamId);
+    if (!stream) {
+      // Ended by the cancellation of a stream before it.
+      continue;
+    }
+    // Keep the stream alive while it terminates.
+    auto stateMachine = *stream;
+    stateMachine->cancelRequest();
+  }
+  if (outermost) {
+    cancelBatch_ = nullptr;
+    outputFramesOrEnqueue(std::move(frames));
+  }
+}
+
+void RSocketStateMachine::armStreamDeadline(
+    StreamId streamId,
+    std::chrono::milliseconds timeout) {
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  auto& deadline = streamDeadlines_[streamId];
+  deadline.timeout = timeout;
+  if (deadline.wheel) {
+    deadline.wheel->cancel(deadline.handle);
+  }
+  deadline.wheel = &TimingWheel::get(*eventBase);
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  deadline.handle = deadline.wheel->schedule(
+      timeout, [ weakSelf = std::move(weakSelf), streamId ] {
+        if (auto self = weakSelf.lock()) {
+          self->expireStream(streamId);
+        }
+      });
+}
+
+void RSocketStateMachine::cancelStreamDeadline(StreamId streamId) {
+  auto it = streamDeadlines_.find(streamId);
+  if (it == streamDeadlines_.end()) {
+    return;
+  }
+  if (it->second.wheel) {
+    it->second.wheel->cancel(it->second.handle);
+  }
+  streamDeadlines_.erase(it);
+}
+
+void RSocketStateMachine::expireStream(StreamId streamId) {
+  // The timeout has fired, there is nothing to cancel.
+  streamDeadlines_.erase(streamId);
+  auto stream = streamState_.streams_.find(streamId);
+  if (!stream) {
+    return;
+  }
+  // Keep the stream alive while it terminates.
+  auto stateMachine = *stream;
+  VLOG(3) << mode_ << " Deadline of stream " << streamId << " expired";
+
+  if (streamsFactory_.isLocalStreamId(streamId)) {
+    outputFrameOrEnqueue(Frame_CANCEL(streamId));
+    stateMachine->handleError(RequestTimeoutError(""));
+  } else {
+    stateMachine->handleCancel();
+  }
+  endStream(streamId, StreamCompletionSignal::ERROR);
 }
 
 void RSocketStateMachine::endStream(
@@ -408,30 +888,88 @@ bool RSocketStateMachine::endStreamInternal(
     StreamId streamId,
     StreamCompletionSignal signal) {
   VLOG(6) << "endStreamInternal";
-  auto it = streamState_.streams_.find(streamId);
-  if (it == streamState_.streams_.end()) {
+  // Remove from the map before notifying the stateMachine.
+  auto stateMachine = streamState_.streams_.erase(streamId);
+  if (!stateMachine) {
     // Unsubscribe handshake initiated by the connection, we're done.
     return false;
   }
+  RSOCKET_TRACE(
+      stream_close,
+      this,
+      static_cast<int>(mode_),
+      streamId,
+      static_cast<int>(signal));
+  if (!streamsFactory_.isLocalStreamId(streamId)) {
+    --peerStreams_;
+    if (serverStreams_) {
+      serverStreams_->fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  streamState_.clearStreamPriority(streamId);
+  if (frameTransport_) {
+    frameTransport_->clearStreamPriority(streamId);
+  }
+  cancelStreamDeadline(streamId);
+  streamLatencies_.erase(streamId);
+  if (!streamGroups_.empty()) {
+    streamGroups_.erase(streamId);
+  }
+  if (!streamTraces_.empty()) {
+    finishStreamTrace(streamId, signal);
+  }
+  if (!streamStalls_.empty()) {
+    finishStreamStalls(streamId);
+  }
 
-  // Remove from the map before notifying the stateMachine.
-  auto stateMachine = std::move(it->second);
-  streamState_.streams_.erase(it);
   stateMachine->endStream(signal);
+  if (isDraining_ && !isClosed() && streamState_.streams_.empty()) {
+    scheduleCloseDrained();
+  }
   return true;
 }
 
-void RSocketStateMachine::closeStreams(StreamCompletionSignal signal) {
-  // Close all streams.
+bool RSocketStateMachine::closeStreams(StreamCompletionSignal signal) {
+  size_t closed = 0;
   while (!streamState_.streams_.empty()) {
+    if (closed++ == kStreamsClosedPerLoop && scheduleCloseStreams(signal)) {
+      return false;
+    }
     auto oldSize = streamState_.streams_.size();
     auto result =
-        endStreamInternal(streamState_.streams_.begin()->first, signal);
+        endStreamInternal(streamState_.streams_.anyStreamId(), signal);
     // TODO(stupaq): what kind of a user action could violate these
     // assertions?
     DCHECK(result);
     DCHECK_EQ(streamState_.streams_.size(), oldSize - 1);
   }
+  return true;
+}
+
+bool RSocketStateMachine::scheduleCloseStreams(StreamCompletionSignal signal) {
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  // Without an owner, e.g. when closed by the last one letting go of this,
+  // nothing would keep this alive until the next loop iteration.
+  auto self = weakFromThis().lock();
+  if (!eventBase || !self) {
+    return false;
+  }
+  // Holds on to the connection until all of its streams are terminated.
+  eventBase->runInLoop([ self = std::move(self), signal ] {
+    if (self->closeStreams(signal)) {
+      self->finishClose();
+    }
+  });
+  return true;
+}
+
+std::weak_ptr<RSocketStateMachine> RSocketStateMachine::weakFromThis() {
+  // std::enable_shared_from_this::weak_from_this() comes with C++17.
+  try {
+    return shared_from_this();
+  } catch (const std::bad_weak_ptr&) {
+    return {};
+  }
 }
 
 void RSocketStateMachine::processFrame(std::unique_ptr<folly::IOBuf> frame) {
@@ -444,27 +982,95 @@ void RSocketStateMachine::processFrame(std::unique_ptr<folly::IOBuf> frame) {
   // Necessary in case the only stream state machine closes itself, and takes
   // the RSocketStateMachine with it.
   auto self = shared_from_this();
+  CpuAccount::Scope cpuScope(cpu_);
+
+  if (measureStreamLatencies_) {
+    framesReadTime_ = Clock::now();
+  }
+  if (keepaliveTimer_) {
+    keepaliveTimer_->frameReceived();
+  }
+  processFrameImpl(std::move(frame));
+  flushFramesRead();
+  trackReceivedFrames();
+  checkMemoryUsage();
+}
+
+void RSocketStateMachine::processFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  if (isClosed()) {
+    VLOG(4) << "StateMachine has been closed.  Discarding incoming frames";
+    return;
+  }
+
+  auto self = shared_from_this();
+  CpuAccount::Scope cpuScope(cpu_);
+
+  if (measureStreamLatencies_) {
+    framesReadTime_ = Clock::now();
+  }
+  if (keepaliveTimer_) {
+    keepaliveTimer_->frameReceived();
+  }
 
+  // The frames which the transport delivers after it got closed, or replaced,
+  // while processing the batch are dropped, as it would have stopped reading.
+  auto const transport = frameTransport_;
+  batchingFireAndForget_ = requestResponder_->batchesFireAndForget();
+  for (auto& frame : frames) {
+    if (isClosed() || frameTransport_ != transport) {
+      break;
+    }
+    processFrameImpl(std::move(frame));
+  }
+  batchingFireAndForget_ = false;
+  flushFireAndForgetBatch();
+  flushFramesRead();
+  trackReceivedFrames();
+  checkMemoryUsage();
+}
+
+void RSocketStateMachine::processFrameImpl(
+    std::unique_ptr<folly::IOBuf> frame) {
   if (!ensureOrAutodetectFrameSerializer(*frame)) {
     constexpr folly::StringPiece message{"Cannot detect protocol version"};
     closeWithError(Frame_ERROR::connectionError(message.str()));
     return;
   }
 
-  auto frameType = frameSerializer_->peekFrameType(*frame);
-  stats_->frameRead(frameType);
-
-  auto optStreamId = frameSerializer_->peekStreamId(*frame);
-  if (!optStreamId) {
+  auto header = peekFrameHeader(*frame);
+  if (!header) {
+    stats_->frameRead(frameSerializer_->peekFrameType(*frame));
     constexpr folly::StringPiece message{"Cannot decode stream ID"};
     closeWithError(Frame_ERROR::connectionError(message.str()));
     return;
   }
 
+  auto frameType = header->type;
   auto frameLength = frame->computeChainDataLength();
-  auto streamId = *optStreamId;
+  if (reportFrameSizes_) {
+    stats_->frameReadBytes(frameType, frameLength);
+  } else {
+    countFrameRead(frameType);
+  }
+  RSOCKET_TRACE(
+      frame_read,
+      this,
+      static_cast<int>(mode_),
+      header->streamId,
+      static_cast<int>(frameType),
+      frameLength);
+  FlightRecorder::recordRead(
+      this, header->streamId, frameType, header->flags, frameLength);
+  bytesRead_ += frameLength;
+  if (frameType != FrameType::KEEPALIVE) {
+    ++activeFrames_;
+  }
+  auto streamId = header->streamId;
   if (streamId == 0) {
-    handleConnectionFrame(frameType, std::move(frame));
+    // Keepalives report the position up to the frames received before them.
+    trackReceivedFrames();
+    handleConnectionFrame(*header, std::move(frame));
   } else if (resumeCallback_) {
     // during the time when we are resuming we are can't receive any other
     // than connection level frames which drives the resumption
@@ -475,11 +1081,65 @@ void RSocketStateMachine::processFrame(std::unique_ptr<folly::IOBuf> frame) {
     LOG(ERROR) << message;
     closeWithError(Frame_ERROR::connectionError(message.str()));
     return;
+  } else if (
+      (!!(header->flags & FrameFlags::FOLLOWS) ||
+       (!partialFrames_.empty() && partialFrames_.count(streamId))) &&
+      (forwardedStreams_.empty() || !forwardedStreams_.count(streamId))) {
+    // The fragments of forwarded streams go through as they are.
+    if (auto other = reassembleFragment(*header, std::move(frame))) {
+      handleStreamFrame(*header, std::move(other));
+    }
   } else {
-    handleStreamFrame(streamId, frameType, std::move(frame));
+    handleStreamFrame(*header, std::move(frame));
+  }
+  // The consumer allowance is only needed to resume the connection, avoid the
+  // extra stream lookup otherwise.
+  receivedFrames_.push_back(ReceivedFrameInfo{
+      frameLength,
+      frameType,
+      streamId,
+      isResumable_ ? getConsumerAllowance(streamId) : 0});
+}
+
+void RSocketStateMachine::countFrameRead(FrameType frameType) {
+  if (framesReadCount_ > 0 && framesReadType_ != frameType) {
+    flushFramesRead();
+  }
+  framesReadType_ = frameType;
+  ++framesReadCount_;
+}
+
+void RSocketStateMachine::flushFramesRead() {
+  if (framesReadCount_ == 0) {
+    return;
+  }
+  stats_->framesRead(framesReadType_, framesReadCount_);
+  framesReadCount_ = 0;
+}
+
+void RSocketStateMachine::flushFireAndForgetBatch() {
+  if (fireAndForgetBatch_.empty()) {
+    return;
+  }
+  auto batch = std::move(fireAndForgetBatch_);
+  fireAndForgetBatch_.clear();
+  requestResponder_->handleFireAndForgetBatch(std::move(batch));
+}
+
+void RSocketStateMachine::trackReceivedFrames() {
+  if (receivedFrames_.empty()) {
+    return;
+  }
+  resumeManager_->trackReceivedFrames(receivedFrames_);
+  receivedFrames_.clear();
+
+  if (positionAckBytes_ > 0 && isResumable_ && !isDisconnected() &&
+      !resumeCallback_ && frameSerializer_ &&
+      resumeManager_->impliedPosition() - ackedPosition_ >=
+          static_cast<ResumePosition>(positionAckBytes_)) {
+    // a plain position update, the peer doesn't respond to it
+    sendKeepalive(FrameFlags::EMPTY, folly::IOBuf::create(0));
   }
-  resumeManager_->trackReceivedFrame(
-      frameLength, frameType, streamId, getConsumerAllowance(streamId));
 }
 
 void RSocketStateMachine::onTerminal(folly::exception_wrapper ex) {
@@ -492,9 +1152,197 @@ void RSocketStateMachine::onTerminal(folly::exception_wrapper ex) {
   close(std::move(ex), termSignal);
 }
 
+void RSocketStateMachine::onWritabilityChanged(bool writable) {
+  if (isDisconnected() || isWritable_ == writable) {
+    return;
+  }
+  VLOG(3) << mode_ << " writable=" << writable;
+  isWritable_ = writable;
+  CpuAccount::Scope cpuScope(cpu_);
+
+  // Send the frames held while the transport was buffering, until it starts
+  // buffering again.
+  sendPendingFramesWhileWritable();
+  notifyStreamsWritability();
+  checkMemoryUsage();
+}
+
+void RSocketStateMachine::sendPendingFramesWhileWritable() {
+  // The frames sent after the disconnection go first.
+  if (isReplaying_) {
+    replayFrames();
+    if (isReplaying_) {
+      return;
+    }
+  }
+
+  // Frames are taken one at a time, so that spilled frames are only read back
+  // once they can be written.
+  while (isWritable_ && !isDisconnected() && !resumeCallback_) {
+    auto frame = streamState_.dequeueOutputPendingFrame();
+    if (!frame) {
+      break;
+    }
+    outputFrame(std::move(frame));
+  }
+}
+
+bool RSocketStateMachine::rejectsNewStreams() const {
+  return streamState_.pendingFrameLimits().policy ==
+      PendingFrameLimits::Policy::FAIL_NEW_STREAMS &&
+      streamState_.isOutputPendingFull();
+}
+
+bool RSocketStateMachine::dropsFireAndForget() const {
+  auto const limit =
+      streamState_.pendingFrameLimits().maxBytesForFireAndForget;
+  if (limit == std::numeric_limits<size_t>::max()) {
+    return false;
+  }
+  auto bytes = streamState_.outputPendingBytes();
+  if (frameTransport_) {
+    bytes += frameTransport_->bufferedBytes();
+  }
+  return bytes >= limit;
+}
+
+void RSocketStateMachine::notifyStreamsWritability() {
+  // Streams can produce, and end, while being notified.
+  std::vector<yarpl::Reference<StreamStateMachineBase>> streams;
+  streams.reserve(streamState_.streams_.size());
+  streamState_.streams_.forEach(
+      [&](StreamId, const yarpl::Reference<StreamStateMachineBase>& stream) {
+        streams.push_back(stream);
+      });
+  for (auto& stream : streams) {
+    // Producing might have made the transport buffer again, or filled up the
+    // pending frames.
+    stream->connectionWritabilityChanged(
+        isWritable_ && !isReplaying_ && !rejectsNewStreams() &&
+        !memoryBackpressure_);
+  }
+}
+
+size_t RSocketStateMachine::memoryUsage() const {
+  size_t bytes = streamState_.outputPendingBytes();
+  for (auto const& it : partialFrames_) {
+    bytes += it.second.payload.size();
+  }
+  bytes += resumeManager_->bufferedBytes();
+  if (frameTransport_) {
+    bytes += frameTransport_->bufferedBytes();
+  }
+  return bytes;
+}
+
+ConnectionSnapshot RSocketStateMachine::snapshot() const {
+  ConnectionSnapshot snapshot;
+  snapshot.mode = mode_;
+  snapshot.protocolVersion = protocolVersion();
+  snapshot.resumable = isResumable_;
+  snapshot.disconnected = isDisconnected();
+  snapshot.pendingFrames = streamState_.outputPendingFrames();
+  snapshot.pendingBytes = streamState_.outputPendingBytes();
+  snapshot.resumeBufferBytes = resumeManager_->bufferedBytes();
+  if (frameTransport_) {
+    snapshot.transportBufferedBytes = frameTransport_->bufferedBytes();
+  }
+  snapshot.bytesRead = bytesRead_;
+  snapshot.bytesWritten = bytesWritten_;
+  snapshot.cpuCycles = cpu_.cycles();
+
+  snapshot.streams.reserve(streamState_.streams_.size());
+  streamState_.streams_.forEach([&](StreamId streamId, const auto& stream) {
+    StreamSnapshot streamSnapshot;
+    streamSnapshot.streamId = streamId;
+    streamSnapshot.consumerAllowance = stream->getConsumerAllowance();
+    snapshot.streams.push_back(streamSnapshot);
+  });
+  return snapshot;
+}
+
+void RSocketStateMachine::checkMemoryUsage() {
+  auto const& limits = memoryLimits_;
+  auto const limited = limits.maxBytes > 0 || limits.highWaterMark > 0;
+  if ((!limited && !memoryGovernor_) || isClosed() || memoryExceeded_) {
+    return;
+  }
+  auto const bytes = memoryUsage();
+  if (memoryGovernor_) {
+    governMemory(bytes);
+  }
+  if (!limited) {
+    return;
+  }
+
+  if (limits.maxBytes > 0 && bytes > limits.maxBytes) {
+    VLOG(2) << mode_ << " Holding " << bytes << " bytes, above the limit of "
+            << limits.maxBytes;
+    memoryExceeded_ = true;
+    stats_->connectionMemoryExceeded(bytes);
+    // The check runs while frames are read and written, the streams doing so
+    // are ended once they have returned.
+    auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+    CHECK(eventBase);
+    std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+    eventBase->runInLoop([weakSelf = std::move(weakSelf)] {
+      if (auto self = weakSelf.lock()) {
+        if (!self->isClosed()) {
+          self->closeWithError(Frame_ERROR::connectionError(
+              "Connection memory limit exceeded"));
+        }
+      }
+    });
+    return;
+  }
+
+  if (limits.highWaterMark == 0) {
+    return;
+  }
+  if (!memoryBackpressure_ && bytes >= limits.highWaterMark) {
+    memoryBackpressure_ = true;
+  } else if (memoryBackpressure_ && bytes <= limits.lowWaterMark) {
+    memoryBackpressure_ = false;
+  } else {
+    return;
+  }
+  if (requestNWindowTuner_) {
+    requestNWindowTuner_->setMemoryPressure(
+        memoryBackpressure_ || governorPressure_);
+  }
+  VLOG(3) << mode_ << " Holding " << bytes << " bytes, backpressure="
+          << memoryBackpressure_;
+  stats_->connectionMemoryBackpressure(memoryBackpressure_, bytes);
+  notifyStreamsWritability();
+}
+
+void RSocketStateMachine::governMemory(size_t bytes) {
+  auto& governor = *memoryGovernor_;
+  governor.update(governedBytes_, bytes);
+
+  auto const fraction = governor.resumeFraction();
+  if (fraction != resumeFraction_) {
+    VLOG(3) << mode_ << " Limiting the resume buffer to " << fraction
+            << " of its capacity, " << governor.usage() << " bytes held";
+    resumeFraction_ = fraction;
+    resumeManager_->limitBuffer(fraction);
+    governor.update(governedBytes_, memoryUsage());
+  }
+
+  auto const pressure = governor.level() != MemoryGovernor::Level::NORMAL;
+  if (pressure != governorPressure_) {
+    governorPressure_ = pressure;
+    if (requestNWindowTuner_) {
+      requestNWindowTuner_->setMemoryPressure(
+          memoryBackpressure_ || governorPressure_);
+    }
+  }
+}
+
 void RSocketStateMachine::handleConnectionFrame(
-    FrameType frameType,
+    const FrameHeader& header,
     std::unique_ptr<folly::IOBuf> payload) {
+  auto frameType = header.type;
   switch (frameType) {
     case FrameType::KEEPALIVE: {
       Frame_KEEPALIVE frame;
@@ -502,13 +1350,18 @@ void RSocketStateMachine::handleConnectionFrame(
         return;
       }
       VLOG(3) << mode_ << " In: " << frame;
+      RSOCKET_TRACE(
+          keepalive_received,
+          this,
+          static_cast<int>(mode_),
+          static_cast<int>(frame.header_.flags),
+          frame.data_ ? frame.data_->computeChainDataLength() : 0);
       resumeManager_->resetUpToPosition(frame.position_);
       if (mode_ == RSocketMode::SERVER) {
+        // Without the respond flag the keepalive only acknowledges the
+        // position, see SetupParameters::positionAckBytes.
         if (!!(frame.header_.flags & FrameFlags::KEEPALIVE_RESPOND)) {
           sendKeepalive(FrameFlags::EMPTY, std::move(frame.data_));
-        } else {
-          closeWithError(
-              Frame_ERROR::connectionError("keepalive without flag"));
         }
       } else {
         if (!!(frame.header_.flags & FrameFlags::KEEPALIVE_RESPOND)) {
@@ -517,6 +1370,18 @@ void RSocketStateMachine::handleConnectionFrame(
         } else if (keepaliveTimer_) {
           keepaliveTimer_->keepaliveReceived();
         }
+        if (keepaliveSentAt_) {
+          auto const rtt = std::chrono::steady_clock::now() - *keepaliveSentAt_;
+          keepaliveSentAt_.clear();
+          if (requestNWindowTuner_) {
+            requestNWindowTuner_->addRoundTrip(rtt);
+          }
+          stats_->keepaliveRoundTrip(
+              std::chrono::duration_cast<std::chrono::microseconds>(rtt));
+        }
+        for (auto& ping : std::exchange(pings_, {})) {
+          ping.setValue();
+        }
         stats_->keepaliveReceived();
       }
       return;
@@ -525,6 +1390,13 @@ void RSocketStateMachine::handleConnectionFrame(
       Frame_METADATA_PUSH frame;
       if (deserializeFrameOrError(frame, std::move(payload))) {
         VLOG(3) << mode_ << " In: " << frame;
+        if (requestedCompression_.codec != PayloadCompression::Codec::NONE &&
+            frame.metadata_ && hasPayloadCompressionEntry(*frame.metadata_)) {
+          // The server accepts compressed payloads.
+          compression_ = std::move(requestedCompression_);
+          requestedCompression_ = PayloadCompression();
+          return;
+        }
         requestResponder_->handleMetadataPush(std::move(frame.metadata_));
       }
       return;
@@ -573,6 +1445,7 @@ void RSocketStateMachine::handleConnectionFrame(
         coldResumeInProgress_ = false;
       }
 
+      RSOCKET_TRACE(resume_finish, this, static_cast<int>(mode_), 1);
       auto resumeCallback = std::move(resumeCallback_);
       resumeCallback->onResumeOk();
       resumeFromPosition(frame.position_);
@@ -590,6 +1463,7 @@ void RSocketStateMachine::handleConnectionFrame(
       if ((frame.errorCode_ == ErrorCode::CONNECTION_ERROR ||
            frame.errorCode_ == ErrorCode::REJECTED_RESUME) &&
           resumeCallback_) {
+        RSOCKET_TRACE(resume_finish, this, static_cast<int>(mode_), 0);
         auto resumeCallback = std::move(resumeCallback_);
         resumeCallback->onResumeError(
             ResumptionException(frame.payload_.cloneDataToString()));
@@ -601,10 +1475,26 @@ void RSocketStateMachine::handleConnectionFrame(
           StreamCompletionSignal::ERROR);
       return;
     }
+    case FrameType::LEASE: {
+      Frame_LEASE frame;
+      if (!deserializeFrameOrError(frame, std::move(payload))) {
+        return;
+      }
+      VLOG(3) << mode_ << " In: " << frame;
+
+      if (!requesterLeaseEnabled_) {
+        constexpr folly::StringPiece message{
+            "Received LEASE on a connection set up without leases"};
+        closeWithError(Frame_ERROR::connectionError(message.str()));
+        return;
+      }
+      requesterLease_.update(
+          std::chrono::milliseconds(frame.ttl_), frame.numberOfRequests_);
+      return;
+    }
     case FrameType::SETUP: // this should be processed in SetupResumeAcceptor
     case FrameType::RESUME: // this should be processed in SetupResumeAcceptor
     case FrameType::RESERVED:
-    case FrameType::LEASE:
     case FrameType::REQUEST_RESPONSE:
     case FrameType::REQUEST_FNF:
     case FrameType::REQUEST_STREAM:
@@ -623,19 +1513,27 @@ void RSocketStateMachine::handleConnectionFrame(
 }
 
 void RSocketStateMachine::handleStreamFrame(
-    StreamId streamId,
-    FrameType frameType,
+    const FrameHeader& header,
     std::unique_ptr<folly::IOBuf> serializedFrame) {
-  auto it = streamState_.streams_.find(streamId);
-  if (it == streamState_.streams_.end()) {
-    handleUnknownStream(streamId, frameType, std::move(serializedFrame));
+  auto streamId = header.streamId;
+  auto frameType = header.type;
+  if (!forwardedStreams_.empty()) {
+    auto it = forwardedStreams_.find(streamId);
+    if (it != forwardedStreams_.end()) {
+      forwardStreamFrame(header, it->second, std::move(serializedFrame));
+      return;
+    }
+  }
+  auto stateMachinePtr = streamState_.streams_.find(streamId);
+  if (!stateMachinePtr) {
+    handleUnknownStream(header, std::move(serializedFrame));
     return;
   }
 
   // we are purposely making a copy of the reference here to avoid problems with
   // lifetime of the stateMachine when a terminating signal is delivered which
   // will cause the stateMachine to be destroyed while in one of its methods
-  auto stateMachine = it->second;
+  auto stateMachine = *stateMachinePtr;
 
   switch (frameType) {
     case FrameType::REQUEST_N: {
@@ -644,6 +1542,11 @@ void RSocketStateMachine::handleStreamFrame(
         return;
       }
       VLOG(3) << mode_ << " In: " << frameRequestN;
+      streamRequestNReceived(streamId, frameRequestN.requestN_);
+      streamAllowanceAdded(
+          streamId,
+          RSocketStats::StallDirection::SEND,
+          frameRequestN.requestN_);
       stateMachine->handleRequestN(frameRequestN.requestN_);
       break;
     }
@@ -658,10 +1561,11 @@ void RSocketStateMachine::handleStreamFrame(
         return;
       }
       VLOG(3) << mode_ << " In: " << framePayload;
-      stateMachine->handlePayload(
+      handleStreamPayload(
+          *stateMachine,
+          streamId,
           std::move(framePayload.payload_),
-          framePayload.header_.flagsComplete(),
-          framePayload.header_.flagsNext());
+          framePayload.header_.flags);
       break;
     }
     case FrameType::ERROR: {
@@ -697,37 +1601,230 @@ void RSocketStateMachine::handleStreamFrame(
   }
 }
 
-void RSocketStateMachine::handleUnknownStream(
+void RSocketStateMachine::handleStreamPayload(
+    StreamStateMachineBase& stateMachine,
     StreamId streamId,
-    FrameType frameType,
+    Payload payload,
+    FrameFlags flags) {
+  auto const complete = !!(flags & FrameFlags::COMPLETE);
+  auto const next = !!(flags & FrameFlags::NEXT);
+  if (next) {
+    streamTracePayload(streamId, false);
+    streamAllowanceUsed(
+        streamId, RSocketStats::StallDirection::RECEIVE, complete);
+  }
+  stateMachine.handlePayload(std::move(payload), complete, next);
+}
+
+std::unique_ptr<folly::IOBuf> RSocketStateMachine::reassembleFragment(
+    const FrameHeader& header,
     std::unique_ptr<folly::IOBuf> serializedFrame) {
-  DCHECK(streamId != 0);
-  // TODO: comparing string versions is odd because from version
-  // 10.0 the lexicographic comparison doesn't work
-  // we should change the version to struct
-  if (frameSerializer_->protocolVersion() > ProtocolVersion{0, 0} &&
-      !streamsFactory_.registerNewPeerStreamId(streamId)) {
-    return;
+  auto streamId = header.streamId;
+  auto it = partialFrames_.find(streamId);
+  if (it == partialFrames_.end()) {
+    // the first fragment
+    PartialFrame partial;
+    Payload payload;
+    switch (header.type) {
+      case FrameType::REQUEST_STREAM:
+      case FrameType::REQUEST_CHANNEL: {
+        // both carry the same fields, only the frame type differs
+        Frame_REQUEST_STREAM frame;
+        if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+          return nullptr;
+        }
+        partial.requestN = frame.requestN_;
+        partial.flags = frame.header_.flags;
+        payload = std::move(frame.payload_);
+        break;
+      }
+      case FrameType::REQUEST_RESPONSE: {
+        Frame_REQUEST_RESPONSE frame;
+        if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+          return nullptr;
+        }
+        partial.flags = frame.header_.flags;
+        payload = std::move(frame.payload_);
+        break;
+      }
+      case FrameType::REQUEST_FNF: {
+        Frame_REQUEST_FNF frame;
+        if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+          return nullptr;
+        }
+        partial.flags = frame.header_.flags;
+        payload = std::move(frame.payload_);
+        break;
+      }
+      case FrameType::PAYLOAD: {
+        Frame_PAYLOAD frame;
+        if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+          return nullptr;
+        }
+        partial.flags = frame.header_.flags;
+        payload = std::move(frame.payload_);
+        break;
+      }
+      default:
+        // FOLLOWS is meaningless on other frames
+        return serializedFrame;
+    }
+    partial.type = header.type;
+    partial.payload.append(std::move(payload));
+    partialFrames_.emplace(streamId, std::move(partial));
+    return nullptr;
   }
 
-  if (!isNewStreamFrame(frameType)) {
+  switch (header.type) {
+    case FrameType::PAYLOAD:
+      break;
+    case FrameType::CANCEL:
+    case FrameType::ERROR:
+      // a CANCEL or an ERROR abandons the fragmented frame
+      partialFrames_.erase(it);
+      return serializedFrame;
+    case FrameType::REQUEST_N:
+      if (it->second.type == FrameType::REQUEST_STREAM ||
+          it->second.type == FrameType::REQUEST_CHANNEL) {
+        // the stream only opens with the last fragment, until then the
+        // credits add up to those of the request
+        Frame_REQUEST_N frame;
+        if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+          return nullptr;
+        }
+        it->second.requestN = static_cast<uint32_t>(std::min<int64_t>(
+            int64_t{it->second.requestN} + frame.requestN_,
+            Frame_REQUEST_N::kMaxRequestN));
+        return nullptr;
+      }
+      return serializedFrame;
+    default:
+      // the frames interleaved with the fragments, like a REQUEST_N for the
+      // other direction of a channel, are handled as usual
+      return serializedFrame;
+  }
+
+  Frame_PAYLOAD frame;
+  if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
+    return nullptr;
+  }
+  VLOG(4) << mode_ << " In: " << frame;
+  it->second.payload.append(std::move(frame.payload_));
+  if (it->second.payload.size() > maxFrameLength_) {
+    partialFrames_.erase(it);
     auto msg = folly::sformat(
-        "Unexpected frame {} for stream {}", toString(frameType), streamId);
+        "Fragmented frame for stream {} longer than {} bytes",
+        streamId,
+        maxFrameLength_);
     VLOG(1) << msg;
     closeWithError(Frame_ERROR::connectionError(std::move(msg)));
+    return nullptr;
+  }
+  if (!!(frame.header_.flags & FrameFlags::FOLLOWS)) {
+    return nullptr;
+  }
+
+  auto partial = std::move(it->second);
+  partialFrames_.erase(it);
+  handleReassembledFrame(streamId, std::move(partial), frame.header_.flags);
+  return nullptr;
+}
+
+void RSocketStateMachine::handleReassembledFrame(
+    StreamId streamId,
+    PartialFrame partial,
+    FrameFlags lastFlags) {
+  auto payload = partial.payload.move();
+  // The first fragment tells whether the payload is compressed, which is
+  // undone once the stream is known, to fail only the stream if it can't.
+  FrameHeader header(
+      partial.type,
+      partial.flags & ~(FrameFlags::FOLLOWS | FrameFlags::METADATA),
+      streamId);
+  VLOG(3) << mode_ << " In: " << header << " reassembled";
+
+  if (partial.type != FrameType::PAYLOAD) {
+    if (streamState_.streams_.find(streamId) ||
+        forwardedStreams_.count(streamId)) {
+      auto msg = folly::sformat(
+          "Unexpected {} frame for stream {}",
+          toString(partial.type),
+          streamId);
+      closeWithError(Frame_ERROR::connectionError(std::move(msg)));
+      return;
+    }
+    if (!admitPeerStream(header.type, streamId)) {
+      return;
+    }
+    auto const metadata = payload.metadata
+        ? MetadataView(
+              folly::io::Cursor(payload.metadata.get()),
+              payload.metadata->computeChainDataLength())
+        : MetadataView();
+    if (!acceptRequest(header.type, streamId, metadata)) {
+      VLOG(2) << mode_ << " Responder rejected " << toString(header.type)
+              << " for stream " << streamId;
+      if (header.type != FrameType::REQUEST_FNF) {
+        rejectStream(streamId, Rejection::REJECTED);
+      }
+      return;
+    }
+    if (!decompressFrame(header, payload)) {
+      return;
+    }
+    openPeerStream(header, partial.requestN, std::move(payload));
     return;
   }
 
-  auto saveStreamToken = [&](const Payload& payload) {
-    if (coldResumeHandler_) {
-      auto streamType = getStreamType(frameType);
-      CHECK(streamType != StreamType::FNF);
-      auto streamToken = coldResumeHandler_->generateStreamToken(
-          payload, streamId, streamType);
-      resumeManager_->onStreamOpen(
-          streamId, RequestOriginator::REMOTE, streamToken, streamType);
+  auto stateMachinePtr = streamState_.streams_.find(streamId);
+  if (!stateMachinePtr) {
+    // ignores a late frame of a closed stream, fails the connection otherwise
+    auto const admitted = admitPeerStream(FrameType::PAYLOAD, streamId);
+    DCHECK(!admitted);
+    return;
+  }
+  // see handleStreamFrame()
+  auto stateMachine = *stateMachinePtr;
+  if (!decompressFrame(header, payload)) {
+    return;
+  }
+  // the last fragment tells whether the payload completes the stream
+  handleStreamPayload(
+      *stateMachine,
+      streamId,
+      std::move(payload),
+      lastFlags & (FrameFlags::COMPLETE | FrameFlags::NEXT));
+}
+
+void RSocketStateMachine::handleUnknownStream(
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> serializedFrame) {
+  auto streamId = header.streamId;
+  auto frameType = header.type;
+  if (!admitPeerStream(frameType, streamId)) {
+    return;
+  }
+
+  if (!acceptRequest(frameType, streamId, *serializedFrame)) {
+    VLOG(2) << mode_ << " Responder rejected " << toString(frameType)
+            << " for stream " << streamId;
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::REJECTED);
     }
-  };
+    return;
+  }
+
+  if (frameType == FrameType::REQUEST_RESPONSE &&
+      respondSerialized(streamId, serializedFrame)) {
+    return;
+  }
+
+  if ((frameType == FrameType::REQUEST_STREAM ||
+       frameType == FrameType::REQUEST_RESPONSE) &&
+      (forwardRequest(frameType, streamId, serializedFrame) ||
+       handleLazyRequest(streamId, serializedFrame))) {
+    return;
+  }
 
   if (frameType == FrameType::REQUEST_CHANNEL) {
     Frame_REQUEST_CHANNEL frame;
@@ -735,171 +1832,1015 @@ void RSocketStateMachine::handleUnknownStream(
       return;
     }
     VLOG(3) << mode_ << " In: " << frame;
-    auto stateMachine =
-        streamsFactory_.createChannelResponder(frame.requestN_, streamId);
-    saveStreamToken(frame.payload_);
-    auto requestSink = requestResponder_->handleRequestChannelCore(
-        std::move(frame.payload_), streamId, stateMachine);
-    stateMachine->subscribe(requestSink);
+    openPeerStream(frame.header_, frame.requestN_, std::move(frame.payload_));
   } else if (frameType == FrameType::REQUEST_STREAM) {
     Frame_REQUEST_STREAM frame;
     if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
       return;
     }
     VLOG(3) << mode_ << " In: " << frame;
-    auto stateMachine =
-        streamsFactory_.createStreamResponder(frame.requestN_, streamId);
-    saveStreamToken(frame.payload_);
-    requestResponder_->handleRequestStreamCore(
-        std::move(frame.payload_), streamId, stateMachine);
+    openPeerStream(frame.header_, frame.requestN_, std::move(frame.payload_));
   } else if (frameType == FrameType::REQUEST_RESPONSE) {
     Frame_REQUEST_RESPONSE frame;
     if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
       return;
     }
     VLOG(3) << mode_ << " In: " << frame;
-    auto stateMachine =
-        streamsFactory_.createRequestResponseResponder(streamId);
-    saveStreamToken(frame.payload_);
-    requestResponder_->handleRequestResponseCore(
-        std::move(frame.payload_), streamId, stateMachine);
+    openPeerStream(frame.header_, 1, std::move(frame.payload_));
   } else if (frameType == FrameType::REQUEST_FNF) {
     Frame_REQUEST_FNF frame;
     if (!deserializeFrameOrError(frame, std::move(serializedFrame))) {
       return;
     }
     VLOG(3) << mode_ << " In: " << frame;
-    // no stream tracking is necessary
-    requestResponder_->handleFireAndForget(std::move(frame.payload_), streamId);
+    openPeerStream(frame.header_, 0, std::move(frame.payload_));
   }
 }
 
-void RSocketStateMachine::sendKeepalive(std::unique_ptr<folly::IOBuf> data) {
-  sendKeepalive(FrameFlags::KEEPALIVE_RESPOND, std::move(data));
-}
+bool RSocketStateMachine::admitPeerStream(
+    FrameType frameType,
+    StreamId streamId) {
+  DCHECK(streamId != 0);
+  // TODO: comparing string versions is odd because from version
+  // 10.0 the lexicographic comparison doesn't work
+  // we should change the version to struct
+  if (frameSerializer_->protocolVersion() > ProtocolVersion{0, 0} &&
+      !streamsFactory_.registerNewPeerStreamId(
+          streamId, isNewStreamFrame(frameType))) {
+    return false;
+  }
 
-void RSocketStateMachine::sendKeepalive(
-    FrameFlags flags,
-    std::unique_ptr<folly::IOBuf> data) {
-  Frame_KEEPALIVE pingFrame(
-      flags, resumeManager_->impliedPosition(), std::move(data));
-  VLOG(3) << "Out: " << pingFrame;
-  outputFrameOrEnqueue(
-      frameSerializer_->serializeOut(std::move(pingFrame), isResumable_));
-  stats_->keepaliveSent();
-}
+  if (!isNewStreamFrame(frameType)) {
+    auto msg = folly::sformat(
+        "Unexpected frame {} for stream {}", toString(frameType), streamId);
+    VLOG(1) << msg;
+    closeWithError(Frame_ERROR::connectionError(std::move(msg)));
+    return false;
+  }
 
-bool RSocketStateMachine::isPositionAvailable(ResumePosition position) const {
-  return resumeManager_->isPositionAvailable(position);
-}
+  if (isDraining_) {
+    VLOG(2) << mode_ << " Rejecting " << toString(frameType) << " for stream "
+            << streamId << " while draining";
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::DRAINING);
+    }
+    return false;
+  }
 
-bool RSocketStateMachine::resumeFromPositionOrClose(
-    ResumePosition serverPosition,
-    ResumePosition clientPosition) {
-  DCHECK(!resumeCallback_);
-  DCHECK(!isDisconnected());
-  DCHECK(mode_ == RSocketMode::SERVER);
+  if (tooManyPeerStreams()) {
+    VLOG(2) << mode_ << " Rejecting " << toString(frameType) << " for stream "
+            << streamId << " past the stream limits";
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::TOO_MANY_STREAMS);
+    }
+    return false;
+  }
 
-  bool clientPositionExist = (clientPosition == kUnspecifiedResumePosition) ||
-      clientPosition <= resumeManager_->impliedPosition();
+  if (eventBaseLoad_ && eventBaseLoad_->overloaded) {
+    VLOG(2) << mode_ << " Rejecting " << toString(frameType) << " for stream "
+            << streamId << " while overloaded";
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::OVERLOADED);
+    }
+    return false;
+  }
 
-  if (clientPositionExist &&
-      resumeManager_->isPositionAvailable(serverPosition)) {
-    Frame_RESUME_OK resumeOkFrame(resumeManager_->impliedPosition());
-    VLOG(3) << "Out: " << resumeOkFrame;
-    frameTransport_->outputFrameOrDrop(
-        frameSerializer_->serializeOut(std::move(resumeOkFrame)));
-    resumeFromPosition(serverPosition);
-    return true;
+  if (memoryGovernor_ &&
+      memoryGovernor_->level() == MemoryGovernor::Level::REJECTING) {
+    VLOG(2) << mode_ << " Rejecting " << toString(frameType) << " for stream "
+            << streamId << " near the memory budget";
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::OUT_OF_MEMORY);
+    }
+    return false;
   }
 
-  auto message = folly::to<std::string>(
-      "Cannot resume server, client lastServerPosition=",
-      serverPosition,
-      " firstClientPosition=",
-      clientPosition,
-      " is not available. Last reset position is ",
-      resumeManager_->firstSentPosition());
+  if (responderLeaseEnabled_ && !responderLease_.tryAcquire()) {
+    VLOG(2) << mode_ << " Rejecting " << toString(frameType) << " for stream "
+            << streamId << " without a lease";
+    if (frameType != FrameType::REQUEST_FNF) {
+      rejectStream(streamId, Rejection::NO_LEASE);
+    }
+    return false;
+  }
 
-  closeWithError(Frame_ERROR::connectionError(std::move(message)));
-  return false;
+  return true;
 }
 
-void RSocketStateMachine::resumeFromPosition(ResumePosition position) {
-  DCHECK(!resumeCallback_);
-  DCHECK(!isDisconnected());
-  DCHECK(resumeManager_->isPositionAvailable(position));
-
-  if (connectionEvents_) {
-    connectionEvents_->onStreamsResumed();
-  }
-  resumeManager_->sendFramesFromPosition(position, *frameTransport_);
+void RSocketStateMachine::openPeerStream(
+    const FrameHeader& header,
+    uint32_t requestN,
+    Payload payload) {
+  auto streamId = header.streamId;
+  auto frameType = header.type;
+  auto saveStreamToken = [&](const Payload& request) {
+    if (coldResumeHandler_) {
+      auto streamType = getStreamType(frameType);
+      CHECK(streamType != StreamType::FNF);
+      auto streamToken = coldResumeHandler_->generateStreamToken(
+          request, streamId, streamType);
+      resumeManager_->onStreamOpen(
+          streamId, RequestOriginator::REMOTE, streamToken, streamType);
+    }
+  };
 
-  for (auto& frame : streamState_.moveOutputPendingFrames()) {
-    outputFrameOrEnqueue(std::move(frame));
-  }
+  // The responder drops the work the requester no longer waits for.
+  auto requestTimeout = [](const Payload& request) {
+    return request.metadata ? findRequestTimeout(*request.metadata)
+                            : folly::none;
+  };
+  auto armRequestTimeout =
+      [&](folly::Optional<std::chrono::milliseconds> timeout) {
+        // The responder might have terminated the stream already.
+        if (timeout && streamState_.streams_.find(streamId)) {
+          armStreamDeadline(streamId, *timeout);
+        }
+      };
 
-  if (!isDisconnected() && keepaliveTimer_) {
-    keepaliveTimer_->start(shared_from_this());
+  if (frameType == FrameType::REQUEST_CHANNEL) {
+    auto stateMachine =
+        streamsFactory_.createChannelResponder(requestN, streamId);
+    saveStreamToken(payload);
+    auto const timeout = requestTimeout(payload);
+    startStreamLatency(streamId, StreamType::CHANNEL, requestN);
+    startResponderTrace(streamId, StreamType::CHANNEL, payload);
+    startStreamStalls(
+        streamId,
+        StreamType::CHANNEL,
+        false,
+        requestN,
+        !!(header.flags & FrameFlags::COMPLETE));
+    auto requestSink = requestResponder_->handleRequestChannelCore(
+        std::move(payload), streamId, stateMachine);
+    stateMachine->subscribe(requestSink);
+    armRequestTimeout(timeout);
+  } else if (frameType == FrameType::REQUEST_STREAM) {
+    auto stateMachine =
+        streamsFactory_.createStreamResponder(requestN, streamId);
+    saveStreamToken(payload);
+    auto const timeout = requestTimeout(payload);
+    startStreamLatency(streamId, StreamType::STREAM, requestN);
+    startResponderTrace(streamId, StreamType::STREAM, payload);
+    startStreamStalls(streamId, StreamType::STREAM, false, requestN, false);
+    requestResponder_->handleRequestStreamCore(
+        std::move(payload), streamId, stateMachine);
+    armRequestTimeout(timeout);
+  } else if (frameType == FrameType::REQUEST_RESPONSE) {
+    auto stateMachine =
+        streamsFactory_.createRequestResponseResponder(streamId);
+    saveStreamToken(payload);
+    auto const timeout = requestTimeout(payload);
+    startStreamLatency(streamId, StreamType::REQUEST_RESPONSE, 1);
+    startResponderTrace(streamId, StreamType::REQUEST_RESPONSE, payload);
+    requestResponder_->handleRequestResponseCore(
+        std::move(payload), streamId, stateMachine);
+    armRequestTimeout(timeout);
+  } else if (frameType == FrameType::REQUEST_FNF) {
+    // no stream tracking is necessary
+    startStreamLatency(streamId, StreamType::FNF, 0);
+    if (batchingFireAndForget_) {
+      fireAndForgetBatch_.emplace_back(std::move(payload), streamId);
+      return;
+    }
+    requestResponder_->handleFireAndForget(std::move(payload), streamId);
   }
 }
 
-void RSocketStateMachine::outputFrameOrEnqueue(
-    std::unique_ptr<folly::IOBuf> frame) {
-  // if we are resuming we cant send any frames until we receive RESUME_OK
-  if (!isDisconnected() && !resumeCallback_) {
-    outputFrame(std::move(frame));
+namespace {
+/// Runs `func` with the connection of an end of a forwarded stream, on its
+/// EventBase, or with nullptr if the connection is gone or closed.
+void runOnForwardedEnd(
+    const ForwardedStream::End& end,
+    folly::Function<void(RSocketStateMachine*)> func) {
+  auto run = [ connection = end.connection, func = std::move(func) ]() mutable {
+    auto locked = connection.lock();
+    func(locked && !locked->isClosed() ? locked.get() : nullptr);
+  };
+  if (end.eventBase->isInEventBaseThread()) {
+    run();
   } else {
-    streamState_.enqueueOutputPendingFrame(std::move(frame));
+    end.eventBase->runInEventBaseThread(std::move(run));
   }
 }
 
-void RSocketStateMachine::fireAndForget(Payload request) {
-  auto const streamId = streamsFactory().getNextStreamId();
-  Frame_REQUEST_FNF frame{streamId, FrameFlags::EMPTY, std::move(request)};
-  outputFrameOrEnqueue(std::move(frame));
+/// Whether the frame is the last one of the stream, in either direction.
+bool endsForwardedStream(StreamType streamType, const FrameHeader& header) {
+  switch (header.type) {
+    case FrameType::CANCEL:
+    case FrameType::ERROR:
+      return true;
+    case FrameType::PAYLOAD:
+      return streamType == StreamType::REQUEST_RESPONSE ||
+          header.flagsComplete();
+    default:
+      return false;
+  }
 }
+} // namespace
 
-void RSocketStateMachine::metadataPush(std::unique_ptr<folly::IOBuf> metadata) {
-  Frame_METADATA_PUSH metadataPushFrame{std::move(metadata)};
-  outputFrameOrEnqueue(std::move(metadataPushFrame));
+bool RSocketStateMachine::canForwardStreams() const {
+  // The serializer, the resumability and the compression of a connection are
+  // set once it is connected.
+  return frameSerializer_ && frameSerializer_->protocolVersion().major >= 1 &&
+      !isResumable_ && compression_.codec == PayloadCompression::Codec::NONE;
 }
 
-void RSocketStateMachine::outputFrame(std::unique_ptr<folly::IOBuf> frame) {
-  DCHECK(!isDisconnected());
-
-  auto frameType = frameSerializer_->peekFrameType(*frame);
-  stats_->frameWritten(frameType);
-
-  if (isResumable_) {
-    auto streamIdPtr = frameSerializer_->peekStreamId(*frame);
-    CHECK(streamIdPtr) << "Error in serialized frame.";
-    resumeManager_->trackSentFrame(
-        *frame, frameType, *streamIdPtr, getConsumerAllowance(*streamIdPtr));
+bool RSocketStateMachine::forwardRequest(
+    FrameType frameType,
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf>& serializedFrame) {
+  if (!canForwardStreams()) {
+    return false;
+  }
+  auto metadata = frameSerializer_->peekRequestMetadata(*serializedFrame);
+  if (!metadata) {
+    return false;
+  }
+  auto const streamType = getStreamType(frameType);
+  auto requester =
+      requestResponder_->forwardRequest(streamType, *metadata, streamId);
+  if (!requester) {
+    return false;
+  }
+  auto const& target = requester->stateMachine_;
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase || !target->canForwardStreams() ||
+      target->frameSerializer_->protocolVersion() !=
+          frameSerializer_->protocolVersion()) {
+    VLOG(2) << mode_ << " Can't forward stream " << streamId
+            << ", handling it";
+    return false;
   }
-  frameTransport_->outputFrameOrDrop(std::move(frame));
-}
 
-uint32_t RSocketStateMachine::getKeepaliveTime() const {
-  return keepaliveTimer_
-      ? static_cast<uint32_t>(keepaliveTimer_->keepaliveTime().count())
-      : Frame_SETUP::kMaxKeepaliveTime;
+  VLOG(3) << mode_ << " Forwarding " << toString(frameType) << " of stream "
+          << streamId;
+  auto stream = std::make_shared<ForwardedStream>(
+      streamType,
+      ForwardedStream::End{shared_from_this(), eventBase, streamId},
+      ForwardedStream::End{target, &requester->eventBase_, 0});
+  forwardedStreams_.emplace(streamId, stream);
+  runOnForwardedEnd(
+      stream->requester,
+      [ stream, request = std::move(serializedFrame) ](
+          RSocketStateMachine* connection) mutable {
+        if (connection) {
+          connection->startForwardedStream(
+              std::move(stream), std::move(request));
+        } else {
+          runOnForwardedEnd(
+              stream->responder, [stream](RSocketStateMachine* responder) {
+                if (responder) {
+                  responder->abortForwardedStream(*stream, false);
+                }
+              });
+        }
+      });
+  return true;
 }
 
-bool RSocketStateMachine::isDisconnected() const {
-  return !frameTransport_;
+void RSocketStateMachine::startForwardedStream(
+    std::shared_ptr<ForwardedStream> stream,
+    std::unique_ptr<folly::IOBuf> request) {
+  auto const streamId = streamsFactory_.getNextStreamId();
+  stream->requester.streamId = streamId;
+  VLOG(3) << mode_ << " Forwarded stream " << stream->responder.streamId
+          << " to stream " << streamId;
+  forwardedStreams_.emplace(streamId, std::move(stream));
+  outputFrameOrEnqueue(
+      frameSerializer_->withStreamId(std::move(request), streamId));
 }
 
-bool RSocketStateMachine::isClosed() const {
+void RSocketStateMachine::forwardStreamFrame(
+    const FrameHeader& header,
+    std::shared_ptr<ForwardedStream> stream,
+    std::unique_ptr<folly::IOBuf> frame) {
+  switch (header.type) {
+    case FrameType::REQUEST_N:
+    case FrameType::CANCEL:
+    case FrameType::PAYLOAD:
+    case FrameType::ERROR:
+      break;
+    default: {
+      auto msg = folly::sformat(
+          "Unexpected {} frame for forwarded stream {}",
+          toString(header.type),
+          header.streamId);
+      closeWithError(Frame_ERROR::connectionError(std::move(msg)));
+      return;
+    }
+  }
+
+  VLOG(3) << mode_ << " Forwarding " << header;
+  if (endsForwardedStream(stream->type, header)) {
+    forwardedStreams_.erase(header.streamId);
+  }
+  // The frames read for one end are written by the other.
+  auto const toRequester = !streamsFactory_.isLocalStreamId(header.streamId);
+  auto& other = toRequester ? stream->requester : stream->responder;
+  runOnForwardedEnd(
+      other,
+      [ stream, toRequester, header, frame = std::move(frame) ](
+          RSocketStateMachine* connection) mutable {
+        if (connection) {
+          connection->writeForwardedFrame(
+              *stream, toRequester, header, std::move(frame));
+        }
+      });
+}
+
+void RSocketStateMachine::writeForwardedFrame(
+    const ForwardedStream& stream,
+    bool requesterEnd,
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto const streamId =
+      requesterEnd ? stream.requester.streamId : stream.responder.streamId;
+  auto it = forwardedStreams_.find(streamId);
+  if (it == forwardedStreams_.end() || it->second.get() != &stream) {
+    // This end already ended.
+    return;
+  }
+  if (endsForwardedStream(stream.type, header)) {
+    forwardedStreams_.erase(it);
+  }
+  outputFrameOrEnqueue(
+      frameSerializer_->withStreamId(std::move(frame), streamId));
+}
+
+void RSocketStateMachine::abortForwardedStream(
+    const ForwardedStream& stream,
+    bool requesterEnd) {
+  auto const streamId =
+      requesterEnd ? stream.requester.streamId : stream.responder.streamId;
+  auto it = forwardedStreams_.find(streamId);
+  if (it == forwardedStreams_.end() || it->second.get() != &stream) {
+    return;
+  }
+  forwardedStreams_.erase(it);
+  if (requesterEnd) {
+    outputFrameOrEnqueue(Frame_CANCEL(streamId));
+  } else {
+    outputFrameOrEnqueue(Frame_ERROR::applicationError(
+        streamId, "Connection of the forwarded stream closed"));
+  }
+}
+
+void RSocketStateMachine::closeForwardedStreams() {
+  for (auto& entry : std::exchange(forwardedStreams_, {})) {
+    auto stream = std::move(entry.second);
+    auto const requesterEnd = streamsFactory_.isLocalStreamId(entry.first);
+    runOnForwardedEnd(
+        requesterEnd ? stream->responder : stream->requester,
+        [stream, requesterEnd](RSocketStateMachine* connection) {
+          if (connection) {
+            connection->abortForwardedStream(*stream, !requesterEnd);
+          }
+        });
+  }
+}
+
+bool RSocketStateMachine::handleLazyRequest(
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf>& serializedFrame) {
+  // Cold resumption tokens and traces are built from a Payload.
+  if (coldResumeHandler_ || traceEvery_ > 0 ||
+      !requestResponder_->handlesLazyPayloads()) {
+    return false;
+  }
+  FrameHeader header;
+  uint32_t requestN;
+  auto layout =
+      frameSerializer_->peekRequestPayload(*serializedFrame, header, requestN);
+  // malformed frames are reported when they are deserialized
+  if (!layout || !!(header.flags & FrameFlags::COMPRESSED)) {
+    return false;
+  }
+
+  VLOG(3) << mode_ << " In: " << header << " with a lazy payload";
+  LazyPayload request(std::move(serializedFrame), *layout);
+  auto const timeout = request.hasMetadata()
+      ? findRequestTimeout(request.metadataView())
+      : folly::none;
+  if (header.type == FrameType::REQUEST_STREAM) {
+    auto stateMachine =
+        streamsFactory_.createStreamResponder(requestN, streamId);
+    startStreamLatency(streamId, StreamType::STREAM, requestN);
+    startStreamStalls(streamId, StreamType::STREAM, false, requestN, false);
+    requestResponder_->handleRequestStreamCore(
+        std::move(request), streamId, stateMachine);
+  } else {
+    auto stateMachine =
+        streamsFactory_.createRequestResponseResponder(streamId);
+    startStreamLatency(streamId, StreamType::REQUEST_RESPONSE, 1);
+    requestResponder_->handleRequestResponseCore(
+        std::move(request), streamId, stateMachine);
+  }
+  // The responder might have terminated the stream already.
+  if (timeout && streamState_.streams_.find(streamId)) {
+    armStreamDeadline(streamId, *timeout);
+  }
+  return true;
+}
+
+bool RSocketStateMachine::respondSerialized(
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf>& serializedFrame) {
+  // Cold resumption tokens and traces are built from a stream.
+  if (coldResumeHandler_ || traceEvery_ > 0 ||
+      !requestResponder_->servesSerializedResponses()) {
+    return false;
+  }
+  FrameHeader header;
+  uint32_t requestN;
+  auto layout =
+      frameSerializer_->peekRequestPayload(*serializedFrame, header, requestN);
+  // malformed frames are reported when they are deserialized
+  if (!layout || !!(header.flags & FrameFlags::COMPRESSED)) {
+    return false;
+  }
+
+  LazyPayload request(std::move(serializedFrame), *layout);
+  auto response = requestResponder_->serializedResponse(request, streamId);
+  if (!response) {
+    serializedFrame = std::move(request).moveFrame();
+    return false;
+  }
+
+  VLOG(3) << mode_ << " In: " << header << " with a serialized response";
+  if (frameSerializerV1_0_ && !shouldFragment(response->payload())) {
+    outputFrameOrEnqueue(
+        frameSerializerV1_0_->cloneWithStreamId(response->frame(), streamId));
+  } else {
+    writePayload(Frame_PAYLOAD(
+        streamId,
+        FrameFlags::NEXT | FrameFlags::COMPLETE,
+        response->payload().clone()));
+  }
+  return true;
+}
+
+bool RSocketStateMachine::acceptRequest(
+    FrameType frameType,
+    StreamId streamId,
+    const folly::IOBuf& serializedFrame) {
+  auto metadata = frameSerializer_->peekRequestMetadata(serializedFrame);
+  if (!metadata) {
+    // malformed frames are reported when they are deserialized
+    return true;
+  }
+  return acceptRequest(frameType, streamId, *metadata);
+}
+
+bool RSocketStateMachine::acceptRequest(
+    FrameType frameType,
+    StreamId streamId,
+    const MetadataView& metadata) {
+  return requestResponder_->acceptRequest(
+      getStreamType(frameType), metadata, streamId);
+}
+
+void RSocketStateMachine::sendKeepalive(std::unique_ptr<folly::IOBuf> data) {
+  // The answers don't tell which keepalive they answer, the first one is
+  // taken to answer the oldest.
+  if (!keepaliveSentAt_) {
+    keepaliveSentAt_ = std::chrono::steady_clock::now();
+  }
+  sendKeepalive(FrameFlags::KEEPALIVE_RESPOND, std::move(data));
+}
+
+folly::Future<folly::Unit> RSocketStateMachine::ping() {
+  DCHECK(mode_ == RSocketMode::CLIENT);
+  if (isDisconnected()) {
+    return folly::makeFuture<folly::Unit>(
+        ConnectionException("Not connected"));
+  }
+  pings_.emplace_back();
+  auto future = pings_.back().getFuture();
+  sendKeepalive(folly::IOBuf::create(0));
+  return future;
+}
+
+void RSocketStateMachine::sendKeepalive(
+    FrameFlags flags,
+    std::unique_ptr<folly::IOBuf> data) {
+  ackedPosition_ = resumeManager_->impliedPosition();
+  RSOCKET_TRACE(
+      keepalive_sent,
+      this,
+      static_cast<int>(mode_),
+      static_cast<int>(flags),
+      data ? data->computeChainDataLength() : 0);
+  Frame_KEEPALIVE pingFrame(flags, ackedPosition_, std::move(data));
+  VLOG(3) << "Out: " << pingFrame;
+  outputFrameOrEnqueue(
+      frameSerializer_->serializeOut(std::move(pingFrame), isResumable_));
+  stats_->keepaliveSent();
+}
+
+void RSocketStateMachine::sendLease() {
+  DCHECK(leaseSender_);
+  if (isDraining_) {
+    // Requests are rejected from now on, stop leasing.
+    return;
+  }
+  auto lease = leaseSender_->nextLease(streamState_.streams_.size());
+  auto ttl = std::min(
+      std::max(lease.ttl, std::chrono::milliseconds(1)),
+      std::chrono::milliseconds(Frame_LEASE::kMaxTtl));
+  auto numberOfRequests =
+      std::min(lease.numberOfRequests, Frame_LEASE::kMaxNumRequests);
+  if (eventBaseLoad_ && eventBaseLoad_->overloaded) {
+    // No requests are granted until the next lease.
+    numberOfRequests = 0;
+  }
+  responderLease_.update(ttl, numberOfRequests);
+
+  if (numberOfRequests > 0 && !isDisconnected()) {
+    outputFrameOrEnqueue(
+        Frame_LEASE(static_cast<uint32_t>(ttl.count()), numberOfRequests));
+  }
+
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  eventBase->runAfterDelay(
+      [weakSelf = std::move(weakSelf)] {
+        auto self = weakSelf.lock();
+        if (self && !self->isClosed()) {
+          self->sendLease();
+        }
+      },
+      static_cast<uint32_t>(ttl.count()));
+}
+
+void RSocketStateMachine::scheduleHibernationCheck() {
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  eventBase->runAfterDelay(
+      [weakSelf = std::move(weakSelf)] {
+        auto self = weakSelf.lock();
+        if (self && !self->isClosed()) {
+          self->checkHibernation();
+        }
+      },
+      static_cast<uint32_t>(hibernateAfter_.count()));
+}
+
+void RSocketStateMachine::checkHibernation() {
+  if (activeFrames_ != activeFramesChecked_) {
+    activeFramesChecked_ = activeFrames_;
+    isHibernating_ = false;
+  } else if (!isHibernating_) {
+    isHibernating_ = true;
+    hibernate();
+  }
+  scheduleHibernationCheck();
+}
+
+void RSocketStateMachine::hibernate() {
+  VLOG(3) << mode_ << " Releasing the buffers of the idle connection";
+  if (frameTransport_) {
+    frameTransport_->releaseBuffers();
+  }
+  streamState_.releaseBuffers();
+  if (isResumable_ && resumeManager_) {
+    resumeManager_->releaseBuffers();
+  }
+  receivedFrames_.shrink_to_fit();
+}
+
+void RSocketStateMachine::drain(
+    std::chrono::milliseconds timeout,
+    folly::Function<void()> onClosed) {
+  if (isClosed()) {
+    onClosed();
+    return;
+  }
+
+  onDrained_ = std::move(onClosed);
+  if (isDraining_) {
+    return;
+  }
+  isDraining_ = true;
+
+  if (streamState_.streams_.empty()) {
+    scheduleCloseDrained();
+    return;
+  }
+
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  eventBase->runAfterDelay(
+      [weakSelf = std::move(weakSelf)] {
+        auto self = weakSelf.lock();
+        if (self && !self->isClosed()) {
+          VLOG(2) << self->mode_ << " Closing connection with "
+                  << self->streamState_.streams_.size()
+                  << " streams left after draining";
+          self->closeWithError(
+              Frame_ERROR::connectionError("Connection closed after draining"));
+        }
+      },
+      static_cast<uint32_t>(timeout.count()));
+}
+
+void RSocketStateMachine::scheduleCloseDrained() {
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  // Don't close from within the stream which just terminated.
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  eventBase->runInLoop(
+      [weakSelf = std::move(weakSelf)] {
+        auto self = weakSelf.lock();
+        if (self && !self->isClosed()) {
+          self->closeWithError(
+              Frame_ERROR::connectionError("Connection closed after draining"));
+        }
+      },
+      true /* thisIteration */);
+}
+
+bool RSocketStateMachine::isPositionAvailable(ResumePosition position) const {
+  return resumeManager_->isPositionAvailable(position);
+}
+
+bool RSocketStateMachine::resumeFromPositionOrClose(
+    ResumePosition serverPosition,
+    ResumePosition clientPosition) {
+  DCHECK(!resumeCallback_);
+  DCHECK(!isDisconnected());
+  DCHECK(mode_ == RSocketMode::SERVER);
+
+  bool clientPositionExist = (clientPosition == kUnspecifiedResumePosition) ||
+      clientPosition <= resumeManager_->impliedPosition();
+
+  if (clientPositionExist &&
+      resumeManager_->isPositionAvailable(serverPosition)) {
+    Frame_RESUME_OK resumeOkFrame(resumeManager_->impliedPosition());
+    VLOG(3) << "Out: " << resumeOkFrame;
+    frameTransport_->outputFrameOrDrop(
+        frameSerializer_->serializeOut(std::move(resumeOkFrame)));
+    resumeFromPosition(serverPosition);
+    return true;
+  }
+
+  auto message = folly::to<std::string>(
+      "Cannot resume server, client lastServerPosition=",
+      serverPosition,
+      " firstClientPosition=",
+      clientPosition,
+      " is not available. Last reset position is ",
+      resumeManager_->firstSentPosition());
+
+  closeWithError(Frame_ERROR::connectionError(std::move(message)));
+  return false;
+}
+
+void RSocketStateMachine::resumeFromPosition(ResumePosition position) {
+  DCHECK(!resumeCallback_);
+  DCHECK(!isDisconnected());
+  DCHECK(resumeManager_->isPositionAvailable(position));
+
+  if (connectionEvents_) {
+    connectionEvents_->onStreamsResumed();
+  }
+  // The buffered frames are replayed a batch at a time, the frames produced
+  // meanwhile are held until all of them were sent.
+  isReplaying_ = true;
+  replayPosition_ = position;
+  sendPendingFramesWhileWritable();
+  notifyStreamsWritability();
+
+  if (!isDisconnected() && keepaliveTimer_) {
+    keepaliveTimer_->start(shared_from_this());
+  }
+}
+
+void RSocketStateMachine::replayFrames() {
+  DCHECK(isReplaying_);
+  size_t replayed = 0;
+  while (isWritable_ && !isDisconnected()) {
+    if (replayPosition_ == resumeManager_->lastSentPosition()) {
+      isReplaying_ = false;
+      return;
+    }
+    if (replayed >= kReplayBytesPerLoop) {
+      scheduleReplay();
+      return;
+    }
+    auto const next = resumeManager_->replayFramesFromPosition(
+        replayPosition_, *frameTransport_, kReplayBatchBytes);
+    replayed += static_cast<size_t>(next - replayPosition_);
+    replayPosition_ = next;
+  }
+  // Continues once the transport is writable again, or from the position the
+  // peer asks for when it resumes again.
+}
+
+void RSocketStateMachine::scheduleReplay() {
+  if (replayScheduled_) {
+    return;
+  }
+  replayScheduled_ = true;
+  auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  CHECK(eventBase);
+  std::weak_ptr<RSocketStateMachine> weakSelf = shared_from_this();
+  eventBase->runInLoop([weakSelf = std::move(weakSelf)] {
+    auto self = weakSelf.lock();
+    if (!self) {
+      return;
+    }
+    self->replayScheduled_ = false;
+    if (self->isReplaying_ && !self->isDisconnected()) {
+      self->sendPendingFramesWhileWritable();
+      self->notifyStreamsWritability();
+    }
+  });
+}
+
+void RSocketStateMachine::outputFrameOrEnqueue(
+    std::unique_ptr<folly::IOBuf> frame) {
+  CpuAccount::Scope cpuScope(cpu_);
+  // if we are resuming we cant send any frames until we receive RESUME_OK, nor
+  // until the frames buffered for resumption were replayed, and while the
+  // transport is buffering the frames wait in their priority order
+  if (writesFrames()) {
+    outputFrame(std::move(frame));
+  } else {
+    auto header = peekFrameHeader(*frame);
+    CHECK(header) << "Error in serialized frame.";
+    auto const streamId = header->streamId;
+    if (skipsBacklog(*header)) {
+      // Only the transport's own buffer is ahead of it.
+      outputFrame(std::move(frame));
+      checkMemoryUsage();
+      return;
+    }
+    auto const& limits = streamState_.pendingFrameLimits();
+    if (limits.policy == PendingFrameLimits::Policy::DROP_OLDEST_STREAM &&
+        streamId != 0 && !dropOldestPendingStreams(streamId)) {
+      return;
+    }
+    auto const wasFull = streamState_.isOutputPendingFull();
+    streamState_.enqueueOutputPendingFrame(std::move(frame), streamId);
+    if (!wasFull && rejectsNewStreams()) {
+      // Pause the publishers until the frames have been written.
+      notifyStreamsWritability();
+    }
+  }
+  checkMemoryUsage();
+}
+
+bool RSocketStateMachine::skipsBacklog(const FrameHeader& header) const {
+  if (header.streamId != 0 || isDisconnected() || resumeCallback_) {
+    return false;
+  }
+  switch (header.type) {
+    case FrameType::KEEPALIVE:
+    case FrameType::ERROR:
+    case FrameType::LEASE:
+    case FrameType::RESUME_OK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void RSocketStateMachine::outputFramesOrEnqueue(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  CpuAccount::Scope cpuScope(cpu_);
+  if (writesFrames()) {
+    outputFrames(std::move(frames));
+    checkMemoryUsage();
+    return;
+  }
+  for (auto& frame : frames) {
+    outputFrameOrEnqueue(std::move(frame));
+  }
+}
+
+bool RSocketStateMachine::dropOldestPendingStreams(StreamId streamId) {
+  std::vector<StreamId> dropped;
+  while (streamState_.isOutputPendingFull()) {
+    auto const oldest = streamState_.dropOldestOutputPendingStream();
+    if (oldest == 0) {
+      break;
+    }
+    VLOG(3) << mode_ << " Dropping the pending frames of stream " << oldest;
+    dropped.push_back(oldest);
+    // The frame terminating the stream gets past the limits, as it is the
+    // last one of the stream.  It is queued with the connection frames, so
+    // that it isn't taken for a stream with pending frames.
+    auto terminal = streamsFactory_.isLocalStreamId(oldest)
+        ? frameSerializer_->serializeOut(Frame_CANCEL(oldest))
+        : frameSerializer_->serializeOut(Frame_ERROR::canceled(
+              oldest, "Pending frame buffer is full"));
+    streamState_.enqueueOutputPendingFrame(std::move(terminal));
+  }
+
+  // Ending the streams can call into the application, which can write more
+  // frames, so it is done once the pending frames are consistent.
+  for (auto id : dropped) {
+    endStream(id, StreamCompletionSignal::ERROR);
+  }
+  return std::find(dropped.begin(), dropped.end(), streamId) == dropped.end();
+}
+
+bool RSocketStateMachine::acquireLease() {
+  return !requesterLeaseEnabled_ || requesterLease_.tryAcquire();
+}
+
+void RSocketStateMachine::fireAndForget(Payload request) {
+  if (dropsFireAndForget()) {
+    VLOG(3) << mode_ << " Dropping a fire-and-forget, the output is backed up";
+    stats_->fireAndForgetDropped();
+    return;
+  }
+  auto const streamId = streamsFactory().getNextStreamId();
+  writeNewStream(
+      streamId, StreamType::FNF, 0, std::move(request), false /*completed*/);
+}
+
+void RSocketStateMachine::fireAndForgetBatch(std::vector<Payload> requests) {
+  if (dropsFireAndForget()) {
+    VLOG(3) << mode_ << " Dropping " << requests.size()
+            << " fire-and-forgets, the output is backed up";
+    for (size_t i = 0; i < requests.size(); ++i) {
+      stats_->fireAndForgetDropped();
+    }
+    return;
+  }
+  auto streamId = streamsFactory().getNextStreamIds(requests.size());
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  frames.reserve(requests.size());
+  for (auto& request : requests) {
+    if (shouldFragment(request)) {
+      // keep the frames in stream id order
+      outputFramesOrEnqueue(std::move(frames));
+      frames.clear();
+      writeNewStream(streamId, StreamType::FNF, 0, std::move(request), false);
+    } else {
+      auto const flags = compressPayload(request);
+      Frame_REQUEST_FNF frame(streamId, flags, std::move(request));
+      VLOG(3) << mode_ << " Out: " << frame;
+      frames.push_back(withFrameSerializer([&](auto& serializer) {
+        return serializer.serializeOut(std::move(frame));
+      }));
+    }
+    streamId += 2;
+  }
+  outputFramesOrEnqueue(std::move(frames));
+}
+
+void RSocketStateMachine::metadataPush(std::unique_ptr<folly::IOBuf> metadata) {
+  Frame_METADATA_PUSH metadataPushFrame{std::move(metadata)};
+  outputFrameOrEnqueue(std::move(metadataPushFrame));
+}
+
+void RSocketStateMachine::metadataPushLatest(
+    std::unique_ptr<folly::IOBuf> metadata,
+    const std::string& key) {
+  Frame_METADATA_PUSH metadataPushFrame{std::move(metadata)};
+  if (writesFrames()) {
+    outputFrameOrEnqueue(std::move(metadataPushFrame));
+    return;
+  }
+  CpuAccount::Scope cpuScope(cpu_);
+  VLOG(3) << mode_ << " Out (latest of " << key << "): " << metadataPushFrame;
+  auto frame = withFrameSerializer([&](auto& serializer) {
+    return serializer.serializeOut(std::move(metadataPushFrame));
+  });
+  auto const wasFull = streamState_.isOutputPendingFull();
+  streamState_.enqueueOutputPendingMetadataPush(std::move(frame), key);
+  if (!wasFull && rejectsNewStreams()) {
+    notifyStreamsWritability();
+  }
+  checkMemoryUsage();
+}
+
+void RSocketStateMachine::metadataPushSerialized(
+    std::unique_ptr<folly::IOBuf> frame) {
+  DCHECK(frameSerializer_);
+  outputFrameOrEnqueue(std::move(frame));
+}
+
+folly::Optional<ProtocolVersion> RSocketStateMachine::protocolVersion() const {
+  if (!frameSerializer_) {
+    return folly::none;
+  }
+  return frameSerializer_->protocolVersion();
+}
+
+void RSocketStateMachine::outputFrame(std::unique_ptr<folly::IOBuf> frame) {
+  DCHECK(!isDisconnected());
+  onFrameWritten(*frame);
+  frameTransport_->outputFrameOrDrop(std::move(frame));
+}
+
+void RSocketStateMachine::outputFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  DCHECK(!isDisconnected());
+  if (frames.empty()) {
+    return;
+  }
+  for (auto& frame : frames) {
+    onFrameWritten(*frame);
+  }
+  frameTransport_->outputFramesOrDrop(std::move(frames));
+}
+
+void RSocketStateMachine::onFrameWritten(const folly::IOBuf& frame) {
+  auto header = peekFrameHeader(frame);
+  CHECK(header) << "Error in serialized frame.";
+  auto const frameLength = frame.computeChainDataLength();
+  if (reportFrameSizes_) {
+    stats_->frameWrittenBytes(header->type, frameLength);
+  } else {
+    stats_->frameWritten(header->type);
+  }
+  RSOCKET_TRACE(
+      frame_written,
+      this,
+      static_cast<int>(mode_),
+      header->streamId,
+      static_cast<int>(header->type),
+      frameLength);
+  FlightRecorder::recordWritten(
+      this, header->streamId, header->type, header->flags, frameLength);
+  bytesWritten_ += frameLength;
+  if (header->type != FrameType::KEEPALIVE) {
+    ++activeFrames_;
+  }
+  if (isResumable_) {
+    resumeManager_->trackSentFrame(
+        frame,
+        frameLength,
+        header->type,
+        header->streamId,
+        getConsumerAllowance(header->streamId));
+  }
+}
+
+uint32_t RSocketStateMachine::getKeepaliveTime() const {
+  return keepaliveTimer_
+      ? static_cast<uint32_t>(keepaliveTimer_->keepaliveTime().count())
+      : Frame_SETUP::kMaxKeepaliveTime;
+}
+
+bool RSocketStateMachine::isDisconnected() const {
+  return !frameTransport_;
+}
+
+bool RSocketStateMachine::isClosed() const {
   return isClosed_;
 }
 
+bool RSocketStateMachine::isAbandoned(std::chrono::milliseconds timeout) const {
+  return isClosed_ || !isResumable_ ||
+      (isDisconnected() &&
+       std::chrono::steady_clock::now() - disconnectedAt_ >= timeout);
+}
+
 void RSocketStateMachine::setFrameSerializer(
     std::unique_ptr<FrameSerializer> frameSerializer) {
   CHECK(frameSerializer);
   // serializer is not interchangeable, it would screw up resumability
   // CHECK(!frameSerializer_);
   frameSerializer_ = std::move(frameSerializer);
+  for (auto& frame : rejectionFrames_) {
+    frame = nullptr;
+  }
+  frameSerializerV1_0_ =
+      dynamic_cast<FrameSerializerV1_0*>(frameSerializer_.get());
+}
+
+void RSocketStateMachine::rejectStream(StreamId streamId, Rejection rejection) {
+  auto& frame = rejectionFrames_[static_cast<size_t>(rejection)];
+  if (!frame) {
+    auto message = [rejection] {
+      switch (rejection) {
+        case Rejection::DRAINING:
+          return "Connection is draining";
+        case Rejection::OVERLOADED:
+          return "Server overloaded";
+        case Rejection::NO_LEASE:
+          return "No lease available";
+        case Rejection::REJECTED:
+          return "Request rejected";
+        case Rejection::TOO_MANY_STREAMS:
+          return "Too many concurrent streams";
+        case Rejection::OUT_OF_MEMORY:
+          return "Server out of memory";
+      }
+      return "Request rejected";
+    }();
+    frame = frameSerializer_->serializeOut(
+        Frame_ERROR::rejected(streamId, message));
+  }
+  VLOG(3) << mode_ << " Out: ERROR rejecting stream " << streamId;
+  outputFrameOrEnqueue(frameSerializer_->cloneWithStreamId(*frame, streamId));
 }
 
 void RSocketStateMachine::writeNewStream(
@@ -915,45 +2856,462 @@ void RSocketStateMachine::writeNewStream(
         streamId, RequestOriginator::LOCAL, streamToken, streamType);
   }
 
+  auto deadline = streamDeadlines_.find(streamId);
+  if (deadline != streamDeadlines_.end() && streamType != StreamType::FNF) {
+    if (deadline->second.propagate) {
+      addRequestTimeout(payload, deadline->second.timeout);
+    }
+    armStreamDeadline(streamId, deadline->second.timeout);
+  }
+
+  if (!streamTraces_.empty()) {
+    auto trace = streamTraces_.find(streamId);
+    if (trace != streamTraces_.end()) {
+      if (trace->second.propagate) {
+        addTraceContext(payload, trace->second.span.context);
+      }
+      trace->second.span.streamType = streamType;
+      trace->second.span.start = Clock::now();
+      trace->second.started = true;
+    }
+  }
+  startStreamStalls(streamId, streamType, true, initialRequestN, completed);
+
+  // Compressed whole, the fragments are decompressed once reassembled.
+  auto flags = compressPayload(payload);
+  std::vector<Payload> fragments;
+  if (shouldFragment(payload)) {
+    fragments = fragmentPayload(std::move(payload), mtu_);
+    payload = std::move(fragments.front());
+    flags |= FrameFlags::FOLLOWS;
+  }
+
   switch (streamType) {
     case StreamType::CHANNEL:
       outputFrameOrEnqueue(Frame_REQUEST_CHANNEL(
           streamId,
-          completed ? FrameFlags::COMPLETE : FrameFlags::EMPTY,
+          (completed ? FrameFlags::COMPLETE : FrameFlags::EMPTY) | flags,
           initialRequestN,
           std::move(payload)));
       break;
 
     case StreamType::STREAM:
       outputFrameOrEnqueue(Frame_REQUEST_STREAM(
-          streamId, FrameFlags::EMPTY, initialRequestN, std::move(payload)));
+          streamId, flags, initialRequestN, std::move(payload)));
       break;
 
     case StreamType::REQUEST_RESPONSE:
-      outputFrameOrEnqueue(Frame_REQUEST_RESPONSE(
-          streamId, FrameFlags::EMPTY, std::move(payload)));
+      outputFrameOrEnqueue(
+          Frame_REQUEST_RESPONSE(streamId, flags, std::move(payload)));
       break;
 
     case StreamType::FNF:
       outputFrameOrEnqueue(
-          Frame_REQUEST_FNF(streamId, FrameFlags::EMPTY, std::move(payload)));
+          Frame_REQUEST_FNF(streamId, flags, std::move(payload)));
       break;
 
     default:
       CHECK(false); // unknown type
   }
+
+  writeFragments(streamId, std::move(fragments), FrameFlags::NEXT);
 }
 
 void RSocketStateMachine::writeRequestN(Frame_REQUEST_N&& frame) {
+  streamAllowanceAdded(
+      frame.header_.streamId,
+      RSocketStats::StallDirection::RECEIVE,
+      frame.requestN_);
   outputFrameOrEnqueue(std::move(frame));
 }
 
 void RSocketStateMachine::writeCancel(Frame_CANCEL&& frame) {
+  if (cancelBatch_) {
+    VLOG(3) << mode_ << " Out: " << frame;
+    cancelBatch_->push_back(withFrameSerializer([&](auto& serializer) {
+      return serializer.serializeOut(std::move(frame));
+    }));
+    return;
+  }
   outputFrameOrEnqueue(std::move(frame));
 }
 
 void RSocketStateMachine::writePayload(Frame_PAYLOAD&& frame) {
-  outputFrameOrEnqueue(std::move(frame));
+  CpuAccount::Scope cpuScope(cpu_);
+  if (!!(frame.header_.flags & FrameFlags::NEXT)) {
+    streamPayloadWritten(
+        frame.header_.streamId, frame.header_.flagsComplete());
+  }
+  auto const compressed = compressPayload(frame.payload_);
+  if (!shouldFragment(frame.payload_)) {
+    frame.header_.flags |= compressed;
+    outputFrameOrEnqueue(std::move(frame));
+    return;
+  }
+
+  auto const streamId = frame.header_.streamId;
+  auto const flags =
+      frame.header_.flags & (FrameFlags::COMPLETE | FrameFlags::NEXT);
+  auto fragments = fragmentPayload(std::move(frame.payload_), mtu_);
+  outputFrameOrEnqueue(Frame_PAYLOAD(
+      streamId,
+      (flags & FrameFlags::NEXT) | FrameFlags::FOLLOWS | compressed,
+      std::move(fragments.front())));
+  writeFragments(streamId, std::move(fragments), flags);
+}
+
+void RSocketStateMachine::writePayloads(std::vector<Frame_PAYLOAD> frames) {
+  CpuAccount::Scope cpuScope(cpu_);
+  // The frames which don't need to be fragmented are serialized and handed to
+  // the transport together, the others are written as they come so that the
+  // order of the frames is kept.
+  std::vector<std::unique_ptr<folly::IOBuf>> serialized;
+  serialized.reserve(frames.size());
+  for (auto& frame : frames) {
+    if (shouldFragment(frame.payload_)) {
+      outputFramesOrEnqueue(std::move(serialized));
+      serialized.clear();
+      writePayload(std::move(frame));
+      continue;
+    }
+    if (!!(frame.header_.flags & FrameFlags::NEXT)) {
+      streamPayloadWritten(
+          frame.header_.streamId, frame.header_.flagsComplete());
+    }
+    frame.header_.flags |= compressPayload(frame.payload_);
+    VLOG(3) << mode_ << " Out: " << frame;
+    serialized.push_back(withFrameSerializer([&](auto& serializer) {
+      return serializer.serializeOut(std::move(frame));
+    }));
+  }
+  outputFramesOrEnqueue(std::move(serialized));
+}
+
+std::unique_ptr<folly::IOBuf> RSocketStateMachine::serializePayload(
+    Frame_PAYLOAD& frame) {
+  if (shouldFragment(frame.payload_)) {
+    return nullptr;
+  }
+  CpuAccount::Scope cpuScope(cpu_);
+  frame.header_.flags |= compressPayload(frame.payload_);
+  VLOG(3) << mode_ << " Out: " << frame;
+  return withFrameSerializer([&](auto& serializer) {
+    return serializer.serializeOut(std::move(frame));
+  });
+}
+
+void RSocketStateMachine::writeSerializedPayloads(
+    StreamId streamId,
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  CpuAccount::Scope cpuScope(cpu_);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    streamPayloadWritten(streamId, false);
+  }
+  outputFramesOrEnqueue(std::move(frames));
+}
+
+void RSocketStateMachine::writeFragments(
+    StreamId streamId,
+    std::vector<Payload> fragments,
+    FrameFlags lastFlags) {
+  for (size_t i = 1; i < fragments.size(); ++i) {
+    auto const flags = i + 1 == fragments.size()
+        ? lastFlags
+        : FrameFlags::NEXT | FrameFlags::FOLLOWS;
+    outputFrameOrEnqueue(
+        Frame_PAYLOAD(streamId, flags, std::move(fragments[i])));
+  }
+}
+
+FrameFlags RSocketStateMachine::compressPayloadSlow(Payload& payload) {
+  return rsocket::compressPayload(payload, compression_)
+      ? FrameFlags::COMPRESSED
+      : FrameFlags::EMPTY;
+}
+
+bool RSocketStateMachine::decompressFrameSlow(
+    FrameHeader& header,
+    Payload& payload) {
+  try {
+    rsocket::decompressPayload(payload, compression_, maxFrameLength_);
+  } catch (const std::exception& ex) {
+    failStreamFrame(
+        header,
+        folly::sformat(
+            "Cannot decompress payload: {}", folly::exceptionStr(ex)));
+    return false;
+  }
+  header.flags &= ~FrameFlags::COMPRESSED;
+  return true;
+}
+
+void RSocketStateMachine::failStreamFrame(
+    const FrameHeader& header,
+    std::string message) {
+  auto streamId = header.streamId;
+  VLOG(1) << mode_ << " Failing stream " << streamId << ": " << message;
+  if (header.type != FrameType::PAYLOAD) {
+    // the request of a stream which isn't open yet
+    if (header.type != FrameType::REQUEST_FNF) {
+      outputFrameOrEnqueue(Frame_ERROR::invalid(streamId, std::move(message)));
+    }
+    return;
+  }
+  auto stream = streamState_.streams_.find(streamId);
+  if (!stream) {
+    return;
+  }
+  // Keep the stream alive while it terminates.
+  auto stateMachine = *stream;
+  if (streamsFactory_.isLocalStreamId(streamId)) {
+    outputFrameOrEnqueue(Frame_CANCEL(streamId));
+  } else {
+    outputFrameOrEnqueue(Frame_ERROR::invalid(streamId, message));
+  }
+  stateMachine->handleError(std::runtime_error(std::move(message)));
+  endStream(streamId, StreamCompletionSignal::ERROR);
+}
+
+bool RSocketStateMachine::shouldFragment(const Payload& payload) const {
+  // Only the 1.0 serializer decodes the flags of the frame headers, which is
+  // how a fragmented frame is recognized on the receiving end.
+  return mtu_ > 0 && frameSerializer_ &&
+      frameSerializer_->protocolVersion().major >= 1 &&
+      needsFragmentation(payload, mtu_);
+}
+
+void RSocketStateMachine::startStreamLatency(
+    StreamId streamId,
+    StreamType streamType,
+    uint32_t initialRequestN) {
+  if (!measureStreamLatencies_) {
+    return;
+  }
+  auto const now = Clock::now();
+  stats_->streamHandlerInvoked(
+      streamType,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          now - framesReadTime_));
+  if (streamType == StreamType::FNF) {
+    return;
+  }
+  streamLatencies_.emplace(
+      streamId, StreamLatency(streamType, initialRequestN, framesReadTime_));
+}
+
+void RSocketStateMachine::streamPayloadWritten(
+    StreamId streamId,
+    bool complete) {
+  streamTracePayload(streamId, true);
+  streamAllowanceUsed(streamId, RSocketStats::StallDirection::SEND, complete);
+  if (!measureStreamLatencies_) {
+    return;
+  }
+  auto it = streamLatencies_.find(streamId);
+  if (it == streamLatencies_.end()) {
+    return;
+  }
+  auto& latency = it->second;
+  auto const now = Clock::now();
+  if (latency.lastPayload) {
+    stats_->streamPayloadGap(
+        latency.streamType,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *latency.lastPayload));
+  } else {
+    stats_->streamFirstPayload(
+        latency.streamType,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - latency.requested));
+  }
+  latency.lastPayload = now;
+  if (latency.allowance.tryConsume(1) && !latency.allowance && !complete) {
+    latency.blockedSince = now;
+  }
+}
+
+void RSocketStateMachine::streamRequestNReceived(
+    StreamId streamId,
+    uint32_t n) {
+  if (!measureStreamLatencies_) {
+    return;
+  }
+  auto it = streamLatencies_.find(streamId);
+  if (it == streamLatencies_.end()) {
+    return;
+  }
+  auto& latency = it->second;
+  latency.allowance.add(n);
+  if (latency.blockedSince && latency.allowance) {
+    stats_->streamBlockedOnRequestN(
+        latency.streamType,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - *latency.blockedSince));
+    latency.blockedSince = folly::none;
+  }
+}
+
+void RSocketStateMachine::startResponderTrace(
+    StreamId streamId,
+    StreamType streamType,
+    const Payload& request) {
+  if (traceEvery_ == 0 || !request.metadata) {
+    return;
+  }
+  auto const parent = findTraceContext(*request.metadata);
+  if (!parent || !parent->sampled) {
+    return;
+  }
+  StreamTrace trace;
+  trace.span.context = parent->newChild();
+  trace.span.streamId = streamId;
+  trace.span.streamType = streamType;
+  trace.span.start = Clock::now();
+  trace.started = true;
+  streamTraces_[streamId] = std::move(trace);
+}
+
+void RSocketStateMachine::streamTracePayload(StreamId streamId, bool written) {
+  if (streamTraces_.empty()) {
+    return;
+  }
+  auto it = streamTraces_.find(streamId);
+  if (it == streamTraces_.end()) {
+    return;
+  }
+  // The payloads of the requester of a channel don't count.
+  auto& span = it->second.span;
+  if (it->second.started && !span.firstPayload &&
+      written != span.requester) {
+    span.firstPayload = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - span.start);
+  }
+}
+
+void RSocketStateMachine::finishStreamTrace(
+    StreamId streamId,
+    StreamCompletionSignal signal) {
+  auto it = streamTraces_.find(streamId);
+  if (it == streamTraces_.end()) {
+    return;
+  }
+  auto trace = std::move(it->second);
+  streamTraces_.erase(it);
+  if (!trace.started || !trace.span.context.sampled) {
+    return;
+  }
+  trace.span.duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - trace.span.start);
+  trace.span.signal = signal;
+  stats_->streamSpan(trace.span);
+}
+
+void RSocketStateMachine::startStreamStalls(
+    StreamId streamId,
+    StreamType streamType,
+    bool requester,
+    uint32_t initialRequestN,
+    bool completed) {
+  if (stallThreshold_.count() == 0 ||
+      (streamType != StreamType::STREAM && streamType != StreamType::CHANNEL)) {
+    return;
+  }
+  auto const now = Clock::now();
+  StreamStall stall;
+  stall.streamType = streamType;
+  auto track = [&](RSocketStats::StallDirection direction, uint32_t n) {
+    auto& tracked = stall.directions[static_cast<size_t>(direction)];
+    tracked.tracked = true;
+    tracked.allowance.add(n);
+    if (!tracked.allowance) {
+      tracked.since = now;
+    }
+  };
+
+  // The initial allowance is granted by the requester to the responder.  The
+  // requester of a channel sends its first payload with the request, and
+  // needs the responder to request the others.
+  if (requester) {
+    track(RSocketStats::StallDirection::RECEIVE, initialRequestN);
+    if (streamType == StreamType::CHANNEL && !completed) {
+      track(RSocketStats::StallDirection::SEND, 0);
+    }
+  } else {
+    track(RSocketStats::StallDirection::SEND, initialRequestN);
+    if (streamType == StreamType::CHANNEL && !completed) {
+      track(RSocketStats::StallDirection::RECEIVE, 0);
+    }
+  }
+  streamStalls_[streamId] = stall;
+}
+
+void RSocketStateMachine::streamAllowanceUsed(
+    StreamId streamId,
+    RSocketStats::StallDirection direction,
+    bool complete) {
+  if (streamStalls_.empty()) {
+    return;
+  }
+  auto it = streamStalls_.find(streamId);
+  if (it == streamStalls_.end()) {
+    return;
+  }
+  auto& tracked = it->second.directions[static_cast<size_t>(direction)];
+  if (tracked.tracked && tracked.allowance.tryConsume(1) &&
+      !tracked.allowance && !complete) {
+    tracked.since = Clock::now();
+  }
+}
+
+void RSocketStateMachine::streamAllowanceAdded(
+    StreamId streamId,
+    RSocketStats::StallDirection direction,
+    uint32_t n) {
+  if (streamStalls_.empty()) {
+    return;
+  }
+  auto it = streamStalls_.find(streamId);
+  if (it == streamStalls_.end()) {
+    return;
+  }
+  auto& tracked = it->second.directions[static_cast<size_t>(direction)];
+  if (!tracked.tracked) {
+    return;
+  }
+  tracked.allowance.add(n);
+  if (tracked.since && tracked.allowance) {
+    auto const stalled = Clock::now() - *tracked.since;
+    tracked.since = folly::none;
+    if (stalled >= stallThreshold_) {
+      stats_->streamStalled(
+          streamId,
+          it->second.streamType,
+          direction,
+          std::chrono::duration_cast<std::chrono::microseconds>(stalled));
+    }
+  }
+}
+
+void RSocketStateMachine::finishStreamStalls(StreamId streamId) {
+  auto it = streamStalls_.find(streamId);
+  if (it == streamStalls_.end()) {
+    return;
+  }
+  auto const stall = it->second;
+  streamStalls_.erase(it);
+  auto const now = Clock::now();
+  for (size_t i = 0; i < stall.directions.size(); ++i) {
+    auto const& tracked = stall.directions[i];
+    if (!tracked.since || now - *tracked.since < stallThreshold_) {
+      continue;
+    }
+    stats_->streamStalled(
+        streamId,
+        stall.streamType,
+        static_cast<RSocketStats::StallDirection>(i),
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *tracked.since));
+  }
 }
 
 void RSocketStateMachine::writeError(Frame_ERROR&& frame) {
@@ -986,21 +3344,23 @@ bool RSocketStateMachine::ensureOrAutodetectFrameSerializer(
   }
 
   VLOG(2) << "detected protocol version" << serializer->protocolVersion();
-  frameSerializer_ = std::move(serializer);
+  setFrameSerializer(std::move(serializer));
   return true;
 }
 
 size_t RSocketStateMachine::getConsumerAllowance(StreamId streamId) const {
   size_t consumerAllowance = 0;
-  auto it = streamState_.streams_.find(streamId);
-  if (it != streamState_.streams_.end()) {
-    consumerAllowance = it->second->getConsumerAllowance();
+  if (auto stateMachine = streamState_.streams_.find(streamId)) {
+    consumerAllowance = (*stateMachine)->getConsumerAllowance();
   }
   return consumerAllowance;
 }
 
-void RSocketStateMachine::registerSet(std::shared_ptr<ConnectionSet> set) {
+void RSocketStateMachine::registerSet(
+    std::shared_ptr<ConnectionSet> set,
+    folly::EventBase* evb) {
   connectionSet_ = std::move(set);
+  connectionSetEventBase_ = evb;
 }
 
 DuplexConnection* RSocketStateMachine::getConnection() {
@@ -2,17 +2,38 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
 
 #include "rsocket/ColdResumeHandler.h"
+#include "rsocket/ConnectionSnapshot.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/LeaseSender.h"
 #include "rsocket/Payload.h"
 #include "rsocket/RSocketParameters.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/RequestOptions.h"
 #include "rsocket/ResumeManager.h"
+#include "rsocket/framing/Fragmentation.h"
 #include "rsocket/framing/FrameProcessor.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/internal/Allowance.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/CpuAccount.h"
 #include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/internal/LeaseTracker.h"
+#include "rsocket/internal/RequestNWindowTuner.h"
+#include "rsocket/internal/TimingWheel.h"
+#include "rsocket/statemachine/ForwardedStream.h"
 #include "rsocket/statemachine/StreamState.h"
 #include "rsocket/statemachine/StreamsFactory.h"
 #include "rsocket/statemachine/StreamsWriter.h"
@@ -22,16 +43,19 @@ namespace rsocket {
 class ClientResumeStatusCallback;
 class ConnectionSet;
 class DuplexConnection;
+struct EventBaseLoad;
 class FrameSerializer;
+struct HandedOverSocket;
 class FrameTransport;
 class Frame_ERROR;
 class KeepaliveTimer;
+class MemoryGovernor;
 class RSocketConnectionEvents;
 class RSocketParameters;
 class RSocketResponder;
 class RSocketStateMachine;
-class RSocketStats;
 class ResumeManager;
+struct ResumeStateTransfer;
 class StreamState;
 class StreamStateMachineBase;
 
@@ -70,7 +94,8 @@ class RSocketStateMachine final
       std::shared_ptr<RSocketStats> stats,
       std::shared_ptr<RSocketConnectionEvents> connectionEvents,
       std::shared_ptr<ResumeManager> resumeManager,
-      std::shared_ptr<ColdResumeHandler> coldResumeHandler);
+      std::shared_ptr<ColdResumeHandler> coldResumeHandler,
+      std::shared_ptr<LeaseSender> leaseSender = nullptr);
 
   ~RSocketStateMachine();
 
@@ -80,6 +105,53 @@ class RSocketStateMachine final
   /// Resume a connection as a server.
   bool resumeServer(yarpl::Reference<FrameTransport>, const ResumeParameters&);
 
+  /// The token and the mime types of the SETUP of a server connection, which
+  /// exportResumeState() hands over along with its state.
+  void setSetupIdentity(
+      ResumeIdentificationToken token,
+      std::string metadataMimeType,
+      std::string dataMimeType);
+
+  /// Hand a resumable server connection over to another host: fill `state`
+  /// with what that host needs to resume it, and close the connection here.
+  /// Returns false if the connection can't be handed over.
+  ///
+  /// With `socket`, the connection goes to another process of this host: its
+  /// socket goes along if the transport can release it, see
+  /// DuplexConnection::releaseSocket(), and the other process carries on
+  /// with it without the client noticing, see adoptTransferredServer().
+  bool exportResumeState(
+      ResumeStateTransfer& state,
+      HandedOverSocket* socket = nullptr);
+
+  /// Move the IO of the connection to `transportEvb`, e.g. off a busy
+  /// EventBase, while the state machine and its streams stay on
+  /// `stateMachineEvb`, the calling thread's.  The frames hop between the two
+  /// as for a client resumed on another EventBase, see
+  /// ScheduledFrameTransport.  Returns false if the connection can't move
+  /// right now, e.g. while writes are in flight, or at all.
+  bool migrateTransport(
+      folly::EventBase& stateMachineEvb,
+      folly::EventBase& transportEvb);
+
+  /// Resume a connection handed over by another host as a server, with the
+  /// resume manager the state has been imported into.  The streams the
+  /// connection had there are canceled.
+  bool resumeTransferredServer(
+      yarpl::Reference<FrameTransport>,
+      const ResumeParameters&,
+      const SetupParameters&,
+      const ResumeStateTransfer&);
+
+  /// Carry on with a connection handed over by another process of this host
+  /// along with its socket, as if nothing happened, with the resume manager
+  /// the state has been imported into.  The streams the connection had there
+  /// are canceled.
+  void adoptTransferredServer(
+      yarpl::Reference<FrameTransport>,
+      const SetupParameters&,
+      const ResumeStateTransfer&);
+
   /// Connect as a client.  Sends a SETUP frame.
   void connectClient(yarpl::Reference<FrameTransport>, SetupParameters);
 
@@ -97,6 +169,10 @@ class RSocketStateMachine final
   /// Whether the connection has been disconnected or closed.
   bool isDisconnected() const;
 
+  /// Whether the connection is closed or not resumable, or has been
+  /// disconnected for at least `timeout` without its client resuming it.
+  bool isAbandoned(std::chrono::milliseconds timeout) const;
+
   /// Send an ERROR frame, and close the connection and all of its streams.
   void closeWithError(Frame_ERROR&&);
 
@@ -119,6 +195,37 @@ class RSocketStateMachine final
   /// ::writeFrame after calling this method.
   void addStream(StreamId, yarpl::Reference<StreamStateMachineBase>);
 
+  /// Whether the connection has an open stream with the id.
+  bool hasStream(StreamId) const;
+
+  /// Sets how the frames of the stream are ordered against those of other
+  /// streams while they can't be sent right away.
+  void setStreamPriority(StreamId, StreamPriority);
+
+  /// Fails a requester stream with RequestTimeoutError, and cancels it, if it
+  /// hasn't terminated `timeout` after its request was written.  With
+  /// `propagate` the timeout is also added to the metadata of the request.
+  void setStreamTimeout(
+      StreamId,
+      std::chrono::milliseconds timeout,
+      bool propagate);
+
+  /// Gives a requester stream a span, as a child of `parent` or, without one,
+  /// as the root of a new trace if the stream is sampled.  With `propagate`
+  /// the trace context is added to the metadata of the request.  See
+  /// RSocketStats::traceSampleRate().
+  void setStreamTrace(
+      StreamId,
+      const folly::Optional<TraceContext>& parent,
+      bool propagate);
+
+  /// Adds a requester stream to the RequestGroup with the id `group`.
+  void setStreamGroup(StreamId, uint64_t group);
+
+  /// Cancels the requester streams of the group which are still open, as
+  /// their subscribers would, and writes their CANCEL frames at once.
+  void cancelStreamGroup(uint64_t group);
+
   /// Indicates that the stream should be removed from the connection.
   ///
   /// No frames will be issued as a result of this call. Stream stateMachine
@@ -141,17 +248,105 @@ class RSocketStateMachine final
   ///   ConnectionAutomaton.
   void endStream(StreamId, StreamCompletionSignal);
 
+  /// Whether a new request may be sent to the peer.  On connections set up
+  /// with leases this consumes one request of the lease granted by the peer.
+  bool acquireLease();
+
+  /// Whether new requests are refused because the frames waiting to be
+  /// written reach the PendingFrameLimits, with the FAIL_NEW_STREAMS policy.
+  bool rejectsNewStreams() const;
+
+  /// Whether fire-and-forgets are dropped because the frames waiting to be
+  /// written reach PendingFrameLimits::maxBytesForFireAndForget.
+  bool dropsFireAndForget() const;
+
+  const RequestNBatching& requestNBatching() const {
+    return requestNBatching_;
+  }
+
+  /// How many payloads the stream responders serialize ahead of the peer.
+  size_t streamSerializeAhead() const {
+    return streamSerializeAhead_;
+  }
+
+  /// Sizes the windows of the stream requesters, null unless they request
+  /// ahead of their subscribers, see AdaptiveRequestN.
+  const std::shared_ptr<RequestNWindowTuner>& requestNWindowTuner() const {
+    return requestNWindowTuner_;
+  }
+
+  /// Rejects the new requests of the peer, and issues no leases, while `load`
+  /// is overloaded.
+  void setEventBaseLoad(std::shared_ptr<const EventBaseLoad> load) {
+    eventBaseLoad_ = std::move(load);
+  }
+
+  /// Rejects the new requests of the peer past its StreamLimits.
+  /// `serverStreams` counts the streams of the peers of all the connections
+  /// with the same limits.
+  void setStreamLimits(
+      StreamLimits limits,
+      std::shared_ptr<std::atomic<size_t>> serverStreams);
+
+  /// Reports the bytes the connection holds to `governor`, and degrades as
+  /// it asks to, see MemoryGovernor.
+  void setMemoryGovernor(std::shared_ptr<MemoryGovernor> governor);
+
+  /// Bytes the connection holds in memory, which count against its
+  /// ConnectionMemoryLimits.
+  size_t memoryUsage() const;
+
+  /// The state of the connection and of its streams, see
+  /// RSocketServer::snapshot().
+  ConnectionSnapshot snapshot() const;
+
   /// Send a REQUEST_FNF frame.
   void fireAndForget(Payload);
 
+  /// Send a REQUEST_FNF frame for each of the payloads, on a block of stream
+  /// ids.  The frames are written to the transport at once when the
+  /// connection is writable.
+  void fireAndForgetBatch(std::vector<Payload>);
+
   /// Send a METADATA_PUSH frame.
   void metadataPush(std::unique_ptr<folly::IOBuf>);
 
+  /// Like metadataPush(), except that while the frame waits to be written,
+  /// e.g. while the connection is disconnected or its transport is backed
+  /// up, it supersedes the METADATA_PUSH of the same `key` which is still
+  /// waiting.
+  void metadataPushLatest(
+      std::unique_ptr<folly::IOBuf> metadata,
+      const std::string& key);
+
+  /// Send a METADATA_PUSH frame which has already been serialized with
+  /// protocolVersion(), e.g. a clone of a frame shared between connections.
+  void metadataPushSerialized(std::unique_ptr<folly::IOBuf> frame);
+
+  /// The protocol version the frames of the connection are serialized with.
+  /// None until it has been negotiated.
+  folly::Optional<ProtocolVersion> protocolVersion() const;
+
   /// Send a KEEPALIVE frame, with the RESPOND flag set.
   void sendKeepalive(std::unique_ptr<folly::IOBuf>) override;
 
-  /// Register the connection set that's holding this state machine.
-  void registerSet(std::shared_ptr<ConnectionSet>);
+  /// Send a KEEPALIVE frame, with the RESPOND flag set, and return a future
+  /// fulfilled once the server answers.  It fails if the connection is lost
+  /// first.  Only for clients.
+  folly::Future<folly::Unit> ping();
+
+  /// Stops taking new requests from the peer and closes the connection once
+  /// the streams open on it have terminated, or after `timeout` at the latest.
+  /// Requests arriving in the meantime are rejected, and no more leases are
+  /// issued.  `onClosed` is called once the connection is closed, right away
+  /// if it already is.
+  void drain(
+      std::chrono::milliseconds timeout,
+      folly::Function<void()> onClosed);
+
+  /// Register the connection set that's holding this state machine, and the
+  /// EventBase it was inserted with.
+  void registerSet(std::shared_ptr<ConnectionSet>, folly::EventBase*);
 
   StreamsFactory& streamsFactory() {
     return streamsFactory_;
@@ -169,6 +364,18 @@ class RSocketStateMachine final
 
   void setResumable(bool);
 
+  /// Creates requestNWindowTuner_ if the stream requesters request ahead.
+  void setAdaptiveRequestN(const AdaptiveRequestN&);
+
+  /// Sets up a connection handed over by another host or process with the
+  /// parameters it has been accepted with here.
+  void restoreTransferredServer(
+      const SetupParameters&,
+      const ResumeStateTransfer&);
+
+  /// Cancels the streams a connection handed over had on the other side.
+  void cancelTransferredStreams(const ResumeStateTransfer&);
+
   bool resumeFromPositionOrClose(
       ResumePosition serverPosition,
       ResumePosition clientPosition);
@@ -182,25 +389,48 @@ class RSocketStateMachine final
 
   void setFrameSerializer(std::unique_ptr<FrameSerializer>);
 
+  /// Calls `func` with the serializer of the connection.  The serializer of
+  /// protocol 1.0 is passed as its final type, so that the per frame calls on
+  /// it are direct.
+  template <typename F>
+  decltype(auto) withFrameSerializer(F&& func) {
+    if (frameSerializerV1_0_) {
+      return func(*frameSerializerV1_0_);
+    }
+    return func(*frameSerializer_);
+  }
+
+  /// Peeks at the header of a frame of this connection.
+  folly::Optional<FrameHeader> peekFrameHeader(const folly::IOBuf& frame) {
+    return withFrameSerializer([&](auto& serializer) {
+      return serializer.peekFrameHeader(frame);
+    });
+  }
+
   void sendPendingFrames();
 
   /// Send a frame to the output.  Will buffer the frame if the state machine is
   /// disconnected or in the process of resuming.
   void outputFrameOrEnqueue(std::unique_ptr<folly::IOBuf>);
+  void outputFramesOrEnqueue(std::vector<std::unique_ptr<folly::IOBuf>>);
 
   template <typename T>
   void outputFrameOrEnqueue(T&& frame) {
+    CpuAccount::Scope cpuScope(cpu_);
     VLOG(3) << mode_ << " Out: " << frame;
-    outputFrameOrEnqueue(
-        frameSerializer_->serializeOut(std::forward<T>(frame)));
+    outputFrameOrEnqueue(withFrameSerializer([&](auto& serializer) {
+      return serializer.serializeOut(std::forward<T>(frame));
+    }));
   }
 
   template <typename TFrame>
   bool deserializeFrameOrError(
       TFrame& frame,
       std::unique_ptr<folly::IOBuf> buf) {
-    if (frameSerializer_->deserializeFrom(frame, std::move(buf))) {
-      return true;
+    if (withFrameSerializer([&](auto& serializer) {
+          return serializer.deserializeFrom(frame, std::move(buf));
+        })) {
+      return decompressFrame(frame);
     }
     closeWithError(Frame_ERROR::connectionError("Invalid frame"));
     return false;
@@ -211,7 +441,9 @@ class RSocketStateMachine final
       bool resumable,
       TFrame& frame,
       std::unique_ptr<folly::IOBuf> buf) {
-    if (frameSerializer_->deserializeFrom(frame, std::move(buf), resumable)) {
+    if (withFrameSerializer([&](auto& serializer) {
+          return serializer.deserializeFrom(frame, std::move(buf), resumable);
+        })) {
       return true;
     }
     closeWithError(Frame_ERROR::connectionError("Invalid frame"));
@@ -226,19 +458,323 @@ class RSocketStateMachine final
 
   // FrameProcessor.
   void processFrame(std::unique_ptr<folly::IOBuf>) override;
+  void processFrames(std::vector<std::unique_ptr<folly::IOBuf>>) override;
   void onTerminal(folly::exception_wrapper) override;
+  void onWritabilityChanged(bool writable) override;
+
+  /// Tells the streams whether the connection is writable.
+  void notifyStreamsWritability();
+
+  /// Starts the deadline of a stream on the timing wheel of the EventBase.
+  void armStreamDeadline(StreamId, std::chrono::milliseconds timeout);
+
+  /// Stops the deadline of a stream, if it has one.
+  void cancelStreamDeadline(StreamId);
+
+  /// Terminates a stream whose deadline passed.  Requesters are cancelled and
+  /// fail with RequestTimeoutError, responders are cancelled as if the peer
+  /// had cancelled them.
+  void expireStream(StreamId);
+
+  /// Writes the pending frames for as long as the connection is writable.
+  void sendPendingFramesWhileWritable();
+
+  /// Pauses or resumes the publishers as memoryUsage() crosses the water
+  /// marks of memoryLimits_, and closes the connection once it goes above
+  /// their maximum.
+  void checkMemoryUsage();
+
+  /// Reports `bytes` to memoryGovernor_, and limits the resume buffer and
+  /// the windows of the stream requesters as it asks to.
+  void governMemory(size_t bytes);
+
+  /// Makes room for a frame of `streamId` by dropping the pending frames of
+  /// the oldest streams, with the DROP_OLDEST_STREAM policy.  The dropped
+  /// streams are terminated and the peer is told about it.  Returns false if
+  /// the stream of the frame was dropped itself.
+  bool dropOldestPendingStreams(StreamId streamId);
+
+  /// Processes one frame of processFrame() or processFrames(), recording it
+  /// in receivedFrames_.
+  void processFrameImpl(std::unique_ptr<folly::IOBuf>);
+
+  /// Hands the frames recorded in receivedFrames_ to the ResumeManager.
+  void trackReceivedFrames();
+
+  /// Checks every hibernateAfter_ whether a frame other than a KEEPALIVE went
+  /// through since the last check, and hibernates the connection once none
+  /// did.
+  void scheduleHibernationCheck();
+  void checkHibernation();
+
+  /// Frees the buffers the connection keeps to reuse, in the transport, in
+  /// streamState_ and in resumeManager_.  They are allocated again as the
+  /// connection needs them.
+  void hibernate();
+
+  /// Take the timestamps of the streams the connection responds to, and
+  /// report the latencies to stats_.  They do nothing unless
+  /// measureStreamLatencies_ is set.
+  void startStreamLatency(
+      StreamId,
+      StreamType,
+      uint32_t initialRequestN);
+  void streamPayloadWritten(StreamId, bool complete);
+  void streamRequestNReceived(StreamId, uint32_t n);
+
+  /// Take the timestamps of the traced streams, and report their spans to
+  /// stats_ when they end.  They do nothing unless streamTraces_ has the
+  /// stream.
+  void startResponderTrace(StreamId, StreamType, const Payload& request);
+  void streamTracePayload(StreamId, bool written);
+  void finishStreamTrace(StreamId, StreamCompletionSignal);
+
+  /// Track the allowances of the streams and channels, and report the stalls
+  /// longer than stallThreshold_ to stats_.  They do nothing unless
+  /// streamStalls_ has the stream.
+  void startStreamStalls(
+      StreamId,
+      StreamType,
+      bool requester,
+      uint32_t initialRequestN,
+      bool completed);
+  void streamAllowanceUsed(
+      StreamId,
+      RSocketStats::StallDirection,
+      bool complete);
+  void streamAllowanceAdded(
+      StreamId,
+      RSocketStats::StallDirection,
+      uint32_t n);
+  void finishStreamStalls(StreamId);
+
+  /// Counts the frames read in a row of the same type, and reports them to
+  /// the stats at once.
+  void countFrameRead(FrameType);
+  void flushFramesRead();
+
+  /// Hands the fire-and-forget requests collected while processing a batch
+  /// of frames to the responder, see RSocketResponder::batchesFireAndForget().
+  void flushFireAndForgetBatch();
+
+  /// The handlers get the frame header decoded once by processFrame(), only
+  /// the frame type and the stream id of the header are valid.
+  void handleConnectionFrame(
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleStreamFrame(const FrameHeader&, std::unique_ptr<folly::IOBuf>);
+  void handleUnknownStream(const FrameHeader&, std::unique_ptr<folly::IOBuf>);
+
+  /// Hands the payload of a PAYLOAD frame with the given flags to its stream.
+  void handleStreamPayload(
+      StreamStateMachineBase&,
+      StreamId,
+      Payload,
+      FrameFlags);
+
+  /// Registers the stream id of a frame for a stream which isn't open, and
+  /// checks that a new stream can be opened for it.  Returns false if the
+  /// frame was ignored, the stream rejected or the connection closed.
+  bool admitPeerStream(FrameType, StreamId);
+
+  /// Opens the stream of a new request admitted and accepted, and hands the
+  /// request to the responder.  Only the type, the flags and the stream id of
+  /// the header are used.
+  void openPeerStream(const FrameHeader&, uint32_t requestN, Payload);
+
+  /// Forwards a new request stream or request-response to the connection the
+  /// responder picks, see RSocketResponder::forwardRequest().  Returns false
+  /// and leaves the frame alone if the request isn't forwarded.
+  bool forwardRequest(
+      FrameType,
+      StreamId,
+      std::unique_ptr<folly::IOBuf>& frame);
+
+  /// Whether the streams of the connection can be forwarded frame by frame,
+  /// to or from a connection for which it is also true.
+  bool canForwardStreams() const;
+
+  /// The frames of the forwarded streams.  Each runs on the EventBase of the
+  /// end it is called for.  startForwardedStream() sends the request on the
+  /// requester end.  forwardStreamFrame() passes the frames read for an end
+  /// to the other one, which writes them with writeForwardedFrame().
+  /// abortForwardedStream() ends an end whose other end is gone, with a
+  /// CANCEL or an ERROR.
+  void startForwardedStream(
+      std::shared_ptr<ForwardedStream>,
+      std::unique_ptr<folly::IOBuf> request);
+  void forwardStreamFrame(
+      const FrameHeader&,
+      std::shared_ptr<ForwardedStream>,
+      std::unique_ptr<folly::IOBuf>);
+  void writeForwardedFrame(
+      const ForwardedStream&,
+      bool requesterEnd,
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void abortForwardedStream(const ForwardedStream&, bool requesterEnd);
+  void closeForwardedStreams();
+
+  /// Hands a new request stream or request-response to the responder with a
+  /// LazyPayload, if it handles them and the frame allows it.  Returns false
+  /// and leaves the frame alone otherwise.
+  bool handleLazyRequest(StreamId, std::unique_ptr<folly::IOBuf>& frame);
+
+  /// Answers a new request-response with the SerializedResponse of the
+  /// responder, if it has one for it.  Returns false and leaves the frame
+  /// alone otherwise.
+  bool respondSerialized(StreamId, std::unique_ptr<folly::IOBuf>& frame);
+
+  /// Asks the responder whether to accept a new request, from the metadata of
+  /// its frame.
+  bool acceptRequest(
+      FrameType frameType,
+      StreamId streamId,
+      const folly::IOBuf& serializedFrame);
+  bool acceptRequest(
+      FrameType frameType,
+      StreamId streamId,
+      const MetadataView& metadata);
+
+  /// Why a new stream of the peer is rejected with an ERROR frame.
+  enum class Rejection : uint8_t {
+    DRAINING,
+    OVERLOADED,
+    NO_LEASE,
+    REJECTED,
+    TOO_MANY_STREAMS,
+    OUT_OF_MEMORY,
+  };
+  static constexpr size_t kRejectionCount = 6;
+
+  /// Rejects a new stream of the peer.  The ERROR frame of each rejection is
+  /// serialized once per serializer and then copied with the stream id of
+  /// the rejected streams, as rejections come in floods when overloaded.
+  void rejectStream(StreamId streamId, Rejection rejection);
+
+  /// Whether the peer has as many streams open as its StreamLimits allow.
+  bool tooManyPeerStreams() const;
+
+  /// Collects the fragments of a frame sent with the FOLLOWS flag, and hands
+  /// the reassembled payload over with handleReassembledFrame() once the last
+  /// fragment has been received.  A payload growing past maxFrameLength_
+  /// closes the connection.  Frames which are not part of a fragmented frame
+  /// are returned as they are, nullptr otherwise.  Of those interleaved with
+  /// the fragments, only a CANCEL or an ERROR abandons the fragmented frame.
+  std::unique_ptr<folly::IOBuf> reassembleFragment(
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+
+  /// Opens the stream of a reassembled request, or hands a reassembled
+  /// PAYLOAD to its stream, without serializing the frame again.
+  /// `lastFlags` are those of the last fragment.
+  void handleReassembledFrame(StreamId, PartialFrame, FrameFlags lastFlags);
+
+  /// Whether the payload has to be sent in more than one frame.
+  bool shouldFragment(const Payload&) const;
+
+  /// Compresses the data of a payload about to be sent if the connection
+  /// compresses.  Returns the COMPRESSED flag if it did.
+  FrameFlags compressPayload(Payload& payload) {
+    if (compression_.codec == PayloadCompression::Codec::NONE) {
+      return FrameFlags::EMPTY;
+    }
+    return compressPayloadSlow(payload);
+  }
+  FrameFlags compressPayloadSlow(Payload&);
 
-  void handleConnectionFrame(FrameType, std::unique_ptr<folly::IOBuf>);
-  void handleStreamFrame(StreamId, FrameType, std::unique_ptr<folly::IOBuf>);
-  void handleUnknownStream(StreamId, FrameType, std::unique_ptr<folly::IOBuf>);
-
-  void closeStreams(StreamCompletionSignal);
+  /// Decompresses the data of a received frame with the COMPRESSED flag, once
+  /// the peers negotiated compressed payloads, but not a fragment, which is
+  /// decompressed once reassembled.  Fails the
+  /// stream with failStreamFrame() and returns false if it can't, or if the
+  /// data would be longer than maxFrameLength_.
+  template <typename TFrame>
+  bool decompressFrame(TFrame&) {
+    return true;
+  }
+  bool decompressFrame(Frame_REQUEST_STREAM& frame) {
+    return decompressFrame(frame.header_, frame.payload_);
+  }
+  bool decompressFrame(Frame_REQUEST_CHANNEL& frame) {
+    return decompressFrame(frame.header_, frame.payload_);
+  }
+  bool decompressFrame(Frame_REQUEST_RESPONSE& frame) {
+    return decompressFrame(frame.header_, frame.payload_);
+  }
+  bool decompressFrame(Frame_REQUEST_FNF& frame) {
+    return decompressFrame(frame.header_, frame.payload_);
+  }
+  bool decompressFrame(Frame_PAYLOAD& frame) {
+    return decompressFrame(frame.header_, frame.payload_);
+  }
+  bool decompressFrame(FrameHeader& header, Payload& payload) {
+    if (!(header.flags & FrameFlags::COMPRESSED) ||
+        !!(header.flags & FrameFlags::FOLLOWS) || !acceptsCompressed_) {
+      return true;
+    }
+    return decompressFrameSlow(header, payload);
+  }
+  bool decompressFrameSlow(FrameHeader&, Payload&);
+
+  /// Fails the stream of a frame which can't be handled: rejects a new
+  /// request with an INVALID error, or terminates an open stream on both
+  /// ends.
+  void failStreamFrame(const FrameHeader&, std::string message);
+
+  /// Sends all but the first fragment as PAYLOAD frames.  The last one gets
+  /// `lastFlags`, the others the FOLLOWS flag.
+  void writeFragments(
+      StreamId,
+      std::vector<Payload> fragments,
+      FrameFlags lastFlags);
+
+  /// Terminates at most kStreamsClosedPerLoop streams, and schedules the
+  /// rest for the next loop iteration.  Returns false if some are left.
+  bool closeStreams(StreamCompletionSignal);
+  /// Returns false if the rest can't wait for the next loop iteration: there
+  /// is no EventBase on this thread, or no owner of this left.  They are then
+  /// terminated right away.
+  bool scheduleCloseStreams(StreamCompletionSignal);
+  /// Empty while there is no owner of this, e.g. in its destructor.
+  std::weak_ptr<RSocketStateMachine> weakFromThis();
+  /// The end of close(), once all the streams are terminated.
+  void finishClose();
   void closeFrameTransport(folly::exception_wrapper, StreamCompletionSignal);
 
   void sendKeepalive(FrameFlags, std::unique_ptr<folly::IOBuf>);
 
+  /// Issue the next lease from the LeaseSender and schedule its renewal for
+  /// when it expires.
+  void sendLease();
+
   void resumeFromPosition(ResumePosition);
+  /// Replays the frames buffered for resumption from replayPosition_ while
+  /// the transport is writable, and at most kReplayBytesPerLoop of them before
+  /// yielding to the EventBase.
+  void replayFrames();
+  /// Continues replayFrames() in the next EventBase loop iteration.
+  void scheduleReplay();
+  /// Whether a connection frame which keeps the connection alive (KEEPALIVE,
+  /// ERROR, LEASE or RESUME_OK) goes to the transport right away while the
+  /// data frames are held back because the transport is backed up or
+  /// resumed frames are being replayed, so that the peer doesn't take the
+  /// connection for dead behind megabytes of payloads.  How long it waits is
+  /// then bounded by the transport's buffer, e.g. by the high-water mark of
+  /// TcpWriteBufferLimits.
+  bool skipsBacklog(const FrameHeader& header) const;
+
+  /// Whether frames go to the transport right away rather than being
+  /// buffered, see outputFrameOrEnqueue().
+  bool writesFrames() const {
+    return !isDisconnected() && !resumeCallback_ && !isReplaying_ &&
+        isWritable_;
+  }
+
   void outputFrame(std::unique_ptr<folly::IOBuf>);
+  void outputFrames(std::vector<std::unique_ptr<folly::IOBuf>>);
+
+  /// Bookkeeping of a frame which is about to be written.
+  void onFrameWritten(const folly::IOBuf&);
 
   void writeNewStream(
       StreamId streamId,
@@ -250,11 +786,20 @@ class RSocketStateMachine final
   void writeCancel(Frame_CANCEL&&) override;
 
   void writePayload(Frame_PAYLOAD&&) override;
+  void writePayloads(std::vector<Frame_PAYLOAD> frames) override;
+  std::unique_ptr<folly::IOBuf> serializePayload(Frame_PAYLOAD&) override;
+  void writeSerializedPayloads(
+      StreamId,
+      std::vector<std::unique_ptr<folly::IOBuf>>) override;
   void writeError(Frame_ERROR&&) override;
 
   void onStreamClosed(StreamId streamId, StreamCompletionSignal signal)
       override;
 
+  /// Closes a drained connection once the current EventBase callback has
+  /// returned.
+  void scheduleCloseDrained();
+
   bool ensureOrAutodetectFrameSerializer(const folly::IOBuf& firstFrame);
 
   size_t getConsumerAllowance(StreamId) const;
@@ -267,32 +812,255 @@ class RSocketStateMachine final
 
   /// Whether the connection has closed.
   bool isClosed_{false};
+  /// When the transport was last closed, see isAbandoned().
+  std::chrono::steady_clock::time_point disconnectedAt_{
+      std::chrono::steady_clock::now()};
+
+  /// Whether the transport accepts more output without buffering it.  Frames
+  /// are held in streamState_ while it doesn't.
+  bool isWritable_{true};
+
+  /// Whether the frames buffered for resumption are being replayed.  Frames
+  /// are held in streamState_ until all of them were sent.
+  bool isReplaying_{false};
+  /// What close() was called with, for onClosed() once the streams are
+  /// terminated.
+  folly::exception_wrapper closeError_;
+
+  /// Whether replayFrames() is scheduled for the next loop iteration.
+  bool replayScheduled_{false};
+  /// Position of the next buffered frame to replay.
+  ResumePosition replayPosition_{0};
+
+  /// Whether drain() has been called, and the connection closes once its
+  /// streams are done.
+  bool isDraining_{false};
 
   /// Whether a cold resume is currently in progress.
   bool coldResumeInProgress_{false};
 
+  /// Whether the requests sent by this side are subject to the leases granted
+  /// by the peer (clients which asked for leases in SETUP).
+  bool requesterLeaseEnabled_{false};
+
+  /// Whether the requests received by this side are checked against the leases
+  /// issued by leaseSender_.
+  bool responderLeaseEnabled_{false};
+
+  /// Lease received from the peer.
+  LeaseTracker requesterLease_;
+
+  /// Lease issued to the peer.
+  LeaseTracker responderLease_;
+
+  /// Largest payload sent in a single frame, 0 if payloads aren't fragmented.
+  size_t mtu_{0};
+  RequestNBatching requestNBatching_;
+  size_t streamSerializeAhead_{0};
+  std::shared_ptr<RequestNWindowTuner> requestNWindowTuner_;
+  /// When the oldest keepalive not answered yet was sent, to measure the
+  /// round trip time for requestNWindowTuner_ and the stats.
+  folly::Optional<std::chrono::steady_clock::time_point> keepaliveSentAt_;
+
+  /// Bytes received after which the position is acknowledged with a
+  /// KEEPALIVE, 0 if only the regular keepalives carry it.
+  size_t positionAckBytes_{0};
+
+  ConnectionMemoryLimits memoryLimits_;
+
+  /// Idle time after which the connection hibernates, 0 if it never does.
+  std::chrono::milliseconds hibernateAfter_{0};
+  /// Frames other than KEEPALIVE read and written, and their number at the
+  /// last check of checkHibernation().
+  uint64_t activeFrames_{0};
+  uint64_t activeFramesChecked_{0};
+  bool hibernationScheduled_{false};
+  /// Whether the connection hibernated, and nothing happened since.
+  bool isHibernating_{false};
+
+  /// How the payloads sent are compressed, no codec if they aren't.
+  PayloadCompression compression_;
+  /// How a client compresses its payloads once the server accepted them.
+  PayloadCompression requestedCompression_;
+  /// Whether the peers negotiated compressed payloads, without which the
+  /// COMPRESSED flag is a reserved bit and ignored.
+  bool acceptsCompressed_{false};
+  /// Whether the publishers are paused since memoryUsage() went above the
+  /// high-water mark.
+  bool memoryBackpressure_{false};
+  /// Whether the connection is being closed for going above the maximum.
+  bool memoryExceeded_{false};
+  /// See setMemoryGovernor().
+  std::shared_ptr<MemoryGovernor> memoryGovernor_;
+  /// The bytes last reported to memoryGovernor_.
+  size_t governedBytes_{0};
+  /// The fraction of its capacity the resume buffer was limited to.
+  double resumeFraction_{1};
+  /// Whether the windows are cut back for memoryGovernor_.
+  bool governorPressure_{false};
+  /// Load of the EventBase of the connection, see setEventBaseLoad().
+  std::shared_ptr<const EventBaseLoad> eventBaseLoad_;
+  /// See setStreamLimits().
+  StreamLimits streamLimits_;
+  std::shared_ptr<std::atomic<size_t>> serverStreams_;
+  /// Streams opened by the peer in streamState_.
+  size_t peerStreams_{0};
+
+  /// Bytes of the frames read and written, see ConnectionSnapshot.
+  uint64_t bytesRead_{0};
+  uint64_t bytesWritten_{0};
+
+  /// Position carried by the last KEEPALIVE sent.
+  ResumePosition ackedPosition_{0};
+
+  /// Waiting for a keepalive answer, see ping().
+  std::vector<folly::Promise<folly::Unit>> pings_;
+
+  /// Frames whose fragments are being received, by stream.
+  std::unordered_map<StreamId, PartialFrame> partialFrames_;
+  /// Longest payload reassembled from fragments, metadata included.
+  size_t maxFrameLength_{kMaxFrameLength};
+
+  struct StreamDeadline {
+    std::chrono::milliseconds timeout;
+    bool propagate{false};
+    /// Set once the deadline is running.
+    TimingWheel* wheel{nullptr};
+    TimingWheel::Handle handle;
+  };
+
+  /// Deadlines of the streams, see setStreamTimeout().
+  std::unordered_map<StreamId, StreamDeadline> streamDeadlines_;
+
+  /// The RequestGroup of the streams which joined one, see setStreamGroup().
+  std::unordered_map<StreamId, uint64_t> streamGroups_;
+  /// Collects the CANCEL frames of the streams cancelStreamGroup() cancels.
+  std::vector<std::unique_ptr<folly::IOBuf>>* cancelBatch_{nullptr};
+
   std::shared_ptr<RSocketStats> stats_;
+  /// Whether stats_ takes the stream latencies, see streamLatencies_.
+  const bool measureStreamLatencies_;
+  /// Whether stats_ takes the size of each frame.
+  const bool reportFrameSizes_;
+  /// Cycles spent on the EventBase, with RSocketStats::cpuAccountingEnabled().
+  CpuAccount cpu_;
+  /// The frames counted by countFrameRead() which weren't reported yet.
+  FrameType framesReadType_{FrameType::RESERVED};
+  size_t framesReadCount_{0};
+  /// Whether processFrames() collects the fire-and-forget requests in
+  /// fireAndForgetBatch_.
+  bool batchingFireAndForget_{false};
+  std::vector<std::pair<Payload, StreamId>> fireAndForgetBatch_;
 
   /// Per-stream frame buffer between the state machine and the FrameTransport.
   StreamState streamState_;
 
+  using Clock = std::chrono::steady_clock;
+
+  /// Timestamps of a stream the connection responds to.
+  struct StreamLatency {
+    StreamLatency(
+        StreamType _streamType,
+        uint32_t initialRequestN,
+        Clock::time_point _requested)
+        : streamType(_streamType),
+          requested(_requested),
+          allowance(initialRequestN) {}
+
+    StreamType streamType;
+    Clock::time_point requested;
+    /// When the last payload was written, unset until the first one is.
+    folly::Optional<Clock::time_point> lastPayload;
+    /// Allowance of the requester which hasn't been used yet.
+    Allowance allowance;
+    /// When the allowance was used up.
+    folly::Optional<Clock::time_point> blockedSince;
+  };
+
+  /// When the frames being processed were read, with measureStreamLatencies_.
+  Clock::time_point framesReadTime_;
+  std::unordered_map<StreamId, StreamLatency> streamLatencies_;
+
+  /// One in traceEvery_ requests sent without a trace parent starts a trace,
+  /// 0 if tracing is off.  See RSocketStats::traceSampleRate().
+  const size_t traceEvery_;
+  /// Requests left to send until the next sampled one.
+  size_t traceCountdown_;
+
+  struct StreamTrace {
+    StreamSpan span;
+    /// Whether the requester adds the context to the request.
+    bool propagate{false};
+    /// Set once the request was written, or read.
+    bool started{false};
+  };
+
+  /// Spans of the traced streams.
+  std::unordered_map<StreamId, StreamTrace> streamTraces_;
+
+  /// Stalls shorter than this aren't reported, 0 if the allowances aren't
+  /// tracked.  See RSocketStats::streamStallThreshold().
+  const std::chrono::milliseconds stallThreshold_;
+
+  /// Allowances of a stream or channel, in each direction it is tracked in.
+  struct StreamStall {
+    struct Direction {
+      bool tracked{false};
+      Allowance allowance;
+      /// When the allowance was used up, unset while there is some.
+      folly::Optional<Clock::time_point> since;
+    };
+
+    StreamType streamType{StreamType::STREAM};
+    /// Indexed by RSocketStats::StallDirection.
+    std::array<Direction, 2> directions;
+  };
+
+  /// Allowances of the streams, with stallThreshold_.
+  std::unordered_map<StreamId, StreamStall> streamStalls_;
+
+  /// The ends of the streams forwarded from or to this connection, by their
+  /// stream id on this connection.  Only the frames of the ends of the
+  /// requester have local stream ids.
+  std::unordered_map<StreamId, std::shared_ptr<ForwardedStream>>
+      forwardedStreams_;
+
   // Manages all state needed for warm/cold resumption.
   std::shared_ptr<ResumeManager> resumeManager_;
+  /// Frames processed but not yet tracked by resumeManager_, they are tracked
+  /// once per batch of frames.
+  std::vector<ReceivedFrameInfo> receivedFrames_;
 
   std::shared_ptr<RSocketResponder> requestResponder_;
   yarpl::Reference<FrameTransport> frameTransport_;
   std::unique_ptr<FrameSerializer> frameSerializer_;
+  /// frameSerializer_ when it is the serializer of protocol 1.0, see
+  /// withFrameSerializer().
+  FrameSerializerV1_0* frameSerializerV1_0_{nullptr};
+  /// The ERROR frames of rejectStream() serialized by frameSerializer_, by
+  /// Rejection.
+  std::array<std::unique_ptr<folly::IOBuf>, kRejectionCount> rejectionFrames_;
 
   const std::unique_ptr<KeepaliveTimer> keepaliveTimer_;
 
   std::unique_ptr<ClientResumeStatusCallback> resumeCallback_;
   std::shared_ptr<ColdResumeHandler> coldResumeHandler_;
+  std::shared_ptr<LeaseSender> leaseSender_;
 
   StreamsFactory streamsFactory_;
 
   std::shared_ptr<RSocketConnectionEvents> connectionEvents_;
 
+  /// See setSetupIdentity().
+  ResumeIdentificationToken setupToken_;
+  std::string setupMetadataMimeType_;
+  std::string setupDataMimeType_;
+
   /// Back reference to the set that's holding this state machine.
   std::weak_ptr<ConnectionSet> connectionSet_;
+  folly::EventBase* connectionSetEventBase_{nullptr};
+
+  /// Called once the connection is closed after drain().
+  folly::Function<void()> onDrained_;
 };
 }
@@ -2,6 +2,9 @@
 
 #include "rsocket/statemachine/RequestResponseRequester.h"
 
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/RSocketErrors.h"
 #include "rsocket/internal/Common.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
@@ -16,19 +19,75 @@ void RequestResponseRequester::subscribe(
   DCHECK(!consumingSubscriber_);
   consumingSubscriber_ = std::move(subscriber);
   consumingSubscriber_->onSubscribe(this->ref_from_this(this));
+  sendRequest();
+}
+
+void RequestResponseRequester::subscribe(folly::Promise<Payload> promise) {
+  DCHECK(!isTerminated());
+  DCHECK(!consumingSubscriber_ && !promise_);
+  // the interrupt can come from any thread, the stream has to be canceled on
+  // the EventBase it runs on
+  if (auto eventBase =
+          folly::EventBaseManager::get()->getExistingEventBase()) {
+    promise.setInterruptHandler([
+      eventBase,
+      self = this->ref_from_this(this)
+    ](const folly::exception_wrapper& ew) {
+      eventBase->runInEventBaseThread([self, ew] { self->interrupt(ew); });
+    });
+  }
+  promise_ = std::move(promise);
+  sendRequest();
+}
 
+void RequestResponseRequester::sendRequest() {
   if (state_ == State::NEW) {
     state_ = State::REQUESTED;
     newStream(StreamType::REQUEST_RESPONSE, 1, std::move(initialPayload_));
   } else {
-    if (auto subscriber = std::move(consumingSubscriber_)) {
-      subscriber->onError(
-          std::runtime_error("cannot request more than 1 item"));
-    }
+    deliverError(std::runtime_error("cannot request more than 1 item"));
     closeStream(StreamCompletionSignal::ERROR);
   }
 }
 
+void RequestResponseRequester::interrupt(folly::exception_wrapper ew) {
+  // the response or an error might have been delivered in the meantime
+  if (!promise_) {
+    return;
+  }
+  deliverError(std::move(ew));
+  cancel();
+}
+
+void RequestResponseRequester::cancelRequest() {
+  // A future has to be completed, an observer isn't signaled once cancelled.
+  if (promise_) {
+    interrupt(RequestCancelledError(""));
+  } else {
+    cancel();
+  }
+}
+
+void RequestResponseRequester::deliverResponse(Payload payload) {
+  if (auto subscriber = std::move(consumingSubscriber_)) {
+    subscriber->onSuccess(std::move(payload));
+  } else if (promise_) {
+    auto promise = std::move(*promise_);
+    promise_.clear();
+    promise.setValue(std::move(payload));
+  }
+}
+
+void RequestResponseRequester::deliverError(folly::exception_wrapper ew) {
+  if (auto subscriber = std::move(consumingSubscriber_)) {
+    subscriber->onError(std::move(ew));
+  } else if (promise_) {
+    auto promise = std::move(*promise_);
+    promise_.clear();
+    promise.setException(std::move(ew));
+  }
+}
+
 void RequestResponseRequester::cancel() noexcept {
   consumingSubscriber_ = nullptr;
   switch (state_) {
@@ -59,10 +118,10 @@ void RequestResponseRequester::endStream(StreamCompletionSignal signal) {
     case State::CLOSED:
       break;
   }
-  if (auto subscriber = std::move(consumingSubscriber_)) {
+  if (consumingSubscriber_ || promise_) {
     DCHECK(signal != StreamCompletionSignal::COMPLETE);
     DCHECK(signal != StreamCompletionSignal::CANCEL);
-    subscriber->onError(StreamInterruptedException(static_cast<int>(signal)));
+    deliverError(StreamInterruptedException(static_cast<int>(signal)));
   }
 }
 
@@ -75,9 +134,7 @@ void RequestResponseRequester::handleError(
       break;
     case State::REQUESTED:
       state_ = State::CLOSED;
-      if (auto subscriber = std::move(consumingSubscriber_)) {
-        subscriber->onError(errorPayload);
-      }
+      deliverError(std::move(errorPayload));
       closeStream(StreamCompletionSignal::ERROR);
       break;
     case State::CLOSED:
@@ -105,8 +162,7 @@ void RequestResponseRequester::handlePayload(
   }
 
   if (payload || flagsNext) {
-    consumingSubscriber_->onSuccess(std::move(payload));
-    consumingSubscriber_ = nullptr;
+    deliverResponse(std::move(payload));
   } else if (!complete) {
     errorStream("payload, NEXT or COMPLETE flag expected");
     return;
@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include <folly/Optional.h>
+#include <folly/futures/Promise.h>
+
 #include "rsocket/Payload.h"
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/single/SingleObserver.h"
 #include "yarpl/single/SingleSubscription.h"
@@ -11,9 +15,11 @@ namespace rsocket {
 
 /// Implementation of stream stateMachine that represents a RequestResponse
 /// requester
-class RequestResponseRequester : public StreamStateMachineBase,
-                                 public yarpl::single::SingleSubscription,
-                                 public yarpl::enable_get_ref {
+class RequestResponseRequester final
+    : public StreamStateMachineBase,
+      public yarpl::single::SingleSubscription,
+      public yarpl::enable_get_ref,
+      public PoolAllocated<RequestResponseRequester> {
  public:
   RequestResponseRequester(
       std::shared_ptr<StreamsWriter> writer,
@@ -25,11 +31,21 @@ class RequestResponseRequester : public StreamStateMachineBase,
   void subscribe(
       yarpl::Reference<yarpl::single::SingleObserver<Payload>> subscriber);
 
+  /// Fulfills the promise with the response instead of signaling an observer.
+  /// Interrupting its future cancels the request.
+  void subscribe(folly::Promise<Payload> promise);
+
  private:
   void cancel() noexcept override;
 
+  void sendRequest();
+  void interrupt(folly::exception_wrapper ew);
+  void deliverResponse(Payload payload);
+  void deliverError(folly::exception_wrapper ew);
+
   void handlePayload(Payload&& payload, bool complete, bool flagsNext) override;
   void handleError(folly::exception_wrapper errorPayload) override;
+  void cancelRequest() override;
 
   void endStream(StreamCompletionSignal signal) override;
 
@@ -44,6 +60,8 @@ class RequestResponseRequester : public StreamStateMachineBase,
 
   /// The observer that will consume payloads.
   yarpl::Reference<yarpl::single::SingleObserver<Payload>> consumingSubscriber_;
+  /// Or the promise for the response.
+  folly::Optional<folly::Promise<Payload>> promise_;
 
   /// Initial payload which has to be sent with 1st request.
   Payload initialPayload_;
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/flowable/Subscriber.h"
 #include "yarpl/single/SingleObserver.h"
@@ -13,8 +14,10 @@ namespace rsocket {
 
 /// Implementation of stream stateMachine that represents a RequestResponse
 /// responder
-class RequestResponseResponder : public StreamStateMachineBase,
-                                 public yarpl::single::SingleObserver<Payload> {
+class RequestResponseResponder final
+    : public StreamStateMachineBase,
+      public yarpl::single::SingleObserver<Payload>,
+      public PoolAllocated<RequestResponseResponder> {
  public:
   RequestResponseResponder(
       std::shared_ptr<StreamsWriter> writer,
@@ -2,6 +2,9 @@
 
 #include "rsocket/statemachine/StreamRequester.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace rsocket {
 
 void StreamRequester::setRequested(size_t n) {
@@ -18,6 +21,13 @@ void StreamRequester::request(int64_t n) noexcept {
   if(!requested_) {
     requested_ = true;
 
+    if (prefetches()) {
+      // The REQUEST_STREAM carries the window as well.
+      n = static_cast<int64_t>(std::min<size_t>(
+          startPrefetch(static_cast<size_t>(n)),
+          std::numeric_limits<int64_t>::max()));
+    }
+
     auto initialN =
         n > Frame_REQUEST_N::kMaxRequestN ? Frame_REQUEST_N::kMaxRequestN : n;
     auto remainingN = n > Frame_REQUEST_N::kMaxRequestN
@@ -38,7 +48,7 @@ void StreamRequester::request(int64_t n) noexcept {
     // Pump the remaining allowance into the ConsumerBase _after_ sending the
     // initial request.
     if (remainingN) {
-      generateRequest(remainingN);
+      grantRequest(remainingN);
     }
     return;
   }
@@ -50,7 +60,10 @@ void StreamRequester::cancel() noexcept {
   VLOG(5) << "StreamRequester::cancel(requested_=" << requested_ << ")";
   if (requested_) {
     cancelConsumer();
-    cancelStream();
+    // A prefetching stream may have completed with payloads left buffered.
+    if (!isTerminated()) {
+      cancelStream();
+    }
   }
   closeStream(StreamCompletionSignal::CANCEL);
 }
@@ -68,11 +81,15 @@ void StreamRequester::handlePayload(
   processPayload(std::move(payload), next);
 
   if (complete) {
-    completeConsumer();
-    closeStream(StreamCompletionSignal::COMPLETE);
+    handleComplete();
   }
 }
 
+void StreamRequester::handleComplete() {
+  completeConsumer();
+  closeStream(StreamCompletionSignal::COMPLETE);
+}
+
 void StreamRequester::handleError(folly::exception_wrapper errorPayload) {
   CHECK(requested_);
   errorConsumer(std::move(errorPayload));
@@ -3,7 +3,10 @@
 #pragma once
 
 #include <iosfwd>
+#include <type_traits>
+
 #include "rsocket/internal/Allowance.h"
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/ConsumerBase.h"
 
 namespace folly {
@@ -15,7 +18,8 @@ namespace rsocket {
 enum class StreamCompletionSignal;
 
 /// Implementation of stream stateMachine that represents a Stream requester
-class StreamRequester : public ConsumerBase {
+class StreamRequester : public ConsumerBase,
+                        public PoolAllocated<StreamRequester> {
   using Base = ConsumerBase;
 
  public:
@@ -30,6 +34,11 @@ class StreamRequester : public ConsumerBase {
 
   void setRequested(size_t n);
 
+ protected:
+  /// Completes the subscriber and closes the stream, once the peer completed
+  /// it.
+  void handleComplete();
+
  private:
   // implementation from ConsumerBase::Subscription
   void request(int64_t) noexcept override;
@@ -37,15 +46,53 @@ class StreamRequester : public ConsumerBase {
 
   void handlePayload(Payload&& payload, bool complete, bool flagsNext) override;
   void handleError(folly::exception_wrapper errorPayload) override;
+  void cancelRequest() override {
+    cancel();
+  }
 
   void endStream(StreamCompletionSignal) override;
 
-  /// An allowance accumulated before the stream is initialised.
-  /// Remaining part of the allowance is forwarded to the ConsumerBase.
-  Allowance initialResponseAllowance_;
-
   /// Initial payload which has to be sent with 1st request.
   Payload initialPayload_;
   bool requested_{false};
 };
+
+/// A StreamRequester for a subscriber of the final class S, see
+/// RSocketRequester::requestStream(Payload, Reference<S>).  The payloads are
+/// given to the subscriber with a direct call to S::onNext(), which the
+/// compiler can inline into the handling of their frames.  Payloads buffered
+/// ahead of the subscriber (see AdaptiveRequestN) still go through the
+/// virtual call.
+template <typename S>
+class TypedStreamRequester final : public StreamRequester {
+  static_assert(
+      std::is_base_of<yarpl::flowable::Subscriber<Payload>, S>::value,
+      "S must be a Subscriber<Payload>");
+  static_assert(
+      std::is_final<S>::value,
+      "S must be final for its methods to be called directly");
+
+ public:
+  using StreamRequester::StreamRequester;
+
+  /// A StreamRequesterFactory, see StreamsFactory.
+  static yarpl::Reference<StreamRequester> make(
+      std::shared_ptr<StreamsWriter> writer,
+      StreamId streamId,
+      Payload payload) {
+    return yarpl::make_ref<TypedStreamRequester>(
+        std::move(writer), streamId, std::move(payload));
+  }
+
+ private:
+  void handlePayload(Payload&& payload, bool complete, bool next) override {
+    if (acceptPayload(payload, next)) {
+      // Only subscribers of type S are given to this state machine.
+      static_cast<S*>(consumingSubscriber())->onNext(std::move(payload));
+    }
+    if (complete) {
+      handleComplete();
+    }
+  }
+};
 }
@@ -2,26 +2,123 @@
 
 #include "rsocket/statemachine/StreamResponder.h"
 
+#include <algorithm>
+
+#include "rsocket/statemachine/StreamsWriter.h"
+
 namespace rsocket {
 
 using namespace yarpl;
 using namespace yarpl::flowable;
 
+void StreamResponder::setSerializeAhead(size_t n) {
+  serializeAhead_ =
+      static_cast<uint16_t>(std::min(n, PublisherBase::kMaxProducerAllowance));
+}
+
 void StreamResponder::onSubscribe(
     Reference<yarpl::flowable::Subscription> subscription) noexcept {
   publisherSubscribe(std::move(subscription));
+  requestAhead();
 }
 
 void StreamResponder::onNext(Payload response) noexcept {
-  checkPublisherOnNext();
+  auto const writes = writesNext();
   if (!publisherClosed()) {
-    writePayload(std::move(response), false);
+    if (writes) {
+      writePayload(std::move(response), false);
+    } else {
+      hold(std::move(response));
+    }
+    requestFromProducer();
+    requestAhead();
   }
 }
 
+void StreamResponder::onNextBatch(std::vector<Payload> responses) noexcept {
+  // The payloads held are the last ones, the peer allows the earliest first.
+  size_t writes = 0;
+  for (size_t i = 0; i < responses.size(); ++i) {
+    writes += writesNext() ? 1 : 0;
+  }
+  if (!publisherClosed()) {
+    for (size_t i = writes; i < responses.size(); ++i) {
+      hold(std::move(responses[i]));
+    }
+    responses.resize(writes);
+    if (!responses.empty()) {
+      writePayloads(std::move(responses));
+    }
+    requestFromProducer();
+    requestAhead();
+  }
+}
+
+bool StreamResponder::writesNext() {
+  if (checkPublisherOnNext() || !aheadRequested_) {
+    return true;
+  }
+  --aheadRequested_;
+  if (aheadAllowed_) {
+    --aheadAllowed_;
+    return true;
+  }
+  return false;
+}
+
+void StreamResponder::hold(Payload payload) {
+  Frame_PAYLOAD frame(streamId_, FrameFlags::NEXT, std::move(payload));
+  HeldPayload held;
+  held.frame = writer_->serializePayload(frame);
+  if (!held.frame) {
+    held.payload = std::move(frame.payload_);
+  }
+  held_.push_back(std::move(held));
+}
+
+void StreamResponder::writeHeld(size_t n) {
+  // The frames serialized one after the other are written together.
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  for (size_t i = 0; i < n; ++i) {
+    if (held_[i].frame) {
+      frames.push_back(std::move(held_[i].frame));
+      continue;
+    }
+    if (!frames.empty()) {
+      writer_->writeSerializedPayloads(streamId_, std::move(frames));
+      frames.clear();
+    }
+    writePayload(std::move(held_[i].payload), false);
+  }
+  if (!frames.empty()) {
+    writer_->writeSerializedPayloads(streamId_, std::move(frames));
+  }
+  held_.erase(held_.begin(), held_.begin() + n);
+  if (completeHeld_ && held_.empty()) {
+    completeHeld_ = false;
+    completeStream();
+    closeStream(StreamCompletionSignal::COMPLETE);
+  }
+}
+
+void StreamResponder::requestAhead() {
+  auto const ahead = held_.size() + aheadRequested_;
+  if (ahead >= serializeAhead_ || !producerWaitsForPeer()) {
+    return;
+  }
+  auto const n = serializeAhead_ - ahead;
+  // The producer may deliver within request().
+  aheadRequested_ += static_cast<uint16_t>(n);
+  requestAheadOfPeer(n);
+}
+
 void StreamResponder::onComplete() noexcept {
   if (!publisherClosed()) {
     publisherComplete();
+    if (!held_.empty()) {
+      completeHeld_ = true;
+      return;
+    }
     completeStream();
     closeStream(StreamCompletionSignal::COMPLETE);
   }
@@ -30,6 +127,8 @@ void StreamResponder::onComplete() noexcept {
 void StreamResponder::onError(folly::exception_wrapper ex) noexcept {
   if (!publisherClosed()) {
     publisherComplete();
+    // The payloads the peer didn't request yet are dropped.
+    held_.clear();
     applicationError(ex.get_exception()->what());
     closeStream(StreamCompletionSignal::ERROR);
   }
@@ -37,6 +136,7 @@ void StreamResponder::onError(folly::exception_wrapper ex) noexcept {
 
 void StreamResponder::endStream(StreamCompletionSignal signal) {
   terminatePublisher();
+  held_.clear();
   StreamStateMachineBase::endStream(signal);
 }
 
@@ -46,6 +146,21 @@ void StreamResponder::handleCancel() {
 }
 
 void StreamResponder::handleRequestN(uint32_t n) {
-  processRequestN(n);
+  // The payloads requested ahead are the first the peer allows.
+  auto const written = std::min<size_t>(n, held_.size());
+  if (written) {
+    writeHeld(written);
+    n -= static_cast<uint32_t>(written);
+  }
+  auto const allowed =
+      std::min<uint32_t>(n, aheadRequested_ - aheadAllowed_);
+  aheadAllowed_ += static_cast<uint16_t>(allowed);
+  processRequestN(n - allowed);
+  requestAhead();
+}
+
+void StreamResponder::connectionWritabilityChanged(bool writable) {
+  publisherWritabilityChanged(writable);
+  requestAhead();
 }
 }
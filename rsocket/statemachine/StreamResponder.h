@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include "rsocket/internal/PoolAllocated.h"
 #include "rsocket/statemachine/PublisherBase.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/flowable/Subscriber.h"
@@ -9,9 +13,14 @@
 namespace rsocket {
 
 /// Implementation of stream stateMachine that represents a Stream responder
+///
+/// With setSerializeAhead(), the responder requests payloads of the producer
+/// beyond the allowance of the peer and holds them serialized, so that the
+/// REQUEST_N of the peer is answered with a single write of the frames ready.
 class StreamResponder : public StreamStateMachineBase,
                         public PublisherBase,
-                        public yarpl::flowable::Subscriber<Payload> {
+                        public yarpl::flowable::Subscriber<Payload>,
+                        public PoolAllocated<StreamResponder> {
  public:
   StreamResponder(
       std::shared_ptr<StreamsWriter> writer,
@@ -20,17 +29,50 @@ class StreamResponder : public StreamStateMachineBase,
       : StreamStateMachineBase(std::move(writer), streamId),
         PublisherBase(initialRequestN) {}
 
+  /// Up to `n` payloads, at most kMaxProducerAllowance, are serialized ahead
+  /// of the allowance of the peer.  0, the default, serializes none.
+  void setSerializeAhead(size_t n);
+
  protected:
   void handleCancel() override;
   void handleRequestN(uint32_t n) override;
+  void connectionWritabilityChanged(bool writable) override;
 
  private:
   void onSubscribe(yarpl::Reference<yarpl::flowable::Subscription>
                        subscription) noexcept override;
   void onNext(Payload) noexcept override;
+  void onNextBatch(std::vector<Payload>) noexcept override;
   void onComplete() noexcept override;
   void onError(folly::exception_wrapper) noexcept override;
 
   void endStream(StreamCompletionSignal) override;
+
+  /// Accounts for a payload of the producer, returns false when it has to be
+  /// held until the peer allows it.
+  bool writesNext();
+  void hold(Payload);
+  /// Writes the first `n` payloads held, and completes the stream once the
+  /// last one is written after the producer completed.
+  void writeHeld(size_t n);
+  /// Tops up the payloads requested ahead of the peer.
+  void requestAhead();
+
+  /// A payload held until the peer allows it: its frame, or the payload when
+  /// it couldn't be serialized ahead.
+  struct HeldPayload {
+    std::unique_ptr<folly::IOBuf> frame;
+    Payload payload;
+  };
+  std::vector<HeldPayload> held_;
+  /// At most this many payloads are requested ahead of the peer and held.
+  uint16_t serializeAhead_{0};
+  /// Payloads requested ahead of the peer which the producer didn't deliver
+  /// yet...
+  uint16_t aheadRequested_{0};
+  /// ...and how many of those the peer allowed since.
+  uint16_t aheadAllowed_{0};
+  /// The producer completed, the stream completes once held_ is written.
+  bool completeHeld_{false};
 };
 }
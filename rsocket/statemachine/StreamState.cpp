@@ -13,25 +13,127 @@ StreamState::~StreamState() {
 }
 
 void StreamState::enqueueOutputPendingFrame(
-    std::unique_ptr<folly::IOBuf> frame) {
+    std::unique_ptr<folly::IOBuf> frame,
+    StreamId streamId) {
   auto length = frame->computeChainDataLength();
   stats_.streamBufferChanged(1, static_cast<int64_t>(length));
+
+  auto const spill = !spilledFrames_.empty() ||
+      (limits_.policy == PendingFrameLimits::Policy::SPILL_TO_FILE &&
+       isOutputPendingFull());
+  if (spill && spilledFrames_.push(*frame)) {
+    spilledLength_ += length;
+    return;
+  }
+  // Memory is the fallback when the frame can't be spilled, at the cost of
+  // its order against the spilled frames of the same stream.
   dataLength_ += length;
-  outputFrames_.push_back(std::move(frame));
+  outputFrames_.enqueue(streamId, std::move(frame));
+}
+
+void StreamState::enqueueOutputPendingMetadataPush(
+    std::unique_ptr<folly::IOBuf> frame,
+    const std::string& key) {
+  auto const queued = frame.get();
+  auto it = latestMetadataPush_.find(key);
+  if (it != latestMetadataPush_.end()) {
+    auto const length = frame->computeChainDataLength();
+    if (outputFrames_.replaceConnectionFrame(it->second, frame)) {
+      // `frame` is the superseded one now.
+      auto const replaced = frame->computeChainDataLength();
+      stats_.streamBufferChanged(
+          0, static_cast<int64_t>(length) - static_cast<int64_t>(replaced));
+      dataLength_ = dataLength_ - replaced + length;
+      it->second = queued;
+      return;
+    }
+    latestMetadataPush_.erase(it);
+  }
+  auto const numSpilled = spilledFrames_.size();
+  enqueueOutputPendingFrame(std::move(frame));
+  if (spilledFrames_.size() == numSpilled) {
+    latestMetadataPush_.emplace(key, queued);
+  }
+}
+
+bool StreamState::isOutputPendingFull() const {
+  return outputFrames_.size() >= limits_.maxFrames ||
+      dataLength_ >= limits_.maxBytes;
+}
+
+StreamId StreamState::dropOldestOutputPendingStream() {
+  auto const streamId = outputFrames_.oldestStream();
+  if (streamId == 0) {
+    return 0;
+  }
+  auto frames = outputFrames_.dropStream(streamId);
+  uint64_t length = 0;
+  for (auto& frame : frames) {
+    length += frame->computeChainDataLength();
+  }
+  stats_.streamBufferChanged(
+      -static_cast<int64_t>(frames.size()), -static_cast<int64_t>(length));
+  dataLength_ -= length;
+  return streamId;
 }
 
 std::deque<std::unique_ptr<folly::IOBuf>>
 StreamState::moveOutputPendingFrames() {
   onClearFrames();
-  return std::move(outputFrames_);
+  latestMetadataPush_.clear();
+  std::deque<std::unique_ptr<folly::IOBuf>> frames;
+  while (auto frame = outputFrames_.dequeue()) {
+    frames.push_back(std::move(frame));
+  }
+  while (auto frame = spilledFrames_.pop()) {
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+std::unique_ptr<folly::IOBuf> StreamState::dequeueOutputPendingFrame() {
+  if (auto frame = outputFrames_.dequeue()) {
+    if (!latestMetadataPush_.empty()) {
+      forgetMetadataPush(frame.get());
+    }
+    auto length = frame->computeChainDataLength();
+    stats_.streamBufferChanged(-1, -static_cast<int64_t>(length));
+    dataLength_ -= length;
+    return frame;
+  }
+  if (spilledFrames_.empty()) {
+    return nullptr;
+  }
+  auto const numSpilled = spilledFrames_.size();
+  auto frame = spilledFrames_.pop();
+  // The rest of the file is lost when a frame can't be read back.
+  auto const length = spilledFrames_.empty() ? spilledLength_
+                                             : frame->computeChainDataLength();
+  stats_.streamBufferChanged(
+      -static_cast<int64_t>(numSpilled - spilledFrames_.size()),
+      -static_cast<int64_t>(length));
+  spilledLength_ -= length;
+  return frame;
+}
+
+void StreamState::forgetMetadataPush(const folly::IOBuf* frame) {
+  for (auto it = latestMetadataPush_.begin(); it != latestMetadataPush_.end();
+       ++it) {
+    if (it->second == frame) {
+      latestMetadataPush_.erase(it);
+      return;
+    }
+  }
 }
 
 void StreamState::onClearFrames() {
-  auto numFrames = outputFrames_.size();
+  auto numFrames = outputFrames_.size() + spilledFrames_.size();
   if (numFrames != 0) {
     stats_.streamBufferChanged(
-        -static_cast<int64_t>(numFrames), -static_cast<int64_t>(dataLength_));
+        -static_cast<int64_t>(numFrames),
+        -static_cast<int64_t>(dataLength_ + spilledLength_));
     dataLength_ = 0;
+    spilledLength_ = 0;
   }
 }
 }
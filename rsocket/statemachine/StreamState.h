@@ -5,8 +5,13 @@
 #include <folly/io/IOBuf.h>
 #include <stdint.h>
 #include <deque>
+#include <string>
 #include <unordered_map>
 
+#include "rsocket/RSocketParameters.h"
+#include "rsocket/internal/FrameSpillFile.h"
+#include "rsocket/internal/OutputScheduler.h"
+#include "rsocket/internal/StreamTable.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/Refcounted.h"
 
@@ -21,22 +26,97 @@ class StreamState {
   explicit StreamState(RSocketStats& stats);
   ~StreamState();
 
-  void enqueueOutputPendingFrame(std::unique_ptr<folly::IOBuf> frame);
+  void setPendingFrameLimits(PendingFrameLimits limits) {
+    limits_ = limits;
+  }
 
+  const PendingFrameLimits& pendingFrameLimits() const {
+    return limits_;
+  }
+
+  /// Buffers a frame of the stream until the connection can send it.  Frames
+  /// of stream 0 are connection frames.  With the SPILL_TO_FILE policy the
+  /// frames go to a file once the buffer is full, and keep going there until
+  /// the file has been drained.  Spilled frames are sent in the order they
+  /// were buffered, regardless of their priority.
+  void enqueueOutputPendingFrame(
+      std::unique_ptr<folly::IOBuf> frame,
+      StreamId streamId = 0);
+
+  /// Buffers a METADATA_PUSH frame in place of the one buffered with the same
+  /// `key`, if that one is still waiting in memory, so that only the latest
+  /// metadata of each key is sent once the connection can send frames.
+  void enqueueOutputPendingMetadataPush(
+      std::unique_ptr<folly::IOBuf> frame,
+      const std::string& key);
+
+  /// Whether the frames buffered in memory reach the pending frame limits.
+  bool isOutputPendingFull() const;
+
+  /// Data length of the frames buffered in memory, not counting the spilled
+  /// ones.
+  uint64_t outputPendingBytes() const {
+    return dataLength_;
+  }
+
+  /// Number of the frames buffered in memory.
+  size_t outputPendingFrames() const {
+    return outputFrames_.size();
+  }
+
+  /// Drops the buffered frames of the oldest stream which has any.  Returns
+  /// the id of the stream, or 0 if only connection frames are buffered.
+  StreamId dropOldestOutputPendingStream();
+
+  /// Returns the buffered frames, in the order given by the priorities of their
+  /// streams.
   std::deque<std::unique_ptr<folly::IOBuf>> moveOutputPendingFrames();
 
-  std::unordered_map<StreamId, yarpl::Reference<StreamStateMachineBase>>
-      streams_;
+  /// Returns the next buffered frame, or nullptr if there is none.
+  std::unique_ptr<folly::IOBuf> dequeueOutputPendingFrame();
+
+  /// Frees the spare capacity of the buffers of the frames and of the stream
+  /// table, e.g. on an idle connection.  It is allocated again as needed.
+  void releaseBuffers() {
+    outputFrames_.shrinkToFit();
+    streams_.releaseEmptySlots();
+  }
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) {
+    outputFrames_.setPriority(streamId, priority);
+  }
+
+  void clearStreamPriority(StreamId streamId) {
+    outputFrames_.clearPriority(streamId);
+  }
+
+  StreamTable<yarpl::Reference<StreamStateMachineBase>> streams_;
 
  private:
   /// Called to update stats when outputFrames_ is about to be cleared.
   void onClearFrames();
 
+  /// Removes a frame dequeued from outputFrames_ from latestMetadataPush_.
+  void forgetMetadataPush(const folly::IOBuf* frame);
+
   RSocketStats& stats_;
 
   /// Total data length of all IOBufs in outputFrames_.
   uint64_t dataLength_{0};
 
-  std::deque<std::unique_ptr<folly::IOBuf>> outputFrames_;
+  /// Total data length of the frames in spilledFrames_.
+  uint64_t spilledLength_{0};
+
+  PendingFrameLimits limits_;
+
+  OutputScheduler outputFrames_;
+
+  /// The frames enqueueOutputPendingMetadataPush() buffered in outputFrames_,
+  /// by key, until they are dequeued.
+  std::unordered_map<std::string, const folly::IOBuf*> latestMetadataPush_;
+
+  /// Frames buffered after outputFrames_ filled up, with the SPILL_TO_FILE
+  /// policy.  They come out after the ones in outputFrames_.
+  FrameSpillFile spilledFrames_;
 };
 }
@@ -49,6 +49,15 @@ void StreamStateMachineBase::writePayload(Payload&& payload, bool complete) {
   writer_->writePayload(std::move(frame));
 }
 
+void StreamStateMachineBase::writePayloads(std::vector<Payload> payloads) {
+  std::vector<Frame_PAYLOAD> frames;
+  frames.reserve(payloads.size());
+  for (auto& payload : payloads) {
+    frames.emplace_back(streamId_, FrameFlags::NEXT, std::move(payload));
+  }
+  writer_->writePayloads(std::move(frames));
+}
+
 void StreamStateMachineBase::writeRequestN(uint32_t n) {
   writer_->writeRequestN(Frame_REQUEST_N{streamId_, n});
 }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <folly/ExceptionWrapper.h>
 
@@ -35,8 +36,16 @@ class StreamStateMachineBase : public virtual yarpl::Refcounted {
   virtual void handleError(folly::exception_wrapper errorPayload);
   virtual void handleCancel();
 
+  /// Cancels the request of a requester as its subscriber would, see
+  /// RSocketStateMachine::cancelStreamGroup().  Nothing for the responders.
+  virtual void cancelRequest() {}
+
   virtual size_t getConsumerAllowance() const;
 
+  /// Called when the connection starts or stops accepting more output without
+  /// buffering it.  Producers should not emit more while it is not writable.
+  virtual void connectionWritabilityChanged(bool /*writable*/) {}
+
   /// Indicates a terminal signal from the connection.
   ///
   /// This signal corresponds to Subscriber::{onComplete,onError} and
@@ -61,6 +70,7 @@ class StreamStateMachineBase : public virtual yarpl::Refcounted {
       Payload payload,
       bool completed = false);
   void writePayload(Payload&& payload, bool complete);
+  void writePayloads(std::vector<Payload> payloads);
   void writeRequestN(uint32_t n);
   void applicationError(std::string errorPayload);
   void errorStream(std::string errorPayload);
@@ -2,6 +2,8 @@
 
 #include "rsocket/statemachine/StreamsFactory.h"
 
+#include "rsocket/RSocketErrors.h"
+#include "rsocket/RequestGroup.h"
 #include "rsocket/statemachine/ChannelRequester.h"
 #include "rsocket/statemachine/ChannelResponder.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
@@ -21,55 +23,91 @@ StreamsFactory::StreamsFactory(
     RSocketStateMachine& connection,
     RSocketMode mode)
     : connection_(connection),
-      nextStreamId_(
+      firstStreamId_(
           mode == RSocketMode::CLIENT
               ? 1 /*Streams initiated by a client MUST use
                     odd-numbered stream identifiers*/
               : 2 /*streams initiated by the server MUST use
-                    even-numbered stream identifiers*/) {}
+                    even-numbered stream identifiers*/),
+      nextStreamId_(firstStreamId_) {}
+
+static folly::exception_wrapper disconnectedError() {
+  return std::runtime_error("state machine is disconnected/closed");
+}
 
 static void subscribeToErrorFlowable(
-    Reference<yarpl::flowable::Subscriber<Payload>> responseSink) {
-  yarpl::flowable::Flowables::error<Payload>(
-      std::runtime_error("state machine is disconnected/closed"))
+    Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
+    folly::exception_wrapper ex = disconnectedError()) {
+  yarpl::flowable::Flowables::error<Payload>(std::move(ex))
       ->subscribe(std::move(responseSink));
 }
 
 static void subscribeToErrorSingle(
-    Reference<yarpl::single::SingleObserver<Payload>> responseSink) {
-  yarpl::single::Singles::error<Payload>(
-      std::runtime_error("state machine is disconnected/closed"))
+    Reference<yarpl::single::SingleObserver<Payload>> responseSink,
+    folly::exception_wrapper ex = disconnectedError()) {
+  yarpl::single::Singles::error<Payload>(std::move(ex))
       ->subscribe(std::move(responseSink));
 }
 
 Reference<yarpl::flowable::Subscriber<Payload>>
 StreamsFactory::createChannelRequester(
-    Reference<yarpl::flowable::Subscriber<Payload>> responseSink) {
+    Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
+    const RequestOptions& options) {
   if (connection_.isDisconnected()) {
     subscribeToErrorFlowable(std::move(responseSink));
     return nullptr;
   }
+  if (connection_.rejectsNewStreams()) {
+    subscribeToErrorFlowable(
+        std::move(responseSink), PendingFramesFullError(""));
+    return nullptr;
+  }
+  if (!connection_.acquireLease()) {
+    subscribeToErrorFlowable(std::move(responseSink), NoLeaseError(""));
+    return nullptr;
+  }
 
   auto const streamId = getNextStreamId();
   auto stateMachine = yarpl::make_ref<ChannelRequester>(
       connection_.shared_from_this(), streamId);
+  stateMachine->setRequestNBatching(connection_.requestNBatching());
   connection_.addStream(streamId, stateMachine);
+  applyOptions(streamId, options, StreamPriority::Class::BULK);
   stateMachine->subscribe(std::move(responseSink));
   return stateMachine;
 }
 
 void StreamsFactory::createStreamRequester(
     Payload request,
-    Reference<yarpl::flowable::Subscriber<Payload>> responseSink) {
+    Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
+    const RequestOptions& options,
+    StreamRequesterFactory makeRequester) {
   if (connection_.isDisconnected()) {
     subscribeToErrorFlowable(std::move(responseSink));
     return;
   }
+  if (connection_.rejectsNewStreams()) {
+    subscribeToErrorFlowable(
+        std::move(responseSink), PendingFramesFullError(""));
+    return;
+  }
+  if (!connection_.acquireLease()) {
+    subscribeToErrorFlowable(std::move(responseSink), NoLeaseError(""));
+    return;
+  }
 
   auto const streamId = getNextStreamId();
-  auto stateMachine = yarpl::make_ref<StreamRequester>(
-      connection_.shared_from_this(), streamId, std::move(request));
+  auto stateMachine = makeRequester
+      ? makeRequester(
+            connection_.shared_from_this(), streamId, std::move(request))
+      : yarpl::make_ref<StreamRequester>(
+            connection_.shared_from_this(), streamId, std::move(request));
+  stateMachine->setRequestNBatching(connection_.requestNBatching());
+  if (auto const& tuner = connection_.requestNWindowTuner()) {
+    stateMachine->setWindowTuner(tuner);
+  }
   connection_.addStream(streamId, stateMachine);
+  applyOptions(streamId, options, StreamPriority::Class::BULK);
   stateMachine->subscribe(std::move(responseSink));
 }
 
@@ -84,6 +122,7 @@ void StreamsFactory::createStreamRequester(
 
   auto stateMachine = yarpl::make_ref<StreamRequester>(
       connection_.shared_from_this(), streamId, Payload());
+  stateMachine->setRequestNBatching(connection_.requestNBatching());
   // Set requested to true (since cold resumption)
   stateMachine->setRequested(n);
   connection_.addStream(streamId, stateMachine);
@@ -92,31 +131,118 @@ void StreamsFactory::createStreamRequester(
 
 void StreamsFactory::createRequestResponseRequester(
     Payload payload,
-    Reference<yarpl::single::SingleObserver<Payload>> responseSink) {
+    Reference<yarpl::single::SingleObserver<Payload>> responseSink,
+    const RequestOptions& options) {
   if (connection_.isDisconnected()) {
     subscribeToErrorSingle(std::move(responseSink));
     return;
   }
+  if (connection_.rejectsNewStreams()) {
+    subscribeToErrorSingle(std::move(responseSink), PendingFramesFullError(""));
+    return;
+  }
+  if (!connection_.acquireLease()) {
+    subscribeToErrorSingle(std::move(responseSink), NoLeaseError(""));
+    return;
+  }
 
   auto const streamId = getNextStreamId();
   auto stateMachine = yarpl::make_ref<RequestResponseRequester>(
       connection_.shared_from_this(), streamId, std::move(payload));
   connection_.addStream(streamId, stateMachine);
+  applyOptions(streamId, options, StreamPriority::Class::INTERACTIVE);
   stateMachine->subscribe(std::move(responseSink));
 }
 
+void StreamsFactory::createRequestResponseRequester(
+    Payload payload,
+    folly::Promise<Payload> response,
+    const RequestOptions& options) {
+  if (connection_.isDisconnected()) {
+    response.setException(disconnectedError());
+    return;
+  }
+  if (connection_.rejectsNewStreams()) {
+    response.setException(PendingFramesFullError(""));
+    return;
+  }
+  if (!connection_.acquireLease()) {
+    response.setException(NoLeaseError(""));
+    return;
+  }
+
+  auto const streamId = getNextStreamId();
+  auto stateMachine = yarpl::make_ref<RequestResponseRequester>(
+      connection_.shared_from_this(), streamId, std::move(payload));
+  connection_.addStream(streamId, stateMachine);
+  applyOptions(streamId, options, StreamPriority::Class::INTERACTIVE);
+  stateMachine->subscribe(std::move(response));
+}
+
+void StreamsFactory::applyOptions(
+    StreamId streamId,
+    const RequestOptions& options,
+    StreamPriority::Class defaultClass) {
+  connection_.setStreamPriority(
+      streamId, options.priority.value_or(StreamPriority(defaultClass)));
+  if (options.timeout) {
+    connection_.setStreamTimeout(
+        streamId, *options.timeout, options.propagateTimeout);
+  }
+  connection_.setStreamTrace(
+      streamId, options.traceParent, options.propagateTrace);
+  if (options.group) {
+    connection_.setStreamGroup(streamId, options.group->id());
+  }
+}
+
 StreamId StreamsFactory::getNextStreamId() {
-  StreamId streamId = nextStreamId_;
-  CHECK(streamId <= std::numeric_limits<int32_t>::max() - 2);
-  nextStreamId_ += 2;
-  return streamId;
+  return getNextStreamIds(1);
+}
+
+StreamId StreamsFactory::getNextStreamIds(size_t n) {
+  constexpr auto kMaxStreamId =
+      static_cast<size_t>(std::numeric_limits<int32_t>::max());
+  CHECK_LE(n, kMaxStreamId / 2);
+  if (n == 0) {
+    return nextStreamId_;
+  }
+  size_t streamId = nextStreamId_;
+  // Bounds the search for free ids, which only fails with as many streams
+  // open as the id space has room for.
+  size_t probes = 0;
+  while (true) {
+    if (streamId + 2 * (n - 1) > kMaxStreamId) {
+      VLOG(1) << "Stream ids wrap around after " << streamId;
+      streamId = firstStreamId_;
+      streamIdsWrapped_ = true;
+    }
+    if (!streamIdsWrapped_ || areStreamIdsFree(streamId, n)) {
+      break;
+    }
+    CHECK_LT(++probes, kMaxStreamId) << "No stream ids left";
+    streamId += 2;
+  }
+  nextStreamId_ = static_cast<StreamId>(streamId + 2 * n);
+  return static_cast<StreamId>(streamId);
+}
+
+bool StreamsFactory::areStreamIdsFree(StreamId streamId, size_t n) const {
+  for (size_t i = 0; i < n; ++i) {
+    if (connection_.hasStream(static_cast<StreamId>(streamId + 2 * i))) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void StreamsFactory::setNextStreamId(StreamId streamId) {
   nextStreamId_ = streamId + 2;
 }
 
-bool StreamsFactory::registerNewPeerStreamId(StreamId streamId) {
+bool StreamsFactory::registerNewPeerStreamId(
+    StreamId streamId,
+    bool newStream) {
   DCHECK(streamId != 0);
   if (nextStreamId_ % 2 == streamId % 2) {
     // if this is an unknown stream to the socket and this socket is
@@ -126,7 +252,14 @@ bool StreamsFactory::registerNewPeerStreamId(StreamId streamId) {
     return false;
   }
   if (streamId <= lastPeerStreamId_) {
-    // receiving frame for a stream which no longer exists
+    if (!newStream) {
+      // receiving frame for a stream which no longer exists
+      return false;
+    }
+    // the peer started again from its first stream id
+    peerStreamIdsWrapped_ = true;
+  } else if (!newStream && peerStreamIdsWrapped_) {
+    // may be a late frame of a stream which had the id before
     return false;
   }
   lastPeerStreamId_ = streamId;
@@ -138,6 +271,7 @@ Reference<ChannelResponder> StreamsFactory::createChannelResponder(
     StreamId streamId) {
   auto stateMachine = yarpl::make_ref<ChannelResponder>(
       connection_.shared_from_this(), streamId, initialRequestN);
+  stateMachine->setRequestNBatching(connection_.requestNBatching());
   connection_.addStream(streamId, stateMachine);
   return stateMachine;
 }
@@ -148,6 +282,7 @@ StreamsFactory::createStreamResponder(
     StreamId streamId) {
   auto stateMachine = yarpl::make_ref<StreamResponder>(
       connection_.shared_from_this(), streamId, initialRequestN);
+  stateMachine->setSerializeAhead(connection_.streamSerializeAhead());
   connection_.addStream(streamId, stateMachine);
   return stateMachine;
 }
@@ -157,6 +292,8 @@ StreamsFactory::createRequestResponseResponder(StreamId streamId) {
   auto stateMachine = yarpl::make_ref<RequestResponseResponder>(
       connection_.shared_from_this(), streamId);
   connection_.addStream(streamId, stateMachine);
+  connection_.setStreamPriority(
+      streamId, StreamPriority(StreamPriority::Class::INTERACTIVE));
   return stateMachine;
 }
 }
@@ -2,6 +2,11 @@
 
 #pragma once
 
+#include <memory>
+
+#include <folly/futures/Promise.h>
+
+#include "rsocket/RequestOptions.h"
 #include "rsocket/internal/Common.h"
 #include "yarpl/flowable/Subscriber.h"
 #include "yarpl/flowable/Subscription.h"
@@ -15,18 +20,32 @@ namespace rsocket {
 
 class RSocketStateMachine;
 class ChannelResponder;
+class StreamRequester;
+class StreamsWriter;
 struct Payload;
 
+/// Creates the state machine of a stream requester, e.g.
+/// TypedStreamRequester<S>::make.
+using StreamRequesterFactory = yarpl::Reference<StreamRequester> (*)(
+    std::shared_ptr<StreamsWriter> writer,
+    StreamId streamId,
+    Payload payload);
+
 class StreamsFactory {
  public:
   StreamsFactory(RSocketStateMachine& connection, RSocketMode mode);
 
   yarpl::Reference<yarpl::flowable::Subscriber<Payload>> createChannelRequester(
-      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> responseSink);
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
+      const RequestOptions& options = RequestOptions());
 
+  /// `makeRequester` creates the state machine, a plain StreamRequester if
+  /// null.
   void createStreamRequester(
       Payload request,
-      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> responseSink);
+      yarpl::Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
+      const RequestOptions& options = RequestOptions(),
+      StreamRequesterFactory makeRequester = nullptr);
 
   void createStreamRequester(
       yarpl::Reference<yarpl::flowable::Subscriber<Payload>> responseSink,
@@ -35,7 +54,13 @@ class StreamsFactory {
 
   void createRequestResponseRequester(
       Payload payload,
-      yarpl::Reference<yarpl::single::SingleObserver<Payload>> responseSink);
+      yarpl::Reference<yarpl::single::SingleObserver<Payload>> responseSink,
+      const RequestOptions& options = RequestOptions());
+
+  void createRequestResponseRequester(
+      Payload payload,
+      folly::Promise<Payload> response,
+      const RequestOptions& options = RequestOptions());
 
   // TODO: the return type should not be the stateMachine type, but something
   // generic
@@ -50,14 +75,63 @@ class StreamsFactory {
   yarpl::Reference<yarpl::single::SingleObserver<Payload>>
   createRequestResponseResponder(StreamId streamId);
 
-  bool registerNewPeerStreamId(StreamId streamId);
+  /// Whether a frame for a stream the connection doesn't have starts a new
+  /// stream of the peer, rather than being a late frame of a stream which
+  /// ended.  `newStream` tells whether it is a request frame.  Past the
+  /// largest stream id the peer starts again from its first id, and the
+  /// request frames with lower ids than the last one start new streams.
+  bool registerNewPeerStreamId(StreamId streamId, bool newStream);
+
+  /// Allocates a stream id of this side.  Once the largest stream id has been
+  /// used, the ids start again from the first one, skipping those of the
+  /// streams still open, so that a connection can live indefinitely.  An id
+  /// is only used again after the rest of the id space, so the late frames
+  /// of the stream which had it are long gone.
   StreamId getNextStreamId();
 
+  /// Allocates `n` consecutive stream ids of this side and returns the first
+  /// of them.  The others follow in steps of 2.
+  StreamId getNextStreamIds(size_t n);
+
+  /// Whether the stream was started by this side of the connection.
+  bool isLocalStreamId(StreamId streamId) const {
+    return nextStreamId_ % 2 == streamId % 2;
+  }
+
   void setNextStreamId(StreamId streamId);
 
+  StreamId nextStreamId() const {
+    return nextStreamId_;
+  }
+
+  StreamId lastPeerStreamId() const {
+    return lastPeerStreamId_;
+  }
+
+  /// Continues the ids of a connection handed over by another host.
+  void restoreStreamIds(StreamId nextStreamId, StreamId lastPeerStreamId) {
+    nextStreamId_ = nextStreamId;
+    lastPeerStreamId_ = lastPeerStreamId;
+  }
+
  private:
+  /// Applies the priority of the options, or the default of the interaction
+  /// model if they don't have one, and their timeout.
+  void applyOptions(
+      StreamId streamId,
+      const RequestOptions& options,
+      StreamPriority::Class defaultClass);
+
+  /// Whether none of the `n` ids from `streamId` are in use.
+  bool areStreamIdsFree(StreamId streamId, size_t n) const;
+
   RSocketStateMachine& connection_;
+  /// The first stream id of this side, 1 for clients and 2 for servers.
+  const StreamId firstStreamId_;
   StreamId nextStreamId_;
   StreamId lastPeerStreamId_{0};
+  /// Set once the ids of this side, or of the peer, have wrapped around.
+  bool streamIdsWrapped_{false};
+  bool peerStreamIdsWrapped_{false};
 };
 } // reactivesocket
@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "rsocket/Payload.h"
+#include "rsocket/framing/Frame.h"
 #include "rsocket/internal/Common.h"
 
 namespace rsocket {
@@ -23,6 +27,23 @@ class StreamsWriter {
   virtual void writeCancel(Frame_CANCEL&&) = 0;
 
   virtual void writePayload(Frame_PAYLOAD&&) = 0;
+  /// Writes several payload frames at once, in order.
+  virtual void writePayloads(std::vector<Frame_PAYLOAD> frames) {
+    for (auto& frame : frames) {
+      writePayload(std::move(frame));
+    }
+  }
+  /// Serializes a payload frame ahead of writing it with
+  /// writeSerializedPayloads().  Returns null, leaving the frame as it was,
+  /// when it has to be written with writePayload().
+  virtual std::unique_ptr<folly::IOBuf> serializePayload(Frame_PAYLOAD&) {
+    return nullptr;
+  }
+  /// Writes NEXT frames of serializePayload() which don't complete their
+  /// stream, in order.
+  virtual void writeSerializedPayloads(
+      StreamId,
+      std::vector<std::unique_ptr<folly::IOBuf>>) {}
   virtual void writeError(Frame_ERROR&&) = 0;
 
   virtual void onStreamClosed(StreamId, StreamCompletionSignal) = 0;
@@ -0,0 +1,108 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/quic/QuicConnectionAcceptor.h"
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+#include <quic/server/QuicServerTransport.h>
+#include <quic/server/QuicServerTransportFactory.h>
+
+#include "rsocket/transports/quic/QuicHandshake.h"
+
+namespace rsocket {
+
+/// Makes the transport of each new connection of the QuicServer, on one of
+/// its worker EventBases, and hands the connection over once it is ready.
+class QuicConnectionAcceptor::TransportFactory
+    : public quic::QuicServerTransportFactory {
+ public:
+  TransportFactory(
+      OnDuplexConnectionAccept onAccept,
+      QuicStreamMapping mapping,
+      std::shared_ptr<RSocketStats> stats)
+      : onAccept_(std::move(onAccept)),
+        mapping_(mapping),
+        stats_(std::move(stats)) {}
+
+  quic::QuicServerTransport::Ptr make(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> socket,
+      const folly::SocketAddress&,
+      quic::QuicVersion,
+      std::shared_ptr<const fizz::server::FizzServerContext> ctx) noexcept
+      override {
+    auto handshake = std::make_shared<QuicHandshake>(
+        *evb,
+        false,
+        mapping_,
+        stats_,
+        [ evb, onAccept = onAccept_ ](
+            folly::Try<std::unique_ptr<QuicDuplexConnection>> result) {
+          if (result.hasException()) {
+            VLOG(2) << "QUIC connection not accepted: "
+                    << result.exception().what();
+            return;
+          }
+          onAccept(std::move(result.value()), *evb);
+        });
+    auto transport = quic::QuicServerTransport::make(
+        evb,
+        std::move(socket),
+        handshake.get(),
+        handshake.get(),
+        std::move(ctx));
+    handshake->watch(
+        transport,
+        std::make_unique<QuicDuplexConnection>(
+            transport, false, mapping_, stats_));
+    return transport;
+  }
+
+ private:
+  const OnDuplexConnectionAccept onAccept_;
+  const QuicStreamMapping mapping_;
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+QuicConnectionAcceptor::QuicConnectionAcceptor(
+    Options options,
+    std::shared_ptr<const fizz::server::FizzServerContext> fizzContext)
+    : options_(std::move(options)), fizzContext_(std::move(fizzContext)) {}
+
+QuicConnectionAcceptor::~QuicConnectionAcceptor() {
+  if (server_) {
+    stop();
+  }
+}
+
+void QuicConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  CHECK(!server_) << "QuicConnectionAcceptor::start() already called";
+  CHECK_GT(options_.threads, 0U);
+
+  server_ = quic::QuicServer::createQuicServer();
+  server_->setQuicServerTransportFactory(std::make_unique<TransportFactory>(
+      std::move(onAccept), options_.mapping, options_.stats));
+  server_->setFizzContext(fizzContext_);
+  server_->setTransportSettings(options_.transportSettings);
+  server_->start(options_.address, options_.threads);
+  server_->waitUntilInitialized();
+
+  VLOG(1) << "QuicConnectionAcceptor listening on "
+          << server_->getAddress().describe();
+}
+
+void QuicConnectionAcceptor::stop() {
+  VLOG(1) << "Shutting down QuicConnectionAcceptor";
+  if (auto server = std::move(server_)) {
+    server->shutdown();
+  }
+}
+
+folly::Optional<uint16_t> QuicConnectionAcceptor::listeningPort() const {
+  if (!server_) {
+    return folly::none;
+  }
+  return server_->getAddress().getPort();
+}
+
+} // namespace rsocket
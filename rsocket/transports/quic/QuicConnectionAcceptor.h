@@ -0,0 +1,73 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <fizz/server/FizzServerContext.h>
+#include <folly/SocketAddress.h>
+#include <quic/server/QuicServer.h>
+#include <quic/state/TransportSettings.h>
+
+#include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+namespace rsocket {
+
+/**
+ * QUIC implementation of ConnectionAcceptor for use with
+ * RSocket::createServer, on the quic::QuicServer of mvfst.  Connections are
+ * handed over once their TLS handshake, with the context given, completes.
+ * They only carry protocol 1.0.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class QuicConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    explicit Options(uint16_t port_ = 8080, size_t threads_ = 2)
+        : address("::", port_), threads(threads_) {}
+
+    /// Address to listen on.
+    folly::SocketAddress address;
+
+    /// Number of worker threads processing requests.
+    size_t threads;
+
+    /// How the accepted connections spread the RSocket streams over QUIC
+    /// streams.  See QuicStreamMapping.
+    QuicStreamMapping mapping;
+
+    quic::TransportSettings transportSettings;
+
+    std::shared_ptr<RSocketStats> stats{RSocketStats::noop()};
+  };
+
+  QuicConnectionAcceptor(
+      Options,
+      std::shared_ptr<const fizz::server::FizzServerContext> fizzContext);
+  ~QuicConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Bind the UDP sockets of a QuicServer and start accepting connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Shutdown the QuicServer.
+   */
+  void stop() override;
+
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  class TransportFactory;
+
+  Options options_;
+  const std::shared_ptr<const fizz::server::FizzServerContext> fizzContext_;
+  std::shared_ptr<quic::QuicServer> server_;
+};
+} // namespace rsocket
@@ -0,0 +1,81 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/quic/QuicConnectionFactory.h"
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/client/QuicClientTransport.h>
+
+#include "rsocket/transports/quic/QuicHandshake.h"
+
+namespace rsocket {
+
+QuicConnectionFactory::QuicConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    std::string hostname,
+    std::shared_ptr<quic::ClientHandshakeFactory> handshakeFactory,
+    QuicStreamMapping mapping,
+    quic::TransportSettings transportSettings)
+    : eventBase_(&eventBase),
+      address_(std::move(address)),
+      hostname_(std::move(hostname)),
+      handshakeFactory_(std::move(handshakeFactory)),
+      mapping_(mapping),
+      transportSettings_(std::move(transportSettings)) {
+  VLOG(1) << "Constructing QuicConnectionFactory";
+}
+
+QuicConnectionFactory::~QuicConnectionFactory() {
+  VLOG(1) << "Destroying QuicConnectionFactory";
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+QuicConnectionFactory::connect() {
+  return connectOn(*eventBase_);
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+QuicConnectionFactory::connectOn(folly::EventBase& eventBase) {
+  folly::Promise<ConnectedDuplexConnection> promise;
+  auto future = promise.getFuture();
+
+  eventBase.runInEventBaseThread([
+    evb = &eventBase,
+    address = address_,
+    hostname = hostname_,
+    handshakeFactory = handshakeFactory_,
+    mapping = mapping_,
+    transportSettings = transportSettings_,
+    promise = std::move(promise)
+  ]() mutable {
+    auto handshake = std::make_shared<QuicHandshake>(
+        *evb,
+        true,
+        mapping,
+        RSocketStats::noop(),
+        [ evb, promise = std::move(promise) ](
+            folly::Try<std::unique_ptr<QuicDuplexConnection>> result) mutable {
+          if (result.hasException()) {
+            promise.setException(std::move(result.exception()));
+            return;
+          }
+          promise.setValue(
+              ConnectedDuplexConnection{std::move(result.value()), *evb});
+        });
+
+    auto transport = quic::QuicClientTransport::newClient(
+        evb,
+        std::make_unique<folly::AsyncUDPSocket>(evb),
+        std::move(handshakeFactory));
+    transport->setHostname(hostname);
+    transport->addNewPeerAddress(address);
+    transport->setTransportSettings(std::move(transportSettings));
+    handshake->watch(transport);
+    transport->start(handshake.get(), handshake.get());
+  });
+
+  return future;
+}
+
+} // namespace rsocket
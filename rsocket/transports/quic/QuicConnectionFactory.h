@@ -0,0 +1,51 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <folly/SocketAddress.h>
+#include <quic/client/handshake/ClientHandshakeFactory.h>
+#include <quic/state/TransportSettings.h>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+namespace rsocket {
+
+/**
+ * QUIC implementation of ConnectionFactory for use with
+ * RSocket::createClient(), on mvfst.  Each connect() makes a new QUIC
+ * connection, with the TLS handshake of `handshakeFactory` (e.g. a
+ * quic::FizzClientQuicHandshakeContext), which completes before connect()
+ * does.  The connections only carry protocol 1.0.
+ *
+ * Over a lossy network, QuicStreamMapping::interactiveStreams keeps the
+ * INTERACTIVE streams from waiting on the retransmissions of the others.
+ */
+class QuicConnectionFactory : public ConnectionFactory {
+ public:
+  QuicConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      std::string hostname,
+      std::shared_ptr<quic::ClientHandshakeFactory> handshakeFactory,
+      QuicStreamMapping mapping = QuicStreamMapping(),
+      quic::TransportSettings transportSettings = quic::TransportSettings());
+  virtual ~QuicConnectionFactory();
+
+  folly::Future<ConnectedDuplexConnection> connect() override;
+
+  folly::Future<ConnectedDuplexConnection> connectOn(
+      folly::EventBase& eventBase) override;
+
+ private:
+  folly::EventBase* eventBase_;
+  const folly::SocketAddress address_;
+  const std::string hostname_;
+  const std::shared_ptr<quic::ClientHandshakeFactory> handshakeFactory_;
+  const QuicStreamMapping mapping_;
+  const quic::TransportSettings transportSettings_;
+};
+} // namespace rsocket
@@ -0,0 +1,595 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/framing/FramedReader.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+namespace {
+
+/// Prepends the frame length field of protocol 1.0 to `frame`.
+std::unique_ptr<folly::IOBuf> withLengthField(
+    std::unique_ptr<folly::IOBuf> frame) {
+  constexpr auto kFieldLength = FrameSerializerV1_0::kFrameLengthFieldLength;
+  auto const length = frame->computeChainDataLength();
+  auto field = folly::IOBuf::create(kFieldLength);
+  auto data = field->writableData();
+  data[0] = static_cast<uint8_t>(length >> 16);
+  data[1] = static_cast<uint8_t>(length >> 8);
+  data[2] = static_cast<uint8_t>(length);
+  field->append(kFieldLength);
+  field->prependChain(std::move(frame));
+  return field;
+}
+
+/// The stream id of a frame of protocol 1.0, 0 if it is too short for one.
+StreamId streamIdOf(const folly::IOBuf& frame) {
+  folly::io::Cursor cur(&frame);
+  uint32_t streamId;
+  return cur.tryReadBE(streamId) ? streamId & 0x7fffffff : 0;
+}
+
+size_t chainLength(const std::vector<std::unique_ptr<folly::IOBuf>>& frames) {
+  size_t bytes = 0;
+  for (auto const& frame : frames) {
+    bytes += frame->computeChainDataLength();
+  }
+  return bytes;
+}
+
+} // namespace
+
+class QuicChannel : public quic::QuicSocket::ConnectionCallback,
+                    public quic::QuicSocket::ReadCallback,
+                    public std::enable_shared_from_this<QuicChannel> {
+ public:
+  QuicChannel(
+      std::shared_ptr<quic::QuicSocket> socket,
+      bool client,
+      QuicStreamMapping mapping)
+      : socket_(std::move(socket)),
+        eventBase_(*folly::EventBaseManager::get()->getExistingEventBase()),
+        client_(client),
+        lanes_(mapping.interactiveStreams) {}
+
+  ~QuicChannel() {
+    DCHECK(closed_);
+    DCHECK(!inputSubscriber_);
+  }
+
+  void start() {
+    socket_->setConnectionCallback(this);
+    if (!client_) {
+      // The main stream comes with onNewBidirectionalStream().
+      return;
+    }
+    auto streamId = socket_->createBidirectionalStream();
+    if (streamId.hasError()) {
+      closeErr(std::runtime_error("Can't open the main QUIC stream"));
+      return;
+    }
+    openMainStream(*streamId);
+  }
+
+  void setInput(
+      yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && closed_) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      inputMultiple_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+    inputMultiple_ = dynamic_cast<DuplexConnection::DuplexSubscriber*>(
+        inputSubscriber_.get());
+
+    // Frames which arrived while there was no subscriber.
+    std::weak_ptr<QuicChannel> weakSelf = shared_from_this();
+    eventBase_.runInLoop([weakSelf = std::move(weakSelf)] {
+      if (auto self = weakSelf.lock()) {
+        auto frames = std::move(self->undelivered_);
+        self->undelivered_.clear();
+        self->deliver(std::move(frames));
+      }
+    });
+  }
+
+  void setOutputSubscription(yarpl::Reference<Subscription> subscription) {
+    if (!subscription) {
+      outputSubscription_ = nullptr;
+      return;
+    }
+
+    if (closed_) {
+      subscription->cancel();
+      return;
+    }
+
+    // No flow control on the output, QUIC buffers what it can't send yet.
+    subscription->request(std::numeric_limits<int64_t>::max());
+    outputSubscription_ = std::move(subscription);
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (closed_ || !checkFrameLength(*frame)) {
+      return;
+    }
+    auto const lane = laneOf(streamIdOf(*frame));
+    write(lane, withLengthField(std::move(frame)));
+  }
+
+  /// Writes the consecutive frames which go to the same QUIC stream together.
+  void sendMultiple(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    std::unique_ptr<folly::IOBuf> chain;
+    size_t chainLane = 0;
+    for (auto& frame : frames) {
+      if (closed_ || !checkFrameLength(*frame)) {
+        return;
+      }
+      auto const lane = laneOf(streamIdOf(*frame));
+      if (chain && lane != chainLane) {
+        write(chainLane, std::move(chain));
+      }
+      chainLane = lane;
+      auto framed = withLengthField(std::move(frame));
+      if (chain) {
+        chain->prependChain(std::move(framed));
+      } else {
+        chain = std::move(framed);
+      }
+    }
+    if (chain && !closed_) {
+      write(chainLane, std::move(chain));
+    }
+  }
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) {
+    if (lanes_.empty() ||
+        priority.priorityClass != StreamPriority::Class::INTERACTIVE) {
+      return;
+    }
+    // The stream ids of each side go by two.
+    streamLanes_[streamId] = 1 + (streamId / 2) % lanes_.size();
+  }
+
+  void clearStreamPriority(StreamId streamId) {
+    streamLanes_.erase(streamId);
+  }
+
+  /// Frames parsed from a QUIC stream.
+  void onFrames(bool main, std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    if (!mainStarted_) {
+      if (!main) {
+        for (auto& frame : frames) {
+          held_.push_back(std::move(frame));
+        }
+        return;
+      }
+      mainStarted_ = true;
+      for (auto& frame : held_) {
+        frames.push_back(std::move(frame));
+      }
+      held_.clear();
+    }
+    deliver(std::move(frames));
+  }
+
+  size_t bufferedBytes() const {
+    size_t bytes = chainLength(held_) + chainLength(undelivered_);
+    for (auto const& reader : readers_) {
+      bytes += reader.second->bufferedBytes();
+    }
+    if (unsentMain_) {
+      bytes += unsentMain_->computeChainDataLength();
+    }
+    return bytes;
+  }
+
+  quic::QuicSocket* socket() const {
+    return socket_.get();
+  }
+
+  void close() {
+    closeWith(folly::exception_wrapper());
+  }
+
+  void closeErr(folly::exception_wrapper ew) {
+    closeWith(std::move(ew));
+  }
+
+  // quic::QuicSocket::ConnectionCallback.
+
+  void onNewBidirectionalStream(quic::StreamId streamId) noexcept override {
+    if (!client_ && !mainStream_) {
+      openMainStream(streamId);
+      return;
+    }
+    socket_->stopSending(streamId, quic::GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId streamId) noexcept override {
+    watchStream(streamId, false);
+  }
+
+  void onStopSending(
+      quic::StreamId streamId,
+      quic::ApplicationErrorCode) noexcept override {
+    closeErr(std::runtime_error(folly::to<std::string>(
+        "The peer stopped reading QUIC stream ", streamId)));
+  }
+
+  void onConnectionEnd() noexcept override {
+    auto self = shared_from_this();
+    close();
+  }
+
+  void onConnectionError(quic::QuicError error) noexcept override {
+    auto self = shared_from_this();
+    closeErr(std::runtime_error(
+        folly::to<std::string>("QUIC connection failed: ", error.message)));
+  }
+
+  // quic::QuicSocket::ReadCallback.
+
+  void readAvailable(quic::StreamId streamId) noexcept override {
+    // The input may close the connection.
+    auto self = shared_from_this();
+    auto it = readers_.find(streamId);
+    if (it == readers_.end()) {
+      return;
+    }
+    auto reader = it->second;
+    auto result = socket_->read(streamId, 0);
+    if (result.hasError()) {
+      closeErr(std::runtime_error(
+          folly::to<std::string>("Can't read QUIC stream ", streamId)));
+      return;
+    }
+    if (result->first && !result->first->empty()) {
+      reader->onNext(std::move(result->first));
+    }
+    if (result->second) {
+      readers_.erase(streamId);
+      if (mainStream_ && streamId == *mainStream_) {
+        // The peer is done with the connection.
+        close();
+      }
+    }
+  }
+
+  void readError(quic::StreamId streamId, quic::QuicError error) noexcept
+      override {
+    auto self = shared_from_this();
+    closeErr(std::runtime_error(folly::to<std::string>(
+        "QUIC stream ", streamId, " failed: ", error.message)));
+  }
+
+ private:
+  void openMainStream(quic::StreamId streamId) {
+    mainStream_ = streamId;
+    watchStream(streamId, true);
+    if (auto unsent = std::move(unsentMain_)) {
+      writeTo(streamId, std::move(unsent));
+    }
+  }
+
+  void watchStream(quic::StreamId streamId, bool main);
+
+  bool checkFrameLength(const folly::IOBuf& frame) {
+    if (frame.computeChainDataLength() <= kMaxFrameLength) {
+      return true;
+    }
+    closeErr(std::runtime_error("Frame too large for its length field"));
+    return false;
+  }
+
+  /// 0 for the main stream, 1 + the index of a QUIC stream of lanes_
+  /// otherwise.
+  size_t laneOf(StreamId streamId) const {
+    auto it = streamLanes_.find(streamId);
+    return it == streamLanes_.end() ? 0 : it->second;
+  }
+
+  void write(size_t lane, std::unique_ptr<folly::IOBuf> bytes) {
+    if (lane == 0) {
+      if (!mainStream_) {
+        // The server only writes after the client opened the main stream, so
+        // this is hardly ever needed.
+        if (unsentMain_) {
+          unsentMain_->prependChain(std::move(bytes));
+        } else {
+          unsentMain_ = std::move(bytes);
+        }
+        return;
+      }
+      writeTo(*mainStream_, std::move(bytes));
+      return;
+    }
+
+    auto& stream = lanes_[lane - 1];
+    if (!stream) {
+      auto streamId = socket_->createUnidirectionalStream();
+      if (streamId.hasError()) {
+        closeErr(std::runtime_error("Can't open a QUIC stream"));
+        return;
+      }
+      stream = *streamId;
+      // Ahead of the main stream, which has the default urgency.
+      socket_->setStreamPriority(*stream, quic::Priority(0, false));
+    }
+    writeTo(*stream, std::move(bytes));
+  }
+
+  void writeTo(quic::StreamId streamId, std::unique_ptr<folly::IOBuf> bytes) {
+    auto result = socket_->writeChain(streamId, std::move(bytes), false);
+    if (result.hasError()) {
+      closeErr(std::runtime_error(
+          folly::to<std::string>("Can't write QUIC stream ", streamId)));
+    }
+  }
+
+  void deliver(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    if (frames.empty()) {
+      return;
+    }
+    if (!inputSubscriber_ || !undelivered_.empty()) {
+      // After the frames waiting for the input.
+      for (auto& frame : frames) {
+        undelivered_.push_back(std::move(frame));
+      }
+      return;
+    }
+    if (frames.size() > 1 && inputMultiple_) {
+      auto input = inputSubscriber_;
+      inputMultiple_->onNextMultiple(std::move(frames));
+      return;
+    }
+    for (auto& frame : frames) {
+      // Dropped once the input canceled.
+      auto input = inputSubscriber_;
+      if (!input) {
+        break;
+      }
+      input->onNext(std::move(frame));
+    }
+  }
+
+  void closeWith(folly::exception_wrapper ew) {
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+
+    for (auto const& reader : readers_) {
+      socket_->setReadCallback(reader.first, nullptr);
+    }
+    readers_.clear();
+    socket_->setConnectionCallback(nullptr);
+    if (ew) {
+      socket_->close(quic::QuicError(
+          quic::GenericApplicationErrorCode::UNKNOWN, ew.what().toStdString()));
+    } else {
+      socket_->close(folly::none);
+    }
+    held_.clear();
+    undelivered_.clear();
+    unsentMain_ = nullptr;
+
+    if (auto subscription = std::move(outputSubscription_)) {
+      subscription->cancel();
+    }
+    inputMultiple_ = nullptr;
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      } else {
+        subscriber->onComplete();
+      }
+    }
+  }
+
+  const std::shared_ptr<quic::QuicSocket> socket_;
+  folly::EventBase& eventBase_;
+  const bool client_;
+  bool closed_{false};
+
+  folly::Optional<quic::StreamId> mainStream_;
+  /// Whether the first frame of the main stream was delivered.
+  bool mainStarted_{false};
+  /// The unidirectional streams the INTERACTIVE streams are written to, opened
+  /// on their first frame.
+  std::vector<folly::Optional<quic::StreamId>> lanes_;
+  /// The lane of each INTERACTIVE stream, see laneOf().
+  std::unordered_map<StreamId, size_t> streamLanes_;
+  /// What was written before the peer opened the main stream.
+  std::unique_ptr<folly::IOBuf> unsentMain_;
+
+  /// The streams read from, each with the FramedReader parsing its frames.
+  std::unordered_map<quic::StreamId, yarpl::Reference<FramedReader>> readers_;
+  /// Frames of the other streams read before the first one of the main one.
+  std::vector<std::unique_ptr<folly::IOBuf>> held_;
+  /// Frames read while there was no input.
+  std::vector<std::unique_ptr<folly::IOBuf>> undelivered_;
+
+  yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber_;
+  DuplexConnection::DuplexSubscriber* inputMultiple_{nullptr};
+  yarpl::Reference<Subscription> outputSubscription_;
+};
+
+namespace {
+
+/// Hands the frames parsed from one QUIC stream to the channel.
+class QuicStreamInput : public DuplexConnection::DuplexSubscriber {
+ public:
+  QuicStreamInput(std::weak_ptr<QuicChannel> channel, bool main)
+      : channel_(std::move(channel)), main_(main) {}
+
+  void onSubscribe(yarpl::Reference<Subscription> subscription) override {
+    DuplexConnection::DuplexSubscriber::onSubscribe(subscription);
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    frames.push_back(std::move(frame));
+    onNextMultiple(std::move(frames));
+  }
+
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    if (auto channel = channel_.lock()) {
+      channel->onFrames(main_, std::move(frames));
+    }
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    DuplexConnection::DuplexSubscriber::onError({});
+    if (auto channel = channel_.lock()) {
+      channel->closeErr(std::move(ew));
+    }
+  }
+
+ private:
+  const std::weak_ptr<QuicChannel> channel_;
+  const bool main_;
+};
+
+class QuicOutputSubscriber : public DuplexConnection::DuplexSubscriber {
+ public:
+  explicit QuicOutputSubscriber(std::shared_ptr<QuicChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void onSubscribe(yarpl::Reference<Subscription> subscription) override {
+    CHECK(subscription);
+    channel_->setOutputSubscription(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    channel_->send(std::move(frame));
+  }
+
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    channel_->sendMultiple(std::move(frames));
+  }
+
+  void onComplete() override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+  void onError(folly::exception_wrapper) override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+ private:
+  const std::shared_ptr<QuicChannel> channel_;
+};
+
+class QuicInputSubscription : public Subscription {
+ public:
+  explicit QuicInputSubscription(std::shared_ptr<QuicChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(channel_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "QuicDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    channel_->setInput(nullptr);
+    channel_ = nullptr;
+  }
+
+ private:
+  std::shared_ptr<QuicChannel> channel_;
+};
+
+} // namespace
+
+void QuicChannel::watchStream(quic::StreamId streamId, bool main) {
+  auto reader = yarpl::make_ref<FramedReader>(FrameSerializerV1_0::Version);
+  reader->onSubscribe(Subscription::empty());
+  reader->setInput(yarpl::make_ref<QuicStreamInput>(shared_from_this(), main));
+  readers_.emplace(streamId, std::move(reader));
+  socket_->setReadCallback(streamId, this);
+}
+
+QuicDuplexConnection::QuicDuplexConnection(
+    std::shared_ptr<quic::QuicSocket> socket,
+    bool client,
+    QuicStreamMapping mapping,
+    std::shared_ptr<RSocketStats> stats)
+    : channel_(
+          std::make_shared<QuicChannel>(std::move(socket), client, mapping)),
+      stats_(std::move(stats)) {
+  channel_->start();
+  if (stats_) {
+    stats_->duplexConnectionCreated("quic", this);
+  }
+}
+
+QuicDuplexConnection::~QuicDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("quic", this);
+  }
+  channel_->close();
+}
+
+quic::QuicSocket* QuicDuplexConnection::getSocket() {
+  return channel_->socket();
+}
+
+size_t QuicDuplexConnection::bufferedBytes() const {
+  return channel_->bufferedBytes();
+}
+
+void QuicDuplexConnection::setStreamPriority(
+    StreamId streamId,
+    StreamPriority priority) {
+  channel_->setStreamPriority(streamId, priority);
+}
+
+void QuicDuplexConnection::clearStreamPriority(StreamId streamId) {
+  channel_->clearStreamPriority(streamId);
+}
+
+yarpl::Reference<DuplexConnection::Subscriber>
+QuicDuplexConnection::getOutput() {
+  return yarpl::make_ref<QuicOutputSubscriber>(channel_);
+}
+
+void QuicDuplexConnection::setInput(
+    yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+  // we don't care if the subscriber will call request synchronously
+  inputSubscriber->onSubscribe(
+      yarpl::make_ref<QuicInputSubscription>(channel_));
+  channel_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
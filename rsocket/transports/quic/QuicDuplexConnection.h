@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <quic/api/QuicSocket.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+class QuicChannel;
+
+/// How a QuicDuplexConnection spreads the RSocket streams over QUIC streams.
+struct QuicStreamMapping {
+  /// Unidirectional QUIC streams each side spreads the INTERACTIVE RSocket
+  /// streams over, by stream id, besides the QUIC stream carrying the other
+  /// frames.  A packet lost on one of them only holds up the RSocket streams
+  /// it carries.  0 sends all the frames on a single QUIC stream.
+  size_t interactiveStreams{0};
+};
+
+/// DuplexConnection over a QUIC connection of mvfst.  The frames go with the
+/// frame length field of protocol 1.0 over a bidirectional QUIC stream the
+/// client opens, the main stream.  So the connection is framed, and only
+/// carries protocol 1.0.
+///
+/// With QuicStreamMapping::interactiveStreams, the frames of the RSocket
+/// streams whose priority is INTERACTIVE when they start go over other QUIC
+/// streams, see DuplexConnection::setStreamPriority().  All the frames of an
+/// RSocket stream go over the same QUIC stream, so they stay in order.  The
+/// frames read from the other QUIC streams are only delivered once the first
+/// frame of the main stream has been, so that no request overtakes the SETUP.
+///
+/// Has to be created, used and destroyed on the EventBase of the socket.
+class QuicDuplexConnection : public DuplexConnection {
+ public:
+  /// Takes over the connection callback of `socket`, which has to be ready
+  /// for streams.  The client opens the main stream right away.
+  QuicDuplexConnection(
+      std::shared_ptr<quic::QuicSocket> socket,
+      bool client,
+      QuicStreamMapping mapping = QuicStreamMapping(),
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  ~QuicDuplexConnection();
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override;
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+  /// The bytes read which don't make a whole frame yet, and the frames
+  /// waiting for the input or for the first frame of the main stream.
+  size_t bufferedBytes() const override;
+
+  void setStreamPriority(StreamId streamId, StreamPriority priority) override;
+
+  void clearStreamPriority(StreamId streamId) override;
+
+  // Only to be used for observation purposes.
+  quic::QuicSocket* getSocket();
+
+ private:
+  std::shared_ptr<QuicChannel> channel_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+} // namespace rsocket
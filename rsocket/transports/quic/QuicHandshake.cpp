@@ -0,0 +1,82 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/quic/QuicHandshake.h"
+
+#include <folly/Conv.h>
+#include <folly/io/async/EventBase.h>
+
+namespace rsocket {
+
+QuicHandshake::QuicHandshake(
+    folly::EventBase& eventBase,
+    bool client,
+    QuicStreamMapping mapping,
+    std::shared_ptr<RSocketStats> stats,
+    Callback callback)
+    : eventBase_(eventBase),
+      client_(client),
+      mapping_(mapping),
+      stats_(std::move(stats)),
+      callback_(std::move(callback)) {}
+
+void QuicHandshake::watch(
+    std::shared_ptr<quic::QuicSocket> socket,
+    std::unique_ptr<QuicDuplexConnection> connection) {
+  socket_ = std::move(socket);
+  connection_ = std::move(connection);
+  self_ = shared_from_this();
+}
+
+void QuicHandshake::onConnectionSetupError(quic::QuicError error) noexcept {
+  finish(folly::Try<std::unique_ptr<QuicDuplexConnection>>(
+      folly::make_exception_wrapper<std::runtime_error>(
+          folly::to<std::string>("QUIC handshake failed: ", error.message))));
+}
+
+void QuicHandshake::onTransportReady() noexcept {
+  if (!socket_) {
+    return;
+  }
+  socket_->setConnectionSetupCallback(nullptr);
+  if (!connection_) {
+    // Takes over the connection callback.
+    connection_ = std::make_unique<QuicDuplexConnection>(
+        socket_, client_, mapping_, stats_);
+  }
+  finish(folly::Try<std::unique_ptr<QuicDuplexConnection>>(
+      std::move(connection_)));
+}
+
+void QuicHandshake::onConnectionEnd() noexcept {
+  finish(folly::Try<std::unique_ptr<QuicDuplexConnection>>(
+      folly::make_exception_wrapper<std::runtime_error>(
+          "QUIC connection ended during the handshake")));
+}
+
+void QuicHandshake::onConnectionError(quic::QuicError error) noexcept {
+  onConnectionSetupError(std::move(error));
+}
+
+void QuicHandshake::finish(
+    folly::Try<std::unique_ptr<QuicDuplexConnection>> result) {
+  if (!self_) {
+    return;
+  }
+  if (result.hasException() && socket_) {
+    socket_->setConnectionSetupCallback(nullptr);
+    if (connection_) {
+      // Closes the socket.
+      connection_ = nullptr;
+    } else {
+      socket_->setConnectionCallback(nullptr);
+    }
+  }
+  if (auto callback = std::move(callback_)) {
+    callback(std::move(result));
+  }
+  socket_ = nullptr;
+  // Not while the socket is calling this.
+  eventBase_.runInLoop([self = std::move(self_)] {});
+}
+
+} // namespace rsocket
@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/Function.h>
+#include <folly/Try.h>
+#include <quic/api/QuicSocket.h>
+
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Waits for a QUIC connection to be ready for streams, as its connection
+/// callbacks, and hands it over as a QuicDuplexConnection, or the error which
+/// failed it.  Keeps itself alive until then.
+class QuicHandshake : public quic::QuicSocket::ConnectionSetupCallback,
+                      public quic::QuicSocket::ConnectionCallback,
+                      public std::enable_shared_from_this<QuicHandshake> {
+ public:
+  using Callback = folly::Function<void(
+      folly::Try<std::unique_ptr<QuicDuplexConnection>>)>;
+
+  QuicHandshake(
+      folly::EventBase& eventBase,
+      bool client,
+      QuicStreamMapping mapping,
+      std::shared_ptr<RSocketStats> stats,
+      Callback callback);
+
+  /// Starts waiting on `socket`, whose connection setup callback has to be
+  /// this.  Without `connection`, the connection is made once the socket is
+  /// ready, and this is its connection callback until then.  The server makes
+  /// it upfront, so that it sees the streams the client opens as soon as the
+  /// handshake allows.
+  void watch(
+      std::shared_ptr<quic::QuicSocket> socket,
+      std::unique_ptr<QuicDuplexConnection> connection = nullptr);
+
+  // quic::QuicSocket::ConnectionSetupCallback.
+
+  void onConnectionSetupError(quic::QuicError error) noexcept override;
+  void onTransportReady() noexcept override;
+
+  // quic::QuicSocket::ConnectionCallback, until the connection takes over.
+
+  void onNewBidirectionalStream(quic::StreamId) noexcept override {}
+  void onNewUnidirectionalStream(quic::StreamId) noexcept override {}
+  void onStopSending(quic::StreamId, quic::ApplicationErrorCode) noexcept
+      override {}
+  void onConnectionEnd() noexcept override;
+  void onConnectionError(quic::QuicError error) noexcept override;
+
+ private:
+  void finish(folly::Try<std::unique_ptr<QuicDuplexConnection>> result);
+
+  folly::EventBase& eventBase_;
+  const bool client_;
+  const QuicStreamMapping mapping_;
+  const std::shared_ptr<RSocketStats> stats_;
+  Callback callback_;
+  std::shared_ptr<quic::QuicSocket> socket_;
+  std::unique_ptr<QuicDuplexConnection> connection_;
+  /// This, until the handshake is over.
+  std::shared_ptr<QuicHandshake> self_;
+};
+} // namespace rsocket
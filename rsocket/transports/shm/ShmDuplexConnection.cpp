@@ -0,0 +1,395 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+
+#include <linux/memfd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <deque>
+#include <limits>
+
+#include <folly/Exception.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Format.h>
+#include <folly/io/async/EventHandler.h>
+
+#include "rsocket/transports/shm/ShmRing.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t n) {
+  size_t capacity = 64;
+  while (capacity < n) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+size_t mappingSize(size_t ringCapacity) {
+  return 2 * ShmRing::regionSize(ringCapacity);
+}
+
+uint8_t* map(int fd, size_t size) {
+  auto base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    folly::throwSystemError("mmap of shared memory failed");
+  }
+  return static_cast<uint8_t*>(base);
+}
+
+folly::File makeEventFd() {
+  auto fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  folly::checkUnixError(fd, "eventfd failed");
+  return folly::File(fd, true);
+}
+
+void wake(const folly::File& eventFd) {
+  uint64_t const one = 1;
+  // Only fails when the counter is about to overflow, and the peer has
+  // plenty of wakeups pending then.
+  auto const written = ::write(eventFd.fd(), &one, sizeof(one));
+  (void)written;
+}
+
+} // namespace
+
+class ShmChannel : public folly::EventHandler,
+                   public std::enable_shared_from_this<ShmChannel> {
+ public:
+  ShmChannel(
+      ShmEndpoint endpoint,
+      folly::EventBase& eventBase,
+      std::shared_ptr<RSocketStats> stats)
+      : folly::EventHandler(&eventBase, endpoint.wakeup.fd()),
+        endpoint_(std::move(endpoint)),
+        eventBase_(eventBase),
+        stats_(std::move(stats)),
+        base_(map(endpoint_.memory.fd(), mappingSize(endpoint_.ringCapacity))),
+        tx_(ring(endpoint_.first ? 0 : 1)),
+        rx_(ring(endpoint_.first ? 1 : 0)) {
+    registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  }
+
+  ~ShmChannel() {
+    DCHECK(isClosed());
+    DCHECK(!inputSubscriber_);
+    unregisterHandler();
+    ::munmap(base_, mappingSize(endpoint_.ringCapacity));
+  }
+
+  void setInput(
+      yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && isClosed()) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+
+    // Frames which arrived while there was no subscriber wait in the ring.
+    std::weak_ptr<ShmChannel> weakSelf = shared_from_this();
+    eventBase_.runInLoop([weakSelf = std::move(weakSelf)] {
+      if (auto self = weakSelf.lock()) {
+        self->drainInput();
+      }
+    });
+  }
+
+  void setOutputSubscription(yarpl::Reference<Subscription> subscription) {
+    if (!subscription) {
+      outputSubscription_ = nullptr;
+      return;
+    }
+
+    if (isClosed()) {
+      subscription->cancel();
+      return;
+    }
+
+    // Frames which don't fit the ring are queued locally, no flow control.
+    subscription->request(std::numeric_limits<int64_t>::max());
+    outputSubscription_ = std::move(subscription);
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (isClosed()) {
+      return;
+    }
+
+    auto const length = frame->computeChainDataLength();
+    if (!tx_.fits(length)) {
+      closeErr(std::runtime_error(folly::sformat(
+          "Frame of {} bytes doesn't fit the shared memory ring", length)));
+      return;
+    }
+    if (stats_) {
+      stats_->bytesWritten(length);
+    }
+
+    if (!pending_.empty() || !write(*frame)) {
+      pending_.push_back(std::move(frame));
+    }
+  }
+
+  void close() {
+    if (isClosed()) {
+      return;
+    }
+    // let the frames which fit be written before the ring is closed
+    flushPending();
+    closeRings();
+
+    if (auto subscription = std::move(outputSubscription_)) {
+      subscription->cancel();
+    }
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onComplete();
+    }
+  }
+
+  void closeErr(folly::exception_wrapper ew) {
+    if (isClosed()) {
+      return;
+    }
+    closeRings();
+
+    if (auto subscription = std::move(outputSubscription_)) {
+      subscription->cancel();
+    }
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onError(std::move(ew));
+    }
+  }
+
+ private:
+  bool isClosed() const {
+    return closed_;
+  }
+
+  ShmRing ring(size_t index) const {
+    return ShmRing(
+        base_ + index * ShmRing::regionSize(endpoint_.ringCapacity),
+        endpoint_.ringCapacity);
+  }
+
+  void closeRings() {
+    closed_ = true;
+    pending_.clear();
+    tx_.close();
+    wake(endpoint_.peerWakeup);
+    unregisterHandler();
+  }
+
+  bool write(const folly::IOBuf& frame) {
+    bool wasEmpty = false;
+    if (!tx_.tryWrite(frame, wasEmpty)) {
+      return false;
+    }
+    if (wasEmpty) {
+      wake(endpoint_.peerWakeup);
+    }
+    return true;
+  }
+
+  void flushPending() {
+    while (!pending_.empty() && write(*pending_.front())) {
+      pending_.pop_front();
+    }
+  }
+
+  void drainInput() {
+    while (inputSubscriber_) {
+      bool producerWaiting = false;
+      std::unique_ptr<folly::IOBuf> frame;
+      try {
+        frame = rx_.read(producerWaiting);
+        if (!frame) {
+          if (!rx_.isClosed()) {
+            return;
+          }
+          // Everything written before the ring was closed is visible now.
+          frame = rx_.read(producerWaiting);
+          if (!frame) {
+            close();
+            return;
+          }
+        }
+      } catch (const std::exception& ex) {
+        closeErr(std::runtime_error(ex.what()));
+        return;
+      }
+      if (producerWaiting) {
+        wake(endpoint_.peerWakeup);
+      }
+      if (stats_) {
+        stats_->bytesRead(frame->length());
+      }
+      inputSubscriber_->onNext(std::move(frame));
+    }
+  }
+
+  void handlerReady(uint16_t) noexcept override {
+    auto self = shared_from_this();
+    // Reset the eventfd, the reasons for the wakeup are found in the rings.
+    uint64_t count;
+    auto const read = ::read(endpoint_.wakeup.fd(), &count, sizeof(count));
+    (void)read;
+
+    flushPending();
+    drainInput();
+  }
+
+  const ShmEndpoint endpoint_;
+  folly::EventBase& eventBase_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  /// The shared memory, holding both rings.
+  uint8_t* const base_;
+  ShmRing tx_;
+  ShmRing rx_;
+
+  /// Frames waiting for room in the ring.
+  std::deque<std::unique_ptr<folly::IOBuf>> pending_;
+
+  yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber_;
+  yarpl::Reference<Subscription> outputSubscription_;
+  bool closed_{false};
+};
+
+namespace {
+
+class ShmOutputSubscriber : public DuplexConnection::Subscriber {
+ public:
+  explicit ShmOutputSubscriber(std::shared_ptr<ShmChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void onSubscribe(yarpl::Reference<Subscription> subscription) override {
+    CHECK(subscription);
+    channel_->setOutputSubscription(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> element) override {
+    channel_->send(std::move(element));
+  }
+
+  void onComplete() override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+  void onError(folly::exception_wrapper) override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+ private:
+  std::shared_ptr<ShmChannel> channel_;
+};
+
+class ShmInputSubscription : public Subscription {
+ public:
+  explicit ShmInputSubscription(std::shared_ptr<ShmChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(channel_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "ShmDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    channel_->setInput(nullptr);
+    channel_ = nullptr;
+  }
+
+ private:
+  std::shared_ptr<ShmChannel> channel_;
+};
+
+} // namespace
+
+std::pair<ShmEndpoint, ShmEndpoint> ShmDuplexConnection::createEndpoints(
+    size_t ringCapacity) {
+  auto const capacity = roundUpToPowerOfTwo(ringCapacity);
+  auto const size = mappingSize(capacity);
+
+  auto const fd = ::syscall(SYS_memfd_create, "rsocket-shm", MFD_CLOEXEC);
+  folly::checkUnixError(fd, "memfd_create failed");
+  folly::File memory(static_cast<int>(fd), true);
+  folly::checkUnixError(
+      ::ftruncate(memory.fd(), static_cast<off_t>(size)), "ftruncate failed");
+
+  auto base = map(memory.fd(), size);
+  ShmRing::initialize(base);
+  ShmRing::initialize(base + ShmRing::regionSize(capacity));
+  ::munmap(base, size);
+
+  auto firstWakeup = makeEventFd();
+  auto secondWakeup = makeEventFd();
+
+  ShmEndpoint first;
+  first.memory = memory.dup();
+  first.wakeup = firstWakeup.dup();
+  first.peerWakeup = secondWakeup.dup();
+  first.ringCapacity = capacity;
+  first.first = true;
+
+  ShmEndpoint second;
+  second.memory = std::move(memory);
+  second.wakeup = std::move(secondWakeup);
+  second.peerWakeup = std::move(firstWakeup);
+  second.ringCapacity = capacity;
+  second.first = false;
+
+  return std::make_pair(std::move(first), std::move(second));
+}
+
+ShmDuplexConnection::ShmDuplexConnection(
+    ShmEndpoint endpoint,
+    folly::EventBase& eventBase,
+    std::shared_ptr<RSocketStats> stats)
+    : channel_(
+          std::make_shared<ShmChannel>(std::move(endpoint), eventBase, stats)),
+      stats_(std::move(stats)) {
+  if (stats_) {
+    stats_->duplexConnectionCreated("shm", this);
+  }
+}
+
+ShmDuplexConnection::~ShmDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("shm", this);
+  }
+  channel_->close();
+}
+
+yarpl::Reference<DuplexConnection::Subscriber>
+ShmDuplexConnection::getOutput() {
+  return yarpl::make_ref<ShmOutputSubscriber>(channel_);
+}
+
+void ShmDuplexConnection::setInput(
+    yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+  // we don't care if the subscriber will call request synchronously
+  inputSubscriber->onSubscribe(
+      yarpl::make_ref<ShmInputSubscription>(channel_));
+  channel_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
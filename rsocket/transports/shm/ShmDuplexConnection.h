@@ -0,0 +1,70 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include <folly/File.h>
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+class ShmChannel;
+
+/// The resources one side of a shared memory connection needs: the shared
+/// memory and the eventfds both sides wake each other up with.  The files can
+/// be handed to another process, e.g. over a Unix domain socket.
+struct ShmEndpoint {
+  /// Shared memory holding the rings of both directions.
+  folly::File memory;
+  /// eventfd this side waits on.
+  folly::File wakeup;
+  /// eventfd the peer waits on.
+  folly::File peerWakeup;
+  /// Bytes of frames each ring holds.
+  size_t ringCapacity{0};
+  /// Which of the two rings this side writes to.
+  bool first{false};
+};
+
+/// DuplexConnection between two peers on the same host, through a pair of
+/// single-producer single-consumer rings in shared memory, one per direction.
+/// Peers wake each other up with eventfds, only when a ring goes from empty to
+/// non-empty, or when a full ring got room again.
+///
+/// The rings carry whole frames, so the connection is framed.  Frames larger
+/// than a ring fail the connection.  Received frames are copied out of the
+/// ring, which is then free for the peer to reuse right away.
+///
+/// Has to be created, used and destroyed on the thread of its EventBase.
+class ShmDuplexConnection : public DuplexConnection {
+ public:
+  /// Allocates the shared memory and the eventfds for a connection, and
+  /// returns the endpoints of both sides.  `ringCapacity` is rounded up to a
+  /// power of two.  Linux only.
+  static std::pair<ShmEndpoint, ShmEndpoint> createEndpoints(
+      size_t ringCapacity = 1 << 20);
+
+  ShmDuplexConnection(
+      ShmEndpoint endpoint,
+      folly::EventBase& eventBase,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  ~ShmDuplexConnection();
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override;
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  std::shared_ptr<ShmChannel> channel_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+} // namespace rsocket
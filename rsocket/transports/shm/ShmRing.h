@@ -0,0 +1,157 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include <folly/io/IOBuf.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+/// Single-producer single-consumer ring of frames in a memory region shared
+/// by two processes (or threads).  Each frame is stored as a 32 bit length
+/// followed by its bytes, wrapping around the end of the buffer.
+///
+/// head and tail are byte counters which only grow, the producer advances
+/// head and the consumer tail.  Both sides tell when the other has to be woken
+/// up: the producer when it wrote into an empty ring, the consumer when it
+/// freed space for a producer which found the ring full.
+class ShmRing {
+ public:
+  /// Bytes of shared memory taken by a ring with `capacity` bytes of frames.
+  static size_t regionSize(size_t capacity) {
+    return sizeof(Header) + capacity;
+  }
+
+  /// Sets up a ring in freshly allocated shared memory, before either side
+  /// uses it.
+  static void initialize(void* region) {
+    new (region) Header();
+  }
+
+  /// `capacity` has to be a power of two.
+  ShmRing(void* region, size_t capacity)
+      : header_(static_cast<Header*>(region)),
+        data_(static_cast<uint8_t*>(region) + sizeof(Header)),
+        capacity_(capacity) {
+    DCHECK_EQ(0, capacity_ & (capacity_ - 1));
+  }
+
+  /// Whether a frame of `length` bytes can ever fit.
+  bool fits(size_t length) const {
+    return sizeof(uint32_t) + length <= capacity_;
+  }
+
+  /// Producer.  Writes a frame, or returns false if there isn't enough room;
+  /// the consumer wakes the producer up once it has made room.  Sets
+  /// `wasEmpty` if the consumer needs to be woken up.
+  bool tryWrite(const folly::IOBuf& frame, bool& wasEmpty) {
+    auto const length = frame.computeChainDataLength();
+    DCHECK(fits(length));
+    auto const needed = sizeof(uint32_t) + length;
+    auto const head = header_->head.load(std::memory_order_relaxed);
+
+    if (!hasRoom(head, needed)) {
+      header_->producerWaiting.store(true);
+      // Check again, the consumer may have freed space before it saw the flag.
+      if (!hasRoom(head, needed)) {
+        return false;
+      }
+      header_->producerWaiting.store(false, std::memory_order_relaxed);
+    }
+
+    auto const length32 = static_cast<uint32_t>(length);
+    copyIn(head, &length32, sizeof(length32));
+    auto position = head + sizeof(length32);
+    for (auto& range : frame) {
+      copyIn(position, range.data(), range.size());
+      position += range.size();
+    }
+
+    // Publish, then check whether the consumer may have gone to sleep on an
+    // empty ring.  Both sides use sequentially consistent store-then-load, so
+    // at least one of them sees the other.
+    header_->head.store(head + needed);
+    wasEmpty = header_->tail.load() == head;
+    return true;
+  }
+
+  /// Consumer.  Reads the next frame, or returns nullptr if the ring is empty.
+  /// Sets `producerWaiting` if the producer needs to be woken up.  Throws
+  /// std::runtime_error if the producer wrote a frame longer than what it
+  /// published, as the other side of the memory can't be trusted.
+  std::unique_ptr<folly::IOBuf> read(bool& producerWaiting) {
+    auto const tail = header_->tail.load(std::memory_order_relaxed);
+    auto const head = header_->head.load();
+    if (head == tail) {
+      return nullptr;
+    }
+
+    uint32_t length;
+    auto const readable = head - tail;
+    if (readable > capacity_ || readable < sizeof(length)) {
+      throw std::runtime_error("Shared memory ring holds a broken frame");
+    }
+    copyOut(tail, &length, sizeof(length));
+    if (length > readable - sizeof(length)) {
+      throw std::runtime_error("Shared memory ring holds a broken frame");
+    }
+    auto frame = folly::IOBuf::create(length);
+    copyOut(tail + sizeof(length), frame->writableData(), length);
+    frame->append(length);
+
+    header_->tail.store(tail + sizeof(length) + length);
+    producerWaiting = header_->producerWaiting.exchange(false);
+    return frame;
+  }
+
+  /// Producer.  No more frames will be written.
+  void close() {
+    header_->closed.store(true, std::memory_order_release);
+  }
+
+  /// Consumer.  Whether the producer closed the ring.  Frames written before
+  /// it did so can still be read.
+  bool isClosed() const {
+    return header_->closed.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Header {
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) std::atomic<bool> producerWaiting{false};
+    std::atomic<bool> closed{false};
+  };
+
+  bool hasRoom(uint64_t head, size_t needed) const {
+    return capacity_ - (head - header_->tail.load()) >= needed;
+  }
+
+  void copyIn(uint64_t position, const void* src, size_t size) {
+    auto const offset = position & (capacity_ - 1);
+    auto const first = std::min(size, capacity_ - offset);
+    std::memcpy(data_ + offset, src, first);
+    std::memcpy(data_, static_cast<const uint8_t*>(src) + first, size - first);
+  }
+
+  void copyOut(uint64_t position, void* dst, size_t size) const {
+    auto const offset = position & (capacity_ - 1);
+    auto const first = std::min(size, capacity_ - offset);
+    std::memcpy(dst, data_ + offset, first);
+    std::memcpy(static_cast<uint8_t*>(dst) + first, data_, size - first);
+  }
+
+  Header* const header_;
+  uint8_t* const data_;
+  const size_t capacity_;
+};
+
+} // namespace rsocket
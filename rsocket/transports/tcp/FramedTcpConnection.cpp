@@ -0,0 +1,24 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/tcp/FramedTcpConnection.h"
+
+namespace rsocket {
+
+FramedTcpConnection::FramedTcpConnection(
+    folly::AsyncTransportWrapper::UniquePtr&& socket,
+    std::shared_ptr<RSocketStats> stats,
+    size_t maxFrameLength,
+    TcpWriteCoalescing writeCoalescing,
+    std::shared_ptr<ReadBufferAllocator> readBufferAllocator,
+    TcpZeroCopy zeroCopy,
+    TcpWriteBufferLimits writeBufferLimits)
+    : TcpDuplexConnection(
+          std::move(socket),
+          std::move(stats),
+          writeCoalescing,
+          std::move(readBufferAllocator),
+          zeroCopy,
+          writeBufferLimits,
+          maxFrameLength) {}
+
+} // namespace rsocket
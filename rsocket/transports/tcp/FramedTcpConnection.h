@@ -0,0 +1,37 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "rsocket/internal/Common.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+
+namespace rsocket {
+
+/// A TcpDuplexConnection which does the framing itself.  The socket read
+/// callback splits the frames off the bytes it reads, and the frame lengths
+/// are written into the headroom of the frames sent, so the connection is used
+/// as it is rather than through a FramedDuplexConnection.  That saves the
+/// FramedReader and FramedWriter layers on the hottest path, their virtual
+/// calls, references and IOBufs per frame.
+///
+/// Only for protocol 1.0, whose frames have a 3 bytes length field.  Frames
+/// longer than `maxFrameLength` bytes, not counting their length field, fail
+/// the connection.
+class FramedTcpConnection : public TcpDuplexConnection {
+ public:
+  explicit FramedTcpConnection(
+      folly::AsyncTransportWrapper::UniquePtr&& socket,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      size_t maxFrameLength = kMaxFrameLength,
+      TcpWriteCoalescing writeCoalescing = TcpWriteCoalescing(),
+      std::shared_ptr<ReadBufferAllocator> readBufferAllocator =
+          ReadBufferAllocator::defaultAllocator(),
+      TcpZeroCopy zeroCopy = TcpZeroCopy(),
+      TcpWriteBufferLimits writeBufferLimits = TcpWriteBufferLimits());
+
+  bool isFramed() const override {
+    return true;
+  }
+};
+
+} // namespace rsocket
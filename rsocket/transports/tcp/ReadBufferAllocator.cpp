@@ -0,0 +1,224 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/tcp/ReadBufferAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include <folly/ThreadLocal.h>
+#include <glog/logging.h>
+
+#include "rsocket/internal/HugePageArena.h"
+
+namespace rsocket {
+
+namespace {
+
+class HeapReadBufferAllocator : public ReadBufferAllocator {
+ public:
+  std::unique_ptr<folly::IOBuf> allocate(size_t size) override {
+    return folly::IOBuf::create(size);
+  }
+};
+
+/// Free slabs of one thread.  Slabs return to the pool which allocated them,
+/// from whichever thread releases them.  The pool is refcounted by its thread
+/// and by every outstanding slab, so it stays alive until both are gone.
+///
+/// The slabs come from `arena` if there is one and it still has memory, and
+/// from malloc otherwise.
+class SlabPool {
+ public:
+  SlabPool(
+      size_t slabSize,
+      size_t maxCachedSlabs,
+      std::shared_ptr<HugePageArena> arena)
+      : slabSize_(slabSize),
+        maxCachedSlabs_(maxCachedSlabs),
+        arena_(std::move(arena)) {}
+
+  std::unique_ptr<folly::IOBuf> allocate() {
+    void* slab = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!cached_.empty()) {
+        slab = cached_.back();
+        cached_.pop_back();
+      }
+    }
+    if (!slab && arena_) {
+      slab = arena_->allocate();
+    }
+    if (!slab) {
+      slab = std::malloc(slabSize_);
+      if (!slab) {
+        throw std::bad_alloc();
+      }
+    }
+    ++refCount_;
+    return folly::IOBuf::takeOwnership(
+        slab, slabSize_, 0 /* length */, &SlabPool::freeSlab, this);
+  }
+
+  /// Called when the thread owning the pool exits.  The cached slabs are
+  /// freed, and the slabs still in use are freed when they are released.
+  void orphan() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      orphaned_ = true;
+      for (auto slab : cached_) {
+        freeMemory(slab);
+      }
+      cached_.clear();
+    }
+    release();
+  }
+
+ private:
+  static void freeSlab(void* slab, void* userData) {
+    auto pool = static_cast<SlabPool*>(userData);
+    pool->recycle(slab);
+    pool->release();
+  }
+
+  void recycle(void* slab) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!orphaned_ && cached_.size() < maxCachedSlabs_) {
+        cached_.push_back(slab);
+        return;
+      }
+    }
+    freeMemory(slab);
+  }
+
+  void freeMemory(void* slab) {
+    if (arena_ && arena_->owns(slab)) {
+      arena_->free(slab);
+    } else {
+      std::free(slab);
+    }
+  }
+
+  void release() {
+    if (--refCount_ == 0) {
+      delete this;
+    }
+  }
+
+  const size_t slabSize_;
+  const size_t maxCachedSlabs_;
+  const std::shared_ptr<HugePageArena> arena_;
+
+  std::mutex mutex_;
+  std::vector<void*> cached_;
+  bool orphaned_{false};
+
+  /// One reference held by the owning thread.
+  std::atomic<size_t> refCount_{1};
+};
+
+class SlabReadBufferAllocator : public ReadBufferAllocator {
+ public:
+  SlabReadBufferAllocator(
+      size_t slabSize,
+      size_t maxCachedSlabs,
+      size_t maxRecycledSize,
+      std::shared_ptr<HugePageArena> arena = nullptr)
+      : slabSize_(slabSize),
+        maxCachedSlabs_(maxCachedSlabs),
+        arena_(std::move(arena)) {
+    CHECK_GT(slabSize_, 0);
+    while ((slabSize_ << (sizeClasses_ - 1)) < maxRecycledSize) {
+      ++sizeClasses_;
+    }
+  }
+
+  std::unique_ptr<folly::IOBuf> allocate(size_t size) override {
+    size_t sizeClass = 0;
+    while ((slabSize_ << sizeClass) < size) {
+      if (++sizeClass == sizeClasses_) {
+        return folly::IOBuf::create(size);
+      }
+    }
+    auto& handle = *pools_;
+    if (handle.pools.empty()) {
+      handle.pools.resize(sizeClasses_);
+    }
+    auto& pool = handle.pools[sizeClass];
+    if (!pool) {
+      // Each class caches as many bytes as the slabs, and at least a buffer.
+      auto const maxCached = std::max(
+          maxCachedSlabs_ >> sizeClass, std::min<size_t>(maxCachedSlabs_, 1));
+      // The arena only carves buffers of a slab.
+      pool = new SlabPool(
+          slabSize_ << sizeClass, maxCached, sizeClass ? nullptr : arena_);
+    }
+    return pool->allocate();
+  }
+
+ private:
+  struct PoolHandle {
+    ~PoolHandle() {
+      for (auto pool : pools) {
+        if (pool) {
+          pool->orphan();
+        }
+      }
+    }
+
+    /// By size class, a slab times 2^index.
+    std::vector<SlabPool*> pools;
+  };
+
+  const size_t slabSize_;
+  const size_t maxCachedSlabs_;
+  /// Buffers up to a slab times 2^(sizeClasses_ - 1) come from the pools.
+  size_t sizeClasses_{1};
+  /// Shared by the pools of all the threads.
+  const std::shared_ptr<HugePageArena> arena_;
+  folly::ThreadLocal<PoolHandle> pools_;
+};
+
+} // namespace
+
+std::shared_ptr<ReadBufferAllocator> ReadBufferAllocator::heap() {
+  return std::make_shared<HeapReadBufferAllocator>();
+}
+
+std::shared_ptr<ReadBufferAllocator> ReadBufferAllocator::slabs(
+    size_t slabSize,
+    size_t maxCachedSlabs) {
+  return std::make_shared<SlabReadBufferAllocator>(
+      slabSize, maxCachedSlabs, slabSize);
+}
+
+std::shared_ptr<ReadBufferAllocator> ReadBufferAllocator::hugePageSlabs(
+    size_t slabSize,
+    size_t maxCachedSlabs) {
+  return std::make_shared<SlabReadBufferAllocator>(
+      slabSize,
+      maxCachedSlabs,
+      slabSize,
+      std::make_shared<HugePageArena>(slabSize));
+}
+
+std::shared_ptr<ReadBufferAllocator> ReadBufferAllocator::recyclingSlabs(
+    size_t slabSize,
+    size_t maxCachedSlabs,
+    size_t maxRecycledSize) {
+  return std::make_shared<SlabReadBufferAllocator>(
+      slabSize, maxCachedSlabs, maxRecycledSize);
+}
+
+std::shared_ptr<ReadBufferAllocator> ReadBufferAllocator::defaultAllocator() {
+  // Leaked on purpose, connections may outlive static destruction.
+  static auto* instance =
+      new std::shared_ptr<ReadBufferAllocator>(ReadBufferAllocator::slabs());
+  return *instance;
+}
+
+} // namespace rsocket
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+
+namespace rsocket {
+
+/// Allocates the buffers a TcpDuplexConnection reads the socket into.
+///
+/// A buffer is shared by the frames read into it and is only freed once all
+/// of them have been released, which can happen on any thread.
+class ReadBufferAllocator {
+ public:
+  virtual ~ReadBufferAllocator() = default;
+
+  /// Returns an unshared buffer with at least `size` bytes of tailroom.  Called
+  /// on the EventBase thread of the connection.
+  virtual std::unique_ptr<folly::IOBuf> allocate(size_t size) = 0;
+
+  /// Allocates every buffer with folly::IOBuf::create.
+  static std::shared_ptr<ReadBufferAllocator> heap();
+
+  /// Hands out fixed size slabs from a pool per thread, and recycles up to
+  /// `maxCachedSlabs` freed slabs per pool, so the common case of small frames
+  /// doesn't go through malloc.  Requests larger than a slab are served from
+  /// the heap.
+  static std::shared_ptr<ReadBufferAllocator> slabs(
+      size_t slabSize = 4096,
+      size_t maxCachedSlabs = 64);
+
+  /// Like slabs(), with the slabs carved from 2MB huge pages shared by all the
+  /// threads, see HugePageArena, to cut the TLB misses of touching the read
+  /// buffers of many connections.  Falls back to malloc once huge pages, or
+  /// any mapped memory, run out.  Slabs are only given back to the system
+  /// with the allocator and its last slab.
+  static std::shared_ptr<ReadBufferAllocator> hugePageSlabs(
+      size_t slabSize = 4096,
+      size_t maxCachedSlabs = 64);
+
+  /// Like slabs(), and the buffers of reads larger than a slab, up to
+  /// `maxRecycledSize`, are recycled too, in size classes of a slab times a
+  /// power of two.  Each class caches as many bytes as the slabs do, and at
+  /// least one buffer.  Once the reads of a stream of large payloads settle
+  /// on a size, the buffers the payloads are dropped with go back to the
+  /// pool, and the next reads are served from it instead of malloc.
+  static std::shared_ptr<ReadBufferAllocator> recyclingSlabs(
+      size_t slabSize = 4096,
+      size_t maxCachedSlabs = 64,
+      size_t maxRecycledSize = 1024 * 1024);
+
+  /// The allocator used by default, a process-wide slabs() allocator.
+  static std::shared_ptr<ReadBufferAllocator> defaultAllocator();
+};
+
+} // namespace rsocket
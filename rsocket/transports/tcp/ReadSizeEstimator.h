@@ -0,0 +1,51 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace rsocket {
+
+/// Decides how much to read from a socket next.  Keeps a moving average of
+/// the bytes returned by the recent reads, so connections carrying small
+/// frames read into small buffers, while bulk transfers get buffers large
+/// enough to drain the socket in fewer reads.  A frame the reader already
+/// knows the length of is read in one go, up to `maxReadSize`.
+class ReadSizeEstimator {
+ public:
+  ReadSizeEstimator(size_t minReadSize, size_t maxReadSize)
+      : minReadSize_(minReadSize),
+        maxReadSize_(std::max(minReadSize, maxReadSize)),
+        average_(minReadSize) {}
+
+  /// Records that a read returned `len` bytes.  A read which filled the
+  /// buffer suggests there was more data waiting, so the estimate grows
+  /// faster than it shrinks.
+  void onRead(size_t len, size_t bufferSize) {
+    if (len >= bufferSize) {
+      average_ = std::min(maxReadSize_, std::max(average_, len) * 2);
+      return;
+    }
+    // exponential moving average with a weight of 1/8 for the new sample
+    average_ = average_ - average_ / 8 + len / 8;
+  }
+
+  /// The size of the next read, given the number of bytes still missing from
+  /// the frame which is being received (0 if unknown).
+  size_t nextReadSize(size_t bytesExpected) const {
+    auto size = std::max(average_, bytesExpected);
+    return std::min(maxReadSize_, std::max(minReadSize_, size));
+  }
+
+  size_t minReadSize() const {
+    return minReadSize_;
+  }
+
+ private:
+  const size_t minReadSize_;
+  const size_t maxReadSize_;
+  size_t average_;
+};
+
+} // namespace rsocket
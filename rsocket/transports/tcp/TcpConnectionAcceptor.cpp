@@ -3,33 +3,106 @@
 #include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 
 #include <folly/Format.h>
+#include <folly/String.h>
 #include <folly/futures/Future.h>
+#include <folly/io/async/AsyncSSLSocket.h>
 #include <folly/io/async/AsyncSocket.h>
 #include <folly/io/async/EventBaseManager.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/system/ThreadName.h>
 
+#include <algorithm>
+#include <list>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include "rsocket/BusyPollEventBaseThread.h"
 #include "rsocket/framing/FramedDuplexConnection.h"
+#include "rsocket/transports/tcp/FramedTcpConnection.h"
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
 namespace rsocket {
 
+namespace {
+
+/// Pins the calling thread to `cpus`, unless there are none.
+void pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (auto error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+    LOG(ERROR) << "Failed to pin the thread to its CPUs: "
+               << folly::errnoStr(error);
+  }
+#else
+  (void)cpus;
+#endif
+}
+
+/// The CPU the kernel processed the packets of the socket on, -1 if unknown.
+int incomingCpu(int fd) {
+#ifdef SO_INCOMING_CPU
+  int cpu = -1;
+  socklen_t length = sizeof(cpu);
+  if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length) == 0) {
+    return cpu;
+  }
+#else
+  (void)fd;
+#endif
+  return -1;
+}
+
+} // namespace
+
 class TcpConnectionAcceptor::SocketCallback
     : public folly::AsyncServerSocket::AcceptCallback {
  public:
-  explicit SocketCallback(OnDuplexConnectionAccept& onAccept)
-      : onAccept_{onAccept} {}
+  SocketCallback(
+      TcpConnectionAcceptor& acceptor,
+      OnDuplexConnectionAccept& onAccept,
+      const Options& options)
+      : thread_{options.busyPollBudget, "TCPWrk"},
+        acceptor_{acceptor},
+        onAccept_{onAccept},
+        zeroCopy_{options.zeroCopy},
+        socketOptions_{socketOptionsOf(options)},
+        writeBufferLimits_{options.socketOptions.writeBufferLimits()},
+        readBufferAllocator_{options.readBufferAllocator},
+        framing_{options.framing},
+        sslContext_{options.sslContext},
+        tlsHandshakeTimeout_{options.tlsHandshakeTimeout},
+        steerByIncomingCpu_{options.steerByIncomingCpu} {}
+
+  ~SocketCallback() {
+    // After the tasks of stopListening(), if any.
+    eventBase()->runInEventBaseThreadAndWait([this] { closeHandshakes(); });
+  }
 
   void connectionAccepted(
       int fd,
       const folly::SocketAddress& address) noexcept override {
-    VLOG(2) << "Accepting TCP connection from " << address << " on FD " << fd;
-
-    folly::AsyncTransportWrapper::UniquePtr socket(
-        new folly::AsyncSocket(eventBase(), fd));
-
-    auto connection = std::make_unique<TcpDuplexConnection>(std::move(socket));
-    onAccept_(std::move(connection), *eventBase());
+    if (steerByIncomingCpu_) {
+      auto cpu = incomingCpu(fd);
+      auto worker = cpu >= 0 ? acceptor_.workerForCpu(cpu) : nullptr;
+      if (worker && worker != this) {
+        VLOG(3) << "Steering FD " << fd << " to the worker on CPU " << cpu;
+        worker->eventBase()->runInEventBaseThread(
+            [worker, fd, address] { worker->onAccepted(fd, address); });
+        return;
+      }
+    }
+    onAccepted(fd, address);
   }
 
   void acceptError(const std::exception& ex) noexcept override {
@@ -40,12 +113,208 @@ class TcpConnectionAcceptor::SocketCallback
     return thread_.getEventBase();
   }
 
+  /// Binds a listening socket of this callback's own, driven by its thread,
+  /// with SO_REUSEPORT so sockets of other callbacks can share the address,
+  /// unless it inherits sockets.  Returns the port it is bound to.
+  uint16_t listen(
+      const folly::SocketAddress& address,
+      int backlog,
+      uint32_t maxAcceptAtOnce,
+      std::vector<int> inherited) {
+    return folly::via(
+               eventBase(),
+               [this, address, backlog, maxAcceptAtOnce, inherited] {
+                 socket_.reset(new folly::AsyncServerSocket(eventBase()));
+                 socket_->setReusePortEnabled(true);
+                 socket_->setMaxAcceptAtOnce(maxAcceptAtOnce);
+                 if (inherited.empty()) {
+                   socket_->bind(address);
+                 } else {
+                   socket_->useExistingSockets(inherited);
+                 }
+                 // No EventBase: accept on this thread, without any handoff.
+                 socket_->addAcceptCallback(this, nullptr);
+                 socket_->listen(backlog);
+                 socket_->startAccepting();
+                 return socket_->getAddress().getPort();
+               })
+        .get();
+  }
+
+  /// Closes the callback's own listening socket, if any, and the sockets
+  /// still in their TLS handshake.
+  void stopListening() {
+    eventBase()->runInEventBaseThread(
+        [this, socket = std::move(socket_)]() { closeHandshakes(); });
+  }
+
+  /// TLS handshakes still running.
+  size_t pendingHandshakes() {
+    return folly::via(eventBase(), [this] { return handshakes_.size(); })
+        .get();
+  }
+
+  folly::Optional<uint16_t> listeningPort() const {
+    if (!socket_) {
+      return folly::none;
+    }
+    return socket_->getAddress().getPort();
+  }
+
+  std::vector<int> listeningSockets() const {
+    if (!socket_) {
+      return {};
+    }
+    return socket_->getSockets();
+  }
+
  private:
+  /// Creates the connection of a socket accepted for this worker, on its
+  /// thread.
+  void onAccepted(int fd, const folly::SocketAddress& address) {
+    VLOG(2) << "Accepting TCP connection from " << address << " on FD " << fd;
+    socketOptions_.apply(fd, address.getFamily());
+
+    if (sslContext_) {
+      folly::AsyncSSLSocket::UniquePtr socket(new folly::AsyncSSLSocket(
+          sslContext_, eventBase(), fd, true /* server */));
+      auto handshake =
+          std::make_unique<TlsHandshake>(std::move(socket), *this);
+      auto& started = *handshake;
+      started.start(
+          handshakes_.insert(handshakes_.end(), std::move(handshake)),
+          tlsHandshakeTimeout_);
+      return;
+    }
+
+    folly::AsyncTransportWrapper::UniquePtr socket(
+        new folly::AsyncSocket(eventBase(), fd));
+    accept(std::move(socket), zeroCopy_);
+  }
+
+  class TlsHandshake;
+  using Handshakes = std::list<std::unique_ptr<TlsHandshake>>;
+
+  /// An accepted TLS socket until its handshake completes.  It is in the
+  /// handshakes_ of its callback, which it removes itself from once done.
+  class TlsHandshake : public folly::AsyncSSLSocket::HandshakeCB {
+   public:
+    TlsHandshake(
+        folly::AsyncSSLSocket::UniquePtr socket,
+        SocketCallback& acceptor)
+        : socket_(std::move(socket)), acceptor_(acceptor) {}
+
+    void start(Handshakes::iterator entry, std::chrono::milliseconds timeout) {
+      entry_ = entry;
+      socket_->sslAccept(this, timeout);
+    }
+
+    /// Closes the socket, once the callback no longer holds the handshake.
+    void abandon() {
+      abandoned_ = true;
+      socket_->closeNow();
+    }
+
+    void handshakeSuc(folly::AsyncSSLSocket*) noexcept override {
+      if (abandoned_) {
+        return;
+      }
+      auto self = remove();
+      acceptor_.accept(std::move(socket_), TcpZeroCopy());
+    }
+
+    void handshakeErr(
+        folly::AsyncSSLSocket*,
+        const folly::AsyncSocketException& ex) noexcept override {
+      if (abandoned_) {
+        return;
+      }
+      auto self = remove();
+      VLOG(2) << "TLS handshake failed: " << ex.what();
+    }
+
+   private:
+    std::unique_ptr<TlsHandshake> remove() {
+      auto self = std::move(*entry_);
+      acceptor_.handshakes_.erase(entry_);
+      return self;
+    }
+
+    folly::AsyncSSLSocket::UniquePtr socket_;
+    SocketCallback& acceptor_;
+    Handshakes::iterator entry_;
+    bool abandoned_{false};
+  };
+
+  /// Closes the sockets still in their handshake, on the callback's thread.
+  void closeHandshakes() {
+    auto handshakes = std::move(handshakes_);
+    handshakes_.clear();
+    for (auto& handshake : handshakes) {
+      handshake->abandon();
+    }
+  }
+
+  void accept(
+      folly::AsyncTransportWrapper::UniquePtr socket,
+      TcpZeroCopy zeroCopy) {
+    std::unique_ptr<DuplexConnection> connection;
+    if (framing_) {
+      connection = std::make_unique<FramedTcpConnection>(
+          std::move(socket),
+          RSocketStats::noop(),
+          *framing_,
+          TcpWriteCoalescing(),
+          readBufferAllocator_,
+          zeroCopy,
+          writeBufferLimits_);
+    } else {
+      connection = std::make_unique<TcpDuplexConnection>(
+          std::move(socket),
+          RSocketStats::noop(),
+          TcpWriteCoalescing(),
+          readBufferAllocator_,
+          zeroCopy,
+          writeBufferLimits_);
+    }
+    onAccept_(std::move(connection), *eventBase());
+  }
+
+  static TcpSocketOptions socketOptionsOf(const Options& options) {
+    auto socketOptions = options.socketOptions;
+    if (options.busyPollBudget.count() > 0 && !socketOptions.busyPollMicros) {
+      socketOptions.busyPollMicros =
+          static_cast<int>(options.busyPollBudget.count());
+    }
+    return socketOptions;
+  }
+
   /// The thread running this callback.
-  folly::ScopedEventBaseThread thread_;
+  BusyPollEventBaseThread thread_;
+
+  /// The callback's own listening socket, with Options::reusePort.
+  folly::AsyncServerSocket::UniquePtr socket_;
+
+  /// The acceptor, to steer the connections to the other workers.
+  TcpConnectionAcceptor& acceptor_;
 
   /// Reference to the ConnectionAcceptor's callback.
   OnDuplexConnectionAccept& onAccept_;
+
+  const TcpZeroCopy zeroCopy_;
+  const TcpSocketOptions socketOptions_;
+  const TcpWriteBufferLimits writeBufferLimits_;
+  const std::shared_ptr<ReadBufferAllocator> readBufferAllocator_;
+  const folly::Optional<size_t> framing_;
+
+  /// Set when accepting TLS connections.
+  const std::shared_ptr<folly::SSLContext> sslContext_;
+  const std::chrono::milliseconds tlsHandshakeTimeout_;
+
+  const bool steerByIncomingCpu_;
+
+  /// The accepted TLS sockets in their handshake.  Only used on the thread.
+  Handshakes handshakes_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,7 +323,7 @@ TcpConnectionAcceptor::TcpConnectionAcceptor(Options options)
     : options_(std::move(options)) {}
 
 TcpConnectionAcceptor::~TcpConnectionAcceptor() {
-  if (serverThread_) {
+  if (onAccept_) {
     stop();
     serverThread_.reset();
   }
@@ -68,22 +337,61 @@ void TcpConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
   }
 
   onAccept_ = std::move(onAccept);
-  serverThread_ = std::make_unique<folly::ScopedEventBaseThread>();
-  serverThread_->getEventBase()->runInEventBaseThread(
-      [] { folly::setThreadName("TcpConnectionAcceptor.Listener"); });
 
   callbacks_.reserve(options_.threads);
   for (size_t i = 0; i < options_.threads; ++i) {
-    callbacks_.push_back(std::make_unique<SocketCallback>(onAccept_));
-    callbacks_[i]->eventBase()->runInEventBaseThread([i] {
+    callbacks_.push_back(
+        std::make_unique<SocketCallback>(*this, onAccept_, options_));
+    std::vector<int> cpus;
+    if (!options_.workerCpus.empty()) {
+      cpus = options_.workerCpus[i % options_.workerCpus.size()];
+    }
+    if (options_.steerByIncomingCpu) {
+      for (auto cpu : cpus) {
+        if (cpu >= 0) {
+          workersByCpu_.resize(
+              std::max(workersByCpu_.size(), static_cast<size_t>(cpu) + 1));
+          workersByCpu_[cpu].push_back(callbacks_[i].get());
+        }
+      }
+    }
+    callbacks_[i]->eventBase()->runInEventBaseThread([i, cpus] {
       folly::EventBaseManager::get()->getEventBase()->setName(
           folly::sformat("TCPWrk.{}", i));
+      pinCurrentThread(cpus);
     });
   }
 
-  VLOG(1) << "Starting TCP listener on port " << options_.address.getPort()
+  VLOG(1) << "Starting TCP listener on " << options_.address.describe()
           << " with " << options_.threads << " request threads";
 
+  if (options_.reusePort) {
+    auto address = options_.address;
+    auto const& inherited = options_.inheritedSockets;
+    for (size_t i = 0; i < callbacks_.size(); ++i) {
+      std::vector<int> sockets;
+      for (size_t j = i; j < inherited.size(); j += callbacks_.size()) {
+        sockets.push_back(inherited[j]);
+      }
+      // Bind all sockets to the port of the first one, in case the port was 0.
+      address.setPort(callbacks_[i]->listen(
+          address,
+          options_.backlog,
+          options_.maxAcceptAtOnce,
+          std::move(sockets)));
+    }
+    VLOG(1) << "Listening on port " << address.getPort() << " from "
+            << callbacks_.size() << " worker threads";
+    return;
+  }
+
+  serverThread_ = std::make_unique<folly::ScopedEventBaseThread>();
+  serverThread_->getEventBase()->runInEventBaseThread(
+      [cpus = options_.listenerCpus] {
+        folly::setThreadName("TcpConnectionAcceptor.Listener");
+        pinCurrentThread(cpus);
+      });
+
   serverSocket_.reset(
       new folly::AsyncServerSocket(serverThread_->getEventBase()));
 
@@ -92,7 +400,12 @@ void TcpConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
   folly::via(
       serverThread_->getEventBase(),
       [this] {
-        serverSocket_->bind(options_.address);
+        if (options_.inheritedSockets.empty()) {
+          serverSocket_->bind(options_.address);
+        } else {
+          serverSocket_->useExistingSockets(options_.inheritedSockets);
+        }
+        serverSocket_->setMaxAcceptAtOnce(options_.maxAcceptAtOnce);
 
         for (auto const& callback : callbacks_) {
           serverSocket_->addAcceptCallback(
@@ -109,18 +422,96 @@ void TcpConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
       .get();
 }
 
+TcpConnectionAcceptor::SocketCallback* TcpConnectionAcceptor::workerForCpu(
+    int cpu) {
+  if (static_cast<size_t>(cpu) >= workersByCpu_.size()) {
+    return nullptr;
+  }
+  auto const& workers = workersByCpu_[cpu];
+  if (workers.empty()) {
+    return nullptr;
+  }
+  return workers[steeringTurn_++ % workers.size()];
+}
+
 void TcpConnectionAcceptor::stop() {
   VLOG(1) << "Shutting down TCP listener";
 
+  // The workers close the sockets still in their TLS handshake.
+  for (auto const& callback : callbacks_) {
+    callback->stopListening();
+  }
+  if (options_.reusePort) {
+    return;
+  }
+
   serverThread_->getEventBase()->runInEventBaseThread(
       [serverSocket = std::move(serverSocket_)]() {});
 }
 
 folly::Optional<uint16_t> TcpConnectionAcceptor::listeningPort() const {
+  if (options_.reusePort) {
+    if (callbacks_.empty()) {
+      return folly::none;
+    }
+    return callbacks_.front()->listeningPort();
+  }
   if (!serverSocket_) {
     return folly::none;
   }
-  return serverSocket_->getAddress().getPort();
+  auto address = serverSocket_->getAddress();
+  if (address.getFamily() != AF_INET && address.getFamily() != AF_INET6) {
+    // e.g. a Unix domain socket
+    return folly::none;
+  }
+  return address.getPort();
+}
+
+std::vector<folly::EventBase*> TcpConnectionAcceptor::workerEventBases() const {
+  std::vector<folly::EventBase*> eventBases;
+  eventBases.reserve(callbacks_.size());
+  for (auto const& callback : callbacks_) {
+    eventBases.push_back(callback->eventBase());
+  }
+  return eventBases;
+}
+
+std::vector<int> TcpConnectionAcceptor::listeningSockets() const {
+  if (options_.reusePort) {
+    std::vector<int> sockets;
+    for (auto const& callback : callbacks_) {
+      auto own = callback->listeningSockets();
+      sockets.insert(sockets.end(), own.begin(), own.end());
+    }
+    return sockets;
+  }
+  if (!serverSocket_) {
+    return {};
+  }
+  return serverSocket_->getSockets();
+}
+
+std::unique_ptr<DuplexConnection> TcpConnectionAcceptor::adoptSocket(
+    int fd,
+    folly::EventBase& eventBase) {
+  VLOG(2) << "Adopting TCP connection on FD " << fd;
+  folly::AsyncTransportWrapper::UniquePtr socket(
+      new folly::AsyncSocket(&eventBase, fd));
+  return std::make_unique<TcpDuplexConnection>(
+      std::move(socket),
+      RSocketStats::noop(),
+      TcpWriteCoalescing(),
+      options_.readBufferAllocator,
+      options_.zeroCopy,
+      options_.socketOptions.writeBufferLimits());
+}
+
+size_t TcpConnectionAcceptor::pendingTlsHandshakes() const {
+  size_t pending = 0;
+  for (auto const& callback : callbacks_) {
+    pending += callback->pendingHandshakes();
+  }
+  return pending;
 }
 
 } // namespace rsocket
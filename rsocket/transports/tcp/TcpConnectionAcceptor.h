@@ -2,9 +2,17 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <folly/Optional.h>
 #include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/SSLContext.h>
 
 #include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+#include "rsocket/transports/tcp/TcpSocketOptions.h"
 
 namespace folly {
 class ScopedEventBaseThread;
@@ -34,6 +42,72 @@ class TcpConnectionAcceptor : public ConnectionAcceptor {
 
     /// Number of connections to buffer before accept handlers process them.
     int backlog;
+
+    /// Give each worker thread its own listening socket bound with
+    /// SO_REUSEPORT, instead of accepting on a single listener thread and
+    /// handing the sockets over to the workers.  The kernel then balances
+    /// new connections across the workers.
+    bool reusePort{false};
+
+    /// Upper bound of the connections accepted per readiness event of a
+    /// listening socket.  Raising it lets bursts of new connections on busy
+    /// servers be accepted with fewer trips through epoll, at the cost of
+    /// fairness with the other events of the listening thread.
+    uint32_t maxAcceptAtOnce{
+        folly::AsyncServerSocket::kDefaultMaxAcceptAtOnce};
+
+    /// MSG_ZEROCOPY sends of the accepted connections.  Doesn't apply to
+    /// TLS connections, their records are encrypted in userspace.
+    TcpZeroCopy zeroCopy;
+
+    /// Socket options set on the accepted connections.
+    TcpSocketOptions socketOptions;
+
+    /// Allocates the buffers the accepted connections read into, e.g.
+    /// ReadBufferAllocator::recyclingSlabs() to recycle the buffers of large
+    /// payloads as well.
+    std::shared_ptr<ReadBufferAllocator> readBufferAllocator{
+        ReadBufferAllocator::defaultAllocator()};
+
+    /// CPUs the worker threads run on, worker i on workerCpus[i % size()].
+    /// All the CPUs of a NUMA node keep a worker on that node.  Empty leaves
+    /// the workers to the scheduler.
+    std::vector<std::vector<int>> workerCpus;
+
+    /// CPUs the listener thread runs on, without reusePort.
+    std::vector<int> listenerCpus;
+
+    /// Hand each accepted connection over to a worker running on the CPU the
+    /// kernel processed its packets on (SO_INCOMING_CPU), picking among those
+    /// in turn if several do.  With workerCpus pinned to the NUMA nodes of
+    /// the NIC queues, the packets, the buffers and the state machine of a
+    /// connection stay on the same node.  Connections from CPUs no worker
+    /// runs on stay where they were accepted.
+    bool steerByIncomingCpu{false};
+
+    /// Run the workers on BusyPollEventBaseThreads spinning this long after
+    /// each wakeup, for the lowest latency at the cost of the CPU.  Unless
+    /// socketOptions set it, SO_BUSY_POLL is set to the budget as well.
+    std::chrono::microseconds busyPollBudget{0};
+
+    /// Accept FramedTcpConnections, which do the framing themselves, with
+    /// this maximum frame length.  RSocketServer::setMaxFrameLength() doesn't
+    /// apply to them.  Only for clients of protocol 1.0.
+    folly::Optional<size_t> framing;
+
+    /// Accept TLS connections.  The handshake is performed with this context
+    /// before a connection is handed over to the OnDuplexConnectionAccept
+    /// callback.
+    std::shared_ptr<folly::SSLContext> sslContext;
+
+    /// Time a client has to complete the TLS handshake.
+    std::chrono::milliseconds tlsHandshakeTimeout{std::chrono::seconds(5)};
+
+    /// Listening sockets to accept on instead of binding `address`, e.g.
+    /// those of the process this one takes over from, see HotRestart.h.  The
+    /// acceptor owns them.  With reusePort they are spread over the workers,
+    /// and the workers left without one bind their own.
+    std::vector<int> inheritedSockets;
   };
 
   //////////////////////////////////////////////////////////////////////////////
@@ -56,14 +130,43 @@ class TcpConnectionAcceptor : public ConnectionAcceptor {
   void stop() override;
 
   /**
-   * Get the port being listened on.
+   * Get the port being listened on.  None if the address has no port (e.g. a
+   * Unix domain socket).
    */
   folly::Optional<uint16_t> listeningPort() const override;
 
+  /**
+   * The EventBases of the worker threads, one per Options::threads.
+   */
+  std::vector<folly::EventBase*> workerEventBases() const override;
+
+  /**
+   * The sockets listened on, those of the workers with reusePort.
+   */
+  std::vector<int> listeningSockets() const override;
+
+  /**
+   * A plain TCP connection, framed or not: the framing, of the bytes read
+   * before as well, is left to the caller.
+   */
+  std::unique_ptr<DuplexConnection> adoptSocket(
+      int fd,
+      folly::EventBase& eventBase) override;
+
+  /**
+   * Connections accepted with Options::sslContext whose TLS handshake hasn't
+   * completed yet.  stop() closes them.
+   */
+  size_t pendingTlsHandshakes() const;
+
  private:
   class SocketCallback;
 
-  /// The thread driving the AsyncServerSocket.
+  /// The next of the workers running on `cpu`, nullptr if none does.
+  SocketCallback* workerForCpu(int cpu);
+
+  /// The thread driving the AsyncServerSocket.  Not used with
+  /// Options::reusePort, the workers drive their own sockets then.
   std::unique_ptr<folly::ScopedEventBaseThread> serverThread_;
 
   /// Function to run when a connection is accepted.
@@ -73,10 +176,16 @@ class TcpConnectionAcceptor : public ConnectionAcceptor {
   /// thread.
   std::vector<std::unique_ptr<SocketCallback>> callbacks_;
 
-  /// The socket listening for new connections.
+  /// The socket listening for new connections, unless each callback has its
+  /// own.
   folly::AsyncServerSocket::UniquePtr serverSocket_;
 
   /// Options this acceptor has been configured with.
   Options options_;
+
+  /// The workers running on each CPU, with steerByIncomingCpu, and the
+  /// turns to pick among them.
+  std::vector<std::vector<SocketCallback*>> workersByCpu_;
+  std::atomic<size_t> steeringTurn_{0};
 };
 }
@@ -2,11 +2,16 @@
 
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
 
+#include <deque>
+#include <list>
+
+#include <folly/io/async/AsyncSSLSocket.h>
 #include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/AsyncTransport.h>
-#include <folly/io/async/EventBaseManager.h>
 #include <glog/logging.h>
 
+#include "rsocket/transports/tcp/FramedTcpConnection.h"
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
 using namespace rsocket;
@@ -15,77 +20,275 @@ namespace rsocket {
 
 namespace {
 
-class ConnectCallback : public folly::AsyncSocket::ConnectCallback {
+/// Connects to the first of several addresses to accept a connection.  An
+/// attempt is started every attemptDelay, or as soon as all the attempts in
+/// flight failed, and the others are cancelled once one succeeds.  Owns
+/// itself, it is deleted once the promise is fulfilled.
+class ConnectRace : private folly::AsyncTimeout {
  public:
-  ConnectCallback(
-      folly::SocketAddress address,
+  ConnectRace(
+      folly::EventBase& eventBase,
+      std::vector<folly::SocketAddress> addresses,
+      std::chrono::milliseconds attemptDelay,
       folly::Promise<ConnectionFactory::ConnectedDuplexConnection>
-          connectPromise)
-      : address_(address), connectPromise_{std::move(connectPromise)} {
-    VLOG(2) << "Constructing ConnectCallback";
+          connectPromise,
+      TcpZeroCopy zeroCopy,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      folly::Optional<size_t> framing,
+      TcpSocketOptions socketOptions,
+      std::shared_ptr<ReadBufferAllocator> readBufferAllocator)
+      : folly::AsyncTimeout(&eventBase),
+        eventBase_(eventBase),
+        addresses_(std::move(addresses)),
+        attemptDelay_(attemptDelay),
+        connectPromise_{std::move(connectPromise)},
+        zeroCopy_(sslContext ? TcpZeroCopy() : zeroCopy),
+        sslContext_(std::move(sslContext)),
+        framing_(framing),
+        socketOptions_(std::move(socketOptions)),
+        readBufferAllocator_(std::move(readBufferAllocator)) {
+    VLOG(2) << "Constructing ConnectRace";
+    DCHECK(!addresses_.empty());
+  }
+
+  ~ConnectRace() {
+    VLOG(2) << "Destroying ConnectRace";
+  }
 
-    // Set up by ScopedEventBaseThread.
-    auto evb = folly::EventBaseManager::get()->getExistingEventBase();
-    DCHECK(evb);
+  /// Starts the next attempt.  May delete this.
+  void startNext() {
+    DCHECK_LT(next_, addresses_.size());
+    auto const& address = addresses_[next_++];
 
-    VLOG(3) << "Starting socket";
-    socket_.reset(new folly::AsyncSocket(evb));
+    folly::AsyncSocket::UniquePtr socket;
+    if (sslContext_) {
+      // connects and then performs the handshake before calling back
+      socket.reset(new folly::AsyncSSLSocket(sslContext_, &eventBase_));
+    } else {
+      socket.reset(new folly::AsyncSocket(&eventBase_));
+    }
+    attempts_.push_back(
+        std::make_unique<Attempt>(*this, address, std::move(socket)));
 
-    VLOG(3) << "Attempting connection to " << address_;
+    if (next_ < addresses_.size()) {
+      scheduleTimeout(static_cast<uint32_t>(attemptDelay_.count()));
+    }
 
-    socket_->connect(this, address_);
+    VLOG(3) << "Attempting connection to " << address;
+    // Can fail in-line, deleting this.
+    auto& attempt = *attempts_.back();
+    attempt.socket->connect(
+        &attempt, address, 0, socketOptions_.toOptionMap(address.getFamily()));
   }
 
-  ~ConnectCallback() {
-    VLOG(2) << "Destroying ConnectCallback";
+ private:
+  struct Attempt : public folly::AsyncSocket::ConnectCallback {
+    Attempt(
+        ConnectRace& _race,
+        folly::SocketAddress _address,
+        folly::AsyncSocket::UniquePtr _socket)
+        : race(_race),
+          address(std::move(_address)),
+          socket(std::move(_socket)) {}
+
+    void connectSuccess() noexcept override {
+      race.onConnected(*this);
+    }
+
+    void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+      race.onFailed(*this, ex);
+    }
+
+    ConnectRace& race;
+    folly::SocketAddress address;
+    folly::AsyncSocket::UniquePtr socket;
+  };
+
+  void timeoutExpired() noexcept override {
+    VLOG(3) << "No connection after " << attemptDelay_.count()
+            << "ms, trying another address";
+    startNext();
   }
 
-  void connectSuccess() noexcept override {
-    std::unique_ptr<ConnectCallback> deleter(this);
-    VLOG(4) << "connectSuccess() on " << address_;
+  void onConnected(Attempt& winner) {
+    std::unique_ptr<ConnectRace> deleter(this);
+    VLOG(4) << "connectSuccess() on " << winner.address;
+    cancelTimeout();
+    done_ = true;
+
+    auto socket = std::move(winner.socket);
+    // Cancelling calls connectErr() in-line, which ignores them now.
+    auto attempts = std::move(attempts_);
+    for (auto& attempt : attempts) {
+      if (attempt->socket) {
+        attempt->socket->closeNow();
+      }
+    }
 
-    auto connection = TcpConnectionFactory::createDuplexConnectionFromSocket(
-        std::move(socket_), RSocketStats::noop());
-    auto evb = folly::EventBaseManager::get()->getExistingEventBase();
-    CHECK(evb);
+    std::unique_ptr<DuplexConnection> connection;
+    if (framing_) {
+      connection = std::make_unique<FramedTcpConnection>(
+          std::move(socket),
+          RSocketStats::noop(),
+          *framing_,
+          TcpWriteCoalescing(),
+          readBufferAllocator_,
+          zeroCopy_,
+          socketOptions_.writeBufferLimits());
+    } else {
+      connection = std::make_unique<TcpDuplexConnection>(
+          std::move(socket),
+          RSocketStats::noop(),
+          TcpWriteCoalescing(),
+          readBufferAllocator_,
+          zeroCopy_,
+          socketOptions_.writeBufferLimits());
+    }
     connectPromise_.setValue(ConnectionFactory::ConnectedDuplexConnection{
-        std::move(connection), *evb});
+        std::move(connection), eventBase_});
   }
 
-  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
-    std::unique_ptr<ConnectCallback> deleter(this);
-    VLOG(4) << "connectErr(" << ex.what() << ") on " << address_;
-    connectPromise_.setException(ex);
+  void onFailed(Attempt& failed, const folly::AsyncSocketException& ex) {
+    VLOG(4) << "connectErr(" << ex.what() << ") on " << failed.address;
+    if (done_) {
+      return;
+    }
+    lastError_ = ex;
+    attempts_.remove_if(
+        [&](const std::unique_ptr<Attempt>& a) { return a.get() == &failed; });
+    if (!attempts_.empty()) {
+      return;
+    }
+    if (next_ < addresses_.size()) {
+      cancelTimeout();
+      startNext();
+      return;
+    }
+    std::unique_ptr<ConnectRace> deleter(this);
+    done_ = true;
+    connectPromise_.setException(lastError_);
   }
 
- private:
-  folly::SocketAddress address_;
-  folly::AsyncSocket::UniquePtr socket_;
+  folly::EventBase& eventBase_;
+  const std::vector<folly::SocketAddress> addresses_;
+  const std::chrono::milliseconds attemptDelay_;
   folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise_;
+  TcpZeroCopy zeroCopy_;
+  std::shared_ptr<folly::SSLContext> sslContext_;
+  const folly::Optional<size_t> framing_;
+  const TcpSocketOptions socketOptions_;
+  const std::shared_ptr<ReadBufferAllocator> readBufferAllocator_;
+
+  /// Index of the next address to try.
+  size_t next_{0};
+  std::list<std::unique_ptr<Attempt>> attempts_;
+  folly::AsyncSocketException lastError_{
+      folly::AsyncSocketException::UNKNOWN,
+      "No address to connect to"};
+  bool done_{false};
 };
 
+/// Alternates between IPv6 and IPv4 addresses, starting with the family of
+/// the first one, see RFC 8305 section 4.
+std::vector<folly::SocketAddress> interleaveFamilies(
+    std::vector<folly::SocketAddress> addresses) {
+  if (addresses.empty()) {
+    return addresses;
+  }
+  auto const firstFamily = addresses.front().getFamily();
+  std::deque<folly::SocketAddress> first, second;
+  for (auto& address : addresses) {
+    (address.getFamily() == firstFamily ? first : second)
+        .push_back(std::move(address));
+  }
+  std::vector<folly::SocketAddress> interleaved;
+  interleaved.reserve(addresses.size());
+  while (!first.empty() || !second.empty()) {
+    for (auto* family : {&first, &second}) {
+      if (!family->empty()) {
+        interleaved.push_back(std::move(family->front()));
+        family->pop_front();
+      }
+    }
+  }
+  return interleaved;
+}
+
 } // namespace
 
+constexpr std::chrono::milliseconds TcpConnectionFactory::kDefaultAttemptDelay;
+
+TcpConnectionFactory::TcpConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    TcpZeroCopy zeroCopy,
+    std::shared_ptr<folly::SSLContext> sslContext)
+    : TcpConnectionFactory(
+          eventBase,
+          std::vector<folly::SocketAddress>{std::move(address)},
+          kDefaultAttemptDelay,
+          zeroCopy,
+          std::move(sslContext)) {}
+
 TcpConnectionFactory::TcpConnectionFactory(
     folly::EventBase& eventBase,
-    folly::SocketAddress address)
-    : address_{std::move(address)}, eventBase_{&eventBase} {
+    std::vector<folly::SocketAddress> addresses,
+    std::chrono::milliseconds attemptDelay,
+    TcpZeroCopy zeroCopy,
+    std::shared_ptr<folly::SSLContext> sslContext)
+    : addresses_{interleaveFamilies(std::move(addresses))},
+      attemptDelay_{attemptDelay},
+      eventBase_{&eventBase},
+      zeroCopy_{zeroCopy},
+      sslContext_{std::move(sslContext)} {
   VLOG(1) << "Constructing TcpConnectionFactory";
+  CHECK(!addresses_.empty());
 }
 
 TcpConnectionFactory::~TcpConnectionFactory() {
   VLOG(1) << "Destroying TcpConnectionFactory";
 }
 
+void TcpConnectionFactory::setFraming(folly::Optional<size_t> maxFrameLength) {
+  framing_ = maxFrameLength;
+}
+
+void TcpConnectionFactory::setSocketOptions(TcpSocketOptions socketOptions) {
+  socketOptions_ = std::move(socketOptions);
+}
+
+void TcpConnectionFactory::setReadBufferAllocator(
+    std::shared_ptr<ReadBufferAllocator> allocator) {
+  readBufferAllocator_ = std::move(allocator);
+}
+
 folly::Future<ConnectionFactory::ConnectedDuplexConnection>
 TcpConnectionFactory::connect() {
+  return connectOn(*eventBase_);
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+TcpConnectionFactory::connectOn(folly::EventBase& eventBase) {
   folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise;
   auto connectFuture = connectPromise.getFuture();
 
-  eventBase_->runInEventBaseThread(
-      [ this, connectPromise = std::move(connectPromise) ]() mutable {
-        new ConnectCallback(address_, std::move(connectPromise));
-      });
+  eventBase.runInEventBaseThread([
+    this,
+    &eventBase,
+    connectPromise = std::move(connectPromise)
+  ]() mutable {
+    auto race = new ConnectRace(
+        eventBase,
+        addresses_,
+        attemptDelay_,
+        std::move(connectPromise),
+        zeroCopy_,
+        sslContext_,
+        framing_,
+        socketOptions_,
+        readBufferAllocator_);
+    race->startNext();
+  });
   return connectFuture;
 }
 
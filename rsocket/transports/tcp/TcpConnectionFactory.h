@@ -2,11 +2,18 @@
 
 #pragma once
 
+#include <chrono>
+#include <vector>
+
+#include <folly/Optional.h>
 #include <folly/SocketAddress.h>
 #include <folly/io/async/AsyncTransport.h>
+#include <folly/io/async/SSLContext.h>
 
 #include "rsocket/ConnectionFactory.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+#include "rsocket/transports/tcp/TcpSocketOptions.h"
 
 namespace rsocket {
 
@@ -16,25 +23,85 @@ class RSocketStats;
  * TCP implementation of ConnectionFactory for use with RSocket::createClient().
  *
  * Creation of this does nothing.  The `start` method kicks off work.
+ *
+ * With an SSLContext the connections are TLS connections, the handshake
+ * completes before connect() does.  zeroCopy doesn't apply to them.
+ *
+ * The connections live on the EventBase given, which may be that of a
+ * BusyPollEventBaseThread for the lowest latency.
+ *
+ * Given several addresses of the server, e.g. all the addresses its name
+ * resolves to, connections race them "happy eyeballs" style (RFC 8305): the
+ * addresses are tried in turn, alternating between IPv6 and IPv4, and the
+ * next one is tried once the ones before it took `attemptDelay` without
+ * connecting, or all failed.  The first connection to succeed wins, the
+ * other attempts are cancelled.
  */
 class TcpConnectionFactory : public ConnectionFactory {
  public:
-  TcpConnectionFactory(folly::EventBase& eventBase, folly::SocketAddress);
+  static constexpr std::chrono::milliseconds kDefaultAttemptDelay{250};
+
+  TcpConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress,
+      TcpZeroCopy zeroCopy = TcpZeroCopy(),
+      std::shared_ptr<folly::SSLContext> sslContext = nullptr);
+  TcpConnectionFactory(
+      folly::EventBase& eventBase,
+      std::vector<folly::SocketAddress> addresses,
+      std::chrono::milliseconds attemptDelay = kDefaultAttemptDelay,
+      TcpZeroCopy zeroCopy = TcpZeroCopy(),
+      std::shared_ptr<folly::SSLContext> sslContext = nullptr);
   virtual ~TcpConnectionFactory();
 
   /**
    * Connect to server defined in constructor.
    *
-   * Each call to connect() creates a new AsyncSocket.
+   * Each call to connect() creates a new AsyncSocket, one per address tried.
    */
   folly::Future<ConnectedDuplexConnection> connect() override;
 
+  /**
+   * Connect as connect() does, on `eventBase` instead of the EventBase given
+   * to the constructor.
+   */
+  folly::Future<ConnectedDuplexConnection> connectOn(
+      folly::EventBase& eventBase) override;
+
+  /**
+   * Connect FramedTcpConnections, which do the framing themselves, with this
+   * maximum frame length.  SetupParameters::maxFrameLength doesn't apply to
+   * them.  Only for protocol 1.0.
+   */
+  void setFraming(folly::Optional<size_t> maxFrameLength);
+
+  /**
+   * Socket options set on the sockets of the next connections, before they
+   * connect.
+   */
+  void setSocketOptions(TcpSocketOptions socketOptions);
+
+  /**
+   * Allocates the buffers the next connections read into, e.g.
+   * ReadBufferAllocator::recyclingSlabs() to recycle the buffers of large
+   * payloads as well.
+   */
+  void setReadBufferAllocator(std::shared_ptr<ReadBufferAllocator> allocator);
+
   static std::unique_ptr<DuplexConnection> createDuplexConnectionFromSocket(
       folly::AsyncTransportWrapper::UniquePtr socket,
       std::shared_ptr<RSocketStats> stats = std::shared_ptr<RSocketStats>());
 
  private:
-  folly::SocketAddress address_;
+  /// In the order they are tried.
+  std::vector<folly::SocketAddress> addresses_;
+  std::chrono::milliseconds attemptDelay_;
   folly::EventBase* eventBase_;
+  TcpZeroCopy zeroCopy_;
+  std::shared_ptr<folly::SSLContext> sslContext_;
+  folly::Optional<size_t> framing_;
+  TcpSocketOptions socketOptions_;
+  std::shared_ptr<ReadBufferAllocator> readBufferAllocator_{
+      ReadBufferAllocator::defaultAllocator()};
 };
 } // namespace rsocket
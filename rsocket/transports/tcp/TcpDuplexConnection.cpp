@@ -2,10 +2,19 @@
 
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
+#include <deque>
+#include <utility>
+
+#include <folly/Conv.h>
 #include <folly/ExceptionWrapper.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/Cursor.h>
 #include <folly/io/IOBufQueue.h>
 
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/internal/Allowance.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/transports/tcp/ReadSizeEstimator.h"
 #include "yarpl/flowable/Subscription.h"
 
 namespace rsocket {
@@ -13,15 +22,42 @@ namespace rsocket {
 using namespace yarpl::flowable;
 
 class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
-                        public folly::AsyncTransportWrapper::ReadCallback {
+                        public folly::AsyncTransportWrapper::ReadCallback,
+                        public folly::EventBase::LoopCallback {
   friend void intrusive_ptr_add_ref(TcpReaderWriter* x);
   friend void intrusive_ptr_release(TcpReaderWriter* x);
 
  public:
   explicit TcpReaderWriter(
       folly::AsyncTransportWrapper::UniquePtr&& socket,
-      std::shared_ptr<RSocketStats> stats)
-      : socket_(std::move(socket)), stats_(std::move(stats)) {}
+      std::shared_ptr<RSocketStats> stats,
+      TcpWriteCoalescing writeCoalescing,
+      std::shared_ptr<ReadBufferAllocator> readBufferAllocator,
+      TcpZeroCopy zeroCopy,
+      TcpWriteBufferLimits writeBufferLimits,
+      folly::Optional<size_t> maxFrameLength)
+      : socket_(std::move(socket)),
+        stats_(std::move(stats)),
+        writeCoalescing_(writeCoalescing),
+        readBufferAllocator_(std::move(readBufferAllocator)),
+        zeroCopy_(zeroCopy),
+        writeBufferLimits_(writeBufferLimits),
+        maxFrameLength_(maxFrameLength) {
+    CHECK(readBufferAllocator_);
+    CHECK_LE(writeBufferLimits_.lowWaterMark, writeBufferLimits_.highWaterMark);
+    CHECK(
+        writeBufferLimits_.maxBytes == 0 ||
+        writeBufferLimits_.maxBytes > writeBufferLimits_.highWaterMark);
+    if (writeBufferLimits_.stallTimeout.count() > 0) {
+      writeDeadline_ =
+          std::make_unique<WriteDeadline>(*this, socket_->getEventBase());
+    }
+    if (zeroCopy_.enabled) {
+      auto asyncSocket = dynamic_cast<folly::AsyncSocket*>(socket_.get());
+      zeroCopy_.enabled = asyncSocket && asyncSocket->setZeroCopy(true);
+      VLOG_IF(1, !zeroCopy_.enabled) << "MSG_ZEROCOPY is not supported";
+    }
+  }
 
   ~TcpReaderWriter() {
     CHECK(isClosed());
@@ -41,11 +77,15 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
 
     if (!inputSubscriber) {
       inputSubscriber_ = nullptr;
+      inputSizeHint_ = nullptr;
+      allowance_.consumeAll();
       return;
     }
 
     CHECK(!inputSubscriber_);
     inputSubscriber_ = std::move(inputSubscriber);
+    inputSizeHint_ = dynamic_cast<DuplexConnection::DuplexSubscriber*>(
+        inputSubscriber_.get());
 
     if (!socket_->getReadCallback()) {
       // The AsyncSocket will hold a reference to this instance until it calls
@@ -53,11 +93,27 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
       intrusive_ptr_add_ref(this);
       socket_->setReadCB(this);
     }
+    // The frames read before, e.g. by the subscriber which took the first
+    // frame only.
+    deliverFrames();
+  }
+
+  /// Credit of the input subscriber, only framed connections have flow
+  /// control.
+  void request(int64_t n) {
+    if (!maxFrameLength_) {
+      DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+          << "TcpDuplexConnection doesnt support proper flow control";
+      return;
+    }
+    allowance_.add(n);
+    deliverFrames();
   }
 
   void setOutputSubscription(yarpl::Reference<Subscription> subscription) {
     if (!subscription) {
       outputSubscription_ = nullptr;
+      outputWritability_ = nullptr;
       return;
     }
 
@@ -67,9 +123,13 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     }
 
     // No flow control at TCP level for output
-    // The AsyncSocket will accept all send calls
+    // The AsyncSocket will accept all send calls, the subscription is told
+    // when they pile up instead
     subscription->request(std::numeric_limits<int64_t>::max());
     outputSubscription_ = std::move(subscription);
+    outputWritability_ = dynamic_cast<DuplexConnection::DuplexSubscription*>(
+        outputSubscription_.get());
+    blocked_ = false;
   }
 
   void send(std::unique_ptr<folly::IOBuf> element) {
@@ -77,34 +137,138 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
       return;
     }
 
+    if (maxFrameLength_) {
+      element = prependFrameLength(std::move(element));
+      if (!element) {
+        closeErr(std::runtime_error("payload too big"));
+        return;
+      }
+    }
+
+    auto length = element->computeChainDataLength();
     if (stats_) {
-      stats_->bytesWritten(element->computeChainDataLength());
+      stats_->bytesWritten(length);
+    }
+
+    if (!writeCoalescing_.enabled) {
+      write(std::move(element), length);
+      updateWritability();
+      return;
+    }
+
+    pendingWrites_.append(std::move(element));
+    pendingBytes_ += length;
+    ++pendingFrames_;
+    if (pendingBytes_ >= writeCoalescing_.maxBytes ||
+        pendingFrames_ >= writeCoalescing_.maxFrames) {
+      flushPendingWrites();
+      return;
+    }
+    updateWritability();
+
+    if (!isLoopCallbackScheduled()) {
+      // the EventBase holds a reference to this instance until the callback
+      // runs
+      intrusive_ptr_add_ref(this);
+      socket_->getEventBase()->runInLoop(this);
     }
-    // now AsyncSocket will hold a reference to this instance as a writer until
-    // they call writeComplete or writeErr
-    intrusive_ptr_add_ref(this);
-    socket_->writeChain(this, std::move(element));
   }
 
   void close() {
+    // let the pending frames be written before the socket is closed
+    flushPendingWrites();
+    cancelWriteDeadline();
     if (auto socket = std::move(socket_)) {
       socket->close();
     }
+    outputWritability_ = nullptr;
     if (auto outputSubscription = std::move(outputSubscription_)) {
       outputSubscription->cancel();
     }
+    inputSizeHint_ = nullptr;
     if (auto subscriber = std::move(inputSubscriber_)) {
       subscriber->onComplete();
     }
   }
 
+  bool detachEventBase() {
+    if (isClosed() || !pendingWrites_.empty() || !writesInFlight_.empty()) {
+      return false;
+    }
+    auto const reading = socket_->getReadCallback() != nullptr;
+    if (reading) {
+      // The reference of the read callback stays until it is set again.
+      socket_->setReadCB(nullptr);
+    }
+    if (!socket_->isDetachable()) {
+      if (reading) {
+        socket_->setReadCB(this);
+      }
+      return false;
+    }
+    if (isLoopCallbackScheduled()) {
+      cancelLoopCallback();
+      intrusive_ptr_release(this);
+    }
+    socket_->detachEventBase();
+    if (writeDeadline_) {
+      writeDeadline_->detachEventBase();
+    }
+    detachedReading_ = reading;
+    return true;
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) {
+    if (isClosed()) {
+      return;
+    }
+    socket_->attachEventBase(&eventBase);
+    if (writeDeadline_) {
+      writeDeadline_->attachEventBase(&eventBase);
+    }
+    if (std::exchange(detachedReading_, false)) {
+      socket_->setReadCB(this);
+    }
+  }
+
+  int releaseSocket(folly::IOBufQueue& unread) {
+    if (isClosed() || zeroCopy_.enabled ||
+        !socket_->getSecurityProtocol().empty()) {
+      return -1;
+    }
+    auto asyncSocket = dynamic_cast<folly::AsyncSocket*>(socket_.get());
+    if (!asyncSocket) {
+      return -1;
+    }
+    // The corked frames go out first, often without waiting.
+    flushPendingWrites();
+    if (isClosed() || !writesInFlight_.empty()) {
+      return -1;
+    }
+    if (socket_->getReadCallback()) {
+      socket_->setReadCB(nullptr);
+      intrusive_ptr_release(this);
+    } else if (std::exchange(detachedReading_, false)) {
+      // The reference of the read callback it had before it was detached.
+      intrusive_ptr_release(this);
+    }
+    cancelWriteDeadline();
+    unread.append(undelivered_.move());
+    // The socket is closed without its descriptor from now on.
+    return asyncSocket->detachFd();
+  }
+
   void closeErr(folly::exception_wrapper ew) {
+    clearPendingWrites();
+    cancelWriteDeadline();
     if (auto socket = std::move(socket_)) {
       socket->close();
     }
+    outputWritability_ = nullptr;
     if (auto subscription = std::move(outputSubscription_)) {
       subscription->cancel();
     }
+    inputSizeHint_ = nullptr;
     if (auto subscriber = std::move(inputSubscriber_)) {
       subscriber->onError(std::move(ew));
     }
@@ -115,29 +279,296 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     return !socket_;
   }
 
+  void write(std::unique_ptr<folly::IOBuf> buf, size_t length) {
+    auto const flags = zeroCopy_.enabled && length >= zeroCopy_.minBytes
+        ? folly::WriteFlags::WRITE_MSG_ZEROCOPY
+        : folly::WriteFlags::NONE;
+    // the writes complete in order, writeSuccess pops their lengths
+    writesInFlight_.push_back(length);
+    bytesInFlight_ += length;
+    // now AsyncSocket will hold a reference to this instance as a writer until
+    // they call writeComplete or writeErr
+    intrusive_ptr_add_ref(this);
+    socket_->writeChain(this, std::move(buf), flags);
+  }
+
+  void flushPendingWrites() {
+    if (pendingWrites_.empty() || isClosed()) {
+      return;
+    }
+    auto const length = pendingBytes_;
+    pendingBytes_ = 0;
+    pendingFrames_ = 0;
+    write(pendingWrites_.move(), length);
+    updateWritability();
+  }
+
+  void popWriteInFlight() {
+    DCHECK(!writesInFlight_.empty());
+    bytesInFlight_ -= writesInFlight_.front();
+    writesInFlight_.pop_front();
+  }
+
+  size_t bufferedBytes() const {
+    return pendingBytes_ + bytesInFlight_ + undelivered_.chainLength();
+  }
+
+  /// Drops the read buffer, which is mostly tailroom kept for the next read,
+  /// and copies the bytes not delivered yet out of the buffers they pin.
+  void releaseBuffers() {
+    readBuffer_ = nullptr;
+    auto const buffered = undelivered_.chainLength();
+    if (buffered > 0) {
+      auto compact = folly::IOBuf::create(buffered);
+      folly::io::Cursor(undelivered_.front())
+          .pull(compact->writableData(), buffered);
+      compact->append(buffered);
+      undelivered_.move();
+      undelivered_.append(std::move(compact));
+    }
+  }
+
+  /// Tells the output subscription when the buffered bytes cross the limits,
+  /// and evicts the peer once they go above the maximum.
+  void updateWritability() {
+    if (isClosed()) {
+      return;
+    }
+    auto const buffered = pendingBytes_ + bytesInFlight_;
+    if (writeBufferLimits_.maxBytes > 0 &&
+        buffered > writeBufferLimits_.maxBytes) {
+      evict(buffered, folly::none);
+      return;
+    }
+    updateWriteDeadline(buffered);
+    if (!outputWritability_) {
+      return;
+    }
+    if (!blocked_ && buffered >= writeBufferLimits_.highWaterMark) {
+      blocked_ = true;
+      outputWritability_->onWritabilityChanged(false);
+    } else if (blocked_ && buffered <= writeBufferLimits_.lowWaterMark) {
+      blocked_ = false;
+      outputWritability_->onWritabilityChanged(true);
+    }
+  }
+
+  /// Runs the stall timeout while bytes are buffered.
+  void updateWriteDeadline(size_t buffered) {
+    if (!writeDeadline_) {
+      return;
+    }
+    if (buffered == 0) {
+      cancelWriteDeadline();
+    } else if (!writeDeadline_->isScheduled()) {
+      writtenAtDeadline_ = socket_->getAppBytesWritten();
+      writeDeadline_->scheduleTimeout(writeBufferLimits_.stallTimeout);
+    }
+  }
+
+  void cancelWriteDeadline() {
+    if (writeDeadline_) {
+      writeDeadline_->cancelTimeout();
+    }
+  }
+
+  /// Evicts the peer if the socket wrote nothing since the timeout was
+  /// scheduled, otherwise gives it another stall timeout.
+  void writeDeadlineExpired() {
+    if (isClosed()) {
+      return;
+    }
+    auto const written = socket_->getAppBytesWritten();
+    if (written == writtenAtDeadline_) {
+      evict(pendingBytes_ + bytesInFlight_, writeBufferLimits_.stallTimeout);
+      return;
+    }
+    writtenAtDeadline_ = written;
+    writeDeadline_->scheduleTimeout(writeBufferLimits_.stallTimeout);
+  }
+
+  void evict(
+      size_t buffered,
+      folly::Optional<std::chrono::milliseconds> stalled) {
+    VLOG(1) << "Evicting a slow peer with " << buffered << " bytes buffered";
+    if (stats_) {
+      stats_->connectionWriteStalled(buffered, stalled);
+    }
+    closeErr(std::runtime_error(
+        stalled ? "write stall timeout" : "write buffer limit exceeded"));
+  }
+
+  /// Reads the length field of the frame at the head of the bytes read.
+  size_t readFrameLength() const {
+    folly::io::Cursor cursor(undelivered_.front());
+    size_t length = 0;
+    for (size_t i = 0; i < FrameSerializerV1_0::kFrameLengthFieldLength; ++i) {
+      length = (length << 8) | cursor.read<uint8_t>();
+    }
+    return length;
+  }
+
+  /// Bytes still missing from the frame at the head of the bytes read, or
+  /// what the input subscriber expects if it does the framing.
+  size_t bytesExpected() const {
+    if (!maxFrameLength_) {
+      return inputSizeHint_ ? inputSizeHint_->bytesExpected() : 0;
+    }
+    auto const buffered = undelivered_.chainLength();
+    if (buffered < FrameSerializerV1_0::kFrameLengthFieldLength) {
+      return 0;
+    }
+    auto const length = readFrameLength();
+    if (length > *maxFrameLength_) {
+      return 0;
+    }
+    auto const size = length + FrameSerializerV1_0::kFrameLengthFieldLength;
+    return size > buffered ? size - buffered : 0;
+  }
+
+  /// Splits the frames off the bytes read as long as the input subscriber
+  /// has credit, and delivers them.
+  void deliverFrames() {
+    if (!maxFrameLength_ || delivering_ || !inputSubscriber_) {
+      return;
+    }
+    // Delivering the frames can close the connection and release the last
+    // reference to this instance.
+    boost::intrusive_ptr<TcpReaderWriter> self(this);
+    delivering_ = true;
+    while (deliverSomeFrames()) {
+      // Delivering the frames may have allowed more of them.
+    }
+    delivering_ = false;
+  }
+
+  /// The frames split at once are delivered together, so that the input
+  /// subscriber pays what it does per delivery once per read.  Returns false
+  /// once there is nothing to deliver, or on errors.
+  bool deliverSomeFrames() {
+    auto const fieldLength = FrameSerializerV1_0::kFrameLengthFieldLength;
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    std::string errorMsg;
+    while (inputSubscriber_ && allowance_.canConsume(1) &&
+           undelivered_.chainLength() >= fieldLength) {
+      auto const length = readFrameLength();
+      if (length < FrameSerializerV1_0::kFrameHeaderSize) {
+        errorMsg = "Invalid frame - Frame size smaller than minimum";
+        break;
+      }
+      if (length > *maxFrameLength_) {
+        errorMsg = folly::to<std::string>(
+            "Invalid frame - Frame size ",
+            length,
+            " larger than maximum ",
+            *maxFrameLength_);
+        break;
+      }
+      if (undelivered_.chainLength() < fieldLength + length) {
+        break;
+      }
+      undelivered_.trimStart(fieldLength);
+      frames.push_back(undelivered_.split(length));
+      CHECK(allowance_.tryConsume(1));
+    }
+
+    auto const delivered = !frames.empty();
+    if (frames.size() == 1) {
+      inputSubscriber_->onNext(std::move(frames.front()));
+    } else if (delivered && inputSizeHint_) {
+      inputSizeHint_->onNextMultiple(std::move(frames));
+    } else {
+      for (auto& frame : frames) {
+        if (!inputSubscriber_) {
+          break;
+        }
+        inputSubscriber_->onNext(std::move(frame));
+      }
+    }
+
+    if (!errorMsg.empty()) {
+      VLOG(1) << "error: " << errorMsg;
+      closeErr(std::runtime_error(std::move(errorMsg)));
+      return false;
+    }
+    return delivered;
+  }
+
+  /// Writes the length field of a frame in its headroom, or in a buffer
+  /// chained in front of it.  Returns nullptr for frames too long.
+  std::unique_ptr<folly::IOBuf> prependFrameLength(
+      std::unique_ptr<folly::IOBuf> frame) {
+    auto const fieldLength = FrameSerializerV1_0::kFrameLengthFieldLength;
+    auto const length = frame->computeChainDataLength();
+    if (length > *maxFrameLength_) {
+      return nullptr;
+    }
+    if (!frame->isSharedOne() && frame->headroom() >= fieldLength) {
+      frame->prepend(fieldLength);
+    } else {
+      auto head = folly::IOBuf::create(fieldLength);
+      head->append(fieldLength);
+      head->appendChain(std::move(frame));
+      frame = std::move(head);
+    }
+    auto data = frame->writableData();
+    data[0] = static_cast<uint8_t>(length >> 16);
+    data[1] = static_cast<uint8_t>(length >> 8);
+    data[2] = static_cast<uint8_t>(length);
+    return frame;
+  }
+
+  void clearPendingWrites() {
+    pendingWrites_.move();
+    pendingBytes_ = 0;
+    pendingFrames_ = 0;
+  }
+
+  void runLoopCallback() noexcept override {
+    flushPendingWrites();
+    intrusive_ptr_release(this);
+  }
+
   void writeSuccess() noexcept override {
+    popWriteInFlight();
+    updateWritability();
     intrusive_ptr_release(this);
   }
 
   void writeErr(
       size_t,
       const folly::AsyncSocketException& exn) noexcept override {
+    popWriteInFlight();
     closeErr(folly::exception_wrapper{exn});
     intrusive_ptr_release(this);
   }
 
   void getReadBuffer(void** bufReturn, size_t* lenReturn) noexcept override {
-    std::tie(*bufReturn, *lenReturn) = readBuffer_.preallocate(4096, 4096);
+    auto const size = readSizeEstimator_.nextReadSize(bytesExpected());
+
+    // Keep reading into the tailroom of the current buffer while it fits the
+    // next read, the frames read before share it.
+    if (!readBuffer_ || readBuffer_->tailroom() < size) {
+      readBuffer_ = readBufferAllocator_->allocate(size);
+    }
+    *bufReturn = readBuffer_->writableTail();
+    *lenReturn = readBuffer_->tailroom();
   }
 
   void readDataAvailable(size_t len) noexcept override {
-    readBuffer_.postallocate(len);
+    readSizeEstimator_.onRead(len, readBuffer_->tailroom());
+    readBuffer_->append(len);
     if (stats_) {
       stats_->bytesRead(len);
     }
 
-    if (inputSubscriber_) {
-      readBufferAvailable(readBuffer_.split(len));
+    auto data = readBuffer_->cloneOne();
+    readBuffer_->trimStart(len);
+    undelivered_.append(std::move(data));
+    if (maxFrameLength_) {
+      deliverFrames();
+    } else if (inputSubscriber_) {
+      readBufferAvailable(undelivered_.move());
     }
   }
 
@@ -157,16 +588,81 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
 
   void readBufferAvailable(
       std::unique_ptr<folly::IOBuf> readBuf) noexcept override {
+    if (maxFrameLength_) {
+      undelivered_.append(std::move(readBuf));
+      deliverFrames();
+      return;
+    }
     CHECK(inputSubscriber_);
     inputSubscriber_->onNext(std::move(readBuf));
   }
 
-  folly::IOBufQueue readBuffer_{folly::IOBufQueue::cacheChainLength()};
+  class WriteDeadline : public folly::AsyncTimeout {
+   public:
+    WriteDeadline(TcpReaderWriter& owner, folly::EventBase* eventBase)
+        : folly::AsyncTimeout(eventBase), owner_(owner) {}
+
+    void timeoutExpired() noexcept override {
+      // Evicting the peer can release the last reference to the owner.
+      boost::intrusive_ptr<TcpReaderWriter> owner(&owner_);
+      owner_.writeDeadlineExpired();
+    }
+
+   private:
+    TcpReaderWriter& owner_;
+  };
+
+  /// Bounds of the size of a single read.  Reads which need more than the
+  /// tailroom of the current buffer get a new one.
+  static constexpr size_t kMinReadSize = 1024;
+  static constexpr size_t kMaxReadSize = 1024 * 1024;
+
   folly::AsyncTransportWrapper::UniquePtr socket_;
   const std::shared_ptr<RSocketStats> stats_;
+  const TcpWriteCoalescing writeCoalescing_;
+
+  const std::shared_ptr<ReadBufferAllocator> readBufferAllocator_;
+  /// Buffer being read into, its tailroom is used by the next read.
+  std::unique_ptr<folly::IOBuf> readBuffer_;
+  ReadSizeEstimator readSizeEstimator_{kMinReadSize, kMaxReadSize};
+  /// Bytes read while there was no input subscriber, and on framed
+  /// connections the frames not delivered yet.
+  folly::IOBufQueue undelivered_{folly::IOBufQueue::cacheChainLength()};
+
+  /// Set on the connections which do the framing, see FramedTcpConnection.
+  const folly::Optional<size_t> maxFrameLength_;
+  /// Frames the input subscriber of a framed connection can take.
+  Allowance allowance_;
+  bool delivering_{false};
+  /// Whether the socket was read from before it was detached.
+  bool detachedReading_{false};
+
+  /// Frames corked during the current EventBase loop iteration.
+  folly::IOBufQueue pendingWrites_;
+  size_t pendingBytes_{0};
+  size_t pendingFrames_{0};
+
+  /// Disabled if the socket doesn't support MSG_ZEROCOPY.
+  TcpZeroCopy zeroCopy_;
+
+  const TcpWriteBufferLimits writeBufferLimits_;
+  /// Lengths of the writes handed to the socket which haven't completed yet.
+  std::deque<size_t> writesInFlight_;
+  size_t bytesInFlight_{0};
+  /// Whether the output subscription was told the connection isn't writable.
+  bool blocked_{false};
+  /// Scheduled while bytes are buffered, if there is a stall timeout.
+  std::unique_ptr<WriteDeadline> writeDeadline_;
+  /// What the socket had written when the deadline was scheduled.
+  size_t writtenAtDeadline_{0};
 
   yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber_;
+  /// The input subscriber, if it can tell how many bytes it expects, and take
+  /// several frames at once.
+  DuplexConnection::DuplexSubscriber* inputSizeHint_{nullptr};
   yarpl::Reference<Subscription> outputSubscription_;
+  /// The output subscription, if it can be told about writability.
+  DuplexConnection::DuplexSubscription* outputWritability_{nullptr};
   int refCount_{0};
 };
 
@@ -227,8 +723,7 @@ class TcpInputSubscription : public Subscription {
 
   void request(int64_t n) noexcept override {
     DCHECK(tcpReaderWriter_);
-    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
-        << "TcpDuplexConnection doesnt support proper flow control";
+    tcpReaderWriter_->request(n);
   }
 
   void cancel() noexcept override {
@@ -243,8 +738,36 @@ class TcpInputSubscription : public Subscription {
 
 TcpDuplexConnection::TcpDuplexConnection(
     folly::AsyncTransportWrapper::UniquePtr&& socket,
-    std::shared_ptr<RSocketStats> stats)
-    : tcpReaderWriter_(new TcpReaderWriter(std::move(socket), stats)),
+    std::shared_ptr<RSocketStats> stats,
+    TcpWriteCoalescing writeCoalescing,
+    std::shared_ptr<ReadBufferAllocator> readBufferAllocator,
+    TcpZeroCopy zeroCopy,
+    TcpWriteBufferLimits writeBufferLimits)
+    : TcpDuplexConnection(
+          std::move(socket),
+          std::move(stats),
+          writeCoalescing,
+          std::move(readBufferAllocator),
+          zeroCopy,
+          writeBufferLimits,
+          folly::none) {}
+
+TcpDuplexConnection::TcpDuplexConnection(
+    folly::AsyncTransportWrapper::UniquePtr&& socket,
+    std::shared_ptr<RSocketStats> stats,
+    TcpWriteCoalescing writeCoalescing,
+    std::shared_ptr<ReadBufferAllocator> readBufferAllocator,
+    TcpZeroCopy zeroCopy,
+    TcpWriteBufferLimits writeBufferLimits,
+    folly::Optional<size_t> maxFrameLength)
+    : tcpReaderWriter_(new TcpReaderWriter(
+          std::move(socket),
+          stats,
+          writeCoalescing,
+          std::move(readBufferAllocator),
+          zeroCopy,
+          writeBufferLimits,
+          maxFrameLength)),
       stats_(stats) {
   if (stats_) {
     stats_->duplexConnectionCreated("tcp", this);
@@ -262,6 +785,26 @@ folly::AsyncTransportWrapper* TcpDuplexConnection::getTransport() {
   return tcpReaderWriter_ ? tcpReaderWriter_->getTransport() : nullptr;
 }
 
+size_t TcpDuplexConnection::bufferedBytes() const {
+  return tcpReaderWriter_->bufferedBytes();
+}
+
+void TcpDuplexConnection::releaseBuffers() {
+  tcpReaderWriter_->releaseBuffers();
+}
+
+bool TcpDuplexConnection::detachEventBase() {
+  return tcpReaderWriter_->detachEventBase();
+}
+
+void TcpDuplexConnection::attachEventBase(folly::EventBase& eventBase) {
+  tcpReaderWriter_->attachEventBase(eventBase);
+}
+
+int TcpDuplexConnection::releaseSocket(folly::IOBufQueue& unread) {
+  return tcpReaderWriter_->releaseSocket(unread);
+}
+
 yarpl::Reference<DuplexConnection::Subscriber>
 TcpDuplexConnection::getOutput() {
   return yarpl::make_ref<TcpOutputSubscriber>(tcpReaderWriter_);
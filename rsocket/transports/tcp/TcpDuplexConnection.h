@@ -2,32 +2,114 @@
 
 #pragma once
 
+#include <chrono>
+
 #include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <folly/Optional.h>
 #include <folly/io/async/AsyncSocket.h>
 #include <folly/io/async/AsyncTransport.h>
 
 #include "rsocket/DuplexConnection.h"
 #include "rsocket/RSocketStats.h"
+#include "rsocket/transports/tcp/ReadBufferAllocator.h"
 #include "yarpl/flowable/Subscriber.h"
 
 namespace rsocket {
 
 class TcpReaderWriter;
 
+/// Controls how frames sent on a TcpDuplexConnection are written to the
+/// socket.  Frames sent during one EventBase loop iteration are corked and
+/// written to the socket as a single IOBuf chain (a single writev) at the end
+/// of the iteration, or as soon as one of the limits is reached.
+struct TcpWriteCoalescing {
+  /// When false every frame is written to the socket immediately.
+  bool enabled{true};
+  /// Flush once this many bytes are pending.
+  size_t maxBytes{64 * 1024};
+  /// Flush once this many frames are pending.
+  size_t maxFrames{128};
+};
+
+/// Opt-in MSG_ZEROCOPY sends.  Writes of at least `minBytes` are sent by the
+/// kernel straight from the IOBufs instead of being copied into the socket
+/// buffer, and the AsyncSocket keeps the IOBufs alive until the kernel reports
+/// the send as complete.  The completion notifications make this a loss for
+/// small writes.  Payloads must not be modified once they have been sent.
+/// The data of Payload::fromFile() goes from the page cache to the network.
+/// Sockets which don't support MSG_ZEROCOPY copy as usual.
+struct TcpZeroCopy {
+  bool enabled{false};
+  /// Smallest write, after coalescing, sent without copying.
+  size_t minBytes{16 * 1024};
+};
+
+/// Bounds the bytes a TcpDuplexConnection buffers while the socket can't keep
+/// up.  Once the frames corked or handed to the socket but not yet written to
+/// the network reach `highWaterMark` bytes, the output Subscription is told
+/// that the connection is not writable, and once they drop to `lowWaterMark`
+/// that it is writable again.  See DuplexSubscription.
+///
+/// A peer which stops reading is evicted: the connection is closed with an
+/// error, which disconnects it if it is resumable, once it buffers more than
+/// `maxBytes`, or once the socket wrote nothing for `stallTimeout` while bytes
+/// were buffered.  Both are reported to RSocketStats::connectionWriteStalled().
+/// 0 disables either.  `maxBytes` must leave room above `highWaterMark` for
+/// the frames sent before the output Subscription stops.
+struct TcpWriteBufferLimits {
+  size_t highWaterMark{4 * 1024 * 1024};
+  size_t lowWaterMark{1024 * 1024};
+  size_t maxBytes{0};
+  std::chrono::milliseconds stallTimeout{0};
+};
+
 class TcpDuplexConnection : public DuplexConnection {
  public:
   explicit TcpDuplexConnection(
       folly::AsyncTransportWrapper::UniquePtr&& socket,
-      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      TcpWriteCoalescing writeCoalescing = TcpWriteCoalescing(),
+      std::shared_ptr<ReadBufferAllocator> readBufferAllocator =
+          ReadBufferAllocator::defaultAllocator(),
+      TcpZeroCopy zeroCopy = TcpZeroCopy(),
+      TcpWriteBufferLimits writeBufferLimits = TcpWriteBufferLimits());
   ~TcpDuplexConnection();
 
   yarpl::Reference<DuplexConnection::Subscriber> getOutput() override;
 
   void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
 
+  /// The frames corked or handed to the socket but not yet written, and the
+  /// bytes read while there was no input subscriber.
+  size_t bufferedBytes() const override;
+
+  /// Drops the read buffer, and compacts the bytes read but not delivered.
+  void releaseBuffers() override;
+
+  /// Possible while no writes are corked or in flight.
+  bool detachEventBase() override;
+
+  void attachEventBase(folly::EventBase& eventBase) override;
+
+  /// Possible for plain TCP sockets, once the corked writes are written, and
+  /// without MSG_ZEROCOPY.
+  int releaseSocket(folly::IOBufQueue& unread) override;
+
   // Only to be used for observation purposes.
   folly::AsyncTransportWrapper* getTransport();
 
+ protected:
+  /// With `maxFrameLength` the connection does the framing of protocol 1.0,
+  /// see FramedTcpConnection.
+  TcpDuplexConnection(
+      folly::AsyncTransportWrapper::UniquePtr&& socket,
+      std::shared_ptr<RSocketStats> stats,
+      TcpWriteCoalescing writeCoalescing,
+      std::shared_ptr<ReadBufferAllocator> readBufferAllocator,
+      TcpZeroCopy zeroCopy,
+      TcpWriteBufferLimits writeBufferLimits,
+      folly::Optional<size_t> maxFrameLength);
+
  private:
   boost::intrusive_ptr<TcpReaderWriter> tcpReaderWriter_;
   std::shared_ptr<RSocketStats> stats_;
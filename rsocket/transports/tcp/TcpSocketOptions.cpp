@@ -0,0 +1,82 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/tcp/TcpSocketOptions.h"
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+
+#include <glog/logging.h>
+
+namespace rsocket {
+
+folly::AsyncSocket::OptionMap TcpSocketOptions::toOptionMap(
+    sa_family_t family) const {
+  folly::AsyncSocket::OptionMap options;
+  auto set = [&](int level, int name, int value) {
+    options[folly::AsyncSocket::OptionKey{level, name}] = value;
+  };
+  if (noDelay) {
+    set(IPPROTO_TCP, TCP_NODELAY, *noDelay ? 1 : 0);
+  }
+#ifdef TCP_QUICKACK
+  if (quickAck) {
+    set(IPPROTO_TCP, TCP_QUICKACK, *quickAck ? 1 : 0);
+  }
+#endif
+  if (sendBufferSize) {
+    set(SOL_SOCKET, SO_SNDBUF, *sendBufferSize);
+  }
+  if (receiveBufferSize) {
+    set(SOL_SOCKET, SO_RCVBUF, *receiveBufferSize);
+  }
+#ifdef SO_BUSY_POLL
+  if (busyPollMicros) {
+    set(SOL_SOCKET, SO_BUSY_POLL, *busyPollMicros);
+  }
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+  if (notSentLowAt) {
+    set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, static_cast<int>(*notSentLowAt));
+  }
+#endif
+#ifdef TCP_USER_TIMEOUT
+  if (userTimeout) {
+    set(IPPROTO_TCP, TCP_USER_TIMEOUT, static_cast<int>(userTimeout->count()));
+  }
+#endif
+  if (tos) {
+    if (family == AF_INET6) {
+      set(IPPROTO_IPV6, IPV6_TCLASS, *tos);
+    } else if (family == AF_INET) {
+      set(IPPROTO_IP, IP_TOS, *tos);
+    }
+  }
+  return options;
+}
+
+void TcpSocketOptions::apply(int fd, sa_family_t family) const {
+  for (auto const& option : toOptionMap(family)) {
+    if (option.first.apply(fd, option.second) != 0) {
+      VLOG(1) << "Failed to set socket option " << option.first.level << "/"
+              << option.first.optname << " on FD " << fd;
+    }
+  }
+}
+
+TcpWriteBufferLimits TcpSocketOptions::writeBufferLimits() const {
+  TcpWriteBufferLimits limits;
+  if (notSentLowAt && *notSentLowAt > 0) {
+    limits.highWaterMark = *notSentLowAt;
+    limits.lowWaterMark = *notSentLowAt / 2;
+  }
+  if (maxWriteBufferBytes) {
+    limits.maxBytes = *maxWriteBufferBytes;
+  }
+  if (writeStallTimeout) {
+    limits.stallTimeout = *writeStallTimeout;
+  }
+  return limits;
+}
+
+} // namespace rsocket
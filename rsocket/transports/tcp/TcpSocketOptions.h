@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdint>
+
+#include <folly/Optional.h>
+#include <folly/io/async/AsyncSocket.h>
+
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+
+namespace rsocket {
+
+/// Socket options set on each connection, accepted by TcpConnectionAcceptor
+/// or connected by TcpConnectionFactory.  The options left unset keep the
+/// defaults of the kernel, as do those the platform doesn't define.
+///
+/// The factory sets them before connecting, and the connection fails if the
+/// kernel rejects one.  The acceptor sets them once a connection is accepted,
+/// and only logs the options rejected.  The buffer sizes it sets don't change
+/// the window scale negotiated during the handshake.
+struct TcpSocketOptions {
+  /// TCP_NODELAY, disables Nagle's algorithm.
+  folly::Optional<bool> noDelay;
+
+  /// TCP_QUICKACK, acknowledges right away rather than delaying the ACKs.
+  /// The kernel may fall back to delayed ACKs later on.
+  folly::Optional<bool> quickAck;
+
+  /// SO_SNDBUF and SO_RCVBUF, in bytes.  Setting them disables the kernel's
+  /// autotuning of the buffer.
+  folly::Optional<int> sendBufferSize;
+  folly::Optional<int> receiveBufferSize;
+
+  /// SO_BUSY_POLL, microseconds to busy poll the device queue on blocking
+  /// receives.
+  folly::Optional<int> busyPollMicros;
+
+  /// TCP_NOTSENT_LOWAT, bytes not sent yet past which the socket isn't
+  /// writable.  The bytes queued past it wait in the AsyncSocket instead of
+  /// the kernel, writeBufferLimits() bounds them.
+  folly::Optional<uint32_t> notSentLowAt;
+
+  /// TCP_USER_TIMEOUT, how long sent bytes may remain unacknowledged before
+  /// the connection is dropped.
+  folly::Optional<std::chrono::milliseconds> userTimeout;
+
+  /// IP_TOS, or IPV6_TCLASS on IPv6 sockets.  The DSCP is the six upper bits.
+  folly::Optional<uint8_t> tos;
+
+  /// The options as set with setsockopt() on a socket of `family`.
+  folly::AsyncSocket::OptionMap toOptionMap(sa_family_t family) const;
+
+  /// Sets the options on the socket `fd` of `family`.
+  void apply(int fd, sa_family_t family) const;
+
+  /// Evicts the peers which don't read, see TcpWriteBufferLimits: the bytes a
+  /// connection may buffer, and how long its socket may write nothing while
+  /// bytes are buffered.
+  folly::Optional<size_t> maxWriteBufferBytes;
+  folly::Optional<std::chrono::milliseconds> writeStallTimeout;
+
+  /// Limits of the bytes buffered by the connections, see
+  /// TcpWriteBufferLimits.  With notSentLowAt the connections stop being
+  /// writable once as many bytes wait in the AsyncSocket as the kernel
+  /// keeps, so that a couple of notSentLowAt at most are queued in total.
+  TcpWriteBufferLimits writeBufferLimits() const;
+};
+
+} // namespace rsocket
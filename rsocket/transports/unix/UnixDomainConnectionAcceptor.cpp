@@ -0,0 +1,93 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/unix/UnixDomainConnectionAcceptor.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <folly/SocketAddress.h>
+#include <glog/logging.h>
+
+#include "rsocket/transports/unix/UnixDomainConnectionFactory.h"
+
+namespace rsocket {
+
+namespace {
+TcpConnectionAcceptor::Options toTcpOptions(
+    const UnixDomainConnectionAcceptor::Options& options) {
+  TcpConnectionAcceptor::Options tcpOptions(
+      0, options.threads, options.backlog);
+  tcpOptions.address = UnixDomainConnectionFactory::makeAddress(options.path);
+  return tcpOptions;
+}
+} // namespace
+
+UnixDomainConnectionAcceptor::UnixDomainConnectionAcceptor(Options options)
+    : TcpConnectionAcceptor(toTcpOptions(options)),
+      path_(std::move(options.path)) {}
+
+UnixDomainConnectionAcceptor::~UnixDomainConnectionAcceptor() {
+  unlinkSocketFile();
+}
+
+void UnixDomainConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  // bind() fails on an existing file, e.g. left behind by a crashed server.
+  unlinkStaleSocketFile();
+  TcpConnectionAcceptor::start(std::move(onAccept));
+  bound_ = true;
+}
+
+void UnixDomainConnectionAcceptor::stop() {
+  TcpConnectionAcceptor::stop();
+  unlinkSocketFile();
+}
+
+bool UnixDomainConnectionAcceptor::hasSocketFile() const {
+  // Abstract sockets go away with their file descriptor.
+  return !path_.empty() && path_[0] != '\0';
+}
+
+void UnixDomainConnectionAcceptor::unlinkStaleSocketFile() {
+  if (!hasSocketFile()) {
+    return;
+  }
+  // Only a socket nobody listens on any more, never a file of another kind
+  // or the socket of a running server.
+  struct stat st;
+  if (::lstat(path_.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+    return;
+  }
+  auto const fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return;
+  }
+  sockaddr_storage address;
+  auto const length = UnixDomainConnectionFactory::makeAddress(path_)
+                          .getAddress(&address);
+  auto const refused =
+      ::connect(fd, reinterpret_cast<sockaddr*>(&address), length) != 0 &&
+      errno == ECONNREFUSED;
+  ::close(fd);
+  if (!refused) {
+    return;
+  }
+  if (::unlink(path_.c_str()) != 0 && errno != ENOENT) {
+    VLOG(1) << "Failed to remove socket file " << path_ << ": errno " << errno;
+  }
+}
+
+void UnixDomainConnectionAcceptor::unlinkSocketFile() {
+  // Not the file of another server which bound the path.
+  if (!bound_ || !hasSocketFile()) {
+    return;
+  }
+  bound_ = false;
+  if (::unlink(path_.c_str()) != 0 && errno != ENOENT) {
+    VLOG(1) << "Failed to remove socket file " << path_ << ": errno " << errno;
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,60 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * Unix domain socket implementation of ConnectionAcceptor for use with
+ * RSocket::createServer.  Avoids the loopback TCP stack for peers on the same
+ * host.  Connections are served by the same machinery as TCP ones.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class UnixDomainConnectionAcceptor : public TcpConnectionAcceptor {
+ public:
+  struct Options {
+    explicit Options(
+        std::string path_ = "",
+        size_t threads_ = 2,
+        int backlog_ = 10)
+        : path(std::move(path_)), threads(threads_), backlog(backlog_) {}
+
+    /// Path of the socket.  A path starting with a NUL character names a
+    /// socket in the (Linux) abstract namespace, which has no file on disk.
+    std::string path;
+
+    /// Number of worker threads processing requests.
+    size_t threads;
+
+    /// Number of connections to buffer before accept handlers process them.
+    int backlog;
+  };
+
+  explicit UnixDomainConnectionAcceptor(Options);
+  ~UnixDomainConnectionAcceptor();
+
+  /**
+   * Remove a stale socket file left at the path, one which refuses
+   * connections, bind and start accepting.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting and remove the socket file, if this acceptor bound it.
+   */
+  void stop() override;
+
+ private:
+  bool hasSocketFile() const;
+  void unlinkStaleSocketFile();
+  void unlinkSocketFile();
+
+  const std::string path_;
+  bool bound_{false};
+};
+} // namespace rsocket
@@ -0,0 +1,20 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/unix/UnixDomainConnectionFactory.h"
+
+namespace rsocket {
+
+UnixDomainConnectionFactory::UnixDomainConnectionFactory(
+    folly::EventBase& eventBase,
+    std::string path)
+    : TcpConnectionFactory(eventBase, makeAddress(path)) {}
+
+folly::SocketAddress UnixDomainConnectionFactory::makeAddress(
+    const std::string& path) {
+  folly::SocketAddress address;
+  // Takes the bytes as they are, so abstract paths keep their leading NUL.
+  address.setFromPath(folly::StringPiece(path.data(), path.size()));
+  return address;
+}
+
+} // namespace rsocket
@@ -0,0 +1,26 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * Unix domain socket implementation of ConnectionFactory for use with
+ * RSocket::createClient().  The connections are the same as TCP ones, the
+ * socket is just connected to a path instead of a host and port.
+ *
+ * A path starting with a NUL character names a socket in the (Linux) abstract
+ * namespace.
+ */
+class UnixDomainConnectionFactory : public TcpConnectionFactory {
+ public:
+  UnixDomainConnectionFactory(folly::EventBase& eventBase, std::string path);
+
+  /// The address of the socket at `path`.
+  static folly::SocketAddress makeAddress(const std::string& path);
+};
+} // namespace rsocket
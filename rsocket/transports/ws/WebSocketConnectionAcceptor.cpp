@@ -0,0 +1,36 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/ws/WebSocketConnectionAcceptor.h"
+
+namespace rsocket {
+
+namespace {
+TcpConnectionAcceptor::Options withoutFraming(
+    TcpConnectionAcceptor::Options options) {
+  options.framing = folly::none;
+  return options;
+}
+} // namespace
+
+WebSocketConnectionAcceptor::WebSocketConnectionAcceptor(
+    Options options,
+    WebSocketOptions webSocketOptions)
+    : TcpConnectionAcceptor(withoutFraming(std::move(options))),
+      webSocketOptions_(std::move(webSocketOptions)) {}
+
+void WebSocketConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  TcpConnectionAcceptor::start([
+    onAccept = std::move(onAccept),
+    options = webSocketOptions_
+  ](std::unique_ptr<DuplexConnection> connection, folly::EventBase& evb) {
+    // Called on the EventBase of the connection.
+    onAccept(
+        std::make_unique<WebSocketDuplexConnection>(
+            std::move(connection),
+            WebSocketDuplexConnection::Role::SERVER,
+            options),
+        evb);
+  });
+}
+
+} // namespace rsocket
@@ -0,0 +1,33 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/ws/WebSocketDuplexConnection.h"
+
+namespace rsocket {
+
+/**
+ * WebSocket implementation of ConnectionAcceptor for use with
+ * RSocket::createServer.  Accepts TCP, or TLS with Options::sslContext,
+ * connections as TcpConnectionAcceptor does, and hands them over as
+ * WebSocketDuplexConnections, which answer the upgrade request of the client
+ * first.
+ *
+ * Options::framing doesn't apply, WebSocket messages frame the connections.
+ */
+class WebSocketConnectionAcceptor : public TcpConnectionAcceptor {
+ public:
+  explicit WebSocketConnectionAcceptor(
+      Options options,
+      WebSocketOptions webSocketOptions = WebSocketOptions());
+
+  /**
+   * Bind and start accepting, wrapping the connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+ private:
+  const WebSocketOptions webSocketOptions_;
+};
+} // namespace rsocket
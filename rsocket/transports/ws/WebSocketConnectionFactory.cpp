@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/ws/WebSocketConnectionFactory.h"
+
+#include <folly/io/async/EventBase.h>
+
+namespace rsocket {
+
+WebSocketConnectionFactory::WebSocketConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    WebSocketOptions options,
+    std::shared_ptr<folly::SSLContext> sslContext)
+    : TcpConnectionFactory(
+          eventBase,
+          address,
+          TcpZeroCopy(),
+          std::move(sslContext)),
+      options_([&] {
+        if (options.host.empty()) {
+          options.host = address.describe();
+        }
+        return std::move(options);
+      }()) {}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+WebSocketConnectionFactory::connect() {
+  return upgrade(TcpConnectionFactory::connect(), options_);
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+WebSocketConnectionFactory::connectOn(folly::EventBase& eventBase) {
+  return upgrade(TcpConnectionFactory::connectOn(eventBase), options_);
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+WebSocketConnectionFactory::upgrade(
+    folly::Future<ConnectedDuplexConnection> connected,
+    WebSocketOptions options) {
+  return connected.then(
+      [options = std::move(options)](ConnectedDuplexConnection connected) {
+        // The handshake starts right away, so on the EventBase of the socket.
+        auto* transportEvb = &connected.eventBase;
+        return via(transportEvb, [
+          connected = std::move(connected),
+          options = std::move(options)
+        ]() mutable {
+          auto connection = std::make_unique<WebSocketDuplexConnection>(
+              std::move(connected.connection),
+              WebSocketDuplexConnection::Role::CLIENT,
+              std::move(options));
+          return ConnectedDuplexConnection{std::move(connection),
+                                           connected.eventBase};
+        });
+      });
+}
+
+} // namespace rsocket
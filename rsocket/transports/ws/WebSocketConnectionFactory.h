@@ -0,0 +1,38 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "rsocket/transports/ws/WebSocketDuplexConnection.h"
+
+namespace rsocket {
+
+/**
+ * WebSocket implementation of ConnectionFactory for use with
+ * RSocket::createClient().  Connects over TCP, or TLS with an SSLContext, as
+ * TcpConnectionFactory does, and wraps the connections into
+ * WebSocketDuplexConnections, which upgrade them to WebSocket first.
+ *
+ * setFraming() doesn't apply, WebSocket messages frame the connections.
+ */
+class WebSocketConnectionFactory : public TcpConnectionFactory {
+ public:
+  WebSocketConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      WebSocketOptions options = WebSocketOptions(),
+      std::shared_ptr<folly::SSLContext> sslContext = nullptr);
+
+  folly::Future<ConnectedDuplexConnection> connect() override;
+
+  folly::Future<ConnectedDuplexConnection> connectOn(
+      folly::EventBase& eventBase) override;
+
+ private:
+  static folly::Future<ConnectedDuplexConnection> upgrade(
+      folly::Future<ConnectedDuplexConnection> connected,
+      WebSocketOptions options);
+
+  const WebSocketOptions options_;
+};
+} // namespace rsocket
@@ -0,0 +1,689 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/ws/WebSocketDuplexConnection.h"
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Random.h>
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/transports/ws/WebSocketFraming.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+namespace {
+
+/// Requests and responses of the handshake larger than this fail it.
+constexpr size_t kMaxHandshakeLength = 8192;
+
+/// Status codes of close messages.
+constexpr uint16_t kCloseNormal = 1000;
+constexpr uint16_t kCloseProtocolError = 1002;
+
+/// The start line and the headers of an HTTP/1.1 message, with lower case
+/// header names.
+struct HttpHead {
+  std::string startLine;
+  std::unordered_map<std::string, std::string> headers;
+
+  bool hasToken(const std::string& header, folly::StringPiece token) const {
+    auto it = headers.find(header);
+    if (it == headers.end()) {
+      return false;
+    }
+    std::vector<folly::StringPiece> tokens;
+    folly::split(',', it->second, tokens);
+    for (auto t : tokens) {
+      if (folly::trimWhitespace(t).equals(
+              token, folly::AsciiCaseInsensitive())) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+HttpHead parseHttpHead(folly::StringPiece head) {
+  std::vector<folly::StringPiece> lines;
+  folly::split("\r\n", head, lines);
+  HttpHead parsed;
+  if (lines.empty()) {
+    return parsed;
+  }
+  parsed.startLine = lines[0].str();
+  for (size_t i = 1; i < lines.size(); ++i) {
+    auto const colon = lines[i].find(':');
+    if (colon == folly::StringPiece::npos) {
+      continue;
+    }
+    auto name = lines[i].subpiece(0, colon).str();
+    folly::toLowerAscii(name);
+    parsed.headers[std::move(name)] =
+        folly::trimWhitespace(lines[i].subpiece(colon + 1)).str();
+  }
+  return parsed;
+}
+
+WebSocketMaskKey randomMaskKey() {
+  auto const random = folly::Random::rand32();
+  return WebSocketMaskKey{{static_cast<uint8_t>(random >> 24),
+                           static_cast<uint8_t>(random >> 16),
+                           static_cast<uint8_t>(random >> 8),
+                           static_cast<uint8_t>(random)}};
+}
+
+} // namespace
+
+class WebSocketChannel : public std::enable_shared_from_this<WebSocketChannel> {
+ public:
+  WebSocketChannel(
+      std::unique_ptr<DuplexConnection> connection,
+      WebSocketDuplexConnection::Role role,
+      WebSocketOptions options)
+      : inner_(std::move(connection)),
+        client_(role == WebSocketDuplexConnection::Role::CLIENT),
+        options_(std::move(options)) {}
+
+  ~WebSocketChannel() {
+    DCHECK(closed_);
+    DCHECK(!inputSubscriber_);
+  }
+
+  void start();
+
+  void setInput(
+      yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && closed_) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      inputMultiple_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+    inputMultiple_ = dynamic_cast<DuplexConnection::DuplexSubscriber*>(
+        inputSubscriber_.get());
+
+    // Messages which arrived while there was no subscriber.
+    auto messages = std::move(undelivered_);
+    undelivered_.clear();
+    deliver(std::move(messages));
+  }
+
+  void setOutputSubscription(yarpl::Reference<Subscription> subscription) {
+    if (!subscription) {
+      outputSubscription_ = nullptr;
+      return;
+    }
+
+    if (closed_) {
+      subscription->cancel();
+      return;
+    }
+
+    // No flow control on the output, the connection underneath buffers.
+    subscription->request(std::numeric_limits<int64_t>::max());
+    outputSubscription_ = std::move(subscription);
+  }
+
+  /// Sends frames as binary messages, all in one write.
+  void send(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    if (closed_) {
+      return;
+    }
+    std::unique_ptr<folly::IOBuf> chain;
+    for (auto& frame : frames) {
+      auto message = serializeMessage(WebSocketOpcode::BINARY, *frame);
+      if (!message) {
+        message = serializeMessage(WebSocketOpcode::BINARY, std::move(frame));
+      }
+      if (chain) {
+        chain->prependChain(std::move(message));
+      } else {
+        chain = std::move(message);
+      }
+    }
+    write(std::move(chain));
+  }
+
+  void onInnerSubscribe(yarpl::Reference<Subscription> subscription) {
+    if (closed_) {
+      subscription->cancel();
+      return;
+    }
+    innerInputSubscription_ = std::move(subscription);
+    innerInputSubscription_->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onBytes(std::unique_ptr<folly::IOBuf> bytes) {
+    if (closed_) {
+      return;
+    }
+    // Delivering can close the connection.
+    auto self = shared_from_this();
+    readQueue_.append(std::move(bytes));
+    if (!handshakeDone_ && !readHandshake()) {
+      return;
+    }
+    readMessages();
+  }
+
+  size_t bufferedBytes() const {
+    size_t bytes = readQueue_.chainLength() + messageLength_;
+    for (auto const& frame : undelivered_) {
+      bytes += frame->computeChainDataLength();
+    }
+    if (unsent_) {
+      bytes += unsent_->computeChainDataLength();
+    }
+    if (inner_) {
+      bytes += inner_->bufferedBytes();
+    }
+    return bytes;
+  }
+
+  void close() {
+    closeWith(folly::exception_wrapper(), kCloseNormal);
+  }
+
+  void closeErr(folly::exception_wrapper ew) {
+    closeWith(std::move(ew), kCloseProtocolError);
+  }
+
+  /// The input of the connection underneath terminated.
+  void onInnerInputClosed(folly::exception_wrapper ew) {
+    innerInputSubscription_ = nullptr;
+    if (ew) {
+      closeErr(std::move(ew));
+    } else {
+      close();
+    }
+  }
+
+  /// The output of the connection underneath canceled.
+  void onInnerOutputClosed() {
+    innerOutputClosed_ = true;
+    close();
+  }
+
+ private:
+  /// Reads the request of the client, or the response of the server.
+  /// Returns true once it is done.
+  bool readHandshake() {
+    if (readQueue_.empty()) {
+      return false;
+    }
+    auto const buffered =
+        std::min(readQueue_.chainLength(), kMaxHandshakeLength);
+    std::string head(buffered, '\0');
+    folly::io::Cursor(readQueue_.front())
+        .pull(&head[0], buffered);
+    auto const end = head.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      if (buffered == kMaxHandshakeLength) {
+        failHandshake("WebSocket handshake too long");
+      }
+      return false;
+    }
+    readQueue_.trimStart(end + 4);
+    head.resize(end);
+    auto const parsed = parseHttpHead(head);
+    if (client_ ? !checkResponse(parsed) : !answerRequest(parsed)) {
+      return false;
+    }
+
+    handshakeDone_ = true;
+    if (auto unsent = std::move(unsent_)) {
+      write(std::move(unsent));
+    }
+    return !closed_;
+  }
+
+  bool answerRequest(const HttpHead& request) {
+    auto key = request.headers.find("sec-websocket-key");
+    auto version = request.headers.find("sec-websocket-version");
+    if (request.startLine.compare(0, 4, "GET ") != 0 ||
+        !request.hasToken("upgrade", "websocket") ||
+        !request.hasToken("connection", "upgrade") ||
+        key == request.headers.end() || version == request.headers.end() ||
+        version->second != "13") {
+      writeRaw(folly::IOBuf::copyBuffer(
+          "HTTP/1.1 400 Bad Request\r\n"
+          "Sec-WebSocket-Version: 13\r\n"
+          "Content-Length: 0\r\n\r\n"));
+      failHandshake("Not a WebSocket upgrade request");
+      return false;
+    }
+
+    auto response = folly::to<std::string>(
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ",
+        webSocketAcceptKey(key->second),
+        "\r\n");
+    if (request.hasToken("sec-websocket-protocol", "rsocket")) {
+      response += "Sec-WebSocket-Protocol: rsocket\r\n";
+    }
+    response += "\r\n";
+    writeRaw(folly::IOBuf::copyBuffer(response));
+    return true;
+  }
+
+  bool checkResponse(const HttpHead& response) {
+    auto accept = response.headers.find("sec-websocket-accept");
+    if (response.startLine.compare(0, 13, "HTTP/1.1 101 ") != 0 ||
+        accept == response.headers.end() ||
+        accept->second != webSocketAcceptKey(key_)) {
+      failHandshake(folly::to<std::string>(
+          "WebSocket upgrade refused: ", response.startLine));
+      return false;
+    }
+    return true;
+  }
+
+  void failHandshake(std::string message) {
+    VLOG(1) << message;
+    closeErr(std::runtime_error(std::move(message)));
+  }
+
+  void readMessages() {
+    std::vector<std::unique_ptr<folly::IOBuf>> messages;
+    while (!closed_ && !readQueue_.empty()) {
+      auto header = parseWebSocketFrameHeader(*readQueue_.front());
+      if (!header) {
+        break;
+      }
+      if (header->reserved != 0 || header->maskKey.hasValue() == client_ ||
+          (header->isControl() &&
+           (!header->fin || header->payloadLength > 125))) {
+        failProtocol("Invalid WebSocket frame");
+        break;
+      }
+      if (header->payloadLength > options_.maxMessageLength - messageLength_) {
+        failProtocol(folly::to<std::string>(
+            "WebSocket message longer than ", options_.maxMessageLength));
+        break;
+      }
+      if (readQueue_.chainLength() <
+          header->headerLength + header->payloadLength) {
+        break;
+      }
+
+      readQueue_.trimStart(header->headerLength);
+      auto payload = header->payloadLength > 0
+          ? readQueue_.split(header->payloadLength)
+          : folly::IOBuf::create(0);
+      if (header->maskKey) {
+        unmaskWebSocketPayload(*payload, *header->maskKey);
+      }
+
+      switch (header->opcode) {
+        case WebSocketOpcode::BINARY:
+        case WebSocketOpcode::CONTINUATION:
+          if ((header->opcode == WebSocketOpcode::BINARY) != !message_) {
+            failProtocol("Unexpected WebSocket continuation");
+            break;
+          }
+          messageLength_ += header->payloadLength;
+          if (message_) {
+            message_->prependChain(std::move(payload));
+          } else {
+            message_ = std::move(payload);
+          }
+          if (header->fin) {
+            messageLength_ = 0;
+            messages.push_back(std::move(message_));
+          }
+          break;
+        case WebSocketOpcode::PING:
+          write(serializeMessage(WebSocketOpcode::PONG, std::move(payload)));
+          break;
+        case WebSocketOpcode::PONG:
+          break;
+        case WebSocketOpcode::CLOSE:
+          // The close message is answered by the one closing the connection.
+          deliver(std::move(messages));
+          close();
+          return;
+        default:
+          failProtocol("Unsupported WebSocket message, only binary ones are");
+          break;
+      }
+    }
+    deliver(std::move(messages));
+  }
+
+  void failProtocol(std::string message) {
+    VLOG(1) << message;
+    closeErr(std::runtime_error(std::move(message)));
+  }
+
+  /// A message with the payload appended to its header if it can be sent as
+  /// it is, nullptr if it has to be masked.
+  std::unique_ptr<folly::IOBuf> serializeMessage(
+      WebSocketOpcode opcode,
+      const folly::IOBuf& payload) {
+    if (!client_) {
+      return nullptr;
+    }
+    auto const key = randomMaskKey();
+    auto message = serializeWebSocketFrameHeader(
+        opcode, payload.computeChainDataLength(), key);
+    message->prependChain(maskedWebSocketPayload(payload, key));
+    return message;
+  }
+
+  std::unique_ptr<folly::IOBuf> serializeMessage(
+      WebSocketOpcode opcode,
+      std::unique_ptr<folly::IOBuf> payload) {
+    if (client_) {
+      return serializeMessage(opcode, *payload);
+    }
+    auto message = serializeWebSocketFrameHeader(
+        opcode, payload->computeChainDataLength(), folly::none);
+    message->prependChain(std::move(payload));
+    return message;
+  }
+
+  /// Writes messages, once the handshake is done.
+  void write(std::unique_ptr<folly::IOBuf> bytes) {
+    if (!bytes) {
+      return;
+    }
+    if (!handshakeDone_) {
+      if (unsent_) {
+        unsent_->prependChain(std::move(bytes));
+      } else {
+        unsent_ = std::move(bytes);
+      }
+      return;
+    }
+    writeRaw(std::move(bytes));
+  }
+
+  void writeRaw(std::unique_ptr<folly::IOBuf> bytes) {
+    if (!innerOutputClosed_) {
+      innerOutput_->onNext(std::move(bytes));
+    }
+  }
+
+  void deliver(std::vector<std::unique_ptr<folly::IOBuf>> messages) {
+    if (messages.empty()) {
+      return;
+    }
+    if (!inputSubscriber_) {
+      for (auto& message : messages) {
+        undelivered_.push_back(std::move(message));
+      }
+      return;
+    }
+    if (messages.size() > 1 && inputMultiple_) {
+      auto input = inputSubscriber_;
+      inputMultiple_->onNextMultiple(std::move(messages));
+      return;
+    }
+    for (auto& message : messages) {
+      // Dropped once the input canceled.
+      auto input = inputSubscriber_;
+      if (!input) {
+        break;
+      }
+      input->onNext(std::move(message));
+    }
+  }
+
+  void closeWith(folly::exception_wrapper ew, uint16_t status) {
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+
+    if (handshakeDone_) {
+      auto statusCode = folly::IOBuf::create(sizeof(status));
+      folly::io::Appender(statusCode.get(), 0).writeBE(status);
+      writeRaw(serializeMessage(WebSocketOpcode::CLOSE, std::move(statusCode)));
+    }
+    if (auto subscription = std::move(innerInputSubscription_)) {
+      subscription->cancel();
+    }
+    if (!innerOutputClosed_) {
+      innerOutputClosed_ = true;
+      innerOutput_->onComplete();
+    }
+    readQueue_.move();
+    message_ = nullptr;
+    undelivered_.clear();
+    unsent_ = nullptr;
+
+    if (auto subscription = std::move(outputSubscription_)) {
+      subscription->cancel();
+    }
+    inputMultiple_ = nullptr;
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      } else {
+        subscriber->onComplete();
+      }
+    }
+  }
+
+  std::unique_ptr<DuplexConnection> inner_;
+  yarpl::Reference<DuplexConnection::Subscriber> innerOutput_;
+  yarpl::Reference<Subscription> innerInputSubscription_;
+  bool innerOutputClosed_{false};
+
+  const bool client_;
+  const WebSocketOptions options_;
+  /// The Sec-WebSocket-Key of the client.
+  std::string key_;
+  bool handshakeDone_{false};
+  bool closed_{false};
+
+  folly::IOBufQueue readQueue_{folly::IOBufQueue::cacheChainLength()};
+  /// The fragments of a message received so far.
+  std::unique_ptr<folly::IOBuf> message_;
+  size_t messageLength_{0};
+  /// Messages read while there was no input.
+  std::vector<std::unique_ptr<folly::IOBuf>> undelivered_;
+  /// Messages sent before the handshake completed.
+  std::unique_ptr<folly::IOBuf> unsent_;
+
+  yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber_;
+  DuplexConnection::DuplexSubscriber* inputMultiple_{nullptr};
+  yarpl::Reference<Subscription> outputSubscription_;
+
+  friend class WebSocketDuplexConnection;
+};
+
+namespace {
+
+/// Reads the bytes of the connection underneath.
+class InnerInputSubscriber : public DuplexConnection::Subscriber {
+ public:
+  explicit InnerInputSubscriber(std::weak_ptr<WebSocketChannel> channel)
+      : channel_(std::move(channel)) {}
+
+  void onSubscribe(yarpl::Reference<Subscription> subscription) override {
+    if (auto channel = channel_.lock()) {
+      channel->onInnerSubscribe(std::move(subscription));
+    } else {
+      subscription->cancel();
+    }
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> bytes) override {
+    if (auto channel = channel_.lock()) {
+      channel->onBytes(std::move(bytes));
+    }
+  }
+
+  void onComplete() override {
+    if (auto channel = channel_.lock()) {
+      channel->onInnerInputClosed(folly::exception_wrapper());
+    }
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    if (auto channel = channel_.lock()) {
+      channel->onInnerInputClosed(std::move(ew));
+    }
+  }
+
+ private:
+  const std::weak_ptr<WebSocketChannel> channel_;
+};
+
+/// What the output of the connection underneath subscribes to.
+class InnerOutputSubscription : public Subscription {
+ public:
+  explicit InnerOutputSubscription(std::weak_ptr<WebSocketChannel> channel)
+      : channel_(std::move(channel)) {}
+
+  void request(int64_t) override {}
+
+  void cancel() override {
+    if (auto channel = channel_.lock()) {
+      channel->onInnerOutputClosed();
+    }
+  }
+
+ private:
+  const std::weak_ptr<WebSocketChannel> channel_;
+};
+
+class WebSocketOutputSubscriber : public DuplexConnection::DuplexSubscriber {
+ public:
+  explicit WebSocketOutputSubscriber(std::shared_ptr<WebSocketChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void onSubscribe(yarpl::Reference<Subscription> subscription) override {
+    CHECK(subscription);
+    channel_->setOutputSubscription(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    frames.push_back(std::move(frame));
+    channel_->send(std::move(frames));
+  }
+
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    channel_->send(std::move(frames));
+  }
+
+  void onComplete() override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+  void onError(folly::exception_wrapper) override {
+    channel_->setOutputSubscription(nullptr);
+  }
+
+ private:
+  const std::shared_ptr<WebSocketChannel> channel_;
+};
+
+class WebSocketInputSubscription : public Subscription {
+ public:
+  explicit WebSocketInputSubscription(std::shared_ptr<WebSocketChannel> channel)
+      : channel_(std::move(channel)) {
+    CHECK(channel_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(channel_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "WebSocketDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    channel_->setInput(nullptr);
+    channel_ = nullptr;
+  }
+
+ private:
+  std::shared_ptr<WebSocketChannel> channel_;
+};
+
+} // namespace
+
+void WebSocketChannel::start() {
+  std::weak_ptr<WebSocketChannel> weakSelf = shared_from_this();
+  innerOutput_ = inner_->getOutput();
+  innerOutput_->onSubscribe(
+      yarpl::make_ref<InnerOutputSubscription>(weakSelf));
+  inner_->setInput(yarpl::make_ref<InnerInputSubscriber>(weakSelf));
+
+  if (client_) {
+    key_ = makeWebSocketKey();
+    writeRaw(folly::IOBuf::copyBuffer(folly::to<std::string>(
+        "GET ",
+        options_.path,
+        " HTTP/1.1\r\n"
+        "Host: ",
+        options_.host,
+        "\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: ",
+        key_,
+        "\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Protocol: rsocket\r\n\r\n")));
+  }
+}
+
+WebSocketDuplexConnection::WebSocketDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    Role role,
+    WebSocketOptions options)
+    : channel_(std::make_shared<WebSocketChannel>(
+          std::move(connection),
+          role,
+          std::move(options))) {
+  channel_->start();
+}
+
+WebSocketDuplexConnection::~WebSocketDuplexConnection() {
+  channel_->close();
+  // After its input and output are closed.
+  channel_->inner_ = nullptr;
+}
+
+size_t WebSocketDuplexConnection::bufferedBytes() const {
+  return channel_->bufferedBytes();
+}
+
+yarpl::Reference<DuplexConnection::Subscriber>
+WebSocketDuplexConnection::getOutput() {
+  return yarpl::make_ref<WebSocketOutputSubscriber>(channel_);
+}
+
+void WebSocketDuplexConnection::setInput(
+    yarpl::Reference<DuplexConnection::Subscriber> inputSubscriber) {
+  // we don't care if the subscriber will call request synchronously
+  inputSubscriber->onSubscribe(
+      yarpl::make_ref<WebSocketInputSubscription>(channel_));
+  channel_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+class WebSocketChannel;
+
+struct WebSocketOptions {
+  /// The Host header and the path the client requests.
+  std::string host;
+  std::string path{"/"};
+
+  /// Messages longer than this fail the connection.
+  size_t maxMessageLength{kMaxFrameLength};
+};
+
+/// RSocket over WebSocket (RFC 6455), on top of a connection carrying bytes,
+/// e.g. a TcpDuplexConnection.  The opening handshake goes over the
+/// connection first, then each RSocket frame is a binary message, so the
+/// connection is framed.
+///
+/// The payloads of messages are sliced out of the read buffers.  The server
+/// unmasks them in place, with SIMD instructions where the build has them,
+/// see xorWebSocketMask().  The client masks the frames it sends into copies.
+/// Pings are answered, and a close message closes the connection.
+class WebSocketDuplexConnection : public DuplexConnection {
+ public:
+  enum class Role { CLIENT, SERVER };
+
+  WebSocketDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      Role role,
+      WebSocketOptions options = WebSocketOptions());
+  ~WebSocketDuplexConnection();
+
+  yarpl::Reference<DuplexConnection::Subscriber> getOutput() override;
+
+  void setInput(yarpl::Reference<DuplexConnection::Subscriber>) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+  /// The bytes of the messages read but not delivered yet, the frames sent
+  /// before the handshake completed, and those of the connection underneath.
+  size_t bufferedBytes() const override;
+
+ private:
+  std::shared_ptr<WebSocketChannel> channel_;
+};
+} // namespace rsocket
@@ -0,0 +1,214 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "rsocket/transports/ws/WebSocketFraming.h"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <openssl/sha.h>
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kAcceptGuid{
+    "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"};
+
+std::string base64(const uint8_t* data, size_t length) {
+  static constexpr char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string encoded;
+  encoded.reserve((length + 2) / 3 * 4);
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t group = uint32_t(data[i]) << 16;
+    if (i + 1 < length) {
+      group |= uint32_t(data[i + 1]) << 8;
+    }
+    if (i + 2 < length) {
+      group |= data[i + 2];
+    }
+    encoded.push_back(kAlphabet[(group >> 18) & 0x3f]);
+    encoded.push_back(kAlphabet[(group >> 12) & 0x3f]);
+    encoded.push_back(i + 1 < length ? kAlphabet[(group >> 6) & 0x3f] : '=');
+    encoded.push_back(i + 2 < length ? kAlphabet[group & 0x3f] : '=');
+  }
+  return encoded;
+}
+
+} // namespace
+
+folly::Optional<WebSocketFrameHeader> parseWebSocketFrameHeader(
+    const folly::IOBuf& buf) {
+  folly::io::Cursor cur(&buf);
+  uint8_t first;
+  uint8_t second;
+  if (!cur.tryRead(first) || !cur.tryRead(second)) {
+    return folly::none;
+  }
+
+  WebSocketFrameHeader header;
+  header.fin = first & 0x80;
+  header.reserved = (first >> 4) & 0x7;
+  header.opcode = static_cast<WebSocketOpcode>(first & 0x0f);
+  header.payloadLength = second & 0x7f;
+  header.headerLength = 2;
+  if (header.payloadLength == 126) {
+    uint16_t length;
+    if (!cur.tryReadBE(length)) {
+      return folly::none;
+    }
+    header.payloadLength = length;
+    header.headerLength += sizeof(length);
+  } else if (header.payloadLength == 127) {
+    uint64_t length;
+    if (!cur.tryReadBE(length)) {
+      return folly::none;
+    }
+    header.payloadLength = length;
+    header.headerLength += sizeof(length);
+  }
+  if (second & 0x80) {
+    WebSocketMaskKey key;
+    if (!cur.canAdvance(key.size())) {
+      return folly::none;
+    }
+    cur.pull(key.data(), key.size());
+    header.maskKey = key;
+    header.headerLength += key.size();
+  }
+  return header;
+}
+
+std::unique_ptr<folly::IOBuf> serializeWebSocketFrameHeader(
+    WebSocketOpcode opcode,
+    uint64_t payloadLength,
+    const folly::Optional<WebSocketMaskKey>& maskKey) {
+  // The longest header: 2 bytes, 8 bytes of length and the mask key.
+  auto header = folly::IOBuf::create(14);
+  folly::io::Appender appender(header.get(), 0);
+  appender.write<uint8_t>(0x80 | static_cast<uint8_t>(opcode));
+  uint8_t const maskBit = maskKey ? 0x80 : 0;
+  if (payloadLength < 126) {
+    appender.write<uint8_t>(maskBit | static_cast<uint8_t>(payloadLength));
+  } else if (payloadLength <= 0xffff) {
+    appender.write<uint8_t>(maskBit | 126);
+    appender.writeBE<uint16_t>(static_cast<uint16_t>(payloadLength));
+  } else {
+    appender.write<uint8_t>(maskBit | 127);
+    appender.writeBE<uint64_t>(payloadLength);
+  }
+  if (maskKey) {
+    appender.push(maskKey->data(), maskKey->size());
+  }
+  return header;
+}
+
+void xorWebSocketMask(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t length,
+    const WebSocketMaskKey& maskKey,
+    size_t offset) {
+  // The key, rotated to start at `in`, repeated over a vector.
+  alignas(32) uint8_t pattern[32];
+  for (size_t i = 0; i < sizeof(pattern); ++i) {
+    pattern[i] = maskKey[(offset + i) % maskKey.size()];
+  }
+
+  size_t i = 0;
+#if defined(__AVX2__)
+  auto const mask256 =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(pattern));
+  for (; i + 32 <= length; i += 32) {
+    auto const bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(bytes, mask256));
+  }
+#endif
+#if defined(__SSE2__)
+  auto const mask128 =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(pattern));
+  for (; i + 16 <= length; i += 16) {
+    auto const bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(bytes, mask128));
+  }
+#elif defined(__ARM_NEON)
+  auto const mask128 = vld1q_u8(pattern);
+  for (; i + 16 <= length; i += 16) {
+    vst1q_u8(out + i, veorq_u8(vld1q_u8(in + i), mask128));
+  }
+#endif
+  // The vectors are multiples of 8 bytes, so the pattern still starts at i.
+  uint64_t mask64;
+  std::memcpy(&mask64, pattern, sizeof(mask64));
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, in + i, sizeof(word));
+    word ^= mask64;
+    std::memcpy(out + i, &word, sizeof(word));
+  }
+  for (; i < length; ++i) {
+    out[i] = in[i] ^ pattern[i % 8];
+  }
+}
+
+void unmaskWebSocketPayload(
+    folly::IOBuf& payload,
+    const WebSocketMaskKey& key) {
+  size_t offset = 0;
+  auto* buf = &payload;
+  do {
+    if (buf->length() > 0) {
+      auto* data = buf->writableData();
+      xorWebSocketMask(data, data, buf->length(), key, offset);
+      offset += buf->length();
+    }
+    buf = buf->next();
+  } while (buf != &payload);
+}
+
+std::unique_ptr<folly::IOBuf> maskedWebSocketPayload(
+    const folly::IOBuf& payload,
+    const WebSocketMaskKey& key) {
+  auto const length = payload.computeChainDataLength();
+  auto masked = folly::IOBuf::create(length);
+  size_t offset = 0;
+  for (auto range : payload) {
+    xorWebSocketMask(
+        masked->writableTail(), range.data(), range.size(), key, offset);
+    masked->append(range.size());
+    offset += range.size();
+  }
+  return masked;
+}
+
+std::string makeWebSocketKey() {
+  uint8_t nonce[16];
+  for (size_t i = 0; i < sizeof(nonce); i += sizeof(uint64_t)) {
+    auto const random = folly::Random::rand64();
+    std::memcpy(nonce + i, &random, sizeof(random));
+  }
+  return base64(nonce, sizeof(nonce));
+}
+
+std::string webSocketAcceptKey(folly::StringPiece key) {
+  auto const keyAndGuid = key.str() + kAcceptGuid.str();
+  uint8_t digest[SHA_DIGEST_LENGTH];
+  SHA1(
+      reinterpret_cast<const uint8_t*>(keyAndGuid.data()),
+      keyAndGuid.size(),
+      digest);
+  return base64(digest, sizeof(digest));
+}
+
+} // namespace rsocket
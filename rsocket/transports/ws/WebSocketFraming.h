@@ -0,0 +1,83 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+namespace rsocket {
+
+/// The opcodes of RFC 6455 frames.
+enum class WebSocketOpcode : uint8_t {
+  CONTINUATION = 0x0,
+  TEXT = 0x1,
+  BINARY = 0x2,
+  CLOSE = 0x8,
+  PING = 0x9,
+  PONG = 0xA,
+};
+
+using WebSocketMaskKey = std::array<uint8_t, 4>;
+
+/// The header of a WebSocket frame, as it is on the wire.
+struct WebSocketFrameHeader {
+  bool fin{true};
+  /// RSV1-3, which no extension is negotiated for.
+  uint8_t reserved{0};
+  WebSocketOpcode opcode{WebSocketOpcode::BINARY};
+  folly::Optional<WebSocketMaskKey> maskKey;
+  uint64_t payloadLength{0};
+  /// Bytes of the header, including the extended length and the mask key.
+  size_t headerLength{0};
+
+  bool isControl() const {
+    return static_cast<uint8_t>(opcode) & 0x8;
+  }
+};
+
+/// The header at the front of `buf`, none until all of it is there.
+folly::Optional<WebSocketFrameHeader> parseWebSocketFrameHeader(
+    const folly::IOBuf& buf);
+
+/// The header of an unfragmented frame with a payload of `payloadLength`
+/// bytes, which the client masks with `maskKey`.
+std::unique_ptr<folly::IOBuf> serializeWebSocketFrameHeader(
+    WebSocketOpcode opcode,
+    uint64_t payloadLength,
+    const folly::Optional<WebSocketMaskKey>& maskKey);
+
+/// Writes the `length` bytes of `in` XORed with the mask key to `out`, which
+/// can be `in` to unmask in place.  `offset` is the position of `in` in the
+/// payload, for payloads split across buffers.  16 or 32 bytes at a time with
+/// SSE2, AVX2 or NEON.
+void xorWebSocketMask(
+    uint8_t* out,
+    const uint8_t* in,
+    size_t length,
+    const WebSocketMaskKey& maskKey,
+    size_t offset);
+
+/// Unmasks a payload in place, buffer by buffer.  The bytes have to be
+/// referenced by nothing else, e.g. by the other slices of a read buffer.
+void unmaskWebSocketPayload(folly::IOBuf& payload, const WebSocketMaskKey& key);
+
+/// A masked copy of `payload` in a single buffer.  Clients can't mask the
+/// frames they send in place, their buffers may be shared.
+std::unique_ptr<folly::IOBuf> maskedWebSocketPayload(
+    const folly::IOBuf& payload,
+    const WebSocketMaskKey& key);
+
+/// A random Sec-WebSocket-Key.
+std::string makeWebSocketKey();
+
+/// The Sec-WebSocket-Accept of a Sec-WebSocket-Key.
+std::string webSocketAcceptKey(folly::StringPiece key);
+
+} // namespace rsocket
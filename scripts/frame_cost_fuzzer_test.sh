@@ -0,0 +1,13 @@
+#!/usr/bin/env bash
+
+if [ ! -s ./build/frame_cost_fuzzer ]; then
+    echo "./build/frame_cost_fuzzer binary not found!"
+    exit 1
+fi
+
+shopt -s nullglob
+for fuzzcase in ./test/fuzzer_testcases/frame_cost_fuzzer/* \
+                ./test/fuzzer_testcases/frame_fuzzer/*; do
+  echo "testing with $fuzzcase..."
+  ./build/frame_cost_fuzzer < $fuzzcase || exit 1
+done
@@ -27,6 +27,11 @@ class BaseSubscriber : public virtual yarpl::Refcounted {
   void assertNotCompleted();
   void assertCanceled();
 
+  /// Values received so far.
+  size_t valueCount() const {
+    return valuesCount_;
+  }
+
  protected:
   std::atomic<bool> canceled_{false};
 
@@ -0,0 +1,146 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "tck-test/StressRunner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <glog/logging.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "tck-test/TestInterpreter.h"
+
+namespace rsocket {
+namespace tck {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// What the runs of one thread found.
+struct RunnerResults {
+  size_t runs{0};
+  size_t values{0};
+  std::vector<Clock::duration> latencies;
+  std::vector<std::string> failedTests;
+};
+
+std::chrono::microseconds percentile(
+    const std::vector<Clock::duration>& sorted,
+    double fraction) {
+  if (sorted.empty()) {
+    return std::chrono::microseconds(0);
+  }
+  auto const index = std::min(
+      sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+  return std::chrono::duration_cast<std::chrono::microseconds>(sorted[index]);
+}
+
+} // namespace
+
+StressRunner::StressRunner(
+    const TestSuite& testSuite,
+    folly::SocketAddress address,
+    StressOptions options)
+    : address_(std::move(address)), options_(options) {
+  CHECK_GT(options_.connections, 0);
+  CHECK_GT(options_.concurrency, 0);
+  for (const auto& test : testSuite.tests()) {
+    if (test.resumption()) {
+      LOG(INFO) << "Leaving out " << test.name() << ", it resumes its clients";
+      continue;
+    }
+    tests_.push_back(&test);
+  }
+}
+
+StressReport StressRunner::run() {
+  StressReport report;
+  if (tests_.empty()) {
+    return report;
+  }
+
+  // As many EventBase threads as there are cores, or connections if fewer.
+  auto const threads = std::max<size_t>(
+      1,
+      std::min<size_t>(
+          options_.connections, std::thread::hardware_concurrency()));
+  std::vector<std::unique_ptr<folly::ScopedEventBaseThread>> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.push_back(std::make_unique<folly::ScopedEventBaseThread>());
+  }
+  std::vector<std::shared_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < options_.connections; ++i) {
+    clients.push_back(
+        RSocket::createConnectedClient(
+            std::make_unique<TcpConnectionFactory>(
+                *workers[i % threads]->getEventBase(), address_))
+            .get());
+  }
+
+  std::atomic<size_t> next{0};
+  std::vector<RunnerResults> results(options_.concurrency);
+  std::vector<std::thread> runners;
+  auto const start = Clock::now();
+  for (size_t r = 0; r < options_.concurrency; ++r) {
+    runners.emplace_back([&, r] {
+      auto& mine = results[r];
+      for (;;) {
+        auto const index = next.fetch_add(1);
+        if (index >= options_.runs) {
+          return;
+        }
+
+        // With a rate, a run is timed from when it was due to start, so that
+        // the runs held up behind slow ones count their wait.
+        auto begin = Clock::now();
+        if (options_.rate > 0) {
+          begin = start +
+              std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<double>(index / options_.rate));
+          std::this_thread::sleep_until(begin);
+        }
+
+        auto const& test = *tests_[index % tests_.size()];
+        TestInterpreter interpreter(test, clients[index % clients.size()]);
+        auto const passed = interpreter.run();
+        mine.latencies.push_back(Clock::now() - begin);
+        mine.values += interpreter.receivedValues();
+        ++mine.runs;
+        if (!passed) {
+          mine.failedTests.push_back(test.name());
+        }
+      }
+    });
+  }
+  for (auto& runner : runners) {
+    runner.join();
+  }
+  report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start);
+
+  std::vector<Clock::duration> latencies;
+  std::set<std::string> failedTests;
+  for (auto& mine : results) {
+    report.runs += mine.runs;
+    report.values += mine.values;
+    report.failures += mine.failedTests.size();
+    latencies.insert(
+        latencies.end(), mine.latencies.begin(), mine.latencies.end());
+    failedTests.insert(mine.failedTests.begin(), mine.failedTests.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  report.p50 = percentile(latencies, 0.5);
+  report.p99 = percentile(latencies, 0.99);
+  report.max = percentile(latencies, 1);
+  report.failedTests.assign(failedTests.begin(), failedTests.end());
+  return report;
+}
+
+} // namespace tck
+} // namespace rsocket
@@ -0,0 +1,68 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <folly/SocketAddress.h>
+
+#include "tck-test/TestSuite.h"
+
+namespace rsocket {
+namespace tck {
+
+struct StressOptions {
+  /// Connections to the server, the runs are spread across them.
+  size_t connections{8};
+
+  /// Runs in flight at once, each on its own thread.
+  size_t concurrency{32};
+
+  /// Runs in total, cycling through the tests.
+  size_t runs{1000};
+
+  /// Runs started per second, 0 to start them as fast as they complete.
+  double rate{0};
+};
+
+struct StressReport {
+  size_t runs{0};
+  size_t failures{0};
+  /// Values received by the subscribers of all the runs.
+  size_t values{0};
+  std::chrono::microseconds elapsed{0};
+
+  /// Of a run, from its start to its last command.
+  std::chrono::microseconds p50{0};
+  std::chrono::microseconds p99{0};
+  std::chrono::microseconds max{0};
+
+  /// Names of the tests which failed, once each.
+  std::vector<std::string> failedTests;
+};
+
+/// Runs the tests of a suite again and again, many at once over a few shared
+/// connections, to check that the marble outcomes hold under load.  The runs
+/// assert what the sequential runs of TestInterpreter do, and are timed.
+///
+/// Tests of resumption, which disconnect their clients, are left out: the
+/// connections are shared.
+class StressRunner {
+ public:
+  StressRunner(
+      const TestSuite& testSuite,
+      folly::SocketAddress address,
+      StressOptions options);
+
+  StressReport run();
+
+ private:
+  std::vector<const Test*> tests_;
+  const folly::SocketAddress address_;
+  const StressOptions options_;
+};
+
+} // namespace tck
+} // namespace rsocket
@@ -19,10 +19,28 @@ namespace rsocket {
 namespace tck {
 
 TestInterpreter::TestInterpreter(const Test& test, SocketAddress address)
-    : address_(address), test_(test) {
+    : worker_(std::make_unique<folly::ScopedEventBaseThread>()),
+      address_(address),
+      test_(test) {
   DCHECK(!test.empty());
 }
 
+TestInterpreter::TestInterpreter(
+    const Test& test,
+    std::shared_ptr<RSocketClient> client)
+    : sharedClient_(std::make_shared<TestClient>(std::move(client))),
+      test_(test) {
+  DCHECK(!test.empty());
+}
+
+size_t TestInterpreter::receivedValues() const {
+  size_t values = 0;
+  for (const auto& subscriber : testSubscribers_) {
+    values += subscriber.second->valueCount();
+  }
+  return values;
+}
+
 bool TestInterpreter::run() {
   LOG(INFO) << "Executing test: " << test_.name() << " ("
             << test_.commands().size() - 1 << " commands)";
@@ -72,6 +90,9 @@ bool TestInterpreter::run() {
 }
 
 void TestInterpreter::handleDisconnect(const DisconnectCommand& command) {
+  if (sharedClient_) {
+    throw std::runtime_error("can't disconnect a shared client");
+  }
   if (testClient_.find(command.clientId()) != testClient_.end()) {
     LOG(INFO) << "Disconnecting the client";
     testClient_[command.clientId()]->client->disconnect(
@@ -80,6 +101,9 @@ void TestInterpreter::handleDisconnect(const DisconnectCommand& command) {
 }
 
 void TestInterpreter::handleResume(const ResumeCommand& command) {
+  if (sharedClient_) {
+    throw std::runtime_error("can't resume a shared client");
+  }
   if (testClient_.find(command.clientId()) != testClient_.end()) {
     LOG(INFO) << "Resuming the client";
     testClient_[command.clientId()]->client->resume().get();
@@ -88,14 +112,16 @@ void TestInterpreter::handleResume(const ResumeCommand& command) {
 
 void TestInterpreter::handleSubscribe(const SubscribeCommand& command) {
   // If client does not exist, create a new client.
-  if (testClient_.find(command.clientId()) == testClient_.end()) {
+  if (sharedClient_) {
+    testClient_[command.clientId()] = sharedClient_;
+  } else if (testClient_.find(command.clientId()) == testClient_.end()) {
     SetupParameters setupParameters;
     if (test_.resumption()) {
       setupParameters.resumable = true;
     }
     auto client = RSocket::createConnectedClient(
                       std::make_unique<TcpConnectionFactory>(
-                          *worker_.getEventBase(), std::move(address_)),
+                          *worker_->getEventBase(), std::move(address_)),
                       std::move(setupParameters))
                       .get();
     testClient_[command.clientId()] =
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/SocketAddress.h>
@@ -46,8 +47,16 @@ class TestInterpreter {
  public:
   TestInterpreter(const Test& test, folly::SocketAddress address);
 
+  /// Runs the test over `client`, shared by all the clients of the test and
+  /// possibly by other tests running at the same time.  Tests disconnecting
+  /// or resuming their clients fail.
+  TestInterpreter(const Test& test, std::shared_ptr<RSocketClient> client);
+
   bool run();
 
+  /// Values received by all the subscribers of the test.
+  size_t receivedValues() const;
+
  private:
   void handleSubscribe(const SubscribeCommand& command);
   void handleRequest(const RequestCommand& command);
@@ -59,8 +68,10 @@ class TestInterpreter {
 
   yarpl::Reference<BaseSubscriber> getSubscriber(const std::string& id);
 
-  folly::ScopedEventBaseThread worker_;
+  /// Connects the clients, unless they share `sharedClient_`.
+  std::unique_ptr<folly::ScopedEventBaseThread> worker_;
   folly::SocketAddress address_;
+  std::shared_ptr<TestClient> sharedClient_;
   const Test& test_;
   std::map<std::string, std::string> interactionIdToType_;
   std::map<std::string, yarpl::Reference<BaseSubscriber>> testSubscribers_;
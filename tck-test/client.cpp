@@ -1,5 +1,9 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <algorithm>
+#include <functional>
+
+#include <folly/Format.h>
 #include <folly/Memory.h>
 #include <folly/SocketAddress.h>
 #include <folly/String.h>
@@ -8,6 +12,7 @@
 
 #include "rsocket/RSocket.h"
 
+#include "tck-test/StressRunner.h"
 #include "tck-test/TestFileParser.h"
 #include "tck-test/TestInterpreter.h"
 
@@ -21,10 +26,65 @@ DEFINE_string(
     "all",
     "Comma separated names of tests to run. By default run all tests");
 DEFINE_int32(timeout, 5, "timeout (in secs) for connecting to the server");
+DEFINE_bool(
+    stress,
+    false,
+    "Run the tests again and again, many at once over shared connections");
+DEFINE_int32(stress_connections, 8, "connections to the server in stress");
+DEFINE_int32(stress_concurrency, 32, "runs in flight at once in stress");
+DEFINE_int32(stress_runs, 1000, "runs of the tests in stress");
+DEFINE_double(
+    stress_rate,
+    0,
+    "runs started per second in stress, 0 for as fast as they complete");
 
 using namespace rsocket;
 using namespace rsocket::tck;
 
+namespace {
+
+int runStress(
+    const TestSuite& testSuite,
+    const std::function<bool(const Test&)>& selected,
+    const folly::SocketAddress& address) {
+  TestSuite stressSuite;
+  for (const auto& test : testSuite.tests()) {
+    if (selected(test)) {
+      stressSuite.addTest(test);
+    }
+  }
+
+  StressOptions options;
+  options.connections = FLAGS_stress_connections;
+  options.concurrency = FLAGS_stress_concurrency;
+  options.runs = FLAGS_stress_runs;
+  options.rate = FLAGS_stress_rate;
+
+  // The commands of every run would drown the report.
+  FLAGS_minloglevel = 1;
+  auto const report = StressRunner(stressSuite, address, options).run();
+  FLAGS_minloglevel = 0;
+
+  auto const seconds = std::max<int64_t>(report.elapsed.count(), 1) / 1e6;
+  LOG(INFO) << folly::sformat(
+      "Stress DONE. {} runs in {:.2f}s, {:.1f} runs/s, {:.1f} values/s. "
+      "Run latency p50 {}us, p99 {}us, max {}us.",
+      report.runs,
+      seconds,
+      report.runs / seconds,
+      report.values / seconds,
+      report.p50.count(),
+      report.p99.count(),
+      report.max.count());
+  if (report.failures) {
+    LOG(ERROR) << report.failures << " runs failed, of the tests "
+               << folly::join(", ", report.failedTests);
+  }
+  return report.runs == 0 || report.failures != 0;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
   FLAGS_logtostderr = true;
   FLAGS_minloglevel = 0;
@@ -45,14 +105,22 @@ int main(int argc, char* argv[]) {
   LOG(INFO) << "Test file parsed. Executing " << testSuite.tests().size()
             << " tests.";
 
-  int ran = 0, passed = 0;
   std::vector<std::string> testsToRun;
   folly::split(",", FLAGS_tests, testsToRun);
-  for (const auto& test : testSuite.tests()) {
-    if (FLAGS_tests == "all" ||
+  auto const selected = [&](const Test& test) {
+    return FLAGS_tests == "all" ||
         std::find(testsToRun.begin(), testsToRun.end(), test.name()) !=
-            testsToRun.end()) {
-      TestInterpreter interpreter(test, std::move(address));
+        testsToRun.end();
+  };
+
+  if (FLAGS_stress) {
+    return runStress(testSuite, selected, address);
+  }
+
+  int ran = 0, passed = 0;
+  for (const auto& test : testSuite.tests()) {
+    if (selected(test)) {
+      TestInterpreter interpreter(test, address);
       bool passing = interpreter.run();
       ++ran;
       if (passing) {
@@ -0,0 +1,43 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "rsocket/BusyPollEventBaseThread.h"
+
+using namespace rsocket;
+
+TEST(BusyPollEventBaseThreadTest, RunsTasksWhileSpinningAndParked) {
+  BusyPollEventBaseThread thread(std::chrono::milliseconds(20));
+  auto eventBase = thread.getEventBase();
+
+  // Right after a wakeup the loop spins, later on it sleeps in epoll.
+  for (auto pause : {0, 50}) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(pause));
+    std::atomic<bool> ran{false};
+    eventBase->runInEventBaseThreadAndWait([&] {
+      EXPECT_TRUE(eventBase->isInEventBaseThread());
+      ran = true;
+    });
+    EXPECT_TRUE(ran);
+  }
+
+  // Timeouts still fire while the loop spins.
+  std::atomic<bool> fired{false};
+  eventBase->runInEventBaseThread(
+      [&] { eventBase->runAfterDelay([&] { fired = true; }, 5); });
+  for (int i = 0; i < 200 && !fired; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_TRUE(fired);
+}
+
+TEST(BusyPollEventBaseThreadTest, ZeroBudgetDoesNotSpin) {
+  BusyPollEventBaseThread thread(std::chrono::microseconds(0));
+  std::atomic<bool> ran{false};
+  thread.getEventBase()->runInEventBaseThreadAndWait([&] { ran = true; });
+  EXPECT_TRUE(ran);
+}
@@ -0,0 +1,111 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/CoalescingRSocketResponder.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::single;
+using namespace std::chrono_literals;
+
+namespace {
+// Echoes the data of the requests once `release` is posted.
+class ReleasedHandler : public RSocketResponder {
+ public:
+  yarpl::Reference<Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    ++requests_;
+    return Single<Payload>::create([
+      data = request.moveDataToString(),
+      release = release_
+    ](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+      std::thread([observer, data, release] {
+        release->wait();
+        observer->onSuccess(Payload(data));
+      }).detach();
+    });
+  }
+
+  std::atomic<size_t> requests_{0};
+  const std::shared_ptr<folly::Baton<>> release_{
+      std::make_shared<folly::Baton<>>()};
+};
+
+// Coalesces the requests by their data, unless it is "private".
+std::shared_ptr<CoalescingRSocketResponder> makeCoalescing(
+    std::shared_ptr<RSocketResponder> inner) {
+  return std::make_shared<CoalescingRSocketResponder>(
+      std::move(inner), [](const Payload& request) {
+        auto data = request.cloneDataToString();
+        return data == "private" ? folly::none
+                                 : folly::Optional<std::string>(data);
+      });
+}
+} // namespace
+
+TEST(CoalescingRSocketResponderTest, CoalescesAcrossConnections) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<ReleasedHandler>();
+  auto responder = makeCoalescing(handler);
+  auto server = makeServer(responder);
+
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  std::vector<yarpl::Reference<SingleTestObserver<std::string>>> observers;
+  for (int i = 0; i < 3; ++i) {
+    clients.push_back(
+        makeClient(worker.getEventBase(), *server->listeningPort()));
+    observers.push_back(SingleTestObserver<std::string>::create());
+    clients.back()
+        ->getRequester()
+        ->requestResponse(Payload("key"))
+        ->map([](auto p) { return p.moveDataToString(); })
+        ->subscribe(observers.back());
+  }
+  while (responder->coalesced() < 2) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(1u, responder->inFlight());
+
+  handler->release_->post();
+  for (auto& observer : observers) {
+    observer->awaitTerminalEvent();
+    observer->assertOnSuccessValue("key");
+  }
+  EXPECT_EQ(1u, handler->requests_);
+  EXPECT_EQ(0u, responder->inFlight());
+}
+
+TEST(CoalescingRSocketResponderTest, ForwardsRequestsWithoutKey) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<ReleasedHandler>();
+  handler->release_->post();
+  auto responder = makeCoalescing(handler);
+  auto server = makeServer(responder);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  std::vector<yarpl::Reference<SingleTestObserver<std::string>>> observers;
+  for (int i = 0; i < 2; ++i) {
+    observers.push_back(SingleTestObserver<std::string>::create());
+    client->getRequester()
+        ->requestResponse(Payload("private"))
+        ->map([](auto p) { return p.moveDataToString(); })
+        ->subscribe(observers.back());
+  }
+  for (auto& observer : observers) {
+    observer->awaitTerminalEvent();
+    observer->assertOnSuccessValue("private");
+  }
+  EXPECT_EQ(2u, handler->requests_);
+  EXPECT_EQ(0u, responder->coalesced());
+}
@@ -0,0 +1,116 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/ConcurrencyLimiter.h"
+#include "rsocket/RSocketErrors.h"
+#include "yarpl/single/SingleTestObserver.h"
+#include "yarpl/single/Singles.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::single;
+
+namespace {
+// Echoes the data of the requests once `release` is posted, or fails them.
+class HoldingHandler : public RSocketResponder {
+ public:
+  explicit HoldingHandler(std::shared_ptr<folly::Baton<>> release)
+      : release_(std::move(release)) {}
+
+  yarpl::Reference<Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    if (!release_) {
+      return Singles::error<Payload>(std::runtime_error("busy"));
+    }
+    return Single<Payload>::create([
+      data = request.moveDataToString(),
+      release = release_
+    ](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+      std::thread([observer, data, release] {
+        release->wait();
+        observer->onSuccess(Payload(data));
+      }).detach();
+    });
+  }
+
+ private:
+  const std::shared_ptr<folly::Baton<>> release_;
+};
+
+yarpl::Reference<SingleTestObserver<Payload>> request(
+    ConcurrencyLimiter& limiter,
+    const std::shared_ptr<RSocketRequester>& requester) {
+  auto observer = SingleTestObserver<Payload>::create();
+  limiter.requestResponse(requester, Payload("hello"))->subscribe(observer);
+  return observer;
+}
+} // namespace
+
+TEST(ConcurrencyLimiterTest, QueuesAndRejects) {
+  folly::ScopedEventBaseThread worker;
+  auto release = std::make_shared<folly::Baton<>>();
+  auto server = makeServer(std::make_shared<HoldingHandler>(release));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  ConcurrencyLimiter::Options options;
+  options.initialLimit = 2;
+  options.maxLimit = 2;
+  options.maxQueued = 1;
+  ConcurrencyLimiter limiter(options);
+
+  auto first = request(limiter, requester);
+  auto second = request(limiter, requester);
+  auto queued = request(limiter, requester);
+  auto rejected = request(limiter, requester);
+
+  rejected->awaitTerminalEvent();
+  EXPECT_TRUE(rejected->getError().is_compatible_with<ConcurrencyLimitError>());
+  auto stats = limiter.stats();
+  EXPECT_EQ(2u, stats.limit);
+  EXPECT_EQ(2u, stats.inFlight);
+  EXPECT_EQ(1u, stats.queued);
+  EXPECT_EQ(1u, stats.rejected);
+
+  // The queued request is sent once one of the others is answered.
+  release->post();
+  for (auto& observer : {first, second, queued}) {
+    observer->awaitTerminalEvent();
+    EXPECT_EQ("hello", observer->getOnSuccessValue().moveDataToString());
+  }
+  stats = limiter.stats();
+  EXPECT_EQ(0u, stats.inFlight);
+  EXPECT_EQ(0u, stats.queued);
+}
+
+TEST(ConcurrencyLimiterTest, BacksOffOnOverload) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HoldingHandler>(nullptr));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  ConcurrencyLimiter::Options options;
+  options.initialLimit = 10;
+  options.minLimit = 8;
+  options.backoffRatio = 0.9;
+  options.isOverload = [](const folly::exception_wrapper&) { return true; };
+  ConcurrencyLimiter limiter(options);
+
+  auto failed = request(limiter, requester);
+  failed->awaitTerminalEvent();
+  EXPECT_EQ(9u, limiter.stats().limit);
+
+  for (int i = 0; i < 5; ++i) {
+    request(limiter, requester)->awaitTerminalEvent();
+  }
+  EXPECT_EQ(8u, limiter.stats().limit);
+}
@@ -0,0 +1,101 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/ConcurrencyLimitingRSocketResponder.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::single;
+using namespace std::chrono_literals;
+
+namespace {
+// Echoes the data of the requests, those of the "slow" route once `release`
+// is posted.
+class SlowRouteHandler : public RSocketResponder {
+ public:
+  yarpl::Reference<Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    auto slow = request.cloneMetadataToString() == "slow";
+    return Single<Payload>::create([
+      data = request.moveDataToString(),
+      release = slow ? release_ : nullptr
+    ](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+      if (!release) {
+        observer->onSuccess(Payload(data));
+        return;
+      }
+      std::thread([observer, data, release] {
+        release->wait();
+        observer->onSuccess(Payload(data));
+      }).detach();
+    });
+  }
+
+  const std::shared_ptr<folly::Baton<>> release_{
+      std::make_shared<folly::Baton<>>()};
+};
+
+yarpl::Reference<SingleTestObserver<std::string>> request(
+    RSocketClient& client,
+    std::string route) {
+  auto observer = SingleTestObserver<std::string>::create();
+  client.getRequester()
+      ->requestResponse(Payload("hello", std::move(route)))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(observer);
+  return observer;
+}
+} // namespace
+
+TEST(ConcurrencyLimitingRSocketResponderTest, RejectsBeyondRouteLimit) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<SlowRouteHandler>();
+  ConcurrencyLimitingRSocketResponder::Options options;
+  options.initialLimit = 1;
+  options.maxLimit = 1;
+  auto responder = std::make_shared<ConcurrencyLimitingRSocketResponder>(
+      handler, options);
+  auto server = makeServer(responder);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto held = request(*client, "slow");
+  auto inFlight = [&] {
+    for (auto const& route : responder->stats()) {
+      if (route.route == "slow") {
+        return route.inFlight;
+      }
+    }
+    return size_t{0};
+  };
+  while (inFlight() < 1) {
+    std::this_thread::sleep_for(1ms);
+  }
+
+  auto rejected = request(*client, "slow");
+  rejected->awaitTerminalEvent();
+  EXPECT_TRUE(rejected->getError());
+
+  // The other routes have limits of their own.
+  auto other = request(*client, "fast");
+  other->awaitTerminalEvent();
+  other->assertOnSuccessValue("hello");
+
+  handler->release_->post();
+  held->awaitTerminalEvent();
+  held->assertOnSuccessValue("hello");
+
+  for (auto const& route : responder->stats()) {
+    EXPECT_EQ(0u, route.inFlight);
+    EXPECT_EQ(route.route == "slow" ? 1u : 0u, route.rejected);
+  }
+}
@@ -0,0 +1,86 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/CountingRSocketStats.h"
+
+using namespace rsocket;
+
+TEST(CountingRSocketStatsTest, CountsPerFrameType) {
+  CountingRSocketStats stats;
+  stats.frameRead(FrameType::PAYLOAD);
+  stats.framesRead(FrameType::PAYLOAD, 49);
+  stats.frameRead(FrameType::REQUEST_N);
+  stats.frameWritten(FrameType::REQUEST_STREAM);
+  stats.bytesRead(100);
+  stats.bytesWritten(10);
+  stats.bytesWritten(20);
+
+  auto counters = stats.snapshot();
+  EXPECT_EQ(50U, counters.read(FrameType::PAYLOAD));
+  EXPECT_EQ(1U, counters.read(FrameType::REQUEST_N));
+  EXPECT_EQ(0U, counters.read(FrameType::REQUEST_STREAM));
+  EXPECT_EQ(1U, counters.written(FrameType::REQUEST_STREAM));
+  EXPECT_EQ(0U, counters.written(FrameType::PAYLOAD));
+  EXPECT_EQ(100U, counters.bytesRead);
+  EXPECT_EQ(30U, counters.bytesWritten);
+}
+
+TEST(CountingRSocketStatsTest, AddsUpTheThreads) {
+  CountingRSocketStats stats;
+  stats.frameRead(FrameType::KEEPALIVE);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 1000; ++j) {
+        stats.frameRead(FrameType::PAYLOAD);
+      }
+      stats.bytesRead(1);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The counts of the threads which exited are kept.
+  auto counters = stats.snapshot();
+  EXPECT_EQ(4000U, counters.read(FrameType::PAYLOAD));
+  EXPECT_EQ(1U, counters.read(FrameType::KEEPALIVE));
+  EXPECT_EQ(4U, counters.bytesRead);
+}
+
+TEST(CountingRSocketStatsTest, CountsFrameSizes) {
+  CountingRSocketStats stats(true);
+  EXPECT_TRUE(stats.frameSizesEnabled());
+  EXPECT_FALSE(CountingRSocketStats().frameSizesEnabled());
+
+  stats.frameReadBytes(FrameType::PAYLOAD, 0);
+  stats.frameReadBytes(FrameType::PAYLOAD, 100);
+  stats.frameReadBytes(FrameType::PAYLOAD, 127);
+  stats.frameReadBytes(FrameType::PAYLOAD, 128);
+  stats.frameReadBytes(FrameType::PAYLOAD, 16 * 1024 * 1024 - 1);
+  stats.frameWrittenBytes(FrameType::REQUEST_N, 10);
+
+  auto counters = stats.snapshot();
+  EXPECT_EQ(5U, counters.read(FrameType::PAYLOAD));
+  EXPECT_EQ(1U, counters.written(FrameType::REQUEST_N));
+
+  auto& sizes = counters.readSizes(FrameType::PAYLOAD);
+  EXPECT_EQ(1U, sizes[0]);
+  EXPECT_EQ(2U, sizes[CountingRSocketStats::sizeBucket(100)]);
+  EXPECT_EQ(1U, sizes[CountingRSocketStats::sizeBucket(128)]);
+  EXPECT_EQ(1U, sizes[CountingRSocketStats::kNumSizeBuckets - 1]);
+  EXPECT_EQ(
+      1U,
+      counters.writtenSizes(FrameType::REQUEST_N)
+          [CountingRSocketStats::sizeBucket(10)]);
+
+  EXPECT_EQ(127U, CountingRSocketStats::sizeBucketMax(
+      CountingRSocketStats::sizeBucket(100)));
+  EXPECT_EQ(255U, CountingRSocketStats::sizeBucketMax(
+      CountingRSocketStats::sizeBucket(128)));
+}
@@ -0,0 +1,203 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+using namespace yarpl;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+// Records the requests, and posts `done` once it has `expected` of them.
+class RecordingHandler : public rsocket::RSocketResponder {
+ public:
+  explicit RecordingHandler(size_t expected) : expected_(expected) {}
+
+  void handleFireAndForget(Payload request, StreamId) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.push_back(request.moveDataToString());
+    if (requests_.size() == expected_) {
+      done.post();
+    }
+  }
+
+  std::vector<std::string> requests() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+  }
+
+  folly::Baton<> done;
+
+ private:
+  const size_t expected_;
+  std::mutex mutex_;
+  std::vector<std::string> requests_;
+};
+
+class SentObserver : public single::SingleObserverBase<void> {
+ public:
+  void onSuccess() override {
+    single::SingleObserverBase<void>::onSuccess();
+    sent.post();
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    single::SingleObserverBase<void>::onError(ex);
+    ADD_FAILURE() << ex.what();
+    sent.post();
+  }
+
+  folly::Baton<> sent;
+};
+
+std::vector<std::string> names(int64_t count) {
+  std::vector<std::string> result;
+  for (int64_t i = 0; i < count; ++i) {
+    result.push_back("item " + std::to_string(i));
+  }
+  return result;
+}
+} // namespace
+
+TEST(FireAndForgetTest, Batch) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<RecordingHandler>(10);
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  std::vector<Payload> requests;
+  for (auto& name : names(10)) {
+    requests.emplace_back(name);
+  }
+  auto observer = make_ref<SentObserver>();
+  client->getRequester()
+      ->fireAndForgetBatch(std::move(requests))
+      ->subscribe(observer);
+  observer->sent.wait();
+
+  handler->done.wait();
+  EXPECT_EQ(names(10), handler->requests());
+}
+
+TEST(FireAndForgetTest, BatchFromFlowable) {
+  // more than one batch
+  constexpr int64_t kCount = RSocketRequester::kFireAndForgetBatchSize + 10;
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<RecordingHandler>(kCount);
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto observer = make_ref<SentObserver>();
+  client->getRequester()
+      ->fireAndForgetBatch(flowable::Flowables::range(0, kCount)->map(
+          [](int64_t i) { return Payload("item " + std::to_string(i)); }))
+      ->subscribe(observer);
+  observer->sent.wait();
+
+  handler->done.wait();
+  EXPECT_EQ(names(kCount), handler->requests());
+}
+
+namespace {
+// Takes the requests read together in one call.
+class BatchingHandler : public RecordingHandler {
+ public:
+  using RecordingHandler::RecordingHandler;
+
+  bool batchesFireAndForget() const override {
+    return true;
+  }
+
+  void handleFireAndForgetBatch(
+      std::vector<std::pair<Payload, StreamId>> requests) override {
+    ++batches;
+    RecordingHandler::handleFireAndForgetBatch(std::move(requests));
+  }
+
+  std::atomic<size_t> batches{0};
+};
+} // namespace
+
+TEST(FireAndForgetTest, HandledInBatches) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<BatchingHandler>(10);
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  std::vector<Payload> requests;
+  for (auto& name : names(10)) {
+    requests.emplace_back(name);
+  }
+  auto observer = make_ref<SentObserver>();
+  client->getRequester()
+      ->fireAndForgetBatch(std::move(requests))
+      ->subscribe(observer);
+  observer->sent.wait();
+
+  handler->done.wait();
+  EXPECT_EQ(names(10), handler->requests());
+  EXPECT_GE(handler->batches, 1u);
+  EXPECT_LE(handler->batches, 10u);
+}
+
+namespace {
+class DropCountingStats : public RSocketStats {
+ public:
+  void fireAndForgetDropped() override {
+    ++dropped;
+  }
+
+  std::atomic<size_t> dropped{0};
+};
+} // namespace
+
+TEST(FireAndForgetTest, DroppedWhenBackedUp) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<RecordingHandler>(1);
+  auto server = makeServer(handler);
+  auto stats = std::make_shared<DropCountingStats>();
+
+  SetupParameters setupParameters;
+  // Any output counts as backed up.
+  setupParameters.pendingFrameLimits.maxBytesForFireAndForget = 0;
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<TcpConnectionFactory>(
+                        *worker.getEventBase(),
+                        folly::SocketAddress(
+                            "127.0.0.1", *server->listeningPort())),
+                    std::move(setupParameters),
+                    std::make_shared<RSocketResponder>(),
+                    kDefaultKeepaliveInterval,
+                    stats)
+                    .get();
+
+  auto observer = make_ref<SentObserver>();
+  client->getRequester()->fireAndForget(Payload("single"))->subscribe(
+      observer);
+  observer->sent.wait();
+
+  std::vector<Payload> requests;
+  for (auto& name : names(10)) {
+    requests.emplace_back(name);
+  }
+  observer = make_ref<SentObserver>();
+  client->getRequester()
+      ->fireAndForgetBatch(std::move(requests))
+      ->subscribe(observer);
+  observer->sent.wait();
+
+  EXPECT_EQ(11U, stats->dropped);
+  EXPECT_TRUE(handler->requests().empty());
+}
@@ -0,0 +1,109 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/HotRestart.h"
+
+using namespace rsocket;
+
+namespace {
+
+/// A connected pair of Unix domain stream sockets, closed on destruction.
+struct SocketPair {
+  SocketPair() {
+    EXPECT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  }
+  ~SocketPair() {
+    for (auto fd : fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  int fds[2]{-1, -1};
+};
+
+uint16_t boundPort(int fd) {
+  sockaddr_in address;
+  socklen_t length = sizeof(address);
+  EXPECT_EQ(0, ::getsockname(fd, (sockaddr*)&address, &length));
+  return ntohs(address.sin_port);
+}
+
+} // namespace
+
+TEST(HotRestartTest, ListeningSockets) {
+  auto listening = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listening, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(0, ::bind(listening, (sockaddr*)&address, sizeof(address)));
+  ASSERT_EQ(0, ::listen(listening, 8));
+
+  SocketPair channel;
+  sendListeningSockets(channel.fds[0], {listening});
+  auto received = receiveListeningSockets(channel.fds[1]);
+  ASSERT_EQ(1U, received.size());
+  EXPECT_NE(listening, received[0]);
+  EXPECT_EQ(boundPort(listening), boundPort(received[0]));
+
+  ::close(received[0]);
+  ::close(listening);
+}
+
+TEST(HotRestartTest, Connections) {
+  SocketPair channel;
+  SocketPair connection;
+
+  std::vector<HandedOverConnection> connections(2);
+  connections[0].state = folly::IOBuf::copyBuffer("state");
+  connections[0].fd = connection.fds[0];
+  connections[0].unread = folly::IOBuf::copyBuffer("unread");
+  connection.fds[0] = -1;
+  // Without its socket, e.g. a TLS connection.
+  connections[1].state = folly::IOBuf::copyBuffer("other");
+
+  sendHandedOverConnections(channel.fds[0], std::move(connections));
+  auto received = receiveHandedOverConnections(channel.fds[1]);
+  ASSERT_EQ(2U, received.size());
+
+  EXPECT_EQ("state", received[0].state->moveToFbString().toStdString());
+  EXPECT_EQ("unread", received[0].unread->moveToFbString().toStdString());
+  ASSERT_GE(received[0].fd, 0);
+  // The socket carries on in the receiving process.
+  ASSERT_EQ(2, ::write(received[0].fd, "hi", 2));
+  char buf[2];
+  ASSERT_EQ(2, ::read(connection.fds[1], buf, sizeof(buf)));
+  EXPECT_EQ("hi", std::string(buf, sizeof(buf)));
+
+  EXPECT_EQ("other", received[1].state->moveToFbString().toStdString());
+  EXPECT_EQ(-1, received[1].fd);
+  EXPECT_FALSE(received[1].unread);
+}
+
+TEST(HotRestartTest, PeerClosed) {
+  SocketPair channel;
+  ::close(channel.fds[0]);
+  channel.fds[0] = -1;
+  EXPECT_THROW(
+      receiveHandedOverConnections(channel.fds[1]), std::runtime_error);
+}
+
+TEST(HotRestartTest, UnexpectedMessage) {
+  SocketPair channel;
+  std::vector<HandedOverConnection> connections(1);
+  connections[0].state = folly::IOBuf::copyBuffer("state");
+  sendHandedOverConnections(channel.fds[0], std::move(connections));
+  EXPECT_THROW(receiveListeningSockets(channel.fds[1]), std::runtime_error);
+}
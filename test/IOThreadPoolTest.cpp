@@ -0,0 +1,95 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "RSocketTests.h"
+#include "rsocket/IOThreadPool.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+TEST(IOThreadPoolTest, RoundRobin) {
+  IOThreadPool pool(3);
+  auto eventBases = pool.eventBases();
+  ASSERT_EQ(3u, eventBases.size());
+
+  std::vector<std::shared_ptr<IOThreadPool::Lease>> leases;
+  for (size_t i = 0; i < 6; ++i) {
+    leases.push_back(pool.lease());
+    EXPECT_EQ(eventBases[i % 3], &leases.back()->eventBase());
+  }
+  EXPECT_EQ(2u, pool.connections(0));
+  leases.clear();
+  EXPECT_EQ(0u, pool.connections(0));
+}
+
+TEST(IOThreadPoolTest, LeastConnections) {
+  IOThreadPool pool(2, IOThreadPool::Policy::LEAST_CONNECTIONS);
+  auto first = pool.lease();
+  auto second = pool.lease();
+  EXPECT_NE(&first->eventBase(), &second->eventBase());
+
+  auto* freed = &first->eventBase();
+  first.reset();
+  // The thread with the fewest connections, whichever is next in turn.
+  EXPECT_EQ(freed, &pool.lease()->eventBase());
+  auto third = pool.lease();
+  EXPECT_EQ(freed, &third->eventBase());
+  EXPECT_EQ(1u, pool.connections(0));
+  EXPECT_EQ(1u, pool.connections(1));
+}
+
+TEST(IOThreadPoolTest, CoLocatesWithCaller) {
+  IOThreadPool pool(4);
+  auto* eventBase = pool.eventBases()[2];
+  eventBase->runInEventBaseThreadAndWait([&] {
+    for (size_t i = 0; i < 3; ++i) {
+      EXPECT_EQ(eventBase, &pool.lease()->eventBase());
+    }
+  });
+
+  // A thread outside of the pool is given any of its threads.
+  folly::ScopedEventBaseThread outside;
+  outside.getEventBase()->runInEventBaseThreadAndWait([&] {
+    auto eventBases = pool.eventBases();
+    auto lease = pool.lease();
+    EXPECT_NE(
+        eventBases.end(),
+        std::find(eventBases.begin(), eventBases.end(), &lease->eventBase()));
+  });
+}
+
+TEST(IOThreadPoolTest, ConnectsClients) {
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto pool = std::make_shared<IOThreadPool>(2);
+  // The EventBase of the factory isn't used.
+  folly::ScopedEventBaseThread unused;
+
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < 4; ++i) {
+    clients.push_back(
+        RSocket::createConnectedClient(
+            getConnFactory(unused.getEventBase(), *server->listeningPort()),
+            pool)
+            .get());
+    auto ts = yarpl::flowable::TestSubscriber<Payload>::create();
+    clients.back()->getRequester()->requestStream(Payload("Bob"))->subscribe(
+        ts);
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+    ts->assertValueCount(10);
+  }
+  EXPECT_EQ(2u, pool->connections(0));
+  EXPECT_EQ(2u, pool->connections(1));
+
+  clients.clear();
+  EXPECT_EQ(0u, pool->connections(0));
+  EXPECT_EQ(0u, pool->connections(1));
+}
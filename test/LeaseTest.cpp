@@ -0,0 +1,97 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/RSocketErrors.h"
+#include "test/test_utils/GenericRequestResponseHandler.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace yarpl;
+using namespace yarpl::single;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+class LeaseServiceHandler : public RSocketServiceHandler {
+ public:
+  explicit LeaseServiceHandler(std::shared_ptr<LeaseSender> leaseSender)
+      : leaseSender_(std::move(leaseSender)) {}
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters& setupParameters) override {
+    EXPECT_TRUE(setupParameters.lease);
+    auto responder = std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response("Hello, " + request.first + "!", "");
+        });
+    return RSocketConnectionParams(
+        std::move(responder), RSocketStats::noop(), nullptr, leaseSender_);
+  }
+
+ private:
+  std::shared_ptr<LeaseSender> leaseSender_;
+};
+
+std::unique_ptr<RSocketClient> makeLeaseClient(
+    folly::EventBase* eventBase,
+    uint16_t port) {
+  SetupParameters setupParameters;
+  setupParameters.lease = true;
+  return RSocket::createConnectedClient(
+             getConnFactory(eventBase, port), std::move(setupParameters))
+      .get();
+}
+
+Reference<SingleTestObserver<std::string>> requestResponse(
+    RSocketRequester& requester) {
+  auto to = SingleTestObserver<std::string>::create();
+  requester.requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  return to;
+}
+
+bool isNoLeaseError(SingleTestObserver<std::string>& to) {
+  auto error = to.getError();
+  return error && error.is_compatible_with<NoLeaseError>();
+}
+} // namespace
+
+TEST(LeaseTest, RequestWithoutLeaseFailsFast) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(std::make_shared<LeaseServiceHandler>(
+      std::make_shared<ConcurrencyLeaseSender>(0)));
+  auto client =
+      makeLeaseClient(worker.getEventBase(), *server->listeningPort());
+
+  auto to = requestResponse(*client->getRequester());
+  EXPECT_TRUE(isNoLeaseError(*to));
+}
+
+TEST(LeaseTest, RequestsWithinLease) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(std::make_shared<LeaseServiceHandler>(
+      std::make_shared<ConcurrencyLeaseSender>(2, std::chrono::seconds(10))));
+  auto client =
+      makeLeaseClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  // the lease is sent by the server right after SETUP, requests fail until it
+  // has been received
+  auto to = requestResponse(*requester);
+  for (int i = 0; i < 100 && isNoLeaseError(*to); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    to = requestResponse(*requester);
+  }
+  to->assertOnSuccessValue("Hello, Jane!");
+
+  requestResponse(*requester)->assertOnSuccessValue("Hello, Jane!");
+
+  // the lease for two requests has been used up
+  EXPECT_TRUE(isNoLeaseError(*requestResponse(*requester)));
+}
@@ -0,0 +1,65 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/MemoryGovernor.h"
+
+using namespace rsocket;
+
+namespace {
+MemoryGovernor::Options options() {
+  MemoryGovernor::Options options;
+  options.budget = 1000;
+  options.shrinkAt = 0.6;
+  options.rejectAt = 0.9;
+  return options;
+}
+} // namespace
+
+TEST(MemoryGovernorTest, SumsTheConnections) {
+  MemoryGovernor governor(options());
+  size_t first = 0;
+  size_t second = 0;
+  governor.update(first, 300);
+  governor.update(second, 200);
+  EXPECT_EQ(500U, governor.usage());
+  EXPECT_EQ(300U, first);
+
+  governor.update(first, 100);
+  EXPECT_EQ(300U, governor.usage());
+  governor.update(second, 0);
+  governor.update(first, 0);
+  EXPECT_EQ(0U, governor.usage());
+}
+
+TEST(MemoryGovernorTest, Levels) {
+  MemoryGovernor governor(options());
+  size_t reported = 0;
+  EXPECT_EQ(MemoryGovernor::Level::NORMAL, governor.level());
+  governor.update(reported, 599);
+  EXPECT_EQ(MemoryGovernor::Level::NORMAL, governor.level());
+  governor.update(reported, 600);
+  EXPECT_EQ(MemoryGovernor::Level::SHRINKING, governor.level());
+  governor.update(reported, 900);
+  EXPECT_EQ(MemoryGovernor::Level::REJECTING, governor.level());
+  governor.update(reported, 2000);
+  EXPECT_EQ(MemoryGovernor::Level::REJECTING, governor.level());
+  governor.update(reported, 100);
+  EXPECT_EQ(MemoryGovernor::Level::NORMAL, governor.level());
+}
+
+TEST(MemoryGovernorTest, ResumeBuffersShrinkProgressively) {
+  MemoryGovernor governor(options());
+  size_t reported = 0;
+  EXPECT_EQ(1, governor.resumeFraction());
+  governor.update(reported, 600);
+  EXPECT_EQ(1, governor.resumeFraction());
+  governor.update(reported, 800);
+  EXPECT_EQ(0.5, governor.resumeFraction());
+  governor.update(reported, 850);
+  EXPECT_EQ(0.375, governor.resumeFraction());
+  governor.update(reported, 1000);
+  EXPECT_EQ(0, governor.resumeFraction());
+  governor.update(reported, 0);
+  EXPECT_EQ(1, governor.resumeFraction());
+}
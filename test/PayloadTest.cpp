@@ -3,6 +3,10 @@
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
 #include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <system_error>
+#include "rsocket/MappedFile.h"
 #include "rsocket/Payload.h"
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameSerializer_v0_1.h"
@@ -78,3 +82,77 @@ TEST(PayloadTest, Clone) {
   EXPECT_EQ(clone.data, nullptr);
   EXPECT_EQ(clone.metadata, nullptr);
 }
+
+TEST(PayloadTest, Wrap) {
+  auto payload = Payload::wrap("data", "");
+  EXPECT_EQ("data", payload.cloneDataToString());
+  EXPECT_EQ(nullptr, payload.metadata);
+
+  // large strings are owned rather than copied
+  std::string data(64 * 1024, 'd');
+  std::string metadata(64 * 1024, 'm');
+  auto const dataBytes = data.data();
+  auto const metadataBytes = metadata.data();
+  payload = Payload::wrap(std::move(data), std::move(metadata));
+  EXPECT_EQ(dataBytes, reinterpret_cast<const char*>(payload.data->data()));
+  EXPECT_EQ(
+      metadataBytes, reinterpret_cast<const char*>(payload.metadata->data()));
+  EXPECT_EQ(std::string(64 * 1024, 'd'), payload.cloneDataToString());
+  EXPECT_EQ(std::string(64 * 1024, 'm'), payload.moveMetadataToString());
+}
+
+TEST(PayloadTest, FromFile) {
+  char path[] = "/tmp/rsocket-payload-XXXXXX";
+  auto fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+  std::string contents(3 * sysconf(_SC_PAGESIZE), '\0');
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<char>('a' + i % 26);
+  }
+  ASSERT_EQ(
+      static_cast<ssize_t>(contents.size()),
+      write(fd, contents.data(), contents.size()));
+
+  // A region which doesn't start on a page.
+  auto p = Payload::fromFile(
+      fd, 1000, contents.size() - 2000, folly::IOBuf::copyBuffer("meta"));
+  close(fd);
+  ASSERT_NE(p.data, nullptr);
+  EXPECT_EQ(0u, p.data->headroom());
+  EXPECT_EQ(0u, p.data->tailroom());
+  EXPECT_EQ("meta", p.cloneMetadataToString());
+  EXPECT_EQ(contents.substr(1000, contents.size() - 2000), p.moveDataToString());
+
+  auto empty = Payload::fromFile(-1, 0, 0);
+  ASSERT_NE(empty.data, nullptr);
+  EXPECT_EQ(0u, empty.data->computeChainDataLength());
+
+  EXPECT_THROW(Payload::fromFile(-1, 0, 10), std::system_error);
+}
+
+TEST(PayloadTest, MappedFileSharesMapping) {
+  char path[] = "/tmp/rsocket-payload-XXXXXX";
+  auto fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+  std::string contents(10000, 'a');
+  contents.replace(5000, 5, "hello");
+  ASSERT_EQ(
+      static_cast<ssize_t>(contents.size()),
+      write(fd, contents.data(), contents.size()));
+
+  auto p = [&] {
+    MappedFile file(fd, 0, contents.size());
+    close(fd);
+    EXPECT_EQ(contents.size(), file.size());
+
+    auto whole = file.payload();
+    auto slice = file.payload(5000, 5);
+    EXPECT_TRUE(slice.data->isShared());
+    EXPECT_EQ(whole.data->data() + 5000, slice.data->data());
+    return slice;
+  }();
+  // The mapping outlives the MappedFile.
+  EXPECT_EQ("hello", p.moveDataToString());
+}
@@ -0,0 +1,66 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+#include "rsocket/PrewarmedClientFactory.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::flowable;
+
+namespace {
+void requestStream(RSocketClient& client) {
+  auto ts = TestSubscriber<std::string>::create();
+  client.getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
+} // namespace
+
+TEST(PrewarmedClientFactoryTest, HandsOutSpares) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  PrewarmedClientFactory factory(
+      getConnFactory(worker.getEventBase(), *server->listeningPort()), 2);
+
+  factory.waitForSpares().get();
+  EXPECT_EQ(2U, factory.sparesReady());
+
+  auto client = factory.getClient().get();
+  EXPECT_EQ(1U, factory.sparesReady());
+  requestStream(*client);
+
+  // The spare handed out is replaced.
+  factory.waitForSpares().get();
+  EXPECT_EQ(2U, factory.sparesReady());
+}
+
+TEST(PrewarmedClientFactoryTest, ConnectsWithoutSpares) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  PrewarmedClientFactory factory(
+      getConnFactory(worker.getEventBase(), *server->listeningPort()), 0);
+
+  auto client = factory.getClient().get();
+  EXPECT_EQ(0U, factory.sparesReady());
+  requestStream(*client);
+}
+
+TEST(PrewarmedClientFactoryTest, Ping) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  EXPECT_NO_THROW(client->getRequester()->ping().get());
+
+  client->disconnect().get();
+  EXPECT_THROW(client->getRequester()->ping().get(), std::exception);
+}
@@ -0,0 +1,264 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/Conv.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "RSocketTests.h"
+#include "rsocket/RSocketClientPool.h"
+#include "rsocket/metadata/StreamStripe.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::flowable;
+using namespace yarpl::single;
+using namespace std::chrono_literals;
+
+namespace {
+std::unique_ptr<RSocketClientPool> makePool(
+    folly::EventBase* eventBase,
+    uint16_t port,
+    size_t connections) {
+  std::vector<std::shared_ptr<ConnectionFactory>> factories;
+  factories.push_back(getConnFactory(eventBase, port));
+  return RSocketClientPool::create(std::move(factories), connections).get();
+}
+
+// The first request never gets an answer, or fails if `fail`.  The others are
+// answered with "answer".
+class FirstRequestSlowHandler : public RSocketResponder {
+ public:
+  explicit FirstRequestSlowHandler(bool fail = false) : fail_(fail) {}
+
+  yarpl::Reference<Single<Payload>> handleRequestResponse(Payload, StreamId)
+      override {
+    if (requests_++ > 0) {
+      return Single<Payload>::create([](auto observer) {
+        observer->onSubscribe(SingleSubscriptions::empty());
+        observer->onSuccess(Payload("answer"));
+      });
+    }
+    return Single<Payload>::create([this](auto observer) {
+      observer->onSubscribe(
+          SingleSubscriptions::create([this] { cancelled_.post(); }));
+      if (fail_) {
+        observer->onError(std::runtime_error("first"));
+      }
+    });
+  }
+
+  size_t requests() const {
+    return requests_;
+  }
+
+  folly::Baton<> cancelled_;
+
+ private:
+  const bool fail_;
+  std::atomic<size_t> requests_{0};
+};
+
+// Streams the numbers below `count` which are in the stripe of the request.
+class StripedRangeHandler : public RSocketResponder {
+ public:
+  explicit StripedRangeHandler(int64_t count) : count_(count) {}
+
+  yarpl::Reference<Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId) override {
+    folly::Optional<StreamStripe> stripe;
+    if (request.metadata) {
+      stripe = findStreamStripe(*request.metadata);
+    }
+    if (!stripe) {
+      return Flowables::error<Payload>(std::runtime_error("not striped"));
+    }
+    streams_++;
+    return Flowables::range(0, count_)
+        ->filter([index = stripe->index, count = stripe->count](int64_t i) {
+          return i % count == index;
+        })
+        ->map([](int64_t i) { return Payload(folly::to<std::string>(i)); });
+  }
+
+  std::atomic<size_t> streams_{0};
+
+ private:
+  const int64_t count_;
+};
+} // namespace
+
+TEST(RSocketClientPoolTest, RequestStream) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 3);
+  EXPECT_EQ(3U, pool->size());
+
+  auto ts = TestSubscriber<std::string>::create();
+  pool->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+  EXPECT_EQ(std::vector<size_t>({0, 0, 0}), pool->outstandingRequests());
+}
+
+TEST(RSocketClientPoolTest, BalancesOutstandingRequests) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 2);
+
+  // Streams with little demand stay open.  With two connections both are
+  // always compared, so the requests alternate between them.
+  std::vector<yarpl::Reference<TestSubscriber<Payload>>> subscribers;
+  for (int i = 0; i < 4; ++i) {
+    subscribers.push_back(TestSubscriber<Payload>::create(1));
+    pool->requestStream(Payload("Bob"))->subscribe(subscribers.back());
+    EXPECT_EQ(
+        std::vector<size_t>({i / 2 + 1U, (i + 1) / 2 + 0U}),
+        pool->outstandingRequests());
+  }
+
+  for (auto& subscriber : subscribers) {
+    subscriber->awaitValueCount(1);
+    subscriber->cancel();
+  }
+  EXPECT_EQ(std::vector<size_t>({0, 0}), pool->outstandingRequests());
+}
+
+TEST(RSocketClientPoolTest, EventBaseAffinity) {
+  folly::ScopedEventBaseThread first;
+  folly::ScopedEventBaseThread second;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  std::vector<std::shared_ptr<ConnectionFactory>> factories;
+  factories.push_back(
+      getConnFactory(first.getEventBase(), *server->listeningPort()));
+  factories.push_back(
+      getConnFactory(second.getEventBase(), *server->listeningPort()));
+  auto pool = RSocketClientPool::create(std::move(factories)).get();
+  pool->setEventBaseAffinity(true);
+
+  // Made on the EventBase of the second connection, the requests all go to
+  // it, however loaded it is.
+  std::vector<yarpl::Reference<TestSubscriber<Payload>>> subscribers;
+  second.getEventBase()->runInEventBaseThreadAndWait([&] {
+    for (int i = 0; i < 3; ++i) {
+      subscribers.push_back(TestSubscriber<Payload>::create(1));
+      pool->requestStream(Payload("Bob"))->subscribe(subscribers.back());
+    }
+  });
+  EXPECT_EQ(std::vector<size_t>({0, 3}), pool->outstandingRequests());
+
+  // Made elsewhere, they are balanced.
+  subscribers.push_back(TestSubscriber<Payload>::create(1));
+  pool->requestStream(Payload("Bob"))->subscribe(subscribers.back());
+  EXPECT_EQ(std::vector<size_t>({1, 3}), pool->outstandingRequests());
+
+  for (auto& subscriber : subscribers) {
+    subscriber->awaitValueCount(1);
+    subscriber->cancel();
+  }
+  EXPECT_EQ(std::vector<size_t>({0, 0}), pool->outstandingRequests());
+}
+
+TEST(RSocketClientPoolTest, HedgesSlowRequests) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<FirstRequestSlowHandler>();
+  auto server = makeServer(handler);
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 2);
+
+  RSocketClientPool::RequestPolicy policy;
+  policy.hedgeDelay = 50ms;
+  auto observer = SingleTestObserver<std::string>::create();
+  pool->requestResponse(Payload("request"), policy)
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(observer);
+  observer->awaitTerminalEvent();
+  observer->assertOnSuccessValue("answer");
+  EXPECT_EQ(2u, handler->requests());
+
+  // The slow copy is cancelled.
+  EXPECT_TRUE(handler->cancelled_.timed_wait(std::chrono::seconds(1)));
+}
+
+TEST(RSocketClientPoolTest, RetriesFailedRequests) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<FirstRequestSlowHandler>(true);
+  auto server = makeServer(handler);
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 2);
+
+  RSocketClientPool::RequestPolicy policy;
+  policy.maxRetries = 1;
+  auto observer = SingleTestObserver<std::string>::create();
+  pool->requestResponse(Payload("request"), policy)
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(observer);
+  observer->awaitTerminalEvent();
+  observer->assertOnSuccessValue("answer");
+  EXPECT_EQ(2u, handler->requests());
+}
+
+TEST(RSocketClientPoolTest, RetriesWithinBudget) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<FirstRequestSlowHandler>(true);
+  auto server = makeServer(handler);
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 2);
+
+  RSocketClientPool::RetryBudget budget;
+  budget.maxBalance = 0;
+  pool->setRetryBudget(budget);
+
+  RSocketClientPool::RequestPolicy policy;
+  policy.maxRetries = 1;
+  auto observer = SingleTestObserver<Payload>::create();
+  pool->requestResponse(Payload("request"), policy)->subscribe(observer);
+  observer->awaitTerminalEvent();
+  observer->assertOnErrorMessage("first");
+  EXPECT_EQ(1u, handler->requests());
+}
+
+TEST(RSocketClientPoolTest, StripedStream) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<StripedRangeHandler>(100);
+  auto server = makeServer(handler);
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 3);
+
+  // A small prefetch, so that the stripes are requested more several times.
+  auto ts = TestSubscriber<std::string>::create();
+  pool->requestStripedStream(Payload("range"), 3, 4)
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(100);
+  for (int i = 0; i < 100; ++i) {
+    ts->assertValueAt(i, folly::to<std::string>(i));
+  }
+  EXPECT_EQ(3u, handler->streams_);
+  EXPECT_EQ(std::vector<size_t>({0, 0, 0}), pool->outstandingRequests());
+}
+
+TEST(RSocketClientPoolTest, StripedStreamClampsStripes) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<StripedRangeHandler>(10);
+  auto server = makeServer(handler);
+  auto pool = makePool(worker.getEventBase(), *server->listeningPort(), 2);
+
+  auto ts = TestSubscriber<std::string>::create(5);
+  pool->requestStripedStream(Payload("range"), 8)
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitValueCount(5);
+  ts->assertValueAt(4, "4");
+  ts->cancel();
+  EXPECT_EQ(2u, handler->streams_);
+  EXPECT_EQ(std::vector<size_t>({0, 0}), pool->outstandingRequests());
+}
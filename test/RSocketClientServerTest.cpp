@@ -2,15 +2,69 @@
 
 #include "RSocketTests.h"
 
+#include <folly/Baton.h>
 #include <folly/Random.h>
+#include <folly/io/async/EventBaseManager.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 #include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
 
 using namespace rsocket;
 using namespace rsocket::tests;
 using namespace rsocket::tests::client_server;
 
+namespace {
+class MetadataPushResponder : public RSocketResponder {
+ public:
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override {
+    EXPECT_EQ("config", metadata->moveToFbString().toStdString());
+    received.post();
+  }
+
+  folly::Baton<> received;
+};
+
+/// Records the EventBase the streams are requested on.
+class EventBaseRecordingHandler : public HelloStreamRequestHandler {
+ public:
+  yarpl::Reference<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override {
+    eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+    return HelloStreamRequestHandler::handleRequestStream(
+        std::move(request), streamId);
+  }
+
+  std::atomic<folly::EventBase*> eventBase{nullptr};
+};
+
+/// Accepts the connections once accept() is called.
+class AsyncServiceHandler : public RSocketServiceHandler {
+ public:
+  folly::Future<RSocketConnectionParams> onNewSetupAsync(
+      const SetupParameters&) override {
+    auto future = promise_.getFuture();
+    setupReceived.post();
+    return future;
+  }
+
+  void accept() {
+    promise_.setValue(RSocketConnectionParams(
+        std::make_shared<HelloStreamRequestHandler>()));
+  }
+
+  folly::Baton<> setupReceived;
+
+ private:
+  folly::Promise<RSocketConnectionParams> promise_;
+};
+} // namespace
+
 TEST(RSocketClientServer, StartAndShutdown) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
@@ -124,3 +178,193 @@ TEST(RSocketClientServer, CloseServerWithConnections) {
 
   server.reset();
 }
+
+TEST(RSocketClientServer, ShardedServer) {
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 2;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  opts.reusePort = true;
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+
+  std::atomic<size_t> shards{0};
+  server->startSharded([&shards](folly::EventBase& eventBase) {
+    EXPECT_TRUE(eventBase.isInEventBaseThread());
+    ++shards;
+    RSocketServer::ShardParams params;
+    params.serviceHandler =
+        RSocketServiceHandler::create([](const SetupParameters&) {
+          return std::make_shared<HelloStreamRequestHandler>();
+        });
+    return params;
+  });
+  EXPECT_EQ(2U, server->shardCount());
+  EXPECT_EQ(2U, shards);
+
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = yarpl::flowable::TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+
+  for (size_t i = 0; i < server->shardCount(); ++i) {
+    folly::Baton<> ran;
+    server->runOnShard(i, [&](RSocketServiceHandler&) {
+      EXPECT_TRUE(server->shardEventBase(i).isInEventBaseThread());
+      ran.post();
+    });
+    ran.wait();
+  }
+  EXPECT_EQ(2U, shards);
+
+  server->shutdownAndWait(std::chrono::seconds(1));
+}
+
+TEST(RSocketClientServer, BroadcastMetadataPush) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+
+  std::vector<std::shared_ptr<MetadataPushResponder>> responders;
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < 3; ++i) {
+    responders.push_back(std::make_shared<MetadataPushResponder>());
+    clients.push_back(
+        RSocket::createConnectedClient(
+            getConnFactory(worker.getEventBase(), *server->listeningPort()),
+            SetupParameters(),
+            responders.back())
+            .get());
+
+    // The server has set up the connection once it responds.
+    auto ts = yarpl::flowable::TestSubscriber<Payload>::create();
+    clients.back()->getRequester()->requestStream(Payload("Bob"))->subscribe(
+        ts);
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+  }
+
+  server->broadcastMetadataPush(folly::IOBuf::copyBuffer("config"));
+  for (auto& responder : responders) {
+    responder->received.wait();
+  }
+}
+
+TEST(RSocketClientServer, Snapshot) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < 2; ++i) {
+    clients.push_back(
+        makeClient(worker.getEventBase(), *server->listeningPort()));
+    auto ts = yarpl::flowable::TestSubscriber<Payload>::create();
+    clients.back()->getRequester()->requestStream(Payload("Bob"))->subscribe(
+        ts);
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+  }
+
+  auto snapshots = server->snapshot().get();
+  ASSERT_EQ(2U, snapshots.size());
+  for (auto const& snapshot : snapshots) {
+    EXPECT_EQ(RSocketMode::SERVER, snapshot.mode);
+    EXPECT_TRUE(snapshot.protocolVersion.hasValue());
+    EXPECT_FALSE(snapshot.disconnected);
+    EXPECT_GT(snapshot.bytesRead, 0U);
+    EXPECT_GT(snapshot.bytesWritten, 0U);
+    EXPECT_EQ(0U, snapshot.pendingFrames);
+    EXPECT_TRUE(snapshot.streams.empty());
+  }
+
+  server->shutdownAndWait();
+  EXPECT_TRUE(server->snapshot().get().empty());
+}
+
+TEST(RSocketClientServer, MigrateConnections) {
+  folly::ScopedEventBaseThread worker;
+  folly::ScopedEventBaseThread io;
+  auto handler = std::make_shared<EventBaseRecordingHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  // Half of the stream is sent before the connection moves, the rest after.
+  auto ts = yarpl::flowable::TestSubscriber<Payload>::create(5);
+  client->getRequester()->requestStream(Payload("Bob"))->subscribe(ts);
+  ts->awaitValueCount(5);
+  auto* eventBase = handler->eventBase.load();
+  ASSERT_NE(nullptr, eventBase);
+
+  EXPECT_EQ(
+      1U,
+      server->migrateConnections(*eventBase, *io.getEventBase(), 10).get());
+  // Its IO isn't on the EventBase of the state machine anymore.
+  EXPECT_EQ(
+      0U,
+      server->migrateConnections(*eventBase, *io.getEventBase(), 10).get());
+
+  ts->request(5);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+
+  auto next = yarpl::flowable::TestSubscriber<Payload>::create();
+  client->getRequester()->requestStream(Payload("Bob"))->subscribe(next);
+  next->awaitTerminalEvent();
+  next->assertSuccess();
+  next->assertValueCount(10);
+  EXPECT_EQ(1U, server->snapshot().get().size());
+}
+
+TEST(RSocketClientServer, AsyncSetup) {
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  auto serviceHandler = std::make_shared<AsyncServiceHandler>();
+  server->start(serviceHandler);
+
+  // The request is sent right after SETUP, while the server still waits for
+  // the service handler.
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = yarpl::flowable::TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+
+  serviceHandler->setupReceived.wait();
+  EXPECT_EQ(0, ts->getValueCount());
+  serviceHandler->accept();
+
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
+
+TEST(RSocketClientServer, PinnedProtocolVersion) {
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  server->setProtocolVersion(ProtocolVersion(1, 0));
+  server->start([](const SetupParameters&) {
+    return std::make_shared<HelloStreamRequestHandler>();
+  });
+
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = yarpl::flowable::TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
 
 using namespace rsocket;
 using namespace rsocket::tests;
@@ -26,3 +27,33 @@ TEST(RSocketClient, ConnectFails) {
     LOG(INFO) << "connection failed as expected";
   }).get();
 }
+
+TEST(RSocketClient, ConnectsToReachableAddress) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+
+  std::vector<folly::SocketAddress> addresses(2);
+  addresses[0].setFromHostPort("localhost", 1);
+  addresses[1].setFromHostPort("localhost", *server->listeningPort());
+  auto client = RSocket::createConnectedClient(
+      std::make_unique<TcpConnectionFactory>(
+          *worker.getEventBase(),
+          std::move(addresses),
+          std::chrono::seconds(10)));
+  // The refused connection doesn't wait for the delay between attempts.
+  EXPECT_NO_THROW(std::move(client).get(std::chrono::seconds(5)));
+}
+
+TEST(RSocketClient, AllAddressesFail) {
+  folly::ScopedEventBaseThread worker;
+
+  std::vector<folly::SocketAddress> addresses(2);
+  addresses[0].setFromHostPort("localhost", 1);
+  addresses[1].setFromHostPort("localhost", 2);
+  auto client = RSocket::createConnectedClient(
+      std::make_unique<TcpConnectionFactory>(
+          *worker.getEventBase(),
+          std::move(addresses),
+          std::chrono::milliseconds(1)));
+  EXPECT_THROW(std::move(client).get(), std::exception);
+}
@@ -17,14 +17,16 @@ std::unique_ptr<TcpConnectionFactory> getConnFactory(
 }
 
 std::unique_ptr<RSocketServer> makeServer(
-    std::shared_ptr<rsocket::RSocketResponder> responder) {
+    std::shared_ptr<rsocket::RSocketResponder> responder,
+    std::shared_ptr<RSocketStats> stats) {
   TcpConnectionAcceptor::Options opts;
   opts.threads = 2;
   opts.address = folly::SocketAddress("0.0.0.0", 0);
 
   // RSocket server accepting on TCP.
   auto rs = RSocket::createServer(
-      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)),
+      std::move(stats));
 
   rs->start([r = std::move(responder)](const SetupParameters&) { return r; });
   return rs;
@@ -18,7 +18,8 @@ std::unique_ptr<TcpConnectionFactory> getConnFactory(
     uint16_t port);
 
 std::unique_ptr<RSocketServer> makeServer(
-    std::shared_ptr<rsocket::RSocketResponder> responder);
+    std::shared_ptr<rsocket::RSocketResponder> responder,
+    std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
 
 std::unique_ptr<RSocketServer> makeResumableServer(
     std::shared_ptr<RSocketServiceHandler> serviceHandler);
@@ -1,11 +1,18 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include <folly/Baton.h>
+#include <folly/Conv.h>
+#include <folly/Synchronized.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 
 #include "RSocketTests.h"
+#include "rsocket/MemoryGovernor.h"
+#include "rsocket/RSocketErrors.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 #include "test/test_utils/GenericRequestResponseHandler.h"
 #include "yarpl/Single.h"
 #include "yarpl/single/SingleTestObserver.h"
@@ -64,6 +71,36 @@ class TestHandlerCancel : public rsocket::RSocketResponder {
   std::shared_ptr<folly::Baton<>> onCancel_;
   std::shared_ptr<folly::Baton<>> onSubscribe_;
 };
+
+// Answers requests once `release` is posted, never without one.
+class TestHandlerDelayed : public rsocket::RSocketResponder {
+ public:
+  TestHandlerDelayed(
+      std::shared_ptr<folly::Baton<>> onRequest,
+      std::shared_ptr<folly::Baton<>> release)
+      : onRequest_(std::move(onRequest)), release_(std::move(release)) {}
+
+  Reference<Single<Payload>> handleRequestResponse(Payload, StreamId)
+      override {
+    onRequest_->post();
+    auto release = release_;
+    return Single<Payload>::create([release](auto subscriber) mutable {
+      if (!release) {
+        subscriber->onSubscribe(SingleSubscriptions::empty());
+        return;
+      }
+      std::thread([subscriber = std::move(subscriber), release] {
+        subscriber->onSubscribe(SingleSubscriptions::empty());
+        release->wait();
+        subscriber->onSuccess(Payload("done"));
+      }).detach();
+    });
+  }
+
+ private:
+  std::shared_ptr<folly::Baton<>> onRequest_;
+  std::shared_ptr<folly::Baton<>> release_;
+};
 }
 
 TEST(RequestResponseTest, Cancel) {
@@ -90,6 +127,27 @@ TEST(RequestResponseTest, Cancel) {
   to->assertNoTerminalEvent();
 }
 
+TEST(RequestResponseTest, Timeout) {
+  folly::ScopedEventBaseThread worker;
+  auto onCancel = std::make_shared<folly::Baton<>>();
+  auto onSubscribe = std::make_shared<folly::Baton<>>();
+  auto server =
+      makeServer(std::make_shared<TestHandlerCancel>(onCancel, onSubscribe));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  RequestOptions options;
+  options.timeout = std::chrono::milliseconds(50);
+  auto to = SingleTestObserver<std::string>::create();
+  requester->requestResponse(Payload("Jane"), options)
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  EXPECT_TRUE(to->getError().is_compatible_with<RequestTimeoutError>());
+  // the responder is cancelled
+  onCancel->wait();
+}
+
 // response creation usage
 TEST(RequestResponseTest, CanCtorTypes) {
   Response r1 = payload_response("foo", "bar");
@@ -115,6 +173,365 @@ TEST(RequestResponseTest, Hello) {
   to->assertOnSuccessValue({"Hello, Jane Doe!", ":)"});
 }
 
+TEST(RequestResponseTest, HelloFuture) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<GenericRequestResponseHandler>(
+      [](StringPair const& request) {
+        return payload_response(
+            "Hello, " + request.first + " " + request.second + "!", ":)");
+      }));
+
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto response = requester->requestResponseFuture(Payload("Jane", "Doe"))
+                      .get(std::chrono::seconds(5));
+  EXPECT_EQ(
+      StringPair("Hello, Jane Doe!", ":)"),
+      payload_to_stringpair(std::move(response)));
+}
+
+TEST(RequestResponseTest, CancelFuture) {
+  folly::ScopedEventBaseThread worker;
+  auto onCancel = std::make_shared<folly::Baton<>>();
+  auto onSubscribe = std::make_shared<folly::Baton<>>();
+  auto server =
+      makeServer(std::make_shared<TestHandlerCancel>(onCancel, onSubscribe));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto response = requester->requestResponseFuture(Payload("Jane"));
+  onSubscribe->wait();
+  response.cancel();
+  // the cancel is sent to the server, and the future fails with the interrupt
+  onCancel->wait();
+  EXPECT_THROW(
+      response.get(std::chrono::seconds(5)), folly::FutureCancellation);
+}
+
+namespace {
+// Never answers, counts the requests and those the client cancels.
+class TestHandlerCounting : public rsocket::RSocketResponder {
+ public:
+  Reference<Single<Payload>> handleRequestResponse(Payload, StreamId)
+      override {
+    ++requests;
+    return Single<Payload>::create([this](auto subscriber) {
+      subscriber->onSubscribe(
+          SingleSubscriptions::create([this] { ++cancels; }));
+    });
+  }
+
+  std::atomic<int> requests{0};
+  std::atomic<int> cancels{0};
+};
+
+void waitFor(const std::atomic<int>& count, int expected) {
+  for (int i = 0; i < 500 && count < expected; ++i) {
+    /* sleep override */
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(expected, count);
+}
+}
+
+TEST(RequestResponseTest, CancelGroup) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<TestHandlerCounting>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  RequestOptions options;
+  options.group = requester->createRequestGroup();
+  auto grouped = SingleTestObserver<Payload>::create();
+  requester->requestResponse(Payload("Jane"), options)->subscribe(grouped);
+  auto groupedFuture =
+      requester->requestResponseFuture(Payload("Joe"), options);
+  auto other = SingleTestObserver<Payload>::create();
+  requester->requestResponse(Payload("Jim"))->subscribe(other);
+  waitFor(handler->requests, 3);
+
+  options.group->cancel();
+  EXPECT_THROW(
+      groupedFuture.get(std::chrono::seconds(5)), RequestCancelledError);
+  waitFor(handler->cancels, 2);
+  grouped->assertNoTerminalEvent();
+  other->assertNoTerminalEvent();
+
+  other->cancel();
+  waitFor(handler->cancels, 3);
+}
+
+namespace {
+class FragmentingServiceHandler : public RSocketServiceHandler {
+ public:
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    auto responder = std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response(request.first + request.first, "");
+        });
+    return RSocketConnectionParams(
+        std::move(responder), RSocketStats::noop(), nullptr, nullptr, 100);
+  }
+};
+}
+
+TEST(RequestResponseTest, FragmentedPayloads) {
+  folly::ScopedEventBaseThread worker;
+  auto server =
+      makeResumableServer(std::make_shared<FragmentingServiceHandler>());
+
+  SetupParameters setupParameters;
+  setupParameters.mtu = 100;
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    std::move(setupParameters))
+                    .get();
+  auto requester = client->getRequester();
+
+  std::string data(10000, 'd');
+  std::string metadata(1000, 'm');
+  auto to = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload(data, metadata))
+      ->map(payload_to_stringpair)
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({data + data, ""});
+}
+
+namespace {
+class CompressingServiceHandler : public RSocketServiceHandler {
+ public:
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters& setupParams) override {
+    EXPECT_TRUE(setupParams.compressionRequested);
+    auto responder = std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response(request.first + request.first, "");
+        });
+    RSocketConnectionParams params(std::move(responder));
+    params.compression.codec = PayloadCompression::Codec::ZSTD;
+    return params;
+  }
+};
+}
+
+TEST(RequestResponseTest, CompressedPayloads) {
+  folly::ScopedEventBaseThread worker;
+  auto server =
+      makeResumableServer(std::make_shared<CompressingServiceHandler>());
+
+  // Fragmented too, the fragments are decompressed once reassembled.
+  SetupParameters setupParameters;
+  setupParameters.metadataMimeType = kCompositeMetadataMimeType.str();
+  setupParameters.compression.codec = PayloadCompression::Codec::ZSTD;
+  setupParameters.mtu = 100;
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    std::move(setupParameters))
+                    .get();
+  auto requester = client->getRequester();
+
+  std::string data;
+  for (int i = 0; i < 1000; ++i) {
+    data += folly::to<std::string>("{\"id\":", i, "}");
+  }
+  auto to = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload(data, "metadata"))
+      ->map(payload_to_stringpair)
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({data + data, ""});
+}
+
+namespace {
+std::unique_ptr<RSocketServer> makeCompressingServer(
+    ConnectionCompression::Codec codec) {
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  ConnectionCompression compression;
+  compression.codec = codec;
+  server->setConnectionCompression(compression);
+  auto responder = std::make_shared<GenericRequestResponseHandler>(
+      [](StringPair const& request) {
+        return payload_response(request.first + request.first, "");
+      });
+  server->start([responder](const SetupParameters&) { return responder; });
+  return server;
+}
+
+void requestCompressedConnection(RSocketServer& server) {
+  folly::ScopedEventBaseThread worker;
+  SetupParameters setupParameters;
+  setupParameters.metadataMimeType = kCompositeMetadataMimeType.str();
+  setupParameters.connectionCompression.codec =
+      ConnectionCompression::Codec::ZSTD;
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server.listeningPort()),
+                    std::move(setupParameters))
+                    .get();
+  auto requester = client->getRequester();
+
+  // Before and after the server accepted.
+  for (int i = 0; i < 3; ++i) {
+    auto const data = folly::to<std::string>("request ", i);
+    auto to = SingleTestObserver<StringPair>::create();
+    requester->requestResponse(Payload(data))
+        ->map(payload_to_stringpair)
+        ->subscribe(to);
+    to->awaitTerminalEvent();
+    to->assertOnSuccessValue({data + data, ""});
+  }
+}
+}
+
+TEST(RequestResponseTest, CompressedConnection) {
+  auto server = makeCompressingServer(ConnectionCompression::Codec::ZSTD);
+  requestCompressedConnection(*server);
+}
+
+TEST(RequestResponseTest, CompressedConnectionIgnored) {
+  // The server doesn't compress, the client keeps writing as it is.
+  auto server = makeCompressingServer(ConnectionCompression::Codec::NONE);
+  requestCompressedConnection(*server);
+}
+
+namespace {
+class MemoryLimitStats : public RSocketStats {
+ public:
+  void connectionMemoryExceeded(size_t bytes) override {
+    exceededBytes = bytes;
+    exceeded.post();
+  }
+
+  std::atomic<size_t> exceededBytes{0};
+  folly::Baton<> exceeded;
+};
+
+class MemoryLimitServiceHandler : public RSocketServiceHandler {
+ public:
+  explicit MemoryLimitServiceHandler(std::shared_ptr<MemoryLimitStats> stats)
+      : stats_(std::move(stats)) {}
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    auto responder = std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response(request.first, "");
+        });
+    RSocketConnectionParams params(std::move(responder), stats_);
+    params.memoryLimits.maxBytes = 64 * 1024;
+    return params;
+  }
+
+ private:
+  const std::shared_ptr<MemoryLimitStats> stats_;
+};
+}
+
+TEST(RequestResponseTest, ConnectionMemoryLimit) {
+  folly::ScopedEventBaseThread worker;
+  auto stats = std::make_shared<MemoryLimitStats>();
+  auto server =
+      makeResumableServer(std::make_shared<MemoryLimitServiceHandler>(stats));
+
+  SetupParameters setupParameters;
+  setupParameters.mtu = 1000;
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    std::move(setupParameters))
+                    .get();
+  auto requester = client->getRequester();
+
+  // The server reassembles the fragments of the request until they go above
+  // its limit.
+  std::string data(1024 * 1024, 'd');
+  auto to = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload(data))
+      ->map(payload_to_stringpair)
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  EXPECT_TRUE(to->getError());
+
+  ASSERT_TRUE(stats->exceeded.timed_wait(std::chrono::seconds(5)));
+  EXPECT_GT(stats->exceededBytes.load(), 64u * 1024);
+  EXPECT_LT(stats->exceededBytes.load(), 2u * 64 * 1024);
+}
+
+namespace {
+class SpanStats : public RSocketStats {
+ public:
+  double traceSampleRate() const override {
+    return 1;
+  }
+
+  void streamSpan(const StreamSpan& span) override {
+    spans.wlock()->push_back(span);
+    recorded.post();
+  }
+
+  folly::Synchronized<std::vector<StreamSpan>> spans;
+  folly::Baton<> recorded;
+};
+}
+
+TEST(RequestResponseTest, TracesSpansAcrossTheConnection) {
+  folly::ScopedEventBaseThread worker;
+  auto serverStats = std::make_shared<SpanStats>();
+  auto server = makeServer(
+      std::make_shared<GenericRequestResponseHandler>(
+          [](StringPair const& request) {
+            return payload_response(request.first, "");
+          }),
+      serverStats);
+
+  auto clientStats = std::make_shared<SpanStats>();
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    SetupParameters(),
+                    std::make_shared<RSocketResponder>(),
+                    kDefaultKeepaliveInterval,
+                    clientStats)
+                    .get();
+
+  RequestOptions options;
+  options.propagateTrace = true;
+  auto to = SingleTestObserver<StringPair>::create();
+  client->getRequester()
+      ->requestResponse(Payload("hello"), options)
+      ->map(payload_to_stringpair)
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({"hello", ""});
+
+  ASSERT_TRUE(clientStats->recorded.timed_wait(std::chrono::seconds(5)));
+  ASSERT_TRUE(serverStats->recorded.timed_wait(std::chrono::seconds(5)));
+  auto const requester = clientStats->spans.rlock()->at(0);
+  auto const responder = serverStats->spans.rlock()->at(0);
+
+  EXPECT_TRUE(requester.requester);
+  EXPECT_EQ(StreamType::REQUEST_RESPONSE, requester.streamType);
+  EXPECT_TRUE(requester.firstPayload);
+  EXPECT_EQ(StreamCompletionSignal::COMPLETE, requester.signal);
+
+  // The span of the responder is a child of the one of the requester.
+  EXPECT_FALSE(responder.requester);
+  EXPECT_EQ(requester.context.traceIdHigh, responder.context.traceIdHigh);
+  EXPECT_EQ(requester.context.traceIdLow, responder.context.traceIdLow);
+  EXPECT_EQ(requester.context.spanId, responder.context.parentSpanId);
+  EXPECT_TRUE(responder.firstPayload);
+  EXPECT_LE(responder.duration, requester.duration);
+}
+
 TEST(RequestResponseTest, FailureInResponse) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<GenericRequestResponseHandler>(
@@ -197,3 +614,265 @@ TEST(RequestResponseTest, FailureOnRequest) {
   to->awaitTerminalEvent();
   EXPECT_TRUE(to->getError());
 }
+
+TEST(RequestResponseTest, DrainWaitsForInFlightRequest) {
+  folly::ScopedEventBaseThread worker;
+  auto onRequest = std::make_shared<folly::Baton<>>();
+  auto release = std::make_shared<folly::Baton<>>();
+  auto server =
+      makeServer(std::make_shared<TestHandlerDelayed>(onRequest, release));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto to = SingleTestObserver<std::string>::create();
+  requester->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  onRequest->wait();
+
+  std::thread shutdown(
+      [&server] { server->shutdownAndWait(std::chrono::seconds(30)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  to->assertNoTerminalEvent();
+
+  release->post();
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("done");
+  shutdown.join();
+}
+
+TEST(RequestResponseTest, DrainTimesOut) {
+  folly::ScopedEventBaseThread worker;
+  auto onRequest = std::make_shared<folly::Baton<>>();
+  auto server =
+      makeServer(std::make_shared<TestHandlerDelayed>(onRequest, nullptr));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto to = SingleTestObserver<std::string>::create();
+  requester->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  onRequest->wait();
+
+  server->shutdownAndWait(std::chrono::milliseconds(100));
+  to->awaitTerminalEvent();
+  EXPECT_TRUE(to->getError());
+}
+
+namespace {
+// Only answers requests whose metadata isn't "blocked", the others are
+// rejected before their payload is deserialized.
+class MetadataRoutingHandler : public GenericRequestResponseHandler {
+ public:
+  MetadataRoutingHandler()
+      : GenericRequestResponseHandler([](StringPair const& request) {
+          EXPECT_NE("blocked", request.second);
+          return payload_response("Hello, " + request.first + "!", "");
+        }) {}
+
+  bool acceptRequest(
+      StreamType streamType,
+      const MetadataView& metadata,
+      StreamId) override {
+    EXPECT_EQ(StreamType::REQUEST_RESPONSE, streamType);
+    auto bytes = metadata.contiguousBytes();
+    EXPECT_TRUE(bytes);
+    return !bytes || folly::StringPiece(*bytes) != "blocked";
+  }
+};
+}
+
+TEST(RequestResponseTest, RejectedFromMetadata) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<MetadataRoutingHandler>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto rejected = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload("Jane", "blocked"))
+      ->map(payload_to_stringpair)
+      ->subscribe(rejected);
+  rejected->awaitTerminalEvent();
+  EXPECT_TRUE(rejected->getError());
+
+  auto accepted = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload("Jane", "allowed"))
+      ->map(payload_to_stringpair)
+      ->subscribe(accepted);
+  accepted->awaitTerminalEvent();
+  accepted->assertOnSuccessValue({"Hello, Jane!", ""});
+}
+
+namespace {
+// Answers from the metadata of the request only, leaving its data in the
+// frame.
+class LazyMetadataHandler : public rsocket::RSocketResponder {
+ public:
+  bool handlesLazyPayloads() const override {
+    return true;
+  }
+
+  Reference<Single<Payload>> handleRequestResponseLazy(
+      LazyPayload request,
+      StreamId) override {
+    auto bytes = request.metadataView().contiguousBytes();
+    EXPECT_TRUE(bytes);
+    auto answer = folly::to<std::string>(
+        "route ",
+        bytes ? folly::StringPiece(*bytes) : folly::StringPiece(),
+        ", ",
+        request.dataLength(),
+        " bytes");
+    return Single<Payload>::create([answer](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+      observer->onSuccess(Payload(answer));
+    });
+  }
+};
+}
+
+TEST(RequestResponseTest, LazyPayload) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<LazyMetadataHandler>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto to = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload("Jane", "users"))
+      ->map(payload_to_stringpair)
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({"route users, 4 bytes", ""});
+}
+
+namespace {
+// Never answers.
+class PendingResponder : public rsocket::RSocketResponder {
+ public:
+  Reference<Single<Payload>> handleRequestResponse(Payload, StreamId)
+      override {
+    return Single<Payload>::create([](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+    });
+  }
+};
+}
+
+TEST(RequestResponseTest, StreamLimits) {
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  StreamLimits limits;
+  limits.maxPerConnection = 2;
+  server->setStreamLimits(limits);
+  auto responder = std::make_shared<PendingResponder>();
+  server->start([responder](const SetupParameters&) { return responder; });
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  std::vector<Reference<SingleTestObserver<Payload>>> pending;
+  for (int i = 0; i < 2; ++i) {
+    pending.push_back(SingleTestObserver<Payload>::create());
+    requester->requestResponse(Payload("Jane"))->subscribe(pending.back());
+  }
+  auto rejected = SingleTestObserver<Payload>::create();
+  requester->requestResponse(Payload("Jane"))->subscribe(rejected);
+  rejected->awaitTerminalEvent();
+  EXPECT_TRUE(rejected->getError());
+  for (auto& observer : pending) {
+    EXPECT_FALSE(observer->getError());
+  }
+}
+
+TEST(RequestResponseTest, MemoryGovernorRejectsStreams) {
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  MemoryGovernor::Options options;
+  options.budget = 1024 * 1024;
+  auto governor = std::make_shared<MemoryGovernor>(options);
+  server->setMemoryGovernor(governor);
+  server->start([](const SetupParameters&) {
+    return std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response(request.first, "");
+        });
+  });
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  // Bytes held by the other connections sharing the budget.
+  size_t others = 0;
+  governor->update(others, options.budget);
+  auto rejected = SingleTestObserver<Payload>::create();
+  requester->requestResponse(Payload("Jane"))->subscribe(rejected);
+  rejected->awaitTerminalEvent();
+  EXPECT_TRUE(rejected->getError());
+
+  governor->update(others, 0);
+  auto accepted = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload("Jane"))
+      ->map(payload_to_stringpair)
+      ->subscribe(accepted);
+  accepted->awaitTerminalEvent();
+  accepted->assertOnSuccessValue({"Jane", ""});
+}
+
+namespace {
+// Answers the requests for "hot" with a serialized response, the others as
+// usual.
+class HotKeyResponder : public GenericRequestResponseHandler {
+ public:
+  HotKeyResponder()
+      : GenericRequestResponseHandler([](StringPair const& request) {
+          EXPECT_NE("hot", request.first);
+          return payload_response("cold " + request.first, "");
+        }),
+        hot_(std::make_shared<SerializedResponse>(Payload("hot value"))) {}
+
+  bool servesSerializedResponses() const override {
+    return true;
+  }
+
+  std::shared_ptr<const SerializedResponse> serializedResponse(
+      const LazyPayload& request,
+      StreamId) override {
+    auto data = request.cloneData();
+    if (data && data->moveToFbString() == "hot") {
+      return hot_;
+    }
+    return nullptr;
+  }
+
+ private:
+  const std::shared_ptr<const SerializedResponse> hot_;
+};
+}
+
+TEST(RequestResponseTest, SerializedResponse) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HotKeyResponder>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  for (int i = 0; i < 3; ++i) {
+    auto hot = SingleTestObserver<StringPair>::create();
+    requester->requestResponse(Payload("hot"))
+        ->map(payload_to_stringpair)
+        ->subscribe(hot);
+    hot->awaitTerminalEvent();
+    hot->assertOnSuccessValue({"hot value", ""});
+  }
+
+  auto cold = SingleTestObserver<StringPair>::create();
+  requester->requestResponse(Payload("key"))
+      ->map(payload_to_stringpair)
+      ->subscribe(cold);
+  cold->awaitTerminalEvent();
+  cold->assertOnSuccessValue({"cold key", ""});
+}
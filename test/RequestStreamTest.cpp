@@ -1,7 +1,10 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <folly/Baton.h>
+#include <folly/Conv.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 
 #include "RSocketTests.h"
@@ -76,6 +79,141 @@ TEST(RequestStreamTest, HelloFlowControl) {
   ts->assertSuccess();
 }
 
+class StreamLatencyStats : public RSocketStats {
+ public:
+  bool streamLatenciesEnabled() const override {
+    return true;
+  }
+  void streamHandlerInvoked(StreamType type, std::chrono::microseconds)
+      override {
+    EXPECT_EQ(StreamType::STREAM, type);
+    ++handlerInvoked;
+  }
+  void streamFirstPayload(StreamType, std::chrono::microseconds) override {
+    ++firstPayloads;
+  }
+  void streamPayloadGap(StreamType, std::chrono::microseconds) override {
+    ++payloadGaps;
+  }
+  void streamBlockedOnRequestN(StreamType, std::chrono::microseconds)
+      override {
+    ++blocked;
+  }
+
+  std::atomic<int> handlerInvoked{0};
+  std::atomic<int> firstPayloads{0};
+  std::atomic<int> payloadGaps{0};
+  std::atomic<int> blocked{0};
+};
+
+namespace {
+/// Takes the stream in batches of 3, on the EventBase of the connection.
+class CollectingSubscriber final : public BaseSubscriber<Payload> {
+ public:
+  void onSubscribeImpl() override {
+    request(3);
+  }
+
+  void onNextImpl(Payload payload) override {
+    values.push_back(payload.moveDataToString());
+    if (values.size() % 3 == 0) {
+      request(3);
+    }
+  }
+
+  void onCompleteImpl() override {
+    done.post();
+  }
+
+  void onErrorImpl(folly::exception_wrapper ex) override {
+    error = std::move(ex);
+    done.post();
+  }
+
+  std::vector<std::string> values;
+  folly::exception_wrapper error;
+  folly::Baton<> done;
+};
+} // namespace
+
+TEST(RequestStreamTest, TypedSubscriber) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<TestHandlerSync>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto subscriber = make_ref<CollectingSubscriber>();
+  client->getRequester()->requestStream(Payload("Bob"), subscriber);
+  ASSERT_TRUE(subscriber->done.timed_wait(std::chrono::seconds(5)));
+  EXPECT_FALSE(subscriber->error);
+  ASSERT_EQ(10U, subscriber->values.size());
+  EXPECT_EQ("Hello Bob 1!", subscriber->values.front());
+  EXPECT_EQ("Hello Bob 10!", subscriber->values.back());
+}
+
+TEST(RequestStreamTest, StreamLatencies) {
+  folly::ScopedEventBaseThread worker;
+  auto stats = std::make_shared<StreamLatencyStats>();
+  auto server = makeServer(std::make_shared<TestHandlerSync>(), stats);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+  auto ts = TestSubscriber<std::string>::create(5);
+  requester->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+
+  ts->awaitValueCount(5);
+  ts->request(5);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+
+  EXPECT_EQ(1, stats->handlerInvoked.load());
+  EXPECT_EQ(1, stats->firstPayloads.load());
+  EXPECT_EQ(9, stats->payloadGaps.load());
+  // The responder used up the initial allowance of 5.
+  EXPECT_GE(stats->blocked.load(), 1);
+}
+
+class StreamStallStats : public RSocketStats {
+ public:
+  std::chrono::milliseconds streamStallThreshold() const override {
+    return std::chrono::milliseconds(5);
+  }
+  void streamStalled(
+      StreamId streamId,
+      StreamType streamType,
+      StallDirection direction,
+      std::chrono::microseconds stalled) override {
+    EXPECT_EQ(1U, streamId);
+    EXPECT_EQ(StreamType::STREAM, streamType);
+    EXPECT_EQ(StallDirection::SEND, direction);
+    EXPECT_GE(stalled, std::chrono::milliseconds(5));
+    ++stalls;
+  }
+
+  std::atomic<int> stalls{0};
+};
+
+TEST(RequestStreamTest, StreamStalls) {
+  folly::ScopedEventBaseThread worker;
+  auto stats = std::make_shared<StreamStallStats>();
+  auto server = makeServer(std::make_shared<TestHandlerSync>(), stats);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+  auto ts = TestSubscriber<std::string>::create(5);
+  requester->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+
+  // The responder is stalled until the subscriber requests more.
+  ts->awaitValueCount(5);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ts->request(5);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+
+  EXPECT_GE(stats->stalls.load(), 1);
+}
+
 class TestHandlerAsync : public rsocket::RSocketResponder {
  public:
   Reference<Flowable<Payload>> handleRequestStream(Payload request, StreamId)
@@ -201,3 +339,90 @@ TEST(RequestStreamTest, HandleErrorMidStream) {
   ts->assertValueCount(4);
   ts->assertOnErrorMessage("A wild Error appeared!");
 }
+
+namespace {
+class TestHandlerTopic : public rsocket::RSocketResponder {
+ public:
+  Reference<Flowable<Payload>> handleRequestStream(Payload, StreamId)
+      override {
+    return topic_;
+  }
+
+ private:
+  const Reference<Flowable<Payload>> topic_{sharePayloads(
+      Flowables::range(1, 10)->map([](int64_t v) {
+        return Payload(folly::to<std::string>(v), "topic");
+      }))};
+};
+} // namespace
+
+TEST(RequestStreamTest, SharedTopic) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<TestHandlerTopic>());
+
+  // The topic is subscribed to again once it has completed.
+  for (int i = 0; i < 2; ++i) {
+    auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+    auto ts = TestSubscriber<std::string>::create(5);
+    client->getRequester()
+        ->requestStream(Payload("topic"))
+        ->map([](auto p) { return p.moveDataToString(); })
+        ->subscribe(ts);
+    ts->awaitValueCount(5);
+    ts->request(5);
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+    ts->assertValueCount(10);
+    ts->assertValueAt(0, "1");
+    ts->assertValueAt(9, "10");
+  }
+}
+
+namespace {
+// Forwards every request to the connection of `requester`.
+class ForwardingHandler : public rsocket::RSocketResponder {
+ public:
+  explicit ForwardingHandler(std::shared_ptr<RSocketRequester> requester)
+      : requester_(std::move(requester)) {}
+
+  std::shared_ptr<RSocketRequester>
+  forwardRequest(StreamType, const MetadataView&, StreamId) override {
+    return requester_;
+  }
+
+  Reference<Flowable<Payload>> handleRequestStream(Payload, StreamId)
+      override {
+    return Flowables::error<Payload>(std::runtime_error("not forwarded"));
+  }
+
+ private:
+  const std::shared_ptr<RSocketRequester> requester_;
+};
+} // namespace
+
+TEST(RequestStreamTest, ForwardedByProxy) {
+  folly::ScopedEventBaseThread backendWorker;
+  auto backend = makeServer(std::make_shared<TestHandlerSync>());
+  auto backendClient =
+      makeClient(backendWorker.getEventBase(), *backend->listeningPort());
+  auto proxy = makeServer(
+      std::make_shared<ForwardingHandler>(backendClient->getRequester()));
+
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *proxy->listeningPort());
+  auto ts = TestSubscriber<std::string>::create(5);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+
+  // The REQUEST_N frames go through the proxy too.
+  ts->awaitValueCount(5);
+  ts->assertValueCount(5);
+  ts->request(5);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+  ts->assertValueAt(0, "Hello Bob 1!");
+  ts->assertValueAt(9, "Hello Bob 10!");
+}
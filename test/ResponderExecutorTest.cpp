@@ -0,0 +1,234 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+#include "rsocket/ResponderExecutor.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+ResponderExecutor::Options singleThread() {
+  ResponderExecutor::Options options;
+  options.numThreads = 1;
+  return options;
+}
+
+/// Keeps the thread of the executor busy until release() is called.
+class Blocker {
+ public:
+  explicit Blocker(ResponderExecutor::Queue& queue) {
+    EXPECT_TRUE(queue.add(
+        [this] {
+          started_.post();
+          released_.wait();
+        },
+        StreamPriority::Class::INTERACTIVE));
+    started_.wait();
+  }
+
+  void release() {
+    released_.post();
+  }
+
+ private:
+  folly::Baton<> started_;
+  folly::Baton<> released_;
+};
+
+class Recorder {
+ public:
+  ResponderExecutor::Func record(std::string name) {
+    return [this, name = std::move(name)] {
+      std::lock_guard<std::mutex> lock(mutex_);
+      order_.push_back(name);
+      if (order_.size() == expected_) {
+        done_.post();
+      }
+    };
+  }
+
+  std::vector<std::string> wait(size_t expected) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      expected_ = expected;
+      if (order_.size() == expected_) {
+        done_.post();
+      }
+    }
+    done_.wait();
+    std::lock_guard<std::mutex> lock(mutex_);
+    return order_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::string> order_;
+  size_t expected_{0};
+  folly::Baton<> done_;
+};
+
+class ExecutorServiceHandler : public RSocketServiceHandler {
+ public:
+  explicit ExecutorServiceHandler(std::shared_ptr<ResponderExecutor> executor)
+      : executor_(std::move(executor)) {}
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    RSocketConnectionParams params(
+        std::make_shared<HelloStreamRequestHandler>());
+    params.responderExecutor = executor_;
+    return params;
+  }
+
+ private:
+  const std::shared_ptr<ResponderExecutor> executor_;
+};
+}
+
+TEST(ResponderExecutorTest, RoundRobinAcrossQueues) {
+  ResponderExecutor executor(singleThread());
+  auto flooding = executor.createQueue();
+  auto quiet = executor.createQueue();
+  Recorder recorder;
+
+  Blocker blocker(*flooding);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(flooding->add(
+        recorder.record("flooding"), StreamPriority::Class::BULK));
+  }
+  EXPECT_TRUE(
+      quiet->add(recorder.record("quiet"), StreamPriority::Class::BULK));
+  EXPECT_EQ(4U, executor.queuedTasks());
+  blocker.release();
+
+  EXPECT_EQ(
+      std::vector<std::string>({"flooding", "quiet", "flooding", "flooding"}),
+      recorder.wait(4));
+}
+
+TEST(ResponderExecutorTest, InteractiveBeforeBulk) {
+  ResponderExecutor executor(singleThread());
+  auto queue = executor.createQueue();
+  Recorder recorder;
+
+  Blocker blocker(*queue);
+  EXPECT_TRUE(queue->add(recorder.record("bulk"), StreamPriority::Class::BULK));
+  EXPECT_TRUE(queue->add(
+      recorder.record("interactive"), StreamPriority::Class::INTERACTIVE));
+  blocker.release();
+
+  EXPECT_EQ(
+      std::vector<std::string>({"interactive", "bulk"}), recorder.wait(2));
+}
+
+TEST(ResponderExecutorTest, EarliestDeadlineFirst) {
+  auto options = singleThread();
+  options.earliestDeadlineFirst = true;
+  ResponderExecutor executor(options);
+  auto first = executor.createQueue();
+  auto second = executor.createQueue();
+  Recorder recorder;
+  auto const now = ResponderExecutor::Clock::now();
+  auto const interactive = StreamPriority::Class::INTERACTIVE;
+
+  Blocker blocker(*first);
+  EXPECT_TRUE(first->add(recorder.record("none"), interactive));
+  EXPECT_TRUE(first->add(
+      recorder.record("late"),
+      interactive,
+      now + std::chrono::hours(2),
+      recorder.record("late expired")));
+  EXPECT_TRUE(second->add(
+      recorder.record("soon"),
+      interactive,
+      now + std::chrono::hours(1),
+      recorder.record("soon expired")));
+  EXPECT_TRUE(second->add(
+      recorder.record("past"),
+      interactive,
+      now - std::chrono::seconds(1),
+      recorder.record("past expired")));
+  EXPECT_EQ(4U, executor.queuedTasks());
+  blocker.release();
+
+  EXPECT_EQ(
+      std::vector<std::string>({"past expired", "soon", "late", "none"}),
+      recorder.wait(4));
+}
+
+TEST(ResponderExecutorTest, DropsTheDeadlinesOfDestroyedQueues) {
+  auto options = singleThread();
+  options.earliestDeadlineFirst = true;
+  ResponderExecutor executor(options);
+  auto first = executor.createQueue();
+  auto second = executor.createQueue();
+  Recorder recorder;
+  auto const deadline = ResponderExecutor::Clock::now() + std::chrono::hours(1);
+
+  Blocker blocker(*first);
+  EXPECT_TRUE(first->add(
+      recorder.record("first"), StreamPriority::Class::BULK, deadline, {}));
+  EXPECT_TRUE(second->add(
+      recorder.record("second"), StreamPriority::Class::BULK, deadline, {}));
+  first.reset();
+  EXPECT_EQ(1U, executor.queuedTasks());
+  blocker.release();
+
+  EXPECT_EQ(std::vector<std::string>({"second"}), recorder.wait(1));
+}
+
+TEST(ResponderExecutorTest, BoundsTheQueues) {
+  auto options = singleThread();
+  options.maxQueuedTasks = 3;
+  options.maxQueuedTasksPerQueue = 2;
+  ResponderExecutor executor(options);
+  auto first = executor.createQueue();
+  auto second = executor.createQueue();
+
+  Blocker blocker(*first);
+  EXPECT_TRUE(first->add([] {}, StreamPriority::Class::BULK));
+  EXPECT_TRUE(first->add([] {}, StreamPriority::Class::BULK));
+  EXPECT_TRUE(first->full());
+  EXPECT_FALSE(first->add([] {}, StreamPriority::Class::BULK));
+
+  EXPECT_TRUE(second->add([] {}, StreamPriority::Class::BULK));
+  // The executor is full.
+  EXPECT_FALSE(second->add([] {}, StreamPriority::Class::BULK));
+
+  // The tasks of a destroyed queue are dropped.
+  first.reset();
+  EXPECT_EQ(1U, executor.queuedTasks());
+  blocker.release();
+}
+
+TEST(ResponderExecutorTest, RunsTheResponders) {
+  auto executor = std::make_shared<ResponderExecutor>(singleThread());
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  server->start(std::make_shared<ExecutorServiceHandler>(executor));
+
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = yarpl::flowable::TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
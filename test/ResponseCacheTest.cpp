@@ -0,0 +1,182 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/ResponseCache.h"
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::single;
+using namespace std::chrono_literals;
+
+namespace {
+// Echoes the data of the requests, once `release` is posted if there is one.
+class CountingHandler : public RSocketResponder {
+ public:
+  explicit CountingHandler(std::shared_ptr<folly::Baton<>> release = nullptr)
+      : release_(std::move(release)) {}
+
+  yarpl::Reference<Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    ++requests_;
+    return Single<Payload>::create([
+      data = request.moveDataToString(),
+      release = release_
+    ](auto observer) {
+      observer->onSubscribe(SingleSubscriptions::empty());
+      if (!release) {
+        observer->onSuccess(Payload(data));
+        return;
+      }
+      std::thread([observer, data, release] {
+        release->wait();
+        observer->onSuccess(Payload(data));
+      }).detach();
+    });
+  }
+
+  std::atomic<size_t> requests_{0};
+
+ private:
+  const std::shared_ptr<folly::Baton<>> release_;
+};
+
+std::string request(
+    ResponseCache& cache,
+    const std::shared_ptr<RSocketRequester>& requester,
+    Payload payload) {
+  auto observer = SingleTestObserver<std::string>::create();
+  cache.requestResponse(requester, std::move(payload))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(observer);
+  observer->awaitTerminalEvent();
+  return observer->getOnSuccessValue();
+}
+} // namespace
+
+TEST(ResponseCacheTest, CachesResponses) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<CountingHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  ResponseCache cache(ResponseCache::Options{});
+  EXPECT_EQ("a", request(cache, requester, Payload("a", "route")));
+  EXPECT_EQ("a", request(cache, requester, Payload("a", "route")));
+  EXPECT_EQ(1u, handler->requests_);
+
+  // Another route or data is another key.
+  EXPECT_EQ("a", request(cache, requester, Payload("a", "other")));
+  EXPECT_EQ("b", request(cache, requester, Payload("b", "route")));
+  EXPECT_EQ(3u, handler->requests_);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(3u, stats.misses);
+  EXPECT_EQ(3u, stats.entries);
+
+  cache.clear();
+  EXPECT_EQ("a", request(cache, requester, Payload("a", "route")));
+  EXPECT_EQ(4u, handler->requests_);
+}
+
+TEST(ResponseCacheTest, ExpiresAndEvictsResponses) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<CountingHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  ResponseCache::Options options;
+  options.ttl = 10ms;
+  options.maxEntries = 2;
+  ResponseCache cache(options);
+
+  request(cache, requester, Payload("a"));
+  std::this_thread::sleep_for(20ms);
+  request(cache, requester, Payload("a"));
+  EXPECT_EQ(2u, handler->requests_);
+
+  options.ttl = std::chrono::hours(1);
+  ResponseCache lasting(options);
+  request(lasting, requester, Payload("a"));
+  request(lasting, requester, Payload("b"));
+  request(lasting, requester, Payload("c"));
+  EXPECT_EQ(2u, lasting.stats().entries);
+  // "a" was the least recently used.
+  request(lasting, requester, Payload("c"));
+  request(lasting, requester, Payload("a"));
+  EXPECT_EQ(6u, handler->requests_);
+}
+
+TEST(ResponseCacheTest, CoalescesConcurrentRequests) {
+  folly::ScopedEventBaseThread worker;
+  auto release = std::make_shared<folly::Baton<>>();
+  auto handler = std::make_shared<CountingHandler>(release);
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  ResponseCache cache(ResponseCache::Options{});
+  std::vector<yarpl::Reference<SingleTestObserver<std::string>>> observers;
+  for (int i = 0; i < 3; ++i) {
+    observers.push_back(SingleTestObserver<std::string>::create());
+    cache.requestResponse(requester, Payload("a", "route"))
+        ->map([](auto p) { return p.moveDataToString(); })
+        ->subscribe(observers.back());
+  }
+  EXPECT_EQ(1u, cache.stats().misses);
+  EXPECT_EQ(2u, cache.stats().coalesced);
+
+  release->post();
+  for (auto& observer : observers) {
+    observer->awaitTerminalEvent();
+    observer->assertOnSuccessValue("a");
+  }
+  EXPECT_EQ(1u, handler->requests_);
+}
+
+TEST(ResponseCacheTest, RoutesCompositeMetadata) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<CountingHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto metadata = [](folly::StringPiece route, folly::StringPiece trace) {
+    return CompositeMetadataBuilder()
+        .add(kRoutingMimeType, route)
+        .add("application/x-trace", trace)
+        .build();
+  };
+
+  ResponseCache::Options options;
+  options.compositeMetadata = true;
+  ResponseCache cache(options);
+  request(
+      cache,
+      requester,
+      Payload(folly::IOBuf::copyBuffer("a"), metadata("route", "1")));
+  request(
+      cache,
+      requester,
+      Payload(folly::IOBuf::copyBuffer("a"), metadata("route", "2")));
+  EXPECT_EQ(1u, handler->requests_);
+  request(
+      cache,
+      requester,
+      Payload(folly::IOBuf::copyBuffer("a"), metadata("other", "2")));
+  EXPECT_EQ(2u, handler->requests_);
+}
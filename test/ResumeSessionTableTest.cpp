@@ -0,0 +1,98 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <chrono>
+#include <thread>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+
+#include "rsocket/ResumeSessionTable.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::flowable;
+
+namespace {
+class HelloSessionHandler : public ResumeSessionServiceHandler {
+ public:
+  using ResumeSessionServiceHandler::ResumeSessionServiceHandler;
+
+  folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
+      const SetupParameters&) override {
+    return RSocketConnectionParams(
+        std::make_shared<HelloStreamRequestHandler>());
+  }
+};
+
+/// Waits up to 5 seconds for the table to have `size` sessions.
+bool waitForSize(ResumeSessionTable& sessions, size_t size) {
+  auto const deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (sessions.size() != size) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+} // namespace
+
+TEST(ResumeSessionTableTest, Resumes) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<HelloSessionHandler>();
+  auto server = makeResumableServer(handler);
+  auto client =
+      makeWarmResumableClient(worker.getEventBase(), *server->listeningPort());
+  EXPECT_TRUE(waitForSize(handler->sessions(), 1));
+
+  auto ts = TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  while (ts->getValueCount() < 3) {
+    std::this_thread::yield();
+  }
+  auto result =
+      client->disconnect(std::runtime_error("Test triggered disconnect"))
+          .then([&] { return client->resume(); });
+  EXPECT_NO_THROW(result.get());
+  ts->request(3);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
+
+TEST(ResumeSessionTableTest, RemovesAbandonedSessions) {
+  folly::ScopedEventBaseThread worker;
+  ResumeSessionTable::Options options;
+  options.abandonAfter = std::chrono::milliseconds(50);
+  auto handler = std::make_shared<HelloSessionHandler>(
+      std::make_shared<ResumeSessionTable>(options));
+  auto server = makeResumableServer(handler);
+  auto client =
+      makeWarmResumableClient(worker.getEventBase(), *server->listeningPort());
+  EXPECT_TRUE(waitForSize(handler->sessions(), 1));
+
+  // Connected sessions stay.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(1U, handler->sessions().size());
+
+  client->disconnect(std::runtime_error("Test triggered disconnect")).get();
+  EXPECT_TRUE(waitForSize(handler->sessions(), 0));
+}
+
+TEST(ResumeSessionTableTest, UnknownToken) {
+  ResumeSessionTable sessions;
+  auto const token = ResumeIdentificationToken::generateNew();
+  EXPECT_EQ(nullptr, sessions.find(token));
+  EXPECT_FALSE(sessions.erase(token));
+  EXPECT_EQ(0U, sessions.size());
+}
@@ -0,0 +1,96 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <atomic>
+#include <thread>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+#include "rsocket/StandbyConnectionFactory.h"
+#include "test/handlers/HelloServiceHandler.h"
+#include "test/handlers/HelloStreamRequestHandler.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace yarpl::flowable;
+
+namespace {
+/// Counts the connections of a factory.
+class CountingConnectionFactory : public ConnectionFactory {
+ public:
+  explicit CountingConnectionFactory(std::unique_ptr<ConnectionFactory> inner)
+      : inner_(std::move(inner)) {}
+
+  folly::Future<ConnectedDuplexConnection> connect() override {
+    ++connects;
+    return inner_->connect();
+  }
+
+  std::atomic<size_t> connects{0};
+
+ private:
+  const std::unique_ptr<ConnectionFactory> inner_;
+};
+} // namespace
+
+TEST(StandbyConnectionFactoryTest, ResumesOverTheStandby) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(std::make_shared<HelloServiceHandler>());
+  auto counting = std::make_shared<CountingConnectionFactory>(
+      getConnFactory(worker.getEventBase(), *server->listeningPort()));
+  auto factory = std::make_shared<StandbyConnectionFactory>(counting);
+  factory->waitForStandby().get();
+  EXPECT_TRUE(factory->standbyReady());
+
+  SetupParameters setupParameters;
+  setupParameters.resumable = true;
+  auto client = RSocket::createConnectedClient(
+                    factory, std::move(setupParameters))
+                    .get();
+  // The client was connected over the standby, which was replaced.
+  factory->waitForStandby().get();
+  EXPECT_TRUE(factory->standbyReady());
+  EXPECT_EQ(2U, counting->connects.load());
+
+  auto ts = TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  while (ts->getValueCount() < 3) {
+    std::this_thread::yield();
+  }
+  client->disconnect(std::runtime_error("Test triggered disconnect"))
+      .then([&] { return client->resume(); })
+      .get();
+  ts->request(3);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+
+  factory->waitForStandby().get();
+  EXPECT_TRUE(factory->standbyReady());
+  EXPECT_EQ(3U, counting->connects.load());
+}
+
+TEST(StandbyConnectionFactoryTest, StaleStandbyIsReplaced) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto counting = std::make_shared<CountingConnectionFactory>(
+      getConnFactory(worker.getEventBase(), *server->listeningPort()));
+  StandbyConnectionFactory::Options options;
+  options.maxIdle = std::chrono::milliseconds(1);
+  auto factory = std::make_shared<StandbyConnectionFactory>(counting, options);
+  factory->waitForStandby().get();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_FALSE(factory->standbyReady());
+
+  // A new standby is connected, and the caller gets a fresh connection.
+  auto client = RSocket::createConnectedClient(factory).get();
+  EXPECT_NO_THROW(client->getRequester()->ping().get());
+  factory->waitForStandby().get();
+  EXPECT_EQ(3U, counting->connects.load());
+}
@@ -69,7 +69,7 @@ TEST_F(WarmResumeManagerTest, OneFrame) {
   auto frame1 = frameSerializer_->serializeOut(Frame_CANCEL(0));
   const auto frame1Size = frame1->computeChainDataLength();
 
-  cache.trackSentFrame(*frame1, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame1, frame1Size, FrameType::CANCEL, 1, 0);
 
   EXPECT_EQ(0, cache.firstSentPosition());
   EXPECT_EQ((ResumePosition)frame1Size, cache.lastSentPosition());
@@ -113,8 +113,8 @@ TEST_F(WarmResumeManagerTest, TwoFrames) {
   auto frame2 = frameSerializer_->serializeOut(Frame_REQUEST_N(0, 2));
   const auto frame2Size = frame2->computeChainDataLength();
 
-  cache.trackSentFrame(*frame1, FrameType::CANCEL, 1, 0);
-  cache.trackSentFrame(*frame2, FrameType::REQUEST_N, 1, 0);
+  cache.trackSentFrame(*frame1, frame1Size, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame2, frame2Size, FrameType::REQUEST_N, 1, 0);
 
   EXPECT_EQ(0, cache.firstSentPosition());
   EXPECT_EQ(
@@ -157,13 +157,13 @@ TEST_F(WarmResumeManagerTest, Stats) {
   auto frame1 = frameSerializer_->serializeOut(Frame_CANCEL(0));
   auto frame1Size = frame1->computeChainDataLength();
   EXPECT_CALL(*stats, resumeBufferChanged(1, frame1Size));
-  cache.trackSentFrame(*frame1, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame1, frame1Size, FrameType::CANCEL, 1, 0);
 
   auto frame2 = frameSerializer_->serializeOut(Frame_REQUEST_N(0, 3));
   auto frame2Size = frame2->computeChainDataLength();
   EXPECT_CALL(*stats, resumeBufferChanged(1, frame2Size)).Times(2);
-  cache.trackSentFrame(*frame2, FrameType::REQUEST_N, 1, 0);
-  cache.trackSentFrame(*frame2, FrameType::REQUEST_N, 1, 0);
+  cache.trackSentFrame(*frame2, frame2Size, FrameType::REQUEST_N, 1, 0);
+  cache.trackSentFrame(*frame2, frame2Size, FrameType::REQUEST_N, 1, 0);
 
   EXPECT_CALL(*stats, resumeBufferChanged(-1, -frame1Size));
   cache.resetUpToPosition(frame1Size);
@@ -177,8 +177,8 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
   // construct cache with capacity of 2 frameSize
   WarmResumeManager cache(RSocketStats::noop(), frameSize * 2);
 
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
 
   // first 2 frames should be present in the cache
   EXPECT_TRUE(cache.isPositionAvailable(0));
@@ -186,7 +186,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
   EXPECT_TRUE(cache.isPositionAvailable(frameSize * 2));
 
   // add third frame, and this frame should evict first frame
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_FALSE(cache.isPositionAvailable(0));
   EXPECT_TRUE(cache.isPositionAvailable(frameSize));
   EXPECT_TRUE(cache.isPositionAvailable(frameSize * 2));
@@ -199,7 +199,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
   EXPECT_TRUE(cache.isPositionAvailable(frameSize * 3));
 
   // add fourth frame, this should evict second frame
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_FALSE(cache.isPositionAvailable(0));
   EXPECT_FALSE(cache.isPositionAvailable(frameSize));
   EXPECT_TRUE(cache.isPositionAvailable(frameSize * 2));
@@ -213,7 +213,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
   }
   auto hugeFrameSize = hugeFrame->computeChainDataLength();
   EXPECT_EQ(hugeFrameSize, frameSize * 3);
-  cache.trackSentFrame(*hugeFrame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*hugeFrame, hugeFrameSize, FrameType::CANCEL, 1, 0);
 
   // cache should be cleared
   EXPECT_EQ(cache.size(), (size_t)0);
@@ -232,7 +232,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
 
   // caching small frames shouldn't be affected
   // Adding one small frame to cache
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_EQ(cache.size(), frameSize);
   EXPECT_FALSE(cache.isPositionAvailable(0));
   EXPECT_FALSE(cache.isPositionAvailable(frameSize));
@@ -249,7 +249,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
       cache.lastSentPosition());
 
   // Adding second small frame to cache
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_EQ(cache.size(), frameSize * 2);
   EXPECT_FALSE(cache.isPositionAvailable(0));
   EXPECT_FALSE(cache.isPositionAvailable(frameSize));
@@ -267,7 +267,7 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
       cache.lastSentPosition());
 
   // Adding third small frame to cache.  Should result in first frame eviction
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_EQ(cache.size(), frameSize * 2);
   EXPECT_FALSE(cache.isPositionAvailable(0));
   EXPECT_FALSE(cache.isPositionAvailable(frameSize));
@@ -286,6 +286,42 @@ TEST_F(WarmResumeManagerTest, EvictFIFO) {
       cache.lastSentPosition());
 }
 
+TEST_F(WarmResumeManagerTest, LimitBuffer) {
+  auto frame = frameSerializer_->serializeOut(Frame_CANCEL(0));
+  const auto frameSize = frame->computeChainDataLength();
+
+  WarmResumeManager cache(RSocketStats::noop(), frameSize * 4);
+  for (int i = 0; i < 4; i++) {
+    cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  }
+  EXPECT_TRUE(cache.isPositionAvailable(0));
+
+  // Halving the capacity evicts the two oldest frames.
+  cache.limitBuffer(0.5);
+  EXPECT_EQ(frameSize * 2, cache.size());
+  EXPECT_FALSE(cache.isPositionAvailable(frameSize));
+  EXPECT_TRUE(cache.isPositionAvailable(frameSize * 2));
+
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  EXPECT_EQ(frameSize * 2, cache.size());
+  EXPECT_FALSE(cache.isPositionAvailable(frameSize * 2));
+
+  // Nothing is buffered while the limit is 0.
+  cache.limitBuffer(0);
+  EXPECT_EQ(0U, cache.size());
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(frameSize * 6, cache.firstSentPosition());
+
+  // Lifting the limit lets the buffer grow back to its capacity.
+  cache.limitBuffer(1);
+  for (int i = 0; i < 4; i++) {
+    cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  }
+  EXPECT_EQ(frameSize * 4, cache.size());
+  EXPECT_TRUE(cache.isPositionAvailable(frameSize * 6));
+}
+
 TEST_F(WarmResumeManagerTest, EvictStats) {
   auto stats = std::make_shared<StrictMock<MockStats>>();
 
@@ -307,9 +343,9 @@ TEST_F(WarmResumeManagerTest, EvictStats) {
     EXPECT_CALL(*stats, resumeBufferChanged(-2, -frameSize * 2));
   }
 
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
 
   EXPECT_EQ(frameSize * 2, cache.size());
 }
@@ -320,7 +356,7 @@ TEST_F(WarmResumeManagerTest, PositionSmallFrame) {
 
   // Cache is larger than frame
   WarmResumeManager cache(RSocketStats::noop(), frameSize * 2);
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_EQ(
       frame->computeChainDataLength(),
       static_cast<size_t>(cache.lastSentPosition()));
@@ -332,8 +368,151 @@ TEST_F(WarmResumeManagerTest, PositionLargeFrame) {
 
   // Cache is smaller than frame
   WarmResumeManager cache(RSocketStats::noop(), frameSize / 2);
-  cache.trackSentFrame(*frame, FrameType::CANCEL, 1, 0);
+  cache.trackSentFrame(*frame, frameSize, FrameType::CANCEL, 1, 0);
   EXPECT_EQ(
       frame->computeChainDataLength(),
       static_cast<size_t>(cache.lastSentPosition()));
 }
+
+TEST_F(WarmResumeManagerTest, FramesWrapAroundBuffer) {
+  auto frameOf = [&](uint32_t n) {
+    return frameSerializer_->serializeOut(Frame_REQUEST_N(1, n));
+  };
+  const auto frameSize = frameOf(1)->computeChainDataLength();
+
+  // The capacity isn't a multiple of the frame size, so frames end up split
+  // across the end of the buffer.
+  WarmResumeManager cache(RSocketStats::noop(), frameSize * 3 + 1);
+  FrameTransportMock transport;
+
+  for (uint32_t n = 1; n <= 10; ++n) {
+    cache.trackSentFrame(*frameOf(n), frameSize, FrameType::REQUEST_N, 1, 0);
+  }
+  EXPECT_EQ(frameSize * 3, cache.size());
+  EXPECT_EQ((ResumePosition)(frameSize * 7), cache.firstSentPosition());
+
+  uint32_t expected = 8;
+  EXPECT_CALL(transport, outputFrameOrDrop_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        Frame_REQUEST_N frame;
+        ASSERT_TRUE(frameSerializer_->deserializeFrom(frame, buf->clone()));
+        EXPECT_EQ(expected++, frame.requestN_);
+      }));
+  cache.sendFramesFromPosition(frameSize * 7, transport);
+}
+
+TEST_F(WarmResumeManagerTest, ReplaysInBatches) {
+  auto frameOf = [&](uint32_t n) {
+    return frameSerializer_->serializeOut(Frame_REQUEST_N(1, n));
+  };
+  const auto frameSize = frameOf(1)->computeChainDataLength();
+
+  WarmResumeManager cache(RSocketStats::noop());
+  FrameTransportMock transport;
+
+  for (uint32_t n = 1; n <= 5; ++n) {
+    cache.trackSentFrame(*frameOf(n), frameSize, FrameType::REQUEST_N, 1, 0);
+  }
+
+  uint32_t expected = 1;
+  EXPECT_CALL(transport, outputFrameOrDrop_(_))
+      .Times(5)
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        Frame_REQUEST_N frame;
+        ASSERT_TRUE(frameSerializer_->deserializeFrom(frame, buf->clone()));
+        EXPECT_EQ(expected++, frame.requestN_);
+      }));
+
+  // At least one frame is sent, and the frame crossing the limit is sent.
+  auto position = cache.replayFramesFromPosition(0, transport, 1);
+  EXPECT_EQ((ResumePosition)frameSize, position);
+  position = cache.replayFramesFromPosition(position, transport, frameSize + 1);
+  EXPECT_EQ((ResumePosition)(frameSize * 3), position);
+  position = cache.replayFramesFromPosition(position, transport, frameSize * 5);
+  EXPECT_EQ(cache.lastSentPosition(), position);
+  EXPECT_EQ(position, cache.replayFramesFromPosition(position, transport, 1));
+}
+
+TEST_F(WarmResumeManagerTest, ReleaseBuffersKeepsFrames) {
+  auto frameOf = [&](uint32_t n) {
+    return frameSerializer_->serializeOut(Frame_REQUEST_N(1, n));
+  };
+  const auto frameSize = frameOf(1)->computeChainDataLength();
+
+  WarmResumeManager cache(RSocketStats::noop(), frameSize * 3 + 1);
+  FrameTransportMock transport;
+
+  // The frames wrap around the buffer before it is compacted.
+  for (uint32_t n = 1; n <= 10; ++n) {
+    cache.trackSentFrame(*frameOf(n), frameSize, FrameType::REQUEST_N, 1, 0);
+  }
+  cache.releaseBuffers();
+  EXPECT_EQ(frameSize * 3, cache.size());
+  EXPECT_TRUE(cache.isPositionAvailable(frameSize * 7));
+
+  // The compacted buffer takes new frames as well.
+  cache.trackSentFrame(*frameOf(11), frameSize, FrameType::REQUEST_N, 1, 0);
+  EXPECT_EQ((ResumePosition)(frameSize * 8), cache.firstSentPosition());
+
+  uint32_t expected = 9;
+  EXPECT_CALL(transport, outputFrameOrDrop_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        Frame_REQUEST_N frame;
+        ASSERT_TRUE(frameSerializer_->deserializeFrom(frame, buf->clone()));
+        EXPECT_EQ(expected++, frame.requestN_);
+      }));
+  cache.sendFramesFromPosition(frameSize * 8, transport);
+
+  // Without frames the buffer goes away, and comes back with the next one.
+  cache.resetUpToPosition(cache.lastSentPosition());
+  cache.releaseBuffers();
+  EXPECT_EQ(0u, cache.size());
+  cache.trackSentFrame(*frameOf(12), frameSize, FrameType::REQUEST_N, 1, 0);
+  EXPECT_EQ(frameSize, cache.size());
+}
+
+TEST_F(WarmResumeManagerTest, SharesLargeFrames) {
+  auto large = folly::IOBuf::copyBuffer(std::string(64 * 1024, 'x'));
+  auto largeFrame = [&] {
+    return frameSerializer_->serializeOut(
+        Frame_PAYLOAD(1, FrameFlags::NEXT, Payload(large->clone())));
+  };
+  auto const largeSize = largeFrame()->computeChainDataLength();
+  auto const smallFrame =
+      frameSerializer_->serializeOut(Frame_REQUEST_N(1, 1));
+  auto const smallSize = smallFrame->computeChainDataLength();
+
+  WarmResumeManager cache(RSocketStats::noop(), largeSize * 2);
+  FrameTransportMock transport;
+
+  cache.trackSentFrame(*largeFrame(), largeSize, FrameType::PAYLOAD, 1, 0);
+  cache.trackSentFrame(*smallFrame, smallSize, FrameType::REQUEST_N, 1, 0);
+  cache.trackSentFrame(*largeFrame(), largeSize, FrameType::PAYLOAD, 1, 0);
+  // The capacity still bounds the frames, shared or not.
+  EXPECT_EQ((ResumePosition)largeSize, cache.firstSentPosition());
+  EXPECT_EQ(smallSize + largeSize, cache.size());
+
+  // The large frame is replayed from the buffer of the payload.
+  std::vector<std::unique_ptr<folly::IOBuf>> replayed;
+  EXPECT_CALL(transport, outputFrameOrDrop_(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        replayed.push_back(std::move(buf));
+      }));
+  cache.sendFramesFromPosition(largeSize, transport);
+  ASSERT_EQ(2u, replayed.size());
+  EXPECT_TRUE(folly::IOBufEqual()(*smallFrame, *replayed[0]));
+  bool sharesPayload = false;
+  for (auto& buf : *replayed[1]) {
+    sharesPayload |= buf.data() == large->data();
+  }
+  EXPECT_TRUE(sharesPayload);
+  EXPECT_TRUE(folly::IOBufEqual()(*largeFrame(), *replayed[1]));
+
+  replayed.clear();
+  cache.resetUpToPosition(cache.lastSentPosition());
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(large->isShared());
+}
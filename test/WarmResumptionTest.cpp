@@ -6,6 +6,8 @@
 
 #include "RSocketTests.h"
 
+#include "rsocket/CountingRSocketStats.h"
+
 #include "test/handlers/HelloServiceHandler.h"
 #include "test/handlers/HelloStreamRequestHandler.h"
 
@@ -157,3 +159,39 @@ TEST(WarmResumptionTest, DifferentEvb) {
   ts->assertSuccess();
   ts->assertValueCount(10);
 }
+
+// Verify the client acknowledges the position it received up to without
+// waiting for a keepalive, and still resumes afterwards.
+TEST(WarmResumptionTest, PositionAcknowledgement) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(std::make_shared<HelloServiceHandler>());
+  SetupParameters setupParameters;
+  setupParameters.resumable = true;
+  setupParameters.positionAckBytes = 1;
+  auto stats = std::make_shared<CountingRSocketStats>();
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    std::move(setupParameters),
+                    std::make_shared<RSocketResponder>(),
+                    std::chrono::hours(1), // no regular keepalives
+                    stats)
+                    .get();
+  auto ts = TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  while (ts->getValueCount() < 3 ||
+         stats->snapshot().written(FrameType::KEEPALIVE) == 0) {
+    std::this_thread::yield();
+  }
+  auto result =
+      client->disconnect(std::runtime_error("Test triggered disconnect"))
+          .then([&] { return client->resume(); });
+  EXPECT_NO_THROW(result.get());
+  ts->request(3);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
@@ -0,0 +1,76 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/framing/Fragmentation.h"
+
+using namespace rsocket;
+
+namespace {
+size_t length(const std::unique_ptr<folly::IOBuf>& buf) {
+  return buf ? buf->computeChainDataLength() : 0;
+}
+} // namespace
+
+TEST(Fragmentation, NeedsFragmentation) {
+  Payload payload(std::string(10, 'd'), std::string(5, 'm'));
+  EXPECT_FALSE(needsFragmentation(payload, 0));
+  EXPECT_FALSE(needsFragmentation(payload, 15));
+  EXPECT_TRUE(needsFragmentation(payload, 14));
+}
+
+TEST(Fragmentation, MetadataIsSentFirst) {
+  auto fragments = fragmentPayload(
+      Payload(std::string(25, 'd'), std::string(15, 'm')), 10);
+  ASSERT_EQ(4U, fragments.size());
+
+  EXPECT_EQ(10U, length(fragments[0].metadata));
+  EXPECT_EQ(nullptr, fragments[0].data);
+  EXPECT_EQ(5U, length(fragments[1].metadata));
+  EXPECT_EQ(5U, length(fragments[1].data));
+  EXPECT_EQ(nullptr, fragments[2].metadata);
+  EXPECT_EQ(10U, length(fragments[2].data));
+  EXPECT_EQ(nullptr, fragments[3].metadata);
+  EXPECT_EQ(10U, length(fragments[3].data));
+}
+
+TEST(Fragmentation, EmptyMetadataIsKept) {
+  auto fragments = fragmentPayload(
+      Payload(folly::IOBuf::copyBuffer(std::string(15, 'd')),
+              folly::IOBuf::create(0)),
+      10);
+  ASSERT_EQ(2U, fragments.size());
+  ASSERT_NE(nullptr, fragments[0].metadata);
+  EXPECT_EQ(0U, length(fragments[0].metadata));
+  EXPECT_EQ(nullptr, fragments[1].metadata);
+
+  PayloadReassembler reassembler;
+  for (auto& fragment : fragments) {
+    reassembler.append(std::move(fragment));
+  }
+  auto payload = reassembler.move();
+  ASSERT_NE(nullptr, payload.metadata);
+  EXPECT_EQ(0U, length(payload.metadata));
+  EXPECT_EQ(std::string(15, 'd'), payload.moveDataToString());
+}
+
+TEST(Fragmentation, Reassemble) {
+  std::string data, metadata;
+  for (int i = 0; i < 1000; ++i) {
+    data.push_back(static_cast<char>('a' + i % 26));
+    metadata.push_back(static_cast<char>('A' + i % 26));
+  }
+  auto fragments = fragmentPayload(Payload(data, metadata.substr(0, 333)), 64);
+  EXPECT_EQ((1000U + 333U + 63U) / 64U, fragments.size());
+
+  PayloadReassembler reassembler;
+  for (auto& fragment : fragments) {
+    EXPECT_LE(length(fragment.metadata) + length(fragment.data), 64U);
+    reassembler.append(std::move(fragment));
+  }
+  EXPECT_EQ(1333U, reassembler.size());
+
+  auto payload = reassembler.move();
+  EXPECT_EQ(data, payload.moveDataToString());
+  EXPECT_EQ(metadata.substr(0, 333), payload.moveMetadataToString());
+}
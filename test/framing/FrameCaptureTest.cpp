@@ -0,0 +1,74 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/framing/FrameCapture.h"
+
+using namespace ::rsocket;
+
+TEST(FrameCapture, RoundTrip) {
+  folly::test::TemporaryFile file;
+  auto const path = file.path().string();
+
+  std::string large(3 * FrameCaptureWriter::kFlushBytes, 'x');
+  {
+    FrameCaptureWriter writer(path, true);
+    writer.record(*folly::IOBuf::copyBuffer("first"));
+    auto chained = folly::IOBuf::copyBuffer("sec");
+    chained->prependChain(folly::IOBuf::copyBuffer("ond"));
+    writer.record(*chained);
+    writer.record(*folly::IOBuf::copyBuffer(large));
+    EXPECT_EQ(3, writer.records());
+  }
+
+  FrameCaptureReader reader(path);
+  EXPECT_TRUE(reader.framed());
+
+  auto first = reader.next();
+  ASSERT_TRUE(first);
+  EXPECT_EQ(std::chrono::microseconds(0), first->delay);
+  EXPECT_EQ("first", first->bytes->moveToFbString().toStdString());
+
+  auto second = reader.next();
+  ASSERT_TRUE(second);
+  EXPECT_EQ("second", second->bytes->moveToFbString().toStdString());
+
+  auto third = reader.next();
+  ASSERT_TRUE(third);
+  EXPECT_EQ(large, third->bytes->moveToFbString().toStdString());
+
+  EXPECT_FALSE(reader.next());
+}
+
+TEST(FrameCapture, SkipsTruncatedRecord) {
+  folly::test::TemporaryFile file;
+  auto const path = file.path().string();
+  {
+    FrameCaptureWriter writer(path, false);
+    writer.record(*folly::IOBuf::copyBuffer("whole"));
+    writer.record(*folly::IOBuf::copyBuffer("truncated"));
+  }
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path.c_str(), contents));
+  contents.resize(contents.size() - 3);
+  ASSERT_TRUE(folly::writeFile(contents, path.c_str()));
+
+  FrameCaptureReader reader(path);
+  EXPECT_FALSE(reader.framed());
+  auto whole = reader.next();
+  ASSERT_TRUE(whole);
+  EXPECT_EQ("whole", whole->bytes->moveToFbString().toStdString());
+  EXPECT_FALSE(reader.next());
+}
+
+TEST(FrameCapture, RejectsOtherFiles) {
+  folly::test::TemporaryFile file;
+  auto const path = file.path().string();
+  ASSERT_TRUE(folly::writeFile(std::string("not a capture"), path.c_str()));
+  EXPECT_THROW(FrameCaptureReader{path}, std::runtime_error);
+}
@@ -7,12 +7,11 @@
 
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
 
 using namespace ::testing;
 using namespace ::rsocket;
 
-// TODO(stupaq): tests with malformed frames
-
 template <typename Frame, typename... Args>
 Frame reserialize_resume(bool resumable, Args... args) {
   Frame givenFrame, newFrame;
@@ -307,3 +306,330 @@ TEST(FrameTest, Frame_RESUME_OK) {
   expectHeader(FrameType::RESUME_OK, flags, 0, frame);
   EXPECT_EQ(position, frame.position_);
 }
+
+namespace {
+std::unique_ptr<folly::IOBuf> copyBufferWithHeadroom(
+    const std::string& str) {
+  return folly::IOBuf::copyBuffer(
+      str.data(), str.size(), FrameSerializerV1_0::kPayloadHeadroom);
+}
+} // namespace
+
+TEST(FrameTest, Frame_PAYLOAD_SerializedInPlace) {
+  FrameSerializerV1_0 frameSerializer;
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::METADATA;
+  auto metadata = copyBufferWithHeadroom("i'm so meta even this acronym");
+  auto data = folly::IOBuf::copyBuffer("424242");
+  auto metadataBuffer = metadata->buffer();
+  auto dataBuffer = data->buffer();
+
+  auto serialized = frameSerializer.serializeOut(Frame_PAYLOAD(
+      streamId, flags, Payload(data->clone(), std::move(metadata))));
+
+  // header is written into the metadata headroom and data is chained as is
+  EXPECT_EQ(metadataBuffer, serialized->buffer());
+  EXPECT_EQ(dataBuffer, serialized->next()->buffer());
+  EXPECT_GE(
+      serialized->headroom(), FrameSerializerV1_0::kFrameLengthFieldLength);
+
+  Frame_PAYLOAD frame;
+  EXPECT_TRUE(frameSerializer.deserializeFrom(frame, std::move(serialized)));
+  expectHeader(FrameType::PAYLOAD, flags, streamId, frame);
+  EXPECT_EQ(
+      "i'm so meta even this acronym",
+      frame.payload_.metadata->moveToFbString());
+  EXPECT_TRUE(folly::IOBufEqual()(*data, *frame.payload_.data));
+}
+
+TEST(FrameTest, Frame_REQUEST_STREAM_SerializedInPlace) {
+  FrameSerializerV1_0 frameSerializer;
+  uint32_t streamId = 42;
+  uint32_t requestN = 3;
+  auto data = copyBufferWithHeadroom("424242");
+  auto dataBuffer = data->buffer();
+
+  auto serialized = frameSerializer.serializeOut(Frame_REQUEST_STREAM(
+      streamId, FrameFlags::EMPTY, requestN, Payload(std::move(data))));
+
+  EXPECT_EQ(dataBuffer, serialized->buffer());
+  EXPECT_FALSE(serialized->isChained());
+
+  Frame_REQUEST_STREAM frame;
+  EXPECT_TRUE(frameSerializer.deserializeFrom(frame, std::move(serialized)));
+  expectHeader(FrameType::REQUEST_STREAM, FrameFlags::EMPTY, streamId, frame);
+  EXPECT_EQ(requestN, frame.requestN_);
+  EXPECT_EQ("424242", frame.payload_.data->moveToFbString());
+}
+
+TEST(FrameTest, Frame_PAYLOAD_SharedBufferIsNotWritten) {
+  FrameSerializerV1_0 frameSerializer;
+  uint32_t streamId = 42;
+  auto data = copyBufferWithHeadroom("424242");
+
+  // a clone shares the headroom, so the serializer must not write into it
+  auto serialized = frameSerializer.serializeOut(
+      Frame_PAYLOAD(streamId, FrameFlags::COMPLETE, Payload(data->clone())));
+  EXPECT_NE(data->buffer(), serialized->buffer());
+
+  Frame_PAYLOAD frame;
+  EXPECT_TRUE(frameSerializer.deserializeFrom(frame, std::move(serialized)));
+  EXPECT_TRUE(folly::IOBufEqual()(*data, *frame.payload_.data));
+}
+
+TEST(FrameTest, PeekFrameHeader) {
+  FrameSerializerV1_0 frameSerializer;
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::NEXT;
+  auto serialized = frameSerializer.serializeOut(Frame_PAYLOAD(
+      streamId, flags, Payload(folly::IOBuf::copyBuffer("424242"))));
+
+  auto header = frameSerializer.peekFrameHeader(*serialized);
+  ASSERT_TRUE(header);
+  EXPECT_EQ(FrameType::PAYLOAD, header->type);
+  EXPECT_EQ(flags, header->flags);
+  EXPECT_EQ(streamId, header->streamId);
+
+  auto truncated = folly::IOBuf::copyBuffer(serialized->data(), 3);
+  EXPECT_FALSE(frameSerializer.peekFrameHeader(*truncated));
+}
+
+TEST(FrameTest, PeekFrameHeaderAcrossBuffers) {
+  FrameSerializerV1_0 frameSerializer;
+  uint32_t streamId = 0x7FFFFFFF;
+  auto serialized = frameSerializer.serializeOut(Frame_REQUEST_N(streamId, 5));
+  serialized->coalesce();
+
+  // the header split over two buffers decodes the same as in one
+  auto split = folly::IOBuf::copyBuffer(serialized->data(), 3);
+  split->prependChain(folly::IOBuf::copyBuffer(
+      serialized->data() + 3, serialized->length() - 3));
+  auto header = frameSerializer.peekFrameHeader(*serialized);
+  auto splitHeader = frameSerializer.peekFrameHeader(*split);
+  ASSERT_TRUE(header);
+  ASSERT_TRUE(splitHeader);
+  EXPECT_EQ(FrameType::REQUEST_N, header->type);
+  EXPECT_EQ(streamId, header->streamId);
+  EXPECT_EQ(header->type, splitHeader->type);
+  EXPECT_EQ(header->flags, splitHeader->flags);
+  EXPECT_EQ(header->streamId, splitHeader->streamId);
+
+  // negative stream ids are invalid
+  auto invalid = serialized->clone();
+  invalid->unshare();
+  invalid->writableData()[0] |= 0x80;
+  EXPECT_FALSE(frameSerializer.peekFrameHeader(*invalid));
+}
+
+TEST(FrameTest, PeekRequestMetadata) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(Frame_REQUEST_STREAM(
+      42,
+      FrameFlags::EMPTY,
+      3,
+      Payload(
+          folly::IOBuf::copyBuffer("data"),
+          folly::IOBuf::copyBuffer("meta"))));
+
+  auto metadata = frameSerializer.peekRequestMetadata(*serialized);
+  ASSERT_TRUE(metadata);
+  ASSERT_TRUE(metadata->hasMetadata());
+  EXPECT_EQ(4U, metadata->length());
+  auto cursor = metadata->cursor();
+  EXPECT_EQ("meta", cursor.readFixedString(metadata->length()));
+
+  auto noMetadata = frameSerializer.serializeOut(Frame_REQUEST_RESPONSE(
+      42, FrameFlags::EMPTY, Payload(folly::IOBuf::copyBuffer("data"))));
+  metadata = frameSerializer.peekRequestMetadata(*noMetadata);
+  ASSERT_TRUE(metadata);
+  EXPECT_FALSE(metadata->hasMetadata());
+
+  auto payload = frameSerializer.serializeOut(Frame_PAYLOAD(
+      42, FrameFlags::NEXT, Payload(folly::IOBuf::copyBuffer("data"))));
+  EXPECT_FALSE(frameSerializer.peekRequestMetadata(*payload));
+}
+
+TEST(FrameTest, PeekRequestPayload) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(Frame_REQUEST_STREAM(
+      42,
+      FrameFlags::EMPTY,
+      3,
+      Payload(
+          folly::IOBuf::copyBuffer("data"),
+          folly::IOBuf::copyBuffer("meta"))));
+
+  FrameHeader header;
+  uint32_t requestN;
+  auto layout =
+      frameSerializer.peekRequestPayload(*serialized, header, requestN);
+  ASSERT_TRUE(layout);
+  EXPECT_EQ(FrameType::REQUEST_STREAM, header.type);
+  EXPECT_EQ(42U, header.streamId);
+  EXPECT_EQ(3U, requestN);
+
+  LazyPayload lazy(std::move(serialized), *layout);
+  ASSERT_TRUE(lazy.hasMetadata());
+  EXPECT_EQ(4U, lazy.metadataView().length());
+  EXPECT_EQ(4U, lazy.dataLength());
+  auto payload = std::move(lazy).materialize();
+  EXPECT_EQ("data", payload.moveDataToString());
+  EXPECT_EQ("meta", payload.moveMetadataToString());
+
+  auto noPayload = frameSerializer.serializeOut(
+      Frame_REQUEST_RESPONSE(42, FrameFlags::EMPTY, Payload()));
+  layout = frameSerializer.peekRequestPayload(*noPayload, header, requestN);
+  ASSERT_TRUE(layout);
+  EXPECT_EQ(0U, requestN);
+  LazyPayload empty(std::move(noPayload), *layout);
+  EXPECT_FALSE(empty.hasMetadata());
+  EXPECT_FALSE(empty.cloneMetadata());
+  EXPECT_FALSE(empty.cloneData());
+
+  auto other = frameSerializer.serializeOut(Frame_PAYLOAD(
+      42, FrameFlags::NEXT, Payload(folly::IOBuf::copyBuffer("data"))));
+  EXPECT_FALSE(frameSerializer.peekRequestPayload(*other, header, requestN));
+}
+
+TEST(FrameTest, WithStreamId) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(Frame_PAYLOAD(
+      42, FrameFlags::NEXT, Payload(folly::IOBuf::copyBuffer("data"))));
+  serialized->coalesce();
+  auto const* data = serialized->data();
+
+  // Rewritten in place.
+  auto rewritten = frameSerializer.withStreamId(std::move(serialized), 7);
+  EXPECT_EQ(data, rewritten->data());
+  EXPECT_EQ(7U, frameSerializer.peekStreamId(*rewritten));
+
+  // Shared with a clone, the rest of the frame is chained behind a new
+  // header.
+  auto clone = rewritten->clone();
+  auto chained = frameSerializer.withStreamId(std::move(clone), 9);
+  EXPECT_TRUE(chained->isChained());
+  EXPECT_EQ(9U, frameSerializer.peekStreamId(*chained));
+  EXPECT_EQ(7U, frameSerializer.peekStreamId(*rewritten));
+
+  Frame_PAYLOAD frame;
+  ASSERT_TRUE(frameSerializer.deserializeFrom(frame, std::move(chained)));
+  EXPECT_EQ(9U, frame.header_.streamId);
+  EXPECT_EQ("data", frame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, CloneWithStreamId) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(Frame_PAYLOAD(
+      42,
+      FrameFlags::NEXT,
+      Payload(
+          folly::IOBuf::copyBuffer("data"),
+          folly::IOBuf::copyBuffer("meta"))));
+  serialized->coalesce();
+
+  // The clone shares the rest of the frame.
+  auto clone = frameSerializer.cloneWithStreamId(*serialized, 7);
+  ASSERT_TRUE(clone->isChained());
+  EXPECT_EQ(
+      serialized->data() + FrameSerializerV1_0::kFrameHeaderSize,
+      clone->next()->data());
+  EXPECT_EQ(42U, frameSerializer.peekStreamId(*serialized));
+
+  Frame_PAYLOAD frame;
+  ASSERT_TRUE(frameSerializer.deserializeFrom(frame, std::move(clone)));
+  EXPECT_EQ(7U, frame.header_.streamId);
+  EXPECT_EQ(FrameFlags::NEXT | FrameFlags::METADATA, frame.header_.flags);
+  EXPECT_EQ("meta", frame.payload_.moveMetadataToString());
+  EXPECT_EQ("data", frame.payload_.moveDataToString());
+
+  // The flags can be replaced too.
+  auto completed = frameSerializer.cloneWithStreamId(
+      *serialized,
+      9,
+      FrameFlags::NEXT | FrameFlags::COMPLETE | FrameFlags::METADATA);
+  Frame_PAYLOAD last;
+  ASSERT_TRUE(frameSerializer.deserializeFrom(last, std::move(completed)));
+  EXPECT_EQ(9U, last.header_.streamId);
+  EXPECT_EQ(
+      FrameFlags::NEXT | FrameFlags::COMPLETE | FrameFlags::METADATA,
+      last.header_.flags);
+  EXPECT_EQ("data", last.payload_.moveDataToString());
+
+  // Frames without a body are a header alone.
+  auto cancel = frameSerializer.serializeOut(Frame_CANCEL(42));
+  auto cancelClone = frameSerializer.cloneWithStreamId(*cancel, 3);
+  EXPECT_FALSE(cancelClone->isChained());
+  EXPECT_EQ(3U, frameSerializer.peekStreamId(*cancelClone));
+  EXPECT_EQ(FrameType::CANCEL, frameSerializer.peekFrameType(*cancelClone));
+}
+
+TEST(FrameTest, TruncatedFrames) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(Frame_REQUEST_STREAM(
+      42,
+      FrameFlags::EMPTY,
+      3,
+      Payload(
+          folly::IOBuf::copyBuffer("data"),
+          folly::IOBuf::copyBuffer("meta"))));
+  serialized->coalesce();
+
+  // Cut anywhere before the end of the metadata, the frame is rejected.
+  auto const metadataEnd = serialized->length() - 4;
+  for (size_t length = 0; length < metadataEnd; ++length) {
+    Frame_REQUEST_STREAM frame;
+    EXPECT_FALSE(frameSerializer.deserializeFrom(
+        frame, folly::IOBuf::copyBuffer(serialized->data(), length)))
+        << length;
+  }
+  Frame_REQUEST_STREAM frame;
+  EXPECT_TRUE(frameSerializer.deserializeFrom(
+      frame, folly::IOBuf::copyBuffer(serialized->data(), metadataEnd)));
+  EXPECT_FALSE(frame.payload_.data);
+
+  auto setup = frameSerializer.serializeOut(Frame_SETUP(
+      FrameFlags::EMPTY,
+      1,
+      0,
+      10,
+      20,
+      ResumeIdentificationToken::generateNew(),
+      "md_mime",
+      "d_mime",
+      Payload()));
+  setup->coalesce();
+  for (size_t length = 0; length < setup->length(); ++length) {
+    Frame_SETUP setupFrame;
+    EXPECT_FALSE(frameSerializer.deserializeFrom(
+        setupFrame, folly::IOBuf::copyBuffer(setup->data(), length)))
+        << length;
+  }
+}
+
+TEST(FrameTest, InvalidFields) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized =
+      frameSerializer.serializeOut(Frame_REQUEST_N(42, 3))->cloneCoalesced();
+  serialized->unshare();
+  // A negative requestN.
+  serialized->writableData()[6] |= 0x80;
+  Frame_REQUEST_N frame;
+  EXPECT_FALSE(frameSerializer.deserializeFrom(frame, std::move(serialized)));
+}
+
+TEST(FrameTest, CopyWithStreamId) {
+  FrameSerializerV1_0 frameSerializer;
+  auto serialized = frameSerializer.serializeOut(
+      Frame_ERROR::rejected(42, "Server overloaded"));
+
+  auto copy = frameSerializer.copyWithStreamId(*serialized, 7);
+  Frame_ERROR frame;
+  ASSERT_TRUE(frameSerializer.deserializeFrom(frame, std::move(copy)));
+  expectHeader(FrameType::ERROR, FrameFlags::EMPTY, 7, frame);
+  EXPECT_EQ(ErrorCode::REJECTED, frame.errorCode_);
+  EXPECT_EQ("Server overloaded", frame.payload_.moveDataToString());
+
+  // The frame copied from is left as it is.
+  ASSERT_TRUE(frameSerializer.deserializeFrom(frame, std::move(serialized)));
+  EXPECT_EQ(42u, frame.header_.streamId);
+}
@@ -95,3 +95,39 @@ TEST(FrameTransport, InputSendsError) {
   transport->setFrameProcessor(std::move(processor));
   transport->close();
 }
+
+TEST(FrameTransport, InputFramesInOneBatch) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>(
+      [](auto input) {
+        auto subscription =
+            yarpl::make_ref<StrictMock<yarpl::mocks::MockSubscription>>();
+        EXPECT_CALL(*subscription, request_(_));
+        EXPECT_CALL(*subscription, cancel_());
+        input->onSubscribe(std::move(subscription));
+
+        auto duplexInput =
+            dynamic_cast<DuplexConnection::DuplexSubscriber*>(input.get());
+        ASSERT_NE(nullptr, duplexInput);
+        std::vector<std::unique_ptr<folly::IOBuf>> frames;
+        frames.push_back(folly::IOBuf::copyBuffer("Hello"));
+        frames.push_back(folly::IOBuf::copyBuffer("World"));
+        duplexInput->onNextMultiple(std::move(frames));
+      },
+      [](auto output) {
+        EXPECT_CALL(*output, onSubscribe_(_));
+        EXPECT_CALL(*output, onComplete_());
+      });
+
+  auto transport = yarpl::make_ref<FrameTransportImpl>(std::move(connection));
+
+  auto processor = std::make_shared<StrictMock<MockFrameProcessor>>();
+  EXPECT_CALL(*processor, processFrames_(_))
+      .WillOnce(Invoke([](std::vector<std::unique_ptr<folly::IOBuf>>& frames) {
+        ASSERT_EQ(2U, frames.size());
+        EXPECT_THAT(frames[0], IOBufStringEq("Hello"));
+        EXPECT_THAT(frames[1], IOBufStringEq("World"));
+      }));
+
+  transport->setFrameProcessor(std::move(processor));
+  transport->close();
+}
@@ -99,3 +99,185 @@ TEST(FramedReader, SubscriberErrorAfterError) {
   reader->error("Oops");
   reader->onError(std::runtime_error{"Not oops"});
 }
+
+TEST(FramedReader, BytesExpected) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = yarpl::make_ref<FramedReader>(version);
+  reader->onSubscribe(yarpl::flowable::Subscription::empty());
+  EXPECT_EQ(0U, reader->bytesExpected());
+
+  // A partial frame length field.
+  auto buf = folly::IOBuf::createCombined(2);
+  buf->append(2);
+  buf->writableData()[0] = '\x00';
+  buf->writableData()[1] = '\x01';
+  reader->onNext(std::move(buf));
+  EXPECT_EQ(0U, reader->bytesExpected());
+
+  // The rest of the length field (256 bytes) and some of the frame.
+  buf = folly::IOBuf::createCombined(11);
+  buf->append(11);
+  memset(buf->writableData(), 0, 11);
+  reader->onNext(std::move(buf));
+  EXPECT_EQ(256U + 3 - 13, reader->bytesExpected());
+
+  reader->onComplete();
+  EXPECT_EQ(0U, reader->bytesExpected());
+}
+
+TEST(FramedReader, BatchOfTinyFrames) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = yarpl::make_ref<FramedReader>(version);
+  reader->onSubscribe(yarpl::flowable::Subscription::empty());
+
+  // Three frames of 6 bytes and the start of a fourth one, in one buffer.
+  auto buf = folly::IOBuf::createCombined(3 * 9 + 2);
+  buf->append(3 * 9 + 2);
+  memset(buf->writableData(), 0, buf->length());
+  for (uint8_t i = 0; i < 3; ++i) {
+    buf->writableData()[i * 9 + 2] = 6; // frame length
+    buf->writableData()[i * 9 + 6] = i + 1; // stream id
+  }
+  reader->onNext(std::move(buf));
+
+  std::vector<std::string> frames;
+  auto subscriber = yarpl::make_ref<
+      StrictMock<MockSubscriber<std::unique_ptr<folly::IOBuf>>>>(2);
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& frame) {
+        frames.push_back(frame->cloneAsValue().moveToFbString().toStdString());
+      }));
+
+  // Only as many frames as requested are delivered.
+  reader->setInput(subscriber);
+  ASSERT_EQ(2U, frames.size());
+  reader->request(10);
+  ASSERT_EQ(3U, frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    EXPECT_EQ(6U, frames[i].size());
+    EXPECT_EQ(static_cast<char>(i + 1), frames[i][3]);
+  }
+
+  EXPECT_CALL(*subscriber, onComplete_());
+  reader->onComplete();
+}
+
+TEST(FramedReader, FrameLongerThanMaximum) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = yarpl::make_ref<FramedReader>(version, 256);
+
+  auto subscription = yarpl::make_ref<StrictMock<MockSubscription>>();
+  EXPECT_CALL(*subscription, request_(_));
+  EXPECT_CALL(*subscription, cancel_());
+  reader->onSubscribe(subscription);
+
+  auto subscriber = yarpl::make_ref<
+      StrictMock<MockSubscriber<std::unique_ptr<folly::IOBuf>>>>();
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onError_(_))
+      .WillOnce(Invoke([](folly::exception_wrapper ew) {
+        EXPECT_EQ(
+            std::string{
+                "Invalid frame - Frame size 257 larger than maximum 256"},
+            ew.get_exception()->what());
+      }));
+  reader->setInput(subscriber);
+
+  // Only the length field (257 bytes) and the frame header arrived, the frame
+  // is rejected without waiting for the rest.
+  auto buf = folly::IOBuf::createCombined(9);
+  buf->append(9);
+  memset(buf->writableData(), 0, 9);
+  buf->writableData()[1] = '\x01';
+  buf->writableData()[2] = '\x01';
+  reader->onNext(std::move(buf));
+  EXPECT_EQ(0U, reader->bytesExpected());
+  reader->onComplete();
+}
+
+namespace {
+class BatchRecorder : public DuplexConnection::DuplexSubscriber {
+ public:
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    batches.push_back(1);
+    frames.push_back(std::move(frame));
+  }
+
+  void onNextMultiple(
+      std::vector<std::unique_ptr<folly::IOBuf>> multiple) override {
+    batches.push_back(multiple.size());
+    for (auto& frame : multiple) {
+      frames.push_back(std::move(frame));
+    }
+  }
+
+  std::vector<size_t> batches;
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+};
+} // namespace
+
+TEST(FramedReader, FramesOfAReadDeliveredAtOnce) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = yarpl::make_ref<FramedReader>(version);
+  reader->onSubscribe(yarpl::flowable::Subscription::empty());
+  auto subscriber = yarpl::make_ref<BatchRecorder>();
+  reader->setInput(subscriber);
+
+  // Two frames of 6 bytes, the second one straddling two buffers, which the
+  // one pass over the head buffer doesn't split.
+  auto frames = [](size_t count) {
+    auto buf = folly::IOBuf::createCombined(count * 9);
+    buf->append(count * 9);
+    memset(buf->writableData(), 0, buf->length());
+    for (size_t i = 0; i < count; ++i) {
+      buf->writableData()[i * 9 + 2] = 6; // frame length
+    }
+    return buf;
+  };
+  auto head = frames(2);
+  auto tail = folly::IOBuf::copyBuffer(head->data() + 13, 5);
+  head->trimEnd(5);
+  head->prependChain(std::move(tail));
+  reader->onNext(std::move(head));
+  ASSERT_EQ(std::vector<size_t>{2}, subscriber->batches);
+
+  // A read of a single frame is delivered as it is.
+  reader->onNext(frames(1));
+  EXPECT_EQ((std::vector<size_t>{2, 1}), subscriber->batches);
+  EXPECT_EQ(3U, subscriber->frames.size());
+  reader->onComplete();
+}
+
+TEST(FramedReader, WholeFramesSlicedOutOfTheRead) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = yarpl::make_ref<FramedReader>(version);
+  reader->onSubscribe(yarpl::flowable::Subscription::empty());
+  auto subscriber = yarpl::make_ref<BatchRecorder>();
+  reader->setInput(subscriber);
+
+  // Two frames of 6 bytes and the start of a third one.
+  auto buf = folly::IOBuf::createCombined(3 * 9);
+  buf->append(3 * 9);
+  memset(buf->writableData(), 0, buf->length());
+  for (size_t i = 0; i < 3; ++i) {
+    buf->writableData()[i * 9 + 2] = 6; // frame length
+  }
+  auto tail = folly::IOBuf::copyBuffer(buf->data() + 22, 5);
+  buf->trimEnd(5);
+  auto const* data = buf->data();
+  reader->onNext(std::move(buf));
+
+  // The frames point into the read, only the partial frame is buffered.
+  ASSERT_EQ(std::vector<size_t>{2}, subscriber->batches);
+  EXPECT_EQ(data + 3, subscriber->frames[0]->data());
+  EXPECT_EQ(data + 12, subscriber->frames[1]->data());
+  EXPECT_EQ(4U, reader->bufferedBytes());
+
+  reader->onNext(std::move(tail));
+  EXPECT_EQ((std::vector<size_t>{2, 1}), subscriber->batches);
+  EXPECT_EQ(6U, subscriber->frames[2]->computeChainDataLength());
+  EXPECT_EQ(0U, reader->bufferedBytes());
+  reader->onComplete();
+}
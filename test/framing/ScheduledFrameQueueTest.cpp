@@ -0,0 +1,97 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Baton.h>
+#include <folly/Conv.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rsocket/framing/ScheduledFrameQueue.h"
+
+using namespace rsocket;
+
+namespace {
+/// Records what the queue delivers, only touched on the EventBase.
+struct Deliveries {
+  std::vector<std::string> log;
+  std::vector<size_t> bursts;
+};
+
+std::shared_ptr<ScheduledFrameQueue> makeQueue(
+    folly::EventBase& evb,
+    Deliveries& deliveries) {
+  return std::make_shared<ScheduledFrameQueue>(
+      evb, [&deliveries](ScheduledFrameQueue::Frames frames) {
+        deliveries.bursts.push_back(frames.size());
+        for (auto& frame : frames) {
+          deliveries.log.push_back(frame->moveToFbString().toStdString());
+        }
+      });
+}
+} // namespace
+
+TEST(ScheduledFrameQueue, DeliversBurstsInOrder) {
+  folly::ScopedEventBaseThread worker;
+  auto& evb = *worker.getEventBase();
+  Deliveries deliveries;
+  auto queue = makeQueue(evb, deliveries);
+
+  // Hold the EventBase so that everything is queued before the drain.
+  folly::Baton<> release;
+  evb.runInEventBaseThread([&release] { release.wait(); });
+
+  queue->push(folly::IOBuf::copyBuffer("a"));
+  queue->push(folly::IOBuf::copyBuffer("b"));
+  queue->run([&deliveries] { deliveries.log.push_back("task"); });
+  ScheduledFrameQueue::Frames frames;
+  frames.push_back(folly::IOBuf::copyBuffer("c"));
+  frames.push_back(folly::IOBuf::copyBuffer("d"));
+  queue->push(std::move(frames));
+  release.post();
+
+  evb.runInEventBaseThreadAndWait([] {});
+  EXPECT_EQ(
+      (std::vector<std::string>{"a", "b", "task", "c", "d"}), deliveries.log);
+  EXPECT_EQ((std::vector<size_t>{2, 2}), deliveries.bursts);
+
+  // The next push schedules another drain.
+  queue->push(folly::IOBuf::copyBuffer("e"));
+  evb.runInEventBaseThreadAndWait([] {});
+  EXPECT_EQ("e", deliveries.log.back());
+  EXPECT_EQ(1u, deliveries.bursts.back());
+}
+
+TEST(ScheduledFrameQueue, KeepsOrderOfConcurrentProducers) {
+  folly::ScopedEventBaseThread worker;
+  auto& evb = *worker.getEventBase();
+  Deliveries deliveries;
+  auto queue = makeQueue(evb, deliveries);
+
+  constexpr size_t kProducers = 4;
+  constexpr size_t kFrames = 10000;
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&queue, p] {
+      for (size_t i = 0; i < kFrames; ++i) {
+        queue->push(
+            folly::IOBuf::copyBuffer(folly::to<std::string>(p, ":", i)));
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  evb.runInEventBaseThreadAndWait([] {});
+
+  ASSERT_EQ(kProducers * kFrames, deliveries.log.size());
+  std::vector<size_t> next(kProducers, 0);
+  for (auto const& frame : deliveries.log) {
+    auto const colon = frame.find(':');
+    auto const p = folly::to<size_t>(frame.substr(0, colon));
+    EXPECT_EQ(next[p]++, folly::to<size_t>(frame.substr(colon + 1)));
+  }
+  EXPECT_LT(deliveries.bursts.size(), deliveries.log.size());
+}
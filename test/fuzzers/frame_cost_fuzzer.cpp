@@ -0,0 +1,200 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+// Feeds an input through FramedReader and RSocketStateMachine like
+// frame_fuzzer, and aborts when it costs more time or heap than a budget
+// proportional to its size, so that a fuzzer keeps the inputs which are slow
+// to handle (e.g. pathological fragmentation, huge declared frame lengths)
+// as crashes.
+//
+// The input is fed as a single read, then again on a new connection as reads
+// of --read_size bytes, to catch the costs of many tiny reads.  Allocations
+// are only counted when built without the sanitizers, see
+// benchmarks/Allocations.h.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include "benchmarks/Allocations.h"
+#include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketServer.h"
+
+DEFINE_int32(
+    read_size,
+    1,
+    "bytes per read of the second pass, 0 to only feed the input at once");
+DEFINE_int64(budget_us, 200000, "microseconds any input may take");
+DEFINE_int64(
+    budget_ns_per_byte,
+    20000,
+    "nanoseconds each byte of the input may add to --budget_us");
+DEFINE_int64(
+    budget_alloc_bytes,
+    4 * 1024 * 1024,
+    "heap bytes any input may allocate");
+DEFINE_int64(
+    budget_alloc_bytes_per_byte,
+    256,
+    "heap bytes each byte of the input may add to --budget_alloc_bytes");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct FuzzerConnectionAcceptor : rsocket::ConnectionAcceptor {
+  void start(rsocket::OnDuplexConnectionAccept func_) override {
+    func = func_;
+  }
+
+  void stop() override {}
+
+  folly::Optional<uint16_t> listeningPort() const override {
+    return 0;
+  }
+
+  rsocket::OnDuplexConnectionAccept func;
+};
+
+struct SinkSubscriber : rsocket::DuplexConnection::DuplexSubscriber {
+  size_t sentBytes{0};
+
+  void onNext(std::unique_ptr<folly::IOBuf> buf) override {
+    sentBytes += buf->computeChainDataLength();
+  }
+};
+
+struct FuzzerDuplexConnection : rsocket::DuplexConnection {
+  FuzzerDuplexConnection(
+      yarpl::Reference<Subscriber>& input,
+      yarpl::Reference<SinkSubscriber> output)
+      : input_(input), output_(std::move(output)) {}
+
+  void setInput(yarpl::Reference<Subscriber> sub) override {
+    input_ = std::move(sub);
+  }
+
+  yarpl::Reference<Subscriber> getOutput() override {
+    return output_;
+  }
+
+  yarpl::Reference<Subscriber>& input_;
+  const yarpl::Reference<SinkSubscriber> output_;
+};
+
+struct NoopSubscription : yarpl::flowable::Subscription {
+  void request(int64_t) override {}
+  void cancel() override {}
+};
+
+struct NoopResponder : rsocket::RSocketResponder {};
+
+struct Cost {
+  std::chrono::microseconds time{0};
+  rsocket::AllocationCount allocations;
+  size_t sentBytes{0};
+};
+
+/// Runs the queued work of the connection, without blocking.
+void drain(folly::EventBase& evb) {
+  evb.loopOnce(EVLOOP_NONBLOCK);
+}
+
+/// Feeds `input` to a new server connection, `readSize` bytes at a time
+/// (all of it at once for 0).
+Cost feed(const std::string& input, size_t readSize) {
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+
+  yarpl::Reference<rsocket::DuplexConnection::Subscriber> inputSub;
+  auto sink = yarpl::make_ref<SinkSubscriber>();
+  auto acceptor = std::make_unique<FuzzerConnectionAcceptor>();
+  auto& acceptorFunc = acceptor->func;
+
+  Cost cost;
+  {
+    rsocket::RSocketServer server(std::move(acceptor));
+    auto responder = std::make_shared<NoopResponder>();
+    server.start(
+        [responder](const rsocket::SetupParameters&) { return responder; });
+    CHECK(acceptorFunc);
+    acceptorFunc(std::make_unique<FuzzerDuplexConnection>(inputSub, sink), evb);
+    drain(evb);
+    CHECK(inputSub);
+    inputSub->onSubscribe(yarpl::make_ref<NoopSubscription>());
+
+    auto const chunk = readSize ? readSize : std::max<size_t>(input.size(), 1);
+    rsocket::AllocationMeter meter;
+    auto const start = Clock::now();
+    for (size_t offset = 0; offset < input.size() && inputSub;
+         offset += chunk) {
+      auto const length = std::min(chunk, input.size() - offset);
+      inputSub->onNext(folly::IOBuf::copyBuffer(input.data() + offset, length));
+      drain(evb);
+    }
+    cost.time = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start);
+    cost.allocations = meter.sinceStart();
+    cost.sentBytes = sink->sentBytes;
+
+    if (auto sub = std::move(inputSub)) {
+      sub->onComplete();
+    }
+    drain(evb);
+  }
+  folly::EventBaseManager::get()->clearEventBase();
+  return cost;
+}
+
+void check(const std::string& input, size_t readSize) {
+  auto const cost = feed(input, readSize);
+  auto const timeBudget = std::chrono::microseconds(
+      FLAGS_budget_us + FLAGS_budget_ns_per_byte * input.size() / 1000);
+  auto const allocBudget = static_cast<uint64_t>(
+      FLAGS_budget_alloc_bytes +
+      FLAGS_budget_alloc_bytes_per_byte * input.size());
+
+  LOG(INFO) << input.size() << " bytes in reads of "
+            << (readSize ? readSize : input.size()) << ": "
+            << cost.time.count() << "us, " << cost.allocations.allocations
+            << " allocations of " << cost.allocations.bytes << " bytes, "
+            << cost.sentBytes << " bytes written";
+
+  if (cost.time > timeBudget) {
+    LOG(FATAL) << "Took " << cost.time.count() << "us, over the budget of "
+               << timeBudget.count() << "us";
+  }
+  if (rsocket::countingAllocations() && cost.allocations.bytes > allocBudget) {
+    LOG(FATAL) << "Allocated " << cost.allocations.bytes
+               << " bytes, over the budget of " << allocBudget << " bytes";
+  }
+}
+
+std::string get_stdin() {
+  std::cin >> std::noskipws;
+  std::istream_iterator<char> it(std::cin);
+  std::istream_iterator<char> end;
+  return std::string(it, end);
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  FLAGS_logtostderr = 1;
+
+  auto const input = get_stdin();
+  VLOG(1) << "fuzz input: " << folly::humanify(input);
+
+  check(input, 0);
+  if (FLAGS_read_size > 0) {
+    check(input, FLAGS_read_size);
+  }
+  return 0;
+}
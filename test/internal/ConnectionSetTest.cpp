@@ -39,7 +39,7 @@ TEST(ConnectionSet, CloseViaMachine) {
 
   auto set = std::make_shared<ConnectionSet>();
   set->insert(machine, &evb);
-  machine->registerSet(set);
+  machine->registerSet(set, &evb);
 
   machine->close({}, StreamCompletionSignal::CANCEL);
 }
@@ -50,5 +50,26 @@ TEST(ConnectionSet, CloseViaSetDtor) {
 
   auto set = std::make_shared<ConnectionSet>();
   set->insert(machine, &evb);
-  machine->registerSet(set);
+  machine->registerSet(set, &evb);
+}
+
+TEST(ConnectionSet, CloseAcrossEventBases) {
+  folly::EventBase evb1, evb2;
+  auto machine1 = makeStateMachine(&evb1);
+  auto machine2 = makeStateMachine(&evb2);
+  auto machine3 = makeStateMachine(&evb2);
+
+  auto set = std::make_shared<ConnectionSet>();
+  set->insert(machine1, &evb1);
+  machine1->registerSet(set, &evb1);
+  set->insert(machine2, &evb2);
+  machine2->registerSet(set, &evb2);
+  set->insert(machine3, &evb2);
+  machine3->registerSet(set, &evb2);
+
+  machine2->close({}, StreamCompletionSignal::CANCEL);
+  // only the closed machine left the set
+  EXPECT_EQ(1, machine2.use_count());
+  EXPECT_EQ(2, machine1.use_count());
+  EXPECT_EQ(2, machine3.use_count());
 }
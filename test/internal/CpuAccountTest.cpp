@@ -0,0 +1,47 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/CpuAccount.h"
+
+using namespace rsocket;
+
+namespace {
+void spin(uint64_t cycles) {
+  auto const start = readCycleCounter();
+  while (readCycleCounter() - start < cycles) {
+  }
+}
+} // namespace
+
+TEST(CpuAccountTest, CountsOuterScopes) {
+  CpuAccount account(true);
+  {
+    CpuAccount::Scope scope(account);
+    spin(1000);
+  }
+  auto const once = account.cycles();
+  EXPECT_GE(once, 1000U);
+
+  {
+    CpuAccount::Scope outer(account);
+    {
+      // Counted as part of the outer scope, not on top of it.
+      CpuAccount::Scope inner(account);
+      spin(1000);
+      EXPECT_EQ(once, account.cycles());
+    }
+    EXPECT_EQ(once, account.cycles());
+  }
+  EXPECT_GE(account.cycles(), once + 1000);
+}
+
+TEST(CpuAccountTest, DisabledCountsNothing) {
+  CpuAccount account(false);
+  {
+    CpuAccount::Scope scope(account);
+    spin(1000);
+  }
+  EXPECT_FALSE(account.enabled());
+  EXPECT_EQ(0U, account.cycles());
+}
@@ -0,0 +1,64 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <thread>
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/EventBaseLoadMonitor.h"
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+namespace {
+class OverloadStats : public RSocketStats {
+ public:
+  void eventBaseOverloaded(
+      bool overloaded,
+      std::chrono::microseconds loopLatency,
+      size_t) override {
+    if (overloaded) {
+      EXPECT_GT(loopLatency, 20ms);
+    }
+    changes.push_back(overloaded);
+  }
+
+  std::vector<bool> changes;
+};
+}
+
+TEST(EventBaseLoadMonitorTest, ShedsWhileTheLoopIsLate) {
+  folly::EventBase evb;
+  auto stats = std::make_shared<OverloadStats>();
+  LoadSheddingOptions options;
+  options.maxLoopLatency = 20ms;
+  options.probeInterval = 1ms;
+  EventBaseLoadMonitor monitor(evb, options, stats);
+  auto load = monitor.load();
+
+  // The probe after the blocking callback is late, the next ones aren't.
+  evb.runAfterDelay([] { std::this_thread::sleep_for(50ms); }, 5);
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 100);
+  evb.loop();
+
+  EXPECT_FALSE(load->overloaded);
+  EXPECT_EQ(std::vector<bool>({true, false}), stats->changes);
+}
+
+TEST(EventBaseLoadMonitorTest, IdleLoopIsNotOverloaded) {
+  folly::EventBase evb;
+  auto stats = std::make_shared<OverloadStats>();
+  LoadSheddingOptions options;
+  options.maxLoopLatency = 200ms;
+  options.maxQueuedTasks = 1000;
+  options.probeInterval = 1ms;
+  EventBaseLoadMonitor monitor(evb, options, stats);
+
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 20);
+  evb.loop();
+
+  EXPECT_FALSE(monitor.load()->overloaded);
+  EXPECT_TRUE(stats->changes.empty());
+}
@@ -0,0 +1,80 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/FlightRecorder.h"
+
+using namespace rsocket;
+
+TEST(FlightRecorder, RecordsTheFramesOfTheThread) {
+  int connection;
+  int other;
+  FlightRecorder::recordRead(
+      &connection, 1, FrameType::REQUEST_STREAM, FrameFlags::EMPTY, 20);
+  FlightRecorder::recordWritten(
+      &other, 1, FrameType::PAYLOAD, FrameFlags::NEXT, 30);
+  FlightRecorder::recordWritten(
+      &connection, 1, FrameType::PAYLOAD, FrameFlags::COMPLETE, 40);
+
+  auto events = FlightRecorder::dumpThread(&connection);
+  ASSERT_EQ(2U, events.size());
+  EXPECT_FALSE(events[0].written);
+  EXPECT_EQ(FrameType::REQUEST_STREAM, events[0].type);
+  EXPECT_EQ(20U, events[0].length);
+  EXPECT_TRUE(events[1].written);
+  EXPECT_EQ(FrameType::PAYLOAD, events[1].type);
+  EXPECT_EQ(FrameFlags::COMPLETE, events[1].flags);
+  EXPECT_EQ(1U, events[1].streamId);
+  EXPECT_LE(events[0].timestamp, events[1].timestamp);
+}
+
+TEST(FlightRecorder, KeepsTheLastEvents) {
+  int connection;
+  auto const count = FlightRecorder::kEventsPerThread + 10;
+  for (size_t i = 0; i < count; ++i) {
+    FlightRecorder::recordRead(
+        &connection, i, FrameType::REQUEST_N, FrameFlags::EMPTY, 10);
+  }
+  auto events = FlightRecorder::dumpThread(&connection);
+  ASSERT_EQ(FlightRecorder::kEventsPerThread, events.size());
+  EXPECT_EQ(10U, events.front().streamId);
+  EXPECT_EQ(count - 1, events.back().streamId);
+}
+
+TEST(FlightRecorder, DumpsAllTheThreads) {
+  int connection;
+  std::thread([&] {
+    FlightRecorder::recordWritten(
+        &connection, 3, FrameType::CANCEL, FrameFlags::EMPTY, 6);
+  }).join();
+  // The thread exited, the threads still running are dumped.
+  for (auto& event : FlightRecorder::dump()) {
+    EXPECT_NE(&connection, event.connection);
+  }
+
+  std::atomic<bool> recorded{false};
+  std::atomic<bool> dumped{false};
+  std::thread thread([&] {
+    FlightRecorder::recordWritten(
+        &connection, 3, FrameType::CANCEL, FrameFlags::EMPTY, 6);
+    recorded = true;
+    while (!dumped) {
+      std::this_thread::yield();
+    }
+  });
+  while (!recorded) {
+    std::this_thread::yield();
+  }
+  size_t found = 0;
+  for (auto& event : FlightRecorder::dump()) {
+    if (event.connection == &connection) {
+      ++found;
+      EXPECT_EQ(FrameType::CANCEL, event.type);
+    }
+  }
+  dumped = true;
+  thread.join();
+  EXPECT_EQ(1U, found);
+}
@@ -0,0 +1,47 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/FrameSpillFile.h"
+
+using namespace ::rsocket;
+
+namespace {
+std::string pop(FrameSpillFile& file) {
+  auto frame = file.pop();
+  return frame ? frame->moveToFbString().toStdString() : "<none>";
+}
+} // namespace
+
+TEST(FrameSpillFileTest, FramesComeOutInOrder) {
+  FrameSpillFile file;
+  EXPECT_TRUE(file.empty());
+  EXPECT_EQ(nullptr, file.pop());
+
+  EXPECT_TRUE(file.push(*folly::IOBuf::copyBuffer("first")));
+  auto chained = folly::IOBuf::copyBuffer("sec");
+  chained->prependChain(folly::IOBuf::copyBuffer("ond"));
+  EXPECT_TRUE(file.push(*chained));
+  EXPECT_TRUE(file.push(*folly::IOBuf::create(0)));
+  EXPECT_EQ(3U, file.size());
+
+  EXPECT_EQ("first", pop(file));
+  EXPECT_EQ("second", pop(file));
+  EXPECT_EQ("", pop(file));
+  EXPECT_TRUE(file.empty());
+  EXPECT_EQ("<none>", pop(file));
+}
+
+TEST(FrameSpillFileTest, ReusedOnceEmpty) {
+  FrameSpillFile file;
+  EXPECT_TRUE(file.push(*folly::IOBuf::copyBuffer("a")));
+  EXPECT_EQ("a", pop(file));
+
+  EXPECT_TRUE(file.push(*folly::IOBuf::copyBuffer("b")));
+  EXPECT_TRUE(file.push(*folly::IOBuf::copyBuffer("c")));
+  EXPECT_EQ("b", pop(file));
+  EXPECT_TRUE(file.push(*folly::IOBuf::copyBuffer("d")));
+  EXPECT_EQ("c", pop(file));
+  EXPECT_EQ("d", pop(file));
+  EXPECT_TRUE(file.empty());
+}
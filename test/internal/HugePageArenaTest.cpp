@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <cstring>
+#include <memory>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/HugePageArena.h"
+
+using namespace rsocket;
+
+TEST(HugePageArenaTest, BlocksAreCarvedFromRegions) {
+  HugePageArena arena(1000);
+  EXPECT_EQ(1024U, arena.blockSize());
+
+  auto first = arena.allocate();
+  if (!first) {
+    // Nothing can be mapped here, callers use the heap.
+    EXPECT_EQ(0U, arena.regions());
+    return;
+  }
+  EXPECT_EQ(1U, arena.regions());
+  EXPECT_LE(arena.hugetlbRegions(), 1U);
+  EXPECT_TRUE(arena.owns(first));
+
+  std::set<void*> blocks{first};
+  auto const perRegion = HugePageArena::kRegionSize / arena.blockSize();
+  for (size_t i = 1; i < perRegion; ++i) {
+    auto block = arena.allocate();
+    ASSERT_NE(nullptr, block);
+    std::memset(block, 0xab, arena.blockSize());
+    EXPECT_TRUE(blocks.insert(block).second);
+  }
+  EXPECT_EQ(1U, arena.regions());
+
+  auto next = arena.allocate();
+  ASSERT_NE(nullptr, next);
+  EXPECT_EQ(2U, arena.regions());
+  EXPECT_EQ(0U, blocks.count(next));
+  for (auto block : blocks) {
+    arena.free(block);
+  }
+  arena.free(next);
+}
+
+TEST(HugePageArenaTest, FreedBlocksAreReused) {
+  HugePageArena arena(4096);
+  auto block = arena.allocate();
+  if (!block) {
+    return;
+  }
+  arena.free(block);
+  EXPECT_EQ(block, arena.allocate());
+  EXPECT_EQ(1U, arena.regions());
+  arena.free(block);
+}
+
+TEST(HugePageArenaTest, OwnsOnlyItsBlocks) {
+  HugePageArena arena(4096);
+  int onStack;
+  EXPECT_FALSE(arena.owns(&onStack));
+  auto block = arena.allocate();
+  if (!block) {
+    return;
+  }
+  EXPECT_TRUE(arena.owns(static_cast<char*>(block) + 100));
+  EXPECT_FALSE(arena.owns(&onStack));
+  auto heap = std::make_unique<char[]>(4096);
+  EXPECT_FALSE(arena.owns(heap.get()));
+  arena.free(block);
+}
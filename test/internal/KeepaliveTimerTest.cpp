@@ -10,6 +10,7 @@
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FramedDuplexConnection.h"
 #include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/internal/TimingWheel.h"
 
 using namespace ::testing;
 using namespace ::rsocket;
@@ -72,3 +73,70 @@ TEST(FollyKeepaliveTimerTest, NoResponse) {
 
   timer.stop();
 }
+
+TEST(FollyKeepaliveTimerTest, SharedWheel) {
+  folly::EventBase eventBase;
+  auto& wheel = TimingWheel::get(eventBase);
+
+  std::vector<std::shared_ptr<StrictMock<MockConnectionAutomaton>>>
+      connections;
+  std::vector<std::unique_ptr<KeepaliveTimer>> timers;
+  for (int i = 0; i < 3; ++i) {
+    connections.push_back(
+        std::make_shared<StrictMock<MockConnectionAutomaton>>());
+    timers.push_back(std::make_unique<KeepaliveTimer>(
+        std::chrono::milliseconds(10), eventBase));
+  }
+
+  // The first connection answers its keepalive, the second doesn't and the
+  // third is stopped before any keepalive is due.
+  EXPECT_CALL(*connections[0], sendKeepalive_(_))
+      .Times(AtLeast(1))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>&) {
+        timers[0]->keepaliveReceived();
+      }));
+  EXPECT_CALL(*connections[1], sendKeepalive_(_)).Times(1);
+  EXPECT_CALL(*connections[1], disconnectOrCloseWithError_(_))
+      .WillOnce(Invoke([&](Frame_ERROR&) { timers[0]->stop(); }));
+
+  for (size_t i = 0; i < timers.size(); ++i) {
+    timers[i]->start(connections[i]);
+  }
+  EXPECT_EQ(3U, wheel.size());
+  timers[2]->stop();
+  EXPECT_EQ(2U, wheel.size());
+
+  eventBase.loop();
+  EXPECT_EQ(0U, wheel.size());
+}
+
+TEST(FollyKeepaliveTimerTest, OnlyWhenIdle) {
+  auto connectionAutomaton =
+      std::make_shared<StrictMock<MockConnectionAutomaton>>();
+
+  EXPECT_CALL(*connectionAutomaton, sendKeepalive_(_)).Times(2);
+  EXPECT_CALL(*connectionAutomaton, disconnectOrCloseWithError_(_)).Times(1);
+
+  folly::EventBase eventBase;
+
+  KeepaliveTimer timer(std::chrono::milliseconds(100), eventBase);
+  timer.setOnlyWhenIdle(true);
+
+  timer.start(connectionAutomaton);
+
+  // skipped, frames were received
+  timer.frameReceived();
+  timer.sendKeepalive();
+
+  timer.sendKeepalive();
+
+  // any frame answers the keepalive
+  timer.frameReceived();
+  timer.sendKeepalive();
+
+  timer.sendKeepalive();
+
+  timer.sendKeepalive();
+
+  timer.stop();
+}
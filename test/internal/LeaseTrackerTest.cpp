@@ -0,0 +1,39 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/LeaseTracker.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+TEST(LeaseTrackerTest, NoLease) {
+  LeaseTracker lease;
+  EXPECT_EQ(0U, lease.remaining());
+  EXPECT_FALSE(lease.tryAcquire());
+}
+
+TEST(LeaseTrackerTest, ConsumesRequests) {
+  auto now = LeaseTracker::Clock::now();
+  LeaseTracker lease;
+  lease.update(std::chrono::seconds(1), 2, now);
+  EXPECT_EQ(2U, lease.remaining(now));
+  EXPECT_TRUE(lease.tryAcquire(now));
+  EXPECT_TRUE(lease.tryAcquire(now));
+  EXPECT_FALSE(lease.tryAcquire(now));
+  EXPECT_EQ(0U, lease.remaining(now));
+
+  // a new lease replaces the previous one
+  lease.update(std::chrono::seconds(1), 1, now);
+  EXPECT_TRUE(lease.tryAcquire(now));
+  EXPECT_FALSE(lease.tryAcquire(now));
+}
+
+TEST(LeaseTrackerTest, Expires) {
+  auto now = LeaseTracker::Clock::now();
+  LeaseTracker lease;
+  lease.update(std::chrono::milliseconds(100), 10, now);
+  EXPECT_TRUE(lease.tryAcquire(now + std::chrono::milliseconds(99)));
+  EXPECT_EQ(0U, lease.remaining(now + std::chrono::milliseconds(100)));
+  EXPECT_FALSE(lease.tryAcquire(now + std::chrono::milliseconds(100)));
+}
@@ -0,0 +1,119 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/OutputScheduler.h"
+
+using namespace ::rsocket;
+
+namespace {
+void enqueue(OutputScheduler& scheduler, StreamId streamId, std::string name) {
+  scheduler.enqueue(streamId, folly::IOBuf::copyBuffer(name));
+}
+
+std::vector<std::string> drain(OutputScheduler& scheduler) {
+  std::vector<std::string> names;
+  while (auto frame = scheduler.dequeue()) {
+    names.push_back(frame->moveToFbString().toStdString());
+  }
+  return names;
+}
+} // namespace
+
+TEST(OutputSchedulerTest, ConnectionFramesFirst) {
+  OutputScheduler scheduler;
+  EXPECT_TRUE(scheduler.empty());
+  EXPECT_EQ(nullptr, scheduler.dequeue());
+
+  scheduler.setPriority(3, StreamPriority(StreamPriority::Class::INTERACTIVE));
+  enqueue(scheduler, 1, "bulk");
+  enqueue(scheduler, 3, "interactive");
+  enqueue(scheduler, 0, "keepalive");
+  enqueue(scheduler, 0, "lease");
+  EXPECT_EQ(4U, scheduler.size());
+
+  EXPECT_EQ(
+      std::vector<std::string>({"keepalive", "lease", "interactive", "bulk"}),
+      drain(scheduler));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST(OutputSchedulerTest, RoundRobinByWeight) {
+  OutputScheduler scheduler;
+  scheduler.setPriority(1, StreamPriority(StreamPriority::Class::BULK, 2));
+  for (int i = 0; i < 4; ++i) {
+    enqueue(scheduler, 1, "a" + std::to_string(i));
+    enqueue(scheduler, 3, "b" + std::to_string(i));
+  }
+
+  EXPECT_EQ(
+      std::vector<std::string>(
+          {"a0", "a1", "b0", "a2", "a3", "b1", "b2", "b3"}),
+      drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, StreamKeepsItsQueue) {
+  OutputScheduler scheduler;
+  enqueue(scheduler, 1, "first");
+  // The new priority only applies once the queued frames of the stream have
+  // been sent, so that they stay in order.
+  scheduler.setPriority(1, StreamPriority(StreamPriority::Class::INTERACTIVE));
+  enqueue(scheduler, 3, "other");
+  enqueue(scheduler, 1, "second");
+
+  EXPECT_EQ(
+      std::vector<std::string>({"first", "other", "second"}),
+      drain(scheduler));
+
+  scheduler.clearPriority(1);
+  enqueue(scheduler, 3, "other");
+  enqueue(scheduler, 1, "third");
+  EXPECT_EQ(
+      std::vector<std::string>({"other", "third"}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, DropStream) {
+  OutputScheduler scheduler;
+  scheduler.setPriority(5, StreamPriority(StreamPriority::Class::BULK, 2));
+  enqueue(scheduler, 5, "c0");
+  enqueue(scheduler, 5, "c1");
+  enqueue(scheduler, 3, "b0");
+  enqueue(scheduler, 0, "keepalive");
+  EXPECT_EQ(3U, scheduler.oldestStream());
+
+  // the dropped stream is in the middle of its turn
+  EXPECT_EQ("keepalive", scheduler.dequeue()->moveToFbString().toStdString());
+  EXPECT_EQ("c0", scheduler.dequeue()->moveToFbString().toStdString());
+  EXPECT_EQ(1U, scheduler.dropStream(5).size());
+  EXPECT_EQ(0U, scheduler.dropStream(5).size());
+  EXPECT_EQ(1U, scheduler.size());
+
+  enqueue(scheduler, 1, "a0");
+  enqueue(scheduler, 1, "a1");
+  EXPECT_EQ(1U, scheduler.oldestStream());
+  EXPECT_EQ(std::vector<std::string>({"b0", "a0", "a1"}), drain(scheduler));
+  EXPECT_EQ(0U, scheduler.oldestStream());
+}
+
+TEST(OutputSchedulerTest, ReplaceConnectionFrame) {
+  OutputScheduler scheduler;
+  auto first = folly::IOBuf::copyBuffer("push1");
+  auto const queued = first.get();
+  scheduler.enqueue(0, std::move(first));
+  enqueue(scheduler, 0, "keepalive");
+
+  auto frame = folly::IOBuf::copyBuffer("push2");
+  EXPECT_TRUE(scheduler.replaceConnectionFrame(queued, frame));
+  EXPECT_EQ("push1", frame->moveToFbString().toStdString());
+  EXPECT_EQ(2U, scheduler.size());
+
+  auto missing = folly::IOBuf::copyBuffer("push3");
+  EXPECT_FALSE(scheduler.replaceConnectionFrame(queued, missing));
+  EXPECT_EQ("push3", missing->moveToFbString().toStdString());
+
+  EXPECT_EQ(
+      std::vector<std::string>({"push2", "keepalive"}), drain(scheduler));
+}
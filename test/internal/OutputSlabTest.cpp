@@ -0,0 +1,73 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/OutputSlab.h"
+
+using namespace rsocket;
+
+namespace {
+std::string toString(const folly::IOBuf& chain) {
+  return chain.cloneAsValue().moveToFbString().toStdString();
+}
+} // namespace
+
+TEST(OutputSlabTest, PacksSmallBuffers) {
+  std::unique_ptr<folly::IOBuf> chain;
+  OutputSlab::append(chain, folly::IOBuf::copyBuffer("first"));
+  auto second = folly::IOBuf::copyBuffer("second");
+  second->prependChain(folly::IOBuf::copyBuffer("third"));
+  OutputSlab::append(chain, std::move(second));
+
+  EXPECT_EQ("firstsecondthird", toString(*chain));
+  EXPECT_EQ(1U, chain->countChainElements());
+}
+
+TEST(OutputSlabTest, ChainsLargeBuffers) {
+  std::string const large(OutputSlab::kMaxPackedBytes + 1, 'x');
+  auto largeBuf = folly::IOBuf::copyBuffer(large);
+  auto const largeData = largeBuf->data();
+
+  std::unique_ptr<folly::IOBuf> chain;
+  OutputSlab::append(chain, folly::IOBuf::copyBuffer("header"));
+  OutputSlab::append(chain, std::move(largeBuf));
+  OutputSlab::append(chain, folly::IOBuf::copyBuffer("next"));
+
+  EXPECT_EQ("header" + large + "next", toString(*chain));
+  ASSERT_EQ(3U, chain->countChainElements());
+  // Not copied.
+  EXPECT_EQ(largeData, chain->next()->data());
+}
+
+TEST(OutputSlabTest, ReusesReleasedSlabs) {
+  std::string const small(OutputSlab::kMaxPackedBytes, 's');
+  const uint8_t* first = nullptr;
+  // More than a slab's worth, dropping the bytes as they are written.
+  for (size_t i = 0; i < 2 * OutputSlab::kSlabSize / small.size(); ++i) {
+    std::unique_ptr<folly::IOBuf> chain;
+    OutputSlab::append(chain, folly::IOBuf::copyBuffer(small));
+    EXPECT_EQ(small, toString(*chain));
+    if (!first) {
+      first = chain->buffer();
+    }
+    EXPECT_EQ(first, chain->buffer());
+  }
+}
+
+TEST(OutputSlabTest, KeepsReferencedSlabs) {
+  std::string const small(OutputSlab::kMaxPackedBytes - 1, 's');
+  std::vector<std::unique_ptr<folly::IOBuf>> written;
+  for (size_t i = 0; i < 2 * OutputSlab::kSlabSize / small.size(); ++i) {
+    std::unique_ptr<folly::IOBuf> chain;
+    OutputSlab::append(
+        chain, folly::IOBuf::copyBuffer(small + std::to_string(i % 10)));
+    written.push_back(std::move(chain));
+  }
+  for (size_t i = 0; i < written.size(); ++i) {
+    EXPECT_EQ(small + std::to_string(i % 10), toString(*written[i]));
+  }
+}
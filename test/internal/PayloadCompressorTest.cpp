@@ -0,0 +1,165 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Conv.h>
+#include <folly/io/Compression.h>
+#include <folly/portability/Config.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#if FOLLY_HAVE_LIBZSTD
+#include <zdict.h>
+#endif
+
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+using namespace rsocket;
+
+namespace {
+constexpr size_t kMaxLength = 1 << 20;
+
+PayloadCompression zstd() {
+  PayloadCompression compression;
+  compression.codec = PayloadCompression::Codec::ZSTD;
+  compression.minBytes = 100;
+  return compression;
+}
+} // namespace
+
+TEST(PayloadCompressorTest, RoundTrip) {
+  if (!folly::io::hasCodec(folly::io::CodecType::ZSTD)) {
+    return;
+  }
+  std::string const data(10000, 'd');
+  Payload payload(data, "metadata");
+  ASSERT_TRUE(compressPayload(payload, zstd()));
+  EXPECT_LT(payload.data->computeChainDataLength(), data.size());
+  EXPECT_EQ("metadata", payload.cloneMetadataToString());
+
+  decompressPayload(payload, zstd(), kMaxLength);
+  EXPECT_EQ(data, payload.moveDataToString());
+  EXPECT_EQ("metadata", payload.moveMetadataToString());
+}
+
+TEST(PayloadCompressorTest, LeavesShortData) {
+  Payload payload(std::string(99, 'd'));
+  EXPECT_FALSE(compressPayload(payload, zstd()));
+  EXPECT_EQ(std::string(99, 'd'), payload.moveDataToString());
+
+  // Nor is anything compressed without a codec.
+  Payload uncompressed(std::string(10000, 'd'));
+  EXPECT_FALSE(compressPayload(uncompressed, PayloadCompression()));
+  EXPECT_EQ(std::string(10000, 'd'), uncompressed.moveDataToString());
+}
+
+TEST(PayloadCompressorTest, RejectsBadData) {
+  Payload empty;
+  EXPECT_THROW(
+      decompressPayload(empty, zstd(), kMaxLength), std::runtime_error);
+
+  Payload unknownCodec(std::string("\x7f" "data"));
+  EXPECT_THROW(
+      decompressPayload(unknownCodec, zstd(), kMaxLength),
+      std::runtime_error);
+}
+
+TEST(PayloadCompressorTest, RejectsLongData) {
+  std::string const data(10000, 'd');
+  for (auto codec :
+       {PayloadCompression::Codec::ZSTD, PayloadCompression::Codec::LZ4}) {
+    auto compression = zstd();
+    compression.codec = codec;
+    Payload payload(data);
+    if (!compressPayload(payload, compression)) {
+      // folly without the codec
+      continue;
+    }
+    Payload copy = payload.clone();
+    EXPECT_THROW(
+        decompressPayload(copy, compression, data.size() - 1),
+        std::runtime_error);
+
+    decompressPayload(payload, compression, data.size());
+    EXPECT_EQ(data, payload.moveDataToString());
+  }
+}
+
+#if FOLLY_HAVE_LIBZSTD
+namespace {
+std::string sample(int i) {
+  return folly::to<std::string>(
+      "{\"user\":", i, ",\"name\":\"user", i, "\",\"active\":true}");
+}
+
+std::shared_ptr<const CompressionDictionary> trainDictionary() {
+  std::string samples;
+  std::vector<size_t> sizes;
+  for (int i = 0; i < 2000; ++i) {
+    samples += sample(i);
+    sizes.push_back(sample(i).size());
+  }
+  std::string dictionary(4096, '\0');
+  auto const size = ZDICT_trainFromBuffer(
+      &dictionary[0],
+      dictionary.size(),
+      samples.data(),
+      sizes.data(),
+      sizes.size());
+  if (ZDICT_isError(size)) {
+    return nullptr;
+  }
+  return std::make_shared<CompressionDictionary>(
+      folly::ByteRange(folly::StringPiece(dictionary.data(), size)));
+}
+} // namespace
+
+TEST(PayloadCompressorTest, Dictionary) {
+  auto dictionary = trainDictionary();
+  if (!dictionary) {
+    return;
+  }
+  auto compression = zstd();
+  compression.minBytes = 0;
+  compression.dictionary = dictionary;
+
+  // Too short to shrink without the dictionary.
+  auto const data = sample(12345);
+  Payload payload(data);
+  ASSERT_TRUE(compressPayload(payload, compression));
+  EXPECT_LT(payload.data->computeChainDataLength(), data.size() / 2);
+
+  // Not without the dictionary either.
+  Payload copy = payload.clone();
+  EXPECT_THROW(
+      decompressPayload(copy, zstd(), kMaxLength), std::runtime_error);
+
+  // Nor past the longest data expected.
+  copy = payload.clone();
+  EXPECT_THROW(
+      decompressPayload(copy, compression, data.size() - 1),
+      std::runtime_error);
+
+  decompressPayload(payload, compression, data.size());
+  EXPECT_EQ(data, payload.moveDataToString());
+}
+
+TEST(PayloadCompressorTest, NamesDictionaryInSetup) {
+  auto dictionary = trainDictionary();
+  if (!dictionary) {
+    return;
+  }
+  SetupParameters setupParams;
+  EXPECT_FALSE(compressionDictionaryId(setupParams));
+
+  setupParams.metadataMimeType = kCompositeMetadataMimeType.str();
+  setupParams.payload.metadata = compressionDictionaryMetadata(*dictionary);
+  auto id = compressionDictionaryId(setupParams);
+  ASSERT_TRUE(id);
+  EXPECT_EQ(dictionary->id(), *id);
+
+  EXPECT_THROW(
+      CompressionDictionary(folly::ByteRange(folly::StringPiece("raw"))),
+      std::runtime_error);
+}
+#endif
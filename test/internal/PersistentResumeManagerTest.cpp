@@ -0,0 +1,143 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <folly/experimental/TestUtil.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/PersistentResumeManager.h"
+#include "rsocket/internal/ResumePersistenceThread.h"
+
+using namespace ::rsocket;
+
+namespace {
+class PersistentResumeManagerTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<PersistentResumeManager> open(
+      size_t segmentSize = 4096,
+      std::shared_ptr<ResumePersistenceThread> thread = nullptr) {
+    PersistentResumeManager::Options options;
+    options.directory = directory_.path().string();
+    options.segmentSize = segmentSize;
+    options.capacity = 1024;
+    options.persistenceThread = std::move(thread);
+    options.queueCapacity = 16;
+    return std::make_unique<PersistentResumeManager>(
+        RSocketStats::noop(), std::move(options));
+  }
+
+  void send(PersistentResumeManager& manager, std::string data) {
+    auto frame = folly::IOBuf::copyBuffer(data);
+    manager.trackSentFrame(*frame, frame->length(), FrameType::PAYLOAD, 1, 0);
+  }
+
+  size_t segmentCount() const {
+    size_t count = 0;
+    for (boost::filesystem::directory_iterator it(directory_.path()), end;
+         it != end;
+         ++it) {
+      ++count;
+    }
+    return count;
+  }
+
+  folly::test::TemporaryDirectory directory_;
+};
+} // namespace
+
+TEST_F(PersistentResumeManagerTest, EmptyDirectory) {
+  auto manager = open();
+  EXPECT_EQ(0, manager->firstSentPosition());
+  EXPECT_EQ(0, manager->lastSentPosition());
+  EXPECT_EQ(0, manager->impliedPosition());
+  EXPECT_TRUE(manager->getStreamResumeInfos().empty());
+  EXPECT_EQ(1U, segmentCount());
+}
+
+TEST_F(PersistentResumeManagerTest, SurvivesRestart) {
+  {
+    auto manager = open();
+    manager->onStreamOpen(
+        1, RequestOriginator::LOCAL, "token", StreamType::STREAM);
+    manager->onStreamOpen(
+        2, RequestOriginator::REMOTE, "", StreamType::REQUEST_RESPONSE);
+    manager->onStreamOpen(
+        3, RequestOriginator::LOCAL, "", StreamType::CHANNEL);
+    manager->onStreamClosed(2);
+    send(*manager, "first");
+    send(*manager, "second");
+    send(*manager, "third");
+    manager->resetUpToPosition(5);
+    manager->trackReceivedFrame(10, FrameType::PAYLOAD, 1, 7);
+    // Not tracked.
+    manager->trackReceivedFrame(10, FrameType::KEEPALIVE, 0, 0);
+  }
+
+  auto manager = open();
+  EXPECT_EQ(5, manager->firstSentPosition());
+  EXPECT_EQ(16, manager->lastSentPosition());
+  EXPECT_EQ(10, manager->impliedPosition());
+  EXPECT_FALSE(manager->isPositionAvailable(0));
+  EXPECT_TRUE(manager->isPositionAvailable(5));
+  EXPECT_TRUE(manager->isPositionAvailable(11));
+  EXPECT_EQ(3U, manager->getLargestUsedStreamId());
+
+  auto const& infos = manager->getStreamResumeInfos();
+  ASSERT_EQ(2U, infos.size());
+  EXPECT_EQ("token", infos.at(1).streamToken);
+  EXPECT_EQ(StreamType::STREAM, infos.at(1).streamType);
+  EXPECT_EQ(7U, infos.at(1).consumerAllowance);
+  EXPECT_EQ(StreamType::CHANNEL, infos.at(3).streamType);
+  EXPECT_EQ(1U, segmentCount());
+}
+
+TEST_F(PersistentResumeManagerTest, RollsOverSegments) {
+  {
+    auto manager = open(64);
+    for (int i = 0; i < 100; ++i) {
+      send(*manager, std::string(100, 'a'));
+      EXPECT_EQ(1U, segmentCount());
+    }
+    // Doesn't fit in the buffer.
+    send(*manager, std::string(2000, 'b'));
+    send(*manager, "last");
+  }
+
+  auto manager = open(64);
+  EXPECT_EQ(12000, manager->firstSentPosition());
+  EXPECT_EQ(12004, manager->lastSentPosition());
+  EXPECT_TRUE(manager->isPositionAvailable(12000));
+  EXPECT_EQ(1U, segmentCount());
+
+  manager->checkpoint();
+  EXPECT_EQ(1U, segmentCount());
+  manager = open(64);
+  EXPECT_EQ(12000, manager->firstSentPosition());
+  EXPECT_EQ(12004, manager->lastSentPosition());
+}
+
+TEST_F(PersistentResumeManagerTest, PersistenceThread) {
+  auto thread = std::make_shared<ResumePersistenceThread>();
+  {
+    auto manager = open(64, thread);
+    manager->onStreamOpen(
+        1, RequestOriginator::LOCAL, "token", StreamType::STREAM);
+    // Overflows the queue, and rolls over the segments.
+    for (int i = 0; i < 100; ++i) {
+      send(*manager, std::string(100, 'a'));
+    }
+    send(*manager, "last");
+    manager->trackReceivedFrame(10, FrameType::PAYLOAD, 1, 7);
+  }
+  thread->flush();
+  EXPECT_EQ(1U, segmentCount());
+
+  auto manager = open(64);
+  EXPECT_EQ(10004, manager->lastSentPosition());
+  EXPECT_EQ(10, manager->impliedPosition());
+  EXPECT_TRUE(manager->isPositionAvailable(10000));
+  EXPECT_EQ("token", manager->getStreamResumeInfos().at(1).streamToken);
+  EXPECT_EQ(7U, manager->getStreamResumeInfos().at(1).consumerAllowance);
+}
@@ -0,0 +1,64 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/PoolAllocated.h"
+
+using namespace rsocket;
+
+namespace {
+
+class Pooled : public PoolAllocated<Pooled, 2> {
+ public:
+  virtual ~Pooled() = default;
+
+  int value{0};
+};
+
+class Larger : public Pooled {
+ public:
+  char padding[64];
+};
+
+} // namespace
+
+TEST(PoolAllocatedTest, ReusesFreedObjects) {
+  auto first = new Pooled;
+  auto const address = static_cast<void*>(first);
+  delete first;
+
+  auto second = new Pooled;
+  EXPECT_EQ(address, static_cast<void*>(second));
+  delete second;
+}
+
+TEST(PoolAllocatedTest, LargerDerivedClass) {
+  auto pooled = new Pooled;
+  auto const address = static_cast<void*>(pooled);
+  delete pooled;
+
+  // a larger object can't use the freed block, and doesn't take it
+  Pooled* larger = new Larger;
+  EXPECT_NE(address, static_cast<void*>(larger));
+  delete larger;
+  auto reused = new Pooled;
+  EXPECT_EQ(address, static_cast<void*>(reused));
+  delete reused;
+}
+
+TEST(PoolAllocatedTest, FreeListPerThread) {
+  auto pooled = new Pooled;
+  auto const address = static_cast<void*>(pooled);
+  delete pooled;
+
+  std::thread([address] {
+    auto other = new Pooled;
+    EXPECT_NE(address, static_cast<void*>(other));
+    delete other;
+  }).join();
+  auto reused = new Pooled;
+  EXPECT_EQ(address, static_cast<void*>(reused));
+  delete reused;
+}
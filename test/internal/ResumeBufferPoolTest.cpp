@@ -0,0 +1,106 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/ResumeBufferPool.h"
+#include "rsocket/internal/WarmResumeManager.h"
+
+using namespace ::rsocket;
+
+namespace {
+constexpr size_t kChunkSize = 64;
+
+void send(WarmResumeManager& manager, size_t length) {
+  auto frame = folly::IOBuf::copyBuffer(std::string(length, 'x'));
+  manager.trackSentFrame(*frame, length, FrameType::PAYLOAD, 1, 0);
+}
+} // namespace
+
+TEST(ResumeBufferPoolTest, ChunksAreGivenBack) {
+  auto pool = std::make_shared<ResumeBufferPool>(4 * kChunkSize, kChunkSize);
+  WarmResumeManager manager(RSocketStats::noop(), pool);
+
+  send(manager, 50);
+  send(manager, 50);
+  send(manager, 50);
+  EXPECT_EQ(3U, pool->chunksInUse());
+  EXPECT_EQ(150U, manager.size());
+  EXPECT_TRUE(manager.isPositionAvailable(50));
+
+  manager.resetUpToPosition(100);
+  EXPECT_EQ(2U, pool->chunksInUse());
+  EXPECT_EQ(100, manager.firstSentPosition());
+
+  manager.resetUpToPosition(150);
+  EXPECT_EQ(0U, pool->chunksInUse());
+  EXPECT_EQ(0U, manager.size());
+}
+
+TEST(ResumeBufferPoolTest, LeastRecentlyActiveGivesUpChunks) {
+  auto pool = std::make_shared<ResumeBufferPool>(4 * kChunkSize, kChunkSize);
+  WarmResumeManager idle(RSocketStats::noop(), pool);
+  WarmResumeManager active(RSocketStats::noop(), pool);
+
+  send(idle, kChunkSize);
+  send(idle, kChunkSize);
+  send(active, kChunkSize);
+  send(active, kChunkSize);
+  EXPECT_EQ(4U, pool->chunksInUse());
+
+  // The pool is exhausted, the oldest frame of the idle connection goes.
+  send(active, kChunkSize);
+  EXPECT_EQ(4U, pool->chunksInUse());
+  EXPECT_EQ(64, idle.firstSentPosition());
+  EXPECT_FALSE(idle.isPositionAvailable(0));
+  EXPECT_TRUE(idle.isPositionAvailable(64));
+  EXPECT_EQ(0, active.firstSentPosition());
+  EXPECT_EQ(3 * kChunkSize, active.size());
+}
+
+TEST(ResumeBufferPoolTest, EvictsItsOwnFrames) {
+  auto pool = std::make_shared<ResumeBufferPool>(2 * kChunkSize, kChunkSize);
+  WarmResumeManager manager(RSocketStats::noop(), pool);
+
+  send(manager, kChunkSize);
+  send(manager, kChunkSize);
+  send(manager, kChunkSize);
+  EXPECT_EQ(64, manager.firstSentPosition());
+  EXPECT_EQ(192, manager.lastSentPosition());
+  EXPECT_EQ(2U, pool->chunksInUse());
+
+  // Larger than the whole pool, it isn't buffered.
+  send(manager, 3 * kChunkSize);
+  EXPECT_EQ(384, manager.firstSentPosition());
+  EXPECT_EQ(384, manager.lastSentPosition());
+  EXPECT_TRUE(manager.isPositionAvailable(384));
+  EXPECT_EQ(0U, pool->chunksInUse());
+
+  send(manager, 10);
+  EXPECT_EQ(1U, pool->chunksInUse());
+  EXPECT_TRUE(manager.isPositionAvailable(384));
+}
+
+TEST(ResumeBufferPoolTest, HugePages) {
+  auto pool =
+      std::make_shared<ResumeBufferPool>(4 * kChunkSize, kChunkSize, true);
+  WarmResumeManager manager(RSocketStats::noop(), pool);
+
+  send(manager, 50);
+  send(manager, 50);
+  send(manager, 50);
+  EXPECT_EQ(3U, pool->chunksInUse());
+  EXPECT_TRUE(manager.isPositionAvailable(50));
+
+  manager.resetUpToPosition(150);
+  EXPECT_EQ(0U, pool->chunksInUse());
+
+  // Larger than a huge page, the chunks come from the heap.
+  auto large = std::make_shared<ResumeBufferPool>(
+      8 * 1024 * 1024, 4 * 1024 * 1024, true);
+  WarmResumeManager other(RSocketStats::noop(), large);
+  send(other, 100);
+  EXPECT_EQ(1U, large->chunksInUse());
+}
@@ -0,0 +1,97 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/ResumeStateTransfer.h"
+#include "rsocket/internal/WarmResumeManager.h"
+
+using namespace ::rsocket;
+
+namespace {
+void send(WarmResumeManager& manager, std::string data) {
+  auto frame = folly::IOBuf::copyBuffer(data);
+  manager.trackSentFrame(*frame, frame->length(), FrameType::PAYLOAD, 1, 0);
+}
+} // namespace
+
+TEST(ResumeStateTransferTest, RoundTrip) {
+  WarmResumeManager owner(RSocketStats::noop());
+  send(owner, "first");
+  send(owner, "second");
+  send(owner, "third");
+  owner.resetUpToPosition(5);
+  owner.trackReceivedFrame(20, FrameType::PAYLOAD, 1, 0);
+
+  ResumeStateTransfer state;
+  state.protocolVersion = ProtocolVersion(1, 0);
+  state.token = ResumeIdentificationToken::generateNew();
+  state.metadataMimeType = "application/json";
+  state.dataMimeType = "text/plain";
+  state.nextStreamId = 4;
+  state.lastPeerStreamId = 7;
+  state.openStreams = {3, 2, 7};
+  owner.exportState(state);
+  EXPECT_EQ(2U, state.sentFrames.size());
+
+  auto buf = state.serialize();
+  auto copy = ResumeStateTransfer::deserialize(*buf);
+  ASSERT_TRUE(copy.hasValue());
+  EXPECT_EQ(ProtocolVersion(1, 0), copy->protocolVersion);
+  EXPECT_EQ(state.token, copy->token);
+  EXPECT_EQ("application/json", copy->metadataMimeType);
+  EXPECT_EQ("text/plain", copy->dataMimeType);
+  EXPECT_EQ(4U, copy->nextStreamId);
+  EXPECT_EQ(7U, copy->lastPeerStreamId);
+  EXPECT_EQ(std::vector<StreamId>({3, 2, 7}), copy->openStreams);
+
+  WarmResumeManager resumed(RSocketStats::noop());
+  ASSERT_TRUE(resumed.importState(*copy));
+  EXPECT_EQ(5, resumed.firstSentPosition());
+  EXPECT_EQ(16, resumed.lastSentPosition());
+  EXPECT_EQ(20, resumed.impliedPosition());
+  EXPECT_TRUE(resumed.isPositionAvailable(5));
+  EXPECT_TRUE(resumed.isPositionAvailable(11));
+  EXPECT_FALSE(resumed.isPositionAvailable(0));
+  EXPECT_EQ(11U, resumed.size());
+}
+
+TEST(ResumeStateTransferTest, NothingBuffered) {
+  WarmResumeManager owner(RSocketStats::noop(), 4);
+  send(owner, "too large");
+
+  ResumeStateTransfer state;
+  owner.exportState(state);
+  auto copy = ResumeStateTransfer::deserialize(*state.serialize());
+  ASSERT_TRUE(copy.hasValue());
+
+  WarmResumeManager resumed(RSocketStats::noop());
+  ASSERT_TRUE(resumed.importState(*copy));
+  EXPECT_EQ(9, resumed.firstSentPosition());
+  EXPECT_EQ(9, resumed.lastSentPosition());
+  EXPECT_TRUE(resumed.isPositionAvailable(9));
+}
+
+TEST(ResumeStateTransferTest, InvalidState) {
+  ResumeStateTransfer state;
+  state.openStreams = {1};
+  auto buf = state.serialize();
+
+  auto truncated = buf->cloneCoalesced();
+  truncated->trimEnd(1);
+  EXPECT_FALSE(ResumeStateTransfer::deserialize(*truncated).hasValue());
+
+  auto extra = buf->cloneCoalesced();
+  extra->prependChain(folly::IOBuf::copyBuffer("x"));
+  EXPECT_FALSE(ResumeStateTransfer::deserialize(*extra).hasValue());
+
+  EXPECT_FALSE(ResumeStateTransfer::deserialize(
+                   *folly::IOBuf::copyBuffer("not a state"))
+                   .hasValue());
+
+  state.firstSentPosition = 10;
+  WarmResumeManager resumed(RSocketStats::noop());
+  EXPECT_FALSE(resumed.importState(state));
+}
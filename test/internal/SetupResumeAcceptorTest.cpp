@@ -272,3 +272,96 @@ TEST(SetupResumeAcceptor, RejectedResume) {
 
   EXPECT_TRUE(resumeCalled);
 }
+
+namespace {
+/// A connection whose first frame is `frame`, and which expects the acceptor
+/// to close it with an ERROR frame of `errorCode`, or to hand it over if none.
+template <typename Frame>
+std::unique_ptr<DuplexConnection> makeConnection(
+    Frame frame,
+    folly::Optional<ErrorCode> errorCode) {
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+  std::shared_ptr<folly::IOBuf> buf =
+      serializer->serializeOut(std::move(frame));
+  return std::make_unique<StrictMock<MockDuplexConnection>>(
+      [buf](auto input) {
+        input->onSubscribe(yarpl::flowable::Subscription::empty());
+        input->onNext(buf->clone());
+        input->onComplete();
+      },
+      [errorCode](auto output) {
+        EXPECT_CALL(*output, onSubscribe_(_));
+        if (!errorCode) {
+          EXPECT_CALL(*output, onComplete_());
+          return;
+        }
+        EXPECT_CALL(*output, onNext_(_))
+            .WillOnce(Invoke([errorCode](auto const& buf) {
+              auto serializer = FrameSerializer::createFrameSerializer(
+                  ProtocolVersion::Current());
+              Frame_ERROR frame;
+              EXPECT_TRUE(serializer->deserializeFrom(frame, buf->clone()));
+              EXPECT_EQ(frame.errorCode_, *errorCode);
+            }));
+        EXPECT_CALL(*output, onError_(_));
+      });
+}
+} // namespace
+
+TEST(SetupResumeAcceptor, ShedsSetupsPastAdmissionLimits) {
+  folly::EventBase evb;
+  SetupAdmissionLimits limits;
+  limits.maxInProgress = 1;
+  limits.resumeHeadroom = 1;
+  SetupResumeAcceptor acceptor{&evb, ProtocolVersion::Unknown, limits};
+
+  // a SETUP the service handler accepts asynchronously
+  std::shared_ptr<void> inProgress;
+  acceptor.accept(
+      makeConnection(makeSetup(), folly::none),
+      [&](auto transport, auto) {
+        transport->close();
+        inProgress = acceptor.trackInProgress();
+      },
+      resumeFail);
+  evb.loop();
+  ASSERT_TRUE(inProgress);
+
+  acceptor.accept(
+      makeConnection(makeSetup(), ErrorCode::REJECTED_SETUP),
+      setupFail,
+      resumeFail);
+  evb.loop();
+
+  // the RESUMEs have room left
+  std::shared_ptr<void> resumeInProgress;
+  acceptor.accept(
+      makeConnection(makeResume(), folly::none),
+      setupFail,
+      [&](auto transport, auto) {
+        transport->close();
+        resumeInProgress = acceptor.trackInProgress();
+      });
+  evb.loop();
+  ASSERT_TRUE(resumeInProgress);
+
+  acceptor.accept(
+      makeConnection(makeResume(), ErrorCode::CONNECTION_ERROR),
+      setupFail,
+      resumeFail);
+  evb.loop();
+
+  inProgress.reset();
+  resumeInProgress.reset();
+  bool setupCalled = false;
+  acceptor.accept(
+      makeConnection(makeSetup(), folly::none),
+      [&](auto transport, auto) {
+        transport->close();
+        setupCalled = true;
+      },
+      resumeFail);
+  evb.loop();
+  EXPECT_TRUE(setupCalled);
+}
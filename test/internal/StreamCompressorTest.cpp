@@ -0,0 +1,117 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/StreamCompressor.h"
+
+using namespace rsocket;
+
+namespace {
+using Codec = ConnectionCompression::Codec;
+
+constexpr size_t kMaxBytes = 1 << 20;
+
+std::string toString(std::unique_ptr<folly::IOBuf> bytes) {
+  return bytes ? bytes->moveToFbString().toStdString() : std::string();
+}
+
+/// Every message compressed is decompressed whole, even if its bytes arrive
+/// one by one.
+void roundTrip(Codec codec) {
+  auto compressor = StreamCompressor::create(codec, 0);
+  auto decompressor = StreamDecompressor::create(codec);
+  if (!compressor) {
+    EXPECT_FALSE(decompressor);
+    return;
+  }
+  ASSERT_TRUE(decompressor);
+
+  for (int i = 0; i < 20; ++i) {
+    auto const message = std::string(100 + i, 'a' + i % 3) + "message";
+    auto compressed =
+        compressor->compress(*folly::IOBuf::copyBuffer(message));
+    auto const bytes = toString(std::move(compressed));
+
+    std::string decompressed;
+    for (auto byte : bytes) {
+      decompressed += toString(decompressor->decompress(
+          *folly::IOBuf::copyBuffer(&byte, 1), kMaxBytes));
+    }
+    EXPECT_EQ(message, decompressed);
+  }
+}
+
+/// Repeated messages compress against the ones before them.
+void window(Codec codec) {
+  auto compressor = StreamCompressor::create(codec, 0);
+  if (!compressor) {
+    return;
+  }
+  std::string message;
+  for (int i = 0; i < 100; ++i) {
+    message += std::to_string(i * 7919);
+  }
+  auto const first =
+      compressor->compress(*folly::IOBuf::copyBuffer(message))
+          ->computeChainDataLength();
+  auto const second =
+      compressor->compress(*folly::IOBuf::copyBuffer(message))
+          ->computeChainDataLength();
+  EXPECT_LT(second, first / 2);
+}
+
+/// Bytes which decompress to more than the limit fail, however few they are.
+void limit(Codec codec) {
+  auto compressor = StreamCompressor::create(codec, 0);
+  auto decompressor = StreamDecompressor::create(codec);
+  if (!compressor) {
+    return;
+  }
+  auto const compressed = compressor->compress(
+      *folly::IOBuf::copyBuffer(std::string(10 * kMaxBytes, 'z')));
+  EXPECT_LT(compressed->computeChainDataLength(), kMaxBytes / 10);
+  EXPECT_THROW(
+      decompressor->decompress(*compressed, kMaxBytes), std::runtime_error);
+}
+} // namespace
+
+TEST(StreamCompressorTest, NoneIsUnavailable) {
+  EXPECT_FALSE(StreamCompressor::create(Codec::NONE, 0));
+  EXPECT_FALSE(StreamDecompressor::create(Codec::NONE));
+}
+
+TEST(StreamCompressorTest, ZstdRoundTrip) {
+  roundTrip(Codec::ZSTD);
+}
+
+TEST(StreamCompressorTest, DeflateRoundTrip) {
+  roundTrip(Codec::DEFLATE);
+}
+
+TEST(StreamCompressorTest, ZstdWindow) {
+  window(Codec::ZSTD);
+}
+
+TEST(StreamCompressorTest, DeflateWindow) {
+  window(Codec::DEFLATE);
+}
+
+TEST(StreamCompressorTest, ZstdLimit) {
+  limit(Codec::ZSTD);
+}
+
+TEST(StreamCompressorTest, DeflateLimit) {
+  limit(Codec::DEFLATE);
+}
+
+TEST(StreamCompressorTest, CorruptBytes) {
+  auto decompressor = StreamDecompressor::create(Codec::ZSTD);
+  if (!decompressor) {
+    return;
+  }
+  EXPECT_THROW(
+      decompressor->decompress(
+          *folly::IOBuf::copyBuffer("not zstd at all"), kMaxBytes),
+      std::runtime_error);
+}
@@ -0,0 +1,94 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/StreamTable.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+using Table = StreamTable<std::shared_ptr<int>>;
+
+std::shared_ptr<int> value(int v) {
+  return std::make_shared<int>(v);
+}
+
+std::vector<StreamId> streamIds(const Table& table) {
+  std::vector<StreamId> ids;
+  table.forEach([&](StreamId id, const std::shared_ptr<int>&) {
+    ids.push_back(id);
+  });
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+} // namespace
+
+TEST(StreamTableTest, InsertFindErase) {
+  Table table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.find(1));
+
+  EXPECT_TRUE(table.insert(1, value(1)));
+  EXPECT_TRUE(table.insert(2, value(2)));
+  EXPECT_TRUE(table.insert(3, value(3)));
+  EXPECT_FALSE(table.insert(3, value(33)));
+  EXPECT_EQ(3U, table.size());
+
+  ASSERT_NE(nullptr, table.find(3));
+  EXPECT_EQ(3, **table.find(3));
+  EXPECT_EQ(2, **table.find(2));
+  EXPECT_EQ(nullptr, table.find(5));
+
+  auto erased = table.erase(1);
+  ASSERT_TRUE(erased);
+  EXPECT_EQ(1, *erased);
+  EXPECT_FALSE(table.erase(1));
+  EXPECT_EQ(nullptr, table.find(1));
+  EXPECT_EQ(2U, table.size());
+  EXPECT_EQ(std::vector<StreamId>({2, 3}), streamIds(table));
+}
+
+TEST(StreamTableTest, SlidingWindow) {
+  Table table;
+  // Keep a bounded number of streams open while allocating many more ids than
+  // the initial capacity of the window.
+  StreamId next = 1;
+  for (int i = 0; i < 8; ++i, next += 2) {
+    EXPECT_TRUE(table.insert(next, value(static_cast<int>(next))));
+  }
+  for (StreamId oldest = 1; next < 100001; oldest += 2, next += 2) {
+    EXPECT_TRUE(table.erase(oldest));
+    EXPECT_TRUE(table.insert(next, value(static_cast<int>(next))));
+    ASSERT_EQ(8U, table.size());
+  }
+  for (StreamId id = next - 16; id < next; id += 2) {
+    ASSERT_NE(nullptr, table.find(id));
+    EXPECT_EQ(static_cast<int>(id), **table.find(id));
+  }
+}
+
+TEST(StreamTableTest, SparseIds) {
+  Table table;
+  EXPECT_TRUE(table.insert(2, value(2)));
+  EXPECT_TRUE(table.insert(2000000002, value(3)));
+  EXPECT_TRUE(table.insert(2000000, value(4)));
+  EXPECT_EQ(3U, table.size());
+
+  EXPECT_EQ(3, **table.find(2000000002));
+  EXPECT_EQ(4, **table.find(2000000));
+  EXPECT_EQ(
+      std::vector<StreamId>({2, 2000000, 2000000002}), streamIds(table));
+
+  while (!table.empty()) {
+    EXPECT_TRUE(table.erase(table.anyStreamId()));
+  }
+  EXPECT_EQ(nullptr, table.find(2000000002));
+  EXPECT_TRUE(table.insert(2000000002, value(5)));
+  EXPECT_EQ(5, **table.find(2000000002));
+}
@@ -1,9 +1,13 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <folly/Baton.h>
 #include <folly/ExceptionWrapper.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include "rsocket/internal/SwappableEventBase.h"
 
 using SwappableEventBase = rsocket::SwappableEventBase;
@@ -185,4 +189,42 @@ TEST_F(SwappableEbTest, CanDestroySEB) {
   loop_ebs();
 }
 
+TEST(SwappableEventBaseTest, KeepsOrderAcrossConcurrentSwaps) {
+  folly::ScopedEventBaseThread threadA;
+  folly::ScopedEventBaseThread threadB;
+  SwappableEventBase seb(*threadA.getEventBase());
+
+  constexpr int kPosters = 4;
+  constexpr int kCallbacks = 10000;
+  // Only touched by the callbacks, which never run concurrently.
+  std::vector<int> last(kPosters, -1);
+  int outOfOrder = 0;
+
+  std::vector<std::thread> posters;
+  for (int poster = 0; poster < kPosters; ++poster) {
+    posters.emplace_back([&, poster] {
+      for (int i = 0; i < kCallbacks; ++i) {
+        seb.runInEventBaseThread([&, poster, i](folly::EventBase&) {
+          outOfOrder += last[poster] + 1 != i;
+          last[poster] = i;
+        });
+      }
+    });
+  }
+  for (int swap = 0; swap < 200; ++swap) {
+    seb.setEventBase(
+        swap % 2 ? *threadA.getEventBase() : *threadB.getEventBase());
+    std::this_thread::yield();
+  }
+  for (auto& poster : posters) {
+    poster.join();
+  }
+
+  folly::Baton<> done;
+  seb.runInEventBaseThread([&](folly::EventBase&) { done.post(); });
+  done.wait();
+  EXPECT_EQ(0, outOfOrder);
+  EXPECT_EQ(std::vector<int>(kPosters, kCallbacks - 1), last);
+}
+
 } /* namespace */
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/internal/TimingWheel.h"
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+TEST(TimingWheelTest, FiresInDeadlineOrder) {
+  folly::EventBase evb;
+  TimingWheel wheel(evb, 1ms, 4);
+  std::vector<int> fired;
+
+  auto const start = TimingWheel::Clock::now();
+  // more than one turn of the wheel
+  wheel.schedule(20ms, [&] { fired.push_back(20); });
+  wheel.schedule(2ms, [&] { fired.push_back(2); });
+  wheel.schedule(6ms, [&] { fired.push_back(6); });
+  EXPECT_EQ(3U, wheel.size());
+
+  evb.loop();
+  EXPECT_EQ(std::vector<int>({2, 6, 20}), fired);
+  EXPECT_GE(TimingWheel::Clock::now() - start, 20ms);
+  EXPECT_EQ(0U, wheel.size());
+}
+
+TEST(TimingWheelTest, Cancel) {
+  folly::EventBase evb;
+  TimingWheel wheel(evb, 1ms, 8);
+  bool fired = false;
+
+  auto handle = wheel.schedule(5ms, [&] { fired = true; });
+  TimingWheel::Handle second;
+  wheel.schedule(1ms, [&] {
+    // cancelling from a callback, and twice
+    wheel.cancel(second);
+    wheel.cancel(second);
+  });
+  second = wheel.schedule(3ms, [&] { fired = true; });
+  wheel.cancel(handle);
+  wheel.cancel(TimingWheel::Handle());
+
+  evb.loop();
+  EXPECT_FALSE(fired);
+  EXPECT_EQ(0U, wheel.size());
+}
+
+TEST(TimingWheelTest, CancelWhenExpiringTogether) {
+  folly::EventBase evb;
+  TimingWheel wheel(evb, 10ms, 8);
+  int fired = 0;
+
+  // Both expire in the same tick, whichever fires first cancels the other.
+  TimingWheel::Handle first, second;
+  first = wheel.schedule(1ms, [&] {
+    ++fired;
+    wheel.cancel(second);
+  });
+  second = wheel.schedule(1ms, [&] {
+    ++fired;
+    wheel.cancel(first);
+  });
+
+  evb.loop();
+  EXPECT_EQ(1, fired);
+  EXPECT_EQ(0U, wheel.size());
+}
+
+TEST(TimingWheelTest, OnePerEventBase) {
+  folly::EventBase evb1, evb2;
+  EXPECT_EQ(&TimingWheel::get(evb1), &TimingWheel::get(evb1));
+  EXPECT_NE(&TimingWheel::get(evb1), &TimingWheel::get(evb2));
+}
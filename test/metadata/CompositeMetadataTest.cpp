@@ -0,0 +1,107 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+using namespace ::rsocket;
+
+namespace {
+std::string contentOf(const CompositeMetadataEntry& entry) {
+  return entry.content.cursor().readFixedString(entry.content.length());
+}
+} // namespace
+
+TEST(CompositeMetadataTest, WellKnownMimeTypes) {
+  EXPECT_EQ(0x05, *wellKnownMimeTypeId("application/json"));
+  EXPECT_EQ(0x7E, *wellKnownMimeTypeId(kRoutingMimeType));
+  EXPECT_FALSE(wellKnownMimeTypeId("application/x-custom"));
+  EXPECT_EQ(
+      "message/x.rsocket.composite-metadata.v0", wellKnownMimeTypeName(0x7F));
+  EXPECT_TRUE(wellKnownMimeTypeName(0x50).empty());
+}
+
+TEST(CompositeMetadataTest, RoundTrip) {
+  auto metadata = CompositeMetadataBuilder()
+                      .add(kRoutingMimeType, "\x0Cmyservice.do")
+                      .add("application/x-custom", "custom")
+                      .add("text/plain", folly::StringPiece())
+                      .build();
+
+  CompositeMetadataReader reader(*metadata);
+  CompositeMetadataEntry entry;
+  ASSERT_TRUE(reader.next(entry));
+  EXPECT_EQ(kRoutingMimeType, entry.mimeType);
+  EXPECT_EQ(0x7E, *entry.wellKnownId);
+  EXPECT_EQ("\x0Cmyservice.do", contentOf(entry));
+
+  ASSERT_TRUE(reader.next(entry));
+  EXPECT_EQ("application/x-custom", entry.mimeType);
+  EXPECT_FALSE(entry.wellKnownId);
+  EXPECT_EQ("custom", contentOf(entry));
+
+  ASSERT_TRUE(reader.next(entry));
+  EXPECT_EQ("text/plain", entry.mimeType);
+  EXPECT_EQ(0U, entry.content.length());
+
+  EXPECT_FALSE(reader.next(entry));
+}
+
+TEST(CompositeMetadataTest, ContentIsNotCopied) {
+  auto content = folly::IOBuf::copyBuffer("tracing");
+  auto const bytes = content->data();
+  auto metadata =
+      CompositeMetadataBuilder()
+          .add("message/x.rsocket.tracing-zipkin.v0", std::move(content))
+          .build();
+
+  auto found = CompositeMetadataReader(*metadata).find(
+      "message/x.rsocket.tracing-zipkin.v0");
+  ASSERT_TRUE(found);
+  auto range = found->contiguousBytes();
+  ASSERT_TRUE(range);
+  EXPECT_EQ(bytes, range->data());
+  EXPECT_EQ(7U, range->size());
+
+  EXPECT_FALSE(CompositeMetadataReader(*metadata).find(kRoutingMimeType));
+}
+
+TEST(CompositeMetadataTest, EntriesStraddlingBuffers) {
+  auto metadata = CompositeMetadataBuilder()
+                      .add("application/x-first", "first")
+                      .add("application/x-second", "second")
+                      .build();
+  metadata->coalesce();
+
+  // split the buffer in the middle of the mime type of the second entry
+  auto head = folly::IOBuf::copyBuffer(metadata->data(), 30);
+  head->prependChain(folly::IOBuf::copyBuffer(
+      metadata->data() + 30, metadata->length() - 30));
+
+  CompositeMetadataReader reader(*head);
+  CompositeMetadataEntry entry;
+  ASSERT_TRUE(reader.next(entry));
+  EXPECT_EQ("application/x-first", entry.mimeType);
+  EXPECT_EQ("first", contentOf(entry));
+  ASSERT_TRUE(reader.next(entry));
+  EXPECT_EQ("application/x-second", entry.mimeType);
+  EXPECT_EQ("second", contentOf(entry));
+  EXPECT_FALSE(reader.next(entry));
+}
+
+TEST(CompositeMetadataTest, Truncated) {
+  auto metadata =
+      CompositeMetadataBuilder().add("application/json", "{}").build();
+  metadata->coalesce();
+  auto truncated =
+      folly::IOBuf::copyBuffer(metadata->data(), metadata->length() - 1);
+
+  CompositeMetadataReader reader(*truncated);
+  CompositeMetadataEntry entry;
+  EXPECT_THROW(reader.next(entry), std::runtime_error);
+
+  EXPECT_THROW(
+      CompositeMetadataBuilder().add("", "content"), std::invalid_argument);
+}
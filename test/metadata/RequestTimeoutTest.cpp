@@ -0,0 +1,37 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/RequestTimeout.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+using namespace ::rsocket;
+
+TEST(RequestTimeoutTest, AppendedToCompositeMetadata) {
+  Payload payload(
+      "data",
+      CompositeMetadataBuilder()
+          .add(kRoutingMimeType, "\x05route")
+          .build()
+          ->moveToFbString()
+          .toStdString());
+  addRequestTimeout(payload, std::chrono::milliseconds(1500));
+
+  CompositeMetadataReader reader(*payload.metadata);
+  EXPECT_TRUE(reader.find(kRoutingMimeType));
+  EXPECT_EQ(
+      std::chrono::milliseconds(1500), findRequestTimeout(*payload.metadata));
+}
+
+TEST(RequestTimeoutTest, NoTimeout) {
+  Payload payload("data");
+  addRequestTimeout(payload, std::chrono::milliseconds(-1));
+  EXPECT_EQ(
+      std::chrono::milliseconds(0), findRequestTimeout(*payload.metadata));
+
+  auto routing = CompositeMetadataBuilder().add(kRoutingMimeType, "").build();
+  EXPECT_FALSE(findRequestTimeout(*routing));
+  // not composite metadata
+  EXPECT_FALSE(findRequestTimeout(*folly::IOBuf::copyBuffer("\xFF\x00")));
+}
@@ -0,0 +1,42 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/StreamStripe.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+using namespace ::rsocket;
+
+TEST(StreamStripeTest, AppendedToCompositeMetadata) {
+  Payload payload(
+      "data",
+      CompositeMetadataBuilder()
+          .add(kRoutingMimeType, "\x05route")
+          .build()
+          ->moveToFbString()
+          .toStdString());
+  addStreamStripe(payload, StreamStripe{2, 3});
+
+  CompositeMetadataReader reader(*payload.metadata);
+  EXPECT_TRUE(reader.find(kRoutingMimeType));
+  auto stripe = findStreamStripe(*payload.metadata);
+  ASSERT_TRUE(stripe);
+  EXPECT_EQ(2U, stripe->index);
+  EXPECT_EQ(3U, stripe->count);
+}
+
+TEST(StreamStripeTest, InvalidStripes) {
+  Payload payload("data");
+  addStreamStripe(payload, StreamStripe{3, 3});
+  EXPECT_FALSE(findStreamStripe(*payload.metadata));
+
+  Payload none("data");
+  addStreamStripe(none, StreamStripe{0, 0});
+  EXPECT_FALSE(findStreamStripe(*none.metadata));
+
+  auto routing = CompositeMetadataBuilder().add(kRoutingMimeType, "").build();
+  EXPECT_FALSE(findStreamStripe(*routing));
+  // not composite metadata
+  EXPECT_FALSE(findStreamStripe(*folly::IOBuf::copyBuffer("\xFF\x00")));
+}
@@ -0,0 +1,59 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/metadata/CompositeMetadata.h"
+#include "rsocket/metadata/TraceContext.h"
+#include "rsocket/metadata/WellKnownMimeTypes.h"
+
+using namespace ::rsocket;
+
+TEST(TraceContextTest, NewTraceAndChild) {
+  auto root = TraceContext::newTrace(true);
+  EXPECT_TRUE(root.sampled);
+  EXPECT_NE(0U, root.spanId);
+  EXPECT_FALSE(root.parentSpanId);
+
+  auto child = root.newChild();
+  EXPECT_EQ(root.traceIdHigh, child.traceIdHigh);
+  EXPECT_EQ(root.traceIdLow, child.traceIdLow);
+  EXPECT_NE(root.spanId, child.spanId);
+  EXPECT_EQ(root.spanId, child.parentSpanId);
+  EXPECT_TRUE(child.sampled);
+
+  EXPECT_FALSE(TraceContext::newTrace(false).newChild().sampled);
+}
+
+TEST(TraceContextTest, AppendedToCompositeMetadata) {
+  Payload payload(
+      "data",
+      CompositeMetadataBuilder()
+          .add(kRoutingMimeType, "\x05route")
+          .build()
+          ->moveToFbString()
+          .toStdString());
+  auto const context = TraceContext::newTrace(true).newChild();
+  addTraceContext(payload, context);
+
+  CompositeMetadataReader reader(*payload.metadata);
+  EXPECT_TRUE(reader.find(kRoutingMimeType));
+  EXPECT_EQ(context, findTraceContext(*payload.metadata));
+}
+
+TEST(TraceContextTest, WithoutParent) {
+  Payload payload("data");
+  auto const context = TraceContext::newTrace(false);
+  addTraceContext(payload, context);
+  EXPECT_EQ(context, findTraceContext(*payload.metadata));
+}
+
+TEST(TraceContextTest, NoTraceContext) {
+  auto routing = CompositeMetadataBuilder().add(kRoutingMimeType, "").build();
+  EXPECT_FALSE(findTraceContext(*routing));
+  // truncated ids
+  auto truncated =
+      CompositeMetadataBuilder().add(kTraceContextMimeType, "\x01\x02").build();
+  EXPECT_FALSE(findTraceContext(*truncated));
+  // not composite metadata
+  EXPECT_FALSE(findTraceContext(*folly::IOBuf::copyBuffer("\xFF\x00")));
+}
@@ -0,0 +1,242 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/statemachine/StreamRequester.h"
+#include "rsocket/statemachine/StreamsWriter.h"
+
+using namespace rsocket;
+
+namespace {
+
+class RecordingWriter : public StreamsWriter {
+ public:
+  void writeNewStream(StreamId, StreamType, uint32_t n, Payload, bool)
+      override {
+    initialRequestN = n;
+  }
+
+  void writeRequestN(Frame_REQUEST_N&& frame) override {
+    requestNs.push_back(frame.requestN_);
+  }
+
+  void writeCancel(Frame_CANCEL&&) override {}
+  void writePayload(Frame_PAYLOAD&&) override {}
+  void writeError(Frame_ERROR&&) override {}
+  void onStreamClosed(StreamId, StreamCompletionSignal) override {}
+
+  uint32_t initialRequestN{0};
+  std::vector<uint32_t> requestNs;
+};
+
+/// Keeps `window` payloads requested by requesting one more per payload.
+class WindowSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  explicit WindowSubscriber(int64_t window) : window_(window) {}
+
+  using yarpl::flowable::BaseSubscriber<Payload>::cancel;
+
+ private:
+  void onSubscribeImpl() override {
+    this->request(window_);
+  }
+
+  void onNextImpl(Payload) override {
+    this->request(1);
+  }
+
+  void onCompleteImpl() override {}
+  void onErrorImpl(folly::exception_wrapper) override {}
+
+  const int64_t window_;
+};
+
+/// Requests only when told to.
+class ManualSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  using yarpl::flowable::BaseSubscriber<Payload>::cancel;
+  using yarpl::flowable::BaseSubscriber<Payload>::request;
+
+  size_t received{0};
+  bool completed{false};
+
+ private:
+  void onSubscribeImpl() override {}
+
+  void onNextImpl(Payload) override {
+    ++received;
+  }
+
+  void onCompleteImpl() override {
+    completed = true;
+  }
+  void onErrorImpl(folly::exception_wrapper) override {}
+};
+
+class ConsumerBaseTest : public testing::Test {
+ protected:
+  void subscribe(RequestNBatching batching, int64_t window) {
+    requester_ =
+        yarpl::make_ref<StreamRequester>(writer_, 1, Payload("request"));
+    requester_->setRequestNBatching(batching);
+    subscriber_ = yarpl::make_ref<WindowSubscriber>(window);
+    requester_->subscribe(subscriber_);
+  }
+
+  void receive(size_t payloads) {
+    for (size_t i = 0; i < payloads; ++i) {
+      yarpl::Reference<StreamStateMachineBase> stream = requester_;
+      stream->handlePayload(Payload("response"), false, true);
+    }
+  }
+
+  void TearDown() override {
+    if (subscriber_) {
+      subscriber_->cancel();
+    }
+  }
+
+  std::shared_ptr<RecordingWriter> writer_{
+      std::make_shared<RecordingWriter>()};
+  yarpl::Reference<StreamRequester> requester_;
+  yarpl::Reference<WindowSubscriber> subscriber_;
+};
+} // namespace
+
+TEST_F(ConsumerBaseTest, RequestNPerPayloadByDefault) {
+  subscribe(RequestNBatching(), 8);
+  receive(4);
+  EXPECT_EQ(std::vector<uint32_t>({1, 1, 1, 1}), writer_->requestNs);
+}
+
+TEST_F(ConsumerBaseTest, LowWaterMark) {
+  RequestNBatching batching;
+  batching.lowWaterMark = 2;
+  subscribe(batching, 8);
+
+  // The peer may send 8 payloads.  Credit is held back until it can only send
+  // 2 more.
+  receive(5);
+  EXPECT_TRUE(writer_->requestNs.empty());
+  receive(1);
+  EXPECT_EQ(std::vector<uint32_t>({5}), writer_->requestNs);
+
+  receive(5);
+  EXPECT_EQ(std::vector<uint32_t>({5, 5}), writer_->requestNs);
+}
+
+TEST_F(ConsumerBaseTest, Unbounded) {
+  // More than 32 bits of allowance, the peer is topped up once per REQUEST_N
+  // worth of payloads.
+  subscribe(RequestNBatching(), std::numeric_limits<int64_t>::max());
+  EXPECT_EQ(
+      std::vector<uint32_t>({Frame_REQUEST_N::kMaxRequestN}),
+      writer_->requestNs);
+  receive(5);
+  EXPECT_EQ(1u, writer_->requestNs.size());
+  EXPECT_EQ(StreamAllowance::max(), requester_->getConsumerAllowance());
+}
+
+TEST_F(ConsumerBaseTest, PerLoopIteration) {
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+
+  RequestNBatching batching;
+  batching.perLoopIteration = true;
+  subscribe(batching, 8);
+
+  receive(3);
+  EXPECT_TRUE(writer_->requestNs.empty());
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint32_t>({3}), writer_->requestNs);
+
+  receive(1);
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint32_t>({3, 1}), writer_->requestNs);
+
+  folly::EventBaseManager::get()->clearEventBase();
+}
+
+TEST_F(ConsumerBaseTest, PrefetchesAhead) {
+  AdaptiveRequestN adaptive;
+  adaptive.minWindow = 4;
+  adaptive.maxWindow = 64;
+  requester_ = yarpl::make_ref<StreamRequester>(writer_, 1, Payload("request"));
+  requester_->setWindowTuner(std::make_shared<RequestNWindowTuner>(adaptive));
+  auto subscriber = yarpl::make_ref<ManualSubscriber>();
+  requester_->subscribe(subscriber);
+
+  // The REQUEST_STREAM carries the window along with the first request.
+  subscriber->request(1);
+  EXPECT_EQ(5u, writer_->initialRequestN);
+
+  // The payloads beyond the request are held back, so is the completion.
+  receive(4);
+  yarpl::Reference<StreamStateMachineBase> stream = requester_;
+  stream->handlePayload(Payload("response"), true, true);
+  EXPECT_EQ(1u, subscriber->received);
+  EXPECT_FALSE(subscriber->completed);
+  EXPECT_TRUE(writer_->requestNs.empty());
+
+  subscriber->request(2);
+  EXPECT_EQ(3u, subscriber->received);
+  EXPECT_FALSE(subscriber->completed);
+  subscriber->request(10);
+  EXPECT_EQ(5u, subscriber->received);
+  EXPECT_TRUE(subscriber->completed);
+  // Nothing is requested once the stream completed.
+  EXPECT_TRUE(writer_->requestNs.empty());
+}
+
+TEST_F(ConsumerBaseTest, PrefetchTopsUp) {
+  AdaptiveRequestN adaptive;
+  adaptive.minWindow = 4;
+  adaptive.maxWindow = 64;
+  requester_ = yarpl::make_ref<StreamRequester>(writer_, 1, Payload("request"));
+  requester_->setWindowTuner(std::make_shared<RequestNWindowTuner>(adaptive));
+  auto subscriber = yarpl::make_ref<ManualSubscriber>();
+  requester_->subscribe(subscriber);
+  subscriber->request(2);
+  EXPECT_EQ(6u, writer_->initialRequestN);
+
+  // The peer is still granted the window.
+  receive(2);
+  EXPECT_EQ(2u, subscriber->received);
+  EXPECT_TRUE(writer_->requestNs.empty());
+  // The window is buffered, and granted again as the subscriber takes it.
+  receive(4);
+  EXPECT_TRUE(writer_->requestNs.empty());
+  subscriber->request(3);
+  EXPECT_EQ(5u, subscriber->received);
+  EXPECT_EQ(std::vector<uint32_t>({3}), writer_->requestNs);
+  subscriber->cancel();
+}
+
+TEST(RequestNWindowTunerTest, GrowsWithConsumption) {
+  AdaptiveRequestN adaptive;
+  adaptive.minWindow = 4;
+  adaptive.maxWindow = 64;
+  RequestNWindowTuner tuner(adaptive);
+  EXPECT_EQ(4u, tuner.initialWindow());
+
+  // Without a round trip time the window stays.
+  EXPECT_EQ(4u, tuner.nextWindow(4, 100, std::chrono::milliseconds(10)));
+
+  tuner.addRoundTrip(std::chrono::milliseconds(10));
+  // 10 payloads per round trip, twice that is needed in flight.
+  EXPECT_EQ(20u, tuner.nextWindow(4, 10, std::chrono::milliseconds(10)));
+  EXPECT_EQ(20u, tuner.initialWindow());
+  // Windows don't shrink, and are bounded.
+  EXPECT_EQ(20u, tuner.nextWindow(20, 1, std::chrono::milliseconds(10)));
+  EXPECT_EQ(64u, tuner.nextWindow(20, 1000, std::chrono::milliseconds(10)));
+
+  tuner.setMemoryPressure(true);
+  EXPECT_EQ(4u, tuner.effectiveWindow(64));
+  EXPECT_EQ(64u, tuner.nextWindow(64, 1000, std::chrono::milliseconds(1)));
+  tuner.setMemoryPressure(false);
+  EXPECT_EQ(64u, tuner.effectiveWindow(64));
+}
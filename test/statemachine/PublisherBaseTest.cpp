@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/statemachine/PublisherBase.h"
+#include "yarpl/test_utils/Mocks.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+constexpr int64_t kMax = PublisherBase::kMaxProducerAllowance;
+
+using MockSubscription = StrictMock<yarpl::mocks::MockSubscription>;
+
+void produce(PublisherBase& publisher, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    publisher.checkPublisherOnNext();
+    publisher.requestFromProducer();
+  }
+}
+} // namespace
+
+TEST(PublisherBaseTest, AllowanceHandedOutInBatches) {
+  auto subscription = yarpl::make_ref<MockSubscription>();
+  PublisherBase publisher(1000);
+
+  EXPECT_CALL(*subscription, request_(kMax));
+  publisher.publisherSubscribe(subscription);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  // the producer is topped up once it has used half of its allowance
+  EXPECT_CALL(*subscription, request_(kMax / 2));
+  produce(publisher, kMax / 2);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  EXPECT_CALL(*subscription, cancel_());
+  publisher.terminatePublisher();
+}
+
+TEST(PublisherBaseTest, PausedWhileNotWritable) {
+  auto subscription = yarpl::make_ref<MockSubscription>();
+  PublisherBase publisher(0);
+  publisher.publisherSubscribe(subscription);
+
+  publisher.publisherWritabilityChanged(false);
+  publisher.processRequestN(10);
+  publisher.processRequestN(5);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  EXPECT_CALL(*subscription, request_(15));
+  publisher.publisherWritabilityChanged(true);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  EXPECT_CALL(*subscription, cancel_());
+  publisher.terminatePublisher();
+}
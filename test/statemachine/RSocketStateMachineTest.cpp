@@ -0,0 +1,309 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <functional>
+
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/RSocketConnectionEvents.h"
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameTransport.h"
+#include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/statemachine/RSocketStateMachine.h"
+
+using namespace rsocket;
+using namespace yarpl;
+using namespace yarpl::flowable;
+
+namespace {
+
+/// Keeps the frames the state machine sends, so that the tests can feed it
+/// the frames of the peer through processFrame().
+class RecordingFrameTransport : public FrameTransport {
+ public:
+  void setFrameProcessor(std::shared_ptr<FrameProcessor> processor) override {
+    processor_ = std::move(processor);
+  }
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    sent.push_back(std::move(frame));
+  }
+
+  void close() override {
+    processor_.reset();
+  }
+
+  void closeWithError(folly::exception_wrapper) override {
+    processor_.reset();
+  }
+
+  DuplexConnection* getConnection() override {
+    return nullptr;
+  }
+
+  void receive(std::unique_ptr<folly::IOBuf> frame) {
+    ASSERT_TRUE(processor_);
+    processor_->processFrame(std::move(frame));
+  }
+
+  std::vector<std::unique_ptr<folly::IOBuf>> sent;
+
+ private:
+  std::shared_ptr<FrameProcessor> processor_;
+};
+
+/// Collects the payloads of the requester of a channel, and counts the
+/// credits it grants and the request streams terminated.
+class ChannelResponder : public RSocketResponder {
+ public:
+  Reference<Flowable<Payload>> handleRequestChannel(
+      Payload,
+      Reference<Flowable<Payload>> requests,
+      StreamId) override {
+    requests->subscribe(
+        [this](Payload payload) {
+          received.push_back(payload.moveDataToString());
+        },
+        [this](folly::exception_wrapper) { ++terminated; },
+        [this] { ++terminated; });
+    return Flowable<Payload>::create([this](auto, int64_t n) {
+      requested += n;
+      return std::make_tuple(int64_t{0}, false);
+    });
+  }
+
+  std::vector<std::string> received;
+  int64_t requested{0};
+  size_t terminated{0};
+};
+
+class ClosedEvents : public RSocketConnectionEvents {
+ public:
+  explicit ClosedEvents(std::function<void()> onClosed)
+      : onClosed_(std::move(onClosed)) {}
+
+  void onClosed(const folly::exception_wrapper&) override {
+    onClosed_();
+  }
+
+ private:
+  std::function<void()> onClosed_;
+};
+
+std::shared_ptr<RSocketStateMachine> makeServer(
+    folly::EventBase& evb,
+    std::shared_ptr<RSocketResponder> responder,
+    Reference<FrameTransport> transport,
+    std::shared_ptr<RSocketConnectionEvents> events =
+        std::make_shared<RSocketConnectionEvents>(),
+    SetupParameters setupParams = SetupParameters()) {
+  auto machine = std::make_shared<RSocketStateMachine>(
+      std::move(responder),
+      std::make_unique<KeepaliveTimer>(std::chrono::seconds{10}, evb),
+      RSocketMode::SERVER,
+      RSocketStats::noop(),
+      std::move(events),
+      nullptr /* resumeManager */,
+      nullptr /* coldResumeHandler */
+      );
+  machine->connectServer(std::move(transport), setupParams);
+  return machine;
+}
+} // namespace
+
+TEST(RSocketStateMachine, RequestNBetweenFragments) {
+  folly::EventBase evb;
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  auto machine = makeServer(evb, responder, transport);
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+
+  transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+      1, FrameFlags::EMPTY, 10, Payload("initial"))));
+  transport->receive(serializer->serializeOut(Frame_PAYLOAD(
+      1, FrameFlags::NEXT | FrameFlags::FOLLOWS, Payload("hel"))));
+  // The requester asks for more in the middle of its fragmented payload.
+  transport->receive(serializer->serializeOut(Frame_REQUEST_N(1, 5)));
+  transport->receive(serializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload("lo"))));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+
+  EXPECT_EQ(std::vector<std::string>({"hello"}), responder->received);
+  EXPECT_EQ(15, responder->requested);
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
+
+TEST(RSocketStateMachine, RequestNBetweenFragmentsOfRequest) {
+  folly::EventBase evb;
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  auto machine = makeServer(evb, responder, transport);
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+
+  transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+      1, FrameFlags::FOLLOWS, 10, Payload("init"))));
+  // The stream isn't open yet, the credits go with the request.
+  transport->receive(serializer->serializeOut(Frame_REQUEST_N(1, 5)));
+  transport->receive(serializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::EMPTY, Payload("ial"))));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+
+  EXPECT_EQ(15, responder->requested);
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
+
+TEST(RSocketStateMachine, FragmentsPastMaxFrameLength) {
+  folly::EventBase evb;
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  size_t closed = 0;
+  SetupParameters setupParams;
+  setupParams.maxFrameLength = 10;
+  auto machine = makeServer(
+      evb,
+      responder,
+      transport,
+      std::make_shared<ClosedEvents>([&] { ++closed; }),
+      std::move(setupParams));
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+
+  transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+      1, FrameFlags::FOLLOWS, 10, Payload("initial"))));
+  EXPECT_EQ(0U, closed);
+  transport->receive(serializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::FOLLOWS, Payload("ly"))));
+  EXPECT_EQ(0U, closed);
+  transport->receive(serializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::EMPTY, Payload(" too long"))));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+
+  EXPECT_EQ(1U, closed);
+  EXPECT_EQ(0, responder->requested);
+  ASSERT_FALSE(transport->sent.empty());
+  Frame_ERROR error;
+  ASSERT_TRUE(
+      serializer->deserializeFrom(error, std::move(transport->sent.back())));
+  EXPECT_EQ(ErrorCode::CONNECTION_ERROR, error.errorCode_);
+}
+
+TEST(RSocketStateMachine, UndecompressableRequest) {
+  folly::EventBase evb;
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  size_t closed = 0;
+  SetupParameters setupParams;
+  setupParams.compressionRequested = true;
+  auto machine = makeServer(
+      evb,
+      responder,
+      transport,
+      std::make_shared<ClosedEvents>([&] { ++closed; }),
+      std::move(setupParams));
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+
+  // The server accepts the compressed payloads of the client first.
+  ASSERT_EQ(1U, transport->sent.size());
+  Frame_METADATA_PUSH accepted;
+  ASSERT_TRUE(serializer->deserializeFrom(
+      accepted, std::move(transport->sent.front())));
+  ASSERT_TRUE(accepted.metadata_);
+  EXPECT_TRUE(hasPayloadCompressionEntry(*accepted.metadata_));
+
+  // Compressed with a codec which doesn't exist.
+  transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+      1, FrameFlags::COMPRESSED, 10, Payload("\x7f" "data"))));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+
+  // Only the stream fails.
+  EXPECT_EQ(0U, closed);
+  EXPECT_EQ(0, responder->requested);
+  ASSERT_FALSE(transport->sent.empty());
+  Frame_ERROR error;
+  ASSERT_TRUE(
+      serializer->deserializeFrom(error, std::move(transport->sent.back())));
+  EXPECT_EQ(1U, error.header_.streamId);
+  EXPECT_EQ(ErrorCode::INVALID, error.errorCode_);
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
+
+TEST(RSocketStateMachine, CompressedFlagWithoutCompression) {
+  folly::EventBase evb;
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  auto machine = makeServer(evb, responder, transport);
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+  EXPECT_TRUE(transport->sent.empty());
+
+  // The flag is a reserved bit without the extension.
+  transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+      1, FrameFlags::EMPTY, 10, Payload("initial"))));
+  transport->receive(serializer->serializeOut(Frame_PAYLOAD(
+      1, FrameFlags::NEXT | FrameFlags::COMPRESSED, Payload("\x7f" "data"))));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+
+  EXPECT_EQ(std::vector<std::string>({"\x7f" "data"}), responder->received);
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
+
+TEST(RSocketStateMachine, CloseManyStreams) {
+  // More streams than are terminated in a single loop iteration.
+  constexpr size_t kStreams = 2500;
+
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+  auto responder = std::make_shared<ChannelResponder>();
+  auto transport = make_ref<RecordingFrameTransport>();
+  size_t closed = 0;
+  size_t terminatedWhenClosed = 0;
+  auto machine = makeServer(
+      evb,
+      responder,
+      transport,
+      std::make_shared<ClosedEvents>([&] {
+        ++closed;
+        terminatedWhenClosed = responder->terminated;
+      }));
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Current());
+
+  for (size_t i = 0; i < kStreams; ++i) {
+    transport->receive(serializer->serializeOut(Frame_REQUEST_CHANNEL(
+        2 * i + 1, FrameFlags::EMPTY, 1, Payload("initial"))));
+  }
+
+  std::shared_ptr<FrameProcessor> processor = machine;
+  machine->close({}, StreamCompletionSignal::CONNECTION_END);
+  EXPECT_LT(responder->terminated, kStreams);
+  EXPECT_EQ(0U, closed);
+
+  // The frames arriving while the streams are being closed are discarded.
+  for (size_t i = 0; i < kStreams; ++i) {
+    processor->processFrame(serializer->serializeOut(
+        Frame_PAYLOAD(2 * i + 1, FrameFlags::NEXT, Payload("late"))));
+  }
+
+  machine.reset();
+  processor.reset();
+  evb.loop();
+
+  EXPECT_EQ(kStreams, responder->terminated);
+  EXPECT_TRUE(responder->received.empty());
+  EXPECT_EQ(1U, closed);
+  EXPECT_EQ(kStreams, terminatedWhenClosed);
+
+  folly::EventBaseManager::get()->clearEventBase();
+}
@@ -0,0 +1,153 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <string>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/statemachine/StreamResponder.h"
+#include "rsocket/statemachine/StreamsWriter.h"
+#include "yarpl/Flowable.h"
+
+using namespace rsocket;
+
+namespace {
+
+class RecordingWriter : public StreamsWriter {
+ public:
+  void writeNewStream(StreamId, StreamType, uint32_t, Payload, bool) override {}
+  void writeRequestN(Frame_REQUEST_N&&) override {}
+  void writeCancel(Frame_CANCEL&&) override {}
+
+  void writePayload(Frame_PAYLOAD&& frame) override {
+    frames.push_back(std::move(frame));
+  }
+
+  void writePayloads(std::vector<Frame_PAYLOAD> batch) override {
+    ++batches;
+    for (auto& frame : batch) {
+      frames.push_back(std::move(frame));
+    }
+  }
+
+  void writeError(Frame_ERROR&&) override {}
+  void onStreamClosed(StreamId, StreamCompletionSignal) override {}
+
+  std::vector<Frame_PAYLOAD> frames;
+  int batches{0};
+};
+
+/// Serializes a payload frame to its data, and records what is written in
+/// order: the data of the payloads, "complete", and the serialized frames
+/// written together joined by commas.
+class SerializingWriter : public RecordingWriter {
+ public:
+  void writePayload(Frame_PAYLOAD&& frame) override {
+    writes.push_back(
+        frame.header_.flagsComplete() ? "complete"
+                                      : frame.payload_.moveDataToString());
+  }
+
+  std::unique_ptr<folly::IOBuf> serializePayload(
+      Frame_PAYLOAD& frame) override {
+    ++serialized;
+    return folly::IOBuf::copyBuffer(frame.payload_.moveDataToString());
+  }
+
+  void writeSerializedPayloads(
+      StreamId,
+      std::vector<std::unique_ptr<folly::IOBuf>> batch) override {
+    std::vector<std::string> data;
+    for (auto& frame : batch) {
+      data.push_back(frame->moveToFbString().toStdString());
+    }
+    writes.push_back(folly::join(",", data));
+  }
+
+  std::vector<std::string> writes;
+  int serialized{0};
+};
+
+/// Emits "0", "1", ... up to `count` payloads, then completes.
+yarpl::Reference<yarpl::flowable::Flowable<Payload>> numbers(int64_t count) {
+  auto next = std::make_shared<int64_t>(0);
+  return yarpl::flowable::Flowable<Payload>::create(
+      [next, count](auto subscriber, int64_t requested) {
+        int64_t emitted = 0;
+        for (; emitted < requested && *next < count; ++emitted) {
+          subscriber->onNext(Payload(folly::to<std::string>((*next)++)));
+        }
+        if (*next == count) {
+          subscriber->onComplete();
+        }
+        return std::make_tuple(emitted, *next == count);
+      });
+}
+
+} // namespace
+
+TEST(StreamResponderTest, BatchWrittenTogether) {
+  auto writer = std::make_shared<RecordingWriter>();
+  auto responder = yarpl::make_ref<StreamResponder>(writer, 1, 3);
+
+  auto flowable = yarpl::flowable::Flowable<Payload>::create(
+      [](auto subscriber, int64_t requested) {
+        std::vector<Payload> payloads;
+        for (int64_t i = 0; i < requested; ++i) {
+          payloads.emplace_back("payload");
+        }
+        subscriber->onNextBatch(std::move(payloads));
+        subscriber->onComplete();
+        return std::make_tuple(requested, true);
+      });
+  flowable->subscribe(responder);
+
+  EXPECT_EQ(1, writer->batches);
+  // the three payloads and the frame completing the stream
+  ASSERT_EQ(4U, writer->frames.size());
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(1U, writer->frames[i].header_.streamId);
+    EXPECT_TRUE(!!(writer->frames[i].header_.flags & FrameFlags::NEXT));
+    EXPECT_EQ("payload", writer->frames[i].payload_.moveDataToString());
+  }
+  EXPECT_TRUE(writer->frames[3].header_.flagsComplete());
+}
+
+TEST(StreamResponderTest, SerializesAheadOfRequestN) {
+  auto writer = std::make_shared<SerializingWriter>();
+  auto responder = yarpl::make_ref<StreamResponder>(writer, 1, 2);
+  responder->setSerializeAhead(3);
+
+  numbers(6)->subscribe(responder);
+
+  // the payloads allowed are written, the next three are held serialized
+  EXPECT_EQ(std::vector<std::string>({"0", "1"}), writer->writes);
+  EXPECT_EQ(3, writer->serialized);
+
+  // the frames held are written at once, then the producer is asked for the
+  // remaining allowance
+  static_cast<StreamStateMachineBase&>(*responder).handleRequestN(4);
+  EXPECT_EQ(
+      std::vector<std::string>({"0", "1", "2,3,4", "5", "complete"}),
+      writer->writes);
+  EXPECT_EQ(3, writer->serialized);
+}
+
+TEST(StreamResponderTest, CompletesOnceHeldPayloadsAreWritten) {
+  auto writer = std::make_shared<SerializingWriter>();
+  auto responder = yarpl::make_ref<StreamResponder>(writer, 1, 1);
+  responder->setSerializeAhead(4);
+
+  numbers(3)->subscribe(responder);
+  EXPECT_EQ(std::vector<std::string>({"0"}), writer->writes);
+
+  static_cast<StreamStateMachineBase&>(*responder).handleRequestN(1);
+  EXPECT_EQ(std::vector<std::string>({"0", "1"}), writer->writes);
+
+  static_cast<StreamStateMachineBase&>(*responder).handleRequestN(10);
+  EXPECT_EQ(
+      std::vector<std::string>({"0", "1", "2", "complete"}), writer->writes);
+}
@@ -0,0 +1,57 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/statemachine/ChannelRequester.h"
+#include "rsocket/statemachine/ChannelResponder.h"
+#include "rsocket/statemachine/RequestResponseRequester.h"
+#include "rsocket/statemachine/RequestResponseResponder.h"
+#include "rsocket/statemachine/StreamRequester.h"
+#include "rsocket/statemachine/StreamResponder.h"
+
+using namespace rsocket;
+
+static_assert(sizeof(StreamAllowance) == sizeof(uint32_t), "");
+// The subscription, the allowances and the flags.
+static_assert(
+    sizeof(PublisherBase) <= sizeof(void*) + 2 * sizeof(uint32_t),
+    "");
+
+// There is one of these per stream, their sizes are bounded to keep the
+// memory taken by connections with many streams in check.  The bounds count
+// the words each class adds to its bases: a vtable pointer per interface, and
+// its members.
+TEST(StreamSizeTest, Sizes) {
+  constexpr size_t kWord = sizeof(void*);
+
+  // The vtable pointer, the writer, the id and the flag.
+  EXPECT_LE(
+      sizeof(StreamStateMachineBase), sizeof(yarpl::Refcounted) + 4 * kWord);
+  // Subscription and enable_get_ref, the subscriber, the allowances, the
+  // batching, the prefetch and the flags.
+  EXPECT_LE(sizeof(ConsumerBase), sizeof(StreamStateMachineBase) + 8 * kWord);
+
+  // The initial payload and the flag.
+  EXPECT_LE(sizeof(StreamRequester), sizeof(ConsumerBase) + 3 * kWord);
+  // Subscriber, the held payloads and their counters.
+  EXPECT_LE(
+      sizeof(StreamResponder),
+      sizeof(StreamStateMachineBase) + sizeof(PublisherBase) + 6 * kWord);
+  // Subscriber, the initial allowance and the flag.
+  EXPECT_LE(
+      sizeof(ChannelRequester),
+      sizeof(ConsumerBase) + sizeof(PublisherBase) + 3 * kWord);
+  // Subscriber.
+  EXPECT_LE(
+      sizeof(ChannelResponder),
+      sizeof(ConsumerBase) + sizeof(PublisherBase) + 2 * kWord);
+  // SingleSubscription and enable_get_ref, the state, the observer or the
+  // promise, and the initial payload.
+  EXPECT_LE(
+      sizeof(RequestResponseRequester),
+      sizeof(StreamStateMachineBase) + 9 * kWord);
+  // SingleObserver, the state and the subscription.
+  EXPECT_LE(
+      sizeof(RequestResponseResponder),
+      sizeof(StreamStateMachineBase) + 5 * kWord);
+}
@@ -34,3 +34,97 @@ TEST_F(StreamStateTest, StatsUpdatedInDtor) {
       folly::IOBuf::copyBuffer(std::string(frameSize, 'x')));
   EXPECT_CALL(stats_, streamBufferChanged(-1, -frameSize));
 }
+
+TEST_F(StreamStateTest, PendingFramesInPriorityOrder) {
+  EXPECT_CALL(stats_, streamBufferChanged(1, _)).Times(3);
+  state_.setStreamPriority(
+      3, StreamPriority(StreamPriority::Class::INTERACTIVE));
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("bulk"), 1);
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("rr"), 3);
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("lease"));
+
+  EXPECT_CALL(stats_, streamBufferChanged(-3, -11));
+  auto frames = state_.moveOutputPendingFrames();
+  ASSERT_EQ(3U, frames.size());
+  EXPECT_EQ("lease", frames[0]->moveToFbString().toStdString());
+  EXPECT_EQ("rr", frames[1]->moveToFbString().toStdString());
+  EXPECT_EQ("bulk", frames[2]->moveToFbString().toStdString());
+}
+
+TEST_F(StreamStateTest, DropOldestStream) {
+  PendingFrameLimits limits;
+  limits.maxFrames = 2;
+  limits.policy = PendingFrameLimits::Policy::DROP_OLDEST_STREAM;
+  state_.setPendingFrameLimits(limits);
+
+  EXPECT_CALL(stats_, streamBufferChanged(1, _)).Times(3);
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("keepalive"));
+  EXPECT_EQ(0U, state_.dropOldestOutputPendingStream());
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("b0"), 3);
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("c0"), 5);
+  EXPECT_TRUE(state_.isOutputPendingFull());
+
+  EXPECT_CALL(stats_, streamBufferChanged(-1, -2));
+  EXPECT_EQ(3U, state_.dropOldestOutputPendingStream());
+  EXPECT_FALSE(state_.isOutputPendingFull());
+
+  EXPECT_CALL(stats_, streamBufferChanged(-2, -11));
+  auto frames = state_.moveOutputPendingFrames();
+  ASSERT_EQ(2U, frames.size());
+  EXPECT_EQ("keepalive", frames[0]->moveToFbString().toStdString());
+  EXPECT_EQ("c0", frames[1]->moveToFbString().toStdString());
+}
+
+TEST_F(StreamStateTest, SpillToFile) {
+  PendingFrameLimits limits;
+  limits.maxBytes = 4;
+  limits.policy = PendingFrameLimits::Policy::SPILL_TO_FILE;
+  state_.setPendingFrameLimits(limits);
+
+  EXPECT_CALL(stats_, streamBufferChanged(1, _)).Times(3);
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("a0a0"), 1);
+  EXPECT_TRUE(state_.isOutputPendingFull());
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("a1"), 1);
+  // the keepalive queues up behind the spilled frame
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("keepalive"));
+
+  EXPECT_CALL(stats_, streamBufferChanged(-1, -4));
+  EXPECT_EQ("a0a0", state_.dequeueOutputPendingFrame()->moveToFbString());
+  EXPECT_FALSE(state_.isOutputPendingFull());
+  EXPECT_CALL(stats_, streamBufferChanged(-1, -2));
+  EXPECT_EQ("a1", state_.dequeueOutputPendingFrame()->moveToFbString());
+  EXPECT_CALL(stats_, streamBufferChanged(-1, -9));
+  EXPECT_EQ("keepalive", state_.dequeueOutputPendingFrame()->moveToFbString());
+  EXPECT_EQ(nullptr, state_.dequeueOutputPendingFrame());
+}
+
+TEST_F(StreamStateTest, LatestMetadataPushWins) {
+  EXPECT_CALL(stats_, streamBufferChanged(1, _)).Times(3);
+  state_.enqueueOutputPendingMetadataPush(
+      folly::IOBuf::copyBuffer("config1"), "config");
+  state_.enqueueOutputPendingMetadataPush(
+      folly::IOBuf::copyBuffer("routes1"), "routes");
+  state_.enqueueOutputPendingFrame(folly::IOBuf::copyBuffer("keepalive"));
+
+  // replaced in place, only the length changes
+  EXPECT_CALL(stats_, streamBufferChanged(0, 2));
+  state_.enqueueOutputPendingMetadataPush(
+      folly::IOBuf::copyBuffer("config222"), "config");
+  EXPECT_EQ(3U, state_.outputPendingFrames());
+  EXPECT_EQ(25U, state_.outputPendingBytes());
+
+  EXPECT_CALL(stats_, streamBufferChanged(-1, -9));
+  EXPECT_EQ("config222", state_.dequeueOutputPendingFrame()->moveToFbString());
+
+  // the written one isn't replaced anymore
+  EXPECT_CALL(stats_, streamBufferChanged(1, 7));
+  state_.enqueueOutputPendingMetadataPush(
+      folly::IOBuf::copyBuffer("config3"), "config");
+
+  EXPECT_CALL(stats_, streamBufferChanged(-3, -23));
+  auto frames = state_.moveOutputPendingFrames();
+  ASSERT_EQ(3U, frames.size());
+  EXPECT_EQ("routes1", frames[0]->moveToFbString().toStdString());
+  EXPECT_EQ("keepalive", frames[1]->moveToFbString().toStdString());
+  EXPECT_EQ("config3", frames[2]->moveToFbString().toStdString());
+}
@@ -0,0 +1,72 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/RSocketConnectionEvents.h"
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/statemachine/RSocketStateMachine.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+constexpr StreamId kMaxStreamId = std::numeric_limits<int32_t>::max();
+
+std::shared_ptr<RSocketStateMachine> makeStateMachine(
+    folly::EventBase* evb,
+    RSocketMode mode) {
+  return std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      std::make_unique<KeepaliveTimer>(std::chrono::seconds{10}, *evb),
+      mode,
+      RSocketStats::noop(),
+      std::make_shared<RSocketConnectionEvents>(),
+      nullptr /* resumeManager */,
+      nullptr /* coldResumeHandler */
+      );
+}
+} // namespace
+
+TEST(StreamsFactory, StreamIdsWrapAround) {
+  folly::EventBase evb;
+  auto machine = makeStateMachine(&evb, RSocketMode::CLIENT);
+  auto& factory = machine->streamsFactory();
+
+  factory.restoreStreamIds(kMaxStreamId - 2, 0);
+  EXPECT_EQ(kMaxStreamId - 2, factory.getNextStreamId());
+  EXPECT_EQ(kMaxStreamId, factory.getNextStreamId());
+  EXPECT_EQ(1U, factory.getNextStreamId());
+  EXPECT_EQ(3U, factory.getNextStreamId());
+
+  // a batch which doesn't fit before the end starts again from the first id
+  factory.restoreStreamIds(kMaxStreamId - 2, 0);
+  EXPECT_EQ(1U, factory.getNextStreamIds(3));
+  EXPECT_EQ(7U, factory.getNextStreamId());
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
+
+TEST(StreamsFactory, PeerStreamIdsWrapAround) {
+  folly::EventBase evb;
+  auto machine = makeStateMachine(&evb, RSocketMode::SERVER);
+  auto& factory = machine->streamsFactory();
+
+  EXPECT_TRUE(factory.registerNewPeerStreamId(kMaxStreamId - 2, true));
+  // a late frame of a stream which ended
+  EXPECT_FALSE(factory.registerNewPeerStreamId(kMaxStreamId - 4, false));
+  EXPECT_TRUE(factory.registerNewPeerStreamId(kMaxStreamId, true));
+
+  // the client starts again from its first id
+  EXPECT_TRUE(factory.registerNewPeerStreamId(1, true));
+  EXPECT_EQ(1U, factory.lastPeerStreamId());
+  // late frames of the streams before the wrap are ignored
+  EXPECT_FALSE(factory.registerNewPeerStreamId(kMaxStreamId - 2, false));
+  EXPECT_TRUE(factory.registerNewPeerStreamId(3, true));
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+}
@@ -90,12 +90,15 @@ ColdResumeManager::ColdResumeManager(
         throw std::runtime_error(
             "Invalid file content.  Expected dynamic object of 1 element");
       }
+      // Copied, as the large frames are shared rather than copied into the
+      // buffer, and the parsed file goes away.
       auto ioBuf = folly::IOBuf::copyBuffer(
           item.values().begin()->getString().c_str(),
           item.values().begin()->getString().size());
-      frames_.emplace_back(
+      addFrame(
           folly::to<int64_t>(item.keys().begin()->getString()),
-          std::move(ioBuf));
+          *ioBuf,
+          ioBuf->length());
     }
   } catch (const std::exception& ex) {
     throw std::runtime_error(
@@ -127,10 +130,10 @@ void ColdResumeManager::persistState(std::string outputFile) {
           folly::to<std::string>(streamResumeInfo.first), val);
     }
     state[FRAMES] = folly::dynamic::array();
-    for (const auto& frame : frames_) {
+    for (size_t i = 0; i < frameCount(); ++i) {
       state[FRAMES].push_back(folly::dynamic::object(
-          folly::to<std::string>(frame.first),
-          frame.second->moveToFbString().toStdString()));
+          folly::to<std::string>(framePosition(i)),
+          copyFrame(i)->moveToFbString().toStdString()));
     }
     std::string jsonState = folly::toPrettyJson(state);
     std::ofstream f(outputFile);
@@ -165,6 +168,7 @@ void ColdResumeManager::trackReceivedFrame(
 
 void ColdResumeManager::trackSentFrame(
     const folly::IOBuf& serializedFrame,
+    size_t frameLength,
     FrameType frameType,
     StreamId streamId,
     size_t consumerAllowance) {
@@ -175,7 +179,7 @@ void ColdResumeManager::trackSentFrame(
   CHECK(it != streamResumeInfos_.end());
   it->second.consumerAllowance = consumerAllowance;
   WarmResumeManager::trackSentFrame(
-      std::move(serializedFrame), frameType, streamId, consumerAllowance);
+      serializedFrame, frameLength, frameType, streamId, consumerAllowance);
 }
 
 void ColdResumeManager::onStreamClosed(StreamId streamId) {
@@ -30,8 +30,15 @@ class ColdResumeManager : public WarmResumeManager {
       StreamId streamId,
       size_t consumerAllowance) override;
 
+  void trackReceivedFrames(
+      const std::vector<ReceivedFrameInfo>& infos) override {
+    // Updates the allowance of the streams frame by frame.
+    ResumeManager::trackReceivedFrames(infos);
+  }
+
   void trackSentFrame(
       const folly::IOBuf& serializedFrame,
+      size_t frameLength,
       FrameType frameType,
       StreamId streamIdPtr,
       size_t consumerAllowance) override;
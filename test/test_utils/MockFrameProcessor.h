@@ -17,11 +17,19 @@ public:
     processFrame_(buf);
   }
 
+  void processFrames(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    processFrames_(frames);
+  }
+
   void onTerminal(folly::exception_wrapper ew) override {
     onTerminal_(std::move(ew));
   }
 
   MOCK_METHOD1(processFrame_, void(std::unique_ptr<folly::IOBuf>&));
+  MOCK_METHOD1(
+      processFrames_,
+      void(std::vector<std::unique_ptr<folly::IOBuf>>&));
   MOCK_METHOD1(onTerminal_, void(folly::exception_wrapper));
 };
 
@@ -0,0 +1,78 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <fizz/protocol/CertUtils.h>
+#include <fizz/protocol/DefaultCertificateVerifier.h>
+#include <fizz/server/CertManager.h>
+#include <fizz/server/FizzServerContext.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <glog/logging.h>
+#include <quic/fizz/client/handshake/FizzClientQuicHandshakeContext.h>
+
+namespace rsocket {
+namespace tests {
+
+/// The TLS handshake of QUIC needs a certificate: a self-signed one for
+/// localhost, which the clients trust.
+struct QuicCertificate {
+  QuicCertificate() : key(EVP_PKEY_new()), cert(X509_new()) {
+    folly::ssl::EcKeyUniquePtr ecKey(
+        EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+    CHECK(EC_KEY_generate_key(ecKey.get()));
+    CHECK(EVP_PKEY_set1_EC_KEY(key.get(), ecKey.get()));
+
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert.get()), -60);
+    X509_gmtime_adj(X509_get_notAfter(cert.get()), 24 * 60 * 60);
+    X509_set_pubkey(cert.get(), key.get());
+    auto name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(
+        name,
+        "CN",
+        MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("localhost"),
+        -1,
+        -1,
+        0);
+    X509_set_issuer_name(cert.get(), name);
+    CHECK(X509_sign(cert.get(), key.get(), EVP_sha256()));
+  }
+
+  std::shared_ptr<const fizz::server::FizzServerContext> serverContext()
+      const {
+    X509_up_ref(cert.get());
+    std::vector<folly::ssl::X509UniquePtr> chain;
+    chain.emplace_back(cert.get());
+    EVP_PKEY_up_ref(key.get());
+    auto certManager = std::make_shared<fizz::server::CertManager>();
+    certManager->addCert(
+        fizz::CertUtils::makeSelfCert(
+            std::move(chain), folly::ssl::EvpPkeyUniquePtr(key.get())),
+        true);
+
+    auto context = std::make_shared<fizz::server::FizzServerContext>();
+    context->setCertManager(std::move(certManager));
+    return context;
+  }
+
+  std::shared_ptr<quic::ClientHandshakeFactory> clientHandshakeFactory()
+      const {
+    folly::ssl::X509StoreUniquePtr store(X509_STORE_new());
+    CHECK(X509_STORE_add_cert(store.get(), cert.get()));
+    return quic::FizzClientQuicHandshakeContext::Builder()
+        .setCertificateVerifier(
+            std::make_shared<fizz::DefaultCertificateVerifier>(
+                fizz::VerificationContext::Client, std::move(store)))
+        .build();
+  }
+
+  folly::ssl::EvpPkeyUniquePtr key;
+  folly::ssl::X509UniquePtr cert;
+};
+} // namespace tests
+} // namespace rsocket
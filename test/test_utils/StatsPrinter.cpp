@@ -65,4 +65,8 @@ void StatsPrinter::keepaliveSent() {
 void StatsPrinter::keepaliveReceived() {
   LOG(INFO) << "keepalive response received";
 }
+
+void StatsPrinter::keepaliveRoundTrip(std::chrono::microseconds rtt) {
+  LOG(INFO) << "keepalive round trip " << rtt.count() << "us";
+}
 }
@@ -29,5 +29,6 @@ class StatsPrinter : public RSocketStats {
 
   void keepaliveSent() override;
   void keepaliveReceived() override;
+  void keepaliveRoundTrip(std::chrono::microseconds rtt) override;
 };
 }
@@ -0,0 +1,77 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/quic/QuicConnectionAcceptor.h"
+#include "rsocket/transports/quic/QuicConnectionFactory.h"
+#include "test/test_utils/GenericRequestResponseHandler.h"
+#include "test/test_utils/QuicCertificate.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace yarpl::single;
+
+namespace {
+std::unique_ptr<RSocketServer> makeQuicServer(
+    const QuicCertificate& certificate) {
+  QuicConnectionAcceptor::Options options(0);
+  options.address = folly::SocketAddress("127.0.0.1", 0);
+  auto server = RSocket::createServer(std::make_unique<QuicConnectionAcceptor>(
+      std::move(options), certificate.serverContext()));
+  server->start([](const SetupParameters&) {
+    return std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response("Hello, " + request.first + "!", "");
+        });
+  });
+  return server;
+}
+
+std::unique_ptr<ConnectionFactory> makeQuicFactory(
+    folly::EventBase& eventBase,
+    const RSocketServer& server,
+    const QuicCertificate& trusted) {
+  return std::make_unique<QuicConnectionFactory>(
+      eventBase,
+      folly::SocketAddress("127.0.0.1", *server.listeningPort()),
+      "localhost",
+      trusted.clientHandshakeFactory());
+}
+} // namespace
+
+TEST(QuicDuplexConnection, RequestResponse) {
+  QuicCertificate certificate;
+  auto server = makeQuicServer(certificate);
+  ASSERT_TRUE(server->listeningPort());
+
+  folly::ScopedEventBaseThread worker;
+  auto client = RSocket::createConnectedClient(makeQuicFactory(
+                                                   *worker.getEventBase(),
+                                                   *server,
+                                                   certificate))
+                    .get();
+
+  auto to = SingleTestObserver<std::string>::create();
+  client->getRequester()
+      ->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("Hello, Jane!");
+}
+
+TEST(QuicDuplexConnection, UntrustedCertificate) {
+  QuicCertificate certificate;
+  auto server = makeQuicServer(certificate);
+
+  // The handshake fails, the client never connects.
+  folly::ScopedEventBaseThread worker;
+  QuicCertificate other;
+  EXPECT_ANY_THROW(
+      RSocket::createConnectedClient(
+          makeQuicFactory(*worker.getEventBase(), *server, other))
+          .get());
+}
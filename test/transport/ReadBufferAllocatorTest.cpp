@@ -0,0 +1,110 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rsocket/transports/tcp/ReadBufferAllocator.h"
+
+using namespace rsocket;
+
+TEST(ReadBufferAllocator, Heap) {
+  auto allocator = ReadBufferAllocator::heap();
+  auto buf = allocator->allocate(100);
+  EXPECT_GE(buf->tailroom(), 100U);
+  EXPECT_FALSE(buf->isShared());
+}
+
+TEST(ReadBufferAllocator, SlabsAreRecycled) {
+  auto allocator = ReadBufferAllocator::slabs(1024, 2);
+  auto buf = allocator->allocate(512);
+  EXPECT_EQ(1024U, buf->tailroom());
+  EXPECT_FALSE(buf->isShared());
+
+  auto slab = buf->data();
+  buf.reset();
+  buf = allocator->allocate(512);
+  EXPECT_EQ(slab, buf->data());
+}
+
+TEST(ReadBufferAllocator, SlabIsFreedWithItsLastFrame) {
+  auto allocator = ReadBufferAllocator::slabs(1024, 2);
+  auto buf = allocator->allocate(1024);
+  auto slab = buf->data();
+  buf->append(10);
+  auto frame = buf->cloneOne();
+  buf.reset();
+
+  // the slab is still used by the frame
+  auto other = allocator->allocate(1024);
+  EXPECT_NE(slab, other->data());
+
+  frame.reset();
+  EXPECT_EQ(slab, allocator->allocate(1024)->data());
+}
+
+TEST(ReadBufferAllocator, LargeBuffersAreNotSlabs) {
+  auto allocator = ReadBufferAllocator::slabs(1024, 2);
+  auto buf = allocator->allocate(10000);
+  EXPECT_GE(buf->tailroom(), 10000U);
+}
+
+TEST(ReadBufferAllocator, LargeBuffersAreRecycled) {
+  auto allocator = ReadBufferAllocator::recyclingSlabs(1024, 2, 8192);
+  auto buf = allocator->allocate(3000);
+  EXPECT_EQ(4096U, buf->tailroom());
+  EXPECT_FALSE(buf->isShared());
+
+  // recycled once the payload carved from it is dropped
+  auto large = buf->data();
+  buf->append(3000);
+  auto payload = buf->cloneOne();
+  buf.reset();
+  auto other = allocator->allocate(4096);
+  EXPECT_NE(large, other->data());
+  payload.reset();
+  EXPECT_EQ(large, allocator->allocate(2500)->data());
+
+  // the size classes don't mix
+  auto slab = allocator->allocate(512);
+  EXPECT_EQ(1024U, slab->tailroom());
+  EXPECT_EQ(8192U, allocator->allocate(8000)->tailroom());
+  EXPECT_GE(allocator->allocate(10000)->tailroom(), 10000U);
+}
+
+TEST(ReadBufferAllocator, ReleaseOnOtherThreads) {
+  auto allocator = ReadBufferAllocator::slabs(1024, 2);
+  std::unique_ptr<folly::IOBuf> fromExitedThread;
+  std::thread([&] { fromExitedThread = allocator->allocate(1024); }).join();
+
+  auto buf = allocator->allocate(1024);
+  auto slab = buf->data();
+  std::thread([buf = std::move(buf)]() mutable { buf.reset(); }).join();
+  EXPECT_EQ(slab, allocator->allocate(1024)->data());
+
+  // the pool of the exited thread is gone, its slab is just freed
+  fromExitedThread.reset();
+  allocator.reset();
+}
+
+TEST(ReadBufferAllocator, HugePageSlabs) {
+  auto allocator = ReadBufferAllocator::hugePageSlabs(1024, 2);
+  auto buf = allocator->allocate(512);
+  EXPECT_EQ(1024U, buf->tailroom());
+  EXPECT_FALSE(buf->isShared());
+
+  auto slab = buf->data();
+  buf.reset();
+  EXPECT_EQ(slab, allocator->allocate(512)->data());
+
+  // Freed on another thread, and past the cache, the slabs go back to the
+  // arena.
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs;
+  for (int i = 0; i < 10; ++i) {
+    bufs.push_back(allocator->allocate(1024));
+  }
+  std::thread([bufs = std::move(bufs)]() mutable { bufs.clear(); }).join();
+  EXPECT_GE(allocator->allocate(10000)->tailroom(), 10000U);
+  allocator.reset();
+}
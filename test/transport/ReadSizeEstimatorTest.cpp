@@ -0,0 +1,40 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/transports/tcp/ReadSizeEstimator.h"
+
+using namespace rsocket;
+
+TEST(ReadSizeEstimator, SmallReadsStayAtMinimum) {
+  ReadSizeEstimator estimator(1024, 65536);
+  for (int i = 0; i < 100; ++i) {
+    estimator.onRead(100, estimator.nextReadSize(0));
+  }
+  EXPECT_EQ(1024U, estimator.nextReadSize(0));
+}
+
+TEST(ReadSizeEstimator, FullReadsGrowUpToMaximum) {
+  ReadSizeEstimator estimator(1024, 65536);
+  estimator.onRead(1024, 1024);
+  EXPECT_EQ(2048U, estimator.nextReadSize(0));
+
+  for (int i = 0; i < 20; ++i) {
+    auto size = estimator.nextReadSize(0);
+    estimator.onRead(size, size);
+  }
+  EXPECT_EQ(65536U, estimator.nextReadSize(0));
+
+  // and decay once the reads get short again
+  for (int i = 0; i < 100; ++i) {
+    estimator.onRead(10, estimator.nextReadSize(0));
+  }
+  EXPECT_EQ(1024U, estimator.nextReadSize(0));
+}
+
+TEST(ReadSizeEstimator, ExpectedFrameIsReadAtOnce) {
+  ReadSizeEstimator estimator(1024, 65536);
+  EXPECT_EQ(10000U, estimator.nextReadSize(10000));
+  EXPECT_EQ(65536U, estimator.nextReadSize(1000000));
+  EXPECT_EQ(1024U, estimator.nextReadSize(10));
+}
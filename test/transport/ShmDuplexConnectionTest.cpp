@@ -0,0 +1,139 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <cstring>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+#include "rsocket/transports/shm/ShmRing.h"
+#include "test/transport/DuplexConnectionTest.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace rsocket;
+
+namespace {
+
+/// Memory for a ring, aligned like the mapped shared memory.
+struct alignas(64) Region {
+  uint8_t bytes[1024];
+};
+
+struct ShmConnections {
+  ScopedEventBaseThread serverThread;
+  ScopedEventBaseThread clientThread;
+  std::unique_ptr<DuplexConnection> serverConnection;
+  std::unique_ptr<DuplexConnection> clientConnection;
+
+  explicit ShmConnections(size_t ringCapacity = 4096) {
+    auto endpoints = ShmDuplexConnection::createEndpoints(ringCapacity);
+    serverThread.getEventBase()->runInEventBaseThreadAndWait([&] {
+      serverConnection = std::make_unique<ShmDuplexConnection>(
+          std::move(endpoints.first), *serverThread.getEventBase());
+    });
+    clientThread.getEventBase()->runInEventBaseThreadAndWait([&] {
+      clientConnection = std::make_unique<ShmDuplexConnection>(
+          std::move(endpoints.second), *clientThread.getEventBase());
+    });
+  }
+};
+
+std::string readAll(ShmRing& ring) {
+  bool producerWaiting = false;
+  auto frame = ring.read(producerWaiting);
+  return frame ? frame->moveToFbString().toStdString() : std::string();
+}
+
+} // namespace
+
+TEST(ShmRing, FramesWrapAround) {
+  constexpr size_t kCapacity = 64;
+  Region region;
+  ASSERT_LE(ShmRing::regionSize(kCapacity), sizeof(region.bytes));
+  ShmRing::initialize(region.bytes);
+  ShmRing ring(region.bytes, kCapacity);
+
+  // each frame takes a sixth of the ring so that they end up straddling its
+  // end
+  for (int i = 0; i < 50; ++i) {
+    auto payload = std::string(6, static_cast<char>('a' + i % 26));
+    bool wasEmpty = false;
+    ASSERT_TRUE(ring.tryWrite(*IOBuf::copyBuffer(payload), wasEmpty));
+    EXPECT_TRUE(wasEmpty);
+    EXPECT_EQ(payload, readAll(ring));
+  }
+  EXPECT_EQ("", readAll(ring));
+}
+
+TEST(ShmRing, FullRingRejectsWrites) {
+  constexpr size_t kCapacity = 64;
+  Region region;
+  ASSERT_LE(ShmRing::regionSize(kCapacity), sizeof(region.bytes));
+  ShmRing::initialize(region.bytes);
+  ShmRing ring(region.bytes, kCapacity);
+
+  EXPECT_FALSE(ring.fits(kCapacity));
+  auto frame = IOBuf::copyBuffer(std::string(20, 'x'));
+  bool wasEmpty = false;
+  int written = 0;
+  while (ring.tryWrite(*frame, wasEmpty)) {
+    ++written;
+  }
+  EXPECT_GT(written, 0);
+
+  bool producerWaiting = false;
+  EXPECT_TRUE(ring.read(producerWaiting));
+  EXPECT_TRUE(producerWaiting);
+  EXPECT_TRUE(ring.tryWrite(*frame, wasEmpty));
+  EXPECT_FALSE(wasEmpty);
+}
+
+TEST(ShmRing, RejectsLengthPastHead) {
+  constexpr size_t kCapacity = 64;
+  Region region;
+  ASSERT_LE(ShmRing::regionSize(kCapacity), sizeof(region.bytes));
+  ShmRing::initialize(region.bytes);
+  ShmRing ring(region.bytes, kCapacity);
+
+  bool wasEmpty = false;
+  ASSERT_TRUE(ring.tryWrite(*IOBuf::copyBuffer("abc"), wasEmpty));
+  // The producer claims more bytes than it published.
+  uint32_t const length = 1000;
+  std::memcpy(region.bytes + ShmRing::regionSize(0), &length, sizeof(length));
+
+  bool producerWaiting = false;
+  EXPECT_THROW(ring.read(producerWaiting), std::runtime_error);
+}
+
+TEST(ShmDuplexConnection, MultipleSetInputGetOutputCalls) {
+  ShmConnections connections;
+  makeMultipleSetInputGetOutputCalls(
+      std::move(connections.serverConnection),
+      connections.serverThread.getEventBase(),
+      std::move(connections.clientConnection),
+      connections.clientThread.getEventBase());
+}
+
+TEST(ShmDuplexConnection, InputAndOutputIsUntied) {
+  ShmConnections connections;
+  verifyInputAndOutputIsUntied(
+      std::move(connections.serverConnection),
+      connections.serverThread.getEventBase(),
+      std::move(connections.clientConnection),
+      connections.clientThread.getEventBase());
+}
+
+TEST(ShmDuplexConnection, ConnectionAndSubscribersAreUntied) {
+  ShmConnections connections;
+  verifyClosingInputAndOutputDoesntCloseConnection(
+      std::move(connections.serverConnection),
+      connections.serverThread.getEventBase(),
+      std::move(connections.clientConnection),
+      connections.clientThread.getEventBase());
+}
+
+} // namespace tests
+} // namespace rsocket
@@ -1,13 +1,26 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <folly/Baton.h>
+#include <folly/Conv.h>
 #include <folly/futures/Future.h>
 #include <folly/io/async/AsyncTransport.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/io/async/SSLContext.h>
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
 #include "test/transport/DuplexConnectionTest.h"
+#include "yarpl/test_utils/Mocks.h"
 
 namespace rsocket {
 namespace tests {
@@ -26,11 +39,15 @@ makeSingleClientServer(
     std::unique_ptr<DuplexConnection>& serverConnection,
     EventBase** serverEvb,
     std::unique_ptr<DuplexConnection>& clientConnection,
-    EventBase* clientEvb) {
+    EventBase* clientEvb,
+    TcpZeroCopy zeroCopy = TcpZeroCopy(),
+    folly::Optional<size_t> framing = folly::none) {
   Promise<Unit> serverPromise;
 
   TcpConnectionAcceptor::Options options(
       0 /*port*/, 1 /*threads*/, 0 /*backlog*/);
+  options.zeroCopy = zeroCopy;
+  options.framing = framing;
   auto server = std::make_unique<TcpConnectionAcceptor>(options);
   server->start(
       [&serverPromise, &serverConnection, &serverEvb](
@@ -44,7 +61,9 @@ makeSingleClientServer(
 
   auto client = std::make_unique<TcpConnectionFactory>(
       *clientEvb,
-      SocketAddress("localhost", port, true));
+      SocketAddress("localhost", port, true),
+      zeroCopy);
+  client->setFraming(framing);
   client->connect().then(
       [&clientConnection](
           ConnectionFactory::ConnectedDuplexConnection connection) {
@@ -94,5 +113,462 @@ TEST(TcpDuplexConnection, ConnectionAndSubscribersAreUntied) {
       worker.getEventBase());
 }
 
+TEST(TcpDuplexConnection, CoalescedWritesArriveInOrder) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase *serverEvb = nullptr;
+  auto keepAlive = makeSingleClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+
+  // more frames than TcpWriteCoalescing::maxFrames so that both the limit
+  // and the end of the loop iteration trigger a flush
+  constexpr int kFrames = 300;
+  std::string expected;
+  for (int i = 0; i < kFrames; ++i) {
+    expected += folly::to<std::string>("frame-", i, ";");
+  }
+
+  std::string received;
+  folly::Baton<> allReceived;
+  auto serverSubscriber = yarpl::make_ref<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received +=
+            buf->cloneCoalescedAsValue().moveToFbString().toStdString();
+        if (received.size() == expected.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&connection = serverConnection, &input = serverSubscriber]() {
+        connection->setInput(input);
+      });
+
+  auto clientSubscription = yarpl::make_ref<yarpl::mocks::MockSubscription>();
+  EXPECT_CALL(*clientSubscription, request_(_)).Times(AtLeast(1));
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connection = clientConnection, &subscription = clientSubscription]() {
+        auto output = connection->getOutput();
+        output->onSubscribe(subscription);
+        for (int i = 0; i < kFrames; ++i) {
+          output->onNext(folly::IOBuf::copyBuffer(
+              folly::to<std::string>("frame-", i, ";")));
+        }
+        output->onComplete();
+      });
+
+  EXPECT_TRUE(allReceived.timed_wait(std::chrono::seconds(1)));
+  EXPECT_EQ(expected, received);
+
+  // Cleanup
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)]() {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connection = clientConnection]() {
+        auto connectionDeleter = std::move(connection);
+      });
+  serverEvb->runInEventBaseThreadAndWait([&connection = serverConnection]() {
+    auto connectionDeleter = std::move(connection);
+  });
+}
+
+TEST(TcpDuplexConnection, FramedConnectionsSplitFrames) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase *serverEvb = nullptr;
+  auto keepAlive = makeSingleClientServer(
+      serverConnection,
+      &serverEvb,
+      clientConnection,
+      worker.getEventBase(),
+      TcpZeroCopy(),
+      kMaxFrameLength);
+  EXPECT_TRUE(serverConnection->isFramed());
+  EXPECT_TRUE(clientConnection->isFramed());
+
+  constexpr int kFrames = 300;
+  std::vector<std::string> expected;
+  for (int i = 0; i < kFrames; ++i) {
+    expected.push_back(folly::to<std::string>("frame-", i));
+  }
+
+  std::vector<std::string> received;
+  folly::Baton<> allReceived;
+  auto serverSubscriber = yarpl::make_ref<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received.push_back(
+            buf->cloneCoalescedAsValue().moveToFbString().toStdString());
+        if (received.size() == expected.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&connection = serverConnection, &input = serverSubscriber]() {
+        connection->setInput(input);
+      });
+
+  // Without headroom for their length fields, and with.
+  auto clientSubscription = yarpl::make_ref<yarpl::mocks::MockSubscription>();
+  EXPECT_CALL(*clientSubscription, request_(_)).Times(AtLeast(1));
+  worker.getEventBase()->runInEventBaseThreadAndWait([
+    &connection = clientConnection,
+    &subscription = clientSubscription,
+    &expected
+  ]() {
+    auto output = connection->getOutput();
+    output->onSubscribe(subscription);
+    for (size_t i = 0; i < expected.size(); ++i) {
+      auto frame = folly::IOBuf::create(expected[i].size() + 16);
+      if (i % 2) {
+        frame->advance(16);
+      }
+      memcpy(frame->writableTail(), expected[i].data(), expected[i].size());
+      frame->append(expected[i].size());
+      output->onNext(std::move(frame));
+    }
+    output->onComplete();
+  });
+
+  EXPECT_TRUE(allReceived.timed_wait(std::chrono::seconds(1)));
+  EXPECT_EQ(expected, received);
+
+  // Cleanup
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)]() {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connection = clientConnection]() {
+        auto connectionDeleter = std::move(connection);
+      });
+  serverEvb->runInEventBaseThreadAndWait([&connection = serverConnection]() {
+    auto connectionDeleter = std::move(connection);
+  });
+}
+
+TEST(TcpDuplexConnection, ZeroCopyWritesArrive) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase *serverEvb = nullptr;
+  TcpZeroCopy zeroCopy;
+  zeroCopy.enabled = true;
+  auto keepAlive = makeSingleClientServer(
+      serverConnection,
+      &serverEvb,
+      clientConnection,
+      worker.getEventBase(),
+      zeroCopy);
+
+  // large frames are sent without copying where the kernel supports it,
+  // small ones are copied as usual
+  std::vector<std::string> frames;
+  for (int i = 0; i < 8; ++i) {
+    frames.push_back(std::string(64 * 1024, static_cast<char>('a' + i)));
+    frames.push_back(folly::to<std::string>("frame-", i, ";"));
+  }
+  std::string expected;
+  for (auto const& frame : frames) {
+    expected += frame;
+  }
+
+  std::string received;
+  folly::Baton<> allReceived;
+  auto serverSubscriber = yarpl::make_ref<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received +=
+            buf->cloneCoalescedAsValue().moveToFbString().toStdString();
+        if (received.size() == expected.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&connection = serverConnection, &input = serverSubscriber]() {
+        connection->setInput(input);
+      });
+
+  auto clientSubscription = yarpl::make_ref<yarpl::mocks::MockSubscription>();
+  EXPECT_CALL(*clientSubscription, request_(_)).Times(AtLeast(1));
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connection = clientConnection,
+       &subscription = clientSubscription,
+       &frames]() {
+        auto output = connection->getOutput();
+        output->onSubscribe(subscription);
+        for (auto const& frame : frames) {
+          output->onNext(folly::IOBuf::copyBuffer(frame));
+        }
+        output->onComplete();
+      });
+
+  EXPECT_TRUE(allReceived.timed_wait(std::chrono::seconds(1)));
+  EXPECT_EQ(expected, received);
+
+  // Cleanup
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)]() {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connection = clientConnection]() {
+        auto connectionDeleter = std::move(connection);
+      });
+  serverEvb->runInEventBaseThreadAndWait([&connection = serverConnection]() {
+    auto connectionDeleter = std::move(connection);
+  });
+}
+
+namespace {
+class MockDuplexSubscription : public DuplexConnection::DuplexSubscription {
+ public:
+  MOCK_METHOD1(request_, void(int64_t));
+  MOCK_METHOD0(cancel_, void());
+  MOCK_METHOD1(onWritabilityChanged_, void(bool));
+
+  void request(int64_t n) override {
+    request_(n);
+  }
+  void cancel() override {
+    cancel_();
+  }
+  void onWritabilityChanged(bool writable) override {
+    onWritabilityChanged_(writable);
+  }
+};
+} // namespace
+
+TEST(TcpDuplexConnection, WriteBufferLimits) {
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  EventBase evb;
+  AsyncSocket::UniquePtr peer(new AsyncSocket(&evb, fds[1]));
+
+  TcpWriteBufferLimits limits;
+  limits.highWaterMark = 1024;
+  limits.lowWaterMark = 0;
+  auto connection = std::make_unique<TcpDuplexConnection>(
+      AsyncSocket::UniquePtr(new AsyncSocket(&evb, fds[0])),
+      RSocketStats::noop(),
+      TcpWriteCoalescing(),
+      ReadBufferAllocator::defaultAllocator(),
+      TcpZeroCopy(),
+      limits);
+
+  auto subscription = yarpl::make_ref<StrictMock<MockDuplexSubscription>>();
+  EXPECT_CALL(*subscription, request_(_));
+  auto output = connection->getOutput();
+  output->onSubscribe(subscription);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  // the frame is corked until the end of the loop iteration
+  EXPECT_CALL(*subscription, onWritabilityChanged_(false));
+  output->onNext(folly::IOBuf::copyBuffer(std::string(4096, 'x')));
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  // the socket pair takes all of it at once
+  EXPECT_CALL(*subscription, onWritabilityChanged_(true));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  Mock::VerifyAndClearExpectations(subscription.get());
+
+  output->onComplete();
+  connection.reset();
+}
+
+namespace {
+class WriteStallStats : public RSocketStats {
+ public:
+  void connectionWriteStalled(
+      size_t bytes,
+      folly::Optional<std::chrono::milliseconds> stalledFor) override {
+    stalledBytes = bytes;
+    stalled = stalledFor;
+    ++evictions;
+  }
+
+  size_t stalledBytes{0};
+  folly::Optional<std::chrono::milliseconds> stalled;
+  int evictions{0};
+};
+} // namespace
+
+TEST(TcpDuplexConnection, EvictsPeerAboveMaxBufferedBytes) {
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  EventBase evb;
+  // never reads
+  AsyncSocket::UniquePtr peer(new AsyncSocket(&evb, fds[1]));
+
+  TcpWriteBufferLimits limits;
+  limits.highWaterMark = 1024 * 1024;
+  limits.lowWaterMark = 0;
+  limits.maxBytes = 2 * 1024 * 1024;
+  auto stats = std::make_shared<WriteStallStats>();
+  auto connection = std::make_unique<TcpDuplexConnection>(
+      AsyncSocket::UniquePtr(new AsyncSocket(&evb, fds[0])),
+      stats,
+      TcpWriteCoalescing(),
+      ReadBufferAllocator::defaultAllocator(),
+      TcpZeroCopy(),
+      limits);
+
+  auto subscription = yarpl::make_ref<StrictMock<MockDuplexSubscription>>();
+  EXPECT_CALL(*subscription, request_(_));
+  EXPECT_CALL(*subscription, onWritabilityChanged_(false));
+  EXPECT_CALL(*subscription, cancel_());
+  auto output = connection->getOutput();
+  output->onSubscribe(subscription);
+
+  // the frames keep being sent although the connection isn't writable
+  for (int i = 0; i < 64 && stats->evictions == 0; ++i) {
+    output->onNext(folly::IOBuf::copyBuffer(std::string(64 * 1024, 'x')));
+  }
+  Mock::VerifyAndClearExpectations(subscription.get());
+  EXPECT_EQ(1, stats->evictions);
+  EXPECT_GT(stats->stalledBytes, limits.maxBytes);
+  EXPECT_FALSE(stats->stalled);
+
+  output->onComplete();
+  connection.reset();
+}
+
+TEST(TcpDuplexConnection, EvictsPeerWhichStopsReading) {
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  EventBase evb;
+  // never reads
+  AsyncSocket::UniquePtr peer(new AsyncSocket(&evb, fds[1]));
+
+  TcpWriteBufferLimits limits;
+  limits.stallTimeout = std::chrono::milliseconds(50);
+  auto stats = std::make_shared<WriteStallStats>();
+  auto connection = std::make_unique<TcpDuplexConnection>(
+      AsyncSocket::UniquePtr(new AsyncSocket(&evb, fds[0])),
+      stats,
+      TcpWriteCoalescing(),
+      ReadBufferAllocator::defaultAllocator(),
+      TcpZeroCopy(),
+      limits);
+
+  auto subscription = yarpl::make_ref<StrictMock<MockDuplexSubscription>>();
+  EXPECT_CALL(*subscription, request_(_));
+  EXPECT_CALL(*subscription, cancel_());
+  auto output = connection->getOutput();
+  output->onSubscribe(subscription);
+
+  // more than the socket pair takes
+  output->onNext(folly::IOBuf::copyBuffer(std::string(1024 * 1024, 'x')));
+  while (stats->evictions == 0) {
+    evb.loopOnce();
+  }
+  Mock::VerifyAndClearExpectations(subscription.get());
+  EXPECT_GT(stats->stalledBytes, 0);
+  EXPECT_EQ(limits.stallTimeout, stats->stalled);
+
+  output->onComplete();
+  connection.reset();
+}
+
+TEST(TcpDuplexConnection, ReusePortAcceptsOnWorkers) {
+  folly::ScopedEventBaseThread worker;
+
+  TcpConnectionAcceptor::Options options(
+      0 /*port*/, 2 /*threads*/, 16 /*backlog*/);
+  options.reusePort = true;
+  TcpConnectionAcceptor server(options);
+
+  constexpr int kConnections = 8;
+  std::mutex mutex;
+  std::vector<std::pair<std::unique_ptr<DuplexConnection>, EventBase*>>
+      serverConnections;
+  folly::Baton<> allAccepted;
+  server.start([&](
+      std::unique_ptr<DuplexConnection> connection, EventBase& eventBase) {
+    // sockets are accepted on the worker that owns them
+    EXPECT_TRUE(eventBase.isInEventBaseThread());
+    std::lock_guard<std::mutex> lock(mutex);
+    serverConnections.emplace_back(std::move(connection), &eventBase);
+    if (serverConnections.size() == kConnections) {
+      allAccepted.post();
+    }
+  });
+
+  auto port = server.listeningPort().value();
+  EXPECT_NE(0, port);
+
+  TcpConnectionFactory client(
+      *worker.getEventBase(), SocketAddress("localhost", port, true));
+  std::vector<std::unique_ptr<DuplexConnection>> clientConnections;
+  for (int i = 0; i < kConnections; ++i) {
+    clientConnections.push_back(std::move(client.connect().get().connection));
+  }
+  EXPECT_TRUE(allAccepted.timed_wait(std::chrono::seconds(1)));
+
+  server.stop();
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&connections = clientConnections]() {
+        auto connectionDeleter = std::move(connections);
+      });
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& connection : serverConnections) {
+    connection.second->runInEventBaseThreadAndWait(
+        [&connection = connection.first]() {
+          auto connectionDeleter = std::move(connection);
+        });
+  }
+}
+
+TEST(TcpDuplexConnection, StopWithStalledTlsHandshake) {
+  TcpConnectionAcceptor::Options options(
+      0 /*port*/, 1 /*threads*/, 0 /*backlog*/);
+  options.sslContext = std::make_shared<SSLContext>();
+  options.tlsHandshakeTimeout = std::chrono::minutes(1);
+  auto server = std::make_unique<TcpConnectionAcceptor>(options);
+  std::atomic<bool> accepted{false};
+  server->start([&](std::unique_ptr<DuplexConnection>, EventBase&) {
+    accepted = true;
+  });
+
+  // The client connects and never sends its ClientHello.
+  SocketAddress serverAddress("127.0.0.1", server->listeningPort().value());
+  sockaddr_storage address;
+  auto const length = serverAddress.getAddress(&address);
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, ::connect(fd, reinterpret_cast<sockaddr*>(&address), length));
+  auto const deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (server->pendingTlsHandshakes() == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(1U, server->pendingTlsHandshakes());
+
+  server->stop();
+  EXPECT_EQ(0U, server->pendingTlsHandshakes());
+
+  // The server closed the socket well before the handshake would time out.
+  timeval timeout{5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  char byte;
+  auto const read = ::recv(fd, &byte, 1, 0);
+  EXPECT_TRUE(read == 0 || (read < 0 && errno == ECONNRESET));
+
+  server.reset();
+  EXPECT_FALSE(accepted);
+  ::close(fd);
+}
+
 } // namespace tests
 } // namespace rsocket
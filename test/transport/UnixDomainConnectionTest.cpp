@@ -0,0 +1,75 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <folly/Conv.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/unix/UnixDomainConnectionAcceptor.h"
+#include "rsocket/transports/unix/UnixDomainConnectionFactory.h"
+#include "test/test_utils/GenericRequestResponseHandler.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace yarpl::single;
+
+namespace {
+void requestResponseOver(const std::string& path) {
+  auto server = RSocket::createServer(
+      std::make_unique<UnixDomainConnectionAcceptor>(
+          UnixDomainConnectionAcceptor::Options(path)));
+  server->start([](const SetupParameters&) {
+    return std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response("Hello, " + request.first + "!", "");
+        });
+  });
+  EXPECT_FALSE(server->listeningPort());
+
+  folly::ScopedEventBaseThread worker;
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<UnixDomainConnectionFactory>(
+                        *worker.getEventBase(), path))
+                    .get();
+
+  auto to = SingleTestObserver<std::string>::create();
+  client->getRequester()
+      ->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("Hello, Jane!");
+}
+} // namespace
+
+TEST(UnixDomainConnection, RequestResponseOverPath) {
+  auto path = folly::to<std::string>("/tmp/rsocket-test-", ::getpid());
+  requestResponseOver(path);
+  // the socket file is removed with the server
+  EXPECT_NE(0, ::access(path.c_str(), F_OK));
+}
+
+TEST(UnixDomainConnection, KeepsFilesItDidntBind) {
+  auto path = folly::to<std::string>("/tmp/rsocket-test-file-", ::getpid());
+  auto file = ::open(path.c_str(), O_CREAT | O_WRONLY, 0600);
+  ASSERT_LE(0, file);
+  ::close(file);
+
+  {
+    UnixDomainConnectionAcceptor acceptor(
+        UnixDomainConnectionAcceptor::Options(path));
+    EXPECT_ANY_THROW(acceptor.start([](auto, auto&) {}));
+  }
+  // Neither removed as stale nor as the file of the acceptor.
+  EXPECT_EQ(0, ::access(path.c_str(), F_OK));
+  ::unlink(path.c_str());
+}
+
+TEST(UnixDomainConnection, RequestResponseOverAbstractPath) {
+  auto path = folly::to<std::string>("rsocket-test-", ::getpid());
+  requestResponseOver(std::string(1, '\0') + path);
+}
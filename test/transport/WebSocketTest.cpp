@@ -0,0 +1,118 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/ws/WebSocketConnectionAcceptor.h"
+#include "rsocket/transports/ws/WebSocketConnectionFactory.h"
+#include "rsocket/transports/ws/WebSocketFraming.h"
+#include "test/test_utils/GenericRequestResponseHandler.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace yarpl::single;
+
+TEST(WebSocket, AcceptKey) {
+  // The example of RFC 6455.
+  EXPECT_EQ(
+      "s3pPLMBiTxaQ9kYGAxzkgOo=",
+      webSocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ=="));
+  EXPECT_EQ(24, makeWebSocketKey().size());
+}
+
+TEST(WebSocket, MaskMatchesBytewise) {
+  const WebSocketMaskKey key{{0x12, 0x34, 0x56, 0x78}};
+  std::vector<uint8_t> in(300);
+  for (size_t i = 0; i < in.size(); ++i) {
+    in[i] = static_cast<uint8_t>(i * 7);
+  }
+  // Across the SIMD widths, with the tails and the offsets into the key.
+  for (size_t length : {0, 1, 3, 7, 15, 16, 31, 33, 64, 100, 300}) {
+    for (size_t offset = 0; offset < 4; ++offset) {
+      std::vector<uint8_t> out(length);
+      xorWebSocketMask(out.data(), in.data(), length, key, offset);
+      for (size_t i = 0; i < length; ++i) {
+        ASSERT_EQ(in[i] ^ key[(i + offset) % 4], out[i])
+            << "length " << length << " offset " << offset << " byte " << i;
+      }
+    }
+  }
+}
+
+TEST(WebSocket, UnmaskChainedPayload) {
+  const WebSocketMaskKey key{{1, 2, 3, 4}};
+  auto payload = folly::IOBuf::copyBuffer("hello ");
+  payload->prependChain(folly::IOBuf::copyBuffer("websocket"));
+  auto masked = maskedWebSocketPayload(*payload, key);
+  EXPECT_FALSE(masked->isChained());
+
+  // Split unevenly, so the second buffer starts inside the key.
+  auto second = masked->cloneOne();
+  masked->trimEnd(5);
+  second->trimStart(masked->length());
+  masked->prependChain(std::move(second));
+  unmaskWebSocketPayload(*masked, key);
+  EXPECT_EQ("hello websocket", masked->moveToFbString().toStdString());
+}
+
+TEST(WebSocket, FrameHeaderRoundTrip) {
+  const WebSocketMaskKey key{{9, 8, 7, 6}};
+  for (uint64_t length : {0, 125, 126, 65535, 65536, 1 << 20}) {
+    for (bool masked : {false, true}) {
+      auto header = serializeWebSocketFrameHeader(
+          WebSocketOpcode::BINARY,
+          length,
+          masked ? folly::Optional<WebSocketMaskKey>(key) : folly::none);
+      auto parsed = parseWebSocketFrameHeader(*header);
+      ASSERT_TRUE(parsed);
+      EXPECT_TRUE(parsed->fin);
+      EXPECT_EQ(0, parsed->reserved);
+      EXPECT_EQ(WebSocketOpcode::BINARY, parsed->opcode);
+      EXPECT_EQ(length, parsed->payloadLength);
+      EXPECT_EQ(header->computeChainDataLength(), parsed->headerLength);
+      EXPECT_EQ(masked, parsed->maskKey.hasValue());
+
+      // Not until the whole header is there.
+      auto partial = header->clone();
+      partial->trimEnd(1);
+      EXPECT_FALSE(parseWebSocketFrameHeader(*partial));
+    }
+  }
+}
+
+TEST(WebSocket, RequestResponse) {
+  TcpConnectionAcceptor::Options options(0);
+  options.address = folly::SocketAddress("::1", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<WebSocketConnectionAcceptor>(std::move(options)));
+  server->start([](const SetupParameters&) {
+    return std::make_shared<GenericRequestResponseHandler>(
+        [](StringPair const& request) {
+          return payload_response("Hello, " + request.first + "!", "");
+        });
+  });
+  auto port = server->listeningPort();
+  ASSERT_TRUE(port);
+
+  folly::ScopedEventBaseThread worker;
+  WebSocketOptions webSocketOptions;
+  webSocketOptions.path = "/rsocket";
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<WebSocketConnectionFactory>(
+                        *worker.getEventBase(),
+                        folly::SocketAddress("::1", *port),
+                        std::move(webSocketOptions)))
+                    .get();
+
+  auto to = SingleTestObserver<std::string>::create();
+  client->getRequester()
+      ->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("Hello, Jane!");
+}
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace yarpl {
+
+/// The Refcounted objects of one type, see census().
+struct CensusEntry {
+  /// Demangled name of the type.
+  std::string type;
+  /// Objects of the type alive now.
+  int64_t live{0};
+  /// Objects of the type created so far.
+  int64_t created{0};
+};
+
+/// Counts the Refcounted objects which make_ref() created, by their concrete
+/// type, e.g. to watch for leaks of stream state machines in production.
+/// Returns the types with objects created so far, most live first.
+///
+/// Always on: every type gets its counters when the program starts, and the
+/// objects are counted with plain stores to counters of the thread creating
+/// or destroying them.  Taking a census sums the counters of every thread,
+/// under a lock.  Objects created before their type got its counters, during
+/// the static initialization of the program, aren't counted.
+std::vector<CensusEntry> census();
+
+/// Writes the census as a table.
+void printCensus(std::ostream& os);
+
+namespace detail {
+
+/// Index of the counters of a type, 0 for a type without counters.
+using CensusId = uint32_t;
+
+CensusId registerCensusType(const std::type_info& type);
+
+void censusCreated(CensusId id);
+void censusDestroyed(CensusId id);
+
+/// The counters of T, registered during the static initialization of the
+/// program.
+template <typename T>
+struct CensusType {
+  static const CensusId id;
+};
+
+template <typename T>
+const CensusId CensusType<T>::id = registerCensusType(typeid(T));
+
+} // namespace detail
+} // namespace yarpl
@@ -10,43 +10,23 @@
 #include <utility>
 
 #include <cstdlib>
-#include <cxxabi.h>
 #include <typeinfo>
 #include <unordered_map>
 #include <string>
 #include <ostream>
 
+#include "yarpl/Census.h"
+
 namespace yarpl {
 
 namespace detail {
 struct skip_initial_refcount_check {};
 struct do_initial_refcount_check {};
 
-
-// refcount debugging utilities
-using refcount_map_type = std::unordered_map<std::string, int64_t>;
-void inc_created(std::string const&);
-
-void inc_live(std::string const&);
-void dec_live(std::string const&);
+/// Prints the census() of the Refcounted objects.
 void debug_refcounts(std::ostream& o);
 
-template<typename T>
-std::string type_name()
-{
-    int status;
-    std::string tname = typeid(T).name();
-    char *demangled_name = abi::__cxa_demangle(tname.c_str(), NULL, NULL, &status);
-    if (status == 0) {
-        tname = demangled_name;
-        std::free(demangled_name);
-    }
-    return tname;
-}
-
-#ifdef YARPL_REFCOUNT_DEBUGGING
-struct set_reference_name;
-#endif
+struct set_census_id;
 
 } /* namespace detail */
 
@@ -79,9 +59,7 @@ class Refcounted {
   template <typename U>
   friend class AtomicReference;
 
-#ifdef YARPL_REFCOUNT_DEBUGGING
-  friend struct detail::set_reference_name;
-#endif
+  friend struct detail::set_census_id;
 
   void incRef() const {
     refcount_.fetch_add(1, std::memory_order_relaxed);
@@ -92,9 +70,9 @@ class Refcounted {
     assert(previous >= 1 && "decRef on a destroyed object!");
     if (previous == 1) {
       std::atomic_thread_fence(std::memory_order_acquire);
-#ifdef YARPL_REFCOUNT_DEBUGGING
-      detail::dec_live(this->demangled_name_);
-#endif
+      if (censusId_) {
+        detail::censusDestroyed(censusId_);
+      }
       delete this;
     }
   }
@@ -103,21 +81,21 @@ class Refcounted {
   // the constructor if we call `ref_from_this` in it
   mutable std::atomic_size_t refcount_{1};
 
-#ifdef YARPL_REFCOUNT_DEBUGGING
-  // for memory debugging and instrumentation
-  std::string demangled_name_;
-#endif
+  // The census counters of the concrete type, set by make_ref<>().  Objects
+  // created otherwise aren't counted.
+  detail::CensusId censusId_{0};
 };
 
-#ifdef YARPL_REFCOUNT_DEBUGGING
 namespace detail {
-struct set_reference_name {
-  set_reference_name(std::string name, Refcounted& refcounted) {
-    refcounted.demangled_name_ = std::move(name);
+struct set_census_id {
+  set_census_id(CensusId id, Refcounted& refcounted) {
+    refcounted.censusId_ = id;
+    if (id) {
+      censusCreated(id);
+    }
   }
 };
-}
-#endif
+} // namespace detail
 
 /// RAII-enabling smart pointer for refcounted objects.  Each reference
 /// constructed against a target refcounted object increases its count by 1
@@ -484,12 +462,7 @@ Reference<CastTo> make_ref(Args&&... args) {
     detail::skip_initial_refcount_check{}
   );
 
-#ifdef YARPL_REFCOUNT_DEBUGGING
-  auto demangled_name = detail::type_name<T>();
-  detail::inc_created(demangled_name);
-  detail::inc_live(demangled_name);
-  detail::set_reference_name{std::move(demangled_name), *r};
-#endif
+  detail::set_census_id{detail::CensusType<std::decay_t<T>>::id, *r};
 
   return std::move(r);
 }
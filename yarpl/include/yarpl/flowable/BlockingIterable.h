@@ -0,0 +1,192 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include <folly/Baton.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/ProducerConsumerQueue.h>
+
+#include "yarpl/flowable/Flowable_FromObservable.h"
+#include "yarpl/flowable/Subscriber.h"
+
+namespace yarpl {
+namespace flowable {
+
+/**
+ * A Subscriber which one thread consumes by blocking on its items, see
+ * Flowable::toBlockingIterable(), e.g.
+ *
+ *   auto items = requester->requestStream(request)->toBlockingIterable(256);
+ *   for (auto& item : *items) {
+ *     ...
+ *   }
+ *
+ * The items go from the thread of upstream to the consumer through a
+ * single-producer single-consumer ring of `prefetch` slots.  Upstream is asked
+ * for `prefetch` items when subscribed, then for as many as were taken each
+ * time a quarter of `prefetch` has been, so it never produces more than the
+ * ring holds and the requests go out in chunks.  The consumer only parks, on a
+ * futex, when the ring is empty, and upstream only wakes it then.
+ *
+ * next() and the iterators must only be used by one thread at a time.  Call
+ * cancel() to stop early, the subscription keeps this alive until then.
+ */
+template <typename T>
+class BlockingIterable : public BaseSubscriber<T> {
+ public:
+  class Iterator : public std::iterator<std::input_iterator_tag, T> {
+   public:
+    Iterator() = default;
+
+    explicit Iterator(BlockingIterable* iterable) : iterable_(iterable) {
+      ++*this;
+    }
+
+    T& operator*() {
+      return *value_;
+    }
+
+    T* operator->() {
+      return value_.get_pointer();
+    }
+
+    Iterator& operator++() {
+      value_ = iterable_->next();
+      if (!value_) {
+        iterable_ = nullptr;
+      }
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return iterable_ == other.iterable_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    BlockingIterable* iterable_{nullptr};
+    folly::Optional<T> value_;
+  };
+
+  explicit BlockingIterable(int64_t prefetch = 64)
+      : prefetch_(std::max<int64_t>(prefetch, 1)),
+        limit_(std::max<int64_t>(prefetch_ / 4, 1)),
+        queue_(static_cast<uint32_t>(prefetch_ + 1)) {}
+
+  /// Blocks for the next item.  None once the Flowable completed or this
+  /// was canceled, throws the error of the Flowable.
+  folly::Optional<T> next() {
+    while (true) {
+      if (auto value = take()) {
+        return value;
+      }
+      if (done_.load(std::memory_order_acquire)) {
+        // Items which arrived before the termination.
+        if (auto value = take()) {
+          return value;
+        }
+        if (error_) {
+          error_.throw_exception();
+        }
+        return folly::none;
+      }
+      park();
+    }
+  }
+
+  Iterator begin() {
+    return Iterator(this);
+  }
+
+  Iterator end() {
+    return Iterator();
+  }
+
+ private:
+  folly::Optional<T> take() {
+    auto front = queue_.frontPtr();
+    if (!front) {
+      return folly::none;
+    }
+    folly::Optional<T> value(std::move(*front));
+    queue_.popFront();
+    if (++taken_ >= limit_) {
+      BaseSubscriber<T>::request(taken_);
+      taken_ = 0;
+    }
+    return value;
+  }
+
+  /// Waits for an item or the termination, after announcing it so the next
+  /// signal wakes it up.
+  void park() {
+    baton_.reset();
+    waiting_.store(true, std::memory_order_seq_cst);
+    if (!queue_.isEmpty() || done_.load(std::memory_order_seq_cst)) {
+      if (waiting_.exchange(false)) {
+        return;
+      }
+      // The signal already claimed the wakeup, let it post before the baton
+      // is reset again.
+    }
+    baton_.wait();
+  }
+
+  void wake() {
+    if (waiting_.load(std::memory_order_seq_cst) && waiting_.exchange(false)) {
+      baton_.post();
+    }
+  }
+
+  void onSubscribeImpl() override {
+    BaseSubscriber<T>::request(prefetch_);
+  }
+
+  void onNextImpl(T value) override {
+    if (!queue_.write(std::move(value))) {
+      // Upstream sent more than it was asked for.
+      error_ = MissingBackpressureException();
+      BaseSubscriber<T>::cancel();
+      return;
+    }
+    wake();
+  }
+
+  void onCompleteImpl() override {}
+
+  void onErrorImpl(folly::exception_wrapper ew) override {
+    error_ = std::move(ew);
+  }
+
+  // Called after onComplete(), onError() and cancel(), once the error is set.
+  void onTerminateImpl() override {
+    done_.store(true, std::memory_order_seq_cst);
+    wake();
+  }
+
+  const int64_t prefetch_;
+  /// Items taken before they are requested again.
+  const int64_t limit_;
+
+  folly::ProducerConsumerQueue<T> queue_;
+  /// Written before done_ is set.
+  folly::exception_wrapper error_;
+  std::atomic<bool> done_{false};
+
+  std::atomic<bool> waiting_{false};
+  folly::Baton<> baton_;
+
+  // Only accessed by the consumer.
+  int64_t taken_{0};
+};
+
+} // namespace flowable
+} // namespace yarpl
@@ -9,6 +9,7 @@
 #include <atomic>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <folly/Conv.h>
 
@@ -53,21 +54,12 @@ class EmiterSubscription : public Subscription, public Subscriber<T> {
       throw std::logic_error(message);
     }
 
-    while (true) {
-      auto current = requested_.load(std::memory_order_relaxed);
-
-      if (current == kCanceled) {
-        // this can happen because there could be an async barrier between the
-        // subscriber and the subscription for instance while onComplete is
-        // being delivered (on effectively cancelled subscription) the
-        // subscriber can call request(n)
-        return;
-      }
-
-      auto const total = credits::add(current, delta);
-      if (requested_.compare_exchange_strong(current, total)) {
-        break;
-      }
+    if (credits::add(&requested_, delta) == kCanceled) {
+      // this can happen because there could be an async barrier between the
+      // subscriber and the subscription for instance while onComplete is
+      // being delivered (on effectively cancelled subscription) the
+      // subscriber can call request(n)
+      return;
     }
 
     process();
@@ -98,6 +90,12 @@ class EmiterSubscription : public Subscription, public Subscriber<T> {
     subscriber_->onNext(std::move(value));
   }
 
+  void onNextBatch(std::vector<T> values) override {
+    DCHECK(!hasFinished_) << "onComplete() or onError() already called";
+
+    subscriber_->onNextBatch(std::move(values));
+  }
+
   void onComplete() override {
     DCHECK(!hasFinished_) << "onComplete() or onError() already called";
     hasFinished_ = true;
@@ -154,16 +152,11 @@ class EmiterSubscription : public Subscription, public Subscriber<T> {
 
       std::tie(emitted, done) = emiter_->emit(this_subscriber, current);
 
-      while (true) {
-        current = requested_.load(std::memory_order_relaxed);
-        if (current == kCanceled || (current == kNoFlowControl && !done)) {
-          break;
-        }
-
-        auto updated = done ? kCanceled : current - emitted;
-        if (requested_.compare_exchange_strong(current, updated)) {
-          break;
-        }
+      // A single fetch_sub: this is the only place which consumes.
+      if (done) {
+        credits::cancel(&requested_);
+      } else {
+        credits::consume(&requested_, emitted);
       }
     }
   }
@@ -177,7 +170,7 @@ class EmiterSubscription : public Subscription, public Subscriber<T> {
   // adds n; each onNext consumes 1.  If this is MAX, flow-control is
   // disabled: items sent downstream don't consume any longer.  A MIN
   // value represents cancellation.  Other -ve values aren't permitted.
-  std::atomic_int_fast64_t requested_{0};
+  std::atomic<int64_t> requested_{0};
 
   bool hasFinished_{false}; // onComplete or onError called
 
@@ -2,9 +2,12 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -17,9 +20,34 @@
 #include <folly/Executor.h>
 #include <folly/functional/Invoke.h>
 
+namespace folly {
+class EventBase;
+}
+
 namespace yarpl {
 namespace flowable {
 
+template <typename T>
+class Flowable;
+
+template <typename T>
+class BlockingIterable;
+
+namespace detail {
+/// The type of the items of the Flowable referenced by a Reference.
+template <typename>
+struct FlowableValue;
+
+template <typename R>
+R flowableValue(const Flowable<R>*);
+
+/// Also of the operators returned with their concrete type, e.g. by map().
+template <typename F>
+struct FlowableValue<Reference<F>> {
+  using type = decltype(flowableValue(std::declval<F*>()));
+};
+} // namespace detail
+
 template <typename T>
 class Flowable : public virtual Refcounted, public yarpl::enable_get_ref {
  public:
@@ -77,26 +105,108 @@ class Flowable : public virtual Refcounted, public yarpl::enable_get_ref {
   template <
       typename Function,
       typename R = typename std::result_of<Function(T)>::type>
-  Reference<Flowable<R>> map(Function function);
+  auto map(Function function);
 
   template <typename Function>
-  Reference<Flowable<T>> filter(Function function);
+  auto filter(Function function);
 
   template <
       typename Function,
       typename R = typename std::result_of<Function(T, T)>::type>
   Reference<Flowable<R>> reduce(Function function);
 
+  /// Maps each item to a Flowable with `function` and merges the items of
+  /// these, subscribed to at most `maxConcurrency` at a time: the next item is
+  /// only requested once one of them has completed.  The items of the inner
+  /// Flowables are requested a few at a time ahead of the demand of the
+  /// subscriber, and interleaved as they arrive.
+  template <
+      typename Function,
+      typename R = typename detail::FlowableValue<
+          typename std::result_of<Function(T)>::type>::type>
+  Reference<Flowable<R>> flatMap(
+      Function function,
+      int64_t maxConcurrency = credits::kNoFlowControl);
+
+  /// flatMap() subscribing to one inner Flowable at a time, so their items
+  /// keep the order of the items they were mapped from.
+  template <
+      typename Function,
+      typename R = typename detail::FlowableValue<
+          typename std::result_of<Function(T)>::type>::type>
+  Reference<Flowable<R>> concatMap(Function function);
+
+  /// Maps the items with `function` on `rails` tasks of `executor` running
+  /// side by side, so a CPU-bound transform of a single stream can use several
+  /// cores.  Each rail maps the items dealt out to it one at a time, with a few
+  /// of them requested ahead.  The results keep the order of the items unless
+  /// `ordered` is false, in which case they go out as soon as they are ready.
+  /// `function` is called from several threads at once.
+  template <
+      typename Function,
+      typename R = typename std::result_of<Function(T)>::type>
+  Reference<Flowable<R>> parallelMap(
+      Function function,
+      folly::Executor& executor,
+      int64_t rails,
+      bool ordered = true);
+
   Reference<Flowable<T>> take(int64_t);
 
   Reference<Flowable<T>> skip(int64_t);
 
   Reference<Flowable<T>> ignoreElements();
 
+  /// Emits the items in vectors of `count` items, the last one holding the
+  /// items left when this Flowable completes.  The subscriber requests
+  /// vectors, and `count` items are requested for each of them.
+  Reference<Flowable<std::vector<T>>> buffer(int64_t count);
+
+  /// buffer() which also emits the items collected so far every `timespan`,
+  /// on the thread of `eventBase`, so they don't wait for a full vector when
+  /// the subscriber has requested one.
+  Reference<Flowable<std::vector<T>>> buffer(
+      int64_t count,
+      std::chrono::milliseconds timespan,
+      folly::EventBase& eventBase);
+
+  /// Requests `high` items upstream ahead of the demand of the subscriber, and
+  /// requests `low` more every time `low` of them have been delivered, so small
+  /// requests of the subscriber don't turn into as many requests upstream.
+  /// Items which arrive before the subscriber asks for them are buffered.
+  Reference<Flowable<T>> limitRate(int64_t high, int64_t low);
+
+  /// limitRate() which replenishes once 75% of `high` has been delivered.
+  Reference<Flowable<T>> limitRate(int64_t high);
+
+  /// Requests at most `permitsPerSecond` items a second upstream, in bursts of
+  /// up to `burst` items, with a token bucket refilled on a timer of
+  /// `eventBase`.  Upstream is only asked for items the subscriber requested,
+  /// so over a stream the responder is held back by REQUEST_N, rather than the
+  /// items being dropped once they have arrived.
+  Reference<Flowable<T>> rateLimit(
+      double permitsPerSecond,
+      int64_t burst,
+      folly::EventBase& eventBase);
+
   Reference<Flowable<T>> subscribeOn(folly::Executor&);
 
   Reference<Flowable<T>> observeOn(folly::Executor&);
 
+  /// Subscribes a BlockingIterable, for a thread to consume the items by
+  /// blocking on them, `prefetch` of them requested ahead.
+  Reference<BlockingIterable<T>> toBlockingIterable(int64_t prefetch = 64);
+
+  /// Multicasts one subscription of this Flowable to all the subscribers of
+  /// the returned one, which only asks upstream for what all of its current
+  /// subscribers have requested.  The subscribers get copies of the items.
+  Reference<Flowable<T>> share();
+
+  /// share() where the items are copied for the subscribers with `clone`,
+  /// which is called with a const reference to each item.
+  template <typename Clone>
+  Reference<Flowable<T>> share(Clone clone);
+
   template <
       typename Emitter,
       typename = typename std::enable_if<folly::is_invocable_r<
@@ -109,8 +219,15 @@ class Flowable : public virtual Refcounted, public yarpl::enable_get_ref {
 } // flowable
 } // yarpl
 
+#include "yarpl/flowable/BlockingIterable.h"
 #include "yarpl/flowable/EmitterFlowable.h"
+#include "yarpl/flowable/FlowableBufferOperator.h"
+#include "yarpl/flowable/FlowableFlatMapOperator.h"
 #include "yarpl/flowable/FlowableOperator.h"
+#include "yarpl/flowable/FlowableParallelMapOperator.h"
+#include "yarpl/flowable/FlowableRateLimitOperator.h"
+#include "yarpl/flowable/FlowableShareOperator.h"
+#include "yarpl/flowable/FlowableZipOperator.h"
 
 namespace yarpl {
 namespace flowable {
@@ -123,14 +240,16 @@ Reference<Flowable<T>> Flowable<T>::create(Emitter emitter) {
 
 template <typename T>
 template <typename Function, typename R>
-Reference<Flowable<R>> Flowable<T>::map(Function function) {
+auto Flowable<T>::map(Function function) {
+  // The concrete type lets a map() or filter() after this one fuse with it.
   return make_ref<MapOperator<T, R, Function>>(
       this->ref_from_this(this), std::move(function));
 }
 
 template <typename T>
 template <typename Function>
-Reference<Flowable<T>> Flowable<T>::filter(Function function) {
+auto Flowable<T>::filter(Function function) {
+  // The concrete type lets a filter() after this one fuse with it.
   return make_ref<FilterOperator<T, Function>>(
       this->ref_from_this(this), std::move(function));
 }
@@ -142,6 +261,32 @@ Reference<Flowable<R>> Flowable<T>::reduce(Function function) {
       this->ref_from_this(this), std::move(function));
 }
 
+template <typename T>
+template <typename Function, typename R>
+Reference<Flowable<R>> Flowable<T>::flatMap(
+    Function function,
+    int64_t maxConcurrency) {
+  return make_ref<detail::FlatMapOperator<T, R, Function>>(
+      this->ref_from_this(this), std::move(function), maxConcurrency);
+}
+
+template <typename T>
+template <typename Function, typename R>
+Reference<Flowable<R>> Flowable<T>::concatMap(Function function) {
+  return flatMap(std::move(function), 1);
+}
+
+template <typename T>
+template <typename Function, typename R>
+Reference<Flowable<R>> Flowable<T>::parallelMap(
+    Function function,
+    folly::Executor& executor,
+    int64_t rails,
+    bool ordered) {
+  return make_ref<detail::ParallelMapOperator<T, R, Function>>(
+      this->ref_from_this(this), std::move(function), executor, rails, ordered);
+}
+
 template <typename T>
 Reference<Flowable<T>> Flowable<T>::take(int64_t limit) {
   return make_ref<TakeOperator<T>>(this->ref_from_this(this), limit);
@@ -157,6 +302,40 @@ Reference<Flowable<T>> Flowable<T>::ignoreElements() {
   return make_ref<IgnoreElementsOperator<T>>(this->ref_from_this(this));
 }
 
+template <typename T>
+Reference<Flowable<std::vector<T>>> Flowable<T>::buffer(int64_t count) {
+  return make_ref<detail::BufferOperator<T>>(
+      this->ref_from_this(this), count, std::chrono::milliseconds(0), nullptr);
+}
+
+template <typename T>
+Reference<Flowable<std::vector<T>>> Flowable<T>::buffer(
+    int64_t count,
+    std::chrono::milliseconds timespan,
+    folly::EventBase& eventBase) {
+  return make_ref<detail::BufferOperator<T>>(
+      this->ref_from_this(this), count, timespan, &eventBase);
+}
+
+template <typename T>
+Reference<Flowable<T>> Flowable<T>::limitRate(int64_t high, int64_t low) {
+  return make_ref<LimitRateOperator<T>>(this->ref_from_this(this), high, low);
+}
+
+template <typename T>
+Reference<Flowable<T>> Flowable<T>::limitRate(int64_t high) {
+  return limitRate(high, high - high / 4);
+}
+
+template <typename T>
+Reference<Flowable<T>> Flowable<T>::rateLimit(
+    double permitsPerSecond,
+    int64_t burst,
+    folly::EventBase& eventBase) {
+  return make_ref<detail::RateLimitOperator<T>>(
+      this->ref_from_this(this), permitsPerSecond, burst, eventBase);
+}
+
 template <typename T>
 Reference<Flowable<T>> Flowable<T>::subscribeOn(folly::Executor& executor) {
   return make_ref<SubscribeOnOperator<T>>(this->ref_from_this(this), executor);
@@ -168,5 +347,25 @@ Reference<Flowable<T>> Flowable<T>::observeOn(folly::Executor& executor) {
       this->ref_from_this(this), executor);
 }
 
+template <typename T>
+Reference<BlockingIterable<T>> Flowable<T>::toBlockingIterable(
+    int64_t prefetch) {
+  auto iterable = make_ref<BlockingIterable<T>>(prefetch);
+  subscribe(iterable);
+  return iterable;
+}
+
+template <typename T>
+Reference<Flowable<T>> Flowable<T>::share() {
+  return share([](const T& value) { return value; });
+}
+
+template <typename T>
+template <typename Clone>
+Reference<Flowable<T>> Flowable<T>::share(Clone clone) {
+  return make_ref<detail::ShareOperator<T, Clone>>(
+      this->ref_from_this(this), std::move(clone));
+}
+
 } // flowable
 } // yarpl
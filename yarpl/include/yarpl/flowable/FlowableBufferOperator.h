@@ -0,0 +1,268 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <vector>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/Ticker.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Collects the items of upstream into vectors of `count` items, see
+/// Flowable::buffer().
+///
+/// Upstream is asked for `count` items per vector the subscriber requests,
+/// less the ones it was already asked for.  With an EventBase, the items
+/// collected so far are also emitted every `timespan` if the subscriber has
+/// requested a vector, so that a slow upstream doesn't hold them back.  A
+/// vector emitted by the timer takes the demand of a full one, the items it
+/// was short of can then collect beyond `count` until more vectors are
+/// requested.
+///
+/// Like for flatMap(), the signals are queued up and handled one at a time by
+/// the thread which found the queue empty: upstream, the timer and the
+/// subscriber can come from different threads.
+template <typename T>
+class BufferOperator : public Flowable<std::vector<T>> {
+ public:
+  BufferOperator(
+      Reference<Flowable<T>> upstream,
+      int64_t count,
+      std::chrono::milliseconds timespan,
+      folly::EventBase* eventBase)
+      : upstream_(std::move(upstream)),
+        count_(std::max<int64_t>(count, 1)),
+        timespan_(timespan),
+        eventBase_(eventBase) {}
+
+  void subscribe(Reference<Subscriber<std::vector<T>>> subscriber) override {
+    upstream_->subscribe(make_ref<Buffer>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  /// The subscriber of upstream, and the subscription of the subscriber.
+  class Buffer : public yarpl::flowable::Subscription,
+                 public BaseSubscriber<T> {
+   public:
+    Buffer(
+        Reference<BufferOperator> flowable,
+        Reference<Subscriber<std::vector<T>>> subscriber)
+        : flowable_(std::move(flowable)), subscriber_(std::move(subscriber)) {}
+
+    // Subscription.
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      Event event{Event::Type::REQUEST};
+      event.n = n;
+      enqueue(std::move(event));
+    }
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+   private:
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, REQUEST, CANCEL, TICK };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+      int64_t n{0};
+    };
+
+    // Subscriber.
+
+    void onSubscribeImpl() override {
+      if (auto eventBase = flowable_->eventBase_) {
+        ticker_ = make_ref<Ticker>(
+            *eventBase,
+            flowable_->timespan_,
+            [self = this->ref_from_this(this)] {
+              self->enqueue(Event{Event::Type::TICK});
+            });
+        ticker_->start();
+      }
+      auto subscriber = subscriber_;
+      subscriber->onSubscribe(this->ref_from_this(this));
+    }
+
+    void onNextImpl(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          if (outstanding_ > 0 && outstanding_ != credits::kNoFlowControl) {
+            --outstanding_;
+          }
+          values_.push_back(std::move(*event.value));
+          break;
+        case Event::Type::COMPLETE:
+          upstreamCompleted_ = true;
+          break;
+        case Event::Type::ERROR:
+          terminate(std::move(event.error));
+          return;
+        case Event::Type::REQUEST:
+          requested_ = credits::add(requested_, event.n);
+          emit();
+          requestUpstream();
+          return;
+        case Event::Type::CANCEL:
+          terminate(folly::exception_wrapper());
+          return;
+        case Event::Type::TICK:
+          if (!values_.empty() && requested_ > 0) {
+            emitVector(std::min<size_t>(values_.size(), flowable_->count_));
+          }
+          break;
+      }
+      emit();
+    }
+
+    /// Emits the full vectors the subscriber has requested, and once upstream
+    /// completed, the items left.
+    void emit() {
+      auto const count = static_cast<size_t>(flowable_->count_);
+      while (!terminated_ && requested_ > 0 && values_.size() >= count) {
+        emitVector(count);
+      }
+      if (terminated_ || !upstreamCompleted_) {
+        return;
+      }
+      if (!values_.empty()) {
+        if (requested_ == 0) {
+          return;
+        }
+        emitVector(values_.size());
+      }
+      terminated_ = true;
+      stopTicker();
+      auto subscriber = std::move(subscriber_);
+      subscriber->onComplete();
+    }
+
+    void emitVector(size_t size) {
+      std::vector<T> vector;
+      if (size == values_.size()) {
+        vector.swap(values_);
+      } else {
+        vector.reserve(size);
+        auto const end = values_.begin() + size;
+        std::move(values_.begin(), end, std::back_inserter(vector));
+        values_.erase(values_.begin(), end);
+      }
+      if (requested_ != credits::kNoFlowControl) {
+        --requested_;
+      }
+      subscriber_->onNext(std::move(vector));
+    }
+
+    /// Tops up the items requested from upstream to `count` per vector the
+    /// subscriber requested.
+    void requestUpstream() {
+      if (upstreamCompleted_ || outstanding_ == credits::kNoFlowControl) {
+        return;
+      }
+      auto const count = flowable_->count_;
+      if (requested_ > credits::kNoFlowControl / count) {
+        outstanding_ = credits::kNoFlowControl;
+        BaseSubscriber<T>::request(credits::kNoFlowControl);
+        return;
+      }
+      auto const wanted = requested_ * count -
+          static_cast<int64_t>(values_.size()) - outstanding_;
+      if (wanted > 0) {
+        outstanding_ += wanted;
+        BaseSubscriber<T>::request(wanted);
+      }
+    }
+
+    /// Cancels upstream, and passes the error on to the subscriber unless it
+    /// canceled.
+    void terminate(folly::exception_wrapper ew) {
+      terminated_ = true;
+      stopTicker();
+      BaseSubscriber<T>::cancel();
+      values_.clear();
+      auto subscriber = std::move(subscriber_);
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      }
+    }
+
+    void stopTicker() {
+      if (auto ticker = std::move(ticker_)) {
+        ticker->stop();
+      }
+    }
+
+    const Reference<BufferOperator> flowable_;
+    MpscQueue<Event> queue_;
+    Reference<Ticker> ticker_;
+
+    // Only accessed while handling a signal (or before the first one can be
+    // queued, for subscribing the subscriber).
+    Reference<Subscriber<std::vector<T>>> subscriber_;
+    std::vector<T> values_;
+    /// Vectors requested by the subscriber which haven't been emitted yet.
+    int64_t requested_{0};
+    /// Items requested from upstream which haven't arrived yet.
+    int64_t outstanding_{0};
+    bool upstreamCompleted_{false};
+    bool terminated_{false};
+  };
+
+  const Reference<Flowable<T>> upstream_;
+  const int64_t count_;
+  const std::chrono::milliseconds timespan_;
+  folly::EventBase* const eventBase_;
+};
+
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
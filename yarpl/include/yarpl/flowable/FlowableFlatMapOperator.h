@@ -0,0 +1,320 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <vector>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Subscribes to the Flowables `function` returns for the items of upstream,
+/// at most `maxConcurrency` of them at a time, and merges their items, see
+/// Flowable::flatMap().
+///
+/// Upstream is asked for `maxConcurrency` items, and for one more every time
+/// one of the inner Flowables completes.  The inner Flowables are asked for
+/// kPrefetch items, and for more as theirs are delivered, so at most
+/// kPrefetch items per inner Flowable are buffered while the subscriber has no
+/// demand.
+///
+/// The signals of upstream, of the inner Flowables and of the subscriber can
+/// come from any thread.  They are queued up and handled one at a time by the
+/// thread which found the queue empty, so the state of the merge is only
+/// accessed by one thread at a time without a lock.
+template <typename T, typename R, typename F>
+class FlatMapOperator : public Flowable<R> {
+ public:
+  FlatMapOperator(
+      Reference<Flowable<T>> upstream,
+      F function,
+      int64_t maxConcurrency)
+      : upstream_(std::move(upstream)),
+        function_(std::move(function)),
+        maxConcurrency_(std::max<int64_t>(maxConcurrency, 1)) {}
+
+  void subscribe(Reference<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(make_ref<Merger>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  static constexpr int64_t kPrefetch{32};
+
+  class Merger;
+
+  /// The subscriber of one of the inner Flowables.
+  class Inner : public BaseSubscriber<R> {
+   public:
+    explicit Inner(Reference<Merger> merger) : merger_(std::move(merger)) {}
+
+    void cancelInner() {
+      canceled_ = true;
+      BaseSubscriber<R>::cancel();
+    }
+
+   private:
+    friend class Merger;
+
+    void onSubscribeImpl() override {
+      // Canceled before the inner Flowable subscribed it.
+      if (canceled_) {
+        BaseSubscriber<R>::cancel();
+        return;
+      }
+      BaseSubscriber<R>::request(kPrefetch);
+    }
+
+    void onNextImpl(R value) override {
+      typename Merger::Event event{Merger::Event::Type::INNER_NEXT};
+      event.inner = this->ref_from_this(this);
+      event.innerValue = std::move(value);
+      merger_->enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      typename Merger::Event event{Merger::Event::Type::INNER_COMPLETE};
+      event.inner = this->ref_from_this(this);
+      merger_->enqueue(std::move(event));
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      typename Merger::Event event{Merger::Event::Type::ERROR};
+      event.error = std::move(ew);
+      merger_->enqueue(std::move(event));
+    }
+
+    /// Replenishes the items requested from the inner Flowable once half of
+    /// them have been delivered.
+    void delivered() {
+      if (++delivered_ >= kPrefetch / 2) {
+        BaseSubscriber<R>::request(delivered_);
+        delivered_ = 0;
+      }
+    }
+
+    const Reference<Merger> merger_;
+    std::atomic<bool> canceled_{false};
+
+    // Only accessed while the merger handles its signals.
+    std::deque<R> values_;
+    int64_t delivered_{0};
+    bool completed_{false};
+  };
+
+  /// The subscriber of upstream, and the subscription of the subscriber.
+  class Merger : public yarpl::flowable::Subscription,
+                 public BaseSubscriber<T> {
+   public:
+    Merger(
+        Reference<FlatMapOperator> flowable,
+        Reference<Subscriber<R>> subscriber)
+        : flowable_(std::move(flowable)), subscriber_(std::move(subscriber)) {}
+
+    // Subscription.
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      Event event{Event::Type::REQUEST};
+      event.n = n;
+      enqueue(std::move(event));
+    }
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+   private:
+    friend class Inner;
+
+    struct Event {
+      enum class Type {
+        NEXT,
+        COMPLETE,
+        ERROR,
+        INNER_NEXT,
+        INNER_COMPLETE,
+        REQUEST,
+        CANCEL
+      };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      Reference<Inner> inner;
+      folly::Optional<R> innerValue;
+      folly::exception_wrapper error;
+      int64_t n{0};
+    };
+
+    // Subscriber.
+
+    void onSubscribeImpl() override {
+      auto subscriber = subscriber_;
+      subscriber->onSubscribe(this->ref_from_this(this));
+      BaseSubscriber<T>::request(flowable_->maxConcurrency_);
+    }
+
+    void onNextImpl(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          subscribeInner(std::move(*event.value));
+          break;
+        case Event::Type::COMPLETE:
+          upstreamCompleted_ = true;
+          break;
+        case Event::Type::ERROR:
+          terminate(std::move(event.error));
+          return;
+        case Event::Type::INNER_NEXT:
+          event.inner->values_.push_back(std::move(*event.innerValue));
+          break;
+        case Event::Type::INNER_COMPLETE:
+          event.inner->completed_ = true;
+          break;
+        case Event::Type::REQUEST:
+          requested_ = credits::add(requested_, event.n);
+          break;
+        case Event::Type::CANCEL:
+          terminate(folly::exception_wrapper());
+          return;
+      }
+      if (!terminated_) {
+        deliver();
+      }
+    }
+
+    void subscribeInner(T value) {
+      Reference<Flowable<R>> flowable;
+      try {
+        flowable = flowable_->function_(std::move(value));
+      } catch (const std::exception& exn) {
+        terminate(folly::exception_wrapper{std::current_exception(), exn});
+        return;
+      }
+      auto inner = make_ref<Inner>(this->ref_from_this(this));
+      inners_.push_back(inner);
+      flowable->subscribe(std::move(inner));
+    }
+
+    /// Hands the buffered items over to the subscriber as far as its demand
+    /// goes, taking turns between the inner Flowables, then lets go of the
+    /// inner Flowables which are done.
+    void deliver() {
+      bool delivered = true;
+      while (delivered && requested_ > 0) {
+        delivered = false;
+        for (size_t i = 0; i < inners_.size() && requested_ > 0; ++i) {
+          auto& inner = *inners_[i];
+          if (inner.values_.empty()) {
+            continue;
+          }
+          auto value = std::move(inner.values_.front());
+          inner.values_.pop_front();
+          if (requested_ != credits::kNoFlowControl) {
+            --requested_;
+          }
+          delivered = true;
+          subscriber_->onNext(std::move(value));
+          inner.delivered();
+        }
+      }
+
+      auto const done = std::remove_if(
+          inners_.begin(), inners_.end(), [](const Reference<Inner>& inner) {
+            return inner->completed_ && inner->values_.empty();
+          });
+      auto const completed = std::distance(done, inners_.end());
+      inners_.erase(done, inners_.end());
+
+      if (upstreamCompleted_) {
+        if (inners_.empty()) {
+          terminated_ = true;
+          auto subscriber = std::move(subscriber_);
+          subscriber->onComplete();
+        }
+      } else if (completed > 0) {
+        BaseSubscriber<T>::request(completed);
+      }
+    }
+
+    /// Cancels upstream and the inner Flowables, and passes the error on to
+    /// the subscriber unless it canceled.
+    void terminate(folly::exception_wrapper ew) {
+      terminated_ = true;
+      BaseSubscriber<T>::cancel();
+      for (auto& inner : inners_) {
+        inner->cancelInner();
+      }
+      inners_.clear();
+      auto subscriber = std::move(subscriber_);
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      }
+    }
+
+    const Reference<FlatMapOperator> flowable_;
+    MpscQueue<Event> queue_;
+
+    // Only accessed while handling a signal (or before the first one can be
+    // queued, for subscribing the subscriber).
+    Reference<Subscriber<R>> subscriber_;
+    std::vector<Reference<Inner>> inners_;
+    int64_t requested_{0};
+    bool upstreamCompleted_{false};
+    bool terminated_{false};
+  };
+
+  const Reference<Flowable<T>> upstream_;
+  F function_;
+  const int64_t maxConcurrency_;
+};
+
+template <typename T, typename R, typename F>
+constexpr int64_t FlatMapOperator<T, R, F>::kPrefetch;
+
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
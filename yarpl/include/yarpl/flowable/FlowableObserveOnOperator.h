@@ -1,5 +1,8 @@
 #pragma once
 
+#include "yarpl/flowable/Signal.h"
+#include "yarpl/utils/MpscQueue.h"
+
 namespace yarpl {
 namespace flowable {
 namespace detail {
@@ -49,45 +52,49 @@ class ObserveOnOperatorSubscriber
 
   // all signaling methods are called from upstream EB
   void onSubscribe(Reference<Subscription> subscription) override {
-    executor_.add([
-      self = this->ref_from_this(this),
-      s = std::move(subscription)
-    ]() mutable {
-      auto subscription =
-          make_ref<ObserveOnOperatorSubscription<T>>(self, std::move(s));
-      self->inner_->onSubscribe(std::move(subscription));
-    });
+    enqueue(Signal<T>::subscribe(std::move(subscription)));
   }
   void onNext(T next) override {
-    executor_.add(
-        [ self = this->ref_from_this(this), n = std::move(next) ]() mutable {
-          if (!self->isCanceled_) {
-            self->inner_->onNext(std::move(n));
-          }
-        });
+    enqueue(Signal<T>::next(std::move(next)));
+  }
+  void onNextBatch(std::vector<T> values) override {
+    enqueue(Signal<T>::nextBatch(std::move(values)));
   }
   void onComplete() override {
-    executor_.add([self = this->ref_from_this(this)]() mutable {
-      if (!self->isCanceled_) {
-        self->inner_->onComplete();
-      }
-    });
+    enqueue(Signal<T>::complete());
   }
   void onError(folly::exception_wrapper err) override {
-    executor_.add(
-        [ self = this->ref_from_this(this), e = std::move(err) ]() mutable {
-          if (!self->isCanceled_) {
-            self->inner_->onError(std::move(e));
-          }
-        });
+    enqueue(Signal<T>::error(std::move(err)));
   }
 
  private:
   friend class ObserveOnOperatorSubscription<T>;
+
+  // Signals are queued up and delivered by a single task on executor_, which
+  // is only scheduled when the queue was empty.
+  void enqueue(Signal<T> signal) {
+    if (queue_.push(std::move(signal))) {
+      executor_.add([self = this->ref_from_this(this)] { self->drain(); });
+    }
+  }
+
+  void drain() {
+    queue_.drain([this](Signal<T> signal) {
+      if (signal.type() == Signal<T>::Type::SUBSCRIBE) {
+        auto subscription = make_ref<ObserveOnOperatorSubscription<T>>(
+            this->ref_from_this(this), signal.takeSubscription());
+        inner_->onSubscribe(std::move(subscription));
+      } else if (!isCanceled_) {
+        signal.deliverTo(*inner_);
+      }
+    });
+  }
+
   bool isCanceled_{false}; // only accessed in executor_ thread
 
   Reference<Subscriber<T>> inner_;
   folly::Executor& executor_;
+  MpscQueue<Signal<T>> queue_;
 };
 
 template <typename T>
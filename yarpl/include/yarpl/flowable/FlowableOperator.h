@@ -2,7 +2,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <deque>
 #include <utility>
 
 #include "yarpl/flowable/Flowable.h"
@@ -11,6 +13,7 @@
 #include "yarpl/utils/credits.h"
 
 #include <folly/Executor.h>
+#include <folly/Optional.h>
 #include <folly/functional/Invoke.h>
 
 namespace yarpl {
@@ -119,6 +122,9 @@ class FlowableOperator : public Flowable<D> {
   Reference<Flowable<U>> upstream_;
 };
 
+template <typename U, typename D, typename F, typename P>
+class MapFilterOperator;
+
 template <
     typename U,
     typename D,
@@ -132,12 +138,56 @@ class MapOperator : public FlowableOperator<U, D, MapOperator<U, D, F>> {
   MapOperator(Reference<Flowable<U>> upstream, F function)
       : Super(std::move(upstream)), function_(std::move(function)) {}
 
+  using Flowable<D>::subscribe;
+
   void subscribe(Reference<Subscriber<D>> subscriber) override {
     Super::upstream_->subscribe(make_ref<Subscription>(
         this->ref_from_this(this), std::move(subscriber)));
   }
 
+  /// Fuses `function` into this map: the returned operator maps with both in
+  /// one subscription.  Hides Flowable<D>::map(), which chains another
+  /// operator, as that one can only see this map through a
+  /// Reference<Flowable<D>>.
+  template <typename Function>
+  auto map(Function function) {
+    return fuseMap(std::move(function), std::is_copy_constructible<F>{});
+  }
+
+  /// Fuses `predicate` into this map: the returned operator maps and filters
+  /// the items in one subscription.
+  template <typename Predicate>
+  auto filter(Predicate predicate) {
+    return fuseFilter(std::move(predicate), std::is_copy_constructible<F>{});
+  }
+
  private:
+  template <typename Function>
+  auto fuseMap(Function function, std::true_type) {
+    using E = typename std::result_of<Function(D)>::type;
+    auto fused = [ first = function_, second = std::move(function) ](
+        U value) mutable { return second(first(std::move(value))); };
+    return make_ref<MapOperator<U, E, decltype(fused)>>(
+        Super::upstream_, std::move(fused));
+  }
+
+  /// This map's function can't be shared with the fused one.
+  template <typename Function>
+  auto fuseMap(Function function, std::false_type) {
+    return Flowable<D>::map(std::move(function));
+  }
+
+  template <typename Predicate>
+  auto fuseFilter(Predicate predicate, std::true_type) {
+    return make_ref<MapFilterOperator<U, D, F, Predicate>>(
+        Super::upstream_, function_, std::move(predicate));
+  }
+
+  template <typename Predicate>
+  auto fuseFilter(Predicate predicate, std::false_type) {
+    return Flowable<D>::filter(std::move(predicate));
+  }
+
   using SuperSubscription = typename Super::Subscription;
   class Subscription : public SuperSubscription {
    public:
@@ -160,6 +210,58 @@ class MapOperator : public FlowableOperator<U, D, MapOperator<U, D, F>> {
   F function_;
 };
 
+/// A filter() fused into the MapOperator preceding it: the items are mapped
+/// and checked in the same stage.
+template <typename U, typename D, typename F, typename P>
+class MapFilterOperator
+    : public FlowableOperator<U, D, MapFilterOperator<U, D, F, P>> {
+  using ThisOperatorT = MapFilterOperator<U, D, F, P>;
+  using Super = FlowableOperator<U, D, ThisOperatorT>;
+
+ public:
+  MapFilterOperator(Reference<Flowable<U>> upstream, F function, P predicate)
+      : Super(std::move(upstream)),
+        function_(std::move(function)),
+        predicate_(std::move(predicate)) {}
+
+  using Flowable<D>::subscribe;
+
+  void subscribe(Reference<Subscriber<D>> subscriber) override {
+    Super::upstream_->subscribe(make_ref<Subscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        Reference<ThisOperatorT> flowable,
+        Reference<Subscriber<D>> subscriber)
+        : SuperSubscription(std::move(flowable), std::move(subscriber)) {}
+
+    void onNextImpl(U value) override {
+      auto&& fused = this->getFlowableOperator();
+      folly::Optional<D> mapped;
+      try {
+        mapped = fused->function_(std::move(value));
+      } catch (const std::exception& exn) {
+        folly::exception_wrapper ew{std::current_exception(), exn};
+        this->terminateErr(std::move(ew));
+        return;
+      }
+      if (fused->predicate_(*mapped)) {
+        this->subscriberOnNext(std::move(*mapped));
+      } else {
+        SuperSubscription::request(1);
+      }
+    }
+  };
+
+  F function_;
+  P predicate_;
+};
+
 template <
     typename U,
     typename F,
@@ -174,12 +276,35 @@ class FilterOperator : public FlowableOperator<U, U, FilterOperator<U, F>> {
   FilterOperator(Reference<Flowable<U>> upstream, F function)
       : Super(std::move(upstream)), function_(std::move(function)) {}
 
+  using Flowable<U>::subscribe;
+
   void subscribe(Reference<Subscriber<U>> subscriber) override {
     Super::upstream_->subscribe(make_ref<Subscription>(
         this->ref_from_this(this), std::move(subscriber)));
   }
 
+  /// Fuses `predicate` into this filter: the returned operator checks both in
+  /// one subscription.
+  template <typename Predicate>
+  auto filter(Predicate predicate) {
+    return fuse(std::move(predicate), std::is_copy_constructible<F>{});
+  }
+
  private:
+  template <typename Predicate>
+  auto fuse(Predicate predicate, std::true_type) {
+    auto fused = [ first = function_, second = std::move(predicate) ](
+        const U& value) mutable { return first(value) && second(value); };
+    return make_ref<FilterOperator<U, decltype(fused)>>(
+        Super::upstream_, std::move(fused));
+  }
+
+  /// This filter's predicate can't be shared with the fused one.
+  template <typename Predicate>
+  auto fuse(Predicate predicate, std::false_type) {
+    return Flowable<U>::filter(std::move(predicate));
+  }
+
   using SuperSubscription = typename Super::Subscription;
   class Subscription : public SuperSubscription {
    public:
@@ -391,6 +516,113 @@ class IgnoreElementsOperator
   };
 };
 
+template <typename T>
+class LimitRateOperator : public FlowableOperator<T, T, LimitRateOperator<T>> {
+  using ThisOperatorT = LimitRateOperator<T>;
+  using Super = FlowableOperator<T, T, ThisOperatorT>;
+
+ public:
+  LimitRateOperator(Reference<Flowable<T>> upstream, int64_t high, int64_t low)
+      : Super(std::move(upstream)),
+        high_(std::max<int64_t>(high, 1)),
+        low_(std::min(std::max<int64_t>(low, 1), high_)) {}
+
+  void subscribe(Reference<Subscriber<T>> subscriber) override {
+    Super::upstream_->subscribe(make_ref<Subscription>(
+        this->ref_from_this(this), high_, low_, std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        Reference<ThisOperatorT> flowable,
+        int64_t high,
+        int64_t low,
+        Reference<Subscriber<T>> subscriber)
+        : SuperSubscription(std::move(flowable), std::move(subscriber)),
+          high_(high),
+          low_(low) {}
+
+    void request(int64_t delta) override {
+      if (delta <= 0) {
+        return;
+      }
+      demand_ = credits::add(demand_, delta);
+      if (!prefetched_) {
+        prefetched_ = true;
+        SuperSubscription::request(high_);
+      }
+      drain();
+    }
+
+    void cancel() override {
+      buffer_.clear();
+      SuperSubscription::cancel();
+    }
+
+    void onNextImpl(T value) override {
+      buffer_.push_back(std::move(value));
+      drain();
+    }
+
+    void onCompleteImpl() override {
+      completed_ = true;
+      drain();
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      // Errors are not delayed behind the buffered items.
+      buffer_.clear();
+      SuperSubscription::onErrorImpl(std::move(ew));
+    }
+
+   private:
+    void drain() {
+      // The subscriber can request more from within onNext.
+      if (draining_) {
+        return;
+      }
+      draining_ = true;
+      while (demand_ > 0 && !buffer_.empty()) {
+        auto value = std::move(buffer_.front());
+        buffer_.pop_front();
+        if (demand_ != credits::kNoFlowControl) {
+          --demand_;
+        }
+        SuperSubscription::subscriberOnNext(std::move(value));
+        if (++delivered_ == low_ && !completed_) {
+          delivered_ = 0;
+          SuperSubscription::request(low_);
+        }
+      }
+      draining_ = false;
+
+      if (completed_ && buffer_.empty()) {
+        completed_ = false;
+        SuperSubscription::onCompleteImpl();
+      }
+    }
+
+    const int64_t high_;
+    const int64_t low_;
+
+    /// Items requested by the subscriber, which have not been delivered yet.
+    int64_t demand_{0};
+    /// Items delivered since upstream was last asked for more.
+    int64_t delivered_{0};
+    /// Items received from upstream ahead of the demand of the subscriber.
+    std::deque<T> buffer_;
+    bool prefetched_{false};
+    bool draining_{false};
+    bool completed_{false};
+  };
+
+  const int64_t high_;
+  const int64_t low_;
+};
+
 template <typename T>
 class SubscribeOnOperator
     : public FlowableOperator<T, T, SubscribeOnOperator<T>> {
@@ -0,0 +1,309 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include <folly/Executor.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Maps the items of upstream with `function` on `rails` tasks of an
+/// executor, see Flowable::parallelMap().
+///
+/// The items are dealt out to the rails in turn.  Each rail maps its items
+/// one after the other, from a lock-free queue drained by one executor task
+/// at a time, so the rails run in parallel with one another but a rail never
+/// runs on two threads at once.  Upstream is asked for kPrefetch items per
+/// rail, and for more as the results are delivered, so at most that many
+/// items are being mapped or waiting for the subscriber.
+///
+/// The results come back in the order of the items, or as soon as they are
+/// ready when the order doesn't matter.  Like for flatMap(), the signals of
+/// upstream, of the rails and of the subscriber are queued up and handled one
+/// at a time by the thread which found the queue empty.
+template <typename T, typename R, typename F>
+class ParallelMapOperator : public Flowable<R> {
+ public:
+  ParallelMapOperator(
+      Reference<Flowable<T>> upstream,
+      F function,
+      folly::Executor& executor,
+      int64_t rails,
+      bool ordered)
+      : upstream_(std::move(upstream)),
+        function_(std::move(function)),
+        executor_(executor),
+        rails_(std::max<int64_t>(rails, 1)),
+        ordered_(ordered) {}
+
+  void subscribe(Reference<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(make_ref<Parallel>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  static constexpr int64_t kPrefetch{16};
+
+  class Parallel;
+
+  /// An item, numbered in the order of upstream, or the result of mapping
+  /// it.
+  template <typename V>
+  struct Numbered {
+    int64_t index{0};
+    folly::Optional<V> value;
+    folly::exception_wrapper error;
+  };
+
+  /// Maps the items dealt out to it, one at a time.
+  class Rail : public virtual Refcounted, public yarpl::enable_get_ref {
+   public:
+    explicit Rail(Reference<Parallel> parallel)
+        : parallel_(std::move(parallel)) {}
+
+    void push(Numbered<T> item) {
+      if (queue_.push(std::move(item))) {
+        auto&& executor = parallel_->flowable_->executor_;
+        executor.add([self = this->ref_from_this(this)] {
+          self->queue_.drain(
+              [&](Numbered<T> item) { self->map(std::move(item)); });
+        });
+      }
+    }
+
+    void cancelRail() {
+      canceled_ = true;
+    }
+
+   private:
+    void map(Numbered<T> item) {
+      if (canceled_) {
+        return;
+      }
+      Numbered<R> result;
+      result.index = item.index;
+      try {
+        result.value = parallel_->flowable_->function_(std::move(*item.value));
+      } catch (const std::exception& exn) {
+        result.error = folly::exception_wrapper{std::current_exception(), exn};
+      }
+      typename Parallel::Event event{Parallel::Event::Type::RESULT};
+      event.result = std::move(result);
+      parallel_->enqueue(std::move(event));
+    }
+
+    const Reference<Parallel> parallel_;
+    MpscQueue<Numbered<T>> queue_;
+    std::atomic<bool> canceled_{false};
+  };
+
+  /// The subscriber of upstream, and the subscription of the subscriber.
+  class Parallel : public yarpl::flowable::Subscription,
+                   public BaseSubscriber<T> {
+   public:
+    Parallel(
+        Reference<ParallelMapOperator> flowable,
+        Reference<Subscriber<R>> subscriber)
+        : flowable_(std::move(flowable)), subscriber_(std::move(subscriber)) {}
+
+    // Subscription.
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      Event event{Event::Type::REQUEST};
+      event.n = n;
+      enqueue(std::move(event));
+    }
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+   private:
+    friend class Rail;
+
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, RESULT, REQUEST, CANCEL };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      Numbered<R> result;
+      folly::exception_wrapper error;
+      int64_t n{0};
+    };
+
+    // Subscriber.
+
+    void onSubscribeImpl() override {
+      for (int64_t i = 0; i < flowable_->rails_; ++i) {
+        rails_.push_back(make_ref<Rail>(this->ref_from_this(this)));
+      }
+      auto subscriber = subscriber_;
+      subscriber->onSubscribe(this->ref_from_this(this));
+      // Only requested from here, so the rails are set before the first item.
+      BaseSubscriber<T>::request(window());
+    }
+
+    void onNextImpl(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT: {
+          Numbered<T> item;
+          item.index = dealt_++;
+          item.value = std::move(event.value);
+          rails_[item.index % rails_.size()]->push(std::move(item));
+          break;
+        }
+        case Event::Type::COMPLETE:
+          upstreamCompleted_ = true;
+          break;
+        case Event::Type::ERROR:
+          terminate(std::move(event.error));
+          return;
+        case Event::Type::RESULT:
+          if (event.result.error) {
+            terminate(std::move(event.result.error));
+            return;
+          }
+          results_.emplace(event.result.index, std::move(*event.result.value));
+          break;
+        case Event::Type::REQUEST:
+          requested_ = credits::add(requested_, event.n);
+          break;
+        case Event::Type::CANCEL:
+          terminate(folly::exception_wrapper());
+          return;
+      }
+      deliver();
+    }
+
+    /// Hands the results over to the subscriber as far as its demand goes,
+    /// in order if it matters, then asks upstream for as many items as were
+    /// delivered.
+    void deliver() {
+      int64_t delivered = 0;
+      while (requested_ > 0 && !results_.empty()) {
+        auto it = results_.begin();
+        if (flowable_->ordered_ && it->first != delivered_) {
+          break;
+        }
+        auto value = std::move(it->second);
+        results_.erase(it);
+        ++delivered_;
+        ++delivered;
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        subscriber_->onNext(std::move(value));
+      }
+
+      if (upstreamCompleted_) {
+        if (delivered_ == dealt_) {
+          terminated_ = true;
+          cancelRails();
+          auto subscriber = std::move(subscriber_);
+          subscriber->onComplete();
+        }
+      } else if (delivered > 0) {
+        BaseSubscriber<T>::request(delivered);
+      }
+    }
+
+    int64_t window() const {
+      return flowable_->rails_ * kPrefetch;
+    }
+
+    /// Cancels upstream and the rails, and passes the error on to the
+    /// subscriber unless it canceled.
+    void terminate(folly::exception_wrapper ew) {
+      terminated_ = true;
+      BaseSubscriber<T>::cancel();
+      cancelRails();
+      results_.clear();
+      auto subscriber = std::move(subscriber_);
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      }
+    }
+
+    void cancelRails() {
+      for (auto& rail : rails_) {
+        rail->cancelRail();
+      }
+      // The rails point back to this.
+      rails_.clear();
+    }
+
+    const Reference<ParallelMapOperator> flowable_;
+    MpscQueue<Event> queue_;
+
+    // Only accessed while handling a signal (or before the first one can be
+    // queued, for subscribing the subscriber).
+    Reference<Subscriber<R>> subscriber_;
+    std::vector<Reference<Rail>> rails_;
+    /// The results which arrived, by the index of their item.
+    std::map<int64_t, R> results_;
+    /// Items dealt out to the rails, and results delivered, so far.
+    int64_t dealt_{0};
+    int64_t delivered_{0};
+    int64_t requested_{0};
+    bool upstreamCompleted_{false};
+    bool terminated_{false};
+  };
+
+  const Reference<Flowable<T>> upstream_;
+  F function_;
+  folly::Executor& executor_;
+  const int64_t rails_;
+  const bool ordered_;
+};
+
+template <typename T, typename R, typename F>
+constexpr int64_t ParallelMapOperator<T, R, F>::kPrefetch;
+
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
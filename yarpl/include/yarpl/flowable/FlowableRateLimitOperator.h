@@ -0,0 +1,236 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/Ticker.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Paces the requests to upstream with a token bucket, see
+/// Flowable::rateLimit().
+///
+/// The bucket starts full with `burst` tokens and refills at
+/// `permitsPerSecond`.  Each item requested from upstream takes a token, and
+/// upstream is never asked for more than the subscriber requested, so the
+/// items go through as they arrive, nothing is buffered.  While the
+/// subscriber waits for items the bucket has no tokens for, a timer on the
+/// EventBase retries every time a token is due.
+///
+/// Like for buffer(), the signals are queued up and handled one at a time by
+/// the thread which found the queue empty: upstream, the timer and the
+/// subscriber can come from different threads.
+template <typename T>
+class RateLimitOperator : public Flowable<T> {
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  RateLimitOperator(
+      Reference<Flowable<T>> upstream,
+      double permitsPerSecond,
+      int64_t burst,
+      folly::EventBase& eventBase)
+      : upstream_(std::move(upstream)),
+        permitsPerSecond_(std::max(permitsPerSecond, 1e-3)),
+        burst_(std::max<int64_t>(burst, 1)),
+        eventBase_(eventBase) {}
+
+  void subscribe(Reference<Subscriber<T>> subscriber) override {
+    upstream_->subscribe(make_ref<RateLimiter>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  /// The time it takes to earn a token, 1ms at least.
+  std::chrono::milliseconds tokenInterval() const {
+    auto const ms = std::ceil(1000 / permitsPerSecond_);
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(std::min(std::max(ms, 1.0), 3.6e6)));
+  }
+
+  /// The subscriber of upstream, and the subscription of the subscriber.
+  class RateLimiter : public yarpl::flowable::Subscription,
+                      public BaseSubscriber<T> {
+   public:
+    RateLimiter(
+        Reference<RateLimitOperator> flowable,
+        Reference<Subscriber<T>> subscriber)
+        : flowable_(std::move(flowable)),
+          subscriber_(std::move(subscriber)),
+          tokens_(static_cast<double>(flowable_->burst_)),
+          refilled_(Clock::now()) {}
+
+    // Subscription.
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      Event event{Event::Type::REQUEST};
+      event.n = n;
+      enqueue(std::move(event));
+    }
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+   private:
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, REQUEST, CANCEL, TICK };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+      int64_t n{0};
+    };
+
+    // Subscriber.
+
+    void onSubscribeImpl() override {
+      ticker_ = make_ref<Ticker>(
+          flowable_->eventBase_,
+          flowable_->tokenInterval(),
+          [self = this->ref_from_this(this)] {
+            self->enqueue(Event{Event::Type::TICK});
+          });
+      ticker_->start();
+      auto subscriber = subscriber_;
+      subscriber->onSubscribe(this->ref_from_this(this));
+    }
+
+    void onNextImpl(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          if (outstanding_ > 0) {
+            --outstanding_;
+          }
+          if (requested_ > 0 && requested_ != credits::kNoFlowControl) {
+            --requested_;
+          }
+          subscriber_->onNext(std::move(*event.value));
+          break;
+        case Event::Type::COMPLETE:
+          terminate(folly::exception_wrapper(), true);
+          break;
+        case Event::Type::ERROR:
+          terminate(std::move(event.error), true);
+          break;
+        case Event::Type::REQUEST:
+          requested_ = credits::add(requested_, event.n);
+          requestUpstream();
+          break;
+        case Event::Type::CANCEL:
+          terminate(folly::exception_wrapper(), false);
+          break;
+        case Event::Type::TICK:
+          requestUpstream();
+          break;
+      }
+    }
+
+    /// Asks upstream for what the subscriber is still waiting for, as far as
+    /// the tokens allow.
+    void requestUpstream() {
+      auto const now = Clock::now();
+      auto const elapsed =
+          std::chrono::duration<double>(now - refilled_).count();
+      refilled_ = now;
+      tokens_ = std::min(
+          tokens_ + elapsed * flowable_->permitsPerSecond_,
+          static_cast<double>(flowable_->burst_));
+
+      auto const wanted = requested_ - outstanding_;
+      auto const n =
+          std::min(wanted, static_cast<int64_t>(std::floor(tokens_)));
+      if (n > 0) {
+        tokens_ -= n;
+        outstanding_ += n;
+        BaseSubscriber<T>::request(n);
+      }
+    }
+
+    /// Passes the termination of upstream on to the subscriber, or cancels
+    /// upstream if the subscriber canceled.
+    void terminate(folly::exception_wrapper ew, bool upstreamTerminated) {
+      terminated_ = true;
+      if (auto ticker = std::move(ticker_)) {
+        ticker->stop();
+      }
+      auto subscriber = std::move(subscriber_);
+      if (!upstreamTerminated) {
+        BaseSubscriber<T>::cancel();
+      } else if (ew) {
+        subscriber->onError(std::move(ew));
+      } else {
+        subscriber->onComplete();
+      }
+    }
+
+    const Reference<RateLimitOperator> flowable_;
+    MpscQueue<Event> queue_;
+    Reference<Ticker> ticker_;
+
+    // Only accessed while handling a signal (or before the first one can be
+    // queued, for subscribing the subscriber).
+    Reference<Subscriber<T>> subscriber_;
+    /// Items requested by the subscriber which haven't been delivered yet.
+    int64_t requested_{0};
+    /// Items requested from upstream which haven't arrived yet.
+    int64_t outstanding_{0};
+    double tokens_;
+    Clock::time_point refilled_;
+    bool terminated_{false};
+  };
+
+  const Reference<Flowable<T>> upstream_;
+  const double permitsPerSecond_;
+  const int64_t burst_;
+  folly::EventBase& eventBase_;
+};
+
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
@@ -0,0 +1,272 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Multicasts a single subscription of the upstream Flowable to all of its
+/// subscribers, see Flowable::share().
+///
+/// Upstream is subscribed to by the first subscriber, and canceled once all the
+/// subscribers have canceled; a later subscriber subscribes to it again.  It is
+/// asked for as many items as the subscriber with the least demand has
+/// requested, so every subscriber gets every item emitted while it has demand.
+/// A subscriber joining once items have been requested on behalf of the others
+/// misses those it didn't ask for, like with any hot Flowable.
+///
+/// Subscribers can request and cancel from any thread.  The items are delivered
+/// on the thread of the upstream Flowable, as clones made by `Clone` for all of
+/// the subscribers but the last.
+template <typename T, typename Clone>
+class ShareOperator : public Flowable<T> {
+ public:
+  ShareOperator(Reference<Flowable<T>> upstream, Clone clone)
+      : upstream_(std::move(upstream)), clone_(std::move(clone)) {}
+
+  void subscribe(Reference<Subscriber<T>> subscriber) override {
+    while (true) {
+      Reference<Connection> connection;
+      bool connect = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!connection_ || connection_->isTerminated()) {
+          connection_ = make_ref<Connection>(clone_);
+          connect = true;
+        }
+        connection = connection_;
+      }
+
+      auto downstream = make_ref<Downstream>(connection, subscriber);
+      if (!connection->add(downstream)) {
+        // Raced with the termination of the connection.
+        continue;
+      }
+      subscriber->onSubscribe(downstream);
+      if (connect) {
+        upstream_->subscribe(connection);
+      }
+      return;
+    }
+  }
+
+ private:
+  class Downstream;
+
+  /// The subscription of upstream, shared by the subscribers.
+  class Connection : public BaseSubscriber<T> {
+   public:
+    explicit Connection(Clone clone) : clone_(std::move(clone)) {}
+
+    bool isTerminated() const {
+      return terminated_;
+    }
+
+    bool add(Reference<Downstream> downstream) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (terminated_) {
+        return false;
+      }
+      downstreams_.push_back(std::move(downstream));
+      return true;
+    }
+
+    void request(Downstream& downstream, int64_t n) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        downstream.credits_ = credits::add(downstream.credits_, n);
+      }
+      requestUpstream();
+    }
+
+    void remove(Downstream& downstream) {
+      bool cancel = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(
+            downstreams_.begin(),
+            downstreams_.end(),
+            [&](const Reference<Downstream>& d) {
+              return d.get() == &downstream;
+            });
+        if (it == downstreams_.end()) {
+          return;
+        }
+        downstreams_.erase(it);
+        cancel = downstreams_.empty() && !terminated_;
+        if (cancel) {
+          terminated_ = true;
+        }
+      }
+      if (cancel) {
+        BaseSubscriber<T>::cancel();
+      } else {
+        // The subscriber which is gone might have been the slowest one.
+        requestUpstream();
+      }
+    }
+
+   private:
+    void onSubscribeImpl() override {
+      bool canceled;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribed_ = true;
+        canceled = terminated_;
+      }
+      if (canceled) {
+        BaseSubscriber<T>::cancel();
+        return;
+      }
+      requestUpstream();
+    }
+
+    void onNextImpl(T value) override {
+      std::vector<Reference<Downstream>> targets;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        for (auto& downstream : downstreams_) {
+          if (downstream->credits_ == 0) {
+            continue;
+          }
+          if (downstream->credits_ != credits::kNoFlowControl) {
+            --downstream->credits_;
+          }
+          targets.push_back(downstream);
+        }
+      }
+
+      if (targets.empty()) {
+        return;
+      }
+      for (size_t i = 0; i + 1 < targets.size(); ++i) {
+        targets[i]->onNext(clone_(static_cast<const T&>(value)));
+      }
+      targets.back()->onNext(std::move(value));
+    }
+
+    void onCompleteImpl() override {
+      for (auto& downstream : terminate()) {
+        downstream->onComplete();
+      }
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      for (auto& downstream : terminate()) {
+        downstream->onError(ew);
+      }
+    }
+
+    std::vector<Reference<Downstream>> terminate() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminated_ = true;
+      auto downstreams = std::move(downstreams_);
+      downstreams_.clear();
+      return downstreams;
+    }
+
+    /// Tops up the items requested from upstream to the demand of the slowest
+    /// subscriber.
+    void requestUpstream() {
+      int64_t n;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!subscribed_ || terminated_ || downstreams_.empty()) {
+          return;
+        }
+        auto demand = credits::kNoFlowControl;
+        for (auto& downstream : downstreams_) {
+          demand = std::min(demand, downstream->credits_);
+        }
+        if (demand <= requested_) {
+          return;
+        }
+        n = demand - requested_;
+        requested_ = demand;
+      }
+      BaseSubscriber<T>::request(n);
+    }
+
+    Clone clone_;
+
+    std::mutex mutex_;
+    std::vector<Reference<Downstream>> downstreams_;
+    /// Items requested from upstream which haven't arrived yet.
+    int64_t requested_{0};
+    bool subscribed_{false};
+    std::atomic<bool> terminated_{false};
+  };
+
+  /// The subscription of one subscriber.
+  class Downstream : public Subscription {
+   public:
+    Downstream(
+        Reference<Connection> connection,
+        Reference<Subscriber<T>> subscriber)
+        : connection_(std::move(connection)),
+          subscriber_(std::move(subscriber)) {}
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      connection_->request(*this, n);
+    }
+
+    void cancel() override {
+      if (subscriber_.exchange(nullptr)) {
+        connection_->remove(*this);
+      }
+    }
+
+    void onNext(T value) {
+      if (auto subscriber = subscriber_.load()) {
+        subscriber->onNext(std::move(value));
+      }
+    }
+
+    void onComplete() {
+      if (auto subscriber = subscriber_.exchange(nullptr)) {
+        subscriber->onComplete();
+      }
+    }
+
+    void onError(folly::exception_wrapper ew) {
+      if (auto subscriber = subscriber_.exchange(nullptr)) {
+        subscriber->onError(std::move(ew));
+      }
+    }
+
+   private:
+    friend class Connection;
+
+    const Reference<Connection> connection_;
+    AtomicReference<Subscriber<T>> subscriber_;
+    /// Items requested by the subscriber which haven't been delivered yet.
+    /// Guarded by the mutex of the connection.
+    int64_t credits_{0};
+  };
+
+  const Reference<Flowable<T>> upstream_;
+  const Clone clone_;
+
+  std::mutex mutex_;
+  Reference<Connection> connection_;
+};
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
@@ -0,0 +1,278 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace detail {
+
+/// Emits vectors of one item of each of the sources, in the order of the
+/// sources, see Flowables::zip().  Completes once one of the sources has
+/// completed and its items have all been zipped, and cancels the others then.
+///
+/// The sources are asked for kPrefetch items, and for more as theirs are
+/// zipped, so at most kPrefetch items per source are buffered while the
+/// subscriber has no demand or another source lags behind.
+///
+/// Like for flatMap(), the signals of the sources and of the subscriber are
+/// queued up and handled one at a time by the thread which found the queue
+/// empty, so the state of the zip is only accessed by one thread at a time
+/// without a lock.
+template <typename T>
+class ZipOperator : public Flowable<std::vector<T>> {
+ public:
+  explicit ZipOperator(std::vector<Reference<Flowable<T>>> sources)
+      : sources_(std::move(sources)) {}
+
+  void subscribe(Reference<Subscriber<std::vector<T>>> subscriber) override {
+    auto zipper = make_ref<Zipper>(sources_.size(), std::move(subscriber));
+    zipper->start(sources_);
+  }
+
+ private:
+  static constexpr int64_t kPrefetch{32};
+
+  class Zipper;
+
+  /// The subscriber of one of the sources.
+  class Inner : public BaseSubscriber<T> {
+   public:
+    Inner(Reference<Zipper> zipper, size_t index)
+        : zipper_(std::move(zipper)), index_(index) {}
+
+    void cancelInner() {
+      canceled_ = true;
+      BaseSubscriber<T>::cancel();
+    }
+
+   private:
+    friend class Zipper;
+
+    void onSubscribeImpl() override {
+      // Canceled before the source subscribed it.
+      if (canceled_) {
+        BaseSubscriber<T>::cancel();
+        return;
+      }
+      BaseSubscriber<T>::request(kPrefetch);
+    }
+
+    void onNextImpl(T value) override {
+      typename Zipper::Event event{Zipper::Event::Type::NEXT};
+      event.index = index_;
+      event.value = std::move(value);
+      zipper_->enqueue(std::move(event));
+    }
+
+    void onCompleteImpl() override {
+      typename Zipper::Event event{Zipper::Event::Type::COMPLETE};
+      event.index = index_;
+      zipper_->enqueue(std::move(event));
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      typename Zipper::Event event{Zipper::Event::Type::ERROR};
+      event.error = std::move(ew);
+      zipper_->enqueue(std::move(event));
+    }
+
+    /// Replenishes the items requested from the source once half of them
+    /// have been zipped.
+    void delivered() {
+      if (++delivered_ >= kPrefetch / 2) {
+        BaseSubscriber<T>::request(delivered_);
+        delivered_ = 0;
+      }
+    }
+
+    const Reference<Zipper> zipper_;
+    const size_t index_;
+    std::atomic<bool> canceled_{false};
+
+    // Only accessed while the zipper handles its signals.
+    std::deque<T> values_;
+    int64_t delivered_{0};
+    bool completed_{false};
+  };
+
+  /// The subscription of the subscriber.
+  class Zipper : public yarpl::flowable::Subscription,
+                 public yarpl::enable_get_ref {
+   public:
+    Zipper(size_t sources, Reference<Subscriber<std::vector<T>>> subscriber)
+        : sources_(sources), subscriber_(std::move(subscriber)) {}
+
+    /// Subscribes the subscriber, then the sources.
+    void start(const std::vector<Reference<Flowable<T>>>& sources) {
+      for (size_t i = 0; i < sources.size(); ++i) {
+        inners_.push_back(make_ref<Inner>(this->ref_from_this(this), i));
+      }
+      // The subscriber can cancel from onSubscribe(), which clears inners_.
+      auto inners = inners_;
+      auto subscriber = subscriber_;
+      subscriber->onSubscribe(this->ref_from_this(this));
+      if (sources.empty()) {
+        enqueue(Event{Event::Type::COMPLETE});
+        return;
+      }
+      for (size_t i = 0; i < sources.size(); ++i) {
+        sources[i]->subscribe(inners[i]);
+      }
+    }
+
+    // Subscription.
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      Event event{Event::Type::REQUEST};
+      event.n = n;
+      enqueue(std::move(event));
+    }
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+   private:
+    friend class Inner;
+
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, REQUEST, CANCEL };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      size_t index{0};
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+      int64_t n{0};
+    };
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          inners_[event.index]->values_.push_back(std::move(*event.value));
+          break;
+        case Event::Type::COMPLETE:
+          if (sources_ > 0) {
+            inners_[event.index]->completed_ = true;
+          }
+          break;
+        case Event::Type::ERROR:
+          terminate(std::move(event.error));
+          return;
+        case Event::Type::REQUEST:
+          requested_ = credits::add(requested_, event.n);
+          break;
+        case Event::Type::CANCEL:
+          terminate(folly::exception_wrapper());
+          return;
+      }
+      deliver();
+    }
+
+    /// Zips the buffered items as far as the demand of the subscriber goes,
+    /// then completes if one of the sources is done.
+    void deliver() {
+      while (requested_ > 0 && ready()) {
+        std::vector<T> values;
+        values.reserve(inners_.size());
+        for (auto& inner : inners_) {
+          values.push_back(std::move(inner->values_.front()));
+          inner->values_.pop_front();
+        }
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        subscriber_->onNext(std::move(values));
+        for (auto& inner : inners_) {
+          inner->delivered();
+        }
+      }
+
+      auto const done = sources_ == 0 ||
+          std::any_of(inners_.begin(), inners_.end(), [](const auto& inner) {
+                          return inner->completed_ && inner->values_.empty();
+                        });
+      if (done) {
+        terminated_ = true;
+        cancelInners();
+        auto subscriber = std::move(subscriber_);
+        subscriber->onComplete();
+      }
+    }
+
+    bool ready() const {
+      for (auto& inner : inners_) {
+        if (inner->values_.empty()) {
+          return false;
+        }
+      }
+      return !inners_.empty();
+    }
+
+    /// Cancels the sources, and passes the error on to the subscriber unless
+    /// it canceled.
+    void terminate(folly::exception_wrapper ew) {
+      terminated_ = true;
+      cancelInners();
+      auto subscriber = std::move(subscriber_);
+      if (ew) {
+        subscriber->onError(std::move(ew));
+      }
+    }
+
+    void cancelInners() {
+      for (auto& inner : inners_) {
+        inner->cancelInner();
+      }
+      // The inners point back to the zipper.
+      inners_.clear();
+    }
+
+    const size_t sources_;
+    MpscQueue<Event> queue_;
+
+    // Only accessed while handling a signal (or before the first one can be
+    // queued, for subscribing the subscriber and the sources).
+    Reference<Subscriber<std::vector<T>>> subscriber_;
+    std::vector<Reference<Inner>> inners_;
+    int64_t requested_{0};
+    bool terminated_{false};
+  };
+
+  const std::vector<Reference<Flowable<T>>> sources_;
+};
+
+template <typename T>
+constexpr int64_t ZipOperator<T>::kPrefetch;
+
+} // namespace detail
+} // namespace flowable
+} // namespace yarpl
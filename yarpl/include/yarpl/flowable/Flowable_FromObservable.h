@@ -2,9 +2,15 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/Synchronized.h>
-#include <deque>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
 #include "yarpl/Flowable.h"
+#include "yarpl/utils/RingBuffer.h"
 #include "yarpl/utils/credits.h"
 
 namespace yarpl {
@@ -24,6 +30,17 @@ class MissingBackpressureException : public std::runtime_error {
       : std::runtime_error("BACK_PRESSURE: DROP (missing credits onNext)") {}
 };
 
+/// What the BUFFER strategy of Observable::toFlowable() does with an item
+/// which arrives while its buffer holds as many items as it may.
+enum class BufferOverflowStrategy {
+  /// Drop the oldest buffered item to make room.
+  DROP_OLDEST,
+  /// Drop the item.
+  DROP_NEWEST,
+  /// Fail the Flowable with a MissingBackpressureException.
+  ERROR,
+};
+
 namespace details {
 
 template <typename T>
@@ -152,7 +169,16 @@ class FlowableFromObservableSubscriptionBufferStrategy
   using Super = FlowableFromObservableSubscription<T>;
 
  public:
-  using Super::FlowableFromObservableSubscription;
+  static constexpr size_t kUnbounded = std::numeric_limits<size_t>::max();
+
+  FlowableFromObservableSubscriptionBufferStrategy(
+      Reference<observable::Observable<T>> observable,
+      Reference<flowable::Subscriber<T>> subscriber,
+      size_t capacity = kUnbounded,
+      BufferOverflowStrategy overflow = BufferOverflowStrategy::ERROR)
+      : Super(std::move(observable), std::move(subscriber)),
+        capacity_(std::max<size_t>(capacity, 1)),
+        overflow_(overflow) {}
 
  private:
   void onComplete() override {
@@ -174,7 +200,29 @@ class FlowableFromObservableSubscriptionBufferStrategy
       return;
     }
 
-    buffer_->push_back(std::move(t));
+    {
+      auto&& lockedBuffer = buffer_.wlock();
+      if (lockedBuffer->size() < capacity_) {
+        lockedBuffer->push_back(std::move(t));
+        return;
+      }
+      switch (overflow_) {
+        case BufferOverflowStrategy::DROP_OLDEST:
+          lockedBuffer->pop_front();
+          lockedBuffer->push_back(std::move(t));
+          return;
+        case BufferOverflowStrategy::DROP_NEWEST:
+          return;
+        case BufferOverflowStrategy::ERROR:
+          break;
+      }
+    }
+
+    if (observable::Observer<T>::isUnsubscribedOrTerminated()) {
+      return;
+    }
+    Super::onError(MissingBackpressureException());
+    Super::cancel();
   }
 
   void onCreditsAvailable(int64_t credits) override {
@@ -190,10 +238,16 @@ class FlowableFromObservableSubscriptionBufferStrategy
     }
   }
 
-  folly::Synchronized<std::deque<T>> buffer_;
+  const size_t capacity_;
+  const BufferOverflowStrategy overflow_;
+  folly::Synchronized<RingBuffer<T>> buffer_;
   std::atomic<bool> completed_{false};
 };
 
+template <typename T>
+constexpr size_t
+    FlowableFromObservableSubscriptionBufferStrategy<T>::kUnbounded;
+
 template <typename T>
 class FlowableFromObservableSubscriptionLatestStrategy
     : public FlowableFromObservableSubscription<T> {
@@ -239,6 +293,132 @@ class FlowableFromObservableSubscriptionLatestStrategy
   folly::Synchronized<T> latest_;
 };
 
+/// The LATEST strategy per key: while the subscriber has no demand, only the
+/// latest item of each key, as given by `KeyFn`, is kept.  The items are
+/// delivered in the order their keys first arrived in, so a key updated over
+/// and over isn't starved by the others, and the memory held is bounded by
+/// the number of keys.
+template <typename T, typename KeyFn>
+class FlowableFromObservableSubscriptionLatestByKeyStrategy
+    : public FlowableFromObservableSubscription<T> {
+  using Super = FlowableFromObservableSubscription<T>;
+  using Key = typename std::decay<
+      typename std::result_of<KeyFn&(const T&)>::type>::type;
+
+ public:
+  FlowableFromObservableSubscriptionLatestByKeyStrategy(
+      Reference<observable::Observable<T>> observable,
+      Reference<flowable::Subscriber<T>> subscriber,
+      KeyFn keyFn)
+      : Super(std::move(observable), std::move(subscriber)),
+        keyFn_(std::move(keyFn)) {}
+
+ private:
+  struct Pending {
+    /// In the order the keys first arrived in.
+    RingBuffer<std::pair<Key, T>> items;
+    /// The sequence number of the item of each key in `items`.
+    std::unordered_map<Key, uint64_t> index;
+    /// The sequence number of the front item.
+    uint64_t front{0};
+    /// A thread delivers items, the others leave it to it.
+    bool draining{false};
+    /// The observable completed, the subscriber is told once it took the
+    /// pending items.
+    bool completed{false};
+  };
+
+  void onNext(T t) override {
+    bool conflated;
+    {
+      auto&& locked = pending_.wlock();
+      conflated = !locked->items.empty() || locked->draining ||
+          this->requested_ <= 0;
+      if (conflated) {
+        conflate(*locked, std::move(t));
+      }
+    }
+    if (conflated) {
+      drain();
+      return;
+    }
+    // Nothing is pending, and only this thread calls onNext().
+    this->subscriber_->onNext(std::move(t));
+    credits::consume(&this->requested_, 1);
+  }
+
+  void onComplete() override {
+    {
+      auto&& locked = pending_.wlock();
+      if (!locked->items.empty() || locked->draining) {
+        locked->completed = true;
+        return;
+      }
+    }
+    Super::onComplete();
+  }
+
+  //
+  // onError signal is delivered immediately by design
+  //
+
+  void onCreditsAvailable(int64_t credits) override {
+    DCHECK(credits > 0);
+    drain();
+  }
+
+  void conflate(Pending& pending, T t) {
+    auto key = keyFn_(static_cast<const T&>(t));
+    auto it = pending.index.find(key);
+    if (it != pending.index.end()) {
+      pending.items[it->second - pending.front].second = std::move(t);
+      return;
+    }
+    auto const sequence = pending.front + pending.items.size();
+    pending.index.emplace(key, sequence);
+    pending.items.push_back(std::make_pair(std::move(key), std::move(t)));
+  }
+
+  /// Delivers pending items while the subscriber requests them, and then
+  /// the completion they held back.
+  void drain() {
+    {
+      auto&& locked = pending_.wlock();
+      if (locked->draining) {
+        return;
+      }
+      locked->draining = true;
+    }
+    while (true) {
+      folly::Optional<T> next;
+      {
+        auto&& locked = pending_.wlock();
+        if (locked->items.empty() || this->requested_ <= 0) {
+          locked->draining = false;
+          if (!locked->items.empty() || !locked->completed) {
+            return;
+          }
+        } else {
+          auto& front = locked->items.front();
+          locked->index.erase(front.first);
+          next = std::move(front.second);
+          locked->items.pop_front();
+          ++locked->front;
+        }
+      }
+      if (!next) {
+        Super::onComplete();
+        return;
+      }
+      this->subscriber_->onNext(std::move(*next));
+      credits::consume(&this->requested_, 1);
+    }
+  }
+
+  KeyFn keyFn_;
+  folly::Synchronized<Pending> pending_;
+};
+
 template <typename T>
 class FlowableFromObservableSubscriptionMissingStrategy
     : public FlowableFromObservableSubscription<T> {
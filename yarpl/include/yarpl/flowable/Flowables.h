@@ -162,6 +162,42 @@ class Flowables {
     return Flowable<T>::create(std::move(lambda));
   }
 
+  /// Merges the items of `flowables`, subscribed to at most `maxConcurrency`
+  /// at a time, see Flowable::flatMap().  Each of them is only asked for what
+  /// it can buffer ahead of the subscriber.
+  template <typename T>
+  static Reference<Flowable<T>> merge(
+      std::vector<Reference<Flowable<T>>> flowables,
+      int64_t maxConcurrency = credits::kNoFlowControl) {
+    auto sources = Flowable<Reference<Flowable<T>>>::create([
+      flowables = std::move(flowables),
+      i = size_t{0}
+    ](Reference<Subscriber<Reference<Flowable<T>>>> subscriber,
+      int64_t requested) mutable {
+      int64_t emitted = 0;
+      while (i < flowables.size() && emitted < requested) {
+        subscriber->onNext(std::move(flowables[i++]));
+        ++emitted;
+      }
+      auto const done = i == flowables.size();
+      if (done) {
+        subscriber->onComplete();
+      }
+      return std::make_tuple(emitted, done);
+    });
+    return sources->flatMap(
+        [](Reference<Flowable<T>> flowable) { return flowable; },
+        maxConcurrency);
+  }
+
+  /// Emits vectors of one item of each of `flowables`, in their order, until
+  /// one of them completes.  Map the vectors to combine them.
+  template <typename T>
+  static Reference<Flowable<std::vector<T>>> zip(
+      std::vector<Reference<Flowable<T>>> flowables) {
+    return make_ref<detail::ZipOperator<T>>(std::move(flowables));
+  }
+
  private:
   Flowables() = delete;
 };
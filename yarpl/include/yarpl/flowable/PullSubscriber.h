@@ -0,0 +1,121 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
+
+#include "yarpl/flowable/Subscriber.h"
+
+namespace yarpl {
+namespace flowable {
+
+/**
+ * A Subscriber which is consumed by pulling its items one at a time, e.g.
+ *
+ *   auto items = make_ref<PullSubscriber<Payload>>();
+ *   requester->requestStream(request)->subscribe(items);
+ *   while (auto item = items->next().get()) {
+ *     ...
+ *   }
+ *
+ * Upstream is asked for `prefetch` items when subscribed and for one more
+ * every time next() takes one, so it never produces more than the consumer
+ * has room for.
+ *
+ * next() and cancel() can be called from any thread, the futures returned by
+ * next() are completed on the thread of the signal which completes them.
+ */
+template <typename T>
+class PullSubscriber : public BaseSubscriber<T> {
+ public:
+  explicit PullSubscriber(int64_t prefetch = 1)
+      : prefetch_(std::max<int64_t>(prefetch, 1)) {}
+
+  /// The next item, none once the Flowable completed or the subscriber was
+  /// canceled, or the error of the Flowable.  Only one next() can be pending
+  /// at a time.
+  folly::Future<folly::Optional<T>> next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!values_.empty()) {
+      auto value = std::move(values_.front());
+      values_.pop_front();
+      lock.unlock();
+      BaseSubscriber<T>::request(1);
+      return folly::makeFuture<folly::Optional<T>>(std::move(value));
+    }
+    if (error_) {
+      return folly::makeFuture<folly::Optional<T>>(error_);
+    }
+    if (terminated_) {
+      return folly::makeFuture<folly::Optional<T>>(folly::none);
+    }
+    DCHECK(!waiting_) << "next() called while another one is pending";
+    waiting_.emplace();
+    return waiting_->getFuture();
+  }
+
+ private:
+  void onSubscribeImpl() override {
+    BaseSubscriber<T>::request(prefetch_);
+  }
+
+  void onNextImpl(T value) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!waiting_) {
+      values_.push_back(std::move(value));
+      return;
+    }
+    auto waiting = takeWaiting();
+    lock.unlock();
+    waiting.setValue(std::move(value));
+    BaseSubscriber<T>::request(1);
+  }
+
+  void onCompleteImpl() override {}
+
+  void onErrorImpl(folly::exception_wrapper ew) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    error_ = ew;
+    if (waiting_) {
+      auto waiting = takeWaiting();
+      lock.unlock();
+      waiting.setException(std::move(ew));
+    }
+  }
+
+  // Called after onComplete(), onError() and cancel().
+  void onTerminateImpl() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    terminated_ = true;
+    if (waiting_) {
+      auto waiting = takeWaiting();
+      lock.unlock();
+      waiting.setValue(folly::none);
+    }
+  }
+
+  folly::Promise<folly::Optional<T>> takeWaiting() {
+    auto waiting = std::move(*waiting_);
+    waiting_.clear();
+    return waiting;
+  }
+
+  const int64_t prefetch_;
+
+  std::mutex mutex_;
+  /// Items which arrived before they were pulled.
+  std::deque<T> values_;
+  /// The promise of a pending next().
+  folly::Optional<folly::Promise<folly::Optional<T>>> waiting_;
+  folly::exception_wrapper error_;
+  bool terminated_{false};
+};
+
+} // namespace flowable
+} // namespace yarpl
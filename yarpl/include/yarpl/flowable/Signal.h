@@ -0,0 +1,92 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <vector>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+
+#include "yarpl/Refcounted.h"
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace yarpl {
+namespace flowable {
+
+/// One of the signals a Subscriber receives, for queueing them up to be
+/// delivered later (e.g. on another thread) in order.
+template <typename T>
+class Signal {
+ public:
+  enum class Type { SUBSCRIBE, NEXT, NEXT_BATCH, COMPLETE, ERROR };
+
+  static Signal subscribe(Reference<Subscription> subscription) {
+    Signal signal{Type::SUBSCRIBE};
+    signal.subscription_ = std::move(subscription);
+    return signal;
+  }
+
+  static Signal next(T value) {
+    Signal signal{Type::NEXT};
+    signal.value_ = std::move(value);
+    return signal;
+  }
+
+  static Signal nextBatch(std::vector<T> values) {
+    Signal signal{Type::NEXT_BATCH};
+    signal.values_ = std::move(values);
+    return signal;
+  }
+
+  static Signal complete() {
+    return Signal{Type::COMPLETE};
+  }
+
+  static Signal error(folly::exception_wrapper ew) {
+    Signal signal{Type::ERROR};
+    signal.error_ = std::move(ew);
+    return signal;
+  }
+
+  Type type() const {
+    return type_;
+  }
+
+  void deliverTo(Subscriber<T>& subscriber) {
+    switch (type_) {
+      case Type::SUBSCRIBE:
+        subscriber.onSubscribe(std::move(subscription_));
+        break;
+      case Type::NEXT:
+        subscriber.onNext(std::move(*value_));
+        break;
+      case Type::NEXT_BATCH:
+        subscriber.onNextBatch(std::move(values_));
+        break;
+      case Type::COMPLETE:
+        subscriber.onComplete();
+        break;
+      case Type::ERROR:
+        subscriber.onError(std::move(error_));
+        break;
+    }
+  }
+
+  /// The subscription carried by a SUBSCRIBE signal.
+  Reference<Subscription> takeSubscription() {
+    return std::move(subscription_);
+  }
+
+ private:
+  explicit Signal(Type type) : type_(type) {}
+
+  Type type_;
+  Reference<Subscription> subscription_;
+  folly::Optional<T> value_;
+  std::vector<T> values_;
+  folly::exception_wrapper error_;
+};
+
+} // namespace flowable
+} // namespace yarpl
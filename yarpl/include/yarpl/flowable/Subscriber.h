@@ -5,6 +5,8 @@
 #include "yarpl/Refcounted.h"
 #include "yarpl/flowable/Subscription.h"
 
+#include <vector>
+
 #include <folly/ExceptionWrapper.h>
 
 #include <glog/logging.h>
@@ -19,6 +21,15 @@ class Subscriber : public virtual Refcounted, public yarpl::enable_get_ref {
   virtual void onComplete() = 0;
   virtual void onError(folly::exception_wrapper) = 0;
   virtual void onNext(T) = 0;
+
+  /// Delivers several items at once, as if onNext() was called for each of
+  /// them.  Subscribers which can handle a batch for less than the sum of its
+  /// items (e.g. by writing them out together) override this.
+  virtual void onNextBatch(std::vector<T> values) {
+    for (auto& value : values) {
+      onNext(std::move(value));
+    }
+  }
 };
 
 #define KEEP_REF_TO_THIS() \
@@ -93,7 +104,9 @@ class BaseSubscriber : public Subscriber<T> {
     }
 #endif
 
-    if(auto sub = subscription_.load()) {
+    // Only checks the subscription instead of copying it: the item doesn't
+    // touch it, and a copy would cost an atomic inc/dec pair per item.
+    if (subscription_) {
       KEEP_REF_TO_THIS();
       onNextImpl(std::move(t));
     }
@@ -112,9 +125,10 @@ class BaseSubscriber : public Subscriber<T> {
 #endif
   }
 
+  // Doesn't keep a reference to this: the copy of the subscription keeps it
+  // alive for the call, and nothing touches this after it returns.
   void request(int64_t n) {
     if(auto sub = subscription_.load()) {
-      KEEP_REF_TO_THIS();
       sub->request(n);
     }
 #ifdef DEBUG
@@ -2,12 +2,14 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "yarpl/utils/type_traits.h"
 
@@ -21,6 +23,10 @@
 
 #include <folly/functional/Invoke.h>
 
+namespace folly {
+class EventBase;
+}
+
 namespace yarpl {
 namespace observable {
 
@@ -29,6 +35,8 @@ namespace observable {
 */
 enum class BackpressureStrategy { BUFFER, DROP, ERROR, LATEST, MISSING };
 
+using flowable::BufferOverflowStrategy;
+
 template <typename T>
 class Observable : public virtual Refcounted, public yarpl::enable_get_ref {
  public:
@@ -103,8 +111,47 @@ class Observable : public virtual Refcounted, public yarpl::enable_get_ref {
 
   Reference<Observable<T>> ignoreElements();
 
+  /// Emits the items in vectors of `count` items, the last one holding the
+  /// items left when this Observable completes.
+  Reference<Observable<std::vector<T>>> buffer(int64_t count);
+
+  /// buffer() which also emits the items collected so far every `timespan`,
+  /// on the thread of `eventBase`, so they don't wait for a full vector.
+  Reference<Observable<std::vector<T>>> buffer(
+      int64_t count,
+      std::chrono::milliseconds timespan,
+      folly::EventBase& eventBase);
+
+  /// Emits the latest item of upstream every `period`, on the thread of
+  /// `eventBase`, if there was one since the last time.
+  Reference<Observable<T>> sample(
+      std::chrono::milliseconds period,
+      folly::EventBase& eventBase);
+
+  /// sample(), under the name of the throttle operators.
+  Reference<Observable<T>> throttleLast(
+      std::chrono::milliseconds period,
+      folly::EventBase& eventBase);
+
+  /// Emits an item, then drops the items of upstream for `window`.  Needs no
+  /// timer, the items go through as they arrive.
+  Reference<Observable<T>> throttleFirst(std::chrono::milliseconds window);
+
+  /// Emits an item once upstream has been quiet for `timeout`, on the thread
+  /// of `eventBase`, and drops the items followed by another one sooner.
+  Reference<Observable<T>> debounce(
+      std::chrono::milliseconds timeout,
+      folly::EventBase& eventBase);
+
   Reference<Observable<T>> subscribeOn(folly::Executor&);
 
+  /// Delivers the signals to the observer on `executor`.  They are handed
+  /// over through a lock-free queue, one executor task delivers up to
+  /// `batchSize` of them.
+  Reference<Observable<T>> observeOn(
+      folly::Executor& executor,
+      size_t batchSize = 64);
+
   // function is invoked when onComplete occurs.
   template <typename Function>
   Reference<Observable<T>> doOnSubscribe(Function function);
@@ -143,6 +190,24 @@ class Observable : public virtual Refcounted, public yarpl::enable_get_ref {
   * Currently the only strategy is DROP.
   */
   auto toFlowable(BackpressureStrategy strategy);
+
+  /**
+   * Convert from Observable to Flowable with the BUFFER strategy, buffering at
+   * most `capacity` items while the subscriber has no demand.  `overflow`
+   * says what happens to the items beyond that.
+   */
+  auto toFlowable(size_t capacity, BufferOverflowStrategy overflow);
+
+  /**
+   * Convert from Observable to Flowable with the LATEST strategy applied per
+   * key: while the subscriber has no demand, only the latest item of each
+   * key, `keyFn(item)`, is kept, and the items are then delivered in the
+   * order their keys first came in.  Suits feeds of updates to a set of
+   * entities, where a slow subscriber is better off with their current
+   * state than with a backlog of stale updates.
+   */
+  template <typename KeyFn>
+  auto toFlowableLatestByKey(KeyFn keyFn);
 };
 } // observable
 } // yarpl
@@ -199,11 +264,64 @@ Reference<Observable<T>> Observable<T>::ignoreElements() {
   return make_ref<IgnoreElementsOperator<T>>(this->ref_from_this(this));
 }
 
+template <typename T>
+Reference<Observable<std::vector<T>>> Observable<T>::buffer(int64_t count) {
+  return make_ref<BufferOperator<T>>(
+      this->ref_from_this(this), count, std::chrono::milliseconds(0), nullptr);
+}
+
+template <typename T>
+Reference<Observable<std::vector<T>>> Observable<T>::buffer(
+    int64_t count,
+    std::chrono::milliseconds timespan,
+    folly::EventBase& eventBase) {
+  return make_ref<BufferOperator<T>>(
+      this->ref_from_this(this), count, timespan, &eventBase);
+}
+
+template <typename T>
+Reference<Observable<T>> Observable<T>::sample(
+    std::chrono::milliseconds period,
+    folly::EventBase& eventBase) {
+  return make_ref<SampleOperator<T>>(
+      this->ref_from_this(this), SampleMode::LATEST, period, &eventBase);
+}
+
+template <typename T>
+Reference<Observable<T>> Observable<T>::throttleLast(
+    std::chrono::milliseconds period,
+    folly::EventBase& eventBase) {
+  return sample(period, eventBase);
+}
+
+template <typename T>
+Reference<Observable<T>> Observable<T>::throttleFirst(
+    std::chrono::milliseconds window) {
+  return make_ref<SampleOperator<T>>(
+      this->ref_from_this(this), SampleMode::FIRST, window, nullptr);
+}
+
+template <typename T>
+Reference<Observable<T>> Observable<T>::debounce(
+    std::chrono::milliseconds timeout,
+    folly::EventBase& eventBase) {
+  return make_ref<SampleOperator<T>>(
+      this->ref_from_this(this), SampleMode::DEBOUNCE, timeout, &eventBase);
+}
+
 template <typename T>
 Reference<Observable<T>> Observable<T>::subscribeOn(folly::Executor& executor) {
   return make_ref<SubscribeOnOperator<T>>(this->ref_from_this(this), executor);
 }
 
+template <typename T>
+Reference<Observable<T>> Observable<T>::observeOn(
+    folly::Executor& executor,
+    size_t batchSize) {
+  return make_ref<ObserveOnOperator<T>>(
+      this->ref_from_this(this), executor, batchSize);
+}
+
 template <typename T>
 template <typename Function>
 Reference<Observable<T>> Observable<T>::doOnSubscribe(Function function) {
@@ -302,5 +420,37 @@ auto Observable<T>::toFlowable(BackpressureStrategy strategy) {
   });
 }
 
+template <typename T>
+auto Observable<T>::toFlowable(
+    size_t capacity,
+    BufferOverflowStrategy overflow) {
+  return yarpl::flowable::Flowables::fromPublisher<T>([
+    thisObservable = this->ref_from_this(this),
+    capacity,
+    overflow
+  ](Reference<flowable::Subscriber<T>> subscriber) {
+    auto subscription = make_ref<
+        flowable::details::FlowableFromObservableSubscriptionBufferStrategy<T>>(
+        thisObservable, subscriber, capacity, overflow);
+    subscriber->onSubscribe(std::move(subscription));
+  });
+}
+
+template <typename T>
+template <typename KeyFn>
+auto Observable<T>::toFlowableLatestByKey(KeyFn keyFn) {
+  return yarpl::flowable::Flowables::fromPublisher<T>([
+    thisObservable = this->ref_from_this(this),
+    keyFn = std::move(keyFn)
+  ](Reference<flowable::Subscriber<T>> subscriber) {
+    auto subscription =
+        make_ref<flowable::details::
+                     FlowableFromObservableSubscriptionLatestByKeyStrategy<
+                         T,
+                         KeyFn>>(thisObservable, subscriber, keyFn);
+    subscriber->onSubscribe(std::move(subscription));
+  });
+}
+
 } // observable
 } // yarpl
@@ -0,0 +1,173 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/Ticker.h"
+
+namespace yarpl {
+namespace observable {
+
+/// Collects the items of upstream into vectors of `count` items, see
+/// Observable::buffer().  With an EventBase, the items collected so far are
+/// also emitted every `timespan`, if there are any.
+///
+/// The items of upstream and the ticks of the timer come from different
+/// threads: they are queued up and handled one at a time by the thread which
+/// found the queue empty.
+template <typename T>
+class BufferOperator
+    : public ObservableOperator<T, std::vector<T>, BufferOperator<T>> {
+  using ThisOperatorT = BufferOperator<T>;
+  using Super = ObservableOperator<T, std::vector<T>, ThisOperatorT>;
+
+ public:
+  BufferOperator(
+      Reference<Observable<T>> upstream,
+      int64_t count,
+      std::chrono::milliseconds timespan,
+      folly::EventBase* eventBase)
+      : Super(std::move(upstream)),
+        count_(static_cast<size_t>(std::max<int64_t>(count, 1))),
+        timespan_(timespan),
+        eventBase_(eventBase) {}
+
+  Reference<Subscription> subscribe(
+      Reference<Observer<std::vector<T>>> observer) override {
+    auto subscription = make_ref<BufferSubscription>(
+        this->ref_from_this(this), std::move(observer));
+    subscription->startTicker();
+    Super::upstream_->subscribe(subscription);
+    return subscription;
+  }
+
+ private:
+  class BufferSubscription : public Super::OperatorSubscription {
+    using SuperSub = typename Super::OperatorSubscription;
+
+   public:
+    BufferSubscription(
+        Reference<ThisOperatorT> observable,
+        Reference<Observer<std::vector<T>>> observer)
+        : SuperSub(std::move(observable), std::move(observer)) {}
+
+    void startTicker() {
+      auto&& op = SuperSub::getObservableOperator();
+      if (op->eventBase_) {
+        ticker_ = make_ref<Ticker>(
+            *op->eventBase_,
+            op->timespan_,
+            [self = this->ref_from_this(this)] {
+              self->enqueue(Event{Event::Type::TICK});
+            });
+        ticker_->start();
+      }
+    }
+
+    void cancel() override {
+      stopTicker();
+      SuperSub::cancel();
+    }
+
+    void onNext(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onComplete() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onError(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+   private:
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, TICK };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+    };
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          values_.push_back(std::move(*event.value));
+          if (values_.size() >= SuperSub::getObservableOperator()->count_) {
+            emitValues();
+          }
+          break;
+        case Event::Type::TICK:
+          emitValues();
+          break;
+        case Event::Type::COMPLETE:
+          terminated_ = true;
+          stopTicker();
+          emitValues();
+          SuperSub::onComplete();
+          break;
+        case Event::Type::ERROR:
+          terminated_ = true;
+          stopTicker();
+          values_.clear();
+          SuperSub::onError(std::move(event.error));
+          break;
+      }
+    }
+
+    void emitValues() {
+      if (values_.empty()) {
+        return;
+      }
+      std::vector<T> values;
+      values.swap(values_);
+      SuperSub::observerOnNext(std::move(values));
+    }
+
+    void stopTicker() {
+      if (ticker_) {
+        ticker_->stop();
+      }
+    }
+
+    MpscQueue<Event> queue_;
+    /// Set before upstream is subscribed, and stopped only afterwards.
+    Reference<Ticker> ticker_;
+
+    // Only accessed while handling an event.
+    std::vector<T> values_;
+    bool terminated_{false};
+  };
+
+  const size_t count_;
+  const std::chrono::milliseconds timespan_;
+  folly::EventBase* const eventBase_;
+};
+
+} // namespace observable
+} // namespace yarpl
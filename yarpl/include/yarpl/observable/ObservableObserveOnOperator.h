@@ -0,0 +1,141 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+
+#include <folly/Executor.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+
+#include "yarpl/utils/MpscQueue.h"
+
+namespace yarpl {
+namespace observable {
+
+/// Delivers the signals of upstream to the observer on an executor, see
+/// Observable::observeOn().
+///
+/// The signals are queued up and delivered by a single task on the executor,
+/// which is only scheduled when the queue was empty.  A task delivers at most
+/// `batchSize` signals and schedules another one for the rest, so that a busy
+/// upstream doesn't hold up the other tasks of the executor.  Canceling goes
+/// through the same queue, the observer gets no signal after it.
+///
+/// onSubscribe() is passed on right away, on the thread of upstream.
+template <typename T>
+class ObserveOnOperator
+    : public ObservableOperator<T, T, ObserveOnOperator<T>> {
+  using ThisOperatorT = ObserveOnOperator<T>;
+  using Super = ObservableOperator<T, T, ThisOperatorT>;
+
+ public:
+  ObserveOnOperator(
+      Reference<Observable<T>> upstream,
+      folly::Executor& executor,
+      size_t batchSize)
+      : Super(std::move(upstream)),
+        executor_(executor),
+        batchSize_(std::max<size_t>(batchSize, 1)) {}
+
+  Reference<Subscription> subscribe(Reference<Observer<T>> observer) override {
+    auto subscription = make_ref<ObserveOnSubscription>(
+        this->ref_from_this(this), std::move(observer));
+    Super::upstream_->subscribe(subscription);
+    return subscription;
+  }
+
+ private:
+  class ObserveOnSubscription : public Super::OperatorSubscription {
+    using SuperSub = typename Super::OperatorSubscription;
+
+   public:
+    ObserveOnSubscription(
+        Reference<ThisOperatorT> observable,
+        Reference<Observer<T>> observer)
+        : SuperSub(std::move(observable), std::move(observer)) {}
+
+    void cancel() override {
+      enqueue(Event{Event::Type::CANCEL});
+    }
+
+    void onNext(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onComplete() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onError(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+   private:
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, CANCEL };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+    };
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        scheduleDrain();
+      }
+    }
+
+    void scheduleDrain() {
+      SuperSub::getObservableOperator()->executor_.add(
+          [self = this->ref_from_this(this)] { self->drain(); });
+    }
+
+    void drain() {
+      auto const batchSize = SuperSub::getObservableOperator()->batchSize_;
+      if (queue_.drainUpTo(
+              batchSize, [this](Event event) { handle(std::move(event)); })) {
+        scheduleDrain();
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      switch (event.type) {
+        case Event::Type::NEXT:
+          SuperSub::observerOnNext(std::move(*event.value));
+          break;
+        case Event::Type::COMPLETE:
+          terminated_ = true;
+          SuperSub::onComplete();
+          break;
+        case Event::Type::ERROR:
+          terminated_ = true;
+          SuperSub::onError(std::move(event.error));
+          break;
+        case Event::Type::CANCEL:
+          terminated_ = true;
+          SuperSub::cancel();
+          break;
+      }
+    }
+
+    MpscQueue<Event> queue_;
+    // Only accessed on the executor.
+    bool terminated_{false};
+  };
+
+  folly::Executor& executor_;
+  const size_t batchSize_;
+};
+
+} // namespace observable
+} // namespace yarpl
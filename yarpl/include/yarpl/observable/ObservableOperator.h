@@ -548,4 +548,7 @@ class FromPublisherOperator : public Observable<T> {
 }
 }
 
+#include "yarpl/observable/ObservableBufferOperator.h"
 #include "yarpl/observable/ObservableDoOperator.h"
+#include "yarpl/observable/ObservableObserveOnOperator.h"
+#include "yarpl/observable/ObservableSampleOperator.h"
@@ -0,0 +1,200 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/utils/MpscQueue.h"
+#include "yarpl/utils/Ticker.h"
+
+namespace yarpl {
+namespace observable {
+
+/// How SampleOperator thins out the items of upstream.
+enum class SampleMode {
+  /// The latest item of each period, see Observable::sample().
+  LATEST,
+  /// The first item of each period, see Observable::throttleFirst().
+  FIRST,
+  /// The items followed by a quiet period, see Observable::debounce().
+  DEBOUNCE,
+};
+
+/// Drops the items of upstream which come too close to one another, see
+/// SampleMode.  The latest item which is held back, if any, is emitted
+/// before the completion of upstream.
+///
+/// The timer only drives LATEST, every `period`, and DEBOUNCE, every quarter
+/// of `period`, which emits an item up to a quarter of `period` late.  FIRST
+/// only looks at the clock as the items arrive.  Like for buffer(), the items
+/// of upstream and the ticks of the timer are queued up and handled one at a
+/// time by the thread which found the queue empty.
+template <typename T>
+class SampleOperator : public ObservableOperator<T, T, SampleOperator<T>> {
+  using ThisOperatorT = SampleOperator<T>;
+  using Super = ObservableOperator<T, T, ThisOperatorT>;
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  SampleOperator(
+      Reference<Observable<T>> upstream,
+      SampleMode mode,
+      std::chrono::milliseconds period,
+      folly::EventBase* eventBase)
+      : Super(std::move(upstream)),
+        mode_(mode),
+        period_(std::max(period, std::chrono::milliseconds(1))),
+        eventBase_(eventBase) {}
+
+  Reference<Subscription> subscribe(Reference<Observer<T>> observer) override {
+    auto subscription = make_ref<SampleSubscription>(
+        this->ref_from_this(this), std::move(observer));
+    subscription->startTicker();
+    Super::upstream_->subscribe(subscription);
+    return subscription;
+  }
+
+ private:
+  class SampleSubscription : public Super::OperatorSubscription {
+    using SuperSub = typename Super::OperatorSubscription;
+
+   public:
+    SampleSubscription(
+        Reference<ThisOperatorT> observable,
+        Reference<Observer<T>> observer)
+        : SuperSub(std::move(observable), std::move(observer)) {}
+
+    void startTicker() {
+      auto&& op = SuperSub::getObservableOperator();
+      if (op->mode_ == SampleMode::FIRST || !op->eventBase_) {
+        return;
+      }
+      auto const interval = op->mode_ == SampleMode::DEBOUNCE
+          ? std::max(op->period_ / 4, std::chrono::milliseconds(1))
+          : op->period_;
+      ticker_ = make_ref<Ticker>(
+          *op->eventBase_, interval, [self = this->ref_from_this(this)] {
+            self->enqueue(Event{Event::Type::TICK});
+          });
+      ticker_->start();
+    }
+
+    void cancel() override {
+      stopTicker();
+      SuperSub::cancel();
+    }
+
+    void onNext(T value) override {
+      Event event{Event::Type::NEXT};
+      event.value = std::move(value);
+      enqueue(std::move(event));
+    }
+
+    void onComplete() override {
+      enqueue(Event{Event::Type::COMPLETE});
+    }
+
+    void onError(folly::exception_wrapper ew) override {
+      Event event{Event::Type::ERROR};
+      event.error = std::move(ew);
+      enqueue(std::move(event));
+    }
+
+   private:
+    struct Event {
+      enum class Type { NEXT, COMPLETE, ERROR, TICK };
+
+      explicit Event(Type t) : type(t) {}
+
+      Type type;
+      folly::Optional<T> value;
+      folly::exception_wrapper error;
+    };
+
+    void enqueue(Event event) {
+      if (queue_.push(std::move(event))) {
+        auto self = this->ref_from_this(this);
+        queue_.drain([this](Event e) { handle(std::move(e)); });
+      }
+    }
+
+    void handle(Event event) {
+      if (terminated_) {
+        return;
+      }
+      auto&& op = SuperSub::getObservableOperator();
+      switch (event.type) {
+        case Event::Type::NEXT:
+          if (op->mode_ == SampleMode::FIRST) {
+            auto const now = Clock::now();
+            if (now >= nextEmit_) {
+              nextEmit_ = now + op->period_;
+              SuperSub::observerOnNext(std::move(*event.value));
+            }
+            break;
+          }
+          latest_ = std::move(event.value);
+          if (op->mode_ == SampleMode::DEBOUNCE) {
+            latestAt_ = Clock::now();
+          }
+          break;
+        case Event::Type::TICK:
+          if (latest_ &&
+              (op->mode_ == SampleMode::LATEST ||
+               Clock::now() - latestAt_ >= op->period_)) {
+            emitLatest();
+          }
+          break;
+        case Event::Type::COMPLETE:
+          terminated_ = true;
+          stopTicker();
+          emitLatest();
+          SuperSub::onComplete();
+          break;
+        case Event::Type::ERROR:
+          terminated_ = true;
+          stopTicker();
+          latest_.clear();
+          SuperSub::onError(std::move(event.error));
+          break;
+      }
+    }
+
+    void emitLatest() {
+      if (!latest_) {
+        return;
+      }
+      auto value = std::move(*latest_);
+      latest_.clear();
+      SuperSub::observerOnNext(std::move(value));
+    }
+
+    void stopTicker() {
+      if (ticker_) {
+        ticker_->stop();
+      }
+    }
+
+    MpscQueue<Event> queue_;
+    /// Set before upstream is subscribed, and stopped only afterwards.
+    Reference<Ticker> ticker_;
+
+    // Only accessed while handling an event.
+    folly::Optional<T> latest_;
+    Clock::time_point latestAt_;
+    Clock::time_point nextEmit_;
+    bool terminated_{false};
+  };
+
+  const SampleMode mode_;
+  const std::chrono::milliseconds period_;
+  folly::EventBase* const eventBase_;
+};
+
+} // namespace observable
+} // namespace yarpl
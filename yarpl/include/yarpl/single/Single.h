@@ -88,7 +88,7 @@ class Single<void> : public virtual Refcounted {
       typename = typename std::enable_if<
           folly::is_invocable<Success>::value>::type>
   void subscribe(Success s) {
-    class SuccessSingleObserver : public SingleObserverBase<void> {
+    class SuccessSingleObserver final : public SingleObserverBase<void> {
      public:
       SuccessSingleObserver(Success success) : success_{std::move(success)} {}
 
@@ -144,7 +144,8 @@ template <typename T>
 template <typename Function>
 auto Single<T>::map(Function function) {
   using D = typename std::result_of<Function(T)>::type;
-  return make_ref<MapOperator<T, D, Function>, Single<D>>(
+  // The concrete type lets a map() after this one fuse with it.
+  return make_ref<MapOperator<T, D, Function>>(
       this->ref_from_this(this), std::move(function));
 }
 
@@ -60,7 +60,7 @@ class SingleObservers {
   };
 
   template <typename T, typename Success, typename Error>
-  class WithError : public Base<T, Success> {
+  class WithError final : public Base<T, Success> {
    public:
     WithError(Success next, Error error)
         : Base<T, Success>(std::move(next)), error_(std::move(error)) {}
@@ -2,10 +2,13 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/Try.h>
 #include <folly/functional/Invoke.h>
 
+#include <atomic>
 #include <utility>
+#include <vector>
 
 #include "yarpl/single/Single.h"
 #include "yarpl/single/SingleObserver.h"
@@ -152,7 +155,7 @@ template <
     typename D,
     typename F,
     typename = typename std::enable_if<folly::is_invocable_r<D, F, U>::value>::type>
-class MapOperator : public SingleOperator<U, D> {
+class MapOperator final : public SingleOperator<U, D> {
   using ThisOperatorT = MapOperator<U, D, F>;
   using Super = SingleOperator<U, D>;
   using OperatorSubscription =
@@ -169,8 +172,31 @@ class MapOperator : public SingleOperator<U, D> {
             this->ref_from_this(this), std::move(observer)));
   }
 
+  /// Fuses `function` into this map: the returned operator maps with both in
+  /// one subscription.  Hides Single<D>::map(), which chains another operator,
+  /// as that one can only see this map through a Reference<Single<D>>.
+  template <typename Function>
+  auto map(Function function) {
+    return fuse(std::move(function), std::is_copy_constructible<F>{});
+  }
+
  private:
-  class MapSubscription : public OperatorSubscription {
+  template <typename Function>
+  auto fuse(Function function, std::true_type) {
+    using E = typename std::result_of<Function(D)>::type;
+    auto fused = [ first = function_, second = std::move(function) ](
+        U value) mutable { return second(first(std::move(value))); };
+    return make_ref<MapOperator<U, E, decltype(fused)>>(
+        Super::upstream_, std::move(fused));
+  }
+
+  /// This map's function can't be shared with the fused one.
+  template <typename Function>
+  auto fuse(Function function, std::false_type) {
+    return Single<D>::map(std::move(function));
+  }
+
+  class MapSubscription final : public OperatorSubscription {
    public:
     MapSubscription(
         Reference<ThisOperatorT> single,
@@ -191,8 +217,152 @@ class MapOperator : public SingleOperator<U, D> {
   F function_;
 };
 
+/// Subscribes to all the upstream Singles at once, and succeeds with their
+/// values in order once they all succeeded.  The first error cancels the
+/// others and is passed on.
+///
+/// Each upstream writes its own slot of the results, so that only a
+/// countdown of the pending ones is shared between them.
+template <typename T>
+class WhenAllOperator : public Single<std::vector<T>> {
+ public:
+  explicit WhenAllOperator(std::vector<Reference<Single<T>>> upstreams)
+      : upstreams_(std::move(upstreams)) {}
+
+  void subscribe(Reference<SingleObserver<std::vector<T>>> observer) override {
+    auto state = make_ref<State>(std::move(observer), upstreams_.size());
+    // The state lets go of them once it terminated, maybe in the middle.
+    auto subscriptions = state->subscriptions_;
+    state->observer_->onSubscribe(
+        SingleSubscriptions::create([state] { state->cancel(); }));
+    if (upstreams_.empty()) {
+      state->succeed();
+      return;
+    }
+    for (size_t i = 0; i < upstreams_.size(); ++i) {
+      upstreams_[i]->subscribe(
+          make_ref<Inner>(state, i, std::move(subscriptions[i])));
+    }
+  }
+
+ private:
+  class State final : public virtual Refcounted {
+   public:
+    State(Reference<SingleObserver<std::vector<T>>> observer, size_t count)
+        : observer_(std::move(observer)), results_(count), pending_(count) {
+      subscriptions_.reserve(count);
+      for (size_t i = 0; i < count; ++i) {
+        subscriptions_.push_back(make_ref<DelegateSingleSubscription>());
+      }
+    }
+
+    void onSuccess(size_t index, T value) {
+      results_[index] = std::move(value);
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        succeed();
+      }
+    }
+
+    void succeed() {
+      if (!terminate()) {
+        return;
+      }
+      std::vector<T> values;
+      values.reserve(results_.size());
+      for (auto& result : results_) {
+        values.push_back(std::move(*result));
+      }
+      results_.clear();
+      subscriptions_.clear();
+      auto observer = std::move(observer_);
+      observer->onSuccess(std::move(values));
+    }
+
+    void onError(folly::exception_wrapper ex) {
+      if (!terminate()) {
+        return;
+      }
+      cancelUpstreams();
+      auto observer = std::move(observer_);
+      observer->onError(std::move(ex));
+    }
+
+    void cancel() {
+      if (!terminate()) {
+        return;
+      }
+      cancelUpstreams();
+      observer_.reset();
+    }
+
+    bool terminated() const {
+      return terminated_.load(std::memory_order_acquire);
+    }
+
+   private:
+    friend class WhenAllOperator;
+
+    /// Whether the caller is the one to terminate.
+    bool terminate() {
+      return !terminated_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    void cancelUpstreams() {
+      for (auto& subscription : subscriptions_) {
+        subscription->cancel();
+      }
+      subscriptions_.clear();
+    }
+
+    Reference<SingleObserver<std::vector<T>>> observer_;
+    std::vector<folly::Optional<T>> results_;
+    /// Lets the cancellation reach upstreams which haven't subscribed yet.
+    std::vector<Reference<DelegateSingleSubscription>> subscriptions_;
+    std::atomic<size_t> pending_;
+    std::atomic<bool> terminated_{false};
+  };
+
+  class Inner final : public SingleObserver<T> {
+   public:
+    Inner(
+        Reference<State> state,
+        size_t index,
+        Reference<DelegateSingleSubscription> subscription)
+        : state_(std::move(state)),
+          index_(index),
+          subscription_(std::move(subscription)) {}
+
+    void onSubscribe(Reference<SingleSubscription> subscription) override {
+      subscription_->setDelegate(std::move(subscription));
+    }
+
+    void onSuccess(T value) override {
+      if (auto state = std::move(state_)) {
+        if (!state->terminated()) {
+          state->onSuccess(index_, std::move(value));
+        }
+      }
+      subscription_.reset();
+    }
+
+    void onError(folly::exception_wrapper ex) override {
+      if (auto state = std::move(state_)) {
+        state->onError(std::move(ex));
+      }
+      subscription_.reset();
+    }
+
+   private:
+    Reference<State> state_;
+    const size_t index_;
+    Reference<DelegateSingleSubscription> subscription_;
+  };
+
+  const std::vector<Reference<Single<T>>> upstreams_;
+};
+
 template <typename T, typename OnSubscribe>
-class FromPublisherOperator : public Single<T> {
+class FromPublisherOperator final : public Single<T> {
  public:
   explicit FromPublisherOperator(OnSubscribe function)
       : function_(std::move(function)) {}
@@ -206,7 +376,7 @@ class FromPublisherOperator : public Single<T> {
 };
 
 template <typename OnSubscribe>
-class SingleVoidFromPublisherOperator : public Single<void> {
+class SingleVoidFromPublisherOperator final : public Single<void> {
  public:
   explicit SingleVoidFromPublisherOperator(OnSubscribe&& function)
       : function_(std::move(function)) {}
@@ -9,6 +9,8 @@
 
 #include <folly/functional/Invoke.h>
 
+#include <vector>
+
 namespace yarpl {
 namespace single {
 
@@ -61,6 +63,25 @@ class Singles {
     return Single<T>::create(std::move(lambda));
   }
 
+  /// Subscribes to all of `singles` at once, and succeeds with their values
+  /// in the same order once they have all succeeded.  Fails with the first
+  /// error, cancelling the others.  Succeeds right away if `singles` is empty.
+  template <typename T>
+  static Reference<Single<std::vector<T>>> whenAll(
+      std::vector<Reference<Single<T>>> singles) {
+    return make_ref<WhenAllOperator<T>, Single<std::vector<T>>>(
+        std::move(singles));
+  }
+
+  /// Like whenAll(), succeeding with the result of `combiner` applied to the
+  /// values.
+  template <typename T, typename Combiner>
+  static auto zip(
+      std::vector<Reference<Single<T>>> singles,
+      Combiner combiner) {
+    return whenAll(std::move(singles))->map(std::move(combiner));
+  }
+
  private:
   Singles() = delete;
 };
@@ -0,0 +1,112 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+#include <folly/Optional.h>
+
+namespace yarpl {
+
+/**
+ * Unbounded lock-free queue with many producers and a single consumer, meant
+ * for handing items over to a drain task running on another thread.
+ *
+ * push() tells the producer whether the queue was empty, in which case it is
+ * responsible for scheduling a drain.  drain() consumes items until the queue
+ * is empty again, including items pushed while it runs, so there is at most
+ * one drain task scheduled at a time, independent of the number of items.
+ *
+ * The queue is a linked list of nodes (after Dmitry Vyukov's intrusive MPSC
+ * queue): producers swap themselves in at the head with a single atomic
+ * exchange, the consumer follows the links from the tail.
+ */
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(new Node()), tail_(head_.load()) {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue() {
+    while (tail_) {
+      auto next = tail_->next.load(std::memory_order_relaxed);
+      delete tail_;
+      tail_ = next;
+    }
+  }
+
+  /// Enqueues an item.  Returns true if the queue was empty, and so a drain
+  /// has to be scheduled.  Can be called from any thread.
+  bool push(T value) {
+    auto node = new Node(std::move(value));
+    // Count the item before linking it, so the count never drops below the
+    // number of linked items.
+    auto const wasEmpty = size_.fetch_add(1, std::memory_order_acq_rel) == 0;
+    auto prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+    return wasEmpty;
+  }
+
+  /// Passes the queued items to `fn` in order until the queue is empty.  Must
+  /// only be called by one thread at a time, after push() returned true.
+  /// `fn` may push more items.
+  template <typename F>
+  void drain(F&& fn) {
+    do {
+      fn(pop());
+    } while (size_.fetch_sub(1, std::memory_order_acq_rel) != 1);
+  }
+
+  /// drain() which stops after `max` items.  Returns true if items are left,
+  /// in which case the caller is still responsible for draining them, e.g. by
+  /// scheduling another drain so that other tasks get to run in between.
+  template <typename F>
+  bool drainUpTo(size_t max, F&& fn) {
+    for (size_t i = 0; i < max; ++i) {
+      fn(pop());
+      if (size_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool empty() const {
+    return size_.load(std::memory_order_acquire) == 0;
+  }
+
+ private:
+  struct Node {
+    Node() = default;
+    explicit Node(T v) : value(std::move(v)) {}
+
+    std::atomic<Node*> next{nullptr};
+    folly::Optional<T> value;
+  };
+
+  T pop() {
+    Node* next;
+    // The item is counted, but its producer may not have linked it yet.
+    while (!(next = tail_->next.load(std::memory_order_acquire))) {
+      std::this_thread::yield();
+    }
+    delete tail_;
+    tail_ = next;
+    // The node of the popped item is the new tail.
+    T value = std::move(*next->value);
+    next->value.clear();
+    return value;
+  }
+
+  std::atomic<size_t> size_{0};
+  std::atomic<Node*> head_;
+  /// Only accessed by the consumer.
+  Node* tail_;
+};
+
+} // namespace yarpl
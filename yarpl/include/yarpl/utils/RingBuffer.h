@@ -0,0 +1,94 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <glog/logging.h>
+
+namespace yarpl {
+
+/**
+ * FIFO queue in a power-of-two array of slots, indexed with a mask.
+ *
+ * The array doubles when an item is pushed while it is full, so it only grows
+ * as large as the most items queued at once (rounded up to a power of two).
+ * Callers which need a bound check size() before pushing.  Not thread safe.
+ */
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(size_t initialCapacity = 16)
+      : slots_(roundUp(initialCapacity)) {}
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  /// The number of items it can hold before growing.
+  size_t capacity() const {
+    return slots_.size();
+  }
+
+  void push_back(T value) {
+    if (size_ == slots_.size()) {
+      grow();
+    }
+    slots_[(head_ + size_) & mask()] = std::move(value);
+    ++size_;
+  }
+
+  T& front() {
+    DCHECK(!empty());
+    return *slots_[head_];
+  }
+
+  /// The item `i` places behind the front one.
+  T& operator[](size_t i) {
+    DCHECK_LT(i, size_);
+    return *slots_[(head_ + i) & mask()];
+  }
+
+  void pop_front() {
+    DCHECK(!empty());
+    slots_[head_].clear();
+    head_ = (head_ + 1) & mask();
+    --size_;
+  }
+
+ private:
+  static size_t roundUp(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  size_t mask() const {
+    return slots_.size() - 1;
+  }
+
+  void grow() {
+    std::vector<folly::Optional<T>> slots(slots_.size() * 2);
+    for (size_t i = 0; i < size_; ++i) {
+      slots[i] = std::move(slots_[(head_ + i) & mask()]);
+    }
+    slots_.swap(slots);
+    head_ = 0;
+  }
+
+  std::vector<folly::Optional<T>> slots_;
+  /// Index of the front item.
+  size_t head_{0};
+  size_t size_{0};
+};
+
+} // namespace yarpl
@@ -0,0 +1,71 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include <folly/Function.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/Refcounted.h"
+
+namespace yarpl {
+
+/**
+ * Calls a function every `interval` on an EventBase until stopped, for the
+ * operators which emit on a timer as well as on their upstream.
+ *
+ * start() and stop() can be called from any thread, the function is only
+ * called on the thread of the EventBase.  Once stopped, the function is
+ * released on that thread and isn't called anymore.
+ */
+class Ticker : public virtual Refcounted,
+               public yarpl::enable_get_ref,
+               private folly::AsyncTimeout {
+ public:
+  Ticker(
+      folly::EventBase& eventBase,
+      std::chrono::milliseconds interval,
+      folly::Function<void()> tick)
+      : eventBase_(eventBase), interval_(interval), tick_(std::move(tick)) {}
+
+  void start() {
+    eventBase_.runInEventBaseThread([self = this->ref_from_this(this)] {
+      if (!self->stopped_) {
+        self->attachEventBase(&self->eventBase_);
+        self->scheduleTimeout(self->interval_);
+      }
+    });
+  }
+
+  void stop() {
+    if (stopped_.exchange(true)) {
+      return;
+    }
+    eventBase_.runInEventBaseThread([self = this->ref_from_this(this)] {
+      self->cancelTimeout();
+      self->tick_ = nullptr;
+    });
+  }
+
+ private:
+  void timeoutExpired() noexcept override {
+    if (stopped_) {
+      return;
+    }
+    tick_();
+    if (!stopped_) {
+      scheduleTimeout(interval_);
+    }
+  }
+
+  folly::EventBase& eventBase_;
+  const std::chrono::milliseconds interval_;
+  /// Only accessed on the thread of the EventBase once started.
+  folly::Function<void()> tick_;
+  std::atomic<bool> stopped_{false};
+};
+
+} // namespace yarpl
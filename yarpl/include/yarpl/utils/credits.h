@@ -21,8 +21,16 @@ constexpr int64_t kNoFlowControl{std::numeric_limits<int64_t>::max()};
  * to also deal with a separate boolean field per Subscription.
  *
  * These functions are thread-safe and intended to deal with concurrent
- * modification by all working off of std::atomic and using
- * compare_exchange_strong.
+ * modification by all working off of std::atomic.  As the Reactive Streams
+ * rules have it, request(n) is called serially and so is onNext(): add() and
+ * consume() each have one caller at a time, and rely on it to use a single
+ * fetch_add/fetch_sub away from the boundaries, which doesn't retry when the
+ * other side races with it.  Near INT64_MAX, compare_exchange loops saturate.
+ * A racing cancel() briefly leaves a value which isn't exactly INT64_MIN
+ * before it is put back.
+ *
+ * LocalCredits is the same without atomics, for subscriptions confined to one
+ * thread, e.g. to an EventBase.
  */
 
 /**
@@ -57,6 +65,11 @@ bool cancel(std::atomic<int64_t>*);
  */
 int64_t consume(std::atomic<int64_t>*, int64_t);
 
+/**
+ * Version of consume that works for non-atomic integers.
+ */
+int64_t consume(int64_t, int64_t);
+
 /**
  * Whether the current value represents a "cancelled" subscription.
  */
@@ -67,5 +80,45 @@ bool isCancelled(std::atomic<int64_t>*);
  */
 bool isInfinite(std::atomic<int64_t>*);
 
+/**
+ * The credits of a subscription only accessed by one thread, with the
+ * semantics of the functions above.
+ */
+class LocalCredits {
+ public:
+  int64_t add(int64_t n) {
+    value_ = credits::add(value_, n);
+    return value_;
+  }
+
+  int64_t consume(int64_t n) {
+    value_ = credits::consume(value_, n);
+    return value_;
+  }
+
+  bool cancel() {
+    if (value_ == kCanceled) {
+      return false;
+    }
+    value_ = kCanceled;
+    return true;
+  }
+
+  int64_t get() const {
+    return value_;
+  }
+
+  bool isCancelled() const {
+    return value_ == kCanceled;
+  }
+
+  bool isInfinite() const {
+    return value_ == kNoFlowControl;
+  }
+
+ private:
+  int64_t value_{0};
+};
+
 }
 }
@@ -0,0 +1,213 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include "yarpl/Census.h"
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+
+namespace yarpl {
+namespace detail {
+
+namespace {
+
+// The counters of a thread are allocated in blocks, as the types are used.
+constexpr size_t kBlockSize = 256;
+constexpr size_t kMaxBlocks = 64;
+constexpr size_t kMaxTypes = kBlockSize * kMaxBlocks;
+
+struct Counters {
+  // Only written by the thread owning them, read by census().
+  std::atomic<int64_t> created{0};
+  std::atomic<int64_t> destroyed{0};
+};
+
+struct Block {
+  Counters counters[kBlockSize];
+};
+
+class ThreadCounters;
+
+struct Registry {
+  std::mutex mutex;
+  // The type of each CensusId, from 1 on.
+  std::vector<const std::type_info*> types{nullptr};
+  std::vector<ThreadCounters*> threads;
+  // The counts of the threads which have exited.
+  std::vector<std::pair<int64_t, int64_t>> retired{{0, 0}};
+};
+
+// Never destroyed, threads may exit after the static destructors ran.
+Registry& registry() {
+  static auto* registry = new Registry();
+  return *registry;
+}
+
+void increment(std::atomic<int64_t>& counter) {
+  counter.store(
+      counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+class ThreadCounters {
+ public:
+  ThreadCounters() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+  }
+
+  ~ThreadCounters() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    for (CensusId id = 1; id < r.types.size(); ++id) {
+      if (auto counters = find(id)) {
+        r.retired[id].first += counters->created.load();
+        r.retired[id].second += counters->destroyed.load();
+      }
+    }
+    for (auto& block : blocks_) {
+      delete block.load();
+    }
+  }
+
+  Counters& get(CensusId id) {
+    auto& slot = blocks_[id / kBlockSize];
+    auto block = slot.load(std::memory_order_relaxed);
+    if (!block) {
+      block = new Block();
+      slot.store(block, std::memory_order_release);
+    }
+    return block->counters[id % kBlockSize];
+  }
+
+  /// Can be called from any thread, under the lock of the registry.
+  const Counters* find(CensusId id) const {
+    auto block = blocks_[id / kBlockSize].load(std::memory_order_acquire);
+    return block ? &block->counters[id % kBlockSize] : nullptr;
+  }
+
+ private:
+  std::atomic<Block*> blocks_[kMaxBlocks]{};
+};
+
+enum class ThreadState : uint8_t { NEW, COUNTING, EXITED };
+
+// Plain data, which outlives the counters of the thread.
+thread_local ThreadState threadState = ThreadState::NEW;
+
+/// The counters of the calling thread, or null once it destroyed them while
+/// exiting.
+ThreadCounters* threadCounters() {
+  if (threadState == ThreadState::EXITED) {
+    return nullptr;
+  }
+  thread_local struct Owner {
+    Owner() {
+      threadState = ThreadState::COUNTING;
+    }
+    ~Owner() {
+      threadState = ThreadState::EXITED;
+    }
+    ThreadCounters counters;
+  } owner;
+  return &owner.counters;
+}
+
+/// Counts an object created or destroyed by the destructor of a thread local
+/// which ran after the counters of its thread were destroyed.
+void countExited(CensusId id, bool created) {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto& retired = r.retired[id];
+  ++(created ? retired.first : retired.second);
+}
+
+std::string demangle(const std::type_info& type) {
+  int status;
+  auto demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (status != 0) {
+    return type.name();
+  }
+  std::string name = demangled;
+  std::free(demangled);
+  return name;
+}
+} // namespace
+
+CensusId registerCensusType(const std::type_info& type) {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  if (r.types.size() == kMaxTypes) {
+    return 0;
+  }
+  r.types.push_back(&type);
+  r.retired.emplace_back(0, 0);
+  return static_cast<CensusId>(r.types.size() - 1);
+}
+
+void censusCreated(CensusId id) {
+  if (auto counters = threadCounters()) {
+    increment(counters->get(id).created);
+  } else {
+    countExited(id, true);
+  }
+}
+
+void censusDestroyed(CensusId id) {
+  if (auto counters = threadCounters()) {
+    increment(counters->get(id).destroyed);
+  } else {
+    countExited(id, false);
+  }
+}
+
+} // namespace detail
+
+std::vector<CensusEntry> census() {
+  std::vector<CensusEntry> entries;
+  {
+    auto& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (detail::CensusId id = 1; id < r.types.size(); ++id) {
+      auto created = r.retired[id].first;
+      auto destroyed = r.retired[id].second;
+      for (auto thread : r.threads) {
+        if (auto counters = thread->find(id)) {
+          created += counters->created.load(std::memory_order_relaxed);
+          destroyed += counters->destroyed.load(std::memory_order_relaxed);
+        }
+      }
+      if (created > 0) {
+        CensusEntry entry;
+        entry.type = detail::demangle(*r.types[id]);
+        entry.live = created - destroyed;
+        entry.created = created;
+        entries.push_back(std::move(entry));
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return a.live != b.live ? a.live > b.live : a.created > b.created;
+  });
+  return entries;
+}
+
+void printCensus(std::ostream& os) {
+  // Long names are truncated.
+  constexpr size_t kTypeWidth = 50;
+
+  os << std::left << std::setw(kTypeWidth) << "TYPE" << " :: LIVE / CREATED"
+     << std::endl;
+  for (auto const& entry : census()) {
+    os << std::left << std::setw(kTypeWidth)
+       << entry.type.substr(0, kTypeWidth) << " :: " << entry.live << " / "
+       << entry.created << std::endl;
+  }
+}
+
+} // namespace yarpl
@@ -2,41 +2,50 @@
 
 #include "yarpl/utils/credits.h"
 
+#include <algorithm>
 #include <atomic>
 #include <limits>
 
 namespace yarpl {
 namespace credits {
 
+namespace {
+
+/// Puts back a value a fast path overwrote because it raced with a terminal
+/// one, canceled or unbounded: once either is reached, it stays.
+int64_t restore(std::atomic<std::int64_t>* current, int64_t terminal) {
+  auto r = current->load(std::memory_order_relaxed);
+  while (r != kCanceled &&
+         !current->compare_exchange_weak(
+             r, terminal, std::memory_order_acq_rel)) {
+  }
+  return r == kCanceled ? kCanceled : terminal;
+}
+
+} // namespace
+
 int64_t add(std::atomic<std::int64_t>* current, int64_t n) {
-  for (;;) {
-    auto r = current->load();
-    // if already "infinite"
-    if (r == kNoFlowControl) {
-      return kNoFlowControl;
-    }
-    // if already "cancelled"
-    if (r == kCanceled) {
-      return kCanceled;
-    }
-    if (n <= 0) {
-      // do nothing, return existing unmodified value
-      return r;
-    }
+  auto r = current->load(std::memory_order_relaxed);
+  if (n <= 0 || r == kCanceled || r == kNoFlowControl) {
+    return r;
+  }
 
-    if (r > kNoFlowControl - n) {
-      // will overflow
-      current->store(kNoFlowControl);
-      return kNoFlowControl;
+  if (r <= kNoFlowControl - n) {
+    // The requests are serialized, so no other add can take the value up to
+    // the boundary in the meantime, only a consume can take it down.
+    auto const previous = current->fetch_add(n, std::memory_order_acq_rel);
+    if (previous == kCanceled) {
+      return restore(current, kCanceled);
     }
+    return previous + n;
+  }
 
-    auto u = r + n;
-    // set the new number
-    if (current->compare_exchange_strong(r, u)) {
-      return u;
-    }
-    // if failed to set (concurrent modification) loop and try again
+  // Near the boundary, saturates.
+  while (r != kCanceled &&
+         !current->compare_exchange_weak(
+             r, add(r, n), std::memory_order_acq_rel)) {
   }
+  return r == kCanceled ? kCanceled : kNoFlowControl;
 }
 
 int64_t add(int64_t current, int64_t n) {
@@ -53,40 +62,38 @@ int64_t add(int64_t current, int64_t n) {
 }
 
 bool cancel(std::atomic<std::int64_t>* current) {
-  for (;;) {
-    auto r = current->load();
-    if (r == kCanceled) {
-      // already cancelled
-      return false;
-    }
-    // try cancelling
-    if (current->compare_exchange_strong(r, kCanceled)) {
-      return true;
-    }
-    // if failed to set (concurrent modification) loop and try again
-  }
+  return current->exchange(kCanceled, std::memory_order_acq_rel) != kCanceled;
 }
 
 int64_t consume(std::atomic<std::int64_t>* current, int64_t n) {
-  for (;;) {
-    auto r = current->load();
-    if (n <= 0) {
-      // do nothing, return existing unmodified value
-      return r;
-    }
-    if (r < n) {
-      // bad usage somewhere ... be resilient, just set to r
-      n = r;
+  auto r = current->load(std::memory_order_relaxed);
+  if (n <= 0 || r == kCanceled || r == kNoFlowControl) {
+    return r;
+  }
+
+  if (r >= n) {
+    // The items are emitted serially, so no other consume can take the value
+    // below n in the meantime, only an add can take it up.
+    auto const previous = current->fetch_sub(n, std::memory_order_acq_rel);
+    if (previous == kCanceled || previous == kNoFlowControl) {
+      return restore(current, previous);
     }
+    return previous - n;
+  }
 
-    auto u = r - n;
+  // Bad usage somewhere ... be resilient, go down to 0.
+  while (r != kCanceled && r != kNoFlowControl &&
+         !current->compare_exchange_weak(
+             r, r - std::min(r, n), std::memory_order_acq_rel)) {
+  }
+  return r == kCanceled || r == kNoFlowControl ? r : 0;
+}
 
-    // set the new number
-    if (current->compare_exchange_strong(r, u)) {
-      return u;
-    }
-    // if failed to set (concurrent modification) loop and try again
+int64_t consume(int64_t current, int64_t n) {
+  if (n <= 0 || current == kCanceled || current == kNoFlowControl) {
+    return current;
   }
+  return current - std::min(current, n);
 }
 
 bool isCancelled(std::atomic<std::int64_t>* current) {
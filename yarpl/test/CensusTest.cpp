@@ -0,0 +1,111 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <gtest/gtest.h>
+
+#include "yarpl/Census.h"
+#include "yarpl/Refcounted.h"
+
+namespace yarpl {
+
+namespace {
+
+class Counted : public virtual Refcounted {};
+class OtherCounted : public virtual Refcounted {};
+
+folly::Optional<CensusEntry> find(const std::string& type) {
+  for (auto& entry : census()) {
+    if (entry.type == type) {
+      return entry;
+    }
+  }
+  return folly::none;
+}
+
+int64_t live(const std::string& type) {
+  auto entry = find(type);
+  return entry ? entry->live : 0;
+}
+
+int64_t created(const std::string& type) {
+  auto entry = find(type);
+  return entry ? entry->created : 0;
+}
+}
+
+TEST(CensusTest, CountsLiveAndCreatedObjectsByType) {
+  auto const type = "yarpl::(anonymous namespace)::Counted";
+  auto const live0 = live(type);
+  auto const created0 = created(type);
+
+  auto first = make_ref<Counted>();
+  auto second = make_ref<Counted>();
+  auto other = make_ref<OtherCounted>();
+  EXPECT_EQ(live0 + 2, live(type));
+  EXPECT_EQ(created0 + 2, created(type));
+
+  // References don't count as objects.
+  auto copy = first;
+  EXPECT_EQ(live0 + 2, live(type));
+
+  first.reset();
+  copy.reset();
+  EXPECT_EQ(live0 + 1, live(type));
+  EXPECT_EQ(created0 + 2, created(type));
+
+  second.reset();
+  EXPECT_EQ(live0, live(type));
+  EXPECT_EQ(1, live("yarpl::(anonymous namespace)::OtherCounted"));
+}
+
+TEST(CensusTest, CountsTheConcreteType) {
+  auto const type = "yarpl::(anonymous namespace)::Counted";
+  auto const live0 = live(type);
+
+  auto ref = make_ref<Counted, Refcounted>();
+  EXPECT_EQ(live0 + 1, live(type));
+}
+
+TEST(CensusTest, DoesNotCountObjectsNotMadeByMakeRef) {
+  auto const type = "yarpl::(anonymous namespace)::Counted";
+  auto const created0 = created(type);
+
+  Counted counted;
+  EXPECT_EQ(created0, created(type));
+}
+
+TEST(CensusTest, CountsAcrossThreads) {
+  auto const type = "yarpl::(anonymous namespace)::Counted";
+  auto const live0 = live(type);
+  auto const created0 = created(type);
+
+  std::vector<Reference<Counted>> refs;
+  std::thread creator([&] {
+    for (int i = 0; i < 100; ++i) {
+      refs.push_back(make_ref<Counted>());
+    }
+  });
+  creator.join();
+  // The counts of an exited thread are kept.
+  EXPECT_EQ(live0 + 100, live(type));
+
+  std::thread destroyer([&] { refs.clear(); });
+  destroyer.join();
+  EXPECT_EQ(live0, live(type));
+  EXPECT_EQ(created0 + 100, created(type));
+}
+
+TEST(CensusTest, PrintsTheCensus) {
+  auto ref = make_ref<Counted>();
+  std::ostringstream os;
+  printCensus(os);
+  EXPECT_NE(
+      std::string::npos,
+      os.str().find("yarpl::(anonymous namespace)::Counted"));
+}
+
+} // namespace yarpl
@@ -74,4 +74,21 @@ TEST(FlowableSubscriberTest, TestKeepRefToThisIsEnabled) {
   subscriber->onSubscribe(subscription);
 }
 
+TEST(FlowableSubscriberTest, OnNextDoesNotCopySubscription) {
+  auto subscriber = yarpl::make_ref<StrictMock<MockBaseSubscriber<int>>>();
+  auto subscription = yarpl::make_ref<StrictMock<MockSubscription>>();
+
+  // one reference here, the other one in the subscriber
+  EXPECT_CALL(*subscriber, onSubscribeImpl());
+  EXPECT_CALL(*subscriber, onNextImpl(5)).WillOnce(InvokeWithoutArgs([&] {
+    EXPECT_EQ(2UL, subscription->count());
+  }));
+
+  subscriber->onSubscribe(subscription);
+  subscriber->onNext(5);
+
+  EXPECT_CALL(*subscription, cancel_());
+  subscriber->cancel();
+}
+
 }
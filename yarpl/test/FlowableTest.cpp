@@ -1,15 +1,23 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <memory>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
 #include <folly/Baton.h>
+#include <folly/Executor.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
 
 #include "yarpl/test_utils/Mocks.h"
 
 #include "yarpl/Flowable.h"
+#include "yarpl/flowable/BlockingIterable.h"
+#include "yarpl/flowable/PullSubscriber.h"
 #include "yarpl/flowable/TestSubscriber.h"
 
 namespace yarpl {
@@ -73,10 +81,10 @@ class CollectingSubscriber : public BaseSubscriber<T> {
 /// Construct a pipeline with a test subscriber against the supplied
 /// flowable.  Return the items that were sent to the subscriber.  If some
 /// exception was sent, the exception is thrown.
-template <typename T>
-std::vector<T> run(
-    Reference<Flowable<T>> flowable,
-    int64_t requestCount = 100) {
+template <
+    typename F,
+    typename T = typename detail::FlowableValue<Reference<F>>::type>
+std::vector<T> run(Reference<F> flowable, int64_t requestCount = 100) {
   auto subscriber = make_ref<TestSubscriber<T>>(requestCount);
   flowable->subscribe(subscriber);
   return std::move(subscriber->values());
@@ -259,6 +267,86 @@ TEST(FlowableTest, RangeWithMapAndFilter) {
   EXPECT_EQ(run(std::move(flowable)), std::vector<char>({11, 13, 15, 17, 19}));
 }
 
+namespace {
+template <typename T>
+struct FusedUpstream;
+
+template <typename U, typename D, typename F>
+struct FusedUpstream<Reference<MapOperator<U, D, F>>> {
+  using type = U;
+};
+
+template <typename U, typename F>
+struct FusedUpstream<Reference<FilterOperator<U, F>>> {
+  using type = U;
+};
+
+template <typename U, typename D, typename F, typename P>
+struct FusedUpstream<Reference<MapFilterOperator<U, D, F, P>>> {
+  using type = U;
+};
+} // namespace
+
+TEST(FlowableTest, FusedOperators) {
+  auto squares = Flowables::range(0, 10)->map([](int64_t v) { return v * v; });
+  auto maps = squares->map([](int64_t v) { return v + 1; })
+                  ->map([](int64_t v) { return std::to_string(v * 2); });
+  // Each map is fused down to the range.
+  static_assert(
+      std::is_same<FusedUpstream<decltype(maps)>::type, int64_t>::value,
+      "maps are fused");
+  EXPECT_EQ(
+      run(std::move(maps), 6),
+      std::vector<std::string>({"2", "4", "10", "20", "34", "52"}));
+
+  auto filtered = squares->filter([](int64_t v) { return v % 2 == 0; });
+  static_assert(
+      std::is_same<FusedUpstream<decltype(filtered)>::type, int64_t>::value,
+      "a filter is fused with a map");
+  EXPECT_EQ(
+      run(std::move(filtered)), std::vector<int64_t>({0, 4, 16, 36, 64}));
+
+  auto filters = Flowables::range(0, 20)
+                     ->filter([](int64_t v) { return v % 2 == 0; })
+                     ->filter([](int64_t v) { return v % 3 == 0; });
+  static_assert(
+      std::is_same<FusedUpstream<decltype(filters)>::type, int64_t>::value,
+      "filters are fused");
+  EXPECT_EQ(run(std::move(filters), 2), std::vector<int64_t>({0, 6}));
+
+  // The operators which were fused into others still work on their own.
+  EXPECT_EQ(run(std::move(squares), 4), std::vector<int64_t>({0, 1, 4, 9}));
+}
+
+TEST(FlowableTest, MapsOfMoveOnlyFunctionsChain) {
+  auto owned = std::make_unique<int64_t>(100);
+  auto flowable = Flowables::range(0, 3)
+                      ->map([owned = std::move(owned)](int64_t v) {
+                        return v + *owned;
+                      })
+                      ->map([](int64_t v) { return v * 2; });
+  EXPECT_EQ(
+      run(std::move(flowable)), std::vector<int64_t>({200, 202, 204}));
+}
+
+TEST(FlowableTest, FusedMapWithException) {
+  auto flowable = Flowables::justN<int>({1, 2, 3, 4})
+                      ->map([](int n) { return n + 1; })
+                      ->map([](int n) {
+                        if (n > 3) {
+                          throw std::runtime_error{"Too big!"};
+                        }
+                        return n;
+                      });
+
+  auto subscriber = yarpl::make_ref<TestSubscriber<int>>();
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(subscriber->values(), std::vector<int>({2, 3}));
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ(subscriber->getErrorMsg(), "Too big!");
+}
+
 TEST(FlowableTest, SimpleTake) {
   EXPECT_EQ(
       run(Flowables::range(0, 100)->take(3)), std::vector<int64_t>({0, 1, 2}));
@@ -313,6 +401,439 @@ TEST(FlowableTest, IgnoreElementsError) {
   EXPECT_EQ(subscriber->getErrorMsg(), kMsg);
 }
 
+TEST(FlowableTest, LimitRateBatchesRequests) {
+  std::vector<int64_t> requests;
+  int64_t next = 0;
+  auto flowable = Flowable<int64_t>::create(
+      [&requests, &next](auto subscriber, int64_t req) {
+        requests.push_back(req);
+        for (int64_t i = 0; i < req; ++i) {
+          subscriber->onNext(next++);
+        }
+        return std::make_tuple(req, false);
+      });
+
+  auto subscriber = make_ref<TestSubscriber<int64_t>>(1);
+  flowable->limitRate(10, 5)->subscribe(subscriber);
+  EXPECT_EQ(std::vector<int64_t>({10}), requests);
+
+  for (int i = 1; i < 20; ++i) {
+    subscriber->request(1);
+  }
+  subscriber->assertValueCount(20);
+  for (int64_t i = 0; i < 20; ++i) {
+    subscriber->assertValueAt(i, i);
+  }
+  EXPECT_EQ(std::vector<int64_t>({10, 5, 5, 5, 5}), requests);
+
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, LimitRateCompletesAfterBufferedItems) {
+  auto subscriber = make_ref<TestSubscriber<int64_t>>(1);
+  Flowables::range(0, 3)->limitRate(10)->subscribe(subscriber);
+
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0}));
+  EXPECT_FALSE(subscriber->isComplete());
+
+  subscriber->request(2);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, ShareRequestsForTheSlowestSubscriber) {
+  std::vector<int64_t> requests;
+  int64_t next = 0;
+  auto flowable = Flowable<int64_t>::create(
+      [&requests, &next](auto subscriber, int64_t req) {
+        requests.push_back(req);
+        for (int64_t i = 0; i < req; ++i) {
+          subscriber->onNext(next++);
+        }
+        return std::make_tuple(req, false);
+      });
+  int clones = 0;
+  auto shared = flowable->share([&clones](const int64_t& value) {
+    ++clones;
+    return value;
+  });
+
+  auto a = make_ref<TestSubscriber<int64_t>>(0);
+  auto b = make_ref<TestSubscriber<int64_t>>(2);
+  shared->subscribe(a);
+  shared->subscribe(b);
+  EXPECT_TRUE(requests.empty());
+
+  a->request(3);
+  b->request(3);
+  EXPECT_EQ(std::vector<int64_t>({2, 1}), requests);
+  EXPECT_EQ(3, clones);
+
+  // the slowest subscriber is gone
+  b->cancel();
+  EXPECT_EQ(std::vector<int64_t>({2, 1}), requests);
+  a->request(2);
+  EXPECT_EQ(std::vector<int64_t>({2, 1, 2}), requests);
+
+  EXPECT_EQ(a->values(), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(b->values(), std::vector<int64_t>({0, 1, 2}));
+  a->cancel();
+}
+
+TEST(FlowableTest, ShareResubscribesAfterCompletion) {
+  auto shared = Flowables::range(0, 3)->share();
+
+  for (int i = 0; i < 2; ++i) {
+    auto subscriber = make_ref<TestSubscriber<int64_t>>();
+    shared->subscribe(subscriber);
+    EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2}));
+    EXPECT_TRUE(subscriber->isComplete());
+  }
+}
+
+TEST(FlowableTest, FlatMapLimitsConcurrency) {
+  std::vector<Reference<Subscriber<int64_t>>> inners;
+  inners.reserve(3);
+  auto flowable = Flowables::range(0, 3)->flatMap(
+      [&inners](int64_t) {
+        return Flowables::fromPublisher<int64_t>(
+            [&inners](Reference<Subscriber<int64_t>> subscriber) {
+              subscriber->onSubscribe(Subscription::empty());
+              inners.push_back(std::move(subscriber));
+            });
+      },
+      2);
+
+  auto subscriber = make_ref<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  ASSERT_EQ(2U, inners.size());
+
+  inners[1]->onNext(10);
+  inners[0]->onNext(0);
+  inners[1]->onComplete();
+  // The third item is only requested once an inner Flowable completed.
+  ASSERT_EQ(3U, inners.size());
+
+  inners[2]->onNext(20);
+  inners[0]->onComplete();
+  EXPECT_FALSE(subscriber->isComplete());
+  inners[2]->onComplete();
+
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({10, 0, 20}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, FlatMapFollowsDemand) {
+  auto flowable = Flowables::range(0, 4)->flatMap(
+      [](int64_t v) { return Flowables::range(v * 10, 2); });
+
+  auto subscriber = make_ref<TestSubscriber<int64_t>>(3);
+  flowable->subscribe(subscriber);
+  subscriber->assertValueCount(3);
+  EXPECT_FALSE(subscriber->isComplete());
+
+  subscriber->request(10);
+  EXPECT_TRUE(subscriber->isComplete());
+  auto values = subscriber->values();
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, std::vector<int64_t>({0, 1, 10, 11, 20, 21, 30, 31}));
+}
+
+TEST(FlowableTest, ConcatMapKeepsOrder) {
+  auto flowable = Flowables::range(1, 3)->concatMap(
+      [](int64_t v) { return Flowables::range(v * 10, 2); });
+  EXPECT_EQ(
+      run(std::move(flowable)),
+      std::vector<int64_t>({10, 11, 20, 21, 30, 31}));
+}
+
+TEST(FlowableTest, FlatMapInnerError) {
+  auto flowable = Flowables::range(0, 3)->flatMap([](int64_t v) {
+    return v == 1
+        ? Flowables::error<int64_t>(std::runtime_error("Inner failed"))
+        : Flowables::just(v);
+  });
+
+  auto subscriber = make_ref<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0}));
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ(subscriber->getErrorMsg(), "Inner failed");
+}
+
+TEST(FlowableTest, BufferByCount) {
+  auto flowable = Flowables::range(0, 5)->buffer(2);
+  auto subscriber = make_ref<TestSubscriber<std::vector<int64_t>>>(2);
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(
+      subscriber->values(),
+      std::vector<std::vector<int64_t>>({{0, 1}, {2, 3}}));
+  EXPECT_FALSE(subscriber->isComplete());
+
+  subscriber->request(1);
+  EXPECT_EQ(
+      subscriber->values(),
+      std::vector<std::vector<int64_t>>({{0, 1}, {2, 3}, {4}}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, BufferByTime) {
+  folly::EventBase evb;
+  Reference<Subscriber<int64_t>> upstream;
+  auto flowable = Flowables::fromPublisher<int64_t>(
+                      [&upstream](Reference<Subscriber<int64_t>> subscriber) {
+                        subscriber->onSubscribe(Subscription::empty());
+                        upstream = std::move(subscriber);
+                      })
+                      ->buffer(10, std::chrono::milliseconds(10), evb);
+  auto subscriber = make_ref<TestSubscriber<std::vector<int64_t>>>();
+  flowable->subscribe(subscriber);
+
+  upstream->onNext(1);
+  upstream->onNext(2);
+  EXPECT_EQ(0, subscriber->getValueCount());
+
+  // The timer emits the items, and stops once upstream completes.
+  evb.runAfterDelay([&upstream] { upstream->onComplete(); }, 100);
+  evb.loop();
+
+  EXPECT_EQ(
+      subscriber->values(), std::vector<std::vector<int64_t>>({{1, 2}}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+namespace {
+/// Runs the tasks added to it when asked to, the last added first.
+class ReversingExecutor : public folly::Executor {
+ public:
+  void add(folly::Func task) override {
+    tasks_.push_back(std::move(task));
+  }
+
+  void runTasks() {
+    auto tasks = std::move(tasks_);
+    tasks_.clear();
+    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+      (*it)();
+    }
+  }
+
+ private:
+  std::vector<folly::Func> tasks_;
+};
+
+std::vector<int64_t> runParallelMap(bool ordered) {
+  ReversingExecutor executor;
+  auto flowable = Flowables::range(0, 4)->parallelMap(
+      [](int64_t v) { return v * 10; }, executor, 2, ordered);
+  auto subscriber = make_ref<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+
+  // One task per rail, the second rail finishes first.
+  EXPECT_EQ(0, subscriber->getValueCount());
+  executor.runTasks();
+  EXPECT_TRUE(subscriber->isComplete());
+  return subscriber->values();
+}
+} // namespace
+
+TEST(FlowableTest, ParallelMapOrdered) {
+  EXPECT_EQ(runParallelMap(true), std::vector<int64_t>({0, 10, 20, 30}));
+}
+
+TEST(FlowableTest, ParallelMapUnordered) {
+  EXPECT_EQ(runParallelMap(false), std::vector<int64_t>({10, 30, 0, 20}));
+}
+
+TEST(FlowableTest, Merge) {
+  auto flowable = Flowables::merge<int64_t>(
+      {Flowables::range(0, 3), Flowables::range(10, 2)}, 1);
+  auto subscriber = make_ref<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2, 10, 11}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, Zip) {
+  auto flowable = Flowables::zip<int64_t>(
+      {Flowables::range(0, 3), Flowables::range(10, 5)});
+  auto subscriber = make_ref<TestSubscriber<std::vector<int64_t>>>(2);
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(
+      subscriber->values(),
+      std::vector<std::vector<int64_t>>({{0, 10}, {1, 11}}));
+  EXPECT_FALSE(subscriber->isComplete());
+
+  // Completes with the shortest source.
+  subscriber->request(5);
+  EXPECT_EQ(
+      subscriber->values(),
+      std::vector<std::vector<int64_t>>({{0, 10}, {1, 11}, {2, 12}}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, ZipError) {
+  auto flowable = Flowables::zip<int64_t>(
+      {Flowables::range(0, 3),
+       Flowables::error<int64_t>(std::runtime_error("Source failed"))});
+  auto subscriber = make_ref<TestSubscriber<std::vector<int64_t>>>();
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(0, subscriber->getValueCount());
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ(subscriber->getErrorMsg(), "Source failed");
+}
+
+TEST(FlowableTest, RateLimit) {
+  folly::EventBase evb;
+  auto flowable = Flowables::range(0, 6)->rateLimit(100, 3, evb);
+  auto subscriber = make_ref<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+
+  // The burst goes through right away, the rest as the tokens come in.
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2}));
+  EXPECT_FALSE(subscriber->isComplete());
+
+  auto const start = std::chrono::steady_clock::now();
+  evb.loop();
+  EXPECT_GE(
+      std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2, 3, 4, 5}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+namespace {
+/// Counts the batches it receives, which go through onNext() as usual.
+class BatchCountingSubscriber : public TestSubscriber<int64_t> {
+ public:
+  using TestSubscriber<int64_t>::TestSubscriber;
+
+  void onNextBatch(std::vector<int64_t> values) override {
+    ++batches;
+    TestSubscriber<int64_t>::onNextBatch(std::move(values));
+  }
+
+  int batches{0};
+};
+} // namespace
+
+TEST(FlowableTest, EmitterBatch) {
+  int64_t next = 0;
+  auto flowable = Flowable<int64_t>::create(
+      [&next](auto subscriber, int64_t requested) {
+        std::vector<int64_t> values;
+        for (int64_t i = 0; i < requested; ++i) {
+          values.push_back(next++);
+        }
+        subscriber->onNextBatch(std::move(values));
+        return std::make_tuple(requested, false);
+      });
+
+  auto subscriber = make_ref<BatchCountingSubscriber>(3);
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(1, subscriber->batches);
+  EXPECT_EQ(std::vector<int64_t>({0, 1, 2}), subscriber->values());
+
+  subscriber->request(2);
+  EXPECT_EQ(2, subscriber->batches);
+  EXPECT_EQ(std::vector<int64_t>({0, 1, 2, 3, 4}), subscriber->values());
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, PullSubscriber) {
+  std::vector<int64_t> requests;
+  int64_t next = 0;
+  auto flowable = Flowable<int64_t>::create(
+      [&requests, &next](auto subscriber, int64_t requested) {
+        requests.push_back(requested);
+        for (int64_t i = 0; i < requested && next < 3; ++i) {
+          subscriber->onNext(next++);
+        }
+        if (next == 3) {
+          subscriber->onComplete();
+          return std::make_tuple(requested, true);
+        }
+        return std::make_tuple(requested, false);
+      });
+
+  auto subscriber = make_ref<PullSubscriber<int64_t>>(2);
+  flowable->subscribe(subscriber);
+  // The prefetched items wait to be pulled.
+  EXPECT_EQ(std::vector<int64_t>({2}), requests);
+
+  EXPECT_EQ(0, subscriber->next().get().value());
+  EXPECT_EQ(std::vector<int64_t>({2, 1}), requests);
+  EXPECT_EQ(1, subscriber->next().get().value());
+  EXPECT_EQ(2, subscriber->next().get().value());
+  EXPECT_FALSE(subscriber->next().get().hasValue());
+}
+
+TEST(FlowableTest, BlockingIterable) {
+  folly::ScopedEventBaseThread worker;
+  auto items = Flowables::range(0, 100)
+                   ->subscribeOn(*worker.getEventBase())
+                   ->toBlockingIterable(16);
+
+  int64_t expected = 0;
+  for (auto& item : *items) {
+    EXPECT_EQ(expected++, item);
+  }
+  EXPECT_EQ(100, expected);
+}
+
+TEST(FlowableTest, BlockingIterableChunks) {
+  std::vector<int64_t> requests;
+  auto flowable = Flowable<int64_t>::create(
+      [&requests, next = int64_t{0}](auto subscriber, int64_t requested) mutable {
+        requests.push_back(requested);
+        for (int64_t i = 0; i < requested && next < 10; ++i) {
+          subscriber->onNext(next++);
+        }
+        if (next == 10) {
+          subscriber->onComplete();
+          return std::make_tuple(requested, true);
+        }
+        return std::make_tuple(requested, false);
+      });
+
+  auto items = flowable->toBlockingIterable(8);
+  EXPECT_EQ(std::vector<int64_t>({8}), requests);
+  EXPECT_EQ(0, items->next().value());
+  EXPECT_EQ(std::vector<int64_t>({8}), requests);
+  // Requested again a quarter of the prefetch at a time.
+  EXPECT_EQ(1, items->next().value());
+  EXPECT_EQ(std::vector<int64_t>({8, 2}), requests);
+
+  std::vector<int64_t> rest(items->begin(), items->end());
+  EXPECT_EQ(std::vector<int64_t>({2, 3, 4, 5, 6, 7, 8, 9}), rest);
+  EXPECT_FALSE(items->next());
+}
+
+TEST(FlowableTest, PullSubscriberPending) {
+  Reference<Subscriber<int>> upstream;
+  auto flowable =
+      Flowables::fromPublisher<int>([&upstream](auto subscriber) {
+        subscriber->onSubscribe(Subscription::empty());
+        upstream = std::move(subscriber);
+      });
+  auto subscriber = make_ref<PullSubscriber<int>>();
+  flowable->subscribe(subscriber);
+
+  auto first = subscriber->next();
+  EXPECT_FALSE(first.isReady());
+  upstream->onNext(7);
+  EXPECT_EQ(7, first.get().value());
+
+  auto second = subscriber->next();
+  upstream->onError(std::runtime_error("pull error"));
+  EXPECT_THROW(second.get(), std::runtime_error);
+  EXPECT_THROW(subscriber->next().get(), std::runtime_error);
+}
+
 TEST(FlowableTest, FlowableError) {
   constexpr auto kMsg = "something broke!";
 
@@ -0,0 +1,89 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "yarpl/utils/MpscQueue.h"
+
+using namespace yarpl;
+
+TEST(MpscQueueTest, PushReportsEmpty) {
+  MpscQueue<int> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_FALSE(queue.push(2));
+  EXPECT_FALSE(queue.empty());
+
+  std::vector<int> items;
+  queue.drain([&](int i) {
+    items.push_back(i);
+    if (i == 2) {
+      // items pushed while draining are consumed by the same drain
+      EXPECT_FALSE(queue.push(3));
+    }
+  });
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), items);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.push(4));
+}
+
+TEST(MpscQueueTest, DrainUpTo) {
+  MpscQueue<int> queue;
+  for (int i = 0; i < 5; ++i) {
+    queue.push(i);
+  }
+
+  std::vector<int> items;
+  auto consume = [&](int i) { items.push_back(i); };
+  EXPECT_TRUE(queue.drainUpTo(2, consume));
+  EXPECT_EQ(std::vector<int>({0, 1}), items);
+  // the queue isn't reported empty while the rest waits to be drained
+  EXPECT_FALSE(queue.push(5));
+  EXPECT_FALSE(queue.drainUpTo(10, consume));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5}), items);
+  EXPECT_TRUE(queue.push(6));
+}
+
+TEST(MpscQueueTest, ManyProducers) {
+  constexpr int kProducers = 4;
+  constexpr int kItems = 10000;
+  MpscQueue<std::pair<int, int>> queue;
+  std::atomic<int> drains{0};
+  std::vector<int> next(kProducers, 0);
+
+  auto consume = [&] {
+    queue.drain([&](std::pair<int, int> item) {
+      // items of one producer arrive in order
+      EXPECT_EQ(next[item.first], item.second);
+      next[item.first] = item.second + 1;
+    });
+  };
+
+  std::vector<std::thread> producers;
+  std::mutex consumer;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kItems; ++i) {
+        if (queue.push(std::make_pair(p, i))) {
+          ++drains;
+          std::lock_guard<std::mutex> lock(consumer);
+          consume();
+        }
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_TRUE(queue.empty());
+  EXPECT_GE(drains.load(), 1);
+  for (int p = 0; p < kProducers; ++p) {
+    EXPECT_EQ(kItems, next[p]);
+  }
+}
@@ -1,10 +1,13 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include <folly/Baton.h>
+#include <folly/Executor.h>
+#include <folly/io/async/EventBase.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <atomic>
 #include <condition_variable>
+#include <numeric>
 
 #include "yarpl/Observable.h"
 #include "yarpl/flowable/Subscriber.h"
@@ -336,6 +339,56 @@ TEST(Observable, toFlowableBufferStrategy) {
   EXPECT_EQ(v, std::vector<int64_t>({1, 2, 3, 4, 5, 6, 7, 8, 9}));
 }
 
+namespace {
+/// Converts an Observable of 1 to 9 with a buffer of 3 items, and requests 2
+/// items and then 5 more.
+std::vector<int64_t> runBoundedBuffer(
+    BufferOverflowStrategy overflow,
+    bool expectError) {
+  auto f = Observables::range(1, 10)->toFlowable(3, overflow);
+
+  std::vector<int64_t> v;
+  auto subscriber = make_ref<testing::StrictMock<MockSubscriber<int64_t>>>(2);
+
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](int64_t value) { v.push_back(value); }));
+  if (expectError) {
+    EXPECT_CALL(*subscriber, onError_(_))
+        .WillOnce(Invoke([&](folly::exception_wrapper ex) {
+          EXPECT_TRUE(ex.is_compatible_with<
+                      yarpl::flowable::MissingBackpressureException>());
+        }));
+  } else {
+    EXPECT_CALL(*subscriber, onComplete_());
+  }
+
+  f->subscribe(subscriber);
+  if (!expectError) {
+    subscriber->subscription()->request(5);
+  }
+  return v;
+}
+} // namespace
+
+TEST(Observable, toFlowableBoundedBufferDropOldest) {
+  EXPECT_EQ(
+      runBoundedBuffer(BufferOverflowStrategy::DROP_OLDEST, false),
+      std::vector<int64_t>({1, 2, 7, 8, 9}));
+}
+
+TEST(Observable, toFlowableBoundedBufferDropNewest) {
+  EXPECT_EQ(
+      runBoundedBuffer(BufferOverflowStrategy::DROP_NEWEST, false),
+      std::vector<int64_t>({1, 2, 3, 4, 5}));
+}
+
+TEST(Observable, toFlowableBoundedBufferError) {
+  EXPECT_EQ(
+      runBoundedBuffer(BufferOverflowStrategy::ERROR, true),
+      std::vector<int64_t>({1, 2}));
+}
+
 TEST(Observable, toFlowableLatestStrategy) {
   auto a = Observables::range(1, 10);
   auto f = a->toFlowable(BackpressureStrategy::LATEST);
@@ -356,6 +409,31 @@ TEST(Observable, toFlowableLatestStrategy) {
   EXPECT_EQ(v, std::vector<int64_t>({1, 2, 3, 4, 5, 9}));
 }
 
+TEST(Observable, toFlowableLatestByKeyStrategy) {
+  auto f = Observables::range(1, 10)->toFlowableLatestByKey(
+      [](int64_t value) { return value % 3; });
+
+  std::vector<int64_t> v;
+
+  auto subscriber = make_ref<testing::StrictMock<MockSubscriber<int64_t>>>(2);
+
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](int64_t value) { v.push_back(value); }));
+  EXPECT_CALL(*subscriber, onComplete_());
+
+  f->subscribe(subscriber);
+  EXPECT_EQ(v, std::vector<int64_t>({1, 2}));
+
+  // 3 to 9 came in without demand: the latest of each key is kept, in the
+  // order of the first item of the key.
+  subscriber->subscription()->request(2);
+  EXPECT_EQ(v, std::vector<int64_t>({1, 2, 9, 7}));
+
+  subscriber->subscription()->request(5);
+  EXPECT_EQ(v, std::vector<int64_t>({1, 2, 9, 7, 8}));
+}
+
 TEST(Observable, Just) {
   EXPECT_EQ(run(Observables::just(22)), std::vector<int>{22});
   EXPECT_EQ(
@@ -490,6 +568,148 @@ TEST(Observable, IgnoreElements) {
   EXPECT_EQ(collector->error(), false);
 }
 
+TEST(Observable, BufferByCount) {
+  EXPECT_EQ(
+      run(Observables::range(0, 5)->buffer(2)),
+      std::vector<std::vector<int64_t>>({{0, 1}, {2, 3}, {4}}));
+}
+
+TEST(Observable, BufferByTime) {
+  folly::EventBase evb;
+  Reference<Observer<int64_t>> upstream;
+  auto observable = Observable<int64_t>::create(
+                        [&upstream](Reference<Observer<int64_t>> observer) {
+                          upstream = std::move(observer);
+                        })
+                        ->buffer(10, std::chrono::milliseconds(10), evb);
+  auto collector = make_ref<CollectingObserver<std::vector<int64_t>>>();
+  observable->subscribe(collector);
+
+  upstream->onNext(1);
+  upstream->onNext(2);
+  EXPECT_TRUE(collector->values().empty());
+
+  // The timer emits the items, and stops once upstream completes.
+  evb.runAfterDelay([&upstream] { upstream->onComplete(); }, 100);
+  evb.loop();
+
+  EXPECT_EQ(
+      collector->values(), std::vector<std::vector<int64_t>>({{1, 2}}));
+  EXPECT_TRUE(collector->complete());
+}
+
+TEST(Observable, ThrottleFirst) {
+  auto collector = make_ref<CollectingObserver<int64_t>>();
+  Observables::range(0, 5)
+      ->throttleFirst(std::chrono::seconds(10))
+      ->subscribe(collector);
+
+  EXPECT_EQ(collector->values(), std::vector<int64_t>({0}));
+  EXPECT_TRUE(collector->complete());
+}
+
+TEST(Observable, SampleAndDebounce) {
+  folly::EventBase evb;
+  Reference<Observer<int64_t>> sampled;
+  Reference<Observer<int64_t>> debounced;
+  auto sampledCollector = make_ref<CollectingObserver<int64_t>>();
+  auto debouncedCollector = make_ref<CollectingObserver<int64_t>>();
+  Observable<int64_t>::create([&sampled](Reference<Observer<int64_t>> o) {
+    sampled = std::move(o);
+  })->sample(std::chrono::milliseconds(10), evb)->subscribe(sampledCollector);
+  Observable<int64_t>::create([&debounced](Reference<Observer<int64_t>> o) {
+    debounced = std::move(o);
+  })->debounce(std::chrono::milliseconds(20), evb)
+      ->subscribe(debouncedCollector);
+
+  // A burst of items, followed by a quiet period and one more item.
+  for (int64_t i = 1; i <= 3; ++i) {
+    sampled->onNext(i);
+    debounced->onNext(i);
+  }
+  evb.runAfterDelay(
+      [&] {
+        sampled->onNext(4);
+        debounced->onNext(4);
+      },
+      100);
+  evb.runAfterDelay(
+      [&] {
+        sampled->onComplete();
+        debounced->onComplete();
+      },
+      200);
+  evb.loop();
+
+  EXPECT_EQ(sampledCollector->values(), std::vector<int64_t>({3, 4}));
+  EXPECT_EQ(debouncedCollector->values(), std::vector<int64_t>({3, 4}));
+  EXPECT_TRUE(sampledCollector->complete());
+  EXPECT_TRUE(debouncedCollector->complete());
+}
+
+namespace {
+/// Runs the tasks added to it when asked to.
+class QueueingExecutor : public folly::Executor {
+ public:
+  void add(folly::Func task) override {
+    tasks_.push_back(std::move(task));
+  }
+
+  size_t runTasks() {
+    auto tasks = std::move(tasks_);
+    tasks_.clear();
+    for (auto& task : tasks) {
+      task();
+    }
+    return tasks.size();
+  }
+
+ private:
+  std::vector<folly::Func> tasks_;
+};
+} // namespace
+
+TEST(Observable, ObserveOnBatches) {
+  QueueingExecutor executor;
+  auto collector = make_ref<CollectingObserver<int64_t>>();
+  Observables::range(0, 25)->observeOn(executor, 10)->subscribe(collector);
+  EXPECT_TRUE(collector->values().empty());
+
+  // One task per batch of signals, the last one also completes.
+  EXPECT_EQ(1U, executor.runTasks());
+  EXPECT_EQ(10U, collector->values().size());
+  EXPECT_EQ(1U, executor.runTasks());
+  EXPECT_EQ(20U, collector->values().size());
+  EXPECT_EQ(1U, executor.runTasks());
+  EXPECT_EQ(0U, executor.runTasks());
+
+  std::vector<int64_t> expected(25);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(expected, collector->values());
+  EXPECT_TRUE(collector->complete());
+}
+
+TEST(Observable, ObserveOnCancel) {
+  QueueingExecutor executor;
+  Reference<Observer<int>> upstream;
+  auto collector = make_ref<CollectingObserver<int>>();
+  auto subscription = Observable<int>::create(
+                          [&upstream](Reference<Observer<int>> observer) {
+                            upstream = std::move(observer);
+                          })
+                          ->observeOn(executor)
+                          ->subscribe(collector);
+
+  upstream->onNext(1);
+  subscription->cancel();
+  upstream->onNext(2);
+  executor.runTasks();
+
+  // The items queued before the cancel are still delivered.
+  EXPECT_EQ(std::vector<int>({1}), collector->values());
+  EXPECT_FALSE(collector->complete());
+}
+
 TEST(Observable, Error) {
   auto observable =
       Observables::error<int>(std::runtime_error("something broke!"));
@@ -0,0 +1,58 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "yarpl/utils/RingBuffer.h"
+
+using namespace yarpl;
+
+TEST(RingBufferTest, PowerOfTwoCapacity) {
+  RingBuffer<int> buffer(5);
+  EXPECT_EQ(8U, buffer.capacity());
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RingBufferTest, WrapsAroundAndGrows) {
+  RingBuffer<std::unique_ptr<int>> buffer(4);
+  int next = 0;
+  int expected = 0;
+  // move the head around the array before it fills up
+  for (int i = 0; i < 3; ++i) {
+    buffer.push_back(std::make_unique<int>(next++));
+    buffer.push_back(std::make_unique<int>(next++));
+    EXPECT_EQ(expected++, *buffer.front());
+    buffer.pop_front();
+  }
+  EXPECT_EQ(3U, buffer.size());
+  EXPECT_EQ(4U, buffer.capacity());
+
+  for (int i = 0; i < 3; ++i) {
+    buffer.push_back(std::make_unique<int>(next++));
+  }
+  EXPECT_EQ(6U, buffer.size());
+  EXPECT_EQ(8U, buffer.capacity());
+
+  while (!buffer.empty()) {
+    EXPECT_EQ(expected++, *buffer.front());
+    buffer.pop_front();
+  }
+  EXPECT_EQ(next, expected);
+}
+
+TEST(RingBufferTest, IndexesFromTheFront) {
+  RingBuffer<int> buffer(4);
+  for (int i = 0; i < 6; ++i) {
+    buffer.push_back(i);
+  }
+  buffer.pop_front();
+  buffer.pop_front();
+  buffer.push_back(6);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    EXPECT_EQ(static_cast<int>(i) + 2, buffer[i]);
+  }
+  buffer[1] = 42;
+  buffer.pop_front();
+  EXPECT_EQ(42, buffer.front());
+}
@@ -3,6 +3,7 @@
 #include <folly/Baton.h>
 #include <gtest/gtest.h>
 #include <atomic>
+#include <numeric>
 #include <folly/ExceptionWrapper.h>
 
 #include "yarpl/Single.h"
@@ -83,3 +84,107 @@ TEST(Single, MapWithException) {
 
   observer->assertOnErrorMessage("Too big!");
 }
+
+namespace {
+/// A Single whose observer is kept, to be completed by the test.
+struct PendingSingle {
+  Reference<Single<int>> single;
+  std::shared_ptr<Reference<SingleObserver<int>>> observer{
+      std::make_shared<Reference<SingleObserver<int>>>()};
+  std::shared_ptr<std::atomic<bool>> cancelled{
+      std::make_shared<std::atomic<bool>>(false)};
+
+  PendingSingle() {
+    single = Single<int>::create([ observer = observer, cancelled = cancelled ](
+        Reference<SingleObserver<int>> obs) {
+      obs->onSubscribe(SingleSubscriptions::create(*cancelled));
+      *observer = std::move(obs);
+    });
+  }
+};
+} // namespace
+
+TEST(Single, WhenAll) {
+  PendingSingle first, second;
+  auto to = SingleTestObserver<std::vector<int>>::create();
+  Singles::whenAll<int>({first.single, Singles::just<int>(2), second.single})
+      ->subscribe(to);
+  to->assertNoTerminalEvent();
+
+  (*second.observer)->onSuccess(3);
+  to->assertNoTerminalEvent();
+  (*first.observer)->onSuccess(1);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({1, 2, 3});
+}
+
+TEST(Single, WhenAllEmpty) {
+  auto to = SingleTestObserver<std::vector<int>>::create();
+  Singles::whenAll<int>({})->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue({});
+}
+
+TEST(Single, WhenAllErrorCancelsTheOthers) {
+  PendingSingle first, second;
+  auto to = SingleTestObserver<std::vector<int>>::create();
+  Singles::whenAll<int>({first.single, second.single})->subscribe(to);
+
+  (*first.observer)
+      ->onError(folly::exception_wrapper(std::runtime_error("broke")));
+  to->awaitTerminalEvent();
+  to->assertOnErrorMessage("broke");
+  EXPECT_FALSE(*first.cancelled);
+  EXPECT_TRUE(*second.cancelled);
+
+  // Late results are dropped.
+  (*second.observer)->onSuccess(2);
+}
+
+TEST(Single, WhenAllCancel) {
+  PendingSingle first, second;
+  auto to = SingleTestObserver<std::vector<int>>::create();
+  Singles::whenAll<int>({first.single, second.single})->subscribe(to);
+
+  to->cancel();
+  EXPECT_TRUE(*first.cancelled);
+  EXPECT_TRUE(*second.cancelled);
+}
+
+TEST(Single, Zip) {
+  auto to = SingleTestObserver<int>::create();
+  Singles::zip<int>(
+      {Singles::just<int>(1), Singles::just<int>(2), Singles::just<int>(3)},
+      [](std::vector<int> values) {
+        return std::accumulate(values.begin(), values.end(), 0);
+      })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue(6);
+}
+
+namespace {
+template <typename T>
+struct MapUpstream;
+
+template <typename U, typename D, typename F>
+struct MapUpstream<Reference<MapOperator<U, D, F>>> {
+  using type = U;
+};
+} // namespace
+
+TEST(Single, MapsFuse) {
+  auto fused = Singles::just<int>(1)
+                   ->map([](int n) { return n + 10; })
+                   ->map([](int n) { return std::to_string(n); })
+                   ->map([](std::string s) { return s.size(); });
+  // The last map is fused down to the Single<int>.
+  static_assert(
+      std::is_same<MapUpstream<decltype(fused)>::type, int>::value,
+      "maps are fused");
+
+  auto to = SingleTestObserver<size_t>::create();
+  fused->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue(2);
+}
@@ -99,3 +99,40 @@ TEST(Credits, consumeTooMany) {
   consume(&rn, 110);
   ASSERT_EQ(rn, 0);
 }
+
+TEST(Credits, consumeInfinite) {
+  std::atomic<std::int64_t> rn{INT64_MAX};
+  consume(&rn, 10);
+  ASSERT_TRUE(isInfinite(&rn));
+}
+
+TEST(Credits, concurrentAddAndConsume) {
+  std::atomic<std::int64_t> rn{0};
+  std::atomic<std::int64_t> consumed{0};
+  std::thread consumer([&] {
+    while (consumed < 100000) {
+      if (rn.load() > 0) {
+        consume(&rn, 1);
+        ++consumed;
+      }
+    }
+  });
+  for (int i = 0; i < 100000; ++i) {
+    add(&rn, 1);
+  }
+  consumer.join();
+  ASSERT_EQ(rn, 0);
+}
+
+TEST(Credits, local) {
+  LocalCredits credits;
+  ASSERT_EQ(5, credits.add(5));
+  ASSERT_EQ(3, credits.consume(2));
+  ASSERT_EQ(0, credits.consume(10));
+  credits.add(INT64_MAX);
+  ASSERT_TRUE(credits.isInfinite());
+  ASSERT_EQ(INT64_MAX, credits.consume(1));
+  ASSERT_TRUE(credits.cancel());
+  ASSERT_FALSE(credits.cancel());
+  ASSERT_EQ(kCanceled, credits.add(1));
+}